@@ -99,6 +99,7 @@ let package = Package(
       sources: [
         "swift_bindings/optimizers/Optimizer.swift",
         "swift_bindings/optimizers/Optimizers.swift",
+        "swift_bindings/optimizers/ParameterArena.swift",
       ],
       swiftSettings: conditionalSwiftSettings),
 //     .target(
@@ -18,5 +18,6 @@
 #include <tensorflow/c/c_api.h>
 #include <tensorflow/c/c_api_experimental.h>
 #include <tensorflow/c/eager/c_api.h>
+#include <tensorflow/c/eager/c_api_experimental.h>
 
 #endif
@@ -116,6 +116,12 @@ void setReplicationDevices(struct DeviceList* device_list) {
   xla::ComputationClient::SetReplicationDevices(device_strings);
 }
 
+void resetReplicationDevices(struct DeviceList* device_list) {
+  const auto device_strings = DeviceListToStrings(device_list);
+  xla::ComputationClient::SetReplicationDevices(device_strings);
+  swift_xla::XLATensor::InvalidateReplicatedComputations(device_strings);
+}
+
 struct DeviceList* getReplicationDevices() {
   return DeviceListFromStrings(xla::ComputationClient::GetReplicationDevices());
 }
@@ -137,6 +143,20 @@ void syncLiveTensorsForDevices(struct DeviceList* device_list) {
   mwait.Wait();
 }
 
+void warmupCompilationCache(const char* manifest_path) {
+  swift_xla::XLATensor::WarmupCompilationCache(manifest_path);
+}
+
+void pushIrScope(const char* name) { swift_xla::ir::ScopePusher::Push(name); }
+
+void popIrScope() { swift_xla::ir::ScopePusher::Pop(); }
+
+void setRngSeed(const struct CDevice* device, uint64_t seed) {
+  swift_xla::Device tmp_device;
+  if (device) tmp_device = ConvertDevice(*device);
+  swift_xla::XLATensor::SetRngSeed(device ? &tmp_device : nullptr, seed);
+}
+
 void XLATensor_LazyTensorBarrier(const struct CDevice* device,
                                  struct DeviceList* device_list, bool wait) {
   const auto device_strings = DeviceListToStrings(device_list);
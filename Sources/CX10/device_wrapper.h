@@ -19,6 +19,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #if !defined(XLA_API)
 #define XLA_API
@@ -59,10 +60,29 @@ XLA_API void setReplicationDevices(struct DeviceList* device_list);
 // Get current device replication for cross-device gradient reduction.
 XLA_API struct DeviceList* getReplicationDevices();
 
+// Replaces the replication devices at a step barrier, like after a host left
+// the pool, and drops the cached computations compiled for other replication
+// devices. The single device computations stay cached.
+XLA_API void resetReplicationDevices(struct DeviceList* device_list);
+
 // Execute outstanding operations for all live tensors across the provided
 // devices, in parallel.
 XLA_API void syncLiveTensorsForDevices(struct DeviceList* device_list);
 
+// Compiles all the computations recorded within the given manifest folder (see
+// XLA_RECORD_COMPILE_MANIFEST), and adds them to the compilation cache.
+XLA_API void warmupCompilationCache(const char* manifest_path);
+
+// Enters and leaves a nested IR scope on the calling thread. The scope names
+// tag the IR nodes traced within them, and the scopes repeating with the same
+// structure can be outlined (see XLA_OUTLINE_SCOPE_DEPTH).
+XLA_API void pushIrScope(const char* name);
+XLA_API void popIrScope();
+
+// Sets the step seed of the random ops on the device, or on all the devices if
+// null, which the following steps derive their seeds from (see XLA_STEP_RNG).
+XLA_API void setRngSeed(const struct CDevice* device, uint64_t seed);
+
 // Marks step and synchronizes a single device out of a list of devices.
 // For use in a multi-threaded environment.
 XLA_API void XLATensor_LazyTensorBarrier(const struct CDevice* device,
@@ -20,6 +20,9 @@
 
 #include "xla_tensor_wrapper.h"
 
+#include <algorithm>
+#include <sstream>
+
 #include "absl/container/flat_hash_set.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
@@ -87,6 +90,9 @@ struct ExtraInputDiscovery {
       state.visited_looking_for_extras = true;
       if (state.depends_on_placeholder) {
         work_list.push_back(v.node);
+      } else if (v.node->op() == swift_xla::ir::OpKind(at::prim::Constant)) {
+        // Constants have no operands, and get emitted within the body rather
+        // than carried through the loop.
       } else {
         results.push_back(Value(n, v.index));
       }
@@ -146,8 +152,13 @@ class XLAFunctionalWhileNode : public swift_xla::ir::Node {
     out.insert(out.end(), extras.begin(), extras.end());
     return out;
   }
-  static xla::hash_t HashOfResults(absl::Span<const Value> results) {
-    xla::hash_t hash = 0;
+  // A runtime trip count only reaches the hash through the shape of n, so the
+  // loop compiles once for all of its values. A static trip count shapes the
+  // unrolling, and goes in the hash.
+  static xla::hash_t HashOfResults(absl::Span<const Value> results,
+                                   xla::int64 trip_count,
+                                   xla::int64 unroll_factor) {
+    xla::hash_t hash = xla::util::MHash(trip_count, unroll_factor);
     for (auto& result : results)
       hash = xla::util::HashCombine(hash, result.hash());
     return hash;
@@ -155,15 +166,19 @@ class XLAFunctionalWhileNode : public swift_xla::ir::Node {
   XLAFunctionalWhileNode(absl::Span<const Value> initial, const Value& n,
                          const Value& index_placeholder,
                          absl::Span<const Value> placeholders,
-                         absl::Span<const Value> results)
+                         absl::Span<const Value> results,
+                         xla::int64 trip_count, xla::int64 unroll_factor)
       : Node(swift_xla::ir::OpKind(at::aten::functional_while),
              BuildArgs(
                  initial, n,
                  DiscoverExtraInputs(results, index_placeholder, placeholders)),
-             ShapeOfXlaOpList(results), results.size(), HashOfResults(results)),
+             ShapeOfXlaOpList(results), results.size(),
+             HashOfResults(results, trip_count, unroll_factor)),
         index_placeholder_(index_placeholder),
         placeholders_(placeholders.begin(), placeholders.end()),
-        results_(results.begin(), results.end()) {}
+        results_(results.begin(), results.end()),
+        trip_count_(trip_count),
+        unroll_factor_(std::max<xla::int64>(unroll_factor, 1)) {}
 
   static xla::XlaOp zeroLike(xla::XlaOp op) {
     auto* b = op.builder();
@@ -179,73 +194,344 @@ class XLAFunctionalWhileNode : public swift_xla::ir::Node {
                swift_xla::XlaHelpers::ShapeOfXlaOp(op).element_type()));
   }
 
-  XlaOpVector Lower(LoweringContext* loctx) const {
+  static xla::XlaOp valueLike(xla::XlaOp op, xla::int64 value) {
+    return swift_xla::XlaHelpers::ScalarValue<xla::int64>(
+        value, swift_xla::XlaHelpers::ShapeOfXlaOp(op).element_type(),
+        op.builder());
+  }
+
+  std::string ToString() const override {
+    std::stringstream ss;
+    ss << Node::ToString() << ", trip_count=" << trip_count_
+       << ", unroll_factor=" << unroll_factor_;
+    return ss.str();
+  }
+
+  XlaOpVector Lower(LoweringContext* loctx) const override {
+    size_t last_i = placeholders_.size();
+    std::vector<xla::XlaOp> carried;
+    for (size_t i = 0; i < last_i; ++i) {
+      carried.push_back(loctx->GetOutputOp(operand(i)));
+    }
+    xla::XlaOp n = loctx->GetOutputOp(operand(last_i));
+    std::vector<xla::XlaOp> extras;
+    for (size_t i = last_i + 1; i < operands().size(); ++i) {
+      extras.push_back(loctx->GetOutputOp(operand(i)));
+    }
+    xla::XlaOp index = zeroLike(n);
+
+    if (trip_count_ >= 0 && unroll_factor_ >= trip_count_) {
+      // Small fixed trip counts get fully unrolled, without any loop.
+      for (xla::int64 i = 0; i < trip_count_; ++i) {
+        carried = LowerIteration(loctx->builder(), loctx->device(), carried,
+                                 index + valueLike(index, i), extras);
+      }
+      return ReturnOps(carried, loctx);
+    }
+    LowerLoop(loctx, unroll_factor_, n, &carried, &index, extras);
+    if (unroll_factor_ > 1) {
+      if (trip_count_ >= 0) {
+        for (xla::int64 i = 0; i < trip_count_ % unroll_factor_; ++i) {
+          carried = LowerIteration(loctx->builder(), loctx->device(), carried,
+                                   index + valueLike(index, i), extras);
+        }
+      } else {
+        LowerLoop(loctx, 1, n, &carried, &index, extras);
+      }
+    }
+    return ReturnOps(carried, loctx);
+  }
+
+  // Lowers one iteration of the body with the given builder. The captured
+  // extras are already lowered outside of the loop, and only the nodes which
+  // depend on the placeholders get lowered here. Returns the carried values for
+  // the next iteration.
+  std::vector<xla::XlaOp> LowerIteration(
+      xla::XlaBuilder* b, const swift_xla::Device& device,
+      absl::Span<const xla::XlaOp> carried, xla::XlaOp index,
+      absl::Span<const xla::XlaOp> extras) const {
+    size_t last_i = placeholders_.size();
+    swift_xla::ir::Util::EmissionMap emap;
+    for (const auto& placeholder : placeholders_) {
+      emap[placeholder.node.get()] = swift_xla::ir::Util::kEmitted;
+    }
+    for (size_t i = last_i + 1; i < operands().size(); ++i) {
+      emap[operand(i).node] = swift_xla::ir::Util::kEmitted;
+    }
+    emap[index_placeholder_.node.get()] = swift_xla::ir::Util::kEmitted;
+    swift_xla::ir::LoweringContext body_loctx(b, device, std::move(emap));
+    for (size_t i = 0; i < placeholders_.size(); ++i) {
+      body_loctx.AssignOutputOp(placeholders_[i], carried[i]);
+    }
+    for (size_t i = last_i + 1; i < operands().size(); ++i) {
+      body_loctx.AssignOutputOp(operand(i), extras[i - last_i - 1]);
+    }
+    body_loctx.AssignOutputOp(index_placeholder_, index);
+
+    std::vector<xla::XlaOp> next;
+    for (auto& result : results_) {
+      next.push_back(body_loctx.GetOutputOp(result));
+    }
+    return next;
+  }
+
+  // Lowers a while loop running the body unroll_factor times per iteration, as
+  // long as unroll_factor iterations are left. The carry holds the carried
+  // values, the index, n and the extras, in this order.
+  void LowerLoop(LoweringContext* loctx, xla::int64 unroll_factor,
+                 xla::XlaOp n, std::vector<xla::XlaOp>* carried,
+                 xla::XlaOp* index, absl::Span<const xla::XlaOp> extras) const {
     size_t last_i = placeholders_.size();
+    std::vector<xla::XlaOp> args(carried->begin(), carried->end());
+    args.push_back(*index);
+    args.push_back(n);
+    args.insert(args.end(), extras.begin(), extras.end());
+    xla::XlaOp initial = xla::Tuple(loctx->builder(), args);
+    xla::Shape initial_shape = swift_xla::XlaHelpers::ShapeOfXlaOp(initial);
 
     auto body_builder = loctx->builder()->CreateSubBuilder("loop_body");
-    xla::XlaOp initial;
+    xla::XlaOp body_result;
     {
-      std::vector<xla::XlaOp> args;
-      args.reserve(operands().size() + 1);
+      auto* b = body_builder.get();
+      auto t = xla::Parameter(b, 0, initial_shape, "tuple");
+      std::vector<xla::XlaOp> body_carried;
       for (size_t i = 0; i < last_i; ++i) {
-        args.push_back(loctx->GetOutputOp(operand(i)));
+        body_carried.push_back(xla::GetTupleElement(t, i));
+      }
+      auto p1 = xla::GetTupleElement(t, last_i);
+      auto p2 = xla::GetTupleElement(t, last_i + 1);
+      std::vector<xla::XlaOp> body_extras;
+      for (size_t i = last_i + 2; i < args.size(); ++i) {
+        body_extras.push_back(xla::GetTupleElement(t, i));
       }
-      auto tmp = loctx->GetOutputOp(operand(last_i));
-      auto it = zeroLike(tmp);
-      args.push_back(it);
-      args.push_back(tmp);
-      for (size_t i = last_i + 1; i < operands().size(); ++i) {
-        args.push_back(loctx->GetOutputOp(operand(i)));
+      for (xla::int64 i = 0; i < unroll_factor; ++i) {
+        body_carried =
+            LowerIteration(b, loctx->device(), body_carried,
+                           i == 0 ? p1 : p1 + valueLike(p1, i), body_extras);
       }
+      std::vector<xla::XlaOp> tmps(body_carried.begin(), body_carried.end());
+      tmps.push_back(p1 + valueLike(p1, unroll_factor));
+      tmps.push_back(p2);
+      tmps.insert(tmps.end(), body_extras.begin(), body_extras.end());
+      body_result = xla::Tuple(b, tmps);
+    }
 
-      initial = xla::Tuple(loctx->builder(), args);
+    auto cond_builder = loctx->builder()->CreateSubBuilder("cond_body");
+    xla::XlaOp cond_result;
+    {
+      auto* b = cond_builder.get();
+      auto t = xla::Parameter(b, 0, initial_shape, "tuple");
+      auto p1 = xla::GetTupleElement(t, last_i);
+      auto p2 = xla::GetTupleElement(t, last_i + 1);
+      cond_result = xla::Le(p1 + valueLike(p1, unroll_factor), p2);
     }
+
+    auto result = xla::While(
+        cond_builder->Build(cond_result).ConsumeValueOrDie(),
+        body_builder->Build(body_result).ConsumeValueOrDie(), initial);
+    for (size_t i = 0; i < last_i; ++i) {
+      (*carried)[i] = xla::GetTupleElement(result, i);
+    }
+    *index = xla::GetTupleElement(result, last_i);
+  }
+
+  Value index_placeholder_;
+  std::vector<Value> placeholders_;
+  std::vector<Value> results_;
+  // The static trip count, or -1 if it is only known at runtime.
+  xla::int64 trip_count_;
+  xla::int64 unroll_factor_;
+};
+
+// Scans the body over the leading dimension of the sequences. The carried
+// values thread through the iterations like in XLAFunctionalWhileNode, and the
+// per-iteration outputs get written into preallocated buffers, which stack them
+// along a new leading dimension of size length.
+class XLAFunctionalScanNode : public swift_xla::ir::Node {
+ public:
+  static std::vector<Value> BuildArgs(absl::Span<const Value> initial,
+                                      const Value& n,
+                                      absl::Span<const Value> sequences,
+                                      absl::Span<const Value> extras) {
+    std::vector<Value> out(initial.begin(), initial.end());
+    out.push_back(n);
+    out.insert(out.end(), sequences.begin(), sequences.end());
+    out.insert(out.end(), extras.begin(), extras.end());
+    return out;
+  }
+  static std::vector<Value> Concat(absl::Span<const Value> lhs,
+                                   absl::Span<const Value> rhs) {
+    std::vector<Value> out(lhs.begin(), lhs.end());
+    out.insert(out.end(), rhs.begin(), rhs.end());
+    return out;
+  }
+  static std::vector<xla::int64> StackedDimensions(const xla::Shape& shape,
+                                                   xla::int64 length) {
+    std::vector<xla::int64> dimensions{length};
+    dimensions.insert(dimensions.end(), shape.dimensions().begin(),
+                      shape.dimensions().end());
+    return dimensions;
+  }
+  static xla::Shape StackedShape(const xla::Shape& shape, xla::int64 length) {
+    return xla::ShapeUtil::MakeShape(shape.element_type(),
+                                     StackedDimensions(shape, length));
+  }
+  static xla::Shape ShapeOfResults(absl::Span<const Value> carried,
+                                   absl::Span<const Value> outputs,
+                                   xla::int64 length) {
+    xla::Shape result = ShapeOfXlaOpList(carried);
+    for (const auto& output : outputs) {
+      xla::ShapeUtil::AppendShapeToTuple(StackedShape(output.shape(), length),
+                                         &result);
+    }
+    return result;
+  }
+  static xla::hash_t HashOfResults(absl::Span<const Value> carried,
+                                   absl::Span<const Value> outputs,
+                                   xla::int64 length, bool reverse) {
+    xla::hash_t hash = xla::util::MHash(length, reverse);
+    for (auto& result : carried)
+      hash = xla::util::HashCombine(hash, result.hash());
+    for (auto& result : outputs)
+      hash = xla::util::HashCombine(hash, result.hash());
+    return hash;
+  }
+  XLAFunctionalScanNode(absl::Span<const Value> initial, const Value& n,
+                        xla::int64 length, absl::Span<const Value> sequences,
+                        absl::Span<const Value> placeholders,
+                        absl::Span<const Value> element_placeholders,
+                        const Value& index_placeholder,
+                        absl::Span<const Value> carried,
+                        absl::Span<const Value> outputs, bool reverse)
+      : Node(swift_xla::ir::OpKind(at::aten::functional_scan),
+             BuildArgs(initial, n, sequences,
+                       DiscoverExtraInputs(
+                           Concat(carried, outputs), index_placeholder,
+                           Concat(placeholders, element_placeholders))),
+             ShapeOfResults(carried, outputs, length),
+             carried.size() + outputs.size(),
+             HashOfResults(carried, outputs, length, reverse)),
+        length_(length),
+        num_sequences_(sequences.size()),
+        index_placeholder_(index_placeholder),
+        placeholders_(placeholders.begin(), placeholders.end()),
+        element_placeholders_(element_placeholders.begin(),
+                              element_placeholders.end()),
+        carried_(carried.begin(), carried.end()),
+        outputs_(outputs.begin(), outputs.end()),
+        reverse_(reverse) {
+    XLA_CHECK_EQ(placeholders_.size(), carried_.size());
+    XLA_CHECK_EQ(element_placeholders_.size(), num_sequences_);
+  }
+
+  std::string ToString() const override {
+    std::stringstream ss;
+    ss << Node::ToString() << ", length=" << length_
+       << ", reverse=" << reverse_;
+    return ss.str();
+  }
+
+  XlaOpVector Lower(LoweringContext* loctx) const override {
+    // The loop carry holds the carried values, the index, n, the output
+    // buffers, the sequences and the extras, in this order.
+    size_t num_carried = placeholders_.size();
+    size_t index_i = num_carried;
+    size_t buffers_i = num_carried + 2;
+    size_t sequences_i = buffers_i + outputs_.size();
+    size_t extras_i = sequences_i + num_sequences_;
+    size_t first_extra_operand = num_carried + 1 + num_sequences_;
+
+    std::vector<xla::XlaOp> args;
+    for (size_t i = 0; i < num_carried; ++i) {
+      args.push_back(loctx->GetOutputOp(operand(i)));
+    }
+    xla::XlaOp n = loctx->GetOutputOp(operand(num_carried));
+    args.push_back(XLAFunctionalWhileNode::zeroLike(n));
+    args.push_back(n);
+    for (const auto& output : outputs_) {
+      const xla::Shape& shape = output.shape();
+      args.push_back(xla::Broadcast(
+          swift_xla::XlaHelpers::ScalarValue<float>(0, shape.element_type(),
+                                                    loctx->builder()),
+          StackedDimensions(shape, length_)));
+    }
+    for (size_t i = num_carried + 1; i < operands().size(); ++i) {
+      args.push_back(loctx->GetOutputOp(operand(i)));
+    }
+    xla::XlaOp initial = xla::Tuple(loctx->builder(), args);
+    xla::Shape initial_shape = swift_xla::XlaHelpers::ShapeOfXlaOp(initial);
+
+    auto body_builder = loctx->builder()->CreateSubBuilder("scan_body");
     xla::XlaOp body_result;
     {
       auto* b = body_builder.get();
+      auto t = xla::Parameter(b, 0, initial_shape, "tuple");
+      std::vector<xla::XlaOp> elements;
+      for (size_t i = 0; i < args.size(); ++i) {
+        elements.push_back(xla::GetTupleElement(t, i));
+      }
+      xla::XlaOp index = elements[index_i];
+      xla::XlaOp step =
+          reverse_ ? elements[index_i + 1] - index -
+                         XLAFunctionalWhileNode::oneLike(index)
+                   : index;
+
       swift_xla::ir::Util::EmissionMap emap;
       for (const auto& placeholder : placeholders_) {
         emap[placeholder.node.get()] = swift_xla::ir::Util::kEmitted;
       }
-      for (size_t i = last_i + 1; i < operands().size(); ++i) {
+      for (const auto& placeholder : element_placeholders_) {
+        emap[placeholder.node.get()] = swift_xla::ir::Util::kEmitted;
+      }
+      for (size_t i = first_extra_operand; i < operands().size(); ++i) {
         emap[operand(i).node] = swift_xla::ir::Util::kEmitted;
       }
       emap[index_placeholder_.node.get()] = swift_xla::ir::Util::kEmitted;
       swift_xla::ir::LoweringContext body_loctx(b, loctx->device(),
                                                 std::move(emap));
-      auto t = xla::Parameter(
-          b, 0, swift_xla::XlaHelpers::ShapeOfXlaOp(initial), "tuple");
-      auto p1 = xla::GetTupleElement(t, last_i);
-      auto p2 = xla::GetTupleElement(t, last_i + 1);
-      for (size_t i = 0; i < placeholders_.size(); ++i) {
-        body_loctx.AssignOutputOp(placeholders_[i], xla::GetTupleElement(t, i));
+      for (size_t i = 0; i < num_carried; ++i) {
+        body_loctx.AssignOutputOp(placeholders_[i], elements[i]);
+      }
+      for (size_t i = 0; i < num_sequences_; ++i) {
+        const xla::Shape& shape = element_placeholders_[i].shape();
+        xla::XlaOp sequence = elements[sequences_i + i];
+        xla::XlaOp element =
+            xla::DynamicSlice(sequence, StartIndices(step, shape.rank()),
+                              StackedDimensions(shape, 1));
+        body_loctx.AssignOutputOp(element_placeholders_[i],
+                                  xla::Reshape(element, shape.dimensions()));
       }
-      for (size_t i = last_i + 1; i < operands().size(); ++i) {
-        body_loctx.AssignOutputOp(operand(i), xla::GetTupleElement(t, i + 1));
+      for (size_t i = first_extra_operand; i < operands().size(); ++i) {
+        body_loctx.AssignOutputOp(
+            operand(i), elements[extras_i + i - first_extra_operand]);
       }
-      body_loctx.AssignOutputOp(index_placeholder_, p1);
+      body_loctx.AssignOutputOp(index_placeholder_, step);
 
       std::vector<xla::XlaOp> tmps;
-      for (auto& result : results_) {
+      for (auto& result : carried_) {
         tmps.push_back(body_loctx.GetOutputOp(result));
       }
-      tmps.push_back(p1 + oneLike(p1));
-      tmps.push_back(p2);
-      for (size_t i = last_i + 1; i < operands().size(); ++i) {
-        tmps.push_back(body_loctx.GetOutputOp(operand(i)));
+      tmps.push_back(index + XLAFunctionalWhileNode::oneLike(index));
+      tmps.push_back(elements[index_i + 1]);
+      for (size_t i = 0; i < outputs_.size(); ++i) {
+        const xla::Shape& shape = outputs_[i].shape();
+        xla::XlaOp output = xla::Reshape(body_loctx.GetOutputOp(outputs_[i]),
+                                         StackedDimensions(shape, 1));
+        tmps.push_back(xla::DynamicUpdateSlice(
+            elements[buffers_i + i], output,
+            StartIndices(step, shape.rank())));
       }
+      tmps.insert(tmps.end(), elements.begin() + sequences_i, elements.end());
       body_result = xla::Tuple(b, tmps);
     }
 
-    auto cond_builder = loctx->builder()->CreateSubBuilder("cond_body");
+    auto cond_builder = loctx->builder()->CreateSubBuilder("scan_cond");
     xla::XlaOp cond_result;
     {
       auto* b = cond_builder.get();
-      auto t = xla::Parameter(
-          b, 0, swift_xla::XlaHelpers::ShapeOfXlaOp(initial), "tuple");
-      auto p1 = xla::GetTupleElement(t, last_i);
-      auto p2 = xla::GetTupleElement(t, last_i + 1);
-      cond_result = xla::Lt(p1, p2);
+      auto t = xla::Parameter(b, 0, initial_shape, "tuple");
+      cond_result = xla::Lt(xla::GetTupleElement(t, index_i),
+                            xla::GetTupleElement(t, index_i + 1));
     }
 
     auto result = xla::While(
@@ -253,15 +539,34 @@ class XLAFunctionalWhileNode : public swift_xla::ir::Node {
         body_builder->Build(body_result).ConsumeValueOrDie(), initial);
 
     std::vector<xla::XlaOp> results;
-    for (size_t i = 0; i < last_i; ++i) {
+    for (size_t i = 0; i < num_carried; ++i) {
       results.push_back(xla::GetTupleElement(result, i));
     }
+    for (size_t i = 0; i < outputs_.size(); ++i) {
+      results.push_back(xla::GetTupleElement(result, buffers_i + i));
+    }
     return ReturnOps(results, loctx);
   }
 
+  // The start indices of the slice at step along the leading dimension of a
+  // stacked tensor whose elements have the given rank.
+  static std::vector<xla::XlaOp> StartIndices(xla::XlaOp step,
+                                              xla::int64 rank) {
+    std::vector<xla::XlaOp> indices{step};
+    for (xla::int64 i = 0; i < rank; ++i) {
+      indices.push_back(XLAFunctionalWhileNode::zeroLike(step));
+    }
+    return indices;
+  }
+
+  xla::int64 length_;
+  size_t num_sequences_;
   Value index_placeholder_;
   std::vector<Value> placeholders_;
-  std::vector<Value> results_;
+  std::vector<Value> element_placeholders_;
+  std::vector<Value> carried_;
+  std::vector<Value> outputs_;
+  bool reverse_;
 };
 
 class XLAPlaceholderNode : public swift_xla::ir::Node {
@@ -296,14 +601,15 @@ std::vector<Value> UnpackIrValues(OpaqueXLATensorArrayRef array) {
 OpaqueXLATensorArrayRef XLATensor_functional_while(
     OpaqueXLATensor* n, OpaqueXLATensorArrayRef initial,
     OpaqueXLATensorArrayRef placeholders, OpaqueXLATensor* indexPlaceholder,
-    OpaqueXLATensorArrayRef results) {
+    OpaqueXLATensorArrayRef results, int64_t trip_count,
+    int64_t unroll_factor) {
   auto initial_ir = UnpackIrValues(initial);
   auto placeholders_ir = UnpackIrValues(placeholders);
   auto results_ir = UnpackIrValues(results);
 
   auto result_node = swift_xla::ir::MakeNode<XLAFunctionalWhileNode>(
       initial_ir, n->GetIrValue(), indexPlaceholder->GetIrValue(),
-      placeholders_ir, results_ir);
+      placeholders_ir, results_ir, trip_count, unroll_factor);
   size_t count = results.size;
   auto opaque_tensors = new OpaqueXLATensor*[count];
   for (size_t i = 0; i < count; ++i) {
@@ -317,3 +623,28 @@ OpaqueXLATensor* XLATensor_makePlaceholder(OpaqueXLATensor* t, int id) {
   return new XLATensor(t->CreateFrom(
       swift_xla::ir::MakeNode<XLAPlaceholderNode>(t->shape(), id)));
 }
+
+OpaqueXLATensorArrayRef XLATensor_functional_scan(
+    OpaqueXLATensor* n, int64_t length, OpaqueXLATensorArrayRef initial,
+    OpaqueXLATensorArrayRef sequences, OpaqueXLATensorArrayRef placeholders,
+    OpaqueXLATensorArrayRef elementPlaceholders,
+    OpaqueXLATensor* indexPlaceholder, OpaqueXLATensorArrayRef carried,
+    OpaqueXLATensorArrayRef outputs, bool reverse) {
+  auto result_node = swift_xla::ir::MakeNode<XLAFunctionalScanNode>(
+      UnpackIrValues(initial), n->GetIrValue(), length,
+      UnpackIrValues(sequences), UnpackIrValues(placeholders),
+      UnpackIrValues(elementPlaceholders), indexPlaceholder->GetIrValue(),
+      UnpackIrValues(carried), UnpackIrValues(outputs), reverse);
+  size_t count = carried.size + outputs.size;
+  auto opaque_tensors = new OpaqueXLATensor*[count];
+  for (size_t i = 0; i < carried.size; ++i) {
+    opaque_tensors[i] = new XLATensor(
+        carried.data[i]->CreateFrom(swift_xla::ir::Value(result_node, i)));
+  }
+  for (size_t i = 0; i < outputs.size; ++i) {
+    size_t index = carried.size + i;
+    opaque_tensors[index] = new XLATensor(outputs.data[i]->CreateFrom(
+        swift_xla::ir::Value(result_node, index)));
+  }
+  return {opaque_tensors, count};
+}
@@ -0,0 +1,278 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks of the ops of swift_bindings/ops_list.txt taking only tensors,
+// over representative shapes and types, on the first device of each kind.
+// The trace, lower, compile and execute phases are timed separately. The
+// specs get generated along the op wrappers, with:
+//   generate_ops.py ... --benchmark_output=op_benchmarks_generated.cc.inc
+// The results can be compared across commits with:
+//   x10_op_benchmarks --benchmark_format=json --benchmark_out=new.json
+//   compare_op_benchmarks.py old.json new.json
+
+#if defined(_WIN32)
+#define XLA_API __declspec(dllexport)
+#else
+#define XLA_API __attribute__((__visibility__("default")))
+#endif
+
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "benchmark/benchmark.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "xla_tensor_wrapper.h"
+
+namespace {
+
+// The type of an op input. The generic ones get instantiated over the types
+// the op is benchmarked at.
+enum class InputType {
+  kGeneric,
+  kGenericInteger,
+  kBool,
+  kInt32,
+  kInt64,
+  kFloat,
+};
+
+struct OpBenchmarkSpec {
+  const char* name;
+  std::vector<InputType> input_types;
+  OpaqueXLATensor* (*run)(OpaqueXLATensor* const* inputs);
+};
+
+#include "op_benchmarks_generated.cc.inc"
+
+enum class Phase { kTrace, kLower, kCompile, kExecute };
+
+struct OpBenchmark {
+  const OpBenchmarkSpec* spec;
+  XLATensorScalarType generic_type;
+  std::vector<size_t> shape;
+  CDevice device;
+};
+
+const char* PhaseName(Phase phase) {
+  switch (phase) {
+    case Phase::kTrace:
+      return "trace";
+    case Phase::kLower:
+      return "lower";
+    case Phase::kCompile:
+      return "compile";
+    case Phase::kExecute:
+      return "execute";
+  }
+  return "unknown";
+}
+
+const char* TypeName(XLATensorScalarType type) {
+  switch (type) {
+#define DEFINE_TYPE_CASE(name, aten_name, type) \
+  case XLATensorScalarType_##name:              \
+    return #name;
+    LIST_SCALAR_TYPES(DEFINE_TYPE_CASE)
+#undef DEFINE_TYPE_CASE
+  }
+  return "Unknown";
+}
+
+XLATensorScalarType GetInputType(const OpBenchmark& benchmark,
+                                 InputType type) {
+  switch (type) {
+    case InputType::kGeneric:
+      return benchmark.generic_type;
+    case InputType::kGenericInteger:
+    case InputType::kInt32:
+      return XLATensorScalarType_Int32;
+    case InputType::kBool:
+      return XLATensorScalarType_Bool;
+    case InputType::kInt64:
+      return XLATensorScalarType_Int64;
+    case InputType::kFloat:
+      return XLATensorScalarType_Float;
+  }
+  return benchmark.generic_type;
+}
+
+std::vector<OpaqueXLATensor*> MakeInputs(const OpBenchmark& benchmark) {
+  size_t num_entries = 1;
+  for (size_t dim : benchmark.shape) {
+    num_entries *= dim;
+  }
+  // Large enough for any of the types.
+  std::vector<int64_t> zeros(num_entries, 0);
+  std::vector<OpaqueXLATensor*> inputs;
+  for (InputType type : benchmark.spec->input_types) {
+    inputs.push_back(copyTensor(GetInputType(benchmark, type), zeros.data(),
+                                num_entries, benchmark.shape.data(),
+                                benchmark.shape.size(), benchmark.device));
+  }
+  return inputs;
+}
+
+struct LoweredOp {
+  xla::XlaComputation computation;
+  std::vector<xla::ComputationClient::DataPtr> arguments;
+};
+
+LoweredOp LowerOp(const swift_xla::XLATensor& result,
+                  const swift_xla::Device& device) {
+  swift_xla::ir::Value root = result.GetIrValue();
+  swift_xla::ir::Util::EmissionMap emission_map;
+  std::vector<const swift_xla::ir::Node*> post_order =
+      swift_xla::ir::Util::ComputePostOrder({root.node.get()}, &emission_map);
+  swift_xla::ir::RootLoweringContext lowering_ctx(
+      "OpBenchmark", device, post_order, std::move(emission_map));
+  lowering_ctx.AddResult(lowering_ctx.GetOutputOp(root));
+  LoweredOp lowered;
+  lowered.computation = ConsumeValue(lowering_ctx.Build());
+  lowered.arguments = lowering_ctx.GetParametersData();
+  return lowered;
+}
+
+xla::ComputationClient::ComputationPtr CompileOp(
+    const xla::XlaComputation& computation, const swift_xla::Device& device) {
+  xla::ProgramShape program_shape = ConsumeValue(computation.GetProgramShape());
+  xla::Shape shape = swift_xla::MakeShapeWithDeviceLayout(
+      program_shape.result(), device.hw_type);
+  std::vector<xla::ComputationClient::CompileInstance> instances;
+  instances.push_back({computation, &shape});
+  return xla::GetX10Device(device)
+      ->Compile(xla::ComputationClient::GetCompilationDevices(
+                    device.ToString(), {}),
+                std::move(instances))
+      .front();
+}
+
+void RunOpBenchmark(benchmark::State& state, const OpBenchmark& benchmark,
+                    Phase phase) {
+  std::vector<OpaqueXLATensor*> inputs = MakeInputs(benchmark);
+  swift_xla::Device device = ConvertDevice(benchmark.device);
+  try {
+    OpaqueXLATensor* result = benchmark.spec->run(inputs.data());
+    if (phase == Phase::kTrace) {
+      destroyTensor(result);
+      for (auto _ : state) {
+        destroyTensor(benchmark.spec->run(inputs.data()));
+      }
+    } else {
+      LoweredOp lowered = LowerOp(*result, device);
+      destroyTensor(result);
+      if (phase == Phase::kLower) {
+        result = benchmark.spec->run(inputs.data());
+        for (auto _ : state) {
+          benchmark::DoNotOptimize(LowerOp(*result, device));
+        }
+        destroyTensor(result);
+      } else if (phase == Phase::kCompile) {
+        for (auto _ : state) {
+          benchmark::DoNotOptimize(CompileOp(lowered.computation, device));
+        }
+      } else {
+        xla::ComputationClient::ComputationPtr computation =
+            CompileOp(lowered.computation, device);
+        xla::ComputationClient::Device* x10_device =
+            xla::GetX10Device(device);
+        // The results get transferred back, to wait for the execution.
+        for (auto _ : state) {
+          xla::ComputationClient::TransferFromServer(
+              x10_device->ExecuteComputation(
+                  *computation, lowered.arguments,
+                  xla::ComputationClient::ExecuteComputationOptions()));
+        }
+      }
+    }
+  } catch (const std::exception& ex) {
+    state.SkipWithError(ex.what());
+  }
+  for (OpaqueXLATensor* input : inputs) {
+    destroyTensor(input);
+  }
+}
+
+bool HasGenericInput(const OpBenchmarkSpec& spec) {
+  for (InputType type : spec.input_types) {
+    if (type == InputType::kGeneric) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns the first device of each kind.
+std::vector<CDevice> GetBenchmarkDevices() {
+  std::vector<CDevice> devices;
+  for (const std::string& device_name :
+       xla::ComputationClient::AllDevices()) {
+    CDevice device = ConvertDevice(swift_xla::Device(device_name));
+    bool seen = false;
+    for (const CDevice& other : devices) {
+      seen = seen || other.hw_type == device.hw_type;
+    }
+    if (!seen) {
+      devices.push_back(device);
+    }
+  }
+  return devices;
+}
+
+void RegisterOpBenchmarks() {
+  const std::vector<std::vector<size_t>> shapes = {{4096}, {256, 256}};
+  const std::vector<XLATensorScalarType> generic_types = {
+      XLATensorScalarType_Float, XLATensorScalarType_BFloat16};
+  const std::vector<Phase> phases = {Phase::kTrace, Phase::kLower,
+                                     Phase::kCompile, Phase::kExecute};
+  for (const CDevice& device : GetBenchmarkDevices()) {
+    std::string device_name = ConvertDevice(device).ToString();
+    for (const OpBenchmarkSpec& spec : kOpBenchmarkSpecs) {
+      for (XLATensorScalarType generic_type : generic_types) {
+        if (!HasGenericInput(spec) && generic_type != generic_types.front()) {
+          continue;
+        }
+        for (const std::vector<size_t>& shape : shapes) {
+          OpBenchmark op_benchmark{&spec, generic_type, shape, device};
+          for (Phase phase : phases) {
+            std::string name = absl::StrCat(
+                "BM_Op/", spec.name, "/", PhaseName(phase), "/", device_name,
+                "/", TypeName(generic_type), "[", absl::StrJoin(shape, ","),
+                "]");
+            benchmark::RegisterBenchmark(
+                name.c_str(), [op_benchmark, phase](benchmark::State& state) {
+                  RunOpBenchmark(state, op_benchmark, phase);
+                });
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  RegisterOpBenchmarks();
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
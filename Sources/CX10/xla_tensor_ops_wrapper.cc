@@ -20,16 +20,28 @@
 
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/attention.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/convert_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/convolution.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/data_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/elementwise.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/function_call_tracker.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/image_augmentation.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/index_narrowing.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_attributes.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/layer_norm.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/layout_manager.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/matrix.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/nll_loss.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/nms_op.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/fused_elementwise.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/infer_output_shape.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/tf_conv_bias_activation.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/tf_conv_bias_activation_backward.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/tf_create_conv_attrs.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/quantization.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/reduction.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/segment_reduction_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/softmax_builder.h"
@@ -61,19 +73,28 @@ xla::hash_t Hash(tensorflow::MirrorPadMode mode) {
 }  // namespace tensorflow
 namespace xla {
 xla::hash_t Hash(const xla::PaddingConfig& padding_config) {
-  std::vector<int64_t> low;
-  std::vector<int64_t> high;
-  std::vector<int64_t> interior;
+  xla::hash_t hash = xla::util::Hash(padding_config.dimensions_size());
   for (const xla::PaddingConfig::PaddingConfigDimension& dim_padding :
        padding_config.dimensions()) {
-    low.push_back(dim_padding.edge_padding_low());
-    high.push_back(dim_padding.edge_padding_high());
-    interior.push_back(dim_padding.interior_padding());
+    hash = xla::util::HashCombine(
+        hash, xla::util::MHash(dim_padding.edge_padding_low(),
+                               dim_padding.edge_padding_high(),
+                               dim_padding.interior_padding()));
   }
-  return xla::util::MHash(low, high, interior);
+  return hash;
 }
+// Hashes the shape fields directly, as the result dimension lists of the ops
+// get hashed on every call.
 xla::hash_t Hash(const xla::Shape& shape) {
-  return xla::util::MHash(shape.ToString());
+  xla::hash_t hash = xla::util::Hash(static_cast<int>(shape.element_type()));
+  if (shape.IsTuple()) {
+    for (const xla::Shape& element_shape : shape.tuple_shapes()) {
+      hash = xla::util::HashCombine(hash, Hash(element_shape));
+    }
+    return hash;
+  }
+  return xla::util::HashCombine(
+      hash, xla::util::MHash(shape.dimensions(), shape.dynamic_dimensions()));
 }
 }  // namespace xla
 namespace swift_xla {
@@ -93,7 +114,7 @@ void OpFieldToString(std::ostream& stream, const char* field_name,
   stream << ", " << field_name << "=" << xla::PaddingConfigToString(value);
 }
 void OpFieldToString(std::ostream& stream, const char* field_name,
-                     const std::vector<int64_t>& value) {
+                     const ir::Int64List& value) {
   stream << ", " << field_name << "=[";
   for (size_t i = 0; i < value.size(); ++i) {
     if (i != 0) stream << ", ";
@@ -322,11 +343,45 @@ xla::XlaOp BuildOneHot(xla::XlaOp indices, xla::XlaOp on_value,
 
 xla::XlaOp LowerTfUnsortedSegmentSum(xla::XlaOp data, xla::XlaOp indices,
                                      int64_t num_segments) {
-  const xla::Shape& data_shape = XlaHelpers::ShapeOfXlaOp(data);
-  xla::XlaOp init_value = xla::Zero(data.builder(), data_shape.element_type());
-  auto combine = [](xla::XlaOp a, xla::XlaOp b) { return a + b; };
-  return UnsortedSegmentReduce(data, indices, init_value, num_segments,
-                               combine);
+  return UnsortedSegmentSum(data, indices, num_segments);
+}
+
+std::vector<xla::XlaOp> LowerLayerNorm(xla::XlaOp input, xla::XlaOp weight,
+                                       xla::XlaOp bias, int64_t dim,
+                                       float eps) {
+  LayerNormOutput result = BuildLayerNorm(input, weight, bias, dim, eps);
+  return {result.output, result.mean, result.invstd};
+}
+
+std::vector<xla::XlaOp> LowerLayerNormBackward(xla::XlaOp grad_output,
+                                               xla::XlaOp input,
+                                               xla::XlaOp weight,
+                                               xla::XlaOp mean,
+                                               xla::XlaOp invstd,
+                                               int64_t dim) {
+  LayerNormGrads grads =
+      BuildLayerNormBackward(grad_output, input, weight, mean, invstd, dim);
+  return {grads.grad_input, grads.grad_weight, grads.grad_bias};
+}
+
+std::vector<xla::XlaOp> LowerRmsNorm(xla::XlaOp input, xla::XlaOp weight,
+                                     int64_t dim, float eps) {
+  RmsNormOutput result = BuildRmsNorm(input, weight, dim, eps);
+  return {result.output, result.invrms};
+}
+
+std::vector<xla::XlaOp> LowerRmsNormBackward(xla::XlaOp grad_output,
+                                             xla::XlaOp input,
+                                             xla::XlaOp weight,
+                                             xla::XlaOp invrms, int64_t dim) {
+  RmsNormGrads grads =
+      BuildRmsNormBackward(grad_output, input, weight, invrms, dim);
+  return {grads.grad_input, grads.grad_weight};
+}
+
+xla::XlaOp LowerEmbeddingSparseUpdate(xla::XlaOp table, xla::XlaOp indices,
+                                      xla::XlaOp values) {
+  return SegmentSumInto(table, values, indices);
 }
 
 xla::BitGeneratorTy GetBestGenerator(LoweringContext* loctx = nullptr) {
@@ -399,6 +454,26 @@ xla::XlaOp LowerNllLoss(xla::XlaOp logits, xla::XlaOp labels,
                       ReductionMode::kMean);
 }
 
+std::vector<xla::XlaOp> LowerSparseSoftmaxCrossEntropy(xla::XlaOp features,
+                                                       xla::XlaOp labels) {
+  return BuildSparseSoftmaxCrossEntropy(features, labels);
+}
+
+std::vector<xla::XlaOp> LowerNonMaxSuppression(xla::XlaOp boxes,
+                                               xla::XlaOp scores,
+                                               xla::XlaOp score_threshold,
+                                               xla::XlaOp iou_threshold,
+                                               int64_t output_size,
+                                               int64_t pre_nms_top_k) {
+  NmsResult result =
+      XlaHelpers::ShapeOfXlaOp(scores).rank() == 1
+          ? BuildNms(boxes, scores, score_threshold, iou_threshold,
+                     output_size, pre_nms_top_k)
+          : BuildBatchedNms(boxes, scores, score_threshold, iou_threshold,
+                            output_size, pre_nms_top_k);
+  return {result.selected_indices, result.num_valid};
+}
+
 xla::XlaOp LowerProd(xla::XlaOp input,
                      const std::vector<int64_t>& dimensions,
                      bool keep_reduced_dimensions) {
@@ -514,6 +589,13 @@ xla::Shape ShapeOfXlaOpList(absl::Span<const xla::XlaOp> ops) {
   return result;
 }
 
+// Whether a TF convolution in the given format runs over channels last
+// activations instead, see PreferChannelsLastConvolution().
+bool UseChannelsLastTfConv(tensorflow::TensorFormat data_format) {
+  return data_format == tensorflow::FORMAT_NCHW &&
+         PreferChannelsLastConvolution(GetCurrentDevice().hw_type);
+}
+
 xla::XlaOp BuildTfConv(xla::XlaOp input, xla::XlaOp filter, bool depthwise,
                        absl::Span<const int64_t> strides,
                        tensorflow::Padding padding,
@@ -527,11 +609,35 @@ xla::XlaOp BuildTfConv(xla::XlaOp input, xla::XlaOp filter, bool depthwise,
                         explicit_paddings, data_format, dilations);
   xla::PrecisionConfig precision_config =
       XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  if (UseChannelsLastTfConv(data_format)) {
+    int64_t rank = input_shape.rank();
+    xla::XlaOp conv = ConsumeValue(tensorflow::MakeXlaForwardConvOp(
+        /*type_string=*/"TfConv",
+        /*conv_input=*/xla::Transpose(input, ChannelsLastPermutation(rank)),
+        /*filter=*/filter, /*attrs=*/ToChannelsLastConvOpAttrs(attrs),
+        /*precision_config=*/&precision_config));
+    return xla::Transpose(conv, ChannelsFirstPermutation(rank));
+  }
   return ConsumeValue(tensorflow::MakeXlaForwardConvOp(
       /*type_string=*/"TfConv", /*conv_input=*/input, /*filter=*/filter,
       /*attrs=*/attrs, /*precision_config=*/&precision_config));
 }
 
+// The S8 operands get widened, which the backends fold into an integer
+// convolution accumulating at S32.
+xla::XlaOp BuildQuantizedConv(xla::XlaOp input, xla::XlaOp filter,
+                              absl::Span<const int64_t> strides,
+                              tensorflow::Padding padding,
+                              absl::Span<const int64_t> explicit_paddings,
+                              tensorflow::TensorFormat data_format,
+                              absl::Span<const int64_t> dilations) {
+  return BuildTfConv(
+      xla::ConvertElementType(input, xla::PrimitiveType::S32),
+      xla::ConvertElementType(filter, xla::PrimitiveType::S32),
+      /*depthwise=*/false, strides, padding, explicit_paddings, data_format,
+      dilations);
+}
+
 xla::XlaOp BuildTfConvBackpropFilter(
     xla::XlaOp input, absl::Span<const int64_t> filter_sizes,
     xla::XlaOp out_backprop, bool depthwise,
@@ -546,6 +652,13 @@ xla::XlaOp BuildTfConvBackpropFilter(
   xla::PrecisionConfig precision_config =
       XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
   xla::Shape input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  if (UseChannelsLastTfConv(data_format)) {
+    // The filter gradient comes out in the same format either way.
+    int64_t rank = input_shape.rank();
+    input = xla::Transpose(input, ChannelsLastPermutation(rank));
+    out_backprop = xla::Transpose(out_backprop, ChannelsLastPermutation(rank));
+    attrs = ToChannelsLastConvOpAttrs(attrs);
+  }
   return ConsumeValue(tensorflow::MakeXlaBackpropFilterConvOp(
       /*type_string=*/"TfConvBackpropFilter", /*activations=*/input,
       /*filter_shape=*/
@@ -568,6 +681,24 @@ xla::XlaOp BuildTfConvBackpropInput(
   xla::PrecisionConfig precision_config =
       XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
   xla::Shape filter_shape = XlaHelpers::ShapeOfXlaOp(filter);
+  if (UseChannelsLastTfConv(data_format)) {
+    int64_t rank = input_sizes.size();
+    std::vector<int64_t> permutation = ChannelsLastPermutation(rank);
+    std::vector<int64_t> channels_last_sizes;
+    for (int64_t dim : permutation) {
+      channels_last_sizes.push_back(input_sizes[dim]);
+    }
+    xla::XlaOp grad_input = ConsumeValue(tensorflow::MakeXlaBackpropInputConvOp(
+        /*type_string=*/"TfConvBackpropInput",
+        /*input_shape=*/
+        xla::ShapeUtil::MakeShape(filter_shape.element_type(),
+                                  channels_last_sizes),
+        /*filter=*/filter,
+        /*out_backprop=*/xla::Transpose(out_backprop, permutation),
+        /*attrs=*/ToChannelsLastConvOpAttrs(attrs),
+        /*precision_config=*/&precision_config));
+    return xla::Transpose(grad_input, ChannelsFirstPermutation(rank));
+  }
   return ConsumeValue(tensorflow::MakeXlaBackpropInputConvOp(
       /*type_string=*/"TfConvBackpropInput",
       /*input_shape=*/
@@ -631,3 +762,68 @@ xla::PaddingConfig ToXLAPaddingConfig(PaddingConfig padding_config) {
 }  // namespace
 
 #include "xla_tensor_ops_wrapper_generated.cc.inc"
+
+OpaqueXLATensor* XLATensor_tf_conv_bias_activation(
+    OpaqueXLATensor* input, OpaqueXLATensor* filter, OpaqueXLATensor* bias,
+    bool relu, bool depthwise, Int64ArrayRef strides, enum TFPadding padding,
+    Int64ArrayRef explicit_paddings, enum TFDataFormat data_format,
+    Int64ArrayRef dilations) {
+  XLA_FN_PROFILE("xla::tf_conv_bias_activation");
+  auto result_node =
+      swift_xla::ir::MakeNode<swift_xla::ir::ops::TfConvBiasActivation>(
+          input->GetIrValue(), filter->GetIrValue(), bias->GetIrValue(),
+          relu ? swift_xla::ConvActivation::kRelu
+               : swift_xla::ConvActivation::kIdentity,
+          depthwise, xla::util::ToVector<int64_t>(strides.slice()),
+          ToTFPadding(padding),
+          xla::util::ToVector<int64_t>(explicit_paddings.slice()),
+          x10::ToTFFormat(data_format),
+          xla::util::ToVector<int64_t>(dilations.slice()));
+  return new swift_xla::XLATensor(
+      input->CreateFrom(swift_xla::ir::Value(result_node, 0)));
+}
+
+OpaqueXLATensor_tuple_3 XLATensor_tf_conv_bias_activation_backward(
+    OpaqueXLATensor* grad_output, OpaqueXLATensor* input,
+    OpaqueXLATensor* filter, OpaqueXLATensor* output, bool relu,
+    bool depthwise, Int64ArrayRef strides, enum TFPadding padding,
+    Int64ArrayRef explicit_paddings, enum TFDataFormat data_format,
+    Int64ArrayRef dilations) {
+  XLA_FN_PROFILE("xla::tf_conv_bias_activation_backward");
+  auto result_node =
+      swift_xla::ir::MakeNode<swift_xla::ir::ops::TfConvBiasActivationBackward>(
+          grad_output->GetIrValue(), input->GetIrValue(),
+          filter->GetIrValue(), output->GetIrValue(),
+          relu ? swift_xla::ConvActivation::kRelu
+               : swift_xla::ConvActivation::kIdentity,
+          depthwise, xla::util::ToVector<int64_t>(strides.slice()),
+          ToTFPadding(padding),
+          xla::util::ToVector<int64_t>(explicit_paddings.slice()),
+          x10::ToTFFormat(data_format),
+          xla::util::ToVector<int64_t>(dilations.slice()));
+  OpaqueXLATensor_tuple_3 result;
+  result.v0 = new swift_xla::XLATensor(
+      input->CreateFrom(swift_xla::ir::Value(result_node, 0)));
+  result.v1 = new swift_xla::XLATensor(
+      input->CreateFrom(swift_xla::ir::Value(result_node, 1)));
+  result.v2 = new swift_xla::XLATensor(
+      input->CreateFrom(swift_xla::ir::Value(result_node, 2)));
+  return result;
+}
+
+OpaqueXLATensor* XLATensor_update_slice_at(OpaqueXLATensor* input,
+                                           OpaqueXLATensor* source,
+                                           Int64ArrayRef base_indices) {
+  const swift_xla::Device& device = input->GetDevice();
+  std::vector<swift_xla::ir::Value> start_indices;
+  start_indices.reserve(base_indices.size);
+  for (size_t i = 0; i < base_indices.size; ++i) {
+    start_indices.push_back(swift_xla::XLATensor::GetIrValueForScalar(
+        base_indices.data[i], xla::PrimitiveType::S32, device));
+  }
+  auto result_node =
+      swift_xla::ir::MakeNode<swift_xla::ir::ops::DynamicUpdateSlice>(
+          input->GetIrValue(), source->GetIrValue(), start_indices);
+  return new swift_xla::XLATensor(
+      input->CreateFrom(swift_xla::ir::Value(result_node, 0)));
+}
@@ -20,13 +20,24 @@
 
 #include "xla_tensor_wrapper.h"
 
+#include <algorithm>
+#include <chrono>
+#include <limits>
 #include <random>
 
+#include "tensorflow/compiler/xla/xla_client/caching_allocator.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+#include "tensorflow/compiler/xla/xla_client/trace_recorder.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/debug_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/device_memory_report.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/function_call_tracker.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_dump_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/layout_manager.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/token.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/recompile_diagnostics.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/strided_slice_helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
@@ -68,6 +79,59 @@ tensorflow::MirrorPadMode ToTFMirrorPadMode(TFMirrorPadMode mode) {
   }
 }
 
+swift_xla::AllReducePrecision ToAllReducePrecision(
+    XLAAllReducePrecision precision) {
+  switch (precision) {
+    case XLAAllReducePrecision_FULL: {
+      return swift_xla::AllReducePrecision::kFull;
+    }
+    case XLAAllReducePrecision_BFLOAT16: {
+      return swift_xla::AllReducePrecision::kBFloat16;
+    }
+    case XLAAllReducePrecision_HALF: {
+      return swift_xla::AllReducePrecision::kHalf;
+    }
+    default: {
+      LOG(FATAL) << "Invalid all-reduce precision: " << precision;
+    }
+  }
+}
+
+swift_xla::OptimizerStepKind ToOptimizerStepKind(XLAOptimizerStepKind kind) {
+  switch (kind) {
+    case XLAOptimizerStepKind_SGD_MOMENTUM: {
+      return swift_xla::OptimizerStepKind::kSgdMomentum;
+    }
+    case XLAOptimizerStepKind_ADAM: {
+      return swift_xla::OptimizerStepKind::kAdam;
+    }
+    case XLAOptimizerStepKind_ADAMW: {
+      return swift_xla::OptimizerStepKind::kAdamW;
+    }
+    default: {
+      LOG(FATAL) << "Invalid optimizer step kind: " << kind;
+    }
+  }
+}
+
+swift_xla::ir::ops::RandomInitDistribution ToRandomInitDistribution(
+    XLARandomInitDistribution distribution) {
+  switch (distribution) {
+    case XLARandomInitDistribution_UNIFORM: {
+      return swift_xla::ir::ops::RandomInitDistribution::kUniform;
+    }
+    case XLARandomInitDistribution_NORMAL: {
+      return swift_xla::ir::ops::RandomInitDistribution::kNormal;
+    }
+    case XLARandomInitDistribution_TRUNCATED_NORMAL: {
+      return swift_xla::ir::ops::RandomInitDistribution::kTruncatedNormal;
+    }
+    default: {
+      LOG(FATAL) << "Invalid random init distribution: " << distribution;
+    }
+  }
+}
+
 XLATensor MakeEmpty(at::ScalarType scalar_type, swift_xla::Device device) {
   at::Tensor empty(at::AnyScalarBuffer::empty(scalar_type), {});
   return XLATensor::Create(empty, device);
@@ -132,6 +196,29 @@ swift_xla::XLATensor* copyTensor(XLATensorScalarType type,
       LOG(FATAL) << "Invalid type: " << type;
   }
 }
+OpaqueXLATensor* copyTensorBorrowing(enum XLATensorScalarType type,
+                                     const void* value, size_t num_entries,
+                                     const size_t* shape, size_t rank,
+                                     const struct CDevice device,
+                                     void (*release)(void* context),
+                                     void* context) {
+  switch (type) {
+#define DEFINE_BORROW_CASE(name, aten_name, DType)                     \
+  case XLATensorScalarType_##name: {                                   \
+    auto buffer = std::make_unique<at::BorrowedAnyScalarBuffer<DType>>( \
+        reinterpret_cast<const DType*>(value), num_entries, release,   \
+        context);                                                      \
+    std::vector<int64_t> dims(shape, shape + rank);                    \
+    at::Tensor t(std::move(buffer), std::move(dims));                  \
+    return new swift_xla::XLATensor(                                   \
+        swift_xla::XLATensor::Create(t, ConvertDevice(device)));       \
+  }
+    LIST_SCALAR_TYPES(DEFINE_BORROW_CASE)
+#undef DEFINE_BORROW_CASE
+    default:
+      LOG(FATAL) << "Invalid type: " << type;
+  }
+}
 OpaqueXLATensor* copyTensorAndMakeResident(enum XLATensorScalarType type,
                                            const void* value,
                                            size_t num_entries,
@@ -154,13 +241,19 @@ OpaqueXLATensor* copyTensorAndMakeResident(enum XLATensorScalarType type,
         swift_xla::XLATensor::Create(xla_data, at::ScalarType::Float));
   }
   auto* device_ptr = xla::GetX10Device(device);
-  if (XLATensorScalarType_Float == type && device_ptr->IsLocal()) {
+  // When the device element type matches the host one, the transfer can read
+  // straight from the caller buffer, and the transfer manager takes care of
+  // the layout.
+  at::ScalarType scalar_type = ToScalarType(type);
+  xla::PrimitiveType host_type =
+      swift_xla::TensorTypeToRawXlaType(scalar_type);
+  if (device_ptr->IsLocal() &&
+      host_type == swift_xla::MakeXlaPrimitiveType(scalar_type, &device)) {
     std::vector<int64_t> dims(shape, shape + rank);
     auto dest_shape = swift_xla::MakeArrayShapeFromDimensions(
-        dims, /*dynamic_dimensions=*/{}, xla::PrimitiveType::F32,
-        device.hw_type);
+        dims, /*dynamic_dimensions=*/{}, host_type, device.hw_type);
     auto host_shape = swift_xla::MakeSwiftTensorLayout(
-        dims, /*dynamic_dimensions=*/{}, xla::PrimitiveType::F32);
+        dims, /*dynamic_dimensions=*/{}, host_type);
     xla::BorrowingLiteral literal(reinterpret_cast<const char*>(value),
                                   host_shape);
 
@@ -170,6 +263,210 @@ OpaqueXLATensor* copyTensorAndMakeResident(enum XLATensorScalarType type,
   }
   return copyTensor(type, value, num_entries, shape, rank, cdevice);
 }
+OpaqueXLATensor* loadMappedTensor(enum XLATensorScalarType type,
+                                  const char* path, size_t offset,
+                                  const size_t* shape, size_t rank,
+                                  const struct CDevice device,
+                                  bool to_reduced_precision) {
+  at::ScalarType scalar_type = ToScalarType(type);
+  std::vector<int64_t> dims(shape, shape + rank);
+  return new swift_xla::XLATensor(swift_xla::XLATensor::Create(
+      swift_xla::MappedFileToXlaData(path, offset, scalar_type, dims,
+                                     ConvertDevice(device),
+                                     to_reduced_precision),
+      scalar_type));
+}
+void copyTensorToReplicas(enum XLATensorScalarType type, const void* value,
+                          size_t num_entries, const size_t* shape, size_t rank,
+                          const struct CDevice* devices, size_t device_count,
+                          bool to_reduced_precision,
+                          OpaqueXLATensor** outputs) {
+  XLA_CHECK_GT(rank, 0) << "Cannot split a scalar across replicas";
+  XLA_CHECK_GT(device_count, 0);
+  XLA_CHECK(shape[0] % device_count == 0)
+      << "Batch size " << shape[0] << " is not divisible by the "
+      << device_count << " replicas";
+  size_t element_size = 0;
+  switch (type) {
+#define DEFINE_SIZE_CASE(name, aten_name, DType) \
+  case XLATensorScalarType_##name:               \
+    element_size = sizeof(DType);                \
+    break;
+    LIST_SCALAR_TYPES(DEFINE_SIZE_CASE)
+#undef DEFINE_SIZE_CASE
+    default:
+      LOG(FATAL) << "Invalid type: " << type;
+  }
+  std::vector<size_t> replica_shape(shape, shape + rank);
+  replica_shape[0] /= device_count;
+  size_t replica_entries = num_entries / device_count;
+  const char* data = reinterpret_cast<const char*>(value);
+  xla::util::MultiWait mwait(device_count);
+  for (size_t i = 0; i < device_count; ++i) {
+    auto copy = [&, i]() {
+      outputs[i] = copyTensorAndMakeResident(
+          type, data + i * replica_entries * element_size, replica_entries,
+          replica_shape.data(), rank, devices[i], to_reduced_precision);
+    };
+    xla::env::ScheduleIoClosure(mwait.Completer(std::move(copy)));
+  }
+  mwait.Wait();
+}
+
+namespace {
+
+// Batches above this size get their samples copied in parallel.
+constexpr size_t kParallelCollateBytes = 1 << 20;
+
+// Copies the row major sample of shape src_shape into the row major dest
+// buffer of shape dest_shape, which is at least as large in every dimension,
+// either at its start or at its end.
+void CopyPaddedSample(const char* src, const std::vector<int64_t>& src_shape,
+                      char* dest, const std::vector<int64_t>& dest_shape,
+                      bool pad_at_start, size_t element_size) {
+  size_t rank = src_shape.size();
+  if (rank == 0) {
+    memcpy(dest, src, element_size);
+    return;
+  }
+  std::vector<int64_t> dest_strides(rank, 1);
+  for (size_t d = rank - 1; d > 0; --d) {
+    dest_strides[d - 1] = dest_strides[d] * dest_shape[d];
+  }
+  int64_t base_offset = 0;
+  if (pad_at_start) {
+    for (size_t d = 0; d < rank; ++d) {
+      base_offset += (dest_shape[d] - src_shape[d]) * dest_strides[d];
+    }
+  }
+  int64_t row_size = src_shape.back();
+  int64_t num_rows = std::accumulate(src_shape.begin(), src_shape.end() - 1,
+                                     int64_t(1), std::multiplies<int64_t>());
+  if (row_size == 0) {
+    return;
+  }
+  std::vector<int64_t> index(rank - 1, 0);
+  for (int64_t row = 0; row < num_rows; ++row) {
+    int64_t offset = base_offset;
+    for (size_t d = 0; d + 1 < rank; ++d) {
+      offset += index[d] * dest_strides[d];
+    }
+    memcpy(dest + offset * element_size,
+                src + row * row_size * element_size, row_size * element_size);
+    for (size_t d = rank - 1; d > 0; --d) {
+      if (++index[d - 1] < src_shape[d - 1]) break;
+      index[d - 1] = 0;
+    }
+  }
+}
+
+// Fills the buffer of num_entries elements of the given type with value.
+// Returns false for the types whose host representation cannot be filled with
+// a converted value.
+bool FillWithScalar(char* data, size_t num_entries, at::ScalarType type,
+                    const at::Scalar& value) {
+  if (value.isIntegral() ? value.toLong() == 0 : value.toDouble() == 0) {
+    memset(data, 0, num_entries * at::internal::GetSizeof(type));
+    return true;
+  }
+  if (type == at::ScalarType::BFloat16 || type == at::ScalarType::Half) {
+    return false;
+  }
+  switch (type) {
+#define DEFINE_FILL_CASE(name, aten_name, DType)                    \
+  case at::ScalarType::aten_name: {                                 \
+    DType fill = value.isIntegral()                                 \
+                     ? static_cast<DType>(value.toLong())           \
+                     : static_cast<DType>(value.toDouble());        \
+    std::fill_n(reinterpret_cast<DType*>(data), num_entries, fill); \
+    return true;                                                    \
+  }
+    LIST_SCALAR_TYPES(DEFINE_FILL_CASE)
+#undef DEFINE_FILL_CASE
+    default:
+      LOG(FATAL) << "Invalid type: " << type;
+  }
+}
+
+}  // namespace
+
+OpaqueXLATensor* XLATensor_collate(OpaqueXLATensorArrayRef samples, bool pad,
+                                   XLAScalar pad_value, bool pad_at_start) {
+  XLA_CHECK_GT(samples.size, 0) << "Cannot collate an empty batch";
+  const swift_xla::Device& device = samples.data[0]->GetDevice();
+  std::vector<at::Tensor> host_samples;
+  host_samples.reserve(samples.size);
+  for (size_t i = 0; i < samples.size; ++i) {
+    const XLATensor& sample = *samples.data[i];
+    c10::optional<at::Tensor> data = sample.CurrentTensorData();
+    if (!data || sample.GetDevice() != device) {
+      return nullptr;
+    }
+    host_samples.push_back(std::move(*data));
+  }
+  at::ScalarType scalar_type = host_samples.front().scalar_type();
+  std::vector<int64_t> sample_shape = host_samples.front().shape();
+  bool ragged = false;
+  for (const at::Tensor& sample : host_samples) {
+    if (sample.scalar_type() != scalar_type ||
+        sample.rank() != sample_shape.size()) {
+      return nullptr;
+    }
+    for (size_t d = 0; d < sample_shape.size(); ++d) {
+      if (sample.shape()[d] != sample_shape[d]) {
+        ragged = true;
+        sample_shape[d] = std::max(sample_shape[d], sample.shape()[d]);
+      }
+    }
+  }
+  if (ragged && !pad) {
+    // Let the stacking report the mismatching shapes.
+    return nullptr;
+  }
+  size_t element_size = at::internal::GetSizeof(scalar_type);
+  size_t sample_entries =
+      std::accumulate(sample_shape.begin(), sample_shape.end(), size_t(1),
+                      std::multiplies<size_t>());
+  size_t num_entries = sample_entries * host_samples.size();
+  std::unique_ptr<char[]> batch(new char[num_entries * element_size]);
+  if (ragged && !FillWithScalar(batch.get(), num_entries, scalar_type,
+                                atScalar(pad_value))) {
+    return nullptr;
+  }
+  auto copy_sample = [&](size_t i) {
+    const at::Tensor& sample = host_samples[i];
+    char* dest = batch.get() + i * sample_entries * element_size;
+    if (ragged) {
+      CopyPaddedSample(
+          static_cast<const char*>(sample.buffer().raw_data()), sample.shape(),
+          dest, sample_shape, pad_at_start, element_size);
+    } else {
+      memcpy(dest, sample.buffer().raw_data(),
+                  sample_entries * element_size);
+    }
+  };
+  if (num_entries * element_size >= kParallelCollateBytes) {
+    xla::util::MultiWait mwait(host_samples.size());
+    for (size_t i = 0; i < host_samples.size(); ++i) {
+      xla::env::ScheduleClosure(
+          mwait.Completer([&copy_sample, i]() { copy_sample(i); }));
+    }
+    mwait.Wait();
+  } else {
+    for (size_t i = 0; i < host_samples.size(); ++i) {
+      copy_sample(i);
+    }
+  }
+  std::vector<size_t> dims;
+  dims.reserve(sample_shape.size() + 1);
+  dims.push_back(host_samples.size());
+  dims.insert(dims.end(), sample_shape.begin(), sample_shape.end());
+  XLA_COUNTER("CollatedBatches", 1);
+  return copyTensorAndMakeResident(FromScalarType(scalar_type), batch.get(),
+                                   num_entries, dims.data(), dims.size(),
+                                   ConvertDevice(device),
+                                   /*to_reduced_precision=*/false);
+}
 
 const void* MaterializedTensor_getData(OpaqueMaterializedTensor* t) {
   return t->buffer().raw_data();
@@ -183,6 +480,199 @@ OpaqueMaterializedTensor* XLATensor_materialize(OpaqueXLATensor* t) {
   return new at::Tensor(t->ToTensor(/*detached=*/false));
 }
 
+void XLATensor_materialize_into(OpaqueXLATensor* t, void* dest,
+                                size_t dest_size) {
+  t->ToBuffer(dest, dest_size);
+}
+
+void XLATensor_materialize_small(OpaqueXLATensor* t, void* dest,
+                                 size_t dest_size) {
+  t->ToSmallBuffer(dest, dest_size);
+}
+
+size_t XLATensor_max_small_read_bytes() {
+  return XLATensor::kMaxSmallReadBytes;
+}
+
+void XLATensor_materialize_many(OpaqueXLATensorArrayRef tensors,
+                                OpaqueMaterializedTensor** outputs) {
+  std::vector<XLATensor> xla_tensors = tensors.array();
+  std::vector<at::Tensor> results = XLATensor::GetTensorsPacked(&xla_tensors);
+  for (size_t i = 0; i < results.size(); ++i) {
+    outputs[i] = new at::Tensor(std::move(results[i]));
+  }
+}
+
+OpaqueMaterializedFuture* XLATensor_materialize_async(
+    OpaqueXLATensorArrayRef tensors, void (*on_ready)(void* context),
+    void* context) {
+  std::vector<XLATensor> xla_tensors = tensors.array();
+  std::function<void()> ready_fn;
+  if (on_ready != nullptr) {
+    ready_fn = [on_ready, context]() { on_ready(context); };
+  }
+  return new OpaqueMaterializedFuture(
+      XLATensor::GetTensorsAsync(&xla_tensors, std::move(ready_fn)));
+}
+
+bool XLATensor_materialized_ready(OpaqueMaterializedFuture* future) {
+  return future->wait_for(std::chrono::seconds(0)) ==
+         std::future_status::ready;
+}
+
+void XLATensor_await_materialized(OpaqueMaterializedFuture* future,
+                                  OpaqueMaterializedTensor** outputs) {
+  std::unique_ptr<OpaqueMaterializedFuture> owned_future(future);
+  std::vector<at::Tensor> results = owned_future->get();
+  for (size_t i = 0; i < results.size(); ++i) {
+    outputs[i] = new at::Tensor(std::move(results[i]));
+  }
+}
+
+void XLATensor_sync_tensors(OpaqueXLATensorArrayRef tensors) {
+  std::vector<XLATensor> xla_tensors = tensors.array();
+  XLATensor::SyncTensorsGraph(&xla_tensors, /*devices=*/{}, /*wait=*/true,
+                              /*sync_xla_data=*/true);
+}
+
+OpaqueXLAFrozenGraph* XLAFrozenGraph_create(OpaqueXLATensorArrayRef inputs,
+                                            OpaqueXLATensorArrayRef outputs) {
+  return new OpaqueXLAFrozenGraph(
+      swift_xla::FrozenGraph::Create(inputs.array(), outputs.array()));
+}
+
+OpaqueXLATensorArrayRef XLAFrozenGraph_run(OpaqueXLAFrozenGraph* graph,
+                                           OpaqueXLATensorArrayRef inputs) {
+  std::vector<XLATensor> xla_tensors = inputs.array();
+  return ConvertTensorList((*graph)->Run(&xla_tensors));
+}
+
+OpaqueXLARequestBatcher* XLARequestBatcher_create(
+    Int64ArrayRef batch_sizes, OpaqueXLAFrozenGraph** graphs,
+    int64_t max_latency_us) {
+  std::map<int64_t, std::shared_ptr<swift_xla::FrozenGraph>> graph_map;
+  for (size_t i = 0; i < batch_sizes.size; ++i) {
+    graph_map[batch_sizes.data[i]] = *graphs[i];
+  }
+  return new OpaqueXLARequestBatcher(
+      std::move(graph_map), std::chrono::microseconds(max_latency_us));
+}
+
+OpaqueXLATensorArrayRef XLARequestBatcher_run(
+    OpaqueXLARequestBatcher* batcher, OpaqueXLATensorArrayRef inputs) {
+  return ConvertTensorList(batcher->Run(inputs.array()));
+}
+
+OpaqueXLAPipeline* XLAPipeline_create(OpaqueXLAFrozenGraph** forward,
+                                      OpaqueXLAFrozenGraph** backward,
+                                      size_t num_stages, bool one_f_one_b) {
+  std::vector<swift_xla::Pipeline::Stage> stages(num_stages);
+  for (size_t i = 0; i < num_stages; ++i) {
+    stages[i].forward = *forward[i];
+    if (backward != nullptr) {
+      stages[i].backward = *backward[i];
+    }
+  }
+  return new OpaqueXLAPipeline(std::move(stages),
+                               one_f_one_b
+                                   ? swift_xla::Pipeline::Schedule::k1F1B
+                                   : swift_xla::Pipeline::Schedule::kGPipe);
+}
+
+OpaqueXLATensorArrayRef XLAPipeline_run(OpaqueXLAPipeline* pipeline,
+                                        OpaqueXLATensorArrayRef params,
+                                        const size_t* num_params,
+                                        OpaqueXLATensorArrayRef inputs,
+                                        size_t num_micro_batches) {
+  std::vector<XLATensor> flat_params = params.array();
+  std::vector<std::vector<XLATensor>> stage_params;
+  auto params_it = flat_params.begin();
+  for (size_t i = 0; i < pipeline->num_stages(); ++i) {
+    stage_params.emplace_back(params_it, params_it + num_params[i]);
+    params_it += num_params[i];
+  }
+  std::vector<XLATensor> flat_inputs = inputs.array();
+  XLA_CHECK_EQ(flat_inputs.size() % std::max<size_t>(num_micro_batches, 1), 0);
+  size_t micro_batch_size =
+      num_micro_batches > 0 ? flat_inputs.size() / num_micro_batches : 0;
+  std::vector<std::vector<XLATensor>> micro_batches;
+  for (size_t m = 0; m < num_micro_batches; ++m) {
+    auto it = flat_inputs.begin() + m * micro_batch_size;
+    micro_batches.emplace_back(it, it + micro_batch_size);
+  }
+  swift_xla::Pipeline::Result result =
+      pipeline->Run(stage_params, micro_batches);
+  std::vector<XLATensor> flat_results;
+  for (auto& outputs : result.outputs) {
+    flat_results.insert(flat_results.end(), outputs.begin(), outputs.end());
+  }
+  for (auto& stage_results : result.stage_results) {
+    for (auto& results : stage_results) {
+      flat_results.insert(flat_results.end(), results.begin(), results.end());
+    }
+  }
+  return ConvertTensorList(flat_results);
+}
+
+OpaqueXLAWeightStreamer* XLAWeightStreamer_create(
+    OpaqueXLAFrozenGraph** layers, OpaqueXLATensorArrayRef weights,
+    const size_t* num_weights, size_t num_layers) {
+  std::vector<XLATensor> flat_weights = weights.array();
+  std::vector<swift_xla::WeightStreamer::Layer> streamer_layers(num_layers);
+  size_t weight_index = 0;
+  for (size_t i = 0; i < num_layers; ++i) {
+    streamer_layers[i].graph = *layers[i];
+    for (size_t j = 0; j < num_weights[i]; ++j, ++weight_index) {
+      XLA_CHECK_LT(weight_index, flat_weights.size());
+      // Detached, so that the tensor does not keep a host copy of its own.
+      streamer_layers[i].weights.push_back(
+          flat_weights[weight_index].ToTensor(/*detached=*/true));
+    }
+  }
+  return new OpaqueXLAWeightStreamer(std::move(streamer_layers));
+}
+
+OpaqueXLATensorArrayRef XLAWeightStreamer_run(OpaqueXLAWeightStreamer* streamer,
+                                              OpaqueXLATensorArrayRef inputs) {
+  return ConvertTensorList(streamer->Run(inputs.array()));
+}
+
+void XLACheckpoint_save(const char* path, const char* const* names,
+                        OpaqueXLATensorArrayRef tensors, size_t num_shards) {
+  std::vector<std::string> tensor_names(names, names + tensors.size);
+  swift_xla::Checkpoint::Save(path, tensor_names, tensors.array(), num_shards);
+}
+
+OpaqueXLACheckpointSnapshot* XLACheckpoint_save_async(
+    const char* path, const char* const* names, OpaqueXLATensorArrayRef tensors,
+    size_t num_shards) {
+  std::vector<std::string> tensor_names(names, names + tensors.size);
+  return new OpaqueXLACheckpointSnapshot(swift_xla::Checkpoint::SaveAsync(
+      path, std::move(tensor_names), tensors.array(), num_shards));
+}
+
+bool XLACheckpointSnapshot_done(OpaqueXLACheckpointSnapshot* snapshot) {
+  return snapshot->wait_for(std::chrono::seconds(0)) ==
+         std::future_status::ready;
+}
+
+void XLACheckpointSnapshot_wait(OpaqueXLACheckpointSnapshot* snapshot) {
+  snapshot->get();
+}
+
+void destroyXLACheckpointSnapshot(OpaqueXLACheckpointSnapshot* snapshot) {
+  delete snapshot;
+}
+
+OpaqueXLATensorArrayRef XLACheckpoint_restore(const char* path,
+                                              const char* const* names,
+                                              size_t num_names,
+                                              const struct CDevice device) {
+  std::vector<std::string> tensor_names(names, names + num_names);
+  return ConvertTensorList(swift_xla::Checkpoint::Restore(
+      path, tensor_names, ConvertDevice(device)));
+}
+
 enum XLATensorScalarType MaterializedTensor_getType(
     OpaqueMaterializedTensor* t) {
   return FromScalarType(t->scalar_type());
@@ -220,6 +710,17 @@ XLATensorScalarType FromScalarType(at::ScalarType type) {
 
 void destroyTensor(swift_xla::XLATensor* t) { delete t; }
 void destroyMaterializedTensor(OpaqueMaterializedTensor* t) { delete t; }
+void destroyMaterializedFuture(OpaqueMaterializedFuture* future) {
+  delete future;
+}
+void destroyXLAFrozenGraph(OpaqueXLAFrozenGraph* graph) { delete graph; }
+void destroyXLARequestBatcher(OpaqueXLARequestBatcher* batcher) {
+  delete batcher;
+}
+void destroyXLAPipeline(OpaqueXLAPipeline* pipeline) { delete pipeline; }
+void destroyXLAWeightStreamer(OpaqueXLAWeightStreamer* streamer) {
+  delete streamer;
+}
 void destroyXLAShape(xla::util::MaybeRef<xla::Shape>* s) { delete s; }
 
 xla::util::MaybeRef<xla::Shape>* fetchTensorShape(
@@ -227,6 +728,17 @@ xla::util::MaybeRef<xla::Shape>* fetchTensorShape(
   return new xla::util::MaybeRef<xla::Shape>(tensor->shape());
 }
 
+size_t XLATensor_shape_into(swift_xla::XLATensor* tensor, int64_t* dimensions,
+                            size_t capacity) {
+  auto shape = tensor->shape();
+  size_t rank = shape.get().rank();
+  if (rank <= capacity) {
+    std::copy(shape.get().dimensions().begin(), shape.get().dimensions().end(),
+              dimensions);
+  }
+  return rank;
+}
+
 size_t XLAShape_getRank(xla::util::MaybeRef<xla::Shape>* shape) {
   return shape->get().dimensions().size();
 }
@@ -274,6 +786,27 @@ void destroyOpaqueXLATensorArrayRef(OpaqueXLATensorArrayRef tensor_list) {
   delete[] tensor_list.data;
 }
 
+void destroyTensors(OpaqueXLATensorArrayRef tensors) {
+  for (size_t i = 0; i < tensors.size; ++i) {
+    delete tensors.data[i];
+  }
+}
+
+size_t XLATensor_shapes(OpaqueXLATensorArrayRef tensors, size_t* ranks,
+                        int64_t* dimensions, size_t dimensions_capacity) {
+  size_t count = 0;
+  for (size_t i = 0; i < tensors.size; ++i) {
+    auto shape = tensors.data[i]->shape();
+    ranks[i] = shape.get().rank();
+    if (count + ranks[i] <= dimensions_capacity) {
+      std::copy(shape.get().dimensions().begin(),
+                shape.get().dimensions().end(), dimensions + count);
+    }
+    count += ranks[i];
+  }
+  return count;
+}
+
 void destroyStridedSliceSpec(StridedSliceSpec* strided_slice_spec) {
   delete[] strided_slice_spec->begin.data;
   delete[] strided_slice_spec->end.data;
@@ -297,14 +830,143 @@ OpaqueXLATensor* XLATensor_arange(XLAScalar start, XLAScalar end,
   return new XLATensor(out);
 }
 OpaqueXLATensorArrayRef XLATensor_cross_replica_sum(
-    OpaqueXLATensorArrayRef inputs, double scale) {
+    OpaqueXLATensorArrayRef inputs, double scale,
+    enum XLAAllReducePrecision precision) {
   auto token = swift_xla::ir::MakeNode<swift_xla::ir::ops::Token>();
   auto inputs_array = inputs.array();
   auto reduced_and_token = XLATensor::all_reduce(
-      inputs_array, token, swift_xla::AllReduceType::kSum, scale, {});
+      inputs_array, token, swift_xla::AllReduceType::kSum, scale, {},
+      ToAllReducePrecision(precision));
   const auto& result_tensors = reduced_and_token.first;
   return ConvertTensorList(result_tensors);
 }
+OpaqueXLATensor* XLATensor_all_finite(OpaqueXLATensorArrayRef tensors) {
+  return new XLATensor(XLATensor::all_finite(tensors.array()));
+}
+OpaqueXLATensor* XLATensor_all_gather(OpaqueXLATensor* input, int64_t dim,
+                                      int64_t shard_count) {
+  auto token = swift_xla::ir::MakeNode<swift_xla::ir::ops::Token>();
+  return new XLATensor(
+      XLATensor::all_gather(*input, token, dim, shard_count, {}).first);
+}
+OpaqueXLATensor* XLATensor_all_to_all(OpaqueXLATensor* input,
+                                      int64_t split_dimension,
+                                      int64_t concat_dimension,
+                                      int64_t split_count) {
+  auto token = swift_xla::ir::MakeNode<swift_xla::ir::ops::Token>();
+  return new XLATensor(XLATensor::all_to_all(*input, token, split_dimension,
+                                             concat_dimension, split_count, {})
+                           .first);
+}
+OpaqueXLATensor* XLATensor_reduce_scatter(OpaqueXLATensor* input,
+                                          double scale, int64_t scatter_dim,
+                                          int64_t shard_count) {
+  auto token = swift_xla::ir::MakeNode<swift_xla::ir::ops::Token>();
+  return new XLATensor(XLATensor::reduce_scatter(
+                           *input, token, swift_xla::AllReduceType::kSum,
+                           scale, scatter_dim, shard_count, {})
+                           .first);
+}
+OpaqueXLATensor_tuple_3 XLATensor_gru_cell(OpaqueXLATensor* input,
+                                           OpaqueXLATensor* hidden,
+                                           OpaqueXLATensor* kernel,
+                                           OpaqueXLATensor* recurrent_kernel,
+                                           OpaqueXLATensor* bias,
+                                           OpaqueXLATensor* recurrent_bias) {
+  auto outputs = XLATensor::gru_cell(*input, *hidden, *kernel,
+                                     *recurrent_kernel, *bias, *recurrent_bias);
+  OpaqueXLATensor_tuple_3 result;
+  result.v0 = new XLATensor(std::get<0>(outputs));
+  result.v1 = new XLATensor(std::get<1>(outputs));
+  result.v2 = new XLATensor(std::get<2>(outputs));
+  return result;
+}
+OpaqueXLATensorArrayRef XLATensor_gru_cell_backward(
+    OpaqueXLATensor* grad_hidden, OpaqueXLATensor* input,
+    OpaqueXLATensor* hidden, OpaqueXLATensor* kernel,
+    OpaqueXLATensor* recurrent_kernel, OpaqueXLATensor* gates,
+    OpaqueXLATensor* recurrent_output) {
+  return ConvertTensorList(XLATensor::gru_cell_backward(
+      *grad_hidden, *input, *hidden, *kernel, *recurrent_kernel, *gates,
+      *recurrent_output));
+}
+OpaqueXLATensor_tuple_3 XLATensor_lstm_cell(OpaqueXLATensor* input,
+                                            OpaqueXLATensor* hidden,
+                                            OpaqueXLATensor* cell,
+                                            OpaqueXLATensor* weight,
+                                            OpaqueXLATensor* bias) {
+  auto outputs = XLATensor::lstm_cell(*input, *hidden, *cell, *weight, *bias);
+  OpaqueXLATensor_tuple_3 result;
+  result.v0 = new XLATensor(std::get<0>(outputs));
+  result.v1 = new XLATensor(std::get<1>(outputs));
+  result.v2 = new XLATensor(std::get<2>(outputs));
+  return result;
+}
+OpaqueXLATensorArrayRef XLATensor_lstm_cell_backward(
+    OpaqueXLATensor* grad_cell, OpaqueXLATensor* grad_hidden,
+    OpaqueXLATensor* input, OpaqueXLATensor* hidden, OpaqueXLATensor* cell,
+    OpaqueXLATensor* weight, OpaqueXLATensor* gates,
+    OpaqueXLATensor* new_cell) {
+  return ConvertTensorList(XLATensor::lstm_cell_backward(
+      *grad_cell, *grad_hidden, *input, *hidden, *cell, *weight, *gates,
+      *new_cell));
+}
+OpaqueXLATensor_pair XLATensor_moe_routing(OpaqueXLATensor* gates, int64_t k,
+                                           int64_t capacity) {
+  auto indices_and_positions = XLATensor::moe_routing(*gates, k, capacity);
+  OpaqueXLATensor_pair result;
+  result.x = new XLATensor(indices_and_positions.first);
+  result.y = new XLATensor(indices_and_positions.second);
+  return result;
+}
+OpaqueXLATensor* XLATensor_moe_dispatch(OpaqueXLATensor* input,
+                                        OpaqueXLATensor* expert_indices,
+                                        OpaqueXLATensor* positions,
+                                        int64_t num_experts, int64_t capacity,
+                                        int64_t split_count) {
+  auto token = swift_xla::ir::MakeNode<swift_xla::ir::ops::Token>();
+  return new XLATensor(XLATensor::moe_dispatch(*input, *expert_indices,
+                                               *positions, token, num_experts,
+                                               capacity, split_count, {})
+                           .first);
+}
+OpaqueXLATensor* XLATensor_moe_combine(OpaqueXLATensor* expert_outputs,
+                                       OpaqueXLATensor* expert_indices,
+                                       OpaqueXLATensor* positions,
+                                       int64_t split_count) {
+  auto token = swift_xla::ir::MakeNode<swift_xla::ir::ops::Token>();
+  return new XLATensor(XLATensor::moe_combine(*expert_outputs,
+                                              *expert_indices, *positions,
+                                              token, split_count, {})
+                           .first);
+}
+OpaqueXLATensor_tuple_3 XLATensor_sync_batch_norm(OpaqueXLATensor* input,
+                                                  OpaqueXLATensor* weight,
+                                                  OpaqueXLATensor* bias,
+                                                  int64_t feature_index,
+                                                  double eps) {
+  auto token = swift_xla::ir::MakeNode<swift_xla::ir::ops::Token>();
+  auto outputs = XLATensor::sync_batch_norm(*input, *weight, *bias, token,
+                                            feature_index, eps, {});
+  OpaqueXLATensor_tuple_3 result;
+  result.v0 = new XLATensor(std::get<0>(outputs));
+  result.v1 = new XLATensor(std::get<1>(outputs));
+  result.v2 = new XLATensor(std::get<2>(outputs));
+  return result;
+}
+OpaqueXLATensor_tuple_3 XLATensor_sync_batch_norm_backward(
+    OpaqueXLATensor* grad, OpaqueXLATensor* input, OpaqueXLATensor* weight,
+    OpaqueXLATensor* mean, OpaqueXLATensor* variance, int64_t feature_index,
+    double eps) {
+  auto token = swift_xla::ir::MakeNode<swift_xla::ir::ops::Token>();
+  auto grads = XLATensor::sync_batch_norm_backward(
+      *grad, *input, *weight, *mean, *variance, token, feature_index, eps, {});
+  OpaqueXLATensor_tuple_3 result;
+  result.v0 = new XLATensor(std::get<0>(grads));
+  result.v1 = new XLATensor(std::get<1>(grads));
+  result.v2 = new XLATensor(std::get<2>(grads));
+  return result;
+}
 OpaqueString* XLATensor_get_annotations(OpaqueXLATensor* a) {
   std::string ir_dag_text =
       swift_xla::ir::DumpUtil::GetAnnotations({a->GetIrValue().node.get()});
@@ -320,6 +982,11 @@ OpaqueString* XLATensor_xla_ir_text(OpaqueXLATensor* a) {
       swift_xla::ir::DumpUtil::ToHlo({a->GetIrValue()}, a->GetDevice());
   return new std::string(ir_dag_text);
 }
+OpaqueString* XLATensor_memory_analysis_text(OpaqueXLATensor* a) {
+  std::string analysis_text = swift_xla::ir::DumpUtil::ToMemoryAnalysis(
+      {a->GetIrValue()}, a->GetDevice());
+  return new std::string(analysis_text);
+}
 OpaqueXLATensor* XLATensor_linspace(XLAScalar start, XLAScalar stop,
                                     int64_t num, const CDevice device,
                                     enum XLATensorScalarType type) {
@@ -328,9 +995,51 @@ OpaqueXLATensor* XLATensor_linspace(XLAScalar start, XLAScalar stop,
                           ToScalarType(type));
   return new XLATensor(out);
 }
+OpaqueXLATensorArrayRef XLATensor_optimizer_step(
+    enum XLAOptimizerStepKind kind, OpaqueXLATensorArrayRef weights,
+    OpaqueXLATensorArrayRef grads, OpaqueXLATensorArrayRef states,
+    OpaqueXLATensorArrayRef hyperparameters, bool nesterov,
+    bool apply_weight_decay, float epsilon) {
+  auto steps_and_states = XLATensor::optimizer_step(
+      ToOptimizerStepKind(kind), weights.array(), grads.array(), states.array(),
+      hyperparameters.array(), nesterov, apply_weight_decay, epsilon);
+  std::vector<XLATensor> result_tensors = std::move(steps_and_states.first);
+  result_tensors.insert(result_tensors.end(), steps_and_states.second.begin(),
+                        steps_and_states.second.end());
+  return ConvertTensorList(result_tensors);
+}
+OpaqueXLATensor_pair XLATensor_pad_to_bucket(OpaqueXLATensor* input,
+                                             int64_t dim,
+                                             XLAScalar padding_value) {
+  auto padded_and_mask =
+      XLATensor::pad_to_bucket(*input, dim, atScalar(padding_value));
+  OpaqueXLATensor_pair result;
+  result.x = new XLATensor(padded_and_mask.first);
+  result.y = new XLATensor(padded_and_mask.second);
+  return result;
+}
+OpaqueXLATensor* XLATensor_random_init(
+    Int64ArrayRef shape, enum XLARandomInitDistribution distribution,
+    double scale, int64_t seed0, int64_t seed1, const CDevice device,
+    enum XLATensorScalarType type) {
+  return new XLATensor(XLATensor::xla_random_init(
+      shape.slice(), ToRandomInitDistribution(distribution), scale, seed0,
+      seed1, ConvertDevice(device), ToScalarType(type)));
+}
+OpaqueXLATensor* XLATensor_remat(OpaqueXLATensor* a, const char* scope) {
+  return new XLATensor(XLATensor::remat(*a, std::string(scope)));
+}
+OpaqueXLATensor* XLATensor_shard(OpaqueXLATensor* input,
+                                 Int64ArrayRef tile_dimensions) {
+  return new XLATensor(XLATensor::shard(*input, tile_dimensions.slice()));
+}
 OpaqueXLATensor* XLATensor_replica_id(const struct CDevice device) {
   return new XLATensor(XLATensor::xla_replica_id(ConvertDevice(device)));
 }
+OpaqueXLATensor* XLATensor_rng_seed(const struct CDevice device) {
+  return new XLATensor(XLATensor::xla_rng_seed(ConvertDevice(device)));
+}
+bool XLATensor_use_step_rng_seeds() { return XLATensor::UseStepRngSeeds(); }
 OpaqueXLATensor* XLATensor_to(OpaqueXLATensor* a, const CDevice* device,
                               Optional_XLAScalarType dtype) {
   return new XLATensor(XLATensor::to(*a, AsOptional(device), dtype.value()));
@@ -352,9 +1061,95 @@ OpaqueXLATensor* XLATensor_rand(Int64ArrayRef size, int64_t seed) {
   at::Tensor t(std::move(elements), std::move(size_vec));
   return new XLATensor(XLATensor::Create(t, *swift_xla::GetDefaultDevice()));
 }
+namespace {
+
+// Elements per block shuffled on its own, sized to stay in the L2 cache.
+constexpr size_t kShuffleBlockSize = 1 << 16;
+
+// Derives the generator of a shuffle task from the seed, the merge level and
+// the run index, so that the result does not depend on the thread scheduling.
+std::mt19937_64 ShuffleGenerator(int64_t seed, size_t level, size_t index) {
+  std::seed_seq seq{static_cast<uint64_t>(seed), static_cast<uint64_t>(level),
+                    static_cast<uint64_t>(index)};
+  return std::mt19937_64(seq);
+}
+
+// Merges the shuffled runs [data, data + mid) and [data + mid, data + size)
+// into a uniformly shuffled run, as described in "MergeShuffle: A Very Fast,
+// Parallel Random Permutation Algorithm" (http://ceur-ws.org/Vol-2113/).
+void MergeShuffledRuns(size_t* data, size_t mid, size_t size,
+                       std::mt19937_64* gen) {
+  size_t i = 0;
+  size_t j = mid;
+  uint64_t bits = 0;
+  int num_bits = 0;
+  while (true) {
+    if (num_bits == 0) {
+      bits = (*gen)();
+      num_bits = 64;
+    }
+    bool take_right = bits & 1;
+    bits >>= 1;
+    --num_bits;
+    if (take_right) {
+      if (j == size) break;
+      std::swap(data[i], data[j]);
+      ++j;
+    } else if (i == j) {
+      break;
+    }
+    ++i;
+  }
+  // One of the runs ran out, insert the rest of the other one at uniformly
+  // chosen positions.
+  for (; i < size; ++i) {
+    std::uniform_int_distribution<size_t> dist(0, i);
+    std::swap(data[i], data[dist(*gen)]);
+  }
+}
+
+}  // namespace
+
 void SeededRandomShuffle(size_t* data, size_t size, int64_t seed) {
-  std::mt19937 gen(seed);
-  std::shuffle(data, data + size, gen);
+  if (size <= kShuffleBlockSize) {
+    std::mt19937 gen(seed);
+    std::shuffle(data, data + size, gen);
+    return;
+  }
+  // Shuffles the blocks in parallel, then merges pairs of adjacent runs, in
+  // parallel too, doubling the run length at every level.
+  size_t num_blocks = (size + kShuffleBlockSize - 1) / kShuffleBlockSize;
+  {
+    xla::util::MultiWait mwait(num_blocks);
+    for (size_t b = 0; b < num_blocks; ++b) {
+      auto shuffle = [&, b]() {
+        size_t start = b * kShuffleBlockSize;
+        size_t end = std::min(start + kShuffleBlockSize, size);
+        std::mt19937_64 gen = ShuffleGenerator(seed, 0, b);
+        std::shuffle(data + start, data + end, gen);
+      };
+      xla::env::ScheduleClosure(mwait.Completer(std::move(shuffle)));
+    }
+    mwait.Wait();
+  }
+  size_t level = 1;
+  for (size_t run = kShuffleBlockSize; run < size; run *= 2, ++level) {
+    size_t num_merges = (size + 2 * run - 1) / (2 * run);
+    xla::util::MultiWait mwait(num_merges);
+    for (size_t m = 0; m < num_merges; ++m) {
+      auto merge = [&, m, run, level]() {
+        size_t start = m * 2 * run;
+        size_t mid = std::min(start + run, size);
+        size_t end = std::min(start + 2 * run, size);
+        if (mid < end) {
+          std::mt19937_64 gen = ShuffleGenerator(seed, level, m);
+          MergeShuffledRuns(data + start, mid - start, end - start, &gen);
+        }
+      };
+      xla::env::ScheduleClosure(mwait.Completer(std::move(merge)));
+    }
+    mwait.Wait();
+  }
 }
 void SetMatMulPrecision(bool use_full_precision) {
   XlaHelpers::set_mat_mul_precision(use_full_precision
@@ -379,5 +1174,84 @@ StridedSliceSpec* ComputeIndexingBoundsAndStrides(
 void PrintMetrics() {
   LOG(INFO) << "Metrics:\n" << xla::metrics::CreateMetricReport();
 }
+int64_t GetCounterValue(const char* name) {
+  xla::metrics::CounterData* data = xla::metrics::GetCounter(name);
+  return data != nullptr ? data->Value() : 0;
+}
+double GetMetricAccumulator(const char* name, size_t* total_samples) {
+  xla::metrics::MetricData* data = xla::metrics::GetMetric(name);
+  if (data == nullptr) {
+    *total_samples = 0;
+    return 0;
+  }
+  *total_samples = data->TotalSamples();
+  return data->Accumulator();
+}
+OpaqueString* GetStepMetricsReport() {
+  std::string report;
+  for (const auto& delta : xla::metrics::GetStepMetricsHistory()) {
+    report += xla::metrics::CreateMetricsDeltaReport(delta);
+  }
+  return new std::string(std::move(report));
+}
+void RecordActivationRange(const char* name, float min_value,
+                           float max_value) {
+  xla::metrics::Metric(std::string("ActivationMin.") + name,
+                       xla::metrics::MetricFnValue)
+      .AddSample(min_value);
+  xla::metrics::Metric(std::string("ActivationMax.") + name,
+                       xla::metrics::MetricFnValue)
+      .AddSample(max_value);
+}
+bool GetActivationRange(const char* name, float* min_value,
+                        float* max_value) {
+  xla::metrics::MetricData* min_data =
+      xla::metrics::GetMetric(std::string("ActivationMin.") + name);
+  xla::metrics::MetricData* max_data =
+      xla::metrics::GetMetric(std::string("ActivationMax.") + name);
+  if (min_data == nullptr || max_data == nullptr) {
+    return false;
+  }
+  double accumulator;
+  size_t total_samples;
+  std::vector<xla::metrics::Sample> samples =
+      min_data->Samples(&accumulator, &total_samples);
+  *min_value = std::numeric_limits<float>::max();
+  for (const xla::metrics::Sample& sample : samples) {
+    *min_value = std::min<float>(*min_value, sample.value);
+  }
+  samples = max_data->Samples(&accumulator, &total_samples);
+  *max_value = std::numeric_limits<float>::lowest();
+  for (const xla::metrics::Sample& sample : samples) {
+    *max_value = std::max<float>(*max_value, sample.value);
+  }
+  return true;
+}
+void ReleaseCachedDeviceMemory() {
+  xla::CachingDeviceAllocator::ReleaseAllCachedMemory();
+}
+OpaqueString* GetDeviceMemoryReport(const struct CDevice* device) {
+  return new std::string(
+      swift_xla::GetDeviceMemoryReport(ConvertDevice(*device)).ToString());
+}
+void SetHighPriorityExecution(bool high_priority) {
+  XLATensor::SetExecutePriority(
+      high_priority ? xla::ComputationClient::ExecutePriority::kHigh
+                    : xla::ComputationClient::ExecutePriority::kNormal);
+}
+void StartTraceRecording() { xla::trace::StartRecording(); }
+OpaqueString* StopTraceRecording() {
+  return new std::string(xla::trace::StopRecording());
+}
+OpaqueString* GetGraphProfileReport() {
+  return new std::string(swift_xla::DebugUtil::GetGraphProfileReport());
+}
+OpaqueString* GetRecompileReport() {
+  return new std::string(swift_xla::RecompileDiagnostics::GetReport());
+}
+OpaqueString* GetDispatchProfileReport(size_t max_entries) {
+  return new std::string(
+      swift_xla::fn_tracker::CreateDispatchReport(max_entries));
+}
 void DeleteString(OpaqueString* str) { delete str; }
 const char* GetStringCStr(OpaqueString* str) { return str->c_str(); }
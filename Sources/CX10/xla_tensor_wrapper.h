@@ -28,10 +28,21 @@
 #endif
 
 #ifdef __cplusplus
+#include "tensorflow/compiler/tf2xla/xla_tensor/checkpoint.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/frozen_graph.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/pipeline.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/request_batcher.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/weight_streamer.h"
 #include "tensorflow/core/profiler/lib/traceme.h"
 using OpaqueMaterializedTensor = at::Tensor;
+using OpaqueMaterializedFuture = std::future<std::vector<at::Tensor>>;
+using OpaqueXLAFrozenGraph = std::shared_ptr<swift_xla::FrozenGraph>;
+using OpaqueXLARequestBatcher = swift_xla::RequestBatcher;
+using OpaqueXLAPipeline = swift_xla::Pipeline;
 using OpaqueXLATensor = swift_xla::XLATensor;
+using OpaqueXLAWeightStreamer = swift_xla::WeightStreamer;
+using OpaqueXLACheckpointSnapshot = std::shared_future<void>;
 using OpaqueXLAShape = xla::util::MaybeRef<xla::Shape>;
 using XLAAnnotationScope = tensorflow::profiler::TraceMe;
 using OpaqueString = std::string;
@@ -43,6 +54,18 @@ typedef struct OpaqueXLAShape {
 } OpaqueXLAShape;
 typedef struct OpaqueMaterializedTensor {
 } OpaqueMaterializedTensor;
+typedef struct OpaqueMaterializedFuture {
+} OpaqueMaterializedFuture;
+typedef struct OpaqueXLAFrozenGraph {
+} OpaqueXLAFrozenGraph;
+typedef struct OpaqueXLARequestBatcher {
+} OpaqueXLARequestBatcher;
+typedef struct OpaqueXLAPipeline {
+} OpaqueXLAPipeline;
+typedef struct OpaqueXLAWeightStreamer {
+} OpaqueXLAWeightStreamer;
+typedef struct OpaqueXLACheckpointSnapshot {
+} OpaqueXLACheckpointSnapshot;
 typedef struct XLAAnnotationScope {
 } XLAAnnotationScope;
 typedef struct OpaqueString {
@@ -96,6 +119,13 @@ XLA_API OpaqueXLATensor* copyTensor(enum XLATensorScalarType type,
                                     const void* value, size_t num_entries,
                                     const size_t* shape, size_t rank,
                                     const struct CDevice device);
+// Same as copyTensor, but without copying the data. The value buffer is
+// borrowed until the tensor data has been uploaded to the device (or the
+// tensor is destroyed), at which point release(context) is called.
+XLA_API OpaqueXLATensor* copyTensorBorrowing(
+    enum XLATensorScalarType type, const void* value, size_t num_entries,
+    const size_t* shape, size_t rank, const struct CDevice device,
+    void (*release)(void* context), void* context);
 // Copies tensor directly using xla's linearizer into temporary memory and then
 // schedule an async copy to device. This avoids copies at the cost of being
 // eager about doing a device copy. Except for this explicit copy, it is
@@ -107,8 +137,48 @@ XLA_API OpaqueXLATensor* copyTensorAndMakeResident(enum XLATensorScalarType type
                                                    size_t rank,
                                                    const struct CDevice device,
                                                    bool to_reduced_precision);
+// Splits the host batch along its first dimension into device_count equal
+// slices, and uploads slice i to devices[i] as copyTensorAndMakeResident does,
+// with all the transfers running concurrently. The resulting tensors are
+// stored into outputs, which must have room for device_count entries.
+XLA_API void copyTensorToReplicas(enum XLATensorScalarType type,
+                                  const void* value, size_t num_entries,
+                                  const size_t* shape, size_t rank,
+                                  const struct CDevice* devices,
+                                  size_t device_count,
+                                  bool to_reduced_precision,
+                                  OpaqueXLATensor** outputs);
+// Collates the samples, which must all hold host data on the same device,
+// into one batch along a new first dimension. The host data gets copied into
+// a single contiguous buffer, which is uploaded with one transfer, rather than
+// stacked by an IR node. When pad is set, the samples of different shapes are
+// padded with pad_value to the largest size in every dimension, at their start
+// if pad_at_start is set and at their end otherwise. Returns null when the
+// samples cannot take this path, like the samples without host data, or the
+// ragged ones when pad is not set, so that the caller stacks them instead.
+XLA_API OpaqueXLATensor* XLATensor_collate(OpaqueXLATensorArrayRef samples,
+                                           bool pad, XLAScalar pad_value,
+                                           bool pad_at_start);
+// Uploads the row major tensor stored at the given byte offset of a file,
+// which gets mapped in memory instead of read, and transferred from the
+// mapping.
+XLA_API OpaqueXLATensor* loadMappedTensor(enum XLATensorScalarType type,
+                                          const char* path, size_t offset,
+                                          const size_t* shape, size_t rank,
+                                          const struct CDevice device,
+                                          bool to_reduced_precision);
 XLA_API void destroyTensor(OpaqueXLATensor* t);
 XLA_API OpaqueMaterializedTensor* XLATensor_materialize(OpaqueXLATensor* t);
+// Writes the tensor values, in row major order, into the dest buffer of
+// dest_size bytes, without materializing an intermediate host tensor.
+XLA_API void XLATensor_materialize_into(OpaqueXLATensor* t, void* dest,
+                                        size_t dest_size);
+// Same as XLATensor_materialize_into(), for values of at most
+// XLATensor_max_small_read_bytes() bytes, like loss scalars. The concurrent
+// small reads from the same device are batched into one transfer.
+XLA_API void XLATensor_materialize_small(OpaqueXLATensor* t, void* dest,
+                                         size_t dest_size);
+XLA_API size_t XLATensor_max_small_read_bytes();
 XLA_API void destroyMaterializedTensor(OpaqueMaterializedTensor* t);
 XLA_API const void* MaterializedTensor_getData(OpaqueMaterializedTensor* t);
 XLA_API enum XLATensorScalarType MaterializedTensor_getType(
@@ -120,6 +190,10 @@ enum XLATensorScalarType XLATensor_physical_scalar_type(OpaqueXLATensor* a);
 // Shape utilities:
 
 XLA_API OpaqueXLAShape* fetchTensorShape(OpaqueXLATensor* tensor);
+// Returns the rank of the tensor, and stores its dimensions into dimensions if
+// they fit in its capacity entries, without allocating a shape.
+XLA_API size_t XLATensor_shape_into(OpaqueXLATensor* tensor,
+                                    int64_t* dimensions, size_t capacity);
 XLA_API void destroyXLAShape(OpaqueXLAShape* shape);
 XLA_API size_t XLAShape_getRank(OpaqueXLAShape* shape);
 XLA_API const int64_t* XLAShape_getDimensions(OpaqueXLAShape* shape);
@@ -151,6 +225,27 @@ enum TFMirrorPadMode {
   TFMirrorPadMode_SYMMETRIC = 2,
 };
 
+// Precision the floating point operands of a cross replica sum get sent at.
+enum XLAAllReducePrecision {
+  XLAAllReducePrecision_FULL = 0,
+  XLAAllReducePrecision_BFLOAT16 = 1,
+  XLAAllReducePrecision_HALF = 2,
+};
+
+// Distribution the initial values of a parameter get sampled from.
+enum XLARandomInitDistribution {
+  XLARandomInitDistribution_UNIFORM = 0,
+  XLARandomInitDistribution_NORMAL = 1,
+  XLARandomInitDistribution_TRUNCATED_NORMAL = 2,
+};
+
+// Update rule of a fused optimizer step.
+enum XLAOptimizerStepKind {
+  XLAOptimizerStepKind_SGD_MOMENTUM = 0,
+  XLAOptimizerStepKind_ADAM = 1,
+  XLAOptimizerStepKind_ADAMW = 2,
+};
+
 // XLA utilities:
 
 typedef struct Int64ArrayRef {
@@ -224,6 +319,115 @@ typedef struct PaddingConfig {
 XLA_API
 void destroyOpaqueXLATensorArrayRef(OpaqueXLATensorArrayRef tensor_list);
 
+// Destroys all the tensors with a single call.
+XLA_API void destroyTensors(OpaqueXLATensorArrayRef tensors);
+
+// Fetches the shapes of all the tensors with a single call. The ranks are
+// stored into ranks, which must have room for tensors.size entries, and the
+// dimensions of all the tensors, one after the other, into dimensions, which
+// has room for dimensions_capacity entries. Returns the total count of
+// dimensions, which the caller should retry with if it exceeds the capacity.
+XLA_API size_t XLATensor_shapes(OpaqueXLATensorArrayRef tensors, size_t* ranks,
+                                int64_t* dimensions,
+                                size_t dimensions_capacity);
+
+// Materializes all the tensors, which must live on the same device, with a
+// single device transfer. The tensors of the same type get packed into one
+// buffer on the device, instead of being read back one by one. The results are
+// stored into outputs, which must have room for tensors.size entries.
+XLA_API void XLATensor_materialize_many(OpaqueXLATensorArrayRef tensors,
+                                        OpaqueMaterializedTensor** outputs);
+
+// Starts materializing the tensors, which must live on the same device, and
+// returns without waiting for their computations or the device to host
+// transfers. Once the results are ready, on_ready(context) is called from a
+// background thread, unless on_ready is null.
+XLA_API OpaqueMaterializedFuture* XLATensor_materialize_async(
+    OpaqueXLATensorArrayRef tensors, void (*on_ready)(void* context),
+    void* context);
+// Returns whether XLATensor_await_materialized() would return without blocking.
+XLA_API bool XLATensor_materialized_ready(OpaqueMaterializedFuture* future);
+// Waits for the transfers started by XLATensor_materialize_async(), and stores
+// the results into outputs, which must have room for tensors.size entries. The
+// future is destroyed.
+XLA_API void XLATensor_await_materialized(OpaqueMaterializedFuture* future,
+                                          OpaqueMaterializedTensor** outputs);
+// Destroys a future which has not been waited on.
+XLA_API void destroyMaterializedFuture(OpaqueMaterializedFuture* future);
+
+// Syncs the pending graphs of the tensors, which must live on the same device,
+// and waits for their device data.
+XLA_API void XLATensor_sync_tensors(OpaqueXLATensorArrayRef tensors);
+// Compiles the graph computing the outputs from the inputs, which must be
+// device data, with the other device data it reads bound to it.
+XLA_API OpaqueXLAFrozenGraph* XLAFrozenGraph_create(
+    OpaqueXLATensorArrayRef inputs, OpaqueXLATensorArrayRef outputs);
+// Runs a frozen graph over new inputs, and returns its outputs.
+XLA_API OpaqueXLATensorArrayRef
+XLAFrozenGraph_run(OpaqueXLAFrozenGraph* graph, OpaqueXLATensorArrayRef inputs);
+XLA_API void destroyXLAFrozenGraph(OpaqueXLAFrozenGraph* graph);
+// Batches the concurrent requests to graphs[i], frozen for a leading batch
+// dimension of batch_sizes.data[i], waiting for at most max_latency_us
+// microseconds for a batch to fill up.
+XLA_API OpaqueXLARequestBatcher* XLARequestBatcher_create(
+    Int64ArrayRef batch_sizes, OpaqueXLAFrozenGraph** graphs,
+    int64_t max_latency_us);
+// Runs one request, possibly batched with the concurrent ones, and returns its
+// outputs.
+XLA_API OpaqueXLATensorArrayRef XLARequestBatcher_run(
+    OpaqueXLARequestBatcher* batcher, OpaqueXLATensorArrayRef inputs);
+XLA_API void destroyXLARequestBatcher(OpaqueXLARequestBatcher* batcher);
+// Creates a pipeline out of num_stages stages, whose forward graphs are
+// forward[i], and backward graphs backward[i] (a null backward array makes an
+// inference pipeline). The stages are scheduled with 1F1B if one_f_one_b is
+// set, and GPipe otherwise.
+XLA_API OpaqueXLAPipeline* XLAPipeline_create(OpaqueXLAFrozenGraph** forward,
+                                              OpaqueXLAFrozenGraph** backward,
+                                              size_t num_stages,
+                                              bool one_f_one_b);
+// Runs the pipeline over num_micro_batches micro-batches, whose first stage
+// inputs are laid one after the other in inputs. The parameters of the stages
+// are laid the same way in params, num_params[i] for stage i. Returns the
+// outputs of the last stage for each micro-batch, followed by the backward
+// results of each stage for each micro-batch.
+XLA_API OpaqueXLATensorArrayRef XLAPipeline_run(
+    OpaqueXLAPipeline* pipeline, OpaqueXLATensorArrayRef params,
+    const size_t* num_params, OpaqueXLATensorArrayRef inputs,
+    size_t num_micro_batches);
+XLA_API void destroyXLAPipeline(OpaqueXLAPipeline* pipeline);
+// Creates a weight streamer out of num_layers layers, whose graphs are
+// layers[i]. The weights of the layers are laid one after the other in weights,
+// num_weights[i] for layer i, and get copied to host memory.
+XLA_API OpaqueXLAWeightStreamer* XLAWeightStreamer_create(
+    OpaqueXLAFrozenGraph** layers, OpaqueXLATensorArrayRef weights,
+    const size_t* num_weights, size_t num_layers);
+// Runs the layers of the weight streamer over the inputs, and returns the
+// outputs of the last layer.
+XLA_API OpaqueXLATensorArrayRef XLAWeightStreamer_run(
+    OpaqueXLAWeightStreamer* streamer, OpaqueXLATensorArrayRef inputs);
+XLA_API void destroyXLAWeightStreamer(OpaqueXLAWeightStreamer* streamer);
+// Saves the tensors under the given names in a checkpoint folder made of
+// num_shards shard files.
+XLA_API void XLACheckpoint_save(const char* path, const char* const* names,
+                                OpaqueXLATensorArrayRef tensors,
+                                size_t num_shards);
+// Same as XLACheckpoint_save(), but returns once the device data of the tensors
+// has been captured, and saves it in the background.
+XLA_API OpaqueXLACheckpointSnapshot* XLACheckpoint_save_async(
+    const char* path, const char* const* names, OpaqueXLATensorArrayRef tensors,
+    size_t num_shards);
+// Returns whether the background save of the snapshot has completed.
+XLA_API bool XLACheckpointSnapshot_done(OpaqueXLACheckpointSnapshot* snapshot);
+// Waits for the background save of the snapshot to complete.
+XLA_API void XLACheckpointSnapshot_wait(OpaqueXLACheckpointSnapshot* snapshot);
+// Destroys the snapshot handle, without waiting for its save.
+XLA_API void destroyXLACheckpointSnapshot(
+    OpaqueXLACheckpointSnapshot* snapshot);
+// Restores the named tensors of a checkpoint onto the device.
+XLA_API OpaqueXLATensorArrayRef
+XLACheckpoint_restore(const char* path, const char* const* names,
+                      size_t num_names, const struct CDevice device);
+
 XLA_API void destroyStridedSliceSpec(StridedSliceSpec* strided_slice_spec);
 
 // Ops:
@@ -234,6 +438,17 @@ XLA_API OpaqueXLATensor* XLATensor_add(OpaqueXLATensor* a, OpaqueXLATensor* b);
 XLA_API OpaqueXLATensor* XLATensor_all(OpaqueXLATensor* input,
                                        Int64ArrayRef dimensions,
                                        bool keep_reduced_dimensions);
+// Returns a boolean scalar which is true when none of the elements of the
+// tensors is a NaN or an infinity.
+XLA_API OpaqueXLATensor* XLATensor_all_finite(OpaqueXLATensorArrayRef tensors);
+// Concatenates the input of all the replicas along dim.
+XLA_API OpaqueXLATensor* XLATensor_all_gather(OpaqueXLATensor* input,
+                                              int64_t dim,
+                                              int64_t shard_count);
+XLA_API OpaqueXLATensor* XLATensor_all_to_all(OpaqueXLATensor* input,
+                                              int64_t split_dimension,
+                                              int64_t concat_dimension,
+                                              int64_t split_count);
 XLA_API OpaqueXLATensor* XLATensor_annotate(OpaqueXLATensor* a, const char*);
 XLA_API OpaqueXLATensor* XLATensor_any(OpaqueXLATensor* input,
                                        Int64ArrayRef dimensions,
@@ -250,10 +465,25 @@ XLA_API OpaqueXLATensor* XLATensor_asin(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_asinh(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_atan(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_atanh(OpaqueXLATensor* a);
+// Crops, resizes, flips and jitters the colors of each image of a batch, as
+// drawn from its own seed.
+XLA_API OpaqueXLATensor* XLATensor_augment_images(
+    OpaqueXLATensor* images, OpaqueXLATensor* seeds, Int64ArrayRef output_size,
+    float min_area, float max_area, float min_aspect_ratio,
+    float max_aspect_ratio, bool flip, float brightness, float contrast,
+    float saturation);
 XLA_API OpaqueXLATensor_pair XLATensor_broadcast_tensors(OpaqueXLATensor* a,
                                                          OpaqueXLATensor* b);
+// Attention of the query over the first length rows of the key and value
+// caches, each query row seeing the keys up to its own position.
+XLA_API OpaqueXLATensor* XLATensor_cached_attention(
+    OpaqueXLATensor* query, OpaqueXLATensor* key_cache,
+    OpaqueXLATensor* value_cache, OpaqueXLATensor* length, float scale);
 XLA_API OpaqueXLATensor* XLATensor_cat(OpaqueXLATensorArrayRef tensors, int64_t dim);
 XLA_API OpaqueXLATensor* XLATensor_ceil(OpaqueXLATensor* a);
+XLA_API OpaqueXLATensor* XLATensor_cholesky(OpaqueXLATensor* input);
+XLA_API OpaqueXLATensor* XLATensor_cholesky_grad(OpaqueXLATensor* l,
+                                                 OpaqueXLATensor* grad);
 XLA_API OpaqueXLATensor*
 XLATensor_clamp(OpaqueXLATensor* input, OpaqueXLATensor* min,
                 OpaqueXLATensor* max);
@@ -263,11 +493,18 @@ XLATensor_constant_pad_nd(OpaqueXLATensor* input, Int64ArrayRef pad,
 XLA_API OpaqueXLATensor* XLATensor_cos(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_cosh(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensorArrayRef XLATensor_cross_replica_sum(
-    OpaqueXLATensorArrayRef inputs, double scale);
+    OpaqueXLATensorArrayRef inputs, double scale,
+    enum XLAAllReducePrecision precision);
 XLA_API OpaqueXLATensor* XLATensor_cumprod(OpaqueXLATensor* a, int64_t dim,
                                            bool exclusive, bool reverse);
 XLA_API OpaqueXLATensor* XLATensor_cumsum(OpaqueXLATensor* a, int64_t dim,
                                           bool exclusive, bool reverse);
+// Maps the S8 or S32 input back to F32, as (input - zero_point) * scale, with
+// scalar or per channel quantization parameters along axis.
+XLA_API OpaqueXLATensor* XLATensor_dequantize(OpaqueXLATensor* input,
+                                              OpaqueXLATensor* scale,
+                                              OpaqueXLATensor* zero_point,
+                                              int64_t axis);
 XLA_API OpaqueXLATensor* XLATensor_diagonal_value(OpaqueXLATensor* a,
                                                   int64_t offset, int64_t dim1,
                                                   int64_t dim2);
@@ -278,6 +515,10 @@ XLA_API OpaqueXLATensor* XLATensor_dynamic_slice(
 XLA_API OpaqueXLATensor* XLATensor_dynamic_update_slice(
     OpaqueXLATensor* base, OpaqueXLATensor* update,
     OpaqueXLATensorArrayRef inputs);
+// Adds the [N, ...] values rows into the rows of table selected by the [N]
+// indices, repeated indices accumulating.
+XLA_API OpaqueXLATensor* XLATensor_embedding_sparse_update(
+    OpaqueXLATensor* table, OpaqueXLATensor* indices, OpaqueXLATensor* values);
 XLA_API OpaqueXLATensor* XLATensor_eq(OpaqueXLATensor* a, OpaqueXLATensor* b);
 XLA_API OpaqueXLATensor* XLATensor_exp(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor*
@@ -291,13 +532,50 @@ XLA_API OpaqueXLATensor* XLATensor_gather(OpaqueXLATensor* x,
                                           int64_t start_dim);
 XLA_API OpaqueXLATensor* XLATensor_ge(OpaqueXLATensor* x, OpaqueXLATensor* y);
 XLA_API OpaqueString* XLATensor_get_annotations(OpaqueXLATensor* a);
+// Returns the new hidden state, and the gates and recurrent output projection
+// which XLATensor_gru_cell_backward takes.
+XLA_API OpaqueXLATensor_tuple_3
+XLATensor_gru_cell(OpaqueXLATensor* input, OpaqueXLATensor* hidden,
+                   OpaqueXLATensor* kernel, OpaqueXLATensor* recurrent_kernel,
+                   OpaqueXLATensor* bias, OpaqueXLATensor* recurrent_bias);
+// Returns the input, hidden, kernel, recurrent kernel, bias and recurrent bias
+// gradients of XLATensor_gru_cell.
+XLA_API OpaqueXLATensorArrayRef XLATensor_gru_cell_backward(
+    OpaqueXLATensor* grad_hidden, OpaqueXLATensor* input,
+    OpaqueXLATensor* hidden, OpaqueXLATensor* kernel,
+    OpaqueXLATensor* recurrent_kernel, OpaqueXLATensor* gates,
+    OpaqueXLATensor* recurrent_output);
 XLA_API OpaqueXLATensor* XLATensor_gt(OpaqueXLATensor* x, OpaqueXLATensor* y);
 XLA_API OpaqueString* XLATensor_ir_text(OpaqueXLATensor* a);
 XLA_API OpaqueString* XLATensor_xla_ir_text(OpaqueXLATensor* a);
+XLA_API OpaqueString* XLATensor_memory_analysis_text(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_is_finite(OpaqueXLATensor* input);
 XLA_API OpaqueXLATensor* XLATensor_is_inf(OpaqueXLATensor* input);
 XLA_API OpaqueXLATensor* XLATensor_is_nan(OpaqueXLATensor* input);
+// Returns the output, and the mean and inverse standard deviation along dim.
+XLA_API OpaqueXLATensor_tuple_3 XLATensor_layer_norm(OpaqueXLATensor* input,
+                                                     OpaqueXLATensor* weight,
+                                                     OpaqueXLATensor* bias,
+                                                     int64_t dim, float eps);
+XLA_API OpaqueXLATensor_tuple_3 XLATensor_layer_norm_backward(
+    OpaqueXLATensor* grad_output, OpaqueXLATensor* input,
+    OpaqueXLATensor* weight, OpaqueXLATensor* mean, OpaqueXLATensor* invstd,
+    int64_t dim);
 XLA_API OpaqueXLATensor* XLATensor_le(OpaqueXLATensor* x, OpaqueXLATensor* y);
+// Returns the new cell and hidden states, and the gates which
+// XLATensor_lstm_cell_backward takes.
+XLA_API OpaqueXLATensor_tuple_3
+XLATensor_lstm_cell(OpaqueXLATensor* input, OpaqueXLATensor* hidden,
+                    OpaqueXLATensor* cell, OpaqueXLATensor* weight,
+                    OpaqueXLATensor* bias);
+// Returns the input, hidden, cell, weight and bias gradients of
+// XLATensor_lstm_cell.
+XLA_API OpaqueXLATensorArrayRef XLATensor_lstm_cell_backward(
+    OpaqueXLATensor* grad_cell, OpaqueXLATensor* grad_hidden,
+    OpaqueXLATensor* input, OpaqueXLATensor* hidden, OpaqueXLATensor* cell,
+    OpaqueXLATensor* weight, OpaqueXLATensor* gates, OpaqueXLATensor* new_cell);
+// Returns the packed LU factors and the row permutation of each matrix.
+XLA_API OpaqueXLATensor_pair XLATensor_lu(OpaqueXLATensor* input);
 XLA_API OpaqueXLATensor* XLATensor_lt(OpaqueXLATensor* x, OpaqueXLATensor* y);
 XLA_API OpaqueXLATensor* XLATensor_linspace(XLAScalar start, XLAScalar stop,
                                             int64_t num,
@@ -331,11 +609,45 @@ XLA_API OpaqueXLATensor*
 XLATensor_minimum(OpaqueXLATensor* a, OpaqueXLATensor* b);
 XLA_API OpaqueXLATensor* XLATensor_mul(OpaqueXLATensor* a, OpaqueXLATensor* b);
 XLA_API OpaqueXLATensor* XLATensor_mm(OpaqueXLATensor* a, OpaqueXLATensor* b);
+// Routes the tokens of the [tokens, experts] gates to their top k experts.
+// Returns the [tokens, k] experts of the tokens and their positions within the
+// expert buffers, which are capacity for the dropped tokens.
+XLA_API OpaqueXLATensor_pair XLATensor_moe_routing(OpaqueXLATensor* gates,
+                                                   int64_t k,
+                                                   int64_t capacity);
+// Scatters the routed tokens into [num_experts, capacity, dim] buffers, and
+// sends each expert buffer to the replica which holds the expert.
+XLA_API OpaqueXLATensor* XLATensor_moe_dispatch(
+    OpaqueXLATensor* input, OpaqueXLATensor* expert_indices,
+    OpaqueXLATensor* positions, int64_t num_experts, int64_t capacity,
+    int64_t split_count);
+// Returns the expert outputs to the replicas of their tokens, as
+// [tokens, k, dim] rows.
+XLA_API OpaqueXLATensor* XLATensor_moe_combine(OpaqueXLATensor* expert_outputs,
+                                               OpaqueXLATensor* expert_indices,
+                                               OpaqueXLATensor* positions,
+                                               int64_t split_count);
 XLA_API OpaqueXLATensor* XLATensor_ne(OpaqueXLATensor* a, OpaqueXLATensor* b);
 XLA_API OpaqueXLATensor* XLATensor_neg(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_nll_loss(OpaqueXLATensor* input,
                                             OpaqueXLATensor* target,
                                             int64_t ignore_index);
+XLA_API OpaqueXLATensor_pair XLATensor_non_max_suppression(
+    OpaqueXLATensor* boxes, OpaqueXLATensor* scores,
+    OpaqueXLATensor* scoreThreshold, OpaqueXLATensor* iouThreshold,
+    int64_t outputSize, int64_t preNmsTopK);
+// Computes the steps of all the weights with a single node. The states are
+// state major, and the result holds the steps followed by the updated states.
+XLA_API OpaqueXLATensorArrayRef XLATensor_optimizer_step(
+    enum XLAOptimizerStepKind kind, OpaqueXLATensorArrayRef weights,
+    OpaqueXLATensorArrayRef grads, OpaqueXLATensorArrayRef states,
+    OpaqueXLATensorArrayRef hyperparameters, bool nesterov,
+    bool apply_weight_decay, float epsilon);
+// Pads the dim dimension of the input to the XLA_SHAPE_BUCKETS bucket its size
+// falls in. Returns the padded tensor and its validity mask.
+XLA_API OpaqueXLATensor_pair XLATensor_pad_to_bucket(OpaqueXLATensor* input,
+                                                     int64_t dim,
+                                                     XLAScalar padding_value);
 XLA_API OpaqueXLATensor*
 XLATensor_permute_value(OpaqueXLATensor* a, Int64ArrayRef arr);
 XLA_API OpaqueXLATensor* XLATensor_physical_cast(
@@ -345,15 +657,83 @@ XLA_API OpaqueXLATensor* XLATensor_pow(OpaqueXLATensor* base,
 XLA_API OpaqueXLATensor* XLATensor_prod(OpaqueXLATensor* a, Int64ArrayRef dims,
                                         bool keep_reduced_dimensions);
 XLA_API OpaqueXLATensor_pair XLATensor_qr(OpaqueXLATensor* input, bool some);
+// Quantizes the input into S8, as round(input / scale) + zero_point, with
+// scalar or per channel quantization parameters along axis.
+XLA_API OpaqueXLATensor* XLATensor_quantize(OpaqueXLATensor* input,
+                                            OpaqueXLATensor* scale,
+                                            OpaqueXLATensor* zero_point,
+                                            int64_t axis);
+// Convolves the S8 input and filter, accumulating the result at S32.
+XLA_API OpaqueXLATensor* XLATensor_quantized_conv(
+    OpaqueXLATensor* input, OpaqueXLATensor* filter, Int64ArrayRef strides,
+    enum TFPadding padding, Int64ArrayRef explicit_paddings,
+    enum TFDataFormat data_format, Int64ArrayRef dilations);
+// Multiplies the S8 matrices, accumulating the result at S32.
+XLA_API OpaqueXLATensor* XLATensor_quantized_matmul(OpaqueXLATensor* lhs,
+                                                    OpaqueXLATensor* rhs);
+// Samples a tensor of the given shape on the device, uniformly between -scale
+// and scale, or normally with scale as standard deviation, from seeds baked
+// into the graph.
+XLA_API OpaqueXLATensor* XLATensor_random_init(
+    Int64ArrayRef shape, enum XLARandomInitDistribution distribution,
+    double scale, int64_t seed0, int64_t seed1, const struct CDevice device,
+    enum XLATensorScalarType type);
+// Sums the input of all the replicas, scales the sum, and returns the replica
+// its shard of the result along scatter_dim.
+XLA_API OpaqueXLATensor* XLATensor_reduce_scatter(OpaqueXLATensor* input,
+                                                  double scale,
+                                                  int64_t scatter_dim,
+                                                  int64_t shard_count);
 XLA_API OpaqueXLATensor* XLATensor_relu(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_rem(OpaqueXLATensor* a, OpaqueXLATensor* b);
+XLA_API OpaqueXLATensor* XLATensor_remat(OpaqueXLATensor* a, const char* scope);
+// Annotates the input to be split tile_dimensions.data[i] ways along dimension
+// i, across the partitions of an SPMD computation.
+XLA_API OpaqueXLATensor* XLATensor_shard(OpaqueXLATensor* input,
+                                         Int64ArrayRef tile_dimensions);
 XLA_API OpaqueXLATensor* XLATensor_repeat(OpaqueXLATensor* input,
                                           Int64ArrayRef repeats);
 XLA_API OpaqueXLATensor* XLATensor_replica_id(const struct CDevice device);
+// Rescales the S32 accumulators into S8, as round(input * scale) + zero_point.
+XLA_API OpaqueXLATensor* XLATensor_requantize(OpaqueXLATensor* input,
+                                              OpaqueXLATensor* scale,
+                                              OpaqueXLATensor* zero_point,
+                                              int64_t axis);
 XLA_API OpaqueXLATensor*
 XLATensor_resize_value(OpaqueXLATensor* a, Int64ArrayRef arr);
+// Returns the [2] seed of the next random op of the step on the device, and
+// whether the random ops should use it, as set by XLA_STEP_RNG.
+XLA_API OpaqueXLATensor* XLATensor_rng_seed(const struct CDevice device);
+XLA_API bool XLATensor_use_step_rng_seeds();
+// Returns the output and the inverse root mean square along dim.
+XLA_API OpaqueXLATensor_pair XLATensor_rms_norm(OpaqueXLATensor* input,
+                                                OpaqueXLATensor* weight,
+                                                int64_t dim, float eps);
+XLA_API OpaqueXLATensor_pair XLATensor_rms_norm_backward(
+    OpaqueXLATensor* grad_output, OpaqueXLATensor* input,
+    OpaqueXLATensor* weight, OpaqueXLATensor* invrms, int64_t dim);
 XLA_API OpaqueXLATensor* XLATensor_round_to_even(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_rsqrt(OpaqueXLATensor* a);
+// Returns the attention output and the log-sum-exp of the scaled scores.
+XLA_API OpaqueXLATensor_pair XLATensor_scaled_dot_product_attention(
+    OpaqueXLATensor* query, OpaqueXLATensor* key, OpaqueXLATensor* value,
+    float scale);
+XLA_API OpaqueXLATensor_tuple_3 XLATensor_scaled_dot_product_attention_grad(
+    OpaqueXLATensor* grad_output, OpaqueXLATensor* query, OpaqueXLATensor* key,
+    OpaqueXLATensor* value, OpaqueXLATensor* output,
+    OpaqueXLATensor* logsumexp, float scale);
+// Like XLATensor_scaled_dot_product_attention, with the queries and keys of
+// different segment ids kept from attending to each other.
+XLA_API OpaqueXLATensor_pair XLATensor_segmented_scaled_dot_product_attention(
+    OpaqueXLATensor* query, OpaqueXLATensor* key, OpaqueXLATensor* value,
+    OpaqueXLATensor* query_segment_ids, OpaqueXLATensor* key_segment_ids,
+    float scale);
+XLA_API OpaqueXLATensor_tuple_3
+XLATensor_segmented_scaled_dot_product_attention_grad(
+    OpaqueXLATensor* grad_output, OpaqueXLATensor* query, OpaqueXLATensor* key,
+    OpaqueXLATensor* value, OpaqueXLATensor* output,
+    OpaqueXLATensor* logsumexp, OpaqueXLATensor* query_segment_ids,
+    OpaqueXLATensor* key_segment_ids, float scale);
 XLA_API OpaqueXLATensor*
 XLATensor_select(OpaqueXLATensor* a, int64_t dim, int64_t index);
 XLA_API OpaqueXLATensor* XLATensor_sigmoid(OpaqueXLATensor* a);
@@ -363,6 +743,10 @@ XLA_API OpaqueXLATensor* XLATensor_sinh(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_slice(
     OpaqueXLATensor* a, int64_t dim, int64_t start, int64_t end, int64_t step);
 XLA_API OpaqueXLATensor* XLATensor_softmax(OpaqueXLATensor* a, int64_t dim);
+XLA_API OpaqueXLATensor* XLATensor_solve(OpaqueXLATensor* matrix,
+                                         OpaqueXLATensor* rhs, bool adjoint);
+XLA_API OpaqueXLATensor_pair XLATensor_sparse_softmax_cross_entropy(
+    OpaqueXLATensor* features, OpaqueXLATensor* labels);
 XLA_API OpaqueXLATensor* XLATensor_sqrt(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_squeeze(OpaqueXLATensor* a, int64_t dim);
 XLA_API OpaqueXLATensor*
@@ -372,6 +756,17 @@ XLA_API OpaqueXLATensor* XLATensor_sum(OpaqueXLATensor* a, Int64ArrayRef dims,
                                        bool keep_reduced_dimensions);
 XLA_API OpaqueXLATensor_tuple_3 XLATensor_svd(OpaqueXLATensor* input, bool compute_uv,
                                       bool full_matrix);
+// Normalizes the input along feature_index with the batch statistics of all
+// the replicas. Returns the output, and the batch mean and variance.
+XLA_API OpaqueXLATensor_tuple_3
+XLATensor_sync_batch_norm(OpaqueXLATensor* input, OpaqueXLATensor* weight,
+                          OpaqueXLATensor* bias, int64_t feature_index,
+                          double eps);
+// Returns the input, weight and bias gradients of XLATensor_sync_batch_norm.
+XLA_API OpaqueXLATensor_tuple_3 XLATensor_sync_batch_norm_backward(
+    OpaqueXLATensor* grad, OpaqueXLATensor* input, OpaqueXLATensor* weight,
+    OpaqueXLATensor* mean, OpaqueXLATensor* variance, int64_t feature_index,
+    double eps);
 XLA_API OpaqueXLATensor* XLATensor_tan(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor* XLATensor_tanh(OpaqueXLATensor* a);
 XLA_API OpaqueXLATensor_pair XLATensor_topk(OpaqueXLATensor* a, int64_t k,
@@ -391,6 +786,21 @@ XLA_API OpaqueXLATensor* XLATensor_tf_ConvBackpropInput(
     OpaqueXLATensor* out_backprop, bool depthwise, Int64ArrayRef strides,
     enum TFPadding padding, Int64ArrayRef explicit_paddings,
     enum TFDataFormat data_format, Int64ArrayRef dilations);
+// The TF convolution plus the bias along the output features, and a ReLU when
+// relu is set, lowered as a single convolution epilogue.
+XLA_API OpaqueXLATensor* XLATensor_tf_conv_bias_activation(
+    OpaqueXLATensor* input, OpaqueXLATensor* filter, OpaqueXLATensor* bias,
+    bool relu, bool depthwise, Int64ArrayRef strides, enum TFPadding padding,
+    Int64ArrayRef explicit_paddings, enum TFDataFormat data_format,
+    Int64ArrayRef dilations);
+// Returns the input, filter and bias gradients of
+// XLATensor_tf_conv_bias_activation, given its output.
+XLA_API OpaqueXLATensor_tuple_3 XLATensor_tf_conv_bias_activation_backward(
+    OpaqueXLATensor* grad_output, OpaqueXLATensor* input,
+    OpaqueXLATensor* filter, OpaqueXLATensor* output, bool relu,
+    bool depthwise, Int64ArrayRef strides, enum TFPadding padding,
+    Int64ArrayRef explicit_paddings, enum TFDataFormat data_format,
+    Int64ArrayRef dilations);
 XLA_API OpaqueXLATensor*
 XLATensor_tf_MirrorPad(OpaqueXLATensor* input, Int64ArrayRef padding,
                        enum TFMirrorPadMode mode);
@@ -411,6 +821,9 @@ XLATensor_tf_UnsortedSegmentSum(OpaqueXLATensor* data, OpaqueXLATensor* indices,
                                 int64_t num_segments);
 XLA_API OpaqueXLATensor* XLATensor_threshold(
     OpaqueXLATensor* input, OpaqueXLATensor* output, float threshold, float value);
+XLA_API OpaqueXLATensor* XLATensor_triangular_solve(OpaqueXLATensor* matrix,
+                                                    OpaqueXLATensor* rhs,
+                                                    bool lower, bool adjoint);
 XLA_API OpaqueXLATensor* XLATensor_truncated_normal(OpaqueXLATensor* input);
 XLA_API OpaqueXLATensor*
 XLATensor_to(OpaqueXLATensor* a, const struct CDevice* device,
@@ -418,6 +831,13 @@ XLATensor_to(OpaqueXLATensor* a, const struct CDevice* device,
 XLA_API OpaqueXLATensor*
 XLATensor_update_slice(OpaqueXLATensor* input, OpaqueXLATensor* source,
                        Int64ArrayRef base_indices);
+// Same as XLATensor_update_slice, but the base indices get passed to the
+// computation as device data instead of being baked into it, so that updates
+// moving along a tensor (like the decode caches) reuse the same compilation,
+// and update the donated input buffer in place.
+XLA_API OpaqueXLATensor*
+XLATensor_update_slice_at(OpaqueXLATensor* input, OpaqueXLATensor* source,
+                          Int64ArrayRef base_indices);
 XLA_API OpaqueXLATensor* XLATensor_where(OpaqueXLATensor* condition,
                                          OpaqueXLATensor* input,
                                          OpaqueXLATensor* other);
@@ -428,10 +848,21 @@ XLA_API OpaqueXLATensor* XLATensor_xla_slice(OpaqueXLATensor* input,
                                              Int64ArrayRef begin,
                                              Int64ArrayRef end,
                                              Int64ArrayRef strides);
+// Runs the body n times. A non negative trip_count is the static value of n,
+// and the iterations get unrolled by unroll_factor.
 XLA_API OpaqueXLATensorArrayRef XLATensor_functional_while(
     OpaqueXLATensor* n, OpaqueXLATensorArrayRef initial,
     OpaqueXLATensorArrayRef placeholders, OpaqueXLATensor* indexPlaceholder,
-    OpaqueXLATensorArrayRef results);
+    OpaqueXLATensorArrayRef results, int64_t trip_count,
+    int64_t unroll_factor);
+// Scans the body over the leading dimension, of size length, of the sequences.
+// Returns the final carried values followed by the stacked outputs.
+XLA_API OpaqueXLATensorArrayRef XLATensor_functional_scan(
+    OpaqueXLATensor* n, int64_t length, OpaqueXLATensorArrayRef initial,
+    OpaqueXLATensorArrayRef sequences, OpaqueXLATensorArrayRef placeholders,
+    OpaqueXLATensorArrayRef elementPlaceholders,
+    OpaqueXLATensor* indexPlaceholder, OpaqueXLATensorArrayRef carried,
+    OpaqueXLATensorArrayRef outputs, bool reverse);
 XLA_API OpaqueXLATensor* XLATensor_makePlaceholder(OpaqueXLATensor* t, int id);
 // Retrieves the device for a given tensor.
 XLA_API struct CDevice XLATensor_device(OpaqueXLATensor* t);
@@ -449,8 +880,60 @@ XLA_API StridedSliceSpec* ComputeIndexingBoundsAndStrides(
 
 XLA_API void PrintMetrics();
 
+// Returns the value of the named counter, or zero if nothing has been counted
+// into it yet.
+XLA_API int64_t GetCounterValue(const char* name);
+// Returns the sum of the samples posted to the named metric, and stores how
+// many have been posted into total_samples. Both are zero if nothing has been
+// posted into the metric yet.
+XLA_API double GetMetricAccumulator(const char* name, size_t* total_samples);
+// Returns the report of what changed in the metrics and counters over each of
+// the last steps, from the oldest.
+XLA_API OpaqueString* GetStepMetricsReport();
+
+// Posts the range an activation spans during a calibration run into the
+// ActivationMin.<name> and ActivationMax.<name> metrics.
+XLA_API void RecordActivationRange(const char* name, float min_value,
+                                   float max_value);
+// Stores into min_value and max_value the extremes of the ranges posted under
+// the name, among the samples the metrics retain. Returns false if no range has
+// been posted under the name.
+XLA_API bool GetActivationRange(const char* name, float* min_value,
+                                float* max_value);
+
+// Returns the device memory blocks held by the caching device allocators to
+// the underlying allocators.
+XLA_API void ReleaseCachedDeviceMemory();
+
+// Returns the memory usage of the device, followed by the live tensors holding
+// device memory on it, the largest first, with where they got computed.
+XLA_API OpaqueString* GetDeviceMemoryReport(const struct CDevice* device);
+
+// Sets whether the computations executed on behalf of the calling thread get
+// admitted ahead of the normal priority ones queued on their devices.
+XLA_API void SetHighPriorityExecution(bool high_priority);
+
+// Starts recording the timeline of the lazy tensor phases, dropping the events
+// recorded so far.
+XLA_API void StartTraceRecording();
+// Stops the recording and returns the recorded timeline as Chrome trace JSON.
+XLA_API OpaqueString* StopTraceRecording();
+
+// Returns the execution profiles of the computations run by the tensors graph
+// syncs, ranked by total execution time.
+XLA_API OpaqueString* GetGraphProfileReport();
+
+// Returns the reports of the most recent compilation cache misses, each naming
+// the first node where the missed graph diverges from a cached one.
+XLA_API OpaqueString* GetRecompileReport();
+
+// Returns the entry points and op kinds which took the most host dispatch
+// time, as sampled with XLA_DISPATCH_PROFILE_SAMPLING.
+XLA_API OpaqueString* GetDispatchProfileReport(size_t max_entries);
+
 // Randomly shuffles the array defined by (data, size) by seed and then
-// returns the result.
+// returns the result. Large arrays are shuffled in parallel, in cache sized
+// blocks which are then merged, and the result only depends on the seed.
 XLA_API void SeededRandomShuffle(size_t* data, size_t size, int64_t seed);
 
 // Safe string handling helpers.
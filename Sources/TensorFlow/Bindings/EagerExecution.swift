@@ -25,14 +25,22 @@ internal struct TFE_Op: TFTensorOperation {
   @usableFromInline internal let status: CTFStatus
   @usableFromInline internal let op: CTFEOp
   @usableFromInline internal let outputCount: Int
+  /// The key of `op` in the eager op cache of the thread, which it returns to once executed.
+  @usableFromInline internal let cacheKey: String
 
   @usableFromInline
   internal init(_ name: String, _ outputCount: Int) {
-    self.status = TF_NewStatus()
-    self.op = TFE_NewOp(_ExecutionContext.global.eagerContext, name, status)
+    (self.op, self.status, self.cacheKey) = _ThreadLocalState.local.eagerOpCache.take(name)
     self.outputCount = outputCount
   }
 
+  /// Returns the executed op object to the eager op cache of the thread, for a later `TFE_Op` of
+  /// the same op to reuse.
+  @usableFromInline
+  internal func recycle() {
+    _ThreadLocalState.local.eagerOpCache.recycle(op, status, key: cacheKey)
+  }
+
   @inlinable @inline(__always)
   internal func addInput(_ input: _AnyTensorHandle) {
     TFE_OpAddInput(op, input._cTensorHandle, status)
@@ -299,8 +307,7 @@ internal struct TFE_Op: TFTensorOperation {
     checkOk(status)
     _TFCEagerExecute(op, UnsafeMutablePointer<CTensorHandle?>(buffer), &count, status)
     checkOk(status)
-    TFE_DeleteOp(op)
-    TF_DeleteStatus(status)
+    recycle()
     return buffer
   }
 
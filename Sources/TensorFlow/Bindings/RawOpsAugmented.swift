@@ -252,6 +252,27 @@ extension _Raw {
     }
   }
 
+  /// Adds the `[N, ...]` `values` rows into the rows of `table` selected by the `[N]` `indices`,
+  /// without materializing the dense sum of the rows.
+  public static func embeddingSparseUpdate<
+    T: TensorFlowNumeric,
+    Ti: TensorFlowIndex
+  >(
+    _ table: Tensor<T>,
+    indices: Tensor<Ti>,
+    values: Tensor<T>
+  ) -> Tensor<T> {
+    switch commonBackend(
+      commonBackend(table.handle.backend, indices.handle.backend), values.handle.backend)
+    {
+    case .XLA:
+      return _RawXLA.embeddingSparseUpdate(table, indices: indices, values: values)
+    case .TF_EAGER:
+      return _RawTFEager.tensorScatterAdd(
+        table, indices: _RawTFEager.reshape(indices, shape: [-1, 1]), updates: values)
+    }
+  }
+
   public static func mean<
     T: TensorFlowNumeric
   >(
@@ -538,9 +559,30 @@ extension _Raw {
   /// A simplified version of cross replica sum, with scaling.
   public static func crossReplicaSum<T: TensorFlowNumeric>(
     _ inputs: [Tensor<T>],
-    _ scale: Double
+    _ scale: Double,
+    precision: CrossReplicaSumPrecision = .full
   ) -> [Tensor<T>] {
-    _RawXLA.crossReplicaSum(inputs, scale)
+    _RawXLA.crossReplicaSum(inputs, scale, precision: precision)
+  }
+
+  /// Concatenates `input` across all the replicas along `axis`.
+  public static func allGather<T: TensorFlowNumeric>(
+    _ input: Tensor<T>,
+    axis: Int,
+    shardCount: Int
+  ) -> Tensor<T> {
+    _RawXLA.allGather(input, axis: axis, shardCount: shardCount)
+  }
+
+  /// Sums `input` across all the replicas, and returns the shard of the scaled sum along `axis`
+  /// which belongs to the current replica.
+  public static func reduceScatter<T: TensorFlowNumeric>(
+    _ input: Tensor<T>,
+    _ scale: Double,
+    axis: Int,
+    shardCount: Int
+  ) -> Tensor<T> {
+    _RawXLA.reduceScatter(input, scale, axis: axis, shardCount: shardCount)
   }
 
   /// Transfer a tensor to a different device.
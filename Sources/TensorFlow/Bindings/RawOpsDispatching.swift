@@ -5208,9 +5208,7 @@ public enum _Raw {
   ) -> Tensor<T> {
     switch input.handle.backend {
     case .XLA:
-      let output_device = input.device
-      let input = Tensor<T>(copying: input, to: .defaultTFEager)
-      return Tensor<T>(copying: _RawTFEager.cholesky(input), to: output_device)
+      return _RawXLA.cholesky(input)
     case .TF_EAGER:
       return _RawTFEager.cholesky(input)
     }
@@ -5238,10 +5236,7 @@ public enum _Raw {
   ) -> Tensor<T> {
     switch commonBackend(l.handle.backend, grad.handle.backend) {
     case .XLA:
-      let output_device = grad.device
-      let l = Tensor<T>(copying: l, to: .defaultTFEager)
-      let grad = Tensor<T>(copying: grad, to: .defaultTFEager)
-      return Tensor<T>(copying: _RawTFEager.choleskyGrad(l: l, grad: grad), to: output_device)
+      return _RawXLA.choleskyGrad(l: l, grad: grad)
     case .TF_EAGER:
       return _RawTFEager.choleskyGrad(l: l, grad: grad)
     }
@@ -18676,7 +18671,13 @@ public enum _Raw {
   >(
     _ input: Tensor<T>
   ) -> (lu: Tensor<T>, p: Tensor<OutputIdxType>) {
-    _RawTFEager.lu(input)
+    switch input.handle.backend {
+    case .XLA:
+      let (lu, p) = _RawXLA.lu(input)
+      return (lu, Tensor<OutputIdxType>(p))
+    case .TF_EAGER:
+      return _RawTFEager.lu(input)
+    }
   }
 
   /// Makes a new iterator from the given `dataset` and stores it in `iterator`.
@@ -19811,10 +19812,11 @@ public enum _Raw {
   ) -> Tensor<T> {
     switch input.handle.backend {
     case .XLA:
-      let output_device = input.device
-      let input = Tensor<T>(copying: input, to: .defaultTFEager)
-      return Tensor<T>(
-        copying: _RawTFEager.matrixInverse(input, adjoint: adjoint), to: output_device)
+      // Solving against the identity takes a single LU decomposition.
+      let identity: Tensor<T> = eye(
+        rowCount: input.shape[input.rank - 1], batchShape: input.shape.dropLast(2).dimensions,
+        on: input.device)
+      return _RawXLA.solve(matrix: input, rhs: identity, adjoint: adjoint)
     case .TF_EAGER:
       return _RawTFEager.matrixInverse(input, adjoint: adjoint)
     }
@@ -20179,12 +20181,7 @@ public enum _Raw {
   ) -> Tensor<T> {
     switch commonBackend(matrix.handle.backend, rhs.handle.backend) {
     case .XLA:
-      let output_device = rhs.device
-      let matrix = Tensor<T>(copying: matrix, to: .defaultTFEager)
-      let rhs = Tensor<T>(copying: rhs, to: .defaultTFEager)
-      return Tensor<T>(
-        copying: _RawTFEager.matrixSolve(matrix: matrix, rhs: rhs, adjoint: adjoint),
-        to: output_device)
+      return _RawXLA.solve(matrix: matrix, rhs: rhs, adjoint: adjoint)
     case .TF_EAGER:
       return _RawTFEager.matrixSolve(matrix: matrix, rhs: rhs, adjoint: adjoint)
     }
@@ -20376,6 +20373,10 @@ public enum _Raw {
   ) -> Tensor<T> {
     switch commonBackend(matrix.handle.backend, rhs.handle.backend) {
     case .XLA:
+      // The lowering needs the batch dimensions to match, which the eager kernel broadcasts.
+      if matrix.shape.dropLast(2) == rhs.shape.dropLast(2) {
+        return _RawXLA.triangularSolve(matrix: matrix, rhs: rhs, lower: lower, adjoint: adjoint)
+      }
       let output_device = rhs.device
       let matrix = Tensor<T>(copying: matrix, to: .defaultTFEager)
       let rhs = Tensor<T>(copying: rhs, to: .defaultTFEager)
@@ -22326,7 +22327,15 @@ public enum _Raw {
     scoreThreshold: Tensor<TThreshold>,
     padToMaxOutputSize: Bool = false
   ) -> (selectedIndices: Tensor<Int32>, validOutputs: Tensor<Int32>) {
-    _RawTFEager.nonMaxSuppressionV4(
+    // The unpadded output has a data dependent shape, which only the eager backend supports.
+    if padToMaxOutputSize && boxes.handle.backend == .XLA {
+      return _RawXLA.nonMaxSuppression(
+        boxes: boxes, scores: scores,
+        scoreThreshold: Tensor<T>(scoreThreshold),
+        iouThreshold: Tensor<T>(iouThreshold),
+        outputSize: Int64(maxOutputSize.scalarized()))
+    }
+    return _RawTFEager.nonMaxSuppressionV4(
       boxes: boxes, scores: scores, maxOutputSize: maxOutputSize, iouThreshold: iouThreshold,
       scoreThreshold: scoreThreshold, padToMaxOutputSize: padToMaxOutputSize)
   }
@@ -1185,10 +1185,11 @@ extension LazyTensorOperation {
     let traceInfo = LazyTensorTraceBuilder.materializationTraceInfo(targets)
     debugLog("Extracted trace:\n\(traceInfo.trace)")
 
-    let function = TFFunction(trace: traceInfo.trace)
+    let function = LazyTensorTraceCache.function(for: traceInfo)
     debugLog("Generated TFFunction:\n\(function)")
 
-    let allOutputs = function.execute(traceInfo.concreteInputs)
+    let allOutputs = function.execute(
+      traceInfo.concreteInputs, usingXLA: _RuntimeConfig.compilesLazyTensorTracesWithXLA)
 
     // Slice up the outputs to various lazy tensors
     var start = 0
@@ -52,6 +52,9 @@ struct MaterializationTraceInfo {
   let trace: LazyTensorTrace
   /// Concrete tensor values for evaluating `trace`.
   let concreteInputs: [TFETensorHandle]
+  /// The key of the function of `trace` in `LazyTensorTraceCache`, if the trace got matched
+  /// against the cache.
+  var functionKey: LazyTensorTraceCache.FunctionKey? = nil
 }
 
 /// A builder class that provides various mechanisms to extract traces for
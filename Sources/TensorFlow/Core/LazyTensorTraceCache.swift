@@ -72,37 +72,167 @@ extension LazyTensorOperation {
   }
 }
 
+extension LazyTensorOperation.Attribute {
+  /// Hashes the attribute consistently with `==`, except for the constant tensors, of which only
+  /// the data type and shape get hashed, as those are the constants which can be promoted.
+  func hashStructure(into hasher: inout Hasher) {
+    switch self {
+    case .boolValue(let v): hasher.combine(0); hasher.combine(v)
+    case .intValue(let v): hasher.combine(1); hasher.combine(v)
+    case .floatValue(let v): hasher.combine(2); hasher.combine(v)
+    case .doubleValue(let v): hasher.combine(3); hasher.combine(v)
+    case .stringValue(let v): hasher.combine(4); hasher.combine(v)
+    case .boolArray(let v): hasher.combine(5); hasher.combine(v)
+    case .intArray(let v): hasher.combine(6); hasher.combine(v)
+    case .floatArray(let v): hasher.combine(7); hasher.combine(v)
+    case .doubleArray(let v): hasher.combine(8); hasher.combine(v)
+    case .stringArray(let v): hasher.combine(9); hasher.combine(v)
+    case .constTensor(let v):
+      hasher.combine(10)
+      hasher.combine(TFE_TensorHandleDataType(v._cTensorHandle).rawValue)
+      hasher.combine(v.shape.dimensions)
+    case .tensorDataTypeValue(let v): hasher.combine(11); hasher.combine(v._cDataType.rawValue)
+    case .tensorFunctionPointer(let v): hasher.combine(12); hasher.combine(v.name)
+    case .tensorDataTypeArray(let v):
+      hasher.combine(13)
+      hasher.combine(v.map { $0._cDataType.rawValue })
+    case .optionalTensorShape(let v): hasher.combine(14); hasher.combine(v?.dimensions)
+    case .optionalTensorShapeArray(let v):
+      hasher.combine(15)
+      hasher.combine(v.map { $0?.dimensions })
+    }
+  }
+}
+
+extension LazyTensorHandle {
+  /// Hashes the handle consistently with `isEquivalent(to:)`.
+  func hashStructure(into hasher: inout Hasher) {
+    switch self.handle {
+    case let .concrete(x, _):
+      hasher.combine(0)
+      hasher.combine(x._cTensorHandle)
+    case let .symbolic(x, xi, _):
+      hasher.combine(1)
+      hasher.combine(xi)
+      hasher.combine(x.id)
+    }
+  }
+}
+
+extension LazyTensorOperation {
+  /// Hashes the operation consistently with `isEquivalent(to:)`, except for the values of the
+  /// constants, so that the traces which only differ by the constants they could promote to inputs
+  /// hash the same.
+  func hashStructure(into hasher: inout Hasher) {
+    hasher.combine(name)
+    hasher.combine(outputCount)
+    hasher.combine(deviceName)
+    hasher.combine(inputs.count)
+    for input in inputs {
+      switch input {
+      case .single(let handle):
+        hasher.combine(0)
+        handle.hashStructure(into: &hasher)
+      case .list(let handles):
+        hasher.combine(1)
+        hasher.combine(handles.count)
+        for handle in handles { handle.hashStructure(into: &hasher) }
+      }
+    }
+    // The iteration order of a dictionary is not stable across instances, so the attributes get
+    // hashed separately and mixed in an order independent way.
+    var attributesHash = 0
+    for (key, value) in attributes {
+      var attributeHasher = Hasher()
+      attributeHasher.combine(key)
+      value.hashStructure(into: &attributeHasher)
+      attributesHash = attributesHash &+ attributeHasher.finalize()
+    }
+    hasher.combine(attributes.count)
+    hasher.combine(attributesHash)
+  }
+}
+
+extension LazyTensorTrace {
+  /// A hash of the signature and the operations of the trace, which is the same for all the
+  /// traces that `LazyTensorTraceCache` could match with each other once their constants get
+  /// promoted.
+  var structuralHash: Int {
+    var hasher = Hasher()
+    hasher.combine(signature)
+    for operation in operations { operation.hashStructure(into: &hasher) }
+    return hasher.finalize()
+  }
+}
+
 // TODO(TF-693): This is not thread safe!
 struct LazyTensorTraceCache {
-  /// Cache from signature to traces that match signature.
-  static private var cache: [String: [LazyTensorTrace]] = [:]
-  static func clearCache() { cache.removeAll() }
+  /// Identifies the trace obtained by promoting the constants at `promotedConstants` of the
+  /// cached trace at `index` of the `structuralHash` bucket, which fully determines its function.
+  struct FunctionKey: Hashable {
+    let structuralHash: Int
+    let index: Int
+    let promotedConstants: [Int]
+  }
+
+  /// Cache from the structural hash of the traces to the traces with that hash. The traces sharing
+  /// a bucket are most often the same up to their constants, and get matched by the first lookup.
+  static private var cache: [Int: [LazyTensorTrace]] = [:]
+  /// The functions built for the traces matched against `cache`, which get reused by the later
+  /// traces with the same key instead of being rebuilt and registered again, and keep their
+  /// compiled executables when running with the XLA JIT.
+  static private var functions: [FunctionKey: TFFunction] = [:]
+  static func clearCache() {
+    cache.removeAll()
+    functions.removeAll()
+  }
 
   /// Returns a `MaterializationTraceInfo` with possibly some constants promoted to inputs.
   static func traceWithPromotedConstants(
     _ traceInfo: MaterializationTraceInfo
   ) -> MaterializationTraceInfo {
     let trace = traceInfo.trace
-    guard var traces = cache[trace.signature] else {
-      cache[trace.signature] = [trace]
-      return traceInfo
+    let key = trace.structuralHash
+    guard let traces = cache[key] else {
+      cache[key] = [trace]
+      var result = traceInfo
+      result.functionKey = FunctionKey(structuralHash: key, index: 0, promotedConstants: [])
+      return result
     }
-    for cachedTrace in traces {
-      if let promotedTrace = traceInfo.withPromotedConstants(cachedTrace: cachedTrace) {
+    for (index, cachedTrace) in traces.enumerated() {
+      if let promotedTrace = traceInfo.withPromotedConstants(
+        cachedTrace: cachedTrace, structuralHash: key, index: index)
+      {
         debugLog("Promoted: \(promotedTrace)\n")
         return promotedTrace
       }
     }
-    // No match found; cache and return the input `traceInfo` itself.
-    traces.append(trace)
-    return traceInfo
+    // No match found (a hash collision); cache and return the input `traceInfo` itself.
+    cache[key, default: []].append(trace)
+    var result = traceInfo
+    result.functionKey = FunctionKey(
+      structuralHash: key, index: traces.count, promotedConstants: [])
+    return result
+  }
+
+  /// Returns the function evaluating the trace of `traceInfo`, which is only built when no
+  /// function got cached for its key yet.
+  static func function(for traceInfo: MaterializationTraceInfo) -> TFFunction {
+    guard let key = traceInfo.functionKey else { return TFFunction(trace: traceInfo.trace) }
+    if let function = functions[key] { return function }
+    let function = TFFunction(trace: traceInfo.trace)
+    functions[key] = function
+    return function
   }
 }
 
 extension MaterializationTraceInfo {
-  fileprivate func withPromotedConstants(cachedTrace: LazyTensorTrace)
-    -> MaterializationTraceInfo?
-  {
+  /// Returns `self` with the constants which differ from those of `cachedTrace`, the trace at
+  /// `index` of the `structuralHash` bucket of the cache, promoted to inputs, or `nil` if the
+  /// traces differ by more than their constants.
+  fileprivate func withPromotedConstants(
+    cachedTrace: LazyTensorTrace, structuralHash: Int, index: Int
+  ) -> MaterializationTraceInfo? {
     let currentTrace = self.trace
     if currentTrace.operations.count != cachedTrace.operations.count { return nil }
     var promotableConstants: [(Int, TFETensorHandle)] = []
@@ -134,7 +264,10 @@ extension MaterializationTraceInfo {
     return MaterializationTraceInfo(
       lazyOperations: self.lazyOperations,
       trace: newTrace,
-      concreteInputs: self.concreteInputs + newConcreteInputs)
+      concreteInputs: self.concreteInputs + newConcreteInputs,
+      functionKey: LazyTensorTraceCache.FunctionKey(
+        structuralHash: structuralHash, index: index,
+        promotedConstants: promotableConstants.map { $0.0 }))
   }
 
   /// If `current` and `cached` are compatible constants, returns the constant tensors.
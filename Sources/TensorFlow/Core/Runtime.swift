@@ -78,6 +78,11 @@ public enum _RuntimeConfig {
   /// When true, use lazy evaluation.
   static public var useLazyTensor: Bool = false
 
+  /// When true, the TF functions built from the lazy tensor traces get compiled by the XLA JIT,
+  /// which fuses their kernels. The functions are cached along with the traces, so that the
+  /// repeated traces reuse the compiled executables.
+  static public var compilesLazyTensorTracesWithXLA: Bool = false
+
   /// When true, prints various debug messages on the runtime state.
   ///
   /// If the value is true when running tensor computation for the first time in the process, INFO
@@ -111,6 +116,13 @@ private func configureRuntimeFromEnvironment() {
     debugLog("Turning on lazy tensor from env.")
   }
 
+  if let value = getenv("SWIFT_TENSORFLOW_LAZY_TENSOR_XLA_JIT"),
+    String(cString: value).lowercased() == "true"
+  {
+    _RuntimeConfig.compilesLazyTensorTracesWithXLA = true
+    debugLog("Turning on XLA compilation of lazy tensor traces from env.")
+  }
+
   if let value = getenv("SWIFT_TENSORFLOW_VERBOSE_LOG_LEVEL") {
     guard var verboseLevel = Int32(String(cString: value)) else {
       fatalError("SWIFT_TENSORFLOW_VERBOSE_LOG_LEVEL must take an int value.")
@@ -505,11 +517,14 @@ func _TFCOpSetAttrTypeArray(
 /// A class to keep around thread local state:
 ///  - DeviceScopes
 ///  - LazyTensorContext
+///  - _EagerOpCache
 class _ThreadLocalState {
   var deviceScopes = DeviceScopes()
 
   var lazyTensorContext = LazyTensorContext()
 
+  var eagerOpCache = _EagerOpCache()
+
   static var useLazyTensor: Bool {
     get {
       _ThreadLocalState.local.lazyTensorEnabled ?? _RuntimeConfig.useLazyTensor
@@ -547,6 +562,51 @@ class _ThreadLocalState {
   }
 }
 
+/// Cache of the eager op objects executed on a thread, which the next `TFE_Op`s of the same op
+/// name and device reset and reuse, instead of allocating new ones. Resetting an op object clears
+/// its inputs and attributes, so that the attributes need not be part of the key.
+final class _EagerOpCache {
+  /// The maximal number of idle op objects kept per key.
+  private static let capacityPerKey = 4
+
+  private var idleOps: [String: [(op: CTFEOp, status: CTFStatus)]] = [:]
+
+  deinit {
+    for ops in idleOps.values {
+      for (op, status) in ops {
+        TFE_DeleteOp(op)
+        TF_DeleteStatus(status)
+      }
+    }
+  }
+
+  /// Returns an op object for the op `name` on the current device, along with its status and
+  /// its cache key.
+  func take(_ name: String) -> (op: CTFEOp, status: CTFStatus, key: String) {
+    let deviceName = _ExecutionContext.global.currentDeviceName
+    let key = deviceName.map { "\(name)@\($0)" } ?? name
+    if let idle = idleOps[key]?.popLast() {
+      TFE_OpReset(idle.op, name, deviceName, idle.status)
+      checkOk(idle.status)
+      return (idle.op, idle.status, key)
+    }
+    let status = TF_NewStatus()!
+    let op = TFE_NewOp(_ExecutionContext.global.eagerContext, name, status)
+    checkOk(status)
+    return (op!, status, key)
+  }
+
+  /// Takes back an executed op object, deleting it when enough of them are idle already.
+  func recycle(_ op: CTFEOp, _ status: CTFStatus, key: String) {
+    if idleOps[key, default: []].count < _EagerOpCache.capacityPerKey {
+      idleOps[key, default: []].append((op, status))
+    } else {
+      TFE_DeleteOp(op)
+      TF_DeleteStatus(status)
+    }
+  }
+}
+
 /// Stack of devices that models nested calls to withDevice/withDefaultDevice. Devices are
 /// represented by their names in TensorFlow notation. See documentation for
 /// `withDevice(named:perform:)` to learn about device names.
@@ -174,6 +174,12 @@ extension Tensor {
   @differentiable(reverse where Scalar: TensorFlowFloatingPoint)
   public var scalars: [Scalar] {
     if handle.backend == .XLA {
+      let xlaTensor = self.xlaTensor
+      if xlaTensor.shape.reduce(1, *) * MemoryLayout<Scalar>.stride
+        <= XLATensor.maxSmallReadBytes
+      {
+        return xlaTensor.fetchSmallTensorValues(Scalar.self)
+      }
       let (storage, _) = xlaTensor.fetchTensorValues(Scalar.self)
       return storage
     }
@@ -181,6 +187,60 @@ extension Tensor {
   }
 }
 
+extension Tensor {
+  /// Returns the scalars of each of the tensors. When the tensors all live on the same X10 device,
+  /// they are fetched with a single device transfer instead of one per tensor, which suits the
+  /// collection of many small tensors, like per step metrics.
+  public static func scalars(of tensors: [Tensor]) -> [[Scalar]] {
+    if let device = tensors.first?.device, device.backend == .XLA,
+      tensors.allSatisfy({ $0.device == device })
+    {
+      return XLATensor.fetchTensorValues(tensors.map { $0.xlaTensor }, Scalar.self)
+    }
+    return tensors.map { $0.scalars }
+  }
+
+  /// Starts fetching the scalars of each of the tensors, and returns a handle whose `wait()`
+  /// returns them. On X10 devices the computations and the device transfers run in the
+  /// background, so that the caller can go on tracing the next step while the results arrive.
+  /// `onReady`, if given, is called once the scalars have landed, possibly from another thread.
+  public static func pendingScalars(
+    of tensors: [Tensor], onReady: (() -> Void)? = nil
+  ) -> PendingScalars<Scalar> {
+    if let device = tensors.first?.device, device.backend == .XLA,
+      tensors.allSatisfy({ $0.device == device })
+    {
+      let pending = XLATensor.fetchTensorValuesAsync(
+        tensors.map { $0.xlaTensor }, Scalar.self, onReady: onReady)
+      return PendingScalars({ pending.wait() }, isReady: { pending.isReady })
+    }
+    let values = tensors.map { $0.scalars }
+    onReady?()
+    return PendingScalars { values }
+  }
+}
+
+/// The scalars of tensors which are being fetched from their device.
+public final class PendingScalars<Scalar: TensorFlowScalar> {
+  private let fetch: () -> [[Scalar]]
+  private let ready: () -> Bool
+
+  init(_ fetch: @escaping () -> [[Scalar]], isReady ready: @escaping () -> Bool = { true }) {
+    self.fetch = fetch
+    self.ready = ready
+  }
+
+  /// Whether `wait()` would return without blocking.
+  public var isReady: Bool {
+    return ready()
+  }
+
+  /// Blocks until the scalars have landed on the host, and returns them.
+  public func wait() -> [[Scalar]] {
+    return fetch()
+  }
+}
+
 extension Tensor where Scalar: TensorFlowFloatingPoint {
   @inlinable
   @derivative(of: scalars)
@@ -343,6 +403,28 @@ extension Tensor {
     }
   }
 
+  /// Creates a tensor on an X10 device from the contiguous scalars stored in row-major order
+  /// `offset` bytes into the file at `path`. The file gets mapped in memory and the tensor
+  /// uploaded from the mapping, so loading the weights of a model one tensor at a time never holds
+  /// more than one of them in host memory.
+  ///
+  /// - Parameters:
+  ///   - shape: The shape of the tensor.
+  ///   - path: The path of the file holding the scalars.
+  ///   - offset: The position of the first scalar in the file, in bytes.
+  ///   - toReducedPrecision: Whether the tensor gets stored with reduced precision.
+  ///   - device: The X10 device of the tensor.
+  public init(
+    shape: TensorShape, mappingFile path: String, offset: Int = 0,
+    toReducedPrecision: Bool = false, directlyOn device: Device
+  ) {
+    precondition(device.backend == .XLA, "Mapped files can only be loaded on X10 devices.")
+    self.init(
+      _xla: XLATensor.make(
+        mappingFile: path, offset: offset, shape.dimensions, as: Scalar.self,
+        toReducedPrecision: toReducedPrecision, directlyOn: device))
+  }
+
   /// Creates a tensor with the specified shape and contiguous scalars in row-major order.
   ///
   /// - Parameters:
@@ -360,6 +442,49 @@ extension Tensor {
       """)
     self.init(shape: shape, scalars: [Scalar](scalars), on: device)
   }
+
+  /// Splits a host batch along its first dimension into one tensor per device, as used to feed
+  /// data parallel replicas. On X10 devices the slices get uploaded concurrently, so the input
+  /// latency does not grow with the number of replicas.
+  ///
+  /// - Parameters:
+  ///   - shape: The shape of the whole batch.
+  ///   - scalars: The scalar contents of the whole batch, in row-major order.
+  ///   - toReducedPrecision: Whether the slices get stored with reduced precision.
+  ///   - devices: The devices of the replicas, which must all use the same backend.
+  /// - Precondition: The first dimension of the shape must be divisible by the number of devices.
+  public static func scatter(
+    shape: TensorShape, scalars: [Scalar], toReducedPrecision: Bool = false,
+    across devices: [Device]
+  ) -> [Tensor] {
+    precondition(
+      shape.contiguousSize == scalars.count,
+      """
+      The shape requires \(shape.contiguousSize) scalars but \(scalars.count) were \
+      provided.
+      """)
+    precondition(shape.rank > 0 && !devices.isEmpty && shape[0] % devices.count == 0)
+    if devices.allSatisfy({ $0.backend == .XLA }) {
+      return scalars.withUnsafeBufferPointer { scalars in
+        XLATensor.makeReplicas(
+          scalars, shape.dimensions, toReducedPrecision: toReducedPrecision,
+          directlyOn: devices
+        ).map { Tensor(_xla: $0) }
+      }
+    }
+    var replicaShape = shape
+    replicaShape[0] /= devices.count
+    let replicaCount = replicaShape.contiguousSize
+    return scalars.withUnsafeBufferPointer { scalars in
+      devices.enumerated().map { (i, device) in
+        let slice = UnsafeBufferPointer(
+          rebasing: scalars[(i * replicaCount)..<((i + 1) * replicaCount)])
+        return Tensor(
+          shape: replicaShape, scalars: slice, toReducedPrecision: toReducedPrecision,
+          directlyOn: device)
+      }
+    }
+  }
 }
 
 extension Tensor where Scalar: TensorFlowFloatingPoint {
@@ -783,3 +908,64 @@ where Scalar: TensorFlowFloatingPoint {
     (annotate(annotation), { $0 })
   }
 }
+
+extension Tensor where Scalar: TensorFlowFloatingPoint {
+  /// Returns `self`, annotated to be split `tiles[i]` ways along dimension `i` across the devices
+  /// of the replication group, so that the X10 SPMD partitioner splits the computations using it
+  /// instead of running them whole on every device. The gradient gets the same annotation.
+  ///
+  /// Note: Only X10 partitions the computation. For other backends, `self` is returned.
+  @differentiable(reverse, wrt: self)
+  public func sharded(tiles: [Int]) -> Tensor {
+    switch handle.backend {
+    case .XLA:
+      return Tensor(_xla: XLATensor.shard(xlaTensor, tiles))
+    case .TF_EAGER:
+      return self
+    }
+  }
+
+  @derivative(of: sharded, wrt: self)
+  @usableFromInline
+  func vjpSharded(tiles: [Int]) -> (value: Tensor, pullback: (Tensor) -> Tensor) {
+    (sharded(tiles: tiles), { $0.sharded(tiles: tiles) })
+  }
+
+  /// Returns `body(self)`, recomputing the intermediate values of `body` in the pullback
+  /// instead of keeping them alive from the forward pass until then.
+  ///
+  /// Note: Only X10 keeps the recomputation apart from the forward computation. For other
+  /// backends, `body` still runs again in the pullback.
+  ///
+  /// - Parameters:
+  ///   - scope: The name under which the memory saved by the recomputation is reported, in
+  ///     the `RematSavedBytes.<scope>` metric.
+  ///   - body: The computation to rematerialize.
+  @differentiable(reverse, wrt: self)
+  public func rematerialized(
+    _ scope: String, _ body: @differentiable(reverse) (Tensor) -> Tensor
+  ) -> Tensor {
+    body(self)
+  }
+
+  @derivative(of: rematerialized, wrt: self)
+  @usableFromInline
+  func vjpRematerialized(
+    _ scope: String, _ body: @differentiable(reverse) (Tensor) -> Tensor
+  ) -> (value: Tensor, pullback: (Tensor) -> Tensor) {
+    let input = self
+    return (
+      body(input),
+      { v in
+        let barrier: Tensor
+        switch input.handle.backend {
+        case .XLA:
+          barrier = Tensor(_xla: XLATensor.remat(input.xlaTensor, scope))
+        case .TF_EAGER:
+          barrier = input
+        }
+        return pullback(at: barrier, of: body)(v)
+      }
+    )
+  }
+}
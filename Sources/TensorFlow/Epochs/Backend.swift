@@ -45,3 +45,131 @@ extension Collection {
     }
   }
 }
+
+extension Collection where Element == UnsafeRawBufferPointer {
+  /// Copies the elements of `self` end to end into `destination`, in parallel
+  /// on chunks of at least `minBatchSize` elements.
+  ///
+  /// When the elements are views of a memory-mapped file, every chunk faults
+  /// in its own pages, so the file gets paged in in parallel too.
+  ///
+  /// - Requires: `destination.count` is the sum of the element counts.
+  func concurrentCopy(
+    to destination: UnsafeMutableRawBufferPointer, minBatchSize: Int = 1
+  ) {
+    precondition(minBatchSize >= 1)
+    var offsets = [0]
+    offsets.reserveCapacity(count + 1)
+    for source in self { offsets.append(offsets.last! + source.count) }
+    precondition(
+      offsets.last! == destination.count,
+      "The destination holds \(destination.count) bytes, not \(offsets.last!).")
+    if destination.isEmpty { return }
+    let n = count
+    let batchCount = Swift.max((n + minBatchSize - 1) / minBatchSize, 1)
+    DispatchQueue.concurrentPerform(iterations: batchCount) { b in
+      let startOffset = b * n / batchCount
+      let endOffset = (b + 1) * n / batchCount
+      var sourceIndex = index(startIndex, offsetBy: startOffset)
+      for i in startOffset..<endOffset {
+        let source = self[sourceIndex]
+        if let sourceAddress = source.baseAddress {
+          (destination.baseAddress! + offsets[i]).copyMemory(
+            from: sourceAddress, byteCount: source.count)
+        }
+        formIndex(after: &sourceIndex)
+      }
+    }
+  }
+}
+
+extension UnsafeMutableBufferPointer {
+  /// The number of elements shuffled as a block by `shuffle(using:)`, which is
+  /// small enough for a block to stay in cache.
+  static var shuffleBlockSize: Int { 1 << 16 }
+
+  /// Shuffles the elements of `self` using `entropy`, in parallel when there are
+  /// more than `shuffleBlockSize` of them.
+  ///
+  /// Large buffers are shuffled with MergeShuffle
+  /// (http://ceur-ws.org/Vol-2113/paper3.pdf): the blocks are shuffled in
+  /// parallel, then adjacent runs are merged pairwise, in parallel too. Every
+  /// task gets its own generator, seeded from a single value drawn from
+  /// `entropy`, so the result only depends on `entropy`, not on scheduling.
+  func parallelShuffle<Entropy: RandomNumberGenerator>(
+    using entropy: inout Entropy
+  ) {
+    let n = count
+    let blockSize = Self.shuffleBlockSize
+    if n <= blockSize {
+      var buffer = self
+      buffer.shuffle(using: &entropy)
+      return
+    }
+    let seed = entropy.next()
+    func generator(level: Int, index: Int) -> ThreefryRandomNumberGenerator {
+      ThreefryRandomNumberGenerator(
+        uint64Seed: seed ^ (UInt64(level) << 48) ^ UInt64(index))
+    }
+
+    let blockCount = (n + blockSize - 1) / blockSize
+    DispatchQueue.concurrentPerform(iterations: blockCount) { b in
+      var rng = generator(level: 0, index: b)
+      var block = UnsafeMutableBufferPointer(
+        rebasing: self[b * blockSize..<Swift.min((b + 1) * blockSize, n)])
+      block.shuffle(using: &rng)
+    }
+
+    var level = 1
+    var runLength = blockSize
+    while runLength < n {
+      let mergeCount = (n + 2 * runLength - 1) / (2 * runLength)
+      DispatchQueue.concurrentPerform(iterations: mergeCount) {
+        [runLength, level] m in
+        let start = m * 2 * runLength
+        let middle = Swift.min(start + runLength, n)
+        let end = Swift.min(start + 2 * runLength, n)
+        if middle == end { return }
+        var rng = generator(level: level, index: m)
+        UnsafeMutableBufferPointer(rebasing: self[start..<end])
+          .mergeShuffledRuns(at: middle - start, using: &rng)
+      }
+      runLength *= 2
+      level += 1
+    }
+  }
+
+  /// Merges the shuffled runs `self[..<middle]` and `self[middle...]` into a
+  /// uniformly shuffled buffer.
+  private func mergeShuffledRuns<Entropy: RandomNumberGenerator>(
+    at middle: Int, using entropy: inout Entropy
+  ) {
+    var i = 0
+    var j = middle
+    var bits: UInt64 = 0
+    var bitCount = 0
+    while true {
+      if bitCount == 0 {
+        bits = entropy.next()
+        bitCount = 64
+      }
+      let takeRight = bits & 1 == 1
+      bits >>= 1
+      bitCount -= 1
+      if takeRight {
+        if j == count { break }
+        swapAt(i, j)
+        j += 1
+      } else if i == j {
+        break
+      }
+      i += 1
+    }
+    // One of the runs ran out; insert the rest of the other one at uniformly
+    // chosen positions.
+    while i < count {
+      swapAt(i, Int.random(in: 0...i, using: &entropy))
+      i += 1
+    }
+  }
+}
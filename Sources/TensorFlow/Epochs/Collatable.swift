@@ -19,11 +19,16 @@ public protocol Collatable {
   where BatchSamples.Element == Self
 }
 
-// Tensor are collated using stacking
+// Tensor are collated using stacking, or on X10 devices, by copying the host
+// data of the samples into a single batch buffer when they still hold it.
 extension Tensor: Collatable {
   public init<BatchSamples: Collection>(collating samples: BatchSamples)
   where BatchSamples.Element == Self {
     let batchSamples = samples.indices.concurrentMap { samples[$0] }
+    if let batch = Tensor.collatingHostSamples(batchSamples, paddingWith: nil) {
+      self = batch
+      return
+    }
     self.init(stacking: batchSamples)
   }
 }
@@ -43,6 +48,11 @@ extension Collection where Element: Collatable {
     with padValue: Scalar, atStart: Bool = false
   ) -> Element
   where Element == Tensor<Scalar> {
+    if let batch = Tensor.collatingHostSamples(
+      Array(self), paddingWith: padValue, atStart: atStart)
+    {
+      return batch
+    }
     let firstShape = self.first!.shapeTensor
     let otherShapes = self.dropFirst().lazy.map(\.shapeTensor)
     let paddedShape = otherShapes.reduce(firstShape) { TensorFlow.max($0, $1) }
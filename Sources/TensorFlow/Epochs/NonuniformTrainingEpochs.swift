@@ -43,8 +43,6 @@ public final class NonuniformTrainingEpochs<
   /// A sorting predicate used to group samples of similar size.
   private let areInAscendingSizeOrder: (Samples.Element, Samples.Element) -> Bool
 
-  // TODO: Figure out how to handle non-threasafe PRNGs with a parallel shuffle
-  // algorithm.
   /// A source of entropy for shuffling samples.
   private var entropy: Entropy
 
@@ -91,9 +89,7 @@ public final class NonuniformTrainingEpochs<
     let remainder = sampleOrder.count % batchSize
 
     sampleOrder.withUnsafeMutableBufferPointer { order in
-      // TODO: use a parallel shuffle like mergeshuffle
-      // (http://ceur-ws.org/Vol-2113/paper3.pdf)
-      order.shuffle(using: &entropy)
+      order.parallelShuffle(using: &entropy)
 
       // The indices of samples used in this epoch
       var epochSampleOrder = order.dropLast(remainder)
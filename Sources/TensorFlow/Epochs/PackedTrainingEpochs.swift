@@ -0,0 +1,212 @@
+// Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// An infinite sequence of collections of batches of packed rows, suitable for
+/// training a DNN on variable length samples without padding each of them to
+/// the longest one.
+///
+/// - Parameter `Samples`: the type of collection from which samples will be
+///   drawn.
+/// - Parameter `Entropy`: a source of entropy used to randomize sample order in
+///   each epoch.  See the `init` documentation for details.
+///
+/// Each row holds as many samples as fit in `rowCapacity`, packed end to end,
+/// and the rows of a batch all have the same capacity, so every batch has the
+/// same shape, and only the tail of the rows is padding. A
+/// `PackedSequenceBatch` turns a batch into tokens and the segment ids which
+/// keep the samples of a row apart in attention and in the loss.
+///
+/// The batches in each epoch all have exactly `batchSize` rows.
+public final class PackedTrainingEpochs<
+  Samples: Collection,
+  Entropy: RandomNumberGenerator
+>: Sequence, IteratorProtocol {
+  private let samples: Samples
+
+  /// The number of rows in a batch.
+  let batchSize: Int
+
+  /// The maximal sum of the lengths of the samples in a row.
+  let rowCapacity: Int
+
+  /// The ordering of samples in the current epoch.
+  private var sampleOrder: [Samples.Index]
+
+  /// The number of consecutive shuffled samples packed together.
+  private let samplesPerPack: Int
+
+  /// The length of a sample.
+  private let length: (Samples.Element) -> Int
+
+  /// A source of entropy for shuffling samples.
+  private var entropy: Entropy
+
+  /// Creates an instance packing samples from `samples` into rows of at most
+  /// `rowCapacity` length, and the rows into batches of size `batchSize`.
+  ///
+  /// - Parameters:
+  ///   - entropy: a source of randomness used to shuffle sample ordering. It
+  ///     will be stored in `self`, so if it is only pseudorandom and has value
+  ///     semantics, the sequence of epochs is determinstic and not dependent on
+  ///     other operations.
+  ///   - samplesPerPack: the number of shuffled samples packed together, or
+  ///     `nil` to indicate that the implementation should choose a number.
+  ///     Packing more samples at once fills the rows better, but brings
+  ///     samples of similar lengths together in the same batches.
+  ///   - length: the length of a sample, which must not exceed `rowCapacity`.
+  public init(
+    samples: Samples,
+    batchSize: Int,
+    rowCapacity: Int,
+    entropy: Entropy,
+    samplesPerPack: Int? = nil,
+    length: @escaping (Samples.Element) -> Int
+  ) {
+    precondition(rowCapacity > 0, "The row capacity must be positive.")
+    self.samples = samples
+    self.batchSize = batchSize
+    self.rowCapacity = rowCapacity
+    sampleOrder = Array(samples.indices)
+    self.entropy = entropy
+    self.samplesPerPack =
+      samplesPerPack ?? Swift.max(batchSize * 64, sampleOrder.count / 100)
+    self.length = length
+  }
+
+  /// The type of each epoch, a collection of batches of rows of samples.
+  public typealias Element = Slices<[Sampling<Samples, [Samples.Index]>]>
+
+  /// Returns the next epoch in sequence.
+  public func next() -> Element? {
+    sampleOrder.withUnsafeMutableBufferPointer {
+      $0.parallelShuffle(using: &entropy)
+    }
+
+    var rows: [[Samples.Index]] = []
+    var start = 0
+    while start < sampleOrder.count {
+      let end = Swift.min(start + samplesPerPack, sampleOrder.count)
+      rows.append(contentsOf: pack(sampleOrder[start..<end]))
+      start = end
+    }
+    // The first fit decreasing packing puts the longest samples first; the
+    // rows get shuffled so that the batches mix them.
+    rows.shuffle(using: &entropy)
+    rows.removeLast(rows.count % batchSize)
+    return rows.map { samples.sampled(at: $0) }.inBatches(of: batchSize)
+  }
+
+  /// Returns `pack` packed into rows, first fit decreasing.
+  private func pack(_ pack: ArraySlice<Samples.Index>) -> [[Samples.Index]] {
+    let sorted = pack.map { ($0, length(samples[$0])) }.sorted { $0.1 > $1.1 }
+    var rows: [[Samples.Index]] = []
+    var free: [Int] = []
+    for (index, sampleLength) in sorted {
+      precondition(
+        sampleLength <= rowCapacity,
+        "A sample of length \(sampleLength) exceeds the row capacity \(rowCapacity).")
+      if let row = free.firstIndex(where: { $0 >= sampleLength }) {
+        rows[row].append(index)
+        free[row] -= sampleLength
+      } else {
+        rows.append([index])
+        free.append(rowCapacity - sampleLength)
+      }
+    }
+    return rows
+  }
+}
+
+extension PackedTrainingEpochs where Entropy == SystemRandomNumberGenerator {
+  /// Creates an instance packing samples from `samples` into rows of at most
+  /// `rowCapacity` length, and the rows into batches of size `batchSize`.
+  ///
+  /// - Parameters:
+  ///   - samplesPerPack: the number of shuffled samples packed together, or
+  ///     `nil` to indicate that the implementation should choose a number.
+  ///   - length: the length of a sample, which must not exceed `rowCapacity`.
+  public convenience init(
+    samples: Samples,
+    batchSize: Int,
+    rowCapacity: Int,
+    samplesPerPack: Int? = nil,
+    length: @escaping (Samples.Element) -> Int
+  ) {
+    self.init(
+      samples: samples,
+      batchSize: batchSize,
+      rowCapacity: rowCapacity,
+      entropy: SystemRandomNumberGenerator(),
+      samplesPerPack: samplesPerPack,
+      length: length
+    )
+  }
+}
+
+/// A batch of rows, each holding one or more sequences packed end to end.
+public struct PackedSequenceBatch<Scalar: TensorFlowScalar & Numeric> {
+  /// The `[rows, capacity]` tokens of the sequences, followed by padding.
+  public var tokens: Tensor<Scalar>
+
+  /// The `[rows, capacity]` one-based index of the sequence of each token in
+  /// its row, or zero for the padding.
+  ///
+  /// These are the `segmentIds` of `scaledDotProductAttention`, which keep the
+  /// sequences of a row from attending to each other.
+  public var segmentIds: Tensor<Int32>
+
+  /// The `[rows, capacity]` position of each token in its sequence, zero for
+  /// the padding.
+  public var positions: Tensor<Int32>
+
+  /// The `[rows, capacity]` mask of the tokens which are not padding, the
+  /// `mask` of `softmaxCrossEntropy(logits:labels:mask:)`.
+  public var mask: Tensor<Float>
+
+  /// Creates an instance holding the rank 1 sequences of `rows`, each row
+  /// padded with `padValue` up to `capacity` tokens.
+  public init<Rows: Collection>(
+    packing rows: Rows,
+    capacity: Int,
+    paddingWith padValue: Scalar = 0,
+    on device: Device = .default
+  ) where Rows.Element: Collection, Rows.Element.Element == Tensor<Scalar> {
+    let size = rows.count * capacity
+    var tokens = [Scalar](repeating: padValue, count: size)
+    var segmentIds = [Int32](repeating: 0, count: size)
+    var positions = [Int32](repeating: 0, count: size)
+    var mask = [Float](repeating: 0, count: size)
+    for (r, row) in rows.enumerated() {
+      var offset = r * capacity
+      for (s, sequence) in row.enumerated() {
+        let scalars = sequence.scalars
+        precondition(
+          offset + scalars.count <= (r + 1) * capacity,
+          "The sequences of row \(r) exceed the capacity \(capacity).")
+        for (p, scalar) in scalars.enumerated() {
+          tokens[offset + p] = scalar
+          segmentIds[offset + p] = Int32(s + 1)
+          positions[offset + p] = Int32(p)
+          mask[offset + p] = 1
+        }
+        offset += scalars.count
+      }
+    }
+    let shape: TensorShape = [rows.count, capacity]
+    self.tokens = Tensor(shape: shape, scalars: tokens, on: device)
+    self.segmentIds = Tensor(shape: shape, scalars: segmentIds, on: device)
+    self.positions = Tensor(shape: shape, scalars: positions, on: device)
+    self.mask = Tensor(shape: shape, scalars: mask, on: device)
+  }
+}
@@ -0,0 +1,136 @@
+// Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+import Foundation
+
+/// A sequence of the elements of a base sequence transformed ahead of time, on
+/// background threads.
+///
+/// The base sequence is read in order on a producer thread, which keeps at most
+/// `count` elements ahead of the consumer, and the elements get transformed on
+/// up to `workerCount` threads at once. The transformed elements come out in
+/// the order of the base sequence.
+public final class PrefetchingSequence<Element>: Sequence, IteratorProtocol {
+  /// The state shared with the background threads, which outlives `self` until
+  /// they notice the cancellation.
+  private final class State {
+    let condition = NSCondition()
+    /// The transformed elements not consumed yet, by position in the base.
+    var ready: [Int: Element] = [:]
+    /// The position of the next element to return.
+    var nextPosition = 0
+    /// The count of elements in the base, once it has been read entirely.
+    var endPosition: Int? = nil
+    var isCancelled = false
+  }
+
+  private let state = State()
+
+  /// Creates an instance returning `transform` applied to the elements of
+  /// `base`.
+  ///
+  /// - Requires: `count >= 1`, `workerCount >= 1`, and `transform` is safe to
+  ///   call from multiple threads if `workerCount > 1`.
+  public init<Base: Sequence>(
+    _ base: Base, count: Int, workerCount: Int,
+    transform: @escaping (Base.Element) -> Element
+  ) {
+    precondition(count >= 1 && workerCount >= 1)
+    let state = self.state
+    let workers = DispatchSemaphore(value: workerCount)
+    Thread.detachNewThread {
+      var position = 0
+      for element in base {
+        state.condition.lock()
+        while !state.isCancelled && position - state.nextPosition >= count {
+          state.condition.wait()
+        }
+        let isCancelled = state.isCancelled
+        state.condition.unlock()
+        if isCancelled { return }
+
+        workers.wait()
+        DispatchQueue.global().async { [position] in
+          let result = transform(element)
+          workers.signal()
+          state.condition.lock()
+          state.ready[position] = result
+          state.condition.broadcast()
+          state.condition.unlock()
+        }
+        position += 1
+      }
+      state.condition.lock()
+      state.endPosition = position
+      state.condition.broadcast()
+      state.condition.unlock()
+    }
+  }
+
+  deinit {
+    state.condition.lock()
+    state.isCancelled = true
+    state.condition.broadcast()
+    state.condition.unlock()
+  }
+
+  /// Returns the next transformed element, waiting for it if need be.
+  public func next() -> Element? {
+    state.condition.lock()
+    defer { state.condition.unlock() }
+    while state.ready[state.nextPosition] == nil
+      && state.endPosition != state.nextPosition
+    {
+      state.condition.wait()
+    }
+    guard let result = state.ready.removeValue(forKey: state.nextPosition)
+    else { return nil }
+    state.nextPosition += 1
+    state.condition.broadcast()
+    return result
+  }
+}
+
+extension Sequence {
+  /// Returns the elements of `self` transformed by `transform` on background
+  /// threads, up to `count` elements ahead of their consumption.
+  ///
+  /// - Requires: `transform` is safe to call from multiple threads if
+  ///   `workerCount > 1`.
+  public func prefetched<T>(
+    count: Int = 2, workerCount: Int = 1,
+    _ transform: @escaping (Element) -> T
+  ) -> PrefetchingSequence<T> {
+    PrefetchingSequence(
+      self, count: count, workerCount: workerCount, transform: transform)
+  }
+}
+
+extension Sequence where Element: Collection {
+  /// Returns the batches of `self` collated and copied to `device` on
+  /// background threads, up to `count` batches ahead of their consumption.
+  ///
+  /// On an XLA device the batches are also uploaded ahead of time, so that the
+  /// training step consuming them does not wait for the transfer.
+  public func prefetchedBatches<Scalar>(
+    count: Int = 2, workerCount: Int = 1, on device: Device
+  ) -> PrefetchingSequence<Tensor<Scalar>>
+  where Element.Element == Tensor<Scalar> {
+    prefetched(count: count, workerCount: workerCount) { batch in
+      let tensor = Tensor(copying: batch.collated, to: device)
+      tensor.syncOnDevice()
+      return tensor
+    }
+  }
+}
@@ -0,0 +1,214 @@
+// Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+import Foundation
+
+/// An indexed file of records, mapped into memory, whose elements are views of
+/// the record bytes.
+///
+/// The file holds, in little endian order:
+/// - the 8 bytes magic `X10RECS1`,
+/// - the record count `n`, as a `UInt64`,
+/// - the `n + 1` offsets of the records from the start of the file, as
+///   `UInt64`s, the last one being the end of the last record,
+/// - the bytes of the records, end to end.
+///
+/// Reading a record only touches its own pages, so a dataset of many small
+/// samples is served from a single file without decoding, and the views stay
+/// valid as long as `self` lives.
+public final class RecordFile {
+  /// The mapped contents of the file.
+  private let storage: NSData
+
+  /// The offsets of the records, followed by the end of the last one.
+  private let offsets: [Int]
+
+  /// The magic the files start with.
+  static let magic: [UInt8] = Array("X10RECS1".utf8)
+
+  /// The error thrown on a file which does not hold records.
+  public struct FormatError: Error, CustomStringConvertible {
+    public let description: String
+  }
+
+  /// Maps the records file at `url` into memory.
+  public init(contentsOf url: URL) throws {
+    storage = try NSData(contentsOf: url, options: .alwaysMapped)
+    let headerSize = Self.magic.count + MemoryLayout<UInt64>.size
+    guard storage.length >= headerSize,
+      Array(UnsafeRawBufferPointer(start: storage.bytes, count: Self.magic.count))
+        == Self.magic
+    else {
+      throw FormatError(description: "\(url.path) is not a records file.")
+    }
+    let count = Int(Self.loadUInt64(storage.bytes, at: Self.magic.count))
+    guard storage.length >= headerSize + (count + 1) * MemoryLayout<UInt64>.size else {
+      throw FormatError(description: "The index of \(url.path) is truncated.")
+    }
+    offsets = (0...count).map {
+      Int(Self.loadUInt64(storage.bytes, at: headerSize + $0 * MemoryLayout<UInt64>.size))
+    }
+    guard zip(offsets, offsets.dropFirst()).allSatisfy({ $0 <= $1 }),
+      offsets.last! <= storage.length
+    else {
+      throw FormatError(description: "The offsets of \(url.path) are out of order or range.")
+    }
+  }
+
+  /// Writes `records` to a records file at `url`.
+  public static func write<Records: Collection>(_ records: Records, to url: URL) throws
+  where Records.Element: DataProtocol {
+    var header = Data(magic)
+    func append(_ value: Int) {
+      withUnsafeBytes(of: UInt64(value).littleEndian) { header.append(contentsOf: $0) }
+    }
+    append(records.count)
+    var offset = magic.count + (records.count + 2) * MemoryLayout<UInt64>.size
+    append(offset)
+    for record in records {
+      offset += record.count
+      append(offset)
+    }
+    var contents = header
+    for record in records { contents.append(contentsOf: record) }
+    try contents.write(to: url)
+  }
+
+  private static func loadUInt64(_ base: UnsafeRawPointer, at offset: Int) -> UInt64 {
+    var value: UInt64 = 0
+    withUnsafeMutableBytes(of: &value) {
+      $0.copyMemory(from: UnsafeRawBufferPointer(start: base + offset, count: $0.count))
+    }
+    return UInt64(littleEndian: value)
+  }
+}
+
+extension RecordFile: RandomAccessCollection {
+  public typealias Index = Int
+  public typealias Element = UnsafeRawBufferPointer
+
+  /// The position of the first record.
+  public var startIndex: Int { 0 }
+
+  /// The position one past the last record.
+  public var endIndex: Int { offsets.count - 1 }
+
+  /// Returns a view of the bytes of the record at `i`, valid as long as `self`
+  /// lives.
+  public subscript(i: Int) -> UnsafeRawBufferPointer {
+    UnsafeRawBufferPointer(
+      start: storage.bytes + offsets[i], count: offsets[i + 1] - offsets[i])
+  }
+}
+
+/// A sample of fixed shape, read in place from a `RecordFile`.
+public struct MappedSample<Scalar: TensorFlowScalar> {
+  /// The file holding the sample, which keeps `bytes` valid.
+  let file: RecordFile
+
+  /// The scalars of the sample, in row-major order.
+  public let bytes: UnsafeRawBufferPointer
+
+  /// The shape of the sample.
+  public let shape: TensorShape
+
+  /// The sample as a tensor on `device`.
+  public func tensor(on device: Device = .default) -> Tensor<Scalar> {
+    CollectionOfOne(self).collated(on: device).squeezingShape(at: 0)
+  }
+}
+
+/// The samples of a `RecordFile` whose records all hold the scalars of a
+/// sample of a given shape.
+///
+/// The samples are views of the mapped file, and get copied only once, in
+/// parallel, straight into the buffer of the batch they are collated in. Used
+/// as the samples of `TrainingEpochs`, the batches are collated with
+/// `collated()` or `collated(on:)`.
+public struct MappedSamples<Scalar: TensorFlowScalar>: RandomAccessCollection {
+  /// The file holding the samples.
+  public let file: RecordFile
+
+  /// The shape of every sample.
+  public let sampleShape: TensorShape
+
+  /// Creates the samples of shape `sampleShape` held in `file`.
+  ///
+  /// - Precondition: every record of `file` holds the scalars of a sample.
+  public init(file: RecordFile, sampleShape: TensorShape) {
+    let byteCount = sampleShape.contiguousSize * MemoryLayout<Scalar>.stride
+    precondition(
+      file.allSatisfy { $0.count == byteCount },
+      "The records must all hold \(byteCount) bytes, for samples of shape \(sampleShape).")
+    self.file = file
+    self.sampleShape = sampleShape
+  }
+
+  /// The position of the first sample.
+  public var startIndex: Int { file.startIndex }
+
+  /// The position one past the last sample.
+  public var endIndex: Int { file.endIndex }
+
+  /// Returns the sample at `i`.
+  public subscript(i: Int) -> MappedSample<Scalar> {
+    MappedSample(file: file, bytes: file[i], shape: sampleShape)
+  }
+}
+
+extension Collection {
+  /// Returns the samples of `self` collated along a new first dimension on
+  /// `device`, with the scalars of the samples copied in parallel straight
+  /// from the mapped file into the contiguous buffer of the batch.
+  ///
+  /// - Precondition: the samples all have the same shape.
+  public func collated<Scalar>(on device: Device) -> Tensor<Scalar>
+  where Element == MappedSample<Scalar> {
+    guard let sampleShape = first?.shape else {
+      return Tensor(shape: [0], scalars: [], on: device)
+    }
+    precondition(
+      allSatisfy { $0.shape == sampleShape }, "The samples must all have the same shape.")
+    let shape = TensorShape([count] + sampleShape.dimensions)
+    let sources = map(\.bytes)
+    // Copying at least a page per task keeps the tasks worth scheduling.
+    let minBatchSize = Swift.max(
+      4096 / Swift.max(sampleShape.contiguousSize * MemoryLayout<Scalar>.stride, 1), 1)
+    switch device.backend {
+    case .XLA:
+      // The samples land in a buffer which the upload reads from in place.
+      let buffer = HostScalarBuffer<Scalar>(count: shape.contiguousSize)
+      sources.concurrentCopy(
+        to: UnsafeMutableRawBufferPointer(buffer.scalars), minBatchSize: minBatchSize)
+      return Tensor(_xla: XLATensor.make(borrowing: buffer, shape.dimensions, on: device))
+    case .TF_EAGER:
+      // The samples land straight in the buffer of the tensor.
+      let handle = TensorHandle<Scalar>(
+        shape: shape.dimensions,
+        scalarsInitializer: { address in
+          sources.concurrentCopy(
+            to: UnsafeMutableRawBufferPointer(
+              start: address, count: shape.contiguousSize * MemoryLayout<Scalar>.stride),
+            minBatchSize: minBatchSize)
+        })
+      return Tensor(handle: handle)
+    }
+  }
+
+  /// The samples of `self` collated along a new first dimension on the default
+  /// device, see `collated(on:)`.
+  public func collated<Scalar>() -> Tensor<Scalar> where Element == MappedSample<Scalar> {
+    collated(on: .default)
+  }
+}
@@ -89,3 +89,94 @@ extension Collection {
     .init(base: self, selection: selection)
   }
 }
+
+/// A lazy, approximate shuffle of a sequence too large to hold in memory.
+///
+/// Elements of the base sequence are read into a buffer of fixed capacity, and
+/// each element produced is drawn uniformly from the buffer, then replaced by
+/// the next base element.  The larger the buffer, the closer the result is to
+/// a uniform shuffle; a buffer as large as the base sequence gives one.
+public struct ShuffleBufferSampling<
+  Base: Sequence, Entropy: RandomNumberGenerator
+>: Sequence {
+  /// The sequence whose elements are shuffled.
+  private let base: Base
+  /// The maximal number of elements held at once.
+  private let bufferCapacity: Int
+  /// A source of randomness used to pick elements from the buffer.
+  private let entropy: Entropy
+
+  /// Creates an instance shuffling `base` through a buffer of
+  /// `bufferCapacity` elements, using `entropy`.
+  ///
+  /// If `entropy` is only pseudorandom and has value semantics, each
+  /// iteration of `self` produces the same order.
+  public init(base: Base, bufferCapacity: Int, entropy: Entropy) {
+    precondition(bufferCapacity > 0, "The buffer capacity must be positive")
+    self.base = base
+    self.bufferCapacity = bufferCapacity
+    self.entropy = entropy
+  }
+
+  /// The iterator of a `ShuffleBufferSampling`.
+  public struct Iterator: IteratorProtocol {
+    private var base: Base.Iterator
+    private var buffer: [Base.Element] = []
+    private var entropy: Entropy
+
+    fileprivate init(
+      base: Base.Iterator, bufferCapacity: Int, entropy: Entropy
+    ) {
+      self.base = base
+      self.entropy = entropy
+      buffer.reserveCapacity(bufferCapacity)
+      while buffer.count < bufferCapacity, let e = self.base.next() {
+        buffer.append(e)
+      }
+    }
+
+    /// Returns the next element, or `nil` when all of them were produced.
+    public mutating func next() -> Base.Element? {
+      if buffer.isEmpty { return nil }
+      let i = Int.random(in: 0..<buffer.count, using: &entropy)
+      if let replacement = base.next() {
+        defer { buffer[i] = replacement }
+        return buffer[i]
+      }
+      buffer.swapAt(i, buffer.count - 1)
+      return buffer.removeLast()
+    }
+  }
+
+  /// Returns an iterator over the shuffled elements.
+  public func makeIterator() -> Iterator {
+    Iterator(
+      base: base.makeIterator(), bufferCapacity: bufferCapacity,
+      entropy: entropy)
+  }
+}
+
+extension Sequence {
+  /// Returns the elements of `self`, shuffled through a buffer of
+  /// `bufferCapacity` elements using `entropy`, without reading `self` until
+  /// iteration.
+  ///
+  /// - Complexity: O(1)
+  public func shuffledThroughBuffer<Entropy: RandomNumberGenerator>(
+    ofCapacity bufferCapacity: Int, using entropy: Entropy
+  ) -> ShuffleBufferSampling<Self, Entropy> {
+    .init(base: self, bufferCapacity: bufferCapacity, entropy: entropy)
+  }
+
+  /// Returns the elements of `self`, shuffled through a buffer of
+  /// `bufferCapacity` elements, without reading `self` until iteration.
+  ///
+  /// - Complexity: O(1)
+  public func shuffledThroughBuffer(ofCapacity bufferCapacity: Int)
+    -> ShuffleBufferSampling<Self, SystemRandomNumberGenerator>
+  {
+    .init(
+      base: self, bufferCapacity: bufferCapacity,
+      entropy: SystemRandomNumberGenerator())
+  }
+}
@@ -0,0 +1,289 @@
+// Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if canImport(Glibc)
+  import Glibc
+
+  /// A ring of batch slots in POSIX shared memory, through which data loader
+  /// processes hand collated batches to a training process without
+  /// serializing or copying them.
+  ///
+  /// The training process creates the ring, and then starts the producer
+  /// processes, which open it by name. A producer collates a batch straight
+  /// into a free slot with `write(_:shape:fill:)`, and the trainer gets the
+  /// batches in the order they were written with `next(_:on:)`. On X10 devices
+  /// the returned tensor borrows the slot until its scalars have been uploaded
+  /// to the device, when it is first used, at which point the slot goes back
+  /// to the producers even if the tensor stays alive; on the other devices the
+  /// scalars get copied and the slot is freed right away.
+  public final class SharedMemoryBatches {
+    /// The error thrown when the shared memory cannot be set up.
+    public struct Error: Swift.Error, CustomStringConvertible {
+      public let description: String
+    }
+
+    /// The name of the shared memory object.
+    public let name: String
+
+    /// The number of slots.
+    public let slotCount: Int
+
+    /// The maximal number of bytes of a batch.
+    public let slotCapacity: Int
+
+    /// The maximal rank of a batch.
+    public static let maxRank = 8
+
+    /// The mapping of the shared memory.
+    private let base: UnsafeMutableRawPointer
+
+    /// The size of the mapping.
+    private let byteCount: Int
+
+    /// Whether `self` created the shared memory object, and unlinks it.
+    private let isOwner: Bool
+
+    // The shared memory holds, in the native byte order:
+    // - the header: the magic, slotCount, slotCapacity and the sequence number
+    //   of the next batch written, as `Int64`s, followed by the semaphores,
+    // - the descriptors of the slots,
+    // - the page aligned slots, of slotCapacity bytes each.
+    private static let magic: Int64 = 0x3147_4E49_5230_3158  // "X10RING1"
+    private static let semaphoresOffset = 4 * MemoryLayout<Int64>.stride
+    private static let semaphoreStride =
+      (MemoryLayout<sem_t>.stride + MemoryLayout<Int64>.alignment - 1)
+      & ~(MemoryLayout<Int64>.alignment - 1)
+    private static let descriptorsOffset = semaphoresOffset + 3 * semaphoreStride
+    /// A descriptor holds the state, the sequence number, the scalar type,
+    /// the rank and the dimensions of the batch in the slot.
+    private static let descriptorStride = 16 * MemoryLayout<Int64>.stride
+
+    /// The states of a slot.
+    private enum SlotState: Int64 {
+      case free, writing, filled, reading
+    }
+
+    /// Creates the shared memory object `name`, holding `slotCount` slots of
+    /// `slotCapacity` bytes each.
+    ///
+    /// - Parameter name: a name starting with a slash, like `/batches`.
+    public init(creating name: String, slotCount: Int, slotCapacity: Int) throws {
+      precondition(slotCount > 0 && slotCapacity > 0)
+      self.name = name
+      self.slotCount = slotCount
+      self.slotCapacity = (slotCapacity + 63) & ~63
+      byteCount = Self.slotsOffset(slotCount: slotCount) + slotCount * self.slotCapacity
+      let fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0o600)
+      guard fd >= 0 else { throw Self.error("Cannot create \(name)") }
+      defer { close(fd) }
+      guard ftruncate(fd, off_t(byteCount)) == 0 else {
+        let error = Self.error("Cannot size \(name)")
+        shm_unlink(name)
+        throw error
+      }
+      guard let base = Self.map(fd, byteCount: byteCount) else {
+        let error = Self.error("Cannot map \(name)")
+        shm_unlink(name)
+        throw error
+      }
+      self.base = base
+      isOwner = true
+      base.storeBytes(of: Int64(slotCount), toByteOffset: 8, as: Int64.self)
+      base.storeBytes(of: Int64(self.slotCapacity), toByteOffset: 16, as: Int64.self)
+      base.storeBytes(of: 0, toByteOffset: 24, as: Int64.self)
+      sem_init(semaphore(0), 1, 1)
+      sem_init(semaphore(1), 1, UInt32(slotCount))
+      sem_init(semaphore(2), 1, 0)
+      for slot in 0..<slotCount { setDescriptor(slot, 0, SlotState.free.rawValue) }
+      // The magic goes last, so that the openers only see a complete ring.
+      base.storeBytes(of: Self.magic, toByteOffset: 0, as: Int64.self)
+    }
+
+    /// Opens the shared memory object `name`, created by another process with
+    /// `init(creating:slotCount:slotCapacity:)`.
+    public init(opening name: String) throws {
+      self.name = name
+      let fd = shm_open(name, O_RDWR, 0)
+      guard fd >= 0 else { throw Self.error("Cannot open \(name)") }
+      defer { close(fd) }
+      var status = stat()
+      guard fstat(fd, &status) == 0, status.st_size >= Self.descriptorsOffset else {
+        throw Error(description: "\(name) is not a batches ring.")
+      }
+      byteCount = Int(status.st_size)
+      guard let base = Self.map(fd, byteCount: byteCount) else {
+        throw Self.error("Cannot map \(name)")
+      }
+      self.base = base
+      isOwner = false
+      slotCount = Int(base.load(fromByteOffset: 8, as: Int64.self))
+      slotCapacity = Int(base.load(fromByteOffset: 16, as: Int64.self))
+      guard base.load(fromByteOffset: 0, as: Int64.self) == Self.magic,
+        Self.slotsOffset(slotCount: slotCount) + slotCount * slotCapacity == byteCount
+      else {
+        munmap(base, byteCount)
+        throw Error(description: "\(name) is not a batches ring.")
+      }
+    }
+
+    deinit {
+      if isOwner {
+        for i in 0..<3 { sem_destroy(semaphore(i)) }
+        shm_unlink(name)
+      }
+      munmap(base, byteCount)
+    }
+
+    /// Writes a batch of `shape` into the next free slot, waiting for one if
+    /// needed, with `fill` storing its scalars in row-major order straight into
+    /// the shared memory.
+    public func write<Scalar: TensorFlowScalar>(
+      _ type: Scalar.Type, shape: TensorShape,
+      fill: (UnsafeMutableBufferPointer<Scalar>) throws -> Void
+    ) rethrows {
+      precondition(shape.rank <= Self.maxRank, "A batch has at most \(Self.maxRank) dimensions.")
+      precondition(
+        shape.contiguousSize * MemoryLayout<Scalar>.stride <= slotCapacity,
+        "A batch of shape \(shape) exceeds the slot capacity of \(slotCapacity) bytes.")
+      Self.wait(semaphore(1))
+      let slot = acquire(from: .free, to: .writing)
+      do {
+        try fill(
+          UnsafeMutableBufferPointer(
+            start: slotAddress(slot).bindMemory(to: Scalar.self, capacity: shape.contiguousSize),
+            count: shape.contiguousSize))
+      } catch {
+        release(slot)
+        throw error
+      }
+      setDescriptor(slot, 2, Int64(Scalar.xlaTensorScalarTypeRawValue))
+      setDescriptor(slot, 3, Int64(shape.rank))
+      for (i, dimension) in shape.dimensions.enumerated() {
+        setDescriptor(slot, 4 + i, Int64(dimension))
+      }
+      Self.wait(semaphore(0))
+      let sequence = base.load(fromByteOffset: 24, as: Int64.self)
+      base.storeBytes(of: sequence + 1, toByteOffset: 24, as: Int64.self)
+      setDescriptor(slot, 1, sequence)
+      setDescriptor(slot, 0, SlotState.filled.rawValue)
+      sem_post(semaphore(0))
+      sem_post(semaphore(2))
+    }
+
+    /// Returns the oldest batch written, waiting for one if needed.
+    ///
+    /// - Precondition: the batch holds scalars of type `Scalar`.
+    public func next<Scalar: TensorFlowScalar>(
+      _ type: Scalar.Type = Scalar.self, on device: Device = .default
+    ) -> Tensor<Scalar> {
+      Self.wait(semaphore(2))
+      let slot = acquire(from: .filled, to: .reading)
+      let lease = SlotLease(self, slot)
+      precondition(
+        descriptor(slot, 2) == Int64(Scalar.xlaTensorScalarTypeRawValue),
+        "The batch does not hold scalars of type \(Scalar.self).")
+      let dimensions = (0..<Int(descriptor(slot, 3))).map { Int(descriptor(slot, 4 + $0)) }
+      let shape = TensorShape(dimensions)
+      let scalars = UnsafeBufferPointer(
+        start: slotAddress(slot).bindMemory(to: Scalar.self, capacity: shape.contiguousSize),
+        count: shape.contiguousSize)
+      switch device.backend {
+      case .XLA:
+        return Tensor(_xla: XLATensor.make(borrowing: scalars, dimensions, owner: lease, on: device))
+      case .TF_EAGER:
+        return Tensor(shape: shape, scalars: scalars, on: device)
+      }
+    }
+
+    /// Hands a slot being read back to the producers once released.
+    private final class SlotLease {
+      let batches: SharedMemoryBatches
+      let slot: Int
+
+      init(_ batches: SharedMemoryBatches, _ slot: Int) {
+        self.batches = batches
+        self.slot = slot
+      }
+
+      deinit { batches.release(slot) }
+    }
+
+    /// Moves a slot in state `from` to state `to`, the oldest one if several
+    /// are, and returns it. The caller holds a count of the slots in state
+    /// `from`, so there is one.
+    private func acquire(from: SlotState, to: SlotState) -> Int {
+      Self.wait(semaphore(0))
+      defer { sem_post(semaphore(0)) }
+      var found: Int? = nil
+      for slot in 0..<slotCount where descriptor(slot, 0) == from.rawValue {
+        if found == nil || descriptor(slot, 1) < descriptor(found!, 1) { found = slot }
+      }
+      guard let slot = found else { fatalError("No slot of \(name) is \(from).") }
+      setDescriptor(slot, 0, to.rawValue)
+      return slot
+    }
+
+    /// Frees a slot being written or read.
+    private func release(_ slot: Int) {
+      Self.wait(semaphore(0))
+      setDescriptor(slot, 0, SlotState.free.rawValue)
+      sem_post(semaphore(0))
+      sem_post(semaphore(1))
+    }
+
+    /// The semaphores are the lock of the descriptors, the count of the free
+    /// slots, and the count of the filled slots.
+    private func semaphore(_ index: Int) -> UnsafeMutablePointer<sem_t> {
+      (base + Self.semaphoresOffset + index * Self.semaphoreStride).assumingMemoryBound(
+        to: sem_t.self)
+    }
+
+    private func descriptor(_ slot: Int, _ field: Int) -> Int64 {
+      base.load(
+        fromByteOffset: Self.descriptorsOffset + slot * Self.descriptorStride + field * 8,
+        as: Int64.self)
+    }
+
+    private func setDescriptor(_ slot: Int, _ field: Int, _ value: Int64) {
+      base.storeBytes(
+        of: value, toByteOffset: Self.descriptorsOffset + slot * Self.descriptorStride + field * 8,
+        as: Int64.self)
+    }
+
+    private func slotAddress(_ slot: Int) -> UnsafeMutableRawPointer {
+      base + Self.slotsOffset(slotCount: slotCount) + slot * slotCapacity
+    }
+
+    private static func slotsOffset(slotCount: Int) -> Int {
+      let pageSize = Int(sysconf(Int32(_SC_PAGESIZE)))
+      let descriptorsEnd = descriptorsOffset + slotCount * descriptorStride
+      return (descriptorsEnd + pageSize - 1) / pageSize * pageSize
+    }
+
+    private static func map(_ fd: Int32, byteCount: Int) -> UnsafeMutableRawPointer? {
+      let address = mmap(nil, byteCount, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+      return address == UnsafeMutableRawPointer(bitPattern: -1) ? nil : address
+    }
+
+    private static func wait(_ semaphore: UnsafeMutablePointer<sem_t>) {
+      while sem_wait(semaphore) != 0 {
+        precondition(errno == EINTR, String(cString: strerror(errno)))
+      }
+    }
+
+    private static func error(_ message: String) -> Error {
+      Error(description: "\(message): \(String(cString: strerror(errno)))")
+    }
+  }
+#endif
@@ -33,8 +33,6 @@ public final class TrainingEpochs<
   /// The ordering of samples in the current epoch.
   private var sampleOrder: [Samples.Index]
 
-  // TODO: Figure out how to handle non-threasafe PRNGs with a parallel shuffle
-  // algorithm.
   /// A source of entropy for shuffling samples.
   private var entropy: Entropy
 
@@ -65,9 +63,9 @@ public final class TrainingEpochs<
   public func next() -> Element? {
     let remainder = sampleOrder.count % batchSize
 
-    // TODO: use a parallel shuffle like mergeshuffle
-    // (http://ceur-ws.org/Vol-2113/paper3.pdf)
-    sampleOrder.shuffle(using: &entropy)
+    sampleOrder.withUnsafeMutableBufferPointer {
+      $0.parallelShuffle(using: &entropy)
+    }
 
     return samples.sampled(at: sampleOrder.dropLast(remainder))
       .inBatches(of: batchSize)
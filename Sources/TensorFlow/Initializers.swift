@@ -396,6 +396,18 @@ extension Tensor where Scalar: TensorFlowFloatingPoint {
 // Random
 //===------------------------------------------------------------------------------------------===//
 
+/// Returns the seed of the next random op of a training step on `device`. On X10 with
+/// `XLA_STEP_RNG` set, it gets derived on the device from the step seed and from the index of the
+/// op within the step, so that the random ops do not each upload a seed, and the traced graph
+/// stays the same across steps. Otherwise it comes from the context seed.
+func _stepRandomSeed(on device: Device) -> Tensor<Int32> {
+  if device.backend == .XLA && _RawXLA.usesStepRandomSeeds {
+    return _RawXLA.stepRandomSeed(device)
+  }
+  let seed = Context.local.randomSeed
+  return Tensor<Int32>([seed.graph, seed.op], on: device)
+}
+
 extension Tensor where Scalar: TensorFlowIndex {
   /// Creates a tensor with the specified shape, randomly sampling scalar values from a uniform 
   /// distribution between `lowerBound` and `upperBound`.
@@ -437,12 +449,25 @@ extension Tensor where Scalar: TensorFlowFloatingPoint {
     upperBound: Tensor<Scalar>? = nil,
     seed: TensorFlowSeed = Context.local.randomSeed,
     on device: Device = .default
+  ) {
+    self.init(
+      randomUniform: shape, lowerBound: lowerBound, upperBound: upperBound,
+      seed: Tensor<Int32>([seed.graph, seed.op], on: device), on: device)
+  }
+
+  /// Same as above, with the seed given as a `[2]` tensor, like `_stepRandomSeed(on:)` returns.
+  init(
+    randomUniform shape: TensorShape,
+    lowerBound: Tensor<Scalar>? = nil,
+    upperBound: Tensor<Scalar>? = nil,
+    seed: Tensor<Int32>,
+    on device: Device = .default
   ) {
     let lowerBound = lowerBound ?? Tensor<Scalar>(0, on: device)
     let upperBound = upperBound ?? Tensor<Scalar>(1, on: device)
     let sample: Tensor<Scalar> = _Raw.statelessRandomUniform(
       shape: Tensor<Int32>((0..<shape.rank).map { Int32(shape[$0]) }, on: device),
-      seed: Tensor<Int32>([seed.graph, seed.op], on: device))
+      seed: seed)
     self = (upperBound - lowerBound) * sample + lowerBound
   }
 
@@ -460,10 +485,23 @@ extension Tensor where Scalar: TensorFlowFloatingPoint {
     standardDeviation: Tensor<Scalar>? = nil,
     seed: TensorFlowSeed = Context.local.randomSeed,
     on device: Device = .default
+  ) {
+    self.init(
+      randomNormal: shape, mean: mean, standardDeviation: standardDeviation,
+      seed: Tensor<Int32>([seed.graph, seed.op], on: device), on: device)
+  }
+
+  /// Same as above, with the seed given as a `[2]` tensor, like `_stepRandomSeed(on:)` returns.
+  init(
+    randomNormal shape: TensorShape,
+    mean: Tensor<Scalar>? = nil,
+    standardDeviation: Tensor<Scalar>? = nil,
+    seed: Tensor<Int32>,
+    on device: Device = .default
   ) {
     let sample: Tensor<Scalar> = _Raw.statelessRandomNormal(
       shape: Tensor<Int32>((0..<shape.rank).map { Int32(shape[$0]) }, on: device),
-      seed: Tensor<Int32>([seed.graph, seed.op], on: device))
+      seed: seed)
     self =
       (standardDeviation ?? Tensor<Scalar>(1, on: device)) * sample
       + (mean ?? Tensor<Scalar>(0, on: device))
@@ -545,6 +583,47 @@ extension TensorShape {
 }
 
 extension Tensor where Scalar: TensorFlowFloatingPoint {
+  /// Creates a tensor with the specified shape, randomly sampling scalar values from a uniform
+  /// distribution between `-limit` and `limit`. On X10, the values get sampled by the graph which
+  /// first uses the tensor, so that initializing a parameter uploads nothing to the device.
+  fileprivate init(
+    varianceScalingUniform shape: TensorShape, limit: Scalar, seed: TensorFlowSeed,
+    on device: Device
+  ) {
+    if device.backend == .XLA {
+      self = _RawXLA.randomInit(
+        shape: shape.dimensions, distribution: .uniform, scale: Double(limit), seed: seed,
+        device: device)
+      return
+    }
+    let limit = Tensor<Scalar>(limit, on: device)
+    self.init(randomUniform: shape, lowerBound: -limit, upperBound: limit, seed: seed, on: device)
+  }
+
+  /// Creates a tensor with the specified shape, randomly sampling scalar values from a normal
+  /// distribution centered on `0` and truncated at two standard deviations, whose standard
+  /// deviation is `standardDeviation` before the truncation. Sampled on X10 like above.
+  fileprivate init(
+    varianceScalingTruncatedNormal shape: TensorShape, standardDeviation: Scalar,
+    seed: TensorFlowSeed, on device: Device
+  ) {
+    // Standard deviation of truncated standard normal between `-2` and `2` standard deviations.
+    let truncationDeviation: Scalar = 0.87962566103423978
+    // Smooths the tails of the clipped normal.
+    let standardDeviation = standardDeviation / truncationDeviation
+    if device.backend == .XLA {
+      self = _RawXLA.randomInit(
+        shape: shape.dimensions, distribution: .truncatedNormal,
+        scale: Double(standardDeviation), seed: seed, device: device)
+      return
+    }
+    self.init(
+      randomTruncatedNormal: shape,
+      mean: Tensor<Scalar>(0, on: device),
+      standardDeviation: Tensor<Scalar>(standardDeviation, on: device),
+      seed: seed, on: device)
+  }
+
   /// Creates a tensor with the specified shape by performing Glorot (Xavier) uniform initialization.
   ///
   /// It draws random samples from a uniform distribution between `-limit` and `limit`
@@ -563,8 +642,8 @@ extension Tensor where Scalar: TensorFlowFloatingPoint {
     on device: Device = .default
   ) {
     let (fanIn, fanOut) = shape.fans()
-    let limit = Tensor<Scalar>(Scalar.sqrt(6 / Scalar(fanIn + fanOut)), on: device)
-    self.init(randomUniform: shape, lowerBound: -limit, upperBound: limit, seed: seed, on: device)
+    self.init(
+      varianceScalingUniform: shape, limit: Scalar.sqrt(6 / Scalar(fanIn + fanOut)), seed: seed, on: device)
   }
 
   /// Creates a tensor with the specified shape by performing Glorot (Xavier) normal initialization.
@@ -585,15 +664,9 @@ extension Tensor where Scalar: TensorFlowFloatingPoint {
     on device: Device = .default
   ) {
     let (fanIn, fanOut) = shape.fans()
-    var standardDeviation = Tensor<Scalar>(Scalar.sqrt(2 / Scalar(fanIn + fanOut)), on: device)
-    // Standard deviation of truncated standard normal between `-2` and `2` standard deviations.
-    let truncationDeviation = Tensor<Scalar>(0.87962566103423978, on: device)
-    standardDeviation /= truncationDeviation  // Smooths the tails of the clipped normal.
     self.init(
-      randomTruncatedNormal: shape,
-      mean: Tensor<Scalar>(0, on: device),
-      standardDeviation: standardDeviation,
-      seed: seed, on: device)
+      varianceScalingTruncatedNormal: shape, standardDeviation: Scalar.sqrt(2 / Scalar(fanIn + fanOut)), seed: seed,
+      on: device)
   }
 }
 
@@ -616,8 +689,8 @@ extension Tensor where Scalar: TensorFlowFloatingPoint {
     on device: Device = .default
   ) {
     let (fanIn, _) = shape.fans()
-    let limit = Tensor<Scalar>(Scalar.sqrt(6 / Scalar(fanIn)), on: device)
-    self.init(randomUniform: shape, lowerBound: -limit, upperBound: limit, seed: seed, on: device)
+    self.init(
+      varianceScalingUniform: shape, limit: Scalar.sqrt(6 / Scalar(fanIn)), seed: seed, on: device)
   }
 
   /// Creates a tensor with the specified shape by performing He (Kaiming) normal initialization.
@@ -638,15 +711,9 @@ extension Tensor where Scalar: TensorFlowFloatingPoint {
     on device: Device = .default
   ) {
     let (fanIn, _) = shape.fans()
-    var standardDeviation = Tensor<Scalar>(Scalar.sqrt(2 / Scalar(fanIn)), on: device)
-    // Standard deviation of truncated standard normal between `-2` and `2` standard deviations.
-    let truncationDeviation = Tensor<Scalar>(0.87962566103423978, on: device)
-    standardDeviation /= truncationDeviation  // Smooths the tails of the clipped normal.
     self.init(
-      randomTruncatedNormal: shape,
-      mean: Tensor<Scalar>(0, on: device),
-      standardDeviation: standardDeviation,
-      seed: seed, on: device)
+      varianceScalingTruncatedNormal: shape, standardDeviation: Scalar.sqrt(2 / Scalar(fanIn)), seed: seed,
+      on: device)
   }
 }
 
@@ -668,8 +735,8 @@ extension Tensor where Scalar: TensorFlowFloatingPoint {
     on device: Device = .default
   ) {
     let (fanIn, _) = shape.fans()
-    let limit = Tensor<Scalar>(Scalar.sqrt(3 / Scalar(fanIn)), on: device)
-    self.init(randomUniform: shape, lowerBound: -limit, upperBound: limit, seed: seed, on: device)
+    self.init(
+      varianceScalingUniform: shape, limit: Scalar.sqrt(3 / Scalar(fanIn)), seed: seed, on: device)
   }
 
   /// Creates a tensor with the specified shape by performing LeCun normal initialization.
@@ -689,15 +756,9 @@ extension Tensor where Scalar: TensorFlowFloatingPoint {
     on device: Device = .default
   ) {
     let (fanIn, _) = shape.fans()
-    var standardDeviation = Tensor<Scalar>(Scalar.sqrt(1 / Scalar(fanIn)), on: device)
-    // Standard deviation of truncated standard normal between `-2` and `2` standard deviations.
-    let truncationDeviation = Tensor<Scalar>(0.87962566103423978, on: device)
-    standardDeviation /= truncationDeviation  // Smooths the tails of the clipped normal.
     self.init(
-      randomTruncatedNormal: shape,
-      mean: Tensor<Scalar>(0, on: device),
-      standardDeviation: standardDeviation,
-      seed: seed, on: device)
+      varianceScalingTruncatedNormal: shape, standardDeviation: Scalar.sqrt(1 / Scalar(fanIn)), seed: seed,
+      on: device)
   }
 }
 
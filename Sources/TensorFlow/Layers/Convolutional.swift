@@ -207,6 +207,18 @@ public struct Conv2D<Scalar: TensorFlowFloatingPoint>: Layer {
   /// - Note: Padding size equals zero when using `.valid`.
   @differentiable(reverse)
   public func callAsFunction(_ input: Tensor<Scalar>) -> Tensor<Scalar> {
+    if useBias && input.device.backend == .XLA {
+      // The bias lands in the epilogue of the convolution.
+      return activation(
+        _fusedConv2DBiasActivation(
+          input,
+          filter: filter,
+          bias: bias,
+          strides: (1, strides.0, strides.1, 1),
+          padding: padding,
+          dilations: (1, dilations.0, dilations.1, 1),
+          relu: false))
+    }
     let conv = conv2D(
       input,
       filter: filter,
@@ -40,6 +40,9 @@ public struct Dense<Scalar: TensorFlowFloatingPoint>: Layer {
   @noDerivative internal let batched: Bool
   /// Workaround optionals not being handled by AD
   @noDerivative private let useBias: Bool
+  /// How many ways each dimension of `weight` gets split across the replication devices, for
+  /// tensor parallelism on X10, or `nil` to keep the weight whole. See `Tensor.sharded(tiles:)`.
+  @noDerivative public var weightTiles: [Int]? = nil
 
   /// The element-wise activation function type.
   public typealias Activation = @differentiable(reverse) (Tensor<Scalar>) -> Tensor<Scalar>
@@ -71,6 +74,12 @@ public struct Dense<Scalar: TensorFlowFloatingPoint>: Layer {
   /// - Returns: The output.
   @differentiable(reverse)
   public func callAsFunction(_ input: Tensor<Scalar>) -> Tensor<Scalar> {
+    let weight: Tensor<Scalar>
+    if let weightTiles = weightTiles {
+      weight = self.weight.sharded(tiles: weightTiles)
+    } else {
+      weight = self.weight
+    }
     if batched {
       let hidden = matmul(input.expandingShape(at: 1), weight).squeezingShape(at: 1)
       return activation(useBias ? hidden + bias : hidden)
@@ -26,10 +26,46 @@ extension Tensor where Scalar: TensorFlowFloatingPoint {
   /// Computes dropout given a probability.
   @differentiable(reverse, wrt: self)
   fileprivate func droppingOut(probability: Double) -> Tensor {
-    let noise = Tensor(randomUniform: shape, on: device)
-    let keepMask = noise .>= Scalar(probability)
-    let keepProbability = Scalar(1.0 - probability)
-    return self * Tensor(keepMask) / Tensor(keepProbability, on: device)
+    droppingOut(probability: probability, seed: _stepRandomSeed(on: device))
+  }
+
+  /// Computes dropout with the keep mask drawn out of `seed`.
+  @differentiable(reverse, wrt: self)
+  fileprivate func droppingOut(probability: Double, seed: Tensor<Int32>) -> Tensor {
+    self * Tensor.dropoutKeepMask(shape, probability: probability, seed: seed, on: device)
+      / Tensor(Scalar(1.0 - probability), on: device)
+  }
+
+  @derivative(of: droppingOut(probability:seed:), wrt: self)
+  fileprivate func vjpDroppingOut(probability: Double, seed: Tensor<Int32>) -> (
+    value: Tensor, pullback: (Tensor) -> Tensor
+  ) {
+    let shape = self.shape
+    let device = self.device
+    return (
+      droppingOut(probability: probability, seed: seed),
+      { v in
+        // The mask gets drawn again out of the seed, instead of staying alive until the pullback.
+        // On X10, the seed goes through a remat barrier so that XLA does not merge both draws.
+        let pullbackSeed: Tensor<Int32>
+        switch seed.handle.backend {
+        case .XLA:
+          pullbackSeed = Tensor<Int32>(_xla: XLATensor.remat(seed.xlaTensor, "dropout"))
+        case .TF_EAGER:
+          pullbackSeed = seed
+        }
+        return v * Tensor.dropoutKeepMask(
+          shape, probability: probability, seed: pullbackSeed, on: device)
+          / Tensor(Scalar(1.0 - probability), on: device)
+      }
+    )
+  }
+
+  fileprivate static func dropoutKeepMask(
+    _ shape: TensorShape, probability: Double, seed: Tensor<Int32>, on device: Device
+  ) -> Tensor {
+    let noise = Tensor(randomUniform: shape, seed: seed, on: device)
+    return Tensor(noise .>= Scalar(probability))
   }
 }
 
@@ -91,7 +127,7 @@ public struct GaussianNoise<Scalar: TensorFlowFloatingPoint>: ParameterlessLayer
     case .training:
       let noise = Tensor<Scalar>(
         randomNormal: input.shape, mean: Tensor<Scalar>(0),
-        standardDeviation: self.standardDeviation)
+        standardDeviation: self.standardDeviation, seed: _stepRandomSeed(on: .default))
       return input + noise
     case .inference:
       return input
@@ -128,7 +164,7 @@ public struct GaussianDropout<Scalar: TensorFlowFloatingPoint>: ParameterlessLay
     case .training:
       let noise = Tensor<Scalar>(
         randomNormal: input.shape, mean: Tensor<Scalar>(1.0),
-        standardDeviation: Tensor<Scalar>(standardDeviation))
+        standardDeviation: Tensor<Scalar>(standardDeviation), seed: _stepRandomSeed(on: .default))
       return input * noise
     case .inference:
       return input
@@ -169,7 +205,8 @@ public struct AlphaDropout<Scalar: TensorFlowFloatingPoint>: ParameterlessLayer
       let alpha = 1.6732632423543772848170429916717
       let scale = 1.0507009873554804934193349852946
       let alpha_p = -alpha * scale
-      let uniform = Tensor<Scalar>(randomUniform: input.shape, on: input.device)
+      let uniform = Tensor<Scalar>(
+        randomUniform: input.shape, seed: _stepRandomSeed(on: input.device), on: input.device)
       let noise = uniform .>= Scalar(probability)
 
       // Get affine transformation params
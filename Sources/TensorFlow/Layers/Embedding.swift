@@ -25,6 +25,9 @@ import _Differentiation
 public struct Embedding<Scalar: TensorFlowFloatingPoint>: Module {
   /// A learnable lookup table that maps vocabulary indices to their dense vector representations.
   public var embeddings: Tensor<Scalar>
+  /// How many ways each dimension of `embeddings` gets split across the replication devices, for
+  /// tensor parallelism on X10, or `nil` to keep the table whole. See `Tensor.sharded(tiles:)`.
+  @noDerivative public var embeddingsTiles: [Int]? = nil
 
   /// Creates an `Embedding` layer with randomly initialized embeddings of shape
   /// `(vocabularySize, embeddingSize)` so that each vocabulary index is given a vector
@@ -60,6 +63,76 @@ public struct Embedding<Scalar: TensorFlowFloatingPoint>: Module {
   /// - Returns: The tensor created by replacing input indices with their vector representations.
   @differentiable(reverse, wrt: self)
   public func callAsFunction(_ input: Tensor<Int32>) -> Tensor<Scalar> {
-    embeddings.gathering(atIndices: input)
+    if let embeddingsTiles = embeddingsTiles {
+      return embeddings.sharded(tiles: embeddingsTiles).gathering(atIndices: input)
+    }
+    return embeddings.gathering(atIndices: input)
+  }
+
+  /// Returns the output of the lookup, along with a pullback which returns the gradient of the
+  /// embeddings as the rows touched by the lookup, instead of a dense table mostly made of zeros.
+  ///
+  /// The rows can be applied with `Tensor.addingRows(_:)`, or with the row-sparse update of
+  /// `GeneralOptimizer`, which makes the cost of the backward pass proportional to the number of
+  /// looked up indices rather than to the vocabulary size.
+  ///
+  /// - Parameter input: The indices that will be mapped to their vector representations.
+  public func lookupWithSparsePullback(_ input: Tensor<Int32>) -> (
+    value: Tensor<Scalar>, pullback: (Tensor<Scalar>) -> SparseRows<Scalar>
+  ) {
+    let indices = input.reshaped(to: [input.scalarCount])
+    let rowShape = TensorShape([input.scalarCount] + embeddings.shape.dimensions.dropFirst())
+    return (
+      embeddings.gathering(atIndices: input),
+      { seed in SparseRows(indices: indices, values: seed.reshaped(to: rowShape)) }
+    )
+  }
+
+  /// Returns the sums of the embeddings of the `[batchSize, vocabularySize]` sparse features,
+  /// weighted by their values, like the embedding bags of recommendation models. The cost is
+  /// proportional to the capacity of `features`, whatever the vocabulary size.
+  @differentiable(reverse, wrt: self)
+  public func callAsFunction(_ features: SparseTensor<Scalar>) -> Tensor<Scalar> {
+    matmul(features, embeddings)
+  }
+
+  /// Returns the output of the embedding bags of `features`, along with a pullback which returns
+  /// the gradient of the embeddings as the rows the features touch. See
+  /// `lookupWithSparsePullback(_:)` for the ways to apply them.
+  public func lookupWithSparsePullback(_ features: SparseTensor<Scalar>) -> (
+    value: Tensor<Scalar>, pullback: (Tensor<Scalar>) -> SparseRows<Scalar>
+  ) {
+    matmulWithSparsePullback(features, embeddings)
+  }
+}
+
+/// A gradient of a lookup table kept as the rows it touches: row `i` of `values` goes to row
+/// `indices[i]` of the table, and repeated indices accumulate.
+public struct SparseRows<Scalar: TensorFlowNumeric> {
+  /// The `[N]` row indices.
+  public var indices: Tensor<Int32>
+  /// The `[N, ...]` rows.
+  public var values: Tensor<Scalar>
+
+  public init(indices: Tensor<Int32>, values: Tensor<Scalar>) {
+    precondition(
+      indices.rank == 1 && values.rank >= 1 && indices.shape[0] == values.shape[0],
+      "The indices must be a vector with one entry per row of the values.")
+    self.indices = indices
+    self.values = values
+  }
+
+  /// Returns the dense `[rowCount, ...]` table holding the sum of the rows.
+  public func densified(rowCount: Int) -> Tensor<Scalar> {
+    let shape = TensorShape([rowCount] + values.shape.dimensions.dropFirst())
+    return Tensor(zeros: shape, on: values.device).addingRows(self)
+  }
+}
+
+extension Tensor where Scalar: TensorFlowNumeric {
+  /// Returns the tensor with the `rows` added into the rows they index. On X10 this lowers to a
+  /// single scatter into the tensor, whatever the size of its first dimension.
+  public func addingRows(_ rows: SparseRows<Scalar>) -> Tensor {
+    _Raw.embeddingSparseUpdate(self, indices: rows.indices, values: rows.values)
   }
 }
@@ -247,13 +247,17 @@ public struct LayerNorm<Scalar: TensorFlowFloatingPoint>: Layer {
   /// - Returns: The output.
   @differentiable(reverse)
   public func callAsFunction(_ input: Tensor<Scalar>) -> Tensor<Scalar> {
-    // Note: `withoutDerivative(at:)` is currently needed in the following to prevent the resulting
-    // tensor for `epsilon` from being scalarized on the backwards pass, breaking X10 traces.
-    let epsilon = withoutDerivative(at: input) { Tensor(self.epsilon, deviceAndPrecisionLike: $0) }
     let positiveAxis = (input.rank + axis) % input.rank
     precondition(
       input.shape[positiveAxis] == offset.shape[0],
       "The number of features of the input and the offset doesn't match.")
+    if input.device.backend == .XLA {
+      return _fusedLayerNorm(
+        input, scale: scale, offset: offset, axis: positiveAxis, epsilon: self.epsilon)
+    }
+    // Note: `withoutDerivative(at:)` is currently needed in the following to prevent the resulting
+    // tensor for `epsilon` from being scalarized on the backwards pass, breaking X10 traces.
+    let epsilon = withoutDerivative(at: input) { Tensor(self.epsilon, deviceAndPrecisionLike: $0) }
     var broadcastShape = TensorShape(Array(repeating: 1, count: input.rank))
     broadcastShape[positiveAxis] = input.shape[positiveAxis]
     let offset = self.offset.reshaped(to: broadcastShape)
@@ -264,6 +268,129 @@ public struct LayerNorm<Scalar: TensorFlowFloatingPoint>: Layer {
   }
 }
 
+/// A layer that applies root mean square normalization over a mini-batch of inputs.
+///
+/// Unlike `LayerNorm`, the input is only rescaled by its root mean square along `axis`, without
+/// getting centered, and there is no offset.
+///
+/// Reference: [Root Mean Square Layer Normalization](https://arxiv.org/abs/1910.07467).
+@frozen
+public struct RMSNorm<Scalar: TensorFlowFloatingPoint>: Layer {
+  /// The scale value, also known as gamma.
+  public var scale: Tensor<Scalar>
+  /// The axis.
+  @noDerivative public let axis: Int
+  /// The epsilon value added to the mean square.
+  @noDerivative public let epsilon: Scalar
+
+  /// Creates a root mean square normalization layer.
+  public init(scale: Tensor<Scalar>, axis: Int, epsilon: Scalar) {
+    precondition(scale.rank == 1, "The scale must have rank 1.")
+    self.scale = scale
+    self.axis = axis
+    self.epsilon = epsilon
+  }
+
+  /// Creates a root mean square normalization layer.
+  ///
+  /// - Parameters:
+  ///   - featureCount: The number of features.
+  ///   - axis: The axis that should be normalized.
+  ///   - epsilon: The small scalar added to the mean square.
+  public init(featureCount: Int, axis: Int, epsilon: Scalar = 1e-6) {
+    self.init(scale: Tensor(ones: [featureCount]), axis: axis, epsilon: epsilon)
+  }
+
+  /// Returns the output obtained from applying the layer to the given input.
+  ///
+  /// - Parameter input: The input to the layer.
+  /// - Returns: The output.
+  @differentiable(reverse)
+  public func callAsFunction(_ input: Tensor<Scalar>) -> Tensor<Scalar> {
+    let positiveAxis = (input.rank + axis) % input.rank
+    precondition(
+      input.shape[positiveAxis] == scale.shape[0],
+      "The number of features of the input and the scale doesn't match.")
+    if input.device.backend == .XLA {
+      return _fusedRMSNorm(input, scale: scale, axis: positiveAxis, epsilon: self.epsilon)
+    }
+    let epsilon = withoutDerivative(at: input) { Tensor(self.epsilon, deviceAndPrecisionLike: $0) }
+    var broadcastShape = TensorShape(Array(repeating: 1, count: input.rank))
+    broadcastShape[positiveAxis] = input.shape[positiveAxis]
+    let scale = self.scale.reshaped(to: broadcastShape)
+    let inv = rsqrt(input.squared().mean(alongAxes: positiveAxis) + epsilon) * scale
+    return input * inv
+  }
+}
+
+/// Layer normalization of `input` along `axis` as a single node, whose statistics come out of one
+/// pass over the input, and get reused by the pullback instead of being recomputed. X10 only.
+@differentiable(reverse, wrt: (input, scale, offset))
+func _fusedLayerNorm<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>,
+  scale: Tensor<Scalar>,
+  offset: Tensor<Scalar>,
+  axis: Int,
+  epsilon: Scalar
+) -> Tensor<Scalar> {
+  _RawXLA.layerNorm(input, weight: scale, bias: offset, dim: Int64(axis), eps: Float(epsilon))
+    .output
+}
+
+@derivative(of: _fusedLayerNorm, wrt: (input, scale, offset))
+func _vjpFusedLayerNorm<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>,
+  scale: Tensor<Scalar>,
+  offset: Tensor<Scalar>,
+  axis: Int,
+  epsilon: Scalar
+) -> (
+  value: Tensor<Scalar>,
+  pullback: (Tensor<Scalar>) -> (Tensor<Scalar>, Tensor<Scalar>, Tensor<Scalar>)
+) {
+  let (output, mean, invstd) = _RawXLA.layerNorm(
+    input, weight: scale, bias: offset, dim: Int64(axis), eps: Float(epsilon))
+  return (
+    output,
+    { v in
+      let grads = _RawXLA.layerNormBackward(
+        gradOutput: v, input: input, weight: scale, mean: mean, invstd: invstd, dim: Int64(axis))
+      return (grads.input, grads.weight, grads.bias)
+    }
+  )
+}
+
+/// Root mean square normalization of `input` along `axis` as a single node, whose inverse root
+/// mean square gets reused by the pullback. X10 only.
+@differentiable(reverse, wrt: (input, scale))
+func _fusedRMSNorm<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>,
+  scale: Tensor<Scalar>,
+  axis: Int,
+  epsilon: Scalar
+) -> Tensor<Scalar> {
+  _RawXLA.rmsNorm(input, weight: scale, dim: Int64(axis), eps: Float(epsilon)).output
+}
+
+@derivative(of: _fusedRMSNorm, wrt: (input, scale))
+func _vjpFusedRMSNorm<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>,
+  scale: Tensor<Scalar>,
+  axis: Int,
+  epsilon: Scalar
+) -> (value: Tensor<Scalar>, pullback: (Tensor<Scalar>) -> (Tensor<Scalar>, Tensor<Scalar>)) {
+  let (output, invrms) = _RawXLA.rmsNorm(
+    input, weight: scale, dim: Int64(axis), eps: Float(epsilon))
+  return (
+    output,
+    { v in
+      let grads = _RawXLA.rmsNormBackward(
+        gradOutput: v, input: input, weight: scale, invrms: invrms, dim: Int64(axis))
+      return (grads.input, grads.weight)
+    }
+  )
+}
+
 /// A layer that applies group normalization over a mini-batch of inputs.
 ///
 /// Reference: [Group Normalization](https://arxiv.org/abs/1803.08494).
@@ -285,6 +285,11 @@ public struct LSTMCell<Scalar: TensorFlowFloatingPoint>: RecurrentLayerCell {
   /// - Returns: The hidden state.
   @differentiable(reverse)
   public func callAsFunction(_ input: Input) -> Output {
+    if input.input.device.backend == .XLA {
+      let newState = _fusedLSTMCell(
+        input.input, state: input.state, weight: fusedWeight, bias: fusedBias)
+      return Output(output: newState, state: newState)
+    }
     let gateInput = input.input.concatenated(with: input.state.hidden, alongAxis: 1)
 
     let fused = matmul(gateInput, fusedWeight) + fusedBias
@@ -360,6 +365,22 @@ public struct GRUCell<Scalar: TensorFlowFloatingPoint>: RecurrentLayerCell {
   /// - Returns: The hidden state.
   @differentiable(reverse)
   public func callAsFunction(_ input: Input) -> Output {
+    if input.input.device.backend == .XLA {
+      // The fused cell takes the state with the batch size of the input, while the zero state
+      // has a single row.
+      let state = input.state.broadcasted(
+        to: [input.input.shape[0], withoutDerivative(at: input.state.shape[1])])
+      let newState = _fusedGRUCell(
+        input.input, state: state,
+        kernel: Tensor(concatenating: [updateKernel, resetKernel, outputKernel], alongAxis: 1),
+        recurrentKernel: Tensor(
+          concatenating: [updateRecurrentKernel, resetRecurrentKernel, outputRecurrentKernel],
+          alongAxis: 1),
+        bias: Tensor(concatenating: [updateBias, resetBias, outputBias]),
+        recurrentBias: Tensor(
+          concatenating: [updateRecurrentBias, resetRecurrentBias, outputRecurrentBias]))
+      return Output(output: newState, state: newState)
+    }
     let updateGate = sigmoid(
       (matmul(input.input, updateKernel) + updateBias)
       + (matmul(input.state, updateRecurrentKernel) + updateRecurrentBias)
@@ -381,6 +402,99 @@ public struct GRUCell<Scalar: TensorFlowFloatingPoint>: RecurrentLayerCell {
   }
 }
 
+/// A step of an LSTM cell as a single node, whose activated gates get reused by the pullback,
+/// itself a single node, instead of being recomputed. X10 only.
+@differentiable(reverse, wrt: (input, state, weight, bias))
+func _fusedLSTMCell<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>,
+  state: LSTMCell<Scalar>.State,
+  weight: Tensor<Scalar>,
+  bias: Tensor<Scalar>
+) -> LSTMCell<Scalar>.State {
+  let output = _RawXLA.lstmCell(
+    input: input, hidden: state.hidden, cell: state.cell, weight: weight, bias: bias)
+  return LSTMCell<Scalar>.State(cell: output.cell, hidden: output.hidden)
+}
+
+@derivative(of: _fusedLSTMCell, wrt: (input, state, weight, bias))
+func _vjpFusedLSTMCell<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>,
+  state: LSTMCell<Scalar>.State,
+  weight: Tensor<Scalar>,
+  bias: Tensor<Scalar>
+) -> (
+  value: LSTMCell<Scalar>.State,
+  pullback: (LSTMCell<Scalar>.State.TangentVector) -> (
+    Tensor<Scalar>, LSTMCell<Scalar>.State.TangentVector, Tensor<Scalar>, Tensor<Scalar>
+  )
+) {
+  let output = _RawXLA.lstmCell(
+    input: input, hidden: state.hidden, cell: state.cell, weight: weight, bias: bias)
+  return (
+    LSTMCell<Scalar>.State(cell: output.cell, hidden: output.hidden),
+    { v in
+      let grads = _RawXLA.lstmCellGrad(
+        gradCell: v.cell, gradHidden: v.hidden, input: input, hidden: state.hidden,
+        cell: state.cell, weight: weight, gates: output.gates, newCell: output.cell)
+      return (
+        grads.input, LSTMCell<Scalar>.State.TangentVector(cell: grads.cell, hidden: grads.hidden),
+        grads.weight, grads.bias
+      )
+    }
+  )
+}
+
+/// A step of a GRU cell as a single node, with the kernels, recurrent kernels and biases of the
+/// update, reset and output gates concatenated along their last axis. The activated gates get
+/// reused by the pullback, itself a single node, instead of being recomputed. X10 only.
+@differentiable(reverse, wrt: (input, state, kernel, recurrentKernel, bias, recurrentBias))
+func _fusedGRUCell<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>,
+  state: Tensor<Scalar>,
+  kernel: Tensor<Scalar>,
+  recurrentKernel: Tensor<Scalar>,
+  bias: Tensor<Scalar>,
+  recurrentBias: Tensor<Scalar>
+) -> Tensor<Scalar> {
+  _RawXLA.gruCell(
+    input: input, hidden: state, kernel: kernel, recurrentKernel: recurrentKernel, bias: bias,
+    recurrentBias: recurrentBias
+  ).hidden
+}
+
+@derivative(of: _fusedGRUCell, wrt: (input, state, kernel, recurrentKernel, bias, recurrentBias))
+func _vjpFusedGRUCell<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>,
+  state: Tensor<Scalar>,
+  kernel: Tensor<Scalar>,
+  recurrentKernel: Tensor<Scalar>,
+  bias: Tensor<Scalar>,
+  recurrentBias: Tensor<Scalar>
+) -> (
+  value: Tensor<Scalar>,
+  pullback: (Tensor<Scalar>) -> (
+    Tensor<Scalar>, Tensor<Scalar>, Tensor<Scalar>, Tensor<Scalar>, Tensor<Scalar>,
+    Tensor<Scalar>
+  )
+) {
+  let output = _RawXLA.gruCell(
+    input: input, hidden: state, kernel: kernel, recurrentKernel: recurrentKernel, bias: bias,
+    recurrentBias: recurrentBias)
+  return (
+    output.hidden,
+    { v in
+      let grads = _RawXLA.gruCellGrad(
+        gradHidden: v, input: input, hidden: state, kernel: kernel,
+        recurrentKernel: recurrentKernel, gates: output.gates,
+        recurrentOutput: output.recurrentOutput)
+      return (
+        grads.input, grads.hidden, grads.kernel, grads.recurrentKernel, grads.bias,
+        grads.recurrentBias
+      )
+    }
+  )
+}
+
 public struct RecurrentLayer<Cell: RecurrentLayerCell>: Layer {
   public typealias Input = [Cell.TimeStepInput]
   public typealias Output = [Cell.TimeStepOutput]
@@ -482,6 +596,28 @@ public struct RecurrentLayer<Cell: RecurrentLayerCell>: Layer {
   }
 }
 
+extension RecurrentLayer
+where Cell.TimeStepInput == Tensor<Float>, Cell.State == Tensor<Float> {
+  /// Returns the hidden states after each time step over `sequence`, whose leading dimension holds
+  /// the time steps, stacked along the leading dimension. For cells like `BasicRNNCell` and
+  /// `GRUCell`, the hidden states are also the outputs.
+  ///
+  /// On X10 the time steps run as a single loop, and so does their pullback, instead of being
+  /// unrolled into the trace.
+  @differentiable(reverse, wrt: (self, sequence, initialState))
+  public func states(over sequence: Tensor<Float>, initialState: Tensor<Float>) -> Tensor<Float> {
+    _scan(self, initial: initialState, over: sequence) { layer, state, input in
+      layer.cell(input: input, state: state).state
+    }
+  }
+
+  @differentiable(reverse, wrt: (self, sequence))
+  public func states(over sequence: Tensor<Float>) -> Tensor<Float> {
+    let initialState = withoutDerivative(at: cell.zeroState(for: sequence[0]))
+    return states(over: sequence, initialState: initialState)
+  }
+}
+
 /// A type with values that support differentiable binary operations.
 ///
 /// Used by `BidirectionalRecurrentLayer` as a generic requirement for merge functions.
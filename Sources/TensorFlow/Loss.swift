@@ -249,6 +249,27 @@ public func softmaxCrossEntropy<Scalar: TensorFlowFloatingPoint>(
   reduction(softmaxCrossEntropyHelper(logits: logits, labels: labels))
 }
 
+/// Computes the sparse softmax cross entropy between logits and labels, averaged over the
+/// positions where `mask` is nonzero.
+///
+/// This is the loss of packed rows, such as the ones of `PackedSequenceBatch`, where `mask` zeroes
+/// the padding positions. The masked positions still run through the fused cross entropy, so the
+/// shapes stay static, but they add nothing to the loss nor to the gradient.
+///
+/// - Parameters:
+///   - logits: One-hot encoded outputs from a neural network.
+///   - labels: Indices (zero-indexed) of the correct outputs.
+///   - mask: The weights of the positions, with the shape of `labels`.
+@differentiable(reverse, wrt: logits)
+public func softmaxCrossEntropy<Scalar: TensorFlowFloatingPoint>(
+  logits: Tensor<Scalar>,
+  labels: Tensor<Int32>,
+  mask: Tensor<Scalar>
+) -> Tensor<Scalar> {
+  let loss = softmaxCrossEntropyHelper(logits: logits, labels: labels)
+  return (loss * mask).sum() / max(mask.sum(), 1)
+}
+
 @inlinable
 @differentiable(reverse, wrt: logits)
 func softmaxCrossEntropyHelper<Scalar: TensorFlowFloatingPoint>(
@@ -559,3 +559,105 @@ func _vjpErosion2D<Scalar: TensorFlowFloatingPoint>(
     }
   )
 }
+
+/// Randomly crops, resizes, flips and color jitters a batch of images, the way the input pipelines
+/// of image classifiers augment their training batches.
+///
+/// Every image gets a crop of a random fraction of its area in `areaRange` and of a random aspect
+/// ratio in `aspectRatioRange`, resized bilinearly to `size`, flipped horizontally with
+/// probability `0.5` when `flip` is `true`, then gets its brightness shifted by up to
+/// `brightness`, and its contrast and saturation scaled by up to `1 ± contrast` and
+/// `1 ± saturation`. On X10, the whole batch is augmented on the device by a single fused op, so
+/// the host only uploads the raw, typically `UInt8`, images.
+///
+/// - Parameters:
+///   - images: 4-D `Tensor` of shape `[batch, height, width, channels]`, whose integer scalars are
+///     in `0...255`, and floating point ones in `[0, 1]`.
+///   - size: The size of the augmented images.
+///   - seed: The `[2]` seed of the random draws, by default the one of the next random op of the
+///     step.
+/// - Returns: The `[batch, size.newHeight, size.newWidth, channels]` augmented images, in `[0, 1]`.
+/// - Precondition: The images must have rank `4`.
+/// - Precondition: The area and aspect ratio ranges must be positive, and the areas at most `1`.
+public func augmentImages<Scalar: TensorFlowNumeric>(
+  _ images: Tensor<Scalar>,
+  size: (newHeight: Int, newWidth: Int),
+  seed: Tensor<Int32>? = nil,
+  areaRange: ClosedRange<Float> = 0.08...1,
+  aspectRatioRange: ClosedRange<Float> = 0.75...(4.0 / 3.0),
+  flip: Bool = true,
+  brightness: Float = 0,
+  contrast: Float = 0,
+  saturation: Float = 0
+) -> Tensor<Float> {
+  precondition(images.rank == 4, "The images tensor must have rank 4.")
+  precondition(
+    areaRange.lowerBound > 0 && areaRange.upperBound <= 1,
+    "The crop areas must be in (0, 1].")
+  precondition(aspectRatioRange.lowerBound > 0, "The aspect ratios must be positive.")
+  let device = images.device
+  let seed = seed ?? _stepRandomSeed(on: device)
+  switch device.backend {
+  case .XLA:
+    return _RawXLA.augmentImages(
+      images, seeds: seed, outputSize: [Int64(size.newHeight), Int64(size.newWidth)],
+      minArea: areaRange.lowerBound, maxArea: areaRange.upperBound,
+      minAspectRatio: aspectRatioRange.lowerBound, maxAspectRatio: aspectRatioRange.upperBound,
+      flip: flip, brightness: brightness, contrast: contrast, saturation: saturation)
+  case .TF_EAGER:
+    let batchSize = images.shape[0]
+    let height = Float(images.shape[1])
+    let width = Float(images.shape[2])
+    // The columns of the draws are the ones of the fused op: area, aspect ratio, top, left,
+    // flip, brightness, contrast and saturation.
+    let draws = Tensor<Float>(randomUniform: [batchSize, 8], seed: seed, on: device)
+    func draw(_ column: Int, in range: ClosedRange<Float>) -> Tensor<Float> {
+      range.lowerBound + draws[0..., column] * (range.upperBound - range.lowerBound)
+    }
+    let area = draw(0, in: areaRange) * (height * width)
+    // The aspect ratios are log-uniform, so that a ratio and its inverse are as likely.
+    let aspectRatio =
+      aspectRatioRange.lowerBound
+      * pow(aspectRatioRange.upperBound / aspectRatioRange.lowerBound, draws[0..., 1])
+    let cropHeight = min(sqrt(area / aspectRatio), height)
+    let cropWidth = min(sqrt(area * aspectRatio), width)
+    let top = draws[0..., 2] * (height - cropHeight) / height
+    let left = draws[0..., 3] * (width - cropWidth) / width
+    var x1 = left
+    var x2 = left + cropWidth / width
+    if flip {
+      // Crop boxes with their ends swapped sample the columns in reverse order.
+      let flipped = draws[0..., 4] .< 0.5
+      (x1, x2) = (x2.replacing(with: x1, where: flipped), x1.replacing(with: x2, where: flipped))
+    }
+    let boxes = Tensor(stacking: [top, x1, top + cropHeight / height, x2], alongAxis: 1)
+    let scalesBytes = ![
+      Float.tensorFlowDataType, Double.tensorFlowDataType, BFloat16.tensorFlowDataType,
+    ].contains(Scalar.tensorFlowDataType)
+    var pixels = _Raw.cropAndResize(
+      image: images, boxes: boxes,
+      boxInd: Tensor<Int32>(rangeFrom: 0, to: Int32(batchSize), stride: 1, on: device),
+      cropSize: Tensor<Int32>([Int32(size.newHeight), Int32(size.newWidth)], on: device))
+    if scalesBytes {
+      pixels = pixels / 255
+    }
+    let perImage: TensorShape = [batchSize, 1, 1, 1]
+    if brightness > 0 {
+      pixels = pixels + draw(5, in: -brightness...brightness).reshaped(to: perImage)
+    }
+    if contrast > 0 {
+      let mean = pixels.mean(alongAxes: [1, 2, 3])
+      pixels =
+        (pixels - mean) * draw(6, in: (1 - contrast)...(1 + contrast)).reshaped(to: perImage)
+        + mean
+    }
+    if saturation > 0 && images.shape[3] == 3 {
+      let luma = Tensor<Float>([0.299, 0.587, 0.114], on: device)
+      let gray = (pixels * luma).sum(alongAxes: 3)
+      pixels =
+        (pixels - gray) * draw(7, in: (1 - saturation)...(1 + saturation)).reshaped(to: perImage)
+        + gray
+    }
+    return pixels.clipped(min: 0, max: 1)
+  }
+}
@@ -269,6 +269,19 @@ extension Tensor where Scalar: TensorFlowFloatingPoint {
     _Raw.qr(self, fullMatrices: fullMatrices)
   }
 
+  /// Returns the LU decomposition with partial pivoting of each inner matrix in the tensor, a
+  /// tensor `lu` whose strictly lower triangular part holds the unit lower triangular factors `L`
+  /// and whose upper triangular part holds the upper triangular factors `U`, and the row
+  /// permutations `permutation`, such that the rows of `self` taken in the order of `permutation`
+  /// are equal to `matmul(L, U)`.
+  ///
+  /// - Precondition: `self` must be a tensor with shape `[..., M, M]`.
+  @inlinable
+  public func luDecomposition() -> (lu: Tensor<Scalar>, permutation: Tensor<Int32>) {
+    let (lu, permutation): (Tensor<Scalar>, Tensor<Int32>) = _Raw.lu(self)
+    return (lu, permutation)
+  }
+
   /// Returns the singular value decomposition of `self`, given that `self` is an optionally
   /// batched matrix.
   ///
@@ -387,6 +400,69 @@ internal func _vjpTriangularSolve<T: TensorFlowFloatingPoint>(
   return (value, pullback)
 }
 
+/// Returns the solution `x` to the system of linear equations represented by `Ax = b`.
+///
+/// Solving the system directly costs less and loses less precision than multiplying `b` by the
+/// inverse of `A`.
+///
+/// - Parameters:
+///   - matrix: The input square coefficient matrix, representing `A` in `Ax = b`.
+///   - rhs: Right-hand side values, representing `b` in `Ax = b`.
+///   - adjoint: If `true`, solve with the adjoint of `matrix` instead of `matrix`. The default
+///     value is `false`.
+/// - Returns: The solution `x` to the system of linear equations represented by `Ax = b`.
+///   `x` has the same shape as `b`.
+/// - Precondition: `matrix` must be a tensor with shape `[..., M, M]`.
+/// - Precondition: `rhs` must be a tensor with shape `[..., M, K]`.
+@inlinable
+@differentiable(reverse)
+public func solve<T: TensorFlowFloatingPoint>(
+  matrix: Tensor<T>,
+  rhs: Tensor<T>,
+  adjoint: Bool = false
+) -> Tensor<T> {
+  _Raw.matrixSolve(matrix: matrix, rhs: rhs, adjoint: adjoint)
+}
+
+@inlinable
+@derivative(of: solve)
+internal func _vjpSolve<T: TensorFlowFloatingPoint>(
+  matrix: Tensor<T>,
+  rhs: Tensor<T>,
+  adjoint: Bool = false
+) -> (value: Tensor<T>, pullback: (Tensor<T>) -> (Tensor<T>, Tensor<T>)) {
+  let value = solve(matrix: matrix, rhs: rhs, adjoint: adjoint)
+  return (
+    value,
+    { v in
+      let rhsGrad = solve(matrix: matrix, rhs: v, adjoint: !adjoint)
+      let (left, right) = adjoint ? (value, rhsGrad) : (rhsGrad, value)
+      return (-matmul(left, transposed: false, right, transposed: true), rhsGrad)
+    }
+  )
+}
+
+/// Returns the solution `x` to the system of linear equations represented by `Ax = b`, given the
+/// Cholesky decomposition `L` of `A`, as returned by `cholesky(_:)`.
+///
+/// This takes two triangular solves, which is how the systems of symmetric positive definite
+/// matrices, like the covariances of Gaussian processes, are best solved.
+///
+/// - Parameters:
+///   - factor: The lower triangular Cholesky factor `L` of `A`.
+///   - rhs: Right-hand side values, representing `b` in `Ax = b`.
+/// - Precondition: `factor` must be a tensor with shape `[..., M, M]`.
+/// - Precondition: `rhs` must be a tensor with shape `[..., M, K]`.
+@inlinable
+@differentiable(reverse)
+public func choleskySolve<T: TensorFlowFloatingPoint>(
+  cholesky factor: Tensor<T>,
+  rhs: Tensor<T>
+) -> Tensor<T> {
+  let y = triangularSolve(matrix: factor, rhs: rhs, lower: true, adjoint: false)
+  return triangularSolve(matrix: factor, rhs: y, lower: true, adjoint: true)
+}
+
 // MARK: Utilities
 
 /// Returns the leading dimensions of two input shapes, given that that they have the same trailing
@@ -162,6 +162,94 @@ func _vjpConv2D<Scalar: TensorFlowFloatingPoint>(
   )
 }
 
+/// Returns the 2-D convolution of `input` and `filter` plus `bias`, followed by a ReLU when `relu`
+/// is set.
+///
+/// On X10 the convolution, bias and ReLU lower as a single convolution epilogue, which the GPU
+/// backend runs as one cuDNN fused convolution. The pullback is a single node too, and masks the
+/// gradient with the output, so that the result before the bias and activation is never kept.
+///
+/// - Parameters:
+///   - input: The input.
+///   - filter: The convolution filter.
+///   - bias: The bias, along the output channels.
+///   - strides: The strides of the sliding filter for each dimension of the input.
+///   - padding: The padding for the operation
+///   - dilations: The dilation factor for each dimension of the input.
+///   - relu: Whether a ReLU follows the bias.
+/// - Precondition: `input` must have rank `4`.
+/// - Precondition: `filter` must have rank 4.
+@differentiable(reverse, wrt: (input, filter, bias))
+public func conv2DBiasActivation<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>,
+  filter: Tensor<Scalar>,
+  bias: Tensor<Scalar>,
+  strides: (Int, Int, Int, Int) = (1, 1, 1, 1),
+  padding: Padding = .valid,
+  dilations: (Int, Int, Int, Int) = (1, 1, 1, 1),
+  relu: Bool = false
+) -> Tensor<Scalar> {
+  if input.device.backend == .XLA {
+    return _fusedConv2DBiasActivation(
+      input, filter: filter, bias: bias, strides: strides, padding: padding,
+      dilations: dilations, relu: relu)
+  }
+  let output = conv2D(
+    input, filter: filter, strides: strides, padding: padding, dilations: dilations) + bias
+  return relu ? TensorFlow.relu(output) : output
+}
+
+@differentiable(reverse, wrt: (input, filter, bias))
+func _fusedConv2DBiasActivation<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>,
+  filter: Tensor<Scalar>,
+  bias: Tensor<Scalar>,
+  strides: (Int, Int, Int, Int),
+  padding: Padding,
+  dilations: (Int, Int, Int, Int),
+  relu: Bool
+) -> Tensor<Scalar> {
+  precondition(input.shape.rank == 4, "The input must have rank 4.")
+  precondition(filter.shape.rank == 4, "The filter must have rank 4.")
+  return _RawXLA.convBiasActivation(
+    input, filter: filter, bias: bias, relu: relu,
+    strides: [Int64(strides.0), Int64(strides.1), Int64(strides.2), Int64(strides.3)],
+    padding: padding.raw,
+    dilations: [Int64(dilations.0), Int64(dilations.1), Int64(dilations.2), Int64(dilations.3)])
+}
+
+@derivative(of: _fusedConv2DBiasActivation, wrt: (input, filter, bias))
+func _vjpFusedConv2DBiasActivation<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>,
+  filter: Tensor<Scalar>,
+  bias: Tensor<Scalar>,
+  strides: (Int, Int, Int, Int),
+  padding: Padding,
+  dilations: (Int, Int, Int, Int),
+  relu: Bool
+) -> (
+  value: Tensor<Scalar>,
+  pullback: (Tensor<Scalar>) -> (Tensor<Scalar>, Tensor<Scalar>, Tensor<Scalar>)
+) {
+  let strides64 = [Int64(strides.0), Int64(strides.1), Int64(strides.2), Int64(strides.3)]
+  let dilations64 = [
+    Int64(dilations.0), Int64(dilations.1), Int64(dilations.2), Int64(dilations.3),
+  ]
+  let output = _RawXLA.convBiasActivation(
+    input, filter: filter, bias: bias, relu: relu, strides: strides64, padding: padding.raw,
+    dilations: dilations64)
+  return (
+    output,
+    { v in
+      let grads = _RawXLA.convBiasActivationGrad(
+        gradOutput: v, input: input, filter: filter, output: output, relu: relu,
+        strides: strides64, padding: padding.raw, dilations: dilations64)
+      return (grads.input, grads.filter, grads.bias)
+    }
+  )
+}
+
+/// Returns a 2-D transposed convolution with the specified input, filter, strides, and padding.
 /// Returns a 2-D transposed convolution with the specified input, filter, strides, and padding.
 ///
 /// - Parameters:
@@ -1075,3 +1163,315 @@ func _vjpSpaceToDepth<Scalar: TensorFlowFloatingPoint>(
 ) -> (value: Tensor<Scalar>, pullback: (Tensor<Scalar>) -> Tensor<Scalar>) {
   (spaceToDepth(input, blockSize: b), { depthToSpace($0, blockSize: b) })
 }
+
+/// Returns `softmax(scale * matmul(query, key, transposed: true))` multiplied by `value`, for the
+/// `[..., Sq, D]` query, `[..., Sk, D]` key and `[..., Sk, Dv]` value.
+///
+/// On X10 both passes lower to fused nodes which visit the keys in blocks of
+/// `XLA_ATTENTION_BLOCK_SIZE` rows with a running softmax, so the `[..., Sq, Sk]` scores never get
+/// materialized, and the memory grows linearly with the sequence length.
+///
+/// - Parameters:
+///   - scale: The scale of the scores, which defaults to `1 / sqrt(D)`.
+@differentiable(reverse, wrt: (query, key, value))
+public func scaledDotProductAttention<Scalar: TensorFlowFloatingPoint>(
+  query: Tensor<Scalar>,
+  key: Tensor<Scalar>,
+  value: Tensor<Scalar>,
+  scale: Float? = nil
+) -> Tensor<Scalar> {
+  _vjpScaledDotProductAttention(query: query, key: key, value: value, scale: scale).value
+}
+
+@usableFromInline
+func _attentionScale<Scalar: TensorFlowScalar>(_ query: Tensor<Scalar>, _ scale: Float?) -> Float {
+  scale ?? 1 / Float(query.shape[query.rank - 1]).squareRoot()
+}
+
+@usableFromInline
+@differentiable(reverse, wrt: (query, key, value))
+func _unfusedScaledDotProductAttention<Scalar: TensorFlowFloatingPoint>(
+  _ query: Tensor<Scalar>, _ key: Tensor<Scalar>, _ value: Tensor<Scalar>, scale: Float
+) -> Tensor<Scalar> {
+  let scores = matmul(query, transposed: false, key, transposed: true) * Scalar(scale)
+  return matmul(softmax(scores), value)
+}
+
+@usableFromInline
+@derivative(of: scaledDotProductAttention(query:key:value:scale:))
+func _vjpScaledDotProductAttention<Scalar: TensorFlowFloatingPoint>(
+  query: Tensor<Scalar>,
+  key: Tensor<Scalar>,
+  value: Tensor<Scalar>,
+  scale: Float?
+) -> (
+  value: Tensor<Scalar>,
+  pullback: (Tensor<Scalar>) -> (Tensor<Scalar>, Tensor<Scalar>, Tensor<Scalar>)
+) {
+  let scale = _attentionScale(query, scale)
+  switch _Raw.commonBackend([query, key, value]) {
+  case .XLA:
+    let (output, logsumexp) = _RawXLA.scaledDotProductAttention(
+      query: query, key: key, value: value, scale: scale)
+    return (
+      output,
+      { v in
+        let grads = _RawXLA.scaledDotProductAttentionGrad(
+          gradOutput: v, query: query, key: key, value: value, output: output,
+          logsumexp: logsumexp, scale: scale)
+        return (grads.query, grads.key, grads.value)
+      }
+    )
+  case .TF_EAGER:
+    return valueWithPullback(at: query, key, value) { query, key, value in
+      _unfusedScaledDotProductAttention(query, key, value, scale: scale)
+    }
+  }
+}
+
+/// Returns `scaledDotProductAttention(query:key:value:scale:)` over rows which pack many sequences,
+/// where each query row only sees the key rows of its own segment.
+///
+/// The segment ids hold the leading batch dimensions of `query`, followed by the rows, so that the
+/// `[B, S]` ids of `PackedSequenceBatch` mask a `[B, H, S, D]` query. Query rows which share no
+/// segment with any key row get a zero output. The shapes stay the ones of the packed rows, so
+/// the packed batches of an epoch share a single compiled computation.
+///
+/// - Parameters:
+///   - segmentIds: The segment ids of the query rows.
+///   - keySegmentIds: The segment ids of the key rows, which default to `segmentIds`.
+///   - scale: The scale of the scores, which defaults to `1 / sqrt(D)`.
+@differentiable(reverse, wrt: (query, key, value))
+public func scaledDotProductAttention<Scalar: TensorFlowFloatingPoint>(
+  query: Tensor<Scalar>,
+  key: Tensor<Scalar>,
+  value: Tensor<Scalar>,
+  segmentIds: Tensor<Int32>,
+  keySegmentIds: Tensor<Int32>? = nil,
+  scale: Float? = nil
+) -> Tensor<Scalar> {
+  _vjpScaledDotProductAttention(
+    query: query, key: key, value: value, segmentIds: segmentIds,
+    keySegmentIds: keySegmentIds, scale: scale
+  ).value
+}
+
+/// Returns the `[..., Sq, Sk]` mask of the query and key rows in the same segment, with unit
+/// dimensions in place of the batch dimensions of `rank` the segment ids lack.
+@usableFromInline
+func _segmentMask(
+  _ querySegmentIds: Tensor<Int32>, _ keySegmentIds: Tensor<Int32>, rank: Int
+) -> Tensor<Bool> {
+  let mask =
+    querySegmentIds.expandingShape(at: querySegmentIds.rank)
+    .== keySegmentIds.expandingShape(at: keySegmentIds.rank - 1)
+  var shape = mask.shape.dimensions
+  shape.insert(
+    contentsOf: repeatElement(1, count: rank - mask.rank), at: querySegmentIds.rank - 1)
+  return mask.reshaped(to: TensorShape(shape))
+}
+
+@usableFromInline
+@differentiable(reverse, wrt: (query, key, value))
+func _unfusedSegmentedScaledDotProductAttention<Scalar: TensorFlowFloatingPoint>(
+  _ query: Tensor<Scalar>, _ key: Tensor<Scalar>, _ value: Tensor<Scalar>,
+  mask: Tensor<Bool>, scale: Float
+) -> Tensor<Scalar> {
+  let scores = matmul(query, transposed: false, key, transposed: true) * Scalar(scale)
+  let masked = mask.broadcasted(to: scores.shape).elementsLogicalNot()
+  let probs = softmax(
+    scores.replacing(
+      with: Tensor(repeating: -Scalar.greatestFiniteMagnitude, shape: scores.shape),
+      where: masked))
+  // The rows which see no key at all get a zero output, as on X10.
+  return matmul(probs.replacing(with: Tensor(zerosLike: probs), where: masked), value)
+}
+
+@usableFromInline
+@derivative(of: scaledDotProductAttention(query:key:value:segmentIds:keySegmentIds:scale:))
+func _vjpScaledDotProductAttention<Scalar: TensorFlowFloatingPoint>(
+  query: Tensor<Scalar>,
+  key: Tensor<Scalar>,
+  value: Tensor<Scalar>,
+  segmentIds: Tensor<Int32>,
+  keySegmentIds: Tensor<Int32>?,
+  scale: Float?
+) -> (
+  value: Tensor<Scalar>,
+  pullback: (Tensor<Scalar>) -> (Tensor<Scalar>, Tensor<Scalar>, Tensor<Scalar>)
+) {
+  let scale = _attentionScale(query, scale)
+  let keySegmentIds = keySegmentIds ?? segmentIds
+  switch _Raw.commonBackend([query, key, value]) {
+  case .XLA:
+    let (output, logsumexp) = _RawXLA.segmentedScaledDotProductAttention(
+      query: query, key: key, value: value, querySegmentIds: segmentIds,
+      keySegmentIds: keySegmentIds, scale: scale)
+    return (
+      output,
+      { v in
+        let grads = _RawXLA.segmentedScaledDotProductAttentionGrad(
+          gradOutput: v, query: query, key: key, value: value, output: output,
+          logsumexp: logsumexp, querySegmentIds: segmentIds, keySegmentIds: keySegmentIds,
+          scale: scale)
+        return (grads.query, grads.key, grads.value)
+      }
+    )
+  case .TF_EAGER:
+    let mask = _segmentMask(segmentIds, keySegmentIds, rank: query.rank)
+    return valueWithPullback(at: query, key, value) { query, key, value in
+      _unfusedSegmentedScaledDotProductAttention(query, key, value, mask: mask, scale: scale)
+    }
+  }
+}
+
+//===------------------------------------------------------------------------------------------===//
+// Synchronized batch normalization
+//===------------------------------------------------------------------------------------------===//
+
+/// Batch normalizes `input` along `axis` with the statistics of the whole batch over all the
+/// replicas, rather than with the ones of the local replica, then scales it by `scale` and shifts
+/// it by `offset`. Each pass reduces the statistics it needs with a single all-reduce.
+///
+/// The `scale` and `offset` gradients are the ones of the local replica, which get reduced with
+/// the gradients of the other parameters.
+///
+/// Note: Only supported by X10.
+@differentiable(reverse, wrt: (input, scale, offset))
+public func syncBatchNorm<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>,
+  scale: Tensor<Scalar>,
+  offset: Tensor<Scalar>,
+  axis: Int = -1,
+  epsilon: Scalar = 0.001
+) -> Tensor<Scalar> {
+  _RawXLA.syncBatchNorm(
+    input, scale: scale, offset: offset, axis: axis, epsilon: Double(epsilon)
+  ).output
+}
+
+@usableFromInline
+@derivative(of: syncBatchNorm, wrt: (input, scale, offset))
+func _vjpSyncBatchNorm<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>,
+  scale: Tensor<Scalar>,
+  offset: Tensor<Scalar>,
+  axis: Int,
+  epsilon: Scalar
+) -> (
+  value: Tensor<Scalar>,
+  pullback: (Tensor<Scalar>) -> (Tensor<Scalar>, Tensor<Scalar>, Tensor<Scalar>)
+) {
+  let (output, mean, variance) = _RawXLA.syncBatchNorm(
+    input, scale: scale, offset: offset, axis: axis, epsilon: Double(epsilon))
+  return (
+    output,
+    { v in
+      let grads = _RawXLA.syncBatchNormGrad(
+        gradOutput: v, input: input, scale: scale, mean: mean, variance: variance, axis: axis,
+        epsilon: Double(epsilon))
+      return (grads.input, grads.scale, grads.offset)
+    }
+  )
+}
+
+//===------------------------------------------------------------------------------------------===//
+// Mixture of experts
+//===------------------------------------------------------------------------------------------===//
+
+/// Routes the tokens of the `[tokens, experts]` gates to their `k` highest gated experts, as the
+/// `[tokens, k]` experts of the tokens and their positions within the `capacity` slots of the
+/// expert buffers. The top choices of all the tokens get their positions before the second ones,
+/// and so on. The tokens which do not fit get `capacity` as position, and get dropped.
+///
+/// The routing never materializes the `[tokens, experts, capacity]` dispatch masks.
+///
+/// Note: Only supported by X10.
+public func moeRouting<Scalar: TensorFlowFloatingPoint>(
+  gates: Tensor<Scalar>,
+  k: Int,
+  capacity: Int
+) -> (expertIndices: Tensor<Int32>, positions: Tensor<Int32>) {
+  _RawXLA.moeRouting(gates: gates, k: k, capacity: capacity)
+}
+
+/// Scatters the `[tokens, dim]` input, or its `[tokens, k, dim]` per slot rows, into the
+/// `[expertCount, capacity, dim]` buffers of the experts, and exchanges the buffers between the
+/// `replicaCount` replicas, each of which holds `expertCount / replicaCount` experts. The rows
+/// of the result are ordered by source replica, then by local expert.
+///
+/// Note: Only supported by X10.
+@differentiable(reverse, wrt: input)
+public func moeDispatch<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>,
+  expertIndices: Tensor<Int32>,
+  positions: Tensor<Int32>,
+  expertCount: Int,
+  capacity: Int,
+  replicaCount: Int
+) -> Tensor<Scalar> {
+  _RawXLA.moeDispatch(
+    input, expertIndices: expertIndices, positions: positions, expertCount: expertCount,
+    capacity: capacity, splitCount: replicaCount)
+}
+
+@usableFromInline
+@derivative(of: moeDispatch, wrt: input)
+func _vjpMoEDispatch<Scalar: TensorFlowFloatingPoint>(
+  _ input: Tensor<Scalar>,
+  expertIndices: Tensor<Int32>,
+  positions: Tensor<Int32>,
+  expertCount: Int,
+  capacity: Int,
+  replicaCount: Int
+) -> (value: Tensor<Scalar>, pullback: (Tensor<Scalar>) -> Tensor<Scalar>) {
+  let value = moeDispatch(
+    input, expertIndices: expertIndices, positions: positions, expertCount: expertCount,
+    capacity: capacity, replicaCount: replicaCount)
+  return (
+    value,
+    { v in
+      let slots = _RawXLA.moeCombine(
+        v, expertIndices: expertIndices, positions: positions, splitCount: replicaCount)
+      return input.rank == 2 ? slots.sum(squeezingAxes: 1) : slots
+    }
+  )
+}
+
+/// The inverse of `moeDispatch`: returns the `[expertCount, capacity, dim]` expert outputs to the
+/// replicas of their tokens, as `[tokens, k, dim]` rows, which are zero for the dropped tokens.
+/// Weighting the rows by the gates of their experts and summing them gives the layer output.
+///
+/// Note: Only supported by X10.
+@differentiable(reverse, wrt: expertOutputs)
+public func moeCombine<Scalar: TensorFlowFloatingPoint>(
+  _ expertOutputs: Tensor<Scalar>,
+  expertIndices: Tensor<Int32>,
+  positions: Tensor<Int32>,
+  replicaCount: Int
+) -> Tensor<Scalar> {
+  _RawXLA.moeCombine(
+    expertOutputs, expertIndices: expertIndices, positions: positions, splitCount: replicaCount)
+}
+
+@usableFromInline
+@derivative(of: moeCombine, wrt: expertOutputs)
+func _vjpMoECombine<Scalar: TensorFlowFloatingPoint>(
+  _ expertOutputs: Tensor<Scalar>,
+  expertIndices: Tensor<Int32>,
+  positions: Tensor<Int32>,
+  replicaCount: Int
+) -> (value: Tensor<Scalar>, pullback: (Tensor<Scalar>) -> Tensor<Scalar>) {
+  let value = moeCombine(
+    expertOutputs, expertIndices: expertIndices, positions: positions,
+    replicaCount: replicaCount)
+  return (
+    value,
+    { v in
+      _RawXLA.moeDispatch(
+        v, expertIndices: expertIndices, positions: positions,
+        expertCount: expertOutputs.shape[0], capacity: expertOutputs.shape[1],
+        splitCount: replicaCount)
+    }
+  )
+}
@@ -0,0 +1,151 @@
+// Copyright 2020 The TensorFlow Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if canImport(Differentiation)
+import Differentiation
+#else
+import _Differentiation
+#endif
+
+/// A sparse tensor in coordinate (COO) format, with room for a fixed number of entries.
+///
+/// Entry `i` holds `values[i]` at the position `indices[i]` of the dense tensor. The capacity is
+/// part of the shapes of `indices` and `values`, so that every batch of sparse features traces to
+/// the same X10 graph whatever its number of entries, and the unused entries hold zeros at
+/// position zero, which leave the sums of the operations untouched. Repeated positions add up.
+///
+/// The operations cost memory and compute in proportion to the capacity rather than to the dense
+/// shape: on X10, they lower to gathers and to the segment sums of `UnsortedSegmentReduce`.
+public struct SparseTensor<Scalar: TensorFlowNumeric> {
+  /// The `[capacity, rank]` positions of the entries in the dense tensor.
+  public var indices: Tensor<Int32>
+
+  /// The `[capacity]` values of the entries.
+  public var values: Tensor<Scalar>
+
+  /// The shape of the dense tensor.
+  public var denseShape: TensorShape
+
+  /// Creates a sparse tensor of the entries `values` at the positions `indices`.
+  public init(indices: Tensor<Int32>, values: Tensor<Scalar>, denseShape: TensorShape) {
+    precondition(
+      indices.rank == 2 && values.rank == 1 && indices.shape[0] == values.shape[0]
+        && indices.shape[1] == denseShape.rank,
+      "The indices must be [capacity, \(denseShape.rank)] and the values [capacity].")
+    self.indices = indices
+    self.values = values
+    self.denseShape = denseShape
+  }
+
+  /// Creates a sparse tensor on `device` of the entries `values` at the positions `indices`,
+  /// padded with unused entries up to `capacity`.
+  public init(
+    indices: [[Int]], values: [Scalar], denseShape: TensorShape, capacity: Int,
+    on device: Device = .default
+  ) {
+    precondition(indices.count == values.count, "There must be a position for each value.")
+    precondition(
+      values.count <= capacity, "\(values.count) entries exceed the capacity \(capacity).")
+    precondition(
+      indices.allSatisfy { $0.count == denseShape.rank }, "The positions must have rank entries.")
+    let padding = capacity - values.count
+    let flatIndices =
+      indices.joined().map { Int32($0) } + Array(repeating: 0, count: padding * denseShape.rank)
+    self.init(
+      indices: Tensor(shape: [capacity, denseShape.rank], scalars: flatIndices, on: device),
+      values: Tensor(
+        shape: [capacity], scalars: values + Array(repeating: 0, count: padding), on: device),
+      denseShape: denseShape)
+  }
+
+  /// The number of entries the tensor has room for.
+  public var capacity: Int { values.shape[0] }
+
+  /// Returns the `[capacity]` positions of the entries in the row-major order of the dense tensor.
+  func linearIndices() -> Tensor<Int32> {
+    var strides = [Int32](repeating: 1, count: denseShape.rank)
+    for axis in stride(from: denseShape.rank - 2, through: 0, by: -1) {
+      strides[axis] = strides[axis + 1] * Int32(denseShape[axis + 1])
+    }
+    return (indices * Tensor(strides, on: indices.device)).sum(squeezingAxes: 1)
+  }
+
+  /// Returns the dense tensor.
+  public func densified() -> Tensor<Scalar> {
+    _Raw.unsortedSegmentSum(
+      data: values, segmentIds: linearIndices(), numSegments: denseShape.contiguousSize
+    ).reshaped(to: denseShape)
+  }
+
+  /// Returns the `[denseShape[0]]` sums of the values of each row, as a single segment sum.
+  public func rowSums() -> Tensor<Scalar> {
+    _Raw.unsortedSegmentSum(data: values, segmentIds: rows, numSegments: denseShape[0])
+  }
+}
+
+extension SparseTensor {
+  /// The `[capacity]` rows of the entries of a matrix.
+  var rows: Tensor<Int32> {
+    indices.slice(lowerBounds: [0, 0], sizes: [capacity, 1]).reshaped(to: [capacity])
+  }
+
+  /// The `[capacity]` columns of the entries of a matrix.
+  var columns: Tensor<Int32> {
+    indices.slice(lowerBounds: [0, 1], sizes: [capacity, 1]).reshaped(to: [capacity])
+  }
+}
+
+/// Returns the product of the sparse `[M, K]` matrix `lhs` and the dense `[K, N]` matrix `rhs`.
+///
+/// The rows of `rhs` picked by the entries get scaled by their values and summed into the rows of
+/// the result, so the cost is proportional to the capacity of `lhs` times `N`. The gradient of
+/// `rhs` is a segment sum as well, see `matmulWithSparsePullback(_:_:)` to keep it sparse.
+@differentiable(reverse, wrt: rhs)
+public func matmul<Scalar: TensorFlowFloatingPoint>(
+  _ lhs: SparseTensor<Scalar>, _ rhs: Tensor<Scalar>
+) -> Tensor<Scalar> {
+  precondition(lhs.denseShape.rank == 2 && rhs.rank == 2, "The operands must be matrices.")
+  precondition(
+    lhs.denseShape[1] == rhs.shape[0],
+    "The shapes \(lhs.denseShape) and \(rhs.shape) cannot be multiplied.")
+  return _Raw.unsortedSegmentSum(
+    data: rhs.gathering(atIndices: lhs.columns) * lhs.values.expandingShape(at: 1),
+    segmentIds: lhs.rows, numSegments: lhs.denseShape[0])
+}
+
+@derivative(of: matmul, wrt: rhs)
+func _vjpMatmul<Scalar: TensorFlowFloatingPoint>(
+  _ lhs: SparseTensor<Scalar>, _ rhs: Tensor<Scalar>
+) -> (value: Tensor<Scalar>, pullback: (Tensor<Scalar>) -> Tensor<Scalar>) {
+  let (value, pullback) = matmulWithSparsePullback(lhs, rhs)
+  let rowCount = rhs.shape[0]
+  return (value, { pullback($0).densified(rowCount: rowCount) })
+}
+
+/// Returns the product of the sparse `[M, K]` matrix `lhs` and the dense `[K, N]` matrix `rhs`,
+/// along with a pullback which returns the gradient of `rhs` as the rows the entries of `lhs`
+/// touch, instead of a dense matrix mostly made of zeros.
+public func matmulWithSparsePullback<Scalar: TensorFlowFloatingPoint>(
+  _ lhs: SparseTensor<Scalar>, _ rhs: Tensor<Scalar>
+) -> (value: Tensor<Scalar>, pullback: (Tensor<Scalar>) -> SparseRows<Scalar>) {
+  let value = matmul(lhs, rhs)
+  return (
+    value,
+    { seed in
+      SparseRows(
+        indices: lhs.columns,
+        values: seed.gathering(atIndices: lhs.rows) * lhs.values.expandingShape(at: 1))
+    }
+  )
+}
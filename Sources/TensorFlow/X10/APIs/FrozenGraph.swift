@@ -0,0 +1 @@
+../../../x10/swift_bindings/apis/FrozenGraph.swift
\ No newline at end of file
@@ -0,0 +1 @@
+../../../x10/swift_bindings/apis/TrainingBenchmark.swift
\ No newline at end of file
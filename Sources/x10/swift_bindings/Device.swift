@@ -161,6 +161,15 @@ public struct Device {
     }
   }
 
+  /// Replaces the replication devices at a step barrier, as when a host left the pool, and drops
+  /// the computations compiled for the previous replication devices, while keeping the single
+  /// device ones.
+  public static func resetReplicationDevices(_ devices: [Device]) {
+    devices.withDeviceList { deviceList in
+      x10_device_wrapper.resetReplicationDevices(&deviceList)
+    }
+  }
+
   public static func getReplicationDevices() -> [Device] {
     let handle = x10_device_wrapper.getReplicationDevices()!
     return deviceListToArray(DeviceListHandle(_handle: handle))
@@ -172,6 +181,23 @@ public struct Device {
     }
   }
 
+  /// Compiles all the computations recorded within the manifest folder at `manifestPath`
+  /// (written by a process running with `XLA_RECORD_COMPILE_MANIFEST` set), so that the
+  /// first execution of the recorded graphs does not pay the compilation cost.
+  public static func warmupCompilationCache(manifestPath: String) {
+    x10_device_wrapper.warmupCompilationCache(manifestPath)
+  }
+
+  /// Sets the step seed of the random ops on `device`, or on all the devices if `nil`, which the
+  /// seeds of the following steps derive from when `XLA_STEP_RNG` is set.
+  public static func setRandomSeed(_ seed: UInt64, on device: Device? = nil) {
+    if var cdevice = device?.cdevice {
+      x10_device_wrapper.setRngSeed(&cdevice, seed)
+    } else {
+      x10_device_wrapper.setRngSeed(nil, seed)
+    }
+  }
+
   private static func deviceListToArray(_ deviceList: DeviceListHandle) -> [Device] {
     return (0..<deviceList.handle.pointee.count).map { i in
       let device = deviceList.handle.pointee.devices[i]
@@ -228,7 +254,9 @@ extension CDevice {
 }
 
 /// LazyTensorBarrier ensures all live tensors (on device if provided) are scheduled and running.
-/// If wait is set to true, this call blocks until the computation is complete.
+/// If wait is set to true, this call blocks until the computation is complete. The tensors created
+/// from host data get uploaded together, but for the scalars never used yet, which get uploaded
+/// when first used.
 public func LazyTensorBarrier(on device: Device? = nil, devices: [Device] = [], wait: Bool = false)
 {
   if device == Device.defaultTFEager { return }
@@ -241,3 +269,13 @@ public func LazyTensorBarrier(on device: Device? = nil, devices: [Device] = [],
     }
   }
 }
+
+/// Runs `body` with the IR it traces tagged with the `name` scope, nested within the current one.
+/// The scopes show up in the HLO metadata, and with `XLA_OUTLINE_SCOPE_DEPTH` set, the scopes which
+/// repeat with the same structure (like the layers of a deep model) are lowered once, as a
+/// computation called by every repetition.
+public func withXLAScope<Result>(_ name: String, _ body: () throws -> Result) rethrows -> Result {
+  x10_device_wrapper.pushIrScope(name)
+  defer { x10_device_wrapper.popIrScope() }
+  return try body()
+}
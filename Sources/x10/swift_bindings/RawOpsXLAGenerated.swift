@@ -125,6 +125,32 @@ extension _RawXLA {
     return Tensor(_xlaHandle: XLATensor_atanh(input.xlaHandle))
   }
 
+  static func augment_images<
+    T: TensorFlowNumeric
+  >(
+    _ images: Tensor<T>,
+    seeds: Tensor<Int32>,
+    outputSize: [Int64],
+    minArea: Float,
+    maxArea: Float,
+    minAspectRatio: Float,
+    maxAspectRatio: Float,
+    flip: Bool,
+    brightness: Float,
+    contrast: Float,
+    saturation: Float
+  ) -> Tensor<Float> {
+    defer { _fixLifetime(images) }
+    defer { _fixLifetime(seeds) }
+    checkSameDevice(images.device, seeds.device)
+    return outputSize.withArrayRef { outputSize in
+      return Tensor(
+        _xlaHandle: XLATensor_augment_images(
+          images.xlaHandle, seeds.xlaHandle, outputSize, minArea, maxArea, minAspectRatio,
+          maxAspectRatio, flip, brightness, contrast, saturation))
+    }
+  }
+
   public static func broadcast_tensors<
     T: TensorFlowScalar
   >(
@@ -139,6 +165,29 @@ extension _RawXLA {
     return (Tensor(_xlaHandle: tuple_output.x), Tensor(_xlaHandle: tuple_output.y))
   }
 
+  static func cached_attention<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    query: Tensor<T>,
+    keyCache: Tensor<T>,
+    valueCache: Tensor<T>,
+    length: Tensor<Int32>,
+    scale: Float
+  ) -> Tensor<T> {
+    defer { _fixLifetime(query) }
+    defer { _fixLifetime(keyCache) }
+    defer { _fixLifetime(valueCache) }
+    defer { _fixLifetime(length) }
+    checkSameDevice(query.device, keyCache.device)
+    checkSamePrecision(query, keyCache)
+    checkSameDevice(query.device, valueCache.device)
+    checkSamePrecision(query, valueCache)
+    checkSameDevice(query.device, length.device)
+    return Tensor(
+      _xlaHandle: XLATensor_cached_attention(
+        query.xlaHandle, keyCache.xlaHandle, valueCache.xlaHandle, length.xlaHandle, scale))
+  }
+
   public static func concat<
     T: TensorFlowScalar
   >(
@@ -159,6 +208,28 @@ extension _RawXLA {
     return Tensor(_xlaHandle: XLATensor_ceil(input.xlaHandle))
   }
 
+  public static func cholesky<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    _ input: Tensor<T>
+  ) -> Tensor<T> {
+    defer { _fixLifetime(input) }
+    return Tensor(_xlaHandle: XLATensor_cholesky(input.xlaHandle))
+  }
+
+  public static func choleskyGrad<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    l: Tensor<T>,
+    grad: Tensor<T>
+  ) -> Tensor<T> {
+    defer { _fixLifetime(l) }
+    defer { _fixLifetime(grad) }
+    checkSameDevice(l.device, grad.device)
+    checkSamePrecision(l, grad)
+    return Tensor(_xlaHandle: XLATensor_cholesky_grad(l.xlaHandle, grad.xlaHandle))
+  }
+
   public static func clipByValue<
     T: TensorFlowNumeric
   >(
@@ -232,6 +303,24 @@ extension _RawXLA {
     return Tensor(_xlaHandle: XLATensor_cumsum(input.xlaHandle, dim, exclusive, reverse))
   }
 
+  static func dequantize_tensor<
+    T: TensorFlowInteger
+  >(
+    _ input: Tensor<T>,
+    scale: Tensor<Float>,
+    zeroPoint: Tensor<Int32>,
+    axis: Int64
+  ) -> Tensor<Float> {
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(scale) }
+    defer { _fixLifetime(zeroPoint) }
+    checkSameDevice(input.device, scale.device)
+    checkSameDevice(input.device, zeroPoint.device)
+    return Tensor(
+      _xlaHandle: XLATensor_dequantize(
+        input.xlaHandle, scale.xlaHandle, zeroPoint.xlaHandle, axis))
+  }
+
   public static func diagonal_value<
     T: TensorFlowNumeric
   >(
@@ -290,6 +379,25 @@ extension _RawXLA {
     }
   }
 
+  static func embedding_sparse_update<
+    T: TensorFlowNumeric,
+    Ti: TensorFlowIndex
+  >(
+    _ table: Tensor<T>,
+    indices: Tensor<Ti>,
+    values: Tensor<T>
+  ) -> Tensor<T> {
+    defer { _fixLifetime(table) }
+    defer { _fixLifetime(indices) }
+    defer { _fixLifetime(values) }
+    checkSameDevice(table.device, indices.device)
+    checkSameDevice(table.device, values.device)
+    checkSamePrecision(table, values)
+    return Tensor(
+      _xlaHandle: XLATensor_embedding_sparse_update(
+        table.xlaHandle, indices.xlaHandle, values.xlaHandle))
+  }
+
   public static func eq<
     T: TensorFlowScalar
   >(
@@ -421,6 +529,62 @@ extension _RawXLA {
     return Tensor(_xlaHandle: XLATensor_is_nan(input.xlaHandle))
   }
 
+  static func layer_norm<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    _ input: Tensor<T>,
+    weight: Tensor<T>,
+    bias: Tensor<T>,
+    dim: Int64,
+    eps: Float
+  ) -> (Tensor<T>, Tensor<T>, Tensor<T>) {
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(weight) }
+    defer { _fixLifetime(bias) }
+    checkSameDevice(input.device, weight.device)
+    checkSamePrecision(input, weight)
+    checkSameDevice(input.device, bias.device)
+    checkSamePrecision(input, bias)
+    let tuple_output = XLATensor_layer_norm(
+      input.xlaHandle, weight.xlaHandle, bias.xlaHandle, dim, eps)
+    return (
+      Tensor(_xlaHandle: tuple_output.v0), Tensor(_xlaHandle: tuple_output.v1),
+      Tensor(_xlaHandle: tuple_output.v2)
+    )
+  }
+
+  static func layer_norm_backward<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    gradOutput: Tensor<T>,
+    input: Tensor<T>,
+    weight: Tensor<T>,
+    mean: Tensor<T>,
+    invstd: Tensor<T>,
+    dim: Int64
+  ) -> (Tensor<T>, Tensor<T>, Tensor<T>) {
+    defer { _fixLifetime(gradOutput) }
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(weight) }
+    defer { _fixLifetime(mean) }
+    defer { _fixLifetime(invstd) }
+    checkSameDevice(gradOutput.device, input.device)
+    checkSamePrecision(gradOutput, input)
+    checkSameDevice(gradOutput.device, weight.device)
+    checkSamePrecision(gradOutput, weight)
+    checkSameDevice(gradOutput.device, mean.device)
+    checkSamePrecision(gradOutput, mean)
+    checkSameDevice(gradOutput.device, invstd.device)
+    checkSamePrecision(gradOutput, invstd)
+    let tuple_output = XLATensor_layer_norm_backward(
+      gradOutput.xlaHandle, input.xlaHandle, weight.xlaHandle, mean.xlaHandle, invstd.xlaHandle,
+      dim)
+    return (
+      Tensor(_xlaHandle: tuple_output.v0), Tensor(_xlaHandle: tuple_output.v1),
+      Tensor(_xlaHandle: tuple_output.v2)
+    )
+  }
+
   public static func lessEqual<
     T: TensorFlowNumeric
   >(
@@ -530,6 +694,16 @@ extension _RawXLA {
     return Tensor(_xlaHandle: XLATensor_lt(lhs.xlaHandle, rhs.xlaHandle))
   }
 
+  public static func lu<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    _ input: Tensor<T>
+  ) -> (Tensor<T>, Tensor<Int32>) {
+    defer { _fixLifetime(input) }
+    let tuple_output = XLATensor_lu(input.xlaHandle)
+    return (Tensor(_xlaHandle: tuple_output.x), Tensor(_xlaHandle: tuple_output.y))
+  }
+
   public static func matmul<
     T: TensorFlowNumeric
   >(
@@ -652,6 +826,32 @@ extension _RawXLA {
     return Tensor(_xlaHandle: XLATensor_neg(input.xlaHandle))
   }
 
+  static func non_max_suppression<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    boxes: Tensor<T>,
+    scores: Tensor<T>,
+    scoreThreshold: Tensor<T>,
+    iouThreshold: Tensor<T>,
+    outputSize: Int64,
+    preNmsTopK: Int64
+  ) -> (Tensor<Int32>, Tensor<Int32>) {
+    defer { _fixLifetime(boxes) }
+    defer { _fixLifetime(scores) }
+    defer { _fixLifetime(scoreThreshold) }
+    defer { _fixLifetime(iouThreshold) }
+    checkSameDevice(boxes.device, scores.device)
+    checkSamePrecision(boxes, scores)
+    checkSameDevice(boxes.device, scoreThreshold.device)
+    checkSamePrecision(boxes, scoreThreshold)
+    checkSameDevice(boxes.device, iouThreshold.device)
+    checkSamePrecision(boxes, iouThreshold)
+    let tuple_output = XLATensor_non_max_suppression(
+      boxes.xlaHandle, scores.xlaHandle, scoreThreshold.xlaHandle, iouThreshold.xlaHandle,
+      outputSize, preNmsTopK)
+    return (Tensor(_xlaHandle: tuple_output.x), Tensor(_xlaHandle: tuple_output.y))
+  }
+
   public static func permute<
     T: TensorFlowScalar
   >(
@@ -711,6 +911,60 @@ extension _RawXLA {
     return (Tensor(_xlaHandle: tuple_output.x), Tensor(_xlaHandle: tuple_output.y))
   }
 
+  static func quantize_tensor<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    _ input: Tensor<T>,
+    scale: Tensor<Float>,
+    zeroPoint: Tensor<Int32>,
+    axis: Int64
+  ) -> Tensor<Int8> {
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(scale) }
+    defer { _fixLifetime(zeroPoint) }
+    checkSameDevice(input.device, scale.device)
+    checkSameDevice(input.device, zeroPoint.device)
+    return Tensor(
+      _xlaHandle: XLATensor_quantize(
+        input.xlaHandle, scale.xlaHandle, zeroPoint.xlaHandle, axis))
+  }
+
+  static func quantized_conv(
+    _ input: Tensor<Int8>,
+    _ filter: Tensor<Int8>,
+    _ strides: [Int64],
+    _ padding: TFPadding,
+    _ explicit_paddings: [Int64],
+    _ data_format: TFDataFormat,
+    _ dilations: [Int64]
+  ) -> Tensor<Int32> {
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(filter) }
+    checkSameDevice(input.device, filter.device)
+    checkSamePrecision(input, filter)
+    return strides.withArrayRef { strides in
+      return explicit_paddings.withArrayRef { explicit_paddings in
+        return dilations.withArrayRef { dilations in
+          return Tensor(
+            _xlaHandle: XLATensor_quantized_conv(
+              input.xlaHandle, filter.xlaHandle, strides, padding, explicit_paddings, data_format,
+              dilations))
+        }
+      }
+    }
+  }
+
+  static func quantized_matmul(
+    _ lhs: Tensor<Int8>,
+    _ rhs: Tensor<Int8>
+  ) -> Tensor<Int32> {
+    defer { _fixLifetime(lhs) }
+    defer { _fixLifetime(rhs) }
+    checkSameDevice(lhs.device, rhs.device)
+    checkSamePrecision(lhs, rhs)
+    return Tensor(_xlaHandle: XLATensor_quantized_matmul(lhs.xlaHandle, rhs.xlaHandle))
+  }
+
   public static func relu<
     T: TensorFlowNumeric
   >(
@@ -745,6 +999,23 @@ extension _RawXLA {
     }
   }
 
+  static func requantize_tensor(
+    _ input: Tensor<Int32>,
+    scale: Tensor<Float>,
+    zeroPoint: Tensor<Int32>,
+    axis: Int64
+  ) -> Tensor<Int8> {
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(scale) }
+    defer { _fixLifetime(zeroPoint) }
+    checkSameDevice(input.device, scale.device)
+    checkSameDevice(input.device, zeroPoint.device)
+    checkSamePrecision(input, zeroPoint)
+    return Tensor(
+      _xlaHandle: XLATensor_requantize(
+        input.xlaHandle, scale.xlaHandle, zeroPoint.xlaHandle, axis))
+  }
+
   public static func resize_value<
     T: TensorFlowScalar
   >(
@@ -757,6 +1028,46 @@ extension _RawXLA {
     }
   }
 
+  static func rms_norm<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    _ input: Tensor<T>,
+    weight: Tensor<T>,
+    dim: Int64,
+    eps: Float
+  ) -> (Tensor<T>, Tensor<T>) {
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(weight) }
+    checkSameDevice(input.device, weight.device)
+    checkSamePrecision(input, weight)
+    let tuple_output = XLATensor_rms_norm(input.xlaHandle, weight.xlaHandle, dim, eps)
+    return (Tensor(_xlaHandle: tuple_output.x), Tensor(_xlaHandle: tuple_output.y))
+  }
+
+  static func rms_norm_backward<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    gradOutput: Tensor<T>,
+    input: Tensor<T>,
+    weight: Tensor<T>,
+    invrms: Tensor<T>,
+    dim: Int64
+  ) -> (Tensor<T>, Tensor<T>) {
+    defer { _fixLifetime(gradOutput) }
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(weight) }
+    defer { _fixLifetime(invrms) }
+    checkSameDevice(gradOutput.device, input.device)
+    checkSamePrecision(gradOutput, input)
+    checkSameDevice(gradOutput.device, weight.device)
+    checkSamePrecision(gradOutput, weight)
+    checkSameDevice(gradOutput.device, invrms.device)
+    checkSamePrecision(gradOutput, invrms)
+    let tuple_output = XLATensor_rms_norm_backward(
+      gradOutput.xlaHandle, input.xlaHandle, weight.xlaHandle, invrms.xlaHandle, dim)
+    return (Tensor(_xlaHandle: tuple_output.x), Tensor(_xlaHandle: tuple_output.y))
+  }
+
   public static func round<
     T: TensorFlowNumeric
   >(
@@ -775,6 +1086,131 @@ extension _RawXLA {
     return Tensor(_xlaHandle: XLATensor_rsqrt(input.xlaHandle))
   }
 
+  static func scaled_dot_product_attention<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    query: Tensor<T>,
+    key: Tensor<T>,
+    value: Tensor<T>,
+    scale: Float
+  ) -> (Tensor<T>, Tensor<T>) {
+    defer { _fixLifetime(query) }
+    defer { _fixLifetime(key) }
+    defer { _fixLifetime(value) }
+    checkSameDevice(query.device, key.device)
+    checkSamePrecision(query, key)
+    checkSameDevice(query.device, value.device)
+    checkSamePrecision(query, value)
+    let tuple_output = XLATensor_scaled_dot_product_attention(
+      query.xlaHandle, key.xlaHandle, value.xlaHandle, scale)
+    return (Tensor(_xlaHandle: tuple_output.x), Tensor(_xlaHandle: tuple_output.y))
+  }
+
+  static func scaled_dot_product_attention_grad<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    gradOutput: Tensor<T>,
+    query: Tensor<T>,
+    key: Tensor<T>,
+    value: Tensor<T>,
+    output: Tensor<T>,
+    logsumexp: Tensor<T>,
+    scale: Float
+  ) -> (Tensor<T>, Tensor<T>, Tensor<T>) {
+    defer { _fixLifetime(gradOutput) }
+    defer { _fixLifetime(query) }
+    defer { _fixLifetime(key) }
+    defer { _fixLifetime(value) }
+    defer { _fixLifetime(output) }
+    defer { _fixLifetime(logsumexp) }
+    checkSameDevice(gradOutput.device, query.device)
+    checkSamePrecision(gradOutput, query)
+    checkSameDevice(gradOutput.device, key.device)
+    checkSamePrecision(gradOutput, key)
+    checkSameDevice(gradOutput.device, value.device)
+    checkSamePrecision(gradOutput, value)
+    checkSameDevice(gradOutput.device, output.device)
+    checkSamePrecision(gradOutput, output)
+    checkSameDevice(gradOutput.device, logsumexp.device)
+    checkSamePrecision(gradOutput, logsumexp)
+    let tuple_output = XLATensor_scaled_dot_product_attention_grad(
+      gradOutput.xlaHandle, query.xlaHandle, key.xlaHandle, value.xlaHandle, output.xlaHandle,
+      logsumexp.xlaHandle, scale)
+    return (
+      Tensor(_xlaHandle: tuple_output.v0), Tensor(_xlaHandle: tuple_output.v1),
+      Tensor(_xlaHandle: tuple_output.v2)
+    )
+  }
+
+  static func segmented_scaled_dot_product_attention<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    query: Tensor<T>,
+    key: Tensor<T>,
+    value: Tensor<T>,
+    querySegmentIds: Tensor<Int32>,
+    keySegmentIds: Tensor<Int32>,
+    scale: Float
+  ) -> (Tensor<T>, Tensor<T>) {
+    defer { _fixLifetime(query) }
+    defer { _fixLifetime(key) }
+    defer { _fixLifetime(value) }
+    defer { _fixLifetime(querySegmentIds) }
+    defer { _fixLifetime(keySegmentIds) }
+    checkSameDevice(query.device, key.device)
+    checkSamePrecision(query, key)
+    checkSameDevice(query.device, value.device)
+    checkSamePrecision(query, value)
+    checkSameDevice(query.device, querySegmentIds.device)
+    checkSameDevice(query.device, keySegmentIds.device)
+    let tuple_output = XLATensor_segmented_scaled_dot_product_attention(
+      query.xlaHandle, key.xlaHandle, value.xlaHandle, querySegmentIds.xlaHandle,
+      keySegmentIds.xlaHandle, scale)
+    return (Tensor(_xlaHandle: tuple_output.x), Tensor(_xlaHandle: tuple_output.y))
+  }
+
+  static func segmented_scaled_dot_product_attention_grad<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    gradOutput: Tensor<T>,
+    query: Tensor<T>,
+    key: Tensor<T>,
+    value: Tensor<T>,
+    output: Tensor<T>,
+    logsumexp: Tensor<T>,
+    querySegmentIds: Tensor<Int32>,
+    keySegmentIds: Tensor<Int32>,
+    scale: Float
+  ) -> (Tensor<T>, Tensor<T>, Tensor<T>) {
+    defer { _fixLifetime(gradOutput) }
+    defer { _fixLifetime(query) }
+    defer { _fixLifetime(key) }
+    defer { _fixLifetime(value) }
+    defer { _fixLifetime(output) }
+    defer { _fixLifetime(logsumexp) }
+    defer { _fixLifetime(querySegmentIds) }
+    defer { _fixLifetime(keySegmentIds) }
+    checkSameDevice(gradOutput.device, query.device)
+    checkSamePrecision(gradOutput, query)
+    checkSameDevice(gradOutput.device, key.device)
+    checkSamePrecision(gradOutput, key)
+    checkSameDevice(gradOutput.device, value.device)
+    checkSamePrecision(gradOutput, value)
+    checkSameDevice(gradOutput.device, output.device)
+    checkSamePrecision(gradOutput, output)
+    checkSameDevice(gradOutput.device, logsumexp.device)
+    checkSamePrecision(gradOutput, logsumexp)
+    checkSameDevice(gradOutput.device, querySegmentIds.device)
+    checkSameDevice(gradOutput.device, keySegmentIds.device)
+    let tuple_output = XLATensor_segmented_scaled_dot_product_attention_grad(
+      gradOutput.xlaHandle, query.xlaHandle, key.xlaHandle, value.xlaHandle, output.xlaHandle,
+      logsumexp.xlaHandle, querySegmentIds.xlaHandle, keySegmentIds.xlaHandle, scale)
+    return (
+      Tensor(_xlaHandle: tuple_output.v0), Tensor(_xlaHandle: tuple_output.v1),
+      Tensor(_xlaHandle: tuple_output.v2)
+    )
+  }
+
   public static func select<
     T: TensorFlowScalar
   >(
@@ -845,6 +1281,35 @@ extension _RawXLA {
     return Tensor(_xlaHandle: XLATensor_softmax(input.xlaHandle, dim))
   }
 
+  public static func solve<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    matrix: Tensor<T>,
+    rhs: Tensor<T>,
+    adjoint: Bool
+  ) -> Tensor<T> {
+    defer { _fixLifetime(matrix) }
+    defer { _fixLifetime(rhs) }
+    checkSameDevice(matrix.device, rhs.device)
+    checkSamePrecision(matrix, rhs)
+    return Tensor(_xlaHandle: XLATensor_solve(matrix.xlaHandle, rhs.xlaHandle, adjoint))
+  }
+
+  static func sparse_softmax_cross_entropy<
+    T: FloatingPoint & TensorFlowScalar,
+    Tlabels: TensorFlowIndex
+  >(
+    features: Tensor<T>,
+    labels: Tensor<Tlabels>
+  ) -> (Tensor<T>, Tensor<T>) {
+    defer { _fixLifetime(features) }
+    defer { _fixLifetime(labels) }
+    checkSameDevice(features.device, labels.device)
+    let tuple_output = XLATensor_sparse_softmax_cross_entropy(
+      features.xlaHandle, labels.xlaHandle)
+    return (Tensor(_xlaHandle: tuple_output.x), Tensor(_xlaHandle: tuple_output.y))
+  }
+
   public static func sqrt<
     T: FloatingPoint & TensorFlowScalar
   >(
@@ -1153,6 +1618,22 @@ extension _RawXLA {
     return (Tensor(_xlaHandle: tuple_output.x), Tensor(_xlaHandle: tuple_output.y))
   }
 
+  public static func triangularSolve<
+    T: FloatingPoint & TensorFlowScalar
+  >(
+    matrix: Tensor<T>,
+    rhs: Tensor<T>,
+    lower: Bool,
+    adjoint: Bool
+  ) -> Tensor<T> {
+    defer { _fixLifetime(matrix) }
+    defer { _fixLifetime(rhs) }
+    checkSameDevice(matrix.device, rhs.device)
+    checkSamePrecision(matrix, rhs)
+    return Tensor(
+      _xlaHandle: XLATensor_triangular_solve(matrix.xlaHandle, rhs.xlaHandle, lower, adjoint))
+  }
+
   static func truncatedNormal<
     T: FloatingPoint & TensorFlowScalar
   >(
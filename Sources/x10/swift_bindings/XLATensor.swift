@@ -52,6 +52,8 @@ struct XLATensor {
     deinit { destroyTensor(handle) }
 
     let handle: UnsafeMutablePointer<OpaqueXLATensor>
+    /// The shape of a tensor never changes, so it is only fetched on the first query.
+    lazy var dimensions: [Int] = XLATensor.fetchShape(handle)
     var xlaTensor: XLATensor { XLATensor(self) }
 
     var _tfeTensorHandle: TFETensorHandle { fatalError("Not a tf handle") }
@@ -89,6 +91,18 @@ extension Tensor {
   }
 }
 
+/// A host buffer of scalars which a tensor created by `XLATensor.make(borrowing:_:on:)` reads
+/// straight out of, instead of copying them. The buffer stays alive until the C++ side releases
+/// it, once the scalars have been uploaded to the device.
+final class HostScalarBuffer<Scalar> {
+  let scalars: UnsafeMutableBufferPointer<Scalar>
+
+  /// Allocates an uninitialized buffer of `count` scalars, which the caller initializes.
+  init(count: Int) { scalars = .allocate(capacity: count) }
+
+  deinit { scalars.deallocate() }
+}
+
 extension XLATensor {
   /// TODO(parkers): Add support for other types and aliasing.
   static func make<Scalar: XLAScalarType>(
@@ -97,6 +111,34 @@ extension XLATensor {
     data.withUnsafeBufferPointer { data in return make(data, dims, on: device) }
   }
 
+  /// Creates a tensor which reads its scalars straight out of `buffer`, instead of copying them.
+  /// The buffer is retained until the data has been uploaded to the device, and must not be
+  /// written to anymore.
+  static func make<Scalar: XLAScalarType>(
+    borrowing buffer: HostScalarBuffer<Scalar>, _ dims: [Int], on device: Device = Device.default
+  ) -> XLATensor {
+    make(borrowing: UnsafeBufferPointer(buffer.scalars), dims, owner: buffer, on: device)
+  }
+
+  /// Creates a tensor which reads its scalars straight out of `data`, instead of copying them.
+  /// `owner` is retained, and must keep `data` valid, until the data has been uploaded to the
+  /// device.
+  static func make<Scalar: XLAScalarType>(
+    borrowing data: UnsafeBufferPointer<Scalar>, _ dims: [Int], owner: AnyObject,
+    on device: Device = Device.default
+  ) -> XLATensor {
+    let context = Unmanaged.passRetained(owner).toOpaque()
+    return dims.withUnsafeBufferPointer { dims in
+      XLATensor(
+        _handle:
+          copyTensorBorrowing(
+            Scalar.xlaTensorScalarType, data.baseAddress, data.count, dims.baseAddress, dims.count,
+            device.cdevice,
+            { context in Unmanaged<AnyObject>.fromOpaque(context!).release() }, context
+          ))
+    }
+  }
+
   static func make<Scalar: XLAScalarType>(_ data: Scalar, on device: Device = Device.default)
     -> XLATensor
   {
@@ -144,14 +186,89 @@ extension XLATensor {
     }
   }
 
+  /// Uploads the tensor stored in row-major order `offset` bytes into the file at `path`, which
+  /// gets mapped in memory and transferred from the mapping instead of read into an array.
+  static func make<Scalar: XLAScalarType>(
+    mappingFile path: String, offset: Int, _ dims: [Int], as type: Scalar.Type,
+    toReducedPrecision: Bool, directlyOn device: Device
+  ) -> XLATensor {
+    dims.withUnsafeBufferPointer { dims in
+      XLATensor(
+        _handle: loadMappedTensor(
+          Scalar.xlaTensorScalarType, path, offset, dims.baseAddress, dims.count, device.cdevice,
+          toReducedPrecision))
+    }
+  }
+
+  /// Splits `data` along its first dimension into one slice per device, and uploads the slices to
+  /// their devices concurrently, instead of one after the other.
+  static func makeReplicas<Scalar: XLAScalarType>(
+    _ data: UnsafeBufferPointer<Scalar>, _ dims: [Int], toReducedPrecision: Bool,
+    directlyOn devices: [Device]
+  ) -> [XLATensor] {
+    precondition(!dims.isEmpty, "Cannot split a scalar across replicas")
+    precondition(
+      dims[0] % devices.count == 0,
+      "The batch size \(dims[0]) is not divisible by the \(devices.count) replicas")
+    let cdevices = devices.map { $0.cdevice }
+    var handles = [UnsafeMutablePointer<OpaqueXLATensor>?](repeating: nil, count: devices.count)
+    dims.withUnsafeBufferPointer { dims in
+      cdevices.withUnsafeBufferPointer { cdevices in
+        handles.withUnsafeMutableBufferPointer { handles in
+          copyTensorToReplicas(
+            Scalar.xlaTensorScalarType, data.baseAddress, data.count, dims.baseAddress, dims.count,
+            cdevices.baseAddress, cdevices.count, toReducedPrecision, handles.baseAddress)
+        }
+      }
+    }
+    return handles.map { XLATensor(_handle: $0!) }
+  }
+
   var shape: [Int] {
-    defer { _fixLifetime(self) }
-    let shape = fetchTensorShape(handle)!
-    let rank = XLAShape_getRank(shape)
-    let data = XLAShape_getDimensions(shape)
-    let result = Array(UnsafeBufferPointer(start: data!, count: rank))
-    destroyXLAShape(shape)
-    return result.map { Int($0) }
+    return handleDeleter.dimensions
+  }
+
+  /// Fetches the shape into a stack sized buffer, which only needs a second call for the tensors
+  /// of rank above `inlineRank`.
+  fileprivate static func fetchShape(_ handle: UnsafeMutablePointer<OpaqueXLATensor>) -> [Int] {
+    let inlineRank = 8
+    var dimensions: (Int64, Int64, Int64, Int64, Int64, Int64, Int64, Int64) =
+      (0, 0, 0, 0, 0, 0, 0, 0)
+    return withUnsafeMutableBytes(of: &dimensions) { buffer in
+      let data = buffer.baseAddress!.assumingMemoryBound(to: Int64.self)
+      let rank = XLATensor_shape_into(handle, data, inlineRank)
+      if rank <= inlineRank {
+        return UnsafeBufferPointer(start: data, count: rank).map { Int($0) }
+      }
+      var result = [Int64](repeating: 0, count: rank)
+      result.withUnsafeMutableBufferPointer {
+        _ = XLATensor_shape_into(handle, $0.baseAddress, rank)
+      }
+      return result.map { Int($0) }
+    }
+  }
+
+  /// The shapes of all the tensors, fetched with a single call rather than one per tensor.
+  static func shapes(_ tensors: [XLATensor]) -> [[Int]] {
+    var ranks = [Int](repeating: 0, count: tensors.count)
+    var dimensions = [Int64](repeating: 0, count: tensors.count * 4)
+    var count = 0
+    tensors.withArrayRef { tensors in
+      while true {
+        count = ranks.withUnsafeMutableBufferPointer { ranks in
+          dimensions.withUnsafeMutableBufferPointer { dimensions in
+            XLATensor_shapes(tensors, ranks.baseAddress, dimensions.baseAddress, dimensions.count)
+          }
+        }
+        if count <= dimensions.count { break }
+        dimensions = [Int64](repeating: 0, count: count)
+      }
+    }
+    var offset = 0
+    return ranks.map { rank in
+      defer { offset += rank }
+      return dimensions[offset..<(offset + rank)].map { Int($0) }
+    }
   }
 
   func fetchTensorValues<Scalar: XLAScalarType>(_ t: Scalar.Type) -> (data: [Scalar], dims: [Int]) {
@@ -171,6 +288,97 @@ extension XLATensor {
     return (data: data, dims: dims)
   }
 
+  /// Fetches the values of all the tensors, which must live on the same device, with a single
+  /// device transfer. The tensors are packed into one buffer on the device, so that collecting
+  /// many small tensors, like per step metrics, takes one round trip instead of one per tensor.
+  static func fetchTensorValues<Scalar: XLAScalarType>(
+    _ tensors: [XLATensor], _ t: Scalar.Type
+  ) -> [[Scalar]] {
+    var materialized = [UnsafeMutablePointer<OpaqueMaterializedTensor>?](
+      repeating: nil, count: tensors.count)
+    tensors.withArrayRef { tensors in
+      materialized.withUnsafeMutableBufferPointer { materialized in
+        XLATensor_materialize_many(tensors, materialized.baseAddress)
+      }
+    }
+    return consumeMaterialized(materialized, of: tensors, Scalar.self)
+  }
+
+  /// Starts fetching the values of all the tensors, which must live on the same device, and
+  /// returns without waiting for their computations or the device transfers. The values are
+  /// returned by `wait()` on the result, so that the fetch overlaps with whatever the caller does
+  /// meanwhile. `onReady`, if given, is called from a background thread once they have landed.
+  static func fetchTensorValuesAsync<Scalar: XLAScalarType>(
+    _ tensors: [XLATensor], _ t: Scalar.Type, onReady: (() -> Void)? = nil
+  ) -> PendingTensorValues<Scalar> {
+    let future = tensors.withArrayRef { tensors -> UnsafeMutablePointer<OpaqueMaterializedFuture> in
+      guard let onReady = onReady else {
+        return XLATensor_materialize_async(tensors, nil, nil)!
+      }
+      let context = Unmanaged.passRetained(ReadyCallback(onReady)).toOpaque()
+      return XLATensor_materialize_async(
+        tensors,
+        { context in Unmanaged<ReadyCallback>.fromOpaque(context!).takeRetainedValue().body() },
+        context)!
+    }
+    return PendingTensorValues(future: future, counts: tensors.map { $0.shape.reduce(1, *) })
+  }
+
+  fileprivate static func consumeMaterialized<Scalar: XLAScalarType>(
+    _ materialized: [UnsafeMutablePointer<OpaqueMaterializedTensor>?], of tensors: [XLATensor],
+    _ t: Scalar.Type
+  ) -> [[Scalar]] {
+    return consumeMaterialized(
+      materialized, counts: tensors.map { $0.shape.reduce(1, *) }, Scalar.self)
+  }
+
+  fileprivate static func consumeMaterialized<Scalar: XLAScalarType>(
+    _ materialized: [UnsafeMutablePointer<OpaqueMaterializedTensor>?], counts: [Int],
+    _ t: Scalar.Type
+  ) -> [[Scalar]] {
+    return zip(counts, materialized).map { (count, materialized) in
+      let materialized = materialized!
+      precondition(
+        MaterializedTensor_getType(materialized) == Scalar.xlaTensorScalarType,
+        "Types mismatch when fetching tensor values.")
+      let data = Array(
+        UnsafeBufferPointer(
+          start:
+            UnsafePointer<Scalar>(OpaquePointer(MaterializedTensor_getData(materialized))),
+          count: count))
+      destroyMaterializedTensor(materialized)
+      return data
+    }
+  }
+
+  /// Writes the tensor values straight into `buffer`, which can be backed by any memory (like a
+  /// mapped file), skipping the intermediate host tensor. Unlike `fetchTensorValues(_:)`, the
+  /// values are not cached on the host, which makes it suited to large one-off downloads.
+  func fetchTensorValues<Scalar: XLAScalarType>(into buffer: UnsafeMutableBufferPointer<Scalar>) {
+    defer { _fixLifetime(self) }
+    precondition(dtype == Scalar.xlaTensorScalarType, "Types mismatch when fetching tensor values.")
+    XLATensor_materialize_into(
+      handle, UnsafeMutableRawPointer(buffer.baseAddress),
+      buffer.count * MemoryLayout<Scalar>.stride)
+  }
+
+  /// The largest tensors, in bytes, which `fetchSmallTensorValues(_:)` takes.
+  static let maxSmallReadBytes = XLATensor_max_small_read_bytes()
+
+  /// Fetches the values of a tensor of at most `maxSmallReadBytes` bytes, like a loss scalar,
+  /// without materializing a host tensor. The concurrent small fetches from the same device share
+  /// one device transfer.
+  func fetchSmallTensorValues<Scalar: XLAScalarType>(_ t: Scalar.Type) -> [Scalar] {
+    defer { _fixLifetime(self) }
+    precondition(dtype == Scalar.xlaTensorScalarType, "Types mismatch when fetching tensor values.")
+    let count = shape.reduce(1, *)
+    return [Scalar](unsafeUninitializedCapacity: count) { buffer, initializedCount in
+      XLATensor_materialize_small(
+        handle, UnsafeMutableRawPointer(buffer.baseAddress), count * MemoryLayout<Scalar>.stride)
+      initializedCount = count
+    }
+  }
+
   var dtype: XLATensorScalarType {
     defer { _fixLifetime(self) }
     return XLATensor_dtype(handle)
@@ -181,6 +389,52 @@ extension XLATensor {
   }
 }
 
+/// Values of tensors being fetched from their device in the background. Only the element counts
+/// of the tensors are kept, so that their device memory gets released once the transfers land.
+final class PendingTensorValues<Scalar: XLAScalarType> {
+  private var future: UnsafeMutablePointer<OpaqueMaterializedFuture>?
+  private let counts: [Int]
+  private var values: [[Scalar]]?
+
+  init(future: UnsafeMutablePointer<OpaqueMaterializedFuture>, counts: [Int]) {
+    self.future = future
+    self.counts = counts
+  }
+
+  deinit {
+    if let future = future { destroyMaterializedFuture(future) }
+  }
+
+  /// Whether `wait()` would return without blocking.
+  var isReady: Bool {
+    guard let future = future else { return true }
+    return XLATensor_materialized_ready(future)
+  }
+
+  /// Blocks until the values have landed on the host, and returns them.
+  func wait() -> [[Scalar]] {
+    if let values = values { return values }
+    var materialized = [UnsafeMutablePointer<OpaqueMaterializedTensor>?](
+      repeating: nil, count: counts.count)
+    materialized.withUnsafeMutableBufferPointer { materialized in
+      XLATensor_await_materialized(future, materialized.baseAddress)
+    }
+    future = nil
+    let values = XLATensor.consumeMaterialized(materialized, counts: counts, Scalar.self)
+    self.values = values
+    return values
+  }
+}
+
+/// Callback handed through the C API as an opaque context.
+private final class ReadyCallback {
+  let body: () -> Void
+
+  init(_ body: @escaping () -> Void) {
+    self.body = body
+  }
+}
+
 extension Array where Element == Int64 {
   func withArrayRef<Result>(_ body: (Int64ArrayRef) throws -> Result) rethrows -> Result {
     return try withUnsafeBufferPointer { buf in
@@ -236,9 +490,35 @@ extension Tensor {
     defer { DeleteString(str) }
     return String(cString: GetStringCStr(str))
   }
+  /// Estimated device memory needed to materialize this tensor, broken down in
+  /// argument, output, temporary and aliased bytes.
+  public var xlaMemoryAnalysisText: String {
+    let str = XLATensor_memory_analysis_text(xlaTensor.handle)
+    defer { DeleteString(str) }
+    return String(cString: GetStringCStr(str))
+  }
   var placeholder: Tensor {
     return Tensor(_xlaHandle: XLATensor_makePlaceholder(self.xlaHandle, 0))
   }
+  /// Returns `samples` collated along a new first dimension, with their host data copied into one
+  /// contiguous buffer which gets uploaded by a single transfer, instead of stacked in the IR.
+  /// Ragged samples are padded with `padValue` to the largest size in every dimension, at their
+  /// start if `atStart` is set. Returns `nil` when the samples are not all on the same X10 device
+  /// with their host data, or are ragged without a `padValue`, in which case they must be stacked.
+  static func collatingHostSamples(
+    _ samples: [Tensor], paddingWith padValue: Scalar?, atStart: Bool = false
+  ) -> Tensor? {
+    guard let device = samples.first?.device, device.backend == .XLA else { return nil }
+    let pad = padValue?.xlaScalar ?? XLAScalar(Int64(0))
+    let handle = samples.withArrayRef { XLATensor_collate($0, padValue != nil, pad, atStart) }
+    return handle.map { Tensor(_xlaHandle: $0) }
+  }
+  /// Runs the pending computation of this tensor, or uploads its host data, and waits for its
+  /// device data. Does nothing on the eager backend.
+  func syncOnDevice() {
+    guard device.backend == .XLA else { return }
+    [xlaTensor].withArrayRef { XLATensor_sync_tensors($0) }
+  }
 }
 
 extension Array where Element == AnyTensor {
@@ -258,6 +538,10 @@ extension TensorFlowScalar {
     return Tensor<Self>(
       _xlaHandle: XLATensor_makePlaceholder((t as! Tensor<Self>).xlaHandle, Int32(i)))
   }
+  /// Makes a placeholder for the elements along the leading dimension of `t`.
+  static func makeElementPlaceholder(_ t: AnyTensor, i: Int) -> AnyTensor {
+    return makePlaceholder((t as! Tensor<Self>)[0], i: i)
+  }
 }
 
 extension _RawXLA {
@@ -266,13 +550,16 @@ extension _RawXLA {
     initial: [AnyTensor],
     placeholders: [AnyTensor],
     indexPlaceholder: Tensor<Int32>,
-    results: [AnyTensor]
+    results: [AnyTensor],
+    tripCount: Int = -1,
+    unrollFactor: Int = 1
   ) -> [AnyTensor] {
     initial.withArrayRef { initial in
       placeholders.withArrayRef { placeholders in
         results.withArrayRef { resultHandles in
           let tensorListHandle = XLATensor_functional_while(
-            n.xlaHandle, initial, placeholders, indexPlaceholder.xlaHandle, resultHandles)
+            n.xlaHandle, initial, placeholders, indexPlaceholder.xlaHandle, resultHandles,
+            Int64(tripCount), Int64(unrollFactor))
           defer { destroyOpaqueXLATensorArrayRef(tensorListHandle) }
           return (0..<tensorListHandle.size).map { i in
             results[i].scalarType.wrapTensor(XLATensor(_handle: tensorListHandle.data[i]!))
@@ -282,8 +569,32 @@ extension _RawXLA {
     }
   }
 
+  /// Runs `body` `n` times over the carried values, starting from `initial`. The loop compiles once
+  /// for all the values of `n`. With an `unrollFactor` above one, each iteration of the loop runs
+  /// that many copies of `body`, followed by a loop over the remaining iterations.
+  public static func functionalWhile(
+    n: Tensor<Int32>, initial: [AnyTensor], unrollFactor: Int = 1,
+    body: ([AnyTensor], Tensor<Int32>) -> ([AnyTensor])
+  ) -> [AnyTensor] {
+    return functionalWhile(
+      n: n, tripCount: -1, initial: initial, unrollFactor: unrollFactor, body: body)
+  }
+
+  /// Runs `body` `tripCount` times over the carried values, starting from `initial`. The loop gets
+  /// fully unrolled when `tripCount` is at most `unrollFactor`, which suits the small fixed trip
+  /// counts.
   public static func functionalWhile(
-    n: Tensor<Int32>, initial: [AnyTensor],
+    tripCount: Int, initial: [AnyTensor], unrollFactor: Int = 1, on device: Device = .default,
+    body: ([AnyTensor], Tensor<Int32>) -> ([AnyTensor])
+  ) -> [AnyTensor] {
+    precondition(tripCount >= 0, "The trip count must not be negative.")
+    return functionalWhile(
+      n: Tensor<Int32>(Int32(tripCount), on: device), tripCount: tripCount, initial: initial,
+      unrollFactor: unrollFactor, body: body)
+  }
+
+  static func functionalWhile(
+    n: Tensor<Int32>, tripCount: Int, initial: [AnyTensor], unrollFactor: Int,
     body: ([AnyTensor], Tensor<Int32>) -> ([AnyTensor])
   ) -> [AnyTensor] {
     var idx = 0
@@ -295,7 +606,63 @@ extension _RawXLA {
     let results = body(placeholders, i)
     return functionalWhile(
       n: n, initial: initial, placeholders: placeholders,
-      indexPlaceholder: i, results: results)
+      indexPlaceholder: i, results: results, tripCount: tripCount, unrollFactor: unrollFactor)
+  }
+}
+
+extension _RawXLA {
+  /// Scans `body` over the leading dimension, of size `length`, of the `sequences`. The body gets
+  /// the carried values, the elements of the sequences and the position of the elements, and
+  /// returns the next carried values along with its outputs for the position. Returns the final
+  /// carried values and the outputs stacked along a new leading dimension. With `reverse`, the
+  /// positions run from `length - 1` down to zero.
+  ///
+  /// The body gets traced once, and runs as a single loop whose outputs are written in place, so
+  /// the size of the trace does not depend on `length`.
+  public static func functionalScan(
+    length: Int, initial: [AnyTensor], sequences: [AnyTensor], reverse: Bool = false,
+    on device: Device = .default,
+    body: ([AnyTensor], [AnyTensor], Tensor<Int32>) -> (carried: [AnyTensor], outputs: [AnyTensor])
+  ) -> (carried: [AnyTensor], outputs: [AnyTensor]) {
+    var idx = 0
+    let placeholders = initial.map { (v: AnyTensor) -> AnyTensor in
+      idx += 1
+      return v.scalarType.makePlaceholder(v, i: idx)
+    }
+    let elementPlaceholders = sequences.map { (v: AnyTensor) -> AnyTensor in
+      idx += 1
+      return v.scalarType.makeElementPlaceholder(v, i: idx)
+    }
+    let n = Tensor<Int32>(Int32(length), on: device)
+    let i = n.placeholder
+    let results = body(placeholders, elementPlaceholders, i)
+    precondition(
+      results.carried.count == initial.count,
+      "The body must return as many carried values as there are initial ones.")
+    return initial.withArrayRef { initialHandles in
+      sequences.withArrayRef { sequenceHandles in
+        placeholders.withArrayRef { placeholderHandles in
+          elementPlaceholders.withArrayRef { elementPlaceholderHandles in
+            results.carried.withArrayRef { carriedHandles in
+              results.outputs.withArrayRef { outputHandles in
+                let tensorListHandle = XLATensor_functional_scan(
+                  n.xlaHandle, Int64(length), initialHandles, sequenceHandles, placeholderHandles,
+                  elementPlaceholderHandles, i.xlaHandle, carriedHandles, outputHandles, reverse)
+                defer { destroyOpaqueXLATensorArrayRef(tensorListHandle) }
+                let all = results.carried + results.outputs
+                let tensors = (0..<tensorListHandle.size).map { j in
+                  all[j].scalarType.wrapTensor(XLATensor(_handle: tensorListHandle.data[j]!))
+                }
+                return (
+                  carried: Array(tensors[..<initial.count]),
+                  outputs: Array(tensors[initial.count...])
+                )
+              }
+            }
+          }
+        }
+      }
+    }
   }
 }
 
@@ -305,6 +672,16 @@ extension XLATensor {
     return XLATensor(_handle: XLATensor_annotate(a.handle, annotation))
   }
 
+  static func remat(_ a: XLATensor, _ scope: String) -> XLATensor {
+    return XLATensor(_handle: XLATensor_remat(a.handle, scope))
+  }
+
+  static func shard(_ a: XLATensor, _ tiles: [Int]) -> XLATensor {
+    return tiles.map { Int64($0) }.withArrayRef { tiles in
+      XLATensor(_handle: XLATensor_shard(a.handle, tiles))
+    }
+  }
+
   static func annotations(_ a: XLATensor) -> String {
     // TODO(michellecasbon): Format with header.
     let str = XLATensor_get_annotations(a.handle)
@@ -355,9 +732,11 @@ extension XLATensor {
     return (XLATensor(_handle: output.x), XLATensor(_handle: output.y))
   }
 
-  static func crossReplicaSum(_ inputs: [XLATensor], _ scale: Double) -> [XLATensor] {
+  static func crossReplicaSum(
+    _ inputs: [XLATensor], _ scale: Double, _ precision: CrossReplicaSumPrecision
+  ) -> [XLATensor] {
     inputs.withArrayRef { inputs in
-      let tensorListHandle = XLATensor_cross_replica_sum(inputs, scale)
+      let tensorListHandle = XLATensor_cross_replica_sum(inputs, scale, precision.xlaPrecision)
       defer {
         destroyOpaqueXLATensorArrayRef(tensorListHandle)
       }
@@ -367,6 +746,194 @@ extension XLATensor {
     }
   }
 
+  static func optimizerStep(
+    _ kind: _RawXLA.OptimizerStepKind, _ weights: [XLATensor], _ grads: [XLATensor],
+    _ states: [XLATensor], _ hyperparameters: [XLATensor], _ nesterov: Bool,
+    _ applyWeightDecay: Bool, _ epsilon: Float
+  ) -> [XLATensor] {
+    weights.withArrayRef { weights in
+      grads.withArrayRef { grads in
+        states.withArrayRef { states in
+          hyperparameters.withArrayRef { hyperparameters in
+            let tensorListHandle = XLATensor_optimizer_step(
+              kind.xlaKind, weights, grads, states, hyperparameters, nesterov, applyWeightDecay,
+              epsilon)
+            defer {
+              destroyOpaqueXLATensorArrayRef(tensorListHandle)
+            }
+            return (0..<tensorListHandle.size).map { i in
+              XLATensor(_handle: tensorListHandle.data[i]!)
+            }
+          }
+        }
+      }
+    }
+  }
+
+  static func allFinite(_ tensors: [XLATensor]) -> XLATensor {
+    tensors.withArrayRef { tensors in
+      XLATensor(_handle: XLATensor_all_finite(tensors))
+    }
+  }
+
+  static func allGather(_ input: XLATensor, _ dim: Int64, _ shardCount: Int64) -> XLATensor {
+    defer { _fixLifetime(input) }
+    return XLATensor(_handle: XLATensor_all_gather(input.handle, dim, shardCount))
+  }
+
+  static func reduceScatter(
+    _ input: XLATensor, _ scale: Double, _ scatterDim: Int64, _ shardCount: Int64
+  ) -> XLATensor {
+    defer { _fixLifetime(input) }
+    return XLATensor(
+      _handle: XLATensor_reduce_scatter(input.handle, scale, scatterDim, shardCount))
+  }
+
+  static func allToAll(
+    _ input: XLATensor, _ splitDimension: Int64, _ concatDimension: Int64, _ splitCount: Int64
+  ) -> XLATensor {
+    defer { _fixLifetime(input) }
+    return XLATensor(
+      _handle: XLATensor_all_to_all(input.handle, splitDimension, concatDimension, splitCount))
+  }
+
+  static func moeRouting(
+    _ gates: XLATensor, _ k: Int64, _ capacity: Int64
+  ) -> (XLATensor, XLATensor) {
+    defer { _fixLifetime(gates) }
+    let output = XLATensor_moe_routing(gates.handle, k, capacity)
+    return (XLATensor(_handle: output.x), XLATensor(_handle: output.y))
+  }
+
+  static func moeDispatch(
+    _ input: XLATensor, _ expertIndices: XLATensor, _ positions: XLATensor,
+    _ numExperts: Int64, _ capacity: Int64, _ splitCount: Int64
+  ) -> XLATensor {
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(expertIndices) }
+    defer { _fixLifetime(positions) }
+    return XLATensor(
+      _handle: XLATensor_moe_dispatch(
+        input.handle, expertIndices.handle, positions.handle, numExperts, capacity, splitCount))
+  }
+
+  static func moeCombine(
+    _ expertOutputs: XLATensor, _ expertIndices: XLATensor, _ positions: XLATensor,
+    _ splitCount: Int64
+  ) -> XLATensor {
+    defer { _fixLifetime(expertOutputs) }
+    defer { _fixLifetime(expertIndices) }
+    defer { _fixLifetime(positions) }
+    return XLATensor(
+      _handle: XLATensor_moe_combine(
+        expertOutputs.handle, expertIndices.handle, positions.handle, splitCount))
+  }
+
+  static func syncBatchNorm(
+    _ input: XLATensor, _ weight: XLATensor, _ bias: XLATensor, _ featureIndex: Int64,
+    _ eps: Double
+  ) -> (XLATensor, XLATensor, XLATensor) {
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(weight) }
+    defer { _fixLifetime(bias) }
+    let output = XLATensor_sync_batch_norm(
+      input.handle, weight.handle, bias.handle, featureIndex, eps)
+    return (
+      XLATensor(_handle: output.v0), XLATensor(_handle: output.v1), XLATensor(_handle: output.v2)
+    )
+  }
+
+  static func syncBatchNormBackward(
+    _ grad: XLATensor, _ input: XLATensor, _ weight: XLATensor, _ mean: XLATensor,
+    _ variance: XLATensor, _ featureIndex: Int64, _ eps: Double
+  ) -> (XLATensor, XLATensor, XLATensor) {
+    defer { _fixLifetime(grad) }
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(weight) }
+    defer { _fixLifetime(mean) }
+    defer { _fixLifetime(variance) }
+    let output = XLATensor_sync_batch_norm_backward(
+      grad.handle, input.handle, weight.handle, mean.handle, variance.handle, featureIndex, eps)
+    return (
+      XLATensor(_handle: output.v0), XLATensor(_handle: output.v1), XLATensor(_handle: output.v2)
+    )
+  }
+
+  static func lstmCell(
+    _ input: XLATensor, _ hidden: XLATensor, _ cell: XLATensor, _ weight: XLATensor,
+    _ bias: XLATensor
+  ) -> (XLATensor, XLATensor, XLATensor) {
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(hidden) }
+    defer { _fixLifetime(cell) }
+    defer { _fixLifetime(weight) }
+    defer { _fixLifetime(bias) }
+    let output = XLATensor_lstm_cell(
+      input.handle, hidden.handle, cell.handle, weight.handle, bias.handle)
+    return (
+      XLATensor(_handle: output.v0), XLATensor(_handle: output.v1), XLATensor(_handle: output.v2)
+    )
+  }
+
+  static func lstmCellBackward(
+    _ gradCell: XLATensor, _ gradHidden: XLATensor, _ input: XLATensor, _ hidden: XLATensor,
+    _ cell: XLATensor, _ weight: XLATensor, _ gates: XLATensor, _ newCell: XLATensor
+  ) -> [XLATensor] {
+    defer { _fixLifetime(gradCell) }
+    defer { _fixLifetime(gradHidden) }
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(hidden) }
+    defer { _fixLifetime(cell) }
+    defer { _fixLifetime(weight) }
+    defer { _fixLifetime(gates) }
+    defer { _fixLifetime(newCell) }
+    let tensorListHandle = XLATensor_lstm_cell_backward(
+      gradCell.handle, gradHidden.handle, input.handle, hidden.handle, cell.handle,
+      weight.handle, gates.handle, newCell.handle)
+    defer { destroyOpaqueXLATensorArrayRef(tensorListHandle) }
+    return (0..<tensorListHandle.size).map { i in
+      XLATensor(_handle: tensorListHandle.data[i]!)
+    }
+  }
+
+  static func gruCell(
+    _ input: XLATensor, _ hidden: XLATensor, _ kernel: XLATensor, _ recurrentKernel: XLATensor,
+    _ bias: XLATensor, _ recurrentBias: XLATensor
+  ) -> (XLATensor, XLATensor, XLATensor) {
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(hidden) }
+    defer { _fixLifetime(kernel) }
+    defer { _fixLifetime(recurrentKernel) }
+    defer { _fixLifetime(bias) }
+    defer { _fixLifetime(recurrentBias) }
+    let output = XLATensor_gru_cell(
+      input.handle, hidden.handle, kernel.handle, recurrentKernel.handle, bias.handle,
+      recurrentBias.handle)
+    return (
+      XLATensor(_handle: output.v0), XLATensor(_handle: output.v1), XLATensor(_handle: output.v2)
+    )
+  }
+
+  static func gruCellBackward(
+    _ gradHidden: XLATensor, _ input: XLATensor, _ hidden: XLATensor, _ kernel: XLATensor,
+    _ recurrentKernel: XLATensor, _ gates: XLATensor, _ recurrentOutput: XLATensor
+  ) -> [XLATensor] {
+    defer { _fixLifetime(gradHidden) }
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(hidden) }
+    defer { _fixLifetime(kernel) }
+    defer { _fixLifetime(recurrentKernel) }
+    defer { _fixLifetime(gates) }
+    defer { _fixLifetime(recurrentOutput) }
+    let tensorListHandle = XLATensor_gru_cell_backward(
+      gradHidden.handle, input.handle, hidden.handle, kernel.handle, recurrentKernel.handle,
+      gates.handle, recurrentOutput.handle)
+    defer { destroyOpaqueXLATensorArrayRef(tensorListHandle) }
+    return (0..<tensorListHandle.size).map { i in
+      XLATensor(_handle: tensorListHandle.data[i]!)
+    }
+  }
+
   static func irText(_ a: XLATensor) -> String {
     let str = XLATensor_ir_text(a.handle)
     defer { DeleteString(str) }
@@ -432,10 +999,29 @@ extension XLATensor {
     }
   }
 
+  static func random_init(
+    _ shape: [Int64], _ distribution: _RawXLA.RandomInitDistribution, _ scale: Double,
+    _ seed0: Int64, _ seed1: Int64, _ type: XLATensorScalarType, _ device: Device
+  ) -> XLATensor {
+    shape.withArrayRef { shape in
+      XLATensor(
+        _handle: XLATensor_random_init(
+          shape, distribution.xlaDistribution, scale, seed0, seed1, device.cdevice, type))
+    }
+  }
+
   static func replica_id(_ device: Device) -> XLATensor {
     return XLATensor(_handle: XLATensor_replica_id(device.cdevice))
   }
 
+  static func rng_seed(_ device: Device) -> XLATensor {
+    return XLATensor(_handle: XLATensor_rng_seed(device.cdevice))
+  }
+
+  static var useStepRngSeeds: Bool {
+    return XLATensor_use_step_rng_seeds()
+  }
+
   static func to(
     _ a: XLATensor, _ device: Device?, _ dtype: XLAScalarType.Type?
   ) -> XLATensor {
@@ -492,6 +1078,85 @@ extension XLATensor {
   }
 }
 
+extension CrossReplicaSumPrecision {
+  fileprivate var xlaPrecision: XLAAllReducePrecision {
+    switch self {
+    case .full: return XLAAllReducePrecision_FULL
+    case .bfloat16: return XLAAllReducePrecision_BFLOAT16
+    case .half: return XLAAllReducePrecision_HALF
+    }
+  }
+}
+
+extension _RawXLA.RandomInitDistribution {
+  fileprivate var xlaDistribution: XLARandomInitDistribution {
+    switch self {
+    case .uniform: return XLARandomInitDistribution_UNIFORM
+    case .normal: return XLARandomInitDistribution_NORMAL
+    case .truncatedNormal: return XLARandomInitDistribution_TRUNCATED_NORMAL
+    }
+  }
+}
+
+extension _RawXLA.OptimizerStepKind {
+  fileprivate var xlaKind: XLAOptimizerStepKind {
+    switch self {
+    case .sgdMomentum: return XLAOptimizerStepKind_SGD_MOMENTUM
+    case .adam: return XLAOptimizerStepKind_ADAM
+    case .adamW: return XLAOptimizerStepKind_ADAMW
+    }
+  }
+}
+
 public func PrintX10Metrics() {
   PrintMetrics()
 }
+
+/// Returns the value of the named X10 counter, like `CachedCompile`, or zero if nothing has been
+/// counted into it yet.
+public func X10CounterValue(_ name: String) -> Int {
+  Int(GetCounterValue(name))
+}
+
+/// Returns the device memory cached by the X10 device allocators, for instance before handing the
+/// accelerator over to another library.
+public func ReleaseX10CachedDeviceMemory() {
+  ReleaseCachedDeviceMemory()
+}
+
+/// Starts recording the timeline of the X10 tracing, compilation, transfer and execution phases.
+public func StartX10TraceRecording() {
+  StartTraceRecording()
+}
+
+/// Stops recording the X10 timeline, and returns it in the Chrome trace JSON format, which can be
+/// loaded by chrome://tracing or Perfetto.
+public func StopX10TraceRecording() -> String {
+  let str = StopTraceRecording()
+  defer { DeleteString(str) }
+  return String(cString: GetStringCStr(str))
+}
+
+/// Returns the execution count, times and sizes of each of the computations run by X10, ranked by
+/// total execution time.
+public func X10GraphProfileReport() -> String {
+  let str = GetGraphProfileReport()
+  defer { DeleteString(str) }
+  return String(cString: GetStringCStr(str))
+}
+
+/// Returns why the most recent X10 compilations missed the cache: for each of them, the first node
+/// where the graph diverges from the nearest graph compiled before.
+public func X10RecompileReport() -> String {
+  let str = GetRecompileReport()
+  defer { DeleteString(str) }
+  return String(cString: GetStringCStr(str))
+}
+
+/// Returns the X10 entry points and op kinds which took the most host dispatch time, estimated
+/// from the calls sampled with `XLA_DISPATCH_PROFILE_SAMPLING`, at most `maxEntries` of each.
+public func X10DispatchProfileReport(maxEntries: Int = 20) -> String {
+  let str = GetDispatchProfileReport(maxEntries)
+  defer { DeleteString(str) }
+  return String(cString: GetStringCStr(str))
+}
@@ -0,0 +1,105 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+@_implementationOnly import x10_xla_tensor_wrapper
+
+/// Checkpoints of named tensors, saved from and restored to the devices in bulk.
+///
+/// Saving transfers the tensors from their devices in large batched groups, overlapped with the
+/// parallel writes of the shard files. Restoring maps the shard files in memory and uploads the
+/// tensors in parallel. Tensors of the 16 bits floating point types are not supported.
+public enum _XLACheckpoint {
+  /// Saves `tensors` under their names, which must be unique and free of whitespace, in the
+  /// checkpoint folder at `path`, spread over `shardCount` shard files written in parallel.
+  public static func save(
+    _ tensors: [(name: String, tensor: AnyTensor)], to path: String, shardCount: Int = 1
+  ) {
+    precondition(shardCount >= 1, "A checkpoint needs at least one shard.")
+    tensors.map { $0.name }.withCStrings { names in
+      tensors.map { $0.tensor }.withArrayRef { tensorHandles in
+        XLACheckpoint_save(path, names, tensorHandles, shardCount)
+      }
+    }
+  }
+
+  /// Same as `save(_:to:shardCount:)`, but returns once the device buffers of the tensors have
+  /// been captured, and saves them in the background while the training goes on. Call it after
+  /// `LazyTensorBarrier()`, so that the tensors hold the values of the finished step. The captured
+  /// buffers are never donated to the later steps, and get released once the save completes.
+  public static func saveAsync(
+    _ tensors: [(name: String, tensor: AnyTensor)], to path: String, shardCount: Int = 1
+  ) -> _XLACheckpointSnapshot {
+    precondition(shardCount >= 1, "A checkpoint needs at least one shard.")
+    return tensors.map { $0.name }.withCStrings { names in
+      tensors.map { $0.tensor }.withArrayRef { tensorHandles in
+        _XLACheckpointSnapshot(
+          handle: XLACheckpoint_save_async(path, names, tensorHandles, shardCount)!)
+      }
+    }
+  }
+
+  /// Restores the tensors of the given names and scalar types, from the checkpoint folder at
+  /// `path`, onto `device`.
+  public static func restore(
+    _ entries: [(name: String, type: TensorFlowScalar.Type)], from path: String,
+    on device: Device = .defaultXLA
+  ) -> [AnyTensor] {
+    entries.map { $0.name }.withCStrings { names in
+      let tensorListHandle = XLACheckpoint_restore(path, names, names.count, device.cdevice)
+      defer { destroyOpaqueXLATensorArrayRef(tensorListHandle) }
+      return (0..<tensorListHandle.size).map { i in
+        entries[i].type.wrapTensor(XLATensor(_handle: tensorListHandle.data[i]!))
+      }
+    }
+  }
+}
+
+/// A checkpoint being saved in the background by `_XLACheckpoint.saveAsync(_:to:shardCount:)`.
+public final class _XLACheckpointSnapshot {
+  private let handle: UnsafeMutablePointer<OpaqueXLACheckpointSnapshot>
+
+  init(handle: UnsafeMutablePointer<OpaqueXLACheckpointSnapshot>) {
+    self.handle = handle
+  }
+
+  /// Lets the save go on in the background.
+  deinit {
+    destroyXLACheckpointSnapshot(handle)
+  }
+
+  /// Whether the save has completed.
+  public var isDone: Bool {
+    return XLACheckpointSnapshot_done(handle)
+  }
+
+  /// Blocks until the save has completed.
+  public func wait() {
+    XLACheckpointSnapshot_wait(handle)
+  }
+}
+
+extension Array where Element == String {
+  /// Calls `body` with the strings of `self` as null terminated C strings.
+  fileprivate func withCStrings<Result>(_ body: ([UnsafePointer<CChar>?]) -> Result) -> Result {
+    var storage: [CChar] = []
+    var offsets: [Int] = []
+    for string in self {
+      offsets.append(storage.count)
+      storage.append(contentsOf: string.utf8CString)
+    }
+    return storage.withUnsafeBufferPointer { buf in
+      body(offsets.map { UnsafePointer(buf.baseAddress! + $0) })
+    }
+  }
+}
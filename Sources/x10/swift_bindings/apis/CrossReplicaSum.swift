@@ -12,45 +12,56 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+/// The precision the floating point tensors of a cross replica sum travel between the devices at.
+/// The reduced precisions halve the bytes to transfer, at the cost of summing in the narrower type.
+public enum CrossReplicaSumPrecision {
+  case full
+  case bfloat16
+  case half
+}
+
 /// Implements crossReplicaSum.
 protocol CrossReplicaSummable {
   /// A cross replica sum is an operation that runs simultaneously on multiple threads on
   /// multiple devices and replaces the value on each thread with a sum of all the other values.
-  mutating func crossReplicaSum(_ scale: Double)
+  mutating func crossReplicaSum(_ scale: Double, precision: CrossReplicaSumPrecision)
 }
 
 extension CrossReplicaSummable {
   /// Helper that applies a cross replica sum operation to a particular keypath.
   static func _doCrossReplicaSum<Root>(
     _ root: inout Root, _ partialKeyPath: PartialKeyPath<Root>,
-    _ scale: Double
+    _ scale: Double, _ precision: CrossReplicaSumPrecision
   ) {
     guard let keyPath = partialKeyPath as? WritableKeyPath<Root, Self> else {
       fatalError("Key path \(partialKeyPath) not writeable cannot copy to device")
     }
-    root[keyPath: keyPath].crossReplicaSum(scale)
+    root[keyPath: keyPath].crossReplicaSum(scale, precision: precision)
   }
 }
 
 extension Tensor: CrossReplicaSummable where Scalar: TensorFlowNumeric {
   /// Runs a cross replica sum for this tensor. The same cross replica sum
   /// must happen on each of the other devices participating in the sum.
-  public mutating func crossReplicaSum(_ scale: Double) {
-    self = _Raw.crossReplicaSum([self], scale).first!
+  public mutating func crossReplicaSum(
+    _ scale: Double, precision: CrossReplicaSumPrecision = .full
+  ) {
+    self = _Raw.crossReplicaSum([self], scale, precision: precision).first!
   }
 }
 
 extension _KeyPathIterableBase {
   /// Helper that iterates over all key paths and applies cross replica sum.
   func crossReplicaSumChild<Root>(
-    _ root: inout Root, _ kp: PartialKeyPath<Root>, _ scale: Double
+    _ root: inout Root, _ kp: PartialKeyPath<Root>, _ scale: Double,
+    _ precision: CrossReplicaSumPrecision
   ) {
     for nkp in _allKeyPathsTypeErased {
       let joinedkp = kp.appending(path: nkp)!
       if let valueType = type(of: joinedkp).valueType as? CrossReplicaSummable.Type {
-        valueType._doCrossReplicaSum(&root, joinedkp, scale)
+        valueType._doCrossReplicaSum(&root, joinedkp, scale, precision)
       } else if let value = self[keyPath: nkp], let nested = value as? _KeyPathIterableBase {
-        nested.crossReplicaSumChild(&root, joinedkp, scale)
+        nested.crossReplicaSumChild(&root, joinedkp, scale, precision)
       }
     }
   }
@@ -59,7 +70,9 @@ extension _KeyPathIterableBase {
 extension KeyPathIterable {
   /// Runs a cross replica sum over all of the tensors found through key path
   /// iteration.
-  public mutating func crossReplicaSum(_ scale: Double) {
-    crossReplicaSumChild(&self, \.self, scale)
+  public mutating func crossReplicaSum(
+    _ scale: Double, precision: CrossReplicaSumPrecision = .full
+  ) {
+    crossReplicaSumChild(&self, \.self, scale, precision)
   }
 }
@@ -0,0 +1,74 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+@_implementationOnly import x10_xla_tensor_wrapper
+
+/// A computation traced once and compiled, for serving.
+///
+/// The device data the computation reads besides its inputs, typically the weights of a model,
+/// gets bound to it when it is frozen. Calling it with new inputs runs the compiled computation
+/// right away, without tracing the model, hashing its graph or looking up the compilation cache.
+/// The bound weights are frozen: updating the model after the fact does not change the results,
+/// and the random ops get the same seeds on every call.
+public final class _FrozenXLAGraph {
+  let handle: UnsafeMutablePointer<OpaqueXLAFrozenGraph>
+  let outputTypes: [TensorFlowScalar.Type]
+  let inputCount: Int
+
+  /// Freezes the computation `body` performs over example `inputs`, which the later calls must
+  /// match in number, types and shapes. The inputs get materialized on their device first.
+  public init(inputs: [AnyTensor], body: ([AnyTensor]) -> [AnyTensor]) {
+    precondition(!inputs.isEmpty, "A frozen graph needs at least one input.")
+    inputs.withArrayRef { XLATensor_sync_tensors($0) }
+    let outputs = body(inputs)
+    outputTypes = outputs.map { $0.scalarType }
+    inputCount = inputs.count
+    handle = inputs.withArrayRef { inputHandles in
+      outputs.withArrayRef { outputHandles in
+        XLAFrozenGraph_create(inputHandles, outputHandles)!
+      }
+    }
+  }
+
+  deinit {
+    destroyXLAFrozenGraph(handle)
+  }
+
+  /// Runs the frozen computation over `inputs`.
+  public func callAsFunction(_ inputs: [AnyTensor]) -> [AnyTensor] {
+    inputs.withArrayRef { inputHandles in
+      let tensorListHandle = XLAFrozenGraph_run(handle, inputHandles)
+      defer { destroyOpaqueXLATensorArrayRef(tensorListHandle) }
+      return (0..<tensorListHandle.size).map { i in
+        outputTypes[i].wrapTensor(XLATensor(_handle: tensorListHandle.data[i]!))
+      }
+    }
+  }
+}
+
+extension _FrozenXLAGraph {
+  /// Freezes a computation from one tensor to another.
+  public convenience init<Input: TensorFlowScalar, Output: TensorFlowScalar>(
+    input: Tensor<Input>, body: (Tensor<Input>) -> Tensor<Output>
+  ) {
+    self.init(inputs: [input]) { inputs in [body(inputs[0] as! Tensor<Input>)] }
+  }
+
+  /// Runs a frozen computation from one tensor to another.
+  public func callAsFunction<Input: TensorFlowScalar, Output: TensorFlowScalar>(
+    _ input: Tensor<Input>, as output: Output.Type = Output.self
+  ) -> Tensor<Output> {
+    return self([input])[0] as! Tensor<Output>
+  }
+}
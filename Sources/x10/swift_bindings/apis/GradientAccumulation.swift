@@ -0,0 +1,88 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if canImport(Differentiation)
+import Differentiation
+#else
+import _Differentiation
+#endif
+
+/// Accumulates the gradients of the micro-batches of a large batch on an X10 device, and applies
+/// an optimizer to their mean once every `microBatchCount` micro-batches.
+///
+/// Every micro-batch ends with an asynchronous barrier on the device, so its forward and backward
+/// passes, followed by the sums into the accumulators, trace the same graph each time. It gets
+/// compiled once, and the buffers of the accumulators are donated to their new sums in place.
+/// The optimizer step and the reset of the accumulators form a second graph, compiled once too.
+/// Neither waits for the device to finish.
+///
+/// The accumulators cover the `Tensor<Float>` leaves of the tangent vector.
+public struct _XLAGradientAccumulator<Model: EuclideanDifferentiable>
+where Model.TangentVector: KeyPathIterable {
+  /// The number of micro-batches per optimizer step.
+  public let microBatchCount: Int
+  /// The device holding the model and the accumulators.
+  public let device: Device
+  /// The sums of the gradients of the micro-batches since the last optimizer step.
+  public private(set) var accumulated: Model.TangentVector
+  /// The number of micro-batches since the last optimizer step.
+  public private(set) var count: Int = 0
+
+  /// Creates zero accumulators for the gradients of `model`, which lives on the X10 `device`.
+  public init(for model: Model, microBatchCount: Int, on device: Device = .defaultXLA) {
+    precondition(microBatchCount > 0, "There must be at least one micro-batch per step.")
+    precondition(device.backend == .XLA, "Gradient accumulation needs an X10 device.")
+    self.microBatchCount = microBatchCount
+    self.device = device
+    accumulated = model.differentiableVectorView
+    Self.resetToZero(&accumulated)
+    // The zeros get materialized, so that the first micro-batch already traces the graph of the
+    // following ones.
+    LazyTensorBarrier(on: device)
+  }
+
+  /// Adds the `gradient` of a micro-batch into the accumulators. After the last micro-batch of
+  /// the batch, updates `model` with `optimizer` along the mean of the accumulated gradients,
+  /// and resets the accumulators.
+  ///
+  /// - Returns: Whether the optimizer got applied.
+  @discardableResult
+  public mutating func accumulate<Opt: Optimizer>(
+    _ gradient: Model.TangentVector, into model: inout Model, using optimizer: inout Opt
+  ) -> Bool where Opt.Model == Model {
+    for keyPath in accumulated.recursivelyAllWritableKeyPaths(to: Tensor<Float>.self) {
+      accumulated[keyPath: keyPath] += gradient[keyPath: keyPath]
+    }
+    count += 1
+    guard count == microBatchCount else {
+      LazyTensorBarrier(on: device)
+      return false
+    }
+    var mean = accumulated
+    for keyPath in mean.recursivelyAllWritableKeyPaths(to: Tensor<Float>.self) {
+      mean[keyPath: keyPath] /= Float(microBatchCount)
+    }
+    optimizer.update(&model, along: mean)
+    Self.resetToZero(&accumulated)
+    count = 0
+    LazyTensorBarrier(on: device)
+    return true
+  }
+
+  private static func resetToZero(_ vector: inout Model.TangentVector) {
+    for keyPath in vector.recursivelyAllWritableKeyPaths(to: Tensor<Float>.self) {
+      vector[keyPath: keyPath] = Tensor(zerosLike: vector[keyPath: keyPath])
+    }
+  }
+}
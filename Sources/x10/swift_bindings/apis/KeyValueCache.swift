@@ -0,0 +1,82 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/// A fixed-capacity cache of the attention keys and values of an autoregressive decoder.
+///
+/// The keys and values live in `[..., capacity, D]` buffers allocated once on the device, the
+/// appended rows get written in place at the current count, and the count is passed to the
+/// computation as device data. A decode step thus traces the same graph whatever its position,
+/// and runs the cached executable, while the parameter aliasing donates the cache buffers to the
+/// updated ones, so that a step costs in proportion to the rows it appends.
+public struct _XLAKeyValueCache<Scalar: TensorFlowFloatingPoint> {
+  /// The `[..., capacity, D]` keys, whose first `count` rows are valid.
+  public private(set) var keys: Tensor<Scalar>
+  /// The `[..., capacity, Dv]` values, whose first `count` rows are valid.
+  public private(set) var values: Tensor<Scalar>
+  /// The number of rows appended so far.
+  public private(set) var count: Int = 0
+  /// The count, on the device.
+  private var deviceCount: Tensor<Int32>
+
+  /// Allocates a cache of `capacity` rows on `device`, for the attention heads of `batchShape`.
+  public init(
+    batchShape: TensorShape, capacity: Int, keyDimension: Int, valueDimension: Int,
+    on device: Device = .defaultXLA
+  ) {
+    precondition(device.backend == .XLA, "The key value cache needs an X10 device.")
+    keys = Tensor(zeros: batchShape + [capacity, keyDimension], on: device)
+    values = Tensor(zeros: batchShape + [capacity, valueDimension], on: device)
+    deviceCount = Tensor(0, on: device)
+  }
+
+  /// The number of rows the cache holds.
+  public var capacity: Int { keys.shape[keys.rank - 2] }
+
+  /// Appends the `[..., n, D]` keys and `[..., n, Dv]` values after the cached rows.
+  public mutating func append(keys newKeys: Tensor<Scalar>, values newValues: Tensor<Scalar>) {
+    let rowCount = newKeys.shape[newKeys.rank - 2]
+    precondition(
+      newValues.shape[newValues.rank - 2] == rowCount,
+      "The keys and values to append have different row counts.")
+    precondition(count + rowCount <= capacity, "The key value cache is full.")
+    let device = keys.device
+    let zero = Tensor<Int32>(0, on: device)
+    var startIndices = Array(repeating: zero, count: keys.rank - 2)
+    startIndices.append(deviceCount)
+    startIndices.append(zero)
+    keys = _RawXLA.dynamicUpdateSlice(keys, newKeys, startIndices)
+    values = _RawXLA.dynamicUpdateSlice(values, newValues, startIndices)
+    count += rowCount
+    deviceCount = Tensor(Int32(count), on: device)
+  }
+
+  /// Computes the attention of the `[..., Sq, D]` `query` over the cached rows, where the query
+  /// rows are the last `Sq` appended ones, each seeing the keys up to its own position.
+  ///
+  /// - Parameters:
+  ///   - scale: The scale of the scores, which defaults to `1 / sqrt(D)`.
+  public func attention(query: Tensor<Scalar>, scale: Float? = nil) -> Tensor<Scalar> {
+    precondition(
+      query.shape[query.rank - 2] <= count, "The query has more rows than the cache holds.")
+    return _RawXLA.cachedAttention(
+      query: query, keyCache: keys, valueCache: values, length: deviceCount,
+      scale: _attentionScale(query, scale))
+  }
+
+  /// Empties the cache, keeping its buffers.
+  public mutating func reset() {
+    count = 0
+    deviceCount = Tensor(0, on: keys.device)
+  }
+}
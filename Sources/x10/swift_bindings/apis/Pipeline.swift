@@ -0,0 +1,111 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+@_implementationOnly import x10_xla_tensor_wrapper
+
+/// Runs a model split into stages, each frozen on its own device, over micro-batches, with the
+/// stages working on different micro-batches at the same time.
+///
+/// The forward graph of a stage takes the stage parameters followed by its activations: the
+/// outputs of the previous stage, or the micro-batch inputs for the first stage. The backward
+/// graph takes the stage parameters, the stage activations and the gradients of the stage
+/// outputs, which are the leading outputs of the backward graph of the next stage (none for the
+/// last stage). It outputs the gradients of the stage activations, followed by the stage results,
+/// like the gradients of the stage parameters. The activations and gradients get copied between
+/// the devices of the stages.
+public final class _XLAPipeline {
+  /// The order in which each stage runs the passes over the micro-batches.
+  public enum Schedule {
+    /// All the forward passes, then all the backward passes.
+    case gpipe
+    /// After a warmup, the forward pass of a micro-batch alternates with the backward pass of an
+    /// earlier one, which bounds the activations a stage holds by the number of stages.
+    case oneForwardOneBackward
+  }
+
+  private let handle: UnsafeMutablePointer<OpaqueXLAPipeline>
+  private let forward: [_FrozenXLAGraph]
+  private let backward: [_FrozenXLAGraph]?
+
+  /// Creates a pipeline out of the stage graphs. Inference pipelines have no `backward` graphs.
+  public init(
+    forward: [_FrozenXLAGraph], backward: [_FrozenXLAGraph]? = nil,
+    schedule: Schedule = .oneForwardOneBackward
+  ) {
+    precondition(!forward.isEmpty, "A pipeline needs at least one stage.")
+    precondition(
+      backward == nil || backward!.count == forward.count,
+      "A pipeline needs one backward graph per stage.")
+    self.forward = forward
+    self.backward = backward
+    var forwardHandles: [UnsafeMutablePointer<OpaqueXLAFrozenGraph>?] = forward.map { $0.handle }
+    var backwardHandles: [UnsafeMutablePointer<OpaqueXLAFrozenGraph>?]? = backward?.map {
+      $0.handle
+    }
+    handle = forwardHandles.withUnsafeMutableBufferPointer { forwardBuf in
+      if backwardHandles == nil {
+        return XLAPipeline_create(
+          forwardBuf.baseAddress, nil, forward.count, schedule == .oneForwardOneBackward)!
+      }
+      return backwardHandles!.withUnsafeMutableBufferPointer { backwardBuf in
+        XLAPipeline_create(
+          forwardBuf.baseAddress, backwardBuf.baseAddress, forward.count,
+          schedule == .oneForwardOneBackward)!
+      }
+    }
+  }
+
+  deinit {
+    destroyXLAPipeline(handle)
+  }
+
+  /// Runs the pipeline with `params[i]` as the parameters of stage `i`, over the `microBatches`,
+  /// which hold the inputs of the first stage. Returns the outputs of the last stage, and the
+  /// backward results of every stage, for each micro-batch.
+  public func callAsFunction(params: [[AnyTensor]], microBatches: [[AnyTensor]]) -> (
+    outputs: [[AnyTensor]], stageResults: [[[AnyTensor]]]
+  ) {
+    precondition(params.count == forward.count, "Wrong number of stage parameter lists.")
+    let numParams = params.map { $0.count }
+    let flatParams = params.flatMap { $0 }
+    let flatInputs = microBatches.flatMap { $0 }
+    return flatParams.withArrayRef { paramHandles in
+      flatInputs.withArrayRef { inputHandles in
+        let tensorListHandle = numParams.withUnsafeBufferPointer { numParams in
+          XLAPipeline_run(
+            handle, paramHandles, numParams.baseAddress, inputHandles, microBatches.count)
+        }
+        defer { destroyOpaqueXLATensorArrayRef(tensorListHandle) }
+        var index = 0
+        func take(_ types: ArraySlice<TensorFlowScalar.Type>) -> [AnyTensor] {
+          return types.map { type in
+            defer { index += 1 }
+            return type.wrapTensor(XLATensor(_handle: tensorListHandle.data[index]!))
+          }
+        }
+        let outputTypes = forward.last!.outputTypes[...]
+        let outputs = microBatches.map { _ in take(outputTypes) }
+        var stageResults: [[[AnyTensor]]] = []
+        if let backward = backward {
+          stageResults = (0..<forward.count).map { s in
+            let activationCount = forward[s].inputCount - numParams[s]
+            let resultTypes = backward[s].outputTypes.dropFirst(activationCount)
+            return microBatches.map { _ in take(resultTypes) }
+          }
+        }
+        return (outputs, stageResults)
+      }
+    }
+  }
+}
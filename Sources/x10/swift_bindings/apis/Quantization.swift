@@ -0,0 +1,149 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+@_implementationOnly import x10_xla_tensor_wrapper
+
+/// Collects the ranges the activations of a model span over calibration runs, into the X10
+/// metrics, to pick the scales of their int8 quantization.
+public enum ActivationCalibration {
+  /// Records the range of `activation` under `name`, into the `ActivationMin.<name>` and
+  /// `ActivationMax.<name>` metrics. This reads the range back to the host, so it only belongs in
+  /// calibration runs.
+  public static func record<Scalar: TensorFlowFloatingPoint>(
+    _ activation: Tensor<Scalar>, name: String
+  ) {
+    RecordActivationRange(
+      name, Float(activation.min().scalarized()), Float(activation.max().scalarized()))
+  }
+
+  /// Returns the range recorded under `name`, over the samples the metrics retain, or `nil` if
+  /// none has been recorded.
+  public static func range(name: String) -> (min: Float, max: Float)? {
+    var minValue: Float = 0
+    var maxValue: Float = 0
+    guard GetActivationRange(name, &minValue, &maxValue) else { return nil }
+    return (minValue, maxValue)
+  }
+}
+
+/// Returns the scale quantizing `range` symmetrically into int8.
+func _int8Scale(_ range: (min: Float, max: Float)) -> Float {
+  return Swift.max(Swift.max(-range.min, range.max) / 127, Float.leastNormalMagnitude)
+}
+
+/// Returns the scales quantizing the slices of `weight` along its last dimension symmetrically
+/// into int8.
+func _int8ChannelScales(_ weight: Tensor<Float>) -> Tensor<Float> {
+  let channelMax = abs(weight).max(squeezingAxes: Array(0..<(weight.rank - 1)))
+  return max(channelMax / 127, Float.leastNormalMagnitude)
+}
+
+/// The int8 inference version of a `Dense` layer.
+///
+/// The weight is quantized per output column and the input per tensor, both symmetrically, and
+/// their product is accumulated at int32 before being scaled back, so that the matrix
+/// multiplication runs on int8 operands.
+public struct QuantizedDense<Scalar: TensorFlowFloatingPoint> {
+  /// The quantized weight matrix.
+  public let weight: Tensor<Int8>
+  /// The scales of the columns of the weight matrix.
+  public let weightScales: Tensor<Float>
+  /// The scale of the input.
+  public let inputScale: Float
+  /// The bias vector.
+  public let bias: Tensor<Scalar>
+  /// The element-wise activation function.
+  public let activation: Dense<Scalar>.Activation
+
+  /// Quantizes the X10 `dense` layer, whose inputs span `inputRange`, like the range
+  /// `ActivationCalibration` recorded for them.
+  public init(_ dense: Dense<Scalar>, inputRange: (min: Float, max: Float)) {
+    precondition(!dense.batched, "Batched dense layers cannot be quantized.")
+    precondition(dense.weight.device.backend == .XLA, "Quantized layers need an X10 device.")
+    let weight = Tensor<Float>(dense.weight)
+    weightScales = _int8ChannelScales(weight)
+    self.weight = _RawXLA.quantize(
+      weight, scale: weightScales, zeroPoint: Tensor(0, on: weight.device), axis: -1)
+    inputScale = _int8Scale(inputRange)
+    bias = dense.bias
+    activation = dense.activation
+  }
+
+  /// Returns the output obtained from applying the layer to the given input.
+  public func callAsFunction(_ input: Tensor<Scalar>) -> Tensor<Scalar> {
+    let device = input.device
+    let zeroPoint = Tensor<Int32>(0, on: device)
+    let quantized = _RawXLA.quantize(
+      input, scale: Tensor(inputScale, on: device), zeroPoint: zeroPoint)
+    let product = _RawXLA.dequantize(
+      _RawXLA.quantizedMatMul(quantized, weight), scale: weightScales * inputScale,
+      zeroPoint: zeroPoint, axis: -1)
+    return activation(Tensor<Scalar>(product) + bias)
+  }
+}
+
+/// The int8 inference version of a `Conv2D` layer.
+///
+/// The filter is quantized per output channel and the input per tensor, both symmetrically, and
+/// the convolution accumulates their product at int32 before it gets scaled back.
+public struct QuantizedConv2D<Scalar: TensorFlowFloatingPoint> {
+  /// The quantized 4-D convolution filter.
+  public let filter: Tensor<Int8>
+  /// The scales of the output channels of the filter.
+  public let filterScales: Tensor<Float>
+  /// The scale of the input.
+  public let inputScale: Float
+  /// The bias vector.
+  public let bias: Tensor<Scalar>
+  /// The element-wise activation function.
+  public let activation: Conv2D<Scalar>.Activation
+  /// The strides of the sliding window for spatial dimensions.
+  public let strides: (Int, Int)
+  /// The padding algorithm for convolution.
+  public let padding: Padding
+  /// The dilation factor for spatial dimensions.
+  public let dilations: (Int, Int)
+
+  /// Quantizes the X10 `conv` layer, whose inputs span `inputRange`, like the range
+  /// `ActivationCalibration` recorded for them.
+  public init(_ conv: Conv2D<Scalar>, inputRange: (min: Float, max: Float)) {
+    precondition(conv.filter.device.backend == .XLA, "Quantized layers need an X10 device.")
+    let filter = Tensor<Float>(conv.filter)
+    filterScales = _int8ChannelScales(filter)
+    self.filter = _RawXLA.quantize(
+      filter, scale: filterScales, zeroPoint: Tensor(0, on: filter.device), axis: -1)
+    inputScale = _int8Scale(inputRange)
+    bias = conv.bias
+    activation = conv.activation
+    strides = conv.strides
+    padding = conv.padding
+    dilations = conv.dilations
+  }
+
+  /// Returns the output obtained from applying the layer to the given
+  /// `[batch size, height, width, input channel count]` input.
+  public func callAsFunction(_ input: Tensor<Scalar>) -> Tensor<Scalar> {
+    let device = input.device
+    let zeroPoint = Tensor<Int32>(0, on: device)
+    let quantized = _RawXLA.quantize(
+      input, scale: Tensor(inputScale, on: device), zeroPoint: zeroPoint)
+    let conv = _RawXLA.quantizedConv2D(
+      quantized, filter: filter,
+      strides: [1, Int32(strides.0), Int32(strides.1), 1], padding: padding.raw2,
+      dilations: [1, Int32(dilations.0), Int32(dilations.1), 1])
+    let output = _RawXLA.dequantize(
+      conv, scale: filterScales * inputScale, zeroPoint: zeroPoint, axis: -1)
+    return activation(Tensor<Scalar>(output) + bias)
+  }
+}
@@ -28,6 +28,28 @@ public enum _RawXLA {
   typealias AnyScalar = XLAScalarType
   typealias ScalarType = XLATensorScalarType
 
+  /// The distribution `randomInit` samples from.
+  public enum RandomInitDistribution {
+    /// Uniform between `-scale` and `scale`.
+    case uniform
+    /// Normal with `scale` as standard deviation.
+    case normal
+    /// Normal with `scale` as standard deviation, truncated at two standard deviations.
+    case truncatedNormal
+  }
+
+  /// The update rule of `optimizerStep`.
+  public enum OptimizerStepKind {
+    /// SGD with momentum, whose state is the velocity, and whose hyperparameters are the learning
+    /// rate, the momentum and the weight decay.
+    case sgdMomentum
+    /// Adam with the weight decay added to the gradient. The states are the first and second
+    /// moments, and the hyperparameters the learning rate, beta1, beta2 and the weight decay.
+    case adam
+    /// Adam with the weight decay added to the update instead of the gradient.
+    case adamW
+  }
+
   private static func canonicalDims(_ dims: [Int64], _ rank: Int64) -> [Int64] {
     dims.map { $0 < 0 ? $0 + rank : $0 }
   }
@@ -912,13 +934,297 @@ public enum _RawXLA {
   /// A simplified version of cross replica sum, with scaling.
   public static func crossReplicaSum<T: TensorFlowNumeric>(
     _ inputs: [Tensor<T>],
-    _ scale: Double
+    _ scale: Double,
+    precision: CrossReplicaSumPrecision = .full
   ) -> [Tensor<T>] {
-    XLATensor.crossReplicaSum(inputs.map { $0.xlaTensor }, scale).map {
+    XLATensor.crossReplicaSum(inputs.map { $0.xlaTensor }, scale, precision).map {
       Tensor(_xla: $0)
     }
   }
 
+  /// Computes the optimizer steps of all the `weights` with a single fused node, and returns them
+  /// along with the updated `states`. The states are state major: `states[s * weights.count + i]`
+  /// is the state `s` of weight `i`. The weight decay only applies with `applyWeightDecay`, and
+  /// `epsilon` gets added to the square root of the second moment by the Adam kinds.
+  public static func optimizerStep<T: FloatingPoint & TensorFlowScalar>(
+    kind: OptimizerStepKind,
+    weights: [Tensor<T>],
+    grads: [Tensor<T>],
+    states: [Tensor<T>],
+    hyperparameters: [Tensor<T>],
+    nesterov: Bool = false,
+    applyWeightDecay: Bool,
+    epsilon: Float = 0
+  ) -> (steps: [Tensor<T>], states: [Tensor<T>]) {
+    let results = XLATensor.optimizerStep(
+      kind, weights.map { $0.xlaTensor }, grads.map { $0.xlaTensor }, states.map { $0.xlaTensor },
+      hyperparameters.map { $0.xlaTensor }, nesterov, applyWeightDecay, epsilon
+    ).map { Tensor<T>(_xla: $0) }
+    return (Array(results[..<weights.count]), Array(results[weights.count...]))
+  }
+
+  /// Returns a scalar which is true when none of the elements of `tensors` is a NaN or an infinity.
+  /// All the tensors get reduced on the device by a single node, and unlike a check of their sum,
+  /// large finite values cannot overflow into a false positive.
+  public static func allFinite<T: FloatingPoint & TensorFlowScalar>(
+    _ tensors: [Tensor<T>]
+  ) -> Tensor<Bool> {
+    Tensor<Bool>(_xla: XLATensor.allFinite(tensors.map { $0.xlaTensor }))
+  }
+
+  /// Concatenates `input` across all the replicas along `axis`, in replica order. `shardCount` must
+  /// be the number of replicas.
+  public static func allGather<T: TensorFlowNumeric>(
+    _ input: Tensor<T>,
+    axis: Int,
+    shardCount: Int
+  ) -> Tensor<T> {
+    Tensor(_xla: XLATensor.allGather(input.xlaTensor, Int64(axis), Int64(shardCount)))
+  }
+
+  /// Sums `input` across all the replicas, scales the sum, and returns the slice of it along
+  /// `axis` which belongs to the current replica. `shardCount` must be the number of replicas, and
+  /// must divide the `axis` dimension.
+  public static func reduceScatter<T: TensorFlowNumeric>(
+    _ input: Tensor<T>,
+    _ scale: Double,
+    axis: Int,
+    shardCount: Int
+  ) -> Tensor<T> {
+    Tensor(
+      _xla: XLATensor.reduceScatter(input.xlaTensor, scale, Int64(axis), Int64(shardCount)))
+  }
+
+  /// Splits `input` of every replica into `splitCount` pieces along `splitAxis`, sends the pieces
+  /// to the replicas in order, and concatenates the pieces received along `concatAxis`.
+  /// `splitCount` must be the number of replicas.
+  public static func allToAll<T: TensorFlowScalar>(
+    _ input: Tensor<T>,
+    splitAxis: Int,
+    concatAxis: Int,
+    splitCount: Int
+  ) -> Tensor<T> {
+    Tensor(
+      _xla: XLATensor.allToAll(
+        input.xlaTensor, Int64(splitAxis), Int64(concatAxis), Int64(splitCount)))
+  }
+
+  /// Routes the tokens of the `[tokens, experts]` gates to their top `k` experts. Returns the
+  /// `[tokens, k]` experts of the tokens, and their positions within the expert buffers, which
+  /// are `capacity` for the tokens which do not fit.
+  public static func moeRouting<T: FloatingPoint & TensorFlowScalar>(
+    gates: Tensor<T>,
+    k: Int,
+    capacity: Int
+  ) -> (expertIndices: Tensor<Int32>, positions: Tensor<Int32>) {
+    let (expertIndices, positions) = XLATensor.moeRouting(
+      gates.xlaTensor, Int64(k), Int64(capacity))
+    return (Tensor(_xla: expertIndices), Tensor(_xla: positions))
+  }
+
+  /// Scatters the `[tokens, dim]` (or `[tokens, k, dim]`) input into
+  /// `[expertCount, capacity, dim]` expert buffers, following the routing, and sends every buffer
+  /// to the replica which holds its expert, out of `splitCount`.
+  public static func moeDispatch<T: TensorFlowScalar>(
+    _ input: Tensor<T>,
+    expertIndices: Tensor<Int32>,
+    positions: Tensor<Int32>,
+    expertCount: Int,
+    capacity: Int,
+    splitCount: Int
+  ) -> Tensor<T> {
+    Tensor(
+      _xla: XLATensor.moeDispatch(
+        input.xlaTensor, expertIndices.xlaTensor, positions.xlaTensor, Int64(expertCount),
+        Int64(capacity), Int64(splitCount)))
+  }
+
+  /// The inverse of `moeDispatch`: returns the expert outputs to the replicas of their tokens, as
+  /// `[tokens, k, dim]` rows.
+  public static func moeCombine<T: TensorFlowScalar>(
+    _ expertOutputs: Tensor<T>,
+    expertIndices: Tensor<Int32>,
+    positions: Tensor<Int32>,
+    splitCount: Int
+  ) -> Tensor<T> {
+    Tensor(
+      _xla: XLATensor.moeCombine(
+        expertOutputs.xlaTensor, expertIndices.xlaTensor, positions.xlaTensor,
+        Int64(splitCount)))
+  }
+
+  /// Normalizes `input` along `axis` with the mean and variance of the whole batch, over all the
+  /// replicas, then scales it by `scale` and shifts it by `offset`. Returns the output along with
+  /// the batch mean and (biased) variance, which the gradient takes. The statistics of all the
+  /// replicas get reduced with a single all-reduce.
+  public static func syncBatchNorm<T: FloatingPoint & TensorFlowScalar>(
+    _ input: Tensor<T>,
+    scale: Tensor<T>,
+    offset: Tensor<T>,
+    axis: Int,
+    epsilon: Double
+  ) -> (output: Tensor<T>, mean: Tensor<T>, variance: Tensor<T>) {
+    let (output, mean, variance) = XLATensor.syncBatchNorm(
+      input.xlaTensor, scale.xlaTensor, offset.xlaTensor, Int64(axis), epsilon)
+    return (Tensor(_xla: output), Tensor(_xla: mean), Tensor(_xla: variance))
+  }
+
+  /// Computes the gradients of `syncBatchNorm` wrt its input, scale and offset, with a single
+  /// all-reduce. The scale and offset gradients are the ones of the local replica.
+  public static func syncBatchNormGrad<T: FloatingPoint & TensorFlowScalar>(
+    gradOutput: Tensor<T>,
+    input: Tensor<T>,
+    scale: Tensor<T>,
+    mean: Tensor<T>,
+    variance: Tensor<T>,
+    axis: Int,
+    epsilon: Double
+  ) -> (input: Tensor<T>, scale: Tensor<T>, offset: Tensor<T>) {
+    let (input, scale, offset) = XLATensor.syncBatchNormBackward(
+      gradOutput.xlaTensor, input.xlaTensor, scale.xlaTensor, mean.xlaTensor,
+      variance.xlaTensor, Int64(axis), epsilon)
+    return (Tensor(_xla: input), Tensor(_xla: scale), Tensor(_xla: offset))
+  }
+
+  /// Computes the channels last convolution of `input` and `filter`, adds `bias` along the output
+  /// features and applies a ReLU when `relu` is set, as a single convolution epilogue. On GPU, the
+  /// backend runs it as one cuDNN fused convolution, without writing the result before the bias
+  /// and activation out.
+  public static func convBiasActivation<T: FloatingPoint & TensorFlowScalar>(
+    _ input: Tensor<T>,
+    filter: Tensor<T>,
+    bias: Tensor<T>,
+    relu: Bool,
+    strides: [Int64],
+    padding: Padding,
+    dilations: [Int64]
+  ) -> Tensor<T> {
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(filter) }
+    defer { _fixLifetime(bias) }
+    return strides.withArrayRef { strides in
+      [Int64]().withArrayRef { explicitPaddings in
+        dilations.withArrayRef { dilations in
+          Tensor(
+            _xlaHandle: XLATensor_tf_conv_bias_activation(
+              input.xlaHandle, filter.xlaHandle, bias.xlaHandle, relu, false, strides,
+              convertPadding(padding), explicitPaddings, TFDataFormat_NHWC, dilations))
+        }
+      }
+    }
+  }
+
+  /// Computes the gradients of `convBiasActivation` wrt its input, filter and bias, given its
+  /// output, which masks the gradient of the ReLU.
+  public static func convBiasActivationGrad<T: FloatingPoint & TensorFlowScalar>(
+    gradOutput: Tensor<T>,
+    input: Tensor<T>,
+    filter: Tensor<T>,
+    output: Tensor<T>,
+    relu: Bool,
+    strides: [Int64],
+    padding: Padding,
+    dilations: [Int64]
+  ) -> (input: Tensor<T>, filter: Tensor<T>, bias: Tensor<T>) {
+    defer { _fixLifetime(gradOutput) }
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(filter) }
+    defer { _fixLifetime(output) }
+    let grads = strides.withArrayRef { strides in
+      [Int64]().withArrayRef { explicitPaddings in
+        dilations.withArrayRef { dilations in
+          XLATensor_tf_conv_bias_activation_backward(
+            gradOutput.xlaHandle, input.xlaHandle, filter.xlaHandle, output.xlaHandle, relu,
+            false, strides, convertPadding(padding), explicitPaddings, TFDataFormat_NHWC,
+            dilations)
+        }
+      }
+    }
+    return (
+      Tensor(_xlaHandle: grads.v0), Tensor(_xlaHandle: grads.v1), Tensor(_xlaHandle: grads.v2)
+    )
+  }
+
+  /// Runs a step of an LSTM cell as a single node, with `weight` the
+  /// `[inputSize + hiddenSize, 4 * hiddenSize]` projection of the concatenated input and hidden
+  /// state, for the input, update, forget and output gates. Returns the new states along with the
+  /// activated gates, which the gradient takes.
+  public static func lstmCell<T: FloatingPoint & TensorFlowScalar>(
+    input: Tensor<T>,
+    hidden: Tensor<T>,
+    cell: Tensor<T>,
+    weight: Tensor<T>,
+    bias: Tensor<T>
+  ) -> (cell: Tensor<T>, hidden: Tensor<T>, gates: Tensor<T>) {
+    let (newCell, newHidden, gates) = XLATensor.lstmCell(
+      input.xlaTensor, hidden.xlaTensor, cell.xlaTensor, weight.xlaTensor, bias.xlaTensor)
+    return (Tensor(_xla: newCell), Tensor(_xla: newHidden), Tensor(_xla: gates))
+  }
+
+  /// Computes the gradients of `lstmCell` wrt its input, states, weight and bias, as a single
+  /// node.
+  public static func lstmCellGrad<T: FloatingPoint & TensorFlowScalar>(
+    gradCell: Tensor<T>,
+    gradHidden: Tensor<T>,
+    input: Tensor<T>,
+    hidden: Tensor<T>,
+    cell: Tensor<T>,
+    weight: Tensor<T>,
+    gates: Tensor<T>,
+    newCell: Tensor<T>
+  ) -> (
+    input: Tensor<T>, hidden: Tensor<T>, cell: Tensor<T>, weight: Tensor<T>, bias: Tensor<T>
+  ) {
+    let grads = XLATensor.lstmCellBackward(
+      gradCell.xlaTensor, gradHidden.xlaTensor, input.xlaTensor, hidden.xlaTensor,
+      cell.xlaTensor, weight.xlaTensor, gates.xlaTensor, newCell.xlaTensor)
+    return (
+      Tensor(_xla: grads[0]), Tensor(_xla: grads[1]), Tensor(_xla: grads[2]),
+      Tensor(_xla: grads[3]), Tensor(_xla: grads[4])
+    )
+  }
+
+  /// Runs a step of a GRU cell as a single node, with `kernel` the `[inputSize, 3 * hiddenSize]`
+  /// and `recurrentKernel` the `[hiddenSize, 3 * hiddenSize]` projections for the update, reset
+  /// and output gates. Returns the new hidden state along with the activated gates and the
+  /// recurrent projection of the output gate, which the gradient takes.
+  public static func gruCell<T: FloatingPoint & TensorFlowScalar>(
+    input: Tensor<T>,
+    hidden: Tensor<T>,
+    kernel: Tensor<T>,
+    recurrentKernel: Tensor<T>,
+    bias: Tensor<T>,
+    recurrentBias: Tensor<T>
+  ) -> (hidden: Tensor<T>, gates: Tensor<T>, recurrentOutput: Tensor<T>) {
+    let (newHidden, gates, recurrentOutput) = XLATensor.gruCell(
+      input.xlaTensor, hidden.xlaTensor, kernel.xlaTensor, recurrentKernel.xlaTensor,
+      bias.xlaTensor, recurrentBias.xlaTensor)
+    return (Tensor(_xla: newHidden), Tensor(_xla: gates), Tensor(_xla: recurrentOutput))
+  }
+
+  /// Computes the gradients of `gruCell` wrt its input, hidden state, kernels and biases, as a
+  /// single node.
+  public static func gruCellGrad<T: FloatingPoint & TensorFlowScalar>(
+    gradHidden: Tensor<T>,
+    input: Tensor<T>,
+    hidden: Tensor<T>,
+    kernel: Tensor<T>,
+    recurrentKernel: Tensor<T>,
+    gates: Tensor<T>,
+    recurrentOutput: Tensor<T>
+  ) -> (
+    input: Tensor<T>, hidden: Tensor<T>, kernel: Tensor<T>, recurrentKernel: Tensor<T>,
+    bias: Tensor<T>, recurrentBias: Tensor<T>
+  ) {
+    let grads = XLATensor.gruCellBackward(
+      gradHidden.xlaTensor, input.xlaTensor, hidden.xlaTensor, kernel.xlaTensor,
+      recurrentKernel.xlaTensor, gates.xlaTensor, recurrentOutput.xlaTensor)
+    return (
+      Tensor(_xla: grads[0]), Tensor(_xla: grads[1]), Tensor(_xla: grads[2]),
+      Tensor(_xla: grads[3]), Tensor(_xla: grads[4]), Tensor(_xla: grads[5])
+    )
+  }
+
   /// Compute the cumulative product of the tensor `x` along `axis`.
   ///
   /// By default, this op performs an inclusive cumprod, which means that the first
@@ -1264,6 +1570,19 @@ public enum _RawXLA {
       e: _RawXLA.mul(gradients, _RawXLA.addV2(outputs, _RawXLA.onesLike(outputs))))
   }
 
+  /// Adds the `[N, ...]` `values` rows into the rows of `table` selected by the `[N]` `indices`.
+  /// Repeated indices accumulate, and out of range indices get dropped.
+  public static func embeddingSparseUpdate<
+    T: TensorFlowNumeric,
+    Ti: TensorFlowIndex
+  >(
+    _ table: Tensor<T>,
+    indices: Tensor<Ti>,
+    values: Tensor<T>
+  ) -> Tensor<T> {
+    embedding_sparse_update(table, indices: indices, values: values)
+  }
+
   /// Returns the truth value of (x == y) element-wise.
   ///
   /// *NOTE*: `Equal` supports broadcasting. More about broadcasting
@@ -1518,6 +1837,32 @@ public enum _RawXLA {
     return Tensor<T>(shape: [scalars.count], scalars: scalars, on: x.device)
   }
 
+  /// Normalizes `input` along `dim` and applies the `weight` and `bias` affine transform, as a
+  /// single fused node. Returns the output along with the mean and the inverse standard
+  /// deviation, which the gradient takes.
+  public static func layerNorm<T: FloatingPoint & TensorFlowScalar>(
+    _ input: Tensor<T>,
+    weight: Tensor<T>,
+    bias: Tensor<T>,
+    dim: Int64,
+    eps: Float
+  ) -> (output: Tensor<T>, mean: Tensor<T>, invstd: Tensor<T>) {
+    layer_norm(input, weight: weight, bias: bias, dim: dim, eps: eps)
+  }
+
+  /// Computes the gradients of `layerNorm` wrt its input, weight and bias.
+  public static func layerNormBackward<T: FloatingPoint & TensorFlowScalar>(
+    gradOutput: Tensor<T>,
+    input: Tensor<T>,
+    weight: Tensor<T>,
+    mean: Tensor<T>,
+    invstd: Tensor<T>,
+    dim: Int64
+  ) -> (input: Tensor<T>, weight: Tensor<T>, bias: Tensor<T>) {
+    layer_norm_backward(
+      gradOutput: gradOutput, input: input, weight: weight, mean: mean, invstd: invstd, dim: dim)
+  }
+
   /// Computes rectified linear: `max(features, features * alpha)`.
   public static func leakyRelu<T: FloatingPoint & TensorFlowScalar>(
     features: Tensor<T>,
@@ -2410,10 +2755,38 @@ public enum _RawXLA {
     return threshold(features, output: gradients, threshold: 0, value: 0)
   }
 
+  /// Samples a tensor of the given shape on `device`, with the seed baked into the graph, so that
+  /// initializing a parameter neither uploads anything to the device, nor runs anything on the
+  /// host. The parameters created this way get sampled by the graph which first uses them.
+  public static func randomInit<T: FloatingPoint & TensorFlowScalar>(
+    shape: [Int],
+    distribution: RandomInitDistribution,
+    scale: Double,
+    seed: TensorFlowSeed,
+    device: Device
+  ) -> Tensor<T> {
+    return Tensor(
+      _xla: XLATensor.random_init(
+        shape.map { Int64($0) }, distribution, scale, Int64(seed.graph), Int64(seed.op),
+        T.xlaTensorScalarType, device))
+  }
+
   public static func replicaId(_ device: Device) -> Tensor<Int32> {
     return Tensor(_xla: XLATensor.replica_id(device))
   }
 
+  /// Returns the seed of the next stateless random op of the step on `device`, which gets derived
+  /// on the device from the step seed and from the index of the op within the step.
+  public static func stepRandomSeed(_ device: Device) -> Tensor<Int32> {
+    return Tensor(_xla: XLATensor.rng_seed(device))
+  }
+
+  /// Whether the random ops of the layers take their seeds from `stepRandomSeed`, as set by
+  /// `XLA_STEP_RNG`.
+  public static var usesStepRandomSeeds: Bool {
+    return XLATensor.useStepRngSeeds
+  }
+
   /// Reshapes a tensor.
   ///
   /// Given `tensor`, this operation returns a tensor that has the same values
@@ -2516,6 +2889,204 @@ public enum _RawXLA {
       _RawXLA.mul(_RawXLA.mul(y, y), y), _RawXLA.div(dy, Tensor<T>(-2, deviceAndPrecisionLike: y)))
   }
 
+  /// Scales `input` by its inverse root mean square along `dim` and by `weight`, as a single
+  /// fused node. Returns the output along with the inverse root mean square, which the gradient
+  /// takes.
+  public static func rmsNorm<T: FloatingPoint & TensorFlowScalar>(
+    _ input: Tensor<T>,
+    weight: Tensor<T>,
+    dim: Int64,
+    eps: Float
+  ) -> (output: Tensor<T>, invrms: Tensor<T>) {
+    rms_norm(input, weight: weight, dim: dim, eps: eps)
+  }
+
+  /// Computes the gradients of `rmsNorm` wrt its input and weight.
+  public static func rmsNormBackward<T: FloatingPoint & TensorFlowScalar>(
+    gradOutput: Tensor<T>,
+    input: Tensor<T>,
+    weight: Tensor<T>,
+    invrms: Tensor<T>,
+    dim: Int64
+  ) -> (input: Tensor<T>, weight: Tensor<T>) {
+    rms_norm_backward(
+      gradOutput: gradOutput, input: input, weight: weight, invrms: invrms, dim: dim)
+  }
+
+  /// Greedily selects up to `outputSize` boxes in decreasing score order, pruning the boxes whose
+  /// IoU with an already selected box is above `iouThreshold` and the ones scoring at most
+  /// `scoreThreshold`. The scores are either `[numBoxes]`, or `[batch, numBoxes]` for a batch of
+  /// independent selections, e.g. one per class, over the `[numBoxes, 4]` or `[batch, numBoxes, 4]`
+  /// boxes. When `preNmsTopK` is positive, only that many of the highest scoring boxes get
+  /// considered. The selected indices are padded to `outputSize`, the first `validOutputs` of
+  /// which are meaningful.
+  public static func nonMaxSuppression<T: FloatingPoint & TensorFlowScalar>(
+    boxes: Tensor<T>,
+    scores: Tensor<T>,
+    scoreThreshold: Tensor<T>,
+    iouThreshold: Tensor<T>,
+    outputSize: Int64,
+    preNmsTopK: Int64 = 0
+  ) -> (selectedIndices: Tensor<Int32>, validOutputs: Tensor<Int32>) {
+    non_max_suppression(
+      boxes: boxes, scores: scores, scoreThreshold: scoreThreshold, iouThreshold: iouThreshold,
+      outputSize: outputSize, preNmsTopK: preNmsTopK)
+  }
+
+  /// Computes `softmax(scale * query • key^T) • value` as a single fused node, and returns the
+  /// output along with the log-sum-exp of the scaled scores, which the gradient takes.
+  public static func scaledDotProductAttention<T: FloatingPoint & TensorFlowScalar>(
+    query: Tensor<T>,
+    key: Tensor<T>,
+    value: Tensor<T>,
+    scale: Float
+  ) -> (output: Tensor<T>, logsumexp: Tensor<T>) {
+    scaled_dot_product_attention(query: query, key: key, value: value, scale: scale)
+  }
+
+  /// Computes the gradients of `scaledDotProductAttention` wrt its query, key and value.
+  public static func scaledDotProductAttentionGrad<T: FloatingPoint & TensorFlowScalar>(
+    gradOutput: Tensor<T>,
+    query: Tensor<T>,
+    key: Tensor<T>,
+    value: Tensor<T>,
+    output: Tensor<T>,
+    logsumexp: Tensor<T>,
+    scale: Float
+  ) -> (query: Tensor<T>, key: Tensor<T>, value: Tensor<T>) {
+    scaled_dot_product_attention_grad(
+      gradOutput: gradOutput, query: query, key: key, value: value, output: output,
+      logsumexp: logsumexp, scale: scale)
+  }
+
+  /// Computes `scaledDotProductAttention` over packed rows, where each query row only sees the key
+  /// rows of the same segment. The segment ids hold the leading batch dimensions of `query`,
+  /// followed by its rows for `querySegmentIds` and by the key rows for `keySegmentIds`.
+  public static func segmentedScaledDotProductAttention<T: FloatingPoint & TensorFlowScalar>(
+    query: Tensor<T>,
+    key: Tensor<T>,
+    value: Tensor<T>,
+    querySegmentIds: Tensor<Int32>,
+    keySegmentIds: Tensor<Int32>,
+    scale: Float
+  ) -> (output: Tensor<T>, logsumexp: Tensor<T>) {
+    segmented_scaled_dot_product_attention(
+      query: query, key: key, value: value, querySegmentIds: querySegmentIds,
+      keySegmentIds: keySegmentIds, scale: scale)
+  }
+
+  /// Computes the gradients of `segmentedScaledDotProductAttention` wrt its query, key and value.
+  public static func segmentedScaledDotProductAttentionGrad<T: FloatingPoint & TensorFlowScalar>(
+    gradOutput: Tensor<T>,
+    query: Tensor<T>,
+    key: Tensor<T>,
+    value: Tensor<T>,
+    output: Tensor<T>,
+    logsumexp: Tensor<T>,
+    querySegmentIds: Tensor<Int32>,
+    keySegmentIds: Tensor<Int32>,
+    scale: Float
+  ) -> (query: Tensor<T>, key: Tensor<T>, value: Tensor<T>) {
+    segmented_scaled_dot_product_attention_grad(
+      gradOutput: gradOutput, query: query, key: key, value: value, output: output,
+      logsumexp: logsumexp, querySegmentIds: querySegmentIds, keySegmentIds: keySegmentIds,
+      scale: scale)
+  }
+
+  /// Computes the attention of `query` over the first `length` rows of `keyCache` and
+  /// `valueCache`, where the query rows are the last cached ones, each seeing the keys up to its
+  /// own position. Only the blocks of keys below `length` are visited.
+  public static func cachedAttention<T: FloatingPoint & TensorFlowScalar>(
+    query: Tensor<T>,
+    keyCache: Tensor<T>,
+    valueCache: Tensor<T>,
+    length: Tensor<Int32>,
+    scale: Float
+  ) -> Tensor<T> {
+    cached_attention(
+      query: query, keyCache: keyCache, valueCache: valueCache, length: length, scale: scale)
+  }
+
+  /// Quantizes `input` into int8, as `round(input / scale) + zeroPoint` saturated to the int8
+  /// range. `scale` and `zeroPoint` are either scalars, or hold one value per index of the `axis`
+  /// dimension.
+  public static func quantize<T: FloatingPoint & TensorFlowScalar>(
+    _ input: Tensor<T>,
+    scale: Tensor<Float>,
+    zeroPoint: Tensor<Int32>,
+    axis: Int64 = -1
+  ) -> Tensor<Int8> {
+    quantize_tensor(input, scale: scale, zeroPoint: zeroPoint, axis: axis)
+  }
+
+  /// Maps the int8 or int32 `input` back to floats, as `(input - zeroPoint) * scale`, with the
+  /// same quantization parameters as `quantize(_:scale:zeroPoint:axis:)`.
+  public static func dequantize<T: TensorFlowInteger>(
+    _ input: Tensor<T>,
+    scale: Tensor<Float>,
+    zeroPoint: Tensor<Int32>,
+    axis: Int64 = -1
+  ) -> Tensor<Float> {
+    dequantize_tensor(input, scale: scale, zeroPoint: zeroPoint, axis: axis)
+  }
+
+  /// Rescales the int32 accumulators of a quantized matrix multiplication or convolution into
+  /// int8, as `round(input * scale) + zeroPoint`, where `scale` is the product of the scales of
+  /// the operands over the scale of the result.
+  public static func requantize(
+    _ input: Tensor<Int32>,
+    scale: Tensor<Float>,
+    zeroPoint: Tensor<Int32>,
+    axis: Int64 = -1
+  ) -> Tensor<Int8> {
+    requantize_tensor(input, scale: scale, zeroPoint: zeroPoint, axis: axis)
+  }
+
+  /// Multiplies the symmetrically quantized int8 matrices, accumulating the result at int32.
+  public static func quantizedMatMul(_ lhs: Tensor<Int8>, _ rhs: Tensor<Int8>) -> Tensor<Int32> {
+    quantized_matmul(lhs, rhs)
+  }
+
+  /// Computes the 2-D convolution of the symmetrically quantized int8 input and filter,
+  /// accumulating the result at int32. The attributes are the ones of `conv2D`.
+  public static func quantizedConv2D(
+    _ input: Tensor<Int8>,
+    filter: Tensor<Int8>,
+    strides: [Int32],
+    padding: Padding1,
+    explicitPaddings: [Int32] = [],
+    dataFormat: DataFormat = .nhwc,
+    dilations: [Int32] = [1, 1, 1, 1]
+  ) -> Tensor<Int32> {
+    quantized_conv(
+      input, filter, strides.map { Int64($0) }, convertPadding1(padding),
+      explicitPaddings.map { Int64($0) }, convertDataFormat(dataFormat),
+      dilations.map { Int64($0) })
+  }
+
+  /// Randomly crops, resizes, flips and color jitters the `[N, H, W, C]` `images` into `[N,
+  /// outputSize[0], outputSize[1], C]` floats in `[0, 1]`, uint8 images being scaled by `1 / 255`.
+  /// Each image draws its crop, flip and jitter factors from the `[2]` `seeds`, so the same seeds
+  /// give the same batch.
+  public static func augmentImages<T: TensorFlowNumeric>(
+    _ images: Tensor<T>,
+    seeds: Tensor<Int32>,
+    outputSize: [Int64],
+    minArea: Float,
+    maxArea: Float,
+    minAspectRatio: Float,
+    maxAspectRatio: Float,
+    flip: Bool,
+    brightness: Float,
+    contrast: Float,
+    saturation: Float
+  ) -> Tensor<Float> {
+    augment_images(
+      images, seeds: seeds, outputSize: outputSize, minArea: minArea, maxArea: maxArea,
+      minAspectRatio: minAspectRatio, maxAspectRatio: maxAspectRatio, flip: flip,
+      brightness: brightness, contrast: contrast, saturation: saturation)
+  }
+
   /// Selects elements from `x` or `y`, depending on `condition`.
   ///
   /// The `x`, and `y` tensors must all have the same shape, and the
@@ -2846,23 +3417,8 @@ public enum _RawXLA {
     features: Tensor<T>,
     labels: Tensor<Tlabels>
   ) -> (loss: Tensor<T>, backprop: Tensor<T>) {
-    checkSameDevice(features.device, labels.device)
-    let device = labels.device
-    let tmp_output = _RawXLA.logSoftmax(logits: features)
-    var one_hot = _RawXLA.neg(
-      _RawXLA.oneHot(
-        indices: labels, depth: Int64(features.shape[1]),
-        onValue: Tensor<T>(1, on: device),
-        offValue: Tensor<T>(0, on: device)))
-    if features.isReducedPrecision {
-      one_hot = one_hot.toReducedPrecision
-    }
-    let loss = _RawXLA.sum(
-      _RawXLA.mul(one_hot, tmp_output),
-      reductionIndices: [Int64(1)], keepDims: false)
-    // one_hot stands in for the backprop gradient as it has the right shape
-    // and will multiplied on the backwards pass.
-    let backprop = logSoftmaxBackward(gradOutput: one_hot, output: tmp_output, dim: -1)
+    let (loss, backprop) = _RawXLA.sparse_softmax_cross_entropy(
+      features: features, labels: labels)
     return (loss: loss, backprop: backprop)
   }
 
@@ -3576,7 +4132,21 @@ public enum _RawXLA {
       rhs = flip(rhs, dims: dimensionsToReverse)
     }
     rhs = resize_value(rhs, dims: sliceDims)
-    return updateSlice(input: input, source: rhs, baseIndices: sliceBegin)
+    return updateSlice(input, rhs, at: sliceBegin)
+  }
+
+  /// Same as `updateSlice(input:source:baseIndices:)`, but the base indices are passed to the
+  /// computation as device data, so that the updates at different positions (like appending to
+  /// the caches of a decode loop) share a compilation and update the donated buffer in place.
+  static func updateSlice<T: TensorFlowScalar>(
+    _ input: Tensor<T>, _ source: Tensor<T>, at baseIndices: [Int64]
+  ) -> Tensor<T> {
+    defer { _fixLifetime(input) }
+    defer { _fixLifetime(source) }
+    return baseIndices.withArrayRef { baseIndices in
+      Tensor(
+        _xlaHandle: XLATensor_update_slice_at(input.xlaHandle, source.xlaHandle, baseIndices))
+    }
   }
 
   /// Constructs a tensor by tiling a given tensor.
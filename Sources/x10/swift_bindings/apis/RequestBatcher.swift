@@ -0,0 +1,73 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+@_implementationOnly import x10_xla_tensor_wrapper
+
+/// Batches the concurrent calls to a served computation, to run them with one execution each
+/// batch instead of one per call.
+///
+/// The computation gets frozen once per batch size. The inputs of a call have a leading batch
+/// dimension: the concurrent calls get concatenated along it, up to the largest batch size, and
+/// zero padded to the smallest batch size which fits them, then the outputs get split back along
+/// their own leading dimension. The first call of a batch waits for at most `maxLatency` seconds
+/// for the others to come in, unless the largest batch size fills up first.
+public final class _XLARequestBatcher {
+  private let handle: UnsafeMutablePointer<OpaqueXLARequestBatcher>
+  private let outputTypes: [TensorFlowScalar.Type]
+
+  /// Freezes the computation `body` performs for each of the `batchSizes`, tracing it over
+  /// `example` inputs with their first row repeated to the batch size.
+  public init(
+    example: [AnyTensor], batchSizes: [Int], maxLatency: Double,
+    body: ([AnyTensor]) -> [AnyTensor]
+  ) {
+    precondition(!batchSizes.isEmpty, "A request batcher needs at least one batch size.")
+    let graphs = batchSizes.map { batchSize in
+      _FrozenXLAGraph(
+        inputs: example.map { $0.scalarType.repeatingFirstRow($0, count: batchSize) },
+        body: body)
+    }
+    outputTypes = graphs[0].outputTypes
+    var graphHandles: [UnsafeMutablePointer<OpaqueXLAFrozenGraph>?] = graphs.map { $0.handle }
+    handle = batchSizes.map { Int64($0) }.withArrayRef { sizes in
+      graphHandles.withUnsafeMutableBufferPointer { buf in
+        XLARequestBatcher_create(sizes, buf.baseAddress, Int64(maxLatency * 1e6))!
+      }
+    }
+  }
+
+  deinit {
+    destroyXLARequestBatcher(handle)
+  }
+
+  /// Runs the computation over `inputs`, possibly batched with the concurrent calls.
+  public func callAsFunction(_ inputs: [AnyTensor]) -> [AnyTensor] {
+    inputs.withArrayRef { inputHandles in
+      let tensorListHandle = XLARequestBatcher_run(handle, inputHandles)
+      defer { destroyOpaqueXLATensorArrayRef(tensorListHandle) }
+      return (0..<tensorListHandle.size).map { i in
+        outputTypes[i].wrapTensor(XLATensor(_handle: tensorListHandle.data[i]!))
+      }
+    }
+  }
+}
+
+extension TensorFlowScalar {
+  fileprivate static func repeatingFirstRow(_ t: AnyTensor, count: Int) -> AnyTensor {
+    let tensor = t as! Tensor<Self>
+    var shape = tensor.shape
+    shape[0] = count
+    return tensor[0..<1].broadcasted(to: shape)
+  }
+}
@@ -0,0 +1,126 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if canImport(Differentiation)
+import Differentiation
+#else
+import _Differentiation
+#endif
+
+/// Scans `body` over the leading dimension of `sequence`, starting from the `initial` state, and
+/// returns the states after each step stacked along the leading dimension. The body takes the
+/// parameters, the current state and the element of the sequence, and returns the next state.
+///
+/// On X10, both the scan and its pullback lower to a single loop, so that the size of the trace
+/// does not grow with the length of the sequence. The pullback is a reverse scan over the states
+/// saved by the forward one, which accumulates the gradient of the parameters in its carry.
+@differentiable(reverse, wrt: (parameters, initial, sequence))
+public func _scan<Parameters: EuclideanDifferentiable>(
+  _ parameters: Parameters, initial: Tensor<Float>, over sequence: Tensor<Float>,
+  body: @escaping @differentiable(reverse) (Parameters, Tensor<Float>, Tensor<Float>)
+    -> Tensor<Float>
+) -> Tensor<Float> where Parameters.TangentVector: KeyPathIterable {
+  let length = withoutDerivative(at: sequence.shape[0])
+  precondition(length > 0, "The sequence must not be empty.")
+  guard sequence.device.backend == .XLA else {
+    return _scanLoop(parameters, initial: initial, over: sequence, body: body)
+  }
+  return _scanXLA(parameters, initial: initial, over: sequence, body: body)
+}
+
+/// The unrolled `_scan`, for the other backends.
+@differentiable(reverse, wrt: (parameters, initial, sequence))
+func _scanLoop<Parameters: Differentiable>(
+  _ parameters: Parameters, initial: Tensor<Float>, over sequence: Tensor<Float>,
+  body: @escaping @differentiable(reverse) (Parameters, Tensor<Float>, Tensor<Float>)
+    -> Tensor<Float>
+) -> Tensor<Float> {
+  var state = initial
+  var states: [Tensor<Float>] = []
+  for step in 0..<withoutDerivative(at: sequence.shape[0]) {
+    state = body(parameters, state, sequence[step])
+    states.append(state)
+  }
+  return Tensor(stacking: states)
+}
+
+@derivative(of: _scan)
+func _vjpScan<Parameters: EuclideanDifferentiable>(
+  _ parameters: Parameters, initial: Tensor<Float>, over sequence: Tensor<Float>,
+  body: @escaping @differentiable(reverse) (Parameters, Tensor<Float>, Tensor<Float>)
+    -> Tensor<Float>
+) -> (
+  value: Tensor<Float>,
+  pullback: (Tensor<Float>) -> (Parameters.TangentVector, Tensor<Float>, Tensor<Float>)
+) where Parameters.TangentVector: KeyPathIterable {
+  guard sequence.device.backend == .XLA else {
+    return valueWithPullback(at: parameters, initial, sequence) { parameters, initial, sequence in
+      _scanLoop(parameters, initial: initial, over: sequence, body: body)
+    }
+  }
+  let states = _scanXLA(parameters, initial: initial, over: sequence, body: body)
+  return (
+    states,
+    { 𝛁states in
+      let 𝛁states = 𝛁states.broadcasted(like: states)
+      let length = sequence.shape[0]
+      let device = sequence.device
+      // The state each step started from.
+      let previousStates = Tensor(
+        concatenating: [initial.expandingShape(at: 0), states[0..<(length - 1)]])
+      let keyPaths = Parameters.TangentVector.zero.recursivelyAllWritableKeyPaths(
+        to: Tensor<Float>.self)
+      let parameterView = parameters.differentiableVectorView
+      var initialGradients: [AnyTensor] = [Tensor<Float>(zerosLike: initial)]
+      for keyPath in keyPaths {
+        initialGradients.append(Tensor<Float>(zerosLike: parameterView[keyPath: keyPath]))
+      }
+      let results = _RawXLA.functionalScan(
+        length: length, initial: initialGradients,
+        sequences: [previousStates, sequence, 𝛁states], reverse: true, on: device
+      ) { carried, elements, _ in
+        let 𝛁state = (carried[0] as! Tensor<Float>) + (elements[2] as! Tensor<Float>)
+        let (_, pullback) = valueWithPullback(
+          at: parameters, elements[0] as! Tensor<Float>, elements[1] as! Tensor<Float>, of: body)
+        let (𝛁parameters, 𝛁previousState, 𝛁element) = pullback(𝛁state)
+        var next: [AnyTensor] = [𝛁previousState]
+        for (i, keyPath) in keyPaths.enumerated() {
+          next.append((carried[i + 1] as! Tensor<Float>) + 𝛁parameters[keyPath: keyPath])
+        }
+        return (carried: next, outputs: [𝛁element])
+      }
+      var 𝛁parameters = Parameters.TangentVector.zero
+      for (i, keyPath) in keyPaths.enumerated() {
+        𝛁parameters[keyPath: keyPath] = results.carried[i + 1] as! Tensor<Float>
+      }
+      return (
+        𝛁parameters, results.carried[0] as! Tensor<Float>, results.outputs[0] as! Tensor<Float>
+      )
+    }
+  )
+}
+
+/// The forward scan of `_scan` on X10.
+func _scanXLA<Parameters: EuclideanDifferentiable>(
+  _ parameters: Parameters, initial: Tensor<Float>, over sequence: Tensor<Float>,
+  body: (Parameters, Tensor<Float>, Tensor<Float>) -> Tensor<Float>
+) -> Tensor<Float> {
+  let results = _RawXLA.functionalScan(
+    length: sequence.shape[0], initial: [initial], sequences: [sequence], on: sequence.device
+  ) { carried, elements, _ in
+    let state = body(parameters, carried[0] as! Tensor<Float>, elements[0] as! Tensor<Float>)
+    return (carried: [state], outputs: [state])
+  }
+  return results.outputs[0] as! Tensor<Float>
+}
@@ -0,0 +1,32 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+@_implementationOnly import x10_xla_tensor_wrapper
+
+extension Tensor where Scalar: Numeric {
+  /// Pads `self` with `paddingValue` along `axis`, up to the size of the `XLA_SHAPE_BUCKETS`
+  /// bucket its size falls in. Returns the padded tensor, together with the mask of the bucket
+  /// size which is true for the positions holding the scalars of `self`.
+  ///
+  /// When `self` still lives on the host, like a batch built from host scalars, it gets padded
+  /// before being uploaded, so all the sizes within a bucket share the same compiled computation.
+  public func paddedToBucket(alongAxis axis: Int, with paddingValue: Scalar = 0)
+    -> (padded: Tensor, mask: Tensor<Bool>)
+  {
+    precondition(device.backend == .XLA, "Shape bucketing needs an X10 device.")
+    defer { _fixLifetime(self) }
+    let output = XLATensor_pad_to_bucket(xlaHandle, Int64(axis), paddingValue.xlaScalar)
+    return (Tensor(_xlaHandle: output.x), Tensor<Bool>(_xlaHandle: output.y))
+  }
+}
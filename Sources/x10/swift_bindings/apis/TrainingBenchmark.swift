@@ -0,0 +1,121 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+import Dispatch
+@_implementationOnly import x10_xla_tensor_wrapper
+
+/// The process wide X10 counters and metrics which tell compilation and execution apart.
+struct X10MetricsSnapshot {
+  /// Number of graphs compiled because they missed the compilation cache.
+  var compiles: Int
+  /// Seconds spent compiling graphs.
+  var compileTime: Double
+  /// Number of graph executions.
+  var executions: Int
+  /// Seconds spent in graph executions, as the `ExecuteTime` metric times them.
+  var executeTime: Double
+
+  static var current: X10MetricsSnapshot {
+    var compileCount = 0
+    let compileTime = GetMetricAccumulator("CompileTime", &compileCount)
+    var executions = 0
+    let executeTime = GetMetricAccumulator("ExecuteTime", &executions)
+    return X10MetricsSnapshot(
+      compiles: Int(GetCounterValue("UncachedCompile")), compileTime: compileTime / 1e9,
+      executions: executions, executeTime: executeTime / 1e9)
+  }
+
+  static func - (lhs: X10MetricsSnapshot, rhs: X10MetricsSnapshot) -> X10MetricsSnapshot {
+    X10MetricsSnapshot(
+      compiles: lhs.compiles - rhs.compiles, compileTime: lhs.compileTime - rhs.compileTime,
+      executions: lhs.executions - rhs.executions, executeTime: lhs.executeTime - rhs.executeTime)
+  }
+}
+
+/// Steady state performance of a training loop, as measured by `benchmarkTraining`. The times are
+/// in seconds.
+public struct TrainingBenchmarkReport: CustomStringConvertible {
+  /// Number of steps run before the measured ones, which absorb the compilations.
+  public var warmupSteps: Int
+  public var warmupTime: Double
+  /// Number of graphs compiled during the warmup steps.
+  public var warmupCompiles: Int
+  public var warmupCompileTime: Double
+  /// Number of measured steps.
+  public var steps: Int
+  public var examplesPerStep: Int
+  /// Wall time of the measured steps.
+  public var steadyStateTime: Double
+  /// Number of graphs compiled during the measured steps, which should be zero. When it is not,
+  /// the graph changes from one step to the other, and the measured times include compilations.
+  public var steadyStateCompiles: Int
+  public var steadyStateCompileTime: Double
+  /// Number of graph executions during the measured steps.
+  public var executions: Int
+  /// Wall time of the graph executions during the measured steps, from the `ExecuteTime` metric.
+  /// The executions get dispatched asynchronously, so this is neither the time the devices were
+  /// busy nor its complement in host time.
+  public var executeTime: Double
+
+  public var stepTime: Double { steadyStateTime / Double(steps) }
+  public var examplesPerSecond: Double { Double(steps * examplesPerStep) / steadyStateTime }
+  public var executeTimePerStep: Double { executeTime / Double(steps) }
+
+  public var description: String {
+    return """
+      Warmup: \(warmupSteps) steps in \(warmupTime)s, \
+      \(warmupCompiles) compiles in \(warmupCompileTime)s
+      Steady state: \(steps) steps in \(steadyStateTime)s, \
+      \(steadyStateCompiles) compiles in \(steadyStateCompileTime)s
+      Step time: \(stepTime)s, Examples/sec: \(examplesPerSecond)
+      Execute time/step: \(executeTimePerStep)s, \
+      Executions/step: \(Double(executions) / Double(steps))
+      """
+  }
+}
+
+/// Measures the steady state performance of the training step `step`, which trains over a batch
+/// of `examplesPerStep` examples on `device`. The first `warmupSteps` steps absorb the
+/// compilations and are reported apart, then the following `steps` steps are timed as a whole, so
+/// that the host keeps tracing ahead of the devices as it does in a regular training loop. Each
+/// phase ends by waiting for `device` and `devices`.
+///
+/// The compilation and execution figures come from the X10 metrics, which are process wide, so
+/// concurrent benchmarks on several devices all report the same ones.
+public func benchmarkTraining(
+  warmupSteps: Int = 3, steps: Int = 20, examplesPerStep: Int, on device: Device,
+  devices: [Device] = [], step: () -> Void
+) -> TrainingBenchmarkReport {
+  precondition(steps > 0, "The benchmark needs at least one measured step")
+  LazyTensorBarrier(on: device, wait: true)
+
+  func runSteps(_ count: Int) -> (time: Double, metrics: X10MetricsSnapshot) {
+    let startMetrics = X10MetricsSnapshot.current
+    let start = DispatchTime.now().uptimeNanoseconds
+    for _ in 0..<count { step() }
+    LazyTensorBarrier(on: device, devices: devices, wait: true)
+    let end = DispatchTime.now().uptimeNanoseconds
+    return (Double(end - start) / 1e9, X10MetricsSnapshot.current - startMetrics)
+  }
+
+  let warmup = runSteps(warmupSteps)
+  let steadyState = runSteps(steps)
+  return TrainingBenchmarkReport(
+    warmupSteps: warmupSteps, warmupTime: warmup.time,
+    warmupCompiles: warmup.metrics.compiles, warmupCompileTime: warmup.metrics.compileTime,
+    steps: steps, examplesPerStep: examplesPerStep, steadyStateTime: steadyState.time,
+    steadyStateCompiles: steadyState.metrics.compiles,
+    steadyStateCompileTime: steadyState.metrics.compileTime,
+    executions: steadyState.metrics.executions, executeTime: steadyState.metrics.executeTime)
+}
@@ -0,0 +1,62 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+@_implementationOnly import x10_xla_tensor_wrapper
+
+/// Runs a model whose weights do not fit the memory of its device, split into layers whose weights
+/// stay in host memory and stream to the device one layer ahead of the one running.
+///
+/// The graph of every layer takes the layer weights followed by its activations: the outputs of
+/// the previous layer, or the inputs for the first layer. The weights of layer `i + 1` upload while
+/// layer `i` runs, so the device holds the weights of two layers at most, and the throughput stays
+/// close to the one of a resident model as long as a layer runs longer than its upload takes.
+public final class _XLAWeightStreamer {
+  private let handle: UnsafeMutablePointer<OpaqueXLAWeightStreamer>
+  private let layers: [_FrozenXLAGraph]
+
+  /// Creates a streamer out of the layer graphs, with `weights[i]` as the weights of layer `i`,
+  /// which get copied to host memory. Dropping the tensors of the weights afterwards releases the
+  /// device memory they might hold.
+  public init(layers: [_FrozenXLAGraph], weights: [[AnyTensor]]) {
+    precondition(!layers.isEmpty, "A weight streamer needs at least one layer.")
+    precondition(weights.count == layers.count, "A weight streamer needs weights for every layer.")
+    self.layers = layers
+    var layerHandles: [UnsafeMutablePointer<OpaqueXLAFrozenGraph>?] = layers.map { $0.handle }
+    let numWeights = weights.map { $0.count }
+    handle = weights.flatMap { $0 }.withArrayRef { weightHandles in
+      layerHandles.withUnsafeMutableBufferPointer { layerBuf in
+        numWeights.withUnsafeBufferPointer { numWeights in
+          XLAWeightStreamer_create(
+            layerBuf.baseAddress, weightHandles, numWeights.baseAddress, layers.count)!
+        }
+      }
+    }
+  }
+
+  deinit {
+    destroyXLAWeightStreamer(handle)
+  }
+
+  /// Runs the layers over `inputs`, and returns the outputs of the last layer.
+  public func callAsFunction(_ inputs: [AnyTensor]) -> [AnyTensor] {
+    inputs.withArrayRef { inputHandles in
+      let tensorListHandle = XLAWeightStreamer_run(handle, inputHandles)
+      defer { destroyOpaqueXLATensorArrayRef(tensorListHandle) }
+      let outputTypes = layers.last!.outputTypes
+      return (0..<tensorListHandle.size).map { i in
+        outputTypes[i].wrapTensor(XLATensor(_handle: tensorListHandle.data[i]!))
+      }
+    }
+  }
+}
@@ -0,0 +1,50 @@
+# Lint as: python3
+"""Compares two JSON outputs of x10_op_benchmarks.
+
+Lists the benchmarks which got slower by more than the threshold, and exits
+with status 1 if there are any, so that it can gate a change.
+"""
+import argparse
+import json
+import sys
+
+
+def load_times(path):
+  with open(path) as f:
+    results = json.load(f)
+  times = {}
+  for benchmark in results["benchmarks"]:
+    if benchmark.get("error_occurred"):
+      continue
+    times[benchmark["name"]] = benchmark["real_time"]
+  return times
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__)
+  parser.add_argument("baseline", help="benchmark JSON of the baseline")
+  parser.add_argument("contender", help="benchmark JSON of the change")
+  parser.add_argument(
+      "--threshold",
+      type=float,
+      default=0.1,
+      help="relative slowdown reported as a regression")
+  args = parser.parse_args()
+
+  baseline = load_times(args.baseline)
+  contender = load_times(args.contender)
+  regressions = []
+  for name, time in sorted(contender.items()):
+    if name not in baseline or baseline[name] <= 0:
+      continue
+    change = time / baseline[name] - 1.0
+    if change > args.threshold:
+      regressions.append((change, name, baseline[name], time))
+  for change, name, old_time, new_time in sorted(regressions, reverse=True):
+    print(f"{name}: {old_time:.1f} -> {new_time:.1f} (+{change * 100:.1f}%)")
+  print(f"{len(regressions)} regressions over {len(contender)} benchmarks")
+  return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -10,6 +10,8 @@ FLAGS = flags.FLAGS
 flags.DEFINE_string("def_file", None, "path to list of ops")
 flags.DEFINE_string("cc_output", None, "path for the generated cc file")
 flags.DEFINE_string("swift_output", None, "path for the generated swift file")
+flags.DEFINE_string("benchmark_output", None,
+                    "path for the generated op benchmark specs, if any")
 
 HEADER = """// Autogenerated by codegen.py. Do not modify.
 """
@@ -60,7 +62,7 @@ def node_type_define(op):
     if stype == "Bool": return f"bool {name}"
     if stype == "Float": return f"float {name}"
     if stype == "[Int64]":
-      return f"std::vector<int64_t> {name}"
+      return f"Int64List {name}"
     if stype == "ScalarType?": return f"c10::optional<at::ScalarType> {name}"
     if stype == "ScalarType":
       return f"at::ScalarType {name}"
@@ -113,7 +115,7 @@ def node_type_define(op):
     if stype == "AnyScalar":
       return f"  at::Scalar {name}_;"
     if stype == "[Int64]":
-      return f"  std::vector<int64_t> {name}_;\n"
+      return f"  Int64List {name}_;\n"
     if stype in builtin_types:
       return f"  {builtin_types[stype][2]} {name}_;\n"
     raise ValueError(f"Problem: no such type: {stype}")
@@ -185,6 +187,15 @@ def node_type_define(op):
     return ReturnOps(result, loctx);
   """
 
+  elementwise_lower = ""
+  if op.get("elementwise"):
+    elementwise_lower = f"""
+  static xla::XlaOp LowerElementwise(absl::Span<const xla::XlaOp> operands) {{
+    return {op["lower_fn"]}(
+        {", ".join(f"operands[{i}]" for i in range(len(tensor_args)))});
+  }}
+"""
+
   return f"""
 class {op["op_node_name"]} : public Node {{
  public:
@@ -201,7 +212,7 @@ class {op["op_node_name"]} : public Node {{
   }}
 
   XlaOpVector Lower(LoweringContext* loctx) const override {{{lower_body}}}
-
+{elementwise_lower}
   std::string ToString() const override {{
     std::stringstream ss;
     ss << Node::ToString();
@@ -257,7 +268,10 @@ def c_function_define(op):
     raise ValueError("problem unknown type: " + stype)
   def format_arg_ref(arg):
     name, stype, _ = arg
-    if stype == "Tensor": return name + "_ir_value"
+    if stype == "Tensor":
+      if ["narrow_index", name] in op["extras"]:
+        return f"swift_xla::NarrowIndices({name}_ir_value)"
+      return name + "_ir_value"
     if stype == "[Tensor]":
       return name + "_ir_value"
     if name == "shape":
@@ -295,7 +309,7 @@ def c_function_define(op):
     if stype == "AnyScalar":
       return f"atScalar({name})"
     if stype == "[Int64]":
-      return f"swift_xla::XlaHelpers::I64List({name}.slice())"
+      return f"swift_xla::ir::Int64List({name}.slice())"
     return name
   def unpack_arg(arg):
     name, stype, _ = arg
@@ -304,6 +318,8 @@ def c_function_define(op):
       return f"  auto {name}_ir_value = swift_xla::UnpackIrValues({name});\n"
     return ""
   node_ctor = f"""swift_xla::ir::MakeNode<swift_xla::ir::ops::{op["op_node_name"]}>({", ".join(format_arg_ref(arg) for arg in op["args"])})"""
+  if op.get("elementwise"):
+    node_ctor = f"swift_xla::ir::ops::FuseElementwise({node_ctor})"
   result_type = None
   if op["n_results"] == 1:
     result_type = "OpaqueXLATensor*"
@@ -337,8 +353,11 @@ def c_function_define(op):
             f"swift_xla::XLATensor({first_tensor}->CreateFrom(swift_xla::ir::Value(result_node,"
             f" {result_i}), at::ScalarType::{dtype}))")
 
+  op_kind = op["x10_enum"].replace("at::", "", 1).replace(
+      "xla_symbols::", "xla::", 1)
   prelude = f"""
 {result_type} XLATensor_{op["c_name"]}({", ".join(format_arg_def(arg) for arg in op["args"])}) {{
+  XLA_FN_PROFILE("{op_kind}");
 {"".join(unpack_arg(arg) for arg in op["args"])}
   auto result_node = {node_ctor};"""
   if op["n_results"] != 1:
@@ -459,6 +478,54 @@ def swift_wrapper_define(op):
 """
 
 
+def elementwise_registry_define(op_list):
+  entries = [
+      f"""    {{typeid({op["op_node_name"]}), {op["op_node_name"]}::LowerElementwise}},
+""" for op in op_list if op.get("elementwise")
+  ]
+  return f"""
+const bool kElementwiseOpsRegistered = RegisterFusibleElementwise({{
+{"".join(entries)}}});
+"""
+
+def benchmark_spec_define(op):
+  """Returns the benchmark spec of an op taking only tensors, or None."""
+  if op["n_results"] != 1 or not op["args"]:
+    return None
+  if any(arg[1] != "Tensor" for arg in op["args"]):
+    return None
+  generic_types = op.get("generics", {})
+
+  def input_type(arg):
+    tname = re.fullmatch("Tensor<(\w+)>", arg[2][1]).group(1)
+    if tname in generic_types:
+      if "TensorFlowInteger" in generic_types[tname]:
+        return "InputType::kGenericInteger"
+      return "InputType::kGeneric"
+    if tname in ("Bool", "Int32", "Int64", "Float"):
+      return f"InputType::k{tname}"
+    return None
+
+  input_types = [input_type(arg) for arg in op["args"]]
+  if None in input_types:
+    return None
+  inputs = ", ".join(f"inputs[{i}]" for i in range(len(op["args"])))
+  return f"""    {{"{op["c_name"]}",
+     {{{", ".join(input_types)}}},
+     [](OpaqueXLATensor* const* inputs) {{
+       return XLATensor_{op["c_name"]}({inputs});
+     }}}},
+"""
+
+
+def benchmark_specs_define(op_list):
+  specs = [benchmark_spec_define(op) for op in op_list]
+  return f"""
+const OpBenchmarkSpec kOpBenchmarkSpecs[] = {{
+{"".join(spec for spec in specs if spec)}}};
+"""
+
+
 def snake_to_camel(name):
   return "".join(map(lambda x: x[0].capitalize() + x[1:],name.split("_")))
 
@@ -570,7 +637,8 @@ namespace swift_xla {
 namespace ir {
 namespace ops {
 namespace {
-""" + ("".join(node_type_define(op) for op in op_list)) + """
+""" + ("".join(node_type_define(op) for op in op_list)) +
+      elementwise_registry_define(op_list) + """
 }  // namespace
 }  // namespace ops
 }  // namespace ir
@@ -588,6 +656,9 @@ extension _RawXLA {
     if "swift_namespace" in op and op["swift_namespace"] == "_RawXLA")) + """
 }
 """)
+  if FLAGS.benchmark_output:
+    open(FLAGS.benchmark_output,
+         "w+").write(HEADER + benchmark_specs_define(op_list))
   for op in op_list:
     if not ("swift_namespace" in op and op["swift_namespace"] == "_RawXLA"):
       print(f"""Missing swift types: {op["op_node_name"]}""")
@@ -104,6 +104,109 @@ public struct HyperparameterDictionary {
 // TODO: Experiment with efficiently fusing these...
 public typealias OptimizerCallback = (inout OptimizerWeightStepState, inout OptimizerState) -> Void
 
+/// Describes the update of a parameter group as one of the rules `_RawXLA.optimizerStep` fuses,
+/// which then replaces the callbacks of the group on X10.
+public struct FusedOptimizerStep {
+  public init(
+    kind: _RawXLA.OptimizerStepKind, hyperparameters: [String], states: [StateAccessor],
+    nesterov: Bool = false, applyWeightDecay: Bool, epsilon: Float = 0
+  ) {
+    self.kind = kind
+    self.hyperparameters = hyperparameters
+    self.states = states
+    self.nesterov = nesterov
+    self.applyWeightDecay = applyWeightDecay
+    self.epsilon = epsilon
+  }
+
+  public var kind: _RawXLA.OptimizerStepKind
+  /// The names of the hyperparameters, in the order `kind` takes them.
+  public var hyperparameters: [String]
+  /// The states, in the order `kind` takes them.
+  public var states: [StateAccessor]
+  public var nesterov: Bool
+  public var applyWeightDecay: Bool
+  public var epsilon: Float
+}
+
+/// Dynamic loss scaling for reduced precision gradients. The loss gets multiplied by `scale`
+/// before differentiation, so that small gradients do not flush to zero, and `GeneralOptimizer`
+/// divides the gradients back. Steps whose gradients are not finite are skipped and back the scale
+/// off, while `growthInterval` finite steps in a row grow it. All of it stays on the device, within
+/// the graph of the optimizer step.
+public struct DynamicLossScale {
+  public init(
+    initialScale: Float = 65536, growthFactor: Float = 2, backoffFactor: Float = 0.5,
+    growthInterval: Int = 2000, on device: Device = .default
+  ) {
+    self.scale = Tensor<Float>(initialScale, on: device)
+    self.growthFactor = growthFactor
+    self.backoffFactor = backoffFactor
+    self.growthInterval = growthInterval
+    self.goodSteps = Tensor<Float>(0, on: device)
+  }
+
+  public init(copying other: DynamicLossScale, to device: Device) {
+    self.scale = Tensor<Float>(copying: other.scale, to: device)
+    self.growthFactor = other.growthFactor
+    self.backoffFactor = other.backoffFactor
+    self.growthInterval = other.growthInterval
+    self.goodSteps = Tensor<Float>(copying: other.goodSteps, to: device)
+  }
+
+  /// The current scale of the loss.
+  public var scale: Tensor<Float>
+  public var growthFactor: Float
+  public var backoffFactor: Float
+  public var growthInterval: Int
+  /// The number of finite steps since the last change of the scale.
+  var goodSteps: Tensor<Float>
+
+  /// Returns the loss to differentiate in place of `loss`.
+  public func scaled(_ loss: Tensor<Float>) -> Tensor<Float> {
+    return loss * scale
+  }
+
+  /// Updates the scale after a step whose gradients were finite or not.
+  mutating func update(allFinite: Tensor<Bool>) {
+    let zeros = Tensor<Float>(zerosLike: goodSteps)
+    let goodSteps = _Raw.select(condition: allFinite, t: self.goodSteps + 1, e: zeros)
+    let grow = goodSteps .>= Float(growthInterval)
+    scale = _Raw.select(
+      condition: allFinite, t: _Raw.select(condition: grow, t: scale * growthFactor, e: scale),
+      e: scale * backoffFactor)
+    self.goodSteps = _Raw.select(condition: grow, t: zeros, e: goodSteps)
+  }
+}
+
+/// Keeps the optimizer state of some parameter groups, like the two Adam moments, in host memory
+/// between the steps, for models which only fit the device without it. Since a graph holds all its
+/// inputs for its whole run, the forward and backward passes need a graph of their own, which the
+/// state streams in after and out of once the update has run:
+///
+///     let grads = gradient(at: model) { model in loss(model(x), y) }
+///     LazyTensorBarrier()  // Runs the forward and backward passes.
+///     optimizer.update(&model, along: grads)
+///     LazyTensorBarrier()  // Runs the update.
+///     optimizer.offloadState()
+///
+/// Both directions are asynchronous. The downloads overlap with the tracing of the next step, and
+/// release the device memory of the state as they land. The uploads start with `prefetchState()`,
+/// which `update(_:along:)` calls when needed, but which can be called before the barrier running
+/// the forward and backward passes to overlap with them, at the cost of holding the state then.
+public struct OptimizerStateOffload {
+  /// Offloads the state of `parameterGroups`, as indices into `GeneralOptimizer.parameterGroups`.
+  public init(parameterGroups: Set<Int>) {
+    self.parameterGroups = parameterGroups
+  }
+
+  public var parameterGroups: Set<Int>
+  /// The offloaded indices of `OptimizerState.state`, with their shapes.
+  var offloaded: [(index: Int, shape: TensorShape)] = []
+  /// The values of the offloaded state, in the order of `offloaded`.
+  var pending: PendingScalars<Float>? = nil
+}
+
 /// An optimizer that works on a single parameter group.
 public struct ParameterGroupOptimizer {
   public init() {}
@@ -112,6 +215,8 @@ public struct ParameterGroupOptimizer {
   public var localCount: Int = 0
   public var callbacks: [OptimizerCallback] = []
   public var stateCount: Int = 0
+  /// The fused equivalent of the callbacks, if any.
+  public var fusedStep: FusedOptimizerStep? = nil
 }
 
 /// General optimizer that should be able to express multiple possible optimizations.
@@ -129,9 +234,30 @@ where
   /// Used to determine the scaling factor of the cross replica sum.
   public var crossReplicaSumCount: Int? = nil
 
+  /// The precision the gradients get summed across the replicas at.
+  public var crossReplicaSumPrecision: CrossReplicaSumPrecision = .full
+
+  /// The dynamic loss scaling the gradients passed to `update(_:along:)` went through, if any.
+  public var lossScale: DynamicLossScale? = nil
+
+  /// Whether `update(_:along:)` skips the steps whose gradients are not all finite, leaving the
+  /// weights and the optimizer state untouched. Always the case with a `lossScale`.
+  public var skipNonFiniteSteps: Bool = false
+
+  /// Whether the gradients of the last checked step were all finite, as a scalar on the device, so
+  /// that training loops can count the skipped steps without a transfer per step.
+  public var lastStepFinite: Tensor<Bool>? = nil
+
+  /// Keeps the state of some parameter groups in host memory between the steps, if set.
+  public var stateOffload: OptimizerStateOffload? = nil
+
   /// global optimizer state.
   public var optimizerState: OptimizerState
 
+  /// The state of the weights updated through a `ParameterArena`, flattened like its buffer, in the
+  /// order of the states of the fused step.
+  var flatState: [Tensor<Float>]? = nil
+
   /// Current device of the model. (Used for constructing hyperparameters)
   public var device: Device
 
@@ -211,34 +337,261 @@ where
   /// The actual optimizer step. Maps over all the tensors of the gradient
   /// and applies per-weight optimizers defined by ParameterGroupOptimizer.
   public func update(_ model: inout Model, along direction: Model.TangentVector) {
+    prefetchState()
+    guard lossScale != nil || skipNonFiniteSteps else {
+      model.move(by: makeStep(model, along: direction, checkFinite: false).step)
+      return
+    }
+    var direction = direction
+    if let inverseScale = lossScale.map({ 1 / $0.scale }) {
+      let scaledDirection = direction
+      kpPlan.mapTensors(&direction, scaledDirection) {
+        (grad: inout Tensor<Float>, _: Tensor<Float>, _: Int) in
+        grad = grad * inverseScale
+      }
+    }
+    let previousState = optimizerState.state
+    let result = makeStep(model, along: direction, checkFinite: true)
+    let allFinite = result.allFinite!
+    var step = result.step
+    let steps = step
+    kpPlan.mapTensors(&step, steps) {
+      (step: inout Tensor<Float>, _: Tensor<Float>, _: Int) in
+      step = _Raw.select(condition: allFinite, t: step, e: Tensor<Float>(zerosLike: step))
+    }
+    optimizerState.state = zip(optimizerState.state, previousState).map {
+      _Raw.select(condition: allFinite, t: $0, e: $1)
+    }
+    lossScale?.update(allFinite: allFinite)
+    lastStepFinite = allFinite
+    model.move(by: step)
+  }
+
+  /// Steps the weights held by `arena` along `direction` on the flat buffers: a single cross
+  /// replica sum of the flattened gradients, and a single fused step of the buffer. The weights
+  /// must form a single parameter group with a fused step, on X10, and `arena` must visit the
+  /// weights of the model in the order of the plan of the optimizer. The first such update moves
+  /// the state of the optimizer into a flat buffer too, after which it only updates the arena.
+  public func update(_ arena: inout ParameterArena<Model>, along direction: Model.TangentVector) {
+    precondition(device.backend == .XLA, "Updates of a parameter arena need an X10 device.")
+    precondition(stateOffload == nil, "Updates of a parameter arena do not offload the state.")
+    let selector = parameterGroupIndices[0]
+    precondition(
+      parameterGroupIndices.allSatisfy { $0 == selector },
+      "Updates of a parameter arena need a single parameter group.")
+    let paramGroup = parameterGroups[selector]
+    guard let fusedStep = paramGroup.fusedStep else {
+      preconditionFailure("Updates of a parameter arena need a parameter group with a fused step.")
+    }
+    step += 1
+    var grad = arena.flatten(kpPlan.allTensors(direction))
+    if let lossScale = lossScale {
+      grad = grad / lossScale.scale
+    }
+    if let count = crossReplicaSumCount {
+      grad = _Raw.crossReplicaSum(
+        [grad], 1.0 / Double(count), precision: crossReplicaSumPrecision)[0]
+    }
+    if flatState == nil {
+      flatState = fusedStep.states.map { state in
+        arena.flatten((0..<optimizerState.stride).map { optimizerState[state.index, $0] })
+      }
+      // A constant holds no device memory, and the weights only get updated through the arena now.
+      optimizerState.state = optimizerState.state.map { _ in Tensor<Float>(0, on: device) }
+    }
+    let previousState = flatState!
+    let result = _RawXLA.optimizerStep(
+      kind: fusedStep.kind,
+      weights: [arena.buffer],
+      grads: [grad],
+      states: previousState,
+      hyperparameters: fusedStep.hyperparameters.map {
+        Tensor<Float>(paramGroup.hyperparameters[$0]!, on: device)
+      },
+      nesterov: fusedStep.nesterov,
+      applyWeightDecay: fusedStep.applyWeightDecay,
+      epsilon: fusedStep.epsilon)
+    var weightStep = result.steps[0]
+    flatState = result.states
+    if lossScale != nil || skipNonFiniteSteps {
+      let allFinite = _RawXLA.allFinite([grad])
+      weightStep = _Raw.select(
+        condition: allFinite, t: weightStep, e: Tensor<Float>(zerosLike: weightStep))
+      flatState = zip(result.states, previousState).map {
+        _Raw.select(condition: allFinite, t: $0, e: $1)
+      }
+      lossScale?.update(allFinite: allFinite)
+      lastStepFinite = allFinite
+    }
+    arena.buffer += weightStep
+  }
+
+  /// Starts uploading the offloaded state back to the device. Does nothing when it is already there.
+  public func prefetchState() {
+    guard var offload = stateOffload, let pending = offload.pending else { return }
+    for (entry, scalars) in zip(offload.offloaded, pending.wait()) {
+      optimizerState.state[entry.index] = Tensor<Float>(
+        shape: entry.shape, scalars: scalars, toReducedPrecision: false, directlyOn: device)
+    }
+    offload.offloaded = []
+    offload.pending = nil
+    stateOffload = offload
+  }
+
+  /// Starts downloading the state of the parameter groups of `stateOffload` to the host, and lets
+  /// its device memory go once the transfers land. The update must have run by then, through the
+  /// `LazyTensorBarrier()` following `update(_:along:)`, or the download would run it again.
+  public func offloadState() {
+    guard var offload = stateOffload, offload.pending == nil else { return }
+    let indices = optimizerState.state.indices.filter {
+      offload.parameterGroups.contains(parameterGroupIndices[$0 % optimizerState.stride])
+    }
+    if indices.isEmpty { return }
+    let tensors = indices.map { optimizerState.state[$0] }
+    offload.offloaded = zip(indices, tensors).map { (index: $0, shape: $1.shape) }
+    offload.pending = Tensor.pendingScalars(of: tensors)
+    for index in indices {
+      // A constant holds no device memory, and gets replaced before any step reads it.
+      optimizerState.state[index] = Tensor<Float>(0, on: device)
+    }
+    stateOffload = offload
+  }
+
+  /// Returns a scalar which is true when none of the elements of `tensors` is a NaN or an infinity.
+  func allFinite(_ tensors: [Tensor<Float>]) -> Tensor<Bool> {
+    if device.backend == .XLA {
+      return _RawXLA.allFinite(tensors)
+    }
+    // A single non finite element makes the sum of all of them non finite, so the check costs one
+    // reduction per tensor rather than a comparison of every element.
+    return tensors.map { $0.sum() }.reduce(Tensor<Float>(0, on: device), +).isFinite
+  }
+
+  /// Computes the step of the weights along the gradients, and updates the optimizer state. With
+  /// `checkFinite`, also returns whether the gradients the step used, summed across the replicas
+  /// if they are, were all finite.
+  func makeStep(_ model: Model, along direction: Model.TangentVector, checkFinite: Bool)
+    -> (step: Model.TangentVector, allFinite: Tensor<Bool>?)
+  {
     step += 1
     let globals = parameterGroups.map { pg in
       pg.globals.map { globalInit in globalInit(pg.hyperparameters, device) }
     }
     var step = direction
     let crsScale : Double? = crossReplicaSumCount.map { 1.0 / Double($0) }
+    // Sum all the gradients with a single cross replica sum, whose lowering packs them into as few
+    // collectives as the XLA_ALL_REDUCE_BUCKET_SIZE allows.
+    let summedGrads: [Tensor<Float>]? = crsScale.map {
+      _Raw.crossReplicaSum(
+        kpPlan.allTensors(direction), $0, precision: crossReplicaSumPrecision)
+    }
+    // The check runs on the summed gradients, so that all the replicas skip the same steps.
+    let allFinite = checkFinite ? self.allFinite(summedGrads ?? kpPlan.allTensors(direction)) : nil
+    let fusedSteps =
+      device.backend == .XLA
+      ? makeFusedSteps(
+        weights: kpPlan.allTensors(model.differentiableVectorView),
+        grads: summedGrads ?? kpPlan.allTensors(direction))
+      : [:]
     // step plays dual-duties as an inout parameter for efficiency.
     let _ = kpPlan.mapTensors(&step, model.differentiableVectorView) {
       (step: inout Tensor<Float>, weight: Tensor<Float>, i: Int) in
+      if let fusedStep = fusedSteps[i] {
+        step = fusedStep
+        return
+      }
       let selector = parameterGroupIndices[i]
       let paramGroup = parameterGroups[selector]
       var state = OptimizerWeightStepState(
         globals: globals[selector], grad: step, weight: weight, weightId: i)
-      if let crsScale = crsScale {
-        state.grad = _Raw.crossReplicaSum([state.grad], crsScale).first!
+      if let summedGrads = summedGrads {
+        state.grad = summedGrads[i]
       }
       for cb in paramGroup.callbacks { cb(&state, &optimizerState) }
       step = state.step ?? Tensor<Float>(zerosLike: step)
     }
-    model.move(by: step)
+    return (step, allFinite)
+  }
+
+  /// Steps all the weights of each parameter group with a fused step through a single node, which
+  /// keeps the traced graph small for models with many weights. Updates the optimizer state, and
+  /// returns the steps by weight index.
+  func makeFusedSteps(weights: [Tensor<Float>], grads: [Tensor<Float>]) -> [Int: Tensor<Float>] {
+    var steps: [Int: Tensor<Float>] = [:]
+    for (selector, paramGroup) in parameterGroups.enumerated() {
+      guard let fusedStep = paramGroup.fusedStep else { continue }
+      let indices = parameterGroupIndices.indices.filter { parameterGroupIndices[$0] == selector }
+      if indices.isEmpty { continue }
+      let result = _RawXLA.optimizerStep(
+        kind: fusedStep.kind,
+        weights: indices.map { weights[$0] },
+        grads: indices.map { grads[$0] },
+        states: fusedStep.states.flatMap { state in
+          indices.map { optimizerState[state.index, $0] }
+        },
+        hyperparameters: fusedStep.hyperparameters.map {
+          Tensor<Float>(paramGroup.hyperparameters[$0]!, on: device)
+        },
+        nesterov: fusedStep.nesterov,
+        applyWeightDecay: fusedStep.applyWeightDecay,
+        epsilon: fusedStep.epsilon)
+      for (j, i) in indices.enumerated() {
+        steps[i] = result.steps[j]
+        for (s, state) in fusedStep.states.enumerated() {
+          optimizerState[state.index, i] = result.states[s * indices.count + j]
+        }
+      }
+    }
+    return steps
+  }
+
+  /// Applies a row-sparse gradient, such as the one returned by
+  /// `Embedding.lookupWithSparsePullback(_:)`, to `weight`. The callbacks of the parameter group
+  /// owning `keyPath` run on the gradient rows and the matching rows of the weight only, and the
+  /// resulting steps get scattered into the weight. The gradient for `keyPath` passed to
+  /// `update(_:along:)` should then be left at zero.
+  ///
+  /// Only parameter groups without state (like plain SGD) are supported, since the state of the
+  /// untouched rows would otherwise need to advance too. Repeated indices each get their own step,
+  /// so weight dependent terms like the weight decay apply once per occurrence.
+  public func update(
+    _ weight: inout Tensor<Float>,
+    at keyPath: WritableKeyPath<Model.TangentVector, Tensor<Float>>,
+    along gradient: SparseRows<Float>
+  ) {
+    guard let i = kpPlan.allTensorKeyPaths.firstIndex(of: keyPath) else {
+      preconditionFailure("\(keyPath) is not a weight of the optimized model.")
+    }
+    precondition(
+      crossReplicaSumCount == nil, "Row-sparse updates do not support cross replica sums.")
+    let paramGroup = parameterGroups[parameterGroupIndices[i]]
+    precondition(
+      paramGroup.stateCount == 0, "Row-sparse updates need a parameter group without state.")
+    let globals = paramGroup.globals.map { globalInit in
+      globalInit(paramGroup.hyperparameters, device)
+    }
+    var state = OptimizerWeightStepState(
+      globals: globals, grad: gradient.values,
+      weight: weight.gathering(atIndices: gradient.indices), weightId: i)
+    for cb in paramGroup.callbacks { cb(&state, &optimizerState) }
+    if let step = state.step {
+      weight = weight.addingRows(SparseRows(indices: gradient.indices, values: step))
+    }
   }
 
   /// Copies the optimizer to the specified device.
   public required init(copying other: GeneralOptimizer, to device: Device) {
+    // The copy needs the values of the offloaded state.
+    other.prefetchState()
     step = other.step
     crossReplicaSumCount = other.crossReplicaSumCount
+    crossReplicaSumPrecision = other.crossReplicaSumPrecision
     kpPlan = other.kpPlan
     optimizerState = .init(copying: other.optimizerState, to: device)
+    flatState = other.flatState?.map { Tensor<Float>(copying: $0, to: device) }
+    lossScale = other.lossScale.map { DynamicLossScale(copying: $0, to: device) }
+    skipNonFiniteSteps = other.skipNonFiniteSteps
+    stateOffload = other.stateOffload
     parameterGroupIndices = other.parameterGroupIndices
     parameterGroups = other.parameterGroups
     self.device = device
@@ -315,6 +668,11 @@ public struct ParameterGroupOptimizerBuilder {
     }
   }
 
+  /// Sets the fused equivalent of the callbacks, which X10 runs instead of them.
+  public mutating func setFusedStep(_ fusedStep: FusedOptimizerStep) {
+    result.fusedStep = fusedStep
+  }
+
   /// Appends a callback to the list of callbacks.
   public mutating func appendCallback(_ cb: @escaping OptimizerCallback) {
     result.callbacks.append(cb)
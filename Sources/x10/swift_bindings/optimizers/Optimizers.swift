@@ -119,11 +119,18 @@ public func makeSGD(
   let velocity = b[state: "velocity"]
   b.updateVelocity(mom: mom, lr: lr, velocity: velocity)
   b.sgdStep(nesterov: nesterov, mom: mom, lr: lr, velocity: velocity)
+  b.setFusedStep(
+    FusedOptimizerStep(
+      kind: .sgdMomentum, hyperparameters: ["learningRate", "mom", "weightDecay"],
+      states: [velocity], nesterov: nesterov, applyWeightDecay: weightDecay != 0))
   return b.makeOptimizer()
 }
 
 /// Builds a per-weight optimizer for Adam with weight decay.
 ///
+/// With `decoupledWeightDecay` (AdamW), the weight decay gets added to the update, otherwise it
+/// gets added to the gradient before the moments.
+///
 /// Reference: ["Adam - A Method for Stochastic Optimization"](
 /// https://arxiv.org/abs/1412.6980v8)
 public func makeAdam(
@@ -131,13 +138,15 @@ public func makeAdam(
   beta1: Float = 0.9,
   beta2: Float = 0.999,
   weightDecayRate: Float = 0.01,
-  epsilon: Float = 1e-6
+  epsilon: Float = 1e-6,
+  decoupledWeightDecay: Bool = true
 ) -> ParameterGroupOptimizer {
   var b = ParameterGroupOptimizerBuilder()
   let lr = b.makeParameter("learningRate", learningRate)
   let beta1 = b.makeParameter("beta1", beta1)
   let beta2 = b.makeParameter("beta2", beta2)
   let wd = b.makeParameter("weightDecay", weightDecayRate)
+  if !decoupledWeightDecay && weightDecayRate != 0 { b.scaleGradient(byWeightDecay: wd) }
 
   let firstMoment = b[state: "firstMoment"]
   let secondMoment = b[state: "secondMoment"]
@@ -155,9 +164,16 @@ public func makeAdam(
 
   b.appendCallback { (state: inout OptimizerWeightStepState, optState: inout OptimizerState) in
     let denominator = sqrt(optState[state, secondMoment]).adding(epsilon)
-    let update = optState[state, firstMoment] ./ denominator + state.weight * state[wd]
+    var update = optState[state, firstMoment] ./ denominator
+    if decoupledWeightDecay { update = update + state.weight * state[wd] }
     state.step = -state[lr] * update
   }
 
+  b.setFusedStep(
+    FusedOptimizerStep(
+      kind: decoupledWeightDecay ? .adamW : .adam,
+      hyperparameters: ["learningRate", "beta1", "beta2", "weightDecay"],
+      states: [firstMoment, secondMoment],
+      applyWeightDecay: decoupledWeightDecay || weightDecayRate != 0, epsilon: epsilon))
   return b.makeOptimizer()
 }
@@ -0,0 +1,87 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if canImport(Differentiation)
+import Differentiation
+#else
+import _Differentiation
+#endif
+import TensorFlow
+
+/// All the `Tensor<Float>` parameters of a model, flattened and laid end to end in a single
+/// buffer. The parameters of the model get rebound to views of the buffer, so that a traced graph
+/// takes the buffer as one parameter instead of one per weight, and the optimizer updates, the
+/// cross replica sums and the checkpoints deal with a single large tensor:
+///
+///     var arena = ParameterArena(TensorVisitorPlan(model), packing: model)
+///     arena.unpack(into: &model)
+///     ...
+///     let grads = gradient(at: model) { model in loss(model(x), y) }
+///     optimizer.update(&arena, along: grads)
+///     arena.unpack(into: &model)
+///
+/// Saving `buffer` saves all the parameters, which `unpack(into:)` restores.
+public struct ParameterArena<Base> {
+  /// The plan visiting the parameters.
+  public let plan: TensorVisitorPlan<Base>
+
+  /// The shapes of the parameters, in the order of `plan`.
+  public let shapes: [TensorShape]
+
+  /// The offsets of the parameters in `buffer`, followed by its size.
+  public let offsets: [Int]
+
+  /// The parameters, flattened and end to end.
+  public var buffer: Tensor<Float>
+
+  /// Creates the arena of the parameters of `base` visited by `plan`.
+  public init(_ plan: TensorVisitorPlan<Base>, packing base: Base) {
+    let tensors = plan.allTensors(base)
+    precondition(!tensors.isEmpty, "An arena needs at least one parameter.")
+    self.plan = plan
+    self.shapes = tensors.map { $0.shape }
+    self.offsets = tensors.reduce(into: [0]) { $0.append($0.last! + $1.scalarCount) }
+    self.buffer = Tensor(concatenating: tensors.map { $0.reshaped(to: [-1]) })
+  }
+
+  /// The number of parameters.
+  public var count: Int { shapes.count }
+
+  /// Returns `tensors`, which have the shapes of the parameters, flattened and end to end like
+  /// `buffer`. The gradients of the parameters map to the buffer this way.
+  public func flatten(_ tensors: [Tensor<Float>]) -> Tensor<Float> {
+    precondition(
+      tensors.map { $0.shape } == shapes, "The tensors do not have the shapes of the parameters.")
+    return Tensor(concatenating: tensors.map { $0.reshaped(to: [-1]) })
+  }
+
+  /// Returns the view of `buffer` holding parameter `i`.
+  public func view(_ i: Int) -> Tensor<Float> {
+    buffer.slice(lowerBounds: [offsets[i]], upperBounds: [offsets[i + 1]]).reshaped(to: shapes[i])
+  }
+
+  /// Replaces the parameters of `base` with their views of `buffer`.
+  public func unpack(into base: inout Base) {
+    let original = base
+    plan.mapTensors(&base, original) {
+      (parameter: inout Tensor<Float>, _: Tensor<Float>, i: Int) in
+      parameter = view(i)
+    }
+  }
+
+  /// Replaces `buffer` with the parameters of `base`, after they got assigned directly.
+  public mutating func pack(_ base: Base) {
+    buffer = flatten(plan.allTensors(base))
+  }
+}
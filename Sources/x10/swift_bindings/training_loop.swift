@@ -77,15 +77,11 @@ fileprivate func unpackNibbles(_ scalars: [Float]) -> Int {
   return out
 }
 
-fileprivate func unpackNibbles(_ input: Tensor<Float>) -> [Int] {
-  let shape = input.shape.dimensions
-  precondition(shape.count == 2 && shape[1] == 16)
-  var out = [Int]()
-  let scalars = input.scalars
-  for i in 0..<shape[0] {
-    out.append(unpackNibbles((0..<16).map { scalars[i * 16 + $0] }))
+fileprivate func unpackNibbleRows(_ scalars: [Float]) -> [Int] {
+  precondition(scalars.count % 16 == 0)
+  return (0..<(scalars.count / 16)).map { i in
+    unpackNibbles((0..<16).map { scalars[i * 16 + $0] })
   }
-  return out
 }
 
 public class EpochPipelineQueue {
@@ -152,8 +148,10 @@ struct Statistics {
     floats.crossReplicaSum(1)
     LazyTensorBarrier(on: device, devices: devices, wait: true)
     return {
-      let intsScalars = unpackNibbles(ints)
-      let floatsScalars = floats.scalars
+      // Both tensors come back with a single transfer.
+      let scalars = Tensor<Float>.scalars(of: [ints, floats])
+      let intsScalars = unpackNibbleRows(scalars[0])
+      let floatsScalars = scalars[1]
 
       return HostStatistics(
         correctGuessCount: Int(intsScalars[0]),
@@ -207,39 +205,9 @@ where
     var testStats = Statistics(on: device)
     Context.local.learningPhase = .training
     for (x, y) in train {
-      let scope = MakeAnnotationScope("training")
-      let scopeTracing = MakeAnnotationScope("training-tracing")
-      var detailedScopeTracing = MakeAnnotationScope("fwd-training-tracing")
-      // x might have been constructed directly with reduced precision, check for that.
-      let input = (useAutomaticMixedPrecision && !x.isReducedPrecision) ? x.toReducedPrecision : x
-      // Compute the gradient with respect to the model.
-      let reducedPrecisionClassifier =
-        useAutomaticMixedPrecision
-        ? classifier.toReducedPrecision : classifier
-      let 𝛁model = gradient(at: reducedPrecisionClassifier) {
-        reducedPrecisionClassifier -> Tensor<Float> in
-        let ŷ = reducedPrecisionClassifier(input)
-        let correctPredictions = ŷ.argmax(squeezingAxis: 1) .== y
-        trainStats.correctGuessCountTensor +=
-          Tensor<Int32>(correctPredictions).sum()
-        trainStats.totalSamples += y.shape[0]
-        let loss = lossFunction(ŷ, y)
-        trainStats.totalLossTensor +=
-          Float(y.shape[0]) * (self.useAutomaticMixedPrecision ? loss.toFullPrecision : loss)
-        DestroyAnnotationScope(detailedScopeTracing)
-        detailedScopeTracing = MakeAnnotationScope("back-training-tracing")
-        return loss
-      }
-      DestroyAnnotationScope(detailedScopeTracing)
-      detailedScopeTracing = MakeAnnotationScope("optimizer-training-tracing")
-      // Update the model's differentiable variables along the gradient vector.
-      scheduleLearningRate(optimizer)
-      optimizer.update(
-        &classifier, along: useAutomaticMixedPrecision ? 𝛁model.toFullPrecision : 𝛁model)
-      DestroyAnnotationScope(detailedScopeTracing)
-      DestroyAnnotationScope(scopeTracing)
-      LazyTensorBarrier(on: device, devices: crsDevices)
-      DestroyAnnotationScope(scope)
+      trainStep(
+        x: x, y: y, stats: &trainStats, crossReplicaSumDevices: crsDevices,
+        scheduleLearningRate: scheduleLearningRate, lossFunction: lossFunction)
     }
 
     Context.local.learningPhase = .inference
@@ -265,6 +233,75 @@ where
     let testStatsCb = testStats.crsHostStats(on: device, devices: crsDevices)
     return { (train: trainStatsCb(), test: testStatsCb()) }
   }
+
+  /// Runs a training step over the (x, y) batch, accumulating its loss and correct guesses into
+  /// `stats`.
+  func trainStep(
+    x: Tensor<Float>, y: Tensor<Int32>, stats: inout Statistics,
+    crossReplicaSumDevices: [Device], scheduleLearningRate: (Opt) -> Void,
+    lossFunction:
+      @differentiable(reverse) (Tensor<Float>, @noDerivative Tensor<Int32>) -> Tensor<Float>
+  ) {
+    let scope = MakeAnnotationScope("training")
+    let scopeTracing = MakeAnnotationScope("training-tracing")
+    var detailedScopeTracing = MakeAnnotationScope("fwd-training-tracing")
+    // x might have been constructed directly with reduced precision, check for that.
+    let input = (useAutomaticMixedPrecision && !x.isReducedPrecision) ? x.toReducedPrecision : x
+    // Compute the gradient with respect to the model.
+    let reducedPrecisionClassifier =
+      useAutomaticMixedPrecision
+      ? classifier.toReducedPrecision : classifier
+    let 𝛁model = gradient(at: reducedPrecisionClassifier) {
+      reducedPrecisionClassifier -> Tensor<Float> in
+      let ŷ = reducedPrecisionClassifier(input)
+      let correctPredictions = ŷ.argmax(squeezingAxis: 1) .== y
+      stats.correctGuessCountTensor +=
+        Tensor<Int32>(correctPredictions).sum()
+      stats.totalSamples += y.shape[0]
+      let loss = lossFunction(ŷ, y)
+      stats.totalLossTensor +=
+        Float(y.shape[0]) * (self.useAutomaticMixedPrecision ? loss.toFullPrecision : loss)
+      DestroyAnnotationScope(detailedScopeTracing)
+      detailedScopeTracing = MakeAnnotationScope("back-training-tracing")
+      return loss
+    }
+    DestroyAnnotationScope(detailedScopeTracing)
+    detailedScopeTracing = MakeAnnotationScope("optimizer-training-tracing")
+    // Update the model's differentiable variables along the gradient vector.
+    scheduleLearningRate(optimizer)
+    optimizer.update(
+      &classifier, along: useAutomaticMixedPrecision ? 𝛁model.toFullPrecision : 𝛁model)
+    DestroyAnnotationScope(detailedScopeTracing)
+    DestroyAnnotationScope(scopeTracing)
+    LazyTensorBarrier(on: devices[threadId], devices: crossReplicaSumDevices)
+    DestroyAnnotationScope(scope)
+  }
+
+  /// Measures the steady state training performance over the (x, y) batch with
+  /// `benchmarkTraining`, running the same step as the training loop.
+  public func benchmark(
+    x: Tensor<Float>, y: Tensor<Int32>, warmupSteps: Int = 3, steps: Int = 20,
+    crossReplicaSumDevices: [Device]? = nil,
+    lossFunction:
+      @differentiable(reverse) (Tensor<Float>, @noDerivative Tensor<Int32>) -> Tensor<Float> =
+      _defaultLossFunction
+  ) -> TrainingBenchmarkReport {
+    let device = devices[threadId]
+    let crsDevices = crossReplicaSumDevices ?? devices
+    // Keep the input transfers out of the measured steps.
+    let x = Tensor(copying: x, to: device)
+    let y = Tensor(copying: y, to: device)
+    var stats = Statistics(on: device)
+    Context.local.learningPhase = .training
+    return benchmarkTraining(
+      warmupSteps: warmupSteps, steps: steps, examplesPerStep: x.shape[0], on: device,
+      devices: crsDevices
+    ) {
+      trainStep(
+        x: x, y: y, stats: &stats, crossReplicaSumDevices: crsDevices,
+        scheduleLearningRate: { _ in }, lossFunction: lossFunction)
+    }
+  }
 }
 
 class ThreadResultBox<T> {
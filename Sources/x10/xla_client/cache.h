@@ -17,33 +17,69 @@
 #ifndef X10_XLA_CLIENT_CACHE_H_
 #define X10_XLA_CLIENT_CACHE_H_
 
+#include <algorithm>
+#include <cstdint>
 #include <functional>
+#include <iterator>
 #include <list>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 
 namespace xla {
 namespace util {
 
 // Generic key and object cache with LRU expiration policy. The objects of type
 // T will be stored as std::shared_ptr<T> and taken and returned as such, by the
-// cache API.
+// cache API. Besides the entry limit, the cache can be bounded by the bytes of
+// its objects, as measured by size_fn. If a name is given, the cache reports
+// its hits, misses and evictions in the <name>Hit, <name>Miss and <name>Evict
+// counters.
+// If a cost_fn is given, which tells how expensive would be recreating an
+// object, the cache evicts following the GreedyDual-Size-Frequency policy
+// instead: the priority of an object is its hit count times its cost, divided
+// by its size, plus the priority of the last evicted object (which ages the
+// objects left untouched), and the lowest priority object goes first. The cost
+// of the evicted objects is then sampled in the <name>EvictedCost metric.
 template <typename K, typename T, typename H = std::hash<K>,
           typename E = std::equal_to<K>>
 class Cache {
  public:
   using TypePtr = std::shared_ptr<T>;
   using Element = std::pair<K, TypePtr>;
+  using SizeFn = std::function<size_t(const T&)>;
+  using CostFn = std::function<double(const T&)>;
 
-  explicit Cache(size_t max_size) : max_size_(max_size) {}
+  explicit Cache(size_t max_size, std::string name = std::string(),
+                 size_t max_bytes = 0, SizeFn size_fn = nullptr,
+                 CostFn cost_fn = nullptr)
+      : max_size_(max_size),
+        max_bytes_(max_bytes),
+        size_fn_(std::move(size_fn)),
+        cost_fn_(std::move(cost_fn)) {
+    if (!name.empty()) {
+      hit_counter_ = absl::make_unique<metrics::Counter>(name + "Hit");
+      miss_counter_ = absl::make_unique<metrics::Counter>(name + "Miss");
+      evict_counter_ = absl::make_unique<metrics::Counter>(name + "Evict");
+      if (cost_fn_ != nullptr) {
+        evicted_cost_metric_ =
+            absl::make_unique<metrics::Metric>(name + "EvictedCost");
+      }
+    }
+  }
 
   // Adds an object to the cache, unless it already exists. If the cache grows
-  // beyond the limit set during construction, the oldest used object will be
-  // removed from the cache.
+  // beyond the limits set during construction, objects will be removed from the
+  // cache, the oldest used first unless a cost function was given. The object
+  // just added is never removed.
   TypePtr Add(K key, TypePtr object) {
     std::lock_guard<std::mutex> slock(lock_);
     element_list_.emplace_front(Element(std::move(key), std::move(object)));
@@ -51,11 +87,23 @@ class Cache {
     auto emplace_result = element_map_.emplace(&it->first, it);
     if (!emplace_result.second) {
       element_list_.erase(it);
-      DoLRU(emplace_result.first->second);
-    } else if (element_list_.size() > max_size_) {
-      Element* last = &element_list_.back();
-      element_map_.erase(&last->first);
-      element_list_.pop_back();
+      Touch(emplace_result.first->second);
+    } else {
+      bytes_ += GetBytes(*it);
+      if (cost_fn_ != nullptr) {
+        gdsf_entries_.emplace(&it->first, GdsfEntry{0, priorities_.end()});
+        UpdatePriority(it);
+      }
+      size_t evicted = 0;
+      while (element_list_.size() > 1 &&
+             (element_list_.size() > max_size_ ||
+              (max_bytes_ > 0 && bytes_ > max_bytes_))) {
+        Evict(GetVictim());
+        ++evicted;
+      }
+      if (evicted > 0 && evict_counter_ != nullptr) {
+        evict_counter_->AddValue(evicted);
+      }
     }
     return emplace_result.first->second->second;
   }
@@ -68,9 +116,15 @@ class Cache {
     std::lock_guard<std::mutex> slock(lock_);
     auto it = element_map_.find(&key);
     if (it == element_map_.end()) {
+      if (miss_counter_ != nullptr) {
+        miss_counter_->AddValue(1);
+      }
       return nullptr;
     }
-    DoLRU(it->second);
+    if (hit_counter_ != nullptr) {
+      hit_counter_->AddValue(1);
+    }
+    Touch(it->second);
     return it->second->second;
   }
 
@@ -80,20 +134,39 @@ class Cache {
     if (it == element_map_.end()) {
       return false;
     }
-    auto lit = it->second;
-    element_map_.erase(it);
-    element_list_.erase(lit);
+    Remove(it->second);
     return true;
   }
 
+  // Removes the objects for which the predicate returns true, and returns how
+  // many were removed.
+  size_t EraseIf(const std::function<bool(const K&, const T&)>& predicate) {
+    std::lock_guard<std::mutex> slock(lock_);
+    size_t erased = 0;
+    for (auto it = element_list_.begin(); it != element_list_.end();) {
+      auto next = std::next(it);
+      if (it->second != nullptr && predicate(it->first, *it->second)) {
+        Remove(it);
+        ++erased;
+      }
+      it = next;
+    }
+    return erased;
+  }
+
   void Clear() {
     std::lock_guard<std::mutex> slock(lock_);
     element_map_.clear();
     element_list_.clear();
+    priorities_.clear();
+    gdsf_entries_.clear();
+    bytes_ = 0;
+    clock_ = 0.0;
   }
 
  private:
   using ElementList = std::list<Element>;
+  using PriorityMap = std::multimap<double, typename ElementList::iterator>;
 
   struct Hasher {
     size_t operator()(const K* key) const { return hasher(*key); }
@@ -109,6 +182,11 @@ class Cache {
     E equaler;
   };
 
+  struct GdsfEntry {
+    size_t frequency = 0;
+    typename PriorityMap::iterator position;
+  };
+
   using ElementMap =
       absl::flat_hash_map<const K*, typename ElementList::iterator, Hasher,
                           Equaler>;
@@ -117,10 +195,145 @@ class Cache {
     element_list_.splice(element_list_.begin(), element_list_, it);
   }
 
+  void Touch(typename ElementList::iterator it) {
+    DoLRU(it);
+    if (cost_fn_ != nullptr) {
+      UpdatePriority(it);
+    }
+  }
+
+  void UpdatePriority(typename ElementList::iterator it) {
+    GdsfEntry& entry = gdsf_entries_.at(&it->first);
+    if (entry.position != priorities_.end()) {
+      priorities_.erase(entry.position);
+    }
+    ++entry.frequency;
+    double size = static_cast<double>(std::max<size_t>(GetBytes(*it), 1));
+    entry.position = priorities_.emplace(
+        clock_ + entry.frequency * GetCost(*it) / size, it);
+  }
+
+  // Returns the object to be evicted, which is never the most recently added
+  // one.
+  typename ElementList::iterator GetVictim() {
+    if (cost_fn_ == nullptr) {
+      return std::prev(element_list_.end());
+    }
+    auto pit = priorities_.begin();
+    if (pit->second == element_list_.begin()) {
+      ++pit;
+    }
+    return pit->second;
+  }
+
+  void Evict(typename ElementList::iterator it) {
+    if (cost_fn_ != nullptr) {
+      clock_ = gdsf_entries_.at(&it->first).position->first;
+      if (evicted_cost_metric_ != nullptr) {
+        evicted_cost_metric_->AddSample(GetCost(*it));
+      }
+    }
+    Remove(it);
+  }
+
+  void Remove(typename ElementList::iterator it) {
+    if (cost_fn_ != nullptr) {
+      auto git = gdsf_entries_.find(&it->first);
+      priorities_.erase(git->second.position);
+      gdsf_entries_.erase(git);
+    }
+    bytes_ -= GetBytes(*it);
+    element_map_.erase(&it->first);
+    element_list_.erase(it);
+  }
+
+  size_t GetBytes(const Element& element) const {
+    return size_fn_ != nullptr && element.second != nullptr
+               ? size_fn_(*element.second)
+               : 0;
+  }
+
+  double GetCost(const Element& element) const {
+    return element.second != nullptr ? cost_fn_(*element.second) : 0.0;
+  }
+
   std::mutex lock_;
   size_t max_size_ = 0;
+  size_t max_bytes_ = 0;
+  size_t bytes_ = 0;
+  SizeFn size_fn_;
+  CostFn cost_fn_;
+  std::unique_ptr<metrics::Counter> hit_counter_;
+  std::unique_ptr<metrics::Counter> miss_counter_;
+  std::unique_ptr<metrics::Counter> evict_counter_;
+  std::unique_ptr<metrics::Metric> evicted_cost_metric_;
   ElementList element_list_;
   ElementMap element_map_;
+  // GreedyDual-Size-Frequency state, only used with a cost function.
+  PriorityMap priorities_;
+  absl::flat_hash_map<const K*, GdsfEntry, Hasher, Equaler> gdsf_entries_;
+  double clock_ = 0.0;
+};
+
+// Cache with the same API as the one above, whose keys are spread by hash over
+// num_shards independent LRU caches, each with its own lock and an even share
+// of the entry and byte limits. This trades exact LRU ordering for threads
+// hitting the cache concurrently without contending on a single lock.
+template <typename K, typename T, typename H = std::hash<K>,
+          typename E = std::equal_to<K>>
+class ShardedCache {
+ public:
+  using ShardType = Cache<K, T, H, E>;
+  using TypePtr = typename ShardType::TypePtr;
+  using SizeFn = typename ShardType::SizeFn;
+  using CostFn = typename ShardType::CostFn;
+
+  ShardedCache(size_t max_size, size_t num_shards,
+               std::string name = std::string(), size_t max_bytes = 0,
+               SizeFn size_fn = nullptr, CostFn cost_fn = nullptr) {
+    num_shards = std::max<size_t>(std::min(num_shards, max_size), 1);
+    size_t shard_size = (max_size + num_shards - 1) / num_shards;
+    size_t shard_bytes = (max_bytes + num_shards - 1) / num_shards;
+    shards_.reserve(num_shards);
+    for (size_t i = 0; i < num_shards; ++i) {
+      shards_.push_back(absl::make_unique<ShardType>(
+          shard_size, name, shard_bytes, size_fn, cost_fn));
+    }
+  }
+
+  TypePtr Add(K key, TypePtr object) {
+    ShardType* shard = GetShard(key);
+    return shard->Add(std::move(key), std::move(object));
+  }
+
+  TypePtr Get(const K& key) { return GetShard(key)->Get(key); }
+
+  bool Erase(const K& key) { return GetShard(key)->Erase(key); }
+
+  size_t EraseIf(const std::function<bool(const K&, const T&)>& predicate) {
+    size_t erased = 0;
+    for (auto& shard : shards_) {
+      erased += shard->EraseIf(predicate);
+    }
+    return erased;
+  }
+
+  void Clear() {
+    for (auto& shard : shards_) {
+      shard->Clear();
+    }
+  }
+
+ private:
+  ShardType* GetShard(const K& key) {
+    // The high bits select the shard, as the shards' hash maps consume the low
+    // ones.
+    uint64_t hash = static_cast<uint64_t>(hasher_(key)) * 0x9e3779b97f4a7c15;
+    return shards_[(hash >> 32) % shards_.size()].get();
+  }
+
+  H hasher_;
+  std::vector<std::unique_ptr<ShardType>> shards_;
 };
 
 }  // namespace util
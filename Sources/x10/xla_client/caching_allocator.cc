@@ -0,0 +1,292 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/xla/xla_client/caching_allocator.h"
+
+#include <algorithm>
+
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+
+namespace xla {
+namespace {
+
+struct Registry {
+  absl::Mutex mutex;
+  absl::flat_hash_set<CachingDeviceAllocator*> allocators
+      ABSL_GUARDED_BY(mutex);
+};
+
+Registry* GetRegistry() {
+  static Registry* registry = new Registry();
+  return registry;
+}
+
+size_t GetBlockSize(size_t size) {
+  constexpr size_t kMinBlockSize = 512;
+  constexpr size_t kLargeBlockSize = 1024 * 1024;
+  if (size <= kLargeBlockSize) {
+    return (size + kMinBlockSize - 1) / kMinBlockSize * kMinBlockSize;
+  }
+  // Large blocks are rounded up to an eighth of their power of two range,
+  // which bounds the rounding waste to 12.5%.
+  size_t step = kLargeBlockSize / 8;
+  while (step * 16 <= size) {
+    step *= 2;
+  }
+  return (size + step - 1) / step * step;
+}
+
+int64_t GetMaxCachedBytes() {
+  static const int64_t max_cached_bytes =
+      sys_util::GetEnvInt("XLA_DEVICE_ALLOCATOR_MAX_CACHED", 0);
+  return max_cached_bytes;
+}
+
+}  // namespace
+
+CachingDeviceAllocator::CachingDeviceAllocator(
+    se::DeviceMemoryAllocator* allocator)
+    : se::DeviceMemoryAllocator(allocator->platform()), allocator_(allocator) {
+  Registry* registry = GetRegistry();
+  absl::MutexLock lock(&registry->mutex);
+  registry->allocators.insert(this);
+}
+
+CachingDeviceAllocator::~CachingDeviceAllocator() {
+  {
+    Registry* registry = GetRegistry();
+    absl::MutexLock lock(&registry->mutex);
+    registry->allocators.erase(this);
+  }
+  for (se::Stream* stream : streams_) {
+    TF_CHECK_OK(stream->BlockHostUntilDone());
+  }
+  CollectPendingBlocks();
+  ReleaseCachedMemory();
+}
+
+void CachingDeviceAllocator::SetStreams(std::vector<se::Stream*> streams) {
+  streams_ = std::move(streams);
+}
+
+se::port::StatusOr<se::OwningDeviceMemory> CachingDeviceAllocator::Allocate(
+    int device_ordinal, uint64 size, bool retry_on_failure,
+    int64 memory_space) {
+  if (size == 0 || memory_space != 0) {
+    return allocator_->Allocate(device_ordinal, size, retry_on_failure,
+                                memory_space);
+  }
+  size_t block_size = GetBlockSize(size);
+  void* ptr = nullptr;
+  CollectPendingBlocks();
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = free_blocks_.find(BucketKey(device_ordinal, block_size));
+    if (it != free_blocks_.end() && !it->second.empty()) {
+      ptr = it->second.back();
+      it->second.pop_back();
+      stats_.cached_bytes -= block_size;
+    }
+  }
+  if (ptr != nullptr) {
+    XLA_COUNTER("DeviceAllocatorCacheHit", 1);
+  } else {
+    XLA_COUNTER("DeviceAllocatorCacheMiss", 1);
+    auto memory_or = allocator_->Allocate(device_ordinal, block_size,
+                                          /*retry_on_failure=*/false,
+                                          memory_space);
+    if (!memory_or.ok()) {
+      // The cached blocks might be what keeps the wrapped allocator from
+      // satisfying the request, so drop them before giving up, along with the
+      // pending ones once their streams are done.
+      for (se::Stream* stream : streams_) {
+        TF_CHECK_OK(stream->BlockHostUntilDone());
+      }
+      CollectPendingBlocks();
+      int64_t released = ReleaseCachedMemory();
+      TF_VLOG(2) << "Device allocation of " << block_size
+                 << " bytes failed, released " << released
+                 << " cached bytes before retrying";
+      XLA_COUNTER("DeviceAllocatorRetries", 1);
+      memory_or = allocator_->Allocate(device_ordinal, block_size,
+                                       retry_on_failure, memory_space);
+      if (!memory_or.ok()) {
+        return memory_or.status();
+      }
+    }
+    ptr = memory_or.ValueOrDie().Release().opaque();
+  }
+  {
+    absl::MutexLock lock(&mutex_);
+    live_blocks_[ptr] = Block{device_ordinal, block_size, size};
+    stats_.live_bytes += block_size;
+    stats_.requested_bytes += size;
+    stats_.peak_bytes = std::max(stats_.peak_bytes, stats_.live_bytes);
+  }
+  return se::OwningDeviceMemory(se::DeviceMemoryBase(ptr, size),
+                                device_ordinal, this);
+}
+
+se::port::Status CachingDeviceAllocator::Deallocate(int device_ordinal,
+                                                    se::DeviceMemoryBase mem) {
+  if (mem.is_null()) {
+    return se::port::Status::OK();
+  }
+  void* ptr = mem.opaque();
+  Block block;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = live_blocks_.find(ptr);
+    if (it == live_blocks_.end()) {
+      return allocator_->Deallocate(device_ordinal, mem);
+    }
+    block = it->second;
+    live_blocks_.erase(it);
+    stats_.live_bytes -= block.size;
+    stats_.requested_bytes -= block.requested;
+  }
+  if (streams_.empty()) {
+    return CacheBlock(ptr, block);
+  }
+  PendingBlock pending{ptr, block, {}};
+  pending.events.reserve(streams_.size());
+  for (se::Stream* stream : streams_) {
+    auto event = std::make_shared<se::Event>(stream->parent());
+    XLA_CHECK(event->Init()) << "Unable to create a stream event";
+    stream->ThenRecordEvent(event.get());
+    pending.events.push_back(std::move(event));
+  }
+  absl::MutexLock lock(&mutex_);
+  stats_.cached_bytes += block.size;
+  pending_blocks_.push_back(std::move(pending));
+  return se::port::Status::OK();
+}
+
+void CachingDeviceAllocator::CollectPendingBlocks() {
+  std::vector<PendingBlock> done_blocks;
+  {
+    absl::MutexLock lock(&mutex_);
+    // The blocks are checked in deallocation order, up to the first one whose
+    // streams have not caught up yet.
+    while (!pending_blocks_.empty() &&
+           std::all_of(pending_blocks_.front().events.begin(),
+                       pending_blocks_.front().events.end(),
+                       [](const std::shared_ptr<se::Event>& event) {
+                         return event->PollForStatus() ==
+                                se::Event::Status::kComplete;
+                       })) {
+      stats_.cached_bytes -= pending_blocks_.front().block.size;
+      done_blocks.push_back(std::move(pending_blocks_.front()));
+      pending_blocks_.pop_front();
+    }
+  }
+  for (const PendingBlock& pending : done_blocks) {
+    TF_CHECK_OK(CacheBlock(pending.ptr, pending.block));
+  }
+}
+
+se::port::Status CachingDeviceAllocator::CacheBlock(void* ptr,
+                                                    const Block& block) {
+  {
+    absl::MutexLock lock(&mutex_);
+    int64_t max_cached_bytes = GetMaxCachedBytes();
+    if (max_cached_bytes <= 0 ||
+        stats_.cached_bytes + static_cast<int64_t>(block.size) <=
+            max_cached_bytes) {
+      free_blocks_[BucketKey(block.device_ordinal, block.size)].push_back(ptr);
+      stats_.cached_bytes += block.size;
+      return se::port::Status::OK();
+    }
+  }
+  return allocator_->Deallocate(block.device_ordinal,
+                                se::DeviceMemoryBase(ptr, block.size));
+}
+
+int64_t CachingDeviceAllocator::ReleaseCachedMemory() {
+  std::map<BucketKey, std::vector<void*>> free_blocks;
+  {
+    absl::MutexLock lock(&mutex_);
+    free_blocks.swap(free_blocks_);
+    for (auto& bucket_blocks : free_blocks) {
+      stats_.cached_bytes -=
+          bucket_blocks.first.second * bucket_blocks.second.size();
+    }
+  }
+  int64_t released = 0;
+  for (auto& bucket_blocks : free_blocks) {
+    const BucketKey& key = bucket_blocks.first;
+    for (void* ptr : bucket_blocks.second) {
+      TF_CHECK_OK(allocator_->Deallocate(
+          key.first, se::DeviceMemoryBase(ptr, key.second)));
+      released += key.second;
+    }
+  }
+  return released;
+}
+
+CachingDeviceAllocator::Stats CachingDeviceAllocator::GetStats() const {
+  absl::MutexLock lock(&mutex_);
+  return stats_;
+}
+
+int64_t CachingDeviceAllocator::ReleaseAllCachedMemory() {
+  Registry* registry = GetRegistry();
+  absl::MutexLock lock(&registry->mutex);
+  int64_t released = 0;
+  for (auto* allocator : registry->allocators) {
+    released += allocator->ReleaseCachedMemory();
+  }
+  return released;
+}
+
+void CachingDeviceAllocator::ReportMetrics() {
+  static metrics::Metric* live_metric =
+      new metrics::Metric("DeviceAllocatorLiveBytes", metrics::MetricFnBytes);
+  static metrics::Metric* peak_metric =
+      new metrics::Metric("DeviceAllocatorPeakBytes", metrics::MetricFnBytes);
+  static metrics::Metric* cached_metric = new metrics::Metric(
+      "DeviceAllocatorCachedBytes", metrics::MetricFnBytes);
+  static metrics::Metric* fragmentation_metric =
+      new metrics::Metric("DeviceAllocatorFragmentation");
+  Stats total;
+  {
+    Registry* registry = GetRegistry();
+    absl::MutexLock lock(&registry->mutex);
+    for (auto* allocator : registry->allocators) {
+      Stats stats = allocator->GetStats();
+      total.live_bytes += stats.live_bytes;
+      total.peak_bytes += stats.peak_bytes;
+      total.cached_bytes += stats.cached_bytes;
+      total.requested_bytes += stats.requested_bytes;
+    }
+  }
+  live_metric->AddSample(total.live_bytes);
+  peak_metric->AddSample(total.peak_bytes);
+  cached_metric->AddSample(total.cached_bytes);
+  // Share of the memory held by the allocators which does not back requested
+  // bytes, either because of the block rounding or because it sits in the
+  // cache.
+  int64_t reserved_bytes = total.live_bytes + total.cached_bytes;
+  if (reserved_bytes > 0) {
+    fragmentation_metric->AddSample(
+        static_cast<double>(reserved_bytes - total.requested_bytes) /
+        reserved_bytes);
+  }
+}
+
+}  // namespace xla
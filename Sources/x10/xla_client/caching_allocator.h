@@ -0,0 +1,132 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef X10_XLA_CLIENT_CACHING_ALLOCATOR_H_
+#define X10_XLA_CLIENT_CACHING_ALLOCATOR_H_
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/stream_executor/device_memory_allocator.h"
+#include "tensorflow/stream_executor/event.h"
+#include "tensorflow/stream_executor/stream.h"
+
+namespace xla {
+
+// Device memory allocator which keeps the freed blocks around, bucketed by
+// rounded size, and hands them out again to the allocations falling in the
+// same bucket, without going through the wrapped allocator. When the wrapped
+// allocator runs out of memory, the cached blocks are released and the
+// allocation is retried.
+//
+// When the computations of the device run on several streams, a block freed
+// while work still queued on one of them can use it, like the temporary
+// buffers an executable frees right after enqueuing, is only handed out again
+// once all the streams have moved past the point of the deallocation.
+class CachingDeviceAllocator : public se::DeviceMemoryAllocator {
+ public:
+  struct Stats {
+    // Bytes of the blocks currently handed out.
+    int64_t live_bytes = 0;
+    // Highest value reached by live_bytes.
+    int64_t peak_bytes = 0;
+    // Bytes of the free blocks held by the cache, including the ones waiting
+    // for their streams.
+    int64_t cached_bytes = 0;
+    // Bytes actually requested by the live allocations.
+    int64_t requested_bytes = 0;
+  };
+
+  explicit CachingDeviceAllocator(se::DeviceMemoryAllocator* allocator);
+
+  ~CachingDeviceAllocator() override;
+
+  using se::DeviceMemoryAllocator::Allocate;
+
+  se::port::StatusOr<se::OwningDeviceMemory> Allocate(
+      int device_ordinal, uint64 size, bool retry_on_failure,
+      int64 memory_space) override;
+
+  se::port::Status Deallocate(int device_ordinal,
+                              se::DeviceMemoryBase mem) override;
+
+  bool AllowsAsynchronousDeallocation() const override {
+    return allocator_->AllowsAsynchronousDeallocation();
+  }
+
+  se::port::StatusOr<se::Stream*> GetStream(int device_ordinal) override {
+    return allocator_->GetStream(device_ordinal);
+  }
+
+  // Makes the freed blocks wait for the work queued so far on the given
+  // streams before getting reused.
+  void SetStreams(std::vector<se::Stream*> streams);
+
+  // Returns all the cached blocks to the wrapped allocator, and returns the
+  // number of bytes released.
+  int64_t ReleaseCachedMemory();
+
+  Stats GetStats() const;
+
+  // Calls ReleaseCachedMemory() on all the live caching allocators.
+  static int64_t ReleaseAllCachedMemory();
+
+  // Samples the stats summed over all the live caching allocators into the
+  // DeviceAllocator* metrics.
+  static void ReportMetrics();
+
+ private:
+  struct Block {
+    int device_ordinal = 0;
+    size_t size = 0;
+    size_t requested = 0;
+  };
+
+  using BucketKey = std::pair<int, size_t>;
+
+  // A freed block waiting for the events recorded on the streams at its
+  // deallocation.
+  struct PendingBlock {
+    void* ptr = nullptr;
+    Block block;
+    std::vector<std::shared_ptr<se::Event>> events;
+  };
+
+  // Caches the freed block, or hands it back to the wrapped allocator if the
+  // cache is full.
+  se::port::Status CacheBlock(void* ptr, const Block& block);
+
+  // Caches the pending blocks whose streams went past their deallocation.
+  void CollectPendingBlocks();
+
+  se::DeviceMemoryAllocator* allocator_;
+  std::vector<se::Stream*> streams_;
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<void*, Block> live_blocks_ ABSL_GUARDED_BY(mutex_);
+  std::map<BucketKey, std::vector<void*>> free_blocks_ ABSL_GUARDED_BY(mutex_);
+  std::deque<PendingBlock> pending_blocks_ ABSL_GUARDED_BY(mutex_);
+  Stats stats_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace xla
+
+#endif  // X10_XLA_CLIENT_CACHING_ALLOCATOR_H_
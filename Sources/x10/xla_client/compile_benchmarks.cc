@@ -0,0 +1,191 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks the compilation of a corpus of saved HLO modules:
+//
+//   x10_compile_benchmarks [<benchmark flags>] <path>...
+//
+// with the paths either files written through XLA_SAVE_HLO_FILE, which can
+// hold many graphs, or folders of the modules saved through
+// XLA_SLOW_COMPILE_HLO_FOLDER. Every module gets compiled, for a single
+// replica, on the first device of each kind, and reports its compile time and
+// the peak host memory of the process while compiling it (Linux only, -1
+// elsewhere). The results can be compared across commits with:
+//   x10_compile_benchmarks --benchmark_format=json --benchmark_out=new.json ...
+//   compare_op_benchmarks.py old.json new.json
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "tensorflow/compiler/xla/service/hlo_parser.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/path.h"
+
+namespace xla {
+namespace {
+
+struct HloModuleEntry {
+  std::string name;
+  std::shared_ptr<XlaComputation> computation;
+};
+
+// Splits the content of a XLA_SAVE_HLO_FILE file, where every graph follows a
+// "[HLO Graph ..." header line. Files without headers hold a single module.
+std::vector<std::string> SplitHloGraphs(const std::string& content) {
+  static const char* const kGraphHeader = "[HLO Graph ";
+  std::vector<std::string> graphs;
+  std::string current;
+  std::istringstream stream(content);
+  std::string line;
+  while (std::getline(stream, line)) {
+    if (absl::StartsWith(line, kGraphHeader)) {
+      if (!current.empty()) {
+        graphs.push_back(std::move(current));
+        current.clear();
+      }
+      continue;
+    }
+    absl::StrAppend(&current, line, "\n");
+  }
+  if (!current.empty()) {
+    graphs.push_back(std::move(current));
+  }
+  return graphs;
+}
+
+void LoadHloFile(const std::string& path,
+                 std::vector<HloModuleEntry>* modules) {
+  std::string content;
+  XLA_CHECK_OK(
+      tensorflow::ReadFileToString(tensorflow::Env::Default(), path, &content));
+  std::vector<std::string> graphs = SplitHloGraphs(content);
+  for (size_t i = 0; i < graphs.size(); ++i) {
+    std::unique_ptr<HloModule> module =
+        ConsumeValue(ParseAndReturnUnverifiedModule(graphs[i]));
+    std::string name = std::string(tensorflow::io::Basename(path));
+    if (graphs.size() > 1) {
+      absl::StrAppend(&name, "#", i);
+    }
+    modules->push_back(
+        {std::move(name), std::make_shared<XlaComputation>(module->ToProto())});
+  }
+}
+
+std::vector<HloModuleEntry> LoadHloModules(
+    const std::vector<std::string>& paths) {
+  tensorflow::Env* env = tensorflow::Env::Default();
+  std::vector<HloModuleEntry> modules;
+  for (const std::string& path : paths) {
+    if (!env->IsDirectory(path).ok()) {
+      LoadHloFile(path, &modules);
+      continue;
+    }
+    std::vector<std::string> children;
+    XLA_CHECK_OK(env->GetChildren(path, &children));
+    std::sort(children.begin(), children.end());
+    for (const std::string& child : children) {
+      LoadHloFile(tensorflow::io::JoinPath(path, child), &modules);
+    }
+  }
+  return modules;
+}
+
+// Reads a "<key>: <value> kB" entry of /proc/self/status, in bytes.
+int64_t ReadProcStatusBytes(const std::string& key) {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (absl::StartsWith(line, key)) {
+      return std::stoll(line.substr(key.size())) * 1024;
+    }
+  }
+  return -1;
+}
+
+// Resets the peak resident set size of the process to the current one.
+void ResetPeakHostMemory() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+}
+
+int64_t PeakHostMemory() { return ReadProcStatusBytes("VmHWM:"); }
+
+void BM_Compile(benchmark::State& state, std::string device,
+                HloModuleEntry module) {
+  ComputationClient::Device* x10_device = GetX10Device(device);
+  int64_t peak_bytes = -1;
+  for (auto _ : state) {
+    std::vector<ComputationClient::CompileInstance> instances;
+    instances.emplace_back(*module.computation, /*output_shape=*/nullptr);
+    ResetPeakHostMemory();
+    benchmark::DoNotOptimize(
+        x10_device->Compile({device}, std::move(instances)));
+    peak_bytes = std::max(peak_bytes, PeakHostMemory());
+  }
+  state.counters["peak_host_bytes"] = peak_bytes;
+}
+
+std::vector<std::string> GetBenchmarkDevices() {
+  std::vector<std::string> devices;
+  for (const std::string& device : ComputationClient::AllDevices()) {
+    swift_xla::Device device_id(device);
+    bool seen = false;
+    for (const std::string& other : devices) {
+      seen = seen || swift_xla::Device(other).hw_type == device_id.hw_type;
+    }
+    if (!seen) {
+      devices.push_back(device);
+    }
+  }
+  return devices;
+}
+
+void RegisterCompileBenchmarks(const std::vector<std::string>& paths) {
+  std::vector<HloModuleEntry> modules = LoadHloModules(paths);
+  for (const std::string& device : GetBenchmarkDevices()) {
+    for (const HloModuleEntry& module : modules) {
+      benchmark::RegisterBenchmark(
+          absl::StrCat("BM_Compile/", device, "/", module.name).c_str(),
+          BM_Compile, device, module)
+          ->Unit(benchmark::kMillisecond)
+          ->UseRealTime();
+    }
+  }
+}
+
+}  // namespace
+}  // namespace xla
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " [<benchmark flags>] <path>...\n";
+    return 1;
+  }
+  xla::RegisterCompileBenchmarks(
+      std::vector<std::string>(argv + 1, argv + argc));
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,36 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Runs the reference compile cache service:
+//
+//   compile_cache_server <address> [<path>]
+//
+// with address like [::]:8477, and the optional path of the folder keeping the
+// entries across restarts.
+
+#include <iostream>
+
+#include "tensorflow/compiler/xla/xla_client/compile_cache_service.h"
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3) {
+    std::cerr << "Usage: " << argv[0] << " <address> [<path>]\n";
+    return 1;
+  }
+  xla::service::CompileCacheService service(argv[1],
+                                            argc > 2 ? argv[2] : "");
+  std::cout << "Compile cache service listening at " << argv[1] << "\n";
+  service.Wait();
+  return 0;
+}
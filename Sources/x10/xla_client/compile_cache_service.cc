@@ -0,0 +1,210 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/xla/xla_client/compile_cache_service.h"
+
+#include <grpcpp/channel.h>
+#include <grpcpp/client_context.h>
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/server.h>
+#include <grpcpp/server_builder.h>
+#include <grpcpp/server_context.h>
+
+#include <chrono>
+#include <mutex>
+
+#include "absl/container/node_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/compile_cache_service.grpc.pb.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace xla {
+namespace service {
+namespace {
+
+class CompileCacheServiceImpl : public grpc::CompileCacheService::Service {
+ public:
+  explicit CompileCacheServiceImpl(std::string path) : path_(std::move(path)) {}
+
+  ::grpc::Status Lookup(::grpc::ServerContext* context,
+                        const grpc::CompileCacheLookupRequest* request,
+                        grpc::CompileCacheLookupResponse* response) override;
+
+  ::grpc::Status Store(::grpc::ServerContext* context,
+                       const grpc::CompileCacheStoreRequest* request,
+                       grpc::CompileCacheStoreResponse* response) override;
+
+ private:
+  std::string GetEntryPath(const std::string& key) const {
+    return absl::StrCat(path_, "/", util::HexHash(util::Hash(key)), ".entry");
+  }
+
+  std::string path_;
+  std::mutex lock_;
+  absl::node_hash_map<std::string, std::string> entries_;
+};
+
+::grpc::Status CompileCacheServiceImpl::Lookup(
+    ::grpc::ServerContext* context,
+    const grpc::CompileCacheLookupRequest* request,
+    grpc::CompileCacheLookupResponse* response) {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto it = entries_.find(request->key());
+    if (it != entries_.end()) {
+      response->set_computation(it->second);
+      return ::grpc::Status::OK;
+    }
+  }
+  if (!path_.empty()) {
+    // The entries of a previous run of the service, loaded on first use.
+    std::string data;
+    if (tensorflow::ReadFileToString(tensorflow::Env::Default(),
+                                     GetEntryPath(request->key()), &data)
+            .ok()) {
+      response->set_computation(data);
+      std::lock_guard<std::mutex> lock(lock_);
+      entries_.emplace(request->key(), std::move(data));
+    }
+  }
+  TF_VLOG(3) << "Compile cache lookup: hit=" << response->has_computation()
+             << ", peer=" << context->peer();
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status CompileCacheServiceImpl::Store(
+    ::grpc::ServerContext* context,
+    const grpc::CompileCacheStoreRequest* request,
+    grpc::CompileCacheStoreResponse* response) {
+  TF_VLOG(3) << "Compile cache store: size=" << request->computation().size()
+             << ", peer=" << context->peer();
+  if (!path_.empty()) {
+    tensorflow::Status status = tensorflow::WriteStringToFile(
+        tensorflow::Env::Default(), GetEntryPath(request->key()),
+        request->computation());
+    if (!status.ok()) {
+      TF_LOG(WARNING) << "Unable to store compile cache entry: " << status;
+    }
+  }
+  std::lock_guard<std::mutex> lock(lock_);
+  entries_[request->key()] = request->computation();
+  return ::grpc::Status::OK;
+}
+
+}  // namespace
+
+struct CompileCacheService::Impl {
+  Impl(const std::string& address, std::string path) : impl(std::move(path)) {
+    ::grpc::ServerBuilder builder;
+    builder.AddListeningPort(address, ::grpc::InsecureServerCredentials());
+    builder.RegisterService(&impl);
+    server = builder.BuildAndStart();
+  }
+
+  CompileCacheServiceImpl impl;
+  std::unique_ptr<::grpc::Server> server;
+};
+
+CompileCacheService::CompileCacheService(const std::string& address,
+                                         std::string path)
+    : impl_(new Impl(address, std::move(path))) {}
+
+CompileCacheService::~CompileCacheService() {}
+
+void CompileCacheService::Wait() { impl_->server->Wait(); }
+
+struct CompileCacheClient::Impl {
+  explicit Impl(const std::string& address) : address(address) {
+    channel =
+        ::grpc::CreateChannel(address, ::grpc::InsecureChannelCredentials());
+    stub = grpc::CompileCacheService::NewStub(channel);
+  }
+
+  std::shared_ptr<::grpc::Channel> channel;
+  std::unique_ptr<grpc::CompileCacheService::Stub> stub;
+  std::string address;
+};
+
+CompileCacheClient* CompileCacheClient::Get() {
+  static CompileCacheClient* client = []() -> CompileCacheClient* {
+    std::string address =
+        sys_util::GetEnvString("XLA_COMPILE_CACHE_SERVICE", "");
+    return !address.empty() ? new CompileCacheClient(address) : nullptr;
+  }();
+  return client;
+}
+
+CompileCacheClient::CompileCacheClient(const std::string& address)
+    : impl_(new Impl(address)) {}
+
+CompileCacheClient::~CompileCacheClient() {}
+
+const std::string& CompileCacheClient::address() const {
+  return impl_->address;
+}
+
+absl::optional<std::string> CompileCacheClient::Lookup(
+    const std::string& key) const {
+  static const int64_t timeout_ms =
+      sys_util::GetEnvInt("XLA_COMPILE_CACHE_SERVICE_TIMEOUT", 5000);
+  ::grpc::ClientContext context;
+  context.set_deadline(std::chrono::system_clock::now() +
+                       std::chrono::milliseconds(timeout_ms));
+  grpc::CompileCacheLookupRequest request;
+  grpc::CompileCacheLookupResponse response;
+  request.set_key(key);
+  ::grpc::Status status = impl_->stub->Lookup(&context, request, &response);
+  if (!status.ok()) {
+    TF_LOG(WARNING) << "Compile cache service " << impl_->address
+                    << " lookup failed: " << status.error_message() << " ("
+                    << static_cast<int>(status.error_code()) << ")";
+    XLA_COUNTER("CompileCacheServiceErrors", 1);
+    return absl::nullopt;
+  }
+  if (!response.has_computation()) {
+    XLA_COUNTER("CompileCacheServiceMiss", 1);
+    return absl::nullopt;
+  }
+  XLA_COUNTER("CompileCacheServiceHit", 1);
+  return std::move(*response.mutable_computation());
+}
+
+void CompileCacheClient::Store(std::string key, std::string data) const {
+  auto store = [this, key = std::move(key), data = std::move(data)]() {
+    ::grpc::ClientContext context;
+    grpc::CompileCacheStoreRequest request;
+    grpc::CompileCacheStoreResponse response;
+    request.set_key(key);
+    request.set_computation(data);
+    ::grpc::Status status = impl_->stub->Store(&context, request, &response);
+    if (!status.ok()) {
+      TF_LOG(WARNING) << "Compile cache service " << impl_->address
+                      << " store failed: " << status.error_message() << " ("
+                      << static_cast<int>(status.error_code()) << ")";
+      XLA_COUNTER("CompileCacheServiceErrors", 1);
+      return;
+    }
+    XLA_COUNTER("CompileCacheServiceStore", 1);
+  };
+  env::ScheduleIoClosure(std::move(store));
+}
+
+}  // namespace service
+}  // namespace xla
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef X10_XLA_CLIENT_COMPILE_CACHE_SERVICE_H_
+#define X10_XLA_CLIENT_COMPILE_CACHE_SERVICE_H_
+
+#include <memory>
+#include <string>
+
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/types.h"
+
+namespace xla {
+namespace service {
+
+// Reference implementation of the compile cache service, which a fleet of
+// processes shares to compile the same computations once. The entries are
+// opaque to the service, and kept in memory, or within the folder at path if
+// not empty, so that they survive restarts of the service.
+class CompileCacheService {
+  struct Impl;
+
+ public:
+  CompileCacheService(const std::string& address, std::string path);
+
+  ~CompileCacheService();
+
+  // Blocks until the service shuts down.
+  void Wait();
+
+ private:
+  std::unique_ptr<Impl> impl_;
+};
+
+class CompileCacheClient {
+  struct Impl;
+
+ public:
+  // Returns the client of the service at XLA_COMPILE_CACHE_SERVICE, or nullptr
+  // if the variable is not set.
+  static CompileCacheClient* Get();
+
+  const std::string& address() const;
+
+  // Returns the entry of the key, or nullopt if the service does not have it,
+  // or does not answer within XLA_COMPILE_CACHE_SERVICE_TIMEOUT milliseconds.
+  // Failures are logged and never thrown, as the caller can always compile the
+  // entry itself.
+  absl::optional<std::string> Lookup(const std::string& key) const;
+
+  // Stores the entry of the key in background.
+  void Store(std::string key, std::string data) const;
+
+ private:
+  explicit CompileCacheClient(const std::string& address);
+
+  ~CompileCacheClient();
+
+  std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace service
+}  // namespace xla
+
+#endif  // X10_XLA_CLIENT_COMPILE_CACHE_SERVICE_H_
@@ -25,8 +25,11 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/fake_computation_client.h"
 #include "tensorflow/compiler/xla/xla_client/mesh_service.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/xla/status_macros.h"
 #include "tensorflow/core/util/device_name_utils.h"
 
@@ -62,13 +65,16 @@ int64_t ComputationClient::GetDeviceOrdinal(const std::string& device) {
 
 ComputationClient* ComputationClient::Get() {
   static ComputationClient* computation_client =
-      ComputationClient::Create().release();
+      sys_util::GetEnvString("XLA_FAKE_CLIENT", "").empty()
+          ? ComputationClient::Create().release()
+          : new FakeComputationClient();
   return computation_client;
 }
 
 metrics::Metric* ComputationClient::TransferToServerMetric() {
   static metrics::Metric* metric =
-      new metrics::Metric("TransferToServerTime", metrics::MetricFnTime);
+      new metrics::Metric("TransferToServerTime", metrics::MetricFnTime,
+                          metrics::kDefaultMaxSamples, /*histogram=*/true);
   return metric;
 }
 
@@ -86,13 +92,15 @@ metrics::Metric* ComputationClient::TransferFromServerMetric() {
 
 metrics::Metric* ComputationClient::CompileMetric() {
   static metrics::Metric* metric =
-      new metrics::Metric("CompileTime", metrics::MetricFnTime);
+      new metrics::Metric("CompileTime", metrics::MetricFnTime,
+                          metrics::kDefaultMaxSamples, /*histogram=*/true);
   return metric;
 }
 
 metrics::Metric* ComputationClient::ExecuteMetric() {
   static metrics::Metric* metric =
-      new metrics::Metric("ExecuteTime", metrics::MetricFnTime);
+      new metrics::Metric("ExecuteTime", metrics::MetricFnTime,
+                          metrics::kDefaultMaxSamples, /*histogram=*/true);
   return metric;
 }
 
@@ -183,10 +191,76 @@ metrics::Metric* ComputationClient::OutboundDataMetric() {
   return metric;
 }
 
+metrics::Metric* ComputationClient::InboundCompressedDataMetric() {
+  static metrics::Metric* metric =
+      new metrics::Metric("InboundCompressedData", metrics::MetricFnBytes);
+  return metric;
+}
+
+metrics::Metric* ComputationClient::OutboundCompressedDataMetric() {
+  static metrics::Metric* metric =
+      new metrics::Metric("OutboundCompressedData", metrics::MetricFnBytes);
+  return metric;
+}
+
+XlaComputation ComputationClient::Computation::computation() const {
+  std::function<XlaComputation()> loader_fn;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!released_) {
+      return computation_;
+    }
+    loader_fn = loader_fn_;
+  }
+  if (loader_fn == nullptr) {
+    return XlaComputation();
+  }
+  // The reloaded HLO is not kept, as the release is meant to save its memory.
+  XLA_COUNTER("ReloadedComputations", 1);
+  return loader_fn();
+}
+
+hash_t ComputationClient::Computation::fingerprint() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (released_) {
+    return fingerprint_;
+  }
+  return util::Hash(computation_.proto().SerializeAsString());
+}
+
+size_t ComputationClient::Computation::computation_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (released_) {
+    return computation_bytes_;
+  }
+  return computation_.proto().ByteSizeLong();
+}
+
+void ComputationClient::Computation::ReleaseComputation(
+    std::function<XlaComputation()> loader_fn) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (released_) {
+    return;
+  }
+  fingerprint_ = util::Hash(computation_.proto().SerializeAsString());
+  computation_bytes_ = computation_.proto().ByteSizeLong();
+  XLA_COUNTER("ReleasedComputationBytes", computation_bytes_);
+  computation_ = XlaComputation();
+  loader_fn_ = std::move(loader_fn);
+  released_ = true;
+}
+
+bool ComputationClient::Computation::HasComputation() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return !released_ || loader_fn_ != nullptr;
+}
+
 int32_t ComputationClient::Device::mesh_id() const {
   TF_LOG(FATAL) << "Unsupported";
 }
 
+int32_t ComputationClient::Device::host_id() const { return 0; }
+
 std::vector<std::string> ComputationClient::GetAllDevices() const {
   std::vector<std::string> out;
   auto tmp = GetAllDevicePointers();
@@ -230,11 +304,74 @@ std::vector<Literal> ComputationClient::TransferFromServer(
   return transfer->TransferFromServerImpl(handles);
 }
 
+void ComputationClient::TransferFromServer(
+    absl::Span<const DataPtr> handles,
+    absl::Span<const MutableBorrowingLiteral> literals) {
+  XLA_CHECK_EQ(handles.size(), literals.size());
+  if (handles.empty()) return;
+  TransferManager* transfer = handles[0]->device()->GetTransferManager();
+  for (auto& handle : handles) {
+    XLA_CHECK_EQ(transfer, handle->device()->GetTransferManager());
+  }
+  transfer->TransferFromServerImpl(handles, literals);
+}
+
+std::future<std::vector<Literal>> ComputationClient::TransferFromServerAsync(
+    absl::Span<const DataPtr> handles) {
+  if (handles.empty()) {
+    std::promise<std::vector<Literal>> promise;
+    promise.set_value({});
+    return promise.get_future();
+  }
+  TransferManager* transfer = handles[0]->device()->GetTransferManager();
+  for (auto& handle : handles) {
+    XLA_CHECK_EQ(transfer, handle->device()->GetTransferManager());
+  }
+  return transfer->TransferFromServerAsyncImpl(
+      std::vector<DataPtr>(handles.begin(), handles.end()));
+}
+
+void ComputationClient::TransferManager::TransferFromServerImpl(
+    absl::Span<const DataPtr> handles,
+    absl::Span<const MutableBorrowingLiteral> literals) {
+  std::vector<Literal> values = TransferFromServerImpl(handles);
+  for (size_t i = 0; i < values.size(); ++i) {
+    // The literals come back in the device layout, and the copy relayouts
+    // them into the destination one.
+    MutableBorrowingLiteral literal = literals[i];
+    TF_CHECK_OK(literal.CopyFrom(values[i]));
+  }
+}
+
+std::future<std::vector<Literal>>
+ComputationClient::TransferManager::TransferFromServerAsyncImpl(
+    std::vector<DataPtr> handles) {
+  auto promise = std::make_shared<std::promise<std::vector<Literal>>>();
+  std::future<std::vector<Literal>> future = promise->get_future();
+  env::ScheduleIoClosure([this, promise, handles = std::move(handles)]() {
+    try {
+      promise->set_value(TransferFromServerImpl(handles));
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+  });
+  return future;
+}
+
 ComputationClient::DataPtr ComputationClient::Device::TransferToServer(
     xla::BorrowingLiteral literal, const xla::Shape& dest_shape) {
   TF_LOG(FATAL) << "Only supported for LocalClient";
 }
 
+ComputationClient::DataPtr ComputationClient::Device::CopyToDevice(
+    const DataPtr& data, Device* destination) {
+  return nullptr;
+}
+
+ComputationClient::MemoryInfo ComputationClient::Device::GetMemoryInfo() {
+  return MemoryInfo();
+}
+
 std::map<std::string, Metric> ComputationClient::ReadMetrics() {
   return Get()->GetMetrics();
 }
@@ -19,8 +19,11 @@
 
 #include <algorithm>
 #include <cmath>
+#include <functional>
+#include <future>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -43,6 +46,7 @@ class ComputationClient {
   struct TensorSource;
   struct ExecuteChainedOp;
   struct ExecuteComputationOptions;
+  struct MemoryInfo;
   class Data;
   using DataPtr = std::shared_ptr<Data>;
   using ComputationPtr = std::shared_ptr<Computation>;
@@ -53,6 +57,20 @@ class ComputationClient {
 
     virtual std::vector<Literal> TransferFromServerImpl(
         absl::Span<const DataPtr> handles) = 0;
+
+    // Writes the device data straight into the destination literals, whose
+    // shapes carry the host layout the data must be written with. The default
+    // implementation goes through the owning literals returned by the API
+    // above.
+    virtual void TransferFromServerImpl(
+        absl::Span<const DataPtr> handles,
+        absl::Span<const MutableBorrowingLiteral> literals);
+
+    // Starts reading the device data back, and returns a future which becomes
+    // ready once the literals have landed on the host. The default
+    // implementation runs the blocking API above on an IO thread.
+    virtual std::future<std::vector<Literal>> TransferFromServerAsyncImpl(
+        std::vector<DataPtr> handles);
   };
 
   class Device {
@@ -61,6 +79,9 @@ class ComputationClient {
 
     const std::string& name() const { return name_; }
     virtual int32_t mesh_id() const;
+    // Identifies the host the device is attached to. The devices of the same
+    // host talk to each other through faster links than across hosts.
+    virtual int32_t host_id() const;
     const swift_xla::Device& device_id() const { return device_id_; }
 
     virtual TransferManager* GetTransferManager() const = 0;
@@ -84,6 +105,14 @@ class ComputationClient {
     virtual DataPtr TransferToServer(xla::BorrowingLiteral literal,
                                      const xla::Shape& dest_shape);
 
+    // Copies the data, which lives on this device, straight to the
+    // destination device. Returns nullptr if there is no direct path between
+    // the two devices, in which case the caller goes through the host.
+    virtual DataPtr CopyToDevice(const DataPtr& data, Device* destination);
+
+    // Returns the memory usage of the device, as far as the backend knows it.
+    virtual MemoryInfo GetMemoryInfo();
+
     virtual std::vector<DataPtr> ExecuteChained(
         absl::Span<const ExecuteChainedOp> ops) = 0;
 
@@ -147,16 +176,38 @@ class ComputationClient {
 
     virtual ~Computation() {}
 
-    const XlaComputation& computation() const { return computation_; }
+    // Returns a copy of the HLO of the computation. Once released, the HLO
+    // gets reloaded through the loader function at every call, or is empty if
+    // there is none.
+    XlaComputation computation() const;
 
     const ProgramShape& program_shape() const { return program_shape_; }
 
     const std::vector<std::string>& devices() const { return devices_; }
 
+    // The hash of the serialized HLO, which survives its release.
+    hash_t fingerprint() const;
+
+    // The size of the serialized HLO, which survives its release.
+    size_t computation_bytes() const;
+
+    // Drops the host copy of the HLO, which the compiled computation does not
+    // need to run. Only the program shape and the fingerprint are kept. The
+    // loader_fn, if not null, regenerates the HLO for the debug dumps.
+    void ReleaseComputation(std::function<XlaComputation()> loader_fn);
+
+    // Whether computation() returns the HLO, either held or reloadable.
+    bool HasComputation() const;
+
    private:
+    mutable std::mutex mutex_;
     XlaComputation computation_;
     ProgramShape program_shape_;
     std::vector<std::string> devices_;
+    bool released_ = false;
+    std::function<XlaComputation()> loader_fn_;
+    hash_t fingerprint_ = 0;
+    size_t computation_bytes_ = 0;
   };
 
   // The TensorSource provides a way for a client to populate a buffer allocated
@@ -177,18 +228,49 @@ class ComputationClient {
 
   struct CompileInstance {
     CompileInstance() = default;
-    CompileInstance(XlaComputation computation, const Shape* output_shape)
-        : computation(std::move(computation)), output_shape(output_shape) {}
+    CompileInstance(XlaComputation computation, const Shape* output_shape,
+                    hash_t fingerprint = 0)
+        : computation(std::move(computation)),
+          output_shape(output_shape),
+          fingerprint(fingerprint) {}
 
     XlaComputation computation;
     const Shape* output_shape = nullptr;
+    // If not zero, uniquely identifies the computation (like the hash of the IR
+    // graph it was lowered from), so that the backends do not need to
+    // fingerprint its HLO.
+    hash_t fingerprint = 0;
+    // Set for computations carrying shardings, which the backends supporting
+    // it compile through the SPMD partitioner, with a partition per
+    // compilation device instead of a replica.
+    bool spmd_partitioned = false;
+    // Set for the first tier of the tiered compilation, which compiles with
+    // reduced optimization (see util::SetFastCompileOptions()) to have the
+    // computation run sooner, until an optimized one replaces it.
+    bool fast_compile = false;
   };
 
   struct ExecuteOptions {
     bool explode_tuple = true;
   };
 
-  struct ExecuteComputationOptions : public ExecuteOptions {};
+  // Device memory usage, in bytes. The values the backend cannot tell are -1.
+  struct MemoryInfo {
+    int64_t bytes_in_use = -1;
+    int64_t peak_bytes_in_use = -1;
+    int64_t bytes_limit = -1;
+    // Free memory which the device allocator holds on to for later use.
+    int64_t bytes_cached = 0;
+  };
+
+  // Priority of the computations on their device. The high priority ones,
+  // like latency critical inference graphs, get admitted ahead of the queued
+  // normal ones, at computation boundaries.
+  enum class ExecutePriority { kNormal, kHigh };
+
+  struct ExecuteComputationOptions : public ExecuteOptions {
+    ExecutePriority priority = ExecutePriority::kNormal;
+  };
 
   struct ExecuteReplicatedOptions : public ExecuteOptions {};
 
@@ -230,6 +312,19 @@ class ComputationClient {
   static std::vector<Literal> TransferFromServer(
       absl::Span<const DataPtr> handles);
 
+  // Same as above, but writes the values into caller owned memory, wrapped by
+  // the destination literals. There are no intermediate host copies when the
+  // device layout matches the destination one, otherwise the values get
+  // relayouted into the destinations.
+  static void TransferFromServer(
+      absl::Span<const DataPtr> handles,
+      absl::Span<const MutableBorrowingLiteral> literals);
+
+  // Same as the first API, but returns without waiting for the transfers,
+  // which complete in the background while the caller goes on.
+  static std::future<std::vector<Literal>> TransferFromServerAsync(
+      absl::Span<const DataPtr> handles);
+
   virtual std::string GetDefaultDevice() const = 0;
   static Device* DefaultDevice();
 
@@ -292,6 +387,10 @@ class ComputationClient {
   static metrics::Metric* ReleaseCompileHandlesTimeMetric();
   static metrics::Metric* InboundDataMetric();
   static metrics::Metric* OutboundDataMetric();
+  // The share of the inbound and outbound bytes which went through compressed
+  // channels.
+  static metrics::Metric* InboundCompressedDataMetric();
+  static metrics::Metric* OutboundCompressedDataMetric();
 
  protected:
   void AddDevice(std::unique_ptr<Device> device);
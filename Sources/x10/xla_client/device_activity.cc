@@ -0,0 +1,192 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/xla/xla_client/device_activity.h"
+
+#include <array>
+#include <map>
+#include <mutex>
+
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace xla {
+namespace device_activity {
+namespace {
+
+constexpr size_t kNumPhases = 4;
+
+using PhaseTimes = std::array<int64_t, kNumPhases>;
+
+struct DeviceState {
+  int64_t inflight = 0;
+  // The start of the current busy interval, while inflight is positive.
+  int64_t busy_start_ns = 0;
+  // The total time of the closed busy intervals.
+  int64_t busy_ns = 0;
+  // The busy time at the start of the step.
+  int64_t step_busy_ns = 0;
+  // The end of the last busy interval, and the phase times at that point.
+  int64_t idle_start_ns = -1;
+  PhaseTimes idle_start_phases = {};
+};
+
+// The state is shared by all the threads. The phases are coarse, and the
+// executions are at least as expensive as taking the lock, so a single lock
+// does not get in the way.
+class ActivityTracker {
+ public:
+  static ActivityTracker* Get() {
+    static ActivityTracker* tracker = new ActivityTracker();
+    return tracker;
+  }
+
+  void EnterPhase(HostPhase phase) {
+    std::lock_guard<std::mutex> lock(lock_);
+    ++phase_counts_[static_cast<size_t>(phase)];
+    UpdateCurrentPhase(sys_util::NowNs());
+  }
+
+  void ExitPhase(HostPhase phase) {
+    std::lock_guard<std::mutex> lock(lock_);
+    --phase_counts_[static_cast<size_t>(phase)];
+    UpdateCurrentPhase(sys_util::NowNs());
+  }
+
+  void ExecutionStarted(const std::string& device) {
+    std::lock_guard<std::mutex> lock(lock_);
+    int64_t now = sys_util::NowNs();
+    DeviceState& state = devices_[device];
+    if (state.inflight++ > 0) {
+      return;
+    }
+    state.busy_start_ns = now;
+    if (state.idle_start_ns < 0) {
+      return;
+    }
+    static metrics::Metric* gap_metric =
+        new metrics::Metric("DeviceIdleGapTime", metrics::MetricFnTime);
+    static metrics::Metric* phase_metrics[kNumPhases] = {
+        new metrics::Metric("DeviceIdleSwiftTime", metrics::MetricFnTime),
+        new metrics::Metric("DeviceIdleTraceTime", metrics::MetricFnTime),
+        new metrics::Metric("DeviceIdleTransferTime", metrics::MetricFnTime),
+        new metrics::Metric("DeviceIdleCompileTime", metrics::MetricFnTime)};
+    gap_metric->AddSample(now, now - state.idle_start_ns);
+    PhaseTimes phase_times = GetPhaseTimes(now);
+    for (size_t i = 0; i < kNumPhases; ++i) {
+      int64_t phase_ns = phase_times[i] - state.idle_start_phases[i];
+      if (phase_ns > 0) {
+        phase_metrics[i]->AddSample(now, phase_ns);
+      }
+    }
+  }
+
+  void ExecutionFinished(const std::string& device) {
+    static metrics::Metric* busy_metric =
+        new metrics::Metric("DeviceBusyTime", metrics::MetricFnTime);
+    std::lock_guard<std::mutex> lock(lock_);
+    int64_t now = sys_util::NowNs();
+    DeviceState& state = devices_[device];
+    if (--state.inflight > 0) {
+      return;
+    }
+    busy_metric->AddSample(now, now - state.busy_start_ns);
+    state.busy_ns += now - state.busy_start_ns;
+    state.idle_start_ns = now;
+    state.idle_start_phases = GetPhaseTimes(now);
+  }
+
+  void RecordStep() {
+    static metrics::Metric* utilization_metric =
+        new metrics::Metric("DeviceUtilization", metrics::MetricFnValue);
+    std::lock_guard<std::mutex> lock(lock_);
+    int64_t now = sys_util::NowNs();
+    int64_t step_ns = now - step_start_ns_;
+    step_start_ns_ = now;
+    if (devices_.empty() || step_ns <= 0) {
+      return;
+    }
+    double utilization = 0.0;
+    for (auto& device_state : devices_) {
+      DeviceState& state = device_state.second;
+      int64_t busy_ns = state.busy_ns;
+      if (state.inflight > 0) {
+        busy_ns += now - state.busy_start_ns;
+      }
+      utilization += static_cast<double>(busy_ns - state.step_busy_ns);
+      state.step_busy_ns = busy_ns;
+    }
+    utilization_metric->AddSample(
+        now, 100.0 * utilization / (step_ns * devices_.size()));
+  }
+
+ private:
+  ActivityTracker() : current_start_ns_(sys_util::NowNs()) {
+    step_start_ns_ = current_start_ns_;
+  }
+
+  void UpdateCurrentPhase(int64_t now) {
+    size_t current = 0;
+    for (size_t i = kNumPhases - 1; i > 0; --i) {
+      if (phase_counts_[i] > 0) {
+        current = i;
+        break;
+      }
+    }
+    if (current != current_phase_) {
+      phase_ns_[current_phase_] += now - current_start_ns_;
+      current_phase_ = current;
+      current_start_ns_ = now;
+    }
+  }
+
+  // Returns the time spent in each phase so far, with the time of the current
+  // one up to now.
+  PhaseTimes GetPhaseTimes(int64_t now) const {
+    PhaseTimes phase_times = phase_ns_;
+    phase_times[current_phase_] += now - current_start_ns_;
+    return phase_times;
+  }
+
+  std::mutex lock_;
+  std::array<int64_t, kNumPhases> phase_counts_ = {};
+  PhaseTimes phase_ns_ = {};
+  size_t current_phase_ = 0;
+  int64_t current_start_ns_ = 0;
+  int64_t step_start_ns_ = 0;
+  std::map<std::string, DeviceState> devices_;
+};
+
+}  // namespace
+
+ScopedHostPhase::ScopedHostPhase(HostPhase phase) : phase_(phase) {
+  ActivityTracker::Get()->EnterPhase(phase_);
+}
+
+ScopedHostPhase::~ScopedHostPhase() {
+  ActivityTracker::Get()->ExitPhase(phase_);
+}
+
+void ExecutionStarted(const std::string& device) {
+  ActivityTracker::Get()->ExecutionStarted(device);
+}
+
+void ExecutionFinished(const std::string& device) {
+  ActivityTracker::Get()->ExecutionFinished(device);
+}
+
+void RecordStep() { ActivityTracker::Get()->RecordStep(); }
+
+}  // namespace device_activity
+}  // namespace xla
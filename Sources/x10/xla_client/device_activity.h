@@ -0,0 +1,78 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef X10_XLA_CLIENT_DEVICE_ACTIVITY_H_
+#define X10_XLA_CLIENT_DEVICE_ACTIVITY_H_
+
+#include <string>
+
+#include "tensorflow/compiler/xla/types.h"
+
+namespace xla {
+namespace device_activity {
+
+// Tracks when the devices are running computations, to tell whether a job is
+// host bound. The idle gaps between the end of the last running computation
+// of a device and the start of its next one get recorded into the
+// DeviceIdleGapTime metric, and split into the DeviceIdle<Phase>Time metrics
+// after the host phase which was running meanwhile. The busy intervals go
+// into the DeviceBusyTime metric, and RecordStep() turns them into the
+// DeviceUtilization percentage of the step.
+
+// The phases of the host work. When several are running at once, the time
+// goes to the last listed one. kSwift stands for the time out of any other
+// phase, the one spent running the user code and recording the IR graphs.
+enum class HostPhase { kSwift, kTrace, kTransfer, kCompile };
+
+// Marks the given phase as running for the lifetime of the object, from any
+// thread.
+class ScopedHostPhase {
+ public:
+  explicit ScopedHostPhase(HostPhase phase);
+  ~ScopedHostPhase();
+
+ private:
+  HostPhase phase_;
+};
+
+// Records that a computation started running on device.
+void ExecutionStarted(const std::string& device);
+
+// Records that a computation which was running on device completed.
+void ExecutionFinished(const std::string& device);
+
+// Records a computation as running on device for the lifetime of the object.
+class ScopedExecution {
+ public:
+  explicit ScopedExecution(std::string device) : device_(std::move(device)) {
+    ExecutionStarted(device_);
+  }
+
+  ~ScopedExecution() { ExecutionFinished(device_); }
+
+ private:
+  std::string device_;
+};
+
+// Ends a step, posting to the DeviceUtilization metric the share of the step
+// time, in percents, during which the devices were running computations,
+// averaged over the devices which ran any so far.
+void RecordStep();
+
+}  // namespace device_activity
+}  // namespace xla
+
+#endif  // X10_XLA_CLIENT_DEVICE_ACTIVITY_H_
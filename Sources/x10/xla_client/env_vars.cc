@@ -13,6 +13,7 @@ const char* const kEnvWorkers = "XRT_WORKERS";
 const char* const kEnvMeshService = "XRT_MESH_SERVICE_ADDRESS";
 const char* const kEnvWorldSize = "XRT_SHARD_WORLD_SIZE";
 const char* const kEnvMpDevice = "XRT_MULTI_PROCESSING_DEVICE";
+const char* const kEnvHostOrdinal = "XRT_HOST_ORDINAL";
 
 }  // namespace env
 }  // namespace xla
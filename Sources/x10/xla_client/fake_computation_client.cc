@@ -14,28 +14,30 @@
 
 #include "tensorflow/compiler/xla/xla_client/fake_computation_client.h"
 
-#include <tuple>
+#include <vector>
 
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
-#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
-#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
-#include "tensorflow/compiler/xla/xla_client/util.h"
-#include "tensorflow/compiler/xla/service/platform_util.h"
-#include "tensorflow/core/profiler/lib/traceme.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 
 namespace xla {
 
+using DataPtr = ComputationClient::DataPtr;
+using ComputationPtr = ComputationClient::ComputationPtr;
+
 class FakeComputationClient::FakeData : public ComputationClient::Data {
  public:
   using Data::Data;
 
-  virtual OpaqueHandle GetOpaqueHandle() {
+  OpaqueHandle GetOpaqueHandle() override {
     return reinterpret_cast<intptr_t>(this);
   }
 
-  virtual void Assign(const Data& data) {}
-  virtual bool HasValue() const { return true; }
+  void Assign(const Data& data) override {}
+
+  bool HasValue() const override { return true; }
 };
 
 struct FakeComputationClient::FakeComputation
@@ -43,98 +45,119 @@ struct FakeComputationClient::FakeComputation
   using Computation::Computation;
 };
 
-using DataPtr = ComputationClient::DataPtr;
-using ComputationPtr = ComputationClient::ComputationPtr;
-
-DataPtr FakeComputationClient::CreateDataPlaceholder(std::string device,
-                                                     Shape shape) {
-  return std::make_shared<FakeData>(device, shape);
-}
-
-ComputationClient::DataPtr FakeComputationClient::TransferToServer(
-    xla::BorrowingLiteral literal, const xla::Shape& dest_shape,
-    const std::string& device) {
-  return CreateDataPlaceholder(device, dest_shape);
-}
-
-std::vector<DataPtr> FakeComputationClient::TransferToServer(
-    absl::Span<const TensorSource> tensors) {
-  tensorflow::profiler::TraceMe trace("TransferToServer");
-  std::vector<DataPtr> out;
-  for (const auto& tensor : tensors) {
-    out.push_back(CreateDataPlaceholder(tensor.device, tensor.shape));
-  }
-  return out;
-}
-
-std::vector<Literal> FakeComputationClient::TransferFromServer(
-    absl::Span<const DataPtr> handles) {
-  tensorflow::profiler::TraceMe trace("TransferFromServer");
-  std::vector<Literal> out;
-  for (const auto& handle : handles) {
-    out.push_back(xla::Literal(handle->shape()));
+class FakeComputationClient::FakeDevice : public ComputationClient::Device {
+ public:
+  FakeDevice(std::string name, FakeComputationClient* client)
+      : Device(std::move(name)), client_(client) {}
+
+  TransferManager* GetTransferManager() const override { return client_; }
+
+  std::vector<ComputationPtr> Compile(
+      const std::vector<std::string>& devices,
+      std::vector<CompileInstance> instances) override {
+    metrics::TimedSection timed(CompileMetric());
+    std::vector<ComputationPtr> out;
+    for (auto& instance : instances) {
+      ProgramShape program_shape =
+          ConsumeValue(instance.computation.GetProgramShape());
+      if (instance.output_shape != nullptr) {
+        *program_shape.mutable_result() = *instance.output_shape;
+      }
+      out.push_back(std::make_shared<FakeComputation>(
+          std::move(instance.computation), std::move(program_shape), devices));
+    }
+    return out;
   }
-  return out;
-}
 
-std::vector<ComputationPtr> FakeComputationClient::Compile(
-    std::vector<CompileInstance> instances) {
-  metrics::TimedSection timed(CompileMetric());
-  std::vector<ComputationPtr> out;
-  for (auto& instance : instances) {
-    auto program_shape =
-        xla::ProgramShape(instance.computation.GetProgramShape().ValueOrDie());
-    out.push_back(std::shared_ptr<FakeComputation>(
-        new FakeComputation(std::move(instance.computation),
-                            std::move(program_shape), instance.devices)));
+  std::vector<DataPtr> TransferToServer(
+      absl::Span<const TensorSource> tensors) override {
+    metrics::TimedSection timed(TransferToServerMetric());
+    std::vector<DataPtr> out;
+    for (const TensorSource& tensor : tensors) {
+      // Populating the source still runs the host conversions of the upload.
+      std::vector<char> buffer(ShapeUtil::ByteSizeOf(tensor.shape));
+      tensor.populate_fn(tensor, buffer.data(), buffer.size());
+      out.push_back(CreateDataPlaceholder(tensor.shape));
+    }
+    return out;
   }
-  return out;
-}
 
-std::vector<DataPtr> FakeComputationClient::ExecuteComputation(
-    const Computation& computation, absl::Span<const DataPtr> arguments,
-    const std::string& device, const ExecuteComputationOptions& options) {
-  std::vector<DataPtr> out;
-  for (const auto& shape :
-       computation.program_shape().result().tuple_shapes()) {
-    out.push_back(CreateDataPlaceholder(device, shape));
+  std::vector<DataPtr> ExecuteChained(
+      absl::Span<const ExecuteChainedOp> ops) override {
+    std::vector<std::vector<DataPtr>> ops_outputs(ops.size());
+    size_t num_results = 0;
+    for (size_t i = 0; i < ops.size(); ++i) {
+      const ExecuteChainedOp& op = ops[i];
+      ops_outputs[i] = op.device_data != nullptr
+                           ? std::vector<DataPtr>{op.device_data}
+                           : ExecuteComputation(*op.computation, {},
+                                                ExecuteComputationOptions());
+      for (const auto& output : op.outputs) {
+        num_results = std::max(num_results, output.result_index + 1);
+      }
+    }
+    std::vector<DataPtr> results(num_results);
+    for (size_t i = 0; i < ops.size(); ++i) {
+      for (const auto& output : ops[i].outputs) {
+        results[output.result_index] =
+            ops_outputs[i][output.output_index.value_or(0)];
+      }
+    }
+    return results;
   }
-  return out;
-}
 
-std::vector<std::vector<DataPtr>> FakeComputationClient::ExecuteReplicated(
-    const Computation& computation,
-    const std::vector<std::vector<DataPtr>>& arguments,
-    absl::Span<const std::string> devices,
-    const ExecuteReplicatedOptions& options) {
-  TF_LOG(FATAL) << "Implement";
-}
+  std::string ResourceDomain() const override { return "FakeDomain"; }
 
-std::vector<std::vector<DataPtr>> FakeComputationClient::ExecuteParallel(
-    absl::Span<const Computation* const> computations,
-    const std::vector<std::vector<DataPtr>>& arguments,
-    absl::Span<const std::string> devices,
-    const ExecuteParallelOptions& options) {
-  TF_LOG(FATAL) << "Implement";
-}
+  DataPtr CreateDataPlaceholder(Shape shape) override {
+    return std::make_shared<FakeData>(this, std::move(shape));
+  }
 
-std::vector<DataPtr> FakeComputationClient::ExecuteChained(
-    absl::Span<const ExecuteChainedOp> ops, const std::string& device) {
-  TF_LOG(FATAL) << "Implement";
-}
+  std::vector<DataPtr> ExecuteComputation(
+      const Computation& computation, absl::Span<const DataPtr> arguments,
+      const ExecuteComputationOptions& options) override {
+    metrics::TimedSection timed(ExecuteMetric());
+    const Shape& result_shape = computation.program_shape().result();
+    std::vector<DataPtr> out;
+    if (result_shape.IsTuple() && options.explode_tuple) {
+      for (const Shape& shape : result_shape.tuple_shapes()) {
+        out.push_back(CreateDataPlaceholder(shape));
+      }
+    } else {
+      out.push_back(CreateDataPlaceholder(result_shape));
+    }
+    return out;
+  }
 
-std::vector<std::vector<DataPtr>> FakeComputationClient::DeconstructTuple(
-    absl::Span<const DataPtr> tuples) {
-  TF_LOG(FATAL) << "Implement";
-}
+ private:
+  FakeComputationClient* client_;
+};
 
-std::map<std::string, Metric> FakeComputationClient::GetMetrics() const {
-  TF_LOG(FATAL) << "Implement";
+FakeComputationClient::FakeComputationClient() {
+  // The devices are given as <kind>:<count>, like TPU:8, besides the CPU:0
+  // device which is always there.
+  std::string spec = sys_util::GetEnvString("XLA_FAKE_CLIENT", "CPU:1");
+  std::vector<std::string> parts = absl::StrSplit(spec, ':');
+  XLA_CHECK_EQ(parts.size(), 2) << "Invalid XLA_FAKE_CLIENT: " << spec;
+  int64_t count = std::stoll(parts[1]);
+  XLA_CHECK_GT(count, 0) << "Invalid XLA_FAKE_CLIENT: " << spec;
+  if (parts[0] != "CPU") {
+    AddDevice(std::make_unique<FakeDevice>("CPU:0", this));
+  }
+  for (int64_t i = 0; i < count; ++i) {
+    AddDevice(
+        std::make_unique<FakeDevice>(absl::StrCat(parts[0], ":", i), this));
+  }
+  default_device_ = absl::StrCat(parts[0], ":0");
 }
 
-std::string FakeComputationClient::GetResourceDomain(
-    const std::string& device) const {
-  return "NopDomain";
+std::vector<Literal> FakeComputationClient::TransferFromServerImpl(
+    absl::Span<const DataPtr> handles) {
+  metrics::TimedSection timed(TransferFromServerMetric());
+  std::vector<Literal> out;
+  for (const DataPtr& handle : handles) {
+    out.push_back(Literal::CreateFromShape(handle->shape()));
+  }
+  return out;
 }
 
 std::string FakeComputationClient::GetDefaultDevice() const {
@@ -142,53 +165,7 @@ std::string FakeComputationClient::GetDefaultDevice() const {
 }
 
 swift_xla::Device FakeComputationClient::GetDefaultDeviceStruct() const {
-  return swift_xla::Device(swift_xla::DeviceType::CPU, 0);
+  return swift_xla::Device(default_device_);
 }
 
-size_t FakeComputationClient::GetNumDevices() const {
-  return device_names_.size();
-}
-
-std::vector<std::string> FakeComputationClient::GetLocalDevices() const {
-  TF_LOG(FATAL) << "Implement";
-}
-
-std::vector<std::string> FakeComputationClient::GetAllDevices() const {
-  return device_names_;
-  ;
-}
-
-void FakeComputationClient::SetReplicationDevices(
-    std::vector<std::string> devices) {
-  TF_LOG(FATAL) << "Implement";
-}
-
-const std::vector<std::string>& FakeComputationClient::GetReplicationDevices()
-    const {
-  static std::vector<std::string>* replicated_devices =
-      new std::vector<std::string>;
-  return *replicated_devices;
-}
-
-void FakeComputationClient::SetRngSeed(size_t seed) {
-  TF_LOG(FATAL) << "Implement";
-}
-
-FakeComputationClient::FakeComputationClient() {
-  for (int i = 0; i < 1; ++i) {
-    device_names_.push_back(absl::StrCat("CPU:", i));
-  }
-  for (int i = 0; i < 16; ++i) {
-    device_names_.push_back(absl::StrCat("TPU:", i));
-  }
-}
-
-std::unique_ptr<ComputationClient> ComputationClient::Create() {
-  return std::make_unique<FakeComputationClient>();
-}
-
-FakeComputationClient::~FakeComputationClient() {}
-
-bool ComputationClient::IsLocal() { return true; }
-
 }  // namespace xla
@@ -17,80 +17,43 @@
 #ifndef X10_XLA_CLIENT_FAKE_COMPUTATION_CLIENT_H_
 #define X10_XLA_CLIENT_FAKE_COMPUTATION_CLIENT_H_
 
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "tensorflow/compiler/xla/xla_client/computation_client.h"
-#include "tensorflow/compiler/xla/client/client_library.h"
 
 namespace xla {
 
-class FakeComputationClient : public ComputationClient {
+// A client whose devices do not compute anything. The computations get
+// compiled into their program shapes only, their executions return data of the
+// result shapes, and the data transferred back is zeros. Running a model over
+// it measures the host side costs of the steps (tracing, hashing, lowering,
+// cache lookups and the Swift to C boundary) without the device time, on any
+// machine. Selected by setting XLA_FAKE_CLIENT.
+class FakeComputationClient : public ComputationClient,
+                              public ComputationClient::TransferManager {
  public:
+  class FakeDevice;
   class FakeData;
   struct FakeComputation;
 
   FakeComputationClient();
-  ~FakeComputationClient();
-
-  DataPtr CreateDataPlaceholder(std::string device, Shape shape) override;
-
-  std::vector<DataPtr> TransferToServer(
-      absl::Span<const TensorSource> tensors) override;
-
-  DataPtr TransferToServer(xla::BorrowingLiteral literal,
-                           const xla::Shape& dest_shape,
-                           const std::string& device_string) override;
 
-  std::vector<Literal> TransferFromServer(
+  std::vector<Literal> TransferFromServerImpl(
       absl::Span<const DataPtr> handles) override;
 
-  std::vector<ComputationPtr> Compile(
-      std::vector<CompileInstance> instances) override;
-
-  std::vector<DataPtr> ExecuteComputation(
-      const Computation& computation, absl::Span<const DataPtr> arguments,
-      const std::string& device,
-      const ExecuteComputationOptions& options) override;
-
-  std::vector<std::vector<DataPtr>> ExecuteReplicated(
-      const Computation& computation,
-      const std::vector<std::vector<DataPtr>>& arguments,
-      absl::Span<const std::string> devices,
-      const ExecuteReplicatedOptions& options) override;
-
-  std::vector<std::vector<DataPtr>> ExecuteParallel(
-      absl::Span<const Computation* const> computations,
-      const std::vector<std::vector<DataPtr>>& arguments,
-      absl::Span<const std::string> devices,
-      const ExecuteParallelOptions& options) override;
-
-  std::vector<DataPtr> ExecuteChained(absl::Span<const ExecuteChainedOp> ops,
-                                      const std::string& device) override;
-
-  std::vector<std::vector<DataPtr>> DeconstructTuple(
-      absl::Span<const DataPtr> tuples) override;
-
-  std::string GetResourceDomain(const std::string& device) const override;
-
   std::string GetDefaultDevice() const override;
 
   swift_xla::Device GetDefaultDeviceStruct() const override;
 
-  size_t GetNumDevices() const override;
-
-  std::map<std::string, Metric> GetMetrics() const override;
-
-  std::vector<std::string> GetLocalDevices() const override;
-
-  std::vector<std::string> GetAllDevices() const override;
-
-  void SetReplicationDevices(std::vector<std::string> devices) override;
-
-  const std::vector<std::string>& GetReplicationDevices() const override;
+  void SetRngSeed(size_t seed) override {}
 
-  void SetRngSeed(size_t seed) override;
+  std::map<std::string, Metric> GetMetrics() const override { return {}; }
 
  private:
-  std::string default_device_ = "CPU:0";
-  std::vector<std::string> device_names_;
+  std::string default_device_;
 };
 
 }  // namespace xla
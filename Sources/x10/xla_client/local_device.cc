@@ -1,15 +1,28 @@
 #include "tensorflow/compiler/xla/xla_client/local_device.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <future>
+#include <map>
 #include <tuple>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/container/node_hash_map.h"
-#include "absl/container/node_hash_set.h"
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "tensorflow/compiler/xla/xla_client/caching_allocator.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/device_activity.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+#include "tensorflow/compiler/xla/xla_client/trace_recorder.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/xla/xla_client/xla_util.h"
+#include "tensorflow/compiler/xla/executable_run_options.h"
 #include "tensorflow/compiler/xla/service/platform_util.h"
 #include "tensorflow/core/profiler/lib/traceme.h"
 
@@ -25,9 +38,21 @@ using TensorSource = ComputationClient::TensorSource;
 using CompileInstance = ComputationClient::CompileInstance;
 using Computation = ComputationClient::Computation;
 using ExecuteComputationOptions = ComputationClient::ExecuteComputationOptions;
+using ExecutePriority = ComputationClient::ExecutePriority;
+using MemoryInfo = ComputationClient::MemoryInfo;
 
 namespace {
 
+// Reports a section of code both to the TF profiler and to the trace recorder.
+class TraceSection {
+ public:
+  explicit TraceSection(absl::string_view name) : trace_(name), event_(name) {}
+
+ private:
+  tensorflow::profiler::TraceMe trace_;
+  trace::ScopedEvent event_;
+};
+
 std::unique_ptr<xla::DeviceAssignment> GetAssignment(
     const std::vector<std::string>& devices) {
   std::unique_ptr<xla::DeviceAssignment> assignment;
@@ -40,26 +65,49 @@ std::unique_ptr<xla::DeviceAssignment> GetAssignment(
   return assignment;
 }
 
+// Same as above, for SPMD computations, which run as one replica split into a
+// partition per device.
+std::unique_ptr<xla::DeviceAssignment> GetPartitionAssignment(
+    const std::vector<std::string>& devices) {
+  auto assignment = std::make_unique<xla::DeviceAssignment>(1, devices.size());
+  for (size_t i = 0; i < devices.size(); ++i) {
+    (*assignment)(0, i) = GetX10Device(devices[i])->mesh_id();
+  }
+  return assignment;
+}
+
 // Dedup multiple computations going on at the same time. This is needed
 // because multiple identical compilations running in parallel cost more
 // than just one compilation.
 // TODO(parkers): This deduping would happen best unified with the
 // higher level cache.
 struct ConcurrentCompileDedupping {
+  // The computations are keyed by fingerprint, either given by the caller or
+  // hashed from the HLO, rather than by their serialized HLO, which can be
+  // hundreds of megabytes. The HLO of the computations with the same hashed
+  // fingerprint is still compared, to rule out collisions.
   struct Key {
     const xla::LocalClient* client;
     std::string result_layout;
-    std::string computation;
+    hash_t fingerprint;
+    bool hlo_fingerprint;
     int64_t num_replicas;
-    size_t hash = ComputeHash();
-    size_t ComputeHash() const {
-      util::PartialHasher<std::string, 4096> hasher;
-      return hasher(computation);
-    }
+    int64_t num_partitions;
+    bool fast_compile;
+    const XlaComputation* computation;
+    size_t hash = util::HashReduce(fingerprint);
     bool operator==(const Key& other) const {
-      return computation == other.computation &&
-             result_layout == other.result_layout &&
-             num_replicas == other.num_replicas && client == other.client;
+      if (fingerprint != other.fingerprint ||
+          hlo_fingerprint != other.hlo_fingerprint ||
+          result_layout != other.result_layout ||
+          num_replicas != other.num_replicas ||
+          num_partitions != other.num_partitions ||
+          fast_compile != other.fast_compile || client != other.client) {
+        return false;
+      }
+      return !hlo_fingerprint || computation == other.computation ||
+             computation->proto().SerializeAsString() ==
+                 other.computation->proto().SerializeAsString();
     }
   };
   struct Hasher {
@@ -117,12 +165,146 @@ std::vector<const xla::Shape*> ArgumentLayoutAsPointers(
   return argument_layout_ptrs;
 }
 
+bool UseCachingAllocator() {
+  static const bool caching_allocator =
+      sys_util::GetEnvBool("XLA_CACHING_DEVICE_ALLOCATOR", false);
+  return caching_allocator;
+}
+
+bool UseAsyncTransfers() {
+  static const bool async_transfers =
+      sys_util::GetEnvBool("XLA_ASYNC_TRANSFER_TO_DEVICE", false);
+  return async_transfers;
+}
+
+// Whether the computations on the CPU backend run asynchronously on the host
+// stream, like on the other devices, instead of blocking their caller.
+bool UseAsyncCpuExecution() {
+  static const bool async_execution =
+      sys_util::GetEnvBool("XLA_CPU_ASYNC_EXECUTION", true);
+  return async_execution;
+}
+
+int64_t GetMaxComputationSlots() {
+  static const int64_t max_slots =
+      std::max<int64_t>(sys_util::GetEnvInt("XLA_COMPUTATION_SLOTS", 64), 1);
+  return max_slots;
+}
+
+// Number of streams the computations of a local device get spread over. The
+// computations which do not depend on each other run concurrently when they
+// land on different streams.
+int GetNumComputeStreams() {
+  static const int num_streams =
+      std::max<int>(sys_util::GetEnvInt("XLA_COMPUTE_STREAMS", 1), 1);
+  return num_streams;
+}
+
+// Number of computation slots only the high priority computations can take, so
+// that a queue full of normal ones never holds them back.
+int64_t GetHighPrioritySlots() {
+  static const int64_t high_priority_slots =
+      std::max<int64_t>(sys_util::GetEnvInt("XLA_HIGH_PRIORITY_SLOTS", 0), 0);
+  return high_priority_slots;
+}
+
+// Whether local GPU devices get an extra compute stream reserved to the high
+// priority computations, which then do not queue behind the kernels of the
+// normal ones.
+bool UseHighPriorityStream() {
+  static const bool high_priority_stream =
+      sys_util::GetEnvBool("XLA_HIGH_PRIORITY_STREAM", false);
+  return high_priority_stream;
+}
+
+// Fraction of the device memory which, when no longer available, starts
+// shrinking the window of in-flight computations. Zero disables the throttling.
+double GetComputationSlotsFreeMemory() {
+  static const double free_fraction =
+      sys_util::GetEnvDouble("XLA_COMPUTATION_SLOTS_FREE_MEMORY", 0.1);
+  return free_fraction;
+}
+
+// Pool of page-locked host buffers used to stage the host to device transfers,
+// so that the copies can run asynchronously on the device stream. Buffers are
+// bucketed by power of two sizes, and reused across transfers.
+class PinnedStagingPool {
+ public:
+  struct Buffer {
+    void* ptr = nullptr;
+    size_t size = 0;
+  };
+
+  explicit PinnedStagingPool(se::StreamExecutor* executor)
+      : executor_(executor) {}
+
+  Buffer Acquire(size_t size) {
+    size_t bucket_size = GetBucketSize(size);
+    {
+      absl::MutexLock lock(&mutex_);
+      auto& free_buffers = free_buffers_[bucket_size];
+      if (!free_buffers.empty()) {
+        void* ptr = free_buffers.back();
+        free_buffers.pop_back();
+        cached_bytes_ -= bucket_size;
+        return {ptr, bucket_size};
+      }
+    }
+    void* ptr = executor_->HostMemoryAllocate(bucket_size);
+    XLA_CHECK(ptr != nullptr)
+        << "Unable to allocate " << bucket_size << " bytes of pinned memory";
+    XLA_COUNTER("PinnedStagingAlloc", 1);
+    return {ptr, bucket_size};
+  }
+
+  void Release(Buffer buffer) {
+    static const size_t kMaxCachedBytes = sys_util::GetEnvInt(
+        "XLA_PINNED_STAGING_POOL_SIZE", 1024L * 1024L * 1024L);
+    {
+      absl::MutexLock lock(&mutex_);
+      if (cached_bytes_ + buffer.size <= kMaxCachedBytes) {
+        free_buffers_[buffer.size].push_back(buffer.ptr);
+        cached_bytes_ += buffer.size;
+        return;
+      }
+    }
+    executor_->HostMemoryDeallocate(buffer.ptr);
+  }
+
+ private:
+  static size_t GetBucketSize(size_t size) {
+    size_t bucket_size = 4096;
+    while (bucket_size < size) {
+      bucket_size *= 2;
+    }
+    return bucket_size;
+  }
+
+  se::StreamExecutor* executor_;
+  absl::Mutex mutex_;
+  std::map<size_t, std::vector<void*>> free_buffers_ ABSL_GUARDED_BY(mutex_);
+  size_t cached_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
 }  // namespace
 
 class LocalTransferManager : public ComputationClient::TransferManager {
  public:
   std::vector<Literal> TransferFromServerImpl(
       absl::Span<const DataPtr> handles) override;
+
+  void TransferFromServerImpl(
+      absl::Span<const DataPtr> handles,
+      absl::Span<const MutableBorrowingLiteral> literals) override;
+
+  // Copies the array buffers into pinned host buffers on the dedicated
+  // transfer stream of their devices, ordered after the computations queued so
+  // far, and fulfills the future from the host callbacks of the streams.
+  std::future<std::vector<Literal>> TransferFromServerAsyncImpl(
+      std::vector<DataPtr> handles) override;
+
+ private:
+  static void WaitForComputations(absl::Span<const DataPtr> handles);
 };
 
 class LocalDevice : public ComputationClient::Device {
@@ -137,48 +319,204 @@ class LocalDevice : public ComputationClient::Device {
         stream_(std::make_unique<se::Stream>(
             client->backend().stream_executor(device_ordinal).ValueOrDie())),
         transfer_from_device_stream_(std::make_unique<se::Stream>(
-            client->backend().stream_executor(device_ordinal).ValueOrDie())) {
+            client->backend().stream_executor(device_ordinal).ValueOrDie())),
+        staging_pool_(
+            client->backend().stream_executor(device_ordinal).ValueOrDie()) {
     stream_->Init();
     transfer_from_device_stream_->Init();
+    if (!is_cpu) {
+      for (int i = 1; i < GetNumComputeStreams(); ++i) {
+        extra_compute_streams_.push_back(std::make_unique<se::Stream>(
+            client->backend().stream_executor(device_ordinal).ValueOrDie()));
+        extra_compute_streams_.back()->Init();
+      }
+      if (UseHighPriorityStream()) {
+        extra_compute_streams_.push_back(std::make_unique<se::Stream>(
+            client->backend().stream_executor(device_ordinal).ValueOrDie()));
+        extra_compute_streams_.back()->Init();
+        high_priority_stream_index_ = num_compute_streams() - 1;
+      }
+    }
+    stream_loads_.resize(num_compute_streams(), 0);
+    // With several compute streams, the temporary buffers an executable frees
+    // right after enqueuing its kernels could go to a computation on another
+    // stream while still in use, so the allocations go through the caching
+    // allocator, which holds the freed blocks until all the streams catch up.
+    if (!is_cpu && (UseCachingAllocator() || num_compute_streams() > 1)) {
+      caching_allocator_ = std::make_unique<CachingDeviceAllocator>(
+          client->backend().memory_allocator());
+      if (num_compute_streams() > 1) {
+        std::vector<se::Stream*> streams;
+        for (int i = 0; i < num_compute_streams(); ++i) {
+          streams.push_back(compute_stream(i));
+        }
+        caching_allocator_->SetStreams(std::move(streams));
+      }
+    }
   }
 
   xla::LocalClient* client() const { return client_; }
   int device_ordinal() const { return device_ordinal_; }
   int32_t mesh_id() const final { return mesh_id_; }
   se::Stream* stream() const { return stream_.get(); }
+  // The stream at index zero is stream(), the one the transfers go through.
+  se::Stream* compute_stream(int index) const {
+    return index == 0 ? stream_.get() : extra_compute_streams_[index - 1].get();
+  }
+  int num_compute_streams() const {
+    return 1 + static_cast<int>(extra_compute_streams_.size());
+  }
   se::Stream* transfer_from_device_stream() const {
     return transfer_from_device_stream_.get();
   }
   bool is_cpu() const { return is_cpu_; }
+  PinnedStagingPool* staging_pool() { return &staging_pool_; }
+  // Allocator to be used for all the device buffers of this device.
+  se::DeviceMemoryAllocator* allocator() const {
+    if (caching_allocator_ != nullptr) {
+      return caching_allocator_.get();
+    }
+    return client_->backend().memory_allocator();
+  }
   TransferManager* GetTransferManager() const override {
     static LocalTransferManager local_transfer;
     return &local_transfer;
   }
   virtual bool IsLocal() { return true; }
 
-  int64_t RunAsyncStart() {
+  // Waits for a computation slot and returns the ID of the computation. The
+  // normal priority computations wait while high priority ones are waiting,
+  // and keep off the slots reserved to them.
+  int64_t RunAsyncStart(ExecutePriority priority = ExecutePriority::kNormal) {
+    static metrics::Metric* wait_metric =
+        new metrics::Metric("ComputationSlotWaitTime", metrics::MetricFnTime);
+    static metrics::Metric* depth_metric =
+        new metrics::Metric("ComputationQueueDepth");
+    bool high_priority = priority == ExecutePriority::kHigh;
+    int64_t computation_slots = GetComputationSlots();
+    int64_t start = sys_util::NowNs();
     mutex_.Lock();
+    computation_slots_ = computation_slots;
+    if (high_priority) {
+      ++waiting_high_priority_;
+    }
     XLA_CHECK(mutex_.AwaitWithTimeout(
-        absl::Condition(this, &LocalDevice::HasAvailableComputationSlots),
+        high_priority
+            ? absl::Condition(this, &LocalDevice::HasAvailableComputationSlots)
+            : absl::Condition(this, &LocalDevice::HasAvailableNormalSlots),
         absl::Hours(2)))
         << "TPU DEADLOCKED or very slow computation...";
-    --available_computation_slots_;
+    if (high_priority) {
+      --waiting_high_priority_;
+    }
     int64_t result = next_computation_id_;
     ++next_computation_id_;
+    int64_t queue_depth = NumInflightComputations();
     mutex_.Unlock();
+    if (high_priority) {
+      static metrics::Metric* high_wait_metric = new metrics::Metric(
+          "HighPrioritySlotWaitTime", metrics::MetricFnTime);
+      int64_t now = sys_util::NowNs();
+      high_wait_metric->AddSample(now, now - start);
+    }
+    int64_t now = sys_util::NowNs();
+    wait_metric->AddSample(now, now - start);
+    depth_metric->AddSample(queue_depth);
     return result;
   }
-  void RunAsyncFinish() {
+  void RunAsyncFinish(int64_t computation_id) {
     mutex_.Lock();
-    ++available_computation_slots_;
-    ++done_computation_id_;
+    auto it = inflight_computations_.find(computation_id);
+    if (it != inflight_computations_.end()) {
+      --stream_loads_[it->second.stream_index];
+      inflight_computations_.erase(it);
+    }
+    // With more than one stream the computations complete out of order, so
+    // the ones past the first still running are parked until it finishes.
+    finished_computation_ids_.insert(computation_id);
+    while (finished_computation_ids_.erase(done_computation_id_) > 0) {
+      ++done_computation_id_;
+    }
     mutex_.Unlock();
   }
 
+  // Selects the compute stream for a computation depending on the given ones,
+  // and makes it wait on the events of the dependencies running on the other
+  // streams. With no pending dependency the least loaded stream is used. The
+  // high priority stream, if any, only runs the high priority computations.
+  int AcquireComputeStream(
+      absl::Span<const int64_t> dependencies,
+      ExecutePriority priority = ExecutePriority::kNormal) {
+    if (num_compute_streams() == 1) {
+      return 0;
+    }
+    std::vector<std::shared_ptr<se::Event>> events;
+    int stream_index = priority == ExecutePriority::kHigh
+                           ? high_priority_stream_index_
+                           : -1;
+    {
+      absl::MutexLock lock(&mutex_);
+      for (int64_t dependency : dependencies) {
+        auto it = inflight_computations_.find(dependency);
+        if (it == inflight_computations_.end()) {
+          continue;
+        }
+        if (stream_index < 0 &&
+            it->second.stream_index != high_priority_stream_index_) {
+          stream_index = it->second.stream_index;
+        } else if (it->second.stream_index != stream_index) {
+          events.push_back(it->second.event);
+        }
+      }
+      if (stream_index < 0) {
+        for (int i = 0; i < num_compute_streams(); ++i) {
+          if (i != high_priority_stream_index_ &&
+              (stream_index < 0 ||
+               stream_loads_[i] < stream_loads_[stream_index])) {
+            stream_index = i;
+          }
+        }
+      }
+      ++stream_loads_[stream_index];
+    }
+    se::Stream* stream = compute_stream(stream_index);
+    for (auto& event : events) {
+      stream->ThenWaitFor(event.get());
+    }
+    if (!events.empty()) {
+      XLA_COUNTER("CrossStreamWaits", events.size());
+    }
+    return stream_index;
+  }
+
+  // Records the event signaling the completion of the computation enqueued
+  // on the given stream, which later computations on other streams wait on.
+  void RecordComputation(int64_t computation_id, int stream_index) {
+    if (num_compute_streams() == 1) {
+      return;
+    }
+    se::Stream* stream = compute_stream(stream_index);
+    auto event = std::make_shared<se::Event>(stream->parent());
+    XLA_CHECK(event->Init()) << "Unable to create a stream event";
+    stream->ThenRecordEvent(event.get());
+    absl::MutexLock lock(&mutex_);
+    inflight_computations_[computation_id] =
+        InflightComputation{stream_index, std::move(event)};
+  }
+
+  // Makes the stream wait for all the work queued so far on the compute
+  // streams.
+  void OrderAfterComputations(se::Stream* stream) {
+    for (int i = 0; i < num_compute_streams(); ++i) {
+      stream->ThenWaitFor(compute_stream(i));
+    }
+  }
+
   void WaitUntilComputationFinished(int64_t computation_id) {
     mutex_.Lock();
     auto cond = [&]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
-      return computation_id < done_computation_id_;
+      return computation_id < done_computation_id_ ||
+             finished_computation_ids_.contains(computation_id);
     };
     XLA_CHECK(mutex_.AwaitWithTimeout(absl::Condition(&cond), absl::Hours(2)))
         << "TPU DEADLOCKED or very slow computation...";
@@ -186,7 +524,52 @@ class LocalDevice : public ComputationClient::Device {
   }
 
   bool HasAvailableComputationSlots() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
-    return available_computation_slots_ > 0;
+    return NumInflightComputations() < computation_slots_;
+  }
+
+  bool HasAvailableNormalSlots() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    int64_t reserved_slots =
+        std::min(GetHighPrioritySlots(), computation_slots_ - 1);
+    return waiting_high_priority_ == 0 &&
+           NumInflightComputations() < computation_slots_ - reserved_slots;
+  }
+
+  int64_t NumInflightComputations() const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return next_computation_id_ - done_computation_id_ -
+           finished_computation_ids_.size();
+  }
+
+  // Returns the number of computations allowed to be in flight on the device.
+  // This is XLA_COMPUTATION_SLOTS, scaled down linearly once the free device
+  // memory drops below XLA_COMPUTATION_SLOTS_FREE_MEMORY, so that a host
+  // running ahead does not pile up the outputs of the queued computations.
+  int64_t GetComputationSlots() const {
+    int64_t max_slots = GetMaxComputationSlots();
+    double free_threshold = GetComputationSlotsFreeMemory();
+    if (is_cpu_ || free_threshold <= 0) {
+      return max_slots;
+    }
+    int64 free_bytes = 0;
+    int64 total_bytes = 0;
+    if (!stream_->parent()->DeviceMemoryUsage(&free_bytes, &total_bytes) ||
+        total_bytes <= 0) {
+      return max_slots;
+    }
+    // The blocks held by the caching allocator are free as far as the
+    // computations are concerned.
+    if (caching_allocator_ != nullptr) {
+      free_bytes += caching_allocator_->GetStats().cached_bytes;
+    }
+    double free_fraction = static_cast<double>(free_bytes) / total_bytes;
+    if (free_fraction >= free_threshold) {
+      return max_slots;
+    }
+    int64_t slots = std::max<int64_t>(
+        static_cast<int64_t>(max_slots * free_fraction / free_threshold), 1);
+    XLA_COUNTER("ComputationSlotsThrottled", 1);
+    XLA_VALUE_METRIC("ComputationSlotsLimit", slots);
+    return slots;
   }
 
   DataPtr CreateDataPlaceholder(Shape shape);
@@ -197,6 +580,39 @@ class LocalDevice : public ComputationClient::Device {
   DataPtr TransferToServer(xla::BorrowingLiteral literal,
                            const xla::Shape& dest_shape) override;
 
+  // Copies array buffers to another accelerator of the same platform through
+  // a peer copy, if the two devices can access each other's memory.
+  DataPtr CopyToDevice(const DataPtr& data,
+                       ComputationClient::Device* destination) override;
+
+  // The usage comes from the caching allocator, which tracks the buffers of
+  // the device, and the limit from the device itself.
+  MemoryInfo GetMemoryInfo() override {
+    MemoryInfo info;
+    if (caching_allocator_ != nullptr) {
+      CachingDeviceAllocator::Stats stats = caching_allocator_->GetStats();
+      info.bytes_in_use = stats.live_bytes;
+      info.peak_bytes_in_use = stats.peak_bytes;
+      info.bytes_cached = stats.cached_bytes;
+    }
+    int64 free_bytes = 0;
+    int64 total_bytes = 0;
+    if (!is_cpu_ &&
+        stream_->parent()->DeviceMemoryUsage(&free_bytes, &total_bytes)) {
+      info.bytes_limit = total_bytes;
+      if (info.bytes_in_use < 0) {
+        info.bytes_in_use = total_bytes - free_bytes;
+      }
+    }
+    return info;
+  }
+
+  // Stages the tensors into pinned host buffers, and enqueues the copies on
+  // the compute stream. The returned data carries a computation ID, which
+  // completes when the copies land on the device.
+  std::vector<DataPtr> TransferToServerAsync(
+      absl::Span<const TensorSource> tensors);
+
   std::vector<ComputationClient::ComputationPtr> Compile(
       const std::vector<std::string>& devices,
       std::vector<CompileInstance> instances) override;
@@ -214,23 +630,50 @@ class LocalDevice : public ComputationClient::Device {
       const Computation& computation, absl::Span<const DataPtr> arguments,
       const ExecuteComputationOptions& options) override;
 
+  // Runs the computation as one replica of a replicated run. The replicas of
+  // the run share the run id, which their collectives rendezvous on.
+  std::vector<ComputationClient::DataPtr> ExecuteReplica(
+      const Computation& computation, absl::Span<const DataPtr> arguments,
+      const ExecuteComputationOptions& options, const xla::RunId* run_id);
+
  private:
   absl::Mutex mutex_;
-  // This starts out as the number of allowable concurrent executions
-  // on this particular device.
-  int64_t available_computation_slots_ ABSL_GUARDED_BY(mutex_) = 64;
-  // computation id assigned to the next computation executed on stream_.
+  // Number of allowable concurrent executions on this particular device, as
+  // last computed by GetComputationSlots().
+  int64_t computation_slots_ ABSL_GUARDED_BY(mutex_) = 64;
+  // computation id assigned to the next computation executed on the device.
   int64_t next_computation_id_ ABSL_GUARDED_BY(mutex_) = 0;
   // Incremented when computations finish.
   // `computation_id < done_computation_id_` checks if a particular computation
   // is complete.
   int64_t done_computation_id_ ABSL_GUARDED_BY(mutex_) = 0;
+  // Computations which completed ahead of done_computation_id_.
+  absl::flat_hash_set<int64_t> finished_computation_ids_
+      ABSL_GUARDED_BY(mutex_);
+  // Number of high priority computations waiting for a slot.
+  int64_t waiting_high_priority_ ABSL_GUARDED_BY(mutex_) = 0;
+  struct InflightComputation {
+    int stream_index = 0;
+    std::shared_ptr<se::Event> event;
+  };
+  // Stream and completion event of the computations running on a device with
+  // more than one compute stream.
+  absl::flat_hash_map<int64_t, InflightComputation> inflight_computations_
+      ABSL_GUARDED_BY(mutex_);
+  // Number of computations in flight on each compute stream.
+  std::vector<int64_t> stream_loads_ ABSL_GUARDED_BY(mutex_);
   xla::LocalClient* client_;
   int device_ordinal_;
   int32_t mesh_id_;
   bool is_cpu_;
   std::unique_ptr<se::Stream> stream_;
   std::unique_ptr<se::Stream> transfer_from_device_stream_;
+  std::vector<std::unique_ptr<se::Stream>> extra_compute_streams_;
+  // Index of the compute stream reserved to the high priority computations, or
+  // -1 if they share the streams of the others.
+  int high_priority_stream_index_ = -1;
+  PinnedStagingPool staging_pool_;
+  std::unique_ptr<CachingDeviceAllocator> caching_allocator_;
 };
 
 class LocalData : public Data {
@@ -257,6 +700,10 @@ class LocalData : public Data {
 
   const ShapedBuffer& buffer() const { return *buffer_; }
 
+  const std::shared_ptr<ScopedShapedBuffer>& shared_buffer() const {
+    return buffer_;
+  }
+
   int64_t computation_id() const { return computation_id_; }
 
  private:
@@ -285,17 +732,16 @@ DataPtr LocalDevice::CreateDataPlaceholder(Shape shape) {
 
 DataPtr LocalDevice::TransferToServer(xla::BorrowingLiteral literal,
                                       const xla::Shape& dest_shape) {
-  tensorflow::profiler::TraceMe trace("TransferSingleTensorToServer");
+  TraceSection trace("TransferSingleTensorToServer");
 
-  stream_executor::DeviceMemoryAllocator* allocator =
-      client()->backend().memory_allocator();
+  stream_executor::DeviceMemoryAllocator* allocator = this->allocator();
   xla::TransferManager* transfer_manager =
       client()->backend().transfer_manager();
 
   se::Stream* stream = stream_->GetOrCreateSubStream();
 
   ScopedShapedBuffer buffer = [&] {
-    tensorflow::profiler::TraceMe trace("Allocate");
+    TraceSection trace("Allocate");
     return transfer_manager
         ->AllocateScopedShapedBuffer(dest_shape, allocator, device_ordinal_)
         .ValueOrDie();
@@ -312,10 +758,85 @@ DataPtr LocalDevice::TransferToServer(xla::BorrowingLiteral literal,
   return std::make_shared<LocalData>(this, std::move(buffer), -1);
 }
 
+namespace {
+
+// Enables the peer access from one executor to the other once, and returns
+// whether it is available.
+bool EnablePeerAccess(se::StreamExecutor* from, se::StreamExecutor* to) {
+  static absl::Mutex* mutex = new absl::Mutex();
+  static auto* peer_access =
+      new absl::flat_hash_map<std::pair<se::StreamExecutor*,
+                                        se::StreamExecutor*>,
+                              bool>();
+  absl::MutexLock lock(mutex);
+  auto it = peer_access->find({from, to});
+  if (it == peer_access->end()) {
+    bool enabled = from->CanEnablePeerAccessTo(to) &&
+                   from->EnablePeerAccessTo(to).ok();
+    TF_VLOG(2) << "Peer access from device " << from->device_ordinal()
+               << " to device " << to->device_ordinal() << ": " << enabled;
+    it = peer_access->emplace(std::make_pair(from, to), enabled).first;
+  }
+  return it->second;
+}
+
+}  // namespace
+
+DataPtr LocalDevice::CopyToDevice(const DataPtr& data,
+                                  ComputationClient::Device* destination) {
+  LocalDevice* dest = dynamic_cast<LocalDevice*>(destination);
+  if (dest == nullptr || dest == this || dest->client() != client() ||
+      is_cpu() || dest->is_cpu() || data->shape().IsTuple()) {
+    return nullptr;
+  }
+  se::StreamExecutor* executor =
+      client()->backend().stream_executor(device_ordinal()).ValueOrDie();
+  se::StreamExecutor* dest_executor =
+      client()->backend().stream_executor(dest->device_ordinal()).ValueOrDie();
+  if (!EnablePeerAccess(executor, dest_executor)) {
+    return nullptr;
+  }
+  TraceSection trace("CopyToDevice");
+  const LocalData& local_data = dynamic_cast<const LocalData&>(*data);
+  XLA_CHECK(local_data.HasValue()) << "Copying data with no value";
+  // Keeps the source buffer alive until the copy is done.
+  std::shared_ptr<ScopedShapedBuffer> source = local_data.shared_buffer();
+  if (local_data.computation_id() >= 0) {
+    WaitUntilComputationFinished(local_data.computation_id());
+  }
+  xla::TransferManager* transfer_manager =
+      client()->backend().transfer_manager();
+  ScopedShapedBuffer buffer =
+      transfer_manager
+          ->AllocateScopedShapedBuffer(source->on_host_shape(),
+                                       dest->allocator(),
+                                       dest->device_ordinal())
+          .ValueOrDie();
+  if (!xla::ShapeUtil::Equal(buffer.on_device_shape(),
+                             source->on_device_shape())) {
+    return nullptr;
+  }
+  uint64_t size = source->root_buffer().size();
+  se::DeviceMemoryBase dest_memory = buffer.root_buffer();
+  se::Stream* stream = stream_->GetOrCreateSubStream();
+  stream->ThenMemcpy(&dest_memory, source->root_buffer(), size);
+  TF_CHECK_OK(stream->BlockHostUntilDone());
+  stream_->ReturnSubStream(stream);
+  static metrics::Metric* copy_metric =
+      new metrics::Metric("DeviceToDeviceBytes", metrics::MetricFnBytes);
+  copy_metric->AddSample(size);
+  return std::make_shared<LocalData>(dest, std::move(buffer), -1);
+}
+
 std::vector<DataPtr> LocalDevice::TransferToServer(
     absl::Span<const TensorSource> tensors) {
+  if (!is_cpu() && UseAsyncTransfers()) {
+    return TransferToServerAsync(tensors);
+  }
   auto* device = this;
-  tensorflow::profiler::TraceMe trace("TransferToServer");
+  TraceSection trace("TransferToServer");
+  device_activity::ScopedHostPhase phase(
+      device_activity::HostPhase::kTransfer);
   std::vector<std::unique_ptr<char[]>> buffers;
   buffers.resize(tensors.size());
   size_t total_size = 0;
@@ -351,8 +872,7 @@ std::vector<DataPtr> LocalDevice::TransferToServer(
   for (size_t i = 0; i < tensors.size(); ++i) {
     const TensorSource& tensor = tensors[i];
 
-    stream_executor::DeviceMemoryAllocator* allocator =
-        device->client()->backend().memory_allocator();
+    stream_executor::DeviceMemoryAllocator* allocator = device->allocator();
     xla::TransferManager* transfer_manager =
         device->client()->backend().transfer_manager();
 
@@ -363,7 +883,7 @@ std::vector<DataPtr> LocalDevice::TransferToServer(
     }
 
     ScopedShapedBuffer buffer = [&] {
-      tensorflow::profiler::TraceMe trace("Allocate");
+      TraceSection trace("Allocate");
       return transfer_manager
           ->AllocateScopedShapedBuffer(tensor.shape, allocator,
                                        device_ordinal())
@@ -383,20 +903,78 @@ std::vector<DataPtr> LocalDevice::TransferToServer(
   return out;
 }
 
+std::vector<DataPtr> LocalDevice::TransferToServerAsync(
+    absl::Span<const TensorSource> tensors) {
+  TraceSection trace("TransferToServerAsync");
+  device_activity::ScopedHostPhase phase(
+      device_activity::HostPhase::kTransfer);
+  std::vector<PinnedStagingPool::Buffer> staging(tensors.size());
+  size_t total_size = 0;
+  util::MultiWait mwait(tensors.size());
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    size_t size = xla::ShapeUtil::ByteSizeOf(tensors[i].shape);
+    total_size += size;
+    auto converter = [&, i, size]() {
+      staging[i] = staging_pool_.Acquire(size);
+      tensors[i].populate_fn(tensors[i], staging[i].ptr, size);
+    };
+    if (tensors.size() == 1) {
+      mwait.Completer(std::move(converter))();
+    } else {
+      env::ScheduleClosure(mwait.Completer(std::move(converter)));
+    }
+  }
+  mwait.Wait();
+
+  ComputationClient::OutboundDataMetric()->AddSample(total_size);
+
+  stream_executor::DeviceMemoryAllocator* allocator = this->allocator();
+  xla::TransferManager* transfer_manager =
+      client()->backend().transfer_manager();
+  // The copies go on the compute stream, so that computations consuming the
+  // transferred buffers are ordered after them, and they complete in order
+  // with the computations as far as the computation IDs are concerned.
+  int64_t computation_id = RunAsyncStart();
+  if (num_compute_streams() > 1) {
+    absl::MutexLock lock(&mutex_);
+    ++stream_loads_[0];
+  }
+  std::vector<DataPtr> out;
+  out.reserve(tensors.size());
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    ScopedShapedBuffer buffer = [&] {
+      TraceSection trace("Allocate");
+      return transfer_manager
+          ->AllocateScopedShapedBuffer(tensors[i].shape, allocator,
+                                       device_ordinal())
+          .ValueOrDie();
+    }();
+    xla::BorrowingLiteral literal(static_cast<const char*>(staging[i].ptr),
+                                  tensors[i].shape);
+    TF_CHECK_OK(
+        transfer_manager->TransferLiteralToDeviceAsync(stream(), literal,
+                                                       buffer));
+    out.push_back(
+        std::make_shared<LocalData>(this, std::move(buffer), computation_id));
+  }
+  RecordComputation(computation_id, /*stream_index=*/0);
+  stream()->ThenDoHostCallback(
+      [this, computation_id, staging = std::move(staging)]() {
+        for (auto& buffer : staging) {
+          staging_pool_.Release(buffer);
+        }
+        RunAsyncFinish(computation_id);
+      });
+  return out;
+}
+
 std::vector<Literal> LocalTransferManager::TransferFromServerImpl(
     absl::Span<const DataPtr> handles) {
-  tensorflow::profiler::TraceMe trace("TransferFromServer");
+  TraceSection trace("TransferFromServer");
   metrics::TimedSection timed(ComputationClient::TransferFromServerMetric());
-  absl::node_hash_set<LocalDevice*> devices;
-  {
-    tensorflow::profiler::TraceMe trace("Wait for transfer");
-    for (size_t i = 0; i < handles.size(); ++i) {
-      const auto& local_data = dynamic_cast<const LocalData&>(*handles[i]);
-      // Block until all compute is done before transfering from the server.
-      dynamic_cast<LocalDevice*>(local_data.device())
-          ->WaitUntilComputationFinished(local_data.computation_id());
-    }
-  }
+  device_activity::ScopedHostPhase phase(
+      device_activity::HostPhase::kTransfer);
+  WaitForComputations(handles);
 
   std::vector<Literal> out;
   out.resize(handles.size());
@@ -418,18 +996,156 @@ std::vector<Literal> LocalTransferManager::TransferFromServerImpl(
   return out;
 }
 
+void LocalTransferManager::TransferFromServerImpl(
+    absl::Span<const DataPtr> handles,
+    absl::Span<const MutableBorrowingLiteral> literals) {
+  XLA_CHECK_EQ(handles.size(), literals.size());
+  // The transfer manager copies the device buffer out as is, in the device
+  // layout, so only the destinations with that same layout can be written
+  // directly. The others go through an owning literal, and an explicit
+  // relayout into the destination.
+  for (size_t i = 0; i < handles.size(); ++i) {
+    const auto& local_data = dynamic_cast<const LocalData&>(*handles[i]);
+    if (!ShapeUtil::Equal(local_data.buffer().on_device_shape(),
+                          literals[i].shape())) {
+      ComputationClient::TransferManager::TransferFromServerImpl(handles,
+                                                                 literals);
+      return;
+    }
+  }
+  TraceSection trace("TransferFromServer");
+  metrics::TimedSection timed(ComputationClient::TransferFromServerMetric());
+  device_activity::ScopedHostPhase phase(
+      device_activity::HostPhase::kTransfer);
+  WaitForComputations(handles);
+
+  util::MultiWait mwait(handles.size());
+  for (size_t i = 0; i < handles.size(); ++i) {
+    const auto& local_data = dynamic_cast<const LocalData&>(*handles[i]);
+    LocalDevice* device = dynamic_cast<LocalDevice*>(local_data.device());
+    xla::TransferManager* transfer_manager =
+        device->client()->backend().transfer_manager();
+    transfer_manager->TransferLiteralFromDevice(
+        device->transfer_from_device_stream(), local_data.buffer(),
+        literals[i], [&mwait](Status status) {
+          TF_CHECK_OK(status);
+          mwait.Done();
+        });
+  }
+  mwait.Wait();
+}
+
+std::future<std::vector<Literal>>
+LocalTransferManager::TransferFromServerAsyncImpl(
+    std::vector<DataPtr> handles) {
+  for (const DataPtr& handle : handles) {
+    const ShapedBuffer& buffer =
+        dynamic_cast<const LocalData&>(*handle).buffer();
+    // Tuples and buffers whose device shape differs from the host one need
+    // the transfer manager to be read back.
+    if (!buffer.on_host_shape().IsArray() ||
+        !ShapeUtil::Equal(buffer.on_host_shape(), buffer.on_device_shape())) {
+      return ComputationClient::TransferManager::TransferFromServerAsyncImpl(
+          std::move(handles));
+    }
+  }
+  TraceSection trace("TransferFromServerAsync");
+  XLA_COUNTER("AsyncTransferFromServer", 1);
+  struct Readback {
+    std::vector<DataPtr> handles;
+    std::vector<PinnedStagingPool::Buffer> staging;
+    std::vector<LocalDevice*> devices;
+    std::promise<std::vector<Literal>> promise;
+    std::atomic<size_t> pending_devices{0};
+    int64_t start = sys_util::NowNs();
+  };
+  auto readback = std::make_shared<Readback>();
+  readback->staging.resize(handles.size());
+  for (size_t i = 0; i < handles.size(); ++i) {
+    const auto& local_data = dynamic_cast<const LocalData&>(*handles[i]);
+    LocalDevice* device = dynamic_cast<LocalDevice*>(local_data.device());
+    se::Stream* stream = device->transfer_from_device_stream();
+    if (std::find(readback->devices.begin(), readback->devices.end(),
+                  device) == readback->devices.end()) {
+      device->OrderAfterComputations(stream);
+      readback->devices.push_back(device);
+    }
+    const ShapedBuffer& buffer = local_data.buffer();
+    size_t size = ShapeUtil::ByteSizeOf(buffer.on_host_shape());
+    readback->staging[i] = device->staging_pool()->Acquire(size);
+    if (size > 0) {
+      stream->ThenMemcpy(readback->staging[i].ptr, buffer.root_buffer(), size);
+    }
+  }
+  readback->handles = std::move(handles);
+  readback->pending_devices = readback->devices.size();
+  std::future<std::vector<Literal>> future = readback->promise.get_future();
+
+  auto complete = [readback]() {
+    try {
+      std::vector<Literal> literals;
+      literals.reserve(readback->handles.size());
+      for (LocalDevice* device : readback->devices) {
+        XLA_CHECK(device->transfer_from_device_stream()->ok())
+            << "Device to host transfer failed on " << device->name();
+      }
+      for (size_t i = 0; i < readback->handles.size(); ++i) {
+        const auto& local_data =
+            dynamic_cast<const LocalData&>(*readback->handles[i]);
+        literals.emplace_back(local_data.buffer().on_host_shape());
+        std::memcpy(literals.back().untyped_data(), readback->staging[i].ptr,
+                    literals.back().size_bytes());
+        dynamic_cast<LocalDevice*>(local_data.device())
+            ->staging_pool()
+            ->Release(readback->staging[i]);
+      }
+      int64_t now = sys_util::NowNs();
+      ComputationClient::TransferFromServerMetric()->AddSample(
+          now, now - readback->start);
+      readback->promise.set_value(std::move(literals));
+    } catch (...) {
+      readback->promise.set_exception(std::current_exception());
+    }
+  };
+  for (LocalDevice* device : readback->devices) {
+    // The host side copies run on an IO thread, away from the stream callback
+    // thread.
+    device->transfer_from_device_stream()->ThenDoHostCallback(
+        [readback, complete]() {
+          if (--readback->pending_devices == 0) {
+            env::ScheduleIoClosure(complete);
+          }
+        });
+  }
+  return future;
+}
+
+void LocalTransferManager::WaitForComputations(
+    absl::Span<const DataPtr> handles) {
+  TraceSection trace("Wait for transfer");
+  for (size_t i = 0; i < handles.size(); ++i) {
+    const auto& local_data = dynamic_cast<const LocalData&>(*handles[i]);
+    // Block until all compute is done before transfering from the server.
+    dynamic_cast<LocalDevice*>(local_data.device())
+        ->WaitUntilComputationFinished(local_data.computation_id());
+  }
+}
+
 std::vector<ComputationPtr> LocalDevice::Compile(
     const std::vector<std::string>& devices,
     std::vector<CompileInstance> instances) {
   metrics::TimedSection timed(ComputationClient::CompileMetric());
-  // TODO(parkers): Probably have to do this in parallel if actually given
-  // n computations.
-  std::vector<ComputationPtr> out;
-  for (CompileInstance& instance : instances) {
-    std::unique_ptr<xla::DeviceAssignment> assignment = GetAssignment(devices);
+  device_activity::ScopedHostPhase phase(device_activity::HostPhase::kCompile);
+  std::vector<ComputationPtr> out(instances.size());
+  auto compile_fn = [&](size_t index) {
+    CompileInstance& instance = instances[index];
+    bool spmd = instance.spmd_partitioned && devices.size() > 1;
+    std::unique_ptr<xla::DeviceAssignment> assignment =
+        spmd ? GetPartitionAssignment(devices) : GetAssignment(devices);
 
     tensorflow::profiler::TraceMe trace(
         [&] { return absl::StrCat("XLA Compile: ", name()); });
+    trace::ScopedEvent compile_event("XLA Compile");
 
     const XlaComputation& computation = instance.computation;
     std::vector<xla::Shape> argument_layouts =
@@ -440,19 +1156,35 @@ std::vector<ComputationPtr> LocalDevice::Compile(
       exec_build_options.set_result_layout(*instance.output_shape);
     }
     exec_build_options.set_device_ordinal(device_ordinal());
-    exec_build_options.set_num_replicas(devices.size());
+    if (spmd) {
+      exec_build_options.set_num_replicas(1);
+      exec_build_options.set_num_partitions(devices.size());
+      exec_build_options.set_use_spmd_partitioning(true);
+    } else {
+      exec_build_options.set_num_replicas(devices.size());
+    }
+    if (instance.fast_compile) {
+      util::SetFastCompileOptions(exec_build_options.mutable_debug_options());
+    }
 
     std::shared_ptr<xla::LocalExecutable> xla_computation;
     static auto* deduping = new ConcurrentCompileDedupping;
 
-    deduping->mutex.Lock();
+    bool hlo_fingerprint = instance.fingerprint == 0;
     ConcurrentCompileDedupping::Key key{
         client(),
         exec_build_options.result_layout()
             ? exec_build_options.result_layout()->ToProto().SerializeAsString()
             : "",
-        computation.proto().SerializeAsString(),
-        exec_build_options.num_replicas()};
+        hlo_fingerprint
+            ? util::Hash(computation.proto().SerializeAsString())
+            : instance.fingerprint,
+        hlo_fingerprint,
+        exec_build_options.num_replicas(),
+        exec_build_options.num_partitions(),
+        instance.fast_compile,
+        &computation};
+    deduping->mutex.Lock();
 
     if (deduping->ShouldCompile(key, &xla_computation)) {
       deduping->mutex.Unlock();
@@ -474,36 +1206,74 @@ std::vector<ComputationPtr> LocalDevice::Compile(
         xla::ProgramShape(instance.computation.GetProgramShape().ValueOrDie()),
         devices, std::move(xla_computation));
     local_computation->assignment = std::move(assignment);
-    out.push_back(std::move(local_computation));
+    out[index] = std::move(local_computation);
+  };
+  // Each compilation holds its HLO module and the compiler working set in host
+  // memory, so at most XLA_COMPILE_PARALLELISM of them run concurrently.
+  static const size_t max_parallelism =
+      std::max<int64_t>(sys_util::GetEnvInt("XLA_COMPILE_PARALLELISM", 4), 1);
+  size_t num_workers = std::min(max_parallelism, instances.size());
+  if (num_workers <= 1) {
+    for (size_t i = 0; i < instances.size(); ++i) {
+      compile_fn(i);
+    }
+    return out;
   }
+  std::atomic<size_t> next_index(0);
+  util::MultiWait mwait(num_workers);
+  for (size_t i = 0; i < num_workers; ++i) {
+    auto worker = [&]() {
+      for (size_t index = next_index++; index < instances.size();
+           index = next_index++) {
+        compile_fn(index);
+      }
+    };
+    env::ScheduleClosure(mwait.Completer(std::move(worker)));
+  }
+  mwait.Wait();
   return out;
 }
 
 std::vector<DataPtr> LocalDevice::ExecuteComputation(
     const Computation& computation, absl::Span<const DataPtr> arguments,
     const ExecuteComputationOptions& options) {
+  return ExecuteReplica(computation, arguments, options, /*run_id=*/nullptr);
+}
+
+std::vector<DataPtr> LocalDevice::ExecuteReplica(
+    const Computation& computation, absl::Span<const DataPtr> arguments,
+    const ExecuteComputationOptions& options, const xla::RunId* run_id) {
   auto& local_computation = dynamic_cast<const LocalComputation&>(computation);
   std::vector<const xla::ShapedBuffer*> args;
+  std::vector<int64_t> dependencies;
   for (const DataPtr& opaque_arg : arguments) {
-    args.push_back(&dynamic_cast<const LocalData&>(*opaque_arg).buffer());
+    const auto& local_data = dynamic_cast<const LocalData&>(*opaque_arg);
+    args.push_back(&local_data.buffer());
+    dependencies.push_back(local_data.computation_id());
   }
 
   std::unique_ptr<xla::DeviceAssignment> devices;
 
+  bool sync_execution = is_cpu() && !UseAsyncCpuExecution();
+  int64_t computation_id = -1;
+  int stream_index = 0;
+  if (!sync_execution) {
+    TraceSection trace("Acquire Async slot");
+    computation_id = RunAsyncStart(options.priority);
+    stream_index = AcquireComputeStream(dependencies, options.priority);
+  }
+
   xla::ExecutableRunOptions run_options;
-  run_options.set_stream(stream_.get());
-  run_options.set_allocator(client_->backend().memory_allocator());
+  run_options.set_stream(compute_stream(stream_index));
+  run_options.set_allocator(allocator());
   run_options.set_intra_op_thread_pool(
       client_->backend().eigen_intra_op_thread_pool_device());
 
   run_options.set_device_assignment(local_computation.assignment.get());
-
-  bool is_cpu = this->is_cpu();
-  int64_t computation_id = -1;
-  if (!is_cpu) {
-    tensorflow::profiler::TraceMe trace("Acquire Async slot");
-    computation_id = RunAsyncStart();
+  if (run_id != nullptr) {
+    run_options.set_run_id(*run_id);
   }
+  device_activity::ExecutionStarted(name());
   xla::ScopedShapedBuffer tmp =
       local_computation.handle->RunAsync(args, run_options).ValueOrDie();
   size_t num_tuples = tmp.on_host_shape().tuple_shapes().size();
@@ -515,13 +1285,37 @@ std::vector<DataPtr> LocalDevice::ExecuteComputation(
         computation_id));
   }
 
-  if (is_cpu) {
+  if (caching_allocator_ != nullptr) {
+    CachingDeviceAllocator::ReportMetrics();
+  }
+  if (sync_execution) {
     TF_CHECK_OK(run_options.stream()->BlockHostUntilDone());
+    device_activity::ExecutionFinished(name());
   } else {
+    // The CPU allocator hands freed memory right back to the host, so there
+    // the argument and output buffers are kept alive until the computation
+    // completes. With several GPU streams, the caching allocator holds the
+    // freed blocks until the streams are done with them.
+    std::vector<std::shared_ptr<ScopedShapedBuffer>> buffers;
+    if (is_cpu()) {
+      buffers.reserve(arguments.size() + out.size());
+      for (const DataPtr& data : arguments) {
+        buffers.push_back(
+            dynamic_cast<const LocalData&>(*data).shared_buffer());
+      }
+      for (const DataPtr& data : out) {
+        buffers.push_back(
+            dynamic_cast<const LocalData&>(*data).shared_buffer());
+      }
+    }
+    RecordComputation(computation_id, stream_index);
     run_options.stream()->ThenDoHostCallback(
         [handle = local_computation.handle,
-         assignment = local_computation.assignment,
-         this]() { RunAsyncFinish(); });
+         assignment = local_computation.assignment, computation_id,
+         buffers = std::move(buffers), this]() {
+          RunAsyncFinish(computation_id);
+          device_activity::ExecutionFinished(name());
+        });
   }
 
   return out;
@@ -529,6 +1323,44 @@ std::vector<DataPtr> LocalDevice::ExecuteComputation(
 
 }  // namespace
 
+std::vector<std::vector<ComputationClient::DataPtr>>
+ExecuteReplicatedOnLocalDevices(
+    const ComputationClient::Computation& computation,
+    const std::vector<std::vector<ComputationClient::DataPtr>>& arguments,
+    absl::Span<ComputationClient::Device* const> devices) {
+  metrics::TimedSection timed(ComputationClient::ExecuteReplicatedMetric());
+  XLA_CHECK_EQ(arguments.size(), devices.size());
+  const auto& local_computation =
+      dynamic_cast<const LocalComputation&>(computation);
+  XLA_CHECK(local_computation.assignment != nullptr &&
+            local_computation.assignment->replica_count() == devices.size())
+      << "The computation is not compiled for " << devices.size()
+      << " replicas";
+  std::vector<LocalDevice*> local_devices;
+  for (size_t i = 0; i < devices.size(); ++i) {
+    LocalDevice* device = dynamic_cast<LocalDevice*>(devices[i]);
+    XLA_CHECK(device != nullptr) << devices[i]->name() << " is not local";
+    XLA_CHECK_EQ((*local_computation.assignment)(i, 0), device->mesh_id())
+        << "Replica " << i << " is not assigned to " << device->name();
+    local_devices.push_back(device);
+  }
+  xla::RunId run_id;
+  ComputationClient::ExecuteComputationOptions options;
+  std::vector<std::vector<ComputationClient::DataPtr>> results(devices.size());
+  util::MultiWait mwait(devices.size());
+  for (size_t i = 0; i < local_devices.size(); ++i) {
+    auto replica_fn = [&, i]() {
+      results[i] = local_devices[i]->ExecuteReplica(computation, arguments[i],
+                                                    options, &run_id);
+    };
+    // A thread per replica, as the launches of the collectives block until
+    // all the replicas have joined.
+    env::ScheduleIoClosure(mwait.Completer(std::move(replica_fn)));
+  }
+  mwait.Wait();
+  return results;
+}
+
 std::unique_ptr<ComputationClient::Device> MakeLocalDeviceFromClient(
     std::string name, xla::LocalClient* client, int device_ordinal,
     int32_t mesh_id, bool is_cpu) {
@@ -541,8 +1373,18 @@ GetAllLocalDevicesForPlatform(const char* platform_name,
                               const char* device_prefix) {
   auto platform = xla::PlatformUtil::GetPlatform(platform_name);
   if (!platform.ok()) return {};
+  bool is_cpu = std::string(platform_name) == "cpu";
   xla::LocalClientOptions options;
   options.set_platform(platform.ValueOrDie());
+  if (is_cpu) {
+    int intra_op_threads = env::GetCpuIntraOpThreads();
+    if (intra_op_threads > 0) {
+      options.set_intra_op_parallelism_threads(intra_op_threads);
+    }
+    // The intra-op threads get created with the client, and inherit the NUMA
+    // binding of this thread.
+    env::BindThreadToCpuNumaNode();
+  }
   auto local_client_statusor =
       xla::ClientLibrary::GetOrCreateLocalClient(options);
   if (!local_client_statusor.ok()) return {};
@@ -551,8 +1393,7 @@ GetAllLocalDevicesForPlatform(const char* platform_name,
   devices.reserve(client->device_count());
   for (int i = 0; i < client->device_count(); ++i) {
     devices.push_back(MakeLocalDeviceFromClient(
-        absl::StrCat(device_prefix, ":", i), client, i, i,
-            std::string(platform_name) == "cpu"));
+        absl::StrCat(device_prefix, ":", i), client, i, i, is_cpu));
   }
   return devices;
 }
@@ -32,6 +32,16 @@ std::vector<std::unique_ptr<ComputationClient::Device>>
 GetAllLocalDevicesForPlatform(const char* platform_name,
                               const char* device_prefix);
 
+// Runs a computation compiled for devices.size() replicas in a single call,
+// with replica i running on devices[i] over arguments[i], and returns the
+// outputs of each replica. All the replicas launch concurrently, one thread
+// each, and share the device assignment of the computation and the run id.
+std::vector<std::vector<ComputationClient::DataPtr>>
+ExecuteReplicatedOnLocalDevices(
+    const ComputationClient::Computation& computation,
+    const std::vector<std::vector<ComputationClient::DataPtr>>& arguments,
+    absl::Span<ComputationClient::Device* const> devices);
+
 }  // namespace xla
 
 #endif  // X10_XLA_CLIENT_LOCAL_DEVICE_IMPL_H_
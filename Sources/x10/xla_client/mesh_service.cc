@@ -25,6 +25,8 @@
 
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <exception>
 #include <iostream>
 #include <map>
 #include <mutex>
@@ -86,11 +88,24 @@ class MeshServiceImpl : public grpc::MeshService::Service {
                             const grpc::RendezvousRequest* request,
                             grpc::RendezvousResponse* response) override;
 
+  ::grpc::Status BatchRendezvous(
+      ::grpc::ServerContext* context,
+      const grpc::BatchRendezvousRequest* request,
+      grpc::BatchRendezvousResponse* response) override;
+
   ::grpc::Status GetNcclUniqueUid(
       ::grpc::ServerContext* context,
       const grpc::GetNcclUniqueUidRequest* request,
       grpc::GetNcclUniqueUidResponse* response) override;
 
+  ::grpc::Status PutBlob(::grpc::ServerContext* context,
+                         const grpc::PutBlobRequest* request,
+                         grpc::PutBlobResponse* response) override;
+
+  ::grpc::Status GetBlob(::grpc::ServerContext* context,
+                         const grpc::GetBlobRequest* request,
+                         grpc::GetBlobResponse* response) override;
+
  private:
   class RendezvousData {
    public:
@@ -148,6 +163,22 @@ class MeshServiceImpl : public grpc::MeshService::Service {
     ::grpc::Status status_;
   };
 
+  std::shared_ptr<RendezvousData> JoinRendezvous(
+      const grpc::RendezvousRequest& request) {
+    std::set<int64_t> replicas(request.replicas().begin(),
+                               request.replicas().end());
+    auto rendezvous = GetRendezvous(request.tag(), replicas);
+    rendezvous->Complete(request.ordinal(), request.payload(), replicas);
+    return rendezvous;
+  }
+
+  static void AddPayloads(const RendezvousData& rendezvous,
+                          grpc::RendezvousResponse* response) {
+    for (auto& ordinal_payload : rendezvous.Payloads()) {
+      response->add_payloads(ordinal_payload.second);
+    }
+  }
+
   std::shared_ptr<RendezvousData> GetRendezvous(
       const std::string& tag, const std::set<int64_t>& replicas) {
     std::lock_guard<std::mutex> lock(lock_);
@@ -173,6 +204,11 @@ class MeshServiceImpl : public grpc::MeshService::Service {
   grpc::Config config_;
   absl::node_hash_map<std::string, std::shared_ptr<RendezvousData>>
       rendezvous_map_;
+  // The blobs live as long as the service, and the GetBlob() calls wait on
+  // blobs_cv_ for the ones not put yet.
+  std::mutex blobs_lock_;
+  std::condition_variable blobs_cv_;
+  absl::node_hash_map<std::string, std::string> blobs_;
 };
 
 ::grpc::Status MeshServiceImpl::GetConfig(::grpc::ServerContext* context,
@@ -186,10 +222,7 @@ class MeshServiceImpl : public grpc::MeshService::Service {
 ::grpc::Status MeshServiceImpl::Rendezvous(
     ::grpc::ServerContext* context, const grpc::RendezvousRequest* request,
     grpc::RendezvousResponse* response) {
-  std::set<int64_t> replicas(request->replicas().begin(),
-                             request->replicas().end());
-  auto rendezvous = GetRendezvous(request->tag(), replicas);
-  rendezvous->Complete(request->ordinal(), request->payload(), replicas);
+  auto rendezvous = JoinRendezvous(*request);
   TF_VLOG(3) << "Entering rendezvous: ordinal=" << request->ordinal()
              << ", tag=" << request->tag() << ", peer=" << context->peer();
   ::grpc::Status status = rendezvous->Wait();
@@ -197,14 +230,51 @@ class MeshServiceImpl : public grpc::MeshService::Service {
              << ", tag=" << request->tag() << ", peer=" << context->peer()
              << ", status=" << status;
   if (status.ok()) {
-    for (auto& ordinal_payload : rendezvous->Payloads()) {
-      response->add_payloads(ordinal_payload.second);
-    }
+    AddPayloads(*rendezvous, response);
   }
   ReleaseRendezvous(request->tag(), rendezvous);
   return status;
 }
 
+::grpc::Status MeshServiceImpl::BatchRendezvous(
+    ::grpc::ServerContext* context, const grpc::BatchRendezvousRequest* request,
+    grpc::BatchRendezvousResponse* response) {
+  std::set<std::string> tags;
+  for (auto& rv_request : request->requests()) {
+    if (!tags.insert(rv_request.tag()).second) {
+      return ::grpc::Status(
+          ::grpc::StatusCode::INVALID_ARGUMENT,
+          absl::StrCat("Duplicate rendezvous tag: ", rv_request.tag()));
+    }
+  }
+  // Join all the rendezvous before waiting on any of them, so that the batch
+  // completes once the slowest replica has shown up, whatever the order in
+  // which the other replicas listed the tags.
+  std::vector<std::shared_ptr<RendezvousData>> rendezvous;
+  for (auto& rv_request : request->requests()) {
+    rendezvous.push_back(JoinRendezvous(rv_request));
+  }
+  TF_VLOG(3) << "Entering batch rendezvous: count=" << rendezvous.size()
+             << ", tags=(" << absl::StrJoin(tags, ", ")
+             << "), peer=" << context->peer();
+  ::grpc::Status status;
+  for (size_t i = 0; i < rendezvous.size(); ++i) {
+    ::grpc::Status rv_status = rendezvous[i]->Wait();
+    grpc::RendezvousResponse* rv_response = response->add_responses();
+    if (rv_status.ok()) {
+      AddPayloads(*rendezvous[i], rv_response);
+    } else if (status.ok()) {
+      status = rv_status;
+    }
+  }
+  TF_VLOG(3) << "Exiting batch rendezvous: count=" << rendezvous.size()
+             << ", peer=" << context->peer() << ", status=" << status;
+  for (size_t i = 0; i < rendezvous.size(); ++i) {
+    ReleaseRendezvous(request->requests(i).tag(), rendezvous[i]);
+  }
+  return status;
+}
+
 ::grpc::Status MeshServiceImpl::GetNcclUniqueUid(
     ::grpc::ServerContext* context,
     const grpc::GetNcclUniqueUidRequest* request,
@@ -219,6 +289,38 @@ class MeshServiceImpl : public grpc::MeshService::Service {
   return ::grpc::Status::OK;
 }
 
+::grpc::Status MeshServiceImpl::PutBlob(::grpc::ServerContext* context,
+                                        const grpc::PutBlobRequest* request,
+                                        grpc::PutBlobResponse* response) {
+  TF_VLOG(3) << "Got blob put request: key=" << request->key()
+             << ", size=" << request->data().size()
+             << ", peer=" << context->peer();
+  {
+    std::lock_guard<std::mutex> lock(blobs_lock_);
+    blobs_[request->key()] = request->data();
+  }
+  blobs_cv_.notify_all();
+  return ::grpc::Status::OK;
+}
+
+::grpc::Status MeshServiceImpl::GetBlob(::grpc::ServerContext* context,
+                                        const grpc::GetBlobRequest* request,
+                                        grpc::GetBlobResponse* response) {
+  TF_VLOG(3) << "Got blob get request: key=" << request->key()
+             << ", peer=" << context->peer();
+  std::unique_lock<std::mutex> lock(blobs_lock_);
+  auto it = blobs_.end();
+  blobs_cv_.wait_for(lock, std::chrono::milliseconds(request->timeout_ms()),
+                     [&]() {
+                       it = blobs_.find(request->key());
+                       return it != blobs_.end();
+                     });
+  if (it != blobs_.end()) {
+    response->set_data(it->second);
+  }
+  return ::grpc::Status::OK;
+}
+
 }  // namespace
 
 struct MeshService::Impl {
@@ -249,6 +351,8 @@ struct MeshClient::Impl {
   std::shared_ptr<::grpc::Channel> channel;
   std::unique_ptr<grpc::MeshService::Stub> stub;
   std::string address;
+  std::mutex nccl_uids_lock;
+  std::map<std::string, std::shared_future<std::string>> nccl_uids;
 };
 
 MeshClient* MeshClient::Get() {
@@ -313,8 +417,109 @@ std::vector<std::string> MeshClient::Rendezvous(
   return rv_payloads;
 }
 
+std::future<std::vector<std::string>> MeshClient::RendezvousAsync(
+    int ordinal, std::string tag, std::string payload,
+    std::vector<int64_t> replicas) const {
+  auto promise = std::make_shared<std::promise<std::vector<std::string>>>();
+  auto rendezvous = [this, promise, ordinal, tag = std::move(tag),
+                     payload = std::move(payload),
+                     replicas = std::move(replicas)]() {
+    try {
+      promise->set_value(Rendezvous(ordinal, tag, payload, replicas));
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+  };
+  env::ScheduleIoClosure(std::move(rendezvous));
+  return promise->get_future();
+}
+
+std::vector<std::vector<std::string>> MeshClient::BatchRendezvous(
+    int ordinal, absl::Span<const RendezvousEntry> entries) const {
+  ::grpc::ClientContext context;
+  grpc::BatchRendezvousRequest request;
+  grpc::BatchRendezvousResponse response;
+  std::vector<std::string> tags;
+  for (auto& entry : entries) {
+    grpc::RendezvousRequest* rv_request = request.add_requests();
+    rv_request->set_tag(entry.tag);
+    rv_request->set_payload(entry.payload);
+    rv_request->set_ordinal(ordinal);
+    for (auto& replica : entry.replicas) {
+      rv_request->add_replicas(replica);
+    }
+    tags.push_back(entry.tag);
+  }
+  TF_VLOG(3) << "Waiting for batch rendezvous: ordinal=" << ordinal
+             << " tags=(" << absl::StrJoin(tags, ", ") << ")";
+  ::grpc::Status status =
+      impl_->stub->BatchRendezvous(&context, request, &response);
+  TF_VLOG(3) << "Batch rendezvous wait complete: ("
+             << absl::StrJoin(tags, ", ") << ")";
+  if (!status.ok()) {
+    XLA_ERROR() << "Failed to meet rendezvous (" << absl::StrJoin(tags, ", ")
+                << "): " << status;
+  }
+  XLA_CHECK_EQ(response.responses_size(), static_cast<int>(entries.size()));
+  std::vector<std::vector<std::string>> rv_payloads;
+  for (auto& rv_response : response.responses()) {
+    rv_payloads.emplace_back(rv_response.payloads().begin(),
+                             rv_response.payloads().end());
+  }
+  return rv_payloads;
+}
+
+std::future<std::vector<std::vector<std::string>>>
+MeshClient::BatchRendezvousAsync(int ordinal,
+                                 std::vector<RendezvousEntry> entries) const {
+  auto promise =
+      std::make_shared<std::promise<std::vector<std::vector<std::string>>>>();
+  auto rendezvous = [this, promise, ordinal, entries = std::move(entries)]() {
+    try {
+      promise->set_value(BatchRendezvous(ordinal, entries));
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+  };
+  env::ScheduleIoClosure(std::move(rendezvous));
+  return promise->get_future();
+}
+
 std::string MeshClient::GetNcclUniqueUid(
     absl::Span<const int64_t> replicas) const {
+  return GetNcclUniqueUidAsync(replicas).get();
+}
+
+std::shared_future<std::string> MeshClient::GetNcclUniqueUidAsync(
+    absl::Span<const int64_t> replicas) const {
+  std::string replicas_str = absl::StrJoin(replicas, ",");
+  std::lock_guard<std::mutex> lock(impl_->nccl_uids_lock);
+  auto it = impl_->nccl_uids.find(replicas_str);
+  if (it == impl_->nccl_uids.end()) {
+    auto promise = std::make_shared<std::promise<std::string>>();
+    it = impl_->nccl_uids.emplace(replicas_str, promise->get_future().share())
+             .first;
+    auto fetch = [this, promise, replicas_str,
+                  replicas = std::vector<int64_t>(replicas.begin(),
+                                                  replicas.end())]() {
+      try {
+        promise->set_value(FetchNcclUniqueUid(replicas));
+      } catch (...) {
+        // Drop the failed entry, so that the next request retries the fetch.
+        {
+          std::lock_guard<std::mutex> lock(impl_->nccl_uids_lock);
+          impl_->nccl_uids.erase(replicas_str);
+        }
+        promise->set_exception(std::current_exception());
+      }
+    };
+    env::ScheduleIoClosure(std::move(fetch));
+  }
+  return it->second;
+}
+
+std::string MeshClient::FetchNcclUniqueUid(
+    absl::Span<const int64_t> replicas) const {
   ::grpc::ClientContext context;
   grpc::GetNcclUniqueUidRequest request;
   grpc::GetNcclUniqueUidResponse response;
@@ -335,5 +540,37 @@ std::string MeshClient::GetNcclUniqueUid(
   return response.uid();
 }
 
+void MeshClient::PutBlob(const std::string& key,
+                         const std::string& data) const {
+  ::grpc::ClientContext context;
+  grpc::PutBlobRequest request;
+  grpc::PutBlobResponse response;
+  request.set_key(key);
+  request.set_data(data);
+  ::grpc::Status status = impl_->stub->PutBlob(&context, request, &response);
+  if (!status.ok()) {
+    XLA_ERROR() << "Failed to put blob '" << key << "': " << status;
+  }
+}
+
+absl::optional<std::string> MeshClient::GetBlob(const std::string& key,
+                                                int64_t timeout_ms) const {
+  ::grpc::ClientContext context;
+  grpc::GetBlobRequest request;
+  grpc::GetBlobResponse response;
+  request.set_key(key);
+  request.set_timeout_ms(timeout_ms);
+  TF_VLOG(3) << "Waiting for blob: key=" << key;
+  ::grpc::Status status = impl_->stub->GetBlob(&context, request, &response);
+  TF_VLOG(3) << "Blob wait complete: " << key;
+  if (!status.ok()) {
+    XLA_ERROR() << "Failed to get blob '" << key << "': " << status;
+  }
+  if (!response.has_data()) {
+    return absl::nullopt;
+  }
+  return std::move(*response.mutable_data());
+}
+
 }  // namespace service
 }  // namespace xla
@@ -17,10 +17,12 @@
 #ifndef X10_XLA_CLIENT_MESH_SERVICE_H_
 #define X10_XLA_CLIENT_MESH_SERVICE_H_
 
+#include <future>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/xla_client/mesh_service.pb.h"
 #include "tensorflow/compiler/xla/types.h"
@@ -44,6 +46,12 @@ class MeshClient {
   struct Impl;
 
  public:
+  struct RendezvousEntry {
+    std::string tag;
+    std::string payload;
+    std::vector<int64_t> replicas;
+  };
+
   static MeshClient* Get();
 
   const std::string& address() const;
@@ -54,13 +62,48 @@ class MeshClient {
                                       const std::string& payload,
                                       absl::Span<const int64_t> replicas) const;
 
+  // Same as Rendezvous(), but returns right away, and the payloads become
+  // available through the future once all the replicas have joined.
+  std::future<std::vector<std::string>> RendezvousAsync(
+      int ordinal, std::string tag, std::string payload,
+      std::vector<int64_t> replicas) const;
+
+  // Joins all the entries rendezvous within a single RPC, and returns their
+  // payloads in the entries order. The service registers the ordinal with all
+  // the tags before waiting on any of them, so replicas may list the same tags
+  // in different orders without deadlocking.
+  std::vector<std::vector<std::string>> BatchRendezvous(
+      int ordinal, absl::Span<const RendezvousEntry> entries) const;
+
+  std::future<std::vector<std::vector<std::string>>> BatchRendezvousAsync(
+      int ordinal, std::vector<RendezvousEntry> entries) const;
+
+  // Returns the NCCL UID of the replica group. The UIDs are cached by replica
+  // group, so only the first request for a group goes to the mesh service.
   std::string GetNcclUniqueUid(absl::Span<const int64_t> replicas) const;
 
+  // Starts fetching the NCCL UID of the replica group in the background, if
+  // not already cached. Used to prefetch the UIDs of the groups which are
+  // known ahead of the first execution using them.
+  std::shared_future<std::string> GetNcclUniqueUidAsync(
+      absl::Span<const int64_t> replicas) const;
+
+  // Stores the data under the key within the mesh service, where the other
+  // hosts can fetch it with GetBlob(). Putting a key again replaces its data.
+  void PutBlob(const std::string& key, const std::string& data) const;
+
+  // Returns the data stored under the key, waiting up to timeout_ms for a
+  // host to put it, or nullopt if none did in time.
+  absl::optional<std::string> GetBlob(const std::string& key,
+                                      int64_t timeout_ms) const;
+
  private:
   explicit MeshClient(const std::string& address);
 
   ~MeshClient();
 
+  std::string FetchNcclUniqueUid(absl::Span<const int64_t> replicas) const;
+
   std::unique_ptr<Impl> impl_;
 };
 
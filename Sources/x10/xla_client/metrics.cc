@@ -14,13 +14,21 @@
 
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
 #include <map>
 #include <sstream>
+#include <thread>
 
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/core/lib/core/bits.h"
 
 namespace xla {
 namespace metrics {
@@ -32,7 +40,8 @@ class MetricsArena {
 
   // Registers a new metric in the global arena.
   void RegisterMetric(const std::string& name, MetricReprFn repr_fn,
-                      size_t max_samples, std::shared_ptr<MetricData>* data);
+                      size_t max_samples, bool histogram,
+                      std::shared_ptr<MetricData>* data);
 
   void RegisterCounter(const std::string& name,
                        std::shared_ptr<CounterData>* data);
@@ -79,18 +88,59 @@ class MetricsArena {
   std::map<std::string, std::shared_ptr<CounterData>> counters_;
 };
 
+void ExportOpenMetrics(const std::string& path) {
+  // Written to a temporary file first, so that scrapers never see a partial
+  // report.
+  std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream file(tmp_path);
+    if (!file) {
+      TF_LOG(ERROR) << "Unable to write the metrics file: " << tmp_path;
+      return;
+    }
+    file << CreateOpenMetricsReport();
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    TF_LOG(ERROR) << "Unable to rename " << tmp_path << " to " << path;
+  }
+}
+
+void MaybeStartOpenMetricsExporter() {
+  std::string path = sys_util::GetEnvString("XLA_METRICS_EXPORT_FILE", "");
+  if (path.empty()) {
+    return;
+  }
+  int64_t period_ms =
+      sys_util::GetEnvInt("XLA_METRICS_EXPORT_PERIOD_MS", 10000);
+  XLA_CHECK_GT(period_ms, 0);
+  std::thread exporter([path, period_ms]() {
+    while (true) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(period_ms));
+      ExportOpenMetrics(path);
+    }
+  });
+  exporter.detach();
+  TF_VLOG(1) << "Exporting metrics to " << path << " every " << period_ms
+             << "ms";
+}
+
 MetricsArena* MetricsArena::Get() {
-  static MetricsArena* arena = new MetricsArena();
+  static MetricsArena* arena = []() {
+    MetricsArena* arena = new MetricsArena();
+    MaybeStartOpenMetricsExporter();
+    return arena;
+  }();
   return arena;
 }
 
 void MetricsArena::RegisterMetric(const std::string& name, MetricReprFn repr_fn,
-                                  size_t max_samples,
+                                  size_t max_samples, bool histogram,
                                   std::shared_ptr<MetricData>* data) {
   std::lock_guard<std::mutex> lock(lock_);
   if (*data == nullptr) {
     *data = xla::util::MapInsert(&metrics_, name, [&]() {
-      return std::make_shared<MetricData>(std::move(repr_fn), max_samples);
+      return std::make_shared<MetricData>(std::move(repr_fn), max_samples,
+                                          histogram);
     });
   }
 }
@@ -139,6 +189,15 @@ const std::vector<double>& GetPercentiles() {
   return *metrics_percentiles;
 }
 
+// The histograms keep all the samples, so their tails go one decimal further.
+std::vector<double> GetHistogramPercentiles() {
+  std::vector<double> percentiles = GetPercentiles();
+  if (percentiles.empty() || percentiles.back() < 0.999) {
+    percentiles.push_back(0.999);
+  }
+  return percentiles;
+}
+
 void EmitMetricInfo(const std::string& name, MetricData* data,
                     std::stringstream* ss) {
   double accumulator = 0.0;
@@ -164,6 +223,19 @@ void EmitMetricInfo(const std::string& name, MetricData* data,
     }
   }
 
+  if (data->histogram() != nullptr) {
+    (*ss) << "  Percentiles: ";
+    std::vector<double> percentiles = GetHistogramPercentiles();
+    for (size_t i = 0; i < percentiles.size(); ++i) {
+      if (i > 0) {
+        (*ss) << "; ";
+      }
+      (*ss) << (percentiles[i] * 100.0) << "%="
+            << data->Repr(data->histogram()->Percentile(percentiles[i]));
+    }
+    (*ss) << std::endl;
+    return;
+  }
   const std::vector<double>& metrics_percentiles = GetPercentiles();
   std::sort(
       samples.begin(), samples.end(),
@@ -186,54 +258,257 @@ void EmitCounterInfo(const std::string& name, CounterData* data,
   (*ss) << "  Value: " << data->Value() << std::endl;
 }
 
+// Maps a metric name to the [a-zA-Z_:][a-zA-Z0-9_:]* OpenMetrics alphabet.
+std::string GetOpenMetricsName(const std::string& name) {
+  std::string om_name = "x10_";
+  for (char c : name) {
+    bool valid =
+        std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == ':';
+    om_name.push_back(valid ? c : '_');
+  }
+  return om_name;
+}
+
+// Metrics are exported as summaries, whose quantiles come from the samples
+// held by the metric, and whose sum and count cover all the posted samples.
+void EmitOpenMetricsMetric(const std::string& name, MetricData* data,
+                           std::stringstream* ss) {
+  double accumulator = 0.0;
+  size_t total_samples = 0;
+  std::vector<Sample> samples = data->Samples(&accumulator, &total_samples);
+  std::string om_name = GetOpenMetricsName(name);
+  (*ss) << "# TYPE " << om_name << " summary\n";
+  if (data->histogram() != nullptr) {
+    if (data->histogram()->TotalCount() > 0) {
+      for (double percentile : GetHistogramPercentiles()) {
+        (*ss) << om_name << "{quantile=\"" << absl::StrCat(percentile)
+              << "\"} " << data->histogram()->Percentile(percentile) << "\n";
+      }
+    }
+  } else if (!samples.empty()) {
+    std::sort(
+        samples.begin(), samples.end(),
+        [](const Sample& s1, const Sample& s2) { return s1.value < s2.value; });
+    for (double percentile : GetPercentiles()) {
+      size_t index = percentile * samples.size();
+      (*ss) << om_name << "{quantile=\"" << absl::StrCat(percentile) << "\"} "
+            << samples[index].value << "\n";
+    }
+  }
+  (*ss) << om_name << "_sum " << accumulator << "\n";
+  (*ss) << om_name << "_count " << total_samples << "\n";
+}
+
+void EmitOpenMetricsCounter(const std::string& name, CounterData* data,
+                            std::stringstream* ss) {
+  std::string om_name = GetOpenMetricsName(name);
+  (*ss) << "# TYPE " << om_name << " counter\n";
+  (*ss) << om_name << "_total " << data->Value() << "\n";
+}
+
+size_t GetStepMetricsHistorySize() {
+  static const size_t history_size =
+      sys_util::GetEnvInt("XLA_STEP_METRICS_HISTORY", 16);
+  return history_size;
+}
+
+// Keeps the snapshot taken at the end of the last step, and the deltas of the
+// last steps. The first step covers all the values posted until its end.
+class StepMetricsRecorder {
+ public:
+  static StepMetricsRecorder* Get() {
+    static StepMetricsRecorder* recorder = new StepMetricsRecorder();
+    return recorder;
+  }
+
+  void Record() {
+    size_t history_size = GetStepMetricsHistorySize();
+    if (history_size == 0) {
+      return;
+    }
+    MetricsSnapshot snapshot = CreateMetricsSnapshot();
+    std::lock_guard<std::mutex> lock(lock_);
+    MetricsDelta delta = ComputeMetricsDelta(last_snapshot_, snapshot);
+    delta.step = next_step_++;
+    if (history_.size() >= history_size) {
+      history_.erase(history_.begin());
+    }
+    history_.push_back(std::move(delta));
+    last_snapshot_ = std::move(snapshot);
+  }
+
+  std::vector<MetricsDelta> GetHistory() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return history_;
+  }
+
+ private:
+  StepMetricsRecorder() { last_snapshot_.timestamp_ns = sys_util::NowNs(); }
+
+  std::mutex lock_;
+  MetricsSnapshot last_snapshot_;
+  std::vector<MetricsDelta> history_;
+  int64_t next_step_ = 0;
+};
+
 }  // namespace
 
-MetricData::MetricData(MetricReprFn repr_fn, size_t max_samples)
-    : repr_fn_(std::move(repr_fn)), samples_(max_samples) {}
+size_t GetThreadDataShard() {
+  static std::atomic<size_t> next_shard(0);
+  static thread_local size_t shard = next_shard++ % kNumDataShards;
+  return shard;
+}
+
+HistogramData::HistogramData()
+    : counts_(new std::atomic<uint64_t>[kNumBuckets]) {
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    counts_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+size_t HistogramData::BucketIndex(uint64_t value) {
+  if (value < kSubBuckets) {
+    return value;
+  }
+  // The values with their top bit at position msb go in steps of 2^shift,
+  // which keeps kSubBucketBits significant bits.
+  int msb = tensorflow::Log2Floor64(value);
+  int shift = msb - kSubBucketBits + 1;
+  size_t sub_bucket = (value >> shift) - kSubBuckets / 2;
+  return kSubBuckets + (shift - 1) * (kSubBuckets / 2) + sub_bucket;
+}
+
+double HistogramData::BucketValue(size_t index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+  size_t offset = index - kSubBuckets;
+  int shift = offset / (kSubBuckets / 2) + 1;
+  double step = std::ldexp(1.0, shift);
+  double low = (offset % (kSubBuckets / 2) + kSubBuckets / 2) * step;
+  return low + step / 2;
+}
+
+void HistogramData::AddValue(double value) {
+  static const double kMaxValue = std::ldexp(1.0, 63);
+  uint64_t int_value = 0;
+  if (value >= kMaxValue) {
+    int_value = std::numeric_limits<uint64_t>::max();
+  } else if (value > 0) {
+    int_value = static_cast<uint64_t>(value);
+  }
+  counts_[BucketIndex(int_value)].fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t HistogramData::TotalCount() const {
+  size_t count = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    count += counts_[i].load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+double HistogramData::Percentile(double fraction) const {
+  std::vector<uint64_t> counts(kNumBuckets);
+  uint64_t total = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    counts[i] = counts_[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  if (total == 0) {
+    return 0.0;
+  }
+  uint64_t rank = std::max<uint64_t>(
+      static_cast<uint64_t>(std::ceil(fraction * total)), 1);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    seen += counts[i];
+    if (seen >= rank) {
+      return BucketValue(i);
+    }
+  }
+  return BucketValue(kNumBuckets - 1);
+}
+
+MetricData::MetricData(MetricReprFn repr_fn, size_t max_samples,
+                       bool histogram)
+    : repr_fn_(std::move(repr_fn)),
+      max_samples_(max_samples),
+      histogram_(histogram ? std::make_unique<HistogramData>() : nullptr) {}
 
 void MetricData::AddSample(int64_t timestamp_ns, double value) {
-  std::lock_guard<std::mutex> lock(lock_);
-  size_t position = count_ % samples_.size();
-  ++count_;
-  accumulator_ += value;
-  samples_[position] = Sample(timestamp_ns, value);
+  if (histogram_ != nullptr) {
+    histogram_->AddValue(value);
+  }
+  Shard& shard = shards_[GetThreadDataShard()];
+  std::lock_guard<std::mutex> lock(shard.lock);
+  if (shard.samples.empty()) {
+    shard.samples.resize(max_samples_);
+  }
+  size_t position = shard.count % shard.samples.size();
+  ++shard.count;
+  shard.accumulator += value;
+  shard.samples[position] = Sample(timestamp_ns, value);
 }
 
 double MetricData::Accumulator() const {
-  std::lock_guard<std::mutex> lock(lock_);
-  return accumulator_;
+  double accumulator = 0.0;
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    accumulator += shard.accumulator;
+  }
+  return accumulator;
 }
 
 size_t MetricData::TotalSamples() const {
-  std::lock_guard<std::mutex> lock(lock_);
-  return count_;
+  size_t count = 0;
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    count += shard.count;
+  }
+  return count;
 }
 
 std::vector<Sample> MetricData::Samples(double* accumulator,
                                         size_t* total_samples) const {
-  std::lock_guard<std::mutex> lock(lock_);
   std::vector<Sample> samples;
-  if (count_ <= samples_.size()) {
-    samples.insert(samples.end(), samples_.begin(), samples_.begin() + count_);
-  } else {
-    size_t position = count_ % samples_.size();
-    samples.insert(samples.end(), samples_.begin() + position, samples_.end());
-    samples.insert(samples.end(), samples_.begin(),
-                   samples_.begin() + position);
+  double total_accumulator = 0.0;
+  size_t count = 0;
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    if (shard.count <= shard.samples.size()) {
+      samples.insert(samples.end(), shard.samples.begin(),
+                     shard.samples.begin() + shard.count);
+    } else {
+      samples.insert(samples.end(), shard.samples.begin(), shard.samples.end());
+    }
+    total_accumulator += shard.accumulator;
+    count += shard.count;
+  }
+  // Every shard holds its own most recent samples, so the most recent ones
+  // overall are among them.
+  std::stable_sort(samples.begin(), samples.end(),
+                   [](const Sample& s1, const Sample& s2) {
+                     return s1.timestamp_ns < s2.timestamp_ns;
+                   });
+  if (samples.size() > max_samples_) {
+    samples.erase(samples.begin(), samples.end() - max_samples_);
   }
   if (accumulator != nullptr) {
-    *accumulator = accumulator_;
+    *accumulator = total_accumulator;
   }
   if (total_samples != nullptr) {
-    *total_samples = count_;
+    *total_samples = count;
   }
   return samples;
 }
 
-Metric::Metric(std::string name, MetricReprFn repr_fn, size_t max_samples)
+Metric::Metric(std::string name, MetricReprFn repr_fn, size_t max_samples,
+               bool histogram)
     : name_(std::move(name)),
       repr_fn_(std::move(repr_fn)),
       max_samples_(max_samples),
+      histogram_(histogram),
       data_(nullptr) {}
 
 double Metric::Accumulator() const { return GetData()->Accumulator(); }
@@ -259,7 +534,8 @@ MetricData* Metric::GetData() const {
     // The RegisterMetric() API is a synchronization point, and even if multiple
     // threads enters it, the data will be created only once.
     MetricsArena* arena = MetricsArena::Get();
-    arena->RegisterMetric(name_, repr_fn_, max_samples_, &data_ptr_);
+    arena->RegisterMetric(name_, repr_fn_, max_samples_, histogram_,
+                          &data_ptr_);
     // Even if multiple threads will enter this IF statement, they will all
     // fetch the same value, and hence store the same value below.
     data = data_ptr_.get();
@@ -347,6 +623,93 @@ std::string CreateMetricReport() {
   return ss.str();
 }
 
+std::string CreateOpenMetricsReport() {
+  MetricsArena* arena = MetricsArena::Get();
+  std::stringstream ss;
+  ss.precision(17);
+  arena->ForEachMetric([&ss](const std::string& name, MetricData* data) {
+    EmitOpenMetricsMetric(name, data, &ss);
+  });
+  arena->ForEachCounter([&ss](const std::string& name, CounterData* data) {
+    EmitOpenMetricsCounter(name, data, &ss);
+  });
+  ss << "# EOF\n";
+  return ss.str();
+}
+
+MetricsSnapshot CreateMetricsSnapshot() {
+  MetricsArena* arena = MetricsArena::Get();
+  MetricsSnapshot snapshot;
+  snapshot.timestamp_ns = sys_util::NowNs();
+  arena->ForEachMetric([&](const std::string& name, MetricData* data) {
+    MetricsSnapshot::MetricValue& value = snapshot.metrics[name];
+    value.accumulator = data->Accumulator();
+    value.total_samples = data->TotalSamples();
+  });
+  arena->ForEachCounter([&](const std::string& name, CounterData* data) {
+    snapshot.counters[name] = data->Value();
+  });
+  return snapshot;
+}
+
+MetricsDelta ComputeMetricsDelta(const MetricsSnapshot& before,
+                                 const MetricsSnapshot& after) {
+  MetricsDelta delta;
+  delta.start_ns = before.timestamp_ns;
+  delta.end_ns = after.timestamp_ns;
+  for (auto& name_value : after.metrics) {
+    MetricsSnapshot::MetricValue value = name_value.second;
+    auto it = before.metrics.find(name_value.first);
+    if (it != before.metrics.end()) {
+      value.accumulator -= it->second.accumulator;
+      value.total_samples -= it->second.total_samples;
+    }
+    if (value.total_samples > 0) {
+      delta.metrics.emplace(name_value.first, value);
+    }
+  }
+  for (auto& name_value : after.counters) {
+    int64_t value = name_value.second;
+    auto it = before.counters.find(name_value.first);
+    if (it != before.counters.end()) {
+      value -= it->second;
+    }
+    if (value != 0) {
+      delta.counters.emplace(name_value.first, value);
+    }
+  }
+  return delta;
+}
+
+std::string CreateMetricsDeltaReport(const MetricsDelta& delta) {
+  std::stringstream ss;
+  if (delta.step >= 0) {
+    ss << "Step: " << delta.step << std::endl;
+  }
+  ss << "  Duration: " << MetricFnTime(delta.end_ns - delta.start_ns)
+     << std::endl;
+  for (auto& name_value : delta.metrics) {
+    MetricData* data = GetMetric(name_value.first);
+    ss << "Metric: " << name_value.first << std::endl;
+    ss << "  TotalSamples: " << name_value.second.total_samples << std::endl;
+    ss << "  Accumulator: "
+       << (data != nullptr ? data->Repr(name_value.second.accumulator)
+                           : MetricFnValue(name_value.second.accumulator))
+       << std::endl;
+  }
+  for (auto& name_value : delta.counters) {
+    ss << "Counter: " << name_value.first << std::endl;
+    ss << "  Value: " << name_value.second << std::endl;
+  }
+  return ss.str();
+}
+
+void RecordStepMetrics() { StepMetricsRecorder::Get()->Record(); }
+
+std::vector<MetricsDelta> GetStepMetricsHistory() {
+  return StepMetricsRecorder::Get()->GetHistory();
+}
+
 std::vector<std::string> GetMetricNames() {
   return MetricsArena::Get()->GetMetricNames();
 }
@@ -18,6 +18,7 @@
 #define X10_XLA_CLIENT_METRICS_H_
 
 #include <atomic>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -25,6 +26,7 @@
 
 #include "absl/strings/str_cat.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/trace_recorder.h"
 #include "tensorflow/compiler/xla/types.h"
 
 namespace xla {
@@ -41,14 +43,59 @@ struct Sample {
 
 using MetricReprFn = std::function<std::string(double)>;
 
+// Number of shards the metrics and counters data is spread over, so that
+// threads posting values to the same metric rarely contend.
+constexpr size_t kNumDataShards = 8;
+
+// Returns the shard index, in [0, kNumDataShards), the calling thread posts
+// metric and counter values to.
+size_t GetThreadDataShard();
+
+// Histogram of non-negative values, over log-linear buckets: each power of two
+// range is split into linear buckets, so that the value reported for a bucket
+// is within 1/64 of the values recorded into it. The memory is constant and
+// the recording lock free, so the histogram can cover all the values posted
+// over a run. Negative values are recorded as zero.
+class HistogramData {
+ public:
+  HistogramData();
+
+  void AddValue(double value);
+
+  size_t TotalCount() const;
+
+  // Returns the value which the given fraction, in [0, 1], of the recorded
+  // values do not exceed.
+  double Percentile(double fraction) const;
+
+ private:
+  static constexpr int kSubBucketBits = 7;
+  static constexpr size_t kSubBuckets = size_t{1} << kSubBucketBits;
+  static constexpr size_t kNumBuckets =
+      kSubBuckets + (64 - kSubBucketBits) * (kSubBuckets / 2);
+
+  static size_t BucketIndex(uint64_t value);
+
+  // Returns the midpoint of the values falling into the bucket.
+  static double BucketValue(size_t index);
+
+  std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+};
+
+constexpr size_t kDefaultMaxSamples = 1024;
+
 // Class used to collect time-stamped numeric samples. The samples are stored in
 // a circular buffer whose size can be configured at constructor time.
 class MetricData {
  public:
-  // Creates a new MetricData object with the internal circular buffer storing
+  // Creates a new MetricData object with the internal circular buffers storing
   // max_samples samples. The repr_fn argument allow to specify a function which
-  // pretty-prints a sample value.
-  MetricData(MetricReprFn repr_fn, size_t max_samples);
+  // pretty-prints a sample value. Every thread shard has its own buffer, which
+  // gets allocated when the shard receives its first sample, and the buffers
+  // are merged when the samples are read. With histogram set, the samples also
+  // go into a histogram which the reports take the percentiles from, so that
+  // they cover the whole run instead of the last samples.
+  MetricData(MetricReprFn repr_fn, size_t max_samples, bool histogram = false);
 
   // Returns the total values of all the samples being posted to this metric.
   double Accumulator() const;
@@ -65,26 +112,48 @@ class MetricData {
 
   std::string Repr(double value) const { return repr_fn_(value); }
 
+  // Returns the histogram of all the samples, or nullptr if the metric has
+  // none.
+  const HistogramData* histogram() const { return histogram_.get(); }
+
  private:
-  mutable std::mutex lock_;
+  struct alignas(64) Shard {
+    mutable std::mutex lock;
+    size_t count = 0;
+    std::vector<Sample> samples;
+    double accumulator = 0.0;
+  };
+
   MetricReprFn repr_fn_;
-  size_t count_ = 0;
-  std::vector<Sample> samples_;
-  double accumulator_ = 0.0;
+  size_t max_samples_;
+  Shard shards_[kNumDataShards];
+  std::unique_ptr<HistogramData> histogram_;
 };
 
 // Counters are a very lightweight form of metrics which do not need to track
-// sample time.
+// sample time. The value is striped over per thread shards, and summed when
+// read.
 class CounterData {
  public:
-  CounterData() : value_(0) {}
-
-  void AddValue(int64_t value) { value_ += value; }
+  void AddValue(int64_t value) {
+    shards_[GetThreadDataShard()].value.fetch_add(value,
+                                                  std::memory_order_relaxed);
+  }
 
-  int64_t Value() const { return value_; }
+  int64_t Value() const {
+    int64_t value = 0;
+    for (auto& shard : shards_) {
+      value += shard.value.load(std::memory_order_relaxed);
+    }
+    return value;
+  }
 
  private:
-  std::atomic<int64_t> value_;
+  struct alignas(64) Shard {
+    std::atomic<int64_t> value{0};
+  };
+
+  Shard shards_[kNumDataShards];
 };
 
 // Emits the value in a to_string() conversion.
@@ -107,7 +176,8 @@ std::string MetricFnTime(double value);
 class Metric {
  public:
   explicit Metric(std::string name, MetricReprFn repr_fn = MetricFnValue,
-                  size_t max_samples = 1024);
+                  size_t max_samples = kDefaultMaxSamples,
+                  bool histogram = false);
 
   const std::string& Name() const { return name_; }
 
@@ -127,6 +197,7 @@ class Metric {
   std::string name_;
   MetricReprFn repr_fn_;
   size_t max_samples_;
+  bool histogram_;
   mutable std::shared_ptr<MetricData> data_ptr_;
   mutable std::atomic<MetricData*> data_;
 };
@@ -172,6 +243,13 @@ class Counter {
 // Creates a report with the current metrics statistics.
 std::string CreateMetricReport();
 
+// Creates a report with the current metrics statistics in the OpenMetrics text
+// format, where the metrics are summaries and the counters are counters, all of
+// them with their name prefixed by x10_. The values are the raw ones, so the
+// times are in nanoseconds. If the XLA_METRICS_EXPORT_FILE environment variable
+// is set, the report is periodically written to that file.
+std::string CreateOpenMetricsReport();
+
 // Returns the currently registered metric names. Note that the list can grow
 // since metrics are usualy function intialized (they are static function
 // variables).
@@ -190,6 +268,45 @@ std::vector<std::string> GetCounterNames();
 // does not exist.
 CounterData* GetCounter(const std::string& name);
 
+// The values of all the metrics and counters at a point in time.
+struct MetricsSnapshot {
+  struct MetricValue {
+    double accumulator = 0.0;
+    size_t total_samples = 0;
+  };
+
+  int64_t timestamp_ns = 0;
+  std::map<std::string, MetricValue> metrics;
+  std::map<std::string, int64_t> counters;
+};
+
+// What changed in the metrics and counters between two snapshots. Only the
+// ones which changed are listed.
+struct MetricsDelta {
+  int64_t start_ns = 0;
+  int64_t end_ns = 0;
+  // The index of the step the delta covers, for the deltas recorded by
+  // RecordStepMetrics().
+  int64_t step = -1;
+  std::map<std::string, MetricsSnapshot::MetricValue> metrics;
+  std::map<std::string, int64_t> counters;
+};
+
+MetricsSnapshot CreateMetricsSnapshot();
+
+MetricsDelta ComputeMetricsDelta(const MetricsSnapshot& before,
+                                 const MetricsSnapshot& after);
+
+// Creates a report of the changes, in the format of CreateMetricReport().
+std::string CreateMetricsDeltaReport(const MetricsDelta& delta);
+
+// Ends a step, recording what changed since the previous one into a ring
+// buffer holding the last XLA_STEP_METRICS_HISTORY steps.
+void RecordStepMetrics();
+
+// Returns the deltas of the steps held by the ring buffer, from the oldest.
+std::vector<MetricsDelta> GetStepMetricsHistory();
+
 // Scope based utility class to measure the time the code takes within a given
 // C++ scope.
 class TimedSection {
@@ -200,6 +317,9 @@ class TimedSection {
   ~TimedSection() {
     int64_t now = sys_util::NowNs();
     metric_->AddSample(now, now - start_);
+    if (trace::IsRecording()) {
+      trace::RecordEvent(metric_->Name(), start_, now);
+    }
   }
 
   double Elapsed() const {
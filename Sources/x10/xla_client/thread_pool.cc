@@ -14,106 +14,359 @@
 
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <deque>
 #include <exception>
 #include <mutex>
+#include <string>
+#include <vector>
 
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#include "tensorflow/core/platform/numa.h"
 
 namespace xla {
 namespace env {
 namespace {
 
+using Task = std::function<void()>;
+
+// Fixed capacity Chase-Lev deque. The owner thread pushes and pops at the
+// bottom, while the other threads steal from the top.
+class WorkStealingDeque {
+ public:
+  static constexpr int64_t kCapacity = 1024;
+
+  // Returns false if the deque is full. Owner only.
+  bool Push(Task* task) {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    int64_t top = top_.load(std::memory_order_acquire);
+    if (bottom - top >= kCapacity) {
+      return false;
+    }
+    buffer_[bottom & kMask].store(task, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Owner only.
+  Task* Pop() {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    Task* task = buffer_[bottom & kMask].load(std::memory_order_relaxed);
+    if (top == bottom) {
+      // Last element, race against the thieves for it.
+      if (!top_.compare_exchange_strong(top, top + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        task = nullptr;
+      }
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return task;
+  }
+
+  Task* Steal() {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = bottom_.load(std::memory_order_acquire);
+    if (top >= bottom) {
+      return nullptr;
+    }
+    Task* task = buffer_[top & kMask].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return task;
+  }
+
+ private:
+  static constexpr int64_t kMask = kCapacity - 1;
+
+  std::atomic<int64_t> top_{0};
+  std::atomic<int64_t> bottom_{0};
+  std::atomic<Task*> buffer_[kCapacity] = {};
+};
+
+// Thread pool where every worker has its own deque, which receives the
+// closures it schedules itself, and steals from the other workers when out of
+// work. Closures scheduled from outside the pool go to a shared queue.
 class ThreadPool {
  public:
-  explicit ThreadPool(size_t num_threads) {
-    threads_.reserve(num_threads);
-    for (size_t i = 0; i < num_threads; ++i) {
-      threads_.emplace_back([this]() { Worker(); });
+  ThreadPool(std::string name, size_t num_threads, size_t max_threads)
+      : num_threads_(std::max<size_t>(num_threads, 1)),
+        max_threads_(std::max(max_threads, num_threads_)),
+        workers_(max_threads_),
+        queue_depth_metric_(name + "QueueDepth"),
+        spawns_counter_(name + "ThreadSpawns"),
+        steals_counter_(name + "Steals") {
+    std::lock_guard<std::mutex> lock(mutex_);
+    threads_.reserve(num_threads_);
+    for (size_t i = 0; i < num_threads_; ++i) {
+      Worker* worker = AcquireWorker();
+      threads_.emplace_back([this, worker]() { Run(worker, /*core=*/true); });
     }
   }
 
   ~ThreadPool() {
     {
-      std::lock_guard<std::mutex> lock(mutex_);
+      std::unique_lock<std::mutex> lock(mutex_);
       exiting_ = true;
       cv_.notify_all();
+      exit_cv_.wait(lock, [this] { return extra_threads_ == 0; });
     }
     for (auto& thread : threads_) {
       thread.join();
     }
+    for (auto& worker : workers_) {
+      delete worker.load();
+    }
   }
 
   void Schedule(std::function<void()> closure) {
-    // If we have more work scheduled than waiting worker threads, just schedule
-    // it on a separate thread. This prevents tricky thread-pool-size-deadlocks
-    // caused by an undersized thread pool and closures that end up doing sync
-    // waits on the pool threads.
-    bool scheduled = false;
-    {
-      std::lock_guard<std::mutex> lock(mutex_);
-      if (work_.size() < waiting_) {
-        work_.emplace_back(std::move(closure));
-        scheduled = true;
-      }
+    Task* task = new Task(std::move(closure));
+    if (tls_pool_ != this || !tls_worker_->deque.Push(task)) {
+      std::lock_guard<std::mutex> lock(queue_mutex_);
+      queue_.push_back(task);
     }
-    if (scheduled) {
+    size_t pending = pending_.fetch_add(1) + 1;
+    queue_depth_metric_.AddSample(pending);
+
+    // If we have more work scheduled than waiting worker threads, grow the pool
+    // with a new worker. This prevents tricky thread-pool-size-deadlocks caused
+    // by an undersized thread pool and closures that end up doing sync waits
+    // on the pool threads. Unlike a thread per closure, the new workers stick
+    // around for a while, and the pool only grows up to max_threads_.
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (parked_ > signaled_) {
+      ++signaled_;
       cv_.notify_one();
-    } else {
-      ScheduleOnThread(std::move(closure));
+    } else if (num_running_ < max_threads_ && !exiting_) {
+      Worker* worker = AcquireWorker();
+      ++extra_threads_;
+      spawns_counter_.AddValue(1);
+      std::thread thread([this, worker]() { Run(worker, /*core=*/false); });
+      thread.detach();
     }
   }
 
  private:
-  void Worker() {
+  struct Worker {
+    WorkStealingDeque deque;
+    bool in_use = false;
+  };
+
+  // Extra workers exit after having been idle for this long.
+  static constexpr std::chrono::seconds kIdleTimeout{5};
+
+  Worker* AcquireWorker() {
+    for (size_t i = 0; i < num_slots_.load(); ++i) {
+      Worker* worker = workers_[i].load();
+      if (!worker->in_use) {
+        worker->in_use = true;
+        ++num_running_;
+        return worker;
+      }
+    }
+    size_t slot = num_slots_.load();
+    Worker* worker = new Worker();
+    worker->in_use = true;
+    workers_[slot].store(worker);
+    num_slots_.store(slot + 1);
+    ++num_running_;
+    return worker;
+  }
+
+  void Run(Worker* worker, bool core) {
+    BindThreadToCpuNumaNode();
+    tls_pool_ = this;
+    tls_worker_ = worker;
     while (true) {
-      std::function<void()> closure = GetWork();
-      if (closure == nullptr) {
+      Task* task = GetWork(worker);
+      if (task != nullptr) {
+        pending_.fetch_sub(1);
+        (*task)();
+        delete task;
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(mutex_);
+      // The schedulers bump pending_ before taking the mutex, so either work
+      // shows up here, or they will see this worker as parked.
+      if (pending_.load() > 0) {
+        continue;
+      }
+      if (exiting_) {
+        break;
+      }
+      ++parked_;
+      auto ready = [this] { return signaled_ > 0 || exiting_; };
+      bool woken = true;
+      if (core) {
+        cv_.wait(lock, ready);
+      } else {
+        woken = cv_.wait_for(lock, kIdleTimeout, ready);
+      }
+      --parked_;
+      if (signaled_ > 0) {
+        --signaled_;
+      } else if (!woken && pending_.load() == 0) {
         break;
       }
-      closure();
+    }
+    if (!core) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ReleaseWorker(worker);
+      --extra_threads_;
+      exit_cv_.notify_all();
     }
   }
 
-  void ScheduleOnThread(std::function<void()> closure) {
-    std::thread thread(std::move(closure));
-    thread.detach();
+  void ReleaseWorker(Worker* worker) {
+    worker->in_use = false;
+    --num_running_;
   }
 
-  std::function<void()> GetWork() {
-    std::unique_lock<std::mutex> lock(mutex_);
-    ++waiting_;
-    cv_.wait(lock, [this] { return exiting_ || !work_.empty(); });
-    --waiting_;
-    if (work_.empty()) {
-      return nullptr;
+  Task* GetWork(Worker* worker) {
+    Task* task = worker->deque.Pop();
+    if (task != nullptr) {
+      return task;
     }
-    std::function<void()> closure(std::move(work_.front()));
-    work_.pop_front();
-    return closure;
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex_);
+      if (!queue_.empty()) {
+        task = queue_.front();
+        queue_.pop_front();
+        return task;
+      }
+    }
+    size_t num_slots = num_slots_.load();
+    size_t start = reinterpret_cast<uintptr_t>(worker) % num_slots;
+    for (size_t i = 0; i < num_slots; ++i) {
+      Worker* victim = workers_[(start + i) % num_slots].load();
+      if (victim != worker && (task = victim->deque.Steal()) != nullptr) {
+        steals_counter_.AddValue(1);
+        return task;
+      }
+    }
+    return nullptr;
   }
 
-  std::vector<std::thread> threads_;
+  static thread_local ThreadPool* tls_pool_;
+  static thread_local Worker* tls_worker_;
+
+  const size_t num_threads_;
+  const size_t max_threads_;
+  std::vector<std::atomic<Worker*>> workers_;
+  std::atomic<size_t> num_slots_{0};
+  std::atomic<size_t> pending_{0};
+  metrics::Metric queue_depth_metric_;
+  metrics::Counter spawns_counter_;
+  metrics::Counter steals_counter_;
+
+  std::mutex queue_mutex_;
+  std::deque<Task*> queue_;
+
   std::mutex mutex_;
   std::condition_variable cv_;
+  std::condition_variable exit_cv_;
+  std::vector<std::thread> threads_;
+  size_t num_running_ = 0;
+  size_t extra_threads_ = 0;
+  size_t parked_ = 0;
+  size_t signaled_ = 0;
   bool exiting_ = false;
-  std::deque<std::function<void()>> work_;
-  size_t waiting_ = 0;
 };
 
+thread_local ThreadPool* ThreadPool::tls_pool_ = nullptr;
+thread_local ThreadPool::Worker* ThreadPool::tls_worker_ = nullptr;
+constexpr std::chrono::seconds ThreadPool::kIdleTimeout;
+
+// How the cores get split between the intra-op threads of the XLA CPU backend
+// and the pools here. Without XLA_CPU_THREAD_BUDGET all of them size
+// themselves to every core, which oversubscribes the host when CPU computations
+// run alongside the pool closures.
+struct CpuThreadBudget {
+  int numa_node = tensorflow::port::kNUMANoAffinity;
+  // Zero keeps the XLA default of one intra-op thread per core.
+  int intra_op_threads = 0;
+  size_t compute_threads = 0;
+  size_t io_threads = 0;
+};
+
+CpuThreadBudget* CreateCpuThreadBudget() {
+  CpuThreadBudget* budget = new CpuThreadBudget();
+  size_t num_cores = std::thread::hardware_concurrency();
+  int numa_node = sys_util::GetEnvInt("XLA_CPU_NUMA_NODE",
+                                      tensorflow::port::kNUMANoAffinity);
+  if (numa_node != tensorflow::port::kNUMANoAffinity) {
+    if (!tensorflow::port::NUMAEnabled() || numa_node < 0 ||
+        numa_node >= tensorflow::port::NUMANumNodes()) {
+      TF_LOG(WARNING) << "Ignoring XLA_CPU_NUMA_NODE=" << numa_node
+                      << ", the host has "
+                      << tensorflow::port::NUMANumNodes()
+                      << " usable NUMA nodes";
+    } else {
+      budget->numa_node = numa_node;
+      num_cores = std::max<size_t>(
+          num_cores / tensorflow::port::NUMANumNodes(), 1);
+    }
+  }
+  budget->compute_threads = num_cores;
+  budget->io_threads = num_cores;
+  if (sys_util::GetEnvBool("XLA_CPU_THREAD_BUDGET", false)) {
+    // The intra-op threads run the bulk of the work, the pools mostly feed
+    // them. The IO pool threads spend their time waiting, so they can share
+    // the cores of the compute pool.
+    budget->intra_op_threads = std::max<int64_t>(
+        sys_util::GetEnvInt("XLA_INTRA_OP_THREADS", num_cores * 3 / 4), 1);
+    budget->compute_threads = std::max<int64_t>(
+        static_cast<int64_t>(num_cores) - budget->intra_op_threads, 1);
+    budget->io_threads = budget->compute_threads;
+  }
+  TF_VLOG(1) << "CPU thread budget: NUMA node " << budget->numa_node << ", "
+             << budget->intra_op_threads << " intra-op threads, "
+             << budget->compute_threads << " compute threads, "
+             << budget->io_threads << " IO threads";
+  return budget;
+}
+
+const CpuThreadBudget& GetCpuThreadBudget() {
+  static CpuThreadBudget* budget = CreateCpuThreadBudget();
+  return *budget;
+}
+
+size_t GetMaxThreads() {
+  static size_t max_threads =
+      sys_util::GetEnvInt("XLA_THREAD_POOL_MAX_SIZE", 1024);
+  return max_threads;
+}
+
 ThreadPool* GetThreadPool() {
   static size_t num_threads = sys_util::GetEnvInt(
-      "XLA_THREAD_POOL_SIZE", std::thread::hardware_concurrency());
-  static ThreadPool* pool = new ThreadPool(num_threads);
+      "XLA_THREAD_POOL_SIZE", GetCpuThreadBudget().compute_threads);
+  static ThreadPool* pool =
+      new ThreadPool("ThreadPool", num_threads, GetMaxThreads());
   return pool;
 }
 
 ThreadPool* GetIoThreadPool() {
   static size_t num_threads = sys_util::GetEnvInt(
-      "XLA_IO_THREAD_POOL_SIZE", std::thread::hardware_concurrency());
-  static ThreadPool* pool = new ThreadPool(num_threads);
+      "XLA_IO_THREAD_POOL_SIZE", GetCpuThreadBudget().io_threads);
+  static ThreadPool* pool =
+      new ThreadPool("IoThreadPool", num_threads, GetMaxThreads());
   return pool;
 }
 
@@ -163,6 +416,15 @@ Completion::~Completion() {}
 
 void Completion::Wait() { data_->Wait(); }
 
+int GetCpuIntraOpThreads() { return GetCpuThreadBudget().intra_op_threads; }
+
+void BindThreadToCpuNumaNode() {
+  int numa_node = GetCpuThreadBudget().numa_node;
+  if (numa_node != tensorflow::port::kNUMANoAffinity) {
+    tensorflow::port::NUMASetThreadNodeAffinity(numa_node);
+  }
+}
+
 void ScheduleClosure(std::function<void()> closure) {
   GetThreadPool()->Schedule(std::move(closure));
 }
@@ -38,6 +38,14 @@ class Completion {
   std::shared_ptr<Data> data_;
 };
 
+// Returns the number of intra-op threads the XLA CPU backend should use, out of
+// the XLA_CPU_THREAD_BUDGET split, or zero to keep its default.
+int GetCpuIntraOpThreads();
+
+// Binds the calling thread to the NUMA node selected with XLA_CPU_NUMA_NODE, if
+// any. The threads it creates afterwards inherit the binding.
+void BindThreadToCpuNumaNode();
+
 // Schedules a closure to be run. The closure should not block waiting for other
 // events.
 void ScheduleClosure(std::function<void()> closure);
@@ -0,0 +1,184 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/xla/xla_client/trace_recorder.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+
+namespace xla {
+namespace trace {
+
+std::atomic<bool> g_recording(false);
+
+namespace {
+
+struct Event {
+  std::string name;
+  int64_t start_ns = 0;
+  int64_t end_ns = 0;
+};
+
+// The events of a thread. The lock is only contended while exporting.
+struct ThreadEvents {
+  explicit ThreadEvents(int64_t tid) : tid(tid) {}
+
+  std::mutex lock;
+  int64_t tid;
+  std::vector<Event> events;
+};
+
+struct Recorder {
+  std::mutex lock;
+  std::vector<std::shared_ptr<ThreadEvents>> threads;
+};
+
+Recorder* GetRecorder() {
+  static Recorder* recorder = new Recorder();
+  return recorder;
+}
+
+size_t GetMaxThreadEvents() {
+  static const size_t max_events =
+      sys_util::GetEnvInt("XLA_TRACE_MAX_EVENTS", 1000000);
+  return max_events;
+}
+
+ThreadEvents* GetThreadEvents() {
+  // The recorder shares the ownership, so that the events of the threads which
+  // exit before the export do not get lost.
+  static thread_local std::shared_ptr<ThreadEvents> thread_events;
+  if (thread_events == nullptr) {
+    Recorder* recorder = GetRecorder();
+    std::lock_guard<std::mutex> lock(recorder->lock);
+    thread_events = std::make_shared<ThreadEvents>(recorder->threads.size());
+    recorder->threads.push_back(thread_events);
+  }
+  return thread_events.get();
+}
+
+void AppendJsonString(absl::string_view text, std::string* json) {
+  json->push_back('"');
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      json->push_back('\\');
+      json->push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      json->push_back(' ');
+    } else {
+      json->push_back(c);
+    }
+  }
+  json->push_back('"');
+}
+
+void WriteTraceFile() {
+  std::string path = sys_util::GetEnvString("XLA_TRACE_FILE", "");
+  std::ofstream file(path);
+  if (!file) {
+    TF_LOG(ERROR) << "Unable to write the trace file: " << path;
+    return;
+  }
+  file << StopRecording();
+  TF_VLOG(1) << "Trace written to " << path;
+}
+
+bool MaybeStartRecordingFromEnv() {
+  if (sys_util::GetEnvString("XLA_TRACE_FILE", "").empty()) {
+    return false;
+  }
+  StartRecording();
+  std::atexit(WriteTraceFile);
+  return true;
+}
+
+const bool g_recording_from_env = MaybeStartRecordingFromEnv();
+
+}  // namespace
+
+void StartRecording() {
+  Recorder* recorder = GetRecorder();
+  std::lock_guard<std::mutex> lock(recorder->lock);
+  for (auto& thread_events : recorder->threads) {
+    std::lock_guard<std::mutex> thread_lock(thread_events->lock);
+    thread_events->events.clear();
+  }
+  g_recording.store(true);
+}
+
+std::string StopRecording() {
+  g_recording.store(false);
+  // Timestamps are relative to the earliest event, as microseconds since the
+  // epoch lose precision once stored as doubles by the trace viewers.
+  std::vector<std::pair<int64_t, std::vector<Event>>> thread_events;
+  int64_t base_ns = -1;
+  {
+    Recorder* recorder = GetRecorder();
+    std::lock_guard<std::mutex> lock(recorder->lock);
+    for (auto& events : recorder->threads) {
+      std::lock_guard<std::mutex> thread_lock(events->lock);
+      if (events->events.empty()) {
+        continue;
+      }
+      for (auto& event : events->events) {
+        if (base_ns < 0 || event.start_ns < base_ns) {
+          base_ns = event.start_ns;
+        }
+      }
+      thread_events.emplace_back(events->tid, std::move(events->events));
+      events->events.clear();
+    }
+  }
+  std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for (auto& tid_events : thread_events) {
+    absl::StrAppend(&json, first ? "" : ",",
+                    "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                    "\"tid\":",
+                    tid_events.first, ",\"args\":{\"name\":\"Thread ",
+                    tid_events.first, "\"}}");
+    first = false;
+    for (auto& event : tid_events.second) {
+      json += ",\n{\"name\":";
+      AppendJsonString(event.name, &json);
+      absl::StrAppend(&json, ",\"ph\":\"X\",\"pid\":0,\"tid\":",
+                      tid_events.first,
+                      ",\"ts\":", (event.start_ns - base_ns) / 1000.0,
+                      ",\"dur\":", (event.end_ns - event.start_ns) / 1000.0,
+                      "}");
+    }
+  }
+  json += "\n]}\n";
+  return json;
+}
+
+void RecordEvent(absl::string_view name, int64_t start_ns, int64_t end_ns) {
+  ThreadEvents* thread_events = GetThreadEvents();
+  std::lock_guard<std::mutex> lock(thread_events->lock);
+  if (thread_events->events.size() >= GetMaxThreadEvents()) {
+    XLA_COUNTER("TraceEventsDropped", 1);
+    return;
+  }
+  thread_events->events.push_back({std::string(name), start_ns, end_ns});
+}
+
+}  // namespace trace
+}  // namespace xla
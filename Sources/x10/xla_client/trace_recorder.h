@@ -0,0 +1,76 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef X10_XLA_CLIENT_TRACE_RECORDER_H_
+#define X10_XLA_CLIENT_TRACE_RECORDER_H_
+
+#include <atomic>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "tensorflow/compiler/xla/types.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace xla {
+namespace trace {
+
+// Records timed events on per thread tracks, and exports them in the Chrome
+// trace JSON format, which chrome://tracing and Perfetto can load. Recording
+// is off by default, and starts either with StartRecording() or, if the
+// XLA_TRACE_FILE environment variable is set, at startup, in which case the
+// trace gets written to that file at exit.
+
+extern std::atomic<bool> g_recording;
+
+inline bool IsRecording() {
+  return g_recording.load(std::memory_order_relaxed);
+}
+
+// Drops the events recorded so far, and starts recording.
+void StartRecording();
+
+// Stops the recording and returns the recorded events as Chrome trace JSON.
+std::string StopRecording();
+
+// Records an event which ran from start_ns to end_ns (as returned by
+// sys_util::NowNs()) on the calling thread.
+void RecordEvent(absl::string_view name, int64_t start_ns, int64_t end_ns);
+
+// Records an event spanning the lifetime of the object.
+class ScopedEvent {
+ public:
+  explicit ScopedEvent(absl::string_view name) {
+    if (IsRecording()) {
+      name_ = std::string(name);
+      start_ns_ = sys_util::NowNs();
+    }
+  }
+
+  ~ScopedEvent() {
+    if (start_ns_ >= 0 && IsRecording()) {
+      RecordEvent(name_, start_ns_, sys_util::NowNs());
+    }
+  }
+
+ private:
+  std::string name_;
+  int64_t start_ns_ = -1;
+};
+
+}  // namespace trace
+}  // namespace xla
+
+#endif  // X10_XLA_CLIENT_TRACE_RECORDER_H_
@@ -76,10 +76,15 @@ void ReportComputationError(
     absl::Span<const Shape* const> output_shapes) {
   std::stringstream ss;
   for (size_t i = 0; i < computations.size(); ++i) {
-    std::string hlo_text = GetComputationHloText(*computations[i]).ValueOrDie();
-    MaybeSaveHloGraph(hlo_text, i);
+    // The HLO of the computations released after compile can be missing.
+    StatusOr<std::string> hlo_text = GetComputationHloText(*computations[i]);
     ss << ">>> Dumping Computation " << i << "\n";
-    ss << hlo_text << "\n";
+    if (hlo_text.ok()) {
+      MaybeSaveHloGraph(hlo_text.ValueOrDie(), i);
+      ss << hlo_text.ValueOrDie() << "\n";
+    } else {
+      ss << "HLO not available: " << hlo_text.status() << "\n";
+    }
     if (i < output_shapes.size() && output_shapes[i] != nullptr) {
       ss << "OutputShape: " << *output_shapes[i] << "\n\n";
     }
@@ -107,5 +112,11 @@ hash_t ShapeHash(const Shape& shape) {
   return hash;
 }
 
+void SetFastCompileOptions(DebugOptions* debug_options) {
+  debug_options->set_xla_backend_optimization_level(0);
+  debug_options->set_xla_llvm_disable_expensive_passes(true);
+  debug_options->set_xla_gpu_autotune_level(0);
+}
+
 }  // namespace util
 }  // namespace xla
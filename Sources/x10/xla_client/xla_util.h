@@ -49,6 +49,11 @@ void CheckComputationStatus(
 
 hash_t ShapeHash(const Shape& shape);
 
+// Lowers the backend optimization level and disables the autotuning and the
+// expensive LLVM passes, which trades the run time of the compiled computation
+// for its compile time.
+void SetFastCompileOptions(DebugOptions* debug_options);
+
 }  // namespace util
 }  // namespace xla
 
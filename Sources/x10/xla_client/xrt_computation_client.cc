@@ -14,19 +14,27 @@
 
 #include "tensorflow/compiler/xla/xla_client/xrt_computation_client.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <functional>
+#include <future>
 #include <limits>
 #include <list>
 #include <sstream>
+#include <thread>
 #include <unordered_map>
 
-#include "absl/container/node_hash_map.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/xla_client/device_activity.h"
 #include "tensorflow/compiler/xla/xla_client/env_vars.h"
 #include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
@@ -38,11 +46,18 @@
 #include "tensorflow/compiler/xla/xla_client/local_device.h"
 #include "tensorflow/compiler/xrt/xrt_util.h"
 #include "tensorflow/cc/ops/const_op.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/debug_options_flags.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/util.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/lib/core/bits.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/hash.h"
 #include "tensorflow/core/platform/net.h"
+#include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/protobuf/cluster.pb.h"
 #include "tensorflow/core/util/device_name_utils.h"
 
@@ -64,6 +79,9 @@ class XrtComputationClient::XrtDevice : public ComputationClient::Device {
   std::vector<DataPtr> TransferToServer(
       absl::Span<const TensorSource> tensors) override;
 
+  std::vector<DataPtr> TransferToServerPartitioned(
+      absl::Span<const TensorSource> tensors);
+
   std::vector<ComputationClient::ComputationPtr> Compile(
       const std::vector<std::string>& devices,
       std::vector<CompileInstance> instances) override {
@@ -89,6 +107,14 @@ class XrtComputationClient::XrtDevice : public ComputationClient::Device {
     return client_;
   }
 
+  int32_t host_id() const override {
+    return client_->GetWorkerForDevice(name()).first.task_no;
+  }
+
+  MemoryInfo GetMemoryInfo() override {
+    return client_->GetMemoryInfo(name());
+  }
+
   XrtComputationClient* computation_client() const { return client_; }
 
  private:
@@ -135,128 +161,263 @@ struct TensorAllocatorTraits {
   }
 };
 
-// A simple Tensorflow Allocator which caches Tensor allocations in order to
-// avoid paying the kernel's clear_page_c() price.
+// A Tensorflow Allocator which caches Tensor allocations in order to avoid
+// paying the kernel's clear_page_c() price. The sizes get rounded up to size
+// classes, four per power of two, so that tensors of close sizes (like the
+// ones of variable size batches) share their blocks, at a cost of at most 25%
+// of wasted memory. Every thread keeps a small cache of the blocks it frees,
+// which it allocates from without locking, and which overflows into the shared
+// cache of the NUMA node the block belongs to. The threads bound to a NUMA
+// node allocate their blocks on it.
 class TensorAllocator : public tensorflow::Allocator {
-  struct AllocKey {
-    struct Hash {
-      size_t operator()(const AllocKey& hk) const {
-        return util::StdHashCombine(hk.alignment, hk.num_bytes);
-      }
-    };
-
-    bool operator==(const AllocKey& rhs) const {
-      return num_bytes == rhs.num_bytes && alignment == rhs.alignment;
-    }
-
-    size_t alignment = 0;
+  static constexpr size_t kBlockAlignment = 64;
+  static constexpr size_t kNumClasses = 1 + 4 * (64 - 6);
+  static constexpr uint32_t kUncachedClass = kNumClasses;
+  static constexpr size_t kThreadCacheBlocks = 4;
+
+  // Lives right before the user memory.
+  struct BlockHeader {
+    uint32_t size_class = kUncachedClass;
+    int32_t node = tensorflow::port::kNUMANoAffinity;
+    // The bytes from the start of the allocation to the user memory.
+    size_t offset = 0;
     size_t num_bytes = 0;
   };
 
-  struct AllocBlocks {
-    explicit AllocBlocks(const AllocKey& alloc_key) : alloc_key(alloc_key) {}
-
-    AllocKey alloc_key;
+  struct ClassBlocks {
     std::vector<void*> blocks;
+    std::list<size_t>::iterator lru_it;
+    bool in_lru = false;
   };
 
-  using AllocList = std::list<AllocBlocks>;
+  // The blocks cached for a NUMA node (or for no node).
+  struct Arena {
+    std::mutex lock;
+    std::array<ClassBlocks, kNumClasses> classes;
+    // The classes, most recently used first.
+    std::list<size_t> lru;
+  };
+
+  struct ThreadCache {
+    ~ThreadCache() { TensorAllocator::Get()->FlushThreadCache(this); }
+
+    std::array<std::vector<void*>, kNumClasses> classes;
+    size_t size = 0;
+  };
 
  public:
   static TensorAllocator* Get() {
     static size_t max_size =
         sys_util::GetEnvInt("XLA_TENSOR_ALLOCATOR_MAXSIZE", 1000000000);
-    static TensorAllocator* allocator = new TensorAllocator(max_size);
+    static size_t thread_cache_size = sys_util::GetEnvInt(
+        "XLA_TENSOR_ALLOCATOR_THREAD_CACHE_SIZE", 64 * 1024 * 1024);
+    static TensorAllocator* allocator =
+        new TensorAllocator(max_size, thread_cache_size);
     return allocator;
   }
 
   std::string Name() override { return "XLA_TensorAllocator"; }
 
   void* AllocateRaw(size_t alignment, size_t num_bytes) override {
-    // We use an alignment-sized area before the memory returned to the caller,
-    // to store a pointer to its AllocBlocks.
-    alignment = std::max<size_t>(alignment, sizeof(void*));
-    // To call aligned_alloc(), num_bytes must be multiple of alignment.
-    num_bytes = RoundUpTo(num_bytes, alignment);
-
-    AllocKey alloc_key = {alignment, num_bytes};
-    void* block = nullptr;
-    AllocBlocks* alloc_blocks = nullptr;
-    std::lock_guard<std::mutex> lock(lock_);
-    auto it = allocs_.find(alloc_key);
-    if (it != allocs_.end()) {
-      alloc_blocks = &*it->second;
-      if (!alloc_blocks->blocks.empty()) {
-        block = alloc_blocks->blocks.back();
-        alloc_blocks->blocks.pop_back();
-      }
-      // LRU
-      alloc_list_.splice(alloc_list_.begin(), alloc_list_, it->second);
-    } else {
-      allocs_.emplace(alloc_key, alloc_list_.insert(alloc_list_.begin(),
-                                                    AllocBlocks(alloc_key)));
-      alloc_blocks = &alloc_list_.front();
+    alignment = std::max(alignment, size_t{kBlockAlignment});
+    uint32_t size_class = GetSizeClass(num_bytes);
+    if (alignment > kBlockAlignment || GetClassBytes(size_class) >= max_size_) {
+      // We do not cache blocks whose size is bigger than the max cache size.
+      XLA_COUNTER("TensorAllocatorUncached", 1);
+      return NewBlock(kUncachedClass, RoundUpTo(num_bytes, alignment),
+                      alignment, tensorflow::port::kNUMANoAffinity);
     }
-    if (block == nullptr) {
-      TrimCache(alloc_key.num_bytes);
-      block = NewBlock(alloc_blocks);
+    ThreadCache* thread_cache = GetThreadCache();
+    std::vector<void*>& thread_blocks = thread_cache->classes[size_class];
+    if (!thread_blocks.empty()) {
+      void* block = thread_blocks.back();
+      thread_blocks.pop_back();
+      thread_cache->size -= GetClassBytes(size_class);
+      XLA_COUNTER("TensorAllocatorThreadHits", 1);
+      return block;
     }
-    return block;
+    int node = GetThreadNode();
+    Arena* arena = GetArena(node);
+    {
+      std::lock_guard<std::mutex> lock(arena->lock);
+      ClassBlocks* class_blocks = &arena->classes[size_class];
+      TouchClass(arena, size_class);
+      if (!class_blocks->blocks.empty()) {
+        void* block = class_blocks->blocks.back();
+        class_blocks->blocks.pop_back();
+        XLA_COUNTER("TensorAllocatorHits", 1);
+        return block;
+      }
+    }
+    XLA_COUNTER("TensorAllocatorMisses", 1);
+    TrimCache(GetClassBytes(size_class), node);
+    return NewBlock(size_class, GetClassBytes(size_class), kBlockAlignment,
+                    node);
   }
 
   void DeallocateRaw(void* ptr) override {
-    if (ptr != nullptr) {
-      // The pointer to AllocBlocks is right before the user memory.
-      AllocBlocks* alloc_blocks = reinterpret_cast<AllocBlocks**>(ptr)[-1];
-      std::lock_guard<std::mutex> lock(lock_);
-      if (alloc_blocks->alloc_key.num_bytes < max_size_) {
-        alloc_blocks->blocks.push_back(ptr);
-      } else {
-        // We do not cache blocks whose size is bigger than the max cache size.
-        FreeBlock(ptr, alloc_blocks);
+    if (ptr == nullptr) {
+      return;
+    }
+    const BlockHeader* header = GetHeader(ptr);
+    if (header->size_class == kUncachedClass) {
+      FreeBlock(ptr);
+      return;
+    }
+    size_t class_bytes = GetClassBytes(header->size_class);
+    if (header->node == GetThreadNode()) {
+      ThreadCache* thread_cache = GetThreadCache();
+      std::vector<void*>& thread_blocks =
+          thread_cache->classes[header->size_class];
+      if (thread_blocks.size() < kThreadCacheBlocks &&
+          thread_cache->size + class_bytes <= thread_cache_size_) {
+        thread_blocks.push_back(ptr);
+        thread_cache->size += class_bytes;
+        return;
       }
     }
+    Arena* arena = GetArena(header->node);
+    std::lock_guard<std::mutex> lock(arena->lock);
+    arena->classes[header->size_class].blocks.push_back(ptr);
+    TouchClass(arena, header->size_class);
   }
 
  private:
-  explicit TensorAllocator(size_t max_size) : max_size_(max_size) {}
-
-  void* NewBlock(AllocBlocks* alloc_blocks) {
-    // We allocate an extra alignment sized area to store the AllocBlocks
-    // pointer.
-    void *ptr = TensorAllocatorTraits::allocate(
-        alloc_blocks->alloc_key.alignment + alloc_blocks->alloc_key.num_bytes,
-        alloc_blocks->alloc_key.alignment);
-    XLA_CHECK(ptr != nullptr);
-    ptr = reinterpret_cast<char*>(ptr) + alloc_blocks->alloc_key.alignment;
-    // Store the pointer to AllocBlocks right before the user memory.
-    reinterpret_cast<AllocBlocks**>(ptr)[-1] = alloc_blocks;
-    size_ += alloc_blocks->alloc_key.num_bytes;
+  TensorAllocator(size_t max_size, size_t thread_cache_size)
+      : max_size_(max_size), thread_cache_size_(thread_cache_size) {
+    // Arena 0 holds the blocks not bound to a NUMA node, arena n + 1 the ones
+    // of node n.
+    int num_nodes =
+        tensorflow::port::NUMAEnabled() ? tensorflow::port::NUMANumNodes() : 0;
+    for (int i = 0; i <= num_nodes; ++i) {
+      arenas_.push_back(absl::make_unique<Arena>());
+    }
+  }
+
+  // Returns the size class of num_bytes: class 0 holds up to kBlockAlignment
+  // bytes, and the next ones split every power of two into four steps.
+  static uint32_t GetSizeClass(size_t num_bytes) {
+    if (num_bytes <= kBlockAlignment) {
+      return 0;
+    }
+    int log2 = tensorflow::Log2Floor64(num_bytes - 1);
+    size_t step = size_t{1} << (log2 - 2);
+    size_t steps = (num_bytes + step - 1) / step;
+    return 1 + (log2 - 6) * 4 + (steps - 5);
+  }
+
+  static size_t GetClassBytes(uint32_t size_class) {
+    if (size_class == 0) {
+      return kBlockAlignment;
+    }
+    int log2 = 6 + (size_class - 1) / 4;
+    return (5 + (size_class - 1) % 4) << (log2 - 2);
+  }
+
+  static BlockHeader* GetHeader(void* ptr) {
+    return reinterpret_cast<BlockHeader*>(ptr) - 1;
+  }
+
+  static int GetThreadNode() {
+    return tensorflow::port::NUMAEnabled()
+               ? tensorflow::port::NUMAGetThreadNodeAffinity()
+               : tensorflow::port::kNUMANoAffinity;
+  }
+
+  static ThreadCache* GetThreadCache() {
+    static thread_local ThreadCache thread_cache;
+    return &thread_cache;
+  }
+
+  Arena* GetArena(int node) const {
+    size_t index = node == tensorflow::port::kNUMANoAffinity ? 0 : node + 1;
+    return arenas_[std::min(index, arenas_.size() - 1)].get();
+  }
+
+  static void TouchClass(Arena* arena, size_t size_class) {
+    ClassBlocks* class_blocks = &arena->classes[size_class];
+    if (class_blocks->in_lru) {
+      arena->lru.splice(arena->lru.begin(), arena->lru, class_blocks->lru_it);
+    } else {
+      class_blocks->lru_it = arena->lru.insert(arena->lru.begin(), size_class);
+      class_blocks->in_lru = true;
+    }
+  }
+
+  void* NewBlock(uint32_t size_class, size_t num_bytes, size_t alignment,
+                 int node) {
+    // We allocate an extra alignment sized area to store the BlockHeader.
+    // To call aligned_alloc(), the size must be multiple of alignment.
+    size_t offset = RoundUpTo(sizeof(BlockHeader), alignment);
+    size_t size = RoundUpTo(offset + num_bytes, alignment);
+    void* base = node != tensorflow::port::kNUMANoAffinity
+                     ? tensorflow::port::NUMAMalloc(node, size, alignment)
+                     : TensorAllocatorTraits::allocate(size, alignment);
+    XLA_CHECK(base != nullptr);
+    void* ptr = reinterpret_cast<char*>(base) + offset;
+    BlockHeader* header = GetHeader(ptr);
+    header->size_class = size_class;
+    header->node = node;
+    header->offset = offset;
+    header->num_bytes = size - offset;
+    XLA_VALUE_METRIC("TensorAllocatorBytes", size_ += header->num_bytes);
     return ptr;
   }
 
-  void FreeBlock(void* ptr, AllocBlocks* alloc_blocks) {
-    size_ -= alloc_blocks->alloc_key.num_bytes;
-    TensorAllocatorTraits::deallocate(
-        reinterpret_cast<char*>(ptr) - alloc_blocks->alloc_key.alignment);
+  void FreeBlock(void* ptr) {
+    const BlockHeader* header = GetHeader(ptr);
+    size_.fetch_sub(header->num_bytes);
+    void* base = reinterpret_cast<char*>(ptr) - header->offset;
+    if (header->node != tensorflow::port::kNUMANoAffinity) {
+      tensorflow::port::NUMAFree(base, header->offset + header->num_bytes);
+    } else {
+      TensorAllocatorTraits::deallocate(base);
+    }
+  }
+
+  // Frees the least recently used cached blocks, starting with the arena of
+  // the node, until num_bytes more fit within the max size.
+  void TrimCache(size_t num_bytes, int node) {
+    if (size_ + num_bytes <= max_size_) {
+      return;
+    }
+    Arena* first_arena = GetArena(node);
+    std::vector<Arena*> arenas({first_arena});
+    for (auto& arena : arenas_) {
+      if (arena.get() != first_arena) {
+        arenas.push_back(arena.get());
+      }
+    }
+    for (Arena* arena : arenas) {
+      std::lock_guard<std::mutex> lock(arena->lock);
+      for (auto it = arena->lru.rbegin();
+           size_ + num_bytes > max_size_ && it != arena->lru.rend(); ++it) {
+        std::vector<void*>& blocks = arena->classes[*it].blocks;
+        while (!blocks.empty() && size_ + num_bytes > max_size_) {
+          FreeBlock(blocks.back());
+          blocks.pop_back();
+          XLA_COUNTER("TensorAllocatorTrimmed", 1);
+        }
+      }
+    }
   }
 
-  void TrimCache(size_t num_bytes) {
-    auto it = alloc_list_.rbegin();
-    for (; size_ + num_bytes > max_size_ && it != alloc_list_.rend(); ++it) {
-      AllocBlocks* alloc_blocks = &*it;
-      while (!alloc_blocks->blocks.empty() && size_ + num_bytes > max_size_) {
-        FreeBlock(alloc_blocks->blocks.back(), alloc_blocks);
-        alloc_blocks->blocks.pop_back();
+  // Hands the blocks of an exiting thread back to their arenas.
+  void FlushThreadCache(ThreadCache* thread_cache) {
+    for (size_t size_class = 0; size_class < kNumClasses; ++size_class) {
+      for (void* ptr : thread_cache->classes[size_class]) {
+        Arena* arena = GetArena(GetHeader(ptr)->node);
+        std::lock_guard<std::mutex> lock(arena->lock);
+        arena->classes[size_class].blocks.push_back(ptr);
+        TouchClass(arena, size_class);
       }
     }
   }
 
   size_t max_size_ = 0;
-  std::mutex lock_;
-  size_t size_ = 0;
-  AllocList alloc_list_;
-  absl::node_hash_map<AllocKey, AllocList::iterator, AllocKey::Hash> allocs_;
+  size_t thread_cache_size_ = 0;
+  std::atomic<size_t> size_{0};
+  std::vector<std::unique_ptr<Arena>> arenas_;
 };
 
 std::string StripPrefix(const std::string& value, const std::string& prefix) {
@@ -560,6 +721,121 @@ bool ParseEnvDevices(XrtComputationClient::Options* options) {
   return !options->global_device_map.empty();
 }
 
+bool PiggybackReleases() {
+  static const bool piggyback_releases =
+      sys_util::GetEnvBool("XRT_PIGGYBACK_RELEASES", false);
+  return piggyback_releases;
+}
+
+int64_t GetTransferChunkSize() {
+  // Tensors bigger than this many bytes get uploaded in slices along their
+  // major dimension, and reassembled on the device.
+  static const int64_t chunk_size =
+      sys_util::GetEnvInt("XRT_TRANSFER_CHUNK_SIZE", 0);
+  return chunk_size;
+}
+
+int64_t GetTransferChunkPipeline() {
+  static const int64_t pipeline =
+      sys_util::GetEnvInt("XRT_TRANSFER_CHUNK_PIPELINE", 4);
+  return std::max<int64_t>(pipeline, 1);
+}
+
+bool IsChunkedTransfer(const Shape& shape, int64_t chunk_size) {
+  return chunk_size > 0 && shape.IsArray() && !shape.is_dynamic() &&
+         shape.rank() > 0 && shape.dimensions(0) > 1 &&
+         ShapeUtil::ByteSizeOfElements(shape) > chunk_size;
+}
+
+bool UseAdaptiveCompression() {
+  // With adaptive compression, only the transfers which are likely to shrink
+  // go through the XRT_GRPC_COMPRESSION sessions.
+  static const bool adaptive =
+      !sys_util::GetEnvString("XRT_GRPC_COMPRESSION", "").empty() &&
+      sys_util::GetEnvBool("XRT_GRPC_COMPRESSION_ADAPTIVE", false);
+  return adaptive;
+}
+
+int64_t GetCompressionMinSize() {
+  static const int64_t min_size =
+      sys_util::GetEnvInt("XRT_GRPC_COMPRESSION_MIN_SIZE", 256 * 1024);
+  return min_size;
+}
+
+// Estimates the entropy of the data, in bits per byte, out of a set of fixed
+// size windows spread over the buffer.
+double SampleEntropy(const char* data, size_t size) {
+  constexpr size_t kWindowSize = 64;
+  constexpr size_t kNumWindows = 64;
+  std::array<uint32_t, 256> counts{};
+  size_t stride = std::max(size / kNumWindows, kWindowSize);
+  size_t sampled = 0;
+  for (size_t offset = 0; offset + kWindowSize <= size; offset += stride) {
+    for (size_t i = 0; i < kWindowSize; ++i) {
+      ++counts[static_cast<uint8_t>(data[offset + i])];
+    }
+    sampled += kWindowSize;
+  }
+  if (sampled == 0) {
+    return 8.0;
+  }
+  double entropy = 0.0;
+  for (auto count : counts) {
+    if (count > 0) {
+      double p = static_cast<double>(count) / sampled;
+      entropy -= p * std::log2(p);
+    }
+  }
+  return entropy;
+}
+
+bool ShouldCompressUpload(const char* data, size_t size) {
+  static const double max_entropy =
+      sys_util::GetEnvDouble("XRT_GRPC_COMPRESSION_MAX_ENTROPY", 6.0);
+  return UseAdaptiveCompression() && size >= GetCompressionMinSize() &&
+         SampleEntropy(data, size) <= max_entropy;
+}
+
+bool ShouldCompressDownload(const Shape& shape) {
+  // The data is not on the host yet, so the decision falls back to the type.
+  // The mantissas of floating point data hardly compress, while integer data
+  // like indices, labels and masks mostly does.
+  PrimitiveType type = shape.element_type();
+  return UseAdaptiveCompression() &&
+         ShapeUtil::ByteSizeOfElements(shape) >= GetCompressionMinSize() &&
+         !primitive_util::IsFloatingPointType(type) &&
+         !primitive_util::IsComplexType(type);
+}
+
+tensorflow::Tensor MakeHandlesTensor(absl::Span<const int64_t> handles) {
+  tensorflow::Tensor handles_tensor(
+      tensorflow::DT_INT64,
+      tensorflow::TensorShape({static_cast<int64_t>(handles.size())}));
+  auto flat_handles_tensor = handles_tensor.flat<tensorflow::int64>();
+  for (size_t i = 0; i < handles.size(); ++i) {
+    flat_handles_tensor(i) = handles[i];
+  }
+  return handles_tensor;
+}
+
+// Serializes the XRT computation, once, into the string tensor which both the
+// compilation cache key and the compile feed share. The HLO module, which
+// CreateXrtComputation() moved into the XRT computation, gets moved back.
+tensorflow::Tensor SerializeXrtComputation(xrt::XLAComputation* xrt_computation,
+                                           XlaComputation* computation) {
+  tensorflow::Tensor serialized(tensorflow::DT_STRING,
+                                tensorflow::TensorShape());
+  tensorflow::tstring& buffer = serialized.scalar<tensorflow::tstring>()();
+  size_t size = xrt_computation->ByteSizeLong();
+  buffer.resize_uninitialized(size);
+  XLA_CHECK(xrt_computation->SerializeToArray(buffer.mdata(), size));
+  HloModuleProto* hlo_module = xrt_computation->mutable_hlo_snapshot()
+                                   ->mutable_hlo()
+                                   ->mutable_hlo_module();
+  *computation->mutable_proto() = std::move(*hlo_module);
+  return serialized;
+}
+
 }  // namespace
 
 std::unique_ptr<ComputationClient> ComputationClient::Create() {
@@ -594,13 +870,36 @@ XrtComputationClient::XrtComputationClient(
     std::unique_ptr<tensorflow::tpu::TopologyProto> topology_proto)
     : options_(std::move(options)),
       compilation_cache_(sys_util::GetEnvInt("XLA_COMPILATION_CACHE_SIZE", 64)),
-      rng_seed_(0x5a2d296e9) {
+      rng_seed_(0x5a2d296e9),
+      release_timer_armed_(false) {
   tensorflow::ConfigProto config = CreateConfigProto(options_);
   std::string local_target = GetLocalTarget(options_);
+  // The executes and the transfers go through different session caches, and
+  // the transfer sessions can get connections of their own, so that large
+  // transfers do not hold back the executes queued on the same channel.
+  XrtSessionCache::Options execute_options;
+  execute_options.compressed = !UseAdaptiveCompression();
+  execute_options.multi_stream =
+      sys_util::GetEnvBool("XRT_GRPC_MULTISTREAM", true);
+  XrtSessionCache::Options transfer_options = execute_options;
+  transfer_options.multi_stream = sys_util::GetEnvBool(
+      "XRT_GRPC_TRANSFER_MULTISTREAM", execute_options.multi_stream);
   session_cache_ = absl::make_unique<XrtSessionCache>(
-      config, [this](XrtSession* s) { InitSession(s); }, local_target);
-  alloc_session_cache_ =
-      absl::make_unique<XrtSessionCache>(config, nullptr, local_target);
+      config, [this](XrtSession* s) { InitSession(s); }, local_target,
+      execute_options);
+  transfer_session_cache_ = absl::make_unique<XrtSessionCache>(
+      config, [this](XrtSession* s) { InitTransferSession(s); }, local_target,
+      transfer_options);
+  alloc_session_cache_ = absl::make_unique<XrtSessionCache>(
+      config, nullptr, local_target, transfer_options);
+  if (UseAdaptiveCompression()) {
+    transfer_options.compressed = true;
+    compressed_session_cache_ = absl::make_unique<XrtSessionCache>(
+        config, [this](XrtSession* s) { InitTransferSession(s); },
+        local_target, transfer_options);
+    compressed_alloc_session_cache_ = absl::make_unique<XrtSessionCache>(
+        config, nullptr, local_target, transfer_options);
+  }
 
   auto default_device_target =
       options_.global_device_map.find(options_.default_device);
@@ -625,6 +924,7 @@ XrtComputationClient::XrtComputationClient(
   TF_VLOG(1) << "XRT default device: " << options_.default_device;
   MaybeCreateLocalService(options_);
   InitializeDevices(std::move(topology_proto));
+  PrewarmSessions();
   StartHandleReleaser();
 
   for (const auto& dev_target : options_.global_device_map) {
@@ -662,6 +962,34 @@ std::vector<size_t> XrtComputationClient::PartitionTransferToServer(
 std::vector<ComputationClient::DataPtr>
 XrtComputationClient::XrtDevice::TransferToServer(
     absl::Span<const TensorSource> tensors) {
+  int64_t chunk_size = GetTransferChunkSize();
+  std::vector<TensorSource> regular_tensors;
+  std::vector<size_t> regular_indices;
+  std::vector<DataPtr> results(tensors.size());
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    if (IsChunkedTransfer(tensors[i].shape, chunk_size)) {
+      results[i] =
+          client_->TransferChunkedToServer(this, tensors[i], chunk_size);
+    } else {
+      regular_tensors.push_back(tensors[i]);
+      regular_indices.push_back(i);
+    }
+  }
+  if (regular_tensors.size() == tensors.size()) {
+    return TransferToServerPartitioned(tensors);
+  }
+  if (!regular_tensors.empty()) {
+    auto regular_results = TransferToServerPartitioned(regular_tensors);
+    for (size_t i = 0; i < regular_results.size(); ++i) {
+      results[regular_indices[i]] = std::move(regular_results[i]);
+    }
+  }
+  return results;
+}
+
+std::vector<ComputationClient::DataPtr>
+XrtComputationClient::XrtDevice::TransferToServerPartitioned(
+    absl::Span<const TensorSource> tensors) {
   auto partitions = PartitionTransferToServer(tensors);
   if (partitions.size() == 1) {
     // Fast path in case of single partition. Avoid creating threads and
@@ -694,10 +1022,14 @@ std::vector<ComputationClient::DataPtr>
 XrtComputationClient::TransferToServerInternal(
     XrtDevice* device_ptr, absl::Span<const TensorSource> tensors) {
   metrics::TimedSection timed(TransferToServerMetric());
+  device_activity::ScopedHostPhase phase(
+      device_activity::HostPhase::kTransfer);
 
   std::mutex lock;
   XrtSessionCache::SessionMap session_map;
+  XrtSessionCache::SessionMap compressed_session_map;
   int64_t total_size = 0;
+  int64_t compressed_size = 0;
   util::MultiWait mwait(tensors.size());
   std::map<XrtSession*, SessionWork> session_work_map;
   std::string device = GetEffectiveDevice(device_ptr->name());
@@ -714,11 +1046,16 @@ XrtComputationClient::TransferToServerInternal(
         auto tdata = tensor.tensor_data();
         tensors[i].populate_fn(tensors[i], const_cast<char*>(tdata.data()),
                                tdata.size());
+        bool compress = ShouldCompressUpload(tdata.data(), tdata.size());
 
         {
           std::lock_guard<std::mutex> slock(lock);
-          XrtSession* session = GetSessionForXrtDevice(
-              alloc_session_cache_.get(), xrt_device, &session_map);
+          XrtSession* session =
+              compress ? GetSessionForXrtDevice(
+                             compressed_alloc_session_cache_.get(), xrt_device,
+                             &compressed_session_map)
+                       : GetSessionForXrtDevice(alloc_session_cache_.get(),
+                                                xrt_device, &session_map);
           SessionWork* session_work = &session_work_map[session];
           tensorflow::Scope device_scope =
               session->root()->WithDevice(xrt_device);
@@ -729,6 +1066,9 @@ XrtComputationClient::TransferToServerInternal(
           session_work->index_mapping.push_back(i);
 
           total_size += tdata.size();
+          if (compress) {
+            compressed_size += tdata.size();
+          }
         }
       };
       env::ScheduleClosure(mwait.Completer(std::move(converter)));
@@ -736,6 +1076,9 @@ XrtComputationClient::TransferToServerInternal(
     mwait.Wait();
   }
   OutboundDataMetric()->AddSample(total_size);
+  if (UseAdaptiveCompression()) {
+    OutboundCompressedDataMetric()->AddSample(compressed_size);
+  }
 
   mwait.Reset(session_work_map.size());
   std::vector<DataPtr> results(tensors.size());
@@ -761,27 +1104,105 @@ XrtComputationClient::TransferToServerInternal(
   return results;
 }
 
+ComputationClient::DataPtr XrtComputationClient::TransferChunkedToServer(
+    XrtDevice* device_ptr, const TensorSource& tensor, int64_t chunk_size) {
+  XLA_COUNTER("XrtChunkedTransferToServer", 1);
+  const Shape& shape = tensor.shape;
+  int64_t size = ShapeUtil::ByteSizeOfElements(shape);
+  int64_t rows = shape.dimensions(0);
+  int64_t row_size = size / rows;
+  int64_t chunk_rows =
+      std::max<int64_t>(std::min<int64_t>(chunk_size / row_size, rows), 1);
+  int64_t num_chunks = (rows + chunk_rows - 1) / chunk_rows;
+
+  // The populate function only knows how to fill the whole tensor, so the
+  // chunks are carved out of a single host copy.
+  std::unique_ptr<char[]> buffer(new char[size]);
+  tensor.populate_fn(tensor, buffer.get(), size);
+
+  std::vector<TensorSource> chunks;
+  for (int64_t row = 0; row < rows; row += chunk_rows) {
+    Shape chunk_shape(shape);
+    chunk_shape.set_dimensions(0, std::min(chunk_rows, rows - row));
+    const char* chunk_data = buffer.get() + row * row_size;
+    auto populate_fn = [chunk_data](const TensorSource& source, void* dest,
+                                    size_t dest_size) {
+      std::memcpy(dest, chunk_data, dest_size);
+    };
+    chunks.emplace_back(std::move(chunk_shape), std::move(populate_fn));
+  }
+
+  // Keeps at most a pipeline worth of chunks in flight, so that the host
+  // tensors created by the transfers do not add up to another full copy.
+  int64_t pipeline = GetTransferChunkPipeline();
+  std::vector<DataPtr> chunks_data(chunks.size());
+  for (size_t base = 0; base < chunks.size(); base += pipeline) {
+    size_t count = std::min<size_t>(pipeline, chunks.size() - base);
+    util::MultiWait mwait(count);
+    for (size_t i = base; i < base + count; ++i) {
+      auto sender = [&, i]() {
+        chunks_data[i] = std::move(TransferToServerInternal(
+            device_ptr, absl::Span<const TensorSource>(&chunks[i], 1))[0]);
+      };
+      env::ScheduleIoClosure(mwait.Completer(std::move(sender)));
+    }
+    mwait.Wait();
+  }
+
+  XlaBuilder builder("ChunkedTransfer");
+  std::vector<XlaOp> parameters;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    parameters.push_back(Parameter(&builder, i, chunks[i].shape,
+                                   absl::StrCat("chunk", i)));
+  }
+  ConcatInDim(&builder, parameters, 0);
+  std::vector<CompileInstance> instances;
+  instances.emplace_back(ConsumeValue(builder.Build()), &shape);
+  // Tensors of the same shape and chunking share the computation, which the
+  // compilation cache hands back without going to XRT again.
+  std::vector<ComputationPtr> computations =
+      Compile(device_ptr->name(), {device_ptr->name()}, std::move(instances));
+  TF_VLOG(4) << "Transferred " << size << " bytes to "
+             << device_ptr->name() << " in " << num_chunks << " chunks";
+  return ExecuteComputation(*computations.front(), chunks_data,
+                            device_ptr->name(), ExecuteComputationOptions())
+      .front();
+}
+
 std::vector<Literal> XrtComputationClient::TransferFromServerImpl(
     absl::Span<const DataPtr> handles) {
   metrics::TimedSection timed(TransferFromServerMetric());
+  device_activity::ScopedHostPhase phase(
+      device_activity::HostPhase::kTransfer);
 
   int64_t max_partition_size = GetMaxTensorsPartitionSize();
   std::list<XrtSessionCache::SessionMap> session_maps;
+  std::list<XrtSessionCache::SessionMap> compressed_session_maps;
   int64_t current_size = 0;
   session_maps.emplace_back();
+  compressed_session_maps.emplace_back();
   std::map<XrtSession*, SessionWork> session_work_map;
+  std::vector<bool> compressed(handles.size());
   for (size_t i = 0; i < handles.size(); ++i) {
     const XrtData& xrt_data = dynamic_cast<const XrtData&>(*handles[i]);
 
     int64_t shape_size = ShapeUtil::ByteSizeOfElements(xrt_data.shape());
     if (current_size + shape_size >= max_partition_size) {
       session_maps.emplace_back();
+      compressed_session_maps.emplace_back();
       current_size = 0;
     }
     current_size += shape_size;
 
-    XrtSession* session = GetSessionForDevice(
-        session_cache_.get(), xrt_data.device()->name(), &session_maps.back());
+    compressed[i] = ShouldCompressDownload(xrt_data.shape());
+    XrtSession* session =
+        compressed[i]
+            ? GetSessionForDevice(compressed_session_cache_.get(),
+                                  xrt_data.device()->name(),
+                                  &compressed_session_maps.back())
+            : GetSessionForDevice(transfer_session_cache_.get(),
+                                  xrt_data.device()->name(),
+                                  &session_maps.back());
     SessionWork* session_work = &session_work_map[session];
     tensorflow::Scope device_scope = session->root()->WithDevice(
         SwiftDeviceToXrtDevice(xrt_data.device()->name()));
@@ -794,6 +1215,7 @@ std::vector<Literal> XrtComputationClient::TransferFromServerImpl(
   }
 
   int64_t total_size = 0;
+  int64_t compressed_size = 0;
   std::vector<Literal> results(handles.size());
   for (auto& session_work : session_work_map) {
     std::vector<tensorflow::Tensor> outputs;
@@ -809,9 +1231,15 @@ std::vector<Literal> XrtComputationClient::TransferFromServerImpl(
           response.ParseFromString(outputs[i].scalar<tensorflow::tstring>()()));
       results[li] = std::move(Literal::CreateFromProto(response).ValueOrDie());
       total_size += results[li].size_bytes();
+      if (compressed[li]) {
+        compressed_size += results[li].size_bytes();
+      }
     }
   }
   InboundDataMetric()->AddSample(total_size);
+  if (UseAdaptiveCompression()) {
+    InboundCompressedDataMetric()->AddSample(compressed_size);
+  }
   return results;
 }
 
@@ -819,6 +1247,7 @@ std::vector<ComputationClient::ComputationPtr> XrtComputationClient::Compile(
     const std::string& device, const std::vector<std::string>& devices,
     std::vector<CompileInstance> instances) {
   metrics::TimedSection timed(CompileMetric());
+  device_activity::ScopedHostPhase phase(device_activity::HostPhase::kCompile);
 
   std::mutex lock;
   util::MultiWait mwait(instances.size());
@@ -829,12 +1258,14 @@ std::vector<ComputationClient::ComputationPtr> XrtComputationClient::Compile(
   std::map<XrtSession*, SessionWork> session_work_map;
   for (size_t i = 0; i < instances.size(); ++i) {
     auto builder = [&, this, i]() {
-      const CompileInstance& instance = instances[i];
+      CompileInstance* instance = &instances[i];
       std::unique_ptr<xrt::XLAComputation> xrt_computation =
-          CreateXrtComputation(instance.computation, devices,
-                               instance.output_shape);
-      CompilationCacheKey cache_key(GetResourceDomain(device),
-                                    xrt_computation->SerializeAsString());
+          CreateXrtComputation(&instance->computation, devices,
+                               instance->output_shape, instance->fast_compile);
+      CompilationCacheKey cache_key(
+          GetResourceDomain(device),
+          SerializeXrtComputation(xrt_computation.get(),
+                                  &instance->computation));
       auto computation_ptr = compilation_cache_.Get(cache_key);
       if (computation_ptr == nullptr) {
         cache_keys[i] = std::move(cache_key);
@@ -911,6 +1342,23 @@ void XrtComputationClient::CheckCompileStatus(
   }
 }
 
+void XrtComputationClient::CheckExecuteStatus(
+    const Status& status, absl::Span<const Computation* const> computations) {
+  if (!status.ok()) {
+    // The HLOs are only copied, or reloaded once released, for the report.
+    std::vector<XlaComputation> xla_computations;
+    xla_computations.reserve(computations.size());
+    std::vector<const XlaComputation*> computation_ptrs;
+    std::vector<const Shape*> output_shapes;
+    for (const Computation* computation : computations) {
+      xla_computations.push_back(computation->computation());
+      computation_ptrs.push_back(&xla_computations.back());
+      output_shapes.push_back(&computation->program_shape().result());
+    }
+    util::ReportComputationError(status, computation_ptrs, output_shapes);
+  }
+}
+
 std::vector<ComputationClient::DataPtr>
 XrtComputationClient::ExecuteComputation(
     const Computation& computation, absl::Span<const DataPtr> arguments,
@@ -919,18 +1367,42 @@ XrtComputationClient::ExecuteComputation(
 
   XrtSessionCache::SessionMap session_map;
   std::string effective_device = GetEffectiveDevice(device);
-  tensorflow::ClientSession::FeedType feed_inputs;
-  std::vector<tensorflow::Output> exec_ops = CreateExecuteOps(
-      &session_map, dynamic_cast<const XrtComputation&>(computation),
-      BuildParallelArguments(arguments), options.explode_tuple,
-      {effective_device}, &feed_inputs);
-
+  const XrtComputation& xrt_computation =
+      dynamic_cast<const XrtComputation&>(computation);
   XrtSession* session =
       GetSessionForDevice(session_cache_.get(), effective_device, &session_map);
+  tensorflow::ClientSession::FeedType feed_inputs;
+  std::vector<tensorflow::Operation> release_ops =
+      AttachPendingReleases(session, effective_device, &feed_inputs);
+  const XrtSession::Callable* callable =
+      release_ops.empty()
+          ? GetExecuteCallable(session, xrt_computation, options.explode_tuple,
+                               effective_device)
+          : nullptr;
   std::vector<tensorflow::Tensor> outputs;
-  util::CheckComputationStatus(
-      session->session()->Run(feed_inputs, {exec_ops.front()}, &outputs),
-      {&computation.computation()}, {&computation.program_shape().result()});
+  // The session run returns once the computation completed on the device.
+  device_activity::ScopedExecution execution(effective_device);
+  if (callable != nullptr) {
+    std::vector<tensorflow::Tensor> feeds(callable->bound_feeds);
+    feeds.push_back(GetArgumentsInputs(arguments, effective_device));
+    tensorflow::RunMetadata run_metadata;
+    CheckExecuteStatus(
+        session->session()->RunCallable(callable->handle, feeds, &outputs,
+                                        &run_metadata),
+        {&computation});
+  } else {
+    std::map<XrtSession*, SessionWork> session_work_map;
+    CreateExecuteOps(&session_map, xrt_computation,
+                     BuildParallelArguments(arguments), options.explode_tuple,
+                     {effective_device}, &session_work_map);
+    SessionWork* session_work = &session_work_map.at(session);
+    session_work->feed_inputs.insert(feed_inputs.begin(), feed_inputs.end());
+    CheckExecuteStatus(
+        session->session()->Run(session_work->feed_inputs,
+                                session_work->outputs_handles, release_ops,
+                                &outputs),
+        {&computation});
+  }
   XLA_CHECK_EQ(outputs.size(), 1);
 
   return GetComputationResults(outputs[0], computation.program_shape().result(),
@@ -946,24 +1418,21 @@ XrtComputationClient::ExecuteReplicated(
   metrics::TimedSection timed(ExecuteReplicatedMetric());
 
   XrtSessionCache::SessionMap session_map;
-  tensorflow::ClientSession::FeedType feed_inputs;
-  std::vector<tensorflow::Output> exec_ops = CreateExecuteOps(
-      &session_map, dynamic_cast<const XrtComputation&>(computation), arguments,
-      options.explode_tuple, devices, &feed_inputs);
+  std::map<XrtSession*, SessionWork> session_work_map;
+  CreateExecuteOps(&session_map,
+                   dynamic_cast<const XrtComputation&>(computation), arguments,
+                   options.explode_tuple, devices, &session_work_map);
   std::vector<const Computation*> computations(devices.size());
   std::fill(computations.begin(), computations.end(), &computation);
 
-  return RunComputations(session_map, exec_ops, computations, devices,
-                         feed_inputs);
+  return RunComputations(&session_work_map, computations, devices);
 }
 
 std::vector<std::vector<ComputationClient::DataPtr>>
 XrtComputationClient::RunComputations(
-    const XrtSessionCache::SessionMap& session_map,
-    const std::vector<tensorflow::Output>& exec_ops,
+    std::map<XrtSession*, SessionWork>* session_work_map,
     absl::Span<const Computation* const> computations,
-    absl::Span<const std::string> devices,
-    const tensorflow::ClientSession::FeedType& feed_inputs) {
+    absl::Span<const std::string> devices) {
   // In the S4TF/XRT interface we keep a map (options_.workers_map) from a
   // worker+taskno, to the GRPC server which is the entry point for that worker.
   // Since XRT could re-distribute ops internally, if we have N hosts
@@ -972,49 +1441,57 @@ XrtComputationClient::RunComputations(
   // host.
   // The advantage of the latter approach, is that we do not bottleneck
   // (especially when feeding inputs) the single GRPC entry point.
-  // Using the N:1 approach, the session_replicas below will contain a single
+  // Using the N:1 approach, the session_work_map below will contain a single
   // session, and all the replica executions will go through it (and distributed
   // by XRT on the service side).
   // Chosing the 1:1 approach (one session per worker), we will have N sessions
-  // within the session_replicas map, which we will be executing independently.
-  std::map<XrtSession*, std::vector<size_t>> session_replicas;
-  for (size_t i = 0; i < devices.size(); ++i) {
-    auto worker_hostport = GetWorkerForDevice(GetEffectiveDevice(devices[i]));
-    XrtSession* session = session_map.at(worker_hostport.second).get();
-    session_replicas[session].push_back(i);
-  }
+  // within the session_work_map, which we will be executing independently.
+  // Either way, all the devices of a session get executed by a single session
+  // run, which only feeds and fetches the nodes of that session.
   XLA_CHECK_EQ(computations.size(), devices.size());
 
-  util::MultiWait mwait(session_replicas.size());
+  util::MultiWait mwait(session_work_map->size());
   std::vector<std::vector<DataPtr>> results(devices.size());
-  for (auto& sess_replica : session_replicas) {
-    XrtSession* session = sess_replica.first;
-    const std::vector<size_t>& replicas = sess_replica.second;
-
-    auto session_runner = [&, this, session]() {
-      std::vector<tensorflow::Output> exec_nodes;
-      std::vector<const XlaComputation*> xla_computations;
-      std::vector<const Shape*> output_shapes;
-      for (auto replica : replicas) {
-        exec_nodes.push_back(exec_ops[replica]);
-        xla_computations.push_back(&computations[replica]->computation());
-        output_shapes.push_back(
-            &computations[replica]->program_shape().result());
+  for (auto& session_and_work : *session_work_map) {
+    XrtSession* session = session_and_work.first;
+    SessionWork* session_work = &session_and_work.second;
+
+    auto session_runner = [&, this, session, session_work]() {
+      std::vector<tensorflow::Operation> release_ops = AttachPendingReleases(
+          session, GetEffectiveDevice(devices[session_work->index_mapping[0]]),
+          &session_work->feed_inputs);
+      std::vector<const Computation*> replica_computations;
+      for (auto replica : session_work->index_mapping) {
+        replica_computations.push_back(computations[replica]);
       }
       std::vector<tensorflow::Tensor> outputs;
-      util::CheckComputationStatus(
-          session->session()->Run(feed_inputs, exec_nodes, &outputs),
-          xla_computations, output_shapes);
-      XLA_CHECK_EQ(outputs.size(), exec_nodes.size());
+      for (auto replica : session_work->index_mapping) {
+        device_activity::ExecutionStarted(GetEffectiveDevice(devices[replica]));
+      }
+      Status status = session->session()->Run(session_work->feed_inputs,
+                                              session_work->outputs_handles,
+                                              release_ops, &outputs);
+      for (auto replica : session_work->index_mapping) {
+        device_activity::ExecutionFinished(
+            GetEffectiveDevice(devices[replica]));
+      }
+      CheckExecuteStatus(status, replica_computations);
+      XLA_CHECK_EQ(outputs.size(), session_work->outputs_handles.size());
 
       for (size_t i = 0; i < outputs.size(); ++i) {
-        auto replica = replicas[i];
+        auto replica = session_work->index_mapping[i];
         results[replica] = GetComputationResults(
             outputs[i], computations[replica]->program_shape().result(),
             GetEffectiveDevice(devices[replica]));
       }
     };
-    env::ScheduleIoClosure(mwait.Completer(std::move(session_runner)));
+    if (session_work_map->size() == 1) {
+      // With a single worker there is nothing to overlap, so save the thread
+      // hop.
+      mwait.Completer(std::move(session_runner))();
+    } else {
+      env::ScheduleIoClosure(mwait.Completer(std::move(session_runner)));
+    }
   }
   mwait.Wait();
   return results;
@@ -1029,12 +1506,10 @@ XrtComputationClient::ExecuteParallel(
   metrics::TimedSection timed(ExecuteParallelMetric());
 
   XrtSessionCache::SessionMap session_map;
-  tensorflow::ClientSession::FeedType feed_inputs;
-  std::vector<tensorflow::Output> exec_ops =
-      CreateExecuteOps(&session_map, computations, arguments,
-                       options.explode_tuple, devices, &feed_inputs);
-  return RunComputations(session_map, exec_ops, computations, devices,
-                         feed_inputs);
+  std::map<XrtSession*, SessionWork> session_work_map;
+  CreateExecuteOps(&session_map, computations, arguments,
+                   options.explode_tuple, devices, &session_work_map);
+  return RunComputations(&session_work_map, computations, devices);
 }
 
 std::vector<ComputationClient::DataPtr> XrtComputationClient::ExecuteChained(
@@ -1107,11 +1582,17 @@ std::vector<ComputationClient::DataPtr> XrtComputationClient::ExecuteChainedXrt(
       GetExecuteChainedNode(session, device_scope, effective_device);
   feed_inputs.insert({cached_node.holders[0], plan.SerializeAsString()});
   feed_inputs.insert({cached_node.holders[1], config.SerializeAsString()});
+  std::vector<tensorflow::Operation> release_ops =
+      AttachPendingReleases(session, effective_device, &feed_inputs);
 
   std::vector<tensorflow::Tensor> outputs;
-  util::CheckComputationStatus(
-      session->session()->Run(feed_inputs, {cached_node.outputs[0]}, &outputs),
-      {}, {});
+  {
+    device_activity::ScopedExecution execution(effective_device);
+    util::CheckComputationStatus(
+        session->session()->Run(feed_inputs, {cached_node.outputs[0]},
+                                release_ops, &outputs),
+        {}, {});
+  }
   XLA_CHECK_EQ(outputs.size(), 1);
 
   std::vector<DataPtr> results;
@@ -1130,70 +1611,215 @@ XrtComputationClient::ExecuteChainedSplit(
     absl::Span<const ExecuteChainedOp> ops, const std::string& device) {
   metrics::TimedSection timed(ExecuteChainedMetric());
 
-  std::vector<int64_t> uses(ops.size(), 0);
-  for (auto& op : ops) {
-    for (auto& input : op.inputs) {
-      uses[input.op_index] += 1;
-    }
-  }
   XrtSessionCache::SessionMap session_map;
   std::string effective_device = GetEffectiveDevice(device);
   const std::string& xrt_device = SwiftDeviceToXrtDevice(effective_device);
   XrtSession* session =
       GetSessionForXrtDevice(session_cache_.get(), xrt_device, &session_map);
   tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
-  std::vector<std::vector<DataPtr>> ops_outputs(ops.size());
-  std::vector<DataPtr> results;
+
+  // The ops get wired into a single graph of XRTExecute nodes, each fed with
+  // the exploded result handles of the ops it depends on, so the whole plan
+  // runs on the worker with a single session round trip. Only the handles of
+  // the requested outputs come back, the ones of the intermediate results get
+  // released on the worker once all their consumers ran. The graphs are cached
+  // by the plan structure, with the data and computation handles fed.
+  std::vector<const Shape*> ops_shapes(ops.size());
+  std::vector<std::vector<int64_t>> ops_fetched(ops.size());
+  std::vector<std::pair<size_t, int64_t>> fetches;
+  std::vector<size_t> results_op;
+  std::vector<size_t> results_fetch;
+  std::string plan_key =
+      XrtSession::GetCacheKey("XrtChainedPlan", effective_device);
   for (size_t i = 0; i < ops.size(); ++i) {
     const ExecuteChainedOp& op = ops[i];
     if (op.device_data != nullptr) {
-      ops_outputs[i].push_back(op.device_data);
+      ops_shapes[i] = &op.device_data->shape();
+      absl::StrAppend(&plan_key, ";d");
     } else {
-      tensorflow::ClientSession::FeedType feed_inputs;
-      std::vector<DataPtr> arguments;
-      arguments.reserve(op.inputs.size());
+      ops_shapes[i] = &op.computation->program_shape().result();
+      absl::StrAppend(&plan_key, ";c",
+                      ops_shapes[i]->IsTuple()
+                          ? ShapeUtil::TupleElementCount(*ops_shapes[i])
+                          : 1);
       for (auto& input : op.inputs) {
         XLA_CHECK_LT(input.op_index, i);
-        XLA_CHECK_LT(input.output_index.value_or(0),
-                     ops_outputs[input.op_index].size());
-        arguments.push_back(
-            ops_outputs[input.op_index][input.output_index.value_or(0)]);
+        absl::StrAppend(&plan_key, ",", input.op_index, ":",
+                        input.output_index.value_or(0));
       }
-
-      std::vector<tensorflow::Output> exec_ops = CreateExecuteOps(
-          &session_map, dynamic_cast<const XrtComputation&>(*op.computation),
-          BuildParallelArguments(arguments), /*explode_tuple=*/true,
-          {effective_device}, &feed_inputs);
-
-      std::vector<tensorflow::Tensor> outputs;
-      util::CheckComputationStatus(
-          session->session()->Run(feed_inputs, {exec_ops.front()}, &outputs),
-          {&op.computation->computation()},
-          {&op.computation->program_shape().result()});
-      XLA_CHECK_EQ(outputs.size(), 1);
-      ops_outputs[i] = GetComputationResults(
-          outputs[0], op.computation->program_shape().result(),
-          effective_device);
     }
-
     for (auto& output : op.outputs) {
-      if (output.result_index >= results.size()) {
-        results.resize(output.result_index + 1);
+      if (output.result_index >= results_fetch.size()) {
+        results_op.resize(output.result_index + 1);
+        results_fetch.resize(output.result_index + 1);
+      }
+      results_op[output.result_index] = i;
+      // A device data is returned as is, as a new data wrapping its handle
+      // would release it a second time.
+      if (op.device_data != nullptr) {
+        continue;
+      }
+      // The same output can be requested more than once, but it must be
+      // wrapped by a single data, which owns its handle.
+      int64_t index = output.output_index.value_or(0);
+      auto it = std::find(ops_fetched[i].begin(), ops_fetched[i].end(), index);
+      if (it == ops_fetched[i].end()) {
+        ops_fetched[i].push_back(index);
+        fetches.emplace_back(i, index);
+        absl::StrAppend(&plan_key, ",o", index);
+        results_fetch[output.result_index] = fetches.size() - 1;
+      } else {
+        results_fetch[output.result_index] =
+            fetches.size() - ops_fetched[i].size() +
+            std::distance(ops_fetched[i].begin(), it);
       }
-      XLA_CHECK_LT(output.output_index.value_or(0), ops_outputs[i].size());
-      results[output.result_index] =
-          ops_outputs[i][output.output_index.value_or(0)];
     }
-    // Drop references to any intermediate result which is not used anymore.
-    for (auto& input : op.inputs) {
-      uses[input.op_index] -= 1;
-      if (uses[input.op_index] == 0) {
-        ops_outputs[input.op_index].clear();
+  }
+
+  XrtSession::NodeCache* cache = session->GetNodeCache(plan_key);
+  if (cache->Empty()) {
+    XLA_COUNTER("XrtChainedPlan_Empty", 1);
+    std::vector<tensorflow::ops::Placeholder> holders(
+        {tensorflow::ops::Placeholder(device_scope, tensorflow::DT_STRING)});
+    std::vector<tensorflow::Output> ops_handles(ops.size());
+    std::vector<std::vector<tensorflow::Operation>> ops_consumers(ops.size());
+    // Returns the handle of the index output of the op at op_index, as a one
+    // element vector.
+    auto get_output_handle = [&](size_t op_index, int64_t index) {
+      return tensorflow::ops::Slice(device_scope, ops_handles[op_index],
+                                    {index}, {1})
+          .output;
+    };
+    for (size_t i = 0; i < ops.size(); ++i) {
+      const ExecuteChainedOp& op = ops[i];
+      if (op.device_data != nullptr) {
+        holders.emplace_back(device_scope, tensorflow::DT_INT64,
+                             tensorflow::ops::Placeholder::Shape({1}));
+        ops_handles[i] = holders.back();
+        continue;
+      }
+      holders.emplace_back(device_scope, tensorflow::DT_INT64);
+      std::vector<tensorflow::Output> input_handles;
+      input_handles.reserve(op.inputs.size());
+      for (auto& input : op.inputs) {
+        input_handles.push_back(get_output_handle(
+            input.op_index, input.output_index.value_or(0)));
+      }
+      tensorflow::ops::XRTExecute execute(device_scope, holders.back(),
+                                          holders.front(), input_handles);
+      for (auto& input : op.inputs) {
+        ops_consumers[input.op_index].push_back(execute.operation);
       }
+      ops_handles[i] = execute.output_handle;
     }
-    // We can reset the TF op cache here so that we don't keep allocating new
-    // TF op nodes on the session graph.
-    session->Reset();
+    std::vector<tensorflow::Output> fetch_outputs;
+    for (auto& fetch : fetches) {
+      fetch_outputs.push_back(get_output_handle(fetch.first, fetch.second));
+    }
+    std::vector<tensorflow::Operation> releases;
+    for (size_t i = 0; i < ops.size(); ++i) {
+      if (ops[i].device_data != nullptr) {
+        continue;
+      }
+      // Release the result handles of the op which are not fetched, after the
+      // ops consuming them.
+      int64_t count = ops_shapes[i]->IsTuple()
+                          ? ShapeUtil::TupleElementCount(*ops_shapes[i])
+                          : 1;
+      std::vector<int64_t> released;
+      for (int64_t j = 0; j < count; ++j) {
+        if (std::find(ops_fetched[i].begin(), ops_fetched[i].end(), j) ==
+            ops_fetched[i].end()) {
+          released.push_back(j);
+        }
+      }
+      if (released.empty()) {
+        continue;
+      }
+      tensorflow::Scope release_scope =
+          device_scope.WithControlDependencies(ops_consumers[i]);
+      tensorflow::Output handles = ops_handles[i];
+      if (released.size() < static_cast<size_t>(count)) {
+        tensorflow::Tensor indices(
+            tensorflow::DT_INT64,
+            tensorflow::TensorShape({static_cast<int64_t>(released.size())}));
+        for (size_t j = 0; j < released.size(); ++j) {
+          indices.flat<tensorflow::int64>()(j) = released[j];
+        }
+        handles = tensorflow::ops::Gather(
+            release_scope, handles,
+            tensorflow::ops::Const(release_scope, indices));
+      }
+      releases.push_back(
+          tensorflow::ops::XRTReleaseAllocationHandle(release_scope, handles)
+              .operation);
+    }
+    auto cached_node = std::make_shared<XrtSession::CachedNode>(
+        std::move(fetch_outputs), std::move(holders));
+    cached_node->operations = std::move(releases);
+    cache->Add(std::move(cached_node));
+  }
+  const XrtSession::CachedNode& cached_node = cache->Get();
+
+  tensorflow::ClientSession::FeedType feed_inputs;
+  xrt::XRTExecutionConfig exec_config;
+  exec_config.set_core_index_in_replica(0);
+  exec_config.set_release_input_handles(false);
+  exec_config.set_release_compilation_handle(false);
+  exec_config.set_return_exploded_tuple(true);
+  exec_config.set_rng_seed(rng_seed_);
+  feed_inputs.insert({cached_node.holders[0], exec_config.SerializeAsString()});
+  for (size_t i = 0; i < ops.size(); ++i) {
+    const ExecuteChainedOp& op = ops[i];
+    if (op.device_data != nullptr) {
+      const XrtData& xrt_data = dynamic_cast<const XrtData&>(*op.device_data);
+      XLA_CHECK_EQ(xrt_data.device()->name(), effective_device);
+      tensorflow::Tensor handle_tensor(tensorflow::DT_INT64,
+                                       tensorflow::TensorShape({1}));
+      handle_tensor.flat<tensorflow::int64>()(0) = xrt_data.get_handle();
+      feed_inputs.insert({cached_node.holders[i + 1], handle_tensor});
+    } else {
+      const XrtComputation& xrt_computation =
+          dynamic_cast<const XrtComputation&>(*op.computation);
+      feed_inputs.insert(
+          {cached_node.holders[i + 1], xrt_computation.get_handle()});
+    }
+  }
+  std::vector<tensorflow::Operation> targets =
+      AttachPendingReleases(session, effective_device, &feed_inputs);
+  targets.insert(targets.end(), cached_node.operations.begin(),
+                 cached_node.operations.end());
+
+  std::vector<tensorflow::Tensor> outputs;
+  {
+    device_activity::ScopedExecution execution(effective_device);
+    util::CheckComputationStatus(
+        session->session()->Run(feed_inputs, cached_node.outputs, targets,
+                                &outputs),
+        {}, {});
+  }
+  XLA_CHECK_EQ(outputs.size(), fetches.size());
+
+  std::vector<DataPtr> fetched_data;
+  fetched_data.reserve(outputs.size());
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    const Shape& shape = ops_shapes[fetches[i].first]->IsTuple()
+                             ? ShapeUtil::GetTupleElementShape(
+                                   *ops_shapes[fetches[i].first],
+                                   fetches[i].second)
+                             : *ops_shapes[fetches[i].first];
+    fetched_data.push_back(std::make_shared<XrtData>(
+        dynamic_cast<XrtDevice*>(GetDevice(effective_device)), shape,
+        outputs[i].flat<tensorflow::int64>()(0)));
+  }
+  CreateDataHandlesCounter()->AddValue(fetched_data.size());
+  std::vector<DataPtr> results;
+  results.reserve(results_fetch.size());
+  for (size_t i = 0; i < results_fetch.size(); ++i) {
+    const ExecuteChainedOp& op = ops[results_op[i]];
+    results.push_back(op.device_data != nullptr
+                          ? op.device_data
+                          : fetched_data[results_fetch[i]]);
   }
   return results;
 }
@@ -1257,6 +1883,7 @@ XrtComputationClient::DeconstructTuple(absl::Span<const DataPtr> tuples) {
 XrtSession* XrtComputationClient::GetSessionForTarget(
     XrtSessionCache* cache, const std::string& target,
     XrtSessionCache::SessionMap* session_map) {
+  WaitForDevices();
   return cache->GetSession(target, session_map);
 }
 
@@ -1299,8 +1926,8 @@ const std::string& XrtComputationClient::SwiftDeviceToXrtDevice(
 }
 
 std::unique_ptr<xrt::XLAComputation> XrtComputationClient::CreateXrtComputation(
-    const XlaComputation& computation, absl::Span<const std::string> devices,
-    const Shape* output_shape) const {
+    XlaComputation* computation, absl::Span<const std::string> devices,
+    const Shape* output_shape, bool fast_compile) const {
   std::unique_ptr<xrt::XLAComputation> xrt_computation(
       new xrt::XLAComputation());
   auto config = xrt_computation->mutable_config();
@@ -1331,13 +1958,21 @@ std::unique_ptr<xrt::XLAComputation> XrtComputationClient::CreateXrtComputation(
     config->set_num_replicas(devices.size());
   }
   *config->mutable_program_shape() =
-      computation.GetProgramShape().ValueOrDie().ToProto();
+      computation->GetProgramShape().ValueOrDie().ToProto();
   if (output_shape != nullptr) {
     *config->mutable_program_shape()->mutable_result() =
         output_shape->ToProto();
   }
-  *xrt_computation->mutable_hlo_snapshot() =
-      std::move(*computation.Snapshot().ConsumeValueOrDie());
+  if (fast_compile) {
+    // The debug options of the config replace the flag ones altogether.
+    *config->mutable_debug_options() = GetDebugOptionsFromFlags();
+    util::SetFastCompileOptions(config->mutable_debug_options());
+  }
+  // The HLO module gets moved rather than copied, as it can be large.
+  HloModuleProto* hlo_module = xrt_computation->mutable_hlo_snapshot()
+                                   ->mutable_hlo()
+                                   ->mutable_hlo_module();
+  *hlo_module = std::move(*computation->mutable_proto());
   return xrt_computation;
 }
 
@@ -1354,13 +1989,12 @@ tensorflow::Tensor XrtComputationClient::GetArgumentsInputs(
   return inputs_tensor;
 }
 
-std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteOps(
+void XrtComputationClient::CreateExecuteOps(
     XrtSessionCache::SessionMap* session_map,
     absl::Span<const Computation* const> computations,
     const std::vector<std::vector<DataPtr>>& arguments, bool explode_tuple,
     absl::Span<const std::string> devices,
-    tensorflow::ClientSession::FeedType* feed_inputs) {
-  std::vector<tensorflow::Output> exec_ops;
+    std::map<XrtSession*, SessionWork>* session_work_map) {
   for (size_t i = 0; i < computations.size(); ++i) {
     const XrtComputation* xrt_computation =
         dynamic_cast<const XrtComputation*>(computations[i]);
@@ -1368,10 +2002,11 @@ std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteOps(
     const std::string& xrt_device = SwiftDeviceToXrtDevice(devices[i]);
     XrtSession* session =
         GetSessionForXrtDevice(session_cache_.get(), xrt_device, session_map);
+    SessionWork* session_work = &(*session_work_map)[session];
     tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
     const XrtSession::CachedNode& cached_node =
         GetExecuteNode(session, device_scope, devices[i]);
-    feed_inputs->insert(
+    session_work->feed_inputs.insert(
         {cached_node.holders[0], xrt_computation->get_handle()});
 
     xrt::XRTExecutionConfig exec_config;
@@ -1380,44 +2015,65 @@ std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteOps(
     exec_config.set_release_compilation_handle(false);
     exec_config.set_return_exploded_tuple(explode_tuple);
     exec_config.set_rng_seed(rng_seed_);
-    feed_inputs->insert(
+    session_work->feed_inputs.insert(
         {cached_node.holders[1], exec_config.SerializeAsString()});
-    feed_inputs->insert({cached_node.holders[2], inputs});
+    session_work->feed_inputs.insert({cached_node.holders[2], inputs});
 
-    exec_ops.push_back(cached_node.outputs[0]);
+    session_work->outputs_handles.push_back(cached_node.outputs[0]);
+    session_work->index_mapping.push_back(i);
   }
-  return exec_ops;
 }
 
-std::vector<tensorflow::Output> XrtComputationClient::CreateExecuteOps(
+void XrtComputationClient::CreateExecuteOps(
     XrtSessionCache::SessionMap* session_map, const XrtComputation& computation,
     const std::vector<std::vector<DataPtr>>& arguments, bool explode_tuple,
     absl::Span<const std::string> devices,
-    tensorflow::ClientSession::FeedType* feed_inputs) {
-  std::vector<tensorflow::Output> exec_ops;
-  for (size_t i = 0; i < arguments.size(); ++i) {
-    auto inputs = GetArgumentsInputs(arguments[i], devices[i]);
-    const std::string& xrt_device = SwiftDeviceToXrtDevice(devices[i]);
-    XrtSession* session =
-        GetSessionForXrtDevice(session_cache_.get(), xrt_device, session_map);
-    tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
-    const XrtSession::CachedNode& cached_node =
-        GetExecuteNode(session, device_scope, devices[i]);
-    feed_inputs->insert({cached_node.holders[0], computation.get_handle()});
-
-    xrt::XRTExecutionConfig exec_config;
-    exec_config.set_core_index_in_replica(0);
-    exec_config.set_release_input_handles(false);
-    exec_config.set_release_compilation_handle(false);
-    exec_config.set_return_exploded_tuple(explode_tuple);
-    exec_config.set_rng_seed(rng_seed_);
-    feed_inputs->insert(
-        {cached_node.holders[1], exec_config.SerializeAsString()});
-    feed_inputs->insert({cached_node.holders[2], inputs});
+    std::map<XrtSession*, SessionWork>* session_work_map) {
+  std::vector<const Computation*> computations(arguments.size(), &computation);
+  CreateExecuteOps(session_map, computations, arguments, explode_tuple,
+                   devices, session_work_map);
+}
 
-    exec_ops.push_back(cached_node.outputs[0]);
-  }
-  return exec_ops;
+const XrtSession::Callable* XrtComputationClient::GetExecuteCallable(
+    XrtSession* session, const XrtComputation& computation, bool explode_tuple,
+    const std::string& device) {
+  size_t rng_seed = rng_seed_;
+  std::string key = absl::StrCat(XrtSession::GetCacheKey("XrtExecute", device),
+                                 ";", computation.get_handle(), ";",
+                                 explode_tuple, ";", rng_seed);
+  const XrtSession::Callable* callable = session->GetCallable(key);
+  if (callable != nullptr) {
+    return callable;
+  }
+  const std::string& xrt_device = SwiftDeviceToXrtDevice(device);
+  tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
+  // The callable only refers to the node names, so any node out of the cache
+  // will do, and it stays valid after the node cache gets rewound.
+  const XrtSession::CachedNode& cached_node =
+      GetExecuteNode(session, device_scope, device);
+
+  xrt::XRTExecutionConfig exec_config;
+  exec_config.set_core_index_in_replica(0);
+  exec_config.set_release_input_handles(false);
+  exec_config.set_release_compilation_handle(false);
+  exec_config.set_return_exploded_tuple(explode_tuple);
+  exec_config.set_rng_seed(rng_seed);
+  tensorflow::Tensor handle_tensor(tensorflow::DT_INT64,
+                                   tensorflow::TensorShape());
+  handle_tensor.scalar<tensorflow::int64>()() = computation.get_handle();
+  tensorflow::Tensor config_tensor(tensorflow::DT_STRING,
+                                   tensorflow::TensorShape());
+  config_tensor.scalar<tensorflow::tstring>()() =
+      exec_config.SerializeAsString();
+
+  tensorflow::CallableOptions callable_options;
+  for (auto& holder : cached_node.holders) {
+    callable_options.add_feed(tensorflow::Output(holder).name());
+  }
+  callable_options.add_fetch(cached_node.outputs[0].name());
+  return session->AddCallable(key, callable_options,
+                              {std::move(handle_tensor),
+                               std::move(config_tensor)});
 }
 
 void XrtComputationClient::ReleaseHandles(
@@ -1437,7 +2093,7 @@ void XrtComputationClient::ReleaseHandles(
     XrtSessionCache::SessionMap session_map;
     std::map<XrtSession*, std::vector<DeviceHandle>> session_handles_map;
     for (auto& handle : released_handles) {
-      XrtSession* session = GetSessionForDevice(session_cache_.get(),
+      XrtSession* session = GetSessionForDevice(transfer_session_cache_.get(),
                                                 handle.device, &session_map);
       session_handles_map[session].push_back(handle);
     }
@@ -1502,9 +2158,78 @@ void XrtComputationClient::ReleaseHandle(int64_t handle,
     std::lock_guard<std::mutex> lock(lock_);
     handles->push_back({device, handle});
   }
+  if (PiggybackReleases()) {
+    // The releases ride on the next session runs, and only the ones which are
+    // still pending after the idle timeout get their own round trip.
+    static const int64_t idle_timeout_ms =
+        sys_util::GetEnvInt("XRT_RELEASE_IDLE_TIMEOUT_MS", 100);
+    if (!release_timer_armed_.exchange(true)) {
+      env::ScheduleIoClosure([this]() {
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(idle_timeout_ms));
+        release_timer_armed_ = false;
+        triggered_task_->Activate();
+      });
+    }
+    return;
+  }
   triggered_task_->Activate();
 }
 
+std::vector<tensorflow::Operation> XrtComputationClient::AttachPendingReleases(
+    XrtSession* session, const std::string& device,
+    tensorflow::ClientSession::FeedType* feed_inputs) {
+  std::vector<tensorflow::Operation> release_ops;
+  if (!PiggybackReleases()) {
+    return release_ops;
+  }
+  const std::string& target = GetWorkerForDevice(device).second;
+  auto take_handles = [&](std::vector<DeviceHandle>* handles) {
+    std::map<std::string, std::vector<int64_t>> device_handles;
+    auto other_worker = [&](const DeviceHandle& handle) {
+      return GetWorkerForDevice(handle.device).second != target;
+    };
+    auto it = std::partition(handles->begin(), handles->end(), other_worker);
+    for (auto hit = it; hit != handles->end(); ++hit) {
+      device_handles[hit->device].push_back(hit->handle);
+    }
+    handles->erase(it, handles->end());
+    return device_handles;
+  };
+  std::map<std::string, std::vector<int64_t>> data_handles;
+  std::map<std::string, std::vector<int64_t>> compile_handles;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    data_handles = take_handles(&released_data_handles_);
+    compile_handles = take_handles(&released_compile_handles_);
+  }
+  auto add_releases =
+      [&](const std::map<std::string, std::vector<int64_t>>& device_handles,
+          bool is_compile, metrics::Counter* destroy_counter) {
+        for (auto& device_and_handles : device_handles) {
+          const std::string& handles_device = device_and_handles.first;
+          tensorflow::Scope device_scope = session->root()->WithDevice(
+              SwiftDeviceToXrtDevice(handles_device));
+          const XrtSession::CachedNode& cached_node =
+              is_compile ? GetReleaseCompileHandleNode(session, device_scope,
+                                                       handles_device)
+                         : GetReleaseAllocationHandleNode(session, device_scope,
+                                                          handles_device);
+          feed_inputs->insert({cached_node.holders[0],
+                               MakeHandlesTensor(device_and_handles.second)});
+          release_ops.push_back(cached_node.operations[0]);
+          destroy_counter->AddValue(device_and_handles.second.size());
+          XLA_COUNTER("XrtPiggybackedReleases",
+                      device_and_handles.second.size());
+        }
+      };
+  add_releases(data_handles, /*is_compile=*/false,
+               DestroyDataHandlesCounter());
+  add_releases(compile_handles, /*is_compile=*/true,
+               DestroyCompileHandlesCounter());
+  return release_ops;
+}
+
 void XrtComputationClient::ReleaseXrtData(const std::string& device,
                                           int64_t handle) {
   ReleaseHandle(handle, device, &released_data_handles_);
@@ -1536,6 +2261,7 @@ XrtComputationClient::GetWorkerForDevice(const std::string& device) const {
 
 const std::vector<int>& XrtComputationClient::GetDeviceMeshCoords(
     const std::string& xrt_device) const {
+  WaitForDevices();
   auto it = device_mesh_coords_.find(xrt_device);
   if (it == device_mesh_coords_.end()) {
     TF_LOG(FATAL) << "Missing mesh coordinates for device: " << xrt_device;
@@ -1586,8 +2312,27 @@ tensorflow::tpu::TopologyProto XrtComputationClient::InitializeAndFetchTopology(
   return ParseProto<tensorflow::tpu::TopologyProto>(outputs[0]);
 }
 
+std::string XrtComputationClient::GetTopologyCachePath(
+    const Worker& worker, const std::string& worker_host_port) const {
+  static std::string cache_dir =
+      sys_util::GetEnvString("XRT_TOPOLOGY_CACHE_DIR", "");
+  if (cache_dir.empty()) {
+    return std::string();
+  }
+  // The topology only depends on the pod configuration, which the cluster
+  // definition and the configured worker identify.
+  std::string key = absl::StrCat(
+      session_cache_->GetConfig().cluster_def().SerializeAsString(), "|",
+      worker.name, ":", worker.task_no, "|", worker_host_port);
+  return absl::StrCat(cache_dir, "/topology-",
+                      absl::Hex(tensorflow::Hash64(key), absl::kZeroPad16),
+                      ".pb");
+}
+
 void XrtComputationClient::InitializeDevices(
     std::unique_ptr<tensorflow::tpu::TopologyProto> topology_proto) {
+  auto devices_promise = std::make_shared<std::promise<void>>();
+  devices_ready_ = devices_promise->get_future().share();
   if (topology_proto == nullptr) {
     std::set<Worker> tpu_workers;
     for (const auto& dev_target : options_.global_device_map) {
@@ -1602,20 +2347,74 @@ void XrtComputationClient::InitializeDevices(
       auto it = options_.workers_map.find(worker);
       XLA_CHECK(it != options_.workers_map.end());
 
-      TF_VLOG(1) << "Configuring TPU for worker " << worker.name << ":"
-                 << worker.task_no << " at " << it->second;
-      tensorflow::tpu::TopologyProto worker_topology_proto =
-          InitializeAndFetchTopology(worker.name, worker.task_no, it->second,
-                                     session_cache_->GetConfig());
-      if (topology_proto == nullptr) {
-        topology_proto = absl::make_unique<tensorflow::tpu::TopologyProto>(
-            std::move(worker_topology_proto));
+      std::string cache_path = GetTopologyCachePath(worker, it->second);
+      auto cached_topology_proto =
+          std::make_shared<tensorflow::tpu::TopologyProto>();
+      bool cached =
+          !cache_path.empty() &&
+          tensorflow::ReadBinaryProto(tensorflow::Env::Default(), cache_path,
+                                      cached_topology_proto.get())
+              .ok();
+      // Configuring the TPU system is what takes long on pods, so it runs in
+      // the background, while the client goes on with its setup, and the
+      // model with its tracing. The first use of a device session waits for
+      // it. With a cached topology, the mesh gets set up right away.
+      std::string host_port = it->second;
+      auto configure = [this, worker, host_port, cache_path, cached,
+                        cached_topology_proto, devices_promise]() {
+        try {
+          TF_VLOG(1) << "Configuring TPU for worker " << worker.name << ":"
+                     << worker.task_no << " at " << host_port;
+          XLA_TIMED("ConfigureTpu");
+          tensorflow::tpu::TopologyProto worker_topology_proto =
+              InitializeAndFetchTopology(worker.name, worker.task_no,
+                                         host_port,
+                                         session_cache_->GetConfig());
+          TF_VLOG(1) << "TPU topology: " << worker_topology_proto.DebugString();
+          bool stale = cached && worker_topology_proto.SerializeAsString() !=
+                                     cached_topology_proto->SerializeAsString();
+          if (!cache_path.empty() && (!cached || stale)) {
+            std::string temp_path = absl::StrCat(cache_path, ".tmp");
+            tensorflow::Env* env = tensorflow::Env::Default();
+            if (!tensorflow::WriteBinaryProto(env, temp_path,
+                                              worker_topology_proto)
+                     .ok() ||
+                !env->RenameFile(temp_path, cache_path).ok()) {
+              TF_LOG(WARNING) << "Unable to cache the TPU topology to "
+                              << cache_path;
+            }
+          }
+          XLA_CHECK(!stale)
+              << "The TPU topology cached in " << cache_path
+              << " did not match the configured one; the cache has been "
+                 "updated, and the job must restart";
+          if (!cached) {
+            InitializeDeviceMesh(&worker_topology_proto);
+          }
+          devices_promise->set_value();
+        } catch (...) {
+          devices_promise->set_exception(std::current_exception());
+        }
+      };
+      if (cached) {
+        XLA_COUNTER("TpuTopologyCacheHit", 1);
+        TF_VLOG(1) << "TPU topology from " << cache_path << ": "
+                   << cached_topology_proto->DebugString();
+        InitializeDeviceMesh(cached_topology_proto.get());
       }
+      env::ScheduleIoClosure(std::move(configure));
+      return;
     }
-    if (topology_proto != nullptr) {
-      TF_VLOG(1) << "TPU topology: " << topology_proto->DebugString();
-    }
   }
+  if (topology_proto != nullptr) {
+    TF_VLOG(1) << "TPU topology: " << topology_proto->DebugString();
+  }
+  InitializeDeviceMesh(topology_proto.get());
+  devices_promise->set_value();
+}
+
+void XrtComputationClient::InitializeDeviceMesh(
+    const tensorflow::tpu::TopologyProto* topology_proto) {
   for (const auto& dev_target : options_.global_device_map) {
     tensorflow::DeviceNameUtils::ParsedName parsed_device =
         ParseFullXrtDevice(dev_target.second);
@@ -1649,12 +2448,39 @@ void XrtComputationClient::InitializeDevices(
   if (!mesh_service_address.empty() && !mp_device.empty()) {
     DeviceId device(mp_device);
     if (device.ordinal == 0) {
-      CreateMeshService(mesh_service_address, topology_proto.get());
+      CreateMeshService(mesh_service_address, topology_proto);
     }
     SetupGpuRuntime();
   }
 }
 
+void XrtComputationClient::WaitForDevices() const {
+  devices_ready_.get();
+}
+
+void XrtComputationClient::PrewarmSessions() {
+  // Creating the sessions of a worker builds their graphs and connects to it,
+  // so the workers of the local devices get theirs in parallel, instead of
+  // one after the other at their first use.
+  std::set<std::string> targets;
+  for (auto& device : options_.devices) {
+    targets.insert(
+        GetWorkerForXrtDevice(SwiftDeviceToXrtDevice(device)).second);
+  }
+  for (const std::string& target : targets) {
+    env::ScheduleIoClosure([this, target]() {
+      try {
+        XrtSessionCache::Ref session = session_cache_->GetSession(target);
+        XrtSessionCache::Ref transfer_session =
+            transfer_session_cache_->GetSession(target);
+      } catch (const std::exception& ex) {
+        TF_VLOG(1) << "Unable to prewarm the sessions of " << target << ": "
+                   << ex.what();
+      }
+    });
+  }
+}
+
 void XrtComputationClient::SetupGpuRuntime() {
   LOG(FATAL) << "Not implemented yet; need to upgrade XRT first";
 }
@@ -1740,6 +2566,26 @@ std::vector<std::string> XrtComputationClient::GetLocalDevices() const {
 
 void XrtComputationClient::SetRngSeed(size_t seed) { rng_seed_ = seed; }
 
+ComputationClient::MemoryInfo XrtComputationClient::GetMemoryInfo(
+    const std::string& device) {
+  XrtSessionCache::SessionMap session_map;
+  XrtSession* session =
+      GetSessionForDevice(session_cache_.get(), device, &session_map);
+  tensorflow::Scope device_scope =
+      session->root()->WithDevice(SwiftDeviceToXrtDevice(device));
+  const XrtSession::CachedNode& cached_node =
+      GetMemoryInfoNode(session, device_scope, device);
+  std::vector<tensorflow::Tensor> outputs;
+  XLA_CHECK_OK(session->session()->Run(cached_node.outputs, &outputs));
+  XLA_CHECK_EQ(outputs.size(), 1);
+
+  xrt::MemoryInfo xrt_info = ParseProto<xrt::MemoryInfo>(outputs[0]);
+  MemoryInfo info;
+  info.bytes_limit = xrt_info.kb_total() * 1024;
+  info.bytes_in_use = (xrt_info.kb_total() - xrt_info.kb_free()) * 1024;
+  return info;
+}
+
 std::map<std::string, Metric> XrtComputationClient::GetMetrics() const {
   static const std::map<std::string, std::string>* metric_remap =
       new std::map<std::string, std::string>{
@@ -1851,18 +2697,28 @@ std::map<std::string, Metric> XrtComputationClient::GetMetrics() const {
 }
 
 void XrtComputationClient::InitSession(XrtSession* session) const {
+  InitSessionNodes(session, /*transfer_only=*/false);
+}
+
+void XrtComputationClient::InitTransferSession(XrtSession* session) const {
+  InitSessionNodes(session, /*transfer_only=*/true);
+}
+
+void XrtComputationClient::InitSessionNodes(XrtSession* session,
+                                            bool transfer_only) const {
   struct InitNode {
     int count;
+    bool transfer;
     const XrtSession::CachedNode& (XrtComputationClient::*node_ctor)(
         XrtSession*, const tensorflow::Scope&, const std::string&) const;
   } const init_nodes[] = {
-      {16, &XrtComputationClient::GetCompileNode},
-      {16, &XrtComputationClient::GetExecuteNode},
-      {16, &XrtComputationClient::GetExecuteChainedNode},
-      {16, &XrtComputationClient::GetReadNode},
-      {16, &XrtComputationClient::GetReleaseAllocationHandleNode},
-      {16, &XrtComputationClient::GetReleaseCompileHandleNode},
-      {16, &XrtComputationClient::GetSubTupleNode},
+      {16, false, &XrtComputationClient::GetCompileNode},
+      {16, false, &XrtComputationClient::GetExecuteNode},
+      {16, false, &XrtComputationClient::GetExecuteChainedNode},
+      {16, true, &XrtComputationClient::GetReadNode},
+      {16, true, &XrtComputationClient::GetReleaseAllocationHandleNode},
+      {16, true, &XrtComputationClient::GetReleaseCompileHandleNode},
+      {16, false, &XrtComputationClient::GetSubTupleNode},
   };
   auto devices = GetLocalDevices();
   for (auto& device : devices) {
@@ -1876,6 +2732,9 @@ void XrtComputationClient::InitSession(XrtSession* session) const {
     const std::string& xrt_device = SwiftDeviceToXrtDevice(device);
     tensorflow::Scope device_scope = session->root()->WithDevice(xrt_device);
     for (auto& init : init_nodes) {
+      if (transfer_only && !init.transfer) {
+        continue;
+      }
       for (int i = 0; i < init.count; ++i) {
         (this->*init.node_ctor)(session, device_scope, device);
       }
@@ -2040,6 +2899,21 @@ const XrtSession::CachedNode& XrtComputationClient::GetSubTupleNode(
   return cache->Get();
 }
 
+const XrtSession::CachedNode& XrtComputationClient::GetMemoryInfoNode(
+    XrtSession* session, const tensorflow::Scope& scope,
+    const std::string& device) const {
+  static const std::string op_name("XrtMemoryInfo");  // NOLINT
+  XrtSession::NodeCache* cache =
+      session->GetNodeCache(XrtSession::GetCacheKey(op_name, device));
+  if (cache->Empty()) {
+    XLA_COUNTER("XrtMemoryInfo_Empty", 1);
+    cache->Add(std::make_shared<XrtSession::CachedNode>(
+        tensorflow::ops::XRTMemoryInfo(scope),
+        std::vector<tensorflow::ops::Placeholder>()));
+  }
+  return cache->Get();
+}
+
 tensorflow::DataType XrtComputationClient::XlaTypeToDataType(
     PrimitiveType dtype) {
   switch (dtype) {
@@ -19,6 +19,7 @@
 
 #include <atomic>
 #include <functional>
+#include <future>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -195,6 +196,10 @@ class XrtComputationClient : public ComputationClient,
 
   std::map<std::string, Metric> GetMetrics() const override;
 
+  // Returns the memory usage of the device, as reported by the XRT memory
+  // manager of its worker, which does not track the peak.
+  MemoryInfo GetMemoryInfo(const std::string& device);
+
   static Worker ParseWorker(const std::string& worker);
 
   static std::string GetMultiProcessingDevice();
@@ -206,26 +211,31 @@ class XrtComputationClient : public ComputationClient,
   struct CompilationCacheKey {
     struct Hash {
       size_t operator()(const CompilationCacheKey& entry) const {
-        util::PartialHasher<std::string, 4096> hasher;
+        util::PartialHasher<tensorflow::tstring, 4096> hasher;
         hash_t h = util::DataHash(entry.domain.data(), entry.domain.size());
         return util::HashReduce(
-            util::HashCombine(h, hasher(entry.serialized_computation)));
+            util::HashCombine(h, hasher(entry.serialized())));
       }
     };
 
-    CompilationCacheKey(std::string domain, std::string serialized_computation)
+    CompilationCacheKey(std::string domain,
+                        tensorflow::Tensor serialized_computation)
         : domain(std::move(domain)),
           serialized_computation(std::move(serialized_computation)) {}
     CompilationCacheKey() = default;
     CompilationCacheKey(CompilationCacheKey&&) = default;
     CompilationCacheKey& operator=(CompilationCacheKey&&) = default;
     bool operator==(const CompilationCacheKey& rhs) const {
-      return domain == rhs.domain &&
-             serialized_computation == rhs.serialized_computation;
+      return domain == rhs.domain && serialized() == rhs.serialized();
+    }
+
+    const tensorflow::tstring& serialized() const {
+      return serialized_computation.scalar<tensorflow::tstring>()();
     }
 
     std::string domain;
-    std::string serialized_computation;
+    // A string scalar, whose buffer the compile feeds share.
+    tensorflow::Tensor serialized_computation;
   };
 
   // When we split a batch operation into per-session batches, we use this data
@@ -251,37 +261,48 @@ class XrtComputationClient : public ComputationClient,
 
   const std::string& SwiftDeviceToXrtDevice(const std::string& device) const;
 
+  // Moves the HLO module of the computation into the returned XRT computation,
+  // to be moved back once serialized (see SerializeXrtComputation()).
   std::unique_ptr<xrt::XLAComputation> CreateXrtComputation(
-      const XlaComputation& computation, absl::Span<const std::string> devices,
-      const Shape* output_shape) const;
+      XlaComputation* computation, absl::Span<const std::string> devices,
+      const Shape* output_shape, bool fast_compile) const;
 
   tensorflow::Tensor GetArgumentsInputs(absl::Span<const DataPtr> arguments,
                                         const std::string& device);
 
-  std::vector<tensorflow::Output> CreateExecuteOps(
-      XrtSessionCache::SessionMap* session_map,
-      absl::Span<const Computation* const> computations,
-      const std::vector<std::vector<DataPtr>>& arguments, bool explode_tuple,
-      absl::Span<const std::string> devices,
-      tensorflow::ClientSession::FeedType* feed_inputs);
-
-  std::vector<tensorflow::Output> CreateExecuteOps(
-      XrtSessionCache::SessionMap* session_map,
-      const XrtComputation& computation,
-      const std::vector<std::vector<DataPtr>>& arguments, bool explode_tuple,
-      absl::Span<const std::string> devices,
-      tensorflow::ClientSession::FeedType* feed_inputs);
-
+  // Adds the execution of computations[i] on devices[i] to the work of the
+  // session of the worker of devices[i].
+  void CreateExecuteOps(XrtSessionCache::SessionMap* session_map,
+                        absl::Span<const Computation* const> computations,
+                        const std::vector<std::vector<DataPtr>>& arguments,
+                        bool explode_tuple,
+                        absl::Span<const std::string> devices,
+                        std::map<XrtSession*, SessionWork>* session_work_map);
+
+  void CreateExecuteOps(XrtSessionCache::SessionMap* session_map,
+                        const XrtComputation& computation,
+                        const std::vector<std::vector<DataPtr>>& arguments,
+                        bool explode_tuple,
+                        absl::Span<const std::string> devices,
+                        std::map<XrtSession*, SessionWork>* session_work_map);
+
+  // Runs the work of each session with a single session run, concurrently
+  // across the sessions.
   std::vector<std::vector<DataPtr>> RunComputations(
-      const XrtSessionCache::SessionMap& session_map,
-      const std::vector<tensorflow::Output>& exec_ops,
+      std::map<XrtSession*, SessionWork>* session_work_map,
       absl::Span<const Computation* const> computations,
-      absl::Span<const std::string> devices,
-      const tensorflow::ClientSession::FeedType& feed_inputs);
+      absl::Span<const std::string> devices);
 
   std::vector<DataPtr> TransferToServerInternal(
       XrtDevice* device_ptr, absl::Span<const TensorSource> tensors);
 
+  // Uploads a tensor bigger than chunk_size bytes as a set of slices along its
+  // major dimension, with a bounded number of slices in flight, and
+  // concatenates them back on the device.
+  DataPtr TransferChunkedToServer(XrtDevice* device_ptr,
+                                  const TensorSource& tensor,
+                                  int64_t chunk_size);
+
   // Retrieves the worker,worker_host pair for a given S4TF device (ie,
   // TPU:0).
   std::pair<Worker, std::string> GetWorkerForDevice(
@@ -302,6 +323,22 @@ class XrtComputationClient : public ComputationClient,
   void ReleaseHandle(int64_t handle, const std::string& device,
                      std::vector<DeviceHandle>* handles);
 
+  // Returns the callable running the computation on device within session,
+  // with the computation handle and execution config feeds pre-bound, so that
+  // only the arguments handles need to be fed. Returns nullptr if the session
+  // does not support callables.
+  const XrtSession::Callable* GetExecuteCallable(
+      XrtSession* session, const XrtComputation& computation,
+      bool explode_tuple, const std::string& device);
+
+  // When the releases get piggybacked (XRT_PIGGYBACK_RELEASES), moves the
+  // pending releases of the handles living on the same worker as device into
+  // the feeds of the session run which is about to take place, and returns the
+  // release operations to be added to its targets.
+  std::vector<tensorflow::Operation> AttachPendingReleases(
+      XrtSession* session, const std::string& device,
+      tensorflow::ClientSession::FeedType* feed_inputs);
+
   void ReleaseXrtData(const std::string& device, int64_t handle);
 
   void ReleaseXrtComputation(const std::string& compilation_device,
@@ -318,9 +355,28 @@ class XrtComputationClient : public ComputationClient,
   const std::vector<int>& GetDeviceMeshCoords(
       const std::string& xrt_device) const;
 
+  // Starts the configuration of the TPU system, in the background when it has
+  // to fetch the topology.
   void InitializeDevices(
       std::unique_ptr<tensorflow::tpu::TopologyProto> topology_proto);
 
+  // Sets up the device mesh coordinates, and the mesh service, from the
+  // topology.
+  void InitializeDeviceMesh(
+      const tensorflow::tpu::TopologyProto* topology_proto);
+
+  // Waits for the devices to be configured, and rethrows the configuration
+  // error if it failed.
+  void WaitForDevices() const;
+
+  // Returns the XRT_TOPOLOGY_CACHE_DIR file caching the topology fetched from
+  // the worker, or an empty string if the cache is disabled.
+  std::string GetTopologyCachePath(const Worker& worker,
+                                   const std::string& worker_host_port) const;
+
+  // Creates the sessions of the workers of the local devices in parallel.
+  void PrewarmSessions();
+
   void CreateMeshService(const std::string& address,
                          const tensorflow::tpu::TopologyProto* topology_proto);
 
@@ -332,12 +388,19 @@ class XrtComputationClient : public ComputationClient,
 
   void InitSession(XrtSession* session) const;
 
+  // Like InitSession(), but only pre-creates the read and release nodes, which
+  // are the only ones the transfer sessions use.
+  void InitTransferSession(XrtSession* session) const;
+
+  void InitSessionNodes(XrtSession* session, bool transfer_only) const;
+
   // Implement the chained execution using the XRTExecuteChained op support.
   std::vector<DataPtr> ExecuteChainedXrt(absl::Span<const ExecuteChainedOp> ops,
                                          const std::string& device);
 
-  // Implement the chained execution using multiple XRTExecute in many RPC round
-  // trips.
+  // Implement the chained execution using a graph of XRTExecute ops, wired
+  // together by their result handles, and run with a single session round
+  // trip.
   std::vector<DataPtr> ExecuteChainedSplit(
       absl::Span<const ExecuteChainedOp> ops, const std::string& device);
 
@@ -447,12 +510,24 @@ class XrtComputationClient : public ComputationClient,
       XrtSession* session, const tensorflow::Scope& scope,
       const std::string& device) const;
 
+  // Creates an XRTMemoryInfo node:
+  //
+  //  XRTMemoryInfo()
+  const XrtSession::CachedNode& GetMemoryInfoNode(
+      XrtSession* session, const tensorflow::Scope& scope,
+      const std::string& device) const;
+
   // Checks the result of a compile operation, and dumps the XLA computation
   // graphs in case of error.
   static void CheckCompileStatus(const Status& status,
                                  const std::vector<CompileInstance>& instances,
                                  const SessionWork& session_work);
 
+  // Checks the result of an execute operation, and dumps the XLA computation
+  // graphs in case of error.
+  static void CheckExecuteStatus(
+      const Status& status, absl::Span<const Computation* const> computations);
+
   // Converts an XLA data type to a tensorflow data type.
   static tensorflow::DataType XlaTypeToDataType(PrimitiveType dtype);
 
@@ -485,12 +560,23 @@ class XrtComputationClient : public ComputationClient,
   Options options_;
   std::mutex lock_;
   std::map<std::string, std::vector<int>> device_mesh_coords_;
+  // Ready once the TPU system is configured and the mesh coordinates are set.
+  std::shared_future<void> devices_ready_;
   std::unique_ptr<XrtSessionCache> session_cache_;
+  // Serves the downloads and the handle releases.
+  std::unique_ptr<XrtSessionCache> transfer_session_cache_;
   std::unique_ptr<XrtSessionCache> alloc_session_cache_;
+  // The twins of the transfer caches whose sessions compress the gRPC
+  // messages, which only exist with XRT_GRPC_COMPRESSION_ADAPTIVE.
+  std::unique_ptr<XrtSessionCache> compressed_session_cache_;
+  std::unique_ptr<XrtSessionCache> compressed_alloc_session_cache_;
   std::unique_ptr<util::TriggeredTask> triggered_task_;
   util::Cache<CompilationCacheKey, Computation, CompilationCacheKey::Hash>
       compilation_cache_;
   std::atomic<size_t> rng_seed_;
+  // Whether a standalone release has been scheduled for the handles which do
+  // not get piggybacked in time.
+  std::atomic<bool> release_timer_armed_;
   // Access to the following members must be done while holding lock_.
   // XRT thread safety semantics.
   std::vector<DeviceHandle> released_data_handles_;
@@ -15,8 +15,20 @@
 #include "tensorflow/compiler/xla/xla_client/xrt_session.h"
 
 #include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 
 namespace xla {
+namespace {
+
+size_t GetMaxCallables() {
+  static const size_t max_callables =
+      sys_util::GetEnvInt("XRT_MAX_SESSION_CALLABLES", 256);
+  return max_callables;
+}
+
+}  // namespace
 
 XrtSession::XrtSession(const tensorflow::SessionOptions& session_options)
     : target_(session_options.target),
@@ -29,6 +41,40 @@ void XrtSession::Reset() {
   }
 }
 
+const XrtSession::Callable* XrtSession::GetCallable(
+    const std::string& key) const {
+  auto it = callables_.find(key);
+  return it != callables_.end() ? &it->second : nullptr;
+}
+
+const XrtSession::Callable* XrtSession::AddCallable(
+    const std::string& key, const tensorflow::CallableOptions& options,
+    std::vector<tensorflow::Tensor> bound_feeds) {
+  if (!callables_supported_ || GetMaxCallables() == 0) {
+    return nullptr;
+  }
+  if (callables_.size() >= GetMaxCallables()) {
+    // The callables are keyed by computation handle, so the ones of the
+    // released computations would otherwise pile up.
+    XLA_COUNTER("XrtSessionCallablesFlush", 1);
+    for (auto& key_callable : callables_) {
+      session_.ReleaseCallable(key_callable.second.handle).IgnoreError();
+    }
+    callables_.clear();
+  }
+  Callable callable;
+  tensorflow::Status status = session_.MakeCallable(options, &callable.handle);
+  if (!status.ok()) {
+    TF_LOG(WARNING) << "Session callables disabled for " << target_ << ": "
+                    << status;
+    callables_supported_ = false;
+    return nullptr;
+  }
+  XLA_COUNTER("XrtSessionCallables", 1);
+  callable.bound_feeds = std::move(bound_feeds);
+  return &callables_.emplace(key, std::move(callable)).first->second;
+}
+
 std::string XrtSession::GetCacheKey(const std::string& op_name,
                                     const std::string& device) {
   return absl::StrCat(op_name, ";", device);
@@ -22,6 +22,7 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
@@ -89,6 +90,15 @@ class XrtSession {
     size_t position_ = 0;
   };
 
+  // A callable pre-binds the feeds and fetches of a session run, so that
+  // running it skips the feed map building, and the graph pruning and name
+  // resolution which Run() performs on every call.
+  struct Callable {
+    tensorflow::ClientSession::CallableHandle handle = 0;
+    // The leading feed tensors, which stay the same across runs.
+    std::vector<tensorflow::Tensor> bound_feeds;
+  };
+
   explicit XrtSession(const tensorflow::SessionOptions& session_options);
 
   const std::string& target() const { return target_; }
@@ -101,6 +111,16 @@ class XrtSession {
 
   void Reset();
 
+  // Returns the callable stored with key, or nullptr if there is none.
+  const Callable* GetCallable(const std::string& key) const;
+
+  // Creates the callable out of the options and stores it with key. Returns
+  // nullptr if the session does not support callables, in which case the
+  // caller should go through Run().
+  const Callable* AddCallable(const std::string& key,
+                              const tensorflow::CallableOptions& options,
+                              std::vector<tensorflow::Tensor> bound_feeds);
+
   static std::string GetCacheKey(const std::string& op_name,
                                  const std::string& device);
 
@@ -109,6 +129,8 @@ class XrtSession {
   tensorflow::Scope root_;
   tensorflow::ClientSession session_;
   std::map<std::string, NodeCache> node_cache_;
+  std::map<std::string, Callable> callables_;
+  bool callables_supported_ = true;
 };
 
 }  // namespace xla
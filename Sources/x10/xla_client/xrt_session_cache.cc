@@ -21,10 +21,11 @@ namespace xla {
 
 XrtSessionCache::XrtSessionCache(tensorflow::ConfigProto config,
                                  std::function<void(XrtSession*)> initfn,
-                                 std::string local_target)
+                                 std::string local_target, Options options)
     : config_(std::move(config)),
       initfn_(std::move(initfn)),
-      local_target_(std::move(local_target)) {}
+      local_target_(std::move(local_target)),
+      options_(options) {}
 
 XrtSessionCache::Ref XrtSessionCache::GetSession(const std::string& target) {
   std::lock_guard<std::mutex> lock(lock_);
@@ -66,14 +67,13 @@ std::shared_ptr<XrtSession> XrtSessionCache::CreateSession(
       session_options.config.mutable_rpc_options();
 
   std::string compression = sys_util::GetEnvString("XRT_GRPC_COMPRESSION", "");
-  if (!compression.empty()) {
+  if (options_.compressed && !compression.empty()) {
     rpc_options->set_compression_algorithm(compression);
     rpc_options->set_compression_level(
         sys_util::GetEnvInt("XRT_GRPC_COMPRESSION_LEVEL", 3));
   }
 
-  bool multi_stream = sys_util::GetEnvBool("XRT_GRPC_MULTISTREAM", true);
-  rpc_options->set_disable_session_connection_sharing(multi_stream);
+  rpc_options->set_disable_session_connection_sharing(options_.multi_stream);
 
   std::shared_ptr<XrtSession> session =
       std::make_shared<XrtSession>(session_options);
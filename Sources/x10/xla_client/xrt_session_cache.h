@@ -82,9 +82,17 @@ class XrtSessionCache {
   // Map from session target to XrtSession reference.
   using SessionMap = std::map<std::string, Ref>;
 
+  struct Options {
+    // Whether the sessions use the XRT_GRPC_COMPRESSION settings.
+    bool compressed = true;
+    // Whether each session gets a gRPC connection of its own, instead of
+    // sharing the one of its target with the other sessions.
+    bool multi_stream = true;
+  };
+
   XrtSessionCache(tensorflow::ConfigProto config,
                   std::function<void(XrtSession*)> initfn,
-                  std::string local_target);
+                  std::string local_target, Options options = Options());
 
   const tensorflow::ConfigProto& GetConfig() const { return config_; }
 
@@ -106,6 +114,7 @@ class XrtSessionCache {
   tensorflow::ConfigProto config_;
   std::function<void(XrtSession*)> initfn_;
   std::string local_target_;
+  Options options_;
   std::mutex lock_;
   std::map<std::string, std::deque<std::shared_ptr<XrtSession>>> session_map_;
 };
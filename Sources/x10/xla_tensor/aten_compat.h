@@ -361,6 +361,7 @@
   _(aten, frobenius_norm)                                   \
   _(aten, full)                                             \
   _(aten, full_like)                                        \
+  _(aten, functional_scan)                                  \
   _(aten, functional_while)                                 \
   _(aten, gather)                                           \
   _(aten, ge)                                               \
@@ -767,27 +768,68 @@
   _(aten, xla_truncated_normal)                             \
   _(aten, xla_is_finite)                                    \
   _(aten, xla_is_inf)                                       \
-  _(aten, xla_is_nan)
-
-#define FORALL_XLA_SYMBOLS(_, __)  \
-  __(xla, all_to_all)              \
-  _(xla, as_strided_view_update)   \
-  _(xla, cast)                     \
-  _(xla, collective_permute)       \
-  _(xla, cross_replica_sum)        \
-  _(xla, device_data)              \
-  _(xla, diagonal_view_update)     \
-  _(xla, generic_slice)            \
-  _(xla, get_dimensions_size)      \
-  _(xla, moving_average)           \
-  _(xla, nms)                      \
-  _(xla, not_supported)            \
-  _(xla, replication_pad)          \
-  _(xla, replication_pad_backward) \
-  _(xla, select)                   \
-  _(xla, tensor_data)              \
-  _(xla, token)                    \
-  _(xla, unselect)                 \
+  _(aten, xla_is_nan)                                       \
+  _(aten, xla_embedding_sparse_update)                      \
+  _(aten, xla_cached_attention)                             \
+  _(aten, xla_scaled_dot_product_attention)                 \
+  _(aten, xla_scaled_dot_product_attention_grad)            \
+  _(aten, xla_segmented_scaled_dot_product_attention)       \
+  _(aten, xla_segmented_scaled_dot_product_attention_grad)  \
+  _(aten, xla_layer_norm_backward)                          \
+  _(aten, xla_rms_norm)                                     \
+  _(aten, xla_rms_norm_backward)                            \
+  _(aten, xla_non_max_suppression)                          \
+  _(aten, xla_quantize)                                     \
+  _(aten, xla_dequantize)                                   \
+  _(aten, xla_requantize)                                   \
+  _(aten, xla_quantized_matmul)                             \
+  _(aten, xla_quantized_conv)                               \
+  _(aten, xla_sparse_softmax_cross_entropy)                 \
+  _(aten, xla_augment_images)                               \
+  _(aten, xla_cholesky_grad)                                \
+  _(aten, xla_lu)
+
+#define FORALL_XLA_SYMBOLS(_, __)          \
+  __(xla, all_finite)                      \
+  _(xla, all_gather)                       \
+  _(xla, all_to_all)                       \
+  _(xla, as_strided_view_update)           \
+  _(xla, bucket_mask)                      \
+  _(xla, cast)                             \
+  _(xla, collective_permute)               \
+  _(xla, cross_replica_sum)                \
+  _(xla, device_data)                      \
+  _(xla, diagonal_view_update)             \
+  _(xla, fused_elementwise)                \
+  _(xla, generic_slice)                    \
+  _(xla, get_dimensions_size)              \
+  _(xla, gru_cell)                         \
+  _(xla, gru_cell_backward)                \
+  _(xla, lstm_cell)                        \
+  _(xla, lstm_cell_backward)               \
+  _(xla, moe_combine)                      \
+  _(xla, moe_dispatch)                     \
+  _(xla, moe_routing)                      \
+  _(xla, moving_average)                   \
+  _(xla, nms)                              \
+  _(xla, not_supported)                    \
+  _(xla, optimizer_step)                   \
+  _(xla, pack_flat)                        \
+  _(xla, random_init)                      \
+  _(xla, reduce_scatter)                   \
+  _(xla, replication_pad)                  \
+  _(xla, replication_pad_backward)         \
+  _(xla, remat)                            \
+  _(xla, rng_seed)                         \
+  _(xla, select)                           \
+  _(xla, sharding)                         \
+  _(xla, sync_batch_norm)                  \
+  _(xla, sync_batch_norm_backward)         \
+  _(xla, tensor_data)                      \
+  _(xla, tf_conv_bias_activation)          \
+  _(xla, tf_conv_bias_activation_backward) \
+  _(xla, token)                            \
+  _(xla, unselect)                         \
   _(xla, update_slice)
 
 namespace at {
@@ -997,6 +1039,9 @@ class AnyScalarBuffer {
 
   ScalarType scalar_type() const { return type_; }
 
+  // Whether the scalars are borrowed from a caller waiting for their release.
+  virtual bool is_borrowed() const { return false; }
+
   std::unique_ptr<AnyScalarBuffer> dup() {
     switch (type_) {
 #define DUP_CASE(name, aten_name, DType)                \
@@ -1064,6 +1109,27 @@ class NonOwnedAnyScalarBuffer : public AnyScalarBuffer {
   }
 };
 
+// Implementation of Scalar buffer backed by a buffer borrowed from the caller,
+// which gets notified through the release callback once the buffer is no
+// longer referenced.
+template <typename T>
+class BorrowedAnyScalarBuffer : public NonOwnedAnyScalarBuffer<T> {
+ public:
+  BorrowedAnyScalarBuffer(const T* data, size_t len,
+                          void (*release)(void* context), void* context)
+      : NonOwnedAnyScalarBuffer<T>(data, len),
+        release_(release),
+        context_(context) {}
+
+  ~BorrowedAnyScalarBuffer() override { release_(context_); }
+
+  bool is_borrowed() const override { return true; }
+
+ private:
+  void (*release_)(void* context);
+  void* context_;
+};
+
 template <typename T>
 std::unique_ptr<AnyScalarBuffer> AnyScalarBuffer::make(
     std::unique_ptr<T[]> data, size_t len) {
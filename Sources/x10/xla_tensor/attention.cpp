@@ -0,0 +1,574 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/attention.h"
+
+#include <algorithm>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/lib/loops.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace {
+
+// Number of key rows folded into the running softmax at each step.
+int64_t GetAttentionBlockSize() {
+  static const int64_t block_size =
+      xla::sys_util::GetEnvInt("XLA_ATTENTION_BLOCK_SIZE", 512);
+  return block_size;
+}
+
+// The half precision inputs get their softmax accumulated at F32.
+xla::PrimitiveType GetAccumulationType(xla::PrimitiveType type) {
+  return type == xla::PrimitiveType::BF16 || type == xla::PrimitiveType::F16
+             ? xla::PrimitiveType::F32
+             : type;
+}
+
+xla::XlaOp MaybeConvertTo(xla::XlaOp input, xla::PrimitiveType type) {
+  return XlaHelpers::TypeOfXlaOp(input) != type
+             ? xla::ConvertElementType(input, type)
+             : input;
+}
+
+struct AttentionDims {
+  int64_t rank = 0;
+  int64_t batch_rank = 0;
+  // Dimension holding the query and key rows.
+  int64_t seq_dim = 0;
+  int64_t kv_length = 0;
+  int64_t block_size = 0;
+  int64_t num_blocks = 0;
+  // Maps the [..., Sq] row values into the [..., Sq, N] ones.
+  std::vector<int64_t> row_broadcast;
+};
+
+AttentionDims GetAttentionDims(xla::XlaOp query, xla::XlaOp key,
+                               xla::XlaOp value) {
+  const xla::Shape& query_shape = XlaHelpers::ShapeOfXlaOp(query);
+  const xla::Shape& key_shape = XlaHelpers::ShapeOfXlaOp(key);
+  const xla::Shape& value_shape = XlaHelpers::ShapeOfXlaOp(value);
+  AttentionDims dims;
+  dims.rank = query_shape.rank();
+  XLA_CHECK_GE(dims.rank, 2) << query_shape;
+  XLA_CHECK_EQ(key_shape.rank(), dims.rank) << key_shape;
+  XLA_CHECK_EQ(value_shape.rank(), dims.rank) << value_shape;
+  dims.batch_rank = dims.rank - 2;
+  dims.seq_dim = dims.rank - 2;
+  XLA_CHECK_EQ(query_shape.dimensions(dims.rank - 1),
+               key_shape.dimensions(dims.rank - 1))
+      << query_shape << " vs. " << key_shape;
+  XLA_CHECK_EQ(key_shape.dimensions(dims.seq_dim),
+               value_shape.dimensions(dims.seq_dim))
+      << key_shape << " vs. " << value_shape;
+  dims.kv_length = key_shape.dimensions(dims.seq_dim);
+  XLA_CHECK_GT(dims.kv_length, 0) << key_shape;
+  dims.block_size =
+      std::max<int64_t>(std::min(GetAttentionBlockSize(), dims.kv_length), 1);
+  dims.num_blocks = (dims.kv_length + dims.block_size - 1) / dims.block_size;
+  dims.row_broadcast = xla::util::Iota<int64_t>(dims.rank - 1);
+  return dims;
+}
+
+// Batched matmul contracting lhs_dim of lhs with rhs_dim of rhs. The result
+// holds the batch dimensions, followed by the free ones of lhs and rhs.
+xla::XlaOp BatchDot(xla::XlaOp lhs, int64_t lhs_dim, xla::XlaOp rhs,
+                    int64_t rhs_dim, int64_t batch_rank) {
+  xla::DotDimensionNumbers dimension_numbers;
+  for (int64_t i = 0; i < batch_rank; ++i) {
+    dimension_numbers.add_lhs_batch_dimensions(i);
+    dimension_numbers.add_rhs_batch_dimensions(i);
+  }
+  dimension_numbers.add_lhs_contracting_dimensions(lhs_dim);
+  dimension_numbers.add_rhs_contracting_dimensions(rhs_dim);
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  return xla::DotGeneral(lhs, rhs, dimension_numbers, &precision_config);
+}
+
+xla::XlaOp SliceRows(xla::XlaOp input, xla::XlaOp start, int64_t dim,
+                     int64_t size) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  std::vector<xla::XlaOp> starts(
+      shape.rank(), xla::Zero(input.builder(), xla::PrimitiveType::S32));
+  starts[dim] = start;
+  auto sizes = xla::util::ToVector<int64_t>(shape.dimensions());
+  sizes[dim] = size;
+  return xla::DynamicSlice(input, starts, sizes);
+}
+
+xla::XlaOp UpdateRows(xla::XlaOp input, xla::XlaOp update, xla::XlaOp start,
+                      int64_t dim) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  std::vector<xla::XlaOp> starts(
+      shape.rank(), xla::Zero(input.builder(), xla::PrimitiveType::S32));
+  starts[dim] = start;
+  return xla::DynamicUpdateSlice(input, update, starts);
+}
+
+// Pads the keys and values with zero rows up to a whole number of blocks.
+xla::XlaOp PadRows(xla::XlaOp input, int64_t dim, int64_t length) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  int64_t padding = length - shape.dimensions(dim);
+  if (padding == 0) {
+    return input;
+  }
+  xla::PaddingConfig padding_config = xla::MakeNoPaddingConfig(shape.rank());
+  padding_config.mutable_dimensions(dim)->set_edge_padding_high(padding);
+  return xla::Pad(input, xla::Zero(input.builder(), shape.element_type()),
+                  padding_config);
+}
+
+// Mask of the [..., Sq, block] scores which come from actual key rows, rather
+// than from the padding of the last block. With a cache length, the query rows
+// are the last Sq of the length cached ones, and each only sees the keys up to
+// its own position.
+xla::XlaOp KeyMask(xla::XlaOp scores, xla::XlaOp start, xla::XlaOp length,
+                   const AttentionDims& dims) {
+  xla::XlaBuilder* builder = scores.builder();
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(scores);
+  xla::Shape rows_shape =
+      xla::ShapeUtil::ChangeElementType(shape, xla::PrimitiveType::S32);
+  xla::XlaOp rows = xla::Iota(builder, rows_shape, dims.rank - 1) + start;
+  if (!length.valid()) {
+    return xla::Lt(rows, XlaHelpers::ScalarValue<int32_t>(
+                             dims.kv_length, xla::PrimitiveType::S32, builder));
+  }
+  xla::XlaOp first_position =
+      length - XlaHelpers::ScalarValue<int32_t>(shape.dimensions(dims.rank - 2),
+                                                xla::PrimitiveType::S32,
+                                                builder);
+  xla::XlaOp positions =
+      xla::Iota(builder, rows_shape, dims.rank - 2) + first_position;
+  return xla::Le(rows, positions);
+}
+
+// The segment ids of packed rows, S32 with the leading batch dimensions of the
+// query followed by the rows. The keys ones are padded to a whole number of
+// blocks. Both are invalid when the rows are not packed.
+struct SegmentIds {
+  xla::XlaOp query;
+  xla::XlaOp key;
+
+  bool valid() const { return query.valid(); }
+};
+
+SegmentIds PrepareSegmentIds(xla::XlaOp query_segment_ids,
+                             xla::XlaOp key_segment_ids,
+                             const AttentionDims& dims, int64_t padded_length) {
+  SegmentIds segment_ids;
+  segment_ids.query =
+      MaybeConvertTo(query_segment_ids, xla::PrimitiveType::S32);
+  segment_ids.key = MaybeConvertTo(key_segment_ids, xla::PrimitiveType::S32);
+  const xla::Shape& query_shape = XlaHelpers::ShapeOfXlaOp(segment_ids.query);
+  const xla::Shape& key_shape = XlaHelpers::ShapeOfXlaOp(segment_ids.key);
+  XLA_CHECK_GE(query_shape.rank(), 1) << query_shape;
+  XLA_CHECK_LE(query_shape.rank(), dims.batch_rank + 1) << query_shape;
+  XLA_CHECK_EQ(key_shape.rank(), query_shape.rank()) << key_shape;
+  XLA_CHECK_EQ(key_shape.dimensions(key_shape.rank() - 1), dims.kv_length)
+      << key_shape;
+  segment_ids.key = PadRows(segment_ids.key, key_shape.rank() - 1,
+                            padded_length);
+  return segment_ids;
+}
+
+// Mask of the [..., Sq, block] scores whose query and key rows belong to the
+// same segment.
+xla::XlaOp SegmentMask(xla::XlaOp scores, const SegmentIds& segment_ids,
+                       xla::XlaOp start, const AttentionDims& dims) {
+  std::vector<int64_t> sizes = XlaHelpers::SizesOfXlaOp(scores);
+  int64_t segment_rank = XlaHelpers::ShapeOfXlaOp(segment_ids.query).rank();
+  std::vector<int64_t> query_dims = xla::util::Iota<int64_t>(segment_rank - 1);
+  std::vector<int64_t> key_dims = query_dims;
+  query_dims.push_back(dims.rank - 2);
+  key_dims.push_back(dims.rank - 1);
+  xla::XlaOp key_block = SliceRows(segment_ids.key, start, segment_rank - 1,
+                                   dims.block_size);
+  return xla::Eq(xla::BroadcastInDim(segment_ids.query, sizes, query_dims),
+                 xla::BroadcastInDim(key_block, sizes, key_dims));
+}
+
+// Mask of the scores which enter the softmax, see KeyMask and SegmentMask.
+xla::XlaOp ScoresMask(xla::XlaOp scores, xla::XlaOp start, xla::XlaOp length,
+                      const SegmentIds& segment_ids,
+                      const AttentionDims& dims) {
+  xla::XlaOp mask = KeyMask(scores, start, length, dims);
+  if (segment_ids.valid()) {
+    mask = xla::And(mask, SegmentMask(scores, segment_ids, start, dims));
+  }
+  return mask;
+}
+
+xla::XlaOp BlockStart(xla::XlaOp block, const AttentionDims& dims) {
+  return block * XlaHelpers::ScalarValue<int32_t>(
+                     dims.block_size, xla::PrimitiveType::S32, block.builder());
+}
+
+xla::XlaOp ScaledScores(xla::XlaOp query, xla::XlaOp key_block, float scale,
+                        const AttentionDims& dims) {
+  xla::XlaOp scores = BatchDot(query, dims.rank - 1, key_block, dims.rank - 1,
+                               dims.batch_rank);
+  return scores * XlaHelpers::ScalarValue<float>(
+                      scale, XlaHelpers::TypeOfXlaOp(scores), query.builder());
+}
+
+// Running softmax over the blocks visited so far: acc holds the output scaled
+// by sum, and max the largest score of each row.
+struct SoftmaxState {
+  xla::XlaOp acc;
+  xla::XlaOp max;
+  xla::XlaOp sum;
+};
+
+SoftmaxState InitialSoftmaxState(xla::XlaOp query, xla::XlaOp value) {
+  xla::XlaBuilder* builder = query.builder();
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(query);
+  std::vector<int64_t> row_sizes = XlaHelpers::SizesOfXlaOp(query);
+  row_sizes.pop_back();
+  std::vector<int64_t> output_sizes = row_sizes;
+  output_sizes.push_back(XlaHelpers::SizesOfXlaOp(value).back());
+  SoftmaxState state;
+  state.acc =
+      xla::Zeros(builder, xla::ShapeUtil::MakeShape(type, output_sizes));
+  state.max = xla::Broadcast(xla::MinFiniteValue(builder, type), row_sizes);
+  state.sum = xla::Zeros(builder, xla::ShapeUtil::MakeShape(type, row_sizes));
+  return state;
+}
+
+// The length, when valid, is the one of the key cache (see KeyMask).
+SoftmaxState ForwardBlock(xla::XlaOp query, xla::XlaOp key, xla::XlaOp value,
+                          xla::XlaOp start, float scale,
+                          const SoftmaxState& state, const AttentionDims& dims,
+                          xla::XlaOp length = xla::XlaOp(),
+                          const SegmentIds& segment_ids = SegmentIds()) {
+  xla::XlaBuilder* builder = query.builder();
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(query);
+  xla::XlaOp key_block = SliceRows(key, start, dims.seq_dim, dims.block_size);
+  xla::XlaOp value_block =
+      SliceRows(value, start, dims.seq_dim, dims.block_size);
+  xla::XlaOp scores = ScaledScores(query, key_block, scale, dims);
+  xla::XlaOp min_value = xla::MinFiniteValue(builder, type);
+  xla::XlaOp mask = ScoresMask(scores, start, length, segment_ids, dims);
+  scores = xla::Select(
+      mask, scores,
+      xla::Broadcast(min_value, XlaHelpers::SizesOfXlaOp(scores)));
+  xla::XlaOp block_max =
+      xla::Reduce(scores, min_value, XlaHelpers::CreateMaxComputation(type),
+                  {dims.rank - 1});
+  SoftmaxState result;
+  result.max = xla::Max(state.max, block_max);
+  // The masked scores sit at the lowest finite value, so their exponential is
+  // zero as the first block holds a key row which every query row sees.
+  xla::XlaOp probs =
+      xla::Exp(xla::Sub(scores, result.max, dims.row_broadcast));
+  if (segment_ids.valid()) {
+    // A query row can see no key of the first blocks when its segment starts
+    // further on, which leaves its running max at the lowest finite value.
+    probs = xla::Select(mask, probs,
+                        xla::Zeros(builder, XlaHelpers::ShapeOfXlaOp(probs)));
+  }
+  xla::XlaOp correction = xla::Exp(state.max - result.max);
+  result.sum = state.sum * correction +
+               xla::Reduce(probs, xla::Zero(builder, type),
+                           XlaHelpers::CreateAddComputation(type),
+                           {dims.rank - 1});
+  result.acc = xla::Add(
+      xla::Mul(state.acc, correction, dims.row_broadcast),
+      BatchDot(probs, dims.rank - 1, value_block, dims.seq_dim,
+               dims.batch_rank));
+  return result;
+}
+
+struct GradState {
+  xla::XlaOp grad_query;
+  xla::XlaOp grad_key;
+  xla::XlaOp grad_value;
+};
+
+// Accumulates the gradients flowing through the block of keys starting at
+// start. The key and value gradients of the block only depend on it, so they
+// are written in place in the padded gradients.
+GradState BackwardBlock(xla::XlaOp grad_output, xla::XlaOp query,
+                        xla::XlaOp key, xla::XlaOp value, xla::XlaOp logsumexp,
+                        xla::XlaOp delta, xla::XlaOp start, float scale,
+                        const GradState& state, const AttentionDims& dims,
+                        const SegmentIds& segment_ids) {
+  xla::XlaBuilder* builder = query.builder();
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(query);
+  xla::XlaOp key_block = SliceRows(key, start, dims.seq_dim, dims.block_size);
+  xla::XlaOp value_block =
+      SliceRows(value, start, dims.seq_dim, dims.block_size);
+  xla::XlaOp scores = ScaledScores(query, key_block, scale, dims);
+  xla::XlaOp probs =
+      xla::Select(ScoresMask(scores, start, xla::XlaOp(), segment_ids, dims),
+                  xla::Exp(xla::Sub(scores, logsumexp, dims.row_broadcast)),
+                  xla::Zeros(builder, XlaHelpers::ShapeOfXlaOp(scores)));
+  xla::XlaOp grad_value_block = BatchDot(probs, dims.seq_dim, grad_output,
+                                         dims.seq_dim, dims.batch_rank);
+  xla::XlaOp grad_probs = BatchDot(grad_output, dims.rank - 1, value_block,
+                                   dims.rank - 1, dims.batch_rank);
+  xla::XlaOp grad_scores =
+      probs * xla::Sub(grad_probs, delta, dims.row_broadcast) *
+      XlaHelpers::ScalarValue<float>(scale, type, builder);
+  GradState result;
+  result.grad_query =
+      state.grad_query + BatchDot(grad_scores, dims.rank - 1, key_block,
+                                  dims.seq_dim, dims.batch_rank);
+  xla::XlaOp grad_key_block = BatchDot(grad_scores, dims.seq_dim, query,
+                                       dims.seq_dim, dims.batch_rank);
+  result.grad_key =
+      UpdateRows(state.grad_key, grad_key_block, start, dims.seq_dim);
+  result.grad_value =
+      UpdateRows(state.grad_value, grad_value_block, start, dims.seq_dim);
+  return result;
+}
+
+// The segment ids are invalid when the rows are not packed.
+std::vector<xla::XlaOp> ScaledDotProductAttention(xla::XlaOp query,
+                                                  xla::XlaOp key,
+                                                  xla::XlaOp value,
+                                                  xla::XlaOp query_segment_ids,
+                                                  xla::XlaOp key_segment_ids,
+                                                  float scale) {
+  xla::XlaBuilder* builder = query.builder();
+  AttentionDims dims = GetAttentionDims(query, key, value);
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(query);
+  xla::PrimitiveType accumulation_type = GetAccumulationType(type);
+  int64_t padded_length = dims.num_blocks * dims.block_size;
+  query = MaybeConvertTo(query, accumulation_type);
+  key = PadRows(MaybeConvertTo(key, accumulation_type), dims.seq_dim,
+                padded_length);
+  value = PadRows(MaybeConvertTo(value, accumulation_type), dims.seq_dim,
+                  padded_length);
+  SegmentIds segment_ids;
+  if (query_segment_ids.valid()) {
+    segment_ids = PrepareSegmentIds(query_segment_ids, key_segment_ids, dims,
+                                    padded_length);
+  }
+
+  SoftmaxState state = InitialSoftmaxState(query, value);
+  if (dims.num_blocks == 1) {
+    state = ForwardBlock(query, key, value,
+                         xla::Zero(builder, xla::PrimitiveType::S32), scale,
+                         state, dims, xla::XlaOp(), segment_ids);
+  } else {
+    auto body_fn =
+        [&](xla::XlaOp block, absl::Span<const xla::XlaOp> values,
+            xla::XlaBuilder* body_builder)
+        -> xla::StatusOr<std::vector<xla::XlaOp>> {
+      SegmentIds body_segment_ids;
+      if (segment_ids.valid()) {
+        body_segment_ids = {values[6], values[7]};
+      }
+      SoftmaxState result = ForwardBlock(
+          values[0], values[1], values[2], BlockStart(block, dims), scale,
+          {values[3], values[4], values[5]}, dims, xla::XlaOp(),
+          body_segment_ids);
+      std::vector<xla::XlaOp> results{values[0],  values[1],  values[2],
+                                      result.acc, result.max, result.sum};
+      results.insert(results.end(), values.begin() + 6, values.end());
+      return results;
+    };
+    std::vector<xla::XlaOp> initial_values{query,     key,       value,
+                                           state.acc, state.max, state.sum};
+    if (segment_ids.valid()) {
+      initial_values.push_back(segment_ids.query);
+      initial_values.push_back(segment_ids.key);
+    }
+    std::vector<xla::XlaOp> results = ConsumeValue(xla::ForEachIndex(
+        dims.num_blocks, xla::PrimitiveType::S32, body_fn, initial_values,
+        "ScaledDotProductAttention", builder));
+    state = {results[3], results[4], results[5]};
+  }
+  if (segment_ids.valid()) {
+    // The rows which see no key at all get a zero output.
+    state.sum = xla::Select(
+        xla::Eq(state.sum, xla::Zero(builder, accumulation_type)),
+        xla::Broadcast(xla::One(builder, accumulation_type),
+                       XlaHelpers::SizesOfXlaOp(state.sum)),
+        state.sum);
+  }
+  xla::XlaOp output = xla::Div(state.acc, state.sum, dims.row_broadcast);
+  xla::XlaOp logsumexp = state.max + xla::Log(state.sum);
+  return {MaybeConvertTo(output, type), MaybeConvertTo(logsumexp, type)};
+}
+
+std::vector<xla::XlaOp> ScaledDotProductAttentionGrad(
+    xla::XlaOp grad_output, xla::XlaOp query, xla::XlaOp key, xla::XlaOp value,
+    xla::XlaOp output, xla::XlaOp logsumexp, xla::XlaOp query_segment_ids,
+    xla::XlaOp key_segment_ids, float scale) {
+  xla::XlaBuilder* builder = query.builder();
+  AttentionDims dims = GetAttentionDims(query, key, value);
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(query);
+  xla::PrimitiveType accumulation_type = GetAccumulationType(type);
+  int64_t padded_length = dims.num_blocks * dims.block_size;
+  grad_output = MaybeConvertTo(grad_output, accumulation_type);
+  query = MaybeConvertTo(query, accumulation_type);
+  key = PadRows(MaybeConvertTo(key, accumulation_type), dims.seq_dim,
+                padded_length);
+  value = PadRows(MaybeConvertTo(value, accumulation_type), dims.seq_dim,
+                  padded_length);
+  logsumexp = MaybeConvertTo(logsumexp, accumulation_type);
+  SegmentIds segment_ids;
+  if (query_segment_ids.valid()) {
+    segment_ids = PrepareSegmentIds(query_segment_ids, key_segment_ids, dims,
+                                    padded_length);
+  }
+  // Row sums of grad_output * output, which is what the softmax gradient
+  // subtracts from the gradient of each probability.
+  xla::XlaOp delta =
+      xla::Reduce(grad_output * MaybeConvertTo(output, accumulation_type),
+                  xla::Zero(builder, accumulation_type),
+                  XlaHelpers::CreateAddComputation(accumulation_type),
+                  {dims.rank - 1});
+
+  GradState state;
+  state.grad_query = xla::Zeros(builder, XlaHelpers::ShapeOfXlaOp(query));
+  state.grad_key = xla::Zeros(builder, XlaHelpers::ShapeOfXlaOp(key));
+  state.grad_value = xla::Zeros(builder, XlaHelpers::ShapeOfXlaOp(value));
+  if (dims.num_blocks == 1) {
+    state = BackwardBlock(grad_output, query, key, value, logsumexp, delta,
+                          xla::Zero(builder, xla::PrimitiveType::S32), scale,
+                          state, dims, segment_ids);
+  } else {
+    auto body_fn =
+        [&](xla::XlaOp block, absl::Span<const xla::XlaOp> values,
+            xla::XlaBuilder* body_builder)
+        -> xla::StatusOr<std::vector<xla::XlaOp>> {
+      SegmentIds body_segment_ids;
+      if (segment_ids.valid()) {
+        body_segment_ids = {values[9], values[10]};
+      }
+      GradState result = BackwardBlock(
+          values[0], values[1], values[2], values[3], values[4], values[5],
+          BlockStart(block, dims), scale, {values[6], values[7], values[8]},
+          dims, body_segment_ids);
+      std::vector<xla::XlaOp> results(values.begin(), values.begin() + 6);
+      results.push_back(result.grad_query);
+      results.push_back(result.grad_key);
+      results.push_back(result.grad_value);
+      results.insert(results.end(), values.begin() + 9, values.end());
+      return results;
+    };
+    std::vector<xla::XlaOp> initial_values{
+        grad_output,      query,          key,
+        value,            logsumexp,      delta,
+        state.grad_query, state.grad_key, state.grad_value};
+    if (segment_ids.valid()) {
+      initial_values.push_back(segment_ids.query);
+      initial_values.push_back(segment_ids.key);
+    }
+    std::vector<xla::XlaOp> results = ConsumeValue(xla::ForEachIndex(
+        dims.num_blocks, xla::PrimitiveType::S32, body_fn, initial_values,
+        "ScaledDotProductAttentionGrad", builder));
+    state = {results[6], results[7], results[8]};
+  }
+  xla::XlaOp grad_key =
+      xla::SliceInDim(state.grad_key, 0, dims.kv_length, 1, dims.seq_dim);
+  xla::XlaOp grad_value =
+      xla::SliceInDim(state.grad_value, 0, dims.kv_length, 1, dims.seq_dim);
+  return {MaybeConvertTo(state.grad_query, type),
+          MaybeConvertTo(grad_key, type), MaybeConvertTo(grad_value, type)};
+}
+
+}  // namespace
+
+std::vector<xla::XlaOp> BuildScaledDotProductAttention(xla::XlaOp query,
+                                                       xla::XlaOp key,
+                                                       xla::XlaOp value,
+                                                       float scale) {
+  return ScaledDotProductAttention(query, key, value, xla::XlaOp(),
+                                   xla::XlaOp(), scale);
+}
+
+std::vector<xla::XlaOp> BuildSegmentedScaledDotProductAttention(
+    xla::XlaOp query, xla::XlaOp key, xla::XlaOp value,
+    xla::XlaOp query_segment_ids, xla::XlaOp key_segment_ids, float scale) {
+  return ScaledDotProductAttention(query, key, value, query_segment_ids,
+                                   key_segment_ids, scale);
+}
+
+xla::XlaOp BuildCachedAttention(xla::XlaOp query, xla::XlaOp key_cache,
+                                xla::XlaOp value_cache, xla::XlaOp length,
+                                float scale) {
+  xla::XlaBuilder* builder = query.builder();
+  AttentionDims dims = GetAttentionDims(query, key_cache, value_cache);
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(query);
+  xla::PrimitiveType accumulation_type = GetAccumulationType(type);
+  int64_t padded_length = dims.num_blocks * dims.block_size;
+  query = MaybeConvertTo(query, accumulation_type);
+  xla::XlaOp key = PadRows(MaybeConvertTo(key_cache, accumulation_type),
+                           dims.seq_dim, padded_length);
+  xla::XlaOp value = PadRows(MaybeConvertTo(value_cache, accumulation_type),
+                             dims.seq_dim, padded_length);
+  length = MaybeConvertTo(length, xla::PrimitiveType::S32);
+
+  SoftmaxState state = InitialSoftmaxState(query, value);
+  if (dims.num_blocks == 1) {
+    state = ForwardBlock(query, key, value,
+                         xla::Zero(builder, xla::PrimitiveType::S32), scale,
+                         state, dims, length);
+  } else {
+    // Only the blocks holding cached rows are visited, so a decode step costs
+    // in proportion to the length rather than to the capacity of the cache.
+    auto condition_fn =
+        [&](absl::Span<const xla::XlaOp> values,
+            xla::XlaBuilder* condition_builder) -> xla::StatusOr<xla::XlaOp> {
+      return xla::Lt(BlockStart(values[0], dims), values[4]);
+    };
+    auto body_fn = [&](absl::Span<const xla::XlaOp> values,
+                       xla::XlaBuilder* body_builder)
+        -> xla::StatusOr<std::vector<xla::XlaOp>> {
+      SoftmaxState result = ForwardBlock(
+          values[1], values[2], values[3], BlockStart(values[0], dims), scale,
+          {values[5], values[6], values[7]}, dims, values[4]);
+      xla::XlaOp next_block =
+          values[0] + xla::One(body_builder, xla::PrimitiveType::S32);
+      return std::vector<xla::XlaOp>{next_block, values[1],  values[2],
+                                     values[3],  values[4],  result.acc,
+                                     result.max, result.sum};
+    };
+    std::vector<xla::XlaOp> results = ConsumeValue(xla::WhileLoopHelper(
+        condition_fn, body_fn,
+        {xla::Zero(builder, xla::PrimitiveType::S32), query, key, value, length,
+         state.acc, state.max, state.sum},
+        "CachedAttention", builder));
+    state = {results[5], results[6], results[7]};
+  }
+  return MaybeConvertTo(xla::Div(state.acc, state.sum, dims.row_broadcast),
+                        type);
+}
+
+std::vector<xla::XlaOp> BuildScaledDotProductAttentionGrad(
+    xla::XlaOp grad_output, xla::XlaOp query, xla::XlaOp key, xla::XlaOp value,
+    xla::XlaOp output, xla::XlaOp logsumexp, float scale) {
+  return ScaledDotProductAttentionGrad(grad_output, query, key, value, output,
+                                       logsumexp, xla::XlaOp(), xla::XlaOp(),
+                                       scale);
+}
+
+std::vector<xla::XlaOp> BuildSegmentedScaledDotProductAttentionGrad(
+    xla::XlaOp grad_output, xla::XlaOp query, xla::XlaOp key, xla::XlaOp value,
+    xla::XlaOp output, xla::XlaOp logsumexp, xla::XlaOp query_segment_ids,
+    xla::XlaOp key_segment_ids, float scale) {
+  return ScaledDotProductAttentionGrad(grad_output, query, key, value, output,
+                                       logsumexp, query_segment_ids,
+                                       key_segment_ids, scale);
+}
+
+}  // namespace swift_xla
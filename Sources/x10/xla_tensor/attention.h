@@ -0,0 +1,66 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+
+namespace swift_xla {
+
+// Computes softmax(scale * query x key^T) x value for the [..., Sq, D] query,
+// [..., Sk, D] key and [..., Sk, Dv] value, and returns the [..., Sq, Dv]
+// output along with the [..., Sq] log-sum-exp of the scaled scores, which the
+// gradient needs. The keys are visited in blocks of XLA_ATTENTION_BLOCK_SIZE
+// rows with a running softmax, so that only a [..., Sq, block] slice of the
+// scores is live at any time.
+std::vector<xla::XlaOp> BuildScaledDotProductAttention(xla::XlaOp query,
+                                                       xla::XlaOp key,
+                                                       xla::XlaOp value,
+                                                       float scale);
+
+// Same as BuildScaledDotProductAttention for the packed rows of many
+// sequences, where each query row only sees the key rows of its own segment.
+// The S32 segment ids hold the leading batch dimensions of the query, followed
+// by the Sq query rows and the Sk key rows, so that [B, S] ids can mask a
+// [B, H, S, D] query. Rows without any key of their segment get a zero output.
+std::vector<xla::XlaOp> BuildSegmentedScaledDotProductAttention(
+    xla::XlaOp query, xla::XlaOp key, xla::XlaOp value,
+    xla::XlaOp query_segment_ids, xla::XlaOp key_segment_ids, float scale);
+
+// Attention of the [..., Sq, D] query over the first length rows of the
+// [..., capacity, D] key and [..., capacity, Dv] value caches of a decoder.
+// The query rows are the last Sq cached ones, and each sees the keys up to its
+// own position. The length is an S32 scalar held on the device, so that the
+// steps of a decode loop share the same computation.
+xla::XlaOp BuildCachedAttention(xla::XlaOp query, xla::XlaOp key_cache,
+                                xla::XlaOp value_cache, xla::XlaOp length,
+                                float scale);
+
+// Returns the gradients of the query, key and value, recomputing the scores
+// block by block from the log-sum-exp returned by the forward pass.
+std::vector<xla::XlaOp> BuildScaledDotProductAttentionGrad(
+    xla::XlaOp grad_output, xla::XlaOp query, xla::XlaOp key, xla::XlaOp value,
+    xla::XlaOp output, xla::XlaOp logsumexp, float scale);
+
+// The gradients of BuildSegmentedScaledDotProductAttention.
+std::vector<xla::XlaOp> BuildSegmentedScaledDotProductAttentionGrad(
+    xla::XlaOp grad_output, xla::XlaOp query, xla::XlaOp key, xla::XlaOp value,
+    xla::XlaOp output, xla::XlaOp logsumexp, xla::XlaOp query_segment_ids,
+    xla::XlaOp key_segment_ids, float scale);
+
+}  // namespace swift_xla
@@ -14,8 +14,10 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/batch_norm.h"
 
+#include "tensorflow/compiler/tf2xla/xla_tensor/cross_replica_reduces.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
 
 namespace swift_xla {
 namespace {
@@ -29,6 +31,66 @@ xla::XlaOp VarianceRecover(xla::XlaOp invstd, float eps_value) {
   return one_over_invstd * one_over_invstd - eps;
 }
 
+// The half precision inputs get their statistics accumulated at F32.
+xla::PrimitiveType GetStatisticsType(xla::PrimitiveType type) {
+  return type == xla::PrimitiveType::BF16 || type == xla::PrimitiveType::F16
+             ? xla::PrimitiveType::F32
+             : type;
+}
+
+xla::XlaOp MaybeConvertTo(xla::XlaOp input, xla::PrimitiveType type) {
+  return XlaHelpers::TypeOfXlaOp(input) != type
+             ? xla::ConvertElementType(input, type)
+             : input;
+}
+
+// All the dimensions but the feature one.
+std::vector<int64_t> GetReduceDimensions(int64_t rank, int64_t feature_index) {
+  std::vector<int64_t> dimensions;
+  for (int64_t i = 0; i < rank; ++i) {
+    if (i != feature_index) {
+      dimensions.push_back(i);
+    }
+  }
+  return dimensions;
+}
+
+xla::XlaOp BroadcastFeatures(xla::XlaOp features, const xla::Shape& shape,
+                             int64_t feature_index) {
+  return xla::BroadcastInDim(features, shape.dimensions(), {feature_index});
+}
+
+struct ReplicaSums {
+  xla::XlaOp first;
+  xla::XlaOp second;
+  xla::XlaOp count;
+  xla::XlaOp token;
+};
+
+// Sums the two [C] vectors, and the element count of the replica, across the
+// replicas of each group with a single packed all-reduce.
+ReplicaSums AllReduceSums(xla::XlaOp first, xla::XlaOp second, int64_t count,
+                          xla::XlaOp token,
+                          const std::vector<std::vector<int64_t>>& groups) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(first);
+  int64_t num_features = shape.dimensions(0);
+  xla::XlaOp count_op = xla::Reshape(
+      XlaHelpers::ScalarValue<int64_t>(count, shape.element_type(),
+                                       first.builder()),
+      {1});
+  xla::XlaOp packed =
+      xla::ConcatInDim(first.builder(), {first, second, count_op}, 0);
+  std::vector<xla::XlaOp> reduced =
+      BuildAllReduce(AllReduceType::kSum, {packed}, token, /*scale=*/1.0,
+                     groups);
+  return {xla::SliceInDim(reduced[0], 0, num_features, 1, 0),
+          xla::SliceInDim(reduced[0], num_features, 2 * num_features, 1, 0),
+          xla::Reshape(xla::SliceInDim(reduced[0], 2 * num_features,
+                                       2 * num_features + 1, 1, 0),
+                       {}),
+          reduced[1]};
+}
+
 }  // namespace
 
 xla::XlaOp BatchNormVarianceInvert(xla::XlaOp variance, float eps_value) {
@@ -68,4 +130,70 @@ BatchNormGrads BuildBatchNormBackward(xla::XlaOp grad, xla::XlaOp input,
   return {grad_input, grad_weight, grad_bias};
 }
 
+SyncBatchNormOutput BuildSyncBatchNormTraining(
+    xla::XlaOp input, xla::XlaOp weight, xla::XlaOp bias, xla::XlaOp token,
+    int64_t feature_index, float eps_value,
+    const std::vector<std::vector<int64_t>>& groups) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::PrimitiveType type = GetStatisticsType(input_shape.element_type());
+  std::vector<int64_t> reduce_dims =
+      GetReduceDimensions(input_shape.rank(), feature_index);
+  int64_t count = xla::util::Multiply<int64_t>(input_shape.dimensions()) /
+                  input_shape.dimensions(feature_index);
+  xla::XlaOp x = MaybeConvertTo(input, type);
+  xla::XlaOp zero = xla::Zero(input.builder(), type);
+  xla::XlaComputation add_func = XlaHelpers::CreateAddComputation(type);
+  ReplicaSums sums = AllReduceSums(
+      xla::Reduce(x, zero, add_func, reduce_dims),
+      xla::Reduce(x * x, zero, add_func, reduce_dims), count, token, groups);
+  xla::XlaOp mean = sums.first / sums.count;
+  xla::XlaOp variance = xla::Max(sums.second / sums.count - mean * mean, zero);
+  xla::XlaOp scale = MaybeConvertTo(weight, type) *
+                     BatchNormVarianceInvert(variance, eps_value);
+  xla::XlaOp shift = MaybeConvertTo(bias, type) - mean * scale;
+  xla::XlaOp output =
+      x * BroadcastFeatures(scale, input_shape, feature_index) +
+      BroadcastFeatures(shift, input_shape, feature_index);
+  return {MaybeConvertTo(output, input_shape.element_type()),
+          MaybeConvertTo(mean, input_shape.element_type()),
+          MaybeConvertTo(variance, input_shape.element_type()), sums.token};
+}
+
+SyncBatchNormGrads BuildSyncBatchNormBackward(
+    xla::XlaOp grad, xla::XlaOp input, xla::XlaOp weight, xla::XlaOp mean,
+    xla::XlaOp variance, xla::XlaOp token, int64_t feature_index,
+    float eps_value, const std::vector<std::vector<int64_t>>& groups) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::PrimitiveType type = GetStatisticsType(input_shape.element_type());
+  std::vector<int64_t> reduce_dims =
+      GetReduceDimensions(input_shape.rank(), feature_index);
+  int64_t count = xla::util::Multiply<int64_t>(input_shape.dimensions()) /
+                  input_shape.dimensions(feature_index);
+  xla::XlaOp x = MaybeConvertTo(input, type);
+  xla::XlaOp dy = MaybeConvertTo(grad, type);
+  xla::XlaOp invstd =
+      BatchNormVarianceInvert(MaybeConvertTo(variance, type), eps_value);
+  xla::XlaOp x_hat =
+      (x - BroadcastFeatures(MaybeConvertTo(mean, type), input_shape,
+                             feature_index)) *
+      BroadcastFeatures(invstd, input_shape, feature_index);
+  xla::XlaOp zero = xla::Zero(input.builder(), type);
+  xla::XlaComputation add_func = XlaHelpers::CreateAddComputation(type);
+  xla::XlaOp grad_bias = xla::Reduce(dy, zero, add_func, reduce_dims);
+  xla::XlaOp grad_weight = xla::Reduce(dy * x_hat, zero, add_func, reduce_dims);
+  ReplicaSums sums =
+      AllReduceSums(grad_bias, grad_weight, count, token, groups);
+  xla::XlaOp mean_dy = sums.first / sums.count;
+  xla::XlaOp mean_dy_x_hat = sums.second / sums.count;
+  xla::XlaOp grad_input =
+      BroadcastFeatures(MaybeConvertTo(weight, type) * invstd, input_shape,
+                        feature_index) *
+      (dy - BroadcastFeatures(mean_dy, input_shape, feature_index) -
+       x_hat * BroadcastFeatures(mean_dy_x_hat, input_shape, feature_index));
+  xla::PrimitiveType weight_type = XlaHelpers::TypeOfXlaOp(weight);
+  return {MaybeConvertTo(grad_input, input_shape.element_type()),
+          MaybeConvertTo(grad_weight, weight_type),
+          MaybeConvertTo(grad_bias, weight_type), sums.token};
+}
+
 }  // namespace swift_xla
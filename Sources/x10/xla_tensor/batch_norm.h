@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 
 namespace swift_xla {
@@ -32,6 +34,20 @@ struct BatchNormGrads {
   xla::XlaOp grad_bias;
 };
 
+struct SyncBatchNormOutput {
+  xla::XlaOp output;
+  xla::XlaOp batch_mean;
+  xla::XlaOp batch_variance;
+  xla::XlaOp token;
+};
+
+struct SyncBatchNormGrads {
+  xla::XlaOp grad_input;
+  xla::XlaOp grad_weight;
+  xla::XlaOp grad_bias;
+  xla::XlaOp token;
+};
+
 xla::XlaOp BatchNormVarianceInvert(xla::XlaOp variance, float eps_value);
 
 BatchNormOutput BuildBatchNormTraining(xla::XlaOp input, xla::XlaOp weight,
@@ -46,4 +62,22 @@ BatchNormGrads BuildBatchNormBackward(xla::XlaOp grad, xla::XlaOp input,
                                       xla::XlaOp save_invstd, bool training,
                                       float eps_value);
 
+// Builds the training batch norm of the input over the replicas of each group,
+// normalizing along the feature_index dimension with the mean and the biased
+// variance of the whole cross-replica batch. The local sums and sums of squares
+// get reduced with a single all-reduce, together with the element counts.
+SyncBatchNormOutput BuildSyncBatchNormTraining(
+    xla::XlaOp input, xla::XlaOp weight, xla::XlaOp bias, xla::XlaOp token,
+    int64_t feature_index, float eps_value,
+    const std::vector<std::vector<int64_t>>& groups);
+
+// Builds the gradients of BuildSyncBatchNormTraining(), with a single
+// all-reduce of the gradient sums the input gradient needs. The weight and bias
+// gradients are the local ones, to be reduced along with the other parameter
+// gradients.
+SyncBatchNormGrads BuildSyncBatchNormBackward(
+    xla::XlaOp grad, xla::XlaOp input, xla::XlaOp weight, xla::XlaOp mean,
+    xla::XlaOp variance, xla::XlaOp token, int64_t feature_index,
+    float eps_value, const std::vector<std::vector<int64_t>>& groups);
+
 }  // namespace swift_xla
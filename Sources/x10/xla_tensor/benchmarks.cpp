@@ -0,0 +1,180 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Microbenchmarks of the lazy tensor hot paths. The results can be emitted as
+// JSON, to be tracked across commits, with:
+//   x10_benchmarks --benchmark_format=json --benchmark_out=results.json
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/literal_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/cache.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace {
+
+const xla::Shape& GetBenchmarkShape() {
+  static const xla::Shape* shape =
+      new xla::Shape(xla::ShapeUtil::MakeShape(xla::F32, {8, 8}));
+  return *shape;
+}
+
+ir::NodePtr MakeAdd(const ir::Value& lhs, const ir::Value& rhs) {
+  return ir::ops::GenericOp(
+      ir::OpKind(at::aten::add), {lhs, rhs}, lhs.shape(),
+      [](const ir::Node& node, ir::LoweringContext* loctx) -> ir::XlaOpVector {
+        xla::XlaOp xla_lhs = loctx->GetOutputOp(node.operand(0));
+        xla::XlaOp xla_rhs = loctx->GetOutputOp(node.operand(1));
+        return node.ReturnOp(xla_lhs + xla_rhs, loctx);
+      });
+}
+
+// Builds a graph of num_nodes additions, each one adding the results of the
+// two previous ones, so that the post-order has to deal with shared operands.
+ir::Value MakeGraph(int64_t num_nodes) {
+  ir::Value prev = ir::ops::ScalarOp(1.0, GetBenchmarkShape());
+  ir::Value current = ir::ops::ScalarOp(2.0, GetBenchmarkShape());
+  for (int64_t i = 0; i < num_nodes; ++i) {
+    ir::Value next = MakeAdd(prev, current);
+    prev = std::move(current);
+    current = std::move(next);
+  }
+  return current;
+}
+
+void BM_IrNodeCreation(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(MakeGraph(state.range(0)));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_IrNodeCreation)->Range(64, 16384);
+
+void BM_PostOrder(benchmark::State& state) {
+  ir::Value root = MakeGraph(state.range(0));
+  for (auto _ : state) {
+    ir::Util::EmissionMap emission_map;
+    benchmark::DoNotOptimize(
+        ir::Util::ComputePostOrder({root.node.get()}, &emission_map));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PostOrder)->Range(64, 16384);
+
+void BM_PostOrderMarked(benchmark::State& state) {
+  ir::Value root = MakeGraph(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ir::Util::ComputePostOrder({root.node.get()}));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PostOrderMarked)->Range(64, 16384);
+
+void BM_Lowering(benchmark::State& state) {
+  ir::Value root = MakeGraph(state.range(0));
+  Device device("CPU:0");
+  for (auto _ : state) {
+    ir::Util::EmissionMap emission_map;
+    std::vector<const ir::Node*> post_order =
+        ir::Util::ComputePostOrder({root.node.get()}, &emission_map);
+    ir::RootLoweringContext lowering_ctx("Benchmark", device, post_order,
+                                         std::move(emission_map));
+    lowering_ctx.AddResult(lowering_ctx.GetOutputOp(root));
+    benchmark::DoNotOptimize(ConsumeValue(lowering_ctx.Build()));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Lowering)->Range(64, 4096);
+
+void BM_ComputationCacheLookup(benchmark::State& state) {
+  using Cache = xla::util::ShardedCache<xla::hash_t, int64_t,
+                                        xla::util::HashReducer>;
+  static constexpr int64_t kNumEntries = 1024;
+  static Cache* cache = []() {
+    Cache* cache = new Cache(kNumEntries, /*num_shards=*/8);
+    for (int64_t i = 0; i < kNumEntries; ++i) {
+      cache->Add(xla::util::MHash(i), std::make_shared<int64_t>(i));
+    }
+    return cache;
+  }();
+  std::mt19937_64 generator(state.thread_index);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        cache->Get(xla::util::MHash(generator() % kNumEntries)));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ComputationCacheLookup)->ThreadRange(1, 16);
+
+void BM_TensorToLiteral(benchmark::State& state) {
+  std::vector<float> values(state.range(0), 1.0f);
+  at::Tensor tensor(std::move(values), {state.range(0)});
+  Device device("CPU:0");
+  xla::Shape shape = xla::ShapeUtil::MakeShape(xla::F32, {state.range(0)});
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(GetTensorLiteral(tensor, &shape, &device));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) *
+                          sizeof(float));
+}
+BENCHMARK(BM_TensorToLiteral)->Range(1 << 10, 1 << 24);
+
+void BM_LiteralToTensor(benchmark::State& state) {
+  xla::Literal literal(xla::ShapeUtil::MakeShape(xla::F32, {state.range(0)}));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        MakeTensorFromXlaLiteral(literal, at::ScalarType::Float));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) *
+                          sizeof(float));
+}
+BENCHMARK(BM_LiteralToTensor)->Range(1 << 10, 1 << 24);
+
+// Syncs a small graph whose computation is cached after the first iteration,
+// which measures the fixed costs of a sync on the default device.
+void BM_SyncTensorsGraph(benchmark::State& state) {
+  Device device = GetCurrentDevice();
+  XLATensor input = XLATensor::Create(
+      at::Tensor(std::vector<float>(64, 1.0f), {8, 8}), device);
+  for (auto _ : state) {
+    ir::Value value = input.GetIrValue();
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      value = MakeAdd(value, value);
+    }
+    std::vector<XLATensor> tensors = {XLATensor::Create(value, device)};
+    XLATensor::SyncTensorsGraph(&tensors, /*devices=*/{}, /*wait=*/true,
+                                /*sync_xla_data=*/true);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SyncTensorsGraph)->Arg(1)->Arg(64)->UseRealTime();
+
+}  // namespace
+}  // namespace swift_xla
+
+BENCHMARK_MAIN();
@@ -0,0 +1,415 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/checkpoint.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/layout_manager.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace swift_xla {
+namespace {
+
+constexpr char kIndexFile[] = "index";
+constexpr char kIndexMagic[] = "x10-checkpoint-v1";
+constexpr size_t kAlignment = 64;
+
+struct Entry {
+  std::string name;
+  at::ScalarType type;
+  std::vector<int64_t> dims;
+  size_t shard = 0;
+  size_t offset = 0;
+  size_t size = 0;
+};
+
+std::string GetShardPath(const std::string& path, size_t shard,
+                         size_t num_shards) {
+  return absl::StrFormat("%s/shard-%05d-of-%05d", path, shard, num_shards);
+}
+
+// The 16 bits floating point types share their host representation with
+// Short, so the host tensors fetched for them would not round trip.
+void CheckCheckpointType(at::ScalarType type) {
+  XLA_CHECK(type != at::ScalarType::BFloat16 && type != at::ScalarType::Half)
+      << "Checkpoints do not support 16 bits floating point tensors";
+}
+
+void CheckCheckpointNames(const std::vector<std::string>& names) {
+  absl::flat_hash_set<std::string> unique_names;
+  for (const std::string& name : names) {
+    XLA_CHECK(!name.empty() &&
+              name.find_first_of(" \t\n\r") == std::string::npos)
+        << "Invalid checkpoint tensor name: '" << name << "'";
+    XLA_CHECK(unique_names.insert(name).second)
+        << "Duplicated checkpoint tensor name: " << name;
+  }
+}
+
+size_t GetTensorBytes(const XLATensor& tensor) {
+  return xla::ShapeUtil::ElementsIn(tensor.shape().get()) *
+         xla::ShapeUtil::ByteSizeOfPrimitiveType(
+             TensorTypeToRawXlaType(tensor.dtype()));
+}
+
+size_t GetTransferGroupBytes() {
+  static const size_t group_bytes =
+      xla::sys_util::GetEnvInt("XLA_CHECKPOINT_TRANSFER_MB", 256) << 20;
+  return group_bytes;
+}
+
+// Bounds the bytes held by the snapshots in flight. A snapshot larger than the
+// budget still goes through, once it is the only one.
+class SnapshotBudget {
+ public:
+  static SnapshotBudget* Get() {
+    static SnapshotBudget* budget = new SnapshotBudget(
+        xla::sys_util::GetEnvInt("XLA_CHECKPOINT_SNAPSHOT_MB", 4096) << 20);
+    return budget;
+  }
+
+  void Acquire(size_t bytes) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] {
+      return in_flight_bytes_ == 0 || in_flight_bytes_ + bytes <= max_bytes_;
+    });
+    in_flight_bytes_ += bytes;
+  }
+
+  void Release(size_t bytes) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      in_flight_bytes_ -= bytes;
+    }
+    cv_.notify_all();
+  }
+
+ private:
+  explicit SnapshotBudget(size_t max_bytes) : max_bytes_(max_bytes) {}
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  size_t max_bytes_ = 0;
+  size_t in_flight_bytes_ = 0;
+};
+
+class ShardWriter {
+ public:
+  explicit ShardWriter(const std::string& path) {
+    XLA_CHECK_OK(tensorflow::Env::Default()->NewWritableFile(path, &file_));
+  }
+
+  // Appends the data at the next aligned offset, and returns that offset.
+  size_t Append(const void* data, size_t size) {
+    static const std::string* padding = new std::string(kAlignment, '\0');
+    size_t padding_size = (kAlignment - offset_ % kAlignment) % kAlignment;
+    XLA_CHECK_OK(file_->Append(
+        tensorflow::StringPiece(padding->data(), padding_size)));
+    size_t offset = offset_ + padding_size;
+    XLA_CHECK_OK(file_->Append(
+        tensorflow::StringPiece(static_cast<const char*>(data), size)));
+    offset_ = offset + size;
+    return offset;
+  }
+
+  void Close() { XLA_CHECK_OK(file_->Close()); }
+
+ private:
+  std::unique_ptr<tensorflow::WritableFile> file_;
+  size_t offset_ = 0;
+};
+
+void WriteIndex(const std::string& path, const std::vector<Entry>& entries,
+                size_t num_shards) {
+  std::stringstream ss;
+  ss << kIndexMagic << " " << num_shards << "\n";
+  for (const Entry& entry : entries) {
+    ss << entry.name << " " << static_cast<int>(entry.type) << " "
+       << entry.dims.size();
+    for (int64_t dim : entry.dims) {
+      ss << " " << dim;
+    }
+    ss << " " << entry.shard << " " << entry.offset << " " << entry.size
+       << "\n";
+  }
+  std::string index_path = absl::StrCat(path, "/", kIndexFile);
+  std::string tmp_path = absl::StrCat(index_path, ".tmp");
+  XLA_CHECK_OK(tensorflow::WriteStringToFile(tensorflow::Env::Default(),
+                                             tmp_path, ss.str()));
+  XLA_CHECK_OK(tensorflow::Env::Default()->RenameFile(tmp_path, index_path));
+}
+
+std::vector<Entry> ReadIndex(const std::string& path, size_t* num_shards) {
+  std::string index_path = absl::StrCat(path, "/", kIndexFile);
+  std::string data;
+  XLA_CHECK_OK(tensorflow::ReadFileToString(tensorflow::Env::Default(),
+                                            index_path, &data));
+  std::vector<Entry> entries;
+  bool header = true;
+  for (absl::string_view line : absl::StrSplit(data, '\n')) {
+    if (line.empty()) {
+      continue;
+    }
+    std::vector<absl::string_view> fields =
+        absl::StrSplit(line, ' ', absl::SkipEmpty());
+    if (header) {
+      XLA_CHECK(fields.size() == 2 && fields[0] == kIndexMagic &&
+                absl::SimpleAtoi(fields[1], num_shards))
+          << "Invalid checkpoint index header in " << index_path;
+      header = false;
+      continue;
+    }
+    Entry entry;
+    int type = 0;
+    size_t rank = 0;
+    XLA_CHECK(fields.size() >= 3 && absl::SimpleAtoi(fields[1], &type) &&
+              absl::SimpleAtoi(fields[2], &rank) && fields.size() == rank + 6)
+        << "Invalid checkpoint index line in " << index_path << ": " << line;
+    entry.name = std::string(fields[0]);
+    entry.type = static_cast<at::ScalarType>(type);
+    entry.dims.resize(rank);
+    bool valid = true;
+    for (size_t i = 0; i < rank; ++i) {
+      valid = valid && absl::SimpleAtoi(fields[3 + i], &entry.dims[i]);
+    }
+    valid = valid && absl::SimpleAtoi(fields[rank + 3], &entry.shard) &&
+            absl::SimpleAtoi(fields[rank + 4], &entry.offset) &&
+            absl::SimpleAtoi(fields[rank + 5], &entry.size) &&
+            entry.shard < *num_shards;
+    XLA_CHECK(valid) << "Invalid checkpoint index line in " << index_path
+                     << ": " << line;
+    entries.push_back(std::move(entry));
+  }
+  XLA_CHECK(!header) << "Empty checkpoint index in " << index_path;
+  return entries;
+}
+
+}  // namespace
+
+void Checkpoint::Save(const std::string& path,
+                      const std::vector<std::string>& names,
+                      std::vector<XLATensor> tensors, size_t num_shards) {
+  XLA_CHECK_EQ(names.size(), tensors.size());
+  XLA_CHECK_GT(num_shards, 0);
+  CheckCheckpointNames(names);
+  XLA_CHECK_OK(tensorflow::Env::Default()->RecursivelyCreateDir(path));
+
+  // Balances the shards by size, and cuts the tensors into transfer groups.
+  std::vector<Entry> entries(tensors.size());
+  std::vector<size_t> shard_bytes(num_shards, 0);
+  std::vector<std::vector<size_t>> groups;
+  size_t group_bytes = 0;
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    Entry& entry = entries[i];
+    entry.name = names[i];
+    entry.type = tensors[i].dtype();
+    CheckCheckpointType(entry.type);
+    xla::util::MaybeRef<xla::Shape> shape = tensors[i].shape();
+    entry.dims.assign(shape.get().dimensions().begin(),
+                      shape.get().dimensions().end());
+    size_t size = GetTensorBytes(tensors[i]);
+    entry.shard = std::min_element(shard_bytes.begin(), shard_bytes.end()) -
+                  shard_bytes.begin();
+    shard_bytes[entry.shard] += size;
+    if (groups.empty() || group_bytes + size > GetTransferGroupBytes()) {
+      groups.emplace_back();
+      group_bytes = 0;
+    }
+    groups.back().push_back(i);
+    group_bytes += size;
+  }
+
+  std::vector<std::unique_ptr<ShardWriter>> writers;
+  for (size_t shard = 0; shard < num_shards; ++shard) {
+    writers.push_back(
+        std::make_unique<ShardWriter>(GetShardPath(path, shard, num_shards)));
+  }
+  auto fetch = [&](size_t group) {
+    std::vector<XLATensor> group_tensors;
+    for (size_t i : groups[group]) {
+      group_tensors.push_back(tensors[i]);
+    }
+    return XLATensor::GetTensorsAsync(&group_tensors);
+  };
+  std::future<std::vector<at::Tensor>> pending;
+  if (!groups.empty()) {
+    pending = fetch(0);
+  }
+  for (size_t group = 0; group < groups.size(); ++group) {
+    std::vector<at::Tensor> host_tensors = pending.get();
+    // Issue the transfer of the next group before writing this one.
+    if (group + 1 < groups.size()) {
+      pending = fetch(group + 1);
+    }
+    xla::util::MultiWait mwait(num_shards);
+    for (size_t shard = 0; shard < num_shards; ++shard) {
+      auto write = [&, shard]() {
+        for (size_t j = 0; j < groups[group].size(); ++j) {
+          Entry& entry = entries[groups[group][j]];
+          if (entry.shard != shard) {
+            continue;
+          }
+          const at::AnyScalarBuffer& buffer = host_tensors[j].buffer();
+          entry.size = buffer.raw_size();
+          entry.offset = writers[shard]->Append(buffer.raw_data(), entry.size);
+        }
+      };
+      xla::env::ScheduleIoClosure(mwait.Completer(std::move(write)));
+    }
+    mwait.Wait();
+    XLA_COUNTER("CheckpointTransferGroups", 1);
+  }
+  for (auto& writer : writers) {
+    writer->Close();
+  }
+  size_t total_bytes = 0;
+  for (const Entry& entry : entries) {
+    total_bytes += entry.size;
+  }
+  WriteIndex(path, entries, num_shards);
+  XLA_COUNTER("CheckpointSavedBytes", total_bytes);
+  TF_VLOG(3) << "Saved " << entries.size() << " tensors (" << total_bytes
+             << " bytes) in checkpoint " << path;
+}
+
+std::shared_future<void> Checkpoint::SaveAsync(const std::string& path,
+                                               std::vector<std::string> names,
+                                               std::vector<XLATensor> tensors,
+                                               size_t num_shards) {
+  XLA_CHECK_EQ(names.size(), tensors.size());
+  XLA_CHECK_GT(num_shards, 0);
+  CheckCheckpointNames(names);
+  size_t total_bytes = 0;
+  for (const XLATensor& tensor : tensors) {
+    CheckCheckpointType(tensor.dtype());
+    total_bytes += GetTensorBytes(tensor);
+  }
+  // The snapshot tensors only share the device data with the captured ones,
+  // whose later updates then leave the snapshot alone.
+  std::vector<XLATensor> snapshot;
+  snapshot.reserve(tensors.size());
+  bool in_flight = false;
+  for (XLATensor& tensor : tensors) {
+    xla::ComputationClient::DataPtr data = tensor.CurrentXlaData();
+    if (data == nullptr) {
+      data = tensor.GetXlaData();
+    }
+    XLATensor::FreezeDeviceData(data);
+    in_flight = in_flight || !data->HasValue();
+    snapshot.push_back(XLATensor::Create(std::move(data), tensor.dtype()));
+  }
+  SnapshotBudget::Get()->Acquire(total_bytes);
+  XLA_COUNTER("CheckpointSnapshots", 1);
+  auto promise = std::make_shared<std::promise<void>>();
+  std::shared_future<void> done = promise->get_future().share();
+  auto save_fn = [path, names = std::move(names),
+                  snapshot = std::move(snapshot), num_shards, total_bytes,
+                  in_flight, promise]() mutable {
+    try {
+      if (in_flight) {
+        // Some of the data is still being computed by the step which was
+        // synced last.
+        XLATensor::WaitDeviceOps({});
+      }
+      Save(path, names, std::move(snapshot), num_shards);
+      promise->set_value();
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+    SnapshotBudget::Get()->Release(total_bytes);
+  };
+  xla::env::ScheduleIoClosure(std::move(save_fn));
+  return done;
+}
+
+std::vector<XLATensor> Checkpoint::Restore(
+    const std::string& path, const std::vector<std::string>& names,
+    const Device& device) {
+  size_t num_shards = 0;
+  std::vector<Entry> entries = ReadIndex(path, &num_shards);
+  absl::flat_hash_map<std::string, const Entry*> entries_by_name;
+  for (const Entry& entry : entries) {
+    entries_by_name.emplace(entry.name, &entry);
+  }
+  std::vector<std::unique_ptr<tensorflow::ReadOnlyMemoryRegion>> regions(
+      num_shards);
+  std::vector<const Entry*> restored;
+  restored.reserve(names.size());
+  size_t total_bytes = 0;
+  for (const std::string& name : names) {
+    auto it = entries_by_name.find(name);
+    XLA_CHECK(it != entries_by_name.end())
+        << "Tensor " << name << " not found in checkpoint " << path;
+    const Entry& entry = *it->second;
+    std::unique_ptr<tensorflow::ReadOnlyMemoryRegion>& region =
+        regions[entry.shard];
+    if (region == nullptr) {
+      XLA_CHECK_OK(
+          tensorflow::Env::Default()->NewReadOnlyMemoryRegionFromFile(
+              GetShardPath(path, entry.shard, num_shards), &region));
+    }
+    XLA_CHECK_LE(entry.offset + entry.size, region->length())
+        << "Truncated checkpoint shard for tensor " << name;
+    XLA_CHECK_EQ(at::GetLenFromShape(entry.dims) *
+                     xla::ShapeUtil::ByteSizeOfPrimitiveType(
+                         TensorTypeToRawXlaType(entry.type)),
+                 entry.size)
+        << "Checkpoint tensor " << name << " has the wrong size";
+    restored.push_back(&entry);
+    total_bytes += entry.size;
+  }
+  // The uploads read straight from the mapped shards, which stay mapped until
+  // they are all done.
+  std::vector<XLATensor> tensors(restored.size());
+  xla::util::MultiWait mwait(restored.size());
+  for (size_t i = 0; i < restored.size(); ++i) {
+    auto upload = [&, i]() {
+      const Entry& entry = *restored[i];
+      xla::Shape shape = MakeArrayShapeFromDimensions(
+          entry.dims, /*dynamic_dimensions=*/{},
+          MakeXlaPrimitiveType(entry.type, &device), device.hw_type);
+      const char* data =
+          static_cast<const char*>(regions[entry.shard]->data()) +
+          entry.offset;
+      tensors[i] = XLATensor::Create(
+          BufferToXlaData(data, entry.type, entry.dims, shape, device),
+          entry.type);
+    };
+    xla::env::ScheduleIoClosure(mwait.Completer(std::move(upload)));
+  }
+  mwait.Wait();
+  XLA_COUNTER("CheckpointRestoredBytes", total_bytes);
+  return tensors;
+}
+
+}  // namespace swift_xla
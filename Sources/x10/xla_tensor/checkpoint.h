@@ -0,0 +1,63 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <future>
+#include <string>
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+
+namespace swift_xla {
+
+// Checkpoints of named tensors, saved from and restored to the devices without
+// going through the tensors one at a time.
+//
+// A checkpoint is a folder with a text index and the given number of shard
+// files holding the raw tensor data, in row major order and 64 bytes aligned.
+// Saving fetches the tensors in groups of XLA_CHECKPOINT_TRANSFER_MB megabytes,
+// with one batched transfer per group issued while the previous group gets
+// written, and writes the shards in parallel. Restoring maps the shard files in
+// memory and uploads the tensors in parallel, straight from the mapping.
+class Checkpoint {
+ public:
+  // Saves the tensors under the given names, which must be unique and free of
+  // whitespace. The index gets written last, so an interrupted save does not
+  // leave a readable checkpoint behind.
+  static void Save(const std::string& path,
+                   const std::vector<std::string>& names,
+                   std::vector<XLATensor> tensors, size_t num_shards);
+
+  // Same as Save(), but returns once the device data of the tensors has been
+  // captured, and saves it in the background while the training goes on. The
+  // captured buffers get frozen, so the later steps never donate them, and they
+  // are held until the save completes. The snapshots in flight hold at most
+  // XLA_CHECKPOINT_SNAPSHOT_MB megabytes, beyond which a new snapshot waits
+  // for the earlier ones to complete. The returned future carries the errors
+  // of the save.
+  static std::shared_future<void> SaveAsync(const std::string& path,
+                                            std::vector<std::string> names,
+                                            std::vector<XLATensor> tensors,
+                                            size_t num_shards);
+
+  // Restores the named tensors onto the device.
+  static std::vector<XLATensor> Restore(const std::string& path,
+                                        const std::vector<std::string>& names,
+                                        const Device& device);
+};
+
+}  // namespace swift_xla
@@ -0,0 +1,286 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Bandwidth benchmarks of the collectives, as lowered by BuildAllReduce() and
+// BuildAllToAll(), in the style of nccl-tests. The message size gets swept
+// from 1KB up to XLA_COLLECTIVE_BENCH_MAX_BYTES (256MB by default), over the
+// replica counts which fit the devices of each kind, and every run reports:
+//   algbw: the message bytes over the time of the collective.
+//   busbw: the algorithm bandwidth scaled by the fraction of the message each
+//          replica sends over its link, 2(n-1)/n for an all-reduce and (n-1)/n
+//          for an all-to-all, which makes it comparable to the link speed.
+// The replicas run through the local devices when they are (GPU, with NCCL),
+// and through the computation client otherwise (XRT). The bandwidths also get
+// recorded as metrics, whose report gets printed at the end of the run.
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "benchmark/benchmark.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/cross_replica_reduces.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/compiler/xla/xla_client/local_device.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+
+namespace swift_xla {
+namespace {
+
+enum class Collective { kAllReduce, kAllReduceBFloat16, kAllToAll };
+
+const char* CollectiveName(Collective collective) {
+  switch (collective) {
+    case Collective::kAllReduce:
+      return "AllReduce";
+    case Collective::kAllReduceBFloat16:
+      return "AllReduceBFloat16";
+    case Collective::kAllToAll:
+      return "AllToAll";
+  }
+}
+
+// The fraction of the message bytes each replica sends over its link.
+double BusBandwidthFactor(Collective collective, int64_t num_replicas) {
+  double n = num_replicas;
+  return collective == Collective::kAllToAll ? (n - 1) / n : 2 * (n - 1) / n;
+}
+
+std::string MetricFnBandwidth(double value) {
+  return absl::StrFormat("%.2fGB/s", value * 1e-9);
+}
+
+void RecordBandwidth(const std::string& name, double value) {
+  static std::mutex* lock = new std::mutex();
+  static auto* metrics = new std::map<std::string, xla::metrics::Metric*>();
+  std::lock_guard<std::mutex> guard(*lock);
+  xla::metrics::Metric*& metric = (*metrics)[name];
+  if (metric == nullptr) {
+    metric = new xla::metrics::Metric(name, MetricFnBandwidth);
+  }
+  metric->AddSample(value);
+}
+
+// Builds the computation of a replica, which outputs the collective result
+// and the token, whose transfer waits for the collective to complete.
+xla::XlaComputation BuildCollective(Collective collective,
+                                    const xla::Shape& shape,
+                                    int64_t num_replicas) {
+  xla::XlaBuilder builder(CollectiveName(collective));
+  xla::XlaOp input = xla::Parameter(&builder, 0, shape, "input");
+  xla::XlaOp token = xla::Zero(&builder, shape.element_type());
+  xla::XlaOp result;
+  if (collective == Collective::kAllToAll) {
+    AllToAllResult all_to_all =
+        BuildAllToAll(input, token, /*split_dimension=*/0,
+                      /*concat_dimension=*/0, num_replicas, /*groups=*/{});
+    result = all_to_all.result;
+    token = all_to_all.token;
+  } else {
+    std::vector<xla::XlaOp> reduced = BuildAllReduce(
+        AllReduceType::kSum, {input}, token, /*scale=*/1.0, /*groups=*/{},
+        collective == Collective::kAllReduceBFloat16
+            ? AllReducePrecision::kBFloat16
+            : AllReducePrecision::kFull);
+    result = reduced.front();
+    token = reduced.back();
+  }
+  xla::Tuple(&builder, {result, token});
+  return ConsumeValue(builder.Build());
+}
+
+// The replicas of a collective, with their inputs already on the devices.
+class ReplicaSet {
+ public:
+  ReplicaSet(Collective collective, std::vector<std::string> devices,
+             int64_t num_bytes)
+      : devices_(std::move(devices)) {
+    DeviceType hw_type = Device(devices_.front()).hw_type;
+    int64_t num_replicas = devices_.size();
+    // The all-to-all splits the leading dimension between the replicas.
+    xla::Shape shape = MakeShapeWithDeviceLayout(
+        xla::ShapeUtil::MakeShape(
+            xla::F32,
+            {num_replicas, num_bytes / num_replicas /
+                               static_cast<int64_t>(sizeof(float))}),
+        hw_type);
+    xla::XlaComputation computation;
+    {
+      ReplicationDevicesScope replication_devices_scope(devices_);
+      computation = BuildCollective(collective, shape, num_replicas);
+    }
+    xla::ProgramShape program_shape =
+        ConsumeValue(computation.GetProgramShape());
+    result_shape_ = MakeShapeWithDeviceLayout(program_shape.result(), hw_type);
+    local_ = true;
+    for (const std::string& device : devices_) {
+      xla::ComputationClient::Device* x10_device = xla::GetX10Device(device);
+      local_ = local_ && x10_device->IsLocal();
+      x10_devices_.push_back(x10_device);
+      std::vector<xla::ComputationClient::CompileInstance> instances;
+      instances.emplace_back(computation, &result_shape_);
+      computations_.push_back(
+          x10_device->Compile(devices_, std::move(instances)).front());
+      xla::ComputationClient::TensorSource source(
+          shape, [](const xla::ComputationClient::TensorSource&, void* buffer,
+                    size_t size) { std::memset(buffer, 0, size); });
+      arguments_.push_back(x10_device->TransferToServer({source}));
+    }
+  }
+
+  // Runs the collective on all the replicas, and waits for it to complete.
+  void Run() {
+    std::vector<std::vector<xla::ComputationClient::DataPtr>> results;
+    if (local_) {
+      // A single launch, so that the replicas share the run the collectives
+      // of the local devices rendezvous on.
+      results = xla::ExecuteReplicatedOnLocalDevices(*computations_.front(),
+                                                     arguments_, x10_devices_);
+    } else {
+      results.resize(devices_.size());
+      xla::util::MultiWait mwait(devices_.size());
+      for (size_t i = 0; i < devices_.size(); ++i) {
+        auto replica_fn = [&, i]() {
+          results[i] = x10_devices_[i]->ExecuteComputation(
+              *computations_[i], arguments_[i],
+              xla::ComputationClient::ExecuteComputationOptions());
+        };
+        // The replicas block in the collective until all of them join.
+        xla::env::ScheduleIoClosure(mwait.Completer(std::move(replica_fn)));
+      }
+      mwait.Wait();
+    }
+    std::vector<xla::ComputationClient::DataPtr> tokens;
+    for (auto& replica_results : results) {
+      tokens.push_back(replica_results.back());
+    }
+    xla::ComputationClient::TransferFromServer(tokens);
+  }
+
+ private:
+  std::vector<std::string> devices_;
+  std::vector<xla::ComputationClient::Device*> x10_devices_;
+  xla::Shape result_shape_;
+  std::vector<xla::ComputationClient::ComputationPtr> computations_;
+  std::vector<std::vector<xla::ComputationClient::DataPtr>> arguments_;
+  bool local_ = false;
+};
+
+void BM_Collective(benchmark::State& state, Collective collective,
+                   std::vector<std::string> devices, int64_t num_bytes) {
+  int64_t num_replicas = devices.size();
+  ReplicaSet replicas(collective, std::move(devices), num_bytes);
+  // Connection setup, like the NCCL communicators, does not count.
+  replicas.Run();
+  double total_seconds = 0;
+  for (auto _ : state) {
+    int64_t start_ns = xla::sys_util::NowNs();
+    replicas.Run();
+    double seconds = (xla::sys_util::NowNs() - start_ns) * 1e-9;
+    state.SetIterationTime(seconds);
+    total_seconds += seconds;
+  }
+  double algbw = num_bytes * state.iterations() / total_seconds;
+  double busbw = algbw * BusBandwidthFactor(collective, num_replicas);
+  state.counters["algbw"] = algbw;
+  state.counters["busbw"] = busbw;
+  state.SetBytesProcessed(state.iterations() * num_bytes);
+  std::string name = absl::StrCat("Collective", CollectiveName(collective),
+                                  "_", num_replicas, "x", num_bytes);
+  RecordBandwidth(absl::StrCat(name, "AlgBw"), algbw);
+  RecordBandwidth(absl::StrCat(name, "BusBw"), busbw);
+}
+
+// Returns the devices of each kind, in ordinal order.
+std::map<DeviceType, std::vector<std::string>> GetDevicesByKind() {
+  std::map<DeviceType, std::vector<std::string>> devices;
+  for (const std::string& device : xla::ComputationClient::AllDevices()) {
+    devices[Device(device).hw_type].push_back(device);
+  }
+  for (auto& kind_devices : devices) {
+    std::sort(kind_devices.second.begin(), kind_devices.second.end(),
+              [](const std::string& lhs, const std::string& rhs) {
+                return Device(lhs) < Device(rhs);
+              });
+  }
+  return devices;
+}
+
+// The powers of two replica counts which fit the devices, plus all of them.
+std::vector<int64_t> GetReplicaCounts(int64_t num_devices) {
+  std::vector<int64_t> counts;
+  for (int64_t count = 2; count < num_devices; count *= 2) {
+    counts.push_back(count);
+  }
+  if (num_devices > 1) {
+    counts.push_back(num_devices);
+  }
+  return counts;
+}
+
+void RegisterCollectiveBenchmarks() {
+  static const int64_t max_bytes = xla::sys_util::GetEnvInt(
+      "XLA_COLLECTIVE_BENCH_MAX_BYTES", int64_t{256} << 20);
+  for (auto& kind_devices : GetDevicesByKind()) {
+    const std::vector<std::string>& devices = kind_devices.second;
+    for (int64_t num_replicas : GetReplicaCounts(devices.size())) {
+      std::vector<std::string> replica_devices(devices.begin(),
+                                               devices.begin() + num_replicas);
+      for (Collective collective :
+           {Collective::kAllReduce, Collective::kAllReduceBFloat16,
+            Collective::kAllToAll}) {
+        for (int64_t num_bytes = 1 << 10; num_bytes <= max_bytes;
+             num_bytes *= 4) {
+          // Every replica holds an equal, whole number of elements.
+          if (num_bytes %
+                  (num_replicas * static_cast<int64_t>(sizeof(float))) !=
+              0) {
+            continue;
+          }
+          std::string name = absl::StrCat(
+              "BM_", CollectiveName(collective), "/",
+              replica_devices.front(), "/", num_replicas, "/", num_bytes);
+          benchmark::RegisterBenchmark(name.c_str(), BM_Collective, collective,
+                                       replica_devices, num_bytes)
+              ->UseManualTime()
+              ->Unit(benchmark::kMicrosecond);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace swift_xla
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  swift_xla::RegisterCollectiveBenchmarks();
+  benchmark::RunSpecifiedBenchmarks();
+  std::cout << xla::metrics::CreateMetricReport();
+  return 0;
+}
@@ -0,0 +1,147 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/collective_profiler.h"
+
+#include <map>
+#include <mutex>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/trace_recorder.h"
+
+namespace swift_xla {
+namespace {
+
+struct KindMetrics {
+  xla::metrics::Counter* count;
+  xla::metrics::Metric* bytes;
+  xla::metrics::Metric* group_size;
+};
+
+// Turns an HLO opcode like all-reduce into the AllReduce metric name part.
+std::string GetMetricName(const std::string& kind) {
+  std::string name;
+  for (absl::string_view part : absl::StrSplit(kind, '-')) {
+    if (!part.empty()) {
+      name += absl::ascii_toupper(part[0]);
+      absl::StrAppend(&name, part.substr(1));
+    }
+  }
+  return name;
+}
+
+KindMetrics* GetKindMetrics(const std::string& kind) {
+  static std::mutex* lock = new std::mutex();
+  static auto* kind_metrics = new std::map<std::string, KindMetrics>();
+  std::lock_guard<std::mutex> guard(*lock);
+  auto it = kind_metrics->find(kind);
+  if (it == kind_metrics->end()) {
+    std::string name = absl::StrCat("Collective", GetMetricName(kind));
+    KindMetrics metrics{
+        new xla::metrics::Counter(absl::StrCat(name, "Count")),
+        new xla::metrics::Metric(absl::StrCat(name, "Bytes"),
+                                 xla::metrics::MetricFnBytes),
+        new xla::metrics::Metric(absl::StrCat(name, "GroupSize"))};
+    it = kind_metrics->emplace(kind, metrics).first;
+  }
+  return &it->second;
+}
+
+// Returns the collective kind of an HLO opcode, or an empty string if the
+// opcode is not a collective. The asynchronous collectives are accounted on
+// their start instruction.
+std::string GetCollectiveKind(const std::string& opcode) {
+  static const char* const kinds[] = {"all-reduce", "all-gather",
+                                      "reduce-scatter", "all-to-all",
+                                      "collective-permute"};
+  for (const char* kind : kinds) {
+    if (opcode == kind || opcode == absl::StrCat(kind, "-start")) {
+      return kind;
+    }
+  }
+  return std::string();
+}
+
+int64_t GetArrayBytes(const xla::Shape& shape) {
+  int64_t bytes = 0;
+  xla::ShapeUtil::ForEachSubshape(
+      shape, [&](const xla::Shape& subshape, const xla::ShapeIndex& index) {
+        if (subshape.IsArray()) {
+          bytes += xla::ShapeUtil::ByteSizeOf(subshape);
+        }
+      });
+  return bytes;
+}
+
+}  // namespace
+
+bool IsCollectiveProfilingEnabled() {
+  static const bool profile_collectives =
+      xla::sys_util::GetEnvBool("XLA_COLLECTIVE_PROFILE", false);
+  return profile_collectives;
+}
+
+std::vector<CollectiveInfo> GetCollectives(const xla::HloModuleProto& proto,
+                                           int64_t replica_count) {
+  std::vector<CollectiveInfo> collectives;
+  for (auto& computation : proto.computations()) {
+    for (auto& instruction : computation.instructions()) {
+      std::string kind = GetCollectiveKind(instruction.opcode());
+      if (kind.empty()) {
+        continue;
+      }
+      CollectiveInfo info;
+      info.kind = std::move(kind);
+      info.scope = instruction.metadata().op_name();
+      info.bytes = GetArrayBytes(xla::Shape(instruction.shape()));
+      info.group_size = instruction.replica_groups_size() > 0
+                            ? instruction.replica_groups(0).replica_ids_size()
+                            : replica_count;
+      collectives.push_back(std::move(info));
+    }
+  }
+  return collectives;
+}
+
+void RecordCollectiveExecution(absl::Span<const CollectiveInfo> collectives,
+                               int64_t start_ns, int64_t end_ns) {
+  static xla::metrics::Metric* time_metric = new xla::metrics::Metric(
+      "CollectiveGraphExecuteTime", xla::metrics::MetricFnTime);
+  static xla::metrics::Metric* bytes_metric = new xla::metrics::Metric(
+      "CollectiveGraphBytes", xla::metrics::MetricFnBytes);
+  int64_t total_bytes = 0;
+  for (auto& info : collectives) {
+    KindMetrics* metrics = GetKindMetrics(info.kind);
+    metrics->count->AddValue(1);
+    metrics->bytes->AddSample(info.bytes);
+    metrics->group_size->AddSample(info.group_size);
+    total_bytes += info.bytes;
+    if (xla::trace::IsRecording()) {
+      xla::trace::RecordEvent(
+          absl::StrCat(info.kind, " ",
+                       info.scope.empty() ? "<unscoped>" : info.scope,
+                       " bytes=", info.bytes, " group=", info.group_size),
+          start_ns, end_ns);
+    }
+  }
+  time_metric->AddSample(end_ns - start_ns);
+  bytes_metric->AddSample(total_bytes);
+}
+
+}  // namespace swift_xla
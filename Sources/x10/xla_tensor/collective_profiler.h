@@ -0,0 +1,56 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/service/hlo.pb.h"
+
+namespace swift_xla {
+
+// A collective operation of a computation, as found in its HLO.
+struct CollectiveInfo {
+  // The HLO opcode, like all-reduce or collective-permute.
+  std::string kind;
+  // The IR scope of the node which lowered to the collective, if any.
+  std::string scope;
+  // Bytes of the collective result.
+  int64_t bytes = 0;
+  // Number of replicas within each of the collective groups.
+  int64_t group_size = 0;
+};
+
+// Whether the collectives of the executed computations get profiled, which
+// happens when XLA_COLLECTIVE_PROFILE is set.
+bool IsCollectiveProfilingEnabled();
+
+// Collects the collectives of the HLO module, run over replica_count replicas.
+std::vector<CollectiveInfo> GetCollectives(const xla::HloModuleProto& proto,
+                                           int64_t replica_count);
+
+// Records an execution of a computation holding the collectives, which took
+// place between start_ns and end_ns, into the Collective* metrics and the
+// trace timeline. The collectives are only observable from the host as part of
+// the whole computation, so the execution time is an upper bound of the time
+// from the issue to the completion of each of them.
+void RecordCollectiveExecution(absl::Span<const CollectiveInfo> collectives,
+                               int64_t start_ns, int64_t end_ns);
+
+}  // namespace swift_xla
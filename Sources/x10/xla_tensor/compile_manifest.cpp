@@ -0,0 +1,162 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/compile_manifest.h"
+
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/service/hlo.pb.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace swift_xla {
+namespace {
+
+// The manifest index holds one line per entry, with the format:
+//   HASH_HIGH64 HASH_LOW64 DEVICE [DEVICE,...]
+// The HLO module of the entry is stored in the HASH.hlo.pb file.
+const char* const kIndexFile = "manifest.txt";
+
+std::string GetHloPath(const std::string& path, const xla::hash_t& hash) {
+  return absl::StrCat(path, "/", xla::util::HexHash(hash), ".hlo.pb");
+}
+
+// Parses the hash of a manifest index line.
+bool ParseEntryHash(const std::string& line, xla::hash_t* hash) {
+  std::vector<std::string> parts =
+      absl::StrSplit(line, ' ', absl::SkipEmpty());
+  if (parts.size() < 3) {
+    return false;
+  }
+  *hash = absl::MakeUint128(std::stoull(parts[0]), std::stoull(parts[1]));
+  return true;
+}
+
+// The hashes already within the manifest index, loaded from it when the
+// recording starts, so that a process appending to the manifest of an earlier
+// run does not record its entries again.
+absl::flat_hash_set<xla::hash_t> LoadRecordedHashes(const std::string& path) {
+  absl::flat_hash_set<xla::hash_t> hashes;
+  std::ifstream index_file(absl::StrCat(path, "/", kIndexFile));
+  std::string line;
+  xla::hash_t hash;
+  while (std::getline(index_file, line)) {
+    if (ParseEntryHash(line, &hash)) {
+      hashes.insert(hash);
+    }
+  }
+  return hashes;
+}
+
+}  // namespace
+
+void CompileManifest::MaybeRecord(const xla::hash_t& hash,
+                                  const std::string& device,
+                                  absl::Span<const std::string> devices,
+                                  const xla::XlaComputation& computation) {
+  static const std::string* path = new std::string(
+      xla::sys_util::GetEnvString("XLA_RECORD_COMPILE_MANIFEST", ""));
+  if (path->empty()) {
+    return;
+  }
+  static std::mutex* lock = new std::mutex();
+  std::lock_guard<std::mutex> guard(*lock);
+  static absl::flat_hash_set<xla::hash_t>* recorded =
+      new absl::flat_hash_set<xla::hash_t>(LoadRecordedHashes(*path));
+  // The same graph gets compiled again when evicted from the cache.
+  if (!recorded->insert(hash).second) {
+    return;
+  }
+  // The recording is a side product of the training, which must not fail
+  // because of it.
+  tensorflow::Status status =
+      tensorflow::Env::Default()->RecursivelyCreateDir(*path);
+  if (status.ok()) {
+    status = tensorflow::WriteStringToFile(
+        tensorflow::Env::Default(), GetHloPath(*path, hash),
+        computation.proto().SerializeAsString());
+  }
+  if (!status.ok()) {
+    TF_LOG(WARNING) << "Unable to record computation "
+                    << xla::util::HexHash(hash)
+                    << " in the compile manifest: " << status;
+    recorded->erase(hash);
+    return;
+  }
+  std::ofstream index_file(absl::StrCat(*path, "/", kIndexFile),
+                           std::ios_base::app);
+  index_file << absl::Uint128High64(hash) << " " << absl::Uint128Low64(hash)
+             << " " << device;
+  if (!devices.empty()) {
+    index_file << " " << absl::StrJoin(devices, ",");
+  }
+  index_file << "\n";
+  index_file.flush();
+  if (!index_file) {
+    TF_LOG(WARNING) << "Unable to append computation "
+                    << xla::util::HexHash(hash) << " to the compile manifest "
+                    << *path;
+    recorded->erase(hash);
+    return;
+  }
+  XLA_COUNTER("CompileManifestRecord", 1);
+}
+
+std::vector<CompileManifest::Entry> CompileManifest::Load(
+    const std::string& path) {
+  std::ifstream index_file(absl::StrCat(path, "/", kIndexFile));
+  XLA_CHECK(index_file.is_open())
+      << "Unable to open compile manifest: " << path;
+  std::vector<Entry> entries;
+  absl::flat_hash_set<xla::hash_t> hashes;
+  std::string line;
+  while (std::getline(index_file, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    Entry entry;
+    XLA_CHECK(ParseEntryHash(line, &entry.hash)) << line;
+    // The manifests recorded before the entries got deduplicated can list
+    // the same computation more than once.
+    if (!hashes.insert(entry.hash).second) {
+      continue;
+    }
+    std::vector<std::string> parts =
+        absl::StrSplit(line, ' ', absl::SkipEmpty());
+    entry.device = parts[2];
+    if (parts.size() > 3) {
+      entry.devices = absl::StrSplit(parts[3], ',');
+    }
+    std::string data;
+    XLA_CHECK_OK(tensorflow::ReadFileToString(
+        tensorflow::Env::Default(), GetHloPath(path, entry.hash), &data));
+    xla::HloModuleProto proto;
+    XLA_CHECK(proto.ParseFromString(data)) << GetHloPath(path, entry.hash);
+    entry.computation = xla::XlaComputation(std::move(proto));
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+}  // namespace swift_xla
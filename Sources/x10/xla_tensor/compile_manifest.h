@@ -0,0 +1,51 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/client/xla_computation.h"
+#include "tensorflow/compiler/xla/xla_client/types.h"
+
+namespace swift_xla {
+
+// Records the computations compiled by the tensors graph sync operations into
+// a manifest folder, so that a later process can compile them all upfront
+// (see XLATensor::WarmupCompilationCache()). Recording is enabled by pointing
+// the XLA_RECORD_COMPILE_MANIFEST environment variable to the manifest folder.
+class CompileManifest {
+ public:
+  struct Entry {
+    xla::hash_t hash;
+    std::string device;
+    std::vector<std::string> devices;
+    xla::XlaComputation computation;
+  };
+
+  // Appends a compilation to the manifest, if recording is enabled and the
+  // manifest does not hold it already. Failing to write it is only logged.
+  static void MaybeRecord(const xla::hash_t& hash, const std::string& device,
+                          absl::Span<const std::string> devices,
+                          const xla::XlaComputation& computation);
+
+  // Loads all the entries of the manifest stored within the path folder.
+  static std::vector<Entry> Load(const std::string& path);
+};
+
+}  // namespace swift_xla
@@ -0,0 +1,230 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/conversion_kernels.h"
+
+#include "tensorflow/core/platform/cpu_info.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define X10_CONVERSION_KERNELS_AVX2
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define X10_CONVERSION_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace swift_xla {
+namespace {
+
+#if defined(X10_CONVERSION_KERNELS_AVX2)
+
+#define X10_AVX2_TARGET __attribute__((target("avx2,f16c")))
+
+bool HasAvx2() {
+  static const bool has_avx2 =
+      tensorflow::port::TestCPUFeature(tensorflow::port::CPUFeature::AVX2) &&
+      tensorflow::port::TestCPUFeature(tensorflow::port::CPUFeature::F16C);
+  return has_avx2;
+}
+
+X10_AVX2_TARGET int64_t Avx2FloatToBFloat16(const float* source,
+                                            uint16_t* dest, int64_t n) {
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i bias = _mm256_set1_epi32(0x7fff);
+  const __m256i nan = _mm256_set1_epi32(0x7fc0);
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 values = _mm256_loadu_ps(source + i);
+    __m256i bits = _mm256_castps_si256(values);
+    // Round to nearest even: add 0x7fff plus the lowest bit which survives
+    // the truncation.
+    __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(bits, 16), one);
+    __m256i rounded = _mm256_srli_epi32(
+        _mm256_add_epi32(bits, _mm256_add_epi32(bias, lsb)), 16);
+    __m256 is_nan = _mm256_cmp_ps(values, values, _CMP_UNORD_Q);
+    rounded = _mm256_blendv_epi8(rounded, nan, _mm256_castps_si256(is_nan));
+    // The pack works within 128bit lanes, so the 64bit groups holding the
+    // results are 0 and 2.
+    __m256i packed = _mm256_packus_epi32(rounded, rounded);
+    packed = _mm256_permute4x64_epi64(packed, 0x08);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                     _mm256_castsi256_si128(packed));
+  }
+  return i;
+}
+
+X10_AVX2_TARGET int64_t Avx2BFloat16ToFloat(const uint16_t* source,
+                                            float* dest, int64_t n) {
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i values = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)));
+    _mm256_storeu_ps(dest + i,
+                     _mm256_castsi256_ps(_mm256_slli_epi32(values, 16)));
+  }
+  return i;
+}
+
+X10_AVX2_TARGET int64_t Avx2FloatToHalf(const float* source, uint16_t* dest,
+                                        int64_t n) {
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i values =
+        _mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), values);
+  }
+  return i;
+}
+
+X10_AVX2_TARGET int64_t Avx2HalfToFloat(const uint16_t* source, float* dest,
+                                        int64_t n) {
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 values = _mm256_cvtph_ps(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)));
+    _mm256_storeu_ps(dest + i, values);
+  }
+  return i;
+}
+
+X10_AVX2_TARGET int64_t Avx2Int64ToInt32(const int64_t* source, int32_t* dest,
+                                         int64_t n) {
+  // Gathers the low 32bit halves of the four 64bit values in the lower lane.
+  const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  int64_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i lo = _mm256_permutevar8x32_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i)),
+        low_halves);
+    __m256i hi = _mm256_permutevar8x32_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i + 4)),
+        low_halves);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i),
+                        _mm256_permute2x128_si256(lo, hi, 0x20));
+  }
+  return i;
+}
+
+#elif defined(X10_CONVERSION_KERNELS_NEON)
+
+int64_t NeonFloatToBFloat16(const float* source, uint16_t* dest, int64_t n) {
+  const uint32x4_t one = vdupq_n_u32(1);
+  const uint32x4_t bias = vdupq_n_u32(0x7fff);
+  const uint32x4_t nan = vdupq_n_u32(0x7fc0);
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t values = vld1q_f32(source + i);
+    uint32x4_t bits = vreinterpretq_u32_f32(values);
+    uint32x4_t lsb = vandq_u32(vshrq_n_u32(bits, 16), one);
+    uint32x4_t rounded =
+        vshrq_n_u32(vaddq_u32(bits, vaddq_u32(bias, lsb)), 16);
+    uint32x4_t not_nan = vceqq_f32(values, values);
+    rounded = vbslq_u32(not_nan, rounded, nan);
+    vst1_u16(dest + i, vmovn_u32(rounded));
+  }
+  return i;
+}
+
+int64_t NeonBFloat16ToFloat(const uint16_t* source, float* dest, int64_t n) {
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    uint32x4_t values = vshll_n_u16(vld1_u16(source + i), 16);
+    vst1q_f32(dest + i, vreinterpretq_f32_u32(values));
+  }
+  return i;
+}
+
+int64_t NeonFloatToHalf(const float* source, uint16_t* dest, int64_t n) {
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float16x4_t values = vcvt_f16_f32(vld1q_f32(source + i));
+    vst1_u16(dest + i, vreinterpret_u16_f16(values));
+  }
+  return i;
+}
+
+int64_t NeonHalfToFloat(const uint16_t* source, float* dest, int64_t n) {
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float16x4_t values = vreinterpret_f16_u16(vld1_u16(source + i));
+    vst1q_f32(dest + i, vcvt_f32_f16(values));
+  }
+  return i;
+}
+
+int64_t NeonInt64ToInt32(const int64_t* source, int32_t* dest, int64_t n) {
+  int64_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    vst1_s32(dest + i, vmovn_s64(vld1q_s64(source + i)));
+  }
+  return i;
+}
+
+#endif
+
+}  // namespace
+
+int64_t ConvertFloatToBFloat16(const float* source, uint16_t* dest,
+                               int64_t n) {
+#if defined(X10_CONVERSION_KERNELS_AVX2)
+  return HasAvx2() ? Avx2FloatToBFloat16(source, dest, n) : 0;
+#elif defined(X10_CONVERSION_KERNELS_NEON)
+  return NeonFloatToBFloat16(source, dest, n);
+#else
+  return 0;
+#endif
+}
+
+int64_t ConvertBFloat16ToFloat(const uint16_t* source, float* dest,
+                               int64_t n) {
+#if defined(X10_CONVERSION_KERNELS_AVX2)
+  return HasAvx2() ? Avx2BFloat16ToFloat(source, dest, n) : 0;
+#elif defined(X10_CONVERSION_KERNELS_NEON)
+  return NeonBFloat16ToFloat(source, dest, n);
+#else
+  return 0;
+#endif
+}
+
+int64_t ConvertFloatToHalf(const float* source, uint16_t* dest, int64_t n) {
+#if defined(X10_CONVERSION_KERNELS_AVX2)
+  return HasAvx2() ? Avx2FloatToHalf(source, dest, n) : 0;
+#elif defined(X10_CONVERSION_KERNELS_NEON)
+  return NeonFloatToHalf(source, dest, n);
+#else
+  return 0;
+#endif
+}
+
+int64_t ConvertHalfToFloat(const uint16_t* source, float* dest, int64_t n) {
+#if defined(X10_CONVERSION_KERNELS_AVX2)
+  return HasAvx2() ? Avx2HalfToFloat(source, dest, n) : 0;
+#elif defined(X10_CONVERSION_KERNELS_NEON)
+  return NeonHalfToFloat(source, dest, n);
+#else
+  return 0;
+#endif
+}
+
+int64_t ConvertInt64ToInt32(const int64_t* source, int32_t* dest, int64_t n) {
+#if defined(X10_CONVERSION_KERNELS_AVX2)
+  return HasAvx2() ? Avx2Int64ToInt32(source, dest, n) : 0;
+#elif defined(X10_CONVERSION_KERNELS_NEON)
+  return NeonInt64ToInt32(source, dest, n);
+#else
+  return 0;
+#endif
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,42 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace swift_xla {
+
+// Vectorized element type conversions used by the host tensor copies. The
+// kernel is picked at runtime according to the CPU features (AVX2 and F16C on
+// x86-64, NEON on AArch64). Every API converts a prefix of the input, and
+// returns the number of converted elements, which is a multiple of the vector
+// width and zero if no kernel is available. The caller converts the remaining
+// elements with the scalar code, which yields the same results (the bfloat16
+// and half conversions round to nearest even).
+
+int64_t ConvertFloatToBFloat16(const float* source, uint16_t* dest, int64_t n);
+
+int64_t ConvertBFloat16ToFloat(const uint16_t* source, float* dest, int64_t n);
+
+int64_t ConvertFloatToHalf(const float* source, uint16_t* dest, int64_t n);
+
+int64_t ConvertHalfToFloat(const uint16_t* source, float* dest, int64_t n);
+
+// Truncates 64bit integers to 32bit, like static_cast<int32_t>() does.
+int64_t ConvertInt64ToInt32(const int64_t* source, int32_t* dest, int64_t n);
+
+}  // namespace swift_xla
@@ -15,7 +15,10 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/convolution.h"
 
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/layout_manager.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
 #include "tensorflow/compiler/tf2xla/kernels/conv_op_helpers.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
@@ -111,11 +114,60 @@ namespace {
  */
 // clang-format on
 
+// Reorders the per dimension values, of which there might be several for each
+// dimension, like the low and high explicit paddings.
+template <typename T>
+std::vector<T> PermuteDimensionValues(const std::vector<T>& values,
+                                      absl::Span<const int64_t> permutation) {
+  size_t values_per_dim = values.size() / permutation.size();
+  std::vector<T> permuted;
+  permuted.reserve(values.size());
+  for (int64_t dim : permutation) {
+    for (size_t i = 0; i < values_per_dim; ++i) {
+      permuted.push_back(values[dim * values_per_dim + i]);
+    }
+  }
+  return permuted;
+}
+
+xla::Shape PermuteShape(const xla::Shape& shape,
+                        absl::Span<const int64_t> permutation) {
+  return xla::ShapeUtil::MakeShape(
+      shape.element_type(),
+      PermuteDimensionValues(xla::util::ToVector<int64_t>(shape.dimensions()),
+                             permutation));
+}
+
+bool UseChannelsLastConvolution() {
+  return PreferChannelsLastConvolution(GetCurrentDevice().hw_type);
+}
+
+// Dimension numbers for channels last activations, (N, spatial..., C), and a
+// (spatial..., Cin, Cout) kernel.
+xla::ConvolutionDimensionNumbers MakeChannelsLastConvDimensionNumbers(
+    int64_t num_spatial_dims) {
+  xla::ConvolutionDimensionNumbers dimension_numbers;
+  dimension_numbers.set_input_batch_dimension(0);
+  dimension_numbers.set_input_feature_dimension(num_spatial_dims + 1);
+  dimension_numbers.set_output_batch_dimension(0);
+  dimension_numbers.set_output_feature_dimension(num_spatial_dims + 1);
+  dimension_numbers.set_kernel_input_feature_dimension(num_spatial_dims);
+  dimension_numbers.set_kernel_output_feature_dimension(num_spatial_dims + 1);
+  for (int64_t spatial_dim = 0; spatial_dim < num_spatial_dims;
+       ++spatial_dim) {
+    dimension_numbers.add_input_spatial_dimensions(spatial_dim + 1);
+    dimension_numbers.add_output_spatial_dimensions(spatial_dim + 1);
+    dimension_numbers.add_kernel_spatial_dimensions(spatial_dim);
+  }
+  return dimension_numbers;
+}
+
 // Create a TF convolution metadata structure out of convolution attributes.
 tensorflow::ConvOpAttrs MakeConvOpAttrs(
     absl::Span<const int64_t> spatial_stride,
     absl::Span<const int64_t> spatial_padding,
-    absl::Span<const int64_t> spatial_dilation, bool depthwise) {
+    absl::Span<const int64_t> spatial_dilation, bool depthwise,
+    bool channels_last) {
   int num_spatial_dims = spatial_stride.size();
   XLA_CHECK_EQ(spatial_padding.size(), num_spatial_dims);
   XLA_CHECK_EQ(spatial_dilation.size(), num_spatial_dims);
@@ -140,7 +192,8 @@ tensorflow::ConvOpAttrs MakeConvOpAttrs(
     conv_op_attrs.explicit_paddings.push_back(spatial_padding[spatial_dim]);
   }
   conv_op_attrs.data_format = tensorflow::TensorFormat::FORMAT_NCHW;
-  return conv_op_attrs;
+  return channels_last ? ToChannelsLastConvOpAttrs(conv_op_attrs)
+                       : conv_op_attrs;
 }
 
 // Transpose filter shape to have [channel, batch] as last two dimensions.
@@ -207,12 +260,24 @@ xla::XlaOp BuildConvBackwardInput(xla::XlaOp grad_output, xla::XlaOp kernel,
                                   absl::Span<const int64_t> spatial_padding,
                                   absl::Span<const int64_t> spatial_dilation,
                                   int64_t groups) {
+  bool channels_last = UseChannelsLastConvolution();
   tensorflow::ConvOpAttrs conv_op_attrs =
-      MakeConvOpAttrs(spatial_stride, spatial_padding, spatial_dilation, false);
+      MakeConvOpAttrs(spatial_stride, spatial_padding, spatial_dilation, false,
+                      channels_last);
   xla::XlaOp kernel_transposed =
       xla::Transpose(kernel, FilterTransposePermutation(input_shape.rank()));
   xla::PrecisionConfig precision_config =
       XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  if (channels_last) {
+    int64_t rank = input_shape.rank();
+    xla::XlaOp grad_input = ConsumeValue(tensorflow::MakeXlaBackpropInputConvOp(
+        "conv_backward_input",
+        PermuteShape(input_shape, ChannelsLastPermutation(rank)),
+        kernel_transposed,
+        xla::Transpose(grad_output, ChannelsLastPermutation(rank)),
+        conv_op_attrs, &precision_config));
+    return xla::Transpose(grad_input, ChannelsFirstPermutation(rank));
+  }
   return ConsumeValue(tensorflow::MakeXlaBackpropInputConvOp(
       "conv_backward_input", input_shape, kernel_transposed, grad_output,
       conv_op_attrs, &precision_config));
@@ -224,8 +289,16 @@ xla::XlaOp BuildConvBackwardWeight(
     absl::Span<const int64_t> spatial_stride,
     absl::Span<const int64_t> spatial_padding,
     absl::Span<const int64_t> spatial_dilation, int64_t groups) {
+  bool channels_last = UseChannelsLastConvolution();
   tensorflow::ConvOpAttrs conv_op_attrs =
-      MakeConvOpAttrs(spatial_stride, spatial_padding, spatial_dilation, false);
+      MakeConvOpAttrs(spatial_stride, spatial_padding, spatial_dilation, false,
+                      channels_last);
+  if (channels_last) {
+    // The filter gradient comes out in the same format either way.
+    int64_t rank = kernel_shape.rank();
+    input = xla::Transpose(input, ChannelsLastPermutation(rank));
+    grad_output = xla::Transpose(grad_output, ChannelsLastPermutation(rank));
+  }
   auto inv_transpose_permutation =
       xla::InversePermutation(FilterTransposePermutation(kernel_shape.rank()));
   xla::Shape transposed_weight_shape = xla::ShapeUtil::PermuteDimensions(
@@ -254,6 +327,30 @@ xla::XlaOp BuildGradBias(xla::XlaOp grad_output) {
       BiasReduceDimensions(grad_output_shape.rank()));
 }
 
+// The features dimension of the activations of a TF convolution.
+int64_t TfConvFeatureDimension(tensorflow::TensorFormat data_format,
+                               int64_t rank) {
+  return data_format == tensorflow::FORMAT_NHWC ? rank - 1 : 1;
+}
+
+// Whether a TF convolution in the given format runs over channels last
+// activations instead.
+bool UseChannelsLastTfConv(tensorflow::TensorFormat data_format) {
+  return data_format == tensorflow::FORMAT_NCHW &&
+         UseChannelsLastConvolution();
+}
+
+xla::XlaOp BuildBiasActivation(xla::XlaOp conv, xla::XlaOp bias,
+                               ConvActivation activation,
+                               int64_t feature_dim) {
+  xla::XlaOp output = xla::Add(conv, bias, {feature_dim});
+  if (activation == ConvActivation::kRelu) {
+    output = xla::Max(
+        output, xla::Zero(conv.builder(), XlaHelpers::TypeOfXlaOp(conv)));
+  }
+  return output;
+}
+
 xla::XlaOp BuildTransposedConvolution(
     xla::XlaOp input, xla::XlaOp kernel, absl::Span<const int64_t> stride,
     absl::Span<const int64_t> padding, absl::Span<const int64_t> dilation,
@@ -308,6 +405,20 @@ xla::XlaOp BuildConvolutionOverrideable(
     auto dims_padding = MakePadding(padding);
     xla::PrecisionConfig precision_config =
         XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+    if (UseChannelsLastConvolution()) {
+      int64_t rank = stride.size() + 2;
+      xla::XlaOp conv = xla::ConvGeneralDilated(
+          xla::Transpose(input, ChannelsLastPermutation(rank)),
+          xla::Transpose(kernel, FilterTransposePermutation(rank)), stride,
+          dims_padding,
+          /*lhs_dilation*/ {},
+          /*rhs_dilation*/ dilation,
+          /*dimension_numbers*/
+          MakeChannelsLastConvDimensionNumbers(stride.size()),
+          /*feature_group_count*/ groups,
+          /*batch_group_count=*/1, &precision_config);
+      return xla::Transpose(conv, ChannelsFirstPermutation(rank));
+    }
     return xla::ConvGeneralDilated(
         input, kernel, stride, dims_padding,
         /*lhs_dilation*/ {},
@@ -357,4 +468,132 @@ ConvGrads BuildConvolutionBackwardOverrideable(
     return {grad_input, grad_weight, grad_bias};
   }
 }
+
+bool UseFusedConvEpilogue(DeviceType device_type) {
+  // Negative means the device type decides, zero and positive force the
+  // epilogue after and before the transpose respectively.
+  static const int fused_epilogue =
+      xla::sys_util::GetEnvInt("XLA_FUSED_CONV_EPILOGUE", -1);
+  if (fused_epilogue >= 0) {
+    return fused_epilogue > 0;
+  }
+  return device_type == DeviceType::GPU;
+}
+
+xla::XlaOp BuildTfConvBiasActivation(xla::XlaOp input, xla::XlaOp filter,
+                                     xla::XlaOp bias,
+                                     ConvActivation activation,
+                                     const tensorflow::ConvOpAttrs& attrs) {
+  int64_t rank = XlaHelpers::ShapeOfXlaOp(input).rank();
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  if (!UseChannelsLastTfConv(attrs.data_format)) {
+    xla::XlaOp conv = ConsumeValue(tensorflow::MakeXlaForwardConvOp(
+        /*type_string=*/"TfConvBiasActivation", /*conv_input=*/input,
+        /*filter=*/filter, /*attrs=*/attrs,
+        /*precision_config=*/&precision_config));
+    return BuildBiasActivation(
+        conv, bias, activation,
+        TfConvFeatureDimension(attrs.data_format, rank));
+  }
+  xla::XlaOp conv = ConsumeValue(tensorflow::MakeXlaForwardConvOp(
+      /*type_string=*/"TfConvBiasActivation",
+      /*conv_input=*/xla::Transpose(input, ChannelsLastPermutation(rank)),
+      /*filter=*/filter, /*attrs=*/ToChannelsLastConvOpAttrs(attrs),
+      /*precision_config=*/&precision_config));
+  if (UseFusedConvEpilogue(GetCurrentDevice().hw_type)) {
+    return xla::Transpose(BuildBiasActivation(conv, bias, activation, rank - 1),
+                          ChannelsFirstPermutation(rank));
+  }
+  return BuildBiasActivation(
+      xla::Transpose(conv, ChannelsFirstPermutation(rank)), bias, activation,
+      /*feature_dim=*/1);
+}
+
+ConvGrads BuildTfConvBiasActivationBackward(
+    xla::XlaOp grad_output, xla::XlaOp input, xla::XlaOp filter,
+    xla::XlaOp output, ConvActivation activation,
+    const tensorflow::ConvOpAttrs& attrs) {
+  xla::Shape input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::PrimitiveType type = input_shape.element_type();
+  int64_t rank = input_shape.rank();
+  xla::XlaOp grad = grad_output;
+  if (activation == ConvActivation::kRelu) {
+    // The output is positive exactly where the pre-activation result is.
+    grad = xla::Select(
+        xla::Gt(output, xla::Zero(output.builder(), type)), grad_output,
+        xla::Zeros(output.builder(), XlaHelpers::ShapeOfXlaOp(grad_output)));
+  }
+  std::vector<int64_t> reduce_dimensions;
+  int64_t feature_dim = TfConvFeatureDimension(attrs.data_format, rank);
+  for (int64_t dim = 0; dim < rank; ++dim) {
+    if (dim != feature_dim) {
+      reduce_dimensions.push_back(dim);
+    }
+  }
+  xla::XlaOp grad_bias =
+      xla::Reduce(grad, xla::Zero(grad.builder(), type),
+                  XlaHelpers::CreateAddComputation(type), reduce_dimensions);
+  tensorflow::ConvOpAttrs conv_attrs = attrs;
+  bool channels_last = UseChannelsLastTfConv(attrs.data_format);
+  if (channels_last) {
+    // Both gradients share the transposes to channels last.
+    std::vector<int64_t> permutation = ChannelsLastPermutation(rank);
+    input = xla::Transpose(input, permutation);
+    grad = xla::Transpose(grad, permutation);
+    input_shape = PermuteShape(input_shape, permutation);
+    conv_attrs = ToChannelsLastConvOpAttrs(attrs);
+  }
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  xla::XlaOp grad_input = ConsumeValue(tensorflow::MakeXlaBackpropInputConvOp(
+      /*type_string=*/"TfConvBiasActivationBackward",
+      /*input_shape=*/input_shape, /*filter=*/filter, /*out_backprop=*/grad,
+      /*attrs=*/conv_attrs, /*precision_config=*/&precision_config));
+  xla::XlaOp grad_filter =
+      ConsumeValue(tensorflow::MakeXlaBackpropFilterConvOp(
+          /*type_string=*/"TfConvBiasActivationBackward",
+          /*activations=*/input,
+          /*filter_shape=*/XlaHelpers::ShapeOfXlaOp(filter),
+          /*gradients=*/grad, /*attrs=*/conv_attrs,
+          /*precision_config=*/&precision_config));
+  if (channels_last) {
+    grad_input = xla::Transpose(grad_input, ChannelsFirstPermutation(rank));
+  }
+  return {grad_input, grad_filter, grad_bias};
+}
+
+std::vector<int64_t> ChannelsLastPermutation(int64_t rank) {
+  std::vector<int64_t> permutation = {0};
+  for (int64_t dim = 2; dim < rank; ++dim) {
+    permutation.push_back(dim);
+  }
+  permutation.push_back(1);
+  return permutation;
+}
+
+std::vector<int64_t> ChannelsFirstPermutation(int64_t rank) {
+  return xla::InversePermutation(ChannelsLastPermutation(rank));
+}
+
+tensorflow::ConvOpAttrs ToChannelsLastConvOpAttrs(
+    const tensorflow::ConvOpAttrs& attrs) {
+  XLA_CHECK_EQ(attrs.data_format, tensorflow::TensorFormat::FORMAT_NCHW);
+  // The per dimension attributes follow the dimension order of the data
+  // format, and the explicit paddings are only there for explicit padding.
+  std::vector<int64_t> permutation =
+      ChannelsLastPermutation(attrs.num_spatial_dims + 2);
+  tensorflow::ConvOpAttrs channels_last_attrs = attrs;
+  channels_last_attrs.dilations =
+      PermuteDimensionValues(attrs.dilations, permutation);
+  channels_last_attrs.strides =
+      PermuteDimensionValues(attrs.strides, permutation);
+  if (!attrs.explicit_paddings.empty()) {
+    channels_last_attrs.explicit_paddings =
+        PermuteDimensionValues(attrs.explicit_paddings, permutation);
+  }
+  channels_last_attrs.data_format = tensorflow::TensorFormat::FORMAT_NHWC;
+  return channels_last_attrs;
+}
+
 }  // namespace swift_xla
@@ -17,7 +17,9 @@
 #pragma once
 
 #include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/kernels/conv_op_helpers.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
 
 namespace swift_xla {
 
@@ -49,4 +51,40 @@ ConvGrads BuildConvolutionBackwardOverrideable(
     absl::Span<const int64_t> dilation, bool transposed,
     absl::Span<const int64_t> output_padding, int64_t groups);
 
+// The element-wise activation applied by BuildTfConvBiasActivation().
+enum class ConvActivation { kIdentity, kRelu };
+
+// Whether the bias and activation of the channels last convolutions of the
+// given device type apply before the result gets transposed back to channels
+// first, rather than after. That keeps them in the epilogue of the convolution,
+// which the GPU backend rewrites into a single cuDNN fused convolution custom
+// call, so that the pre-activation result never gets written out.
+bool UseFusedConvEpilogue(DeviceType device_type);
+
+// Computes the TF convolution of the given attributes, then adds the bias along
+// the output features and applies the activation.
+xla::XlaOp BuildTfConvBiasActivation(xla::XlaOp input, xla::XlaOp filter,
+                                     xla::XlaOp bias,
+                                     ConvActivation activation,
+                                     const tensorflow::ConvOpAttrs& attrs);
+
+// Computes the gradients of BuildTfConvBiasActivation(). The output of the
+// forward pass masks the gradient of the activation, so the pre-activation
+// result is not needed.
+ConvGrads BuildTfConvBiasActivationBackward(
+    xla::XlaOp grad_output, xla::XlaOp input, xla::XlaOp filter,
+    xla::XlaOp output, ConvActivation activation,
+    const tensorflow::ConvOpAttrs& attrs);
+
+// The permutations from channels first (N, C, spatial...) to channels last
+// (N, spatial..., C) dimensions, and back.
+std::vector<int64_t> ChannelsLastPermutation(int64_t rank);
+std::vector<int64_t> ChannelsFirstPermutation(int64_t rank);
+
+// Rewrites the attributes of a channels first convolution into the ones of the
+// same convolution over channels last activations. The filter format is the
+// same for both.
+tensorflow::ConvOpAttrs ToChannelsLastConvOpAttrs(
+    const tensorflow::ConvOpAttrs& attrs);
+
 }  // namespace swift_xla
@@ -16,18 +16,26 @@
 
 #include <map>
 
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/convert_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/layout_manager.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/reduction.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/token_handler.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/xla_lower_util.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 
 namespace swift_xla {
 namespace {
 
+thread_local const std::vector<std::string>* g_replication_devices = nullptr;
+
 struct PerTypeContext {
   std::vector<xla::XlaOp> ops;
   std::vector<size_t> indices;
@@ -95,49 +103,359 @@ std::vector<xla::ReplicaGroup> CreateReduceGroups(
   return reduce_groups;
 }
 
+int64_t GetAllReduceBucketBytes() {
+  static const int64_t bucket_bytes = xla::sys_util::GetEnvInt(
+      "XLA_ALL_REDUCE_BUCKET_SIZE", 25 * 1024 * 1024);
+  return bucket_bytes;
+}
+
+// Whether the buckets get reduced independently, rather than one after the
+// other, so that the XLA scheduler can start each reduction as soon as its
+// operands are computed, while the rest of the computation goes on.
+bool IsAllReduceOverlapEnabled() {
+  static const bool overlap =
+      xla::sys_util::GetEnvBool("XLA_ALL_REDUCE_OVERLAP", false);
+  return overlap;
+}
+
+// The replica groups of a two level reduction: the replicas of each host, and
+// the replicas with the same rank within their host, across the hosts.
+struct HierarchicalGroups {
+  int64_t local_size = 0;
+  std::vector<xla::ReplicaGroup> local_groups;
+  std::vector<xla::ReplicaGroup> cross_groups;
+};
+
+absl::optional<HierarchicalGroups> GetHierarchicalGroups(
+    const std::vector<std::vector<int64_t>>& groups) {
+  static const bool hierarchical =
+      xla::sys_util::GetEnvBool("XLA_HIERARCHICAL_ALL_REDUCE", false);
+  // Only the reductions across all the replicas get split, as the user
+  // defined groups might not follow the hosts.
+  if (!hierarchical || !groups.empty() || g_replication_devices == nullptr ||
+      g_replication_devices->size() < 2) {
+    return absl::nullopt;
+  }
+  std::map<int32_t, std::vector<int64_t>> host_replicas;
+  for (size_t i = 0; i < g_replication_devices->size(); ++i) {
+    int32_t host_id =
+        xla::GetX10Device((*g_replication_devices)[i])->host_id();
+    host_replicas[host_id].push_back(i);
+  }
+  size_t local_size = host_replicas.begin()->second.size();
+  if (host_replicas.size() < 2 || local_size < 2) {
+    return absl::nullopt;
+  }
+  for (auto& host_replica : host_replicas) {
+    if (host_replica.second.size() != local_size) {
+      TF_VLOG(2) << "Uneven replica counts across the hosts, using flat "
+                    "all-reduce";
+      return absl::nullopt;
+    }
+  }
+  HierarchicalGroups hierarchical_groups;
+  hierarchical_groups.local_size = local_size;
+  hierarchical_groups.cross_groups.resize(local_size);
+  for (auto& host_replica : host_replicas) {
+    xla::ReplicaGroup local_group;
+    for (size_t rank = 0; rank < local_size; ++rank) {
+      local_group.add_replica_ids(host_replica.second[rank]);
+      hierarchical_groups.cross_groups[rank].add_replica_ids(
+          host_replica.second[rank]);
+    }
+    hierarchical_groups.local_groups.push_back(std::move(local_group));
+  }
+  return hierarchical_groups;
+}
+
+// Reduces the rank 1 operand in three steps: a reduce-scatter within each host,
+// an all-reduce of the shards across the hosts, and an all-gather within each
+// host. Only a local_size-th of the operand goes through the links across the
+// hosts. Returns the reduced operand and the new token.
+std::pair<xla::XlaOp, xla::XlaOp> BuildHierarchicalAllReduce(
+    AllReduceType reduce_type, xla::XlaOp operand, xla::XlaOp token,
+    const HierarchicalGroups& hierarchical_groups) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(operand);
+  int64_t size = shape.dimensions(0);
+  int64_t local_size = hierarchical_groups.local_size;
+  // The reduce-scatter needs the operand to split evenly among the replicas
+  // of a host, and the padding gets dropped after the all-gather.
+  int64_t padded_size = (size + local_size - 1) / local_size * local_size;
+  TokenHandler token_handler(token);
+  xla::XlaOp input = token_handler.GetInput(operand, &shape);
+  if (padded_size != size) {
+    input = xla::PadInDim(
+        input, xla::Zero(input.builder(), shape.element_type()), 0, 0,
+        padded_size - size);
+  }
+  xla::XlaComputation computation =
+      GetReduceComutation(reduce_type, shape.element_type());
+  xla::XlaOp scattered =
+      xla::ReduceScatter(input, computation, /*scatter_dimension=*/0,
+                         local_size, hierarchical_groups.local_groups);
+  xla::XlaOp reduced = xla::AllReduce(scattered, computation,
+                                      hierarchical_groups.cross_groups);
+  xla::XlaOp result = xla::AllGather(reduced, /*all_gather_dimension=*/0,
+                                     local_size,
+                                     hierarchical_groups.local_groups);
+  if (padded_size != size) {
+    result = xla::SliceInDim(result, 0, size, 1, 0);
+  }
+  return {result, token_handler.GetNewToken(result)};
+}
+
+// A set of same typed operands reduced by a single all-reduce. The operands of
+// a flat bucket get packed into a rank 1 buffer before the reduction, and
+// unpacked after it.
+struct ReduceBucket {
+  std::vector<size_t> positions;
+  bool flat = false;
+};
+
+std::vector<ReduceBucket> CreateReduceBuckets(const PerTypeContext& ctx,
+                                              bool always_flat) {
+  int64_t bucket_bytes = GetAllReduceBucketBytes();
+  std::vector<ReduceBucket> buckets;
+  if (bucket_bytes <= 0) {
+    ReduceBucket bucket;
+    for (size_t i = 0; i < ctx.ops.size(); ++i) {
+      bucket.positions.push_back(i);
+    }
+    buckets.push_back(std::move(bucket));
+    return buckets;
+  }
+  ReduceBucket bucket;
+  int64_t bytes = 0;
+  auto flush = [&]() {
+    if (!bucket.positions.empty()) {
+      bucket.flat = always_flat || bucket.positions.size() > 1;
+      buckets.push_back(std::move(bucket));
+      bucket = ReduceBucket();
+    }
+    bytes = 0;
+  };
+  bool overlap = IsAllReduceOverlapEnabled();
+  for (size_t n = 0; n < ctx.operand_shapes.size(); ++n) {
+    // The gradients come last to first out of the backward pass, so when
+    // overlapping, the buckets which fill up first get reduced first.
+    size_t i = overlap ? ctx.operand_shapes.size() - 1 - n : n;
+    const xla::Shape& shape = ctx.operand_shapes[i];
+    if (shape.is_dynamic()) {
+      // The dynamic operands cannot be packed, so they get reduced on their
+      // own.
+      buckets.push_back(ReduceBucket{{i}, /*flat=*/false});
+      continue;
+    }
+    int64_t operand_bytes = xla::ShapeUtil::ByteSizeOf(shape);
+    if (bytes > 0 && bytes + operand_bytes > bucket_bytes) {
+      flush();
+    }
+    bucket.positions.push_back(i);
+    bytes += operand_bytes;
+  }
+  flush();
+  return buckets;
+}
+
+// Reduces the operands, plus the token converted to their type, with a single
+// tuple all-reduce. Returns the reduced operands followed by the new token.
+std::vector<xla::XlaOp> BuildTupleAllReduce(
+    AllReduceType reduce_type, xla::PrimitiveType type,
+    std::vector<xla::XlaOp> ops, std::vector<xla::Shape> operand_shapes,
+    xla::XlaOp token, const std::vector<xla::ReplicaGroup>& reduce_groups) {
+  xla::XlaOp token_op = MaybeConvertTo(token, type);
+  ops.push_back(token_op);
+  operand_shapes.push_back(XlaHelpers::ShapeOfXlaOp(token_op));
+  xla::XlaOp reduce = xla::AllReduce(
+      xla::Tuple(token.builder(), ops), GetReduceComutation(reduce_type, type),
+      reduce_groups, /*channel_id=*/absl::nullopt,
+      MakeReduceShape(operand_shapes));
+  std::vector<xla::XlaOp> results;
+  results.reserve(ops.size());
+  for (size_t i = 0; i < ops.size(); ++i) {
+    results.push_back(xla::GetTupleElement(reduce, i));
+  }
+  return results;
+}
+
+xla::XlaOp ScaleReduced(xla::XlaOp reduced, double scale) {
+  if (scale == 1.0) {
+    return reduced;
+  }
+  xla::XlaOp scaling_value = XlaHelpers::ScalarValue<float>(
+      scale, XlaHelpers::TypeOfXlaOp(reduced), reduced.builder());
+  return reduced * scaling_value;
+}
+
+// Returns the [tokens * k, 1] rows of the flattened [experts * capacity]
+// buffers the routed slots map to. The dropped slots map to the extra row past
+// the end of the buffers.
+xla::XlaOp MoeBufferRows(xla::XlaOp expert_indices, xla::XlaOp positions,
+                         int64_t num_experts, int64_t capacity) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(expert_indices);
+  xla::XlaBuilder* builder = expert_indices.builder();
+  xla::XlaOp capacity_op = XlaHelpers::ScalarValue<int32_t>(capacity, builder);
+  xla::XlaOp rows = xla::Add(xla::Mul(expert_indices, capacity_op), positions);
+  xla::XlaOp dropped_row = XlaHelpers::ScalarBroadcast<int32_t>(
+      num_experts * capacity, xla::PrimitiveType::S32, shape.dimensions(),
+      builder);
+  rows = xla::Select(xla::Lt(positions, capacity_op), rows, dropped_row);
+  return xla::Reshape(rows, {xla::ShapeUtil::ElementsIn(shape), 1});
+}
+
 }  // namespace
 
 std::vector<xla::XlaOp> BuildAllReduce(
     AllReduceType reduce_type, absl::Span<const xla::XlaOp> operands,
     xla::XlaOp token, double scale,
-    const std::vector<std::vector<int64_t>>& groups) {
+    const std::vector<std::vector<int64_t>>& groups,
+    AllReducePrecision precision) {
   std::vector<xla::ReplicaGroup> reduce_groups = CreateReduceGroups(groups);
   // TODO: We use pseudo-tokens ATM, which are real values. This need to be
   // switched to use the real XLA Token once support has been added to XLA
   // AllReduce().
+  bool overlap = IsAllReduceOverlapEnabled();
+  absl::optional<HierarchicalGroups> hierarchical_groups =
+      GetHierarchicalGroups(groups);
   xla::XlaOp chained_token = token;
+  // With overlap, all the buckets take the input token, and the output token
+  // depends on all of them. Since the tokens are numeric zeros, summing them
+  // yields a zero token.
+  xla::XlaOp overlap_token;
   ReduceContext redux = GetReduceContext(operands);
   std::vector<xla::XlaOp> result(operands.size());
   for (auto& type_ctx : redux.contexts) {
-    xla::XlaOp token_op = MaybeConvertTo(chained_token, type_ctx.first);
-    type_ctx.second.ops.push_back(token_op);
-    type_ctx.second.operand_shapes.push_back(
-        XlaHelpers::ShapeOfXlaOp(token_op));
-
-    xla::XlaOp reduce = xla::AllReduce(
-        xla::Tuple(operands[0].builder(), type_ctx.second.ops),
-        GetReduceComutation(reduce_type, type_ctx.first), reduce_groups,
-        /*channel_id=*/absl::nullopt,
-        MakeReduceShape(type_ctx.second.operand_shapes));
-    for (size_t i = 0; i < type_ctx.second.indices.size(); ++i) {
-      size_t op_idx = type_ctx.second.indices[i];
-      xla::XlaOp gte = xla::GetTupleElement(reduce, i);
-      if (scale != 1.0) {
-        xla::XlaOp scaling_value = XlaHelpers::ScalarValue<float>(
-            scale, type_ctx.second.operand_shapes[i].element_type(),
-            gte.builder());
-        gte = gte * scaling_value;
+    const PerTypeContext& ctx = type_ctx.second;
+    xla::PrimitiveType wire_type =
+        GetAllReduceWireType(type_ctx.first, precision);
+    for (const ReduceBucket& bucket :
+         CreateReduceBuckets(ctx, hierarchical_groups.has_value())) {
+      std::vector<xla::XlaOp> ops;
+      std::vector<xla::Shape> operand_shapes;
+      if (bucket.flat) {
+        // Pack the operands into a single rank 1 buffer, so that many small
+        // tensors cost one collective rather than one each.
+        std::vector<xla::XlaOp> flat_ops;
+        int64_t flat_size = 0;
+        for (size_t pos : bucket.positions) {
+          int64_t size = xla::ShapeUtil::ElementsIn(ctx.operand_shapes[pos]);
+          flat_ops.push_back(xla::Reshape(ctx.ops[pos], {size}));
+          flat_size += size;
+        }
+        ops.push_back(MaybeConvertTo(
+            xla::ConcatInDim(token.builder(), flat_ops, 0), wire_type));
+        operand_shapes.push_back(
+            xla::ShapeUtil::MakeShape(wire_type, {flat_size}));
+      } else {
+        for (size_t pos : bucket.positions) {
+          ops.push_back(MaybeConvertTo(ctx.ops[pos], wire_type));
+          operand_shapes.push_back(ctx.operand_shapes[pos]);
+          operand_shapes.back().set_element_type(wire_type);
+        }
+      }
+      xla::XlaOp bucket_token = overlap ? token : chained_token;
+      std::vector<xla::XlaOp> reduced;
+      if (bucket.flat && hierarchical_groups) {
+        std::pair<xla::XlaOp, xla::XlaOp> reduced_and_token =
+            BuildHierarchicalAllReduce(reduce_type, ops.front(), bucket_token,
+                                       *hierarchical_groups);
+        reduced = {reduced_and_token.first, reduced_and_token.second};
+      } else {
+        reduced = BuildTupleAllReduce(reduce_type, wire_type, std::move(ops),
+                                      std::move(operand_shapes), bucket_token,
+                                      reduce_groups);
+      }
+      if (bucket.flat) {
+        xla::XlaOp flat = ScaleReduced(
+            MaybeConvertTo(reduced.front(), type_ctx.first), scale);
+        int64_t offset = 0;
+        for (size_t pos : bucket.positions) {
+          const xla::Shape& shape = ctx.operand_shapes[pos];
+          int64_t size = xla::ShapeUtil::ElementsIn(shape);
+          result[ctx.indices[pos]] = xla::Reshape(
+              xla::SliceInDim(flat, offset, offset + size, 1, 0),
+              shape.dimensions());
+          offset += size;
+        }
+      } else {
+        for (size_t i = 0; i < bucket.positions.size(); ++i) {
+          result[ctx.indices[bucket.positions[i]]] =
+              ScaleReduced(MaybeConvertTo(reduced[i], type_ctx.first), scale);
+        }
+      }
+      if (overlap) {
+        xla::XlaOp reduced_token =
+            MaybeConvertTo(reduced.back(), XlaHelpers::TypeOfXlaOp(token));
+        overlap_token = overlap_token.valid() ? overlap_token + reduced_token
+                                              : reduced_token;
+      } else {
+        chained_token = reduced.back();
       }
-      result[op_idx] = gte;
     }
-    chained_token =
-        xla::GetTupleElement(reduce, type_ctx.second.indices.size());
+  }
+  if (overlap_token.valid()) {
+    chained_token = overlap_token;
   }
   result.push_back(
       MaybeConvertTo(chained_token, XlaHelpers::TypeOfXlaOp(token)));
   return result;
 }
 
+ReplicationDevicesScope::ReplicationDevicesScope(
+    absl::Span<const std::string> devices)
+    : devices_(devices.begin(), devices.end()),
+      previous_devices_(g_replication_devices) {
+  g_replication_devices = &devices_;
+}
+
+ReplicationDevicesScope::~ReplicationDevicesScope() {
+  g_replication_devices = previous_devices_;
+}
+
+xla::PrimitiveType GetAllReduceWireType(xla::PrimitiveType type,
+                                        AllReducePrecision precision) {
+  if (type != xla::PrimitiveType::F32 && type != xla::PrimitiveType::F64) {
+    return type;
+  }
+  switch (precision) {
+    case AllReducePrecision::kFull:
+      return type;
+    case AllReducePrecision::kBFloat16:
+      return xla::PrimitiveType::BF16;
+    case AllReducePrecision::kHalf:
+      return xla::PrimitiveType::F16;
+  }
+  XLA_ERROR() << "Invalid reduce precision: "
+              << xla::util::GetEnumValue(precision);
+}
+
+AllGatherResult BuildAllGather(
+    xla::XlaOp input, xla::XlaOp token, int64_t dim, int64_t shard_count,
+    const std::vector<std::vector<int64_t>>& groups) {
+  std::vector<xla::ReplicaGroup> reduce_groups = CreateReduceGroups(groups);
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  TokenHandler token_handler(token);
+  xla::XlaOp result =
+      xla::AllGather(token_handler.GetInput(input, &input_shape), dim,
+                     shard_count, reduce_groups);
+  return {result, token_handler.GetNewToken(result)};
+}
+
+ReduceScatterResult BuildReduceScatter(
+    AllReduceType reduce_type, xla::XlaOp input, xla::XlaOp token,
+    double scale, int64_t scatter_dim, int64_t shard_count,
+    const std::vector<std::vector<int64_t>>& groups) {
+  std::vector<xla::ReplicaGroup> reduce_groups = CreateReduceGroups(groups);
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  TokenHandler token_handler(token);
+  xla::XlaOp result = xla::ReduceScatter(
+      token_handler.GetInput(input, &input_shape),
+      GetReduceComutation(reduce_type, input_shape.element_type()),
+      scatter_dim, shard_count, reduce_groups);
+  xla::XlaOp new_token = token_handler.GetNewToken(result);
+  return {ScaleReduced(result, scale), new_token};
+}
+
 AllToAllResult BuildAllToAll(
     xla::XlaOp input, xla::XlaOp token, int64_t split_dimension,
     int64_t concat_dimension, int64_t split_count,
@@ -167,4 +485,112 @@ CollectivePermuteResult BuildCollectivePermute(
   return {result, token_handler.GetNewToken(result)};
 }
 
+MoeRoutingResult BuildMoeRouting(xla::XlaOp gates, int64_t k,
+                                 int64_t capacity) {
+  const xla::Shape& gates_shape = XlaHelpers::ShapeOfXlaOp(gates);
+  XLA_CHECK_EQ(gates_shape.rank(), 2)
+      << "The gates must be [tokens, experts]: " << gates_shape;
+  int64_t num_tokens = gates_shape.dimensions(0);
+  int64_t num_experts = gates_shape.dimensions(1);
+  xla::XlaBuilder* builder = gates.builder();
+  xla::XlaOp expert_indices = xla::ConvertElementType(
+      CreateTopK(gates, k, /*dim=*/1, /*largest=*/true, /*sorted=*/true)[1],
+      xla::PrimitiveType::S32);
+  // Counting, for every slot, the earlier slots routed to the same expert only
+  // takes [tokens * k, experts] integers, rather than the dense
+  // [tokens, experts, capacity] dispatch masks.
+  xla::XlaOp slots = xla::Reshape(xla::Transpose(expert_indices, {1, 0}),
+                                  {k * num_tokens});
+  xla::Shape one_hot_shape = xla::ShapeUtil::MakeShape(
+      xla::PrimitiveType::S32, {k * num_tokens, num_experts});
+  xla::XlaOp one_hot = xla::ConvertElementType(
+      xla::Eq(xla::Iota(builder, one_hot_shape, 1),
+              xla::BroadcastInDim(slots, one_hot_shape.dimensions(), {0})),
+      xla::PrimitiveType::S32);
+  xla::XlaOp zero = xla::Zero(builder, xla::PrimitiveType::S32);
+  xla::XlaComputation add =
+      XlaHelpers::CreateAddComputation(xla::PrimitiveType::S32);
+  xla::XlaOp preceding = BuildCumulativeComputation(
+      one_hot, /*dim=*/0, add, zero, /*exclusive=*/true, /*reverse=*/false);
+  xla::XlaOp positions =
+      xla::Reduce(xla::Mul(preceding, one_hot), zero, add, {1});
+  positions = xla::Min(positions,
+                       XlaHelpers::ScalarValue<int32_t>(capacity, builder));
+  positions =
+      xla::Transpose(xla::Reshape(positions, {k, num_tokens}), {1, 0});
+  return {expert_indices, positions};
+}
+
+AllToAllResult BuildMoeDispatch(
+    xla::XlaOp input, xla::XlaOp expert_indices, xla::XlaOp positions,
+    xla::XlaOp token, int64_t num_experts, int64_t capacity,
+    int64_t split_count, const std::vector<std::vector<int64_t>>& groups) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  const xla::Shape& indices_shape = XlaHelpers::ShapeOfXlaOp(expert_indices);
+  int64_t num_slots = xla::ShapeUtil::ElementsIn(indices_shape);
+  int64_t dim = input_shape.dimensions(input_shape.rank() - 1);
+  xla::XlaBuilder* builder = input.builder();
+  xla::XlaOp slot_rows = input;
+  if (input_shape.rank() == 2) {
+    slot_rows = xla::BroadcastInDim(
+        input,
+        {indices_shape.dimensions(0), indices_shape.dimensions(1), dim},
+        {0, 2});
+  }
+  slot_rows = xla::Reshape(slot_rows, {num_slots, dim});
+  xla::XlaOp buffers =
+      xla::Broadcast(xla::Zero(builder, input_shape.element_type()),
+                     {num_experts * capacity + 1, dim});
+  xla::ScatterDimensionNumbers dim_numbers;
+  dim_numbers.set_index_vector_dim(1);
+  dim_numbers.add_update_window_dims(1);
+  dim_numbers.add_inserted_window_dims(0);
+  dim_numbers.add_scatter_dims_to_operand_dims(0);
+  // The routed slots own distinct rows, only the dropped ones add up, into the
+  // extra row which gets sliced away.
+  buffers = xla::Scatter(
+      buffers,
+      MoeBufferRows(expert_indices, positions, num_experts, capacity),
+      slot_rows, XlaHelpers::CreateAddComputation(input_shape.element_type()),
+      dim_numbers);
+  buffers = xla::Reshape(
+      xla::SliceInDim(buffers, 0, num_experts * capacity, 1, 0),
+      {num_experts, capacity, dim});
+  return BuildAllToAll(buffers, token, /*split_dimension=*/0,
+                       /*concat_dimension=*/0, split_count, groups);
+}
+
+AllToAllResult BuildMoeCombine(
+    xla::XlaOp expert_outputs, xla::XlaOp expert_indices, xla::XlaOp positions,
+    xla::XlaOp token, int64_t split_count,
+    const std::vector<std::vector<int64_t>>& groups) {
+  const xla::Shape& outputs_shape = XlaHelpers::ShapeOfXlaOp(expert_outputs);
+  const xla::Shape& indices_shape = XlaHelpers::ShapeOfXlaOp(expert_indices);
+  int64_t num_experts = outputs_shape.dimensions(0);
+  int64_t capacity = outputs_shape.dimensions(1);
+  int64_t dim = outputs_shape.dimensions(2);
+  xla::XlaBuilder* builder = expert_outputs.builder();
+  // The block exchange of the dispatch is its own inverse.
+  AllToAllResult returned =
+      BuildAllToAll(expert_outputs, token, /*split_dimension=*/0,
+                    /*concat_dimension=*/0, split_count, groups);
+  xla::XlaOp rows = xla::ConcatInDim(
+      builder,
+      {xla::Reshape(returned.result, {num_experts * capacity, dim}),
+       xla::Broadcast(xla::Zero(builder, outputs_shape.element_type()),
+                      {1, dim})},
+      0);
+  xla::GatherDimensionNumbers dim_numbers;
+  dim_numbers.add_offset_dims(1);
+  dim_numbers.add_collapsed_slice_dims(0);
+  dim_numbers.add_start_index_map(0);
+  dim_numbers.set_index_vector_dim(1);
+  xla::XlaOp slot_rows = xla::Gather(
+      rows, MoeBufferRows(expert_indices, positions, num_experts, capacity),
+      dim_numbers, {1, dim});
+  return {xla::Reshape(slot_rows, {indices_shape.dimensions(0),
+                                   indices_shape.dimensions(1), dim}),
+          returned.token};
+}
+
 }  // namespace swift_xla
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include "absl/types/span.h"
@@ -32,19 +33,72 @@ enum class AllReduceType {
   kAnd,
 };
 
+// The precision the floating point operands of a reduction travel between the
+// replicas at. With a reduced precision, the wider operands get converted to
+// the narrower type before the reduction, and back after it, which halves the
+// bytes on the wire at the cost of summing in the narrower type.
+enum class AllReducePrecision {
+  kFull,
+  kBFloat16,
+  kHalf,
+};
+
 struct AllToAllResult {
   xla::XlaOp result;
   xla::XlaOp token;
 };
 
+struct AllGatherResult {
+  xla::XlaOp result;
+  xla::XlaOp token;
+};
+
+struct ReduceScatterResult {
+  xla::XlaOp result;
+  xla::XlaOp token;
+};
+
 struct CollectivePermuteResult {
   xla::XlaOp result;
   xla::XlaOp token;
 };
 
+struct MoeRoutingResult {
+  xla::XlaOp expert_indices;
+  xla::XlaOp positions;
+};
+
+// Sets, for its lifetime, the devices the replicas of the computations lowered
+// by the current thread run on. With XLA_HIERARCHICAL_ALL_REDUCE, the
+// all-reduce lowering uses them to map the replicas to their hosts.
+class ReplicationDevicesScope {
+ public:
+  explicit ReplicationDevicesScope(absl::Span<const std::string> devices);
+
+  ~ReplicationDevicesScope();
+
+ private:
+  std::vector<std::string> devices_;
+  const std::vector<std::string>* previous_devices_;
+};
+
 std::vector<xla::XlaOp> BuildAllReduce(
     AllReduceType reduce_type, absl::Span<const xla::XlaOp> operands,
     xla::XlaOp token, double scale,
+    const std::vector<std::vector<int64_t>>& groups,
+    AllReducePrecision precision = AllReducePrecision::kFull);
+
+// Returns the element type the operands of the given type get reduced as.
+xla::PrimitiveType GetAllReduceWireType(xla::PrimitiveType type,
+                                        AllReducePrecision precision);
+
+AllGatherResult BuildAllGather(
+    xla::XlaOp input, xla::XlaOp token, int64_t dim, int64_t shard_count,
+    const std::vector<std::vector<int64_t>>& groups);
+
+ReduceScatterResult BuildReduceScatter(
+    AllReduceType reduce_type, xla::XlaOp input, xla::XlaOp token,
+    double scale, int64_t scatter_dim, int64_t shard_count,
     const std::vector<std::vector<int64_t>>& groups);
 
 AllToAllResult BuildAllToAll(
@@ -56,4 +110,31 @@ CollectivePermuteResult BuildCollectivePermute(
     xla::XlaOp input, xla::XlaOp token,
     const std::vector<std::pair<int64_t, int64_t>>& source_target_pairs);
 
+// Routes each token of the [tokens, experts] gates to its top k experts, and
+// returns, as [tokens, k] S32 tensors, the experts and the positions of the
+// tokens within their buffers. The positions get assigned in the order of the
+// slots, first the top choices of all the tokens, then the second ones, and so
+// on, so that a full expert drops the lower choices first. The tokens which do
+// not fit within the capacity of their expert get the capacity as position.
+MoeRoutingResult BuildMoeRouting(xla::XlaOp gates, int64_t k,
+                                 int64_t capacity);
+
+// Scatters the [tokens, dim] (or [tokens, k, dim], one row per slot) input
+// into [experts, capacity, dim] buffers, at the routing positions, and sends
+// the buffers of each expert to the replica which holds it. The experts get
+// split evenly between the split_count replicas, and the result rows are
+// ordered by source replica, then by local expert.
+AllToAllResult BuildMoeDispatch(
+    xla::XlaOp input, xla::XlaOp expert_indices, xla::XlaOp positions,
+    xla::XlaOp token, int64_t num_experts, int64_t capacity,
+    int64_t split_count, const std::vector<std::vector<int64_t>>& groups);
+
+// The inverse of BuildMoeDispatch(): sends the [experts, capacity, dim] expert
+// outputs back to the replicas their tokens come from, and gathers them into
+// [tokens, k, dim] rows, which are zero for the dropped tokens.
+AllToAllResult BuildMoeCombine(
+    xla::XlaOp expert_outputs, xla::XlaOp expert_indices, xla::XlaOp positions,
+    xla::XlaOp token, int64_t split_count,
+    const std::vector<std::vector<int64_t>>& groups);
+
 }  // namespace swift_xla
@@ -18,12 +18,14 @@
 #include <functional>
 #include <numeric>
 
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/convert_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_autotuner.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/reduction.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
@@ -36,6 +38,17 @@ namespace {
 
 bool IsSparseGather(const xla::Shape& input_shape,
                     const xla::Shape& index_shape, int64_t dim) {
+  if (IsLoweringAutotuneEnabled()) {
+    auto make_gather = [dim](bool sparse) -> LoweringFn {
+      return [dim, sparse](absl::Span<const xla::XlaOp> operands) {
+        return xla::TorchGather(operands[0], operands[1], dim, sparse);
+      };
+    };
+    return ChooseFastestLowering(absl::StrCat("TorchGather", dim),
+                                 {input_shape, index_shape},
+                                 {make_gather(/*sparse=*/false),
+                                  make_gather(/*sparse=*/true)}) == 1;
+  }
   static int dense_gather_factor =
       xla::sys_util::GetEnvInt("XLA_DENSE_GATHER_FACTOR", 100);
   int64_t input_elements = xla::ShapeUtil::ElementsIn(input_shape);
@@ -14,21 +14,28 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/debug_util.h"
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <mutex>
 #include <sstream>
 #include <unordered_set>
 
 #include "absl/container/node_hash_set.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/graph_profiler.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_binary_dump.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_dump_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/swift_backtrace.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/unique.h"
+#include "tensorflow/compiler/xla/xla_client/xla_util.h"
 
 namespace swift_xla {
 namespace {
@@ -137,6 +144,107 @@ void DebugUtil::SaveTensorsGraphInfo(const char* name,
   }
 }
 
+void DebugUtil::SaveTensorsGraphBinary(const char* name,
+                                       absl::Span<const XLATensor> tensors,
+                                       const std::vector<size_t>* indices,
+                                       bool uncached_compile) {
+  static const std::string save_file =
+      xla::sys_util::GetEnvOrdinalPath("XLA_SAVE_TENSORS_BINARY_FILE", "");
+  if (save_file.empty()) {
+    return;
+  }
+  static const bool uncached_only =
+      xla::sys_util::GetEnvBool("XLA_SAVE_TENSORS_BINARY_UNCACHED", false);
+  static const int64_t every = std::max<int64_t>(
+      xla::sys_util::GetEnvInt("XLA_SAVE_TENSORS_BINARY_EVERY", 1), 1);
+  static std::atomic<int64_t>* count = new std::atomic<int64_t>(0);
+  static ir::BinaryGraphWriter* writer = new ir::BinaryGraphWriter(save_file);
+  if (uncached_compile != uncached_only || (*count)++ % every != 0) {
+    return;
+  }
+  std::vector<const ir::Node*> root_nodes;
+  std::vector<xla::hash_t> root_hashes;
+  auto add_root = [&](const XLATensor& tensor) {
+    ir::Value ir_value = tensor.CurrentIrValue();
+    if (ir_value) {
+      root_nodes.push_back(ir_value.node.get());
+      root_hashes.push_back(ir_value.hash());
+    }
+  };
+  if (indices != nullptr) {
+    for (auto index : *indices) {
+      add_root(tensors[index]);
+    }
+  } else {
+    for (auto& tensor : tensors) {
+      add_root(tensor);
+    }
+  }
+  if (!root_nodes.empty()) {
+    writer->Append(name, ir::Util::ComputePostOrder(root_nodes), root_nodes,
+                   root_hashes, uncached_compile);
+  }
+}
+
+std::string DebugUtil::GetGraphProfileReport(
+    const std::string& hlo_path_prefix) {
+  std::vector<GraphProfiler::Profile> profiles = GraphProfiler::GetProfiles();
+  int64_t now_ns = xla::sys_util::NowNs();
+  std::stringstream ss;
+  for (size_t i = 0; i < profiles.size(); ++i) {
+    const GraphProfiler::Profile& profile = profiles[i];
+    ss << "Graph: " << xla::util::HexHash(profile.hash) << std::endl;
+    ss << "  Rank: " << (i + 1) << std::endl;
+    ss << "  Device: " << profile.device << std::endl;
+    ss << "  Executions: " << profile.executions << std::endl;
+    ss << "  TotalTime: " << xla::metrics::MetricFnTime(profile.total_time_ns)
+       << std::endl;
+    ss << "  MeanTime: " << xla::metrics::MetricFnTime(profile.mean_time_ns)
+       << std::endl;
+    ss << "  P99Time: " << xla::metrics::MetricFnTime(profile.p99_time_ns)
+       << std::endl;
+    ss << "  CompileTime: "
+       << xla::metrics::MetricFnTime(profile.compile_time_ns) << std::endl;
+    ss << "  ArgumentBytes: "
+       << xla::metrics::MetricFnBytes(profile.argument_bytes) << std::endl;
+    ss << "  OutputBytes: "
+       << xla::metrics::MetricFnBytes(profile.output_bytes) << std::endl;
+    ss << "  LastUse: "
+       << xla::metrics::MetricFnTime(now_ns - profile.last_use_ns) << " ago"
+       << std::endl;
+    if (!hlo_path_prefix.empty()) {
+      ss << "  Hlo: " << hlo_path_prefix << "."
+         << xla::util::HexHash(profile.hash) << ".hlo" << std::endl;
+    }
+  }
+  return ss.str();
+}
+
+void DebugUtil::SaveGraphProfileReport() {
+  static const std::string save_file =
+      xla::sys_util::GetEnvOrdinalPath("XLA_SAVE_GRAPH_PROFILE_FILE", "");
+  if (save_file.empty()) {
+    return;
+  }
+  static std::mutex lock;
+  static absl::node_hash_set<xla::hash_t>* saved_hlos =
+      new absl::node_hash_set<xla::hash_t>();
+  std::lock_guard<std::mutex> guard(lock);
+  for (auto& profile : GraphProfiler::GetProfiles()) {
+    if (profile.computation == nullptr ||
+        !profile.computation->HasComputation() ||
+        !saved_hlos->insert(profile.hash).second) {
+      continue;
+    }
+    std::ofstream hlo_file(absl::StrCat(
+        save_file, ".", xla::util::HexHash(profile.hash), ".hlo"));
+    hlo_file << ConsumeValue(xla::util::GetComputationHloText(
+        profile.computation->computation()));
+  }
+  std::ofstream report_file(save_file);
+  report_file << GetGraphProfileReport(save_file);
+}
+
 bool DebugUtil::ExperimentEnabled(const std::string& name) {
   static const absl::node_hash_set<std::string>* xset = LoadExperiments();
   return xset->find(name) != xset->end();
@@ -50,6 +50,29 @@ class DebugUtil {
       const std::vector<size_t>* indices,
       GraphFormat format = GetDefaultGraphFormat());
 
+  // If the environment variable XLA_SAVE_TENSORS_BINARY_FILE is set to the
+  // proper output path, the IR graph is appended there in the compact binary
+  // format of ir::BinaryGraphWriter, on a background thread. Only one every
+  // XLA_SAVE_TENSORS_BINARY_EVERY graphs gets saved, and if
+  // XLA_SAVE_TENSORS_BINARY_UNCACHED is set, only the graphs of the uncached
+  // compiles (for which uncached_compile is true) are considered.
+  static void SaveTensorsGraphBinary(const char* name,
+                                     absl::Span<const XLATensor> tensors,
+                                     const std::vector<size_t>* indices,
+                                     bool uncached_compile = false);
+
+  // Returns the execution profiles of the computations run by the tensors graph
+  // syncs, ranked by total execution time. If hlo_path_prefix is not empty,
+  // each profile names the file with its HLO text, with that prefix.
+  static std::string GetGraphProfileReport(
+      const std::string& hlo_path_prefix = "");
+
+  // If the environment variable XLA_SAVE_GRAPH_PROFILE_FILE is set to the
+  // proper output path, the report returned by GetGraphProfileReport() is
+  // saved there, together with the HLO text of the computations not saved yet,
+  // in the $XLA_SAVE_GRAPH_PROFILE_FILE.HASH.hlo files.
+  static void SaveGraphProfileReport();
+
   static bool ExperimentEnabled(const std::string& name);
 };
 
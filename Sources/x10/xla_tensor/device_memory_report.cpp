@@ -0,0 +1,88 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/device_memory_report.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+
+namespace swift_xla {
+namespace {
+
+std::string BytesRepr(int64_t bytes) {
+  return bytes >= 0 ? xla::metrics::MetricFnBytes(bytes) : "unknown";
+}
+
+}  // namespace
+
+int64_t DeviceMemoryReport::tensor_bytes() const {
+  int64_t bytes = 0;
+  for (const TensorMemoryInfo& tensor : tensors) {
+    bytes += tensor.bytes;
+  }
+  return bytes;
+}
+
+std::string DeviceMemoryReport::ToString() const {
+  std::stringstream ss;
+  ss << "InUse: " << BytesRepr(device.bytes_in_use) << "\n";
+  ss << "PeakInUse: " << BytesRepr(device.peak_bytes_in_use) << "\n";
+  ss << "Limit: " << BytesRepr(device.bytes_limit) << "\n";
+  ss << "Cached: " << BytesRepr(device.bytes_cached) << "\n";
+  ss << "LiveTensors: " << tensors.size() << " ("
+     << BytesRepr(tensor_bytes()) << ")\n";
+  for (const TensorMemoryInfo& tensor : tensors) {
+    ss << "  Tensor " << tensor.tensor_id << ": "
+       << xla::ShapeUtil::HumanString(tensor.shape) << " "
+       << BytesRepr(tensor.bytes);
+    if (tensor.origin != nullptr && !tensor.origin->scope.empty()) {
+      ss << ", scope=" << tensor.origin->scope;
+    }
+    ss << "\n";
+    if (tensor.origin != nullptr && !tensor.origin->frame_info.empty()) {
+      ss << tensor.origin->frame_info;
+    }
+  }
+  return ss.str();
+}
+
+DeviceMemoryReport GetDeviceMemoryReport(const Device& device) {
+  DeviceMemoryReport report;
+  report.device = xla::GetX10Device(device)->GetMemoryInfo();
+  absl::flat_hash_set<const xla::ComputationClient::Data*> seen_data;
+  for (const XLATensor& tensor : XLATensor::GetLiveTensors(&device)) {
+    xla::ComputationClient::DataPtr xla_data = tensor.CurrentXlaData();
+    if (xla_data == nullptr || !seen_data.insert(xla_data.get()).second) {
+      continue;
+    }
+    TensorMemoryInfo info;
+    info.tensor_id = tensor.GetUniqueId();
+    info.shape = xla_data->shape();
+    info.bytes = xla::ShapeUtil::ByteSizeOf(info.shape, sizeof(void*));
+    info.origin = tensor.GetOrigin();
+    report.tensors.push_back(std::move(info));
+  }
+  std::stable_sort(report.tensors.begin(), report.tensors.end(),
+                   [](const TensorMemoryInfo& a, const TensorMemoryInfo& b) {
+                     return a.bytes > b.bytes;
+                   });
+  return report;
+}
+
+}  // namespace swift_xla
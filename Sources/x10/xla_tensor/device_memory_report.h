@@ -0,0 +1,54 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/xla/shape.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+
+namespace swift_xla {
+
+// Device memory held by a live tensor.
+struct TensorMemoryInfo {
+  int64_t tensor_id = 0;
+  xla::Shape shape;
+  int64_t bytes = 0;
+  // Where the device data of the tensor got computed, if known.
+  std::shared_ptr<const ir::MetaData> origin;
+};
+
+struct DeviceMemoryReport {
+  xla::ComputationClient::MemoryInfo device;
+  // The live tensors holding device data, the largest first. The tensors
+  // sharing their device data with a previous one are left out.
+  std::vector<TensorMemoryInfo> tensors;
+
+  int64_t tensor_bytes() const;
+
+  std::string ToString() const;
+};
+
+// Returns the memory usage of the device, with the live tensors holding it.
+DeviceMemoryReport GetDeviceMemoryReport(const Device& device);
+
+}  // namespace swift_xla
@@ -0,0 +1,174 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/frozen_graph.h"
+
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/inference_optimizer.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/device_data.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace {
+
+bool IsInferenceOptimizationEnabled() {
+  static const bool enabled =
+      xla::sys_util::GetEnvBool("XLA_FROZEN_GRAPH_OPTIMIZE", true);
+  return enabled;
+}
+
+}  // namespace
+
+std::shared_ptr<FrozenGraph> FrozenGraph::Create(
+    const std::vector<XLATensor>& inputs,
+    const std::vector<XLATensor>& outputs) {
+  XLA_CHECK(!outputs.empty()) << "A frozen graph needs at least one output";
+  Device device = outputs.front().GetDevice();
+  ir::RootLoweringContext lowering_ctx("FrozenGraph", device);
+  std::vector<xla::ComputationClient::DataPtr> inputs_data;
+  inputs_data.reserve(inputs.size());
+  // Declared first, so that the inputs are the leading parameters.
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    XLA_CHECK_EQ(inputs[i].GetDevice(), device)
+        << "Frozen graph input " << i << " lives on another device";
+    ir::Value ir_value = inputs[i].GetIrValue();
+    const ir::ops::DeviceData* device_data =
+        ir::ops::DeviceData::Cast(ir_value.node.get());
+    XLA_CHECK(device_data != nullptr)
+        << "Frozen graph input " << i
+        << " has a pending computation, instead of being device data";
+    lowering_ctx.GetParameter(device_data->data());
+    inputs_data.push_back(device_data->data());
+    XLA_CHECK_EQ(lowering_ctx.GetParametersData().size(), i + 1)
+        << "Frozen graph input " << i << " is passed more than once";
+  }
+  std::vector<ir::Value> output_values;
+  std::vector<c10::optional<at::ScalarType>> output_types;
+  output_values.reserve(outputs.size());
+  output_types.reserve(outputs.size());
+  for (const XLATensor& output : outputs) {
+    XLA_CHECK_EQ(output.GetDevice(), device)
+        << "The frozen graph outputs live on different devices";
+    output_values.push_back(output.GetIrValue());
+    output_types.push_back(output.dtype());
+  }
+  // The graph binds the device data of the host tensors it references.
+  XLATensor::FlushDeferredUploads(device);
+  if (IsInferenceOptimizationEnabled()) {
+    // The bound parameters never change, so whatever is computed from them
+    // alone is computed once here, instead of at every run.
+    output_values = OptimizeForInference(output_values, inputs_data, device);
+  }
+  for (const ir::Value& output_value : output_values) {
+    lowering_ctx.AddResult(lowering_ctx.GetOutputOp(output_value));
+  }
+  xla::XlaComputation computation = ConsumeValue(lowering_ctx.Build());
+  xla::ProgramShape program_shape = ConsumeValue(computation.GetProgramShape());
+  xla::Shape shape =
+      MakeShapeWithDeviceLayout(program_shape.result(), device.hw_type);
+  std::vector<xla::ComputationClient::CompileInstance> instances;
+  instances.push_back({std::move(computation), &shape});
+  std::vector<std::shared_ptr<xla::ComputationClient::Computation>>
+      computations =
+          xla::GetX10Device(device.ToString())
+              ->Compile(xla::ComputationClient::GetCompilationDevices(
+                            device.ToString(), {}),
+                        std::move(instances));
+  XLA_COUNTER("FrozenGraphCompile", 1);
+
+  const std::vector<xla::ComputationClient::DataPtr>& parameters_data =
+      lowering_ctx.GetParametersData();
+  std::vector<xla::Shape> input_shapes;
+  input_shapes.reserve(inputs.size());
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    input_shapes.push_back(parameters_data[i]->shape());
+  }
+  std::vector<xla::ComputationClient::DataPtr> bound_data(
+      parameters_data.begin() + inputs.size(), parameters_data.end());
+  for (const xla::ComputationClient::DataPtr& data : bound_data) {
+    XLATensor::FreezeDeviceData(data);
+  }
+  TF_VLOG(3) << "Frozen graph on device " << device << " with "
+             << inputs.size() << " inputs, " << bound_data.size()
+             << " bound parameters and " << outputs.size() << " outputs";
+  return std::shared_ptr<FrozenGraph>(new FrozenGraph(
+      std::move(device), std::move(computations.front()),
+      std::move(input_shapes), std::move(bound_data),
+      std::move(output_types)));
+}
+
+FrozenGraph::FrozenGraph(
+    Device device,
+    std::shared_ptr<xla::ComputationClient::Computation> computation,
+    std::vector<xla::Shape> input_shapes,
+    std::vector<xla::ComputationClient::DataPtr> bound_data,
+    std::vector<c10::optional<at::ScalarType>> output_types)
+    : device_(std::move(device)),
+      computation_(std::move(computation)),
+      input_shapes_(std::move(input_shapes)),
+      bound_data_(std::move(bound_data)),
+      output_types_(std::move(output_types)) {}
+
+std::vector<XLATensor> FrozenGraph::Run(std::vector<XLATensor>* inputs) const {
+  XLA_CHECK_EQ(inputs->size(), input_shapes_.size())
+      << "Wrong number of frozen graph inputs";
+  std::vector<xla::ComputationClient::DataPtr> arguments;
+  arguments.reserve(inputs->size() + bound_data_.size());
+  bool in_flight = false;
+  for (size_t i = 0; i < inputs->size(); ++i) {
+    XLATensor& input = (*inputs)[i];
+    XLA_CHECK_EQ(input.GetDevice(), device_)
+        << "Frozen graph input " << i << " lives on another device";
+    // Tensors with pending IR or host data get synced, while the device data
+    // still being computed is waited for below.
+    xla::ComputationClient::DataPtr data = input.CurrentXlaData();
+    if (data == nullptr) {
+      data = input.GetXlaData();
+    }
+    XLA_CHECK(xla::ShapeUtil::Compatible(data->shape(), input_shapes_[i]))
+        << "Frozen graph input " << i << " has shape " << data->shape()
+        << ", instead of " << input_shapes_[i];
+    in_flight = in_flight || !data->HasValue();
+    arguments.push_back(std::move(data));
+  }
+  for (const xla::ComputationClient::DataPtr& data : bound_data_) {
+    in_flight = in_flight || !data->HasValue();
+    arguments.push_back(data);
+  }
+  if (in_flight) {
+    // Some of the arguments are still being computed by an asynchronous sync.
+    XLATensor::WaitDeviceOps({device_.ToString()});
+  }
+  XLA_COUNTER("FrozenGraphRun", 1);
+  xla::ComputationClient::ExecuteComputationOptions options;
+  options.priority = XLATensor::GetExecutePriority();
+  std::vector<xla::ComputationClient::DataPtr> results =
+      xla::GetX10Device(device_)->ExecuteComputation(*computation_, arguments,
+                                                     options);
+  XLA_CHECK_EQ(results.size(), output_types_.size());
+  std::vector<XLATensor> outputs;
+  outputs.reserve(results.size());
+  for (size_t i = 0; i < results.size(); ++i) {
+    outputs.push_back(
+        XLATensor::Create(std::move(results[i]), output_types_[i]));
+  }
+  return outputs;
+}
+
+}  // namespace swift_xla
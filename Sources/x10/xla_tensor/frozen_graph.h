@@ -0,0 +1,75 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+#include "tensorflow/compiler/xla/shape.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+
+namespace swift_xla {
+
+// A traced graph compiled once, for serving. The device data the graph reads
+// besides its inputs (typically the weights of a model) get bound to it as
+// extra parameters, and frozen, so running the graph on new inputs goes
+// straight to the execution, without tracing, hashing or looking up the
+// computation cache. The random ops of the graph get the same seeds on every
+// run, as those are bound as well. Since the bound parameters never change, the
+// graph gets optimized for inference before its compilation (see
+// OptimizeForInference()).
+class FrozenGraph {
+ public:
+  // Freezes the graph computing the outputs from the inputs, which must be
+  // device data tensors, distinct and all on the device of the outputs.
+  static std::shared_ptr<FrozenGraph> Create(
+      const std::vector<XLATensor>& inputs,
+      const std::vector<XLATensor>& outputs);
+
+  // Runs the graph over inputs of the same shapes as the ones it was frozen
+  // with, and returns its outputs as device data tensors. The inputs which are
+  // not device data yet get synced first.
+  std::vector<XLATensor> Run(std::vector<XLATensor>* inputs) const;
+
+  size_t num_inputs() const { return input_shapes_.size(); }
+
+  // The device shape the input at index must have.
+  const xla::Shape& input_shape(size_t index) const {
+    return input_shapes_[index];
+  }
+
+  size_t num_outputs() const { return output_types_.size(); }
+
+  const Device& device() const { return device_; }
+
+ private:
+  FrozenGraph(Device device,
+              std::shared_ptr<xla::ComputationClient::Computation> computation,
+              std::vector<xla::Shape> input_shapes,
+              std::vector<xla::ComputationClient::DataPtr> bound_data,
+              std::vector<c10::optional<at::ScalarType>> output_types);
+
+  Device device_;
+  std::shared_ptr<xla::ComputationClient::Computation> computation_;
+  std::vector<xla::Shape> input_shapes_;
+  // The parameters following the inputs.
+  std::vector<xla::ComputationClient::DataPtr> bound_data_;
+  std::vector<c10::optional<at::ScalarType>> output_types_;
+};
+
+}  // namespace swift_xla
@@ -1,15 +1,24 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/function_call_tracker.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <fstream>
 #include <limits>
 #include <mutex>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
+#include "absl/container/node_hash_map.h"
 #include "absl/container/node_hash_set.h"
 #include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 #include "tensorflow/core/platform/stacktrace.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/swift_backtrace.h"
 
@@ -61,6 +70,121 @@ void LogFunction(TrackerContext* tctx, const char* tag) {
           << tensorflow::CurrentStackTrace() << "\n";
 }
 
+int64_t GetDispatchSampling() {
+  static int64_t sampling =
+      xla::sys_util::GetEnvInt("XLA_DISPATCH_PROFILE_SAMPLING", 0);
+  return sampling;
+}
+
+struct DispatchStats {
+  std::atomic<uint64_t> samples{0};
+  std::atomic<uint64_t> total_ns{0};
+  xla::metrics::HistogramData histogram;
+};
+
+// Holds the stats per entry point and per op kind. The lock only covers the
+// lookups, the stats themselves are recorded lock free.
+class DispatchProfiler {
+ public:
+  void Record(const char* entry_point, const char* op_kind, int64_t time_ns) {
+    Add(GetStats(&entry_points_, entry_point), time_ns);
+    if (op_kind != nullptr) {
+      Add(GetStats(&op_kinds_, op_kind), time_ns);
+    }
+  }
+
+  std::string Report(size_t max_entries) {
+    std::stringstream ss;
+    ss << "Host dispatch time per entry point (sampling one every "
+       << GetDispatchSampling() << " calls):
+";
+    ReportStats(&entry_points_, max_entries, &ss);
+    ss << "Host dispatch time per op kind:
+";
+    ReportStats(&op_kinds_, max_entries, &ss);
+    return ss.str();
+  }
+
+ private:
+  using StatsMap = absl::node_hash_map<std::string, DispatchStats>;
+
+  DispatchStats* GetStats(StatsMap* stats_map, const char* name) {
+    std::lock_guard<std::mutex> lock(lock_);
+    return &(*stats_map)[name];
+  }
+
+  static void Add(DispatchStats* stats, int64_t time_ns) {
+    stats->samples.fetch_add(1, std::memory_order_relaxed);
+    stats->total_ns.fetch_add(time_ns, std::memory_order_relaxed);
+    stats->histogram.AddValue(time_ns);
+  }
+
+  void ReportStats(StatsMap* stats_map, size_t max_entries,
+                   std::stringstream* ss) {
+    std::vector<std::pair<std::string, const DispatchStats*>> ranked;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      for (auto& name_stats : *stats_map) {
+        ranked.emplace_back(name_stats.first, &name_stats.second);
+      }
+    }
+    std::sort(ranked.begin(), ranked.end(),
+              [](const std::pair<std::string, const DispatchStats*>& a,
+                 const std::pair<std::string, const DispatchStats*>& b) {
+                return a.second->total_ns.load() > b.second->total_ns.load();
+              });
+    ranked.resize(std::min(ranked.size(), max_entries));
+    int64_t sampling = GetDispatchSampling();
+    for (auto& name_stats : ranked) {
+      const DispatchStats* stats = name_stats.second;
+      uint64_t samples = stats->samples.load();
+      uint64_t total_ns = stats->total_ns.load();
+      (*ss) << "  " << name_stats.first << ": calls~=" << samples * sampling
+            << " total~=" << total_ns * sampling / 1000
+            << "us mean=" << total_ns / std::max<uint64_t>(samples, 1)
+            << "ns p50=" << stats->histogram.Percentile(0.5)
+            << "ns p99=" << stats->histogram.Percentile(0.99) << "ns\n";
+    }
+  }
+
+  std::mutex lock_;
+  StatsMap entry_points_;
+  StatsMap op_kinds_;
+};
+
+DispatchProfiler* GetDispatchProfiler() {
+  static DispatchProfiler* profiler = new DispatchProfiler();
+  return profiler;
+}
+
+void WriteDispatchReport() {
+  std::string report = CreateDispatchReport(
+      xla::sys_util::GetEnvInt("XLA_DISPATCH_PROFILE_TOP", 20));
+  std::string path =
+      xla::sys_util::GetEnvString("XLA_DISPATCH_PROFILE_FILE", "");
+  if (path.empty()) {
+    TF_LOG(INFO) << report;
+    return;
+  }
+  std::ofstream file(path);
+  if (!file) {
+    TF_LOG(ERROR) << "Unable to write the dispatch profile file: " << path;
+    return;
+  }
+  file << report;
+}
+
+bool IsDispatchProfilingEnabled() {
+  static bool enabled = []() {
+    if (GetDispatchSampling() <= 0) {
+      return false;
+    }
+    std::atexit(WriteDispatchReport);
+    return true;
+  }();
+  return enabled;
+}
+
 }  // namespace
 
 void TrackFunction(const char* tag, int level) {
@@ -71,5 +195,26 @@ void TrackFunction(const char* tag, int level) {
   }
 }
 
+DispatchScope::DispatchScope(const char* entry_point, const char* op_kind)
+    : entry_point_(entry_point), op_kind_(op_kind) {
+  if (IsDispatchProfilingEnabled()) {
+    thread_local int64_t count = 0;
+    if (count++ % GetDispatchSampling() == 0) {
+      start_ns_ = xla::sys_util::NowNs();
+    }
+  }
+}
+
+DispatchScope::~DispatchScope() {
+  if (start_ns_ >= 0) {
+    GetDispatchProfiler()->Record(entry_point_, op_kind_,
+                                  xla::sys_util::NowNs() - start_ns_);
+  }
+}
+
+std::string CreateDispatchReport(size_t max_entries) {
+  return GetDispatchProfiler()->Report(max_entries);
+}
+
 }  // namespace fn_tracker
 }  // namespace swift_xla
@@ -1,12 +1,39 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
+
 namespace swift_xla {
 namespace fn_tracker {
 
 #define XLA_FN_TRACK(level) \
-  torch_xla::fn_tracker::TrackFunction(__FUNCTION__, level)
+  swift_xla::fn_tracker::TrackFunction(__FUNCTION__, level)
+
+// Profiles the host time of the enclosing op dispatch entry point.
+#define XLA_FN_PROFILE(op_kind)                          \
+  swift_xla::fn_tracker::DispatchScope __dispatch_scope( \
+      __FUNCTION__, op_kind)
 
 void TrackFunction(const char* tag, int level);
 
+// Times one every XLA_DISPATCH_PROFILE_SAMPLING calls per thread of the
+// entry point it is created within, and aggregates the host time per entry
+// point and per op kind. Does nothing if the sampling is zero (the default).
+class DispatchScope {
+ public:
+  DispatchScope(const char* entry_point, const char* op_kind);
+
+  ~DispatchScope();
+
+ private:
+  const char* entry_point_;
+  const char* op_kind_;
+  int64_t start_ns_ = -1;
+};
+
+// Returns the entry points and op kinds which took the most host time, with
+// their estimated call counts and percentiles, at most max_entries of each.
+std::string CreateDispatchReport(size_t max_entries);
+
 }  // namespace fn_tracker
 }  // namespace swift_xla
@@ -0,0 +1,147 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/graph_profiler.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/collective_profiler.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace swift_xla {
+namespace {
+
+struct ProfileData {
+  std::string device;
+  std::weak_ptr<xla::ComputationClient::Computation> computation;
+  int64_t compile_time_ns = 0;
+  int64_t argument_bytes = 0;
+  int64_t output_bytes = 0;
+  int64_t last_use_ns = 0;
+  std::shared_ptr<xla::metrics::MetricData> times;
+  std::shared_ptr<const std::vector<CollectiveInfo>> collectives;
+};
+
+struct ProfileRegistry {
+  std::mutex lock;
+  std::map<xla::hash_t, ProfileData> profiles;
+};
+
+ProfileRegistry* GetRegistry() {
+  static ProfileRegistry* registry = new ProfileRegistry();
+  return registry;
+}
+
+int64_t GetTotalBytes(absl::Span<const xla::ComputationClient::DataPtr> data) {
+  int64_t total_bytes = 0;
+  for (auto& item : data) {
+    if (item != nullptr) {
+      total_bytes += xla::ShapeUtil::ByteSizeOf(item->shape());
+    }
+  }
+  return total_bytes;
+}
+
+}  // namespace
+
+void GraphProfiler::RecordExecution(
+    const xla::hash_t& hash, const std::string& device,
+    const std::shared_ptr<xla::ComputationClient::Computation>& computation,
+    int64_t compile_time_ns,
+    absl::Span<const xla::ComputationClient::DataPtr> arguments,
+    absl::Span<const xla::ComputationClient::DataPtr> results,
+    int64_t start_ns, int64_t end_ns) {
+  static const size_t max_samples =
+      xla::sys_util::GetEnvInt("XLA_GRAPH_PROFILE_SAMPLES", 256);
+  std::shared_ptr<const std::vector<CollectiveInfo>> collectives;
+  {
+    ProfileRegistry* registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry->lock);
+    ProfileData& data = registry->profiles[hash];
+    if (data.times == nullptr) {
+      // The shapes of the parameters and results are part of the graph hash,
+      // so they only need to be measured once. Same for the collectives.
+      data.device = device;
+      data.argument_bytes = GetTotalBytes(arguments);
+      data.output_bytes = GetTotalBytes(results);
+      data.times = std::make_shared<xla::metrics::MetricData>(
+          xla::metrics::MetricFnTime, max_samples);
+      if (IsCollectiveProfilingEnabled()) {
+        data.collectives = std::make_shared<std::vector<CollectiveInfo>>(
+            GetCollectives(computation->computation().proto(),
+                           computation->devices().size()));
+      }
+    }
+    data.computation = computation;
+    data.compile_time_ns = compile_time_ns;
+    data.last_use_ns = end_ns;
+    data.times->AddSample(end_ns, end_ns - start_ns);
+    collectives = data.collectives;
+  }
+  if (collectives != nullptr && !collectives->empty()) {
+    RecordCollectiveExecution(*collectives, start_ns, end_ns);
+  }
+}
+
+std::vector<GraphProfiler::Profile> GraphProfiler::GetProfiles() {
+  std::vector<Profile> profiles;
+  {
+    ProfileRegistry* registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry->lock);
+    for (auto& hash_data : registry->profiles) {
+      const ProfileData& data = hash_data.second;
+      double total_time_ns = 0.0;
+      size_t executions = 0;
+      std::vector<xla::metrics::Sample> samples =
+          data.times->Samples(&total_time_ns, &executions);
+      std::sort(samples.begin(), samples.end(),
+                [](const xla::metrics::Sample& s1,
+                   const xla::metrics::Sample& s2) {
+                  return s1.value < s2.value;
+                });
+      Profile profile;
+      profile.hash = hash_data.first;
+      profile.device = data.device;
+      profile.executions = executions;
+      profile.total_time_ns = static_cast<int64_t>(total_time_ns);
+      profile.mean_time_ns = executions > 0 ? total_time_ns / executions : 0.0;
+      if (!samples.empty()) {
+        profile.p99_time_ns = samples[samples.size() * 99 / 100].value;
+      }
+      profile.compile_time_ns = data.compile_time_ns;
+      profile.argument_bytes = data.argument_bytes;
+      profile.output_bytes = data.output_bytes;
+      profile.last_use_ns = data.last_use_ns;
+      profile.computation = data.computation.lock();
+      profiles.push_back(std::move(profile));
+    }
+  }
+  std::stable_sort(profiles.begin(), profiles.end(),
+                   [](const Profile& p1, const Profile& p2) {
+                     return p1.total_time_ns > p2.total_time_ns;
+                   });
+  return profiles;
+}
+
+void GraphProfiler::Reset() {
+  ProfileRegistry* registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry->lock);
+  registry->profiles.clear();
+}
+
+}  // namespace swift_xla
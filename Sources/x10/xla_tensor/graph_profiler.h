@@ -0,0 +1,68 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/types.h"
+
+namespace swift_xla {
+
+// Keeps execution statistics for each of the computations run by the tensors
+// graph sync operations, keyed by their graph hash, which is also the name of
+// their HLO within the XLA_RECORD_COMPILE_MANIFEST folder.
+class GraphProfiler {
+ public:
+  struct Profile {
+    xla::hash_t hash;
+    std::string device;
+    size_t executions = 0;
+    int64_t total_time_ns = 0;
+    double mean_time_ns = 0.0;
+    // Computed over the most recent executions only.
+    double p99_time_ns = 0.0;
+    int64_t compile_time_ns = 0;
+    int64_t argument_bytes = 0;
+    int64_t output_bytes = 0;
+    // EPOCH time of the last execution, in nanoseconds.
+    int64_t last_use_ns = 0;
+    // The computation, unless it has been dropped by the computation caches.
+    std::shared_ptr<xla::ComputationClient::Computation> computation;
+  };
+
+  // Records an execution of the computation, which took place between start_ns
+  // and end_ns.
+  static void RecordExecution(
+      const xla::hash_t& hash, const std::string& device,
+      const std::shared_ptr<xla::ComputationClient::Computation>& computation,
+      int64_t compile_time_ns,
+      absl::Span<const xla::ComputationClient::DataPtr> arguments,
+      absl::Span<const xla::ComputationClient::DataPtr> results,
+      int64_t start_ns, int64_t end_ns);
+
+  // Returns the profiles of all the executed computations, ranked by total
+  // execution time.
+  static std::vector<Profile> GetProfiles();
+
+  static void Reset();
+};
+
+}  // namespace swift_xla
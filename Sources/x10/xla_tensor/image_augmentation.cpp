@@ -0,0 +1,204 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/image_augmentation.h"
+
+#include <cmath>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/random.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+
+namespace swift_xla {
+namespace {
+
+// The columns of the [N, kNumDraws] uniform draws, one row per image.
+enum RandomDraw {
+  kArea,
+  kAspectRatio,
+  kTop,
+  kLeft,
+  kFlip,
+  kBrightness,
+  kContrast,
+  kSaturation,
+  kNumDraws,
+};
+
+xla::XlaOp ScalarF32(float value, xla::XlaBuilder* builder) {
+  return XlaHelpers::ScalarValue<float>(value, xla::PrimitiveType::F32,
+                                        builder);
+}
+
+// Maps the draws in [0, 1) into [low, high).
+xla::XlaOp Lerp(xla::XlaOp draw, float low, float high) {
+  xla::XlaBuilder* builder = draw.builder();
+  return ScalarF32(low, builder) + draw * ScalarF32(high - low, builder);
+}
+
+// Draws the [N, kNumDraws] values of the images from the two seeds, in the
+// way of the stateless random ops.
+xla::XlaOp DrawUniform(xla::XlaOp seeds, int64_t num_images) {
+  xla::XlaBuilder* builder = seeds.builder();
+  xla::XlaOp seed0 = xla::Reshape(xla::Slice(seeds, {0}, {1}, {1}), {});
+  xla::XlaOp seed1 = xla::Reshape(xla::Slice(seeds, {1}, {2}, {1}), {});
+  xla::XlaOp key =
+      xla::ConvertElementType(seed0, xla::PrimitiveType::U64) |
+      xla::ShiftLeft(
+          xla::ConvertElementType(seed1, xla::PrimitiveType::U64),
+          xla::ConstantR0WithType(builder, xla::PrimitiveType::U64, 32));
+  return RngUniform(
+      key,
+      xla::ShapeUtil::MakeShape(xla::PrimitiveType::F32,
+                                {num_images, kNumDraws}),
+      xla::Zero(builder, xla::PrimitiveType::F32),
+      xla::One(builder, xla::PrimitiveType::F32));
+}
+
+xla::XlaOp Draw(xla::XlaOp draws, RandomDraw column) {
+  int64_t num_images = XlaHelpers::SizesOfXlaOp(draws)[0];
+  return xla::Reshape(xla::SliceInDim(draws, column, column + 1, 1, 1),
+                      {num_images});
+}
+
+// Returns the [N, output_size, input_size] bilinear interpolation matrices
+// which sample the [start, start + size) input range of every image at the
+// output positions, with half pixel centers, and in reverse order for the
+// flipped images when flipped is valid.
+xla::XlaOp InterpolationMatrix(xla::XlaOp start, xla::XlaOp size,
+                               int64_t input_size, int64_t output_size,
+                               xla::XlaOp flipped) {
+  xla::XlaBuilder* builder = start.builder();
+  int64_t num_images = XlaHelpers::SizesOfXlaOp(start)[0];
+  xla::Shape shape = xla::ShapeUtil::MakeShape(
+      xla::PrimitiveType::F32, {num_images, output_size, input_size});
+  xla::XlaOp output_position = xla::Iota(builder, shape, 1);
+  if (flipped.valid()) {
+    output_position =
+        xla::Select(xla::BroadcastInDim(flipped, shape.dimensions(), {0}),
+                    ScalarF32(output_size - 1, builder) - output_position,
+                    output_position);
+  }
+  xla::XlaOp scale = size / ScalarF32(output_size, builder);
+  xla::XlaOp coordinate = xla::Add(
+      xla::Mul(output_position + ScalarF32(0.5, builder), scale, {0}),
+      start - ScalarF32(0.5, builder), {0});
+  coordinate = xla::Clamp(ScalarF32(0, builder), coordinate,
+                          ScalarF32(input_size - 1, builder));
+  xla::XlaOp distance = xla::Abs(coordinate - xla::Iota(builder, shape, 2));
+  return xla::Max(ScalarF32(0, builder), ScalarF32(1, builder) - distance);
+}
+
+// Batched matmul over the leading dimension, contracting lhs_dim of lhs with
+// rhs_dim of rhs.
+xla::XlaOp BatchDot(xla::XlaOp lhs, int64_t lhs_dim, xla::XlaOp rhs,
+                    int64_t rhs_dim) {
+  xla::DotDimensionNumbers dimension_numbers;
+  dimension_numbers.add_lhs_batch_dimensions(0);
+  dimension_numbers.add_rhs_batch_dimensions(0);
+  dimension_numbers.add_lhs_contracting_dimensions(lhs_dim);
+  dimension_numbers.add_rhs_contracting_dimensions(rhs_dim);
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  return xla::DotGeneral(lhs, rhs, dimension_numbers, &precision_config);
+}
+
+}  // namespace
+
+xla::XlaOp BuildAugmentImages(xla::XlaOp images, xla::XlaOp seeds,
+                              absl::Span<const int64_t> output_size,
+                              float min_area, float max_area,
+                              float min_aspect_ratio, float max_aspect_ratio,
+                              bool flip, float brightness, float contrast,
+                              float saturation) {
+  xla::XlaBuilder* builder = images.builder();
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(images);
+  XLA_CHECK_EQ(shape.rank(), 4) << shape;
+  XLA_CHECK_EQ(output_size.size(), 2);
+  XLA_CHECK(0 < min_area && min_area <= max_area && max_area <= 1)
+      << "Invalid crop area range: [" << min_area << ", " << max_area << "]";
+  XLA_CHECK(0 < min_aspect_ratio && min_aspect_ratio <= max_aspect_ratio)
+      << "Invalid aspect ratio range: [" << min_aspect_ratio << ", "
+      << max_aspect_ratio << "]";
+  int64_t num_images = shape.dimensions(0);
+  int64_t height = shape.dimensions(1);
+  int64_t width = shape.dimensions(2);
+  int64_t channels = shape.dimensions(3);
+
+  xla::XlaOp pixels =
+      xla::ConvertElementType(images, xla::PrimitiveType::F32);
+  if (!xla::primitive_util::IsFloatingPointType(shape.element_type())) {
+    pixels = pixels * ScalarF32(1.0f / 255, builder);
+  }
+  xla::XlaOp draws = DrawUniform(seeds, num_images);
+
+  // A crop of the drawn area and aspect ratio, shrunk to fit in the image.
+  xla::XlaOp area = Lerp(Draw(draws, kArea), min_area, max_area) *
+                    ScalarF32(height * width, builder);
+  xla::XlaOp aspect_ratio =
+      xla::Exp(Lerp(Draw(draws, kAspectRatio), std::log(min_aspect_ratio),
+                    std::log(max_aspect_ratio)));
+  xla::XlaOp crop_height =
+      xla::Min(xla::Sqrt(area / aspect_ratio), ScalarF32(height, builder));
+  xla::XlaOp crop_width =
+      xla::Min(xla::Sqrt(area * aspect_ratio), ScalarF32(width, builder));
+  xla::XlaOp top =
+      Draw(draws, kTop) * (ScalarF32(height, builder) - crop_height);
+  xla::XlaOp left =
+      Draw(draws, kLeft) * (ScalarF32(width, builder) - crop_width);
+  xla::XlaOp flipped =
+      flip ? xla::Lt(Draw(draws, kFlip), ScalarF32(0.5, builder))
+           : xla::XlaOp();
+  xla::XlaOp rows = InterpolationMatrix(top, crop_height, height,
+                                        output_size[0], xla::XlaOp());
+  xla::XlaOp columns =
+      InterpolationMatrix(left, crop_width, width, output_size[1], flipped);
+  // [N, OH, H] x [N, H, W, C] -> [N, OH, W, C] x [N, OW, W] -> [N, OH, C, OW]
+  pixels = BatchDot(BatchDot(rows, 2, pixels, 1), 2, columns, 2);
+  pixels = xla::Transpose(pixels, {0, 1, 3, 2});
+
+  // The color transforms are elementwise, and fuse with the transpose.
+  if (brightness > 0) {
+    pixels = xla::Add(
+        pixels, Lerp(Draw(draws, kBrightness), -brightness, brightness), {0});
+  }
+  if (contrast > 0) {
+    xla::XlaOp mean =
+        xla::Reduce(pixels, ScalarF32(0, builder),
+                    XlaHelpers::CreateAddComputation(xla::PrimitiveType::F32),
+                    {1, 2, 3}) /
+        ScalarF32(output_size[0] * output_size[1] * channels, builder);
+    xla::XlaOp factor =
+        Lerp(Draw(draws, kContrast), 1 - contrast, 1 + contrast);
+    pixels = xla::Add(xla::Mul(xla::Sub(pixels, mean, {0}), factor, {0}),
+                      mean, {0});
+  }
+  if (saturation > 0 && channels == 3) {
+    xla::XlaOp luma = xla::ConstantR1<float>(builder, {0.299f, 0.587f, 0.114f});
+    xla::XlaOp gray =
+        xla::Reduce(xla::Mul(pixels, luma, {3}), ScalarF32(0, builder),
+                    XlaHelpers::CreateAddComputation(xla::PrimitiveType::F32),
+                    {3});
+    xla::XlaOp factor =
+        Lerp(Draw(draws, kSaturation), 1 - saturation, 1 + saturation);
+    pixels = xla::Add(
+        xla::Mul(xla::Sub(pixels, gray, {0, 1, 2}), factor, {0}), gray,
+        {0, 1, 2});
+  }
+  return xla::Clamp(ScalarF32(0, builder), pixels, ScalarF32(1, builder));
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,41 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+
+namespace swift_xla {
+
+// Augments the [N, H, W, C] batch of images, integers in [0, 255] or floating
+// point in [0, 1], into the F32 [N, output_size[0], output_size[1], C] batch,
+// in [0, 1]. Every image gets its own random crop, of an area fraction in
+// [min_area, max_area] and of an aspect ratio in [min_aspect_ratio,
+// max_aspect_ratio], bilinearly resized to the output size, mirrored half of
+// the time when flip is set, then its brightness, contrast and, with three
+// channels, saturation jittered by factors drawn from 1 -/+ the given amounts.
+// The crops and resizes of the images are interpolation matrices applied by
+// two batched dots, so that the whole batch takes static shapes, and the draws
+// come from the stateless RNG keyed by the two seeds.
+xla::XlaOp BuildAugmentImages(xla::XlaOp images, xla::XlaOp seeds,
+                              absl::Span<const int64_t> output_size,
+                              float min_area, float max_area,
+                              float min_aspect_ratio, float max_aspect_ratio,
+                              bool flip, float brightness, float contrast,
+                              float saturation);
+
+}  // namespace swift_xla
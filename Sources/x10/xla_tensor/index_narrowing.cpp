@@ -0,0 +1,159 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/index_narrowing.h"
+
+#include <limits>
+
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/cast.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/constant.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/scalar.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace swift_xla {
+namespace {
+
+// The bounds of the values of an integer tensor.
+struct ValueRange {
+  int64_t min = 0;
+  int64_t max = 0;
+};
+
+// Casts and constants are looked through up to this depth.
+constexpr int kMaxDepth = 8;
+
+// The literals of more elements are not scanned for their range.
+constexpr int64_t kMaxScannedElements = 1 << 16;
+
+template <typename T>
+ValueRange RangeOf() {
+  return {std::numeric_limits<T>::min(), std::numeric_limits<T>::max()};
+}
+
+absl::optional<ValueRange> TypeRange(xla::PrimitiveType type) {
+  switch (type) {
+    case xla::PrimitiveType::PRED:
+      return ValueRange{0, 1};
+    case xla::PrimitiveType::S8:
+      return RangeOf<int8_t>();
+    case xla::PrimitiveType::U8:
+      return RangeOf<uint8_t>();
+    case xla::PrimitiveType::S16:
+      return RangeOf<int16_t>();
+    case xla::PrimitiveType::U16:
+      return RangeOf<uint16_t>();
+    case xla::PrimitiveType::S32:
+      return RangeOf<int32_t>();
+    case xla::PrimitiveType::U32:
+      return RangeOf<uint32_t>();
+    default:
+      return absl::nullopt;
+  }
+}
+
+absl::optional<ValueRange> LiteralRange(const xla::Literal& literal) {
+  if (literal.shape().element_type() != xla::PrimitiveType::S64 ||
+      xla::ShapeUtil::ElementsIn(literal.shape()) > kMaxScannedElements) {
+    return absl::nullopt;
+  }
+  absl::Span<const int64_t> values = literal.data<int64_t>();
+  if (values.empty()) {
+    return ValueRange{};
+  }
+  ValueRange range{values[0], values[0]};
+  for (int64_t value : values) {
+    range.min = std::min(range.min, value);
+    range.max = std::max(range.max, value);
+  }
+  return range;
+}
+
+// The indices into a tensor of the operand shape, along any dimension or into
+// its flattened elements.
+ValueRange PositionRange(const xla::Shape& shape) {
+  return {0, std::max<int64_t>(xla::ShapeUtil::ElementsIn(shape) - 1, 0)};
+}
+
+absl::optional<ValueRange> ComputeRange(const ir::Output& output,
+                                        int depth) {
+  xla::PrimitiveType type = output.shape().element_type();
+  if (!xla::primitive_util::IsIntegralType(type)) {
+    return absl::nullopt;
+  }
+  absl::optional<ValueRange> type_range = TypeRange(type);
+  if (type_range || depth == 0) {
+    return type_range;
+  }
+  const ir::Node* node = output.node;
+  if (node->op() == *ir::ops::xla_cast) {
+    // Integer to integer casts which widen keep the values.
+    const ir::Output& input = node->operand(0);
+    xla::PrimitiveType input_type = input.shape().element_type();
+    if (xla::primitive_util::IsIntegralType(input_type) &&
+        xla::primitive_util::BitWidth(input_type) <=
+            xla::primitive_util::BitWidth(type)) {
+      return ComputeRange(input, depth - 1);
+    }
+    return absl::nullopt;
+  }
+  if (node->op() == ir::OpKind(at::aten::argmax) ||
+      node->op() == ir::OpKind(at::aten::argmin)) {
+    return PositionRange(node->operand(0).shape());
+  }
+  if (node->op() == ir::OpKind(at::aten::topk) && output.index == 1) {
+    return PositionRange(node->operand(0).shape());
+  }
+  if (node->op() == ir::OpKind(at::prim::Constant)) {
+    if (auto scalar = dynamic_cast<const ir::ops::Scalar*>(node)) {
+      int64_t value = scalar->value().toLong();
+      return ValueRange{value, value};
+    }
+    if (auto constant = dynamic_cast<const ir::ops::Constant*>(node)) {
+      return LiteralRange(constant->value());
+    }
+  }
+  return absl::nullopt;
+}
+
+bool FitsInInt32(const ValueRange& range) {
+  return range.min >= std::numeric_limits<int32_t>::min() &&
+         range.max <= std::numeric_limits<int32_t>::max();
+}
+
+}  // namespace
+
+ir::Value NarrowIndices(const ir::Value& indices) {
+  static const bool narrow_indices =
+      xla::sys_util::GetEnvBool("XLA_NARROW_INDICES", true);
+  xla::PrimitiveType type = indices.shape().element_type();
+  if (!narrow_indices || (type != xla::PrimitiveType::S64 &&
+                          type != xla::PrimitiveType::U64)) {
+    return indices;
+  }
+  absl::optional<ValueRange> range = ComputeRange(indices, kMaxDepth);
+  if (!range || !FitsInInt32(*range)) {
+    return indices;
+  }
+  XLA_COUNTER("NarrowedIndices", 1);
+  // The casts from int32 are folded by XLA with the one narrowing them back,
+  // so indices which were widened from int32 reach the gather untouched.
+  return ir::MakeNode<ir::ops::Cast>(indices, xla::PrimitiveType::S32);
+}
+
+}  // namespace swift_xla
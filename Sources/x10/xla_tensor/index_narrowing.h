@@ -0,0 +1,31 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+
+// Returns the indices of a gather, scatter or segment reduction narrowed to
+// int32 when the IR producing them proves that their values fit, like the
+// results of argmax, argmin and topk, or int64 casts of narrower integers.
+// Int64 arithmetic is emulated on TPU, and this recovers most of the speed of
+// XLA_USE_32BIT_LONG without touching the tensors which need 64 bits. Returns
+// indices unchanged otherwise, or if XLA_NARROW_INDICES is disabled.
+ir::Value NarrowIndices(const ir::Value& indices);
+
+}  // namespace swift_xla
@@ -0,0 +1,355 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/inference_optimizer.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/device_data.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace {
+
+struct GraphInfo {
+  std::vector<const ir::Node*> post_order;
+  absl::flat_hash_map<const ir::Node*, ir::NodePtr> node_ptrs;
+  // The number of operand (and root) references to each node.
+  absl::flat_hash_map<const ir::Node*, size_t> uses;
+  // The nodes computed from literals and bound device data only.
+  absl::flat_hash_set<const ir::Node*> constants;
+  // The constants which depend on bound device data.
+  absl::flat_hash_set<const ir::Node*> bound;
+
+  bool IsConstant(const ir::Node* node) const {
+    return constants.count(node) > 0;
+  }
+
+  ir::Value ValueOf(const ir::Output& output) const {
+    return ir::Value(node_ptrs.at(output.node), output.index);
+  }
+};
+
+GraphInfo AnalyzeGraph(
+    absl::Span<const ir::Value> roots,
+    absl::Span<const xla::ComputationClient::DataPtr> inputs) {
+  absl::flat_hash_set<const xla::ComputationClient::Data*> input_data;
+  for (const xla::ComputationClient::DataPtr& data : inputs) {
+    input_data.insert(data.get());
+  }
+  GraphInfo info;
+  std::vector<const ir::Node*> root_nodes;
+  for (const ir::Value& root : roots) {
+    root_nodes.push_back(root.node.get());
+    info.node_ptrs.emplace(root.node.get(), root.node);
+    info.uses[root.node.get()] += 1;
+  }
+  info.post_order = ir::Util::ComputePostOrder(root_nodes);
+  for (const ir::Node* node : info.post_order) {
+    for (const ir::NodePtr& operand : node->operand_nodes()) {
+      info.node_ptrs.emplace(operand.get(), operand);
+      info.uses[operand.get()] += 1;
+    }
+    const ir::ops::DeviceData* device_data = ir::ops::DeviceData::Cast(node);
+    if (device_data != nullptr) {
+      if (input_data.count(device_data->data().get()) == 0) {
+        info.constants.insert(node);
+        info.bound.insert(node);
+      }
+      continue;
+    }
+    if (node->operands().empty()) {
+      // Other leaves, like tokens and replica ids, are not constants.
+      if (node->op() == ir::OpKind(at::prim::Constant)) {
+        info.constants.insert(node);
+      }
+      continue;
+    }
+    bool constant = true;
+    bool bound = false;
+    for (const ir::Output& operand : node->operands()) {
+      constant = constant && info.IsConstant(operand.node);
+      bound = bound || info.bound.count(operand.node) > 0;
+    }
+    if (constant) {
+      info.constants.insert(node);
+      if (bound) {
+        info.bound.insert(node);
+      }
+    }
+  }
+  return info;
+}
+
+bool IsWeightProducer(const ir::Node* node) {
+  return (node->op() == ir::OpKind(at::aten::mm) ||
+          node->op() == ir::OpKind(at::aten::matmul) ||
+          node->op() == ir::OpKind(at::aten::tf_convolution)) &&
+         node->operands().size() == 2;
+}
+
+// Returns the shape the scale of the producer output takes to multiply its
+// weights, or nullopt if the scale is not a scalar or a vector along the
+// output features, which must be the last dimension.
+absl::optional<std::vector<int64_t>> GetWeightScaleDimensions(
+    const ir::Node* producer, const xla::Shape& scale_shape) {
+  const xla::Shape& output_shape = producer->shape();
+  const xla::Shape& input_shape = producer->operand(0).shape();
+  const xla::Shape& weight_shape = producer->operand(1).shape();
+  int64_t rank = weight_shape.rank();
+  if (rank < 2 || output_shape.rank() == 0 ||
+      scale_shape.rank() > output_shape.rank() ||
+      scale_shape.element_type() != weight_shape.element_type()) {
+    return absl::nullopt;
+  }
+  std::vector<int64_t> dimensions(rank, 1);
+  int64_t num_scales = xla::ShapeUtil::ElementsIn(scale_shape);
+  if (num_scales == 1) {
+    return dimensions;
+  }
+  int64_t features = output_shape.dimensions(output_shape.rank() - 1);
+  if (num_scales != features ||
+      scale_shape.dimensions(scale_shape.rank() - 1) != features) {
+    return absl::nullopt;
+  }
+  if (producer->op() != ir::OpKind(at::aten::tf_convolution)) {
+    if (weight_shape.dimensions(rank - 1) != features) {
+      return absl::nullopt;
+    }
+    dimensions[rank - 1] = features;
+    return dimensions;
+  }
+  // The filters are [spatial..., in, out], or [spatial..., in, multiplier]
+  // for the depthwise convolutions, whatever the data format. Only the channels
+  // last convolutions have their features along the last dimension, which the
+  // shapes must tell without ambiguity.
+  int64_t last = output_shape.rank() - 1;
+  int64_t in_features = weight_shape.dimensions(rank - 2);
+  if (output_shape.rank() != rank || input_shape.rank() != rank ||
+      input_shape.dimensions(last) != in_features ||
+      (input_shape.dimensions(1) == in_features &&
+       output_shape.dimensions(1) == features)) {
+    return absl::nullopt;
+  }
+  if (weight_shape.dimensions(rank - 1) == features) {
+    dimensions[rank - 1] = features;
+  } else if (in_features * weight_shape.dimensions(rank - 1) == features) {
+    dimensions[rank - 2] = in_features;
+    dimensions[rank - 1] = weight_shape.dimensions(rank - 1);
+  } else {
+    return absl::nullopt;
+  }
+  return dimensions;
+}
+
+ir::Value MakeBinary(const ir::OpKind& op, const ir::Value& lhs,
+                     const ir::Value& rhs) {
+  auto lower_fn = [op](const ir::Node& node,
+                       ir::LoweringContext* loctx) -> ir::XlaOpVector {
+    xla::XlaOp xla_lhs = loctx->GetOutputOp(node.operand(0));
+    xla::XlaOp xla_rhs = loctx->GetOutputOp(node.operand(1));
+    return node.ReturnOp(op == ir::OpKind(at::aten::add)
+                             ? XlaHelpers::PromotedAdd(xla_lhs, xla_rhs)
+                             : XlaHelpers::PromotedMul(xla_lhs, xla_rhs),
+                         loctx);
+  };
+  return ir::ops::GenericOp(
+      op, {lhs, rhs}, XlaHelpers::GetPromotedShape(lhs.shape(), rhs.shape()),
+      std::move(lower_fn));
+}
+
+// Multiplies the weight by the scale, reshaped to the given dimensions.
+ir::Value MakeScaledWeight(const ir::Value& weight, const ir::Value& scale,
+                           std::vector<int64_t> dimensions) {
+  auto lower_fn = [dimensions](const ir::Node& node,
+                               ir::LoweringContext* loctx) -> ir::XlaOpVector {
+    xla::XlaOp xla_weight = loctx->GetOutputOp(node.operand(0));
+    xla::XlaOp xla_scale = loctx->GetOutputOp(node.operand(1));
+    return node.ReturnOp(
+        XlaHelpers::PromotedMul(xla_weight,
+                                xla::Reshape(xla_scale, dimensions)),
+        loctx);
+  };
+  return ir::ops::GenericOp(ir::OpKind(at::aten::mul), {weight, scale},
+                            weight.shape(), std::move(lower_fn),
+                            /*num_outputs=*/1, xla::util::MHash(dimensions));
+}
+
+// Rewrites Mul(P, scale) and Mul(Add(P, bias), scale), where P is a
+// convolution or a matrix multiplication whose result is only used there,
+// and the scale and bias are constants, into P with scaled weights, plus the
+// scaled bias.
+std::vector<ir::Value> FoldWeightScales(absl::Span<const ir::Value> roots,
+                                        const GraphInfo& info) {
+  ir::OutputMap<ir::Value> replacements;
+  auto single_use = [&](const ir::Node* node) {
+    return !info.IsConstant(node) && info.uses.at(node) == 1 &&
+           node->num_outputs() == 1;
+  };
+  for (const ir::Node* node : info.post_order) {
+    if (node->op() != ir::OpKind(at::aten::mul) ||
+        node->operands().size() != 2) {
+      continue;
+    }
+    for (size_t i = 0; i < 2; ++i) {
+      const ir::Output& scaled = node->operand(i);
+      const ir::Output& scale = node->operand(1 - i);
+      if (!info.IsConstant(scale.node) || !single_use(scaled.node)) {
+        continue;
+      }
+      const ir::Node* producer = scaled.node;
+      const ir::Node* add = nullptr;
+      absl::optional<ir::Output> bias;
+      if (producer->op() == ir::OpKind(at::aten::add) &&
+          producer->operands().size() == 2) {
+        for (size_t j = 0; j < 2; ++j) {
+          if (info.IsConstant(producer->operand(j).node) &&
+              single_use(producer->operand(1 - j).node)) {
+            add = producer;
+            bias = producer->operand(j);
+            producer = producer->operand(1 - j).node;
+            break;
+          }
+        }
+      }
+      if (!IsWeightProducer(producer) ||
+          !info.IsConstant(producer->operand(1).node) ||
+          !xla::ShapeUtil::Compatible(node->shape(), producer->shape()) ||
+          (add != nullptr &&
+           !xla::ShapeUtil::Compatible(add->shape(), producer->shape()))) {
+        continue;
+      }
+      absl::optional<std::vector<int64_t>> dimensions =
+          GetWeightScaleDimensions(producer, scale.shape());
+      if (!dimensions) {
+        continue;
+      }
+      ir::Value scale_value = info.ValueOf(scale);
+      ir::Value weight = MakeScaledWeight(info.ValueOf(producer->operand(1)),
+                                          scale_value, std::move(*dimensions));
+      ir::Value result(
+          producer->Clone({info.ValueOf(producer->operand(0)), weight}), 0);
+      if (add != nullptr) {
+        result = MakeBinary(
+            ir::OpKind(at::aten::add), result,
+            MakeBinary(ir::OpKind(at::aten::mul), info.ValueOf(*bias),
+                       scale_value));
+      }
+      replacements.emplace(ir::Output(node, 0), std::move(result));
+      break;
+    }
+  }
+  XLA_COUNTER("InferenceFoldedScales", replacements.size());
+  if (replacements.empty()) {
+    return std::vector<ir::Value>(roots.begin(), roots.end());
+  }
+  return ir::Util::CloneWithReplacements(roots, replacements);
+}
+
+// Returns the outputs of the constant subgraphs which the rest of the graph
+// uses. The constant nodes which expand their operands, like broadcasts, are
+// left to the graph, as those are cheaper to recompute than to hold.
+std::vector<ir::Output> FindConstantOutputs(absl::Span<const ir::Value> roots,
+                                            const GraphInfo& info) {
+  absl::flat_hash_set<const ir::Node*> hoisted;
+  for (const ir::Node* node : info.post_order) {
+    if (info.bound.count(node) == 0 || node->operands().empty()) {
+      continue;
+    }
+    int64_t operand_elements = 0;
+    for (const ir::Output& operand : node->operands()) {
+      operand_elements += xla::ShapeUtil::ElementsIn(operand.shape());
+    }
+    int64_t elements = 0;
+    for (size_t i = 0; i < node->num_outputs(); ++i) {
+      elements += xla::ShapeUtil::ElementsIn(node->shape(i));
+    }
+    if (elements <= operand_elements) {
+      hoisted.insert(node);
+    }
+  }
+  std::vector<ir::Output> outputs;
+  ir::OutputSet seen;
+  auto add_output = [&](const ir::Output& output) {
+    if (hoisted.count(output.node) > 0 && seen.insert(output).second) {
+      outputs.push_back(output);
+    }
+  };
+  for (const ir::Node* node : info.post_order) {
+    if (hoisted.count(node) == 0) {
+      for (const ir::Output& operand : node->operands()) {
+        add_output(operand);
+      }
+    }
+  }
+  for (const ir::Value& root : roots) {
+    add_output(ir::Output(root.node.get(), root.index));
+  }
+  return outputs;
+}
+
+std::vector<xla::ComputationClient::DataPtr> EvaluateOutputs(
+    absl::Span<const ir::Output> outputs, const GraphInfo& info,
+    const Device& device) {
+  std::vector<XLATensor> tensors;
+  tensors.reserve(outputs.size());
+  for (const ir::Output& output : outputs) {
+    tensors.push_back(XLATensor::Create(info.ValueOf(output), device));
+  }
+  XLATensor::SyncTensorsGraph(&tensors, {device.ToString()}, /*wait=*/true,
+                              /*sync_xla_data=*/false);
+  std::vector<xla::ComputationClient::DataPtr> results;
+  results.reserve(tensors.size());
+  for (XLATensor& tensor : tensors) {
+    results.push_back(tensor.GetXlaData());
+  }
+  return results;
+}
+
+}  // namespace
+
+std::vector<ir::Value> OptimizeForInference(
+    absl::Span<const ir::Value> roots,
+    absl::Span<const xla::ComputationClient::DataPtr> inputs,
+    const Device& device) {
+  std::vector<ir::Value> values =
+      FoldWeightScales(roots, AnalyzeGraph(roots, inputs));
+  GraphInfo info = AnalyzeGraph(values, inputs);
+  std::vector<ir::Output> constants = FindConstantOutputs(values, info);
+  if (constants.empty()) {
+    return values;
+  }
+  std::vector<xla::ComputationClient::DataPtr> constants_data =
+      EvaluateOutputs(constants, info, device);
+  ir::OutputMap<ir::Value> replacements;
+  for (size_t i = 0; i < constants.size(); ++i) {
+    replacements.emplace(
+        constants[i],
+        ir::Value(ir::MakeNode<ir::ops::DeviceData>(constants_data[i]), 0));
+  }
+  XLA_COUNTER("InferenceHoistedConstants", constants.size());
+  TF_VLOG(3) << "Inference optimization hoisted " << constants.size()
+             << " constant subgraph outputs";
+  return ir::Util::CloneWithReplacements(values, replacements);
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+
+namespace swift_xla {
+
+// Rewrites the graph of the roots for serving, where all the device data but
+// the inputs are constants (see FrozenGraph). The per feature scales following
+// a convolution or a matrix multiplication, with or without a bias in between
+// (as the inference batch norms do), get folded into its weights. Then the
+// subgraphs computed from the constants only, like those folded weights, the
+// batch norm coefficients or the weight transposes and casts, get evaluated
+// once on the device, and replaced by their results.
+std::vector<ir::Value> OptimizeForInference(
+    absl::Span<const ir::Value> roots,
+    absl::Span<const xla::ComputationClient::DataPtr> inputs,
+    const Device& device);
+
+}  // namespace swift_xla
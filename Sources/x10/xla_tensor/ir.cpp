@@ -14,6 +14,8 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <sstream>
 
@@ -21,6 +23,7 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
 #include "tensorflow/compiler/xla/xla_client/cache.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 
@@ -28,8 +31,11 @@ namespace swift_xla {
 namespace ir {
 namespace {
 
-using ShapeCache =
-    xla::util::Cache<xla::hash_t, xla::Shape, xla::util::HashReducer>;
+using ShapeCache = xla::util::Cache<xla::hash_t, const InternedShape,
+                                    xla::util::HashReducer>;
+using SharedShapeCache =
+    xla::util::ShardedCache<xla::hash_t, const InternedShape,
+                            xla::util::HashReducer>;
 
 struct ScapeEntry {
   std::string name;
@@ -43,6 +49,10 @@ struct ScopeContext {
 
 thread_local ScopeContext g_scope_context;
 
+std::atomic<bool> g_node_marks_held(false);
+// Only touched by the node marks owner.
+uint64_t g_node_marks_generation = 0;
+
 void PushScope(const std::string& name) {
   size_t id = g_scope_context.next_id;
   g_scope_context.scopes.push_back(
@@ -73,15 +83,89 @@ std::string GetCurrentScope() {
   return scope;
 }
 
-ShapeCache* GetShapeCache() {
+int64_t GetShapeCacheSize() {
   static int64_t shape_cache_size =
       xla::sys_util::GetEnvInt("XLA_IR_SHAPE_CACHE_SIZE", 131072);
-  thread_local ShapeCache* cache = new ShapeCache(shape_cache_size);
+  return shape_cache_size;
+}
+
+ShapeCache* GetShapeCache() {
+  thread_local ShapeCache* cache = new ShapeCache(GetShapeCacheSize());
   return cache;
 }
 
+// Backs the per thread shape caches, so that the shapes inferred by a thread
+// are found by the other tracing threads, which would otherwise run the shape
+// functions again.
+SharedShapeCache* GetSharedShapeCache() {
+  static SharedShapeCache* cache = new SharedShapeCache(
+      GetShapeCacheSize(), xla::sys_util::GetEnvInt("XLA_CACHE_SHARDS", 8));
+  return cache;
+}
+
+// Holds the interned shapes, keyed by their structure hash. The nodes keep
+// their shapes alive, so an evicted shape only stops being shared with the
+// nodes created afterwards.
+SharedShapeCache* GetInternedShapes() {
+  static SharedShapeCache* cache = new SharedShapeCache(
+      xla::sys_util::GetEnvInt("XLA_IR_SHAPE_INTERN_SIZE", 65536),
+      xla::sys_util::GetEnvInt("XLA_CACHE_SHARDS", 8));
+  return cache;
+}
+
+// Hashes the structure of the shape, which is much cheaper than hashing its
+// text form, to look it up within the interned shapes.
+xla::hash_t GetShapeStructureHash(const xla::Shape& shape) {
+  xla::hash_t hash =
+      xla::util::MHash(static_cast<int>(shape.element_type()));
+  if (shape.IsTuple()) {
+    for (auto& tuple_shape : shape.tuple_shapes()) {
+      hash = xla::util::HashCombine(hash, GetShapeStructureHash(tuple_shape));
+    }
+    return hash;
+  }
+  hash = xla::util::HashCombine(hash, xla::util::Hash(shape.dimensions()));
+  hash = xla::util::HashCombine(hash,
+                                xla::util::Hash(shape.dynamic_dimensions()));
+  if (shape.has_layout()) {
+    hash = xla::util::HashCombine(
+        hash, xla::util::Hash(shape.layout().minor_to_major()));
+  }
+  return hash;
+}
+
+// Capturing the stack of every node slows tracing down, so only every
+// XLA_FRAME_INFO_SAMPLING-th node created by a thread gets its frames.
+bool ShouldCaptureFrames() {
+  static int64_t sampling =
+      std::max<int64_t>(xla::sys_util::GetEnvInt("XLA_FRAME_INFO_SAMPLING", 1),
+                        1);
+  thread_local int64_t count = 0;
+  return count++ % sampling == 0;
+}
+
 }  // namespace
 
+InternedShape::InternedShape(xla::Shape shape)
+    : shape(std::move(shape)),
+      hash(xla::util::Hash(this->shape.ToString())) {}
+
+InternedShapePtr InternShape(xla::Shape shape) {
+  SharedShapeCache* interned_shapes = GetInternedShapes();
+  xla::hash_t key = GetShapeStructureHash(shape);
+  InternedShapePtr interned = interned_shapes->Get(key);
+  if (interned != nullptr && interned->shape == shape) {
+    return interned;
+  }
+  auto new_shape = std::make_shared<const InternedShape>(std::move(shape));
+  if (interned != nullptr) {
+    // Structure hash collision, the first shape keeps the slot.
+    return new_shape;
+  }
+  XLA_COUNTER("IrInternedShapes", 1);
+  return interned_shapes->Add(key, std::move(new_shape));
+}
+
 size_t Output::Hasher::operator()(const Output& output) const {
   return xla::util::StdHashCombine(
       reinterpret_cast<std::ptrdiff_t>(output.node), output.index);
@@ -120,14 +204,19 @@ bool Node::s_log_graph_changes_ =
 
 Node::Node(OpKind op, OpList operands, xla::Shape shape, size_t num_outputs,
            xla::hash_t hash_seed)
+    : Node(std::move(op), operands, InternShape(std::move(shape)), num_outputs,
+           hash_seed) {}
+
+Node::Node(OpKind op, OpList operands, InternedShapePtr shape,
+           size_t num_outputs, xla::hash_t hash_seed)
     : op_(std::move(op)),
       num_outputs_(num_outputs),
       shape_(std::move(shape)),
       node_hash_(xla::util::HashCombine(op_.hash(), hash_seed)),
       hash_(node_hash_) {
   metadata_.scope = GetCurrentScope();
-  if (s_log_graph_changes_) {
-    metadata_.frame_info = GetSwiftFrames();
+  if (s_log_graph_changes_ && ShouldCaptureFrames()) {
+    metadata_.frame_info = SwiftFrames::Capture();
   }
   for (auto& operand : operands) {
     AddOperand(operand.node, operand.index);
@@ -138,8 +227,9 @@ Node::Node(OpKind op, OpList operands, xla::Shape shape, size_t num_outputs,
 Node::Node(OpKind op, OpList operands,
            const std::function<xla::Shape()>& shape_fn, size_t num_outputs,
            xla::hash_t hash_seed)
-    : Node(std::move(op), operands, xla::Shape(), num_outputs, hash_seed) {
-  // Forward the constructor to the one above (with empty shape), so we have the
+    : Node(std::move(op), operands, InternedShapePtr(), num_outputs,
+           hash_seed) {
+  // Forward the constructor to the one above (without shape), so we have the
   // full hash information, then fetch/compute the real shape.
   shape_ = GetOpShape(shape_fn);
 }
@@ -148,21 +238,21 @@ Node::Node(OpKind op, xla::Shape shape, size_t num_outputs,
            xla::hash_t hash_seed)
     : op_(std::move(op)),
       num_outputs_(num_outputs),
-      shape_(std::move(shape)),
-      node_hash_(GetOpHash(op_, shape_, hash_seed)),
+      shape_(InternShape(std::move(shape))),
+      node_hash_(GetOpHash(op_, *shape_, hash_seed)),
       hash_(node_hash_) {
   metadata_.scope = GetCurrentScope();
-  if (s_log_graph_changes_) {
-    metadata_.frame_info = GetSwiftFrames();
+  if (s_log_graph_changes_ && ShouldCaptureFrames()) {
+    metadata_.frame_info = SwiftFrames::Capture();
   }
 }
 
 const xla::Shape& Node::shape(size_t output_index) const {
-  if (shape_.IsTuple()) {
-    return shape_.tuple_shapes(output_index);
+  if (shape_->shape.IsTuple()) {
+    return shape_->shape.tuple_shapes(output_index);
   }
   XLA_CHECK_EQ(output_index, 0);
-  return shape_;
+  return shape_->shape;
 }
 
 void Node::AddOperand(NodePtr node, size_t index) {
@@ -208,26 +298,48 @@ XlaOpVector Node::Lower(LoweringContext* loctx) const {
   XLA_ERROR() << "Lowering not implemented for node: " << *this;
 }
 
-xla::hash_t Node::GetOpHash(OpKind op, const xla::Shape& shape,
+xla::hash_t Node::GetOpHash(OpKind op, const InternedShape& shape,
                             xla::hash_t hash_seed) {
-  xla::hash_t h =
-      xla::util::HashCombine(op.hash(), xla::util::Hash(shape.ToString()));
+  xla::hash_t h = xla::util::HashCombine(op.hash(), shape.hash);
   return xla::util::HashCombine(h, hash_seed);
 }
 
-xla::Shape Node::GetOpShape(const std::function<xla::Shape()>& shape_fn) const {
+InternedShapePtr Node::GetOpShape(
+    const std::function<xla::Shape()>& shape_fn) const {
   ShapeCache* shape_cache = GetShapeCache();
   auto shape = shape_cache->Get(hash());
   if (shape == nullptr) {
-    shape = shape_cache->Add(hash(), std::make_shared<xla::Shape>(shape_fn()));
+    SharedShapeCache* shared_shape_cache = GetSharedShapeCache();
+    shape = shared_shape_cache->Get(hash());
+    if (shape == nullptr) {
+      shape = shared_shape_cache->Add(hash(), InternShape(shape_fn()));
+    }
+    shape_cache->Add(hash(), shape);
+  }
+  return shape;
+}
+
+std::unique_ptr<NodeMarks> NodeMarks::TryAcquire() {
+  bool held = false;
+  if (!g_node_marks_held.compare_exchange_strong(held, true,
+                                                 std::memory_order_acquire)) {
+    return nullptr;
   }
-  return *shape;
+  return std::unique_ptr<NodeMarks>(new NodeMarks(++g_node_marks_generation));
+}
+
+NodeMarks::~NodeMarks() {
+  g_node_marks_held.store(false, std::memory_order_release);
 }
 
 ScopePusher::ScopePusher(const std::string& name) { PushScope(name); }
 
 ScopePusher::~ScopePusher() { PopScope(); }
 
+void ScopePusher::Push(const std::string& name) { PushScope(name); }
+
+void ScopePusher::Pop() { PopScope(); }
+
 void ScopePusher::ResetScopes() { ResetScopeContext(); }
 
 }  // namespace ir
@@ -28,6 +28,7 @@
 
 #include "absl/types/span.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/node_pool.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/swift_backtrace.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 #include "tensorflow/compiler/xla/xla_client/types.h"
@@ -51,7 +52,7 @@ struct UserMetaData {
 
 struct MetaData {
   std::string scope;
-  std::vector<SourceLocation> frame_info;
+  SwiftFrames frame_info;
 };
 
 // Represents a specific output produced by a node. Since the output of a node
@@ -152,6 +153,20 @@ inline std::ostream& operator<<(std::ostream& stream, const OpKind& op) {
 
 using OpList = absl::Span<const Value>;
 
+// An immutable shape shared by all the nodes with an equal shape, together with
+// its hash, which is computed once, when the shape is first interned.
+struct InternedShape {
+  explicit InternedShape(xla::Shape shape);
+
+  const xla::Shape shape;
+  const xla::hash_t hash;
+};
+
+using InternedShapePtr = std::shared_ptr<const InternedShape>;
+
+// Returns the interned instance of the shape, which is created if missing.
+InternedShapePtr InternShape(xla::Shape shape);
+
 // A node in the graph. Nodes for operations which requires extra data to be
 // stored for lowering, should inherit from this class and add operation
 // specific member there. For example, a constant might create a new
@@ -182,7 +197,11 @@ class Node {
 
   // Retrieves the full shape of the IR Node. Note that if this is a
   // multi-output node, the returned shape will be a tuple.
-  const xla::Shape& shape() const { return shape_; }
+  const xla::Shape& shape() const { return shape_->shape; }
+
+  // The interned instance of the full shape, shared by the nodes of an equal
+  // shape.
+  const InternedShapePtr& interned_shape() const { return shape_; }
 
   // Retrieves the shape of the output at a given index. If the node is not a
   // multi-output node, output_index must be zero.
@@ -216,18 +235,22 @@ class Node {
                         LoweringContext* loctx) const;
 
  private:
+  Node(OpKind op, OpList operands, InternedShapePtr shape, size_t num_outputs,
+       xla::hash_t hash_seed);
+
   // Adds node's index output number as operand.
   void AddOperand(NodePtr node, size_t index = 0);
 
-  xla::Shape GetOpShape(const std::function<xla::Shape()>& shape_fn) const;
+  InternedShapePtr GetOpShape(
+      const std::function<xla::Shape()>& shape_fn) const;
 
-  static xla::hash_t GetOpHash(OpKind op, const xla::Shape& shape,
+  static xla::hash_t GetOpHash(OpKind op, const InternedShape& shape,
                                xla::hash_t hash_seed);
 
   // The ID of the operation captured by this node.
   OpKind op_;
   size_t num_outputs_ = 1;
-  xla::Shape shape_;
+  InternedShapePtr shape_;
   // A node holds a real reference to its operands.
   absl::InlinedVector<NodePtr, 4> operands_;
   // Outputs do not hold references on the nodes, and neither do the uses, since
@@ -239,11 +262,45 @@ class Node {
   xla::hash_t hash_ = 0;
   // The IR specific metadata attached to the IR node.
   MetaData metadata_;
+  // The mark set by the graph traversal owning the node marks, valid only if
+  // mark_generation_ matches the traversal generation (see NodeMarks).
+  mutable uint64_t mark_generation_ = 0;
+  mutable size_t mark_ = 0;
+
+  friend class NodeMarks;
 
  public:
   static bool s_log_graph_changes_;
 };
 
+// Marks set within the nodes by a graph traversal, which saves it the hash map
+// lookups of the visited nodes. Every owner gets a new generation number, which
+// tells its marks apart from the stale ones. A single owner at a time can hold
+// the marks: TryAcquire() returns nullptr while they are held (by this or
+// another thread), and the caller must then track the nodes on its own.
+class NodeMarks {
+ public:
+  static std::unique_ptr<NodeMarks> TryAcquire();
+
+  ~NodeMarks();
+
+  // Returns the mark of the node, or zero if the node has not been marked by
+  // this owner.
+  size_t Get(const Node* node) const {
+    return node->mark_generation_ == generation_ ? node->mark_ : 0;
+  }
+
+  void Set(const Node* node, size_t mark) const {
+    node->mark_generation_ = generation_;
+    node->mark_ = mark;
+  }
+
+ private:
+  explicit NodeMarks(uint64_t generation) : generation_(generation) {}
+
+  uint64_t generation_;
+};
+
 // RAII data structure to be used a stack variable to enter a new IR scope. IR
 // scope names will appear in the IR and will help identifying the source of the
 // single IR nodes.
@@ -251,6 +308,11 @@ struct ScopePusher {
   explicit ScopePusher(const std::string& name);
   ~ScopePusher();
 
+  // Same as the constructor and the destructor, for the callers which cannot
+  // keep a stack variable around, like the language bindings.
+  static void Push(const std::string& name);
+  static void Pop();
+
   static void ResetScopes();
 };
 
@@ -261,7 +323,8 @@ inline std::ostream& operator<<(std::ostream& stream, const Node& node) {
 
 template <typename T, typename... Args>
 NodePtr MakeNode(Args&&... args) {
-  return std::make_shared<T>(std::forward<Args>(args)...);
+  return std::allocate_shared<T>(NodeAllocator<T>(),
+                                 std::forward<Args>(args)...);
 }
 
 template <typename T>
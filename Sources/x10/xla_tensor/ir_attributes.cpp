@@ -0,0 +1,91 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_attributes.h"
+
+#include <mutex>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace {
+
+// Past this many lists, new ones are not interned anymore, so that a program
+// tracing ever changing attributes does not grow the table without bounds.
+constexpr size_t kMaxInternedLists = 16384;
+
+using EntryPtr = std::shared_ptr<const Int64List::Entry>;
+
+EntryPtr MakeEntry(absl::Span<const int64_t> values, const xla::hash_t& hash) {
+  auto entry = std::make_shared<Int64List::Entry>();
+  entry->values.assign(values.begin(), values.end());
+  entry->hash = hash;
+  return entry;
+}
+
+class Int64ListTable {
+ public:
+  EntryPtr Intern(absl::Span<const int64_t> values) {
+    xla::hash_t hash = xla::util::Hash(values);
+    std::lock_guard<std::mutex> lock(lock_);
+    size_t key = xla::util::HashReduce(hash);
+    auto it = buckets_.find(key);
+    if (it != buckets_.end()) {
+      for (const EntryPtr& entry : it->second) {
+        if (absl::Span<const int64_t>(entry->values) == values) {
+          return entry;
+        }
+      }
+    }
+    EntryPtr entry = MakeEntry(values, hash);
+    if (size_ < kMaxInternedLists) {
+      buckets_[key].push_back(entry);
+      ++size_;
+      XLA_COUNTER("InternedInt64Lists", 1);
+    }
+    return entry;
+  }
+
+ private:
+  std::mutex lock_;
+  absl::flat_hash_map<size_t, std::vector<EntryPtr>> buckets_;
+  size_t size_ = 0;
+};
+
+Int64ListTable* GetInt64ListTable() {
+  static Int64ListTable* table = new Int64ListTable();
+  return table;
+}
+
+const EntryPtr& GetEmptyEntry() {
+  static const EntryPtr* entry =
+      new EntryPtr(MakeEntry({}, xla::util::Hash(absl::Span<const int64_t>())));
+  return *entry;
+}
+
+}  // namespace
+
+Int64List::Int64List() : entry_(GetEmptyEntry()) {}
+
+Int64List::Int64List(absl::Span<const int64_t> values)
+    : entry_(values.empty() ? GetEmptyEntry()
+                            : GetInt64ListTable()->Intern(values)) {}
+
+xla::hash_t Hash(const Int64List& list) { return list.hash(); }
+
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/xla_client/types.h"
+
+namespace swift_xla {
+namespace ir {
+
+// Immutable list of integers held by the IR nodes as attribute, like the
+// dimensions, paddings and strides of an operation. The lists are interned, so
+// building one from a span which has been seen before does not allocate, and
+// copying one is a reference count increment. The hash of the values is
+// computed once, when the list is interned.
+class Int64List {
+ public:
+  Int64List();
+
+  Int64List(absl::Span<const int64_t> values);
+
+  Int64List(const std::vector<int64_t>& values)
+      : Int64List(absl::Span<const int64_t>(values)) {}
+
+  size_t size() const { return entry_->values.size(); }
+
+  bool empty() const { return entry_->values.empty(); }
+
+  const int64_t* data() const { return entry_->values.data(); }
+
+  std::vector<int64_t>::const_iterator begin() const {
+    return entry_->values.begin();
+  }
+
+  std::vector<int64_t>::const_iterator end() const {
+    return entry_->values.end();
+  }
+
+  int64_t operator[](size_t index) const { return entry_->values[index]; }
+
+  operator absl::Span<const int64_t>() const { return entry_->values; }
+
+  operator const std::vector<int64_t>&() const { return entry_->values; }
+
+  const xla::hash_t& hash() const { return entry_->hash; }
+
+  struct Entry {
+    std::vector<int64_t> values;
+    xla::hash_t hash;
+  };
+
+ private:
+  std::shared_ptr<const Entry> entry_;
+};
+
+xla::hash_t Hash(const Int64List& list);
+
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,121 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir_binary_dump.h"
+
+#include <fstream>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+
+namespace swift_xla {
+namespace ir {
+namespace {
+
+constexpr char kMagic[] = "X10IRv1\n";
+
+void EncodeVarint(uint64_t value, std::string* data) {
+  while (value >= 0x80) {
+    data->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  data->push_back(static_cast<char>(value));
+}
+
+}  // namespace
+
+BinaryGraphWriter::BinaryGraphWriter(std::string path)
+    : path_(std::move(path)) {}
+
+void BinaryGraphWriter::Append(const std::string& name,
+                               absl::Span<const Node* const> post_order,
+                               absl::Span<const Node* const> roots,
+                               absl::Span<const xla::hash_t> root_hashes,
+                               bool uncached_compile) {
+  XLA_CHECK_EQ(roots.size(), root_hashes.size());
+  absl::flat_hash_map<const Node*, uint64_t> node_ids;
+  node_ids.reserve(post_order.size());
+  for (const Node* node : post_order) {
+    node_ids.emplace(node, node_ids.size());
+  }
+  std::lock_guard<std::mutex> lock(lock_);
+  size_t start = pending_.size();
+  pending_.push_back('G');
+  EncodeString(name, &pending_);
+  EncodeVarint(xla::sys_util::NowNs(), &pending_);
+  EncodeVarint(uncached_compile ? 1 : 0, &pending_);
+  EncodeVarint(roots.size(), &pending_);
+  for (size_t i = 0; i < roots.size(); ++i) {
+    EncodeVarint(node_ids.at(roots[i]), &pending_);
+    EncodeVarint(absl::Uint128High64(root_hashes[i]), &pending_);
+    EncodeVarint(absl::Uint128Low64(root_hashes[i]), &pending_);
+  }
+  EncodeVarint(post_order.size(), &pending_);
+  for (size_t id = 0; id < post_order.size(); ++id) {
+    const Node* node = post_order[id];
+    EncodeString(node->op().ToString(), &pending_);
+    EncodeString(node->ToString(), &pending_);
+    EncodeVarint(node->num_outputs(), &pending_);
+    EncodeVarint(node->operands().size(), &pending_);
+    for (const Output& output : node->operands()) {
+      EncodeVarint(id - node_ids.at(output.node), &pending_);
+      EncodeVarint(output.index, &pending_);
+    }
+  }
+  XLA_COUNTER("BinaryGraphDumps", 1);
+  XLA_VALUE_METRIC("BinaryGraphDumpBytes", pending_.size() - start);
+  if (!flush_scheduled_) {
+    flush_scheduled_ = true;
+    xla::env::ScheduleIoClosure([this]() { Flush(); });
+  }
+}
+
+void BinaryGraphWriter::EncodeString(const std::string& value,
+                                     std::string* data) {
+  auto it = strings_.find(value);
+  if (it != strings_.end()) {
+    EncodeVarint(it->second, data);
+    return;
+  }
+  uint64_t index = strings_.size();
+  strings_.emplace(value, index);
+  EncodeVarint(index, data);
+  EncodeVarint(value.size(), data);
+  data->append(value);
+}
+
+void BinaryGraphWriter::Flush() {
+  std::lock_guard<std::mutex> file_lock(file_lock_);
+  std::string data;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    data.swap(pending_);
+    flush_scheduled_ = false;
+  }
+  std::ofstream file(path_, std::ios_base::app | std::ios_base::binary);
+  if (!magic_written_) {
+    file.write(kMagic, sizeof(kMagic) - 1);
+    magic_written_ = true;
+  }
+  file.write(data.data(), data.size());
+  if (!file) {
+    TF_LOG(ERROR) << "Failed to write the IR graphs to " << path_;
+  }
+}
+
+}  // namespace ir
+}  // namespace swift_xla
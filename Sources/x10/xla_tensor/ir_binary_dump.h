@@ -0,0 +1,77 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/xla/xla_client/types.h"
+
+namespace swift_xla {
+namespace ir {
+
+// Appends IR graphs to a file, in a compact binary format which is cheap
+// enough to leave enabled on long running programs. A graph gets encoded on the
+// calling thread, which only walks its nodes, while the file writes happen on
+// an IO thread. The node strings (which carry the shapes and the attributes)
+// and the op names are interned for the lifetime of the writer, so a graph
+// which repeats the nodes of an earlier one only costs their indices.
+// Utilities/x10_ir_dump.py converts the file to the text or dot formats of
+// DumpUtil.
+//
+// The file is a sequence of streams, one per writer (hence per process), each
+// starting with the "X10IRv1\n" magic. All integers are LEB128 varints, and a
+// string is a reference to the table of the stream: an index below the table
+// size names a string seen before, while the index equal to the table size is
+// followed by the length and the bytes of a new string. After the magic, each
+// graph is:
+//   'G', name:string, timestamp_ns, flags (bit 0: uncached compile),
+//   num_roots, { node_id, hash_hi, hash_lo } * num_roots,
+//   num_nodes, { op:string, node:string, num_outputs, num_operands,
+//                { node_id_delta, output_index } * num_operands } * num_nodes
+// where the nodes come in post order, and an operand refers to the node with
+// id node_id - node_id_delta.
+class BinaryGraphWriter {
+ public:
+  explicit BinaryGraphWriter(std::string path);
+
+  void Append(const std::string& name, absl::Span<const Node* const> post_order,
+              absl::Span<const Node* const> roots,
+              absl::Span<const xla::hash_t> root_hashes, bool uncached_compile);
+
+ private:
+  void EncodeString(const std::string& value, std::string* data);
+
+  void Flush();
+
+  std::string path_;
+  std::mutex lock_;
+  absl::flat_hash_map<std::string, uint64_t> strings_;
+  std::string pending_;
+  bool flush_scheduled_ = false;
+  // Held across the writes, so that the graphs land in the file in the order
+  // they got encoded.
+  std::mutex file_lock_;
+  bool magic_written_ = false;
+};
+
+}  // namespace ir
+}  // namespace swift_xla
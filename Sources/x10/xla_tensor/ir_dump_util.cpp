@@ -23,6 +23,7 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/debug_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/memory_analysis.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/xla_util.h"
 
@@ -199,7 +200,7 @@ std::string GenerateTextNodeSpec(const Node* node, const NodeIdMap& id_map) {
 struct ChangeLogNode {
   std::string text;
   xla::Shape shape;
-  std::vector<SourceLocation> backtrace;
+  SwiftFrames backtrace;
 };
 
 thread_local std::map<xla::hash_t, std::vector<ChangeLogNode>> g_change_logs;
@@ -296,6 +297,17 @@ std::string DumpUtil::ToHlo(absl::Span<const Value> values,
   return ConsumeValue(xla::util::GetComputationHloText(computation));
 }
 
+std::string DumpUtil::ToMemoryAnalysis(absl::Span<const Value> values,
+                                       const Device& device) {
+  ir::RootLoweringContext lowering_ctx("IrToMemoryAnalysis", device);
+  for (auto& ir_value : values) {
+    xla::XlaOp root = lowering_ctx.GetOutputOp(ir_value);
+    lowering_ctx.AddResult(root);
+  }
+  xla::XlaComputation computation = ConsumeValue(lowering_ctx.Build());
+  return AnalyzeComputationMemory(computation).ToString();
+}
+
 std::string DumpUtil::GetGraphChangeLog(absl::Span<const Node* const> roots) {
   auto post_order = Util::ComputePostOrder(roots);
   absl::node_hash_map<const Node*, size_t> roots_ids = GetRootsIds(roots);
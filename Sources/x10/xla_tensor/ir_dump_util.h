@@ -40,6 +40,9 @@ class DumpUtil {
   static std::string ToHlo(absl::Span<const Value> values,
                            const Device& device);
 
+  static std::string ToMemoryAnalysis(absl::Span<const Value> values,
+                                      const Device& device);
+
   static std::string GetGraphChangeLog(absl::Span<const Node* const> roots);
 
   static std::string GetAnnotations(absl::Span<const Node* const> nodes);
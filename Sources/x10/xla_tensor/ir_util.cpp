@@ -14,11 +14,344 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
 
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/container/node_hash_map.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/xla_client/cache.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/xla/xla_client/xla_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/memory_analysis.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/constant.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/device_data.h"
+#include "tensorflow/compiler/xla/service/hlo_evaluator.h"
+#include "tensorflow/compiler/xla/shape_util.h"
 
 namespace swift_xla {
 namespace ir {
+namespace {
+
+const Node* GetAlias(const Util::NodeAliases& aliases, const Node* node) {
+  auto it = aliases.find(node);
+  return it != aliases.end() ? it->second : node;
+}
+
+// Returns the key used to look up equivalent nodes, or absl::nullopt if the
+// node should never be merged.
+absl::optional<xla::hash_t> GetCseKey(const Util::NodeAliases& aliases,
+                                      const Node* node) {
+  if (node->operands().empty()) {
+    const ops::DeviceData* device_data = ops::DeviceData::Cast(node);
+    if (device_data != nullptr) {
+      return xla::util::HashCombine(
+          node->node_hash(), device_data->data()->GetOpaqueHandle());
+    }
+    // Constant nodes include their value within the node hash.
+    if (node->op() == OpKind(at::prim::Constant)) {
+      return node->node_hash();
+    }
+    return absl::nullopt;
+  }
+  xla::hash_t key = node->node_hash();
+  for (auto& output : node->operands()) {
+    key = xla::util::HashCombine(
+        key, xla::util::MHash(reinterpret_cast<uintptr_t>(
+                                  GetAlias(aliases, output.node)),
+                              output.index));
+  }
+  return key;
+}
+
+bool IsEquivalent(const Util::NodeAliases& aliases, const Node* node,
+                  const Node* other) {
+  if (node->node_hash() != other->node_hash() || node->op() != other->op() ||
+      node->shape() != other->shape() ||
+      node->operands().size() != other->operands().size()) {
+    return false;
+  }
+  const ops::DeviceData* device_data = ops::DeviceData::Cast(node);
+  if (device_data != nullptr) {
+    return device_data->data()->GetOpaqueHandle() ==
+           ops::DeviceData::Cast(other)->data()->GetOpaqueHandle();
+  }
+  for (size_t i = 0; i < node->operands().size(); ++i) {
+    const Output& output = node->operand(i);
+    const Output& other_output = other->operand(i);
+    if (output.index != other_output.index ||
+        GetAlias(aliases, output.node) !=
+            GetAlias(aliases, other_output.node)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+using FoldedConstantsCache =
+    xla::util::Cache<xla::hash_t, xla::Literal, xla::util::HashReducer>;
+
+FoldedConstantsCache* GetFoldedConstantsCache() {
+  static const size_t kMaxCacheSize =
+      xla::sys_util::GetEnvInt("XLA_FOLDED_CONSTANTS_CACHE_SIZE", 4096);
+  static FoldedConstantsCache* cache = new FoldedConstantsCache(kMaxCacheSize);
+  return cache;
+}
+
+bool IsFoldable(const Node* node, int64_t max_size) {
+  if (node->num_outputs() != 1 || node->operands().empty() ||
+      !node->shape().IsArray() ||
+      xla::ShapeUtil::ElementsIn(node->shape()) > max_size) {
+    return false;
+  }
+  for (auto& output : node->operands()) {
+    if (output.node->op() != OpKind(at::prim::Constant)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::shared_ptr<xla::Literal> EvaluateOnHost(const Node* node) {
+  RootLoweringContext loctx("FoldConstant", Device());
+  xla::XlaOp root = loctx.GetOutputOp(Output(node));
+  xla::StatusOr<xla::XlaComputation> computation = loctx.Build(root);
+  if (!computation.ok()) {
+    return nullptr;
+  }
+  auto module =
+      xla::util::CreateModuleFromProto(computation.ValueOrDie().proto());
+  if (!module.ok()) {
+    return nullptr;
+  }
+  xla::HloEvaluator evaluator;
+  xla::StatusOr<xla::Literal> result =
+      evaluator.Evaluate(*module.ValueOrDie(), {});
+  if (!result.ok()) {
+    TF_VLOG(3) << "Unable to fold " << *node << ": " << result.status();
+    return nullptr;
+  }
+  return std::make_shared<xla::Literal>(std::move(result.ValueOrDie()));
+}
+
+// Same as Util::ComputePostOrder(), but with the emission status of the nodes
+// stored in their marks.
+std::vector<const Node*> ComputeMarkedPostOrder(
+    absl::Span<const Node* const> nodes, const NodeMarks& marks) {
+  std::vector<const Node*> post_order;
+  std::vector<const Node*> queue;
+  for (auto root : nodes) {
+    queue.push_back(root);
+    while (!queue.empty()) {
+      const Node* node = queue.back();
+      size_t status = marks.Get(node);
+      if (status == Util::kNotEmitted) {
+        marks.Set(node, Util::kEmitting);
+        for (const auto& output : node->operands()) {
+          size_t operand_status = marks.Get(output.node);
+          if (operand_status == Util::kNotEmitted) {
+            queue.push_back(output.node);
+          } else if (operand_status == Util::kEmitting) {
+            XLA_ERROR() << "Graph loop found at " << *output.node;
+          }
+        }
+        if (node->operands().empty()) {
+          marks.Set(node, Util::kEmitted);
+          post_order.push_back(node);
+          queue.pop_back();
+        }
+      } else if (status == Util::kEmitting) {
+        marks.Set(node, Util::kEmitted);
+        post_order.push_back(node);
+        queue.pop_back();
+      } else {
+        queue.pop_back();
+      }
+    }
+  }
+  return post_order;
+}
+
+constexpr size_t kNoRegion = std::numeric_limits<size_t>::max();
+
+// Returns the first depth components of the scope, or an empty string if the
+// scope has fewer components.
+std::string GetScopePrefix(const std::string& scope, size_t depth) {
+  if (scope.empty()) {
+    return std::string();
+  }
+  std::vector<absl::string_view> parts = absl::StrSplit(scope, '/');
+  if (parts.size() < depth) {
+    return std::string();
+  }
+  return absl::StrJoin(parts.begin(), parts.begin() + depth, "/");
+}
+
+void AddRegionOutput(OutlinedRegions::Region* region,
+                     OutputMap<size_t>* outputs_map, const Output& output) {
+  if (outputs_map->emplace(output, 0).second) {
+    region->outputs.push_back(output);
+  }
+}
+
+// Fills in the inputs and outputs of the regions.
+void ComputeRegionsBoundaries(
+    absl::Span<const Node* const> post_order, absl::Span<const Value> roots,
+    const absl::flat_hash_map<const Node*, size_t>& node_regions,
+    const absl::flat_hash_map<const Node*, size_t>& positions,
+    std::vector<OutlinedRegions::Region>* regions) {
+  auto get_region = [&](const Node* node) {
+    auto it = node_regions.find(node);
+    return it != node_regions.end() ? it->second : kNoRegion;
+  };
+  std::vector<OutputMap<size_t>> inputs_maps(regions->size());
+  std::vector<OutputMap<size_t>> outputs_maps(regions->size());
+  for (auto node : post_order) {
+    size_t region = get_region(node);
+    for (auto& operand : node->operands()) {
+      size_t operand_region = get_region(operand.node);
+      if (operand_region == region) {
+        continue;
+      }
+      if (operand_region != kNoRegion) {
+        AddRegionOutput(&(*regions)[operand_region],
+                        &outputs_maps[operand_region], operand);
+      }
+      if (region != kNoRegion &&
+          inputs_maps[region].emplace(operand, 0).second) {
+        (*regions)[region].inputs.push_back(operand);
+      }
+    }
+  }
+  for (auto& root : roots) {
+    size_t region = get_region(root.node.get());
+    if (region != kNoRegion) {
+      AddRegionOutput(&(*regions)[region], &outputs_maps[region],
+                      Output(root.node.get(), root.index));
+    }
+  }
+  for (auto& region : *regions) {
+    std::sort(region.outputs.begin(), region.outputs.end(),
+              [&](const Output& o1, const Output& o2) {
+                size_t p1 = positions.at(o1.node);
+                size_t p2 = positions.at(o2.node);
+                return p1 < p2 || (p1 == p2 && o1.index < o2.index);
+              });
+  }
+}
+
+// The key covers the structure of the region and its input shapes, but not
+// the node identities, so that the instances of a repeated layer match.
+xla::hash_t ComputeRegionKey(const OutlinedRegions::Region& region) {
+  xla::hash_t key = xla::util::MHash(region.nodes.size(), region.inputs.size(),
+                                     region.outputs.size());
+  OutputMap<size_t> inputs_map;
+  for (size_t i = 0; i < region.inputs.size(); ++i) {
+    inputs_map[region.inputs[i]] = i;
+    key = xla::util::HashCombine(
+        key, xla::util::ShapeHash(region.inputs[i].shape()));
+  }
+  absl::flat_hash_map<const Node*, size_t> positions;
+  for (size_t i = 0; i < region.nodes.size(); ++i) {
+    const Node* node = region.nodes[i];
+    positions[node] = i;
+    key = xla::util::HashCombine(key, node->node_hash());
+    key = xla::util::HashCombine(key, xla::util::ShapeHash(node->shape()));
+    for (auto& operand : node->operands()) {
+      auto it = positions.find(operand.node);
+      key = it != positions.end()
+                ? xla::util::HashCombine(
+                      key, xla::util::MHash(true, it->second, operand.index))
+                : xla::util::HashCombine(
+                      key, xla::util::MHash(false, inputs_map.at(operand)));
+    }
+  }
+  for (auto& output : region.outputs) {
+    key = xla::util::HashCombine(
+        key, xla::util::MHash(positions.at(output.node), output.index));
+  }
+  return key;
+}
+
+// Sorts the nodes outside the regions and the regions topologically, with each
+// region contracted into a single vertex. Returns the regions which could not
+// be sorted, because they are part of (or depend on) a dependency loop.
+std::vector<size_t> SortContractedGraph(
+    absl::Span<const Node* const> post_order,
+    const absl::flat_hash_map<const Node*, size_t>& node_regions,
+    const absl::flat_hash_map<const Node*, size_t>& positions,
+    size_t num_regions, std::vector<OutlinedRegions::Step>* order) {
+  // The vertices are the post-order positions of the nodes outside the
+  // regions, followed by the regions.
+  size_t num_vertices = post_order.size() + num_regions;
+  auto get_vertex = [&](const Node* node) {
+    auto it = node_regions.find(node);
+    return it != node_regions.end() ? post_order.size() + it->second
+                                    : positions.at(node);
+  };
+  std::vector<std::vector<size_t>> users(num_vertices);
+  std::vector<size_t> pending(num_vertices, 0);
+  std::vector<size_t> first_position(num_vertices,
+                                     std::numeric_limits<size_t>::max());
+  std::vector<bool> present(num_vertices, false);
+  for (size_t i = 0; i < post_order.size(); ++i) {
+    size_t vertex = get_vertex(post_order[i]);
+    present[vertex] = true;
+    first_position[vertex] = std::min(first_position[vertex], i);
+    for (auto& operand : post_order[i]->operands()) {
+      size_t operand_vertex = get_vertex(operand.node);
+      if (operand_vertex != vertex) {
+        users[operand_vertex].push_back(vertex);
+        ++pending[vertex];
+      }
+    }
+  }
+  // Ready vertices are taken in post-order, to keep the lowering order close
+  // to the one without regions.
+  using Entry = std::pair<size_t, size_t>;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> ready;
+  for (size_t vertex = 0; vertex < num_vertices; ++vertex) {
+    if (present[vertex] && pending[vertex] == 0) {
+      ready.emplace(first_position[vertex], vertex);
+    }
+  }
+  order->clear();
+  std::vector<bool> sorted(num_vertices, false);
+  while (!ready.empty()) {
+    size_t vertex = ready.top().second;
+    ready.pop();
+    sorted[vertex] = true;
+    if (vertex < post_order.size()) {
+      order->push_back({post_order[vertex], 0});
+    } else {
+      order->push_back({nullptr, vertex - post_order.size()});
+    }
+    for (size_t user : users[vertex]) {
+      if (--pending[user] == 0) {
+        ready.emplace(first_position[user], user);
+      }
+    }
+  }
+  std::vector<size_t> unsorted_regions;
+  for (size_t region = 0; region < num_regions; ++region) {
+    size_t vertex = post_order.size() + region;
+    if (present[vertex] && !sorted[vertex]) {
+      unsorted_regions.push_back(region);
+    }
+  }
+  return unsorted_regions;
+}
+
+}  // namespace
 
 std::vector<const Node*> Util::ComputePostOrder(const Node* node,
                                                 EmissionMap* emap) {
@@ -75,8 +408,12 @@ std::vector<const Node*> Util::ComputePostOrder(
 
 std::vector<const Node*> Util::ComputePostOrder(
     absl::Span<const Node* const> nodes) {
-  EmissionMap emap;
-  return ComputePostOrder(nodes, &emap);
+  std::unique_ptr<NodeMarks> marks = NodeMarks::TryAcquire();
+  if (marks == nullptr) {
+    EmissionMap emap;
+    return ComputePostOrder(nodes, &emap);
+  }
+  return ComputeMarkedPostOrder(nodes, *marks);
 }
 
 std::vector<Value> Util::Clone(absl::Span<const Value> values,
@@ -119,5 +456,406 @@ size_t Util::GetGraphSize(absl::Span<const Node* const> nodes) {
   return post_order.size();
 }
 
+std::vector<Value> Util::CloneWithReplacements(
+    absl::Span<const Value> values, const OutputMap<Value>& replacements) {
+  // Marks the nodes reachable from the roots without crossing a replaced
+  // output, which are the ones to be cloned.
+  absl::flat_hash_set<const Node*> needed;
+  std::vector<const Node*> queue;
+  for (auto& value : values) {
+    if (replacements.count(Output(value.node.get(), value.index)) == 0 &&
+        needed.insert(value.node.get()).second) {
+      queue.push_back(value.node.get());
+    }
+  }
+  for (size_t q = 0; q < queue.size(); ++q) {
+    for (auto& output : queue[q]->operands()) {
+      if (replacements.count(output) == 0 &&
+          needed.insert(output.node).second) {
+        queue.push_back(output.node);
+      }
+    }
+  }
+  std::vector<const Node*> post_order = ComputePostOrder(queue);
+
+  absl::node_hash_map<const Node*, NodePtr> clone_map;
+  auto get_value = [&](const Output& output) -> Value {
+    auto rit = replacements.find(output);
+    if (rit != replacements.end()) {
+      return rit->second;
+    }
+    auto it = clone_map.find(output.node);
+    XLA_CHECK(it != clone_map.end()) << "Bad post-order: " << output;
+    return Value(it->second, output.index);
+  };
+  for (auto node : post_order) {
+    if (needed.count(node) == 0 || clone_map.count(node) > 0) {
+      continue;
+    }
+    std::vector<Value> inputs;
+    for (auto& output : node->operands()) {
+      inputs.push_back(get_value(output));
+    }
+    clone_map[node] = node->Clone(inputs);
+  }
+
+  std::vector<Value> cloned;
+  for (auto& value : values) {
+    cloned.push_back(get_value(Output(value.node.get(), value.index)));
+  }
+  return cloned;
+}
+
+int64_t Util::GetPostOrderBytes(absl::Span<const Node* const> post_order) {
+  int64_t bytes = 0;
+  for (auto node : post_order) {
+    if (!node->operands().empty()) {
+      bytes += ArraysByteSize(node->shape());
+    }
+  }
+  return bytes;
+}
+
+std::vector<std::vector<Value>> Util::ComputeGraphCuts(
+    absl::Span<const Node* const> post_order, size_t num_chunks) {
+  struct LiveRange {
+    Value value;
+    size_t produced = 0;
+    size_t last_use = 0;
+    int64_t bytes = 0;
+  };
+  absl::flat_hash_map<const Node*, size_t> positions;
+  for (size_t i = 0; i < post_order.size(); ++i) {
+    positions.emplace(post_order[i], i);
+  }
+  OutputMap<LiveRange> ranges;
+  for (size_t i = 0; i < post_order.size(); ++i) {
+    const Node* node = post_order[i];
+    for (size_t j = 0; j < node->operands().size(); ++j) {
+      const Output& output = node->operand(j);
+      if (output.node->operands().empty()) {
+        continue;
+      }
+      auto it = ranges.find(output);
+      if (it == ranges.end()) {
+        LiveRange range;
+        range.value = Value(node->operand_nodes()[j], output.index);
+        range.produced = positions.at(output.node);
+        range.bytes = ArraysByteSize(output.node->shape(output.index));
+        it = ranges.emplace(output, std::move(range)).first;
+      }
+      it->second.last_use = i;
+    }
+  }
+  // The live bytes across the cut at position p, which runs the nodes before
+  // p in one chunk and the rest in the following ones.
+  std::vector<int64_t> live_bytes(post_order.size() + 1, 0);
+  for (auto& output_range : ranges) {
+    const LiveRange& range = output_range.second;
+    live_bytes[range.produced + 1] += range.bytes;
+    live_bytes[range.last_use + 1] -= range.bytes;
+  }
+  for (size_t p = 1; p < live_bytes.size(); ++p) {
+    live_bytes[p] += live_bytes[p - 1];
+  }
+
+  std::vector<size_t> cut_positions;
+  size_t chunk_size = post_order.size() / std::max<size_t>(num_chunks, 1);
+  size_t window = chunk_size / 4;
+  for (size_t c = 1; c < num_chunks && chunk_size > 0; ++c) {
+    size_t target = c * chunk_size;
+    size_t begin = std::max<size_t>(
+        target - window, cut_positions.empty() ? 1 : cut_positions.back() + 1);
+    size_t end = std::min<size_t>(target + window, post_order.size() - 1);
+    absl::optional<size_t> best;
+    for (size_t p = begin; p <= end; ++p) {
+      if (live_bytes[p] > 0 && (!best || live_bytes[p] < live_bytes[*best])) {
+        best = p;
+      }
+    }
+    if (best) {
+      cut_positions.push_back(*best);
+    }
+  }
+
+  std::vector<std::vector<Value>> cuts(cut_positions.size());
+  for (auto& output_range : ranges) {
+    const LiveRange& range = output_range.second;
+    for (size_t c = 0; c < cut_positions.size(); ++c) {
+      if (range.produced < cut_positions[c] &&
+          cut_positions[c] <= range.last_use) {
+        cuts[c].push_back(range.value);
+      }
+    }
+  }
+  // The iteration order of the map is arbitrary, while the cut values become
+  // the outputs of the chunk computations, whose hash must be stable.
+  for (auto& cut : cuts) {
+    std::sort(cut.begin(), cut.end(), [&](const Value& a, const Value& b) {
+      size_t a_position = positions.at(a.node.get());
+      size_t b_position = positions.at(b.node.get());
+      return a_position != b_position ? a_position < b_position
+                                      : a.index < b.index;
+    });
+  }
+  return cuts;
+}
+
+NodePaths Util::ComputeNodePaths(absl::Span<const Node* const> roots,
+                                 absl::Span<const Node* const> targets) {
+  // Breadth first visit, recording the (parent, input) discovery edge of every
+  // node, so that tracing back from a target yields its shortest path.
+  struct Discovery {
+    const Node* parent = nullptr;
+    size_t input = 0;
+    size_t order = 0;
+  };
+  absl::flat_hash_map<const Node*, Discovery> discovery;
+  std::vector<const Node*> queue;
+  for (size_t i = 0; i < roots.size(); ++i) {
+    if (discovery.emplace(roots[i], Discovery{nullptr, i, queue.size()})
+            .second) {
+      queue.push_back(roots[i]);
+    }
+  }
+  for (size_t q = 0; q < queue.size(); ++q) {
+    const Node* node = queue[q];
+    const auto& operands = node->operands();
+    for (size_t i = 0; i < operands.size(); ++i) {
+      if (discovery.emplace(operands[i].node, Discovery{node, i, queue.size()})
+              .second) {
+        queue.push_back(operands[i].node);
+      }
+    }
+  }
+
+  absl::flat_hash_map<const Node*, int64_t> target_index;
+  std::vector<size_t> needed;
+  absl::flat_hash_map<const Node*, int64_t> entry_index;
+  for (size_t i = 0; i < targets.size(); ++i) {
+    target_index.emplace(targets[i], i);
+    for (const Node* node = targets[i];
+         node != nullptr && entry_index.emplace(node, -1).second;) {
+      auto it = discovery.find(node);
+      XLA_CHECK(it != discovery.end()) << "Unreachable node: " << *node;
+      needed.push_back(it->second.order);
+      node = it->second.parent;
+    }
+  }
+  std::sort(needed.begin(), needed.end());
+
+  NodePaths paths;
+  paths.num_targets = targets.size();
+  paths.entries.reserve(needed.size());
+  for (auto order : needed) {
+    const Node* node = queue[order];
+    const Discovery& node_discovery = discovery.at(node);
+    NodePaths::Entry entry;
+    entry.parent = node_discovery.parent != nullptr
+                       ? entry_index.at(node_discovery.parent)
+                       : -1;
+    entry.input = node_discovery.input;
+    auto it = target_index.find(node);
+    if (it != target_index.end()) {
+      entry.target = it->second;
+    }
+    entry_index[node] = paths.entries.size();
+    paths.entries.push_back(entry);
+  }
+  return paths;
+}
+
+std::vector<const Node*> Util::ResolveNodePaths(
+    absl::Span<const Node* const> roots, const NodePaths& paths) {
+  std::vector<const Node*> resolved(paths.entries.size(), nullptr);
+  std::vector<const Node*> targets(paths.num_targets, nullptr);
+  for (size_t i = 0; i < paths.entries.size(); ++i) {
+    const NodePaths::Entry& entry = paths.entries[i];
+    const Node* node = nullptr;
+    if (entry.parent < 0) {
+      if (entry.input >= roots.size()) {
+        return {};
+      }
+      node = roots[entry.input];
+    } else {
+      const auto& operands = resolved[entry.parent]->operands();
+      if (entry.input >= operands.size()) {
+        return {};
+      }
+      node = operands[entry.input].node;
+    }
+    resolved[i] = node;
+    if (entry.target >= 0) {
+      targets[entry.target] = node;
+    }
+  }
+  return targets;
+}
+
+xla::hash_t Util::ComputeSharingHash(
+    absl::Span<const Node* const> post_order) {
+  absl::flat_hash_map<const Node*, size_t> positions;
+  positions.reserve(post_order.size());
+  xla::hash_t hash = xla::util::Hash(post_order.size());
+  for (auto node : post_order) {
+    hash = xla::util::HashCombine(hash, node->node_hash());
+    for (auto& operand : node->operands()) {
+      hash = xla::util::HashCombine(
+          hash, xla::util::MHash(positions.at(operand.node), operand.index));
+    }
+    positions.emplace(node, positions.size());
+  }
+  return hash;
+}
+
+Util::NodeAliases Util::ComputeCommonSubexpressions(
+    absl::Span<const Node* const> post_order) {
+  NodeAliases aliases;
+  absl::node_hash_map<xla::hash_t, const Node*> representatives;
+  for (auto node : post_order) {
+    absl::optional<xla::hash_t> key = GetCseKey(aliases, node);
+    if (!key) {
+      continue;
+    }
+    auto it = representatives.emplace(*key, node).first;
+    if (it->second != node && IsEquivalent(aliases, node, it->second)) {
+      aliases.emplace(node, it->second);
+    }
+  }
+  return aliases;
+}
+
+OutlinedRegions Util::ComputeOutlinedRegions(
+    absl::Span<const Node* const> post_order, absl::Span<const Value> roots,
+    size_t scope_depth) {
+  OutlinedRegions outlined;
+  if (scope_depth == 0) {
+    return outlined;
+  }
+  absl::flat_hash_map<const Node*, size_t> positions;
+  positions.reserve(post_order.size());
+  for (size_t i = 0; i < post_order.size(); ++i) {
+    positions[post_order[i]] = i;
+  }
+  // Group the nodes by scope.
+  std::vector<OutlinedRegions::Region> regions;
+  absl::flat_hash_map<std::string, size_t> scope_regions;
+  for (auto node : post_order) {
+    if (ops::DeviceData::Cast(node) != nullptr) {
+      continue;
+    }
+    std::string prefix = GetScopePrefix(node->metadata().scope, scope_depth);
+    if (prefix.empty()) {
+      continue;
+    }
+    auto it = scope_regions.emplace(prefix, regions.size()).first;
+    if (it->second == regions.size()) {
+      regions.emplace_back();
+    }
+    regions[it->second].nodes.push_back(node);
+  }
+  // Keep the regions which repeat, until their contraction sorts
+  // topologically. Every round drops at least one region, so it terminates.
+  std::vector<bool> dropped(regions.size(), false);
+  while (std::find(dropped.begin(), dropped.end(), false) != dropped.end()) {
+    std::vector<OutlinedRegions::Region> kept;
+    absl::flat_hash_map<const Node*, size_t> node_regions;
+    for (size_t i = 0; i < regions.size(); ++i) {
+      if (!dropped[i]) {
+        regions[i].inputs.clear();
+        regions[i].outputs.clear();
+        for (auto node : regions[i].nodes) {
+          node_regions[node] = i;
+        }
+      }
+    }
+    ComputeRegionsBoundaries(post_order, roots, node_regions, positions,
+                             &regions);
+    absl::node_hash_map<xla::hash_t, std::vector<size_t>,
+                        xla::util::HashReducer>
+        classes;
+    std::vector<xla::hash_t> class_keys;
+    for (size_t i = 0; i < regions.size(); ++i) {
+      if (dropped[i]) {
+        continue;
+      }
+      xla::hash_t key = ComputeRegionKey(regions[i]);
+      auto& instances = classes[key];
+      if (instances.empty()) {
+        class_keys.push_back(key);
+      }
+      instances.push_back(i);
+    }
+    bool singles = false;
+    for (auto& key_instances : classes) {
+      if (key_instances.second.size() < 2) {
+        dropped[key_instances.second.front()] = true;
+        singles = true;
+      }
+    }
+    if (singles) {
+      continue;
+    }
+    // Renumber the kept regions, in order of appearance.
+    std::vector<size_t> region_index(regions.size(), 0);
+    node_regions.clear();
+    outlined.num_computations = 0;
+    for (auto& key : class_keys) {
+      for (size_t i : classes.at(key)) {
+        regions[i].computation = outlined.num_computations;
+      }
+      ++outlined.num_computations;
+    }
+    for (size_t i = 0; i < regions.size(); ++i) {
+      if (!dropped[i]) {
+        region_index[i] = kept.size();
+        for (auto node : regions[i].nodes) {
+          node_regions[node] = kept.size();
+        }
+        kept.push_back(regions[i]);
+      }
+    }
+    std::vector<size_t> unsorted =
+        SortContractedGraph(post_order, node_regions, positions, kept.size(),
+                            &outlined.order);
+    if (unsorted.empty()) {
+      outlined.regions = std::move(kept);
+      break;
+    }
+    for (size_t i = 0; i < regions.size(); ++i) {
+      if (!dropped[i] &&
+          std::find(unsorted.begin(), unsorted.end(), region_index[i]) !=
+              unsorted.end()) {
+        dropped[i] = true;
+      }
+    }
+  }
+  if (outlined.regions.empty()) {
+    outlined = OutlinedRegions();
+  }
+  return outlined;
+}
+
+Value Util::FoldConstant(Value value) {
+  static const int64_t max_size =
+      xla::sys_util::GetEnvInt("XLA_FOLD_CONSTANTS_MAX_SIZE", 0);
+  if (max_size <= 0 || !IsFoldable(value.node.get(), max_size)) {
+    return value;
+  }
+  // Constant nodes hash their value, so the graph hash identifies the result.
+  FoldedConstantsCache* cache = GetFoldedConstantsCache();
+  std::shared_ptr<xla::Literal> literal = cache->Get(value.hash());
+  if (literal == nullptr) {
+    literal = EvaluateOnHost(value.node.get());
+    if (literal == nullptr) {
+      XLA_COUNTER("FoldConstantFailed", 1);
+      return value;
+    }
+    cache->Add(value.hash(), literal);
+  }
+  XLA_COUNTER("FoldConstant", 1);
+  return MakeNode<ops::Constant>(literal->Clone());
+}
+
 }  // namespace ir
 }  // namespace swift_xla
@@ -26,6 +26,56 @@
 namespace swift_xla {
 namespace ir {
 
+// Operand paths from a set of graph roots to a subset of the graph nodes (the
+// targets), stored as a flattened trie. Since the IR graph hash captures the
+// full graph structure, the paths recorded on one graph lead to the matching
+// nodes of any other graph with the same hash, without having to visit the
+// whole graph.
+struct NodePaths {
+  struct Entry {
+    // The index of the parent entry, or -1 if the input field is a root index.
+    int64_t parent = -1;
+    // The root index (if parent is -1), or the operand index within the node
+    // pointed by the parent entry.
+    size_t input = 0;
+    // The index within the targets, or -1 if this is only an internal trie
+    // entry.
+    int64_t target = -1;
+  };
+
+  // Parents always come before their children.
+  std::vector<Entry> entries;
+  size_t num_targets = 0;
+};
+
+// Scope bounded regions of a post-order which repeat with the same structure,
+// and get lowered once as a computation called by all their instances.
+struct OutlinedRegions {
+  struct Region {
+    // The region nodes, in post-order.
+    std::vector<const Node*> nodes;
+    // The outputs of the nodes outside the region used by the region nodes.
+    std::vector<Output> inputs;
+    // The outputs of the region nodes used outside the region, or which are
+    // graph roots, in region order.
+    std::vector<Output> outputs;
+    // The index of the computation shared by the equivalent regions.
+    size_t computation = 0;
+  };
+
+  // A lowering step is either a node outside the regions, or a whole region
+  // (when node is null).
+  struct Step {
+    const Node* node = nullptr;
+    size_t region = 0;
+  };
+
+  std::vector<Region> regions;
+  size_t num_computations = 0;
+  // The nodes outside the regions and the regions, in topological order.
+  std::vector<Step> order;
+};
+
 class Util {
  public:
   // Tracks the emission status of the nodes during the post-order generation.
@@ -38,6 +88,9 @@ class Util {
 
   using EmissionMap = absl::flat_hash_map<const Node*, EmitStatus>;
 
+  // Maps nodes to an equivalent node which comes earlier in post-order.
+  using NodeAliases = absl::flat_hash_map<const Node*, const Node*>;
+
   // Computes the post order from the given node, without using recursion. The
   // emission map can be used as saved state, for multiple separate calls to
   // this API. The returned post-order can be empty if the node has already been
@@ -50,7 +103,8 @@ class Util {
       absl::Span<const Node* const> nodes, EmissionMap* emap);
 
   // Same as above, but computes the post order on the set of nodes specified as
-  // argument.
+  // argument. The visited nodes are tracked with the node marks when they are
+  // available, and with an emission map otherwise.
   static std::vector<const Node*> ComputePostOrder(
       absl::Span<const Node* const> nodes);
 
@@ -64,6 +118,64 @@ class Util {
   // Retrieves the number of nodes within the graph whose sink are passed in the
   // nodes argument.
   static size_t GetGraphSize(absl::Span<const Node* const> nodes);
+
+  // Same as Clone(), but every use of an output found in the replacements map
+  // becomes a use of the mapped value instead. The part of the graph which is
+  // only reachable through replaced outputs is not cloned.
+  static std::vector<Value> CloneWithReplacements(
+      absl::Span<const Value> values, const OutputMap<Value>& replacements);
+
+  // Bytes of the outputs of the non leaf nodes within the post-order, which is
+  // what would need to be materialized to run it in pieces.
+  static int64_t GetPostOrderBytes(absl::Span<const Node* const> post_order);
+
+  // Splits the post-order in num_chunks chunks of similar node count. Every cut
+  // is placed within a window around its evenly spaced position, where the
+  // fewest bytes of non leaf outputs are live across it. Returns, for each cut,
+  // the values produced before the cut and used after it. Cuts across which
+  // only leaves are live are dropped.
+  static std::vector<std::vector<Value>> ComputeGraphCuts(
+      absl::Span<const Node* const> post_order, size_t num_chunks);
+
+  // Computes the shortest operand paths from the roots to the targets. All the
+  // targets must be reachable from the roots.
+  static NodePaths ComputeNodePaths(absl::Span<const Node* const> roots,
+                                    absl::Span<const Node* const> targets);
+
+  // Follows the paths from the roots, and returns the reached targets. Returns
+  // an empty vector if the graph structure does not match the paths.
+  static std::vector<const Node*> ResolveNodePaths(
+      absl::Span<const Node* const> roots, const NodePaths& paths);
+
+  // Hashes the node hashes of the post-order together with the post-order
+  // positions of their operands. Unlike the node hashes, which do not tell
+  // apart a shared subexpression from two identical ones, this captures how
+  // the graph shares its nodes.
+  static xla::hash_t ComputeSharingHash(
+      absl::Span<const Node* const> post_order);
+
+  // Common subexpression elimination over a post-order. Two nodes are
+  // equivalent if they have the same node hash, and their operands are the same
+  // (after aliasing) outputs. Leaves are only merged if they are constants, or
+  // device data nodes referencing the same data.
+  static NodeAliases ComputeCommonSubexpressions(
+      absl::Span<const Node* const> post_order);
+
+  // Groups the nodes of the post-order by their IR scope, truncated to its
+  // first scope_depth components, and keeps the groups which are found at
+  // least twice with the same structure (node hashes, shapes and wiring).
+  // Device data nodes never belong to a region, and the regions whose
+  // outlining would create a dependency loop are dropped. Returns no regions
+  // if none repeat.
+  static OutlinedRegions ComputeOutlinedRegions(
+      absl::Span<const Node* const> post_order, absl::Span<const Value> roots,
+      size_t scope_depth);
+
+  // If the node generating the value only has constant operands, and its
+  // output has at most XLA_FOLD_CONSTANTS_MAX_SIZE elements, evaluates it on
+  // the host and returns a constant node holding the result. Otherwise returns
+  // the input value.
+  static Value FoldConstant(Value value);
 };
 
 }  // namespace ir
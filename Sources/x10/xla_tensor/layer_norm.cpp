@@ -0,0 +1,236 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/layer_norm.h"
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+
+namespace swift_xla {
+namespace {
+
+// The half precision inputs get their statistics accumulated at F32.
+xla::PrimitiveType GetAccumulationType(xla::PrimitiveType type) {
+  return type == xla::PrimitiveType::BF16 || type == xla::PrimitiveType::F16
+             ? xla::PrimitiveType::F32
+             : type;
+}
+
+xla::XlaOp MaybeConvertTo(xla::XlaOp input, xla::PrimitiveType type) {
+  return XlaHelpers::TypeOfXlaOp(input) != type
+             ? xla::ConvertElementType(input, type)
+             : input;
+}
+
+// All the dimensions but dim, which map the statistics into the input shape.
+std::vector<int64_t> StatsDimensions(int64_t rank, int64_t dim) {
+  std::vector<int64_t> dims;
+  for (int64_t i = 0; i < rank; ++i) {
+    if (i != dim) {
+      dims.push_back(i);
+    }
+  }
+  return dims;
+}
+
+// Merges the (count, mean, m2) moments of two sets of values, where m2 is the
+// sum of the squared differences from the mean, as in Chan et al.
+xla::XlaComputation CreateWelfordComputation(xla::PrimitiveType type) {
+  xla::XlaBuilder builder("WelfordComputation");
+  xla::Shape scalar_shape = xla::ShapeUtil::MakeShape(type, {});
+  xla::XlaOp count_a = xla::Parameter(&builder, 0, scalar_shape, "count_a");
+  xla::XlaOp mean_a = xla::Parameter(&builder, 1, scalar_shape, "mean_a");
+  xla::XlaOp m2_a = xla::Parameter(&builder, 2, scalar_shape, "m2_a");
+  xla::XlaOp count_b = xla::Parameter(&builder, 3, scalar_shape, "count_b");
+  xla::XlaOp mean_b = xla::Parameter(&builder, 4, scalar_shape, "mean_b");
+  xla::XlaOp m2_b = xla::Parameter(&builder, 5, scalar_shape, "m2_b");
+  xla::XlaOp zero = xla::Zero(&builder, type);
+  xla::XlaOp count = count_a + count_b;
+  // Both sides can be the empty init value.
+  xla::XlaOp ratio = xla::Select(xla::Gt(count, zero), count_b / count, zero);
+  xla::XlaOp delta = mean_b - mean_a;
+  xla::XlaOp mean = mean_a + delta * ratio;
+  xla::XlaOp m2 = m2_a + m2_b + delta * delta * count_a * ratio;
+  xla::Tuple(&builder, {count, mean, m2});
+  return ConsumeValue(builder.Build());
+}
+
+xla::XlaComputation CreateAddTupleComputation(xla::PrimitiveType type,
+                                              int64_t count) {
+  xla::XlaBuilder builder("AddTupleComputation");
+  xla::Shape scalar_shape = xla::ShapeUtil::MakeShape(type, {});
+  std::vector<xla::XlaOp> lhs;
+  std::vector<xla::XlaOp> sums;
+  for (int64_t i = 0; i < count; ++i) {
+    lhs.push_back(xla::Parameter(&builder, i, scalar_shape,
+                                 absl::StrCat("lhs", i)));
+  }
+  for (int64_t i = 0; i < count; ++i) {
+    sums.push_back(lhs[i] + xla::Parameter(&builder, count + i, scalar_shape,
+                                           absl::StrCat("rhs", i)));
+  }
+  xla::Tuple(&builder, sums);
+  return ConsumeValue(builder.Build());
+}
+
+// Sums all the operands along the dimensions with a single variadic reduction,
+// so that the input gets read once.
+std::vector<xla::XlaOp> ReduceSums(absl::Span<const xla::XlaOp> operands,
+                                   absl::Span<const int64_t> dimensions) {
+  xla::XlaBuilder* builder = operands.front().builder();
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(operands.front());
+  std::vector<xla::XlaOp> init_values(operands.size(),
+                                      xla::Zero(builder, type));
+  xla::XlaOp sums = xla::Reduce(
+      builder, operands, init_values,
+      CreateAddTupleComputation(type, operands.size()), dimensions);
+  std::vector<xla::XlaOp> results;
+  for (size_t i = 0; i < operands.size(); ++i) {
+    results.push_back(xla::GetTupleElement(sums, i));
+  }
+  return results;
+}
+
+struct WelfordMoments {
+  xla::XlaOp mean;
+  xla::XlaOp variance;
+};
+
+WelfordMoments BuildWelfordMoments(xla::XlaOp input, int64_t dim) {
+  xla::XlaBuilder* builder = input.builder();
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(input);
+  std::vector<int64_t> sizes = XlaHelpers::SizesOfXlaOp(input);
+  xla::XlaOp zero = xla::Zero(builder, type);
+  xla::XlaOp moments = xla::Reduce(
+      builder,
+      {xla::Broadcast(xla::One(builder, type), sizes), input,
+       xla::Broadcast(zero, sizes)},
+      {zero, zero, zero}, CreateWelfordComputation(type), {dim});
+  WelfordMoments result;
+  result.mean = xla::GetTupleElement(moments, 1);
+  result.variance =
+      xla::GetTupleElement(moments, 2) / xla::GetTupleElement(moments, 0);
+  return result;
+}
+
+xla::XlaOp InverseFeatureCount(xla::XlaOp input, int64_t dim,
+                               xla::PrimitiveType type) {
+  int64_t count = XlaHelpers::ShapeOfXlaOp(input).dimensions(dim);
+  return XlaHelpers::ScalarValue<double>(1.0 / count, type, input.builder());
+}
+
+}  // namespace
+
+LayerNormOutput BuildLayerNorm(xla::XlaOp input, xla::XlaOp weight,
+                               xla::XlaOp bias, int64_t dim, float eps_value) {
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(input);
+  xla::PrimitiveType accumulation_type = GetAccumulationType(type);
+  xla::XlaOp x = MaybeConvertTo(input, accumulation_type);
+  std::vector<int64_t> stats_dims =
+      StatsDimensions(XlaHelpers::ShapeOfXlaOp(x).rank(), dim);
+  WelfordMoments moments = BuildWelfordMoments(x, dim);
+  xla::XlaOp eps =
+      XlaHelpers::ScalarValue(eps_value, accumulation_type, input.builder());
+  xla::XlaOp invstd = xla::Rsqrt(moments.variance + eps);
+  xla::XlaOp normalized =
+      xla::Mul(xla::Sub(x, moments.mean, stats_dims), invstd, stats_dims);
+  xla::XlaOp output = xla::Add(
+      xla::Mul(normalized, MaybeConvertTo(weight, accumulation_type), {dim}),
+      MaybeConvertTo(bias, accumulation_type), {dim});
+  return {MaybeConvertTo(output, type), MaybeConvertTo(moments.mean, type),
+          MaybeConvertTo(invstd, type)};
+}
+
+LayerNormGrads BuildLayerNormBackward(xla::XlaOp grad, xla::XlaOp input,
+                                      xla::XlaOp weight, xla::XlaOp mean,
+                                      xla::XlaOp invstd, int64_t dim) {
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(input);
+  xla::PrimitiveType accumulation_type = GetAccumulationType(type);
+  xla::XlaOp x = MaybeConvertTo(input, accumulation_type);
+  xla::XlaOp g = MaybeConvertTo(grad, accumulation_type);
+  invstd = MaybeConvertTo(invstd, accumulation_type);
+  std::vector<int64_t> stats_dims =
+      StatsDimensions(XlaHelpers::ShapeOfXlaOp(x).rank(), dim);
+  xla::XlaOp normalized = xla::Mul(
+      xla::Sub(x, MaybeConvertTo(mean, accumulation_type), stats_dims),
+      invstd, stats_dims);
+  xla::XlaOp grad_normalized =
+      xla::Mul(g, MaybeConvertTo(weight, accumulation_type), {dim});
+  std::vector<xla::XlaOp> row_sums =
+      ReduceSums({grad_normalized, grad_normalized * normalized}, {dim});
+  xla::XlaOp inv_count = InverseFeatureCount(x, dim, accumulation_type);
+  xla::XlaOp grad_input = xla::Mul(
+      xla::Sub(xla::Sub(grad_normalized, row_sums[0] * inv_count, stats_dims),
+               xla::Mul(normalized, row_sums[1] * inv_count, stats_dims)),
+      invstd, stats_dims);
+  std::vector<xla::XlaOp> feature_sums =
+      ReduceSums({g * normalized, g}, stats_dims);
+  return {MaybeConvertTo(grad_input, type),
+          MaybeConvertTo(feature_sums[0], type),
+          MaybeConvertTo(feature_sums[1], type)};
+}
+
+RmsNormOutput BuildRmsNorm(xla::XlaOp input, xla::XlaOp weight, int64_t dim,
+                           float eps_value) {
+  xla::XlaBuilder* builder = input.builder();
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(input);
+  xla::PrimitiveType accumulation_type = GetAccumulationType(type);
+  xla::XlaOp x = MaybeConvertTo(input, accumulation_type);
+  std::vector<int64_t> stats_dims =
+      StatsDimensions(XlaHelpers::ShapeOfXlaOp(x).rank(), dim);
+  xla::XlaOp mean_square =
+      xla::Reduce(x * x, xla::Zero(builder, accumulation_type),
+                  XlaHelpers::CreateAddComputation(accumulation_type), {dim}) *
+      InverseFeatureCount(x, dim, accumulation_type);
+  xla::XlaOp eps =
+      XlaHelpers::ScalarValue(eps_value, accumulation_type, builder);
+  xla::XlaOp invrms = xla::Rsqrt(mean_square + eps);
+  xla::XlaOp output =
+      xla::Mul(xla::Mul(x, invrms, stats_dims),
+               MaybeConvertTo(weight, accumulation_type), {dim});
+  return {MaybeConvertTo(output, type), MaybeConvertTo(invrms, type)};
+}
+
+RmsNormGrads BuildRmsNormBackward(xla::XlaOp grad, xla::XlaOp input,
+                                  xla::XlaOp weight, xla::XlaOp invrms,
+                                  int64_t dim) {
+  xla::XlaBuilder* builder = input.builder();
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(input);
+  xla::PrimitiveType accumulation_type = GetAccumulationType(type);
+  xla::XlaOp x = MaybeConvertTo(input, accumulation_type);
+  xla::XlaOp g = MaybeConvertTo(grad, accumulation_type);
+  invrms = MaybeConvertTo(invrms, accumulation_type);
+  std::vector<int64_t> stats_dims =
+      StatsDimensions(XlaHelpers::ShapeOfXlaOp(x).rank(), dim);
+  xla::XlaOp normalized = xla::Mul(x, invrms, stats_dims);
+  xla::XlaOp grad_normalized =
+      xla::Mul(g, MaybeConvertTo(weight, accumulation_type), {dim});
+  xla::XlaOp row_mean =
+      xla::Reduce(grad_normalized * normalized,
+                  xla::Zero(builder, accumulation_type),
+                  XlaHelpers::CreateAddComputation(accumulation_type), {dim}) *
+      InverseFeatureCount(x, dim, accumulation_type);
+  xla::XlaOp grad_input = xla::Mul(
+      xla::Sub(grad_normalized, xla::Mul(normalized, row_mean, stats_dims)),
+      invrms, stats_dims);
+  xla::XlaOp grad_weight =
+      xla::Reduce(g * normalized, xla::Zero(builder, accumulation_type),
+                  XlaHelpers::CreateAddComputation(accumulation_type),
+                  stats_dims);
+  return {MaybeConvertTo(grad_input, type), MaybeConvertTo(grad_weight, type)};
+}
+
+}  // namespace swift_xla
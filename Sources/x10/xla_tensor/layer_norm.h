@@ -0,0 +1,64 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+
+namespace swift_xla {
+
+// The layer and RMS normalizations reduce along a single dimension, which the
+// rank 1 weight and bias get broadcast along. The statistics have the input
+// shape with that dimension removed, and are saved for the backward pass.
+
+struct LayerNormOutput {
+  xla::XlaOp output;
+  xla::XlaOp mean;
+  xla::XlaOp invstd;
+};
+
+struct LayerNormGrads {
+  xla::XlaOp grad_input;
+  xla::XlaOp grad_weight;
+  xla::XlaOp grad_bias;
+};
+
+struct RmsNormOutput {
+  xla::XlaOp output;
+  xla::XlaOp invrms;
+};
+
+struct RmsNormGrads {
+  xla::XlaOp grad_input;
+  xla::XlaOp grad_weight;
+};
+
+// The mean and variance come out of a single Welford reduction over the input.
+LayerNormOutput BuildLayerNorm(xla::XlaOp input, xla::XlaOp weight,
+                               xla::XlaOp bias, int64_t dim, float eps_value);
+
+LayerNormGrads BuildLayerNormBackward(xla::XlaOp grad, xla::XlaOp input,
+                                      xla::XlaOp weight, xla::XlaOp mean,
+                                      xla::XlaOp invstd, int64_t dim);
+
+RmsNormOutput BuildRmsNorm(xla::XlaOp input, xla::XlaOp weight, int64_t dim,
+                           float eps_value);
+
+RmsNormGrads BuildRmsNormBackward(xla::XlaOp grad, xla::XlaOp input,
+                                  xla::XlaOp weight, xla::XlaOp invrms,
+                                  int64_t dim);
+
+}  // namespace swift_xla
@@ -16,15 +16,20 @@
 
 #include <algorithm>
 #include <exception>
+#include <fstream>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <unordered_map>
 
 #include "absl/container/node_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
 #include "absl/strings/str_split.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
@@ -33,6 +38,28 @@
 namespace swift_xla {
 namespace {
 
+bool IsLayoutAutotuneEnabled() {
+  static const bool autotune =
+      xla::sys_util::GetEnvBool("XLA_LAYOUT_AUTOTUNE", false);
+  return autotune;
+}
+
+std::vector<int64_t> MakeSortedLayout(absl::Span<const int64_t> dimensions) {
+  // Place bigger dimensions on most minor layout locations.
+  std::vector<int64_t> layout =
+      xla::util::Iota<int64_t>(dimensions.size(), dimensions.size() - 1, -1);
+  std::sort(layout.begin(), layout.end(), [&](int64_t a, int64_t b) {
+    return dimensions[a] > dimensions[b];
+  });
+  return layout;
+}
+
+xla::Shape MakeShapeWithSortedLayout(absl::Span<const int64_t> dimensions,
+                                     xla::PrimitiveType type) {
+  return xla::ShapeUtil::MakeShapeWithLayout(type, dimensions,
+                                             MakeSortedLayout(dimensions));
+}
+
 class LayoutManager {
  public:
   static LayoutManager* Get() {
@@ -46,6 +73,29 @@ class LayoutManager {
     return it != layouts_.end() ? &it->second->layout : nullptr;
   }
 
+  // Returns the TPU layout with the least tile padding for the dimensions,
+  // picking it the first time and recording it in the layouts file, if any.
+  std::vector<int64_t> GetTunedLayout(absl::Span<const int64_t> dimensions) {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto it = tuned_layouts_.find(dimensions);
+    if (it != tuned_layouts_.end()) {
+      return it->second->layout;
+    }
+    auto entry = std::make_shared<LayoutEntry>();
+    entry->dimensions.assign(dimensions.begin(), dimensions.end());
+    entry->layout = TuneTpuLayout(dimensions);
+    tuned_layouts_.emplace(entry->dimensions, entry);
+    XLA_COUNTER("TunedLayouts", 1);
+    if (!tuned_layouts_path_.empty()) {
+      std::ofstream layouts_file(tuned_layouts_path_, std::ios_base::app);
+      layouts_file << absl::StrJoin(entry->dimensions, ",") << "="
+                   << absl::StrJoin(entry->layout, ",") << "\n";
+    }
+    TF_VLOG(2) << "Tuned layout " << absl::StrJoin(entry->layout, ",")
+               << " for shape " << absl::StrJoin(entry->dimensions, ",");
+    return entry->layout;
+  }
+
  private:
   struct LayoutEntry {
     std::vector<int64_t> dimensions;
@@ -62,7 +112,10 @@ class LayoutManager {
       absl::node_hash_map<absl::Span<const int64_t>,
                           std::shared_ptr<LayoutEntry>, DimensionsHasher>;
 
-  LayoutManager() { PopulateLayouts(); }
+  LayoutManager() {
+    PopulateLayouts();
+    PopulateTunedLayouts();
+  }
 
   // TODO(asuhan): Return status.
   void PopulateLayouts() {
@@ -73,18 +126,84 @@ class LayoutManager {
     if (!layouts_env.empty()) {
       std::vector<std::string> layouts = absl::StrSplit(layouts_env, ';');
       for (const auto& layout_str : layouts) {
-        std::vector<std::string> parts = absl::StrSplit(layout_str, '=');
-        XLA_CHECK_EQ(parts.size(), 2) << layout_str;
+        AddLayout(layout_str, &layouts_);
+      }
+    }
+  }
 
-        auto entry = std::make_shared<LayoutEntry>();
-        entry->dimensions = ParseIntList(parts[0]);
-        entry->layout = ParseLayout(parts[1], entry->dimensions.size());
-        layouts_.emplace(entry->dimensions, entry);
+  // The tuned layouts are kept next to the persistent compilation cache, one
+  // SHAPE=LAYOUT per line, so that later runs reuse them, and keep hitting the
+  // cached computations whose parameters have those layouts.
+  void PopulateTunedLayouts() {
+    std::string cache_path =
+        xla::sys_util::GetEnvString("XLA_PERSISTENT_CACHE_PATH", "");
+    if (cache_path.empty() || !IsLayoutAutotuneEnabled()) {
+      return;
+    }
+    tuned_layouts_path_ = absl::StrCat(cache_path, "/tpu_layouts");
+    std::ifstream layouts_file(tuned_layouts_path_);
+    std::string line;
+    while (std::getline(layouts_file, line)) {
+      if (!line.empty()) {
+        AddLayout(line, &tuned_layouts_);
+      }
+    }
+  }
+
+  static void AddLayout(const std::string& layout_str, LayoutMap* layouts) {
+    std::vector<std::string> parts = absl::StrSplit(layout_str, '=');
+    XLA_CHECK_EQ(parts.size(), 2) << layout_str;
+
+    auto entry = std::make_shared<LayoutEntry>();
+    entry->dimensions = ParseIntList(parts[0]);
+    entry->layout = ParseLayout(parts[1], entry->dimensions.size());
+    layouts->emplace(entry->dimensions, entry);
+
+    TF_VLOG(2) << "Registering layout " << parts[1] << " for shape "
+               << parts[0];
+  }
 
-        TF_VLOG(2) << "Registering layout " << parts[1] << " for shape "
-                   << parts[0];
+  // The TPU tiles the two most minor dimensions of an array by 8x128, so the
+  // shape takes the padded size of those, times the other dimensions.
+  static int64_t TpuPaddedSize(absl::Span<const int64_t> dimensions,
+                               absl::Span<const int64_t> layout) {
+    auto round_up = [](int64_t size, int64_t tile) {
+      return (size + tile - 1) / tile * tile;
+    };
+    int64_t size = round_up(dimensions[layout[0]], 128) *
+                   round_up(dimensions[layout[1]], 8);
+    for (size_t i = 2; i < layout.size(); ++i) {
+      size *= dimensions[layout[i]];
+    }
+    return size;
+  }
+
+  // Picks the layout with the least padding among the permutations of the
+  // dimensions, or among the descending and sorted layouts for the ranks
+  // above kMaxPermutedRank. Ties keep the descending layout, which needs no
+  // transposes around host transfers.
+  static std::vector<int64_t> TuneTpuLayout(
+      absl::Span<const int64_t> dimensions) {
+    constexpr size_t kMaxPermutedRank = 5;
+    std::vector<int64_t> best =
+        xla::util::Iota<int64_t>(dimensions.size(), dimensions.size() - 1, -1);
+    int64_t best_size = TpuPaddedSize(dimensions, best);
+    auto consider = [&](const std::vector<int64_t>& layout) {
+      int64_t size = TpuPaddedSize(dimensions, layout);
+      if (size < best_size) {
+        best = layout;
+        best_size = size;
       }
+    };
+    if (dimensions.size() <= kMaxPermutedRank) {
+      std::vector<int64_t> layout = xla::util::Iota<int64_t>(dimensions.size());
+      do {
+        consider(layout);
+      } while (std::next_permutation(layout.begin(), layout.end()));
+    } else {
+      consider(MakeSortedLayout(dimensions));
     }
+    return best;
   }
 
   static std::vector<int64_t> ParseIntList(const std::string& list_str) {
@@ -111,6 +230,9 @@ class LayoutManager {
   }
 
   LayoutMap layouts_;
+  std::mutex lock_;
+  LayoutMap tuned_layouts_;
+  std::string tuned_layouts_path_;
 };
 
 double PaddingFactor(int64_t size, int padding) {
@@ -120,17 +242,6 @@ double PaddingFactor(int64_t size, int padding) {
                         : 0.0);
 }
 
-xla::Shape MakeShapeWithSortedLayout(absl::Span<const int64_t> dimensions,
-                                     xla::PrimitiveType type) {
-  // Place bigger dimensions on most minor layout locations.
-  std::vector<int64_t> layout =
-      xla::util::Iota<int64_t>(dimensions.size(), dimensions.size() - 1, -1);
-  std::sort(layout.begin(), layout.end(), [&](int64_t a, int64_t b) {
-    return dimensions[a] > dimensions[b];
-  });
-  return xla::ShapeUtil::MakeShapeWithLayout(type, dimensions, layout);
-}
-
 xla::Shape* SetDynamicDimensions(xla::Shape* shape,
                                  absl::Span<const bool> dynamic_dimensions) {
   if (!dynamic_dimensions.empty()) {
@@ -148,7 +259,10 @@ xla::Shape MakeTpuShape(absl::Span<const int64_t> dimensions,
   static double max_padding_factor =
       xla::sys_util::GetEnvDouble("XLA_MAX_PADDING_FACTOR", 1.25);
   xla::Shape shape;
-  if (PaddingFactor(dimensions[dimensions.size() - 1], 128) *
+  if (IsLayoutAutotuneEnabled()) {
+    shape = xla::ShapeUtil::MakeShapeWithLayout(
+        type, dimensions, LayoutManager::Get()->GetTunedLayout(dimensions));
+  } else if (PaddingFactor(dimensions[dimensions.size() - 1], 128) *
           PaddingFactor(dimensions[dimensions.size() - 2], 8) <
       max_padding_factor) {
     shape = xla::ShapeUtil::MakeShapeWithDescendingLayout(type, dimensions);
@@ -195,4 +309,16 @@ xla::Shape MakeArrayShapeFromDimensions(
   return MakeSwiftTensorLayout(dimensions, dynamic_dimensions, type);
 }
 
+bool PreferChannelsLastConvolution(DeviceType device_type) {
+  // Negative means the device type decides, zero and positive force channels
+  // first and channels last respectively.
+  static const int channels_last =
+      xla::sys_util::GetEnvInt("XLA_CONV_CHANNELS_LAST", -1);
+  if (channels_last >= 0) {
+    return channels_last > 0;
+  }
+  return device_type == DeviceType::GPU || device_type == DeviceType::TPU ||
+         device_type == DeviceType::REMOTE_TPU;
+}
+
 }  // namespace swift_xla
@@ -38,4 +38,12 @@ xla::Shape MakeArrayShapeFromDimensions(
     absl::Span<const bool> dynamic_dimensions, xla::PrimitiveType type,
     DeviceType device_type);
 
+// Whether the channels first convolutions lowered for the given device type
+// should run on channels last activations, which the GPU and TPU convolution
+// emitters favour. The activations then get transposed around the convolution,
+// and the XLA layout assignment folds those transposes into the layouts of the
+// adjacent operations, instead of copying the data in and out of each
+// convolution.
+bool PreferChannelsLastConvolution(DeviceType device_type);
+
 }  // namespace swift_xla
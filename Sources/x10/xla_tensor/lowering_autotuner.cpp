@@ -0,0 +1,196 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_autotuner.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/client/lib/arithmetic.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/literal.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+
+namespace swift_xla {
+namespace {
+
+class LoweringAutotuner {
+ public:
+  static LoweringAutotuner* Get() {
+    static LoweringAutotuner* tuner = new LoweringAutotuner();
+    return tuner;
+  }
+
+  size_t Choose(const std::string& name,
+                absl::Span<const xla::Shape> operand_shapes,
+                absl::Span<const LoweringFn> lowerings) {
+    Device device = GetCurrentDevice();
+    std::string key = MakeKey(name, device, operand_shapes);
+    std::lock_guard<std::mutex> lock(lock_);
+    auto it = choices_.find(key);
+    if (it != choices_.end() && it->second < lowerings.size()) {
+      return it->second;
+    }
+    size_t choice = Tune(device, operand_shapes, lowerings);
+    choices_[key] = choice;
+    XLA_COUNTER("TunedLowerings", 1);
+    if (!choices_path_.empty()) {
+      std::ofstream choices_file(choices_path_, std::ios_base::app);
+      choices_file << key << "=" << choice << "\n";
+    }
+    TF_VLOG(2) << "Tuned lowering " << choice << " for " << key;
+    return choice;
+  }
+
+ private:
+  // The choices are kept one KEY=CHOICE per line, where the key holds the
+  // lowering name, the device kind and the operand shapes.
+  LoweringAutotuner() {
+    std::string cache_path =
+        xla::sys_util::GetEnvString("XLA_PERSISTENT_CACHE_PATH", "");
+    if (cache_path.empty()) {
+      return;
+    }
+    choices_path_ = absl::StrCat(cache_path, "/lowering_choices");
+    std::ifstream choices_file(choices_path_);
+    std::string line;
+    while (std::getline(choices_file, line)) {
+      size_t pos = line.rfind('=');
+      if (pos != std::string::npos) {
+        choices_[line.substr(0, pos)] = std::stoul(line.substr(pos + 1));
+      }
+    }
+  }
+
+  static std::string MakeKey(const std::string& name, const Device& device,
+                             absl::Span<const xla::Shape> operand_shapes) {
+    std::string device_kind = device.ToString();
+    device_kind = device_kind.substr(0, device_kind.find(':'));
+    return absl::StrCat(
+        name, ";", device_kind, ";",
+        absl::StrJoin(operand_shapes, ";",
+                      [](std::string* out, const xla::Shape& shape) {
+                        absl::StrAppend(out,
+                                        xla::ShapeUtil::HumanString(shape));
+                      }));
+  }
+
+  static size_t Tune(const Device& device,
+                     absl::Span<const xla::Shape> operand_shapes,
+                     absl::Span<const LoweringFn> lowerings) {
+    static const int64_t num_runs =
+        xla::sys_util::GetEnvInt("XLA_LOWERING_AUTOTUNE_RUNS", 3);
+    xla::ComputationClient::Device* x10_device = xla::GetX10Device(device);
+    std::vector<xla::Shape> device_shapes;
+    std::vector<xla::ComputationClient::DataPtr> arguments;
+    for (const xla::Shape& shape : operand_shapes) {
+      xla::Shape host_shape = xla::ShapeUtil::MakeShapeWithDescendingLayout(
+          shape.element_type(), shape.dimensions());
+      xla::Literal literal = xla::Literal::CreateFromShape(host_shape);
+      xla::BorrowingLiteral borrowing_literal(
+          static_cast<const char*>(literal.untyped_data()), host_shape);
+      device_shapes.push_back(
+          MakeShapeWithDeviceLayout(host_shape, device.hw_type));
+      arguments.push_back(x10_device->TransferToServer(
+          std::move(borrowing_literal), device_shapes.back()));
+    }
+    // The results get summed, so that waiting for a run only transfers back a
+    // scalar.
+    std::vector<xla::Shape> result_shapes(lowerings.size());
+    std::vector<xla::ComputationClient::CompileInstance> instances;
+    for (size_t i = 0; i < lowerings.size(); ++i) {
+      xla::XlaBuilder builder(absl::StrCat("LoweringAutotune", i));
+      std::vector<xla::XlaOp> parameters;
+      for (size_t j = 0; j < device_shapes.size(); ++j) {
+        parameters.push_back(xla::Parameter(&builder, j, device_shapes[j],
+                                            absl::StrCat("p", j)));
+      }
+      xla::XlaOp result = lowerings[i](parameters);
+      xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(result);
+      xla::ReduceAll(result, xla::Zero(&builder, type),
+                     XlaHelpers::CreateAddComputation(type));
+      xla::XlaComputation computation = ConsumeValue(builder.Build());
+      xla::ProgramShape program_shape =
+          ConsumeValue(computation.GetProgramShape());
+      result_shapes[i] =
+          MakeShapeWithDeviceLayout(program_shape.result(), device.hw_type);
+      instances.push_back({std::move(computation), &result_shapes[i]});
+    }
+    std::vector<xla::ComputationClient::ComputationPtr> computations =
+        x10_device->Compile(xla::ComputationClient::GetCompilationDevices(
+                                device.ToString(), {}),
+                            std::move(instances));
+    size_t best = 0;
+    int64_t best_ns = std::numeric_limits<int64_t>::max();
+    for (size_t i = 0; i < computations.size(); ++i) {
+      // The first run is a warmup.
+      int64_t run_ns = std::numeric_limits<int64_t>::max();
+      for (int64_t run = 0; run <= num_runs; ++run) {
+        int64_t start_ns = xla::sys_util::NowNs();
+        std::vector<xla::ComputationClient::DataPtr> results =
+            x10_device->ExecuteComputation(
+                *computations[i], arguments,
+                xla::ComputationClient::ExecuteComputationOptions());
+        xla::ComputationClient::TransferFromServer(results);
+        if (run > 0) {
+          run_ns = std::min(run_ns, xla::sys_util::NowNs() - start_ns);
+        }
+      }
+      TF_VLOG(3) << "Lowering " << i << " ran in " << run_ns << " ns";
+      if (run_ns < best_ns) {
+        best = i;
+        best_ns = run_ns;
+      }
+    }
+    return best;
+  }
+
+  std::mutex lock_;
+  std::unordered_map<std::string, size_t> choices_;
+  std::string choices_path_;
+};
+
+}  // namespace
+
+bool IsLoweringAutotuneEnabled() {
+  static const bool autotune =
+      xla::sys_util::GetEnvBool("XLA_LOWERING_AUTOTUNE", false);
+  return autotune;
+}
+
+size_t ChooseFastestLowering(const std::string& name,
+                             absl::Span<const xla::Shape> operand_shapes,
+                             absl::Span<const LoweringFn> lowerings) {
+  XLA_CHECK(!lowerings.empty());
+  if (lowerings.size() == 1) {
+    return 0;
+  }
+  return LoweringAutotuner::Get()->Choose(name, operand_shapes, lowerings);
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+#include "tensorflow/compiler/xla/shape.h"
+
+namespace swift_xla {
+
+// Builds the result of an op from its operands, one way among others.
+using LoweringFn = std::function<xla::XlaOp(absl::Span<const xla::XlaOp>)>;
+
+// Whether the lowerings which have alternatives (like the dense and sparse
+// gathers) get picked by timing them, instead of by fixed heuristics. Set by
+// the XLA_LOWERING_AUTOTUNE environment variable.
+bool IsLoweringAutotuneEnabled();
+
+// Returns the index of the fastest of the lowerings over operands of the given
+// shapes, on the current device. The first time a name, device kind and shapes
+// combination comes up, every lowering is compiled and timed over zero filled
+// operands. The choices are kept next to the persistent compilation cache, if
+// any, so that later runs reuse them, and keep hitting the cached computations
+// built with them.
+size_t ChooseFastestLowering(const std::string& name,
+                             absl::Span<const xla::Shape> operand_shapes,
+                             absl::Span<const LoweringFn> lowerings);
+
+}  // namespace swift_xla
@@ -18,6 +18,9 @@
 #include <stdexcept>
 
 #include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/collective_profiler.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 
@@ -28,7 +31,8 @@ namespace {
 class HloMetadataSetter {
  public:
   HloMetadataSetter(LoweringContext* loctx, const Node* node) {
-    if (ShouldPopulateXlaOpMetadata()) {
+    if (ShouldPopulateXlaOpMetadata() ||
+        (IsCollectiveProfilingEnabled() && IsCollective(node->op()))) {
       PopulateXlaOpMetadata(loctx, node);
       loctx_ = loctx;
     }
@@ -46,6 +50,15 @@ class HloMetadataSetter {
     return op_metadata;
   }
 
+  // The collectives always carry their IR scope when profiled, so that their
+  // metrics and device profiles can be traced back to the model code.
+  static bool IsCollective(const OpKind& op) {
+    return op == ops::xla_cross_replica_sum || op == ops::xla_all_gather ||
+           op == ops::xla_reduce_scatter || op == ops::xla_all_to_all ||
+           op == ops::xla_collective_permute || op == ops::xla_moe_dispatch ||
+           op == ops::xla_moe_combine;
+  }
+
   static void PopulateXlaOpMetadata(LoweringContext* loctx, const Node* node) {
     xla::OpMetadata metadata;
     metadata.set_op_type(node->op().ToString());
@@ -59,26 +72,66 @@ class HloMetadataSetter {
   LoweringContext* loctx_ = nullptr;
 };
 
+// The reduced precision type which the XLA_AUTOCAST=bf16|fp16 autocast runs
+// the matrix multiplications and convolutions in, or PRIMITIVE_TYPE_INVALID if
+// the autocast is disabled.
+xla::PrimitiveType GetAutocastType() {
+  static const xla::PrimitiveType autocast_type = []() {
+    std::string type = xla::sys_util::GetEnvString("XLA_AUTOCAST", "");
+    if (type.empty()) {
+      return xla::PrimitiveType::PRIMITIVE_TYPE_INVALID;
+    }
+    if (type == "bf16") {
+      return xla::PrimitiveType::BF16;
+    }
+    if (type == "fp16") {
+      return xla::PrimitiveType::F16;
+    }
+    XLA_ERROR() << "Invalid XLA_AUTOCAST value: " << type;
+  }();
+  return autocast_type;
+}
+
+// The ops which the autocast lowers in reduced precision. Everything else,
+// reductions, softmax and normalizations included, keeps its own type.
+bool IsAutocastOp(const OpKind& op) {
+  return op == OpKind(at::aten::mm) || op == OpKind(at::aten::matmul) ||
+         op == OpKind(at::aten::tf_convolution) ||
+         op == OpKind(at::aten::tf_conv_backprop_filter) ||
+         op == OpKind(at::aten::tf_conv_backprop_input);
+}
+
 }  // namespace
 
 LoweringContext::LoweringContext(xla::XlaBuilder* builder, Device device)
     : builder_ptr_(builder), device_(std::move(device)) {}
 LoweringContext::LoweringContext(xla::XlaBuilder* builder, Device device,
-                                 Util::EmissionMap emit_status)
+                                 Util::EmissionMap emit_status,
+                                 Util::NodeAliases node_aliases)
     : builder_ptr_(builder),
       device_(std::move(device)),
-      emit_status_(std::move(emit_status)) {}
+      emit_status_(std::move(emit_status)),
+      node_aliases_(std::move(node_aliases)) {}
 
 RootLoweringContext::RootLoweringContext(const std::string& name, Device device)
     : LoweringContext(&builder_, std::move(device)), builder_(name) {}
 
 RootLoweringContext::RootLoweringContext(
     const std::string& name, Device device,
-    absl::Span<const Node* const> post_order, Util::EmissionMap emit_status)
-    : LoweringContext(&builder_, std::move(device), std::move(emit_status)),
+    absl::Span<const Node* const> post_order, Util::EmissionMap emit_status,
+    Util::NodeAliases node_aliases, const OutlinedRegions& outlined_regions)
+    : LoweringContext(&builder_, std::move(device), std::move(emit_status),
+                      std::move(node_aliases)),
       builder_(name) {
+  InitDenseOutputs(post_order);
+  if (!outlined_regions.regions.empty()) {
+    LowerOutlined(outlined_regions);
+    return;
+  }
   for (auto node : post_order) {
-    LowerNode(node);
+    if (!IsAliased(node)) {
+      LowerNode(node);
+    }
   }
 }
 
@@ -133,24 +186,63 @@ xla::StatusOr<xla::XlaComputation> LoweringContext::Build(xla::XlaOp root) {
   return builder()->Build(root);
 }
 
+void LoweringContext::InitDenseOutputs(
+    absl::Span<const Node* const> post_order) {
+  node_marks_ = NodeMarks::TryAcquire();
+  if (node_marks_ == nullptr) {
+    return;
+  }
+  size_t num_outputs = 0;
+  for (auto node : post_order) {
+    node_marks_->Set(node, num_outputs + 1);
+    num_outputs += node->num_outputs();
+  }
+  dense_outputs_.resize(num_outputs);
+}
+
+const xla::XlaOp* LoweringContext::FindOutputOp(const Output& output) const {
+  if (node_marks_ != nullptr) {
+    size_t mark = node_marks_->Get(output.node);
+    if (mark > 0) {
+      const xla::XlaOp& op = dense_outputs_[mark - 1 + output.index];
+      return op.valid() ? &op : nullptr;
+    }
+  }
+  auto it = emitted_outputs_.find(output);
+  return it != emitted_outputs_.end() ? &it->second : nullptr;
+}
+
 void LoweringContext::AssignOutputOp(const Output& output, xla::XlaOp op) {
+  if (node_marks_ != nullptr) {
+    size_t mark = node_marks_->Get(output.node);
+    if (mark > 0) {
+      dense_outputs_[mark - 1 + output.index] = std::move(op);
+      return;
+    }
+  }
   emitted_outputs_[output] = std::move(op);
 }
 
 xla::XlaOp LoweringContext::GetOutputOp(const Output& output) {
-  auto it = emitted_outputs_.find(output);
-  if (it == emitted_outputs_.end()) {
+  if (!node_aliases_.empty()) {
+    auto alias_it = node_aliases_.find(output.node);
+    if (alias_it != node_aliases_.end()) {
+      return GetOutputOp(Output(alias_it->second, output.index));
+    }
+  }
+  const xla::XlaOp* op = FindOutputOp(output);
+  if (op == nullptr) {
     auto post_order = Util::ComputePostOrder(output.node, &emit_status_);
     for (auto node : post_order) {
       LowerNode(node);
     }
     // At this point the outpout better be present, otherwise there is an issue
     // with the lowering code.
-    it = emitted_outputs_.find(output);
-    XLA_CHECK(it != emitted_outputs_.end())
+    op = FindOutputOp(output);
+    XLA_CHECK(op != nullptr)
         << "No XLA operation emitted for output: " << output;
   }
-  return it->second;
+  return *op;
 }
 
 XlaOpVector LoweringContext::LowerNode(const Node* node) {
@@ -158,13 +250,104 @@ XlaOpVector LoweringContext::LowerNode(const Node* node) {
   // TODO(asuhan): handle errors without crashing
   HloMetadataSetter meta_setter(this, node);
 
-  result_ops = node->Lower(this);
+  xla::PrimitiveType autocast_type = GetAutocastType();
+  if (autocast_type != xla::PrimitiveType::PRIMITIVE_TYPE_INVALID &&
+      IsAutocastOp(node->op())) {
+    result_ops = LowerAutocastNode(node, autocast_type);
+  } else {
+    result_ops = node->Lower(this);
+  }
   if (!builder()->first_error().ok()) {
     ReportBuilderError(node, /*error_msg=*/nullptr);
   }
   return result_ops;
 }
 
+void LoweringContext::LowerOutlined(const OutlinedRegions& outlined_regions) {
+  std::vector<absl::optional<xla::XlaComputation>> computations(
+      outlined_regions.num_computations);
+  for (auto& step : outlined_regions.order) {
+    if (step.node == nullptr) {
+      const OutlinedRegions::Region& region =
+          outlined_regions.regions[step.region];
+      LowerRegion(region, &computations[region.computation]);
+    } else if (!IsAliased(step.node)) {
+      LowerNode(step.node);
+    }
+  }
+}
+
+void LoweringContext::LowerRegion(
+    const OutlinedRegions::Region& region,
+    absl::optional<xla::XlaComputation>* computation) {
+  std::vector<xla::XlaOp> inputs;
+  inputs.reserve(region.inputs.size());
+  for (auto& input : region.inputs) {
+    inputs.push_back(GetOutputOp(input));
+  }
+  if (!*computation) {
+    std::unique_ptr<xla::XlaBuilder> sub_builder = builder()->CreateSubBuilder(
+        absl::StrCat("OutlinedRegion", region.computation));
+    LoweringContext region_loctx(sub_builder.get(), device_);
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      xla::XlaOp param = xla::Parameter(sub_builder.get(), i,
+                                        XlaHelpers::ShapeOfXlaOp(inputs[i]),
+                                        absl::StrCat("p", i));
+      region_loctx.AssignOutputOp(region.inputs[i], param);
+    }
+    for (auto node : region.nodes) {
+      region_loctx.LowerNode(node);
+    }
+    std::vector<xla::XlaOp> outputs;
+    outputs.reserve(region.outputs.size());
+    for (auto& output : region.outputs) {
+      outputs.push_back(region_loctx.GetOutputOp(output));
+    }
+    *computation = ConsumeValue(
+        sub_builder->Build(xla::Tuple(sub_builder.get(), outputs)));
+  }
+  xla::XlaOp call = xla::Call(builder(), **computation, inputs);
+  for (size_t i = 0; i < region.outputs.size(); ++i) {
+    AssignOutputOp(region.outputs[i], xla::GetTupleElement(call, i));
+  }
+}
+
+XlaOpVector LoweringContext::LowerAutocastNode(const Node* node,
+                                               xla::PrimitiveType type) {
+  // The F32 operands are swapped for their converted version while the node
+  // lowers, and restored afterwards, so that the other users of the operands
+  // still see them in F32.
+  std::vector<std::pair<Output, xla::XlaOp>> saved_operands;
+  for (const Output& operand : node->operands()) {
+    Output output = operand;
+    for (auto alias_it = node_aliases_.find(output.node);
+         alias_it != node_aliases_.end();
+         alias_it = node_aliases_.find(output.node)) {
+      output = Output(alias_it->second, output.index);
+    }
+    xla::XlaOp op = GetOutputOp(output);
+    if (XlaHelpers::TypeOfXlaOp(op) == xla::PrimitiveType::F32) {
+      saved_operands.emplace_back(output, op);
+      AssignOutputOp(output, xla::ConvertElementType(op, type));
+    }
+  }
+  XlaOpVector result_ops = node->Lower(this);
+  for (auto& output_op : saved_operands) {
+    AssignOutputOp(output_op.first, output_op.second);
+  }
+  // The node shapes have been inferred in F32, so the results are converted
+  // back for the users of the node.
+  for (size_t i = 0; i < result_ops.size(); ++i) {
+    if (node->shape(i).element_type() == xla::PrimitiveType::F32 &&
+        XlaHelpers::TypeOfXlaOp(result_ops[i]) == type) {
+      result_ops[i] =
+          xla::ConvertElementType(result_ops[i], xla::PrimitiveType::F32);
+      AssignOutputOp(Output(node, i), result_ops[i]);
+    }
+  }
+  return result_ops;
+}
+
 void LoweringContext::ReportBuilderError(const Node* node,
                                          const char* error_msg) {
   std::stringstream ss;
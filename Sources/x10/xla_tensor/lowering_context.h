@@ -22,6 +22,7 @@
 #include <utility>
 #include <vector>
 
+#include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "tensorflow/compiler/xla/xla_client/computation_client.h"
 #include "tensorflow/compiler/xla/xla_client/device.h"
@@ -38,7 +39,8 @@ class LoweringContext {
  public:
   explicit LoweringContext(xla::XlaBuilder* builder, Device device);
   LoweringContext(xla::XlaBuilder* builder, Device device,
-                  Util::EmissionMap emit_status);
+                  Util::EmissionMap emit_status,
+                  Util::NodeAliases node_aliases = {});
 
   xla::XlaBuilder* builder() { return builder_ptr_; }
 
@@ -90,12 +92,39 @@ class LoweringContext {
 
   size_t GetEmittedNodeCount() const { return emit_status_.size(); }
 
+ protected:
+  // Whether the node outputs are taken from an equivalent node.
+  bool IsAliased(const Node* node) const {
+    return node_aliases_.find(node) != node_aliases_.end();
+  }
+
+  // Lowers the nodes and regions in the order of the outlined regions. Every
+  // region gets lowered as a call to the computation shared by its equivalent
+  // regions.
+  void LowerOutlined(const OutlinedRegions& outlined_regions);
+
  private:
   struct Parameter {
     xla::XlaOp param;
     size_t index = 0;
   };
 
+  // Lowers the node with its F32 operands converted to type, and converts its
+  // results back to F32.
+  XlaOpVector LowerAutocastNode(const Node* node, xla::PrimitiveType type);
+
+  // Takes the node marks if available, and gives every output of the
+  // post-order nodes a slot within dense_outputs_.
+  void InitDenseOutputs(absl::Span<const Node* const> post_order);
+
+  // Returns the lowered operation of the output, or nullptr if not lowered yet.
+  const xla::XlaOp* FindOutputOp(const Output& output) const;
+
+  // Lowers a region as a call to the computation, which gets built out of the
+  // region nodes if null.
+  void LowerRegion(const OutlinedRegions::Region& region,
+                   absl::optional<xla::XlaComputation>* computation);
+
   // Reports an XLA builder error for the given node.
   TF_ATTRIBUTE_NORETURN void ReportBuilderError(const Node* node,
                                                 const char* error_msg);
@@ -108,7 +137,14 @@ class LoweringContext {
   std::vector<size_t> parameter_sequence_;
   std::vector<xla::XlaOp> root_tuple_;
   OutputMap<xla::XlaOp> emitted_outputs_;
+  // When the context holds the node marks, the outputs of a node marked m are
+  // stored from dense_outputs_[m - 1], instead of within emitted_outputs_.
+  std::unique_ptr<NodeMarks> node_marks_;
+  std::vector<xla::XlaOp> dense_outputs_;
   Util::EmissionMap emit_status_;
+  // Nodes which are not lowered, and whose outputs are taken from the
+  // equivalent node they are mapped to.
+  Util::NodeAliases node_aliases_;
 };
 
 class RootLoweringContext : public LoweringContext {
@@ -116,7 +152,9 @@ class RootLoweringContext : public LoweringContext {
   explicit RootLoweringContext(const std::string& name, Device device);
   RootLoweringContext(const std::string& name, Device device,
                       absl::Span<const Node* const> post_order,
-                      Util::EmissionMap emit_status);
+                      Util::EmissionMap emit_status,
+                      Util::NodeAliases node_aliases = {},
+                      const OutlinedRegions& outlined_regions = {});
   xla::XlaBuilder builder_;
 };
 
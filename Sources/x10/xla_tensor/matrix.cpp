@@ -16,9 +16,12 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/convert_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/xla/client/lib/arithmetic.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/lib/loops.h"
 #include "tensorflow/compiler/xla/client/lib/matrix.h"
 #include "tensorflow/compiler/xla/client/lib/qr.h"
+#include "tensorflow/compiler/xla/client/lib/slicing.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/util.h"
 
@@ -93,6 +96,98 @@ std::vector<int64_t> GetDiagonalPermutation(int64_t rank, int64_t dim1,
   return permutation;
 }
 
+// Returns the dimensions of a rank `rank` shape, but `dim`.
+std::vector<int64_t> DimensionsBut(int64_t rank, int64_t dim) {
+  std::vector<int64_t> dimensions;
+  for (int64_t i = 0; i < rank; ++i) {
+    if (i != dim) {
+      dimensions.push_back(i);
+    }
+  }
+  return dimensions;
+}
+
+// Sums `input` along `dim`, which picks the single element of a masked row or
+// column exactly.
+xla::XlaOp SumInDim(xla::XlaOp input, int64_t dim) {
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(input);
+  return xla::Reduce(input, xla::Zero(input.builder(), type),
+                     XlaHelpers::CreateAddComputation(type), {dim});
+}
+
+// Broadcasts `input`, the shape of `shape` without `dim`, to `shape`.
+xla::XlaOp BroadcastAlong(xla::XlaOp input, const xla::Shape& shape,
+                          int64_t dim) {
+  return xla::BroadcastInDim(input, shape.dimensions(),
+                             DimensionsBut(shape.rank(), dim));
+}
+
+// One step of the LU decomposition: swaps row `k` of `a` with the row holding
+// the largest magnitude of column `k` at or below the diagonal, and eliminates
+// column `k` below the diagonal, whose multipliers take its place.
+std::vector<xla::XlaOp> LuStep(xla::XlaOp k, xla::XlaOp a,
+                               xla::XlaOp permutation) {
+  xla::XlaBuilder* builder = a.builder();
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(a);
+  const xla::Shape& permutation_shape = XlaHelpers::ShapeOfXlaOp(permutation);
+  int64_t rank = shape.rank();
+  xla::Shape index_shape = xla::ShapeUtil::ChangeElementType(shape, xla::S32);
+  xla::XlaOp rows = xla::Iota(builder, index_shape, rank - 2);
+  xla::XlaOp cols = xla::Iota(builder, index_shape, rank - 1);
+  xla::XlaOp positions = xla::Iota(builder, permutation_shape, rank - 2);
+  xla::XlaOp zeros = xla::ZerosLike(a);
+
+  xla::XlaOp column =
+      SumInDim(xla::Select(xla::Eq(cols, k), a, zeros), rank - 1);
+  xla::XlaOp magnitude = xla::Select(xla::Ge(positions, k), xla::Abs(column),
+                                     xla::FullLike(column, -1));
+  xla::XlaOp pivot = xla::ArgMax(magnitude, xla::S32, rank - 2);
+  std::vector<int64_t> batch_dims = xla::util::Iota<int64_t>(rank - 2);
+  xla::XlaOp is_k = xla::Eq(rows, k);
+  xla::XlaOp is_pivot = xla::Eq(rows, pivot, batch_dims);
+  xla::XlaOp row_k = SumInDim(xla::Select(is_k, a, zeros), rank - 2);
+  xla::XlaOp row_pivot = SumInDim(xla::Select(is_pivot, a, zeros), rank - 2);
+  xla::XlaOp swapped =
+      xla::Select(is_k, BroadcastAlong(row_pivot, shape, rank - 2),
+                  xla::Select(is_pivot, BroadcastAlong(row_k, shape, rank - 2),
+                              a));
+
+  xla::XlaOp position_is_pivot = xla::Eq(positions, pivot, batch_dims);
+  xla::XlaOp permutation_zeros = xla::ZerosLike(permutation);
+  xla::XlaOp permutation_k = SumInDim(
+      xla::Select(xla::Eq(positions, k), permutation, permutation_zeros),
+      rank - 2);
+  xla::XlaOp permutation_pivot = SumInDim(
+      xla::Select(position_is_pivot, permutation, permutation_zeros), rank - 2);
+  permutation = xla::Select(
+      xla::Eq(positions, k),
+      xla::BroadcastInDim(permutation_pivot, permutation_shape.dimensions(),
+                          batch_dims),
+      xla::Select(position_is_pivot,
+                  xla::BroadcastInDim(permutation_k,
+                                      permutation_shape.dimensions(),
+                                      batch_dims),
+                  permutation));
+
+  // After the swap, row k is the pivot row.
+  xla::XlaOp vector_zeros = xla::ZerosLike(row_pivot);
+  xla::XlaOp diagonal = SumInDim(
+      xla::Select(xla::Eq(positions, k), row_pivot, vector_zeros), rank - 2);
+  column = SumInDim(xla::Select(xla::Eq(cols, k), swapped, zeros), rank - 1);
+  xla::XlaOp multipliers =
+      xla::Select(xla::Gt(positions, k), xla::Div(column, diagonal, batch_dims),
+                  vector_zeros);
+  xla::XlaOp pivot_row =
+      xla::Select(xla::Gt(positions, k), row_pivot, vector_zeros);
+  xla::XlaOp broadcast_multipliers =
+      BroadcastAlong(multipliers, shape, rank - 1);
+  xla::XlaOp update =
+      broadcast_multipliers * BroadcastAlong(pivot_row, shape, rank - 2);
+  xla::XlaOp lu = xla::Select(xla::And(xla::Eq(cols, k), xla::Gt(rows, k)),
+                              broadcast_multipliers, swapped - update);
+  return {lu, permutation};
+}
+
 }  // namespace
 
 xla::XlaOp BuildTriu(xla::XlaOp input, int64_t diagonal) {
@@ -152,4 +247,90 @@ xla::XlaOp BuildInverse(xla::XlaOp input) {
                               xla::TriangularSolveOptions::NO_TRANSPOSE);
 }
 
+xla::XlaOp BuildCholesky(xla::XlaOp input) {
+  // The HLO leaves the upper triangle undefined. On GPU, it turns into a
+  // cuSOLVER call.
+  return xla::Triangle(xla::Cholesky(input, /*lower=*/true), /*lower=*/true);
+}
+
+xla::XlaOp BuildCholeskyGrad(xla::XlaOp l, xla::XlaOp grad) {
+  // With phi(X) the lower triangle of X with its diagonal halved, the gradient
+  // is the symmetric part of L^-H phi(L^H grad) L^-1, where both inverses are
+  // triangular solves.
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(l);
+  int64_t rank = shape.rank();
+  xla::Shape index_shape = xla::ShapeUtil::ChangeElementType(shape, xla::S32);
+  xla::XlaOp is_diagonal =
+      xla::Eq(xla::Iota(l.builder(), index_shape, rank - 2),
+              xla::Iota(l.builder(), index_shape, rank - 1));
+  xla::XlaOp middle = xla::Triangle(
+      xla::BatchDot(xla::TransposeInMinorDims(l), grad,
+                    XlaHelpers::mat_mul_precision()),
+      /*lower=*/true);
+  middle = xla::Select(
+      is_diagonal,
+      middle * XlaHelpers::ScalarValue<float>(0.5, shape.element_type(),
+                                              l.builder()),
+      middle);
+  xla::XlaOp left = xla::TriangularSolve(
+      l, middle, /*left_side=*/true, /*lower=*/true, /*unit_diagonal=*/false,
+      /*transpose_a=*/xla::TriangularSolveOptions::ADJOINT);
+  xla::XlaOp grad_input = xla::TriangularSolve(
+      l, left, /*left_side=*/false, /*lower=*/true, /*unit_diagonal=*/false,
+      /*transpose_a=*/xla::TriangularSolveOptions::NO_TRANSPOSE);
+  return (grad_input + xla::TransposeInMinorDims(grad_input)) *
+         XlaHelpers::ScalarValue<float>(0.5, shape.element_type(), l.builder());
+}
+
+xla::XlaOp BuildTriangularSolve(xla::XlaOp matrix, xla::XlaOp rhs, bool lower,
+                                bool adjoint) {
+  return xla::TriangularSolve(
+      matrix, rhs, /*left_side=*/true, lower, /*unit_diagonal=*/false,
+      /*transpose_a=*/adjoint ? xla::TriangularSolveOptions::ADJOINT
+                              : xla::TriangularSolveOptions::NO_TRANSPOSE);
+}
+
+std::vector<xla::XlaOp> BuildLu(xla::XlaOp input) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  int64_t rank = shape.rank();
+  XLA_CHECK_GE(rank, 2) << shape;
+  int64_t n = shape.dimensions(rank - 1);
+  XLA_CHECK_EQ(shape.dimensions(rank - 2), n)
+      << "LU decompositions need square matrices: " << shape;
+  std::vector<int64_t> permutation_sizes(shape.dimensions().begin(),
+                                         shape.dimensions().end() - 1);
+  xla::XlaOp permutation = xla::Iota(
+      input.builder(), xla::ShapeUtil::MakeShape(xla::S32, permutation_sizes),
+      rank - 2);
+  auto body_fn = [&](xla::XlaOp k, absl::Span<const xla::XlaOp> values,
+                     xla::XlaBuilder* body_builder)
+      -> xla::StatusOr<std::vector<xla::XlaOp>> {
+    return LuStep(k, values[0], values[1]);
+  };
+  return ConsumeValue(xla::ForEachIndex(n, xla::S32, body_fn,
+                                        {input, permutation}, "Lu",
+                                        input.builder()));
+}
+
+xla::XlaOp BuildSolve(xla::XlaOp matrix, xla::XlaOp rhs, bool adjoint) {
+  // The matrices are real, so their adjoints are their transposes.
+  if (adjoint) {
+    matrix = xla::TransposeInMinorDims(matrix);
+  }
+  std::vector<xla::XlaOp> lu = BuildLu(matrix);
+  // With P A = L U, A x = b is L U x = P b.
+  const xla::Shape& rhs_shape = XlaHelpers::ShapeOfXlaOp(rhs);
+  xla::XlaOp index = BroadcastAlong(
+      lu[1], xla::ShapeUtil::ChangeElementType(rhs_shape, xla::S32),
+      rhs_shape.rank() - 1);
+  xla::XlaOp permuted_rhs = xla::TorchGather(rhs, index, rhs_shape.rank() - 2);
+  xla::XlaOp y = xla::TriangularSolve(
+      lu[0], permuted_rhs, /*left_side=*/true, /*lower=*/true,
+      /*unit_diagonal=*/true,
+      /*transpose_a=*/xla::TriangularSolveOptions::NO_TRANSPOSE);
+  return xla::TriangularSolve(
+      lu[0], y, /*left_side=*/true, /*lower=*/false, /*unit_diagonal=*/false,
+      /*transpose_a=*/xla::TriangularSolveOptions::NO_TRANSPOSE);
+}
+
 }  // namespace swift_xla
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 
 namespace swift_xla {
@@ -33,4 +35,25 @@ xla::XlaOp BuildDiagonalViewUpdate(xla::XlaOp target, xla::XlaOp input,
 
 xla::XlaOp BuildInverse(xla::XlaOp input);
 
+// Returns the lower triangular Cholesky factors of the matrices of `input`.
+xla::XlaOp BuildCholesky(xla::XlaOp input);
+
+// Returns the gradient of BuildCholesky() with respect to its input, given the
+// factors `l` and the gradient of the factors.
+xla::XlaOp BuildCholeskyGrad(xla::XlaOp l, xla::XlaOp grad);
+
+// Solves matrix * x = rhs, or adjoint(matrix) * x = rhs, for a lower or upper
+// triangular matrix.
+xla::XlaOp BuildTriangularSolve(xla::XlaOp matrix, xla::XlaOp rhs, bool lower,
+                                bool adjoint);
+
+// Returns the LU decompositions with partial pivoting of the matrices of
+// `input`: the unit lower triangular L and the upper triangular U packed in a
+// single matrix, and the S32 row permutation P, such that P * input = L * U.
+std::vector<xla::XlaOp> BuildLu(xla::XlaOp input);
+
+// Solves matrix * x = rhs, or adjoint(matrix) * x = rhs, through the LU
+// decomposition of the matrix.
+xla::XlaOp BuildSolve(xla::XlaOp matrix, xla::XlaOp rhs, bool adjoint);
+
 }  // namespace swift_xla
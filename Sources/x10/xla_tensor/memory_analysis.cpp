@@ -0,0 +1,135 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/memory_analysis.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#include "tensorflow/compiler/xla/xla_client/xla_util.h"
+#include "tensorflow/compiler/xla/service/heap_simulator.h"
+#include "tensorflow/compiler/xla/service/hlo_memory_scheduler.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace {
+
+int64_t GetMemoryBudget() {
+  static const int64_t budget =
+      xla::sys_util::GetEnvInt("XLA_DEVICE_MEMORY_BUDGET", 0);
+  return budget;
+}
+
+int64_t BufferSize(const xla::BufferValue& buffer) {
+  return xla::ShapeUtil::ByteSizeOf(buffer.shape(), sizeof(void*));
+}
+
+}  // namespace
+
+int64_t ArraysByteSize(const xla::Shape& shape) {
+  int64_t size = 0;
+  xla::ShapeUtil::ForEachSubshape(
+      shape, [&](const xla::Shape& subshape, const xla::ShapeIndex& /*index*/) {
+        if (subshape.IsArray()) {
+          size += xla::ShapeUtil::ByteSizeOf(subshape);
+        }
+      });
+  return size;
+}
+
+std::string MemoryAnalysis::ToString() const {
+  return absl::StrCat("ArgumentBytes=", argument_bytes,
+                      "\nOutputBytes=", output_bytes,
+                      "\nTempBytes=", temp_bytes,
+                      "\nAliasedBytes=", aliased_bytes,
+                      "\nTotalBytes=", total_bytes(), "\n");
+}
+
+MemoryAnalysis AnalyzeComputationMemory(
+    const xla::XlaComputation& computation) {
+  XLA_TIMED("MemoryAnalysisTime");
+  MemoryAnalysis analysis;
+  xla::ProgramShape program_shape =
+      ConsumeValue(computation.GetProgramShape());
+  for (const xla::Shape& shape : program_shape.parameters()) {
+    analysis.argument_bytes += ArraysByteSize(shape);
+  }
+  analysis.output_bytes = ArraysByteSize(program_shape.result());
+  for (const auto& entry : computation.proto().input_output_alias().entries()) {
+    xla::ShapeIndex index(entry.parameter_shape_index().begin(),
+                          entry.parameter_shape_index().end());
+    analysis.aliased_bytes += ArraysByteSize(xla::ShapeUtil::GetSubshape(
+        program_shape.parameters(entry.parameter_number()), index));
+  }
+
+  auto module = xla::util::CreateModuleFromProto(computation.proto());
+  if (!module.ok()) {
+    TF_VLOG(3) << "Unable to create the HLO module for the memory analysis: "
+               << module.status();
+    return analysis;
+  }
+  auto schedule = xla::ScheduleModule(module.ValueOrDie().get(), BufferSize);
+  if (!schedule.ok()) {
+    TF_VLOG(3) << "Unable to schedule the HLO module for the memory analysis: "
+               << schedule.status();
+    return analysis;
+  }
+  auto peak_bytes = xla::HeapSimulator::MinimumMemoryForModule(
+      schedule.ValueOrDie(), BufferSize);
+  if (peak_bytes.ok()) {
+    analysis.temp_bytes =
+        std::max<int64_t>(peak_bytes.ValueOrDie() - analysis.argument_bytes -
+                              analysis.output_bytes,
+                          0);
+  }
+  return analysis;
+}
+
+bool IsMemoryAnalysisEnabled() {
+  static const bool enabled =
+      xla::sys_util::GetEnvBool("XLA_MEMORY_ANALYSIS", false) ||
+      GetMemoryBudget() > 0;
+  return enabled;
+}
+
+void CheckMemoryBudget(const MemoryAnalysis& analysis) {
+  static xla::metrics::Metric* argument_metric = new xla::metrics::Metric(
+      "GraphArgumentBytes", xla::metrics::MetricFnBytes);
+  static xla::metrics::Metric* output_metric = new xla::metrics::Metric(
+      "GraphOutputBytes", xla::metrics::MetricFnBytes);
+  static xla::metrics::Metric* temp_metric = new xla::metrics::Metric(
+      "GraphTempBytes", xla::metrics::MetricFnBytes);
+  static xla::metrics::Metric* aliased_metric = new xla::metrics::Metric(
+      "GraphAliasedBytes", xla::metrics::MetricFnBytes);
+  argument_metric->AddSample(analysis.argument_bytes);
+  output_metric->AddSample(analysis.output_bytes);
+  temp_metric->AddSample(analysis.temp_bytes);
+  aliased_metric->AddSample(analysis.aliased_bytes);
+
+  int64_t budget = GetMemoryBudget();
+  if (budget > 0 && analysis.total_bytes() > budget) {
+    XLA_COUNTER("GraphOverMemoryBudget", 1);
+    XLA_ERROR() << "The graph needs about " << analysis.total_bytes()
+                << " bytes of device memory, more than the "
+                << "XLA_DEVICE_MEMORY_BUDGET of " << budget << " bytes:\n"
+                << analysis.ToString();
+  }
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "tensorflow/compiler/xla/client/xla_computation.h"
+
+namespace swift_xla {
+
+// Device memory needed to run a computation, in bytes.
+struct MemoryAnalysis {
+  int64_t argument_bytes = 0;
+  int64_t output_bytes = 0;
+  // Peak of the intermediate buffers, on top of the arguments and outputs.
+  int64_t temp_bytes = 0;
+  // Output bytes which reuse (donated) argument buffers.
+  int64_t aliased_bytes = 0;
+
+  int64_t total_bytes() const {
+    return argument_bytes + output_bytes + temp_bytes - aliased_bytes;
+  }
+
+  std::string ToString() const;
+};
+
+// Bytes of the arrays within the shape, leaving out the tuple index tables.
+int64_t ArraysByteSize(const xla::Shape& shape);
+
+// Estimates the memory needed by the computation. The temporary bytes come from
+// a heap simulation over the HLO as emitted by the lowering, so they do not
+// account for the fusions and rematerializations done by the XLA compiler, and
+// are only an approximation of what the compiled executable uses.
+MemoryAnalysis AnalyzeComputationMemory(
+    const xla::XlaComputation& computation);
+
+// Whether the sync computations get analyzed, which happens when either
+// XLA_MEMORY_ANALYSIS is set, or XLA_DEVICE_MEMORY_BUDGET is not zero.
+bool IsMemoryAnalysisEnabled();
+
+// Records the analysis into the Graph*Bytes metrics, and fails if the graph
+// does not fit the XLA_DEVICE_MEMORY_BUDGET bytes, if any.
+void CheckMemoryBudget(const MemoryAnalysis& analysis);
+
+}  // namespace swift_xla
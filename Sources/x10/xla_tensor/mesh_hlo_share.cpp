@@ -0,0 +1,89 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/persistent_cache.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/mesh_hlo_share.h"
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/service/hlo.pb.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/env_vars.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace {
+
+std::string GetBlobKey(const xla::hash_t& key) {
+  return absl::StrCat("hlo:", xla::util::HexHash(key));
+}
+
+}  // namespace
+
+MeshHloShare* MeshHloShare::Get() {
+  static MeshHloShare* share = []() -> MeshHloShare* {
+    if (!xla::sys_util::GetEnvBool("XLA_MESH_SHARE_HLO", false)) {
+      return nullptr;
+    }
+    xla::service::MeshClient* client = xla::service::MeshClient::Get();
+    if (client == nullptr) {
+      TF_LOG(WARNING) << "XLA_MESH_SHARE_HLO needs a mesh service";
+      return nullptr;
+    }
+    bool publisher =
+        xla::sys_util::GetEnvInt(xla::env::kEnvHostOrdinal, 0) == 0;
+    return new MeshHloShare(client, publisher);
+  }();
+  return share;
+}
+
+MeshHloShare::MeshHloShare(xla::service::MeshClient* client, bool publisher)
+    : client_(client), publisher_(publisher) {}
+
+xla::hash_t MeshHloShare::GetKey(const xla::hash_t& ir_hash,
+                                 const Device& device, bool aliased) {
+  return xla::util::MHash(ir_hash, xla::util::GetEnumValue(device.hw_type),
+                          aliased);
+}
+
+absl::optional<xla::XlaComputation> MeshHloShare::Fetch(
+    const xla::hash_t& key) {
+  static const int64_t timeout_ms =
+      xla::sys_util::GetEnvInt("XLA_MESH_SHARE_HLO_TIMEOUT", 600) * 1000;
+  absl::optional<std::string> data =
+      client_->GetBlob(GetBlobKey(key), timeout_ms);
+  if (!data) {
+    TF_LOG(WARNING) << "Timed out waiting for the HLO of graph "
+                    << xla::util::HexHash(key) << ", lowering it locally";
+    XLA_COUNTER("MeshHloShareTimeout", 1);
+    return absl::nullopt;
+  }
+  xla::HloModuleProto proto;
+  XLA_CHECK(proto.ParseFromString(*data))
+      << "Corrupted HLO shared for graph " << xla::util::HexHash(key);
+  XLA_COUNTER("MeshHloShareFetched", 1);
+  XLA_COUNTER("MeshHloShareBytesFetched", data->size());
+  return xla::XlaComputation(std::move(proto));
+}
+
+void MeshHloShare::Publish(const xla::hash_t& key,
+                           const xla::XlaComputation& computation) {
+  client_->PutBlob(GetBlobKey(key), computation.proto().SerializeAsString());
+  XLA_COUNTER("MeshHloSharePublished", 1);
+}
+
+}  // namespace swift_xla
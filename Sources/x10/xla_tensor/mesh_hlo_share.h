@@ -0,0 +1,60 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/client/xla_computation.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/compiler/xla/xla_client/mesh_service.h"
+#include "tensorflow/compiler/xla/xla_client/types.h"
+
+namespace swift_xla {
+
+// Shares the lowered HLO modules of the SyncTensorsGraph computations across
+// the hosts of a mesh. The host with ordinal 0 (XRT_HOST_ORDINAL) lowers the
+// graphs and publishes their HLO through the mesh service blobs, while the
+// other hosts, which run the same graphs in data parallel training, fetch it
+// instead of lowering their own copy.
+class MeshHloShare {
+ public:
+  // Returns the process wide share, or nullptr if XLA_MESH_SHARE_HLO is not
+  // set or there is no mesh service.
+  static MeshHloShare* Get();
+
+  MeshHloShare(xla::service::MeshClient* client, bool publisher);
+
+  // Whether this host lowers and publishes the HLO, instead of fetching it.
+  bool publisher() const { return publisher_; }
+
+  // Builds the key of a graph, which unlike the graph hash must not depend on
+  // anything local to the host, like the device resource domain.
+  static xla::hash_t GetKey(const xla::hash_t& ir_hash, const Device& device,
+                            bool aliased);
+
+  // Waits for the publisher to share the HLO of the key. Returns nullopt if it
+  // did not within XLA_MESH_SHARE_HLO_TIMEOUT seconds, in which case the
+  // caller lowers the graph itself.
+  absl::optional<xla::XlaComputation> Fetch(const xla::hash_t& key);
+
+  void Publish(const xla::hash_t& key, const xla::XlaComputation& computation);
+
+ private:
+  xla::service::MeshClient* client_;
+  bool publisher_;
+};
+
+}  // namespace swift_xla
@@ -14,174 +14,234 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/nll_loss.h"
 
+#include <algorithm>
+
 #include "absl/types/span.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/data_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/lib/slicing.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 
 namespace swift_xla {
 namespace {
 
-struct WeightScale {
+// Number of classes whose softmax terms the sparse cross entropy accumulates at
+// once.
+int64_t GetCrossEntropyChunkSize() {
+  static const int64_t chunk_size =
+      xla::sys_util::GetEnvInt("XLA_CROSS_ENTROPY_CHUNK_SIZE", 8192);
+  return chunk_size;
+}
+
+struct RowWeights {
+  // The [N] weights of the labels, zero for the ignored ones.
   xla::XlaOp weight;
+  // The sum of the weights, or one when they are all zero.
   xla::XlaOp scale;
 };
 
-// Build a iota tensor populated with values 0 through depth - 1, with the
-// exception of ignore_index which is set to -1 (if between 0 and depth - 1).
-// This allows the ignored index to be ignored by the one-hot conversion.
-xla::XlaOp OneHotIota(xla::XlaBuilder* builder, int64_t depth, int axis,
-                      const xla::Shape& indices_shape, int ignore_index) {
-  int indices_dims = indices_shape.rank();
-  std::vector<int64_t> linspace_dims(indices_dims + 1, 1);
-  linspace_dims[axis] = depth;
-  xla::Shape linspace_xla_shape =
-      xla::ShapeUtil::MakeShape(indices_shape.element_type(), linspace_dims);
-  xla::XlaOp iota = xla::Iota(builder, linspace_xla_shape, axis);
-  if (ignore_index >= 0 && ignore_index < depth) {
-    xla::XlaOp ignore_index_op =
-        xla::Broadcast(XlaHelpers::ScalarValue<int64_t>(
-                           ignore_index, indices_shape.element_type(), builder),
-                       linspace_dims);
-    xla::XlaOp invalid_index =
-        xla::Broadcast(XlaHelpers::ScalarValue<int64_t>(
-                           -1, indices_shape.element_type(), builder),
-                       linspace_dims);
-    iota = xla::Select(xla::Eq(iota, ignore_index_op), invalid_index, iota);
-  }
-  return iota;
+// Clamps the labels into [0, num_classes), so that they can index the classes.
+xla::XlaOp ClampLabels(xla::XlaOp labels, int64_t num_classes) {
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(labels);
+  xla::XlaOp max_label = XlaHelpers::ScalarValue<int64_t>(
+      num_classes - 1, type, labels.builder());
+  return xla::Clamp(xla::Zero(labels.builder(), type), labels, max_label);
 }
 
-// Converts "indices" into a one-hot representation. "depth" is the size of the
-// new axis to add. "axis" is the position at which to add the new axis.
-// "on_value" and "off_value" represent the values to use for the on and off
-// positions, respectively. If "ignore_index" is a valid class, it'll be
-// considered off.
-xla::XlaOp LabelsToOneHot(xla::XlaBuilder* builder, int64_t depth, int axis,
-                          xla::XlaOp indices, xla::XlaOp on_value,
-                          xla::XlaOp off_value, int ignore_index) {
-  const xla::Shape& indices_shape = XlaHelpers::ShapeOfXlaOp(indices);
-
-  // Expand the labels with a depth dimension for the classes.
-  std::vector<int64_t> output_dimensions(indices_shape.dimensions().begin(),
-                                            indices_shape.dimensions().end());
-  output_dimensions.insert(output_dimensions.begin() + axis, depth);
-
-  xla::XlaOp iota = OneHotIota(/*builder=*/builder, /*depth=*/depth,
-                               /*axis=*/axis, /*indices_shape=*/indices_shape,
-                               /*ignore_index=*/ignore_index);
-
-  // Now compare the labels in index form to the iota tensor to get the one hot
-  // format.
-  std::vector<int64_t> broadcast_dims(indices_shape.rank());
-  std::iota(broadcast_dims.begin(), broadcast_dims.begin() + axis, 0);
-  std::iota(broadcast_dims.begin() + axis, broadcast_dims.end(), axis + 1);
-  xla::XlaOp one_hot_bool = xla::Eq(indices, iota, broadcast_dims);
-
-  // Selects the user-provided off_value and on_value values.
-  return xla::Select(one_hot_bool, xla::Broadcast(on_value, output_dimensions),
-                     xla::Broadcast(off_value, output_dimensions));
+// Picks the [N] values of the [N, C] "input" at the class indices "labels".
+xla::XlaOp GatherLabels(xla::XlaOp input, xla::XlaOp labels) {
+  const xla::Shape& labels_shape = XlaHelpers::ShapeOfXlaOp(labels);
+  xla::XlaOp indices = xla::Reshape(labels, {labels_shape.dimensions(0), 1});
+  return xla::Reshape(xla::TorchGather(input, indices, /*dim=*/1),
+                      {labels_shape.dimensions(0)});
 }
 
-WeightScale GetMaskedWeight(const absl::optional<xla::XlaOp>& weight,
-                            const xla::Shape& logits_shape, xla::XlaOp labels,
-                            xla::XlaOp one_hot_labels, int ignore_index) {
+// Builds the [N, C] mask of the positions "labels" points at.
+xla::XlaOp LabelsMask(xla::XlaOp labels, int64_t num_classes,
+                      int64_t class_offset) {
   const xla::Shape& labels_shape = XlaHelpers::ShapeOfXlaOp(labels);
-  xla::XlaOp valid_bitmap = xla::Ne(
-      labels, XlaHelpers::ScalarValue<int64_t>(
-                  ignore_index, labels_shape.element_type(), labels.builder()));
-  xla::XlaOp xweight;
+  xla::Shape iota_shape = xla::ShapeUtil::MakeShape(
+      labels_shape.element_type(), {labels_shape.dimensions(0), num_classes});
+  xla::XlaOp iota = xla::Iota(labels.builder(), iota_shape, 1);
+  if (class_offset != 0) {
+    iota = iota + XlaHelpers::ScalarValue<int64_t>(
+                      class_offset, labels_shape.element_type(),
+                      labels.builder());
+  }
+  return xla::Eq(iota, labels, {0});
+}
+
+// Returns the weights of the labels, which are zero for "ignore_index" and for
+// the labels out of the class range.
+RowWeights GetRowWeights(const absl::optional<xla::XlaOp>& weight,
+                         const xla::Shape& logits_shape, xla::XlaOp labels,
+                         int ignore_index) {
+  const xla::Shape& labels_shape = XlaHelpers::ShapeOfXlaOp(labels);
+  xla::XlaBuilder* builder = labels.builder();
+  int64_t num_classes = logits_shape.dimensions(1);
+  xla::PrimitiveType type = logits_shape.element_type();
+  xla::PrimitiveType labels_type = labels_shape.element_type();
+  xla::XlaOp valid = xla::And(
+      xla::Ne(labels, XlaHelpers::ScalarValue<int64_t>(ignore_index,
+                                                       labels_type, builder)),
+      xla::And(xla::Ge(labels, xla::Zero(builder, labels_type)),
+               xla::Lt(labels, XlaHelpers::ScalarValue<int64_t>(
+                                   num_classes, labels_type, builder))));
+  xla::XlaOp zeros = xla::Broadcast(xla::Zero(builder, type),
+                                    {labels_shape.dimensions(0)});
+  xla::XlaOp row_weight;
   if (weight) {
-    xweight = xla::BroadcastInDim(*weight, logits_shape.dimensions(), {1});
+    row_weight = xla::TorchIndexSelect(
+        *weight, ClampLabels(labels, num_classes), /*dim=*/0);
   } else {
-    xweight =
-        XlaHelpers::ScalarBroadcast<float>(1.0, logits_shape, labels.builder());
+    row_weight = xla::Broadcast(xla::One(builder, type),
+                                {labels_shape.dimensions(0)});
   }
-  xla::XlaOp zeros =
-      XlaHelpers::ScalarBroadcast<float>(0.0, logits_shape, labels.builder());
-  xla::XlaOp xvalid_bitmap =
-      xla::BroadcastInDim(valid_bitmap, logits_shape.dimensions(), {0});
-  xla::XlaOp result_weight =
-      xla::Select(xvalid_bitmap, xweight, zeros) * one_hot_labels;
+  row_weight = xla::Select(valid, row_weight, zeros);
 
-  xla::XlaComputation add_func =
-      XlaHelpers::CreateAddComputation(logits_shape.element_type());
-  xla::XlaOp zero = xla::Zero(labels.builder(), logits_shape.element_type());
-  xla::XlaOp one = xla::One(labels.builder(), logits_shape.element_type());
-  xla::XlaOp scale = xla::ReduceAll(result_weight, zero, add_func);
-  scale = xla::Select(xla::Ne(scale, zero), scale, one);
-  return {result_weight, scale};
+  xla::XlaOp zero = xla::Zero(builder, type);
+  xla::XlaOp scale =
+      xla::ReduceAll(row_weight, zero, XlaHelpers::CreateAddComputation(type));
+  scale = xla::Select(xla::Ne(scale, zero), scale, xla::One(builder, type));
+  return {row_weight, scale};
 }
 
 }  // namespace
 
 // Builds the NLLLoss for log-probabilities "logits" and class indices "labels".
+// The log-probabilities of the labels are gathered, rather than masked out of
+// the whole [N, C] input by a one-hot product.
 xla::XlaOp BuildNllLoss(xla::XlaOp logits, xla::XlaOp labels,
                         const absl::optional<xla::XlaOp>& weight,
                         int ignore_index, ReductionMode reduction_mode) {
-  const int classes_axis = 1;
   const xla::Shape& logits_shape = XlaHelpers::ShapeOfXlaOp(logits);
   xla::XlaOp zero = xla::Zero(logits.builder(), logits_shape.element_type());
-  xla::XlaOp one = xla::One(logits.builder(), logits_shape.element_type());
-  xla::XlaOp one_hot_labels = LabelsToOneHot(
-      /*builder=*/logits.builder(),
-      /*depth=*/logits_shape.dimensions(1),
-      /*axis=*/classes_axis,
-      /*indices=*/labels,
-      /*on_value=*/one,
-      /*off_value=*/zero,
-      /*ignore_index=*/ignore_index);
-  xla::XlaOp mul = xla::Neg(one_hot_labels) * logits;
-  WeightScale weight_scale = GetMaskedWeight(weight, logits_shape, labels,
-                                             one_hot_labels, ignore_index);
-  mul = mul * weight_scale.weight;
-  xla::XlaComputation add_func =
-      XlaHelpers::CreateAddComputation(logits_shape.element_type());
+  RowWeights row_weights =
+      GetRowWeights(weight, logits_shape, labels, ignore_index);
+  xla::XlaOp picked = GatherLabels(
+      logits, ClampLabels(labels, logits_shape.dimensions(1)));
+  xla::XlaOp loss = xla::Neg(picked) * row_weights.weight;
   if (reduction_mode == ReductionMode::kNone) {
-    return xla::Reduce(mul, zero, add_func, {classes_axis});
+    return loss;
   }
-  xla::XlaOp sum = xla::ReduceAll(mul, zero, add_func);
+  xla::XlaOp sum = xla::ReduceAll(
+      loss, zero,
+      XlaHelpers::CreateAddComputation(logits_shape.element_type()));
   if (reduction_mode == ReductionMode::kSum) {
     return sum;
   }
-  return sum / weight_scale.scale;
+  return sum / row_weights.scale;
 }
 
 // Builds the NLLLoss gradient for log-probabilities "logits" and class indices
-// "labels".
+// "labels". Only the label position of a row gets a gradient, so the row
+// coefficients are scattered with a single select.
 xla::XlaOp BuildNllLossBackward(xla::XlaOp grad_output, xla::XlaOp logits,
                                 xla::XlaOp labels,
                                 const absl::optional<xla::XlaOp>& weight,
                                 const absl::optional<xla::XlaOp>& total_weight,
                                 int ignore_index,
                                 ReductionMode reduction_mode) {
-  const int classes_axis = 1;
   const xla::Shape& logits_shape = XlaHelpers::ShapeOfXlaOp(logits);
-  xla::XlaOp zero = xla::Zero(logits.builder(), logits_shape.element_type());
-  xla::XlaOp one = xla::One(logits.builder(), logits_shape.element_type());
-  xla::XlaOp one_hot_labels = LabelsToOneHot(
-      /*builder=*/logits.builder(),
-      /*depth=*/logits_shape.dimensions(1),
-      /*axis=*/classes_axis,
-      /*indices=*/labels,
-      /*on_value=*/one,
-      /*off_value=*/zero,
-      /*ignore_index=*/ignore_index);
-
-  const xla::Shape& grad_output_shape = XlaHelpers::ShapeOfXlaOp(grad_output);
+  const xla::Shape& labels_shape = XlaHelpers::ShapeOfXlaOp(labels);
+  RowWeights row_weights =
+      GetRowWeights(weight, logits_shape, labels, ignore_index);
   xla::XlaOp grad = grad_output;
-  if (grad_output_shape.rank() == 1) {
-    grad = xla::BroadcastInDim(grad, logits_shape.dimensions(), {0});
+  if (XlaHelpers::ShapeOfXlaOp(grad_output).rank() == 0) {
+    grad = xla::Broadcast(grad, {labels_shape.dimensions(0)});
+  }
+  xla::XlaOp coefficient = xla::Neg(grad) * row_weights.weight;
+  if (reduction_mode == ReductionMode::kMean) {
+    coefficient = coefficient / row_weights.scale;
+  }
+  xla::XlaOp zeros = xla::Broadcast(
+      xla::Zero(logits.builder(), logits_shape.element_type()),
+      logits_shape.dimensions());
+  return xla::Select(
+      LabelsMask(labels, logits_shape.dimensions(1), /*class_offset=*/0),
+      xla::BroadcastInDim(coefficient, logits_shape.dimensions(), {0}), zeros);
+}
+
+// Builds the softmax cross entropy of the [N, C] "features" against the class
+// indices "labels", along with its gradient. The classes are walked in chunks
+// which fold into a running log-sum-exp, so that the F32 copies of the inputs
+// the half precision types need are only ever made one chunk at a time.
+std::vector<xla::XlaOp> BuildSparseSoftmaxCrossEntropy(xla::XlaOp features,
+                                                       xla::XlaOp labels) {
+  const xla::Shape& features_shape = XlaHelpers::ShapeOfXlaOp(features);
+  XLA_CHECK_EQ(features_shape.rank(), 2) << features_shape;
+  xla::PrimitiveType type = features_shape.element_type();
+  xla::PrimitiveType accumulation_type =
+      type == xla::PrimitiveType::BF16 || type == xla::PrimitiveType::F16
+          ? xla::PrimitiveType::F32
+          : type;
+  xla::XlaBuilder* builder = features.builder();
+  int64_t num_classes = features_shape.dimensions(1);
+  int64_t chunk_size = GetCrossEntropyChunkSize();
+  if (chunk_size <= 0 || chunk_size > num_classes) {
+    chunk_size = num_classes;
+  }
+  xla::XlaComputation max_func =
+      XlaHelpers::CreateMaxComputation(accumulation_type);
+  xla::XlaComputation add_func =
+      XlaHelpers::CreateAddComputation(accumulation_type);
+  xla::XlaOp min_value = xla::MinValue(builder, accumulation_type);
+  xla::XlaOp zero = xla::Zero(builder, accumulation_type);
+
+  std::vector<xla::XlaOp> chunks;
+  xla::XlaOp row_max;
+  xla::XlaOp row_sum;
+  for (int64_t start = 0; start < num_classes; start += chunk_size) {
+    int64_t limit = std::min(start + chunk_size, num_classes);
+    xla::XlaOp chunk = xla::SliceInDim(features, start, limit, 1, 1);
+    if (accumulation_type != type) {
+      chunk = xla::ConvertElementType(chunk, accumulation_type);
+    }
+    xla::XlaOp chunk_max = xla::Reduce(chunk, min_value, max_func, {1});
+    if (start == 0) {
+      row_max = chunk_max;
+      row_sum = xla::Reduce(xla::Exp(xla::Sub(chunk, row_max, {0})), zero,
+                            add_func, {1});
+    } else {
+      xla::XlaOp new_max = xla::Max(row_max, chunk_max);
+      row_sum = row_sum * xla::Exp(row_max - new_max) +
+                xla::Reduce(xla::Exp(xla::Sub(chunk, new_max, {0})), zero,
+                            add_func, {1});
+      row_max = new_max;
+    }
+    chunks.push_back(chunk);
+  }
+  xla::XlaOp log_sum_exp = row_max + xla::Log(row_sum);
+
+  xla::XlaOp picked = GatherLabels(features, ClampLabels(labels, num_classes));
+  if (accumulation_type != type) {
+    picked = xla::ConvertElementType(picked, accumulation_type);
+  }
+  xla::XlaOp loss = log_sum_exp - picked;
+
+  std::vector<xla::XlaOp> backprop_chunks;
+  xla::XlaOp one = xla::One(builder, accumulation_type);
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    int64_t start = i * chunk_size;
+    int64_t width = XlaHelpers::ShapeOfXlaOp(chunks[i]).dimensions(1);
+    xla::XlaOp softmax = xla::Exp(xla::Sub(chunks[i], log_sum_exp, {0}));
+    xla::XlaOp backprop =
+        xla::Select(LabelsMask(labels, width, start), softmax - one, softmax);
+    if (accumulation_type != type) {
+      backprop = xla::ConvertElementType(backprop, type);
+    }
+    backprop_chunks.push_back(backprop);
   }
-  xla::XlaOp result = xla::Neg(one_hot_labels) * grad;
-  WeightScale weight_scale = GetMaskedWeight(weight, logits_shape, labels,
-                                             one_hot_labels, ignore_index);
-  result = result * weight_scale.weight;
-  if (reduction_mode != ReductionMode::kMean) {
-    return result;
+  if (accumulation_type != type) {
+    loss = xla::ConvertElementType(loss, type);
   }
-  return result / weight_scale.scale;
+  xla::XlaOp backprop = backprop_chunks.size() == 1
+                            ? backprop_chunks.front()
+                            : xla::ConcatInDim(builder, backprop_chunks, 1);
+  return {loss, backprop};
 }
 
 }  // namespace swift_xla
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "absl/types/optional.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/reduction.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
@@ -35,4 +37,10 @@ xla::XlaOp BuildNllLossBackward(xla::XlaOp grad_output, xla::XlaOp logits,
                                 const absl::optional<xla::XlaOp>& total_weight,
                                 int ignore_index, ReductionMode reduction_mode);
 
+// Builds the softmax cross entropy loss of the [N, C] "features" against the
+// [N] class indices "labels", returning the loss and its gradient with respect
+// to the features. The labels must lie in [0, C).
+std::vector<xla::XlaOp> BuildSparseSoftmaxCrossEntropy(xla::XlaOp features,
+                                                       xla::XlaOp labels);
+
 }  // namespace swift_xla
@@ -1,155 +1,204 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/nms_op.h"
 
+#include <algorithm>
 #include <limits>
 
 #include "tensorflow/compiler/xla/client/lib/arithmetic.h"
-#include "tensorflow/compiler/xla/client/lib/comparators.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
 #include "tensorflow/compiler/xla/client/lib/loops.h"
+#include "tensorflow/compiler/xla/client/lib/slicing.h"
 #include "tensorflow/compiler/xla/client/lib/sorting.h"
-#include "tensorflow/compiler/xla/util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
-#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/convert_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 
-// Code extracted from:
+// The boxes get sorted by score and split into blocks of XLA_NMS_BLOCK_SIZE
+// boxes. Each block gets suppressed by the boxes selected in the blocks before
+// it, and then by its own boxes, so only a block by block slice of the IoU
+// matrix is live at a time, and the visit stops at the block which fills the
+// output. This follows the padded NMS of the TensorFlow object detection
+// models, which replaced the full IoU matrix of:
 // https://github.com/tensorflow/tensorflow/blob/dc4c6d305ba3d2de4a795ec77b483b0fa695b9ee/tensorflow/compiler/tf2xla/kernels/image_ops.cc#L399
 
 namespace swift_xla {
 namespace {
 
-struct WhileCondFn {
-  WhileCondFn(int64_t num_boxes, int64_t output_size)
-      : num_boxes(num_boxes), output_size(output_size) {}
+int64_t GetNmsBlockSize() {
+  static const int64_t block_size =
+      xla::sys_util::GetEnvInt("XLA_NMS_BLOCK_SIZE", 512);
+  return block_size;
+}
 
-  xla::StatusOr<xla::XlaOp> operator()(absl::Span<const xla::XlaOp> values,
-                                       xla::XlaBuilder* builder) const {
-    xla::XlaOp row_idx = values[0];
-    xla::XlaOp row_in_bounds =
-        xla::Lt(row_idx, xla::ConstantR0<int32_t>(builder, num_boxes));
-    xla::XlaOp num_outputs_so_far = values[1];
-    xla::XlaOp results_not_full = xla::Lt(
-        num_outputs_so_far, xla::ConstantR0<int32_t>(builder, output_size));
-    return xla::And(row_in_bounds, results_not_full);
-  }
+struct NmsDims {
+  int64_t batch_size;
+  int64_t num_blocks;
+  int64_t block_size;
+};
 
-  int64_t num_boxes;
-  int64_t output_size;
+// The [batch, block_size] corners of a block of boxes, with y1 <= y2 and
+// x1 <= x2.
+struct BoxBlock {
+  xla::XlaOp y1;
+  xla::XlaOp x1;
+  xla::XlaOp y2;
+  xla::XlaOp x2;
 };
 
-// Process the boxes one-by-one using the iou matrix mask.
-// This implementation uses a correct, but greedy, sequential algorithm
-// to ensure that suppressed boxes cannot themselves suppress other
-// boxes.
-struct SuppressBodyFn {
-  explicit SuppressBodyFn(int64_t num_boxes) : num_boxes(num_boxes) {}
+// Slices the [batch, block_size] block at the given index out of a
+// [batch, num_blocks, block_size] operand.
+xla::XlaOp SliceBlock(xla::XlaOp input, xla::XlaOp block,
+                      const NmsDims& dims) {
+  xla::XlaOp zero = xla::ScalarLike(block, 0);
+  return xla::Reshape(xla::DynamicSlice(input, {zero, block, zero},
+                                        {dims.batch_size, 1, dims.block_size}),
+                      {dims.batch_size, dims.block_size});
+}
 
-  xla::StatusOr<std::vector<xla::XlaOp>> operator()(
-      absl::Span<const xla::XlaOp> values, xla::XlaBuilder* builder) const {
-    xla::XlaOp row_idx = values[0];
-    xla::XlaOp num_outputs_so_far = values[1];
-    xla::XlaOp iou_mask = values[2];
-    xla::XlaOp included_iou = values[3];
-    xla::XlaOp zero = xla::Zero(builder, xla::PrimitiveType::S32);
-    xla::XlaOp one = xla::One(builder, xla::PrimitiveType::S32);
-    // Determine if current elem is active using a slice.
-    // The only reason we need an explicit vector is because some old GCCs can't
-    // deduce the right type for MakeConstSpan, and providing a single-value
-    // initializer list directly uses the wrong overload. Delete this once the
-    // deprecated overload is gone.
-    std::vector<xla::XlaOp> row_idx_vector = {row_idx};
-    xla::XlaOp active_elem =
-        xla::DynamicSlice(included_iou, row_idx_vector, {1});
-    active_elem = xla::Reshape(active_elem, {});
-    // Increment output count iff current elem is not suppressed.
-    num_outputs_so_far =
-        xla::Select(active_elem, num_outputs_so_far + one, num_outputs_so_far);
-    // Slice out the row_idx.
-    xla::XlaOp row_iou =
-        xla::DynamicSlice(iou_mask, {row_idx, zero}, {1, num_boxes});
-    // Remove the diagonal from consideration. An elem cannot suppress
-    // itself.
-    row_iou = xla::DynamicUpdateSlice(
-        row_iou, xla::ConstantR2FromArray2D<bool>(builder, {{false}}),
-        {zero, row_idx});
-    // Create a suppression by inverting polarity.
-    row_iou = xla::Reshape(row_iou, {num_boxes});
-    xla::XlaOp supp_mask = xla::Not(row_iou);
-    // Update mask iff current elem is not suppressed.
-    included_iou = xla::Select(xla::Broadcast(active_elem, {num_boxes}),
-                               xla::And(included_iou, supp_mask), included_iou);
-    return std::vector<xla::XlaOp>{row_idx + one, num_outputs_so_far, iou_mask,
-                                   included_iou};
-  }
+BoxBlock SliceBoxBlock(absl::Span<const xla::XlaOp> corners, xla::XlaOp block,
+                       const NmsDims& dims) {
+  return {SliceBlock(corners[0], block, dims),
+          SliceBlock(corners[1], block, dims),
+          SliceBlock(corners[2], block, dims),
+          SliceBlock(corners[3], block, dims)};
+}
 
-  int64_t num_boxes;
-};
+// The [batch, rows, cols] mask of the pairs of boxes whose IoU is above the
+// threshold. As in the TensorFlow kernel, empty boxes overlap nothing.
+xla::XlaOp OverlapMask(const BoxBlock& rows, const BoxBlock& cols,
+                       xla::XlaOp iou_threshold) {
+  const xla::Shape& rows_shape = XlaHelpers::ShapeOfXlaOp(rows.y1);
+  const xla::Shape& cols_shape = XlaHelpers::ShapeOfXlaOp(cols.y1);
+  std::vector<int64_t> sizes = {rows_shape.dimensions(0),
+                                rows_shape.dimensions(1),
+                                cols_shape.dimensions(1)};
+  auto broadcast_rows = [&](xla::XlaOp op) {
+    return xla::BroadcastInDim(op, sizes, {0, 1});
+  };
+  auto broadcast_cols = [&](xla::XlaOp op) {
+    return xla::BroadcastInDim(op, sizes, {0, 2});
+  };
+  xla::XlaOp zero = xla::ScalarLike(rows.y1, 0);
+  xla::XlaOp height =
+      xla::Max(xla::Min(broadcast_rows(rows.y2), broadcast_cols(cols.y2)) -
+                   xla::Max(broadcast_rows(rows.y1), broadcast_cols(cols.y1)),
+               zero);
+  xla::XlaOp width =
+      xla::Max(xla::Min(broadcast_rows(rows.x2), broadcast_cols(cols.x2)) -
+                   xla::Max(broadcast_rows(rows.x1), broadcast_cols(cols.x1)),
+               zero);
+  xla::XlaOp intersection = height * width;
+  xla::XlaOp rows_area =
+      broadcast_rows((rows.y2 - rows.y1) * (rows.x2 - rows.x1));
+  xla::XlaOp cols_area =
+      broadcast_cols((cols.y2 - cols.y1) * (cols.x2 - cols.x1));
+  xla::XlaOp iou = intersection / (rows_area + cols_area - intersection);
+  xla::XlaOp non_empty =
+      xla::And(xla::Gt(rows_area, zero), xla::Gt(cols_area, zero));
+  return xla::And(non_empty, xla::Gt(iou, iou_threshold));
+}
 
-xla::XlaOp NmsGather(xla::XlaOp input, absl::Span<const int64_t> input_sizes,
-                     xla::XlaOp indices,
-                     absl::Span<const int64_t> indices_sizes,
-                     int64_t axis) {
-  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
-  int64_t num_indices = xla::util::Multiply<int64_t>(indices_sizes);
-  if (num_indices == 0) {
-    std::vector<int64_t> output_sizes =
-        xla::util::ToVector<int64_t>(input_sizes);
-    output_sizes.erase(std::next(output_sizes.begin(), axis));
-    return xla::Broadcast(
-        xla::Zero(input.builder(), input_shape.element_type()), output_sizes);
-  }
+// Whether each column box of the [batch, rows, cols] overlap mask overlaps a
+// row box which is alive.
+xla::XlaOp AnyOverlap(xla::XlaOp overlap, xla::XlaOp rows_alive) {
+  xla::XlaBuilder* builder = overlap.builder();
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(overlap);
+  xla::XlaOp masked = xla::And(
+      overlap, xla::BroadcastInDim(rows_alive, shape.dimensions(), {0, 1}));
+  return xla::Reduce(
+      masked, xla::ConstantR0<bool>(builder, false),
+      xla::CreateScalarOrComputation(xla::PrimitiveType::PRED, builder), {1});
+}
 
-  // Example of a 1-D gather with axis=1, pulling two [3,1] tensors out of a
-  // tensor of shape [3,3].
-  //
-  //  operand = s32[3,3] parameter(0)
-  //  indices = s32[2] parameter(1)
-  //  gather = s32[3,2] gather(operand, indices),
-  //       offset_dims={0},
-  //       collapsed_slice_dims={1},
-  //       start_index_map={1},
-  //       index_vector_dim=1,
-  //       slice_sizes={3, 1}
-  //
-  //
-  // Example of an N-D gather pulling out slices of shape [1,1,2] out of a
-  // tensor of shape [3,3,2].
-  //
-  //  operand = s32[3,3,2] parameter(0)
-  //  indices = s32[2,2] parameter(1)
-  //  gather = s32[2,2] gather(operand, indices),
-  //       offset_dims={1},
-  //       collapsed_slice_dims={0,1},
-  //       start_index_map={0,1},
-  //       index_vector_dim=0,
-  //       slice_sizes={1,1,2}
-  xla::GatherDimensionNumbers dim_numbers;
-  std::vector<int64_t> slice_sizes;
-  for (int64_t i = 0; i < input_sizes.size(); ++i) {
-    int64_t window_bound;
-    if (i == axis) {
-      dim_numbers.add_collapsed_slice_dims(i);
-      window_bound = 1;
-    } else {
-      window_bound = input_sizes[i];
-    }
-    slice_sizes.push_back(window_bound);
-    if (i < axis) {
-      dim_numbers.add_offset_dims(i);
-    } else if (i > axis) {
-      dim_numbers.add_offset_dims(i + indices_sizes.size() - 1);
-    }
-  }
-  dim_numbers.set_index_vector_dim(indices_sizes.size());
-  dim_numbers.add_start_index_map(axis);
-  return xla::Gather(input, indices, dim_numbers, slice_sizes);
+// Clears the boxes of the block which overlap a box selected within one of the
+// blocks before it.
+xla::XlaOp SuppressByPreviousBlocks(xla::XlaOp block, xla::XlaOp block_alive,
+                                    xla::XlaOp alive,
+                                    absl::Span<const xla::XlaOp> corners,
+                                    xla::XlaOp iou_threshold,
+                                    const NmsDims& dims,
+                                    xla::XlaBuilder* builder) {
+  auto cond_fn = [](absl::Span<const xla::XlaOp> values,
+                    xla::XlaBuilder* builder) -> xla::StatusOr<xla::XlaOp> {
+    return xla::Lt(values[0], values[1]);
+  };
+  auto body_fn =
+      [&dims](absl::Span<const xla::XlaOp> values, xla::XlaBuilder* builder)
+      -> xla::StatusOr<std::vector<xla::XlaOp>> {
+    xla::XlaOp previous = values[0];
+    absl::Span<const xla::XlaOp> loop_corners = values.subspan(4, 4);
+    xla::XlaOp overlap =
+        OverlapMask(SliceBoxBlock(loop_corners, previous, dims),
+                    SliceBoxBlock(loop_corners, values[1], dims), values[8]);
+    std::vector<xla::XlaOp> results(values.begin(), values.end());
+    results[0] = previous + xla::ScalarLike(previous, 1);
+    results[2] = xla::And(
+        values[2],
+        xla::Not(AnyOverlap(overlap, SliceBlock(values[3], previous, dims))));
+    return results;
+  };
+  std::vector<xla::XlaOp> init_values = {xla::ScalarLike(block, 0), block,
+                                         block_alive, alive};
+  init_values.insert(init_values.end(), corners.begin(), corners.end());
+  init_values.push_back(iou_threshold);
+  return ConsumeValue(xla::WhileLoopHelper(cond_fn, body_fn, init_values,
+                                           "NmsPreviousBlocksLoop",
+                                           builder))[2];
+}
+
+// Suppresses the boxes of the block by the higher scoring boxes of the same
+// block, which come before them. Iterating until nothing changes yields the
+// greedy result, since the status of a box only depends on the boxes before
+// it, so the first k statuses are final after k iterations.
+xla::XlaOp SuppressWithinBlock(const BoxBlock& boxes, xla::XlaOp block_alive,
+                               xla::XlaOp iou_threshold, const NmsDims& dims,
+                               xla::XlaBuilder* builder) {
+  xla::Shape mask_shape = xla::ShapeUtil::MakeShape(
+      xla::PrimitiveType::S32,
+      {dims.batch_size, dims.block_size, dims.block_size});
+  xla::XlaOp earlier = xla::Lt(xla::Iota(builder, mask_shape, 1),
+                               xla::Iota(builder, mask_shape, 2));
+  xla::XlaOp overlap =
+      xla::And(OverlapMask(boxes, boxes, iou_threshold), earlier);
+  auto cond_fn = [](absl::Span<const xla::XlaOp> values,
+                    xla::XlaBuilder* builder) -> xla::StatusOr<xla::XlaOp> {
+    return values[0];
+  };
+  auto body_fn = [](absl::Span<const xla::XlaOp> values,
+                    xla::XlaBuilder* builder)
+      -> xla::StatusOr<std::vector<xla::XlaOp>> {
+    xla::XlaOp loop_alive = values[1];
+    xla::XlaOp initial_alive = values[2];
+    xla::XlaOp loop_overlap = values[3];
+    xla::XlaOp new_alive = xla::And(
+        initial_alive, xla::Not(AnyOverlap(loop_overlap, loop_alive)));
+    xla::XlaOp changed = xla::Reduce(
+        xla::Xor(new_alive, loop_alive), xla::ConstantR0<bool>(builder, false),
+        xla::CreateScalarOrComputation(xla::PrimitiveType::PRED, builder),
+        {0, 1});
+    return std::vector<xla::XlaOp>{changed, new_alive, initial_alive,
+                                   loop_overlap};
+  };
+  std::vector<xla::XlaOp> init_values = {xla::ConstantR0<bool>(builder, true),
+                                         block_alive, block_alive, overlap};
+  return ConsumeValue(xla::WhileLoopHelper(cond_fn, body_fn, init_values,
+                                           "NmsWithinBlockLoop", builder))[1];
+}
+
+xla::XlaOp SumAlongRows(xla::XlaOp mask) {
+  xla::XlaBuilder* builder = mask.builder();
+  return xla::Reduce(
+      xla::ConvertElementType(mask, xla::PrimitiveType::S32),
+      xla::Zero(builder, xla::PrimitiveType::S32),
+      xla::CreateScalarAddComputation(xla::PrimitiveType::S32, builder), {1});
 }
 
 }  // namespace
 
 NmsResult BuildNms(xla::XlaOp boxes, xla::XlaOp scores,
                    xla::XlaOp score_threshold, xla::XlaOp iou_threshold,
-                   int64_t output_size) {
+                   int64_t output_size, int64_t pre_nms_top_k) {
   const xla::Shape& boxes_shape = XlaHelpers::ShapeOfXlaOp(boxes);
   int64_t num_boxes = boxes_shape.dimensions(0);
   const xla::Shape& scores_shape = XlaHelpers::ShapeOfXlaOp(scores);
@@ -157,135 +206,164 @@ NmsResult BuildNms(xla::XlaOp boxes, xla::XlaOp scores,
   XLA_CHECK_EQ(boxes_shape.dimensions(1), 4);
   XLA_CHECK_EQ(scores_shape.rank(), 1);
   XLA_CHECK_EQ(scores_shape.dimensions(0), num_boxes);
+  NmsResult result =
+      BuildBatchedNms(boxes, xla::Reshape(scores, {1, num_boxes}),
+                      score_threshold, iou_threshold, output_size,
+                      pre_nms_top_k);
+  return {xla::Reshape(result.selected_indices, {output_size}),
+          xla::Reshape(result.num_valid, {})};
+}
+
+NmsResult BuildBatchedNms(xla::XlaOp boxes, xla::XlaOp scores,
+                          xla::XlaOp score_threshold, xla::XlaOp iou_threshold,
+                          int64_t output_size, int64_t pre_nms_top_k) {
+  xla::XlaBuilder* builder = scores.builder();
+  const xla::Shape& scores_shape = XlaHelpers::ShapeOfXlaOp(scores);
+  XLA_CHECK_EQ(scores_shape.rank(), 2);
+  int64_t batch_size = scores_shape.dimensions(0);
+  int64_t num_boxes = scores_shape.dimensions(1);
+  xla::PrimitiveType score_type = scores_shape.element_type();
+  if (XlaHelpers::ShapeOfXlaOp(boxes).rank() == 2) {
+    boxes = xla::BroadcastInDim(boxes, {batch_size, num_boxes, 4}, {1, 2});
+  }
+  const xla::Shape& boxes_shape = XlaHelpers::ShapeOfXlaOp(boxes);
+  XLA_CHECK_EQ(boxes_shape.rank(), 3);
+  XLA_CHECK_EQ(boxes_shape.dimensions(0), batch_size);
+  XLA_CHECK_EQ(boxes_shape.dimensions(1), num_boxes);
+  XLA_CHECK_EQ(boxes_shape.dimensions(2), 4);
   XLA_CHECK_LT(num_boxes, std::numeric_limits<int32_t>::max());
   XLA_CHECK_GE(output_size, 0);
   XLA_CHECK_LT(output_size, std::numeric_limits<int32_t>::max());
+  xla::PrimitiveType box_type = boxes_shape.element_type();
+  int64_t num_candidates = pre_nms_top_k > 0
+                               ? std::min(pre_nms_top_k, num_boxes)
+                               : num_boxes;
+  if (num_candidates == 0 || output_size == 0) {
+    return {xla::Zeros(builder,
+                       xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32,
+                                                 {batch_size, output_size})),
+            xla::Zeros(builder, xla::ShapeUtil::MakeShape(
+                                    xla::PrimitiveType::S32, {batch_size}))};
+  }
+  // Keep the highest scoring candidates, in decreasing score order.
+  xla::XlaOp top_k = xla::TopK(scores, num_candidates);
+  xla::XlaOp sorted_scores = xla::GetTupleElement(top_k, 0);
+  xla::XlaOp sorted_indices = xla::GetTupleElement(top_k, 1);
+  xla::XlaOp sorted_boxes = xla::TorchGather(
+      boxes,
+      xla::BroadcastInDim(sorted_indices, {batch_size, num_candidates, 4},
+                          {0, 1}),
+      /*dim=*/1);
 
-  xla::XlaBuilder* builder = boxes.builder();
-  // Choose a more convenient layout.
-  xla::XlaOp boxes_transposed = xla::Transpose(boxes, {1, 0});
-  xla::XlaOp boxes_sorted = xla::GetTupleElement(
-      xla::Sort({xla::Broadcast(scores, {4}), boxes_transposed},
-                xla::CreateScalarGtComputation(
-                    {scores_shape.element_type(), boxes_shape.element_type()},
-                    builder),
-                /*dimension=*/1),
-      1);
-  // Track the mapping of indices into sorted domain.
-  xla::XlaOp iota_indices =
-      xla::Iota(builder, xla::PrimitiveType::S32, num_boxes);
-  xla::XlaOp indices_sort = xla::Sort(
-      {scores, iota_indices},
-      xla::CreateScalarGtComputation(
-          {scores_shape.element_type(), xla::PrimitiveType::S32}, builder));
-  xla::XlaOp indices_sorted = xla::GetTupleElement(indices_sort, 1);
-  xla::XlaOp scores_sorted = xla::GetTupleElement(indices_sort, 0);
-
-  // Shapes are henceforth [1, num_boxes]. 'c_y0' denotes 'coordinate' y0.
-  xla::XlaOp c_y0 = xla::Reshape(xla::SliceInDim(boxes_sorted,
-                                                 /*start_index=*/0,
-                                                 /*limit_index=*/1,
-                                                 /*stride=*/1,
-                                                 /*dimno=*/0),
-                                 {num_boxes});
-  xla::XlaOp c_x0 = xla::Reshape(xla::SliceInDim(boxes_sorted,
-                                                 /*start_index=*/1,
-                                                 /*limit_index=*/2,
-                                                 /*stride=*/1,
-                                                 /*dimno=*/0),
-                                 {num_boxes});
-  xla::XlaOp c_y1 = xla::Reshape(xla::SliceInDim(boxes_sorted,
-                                                 /*start_index=*/2,
-                                                 /*limit_index=*/3,
-                                                 /*stride=*/1,
-                                                 /*dimno=*/0),
-                                 {num_boxes});
-  xla::XlaOp c_x1 = xla::Reshape(xla::SliceInDim(boxes_sorted,
-                                                 /*start_index=*/3,
-                                                 /*limit_index=*/4,
-                                                 /*stride=*/1,
-                                                 /*dimno=*/0),
-                                 {num_boxes});
-
-  xla::XlaOp y1 = xla::Select(xla::Le(c_y0, c_y1), c_y0, c_y1);
-  xla::XlaOp y2 = xla::Select(xla::Le(c_y0, c_y1), c_y1, c_y0);
-  xla::XlaOp x1 = xla::Select(xla::Le(c_x0, c_x1), c_x0, c_x1);
-  xla::XlaOp x2 = xla::Select(xla::Le(c_x0, c_x1), c_x1, c_x0);
-  xla::XlaOp area = (y2 - y1) * (x2 - x1);
-
-  // Shapes are henceforth [1, num_boxes].
-  y1 = xla::Broadcast(y1, {1});
-  y2 = xla::Broadcast(y2, {1});
-  x1 = xla::Broadcast(x1, {1});
-  x2 = xla::Broadcast(x2, {1});
-  area = xla::Broadcast(area, {1});
-
-  // Shapes are henceforth [num_boxes, num_boxes].
-  xla::XlaOp i_xmin = xla::Max(x1, xla::Transpose(x1, {1, 0}));
-  xla::XlaOp i_ymin = xla::Max(y1, xla::Transpose(y1, {1, 0}));
-  xla::XlaOp i_xmax = xla::Min(x2, xla::Transpose(x2, {1, 0}));
-  xla::XlaOp i_ymax = xla::Min(y2, xla::Transpose(y2, {1, 0}));
-  auto square_zero = xla::ZerosLike(i_xmin);
-
-  xla::XlaOp i_area = xla::Max(i_xmax - i_xmin, square_zero) *
-                      xla::Max(i_ymax - i_ymin, square_zero);
-  xla::XlaOp u_area = area + xla::Transpose(area, {1, 0}) - i_area;
-  xla::XlaOp iou = i_area / u_area;
+  NmsDims dims;
+  dims.batch_size = batch_size;
+  dims.block_size = std::min(GetNmsBlockSize(), num_candidates);
+  dims.num_blocks = (num_candidates + dims.block_size - 1) / dims.block_size;
+  int64_t padded_size = dims.num_blocks * dims.block_size;
+  // The padding boxes are empty and never alive, so they have no effect.
+  auto to_blocks = [&](xla::XlaOp input, xla::XlaOp padding_value) {
+    return xla::Reshape(xla::PadInDim(input, padding_value, /*dimno=*/1,
+                                      /*pad_lo=*/0,
+                                      /*pad_hi=*/padded_size - num_candidates),
+                        {batch_size, dims.num_blocks, dims.block_size});
+  };
+  auto corner = [&](int64_t index) {
+    return xla::Reshape(xla::SliceInDim(sorted_boxes, index, index + 1,
+                                        /*stride=*/1, /*dimno=*/2),
+                        {batch_size, num_candidates});
+  };
+  xla::XlaOp c_y0 = corner(0);
+  xla::XlaOp c_x0 = corner(1);
+  xla::XlaOp c_y1 = corner(2);
+  xla::XlaOp c_x1 = corner(3);
+  xla::XlaOp zero = xla::Zero(builder, box_type);
+  std::vector<xla::XlaOp> corners = {to_blocks(xla::Min(c_y0, c_y1), zero),
+                                     to_blocks(xla::Min(c_x0, c_x1), zero),
+                                     to_blocks(xla::Max(c_y0, c_y1), zero),
+                                     to_blocks(xla::Max(c_x0, c_x1), zero)};
+  // The boxes under the score threshold are not candidates, and do not
+  // suppress the other boxes.
+  xla::XlaOp alive = to_blocks(
+      xla::Gt(sorted_scores, MaybeConvertTo(score_threshold, score_type)),
+      xla::ConstantR0<bool>(builder, false));
+  iou_threshold = MaybeConvertTo(iou_threshold, box_type);
 
-  xla::XlaOp iou_threshold_mask = xla::Gt(iou, iou_threshold + square_zero);
-  xla::XlaOp included_iou =
-      xla::Broadcast(xla::ConstantR0<bool>(builder, true), {num_boxes});
+  auto cond_fn = [&](absl::Span<const xla::XlaOp> values,
+                     xla::XlaBuilder* builder) -> xla::StatusOr<xla::XlaOp> {
+    xla::XlaOp blocks_left =
+        xla::Lt(values[0], xla::ConstantR0<int32_t>(builder, dims.num_blocks));
+    xla::XlaOp not_full = xla::Reduce(
+        xla::Lt(values[1], xla::ConstantR0<int32_t>(builder, output_size)),
+        xla::ConstantR0<bool>(builder, false),
+        xla::CreateScalarOrComputation(xla::PrimitiveType::PRED, builder),
+        {0});
+    return xla::And(blocks_left, not_full);
+  };
+  auto body_fn = [&](absl::Span<const xla::XlaOp> values,
+                     xla::XlaBuilder* builder)
+      -> xla::StatusOr<std::vector<xla::XlaOp>> {
+    xla::XlaOp block = values[0];
+    xla::XlaOp loop_alive = values[2];
+    absl::Span<const xla::XlaOp> loop_corners = values.subspan(3, 4);
+    xla::XlaOp loop_iou_threshold = values[7];
+    xla::XlaOp block_alive = SuppressByPreviousBlocks(
+        block, SliceBlock(loop_alive, block, dims), loop_alive, loop_corners,
+        loop_iou_threshold, dims, builder);
+    block_alive =
+        SuppressWithinBlock(SliceBoxBlock(loop_corners, block, dims),
+                            block_alive, loop_iou_threshold, dims, builder);
+    xla::XlaOp block_zero = xla::ScalarLike(block, 0);
+    std::vector<xla::XlaOp> results = {
+        block + xla::ScalarLike(block, 1),
+        values[1] + SumAlongRows(block_alive),
+        xla::DynamicUpdateSlice(
+            loop_alive,
+            xla::Reshape(block_alive, {batch_size, 1, dims.block_size}),
+            {block_zero, block, block_zero})};
+    results.insert(results.end(), loop_corners.begin(), loop_corners.end());
+    results.push_back(loop_iou_threshold);
+    return results;
+  };
+  std::vector<xla::XlaOp> init_values = {
+      xla::Zero(builder, xla::PrimitiveType::S32),
+      xla::Zeros(builder, xla::ShapeUtil::MakeShape(xla::PrimitiveType::S32,
+                                                    {batch_size})),
+      alive};
+  init_values.insert(init_values.end(), corners.begin(), corners.end());
+  init_values.push_back(iou_threshold);
+  std::vector<xla::XlaOp> loop_results = ConsumeValue(xla::WhileLoopHelper(
+      cond_fn, body_fn, init_values, "NmsBlockLoop", builder));
 
+  // The blocks past the one which filled the output were never visited.
+  xla::Shape blocks_shape = xla::ShapeUtil::MakeShape(
+      xla::PrimitiveType::S32, {batch_size, dims.num_blocks, dims.block_size});
+  xla::XlaOp visited = xla::Lt(xla::Iota(builder, blocks_shape, 1),
+                               xla::Broadcast(loop_results[0],
+                                              blocks_shape.dimensions()));
+  xla::XlaOp selected = xla::Reshape(xla::And(loop_results[2], visited),
+                                     {batch_size, padded_size});
+  // Rank the selected positions so that the top output_size ones are the first
+  // selected boxes, in score order. The unselected positions fill the rest.
+  xla::Shape positions_shape = xla::ShapeUtil::MakeShape(
+      xla::PrimitiveType::S32, {batch_size, padded_size});
+  xla::XlaOp rank_key = xla::Select(
+      selected,
+      xla::ConstantR0<int32_t>(builder, padded_size) -
+          xla::Iota(builder, positions_shape, 1),
+      xla::Zeros(builder, positions_shape));
+  int64_t key_size = std::max(padded_size, output_size);
   xla::XlaOp zero_s32 = xla::Zero(builder, xla::PrimitiveType::S32);
-  xla::XlaOp one_s32 = xla::One(builder, xla::PrimitiveType::S32);
-  std::vector<xla::XlaOp> init_values;
-  init_values.reserve(4);
-  init_values.push_back(zero_s32);  // col_idx
-  init_values.push_back(zero_s32);  // num_outputs
-  init_values.push_back(iou_threshold_mask);
-  init_values.push_back(included_iou);
-
-  auto suppress_loop_result = ConsumeValue(xla::WhileLoopHelper(
-      WhileCondFn(num_boxes, output_size), SuppressBodyFn(num_boxes),
-      init_values, "BoxSuppressLoop", builder));
-
-  xla::XlaOp included_score =
-      xla::Gt(scores_sorted, xla::Broadcast(score_threshold, {num_boxes}));
-  xla::XlaOp included = xla::And(included_score, suppress_loop_result[3]);
-
-  // Only consider boxes over which we have iterated. This allows for accurate
-  // counting. DynamicSlice would require knowledge of the size of the output.
-  xla::XlaOp valid_elem = xla::Lt(
-      iota_indices, xla::Broadcast(suppress_loop_result[0], {num_boxes}));
-  included = xla::And(included, valid_elem);
-
-  xla::XlaOp neg_inf = xla::Broadcast(
-      xla::MinValue(builder, scores_shape.element_type()), {num_boxes});
-  xla::XlaOp scores_included = xla::Select(included, scores_sorted, neg_inf);
-  xla::XlaOp output_tuple = xla::TopK(scores_included, output_size);
-  xla::XlaOp selected_indices_sorted = xla::GetTupleElement(output_tuple, 1);
-  // Calculate num_valid.
-  // Note: num_valid cannot be taken from the loop outputs, because outputs
-  // can be suppressed by score threshold.
-  xla::XlaOp ones_included =
-      xla::Select(included, xla::Broadcast(one_s32, {num_boxes}),
-                  xla::Broadcast(zero_s32, {num_boxes}));
-  // num_valid is scalar. Value should be bound by output_size.
-  xla::XlaOp num_valid_total = xla::Reduce(
-      ones_included,
-      /*init_value=*/zero_s32,
-      /*computation=*/
-      xla::CreateScalarAddComputation(xla::PrimitiveType::S32, builder),
-      /*dimensions_to_reduce=*/{0});
-  xla::XlaOp num_valid = xla::Min(
-      num_valid_total, xla::ConstantR0<int32_t>(builder, output_size));
-
-  // Re-index into the original scores input tensor, using a Gather.
-  // Boxes were suppressed in the sorted domain.
+  rank_key = xla::PadInDim(rank_key, zero_s32, /*dimno=*/1, /*pad_lo=*/0,
+                           /*pad_hi=*/key_size - padded_size);
+  xla::XlaOp positions =
+      xla::GetTupleElement(xla::TopK(rank_key, output_size), 1);
+  xla::XlaOp padded_indices =
+      xla::PadInDim(sorted_indices, zero_s32, /*dimno=*/1, /*pad_lo=*/0,
+                    /*pad_hi=*/key_size - num_candidates);
   xla::XlaOp selected_indices =
-      NmsGather(indices_sorted, scores_shape.dimensions(),
-                selected_indices_sorted, {output_size},
-                /*axis=*/0);
+      xla::TorchGather(padded_indices, positions, /*dim=*/1);
+  xla::XlaOp num_valid = xla::Min(
+      loop_results[1], xla::ConstantR0<int32_t>(builder, output_size));
   return {selected_indices, num_valid};
 }
 
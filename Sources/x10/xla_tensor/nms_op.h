@@ -9,8 +9,24 @@ struct NmsResult {
   xla::XlaOp num_valid;
 };
 
+// Greedily selects, in decreasing score order, up to output_size of the boxes
+// whose score is above score_threshold, skipping the ones whose IoU with an
+// already selected box is above iou_threshold. The boxes are [num_boxes, 4],
+// as (y1, x1, y2, x2) corners in any order, and the scores [num_boxes]. When
+// pre_nms_top_k is positive, only that many of the highest scoring boxes get
+// considered. Returns the S32 [output_size] indices of the selected boxes, the
+// first num_valid of which are meaningful.
 NmsResult BuildNms(xla::XlaOp boxes, xla::XlaOp scores,
                    xla::XlaOp score_threshold, xla::XlaOp iou_threshold,
-                   int64_t output_size);
+                   int64_t output_size, int64_t pre_nms_top_k = 0);
+
+// Runs BuildNms() independently over the leading dimension of the
+// [batch, num_boxes] scores, which covers multi-class suppression with one row
+// of scores per class. The boxes are either [batch, num_boxes, 4], or
+// [num_boxes, 4] when shared by all the rows. Returns the [batch, output_size]
+// indices and the [batch] num_valid.
+NmsResult BuildBatchedNms(xla::XlaOp boxes, xla::XlaOp scores,
+                          xla::XlaOp score_threshold, xla::XlaOp iou_threshold,
+                          int64_t output_size, int64_t pre_nms_top_k = 0);
 
 }  // namespace swift_xla
@@ -0,0 +1,270 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/node_pool.h"
+
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/core/platform/mem.h"
+
+namespace swift_xla {
+namespace ir {
+namespace {
+
+// Slabs are aligned to their size, so that the slab owning a chunk can be
+// found by masking the chunk address.
+constexpr size_t kSlabSize = 64 * 1024;
+constexpr size_t kSlabHeaderSize = 64;
+constexpr size_t kChunkAlign = 16;
+constexpr size_t kMaxChunkSize = 1024;
+constexpr size_t kNumSizeClasses = kMaxChunkSize / kChunkAlign;
+// Number of entirely free slabs per size class which Trim() keeps around, to
+// avoid hitting the system allocator again at the beginning of the next step.
+constexpr size_t kRetainedSlabs = 4;
+// Number of chunks per size class a thread keeps for itself, and the number of
+// chunks moved at once between a thread cache and the shared free list.
+constexpr size_t kThreadCacheChunks = 64;
+constexpr size_t kTransferChunks = kThreadCacheChunks / 2;
+
+struct SlabHeader {
+  size_t live = 0;
+};
+
+struct FreeChunk {
+  FreeChunk* next;
+};
+
+struct SizeClass {
+  std::mutex lock;
+  FreeChunk* free_list = nullptr;
+};
+
+// Per thread free list of a size class. The chunks held here count as live in
+// their slabs, so that the slab headers are only touched under the size class
+// lock, when chunks move in and out of the shared free list.
+struct LocalList {
+  FreeChunk* free_list = nullptr;
+  size_t count = 0;
+};
+
+bool IsPoolEnabled() {
+  static const bool enabled = xla::sys_util::GetEnvBool("XLA_NODE_POOL", true);
+  return enabled;
+}
+
+SizeClass* GetSizeClasses() {
+  static SizeClass* size_classes = new SizeClass[kNumSizeClasses];
+  return size_classes;
+}
+
+size_t GetSizeClass(size_t size) {
+  return (size + kChunkAlign - 1) / kChunkAlign - 1;
+}
+
+SlabHeader* GetSlab(void* ptr) {
+  return reinterpret_cast<SlabHeader*>(reinterpret_cast<uintptr_t>(ptr) &
+                                       ~static_cast<uintptr_t>(kSlabSize - 1));
+}
+
+void PushChunk(SizeClass* size_class, void* ptr) {
+  FreeChunk* chunk = static_cast<FreeChunk*>(ptr);
+  chunk->next = size_class->free_list;
+  size_class->free_list = chunk;
+}
+
+void AllocateSlab(size_t chunk_size, SizeClass* size_class) {
+  void* slab = tensorflow::port::AlignedMalloc(kSlabSize, kSlabSize);
+  XLA_CHECK(slab != nullptr) << "Unable to allocate IR node slab";
+  new (slab) SlabHeader();
+  char* base = static_cast<char*>(slab);
+  for (size_t offset = kSlabHeaderSize; offset + chunk_size <= kSlabSize;
+       offset += chunk_size) {
+    PushChunk(size_class, base + offset);
+  }
+  XLA_COUNTER("NodePoolSlabs", 1);
+}
+
+
+// Moves up to kTransferChunks chunks from the shared free list of the size
+// class into the thread list, allocating a new slab if the shared list is
+// empty.
+void RefillLocalList(size_t index, LocalList* local) {
+  SizeClass* size_class = GetSizeClasses() + index;
+  std::lock_guard<std::mutex> lock(size_class->lock);
+  if (size_class->free_list == nullptr) {
+    AllocateSlab((index + 1) * kChunkAlign, size_class);
+  }
+  for (size_t n = 0; n < kTransferChunks && size_class->free_list != nullptr;
+       ++n) {
+    FreeChunk* chunk = size_class->free_list;
+    size_class->free_list = chunk->next;
+    GetSlab(chunk)->live += 1;
+    chunk->next = local->free_list;
+    local->free_list = chunk;
+    local->count += 1;
+  }
+}
+
+// Moves up to count chunks from the thread list back to the shared free list
+// of the size class.
+void DrainLocalList(size_t index, LocalList* local, size_t count) {
+  SizeClass* size_class = GetSizeClasses() + index;
+  std::lock_guard<std::mutex> lock(size_class->lock);
+  for (size_t n = 0; n < count && local->free_list != nullptr; ++n) {
+    FreeChunk* chunk = local->free_list;
+    local->free_list = chunk->next;
+    local->count -= 1;
+    GetSlab(chunk)->live -= 1;
+    PushChunk(size_class, chunk);
+  }
+}
+
+// Set once the thread caches of the current thread have been destroyed. Nodes
+// can still be freed afterwards while the other thread local objects are torn
+// down, and those go straight to the shared free lists.
+thread_local bool thread_caches_destroyed = false;
+
+// Thread local front of the size classes, so that allocating and freeing nodes
+// only takes the size class lock once every kTransferChunks operations. The
+// chunks are handed back to the shared free lists when the thread exits.
+struct ThreadCaches {
+  ~ThreadCaches() {
+    for (size_t i = 0; i < kNumSizeClasses; ++i) {
+      DrainLocalList(i, lists + i, lists[i].count);
+    }
+    thread_caches_destroyed = true;
+  }
+
+  LocalList lists[kNumSizeClasses];
+};
+
+ThreadCaches* GetThreadCaches() {
+  if (thread_caches_destroyed) {
+    return nullptr;
+  }
+  static thread_local ThreadCaches caches;
+  return &caches;
+}
+
+}  // namespace
+
+void* NodePool::Allocate(size_t size) {
+  if (!IsPoolEnabled() || size > kMaxChunkSize) {
+    return ::operator new(size);
+  }
+  size_t index = GetSizeClass(size);
+  ThreadCaches* caches = GetThreadCaches();
+  if (caches == nullptr) {
+    SizeClass* size_class = GetSizeClasses() + index;
+    std::lock_guard<std::mutex> lock(size_class->lock);
+    if (size_class->free_list == nullptr) {
+      AllocateSlab((index + 1) * kChunkAlign, size_class);
+    }
+    FreeChunk* chunk = size_class->free_list;
+    size_class->free_list = chunk->next;
+    GetSlab(chunk)->live += 1;
+    return chunk;
+  }
+  LocalList* local = caches->lists + index;
+  if (local->free_list == nullptr) {
+    RefillLocalList(index, local);
+  }
+  FreeChunk* chunk = local->free_list;
+  local->free_list = chunk->next;
+  local->count -= 1;
+  return chunk;
+}
+
+void NodePool::Deallocate(void* ptr, size_t size) {
+  if (!IsPoolEnabled() || size > kMaxChunkSize) {
+    ::operator delete(ptr);
+    return;
+  }
+  size_t index = GetSizeClass(size);
+  ThreadCaches* caches = GetThreadCaches();
+  if (caches == nullptr) {
+    SizeClass* size_class = GetSizeClasses() + index;
+    std::lock_guard<std::mutex> lock(size_class->lock);
+    PushChunk(size_class, ptr);
+    GetSlab(ptr)->live -= 1;
+    return;
+  }
+  LocalList* local = caches->lists + index;
+  FreeChunk* chunk = static_cast<FreeChunk*>(ptr);
+  chunk->next = local->free_list;
+  local->free_list = chunk;
+  local->count += 1;
+  if (local->count > kThreadCacheChunks) {
+    DrainLocalList(index, local, kTransferChunks);
+  }
+}
+
+void NodePool::Trim() {
+  if (!IsPoolEnabled()) {
+    return;
+  }
+  // Only the chunks of the calling thread can be handed back here. The ones
+  // cached by the other threads keep their slabs alive until reused, or until
+  // those threads exit.
+  ThreadCaches* caches = GetThreadCaches();
+  size_t released = 0;
+  for (size_t i = 0; i < kNumSizeClasses; ++i) {
+    if (caches != nullptr) {
+      DrainLocalList(i, caches->lists + i, caches->lists[i].count);
+    }
+    SizeClass* size_class = GetSizeClasses() + i;
+    absl::flat_hash_set<SlabHeader*> free_slabs;
+    std::lock_guard<std::mutex> lock(size_class->lock);
+    for (FreeChunk* chunk = size_class->free_list; chunk != nullptr;
+         chunk = chunk->next) {
+      SlabHeader* slab = GetSlab(chunk);
+      if (slab->live == 0) {
+        free_slabs.insert(slab);
+      }
+    }
+    if (free_slabs.size() <= kRetainedSlabs) {
+      continue;
+    }
+    // Keep the first free slabs found, and unlink the chunks of the others.
+    std::vector<SlabHeader*> slabs(free_slabs.begin(), free_slabs.end());
+    for (size_t n = 0; n < kRetainedSlabs; ++n) {
+      free_slabs.erase(slabs[n]);
+    }
+    FreeChunk** link = &size_class->free_list;
+    while (*link != nullptr) {
+      if (free_slabs.contains(GetSlab(*link))) {
+        *link = (*link)->next;
+      } else {
+        link = &(*link)->next;
+      }
+    }
+    for (auto slab : free_slabs) {
+      tensorflow::port::AlignedFree(slab);
+    }
+    released += free_slabs.size();
+  }
+  if (released > 0) {
+    XLA_COUNTER("NodePoolSlabsReleased", released);
+  }
+}
+
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace swift_xla {
+namespace ir {
+
+// Slab pool for the IR node allocations. Chunks are grouped in size classes,
+// and carved out of fixed size slabs, so that allocating and freeing a node is
+// a free list operation, and the nodes of a graph are laid out close to each
+// other. Each thread keeps a small free list per size class in front of the
+// shared ones, so that tracing from several threads does not contend on the
+// size class locks. Freed chunks are kept around for reuse, and Trim() returns
+// the slabs with no live chunks to the system.
+class NodePool {
+ public:
+  static void* Allocate(size_t size);
+
+  static void Deallocate(void* ptr, size_t size);
+
+  // Releases all the slabs which are entirely free. Called at the end of every
+  // step, when the IR graphs of the step have been synced and dropped.
+  static void Trim();
+};
+
+// STL allocator over the NodePool, to be used with std::allocate_shared() so
+// that the node and the shared pointer control block share one pool chunk.
+template <typename T>
+struct NodeAllocator {
+  using value_type = T;
+
+  NodeAllocator() = default;
+
+  template <typename U>
+  NodeAllocator(const NodeAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(NodePool::Allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* ptr, size_t n) {
+    NodePool::Deallocate(ptr, n * sizeof(T));
+  }
+
+  template <typename U>
+  bool operator==(const NodeAllocator<U>&) const {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!=(const NodeAllocator<U>&) const {
+    return false;
+  }
+};
+
+}  // namespace ir
+}  // namespace swift_xla
@@ -14,6 +14,8 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/op_by_op_executor.h"
 
+#include <algorithm>
+#include <limits>
 #include <list>
 #include <unordered_map>
 
@@ -91,14 +93,174 @@ xla::hash_t GetNodesKeySeed(const std::string& device,
   return xla::util::MHash(device, devices);
 }
 
+// A run of IR nodes, in post order, lowered into a single computation. The
+// inputs are the outputs of nodes outside the window, and the outputs are the
+// node outputs used outside the window, in window order.
+struct OpsWindow {
+  std::vector<const ir::Node*> nodes;
+  std::vector<ir::Output> inputs;
+  ir::OutputMap<size_t> inputs_map;
+  std::vector<ir::Output> outputs;
+  ir::OutputMap<size_t> outputs_map;
+};
+
+constexpr size_t kNoWindow = std::numeric_limits<size_t>::max();
+
+// Greedily groups the non device data nodes of the post order into windows of
+// at most window_size nodes. A node joins the current window when one of its
+// operands is in there, or when it uses no computed operand at all, so that
+// the windows stay connected and the same graph regions map to the same
+// windows across graphs.
+std::vector<OpsWindow> ComputeWindows(
+    absl::Span<const ir::Node* const> post_order,
+    const absl::node_hash_map<const ir::Node*, size_t>& node_to_index,
+    size_t window_size, std::vector<size_t>* node_window) {
+  std::vector<OpsWindow> windows;
+  node_window->assign(post_order.size(), kNoWindow);
+  for (size_t i = 0; i < post_order.size(); ++i) {
+    const ir::Node* node = post_order[i];
+    if (ir::ops::DeviceData::Cast(node) != nullptr) {
+      continue;
+    }
+    bool join = !windows.empty() && windows.back().nodes.size() < window_size;
+    if (join) {
+      bool connected = true;
+      for (auto& operand : node->operands()) {
+        size_t window = (*node_window)[node_to_index.at(operand.node)];
+        if (window == windows.size() - 1) {
+          connected = true;
+          break;
+        }
+        if (window != kNoWindow) {
+          connected = false;
+        }
+      }
+      join = connected;
+    }
+    if (!join) {
+      windows.emplace_back();
+    }
+    windows.back().nodes.push_back(node);
+    (*node_window)[i] = windows.size() - 1;
+  }
+  return windows;
+}
+
+void AddWindowOutput(OpsWindow* window, const ir::Output& output) {
+  if (window->outputs_map.emplace(output, window->outputs.size()).second) {
+    window->outputs.push_back(output);
+  }
+}
+
+// Fills in the inputs and outputs of the windows.
+void ComputeWindowsBoundaries(
+    absl::Span<const ir::Value> roots,
+    const absl::node_hash_map<const ir::Node*, size_t>& node_to_index,
+    const std::vector<size_t>& node_window, std::vector<OpsWindow>* windows) {
+  for (size_t w = 0; w < windows->size(); ++w) {
+    OpsWindow& window = (*windows)[w];
+    for (const ir::Node* node : window.nodes) {
+      for (auto& operand : node->operands()) {
+        size_t operand_window = node_window[node_to_index.at(operand.node)];
+        if (operand_window == w) {
+          continue;
+        }
+        if (window.inputs_map.emplace(operand, window.inputs.size()).second) {
+          window.inputs.push_back(operand);
+        }
+        if (operand_window != kNoWindow) {
+          AddWindowOutput(&(*windows)[operand_window], operand);
+        }
+      }
+    }
+  }
+  for (auto& root : roots) {
+    size_t window = node_window[node_to_index.at(root.node.get())];
+    if (window != kNoWindow) {
+      AddWindowOutput(&(*windows)[window], root);
+    }
+  }
+  // Sort the outputs in window order, so that their order depends only on the
+  // window itself, and not on the order its users were found.
+  for (auto& window : *windows) {
+    absl::node_hash_map<const ir::Node*, size_t> positions;
+    for (size_t i = 0; i < window.nodes.size(); ++i) {
+      positions[window.nodes[i]] = i;
+    }
+    std::sort(window.outputs.begin(), window.outputs.end(),
+              [&](const ir::Output& o1, const ir::Output& o2) {
+                size_t p1 = positions.at(o1.node);
+                size_t p2 = positions.at(o2.node);
+                return p1 < p2 || (p1 == p2 && o1.index < o2.index);
+              });
+    for (size_t i = 0; i < window.outputs.size(); ++i) {
+      window.outputs_map[window.outputs[i]] = i;
+    }
+  }
+}
+
+// The key of a window covers the input shapes and the structure of the
+// window, but not the node identities, so that equivalent windows share the
+// same computation, like the per node keys do.
+xla::hash_t ComputeWindowKey(const OpsWindow& window,
+                             absl::Span<const xla::Shape* const> input_shapes,
+                             const xla::hash_t& seed) {
+  xla::hash_t key = xla::util::HashCombine(seed, window.nodes.size());
+  for (auto input_shape : input_shapes) {
+    key = xla::util::HashCombine(key, xla::util::ShapeHash(*input_shape));
+  }
+  absl::node_hash_map<const ir::Node*, size_t> positions;
+  for (size_t i = 0; i < window.nodes.size(); ++i) {
+    const ir::Node* node = window.nodes[i];
+    positions[node] = i;
+    key = xla::util::HashCombine(key, node->node_hash());
+    key = xla::util::HashCombine(key, xla::util::ShapeHash(node->shape()));
+    for (auto& operand : node->operands()) {
+      auto it = positions.find(operand.node);
+      key = it != positions.end()
+                ? xla::util::HashCombine(
+                      key, xla::util::MHash(true, it->second, operand.index))
+                : xla::util::HashCombine(
+                      key, xla::util::MHash(false,
+                                            window.inputs_map.at(operand)));
+    }
+  }
+  for (auto& output : window.outputs) {
+    key = xla::util::HashCombine(
+        key, xla::util::MHash(positions.at(output.node), output.index));
+  }
+  return key;
+}
+
+xla::XlaComputation BuildWindowComputation(
+    const OpsWindow& window, absl::Span<const xla::Shape* const> input_shapes,
+    const Device& device) {
+  ir::RootLoweringContext loctx("BuildWindowComputation", device);
+  for (size_t i = 0; i < window.inputs.size(); ++i) {
+    xla::XlaOp param = xla::Parameter(loctx.builder(), i, *input_shapes[i],
+                                      absl::StrCat("p", i));
+    loctx.AssignOutputOp(window.inputs[i], param);
+  }
+  for (const ir::Node* node : window.nodes) {
+    loctx.LowerNode(node);
+  }
+  for (auto& output : window.outputs) {
+    loctx.AddResult(loctx.GetOutputOp(output));
+  }
+  return ConsumeValue(loctx.Build());
+}
+
 }  // namespace
 
-OpByOpExecutor::OpByOpExecutor(size_t compile_cache_size)
-    : compile_cache_(compile_cache_size) {}
+OpByOpExecutor::OpByOpExecutor(size_t compile_cache_size, size_t window_size)
+    : compile_cache_(compile_cache_size), window_size_(window_size) {}
 
 std::vector<xla::ComputationClient::ExecuteChainedOp> OpByOpExecutor::BuildOps(
     absl::Span<const ir::Value> roots, const std::string& device,
     absl::Span<const std::string> devices) {
+  if (window_size_ > 1) {
+    return BuildWindowedOps(roots, device, devices);
+  }
   std::vector<const ir::Node*> root_nodes;
   root_nodes.reserve(roots.size());
   for (auto& root : roots) {
@@ -206,6 +368,145 @@ std::vector<xla::ComputationClient::ExecuteChainedOp> OpByOpExecutor::BuildOps(
   return chained_exec_ops;
 }
 
+std::vector<xla::ComputationClient::ExecuteChainedOp>
+OpByOpExecutor::BuildWindowedOps(absl::Span<const ir::Value> roots,
+                                 const std::string& device,
+                                 absl::Span<const std::string> devices) {
+  std::vector<const ir::Node*> root_nodes;
+  root_nodes.reserve(roots.size());
+  for (auto& root : roots) {
+    root_nodes.push_back(root.node.get());
+  }
+  std::vector<const ir::Node*> post_order =
+      ir::Util::ComputePostOrder(root_nodes);
+  XLA_VALUE_METRIC("OpByOpGraphSize", post_order.size());
+  TF_VLOG(5) << "TensorsGraphSize=" << post_order.size();
+
+  absl::node_hash_map<const ir::Node*, size_t> node_to_index;
+  node_to_index.reserve(post_order.size());
+  for (size_t i = 0; i < post_order.size(); ++i) {
+    node_to_index[post_order[i]] = i;
+  }
+  std::vector<size_t> node_window;
+  std::vector<OpsWindow> windows =
+      ComputeWindows(post_order, node_to_index, window_size_, &node_window);
+  ComputeWindowsBoundaries(roots, node_to_index, node_window, &windows);
+  XLA_VALUE_METRIC("OpByOpWindows", windows.size());
+
+  auto compilation_devices =
+      xla::ComputationClient::GetCompilationDevices(device, devices);
+  xla::hash_t nodes_key_seed = GetNodesKeySeed(device, compilation_devices);
+  Device exec_device(device);
+  std::vector<xla::hash_t> cache_keys;
+  absl::node_hash_map<xla::hash_t, std::vector<size_t>, xla::util::HashReducer>
+      compile_indices;
+  absl::node_hash_map<xla::hash_t, size_t, xla::util::HashReducer>
+      cache_keys_instance;
+  std::list<xla::Shape> compile_shapes;
+  std::vector<xla::ComputationClient::CompileInstance> compile_instances;
+  std::vector<xla::ComputationClient::ExecuteChainedOp> chained_exec_ops;
+  // The chained op index of the device data nodes, and of the windows.
+  std::vector<size_t> node_ops(post_order.size(), 0);
+  std::vector<size_t> window_ops(windows.size(), 0);
+  std::vector<const xla::Shape*> ops_shapes;
+  // Returns the chained op input, and its shape, for a window input.
+  auto get_op_input = [&](const ir::Output& input) {
+    size_t index = node_to_index.at(input.node);
+    size_t window = node_window[index];
+    if (window == kNoWindow) {
+      size_t op_index = node_ops[index];
+      return std::make_pair(xla::ComputationClient::ExecuteChainedOp::Input{
+                                op_index, absl::nullopt},
+                            ops_shapes[op_index]);
+    }
+    size_t op_index = window_ops[window];
+    size_t output_index = windows[window].outputs_map.at(input);
+    return std::make_pair(
+        xla::ComputationClient::ExecuteChainedOp::Input{op_index,
+                                                        output_index},
+        &xla::ShapeUtil::GetTupleElementShape(*ops_shapes[op_index],
+                                              output_index));
+  };
+  for (size_t i = 0; i < post_order.size(); ++i) {
+    const ir::Node* node = post_order[i];
+    const ir::ops::DeviceData* device_data = ir::ops::DeviceData::Cast(node);
+    if (device_data != nullptr) {
+      node_ops[i] = chained_exec_ops.size();
+      chained_exec_ops.emplace_back();
+      chained_exec_ops.back().device_data = device_data->data();
+      ops_shapes.push_back(&device_data->data()->shape());
+      continue;
+    }
+    const OpsWindow& window = windows[node_window[i]];
+    if (node != window.nodes.back()) {
+      continue;
+    }
+    // The last node of the window has been reached, and all the inputs of the
+    // window have their chained op by now.
+    size_t op_index = chained_exec_ops.size();
+    window_ops[node_window[i]] = op_index;
+    chained_exec_ops.emplace_back();
+    ops_shapes.push_back(nullptr);
+    xla::ComputationClient::ExecuteChainedOp& cxop = chained_exec_ops.back();
+    std::vector<const xla::Shape*> op_input_shapes;
+    for (auto& input : window.inputs) {
+      auto op_input = get_op_input(input);
+      cxop.inputs.push_back(op_input.first);
+      op_input_shapes.push_back(op_input.second);
+    }
+
+    xla::hash_t cache_key =
+        ComputeWindowKey(window, op_input_shapes, nodes_key_seed);
+    cxop.computation = compile_cache_.Get(cache_key);
+    if (cxop.computation == nullptr) {
+      XLA_COUNTER("OpByOpCompileCacheMiss", 1);
+
+      // Equivalent windows within the same IR graph get compiled only once.
+      auto& cache_key_indices = compile_indices[cache_key];
+      cache_key_indices.push_back(op_index);
+      if (cache_key_indices.size() == 1) {
+        cache_keys.push_back(cache_key);
+        cache_keys_instance[cache_key] = compile_instances.size();
+
+        xla::XlaComputation computation =
+            BuildWindowComputation(window, op_input_shapes, exec_device);
+        xla::ProgramShape program_shape =
+            ConsumeValue(computation.GetProgramShape());
+        compile_shapes.push_back(MakeShapeWithDeviceLayout(
+            program_shape.result(), exec_device.hw_type));
+        compile_instances.push_back(
+            {std::move(computation), &compile_shapes.back()});
+        ops_shapes[op_index] = &compile_shapes.back();
+      } else {
+        ops_shapes[op_index] =
+            compile_instances[cache_keys_instance.at(cache_key)].output_shape;
+      }
+    } else {
+      ops_shapes[op_index] = &cxop.computation->program_shape().result();
+    }
+  }
+  // Fixup the requested outputs (roots) within the chained ops vector.
+  for (size_t i = 0; i < roots.size(); ++i) {
+    auto op_input = get_op_input(roots[i]);
+    chained_exec_ops[op_input.first.op_index].outputs.push_back(
+        {i, op_input.first.output_index});
+  }
+
+  if (!compile_instances.empty()) {
+    TF_VLOG(3) << "Compiling " << compile_instances.size()
+               << " window computations on device " << device;
+    auto computation_ptrs = xla::GetX10Device(device)->Compile(
+        compilation_devices, std::move(compile_instances));
+    for (size_t i = 0; i < computation_ptrs.size(); ++i) {
+      compile_cache_.Add(cache_keys[i], computation_ptrs[i]);
+      for (auto index : compile_indices[cache_keys[i]]) {
+        chained_exec_ops[index].computation = computation_ptrs[i];
+      }
+    }
+  }
+  return chained_exec_ops;
+}
+
 std::vector<xla::ComputationClient::DataPtr> OpByOpExecutor::Execute(
     absl::Span<const ir::Value> roots, const std::string& device,
     absl::Span<const std::string> devices) {
@@ -230,8 +531,10 @@ OpByOpExecutor::AsyncTask OpByOpExecutor::ExecuteAsync(
 OpByOpExecutor* OpByOpExecutor::Get() {
   static const int64_t compile_cache_size =
       xla::sys_util::GetEnvInt("SPLIT_EXECUTOR_CACHE_SIZE", 2048);
+  static const int64_t window_size =
+      xla::sys_util::GetEnvInt("SPLIT_EXECUTOR_WINDOW_SIZE", 1);
   static OpByOpExecutor* split_executor =
-      new OpByOpExecutor(compile_cache_size);
+      new OpByOpExecutor(compile_cache_size, window_size);
   return split_executor;
 }
 
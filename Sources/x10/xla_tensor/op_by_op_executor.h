@@ -32,7 +32,9 @@ namespace swift_xla {
 // The OpByOpExecutor class is a singleton accessible via its Get() API that
 // allows to run an IR graph is per-IR-node isolation mode. Instead of lowering
 // the whole IR graph in a single XLA computation, the single IR nodes are
-// lowered and executed independently.
+// lowered and executed independently. With a window size greater than one,
+// short connected runs of IR nodes get lowered together instead, into up to
+// window size nodes computations.
 class OpByOpExecutor {
  public:
   using AsyncResult = std::vector<xla::ComputationClient::DataPtr>;
@@ -57,9 +59,14 @@ class OpByOpExecutor {
       xla::util::Cache<xla::hash_t, xla::ComputationClient::Computation,
                        xla::util::HashReducer>;
 
-  explicit OpByOpExecutor(size_t compile_cache_size);
+  OpByOpExecutor(size_t compile_cache_size, size_t window_size);
+
+  std::vector<xla::ComputationClient::ExecuteChainedOp> BuildWindowedOps(
+      absl::Span<const ir::Value> roots, const std::string& device,
+      absl::Span<const std::string> devices);
 
   CompileCache compile_cache_;
+  size_t window_size_;
 };
 
 }  // namespace swift_xla
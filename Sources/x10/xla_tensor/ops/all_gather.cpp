@@ -0,0 +1,75 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/all_gather.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/cross_replica_reduces.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& input, const Value& token,
+                           int64_t dim, int64_t shard_count) {
+  xla::Shape result_shape = input.shape();
+  result_shape.set_dimensions(dim, result_shape.dimensions(dim) * shard_count);
+  return xla::ShapeUtil::MakeTupleShape({result_shape, token.shape()});
+}
+
+}  // namespace
+
+AllGather::AllGather(const Value& input, const Value& token, int64_t dim,
+                     int64_t shard_count,
+                     std::vector<std::vector<int64_t>> groups)
+    : Node(xla_all_gather, {input, token},
+           [&]() { return NodeOutputShape(input, token, dim, shard_count); },
+           /*num_outputs=*/2, xla::util::MHash(dim, shard_count, groups)),
+      dim_(dim),
+      shard_count_(shard_count),
+      groups_(std::move(groups)) {}
+
+NodePtr AllGather::Clone(OpList operands) const {
+  return MakeNode<AllGather>(operands.at(0), operands.at(1), dim_,
+                             shard_count_, groups_);
+}
+
+XlaOpVector AllGather::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  xla::XlaOp token = loctx->GetOutputOp(operand(1));
+  AllGatherResult result =
+      BuildAllGather(input, token, dim_, shard_count_, groups_);
+  return ReturnOps({result.result, result.token}, loctx);
+}
+
+std::string AllGather::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", dim=" << dim_
+     << ", shard_count=" << shard_count_ << ", groups=(";
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    ss << (i == 0 ? "(" : ",(");
+    ss << absl::StrJoin(groups_[i], ", ") << ")";
+  }
+  ss << ")";
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
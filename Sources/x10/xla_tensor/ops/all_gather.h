@@ -0,0 +1,52 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// Concatenates the operands of the replicas of each group along the given
+// dimension, in replica order.
+class AllGather : public Node {
+ public:
+  AllGather(const Value& input, const Value& token, int64_t dim,
+            int64_t shard_count, std::vector<std::vector<int64_t>> groups);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  int64_t dim() const { return dim_; }
+
+  int64_t shard_count() const { return shard_count_; }
+
+  const std::vector<std::vector<int64_t>>& groups() const { return groups_; }
+
+ private:
+  int64_t dim_;
+  int64_t shard_count_;
+  std::vector<std::vector<int64_t>> groups_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
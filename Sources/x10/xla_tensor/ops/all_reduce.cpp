@@ -47,20 +47,22 @@ std::vector<Value> GetOperandList(absl::Span<const Value> operands,
 
 AllReduce::AllReduce(AllReduceType reduce_type,
                      absl::Span<const Value> operands, const Value& token,
-                     double scale, std::vector<std::vector<int64_t>> groups)
+                     double scale, std::vector<std::vector<int64_t>> groups,
+                     AllReducePrecision precision)
     : Node(xla_cross_replica_sum, GetOperandList(operands, token),
            [&]() { return NodeOutputShape(operands, token); },
            /*num_outputs=*/operands.size() + 1,
            xla::util::MHash(xla::util::GetEnumValue(reduce_type), scale,
-                            groups)),
+                            groups, xla::util::GetEnumValue(precision))),
       reduce_type_(reduce_type),
       scale_(scale),
-      groups_(std::move(groups)) {}
+      groups_(std::move(groups)),
+      precision_(precision) {}
 
 NodePtr AllReduce::Clone(OpList operands) const {
   std::vector<Value> operand_list(operands.begin(), operands.end() - 1);
   return MakeNode<AllReduce>(reduce_type_, operand_list, operands.back(),
-                             scale_, groups_);
+                             scale_, groups_, precision_);
 }
 
 XlaOpVector AllReduce::Lower(LoweringContext* loctx) const {
@@ -71,7 +73,8 @@ XlaOpVector AllReduce::Lower(LoweringContext* loctx) const {
     inputs.push_back(loctx->GetOutputOp(operand_list[i]));
   }
   xla::XlaOp token = loctx->GetOutputOp(operand_list.back());
-  return ReturnOps(BuildAllReduce(reduce_type_, inputs, token, scale_, groups_),
+  return ReturnOps(BuildAllReduce(reduce_type_, inputs, token, scale_, groups_,
+                                  precision_),
                    loctx);
 }
 
@@ -79,7 +82,8 @@ std::string AllReduce::ToString() const {
   std::stringstream ss;
   ss << Node::ToString()
      << ", reduce_type=" << xla::util::GetEnumValue(reduce_type_)
-     << ", scale=" << scale_ << ", groups=(";
+     << ", scale=" << scale_
+     << ", precision=" << xla::util::GetEnumValue(precision_) << ", groups=(";
   for (size_t i = 0; i < groups_.size(); ++i) {
     ss << (i == 0 ? "(" : ",(");
     ss << absl::StrJoin(groups_[i], ", ") << ")";
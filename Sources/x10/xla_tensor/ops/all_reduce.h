@@ -27,7 +27,8 @@ class AllReduce : public Node {
  public:
   AllReduce(AllReduceType reduce_type, absl::Span<const Value> operands,
             const Value& token, double scale,
-            std::vector<std::vector<int64_t>> groups);
+            std::vector<std::vector<int64_t>> groups,
+            AllReducePrecision precision = AllReducePrecision::kFull);
 
   std::string ToString() const override;
 
@@ -41,10 +42,13 @@ class AllReduce : public Node {
 
   const std::vector<std::vector<int64_t>>& groups() const { return groups_; }
 
+  AllReducePrecision precision() const { return precision_; }
+
  private:
   AllReduceType reduce_type_;
   double scale_;
   std::vector<std::vector<int64_t>> groups_;
+  AllReducePrecision precision_;
 };
 
 }  // namespace ops
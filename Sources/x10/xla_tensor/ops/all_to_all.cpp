@@ -0,0 +1,95 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/all_to_all.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/cross_replica_reduces.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& input, const Value& token,
+                           int64_t split_dimension, int64_t concat_dimension,
+                           int64_t split_count) {
+  xla::Shape result_shape = input.shape();
+  XLA_CHECK_EQ(result_shape.dimensions(split_dimension) % split_count, 0)
+      << "Dimension " << split_dimension << " of " << result_shape
+      << " does not split into " << split_count << " pieces";
+  result_shape.set_dimensions(
+      split_dimension, result_shape.dimensions(split_dimension) / split_count);
+  result_shape.set_dimensions(
+      concat_dimension,
+      result_shape.dimensions(concat_dimension) * split_count);
+  return xla::ShapeUtil::MakeTupleShape({result_shape, token.shape()});
+}
+
+}  // namespace
+
+AllToAll::AllToAll(const Value& input, const Value& token,
+                   int64_t split_dimension, int64_t concat_dimension,
+                   int64_t split_count,
+                   std::vector<std::vector<int64_t>> groups)
+    : Node(xla_all_to_all, {input, token},
+           [&]() {
+             return NodeOutputShape(input, token, split_dimension,
+                                    concat_dimension, split_count);
+           },
+           /*num_outputs=*/2,
+           xla::util::MHash(split_dimension, concat_dimension, split_count,
+                            groups)),
+      split_dimension_(split_dimension),
+      concat_dimension_(concat_dimension),
+      split_count_(split_count),
+      groups_(std::move(groups)) {}
+
+NodePtr AllToAll::Clone(OpList operands) const {
+  return MakeNode<AllToAll>(operands.at(0), operands.at(1), split_dimension_,
+                            concat_dimension_, split_count_, groups_);
+}
+
+XlaOpVector AllToAll::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  xla::XlaOp token = loctx->GetOutputOp(operand(1));
+  AllToAllResult result =
+      BuildAllToAll(input, token, split_dimension_, concat_dimension_,
+                    split_count_, groups_);
+  return ReturnOps({result.result, result.token}, loctx);
+}
+
+std::string AllToAll::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", split_dimension=" << split_dimension_
+     << ", concat_dimension=" << concat_dimension_
+     << ", split_count=" << split_count_ << ", groups=(";
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    ss << (i == 0 ? "(" : ",(");
+    ss << absl::StrJoin(groups_[i], ", ") << ")";
+  }
+  ss << ")";
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
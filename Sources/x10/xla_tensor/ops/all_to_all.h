@@ -0,0 +1,57 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// Splits the operand of each replica of a group along the split dimension,
+// sends the pieces to the replicas of the group, in order, and concatenates
+// the pieces it receives along the concat dimension.
+class AllToAll : public Node {
+ public:
+  AllToAll(const Value& input, const Value& token, int64_t split_dimension,
+           int64_t concat_dimension, int64_t split_count,
+           std::vector<std::vector<int64_t>> groups);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  int64_t split_dimension() const { return split_dimension_; }
+
+  int64_t concat_dimension() const { return concat_dimension_; }
+
+  int64_t split_count() const { return split_count_; }
+
+  const std::vector<std::vector<int64_t>>& groups() const { return groups_; }
+
+ private:
+  int64_t split_dimension_;
+  int64_t concat_dimension_;
+  int64_t split_count_;
+  std::vector<std::vector<int64_t>> groups_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,237 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/fused_elementwise.h"
+
+#include <sstream>
+#include <typeinfo>
+#include <unordered_map>
+
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+using FusibleOps = std::unordered_map<std::type_index, ElementwiseLowerFn>;
+
+bool IsElementwiseFusionEnabled() {
+  static bool enabled =
+      xla::sys_util::GetEnvBool("XLA_ELEMENTWISE_FUSION", true);
+  return enabled;
+}
+
+size_t GetMaxFusedSteps() {
+  static size_t max_steps =
+      xla::sys_util::GetEnvInt("XLA_ELEMENTWISE_FUSION_MAX_STEPS", 64);
+  return max_steps;
+}
+
+FusibleOps* GetFusibleOps() {
+  static FusibleOps* ops = new FusibleOps();
+  return ops;
+}
+
+ElementwiseLowerFn GetFusibleLowerFn(const Node* node) {
+  FusibleOps* ops = GetFusibleOps();
+  auto it = ops->find(typeid(*node));
+  return it != ops->end() ? it->second : nullptr;
+}
+
+bool IsFusible(const Node* node) {
+  return node->op() == *xla_fused_elementwise ||
+         GetFusibleLowerFn(node) != nullptr;
+}
+
+xla::hash_t HashSteps(const std::vector<FusedElementwise::Step>& steps) {
+  xla::hash_t hash = xla::util::Hash(steps.size());
+  for (auto& step : steps) {
+    hash = xla::util::HashCombine(hash, step.op.hash());
+    for (auto& ref : step.operands) {
+      hash = xla::util::HashCombine(hash,
+                                    xla::util::MHash(ref.is_step, ref.index));
+    }
+  }
+  return hash;
+}
+
+Value OperandValue(const Node* node, size_t index) {
+  return Value(node->operand_nodes()[index], node->operand(index).index);
+}
+
+// Builds the program of a fused node out of the nodes it absorbs. The absorbed
+// nodes are only read, they stay alive as long as other values use them.
+class ProgramBuilder {
+ public:
+  using Ref = FusedElementwise::Ref;
+  using Step = FusedElementwise::Step;
+
+  Ref AddInput(const Value& value) {
+    for (size_t i = 0; i < inputs_.size(); ++i) {
+      if (inputs_[i].node == value.node && inputs_[i].index == value.index) {
+        return {/*is_step=*/false, i};
+      }
+    }
+    inputs_.push_back(value);
+    return {/*is_step=*/false, inputs_.size() - 1};
+  }
+
+  // Appends the steps computing the value, if it is fusible, or makes it an
+  // input of the program otherwise.
+  Ref Absorb(const Value& value) {
+    const Node* node = value.node.get();
+    auto it = absorbed_.find(node);
+    if (it != absorbed_.end()) {
+      return it->second;
+    }
+    Ref ref = AbsorbNode(value);
+    absorbed_.emplace(node, ref);
+    return ref;
+  }
+
+  Ref AddStep(Step step) {
+    steps_.push_back(std::move(step));
+    return {/*is_step=*/true, steps_.size() - 1};
+  }
+
+  std::vector<Value>& inputs() { return inputs_; }
+
+  std::vector<Step>& steps() { return steps_; }
+
+ private:
+  Ref AbsorbNode(const Value& value) {
+    const Node* node = value.node.get();
+    const FusedElementwise* fused =
+        NodeCast<FusedElementwise>(node, *xla_fused_elementwise);
+    if (fused != nullptr) {
+      std::vector<Ref> input_refs;
+      for (size_t i = 0; i < node->operands().size(); ++i) {
+        input_refs.push_back(AddInput(OperandValue(node, i)));
+      }
+      size_t offset = steps_.size();
+      for (const Step& step : fused->steps()) {
+        Step absorbed = step;
+        for (Ref& ref : absorbed.operands) {
+          ref = ref.is_step ? Ref{/*is_step=*/true, offset + ref.index}
+                            : input_refs[ref.index];
+        }
+        steps_.push_back(std::move(absorbed));
+      }
+      return {/*is_step=*/true, steps_.size() - 1};
+    }
+    if (IsFusible(node)) {
+      Step step{node->op(), GetFusibleLowerFn(node), {}};
+      for (size_t i = 0; i < node->operands().size(); ++i) {
+        step.operands.push_back(AddInput(OperandValue(node, i)));
+      }
+      return AddStep(std::move(step));
+    }
+    return AddInput(value);
+  }
+
+  std::vector<Value> inputs_;
+  std::vector<Step> steps_;
+  std::unordered_map<const Node*, Ref> absorbed_;
+};
+
+}  // namespace
+
+FusedElementwise::FusedElementwise(OpList operands, std::vector<Step> steps,
+                                   xla::Shape shape)
+    : Node(xla_fused_elementwise, operands, std::move(shape),
+           /*num_outputs=*/1, HashSteps(steps)),
+      steps_(std::move(steps)) {}
+
+NodePtr FusedElementwise::Clone(OpList operands) const {
+  return MakeNode<FusedElementwise>(operands, steps_, shape());
+}
+
+XlaOpVector FusedElementwise::Lower(LoweringContext* loctx) const {
+  std::vector<xla::XlaOp> inputs;
+  for (auto& operand : operands()) {
+    inputs.push_back(loctx->GetOutputOp(operand));
+  }
+  std::vector<xla::XlaOp> results;
+  for (const Step& step : steps_) {
+    absl::InlinedVector<xla::XlaOp, 2> step_operands;
+    for (const Ref& ref : step.operands) {
+      step_operands.push_back(ref.is_step ? results[ref.index]
+                                          : inputs[ref.index]);
+    }
+    results.push_back(step.lower_fn(step_operands));
+  }
+  return ReturnOp(results.back(), loctx);
+}
+
+std::string FusedElementwise::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", steps=(";
+  for (size_t i = 0; i < steps_.size(); ++i) {
+    ss << (i > 0 ? "; " : "") << steps_[i].op << "(";
+    for (size_t j = 0; j < steps_[i].operands.size(); ++j) {
+      const Ref& ref = steps_[i].operands[j];
+      ss << (j > 0 ? ", " : "") << (ref.is_step ? "s" : "i") << ref.index;
+    }
+    ss << ")";
+  }
+  ss << ")";
+  return ss.str();
+}
+
+bool RegisterFusibleElementwise(
+    absl::Span<const std::pair<std::type_index, ElementwiseLowerFn>> ops) {
+  FusibleOps* fusible_ops = GetFusibleOps();
+  for (auto& type_and_lower_fn : ops) {
+    fusible_ops->emplace(type_and_lower_fn.first, type_and_lower_fn.second);
+  }
+  return true;
+}
+
+NodePtr FuseElementwise(NodePtr node) {
+  if (!IsElementwiseFusionEnabled()) {
+    return node;
+  }
+  ElementwiseLowerFn lower_fn = GetFusibleLowerFn(node.get());
+  if (lower_fn == nullptr) {
+    return node;
+  }
+  bool has_fusible_operand = false;
+  for (auto& operand : node->operands()) {
+    has_fusible_operand = has_fusible_operand || IsFusible(operand.node);
+  }
+  if (!has_fusible_operand) {
+    return node;
+  }
+  ProgramBuilder builder;
+  FusedElementwise::Step step{node->op(), lower_fn, {}};
+  for (size_t i = 0; i < node->operands().size(); ++i) {
+    step.operands.push_back(builder.Absorb(OperandValue(node.get(), i)));
+  }
+  builder.AddStep(std::move(step));
+  if (builder.steps().size() > GetMaxFusedSteps()) {
+    return node;
+  }
+  XLA_COUNTER("FusedElementwiseNodes", 1);
+  return MakeNode<FusedElementwise>(builder.inputs(),
+                                    std::move(builder.steps()), node->shape());
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
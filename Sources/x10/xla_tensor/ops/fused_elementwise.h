@@ -0,0 +1,83 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+#include "absl/container/inlined_vector.h"
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// Lowers an elementwise op given the XLA ops of its operands.
+using ElementwiseLowerFn = xla::XlaOp (*)(absl::Span<const xla::XlaOp>);
+
+// A chain of elementwise ops, absorbed while tracing into a single IR node
+// holding the program of the chain. The steps lower to the same XLA ops the
+// absorbed nodes would, so the resulting HLO does not change, other than for
+// absorbed nodes which other values use as well. Their steps get lowered twice,
+// which the XLA common subexpression elimination folds back.
+class FusedElementwise : public Node {
+ public:
+  // A step operand refers to a node operand, or to the result of an earlier
+  // step.
+  struct Ref {
+    bool is_step = false;
+    size_t index = 0;
+  };
+
+  struct Step {
+    OpKind op;
+    ElementwiseLowerFn lower_fn = nullptr;
+    absl::InlinedVector<Ref, 2> operands;
+  };
+
+  // The node outputs the result of the last step.
+  FusedElementwise(OpList operands, std::vector<Step> steps, xla::Shape shape);
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  std::string ToString() const override;
+
+  const std::vector<Step>& steps() const { return steps_; }
+
+ private:
+  std::vector<Step> steps_;
+};
+
+// Makes the nodes of the given types fusible within the FusedElementwise nodes.
+// The node types rather than the op kinds identify the fusible ops, since
+// other nodes share some of their op kinds. Registration happens during static
+// initialization, so the registry is not locked.
+bool RegisterFusibleElementwise(
+    absl::Span<const std::pair<std::type_index, ElementwiseLowerFn>> ops);
+
+// Absorbs the node, if it is fusible, together with its fusible operands
+// into a FusedElementwise node. Returns the node unchanged if none of its
+// operands is fusible, as there would be nothing to save.
+NodePtr FuseElementwise(NodePtr node);
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,66 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/gru_cell.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/recurrent_cells.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& hidden, const Value& kernel) {
+  const xla::Shape& hidden_shape = hidden.shape();
+  xla::Shape gates_shape = xla::ShapeUtil::MakeShape(
+      hidden_shape.element_type(),
+      {hidden_shape.dimensions(0), kernel.shape().dimensions(1)});
+  return xla::ShapeUtil::MakeTupleShape(
+      {hidden_shape, gates_shape, hidden_shape});
+}
+
+}  // namespace
+
+GruCell::GruCell(const Value& input, const Value& hidden, const Value& kernel,
+                 const Value& recurrent_kernel, const Value& bias,
+                 const Value& recurrent_bias)
+    : Node(xla_gru_cell,
+           {input, hidden, kernel, recurrent_kernel, bias, recurrent_bias},
+           [&]() { return NodeOutputShape(hidden, kernel); },
+           /*num_outputs=*/3, /*hash_seed=*/0x71d4c8a5) {}
+
+NodePtr GruCell::Clone(OpList operands) const {
+  return MakeNode<GruCell>(operands.at(0), operands.at(1), operands.at(2),
+                           operands.at(3), operands.at(4), operands.at(5));
+}
+
+XlaOpVector GruCell::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  xla::XlaOp hidden = loctx->GetOutputOp(operand(1));
+  xla::XlaOp kernel = loctx->GetOutputOp(operand(2));
+  xla::XlaOp recurrent_kernel = loctx->GetOutputOp(operand(3));
+  xla::XlaOp bias = loctx->GetOutputOp(operand(4));
+  xla::XlaOp recurrent_bias = loctx->GetOutputOp(operand(5));
+  GruCellOutput result = BuildGruCell(input, hidden, kernel, recurrent_kernel,
+                                      bias, recurrent_bias);
+  return ReturnOps({result.hidden, result.gates, result.recurrent_output},
+                   loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,79 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/gru_cell_backward.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/recurrent_cells.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& input, const Value& hidden,
+                           const Value& kernel,
+                           const Value& recurrent_kernel) {
+  const xla::Shape& kernel_shape = kernel.shape();
+  xla::Shape bias_shape = xla::ShapeUtil::MakeShape(
+      kernel_shape.element_type(), {kernel_shape.dimensions(1)});
+  return xla::ShapeUtil::MakeTupleShape({input.shape(), hidden.shape(),
+                                         kernel_shape, recurrent_kernel.shape(),
+                                         bias_shape, bias_shape});
+}
+
+}  // namespace
+
+GruCellBackward::GruCellBackward(const Value& grad_hidden, const Value& input,
+                                 const Value& hidden, const Value& kernel,
+                                 const Value& recurrent_kernel,
+                                 const Value& gates,
+                                 const Value& recurrent_output)
+    : Node(xla_gru_cell_backward,
+           {grad_hidden, input, hidden, kernel, recurrent_kernel, gates,
+            recurrent_output},
+           [&]() {
+             return NodeOutputShape(input, hidden, kernel, recurrent_kernel);
+           },
+           /*num_outputs=*/6, /*hash_seed=*/0x4e93b06f) {}
+
+NodePtr GruCellBackward::Clone(OpList operands) const {
+  return MakeNode<GruCellBackward>(operands.at(0), operands.at(1),
+                                   operands.at(2), operands.at(3),
+                                   operands.at(4), operands.at(5),
+                                   operands.at(6));
+}
+
+XlaOpVector GruCellBackward::Lower(LoweringContext* loctx) const {
+  xla::XlaOp grad_hidden = loctx->GetOutputOp(operand(0));
+  xla::XlaOp input = loctx->GetOutputOp(operand(1));
+  xla::XlaOp hidden = loctx->GetOutputOp(operand(2));
+  xla::XlaOp kernel = loctx->GetOutputOp(operand(3));
+  xla::XlaOp recurrent_kernel = loctx->GetOutputOp(operand(4));
+  xla::XlaOp gates = loctx->GetOutputOp(operand(5));
+  xla::XlaOp recurrent_output = loctx->GetOutputOp(operand(6));
+  GruCellGrads grads =
+      BuildGruCellBackward(grad_hidden, input, hidden, kernel,
+                           recurrent_kernel, gates, recurrent_output);
+  return ReturnOps({grads.grad_input, grads.grad_hidden, grads.grad_kernel,
+                    grads.grad_recurrent_kernel, grads.grad_bias,
+                    grads.grad_recurrent_bias},
+                   loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
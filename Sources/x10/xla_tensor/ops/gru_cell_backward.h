@@ -0,0 +1,42 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// The gradients of GruCell, given the gates and recurrent output projection it
+// output. Outputs the input, hidden, kernel, recurrent kernel, bias and
+// recurrent bias gradients.
+class GruCellBackward : public Node {
+ public:
+  GruCellBackward(const Value& grad_hidden, const Value& input,
+                  const Value& hidden, const Value& kernel,
+                  const Value& recurrent_kernel, const Value& gates,
+                  const Value& recurrent_output);
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
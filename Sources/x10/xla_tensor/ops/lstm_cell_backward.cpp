@@ -0,0 +1,75 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/lstm_cell_backward.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/recurrent_cells.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& input, const Value& hidden,
+                           const Value& weight) {
+  const xla::Shape& weight_shape = weight.shape();
+  xla::Shape bias_shape = xla::ShapeUtil::MakeShape(
+      weight_shape.element_type(), {weight_shape.dimensions(1)});
+  return xla::ShapeUtil::MakeTupleShape({input.shape(), hidden.shape(),
+                                         hidden.shape(), weight_shape,
+                                         bias_shape});
+}
+
+}  // namespace
+
+LstmCellBackward::LstmCellBackward(const Value& grad_cell,
+                                   const Value& grad_hidden,
+                                   const Value& input, const Value& hidden,
+                                   const Value& cell, const Value& weight,
+                                   const Value& gates, const Value& new_cell)
+    : Node(xla_lstm_cell_backward,
+           {grad_cell, grad_hidden, input, hidden, cell, weight, gates,
+            new_cell},
+           [&]() { return NodeOutputShape(input, hidden, weight); },
+           /*num_outputs=*/5, /*hash_seed=*/0x2b7e9d41) {}
+
+NodePtr LstmCellBackward::Clone(OpList operands) const {
+  return MakeNode<LstmCellBackward>(operands.at(0), operands.at(1),
+                                    operands.at(2), operands.at(3),
+                                    operands.at(4), operands.at(5),
+                                    operands.at(6), operands.at(7));
+}
+
+XlaOpVector LstmCellBackward::Lower(LoweringContext* loctx) const {
+  xla::XlaOp grad_cell = loctx->GetOutputOp(operand(0));
+  xla::XlaOp grad_hidden = loctx->GetOutputOp(operand(1));
+  xla::XlaOp input = loctx->GetOutputOp(operand(2));
+  xla::XlaOp hidden = loctx->GetOutputOp(operand(3));
+  xla::XlaOp cell = loctx->GetOutputOp(operand(4));
+  xla::XlaOp weight = loctx->GetOutputOp(operand(5));
+  xla::XlaOp gates = loctx->GetOutputOp(operand(6));
+  xla::XlaOp new_cell = loctx->GetOutputOp(operand(7));
+  LstmCellGrads grads = BuildLstmCellBackward(
+      grad_cell, grad_hidden, input, hidden, cell, weight, gates, new_cell);
+  return ReturnOps({grads.grad_input, grads.grad_hidden, grads.grad_cell,
+                    grads.grad_weight, grads.grad_bias},
+                   loctx);
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/moe_combine.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/cross_replica_reduces.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& expert_outputs,
+                           const Value& expert_indices, const Value& token,
+                           int64_t split_count) {
+  const xla::Shape& outputs_shape = expert_outputs.shape();
+  const xla::Shape& indices_shape = expert_indices.shape();
+  XLA_CHECK_EQ(outputs_shape.rank(), 3)
+      << "The expert outputs must be [experts, capacity, dim]: "
+      << outputs_shape;
+  XLA_CHECK_EQ(outputs_shape.dimensions(0) % split_count, 0)
+      << outputs_shape.dimensions(0)
+      << " experts do not split evenly between " << split_count
+      << " replicas";
+  xla::Shape result_shape = xla::ShapeUtil::MakeShape(
+      outputs_shape.element_type(),
+      {indices_shape.dimensions(0), indices_shape.dimensions(1),
+       outputs_shape.dimensions(2)});
+  return xla::ShapeUtil::MakeTupleShape({result_shape, token.shape()});
+}
+
+}  // namespace
+
+MoeCombine::MoeCombine(const Value& expert_outputs, const Value& expert_indices,
+                       const Value& positions, const Value& token,
+                       int64_t split_count,
+                       std::vector<std::vector<int64_t>> groups)
+    : Node(xla_moe_combine, {expert_outputs, expert_indices, positions, token},
+           [&]() {
+             return NodeOutputShape(expert_outputs, expert_indices, token,
+                                    split_count);
+           },
+           /*num_outputs=*/2, xla::util::MHash(split_count, groups)),
+      split_count_(split_count),
+      groups_(std::move(groups)) {}
+
+NodePtr MoeCombine::Clone(OpList operands) const {
+  return MakeNode<MoeCombine>(operands.at(0), operands.at(1), operands.at(2),
+                              operands.at(3), split_count_, groups_);
+}
+
+XlaOpVector MoeCombine::Lower(LoweringContext* loctx) const {
+  xla::XlaOp expert_outputs = loctx->GetOutputOp(operand(0));
+  xla::XlaOp expert_indices = loctx->GetOutputOp(operand(1));
+  xla::XlaOp positions = loctx->GetOutputOp(operand(2));
+  xla::XlaOp token = loctx->GetOutputOp(operand(3));
+  AllToAllResult result = BuildMoeCombine(expert_outputs, expert_indices,
+                                          positions, token, split_count_,
+                                          groups_);
+  return ReturnOps({result.result, result.token}, loctx);
+}
+
+std::string MoeCombine::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", split_count=" << split_count_ << ", groups=(";
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    ss << (i == 0 ? "(" : ",(");
+    ss << absl::StrJoin(groups_[i], ", ") << ")";
+  }
+  ss << ")";
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
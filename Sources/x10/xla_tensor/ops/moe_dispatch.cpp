@@ -0,0 +1,108 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/moe_dispatch.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/cross_replica_reduces.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& input, const Value& expert_indices,
+                           const Value& token, int64_t num_experts,
+                           int64_t capacity, int64_t split_count) {
+  const xla::Shape& input_shape = input.shape();
+  const xla::Shape& indices_shape = expert_indices.shape();
+  XLA_CHECK(input_shape.rank() == 2 || input_shape.rank() == 3)
+      << "The dispatched tokens must be [tokens, dim] or [tokens, k, dim]: "
+      << input_shape;
+  XLA_CHECK_EQ(input_shape.dimensions(0), indices_shape.dimensions(0))
+      << "Tokens " << input_shape << " do not match their routing "
+      << indices_shape;
+  XLA_CHECK(input_shape.rank() == 2 ||
+            input_shape.dimensions(1) == indices_shape.dimensions(1))
+      << "Token slots " << input_shape << " do not match their routing "
+      << indices_shape;
+  XLA_CHECK_EQ(num_experts % split_count, 0)
+      << num_experts << " experts do not split evenly between " << split_count
+      << " replicas";
+  xla::Shape result_shape = xla::ShapeUtil::MakeShape(
+      input_shape.element_type(),
+      {num_experts, capacity,
+       input_shape.dimensions(input_shape.rank() - 1)});
+  return xla::ShapeUtil::MakeTupleShape({result_shape, token.shape()});
+}
+
+}  // namespace
+
+MoeDispatch::MoeDispatch(const Value& input, const Value& expert_indices,
+                         const Value& positions, const Value& token,
+                         int64_t num_experts, int64_t capacity,
+                         int64_t split_count,
+                         std::vector<std::vector<int64_t>> groups)
+    : Node(xla_moe_dispatch, {input, expert_indices, positions, token},
+           [&]() {
+             return NodeOutputShape(input, expert_indices, token, num_experts,
+                                    capacity, split_count);
+           },
+           /*num_outputs=*/2,
+           xla::util::MHash(num_experts, capacity, split_count, groups)),
+      num_experts_(num_experts),
+      capacity_(capacity),
+      split_count_(split_count),
+      groups_(std::move(groups)) {}
+
+NodePtr MoeDispatch::Clone(OpList operands) const {
+  return MakeNode<MoeDispatch>(operands.at(0), operands.at(1), operands.at(2),
+                               operands.at(3), num_experts_, capacity_,
+                               split_count_, groups_);
+}
+
+XlaOpVector MoeDispatch::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  xla::XlaOp expert_indices = loctx->GetOutputOp(operand(1));
+  xla::XlaOp positions = loctx->GetOutputOp(operand(2));
+  xla::XlaOp token = loctx->GetOutputOp(operand(3));
+  AllToAllResult result =
+      BuildMoeDispatch(input, expert_indices, positions, token, num_experts_,
+                       capacity_, split_count_, groups_);
+  return ReturnOps({result.result, result.token}, loctx);
+}
+
+std::string MoeDispatch::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", num_experts=" << num_experts_
+     << ", capacity=" << capacity_ << ", split_count=" << split_count_
+     << ", groups=(";
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    ss << (i == 0 ? "(" : ",(");
+    ss << absl::StrJoin(groups_[i], ", ") << ")";
+  }
+  ss << ")";
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
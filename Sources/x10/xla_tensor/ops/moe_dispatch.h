@@ -0,0 +1,57 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// Scatters the tokens into per expert buffers, at their routing positions, and
+// sends the buffers to the replicas holding the experts.
+class MoeDispatch : public Node {
+ public:
+  MoeDispatch(const Value& input, const Value& expert_indices,
+              const Value& positions, const Value& token, int64_t num_experts,
+              int64_t capacity, int64_t split_count,
+              std::vector<std::vector<int64_t>> groups);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  int64_t num_experts() const { return num_experts_; }
+
+  int64_t capacity() const { return capacity_; }
+
+  int64_t split_count() const { return split_count_; }
+
+  const std::vector<std::vector<int64_t>>& groups() const { return groups_; }
+
+ private:
+  int64_t num_experts_;
+  int64_t capacity_;
+  int64_t split_count_;
+  std::vector<std::vector<int64_t>> groups_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
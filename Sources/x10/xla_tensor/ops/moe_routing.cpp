@@ -0,0 +1,70 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/moe_routing.h"
+
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/cross_replica_reduces.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& gates, int64_t k) {
+  const xla::Shape& gates_shape = gates.shape();
+  XLA_CHECK_EQ(gates_shape.rank(), 2)
+      << "The gates must be [tokens, experts]: " << gates_shape;
+  XLA_CHECK(k > 0 && k <= gates_shape.dimensions(1))
+      << "Cannot route to the top " << k << " of "
+      << gates_shape.dimensions(1) << " experts";
+  xla::Shape slots_shape = xla::ShapeUtil::MakeShape(
+      xla::PrimitiveType::S32, {gates_shape.dimensions(0), k});
+  return xla::ShapeUtil::MakeTupleShape({slots_shape, slots_shape});
+}
+
+}  // namespace
+
+MoeRouting::MoeRouting(const Value& gates, int64_t k, int64_t capacity)
+    : Node(xla_moe_routing, {gates},
+           [&]() { return NodeOutputShape(gates, k); },
+           /*num_outputs=*/2, xla::util::MHash(k, capacity)),
+      k_(k),
+      capacity_(capacity) {}
+
+NodePtr MoeRouting::Clone(OpList operands) const {
+  return MakeNode<MoeRouting>(operands.at(0), k_, capacity_);
+}
+
+XlaOpVector MoeRouting::Lower(LoweringContext* loctx) const {
+  xla::XlaOp gates = loctx->GetOutputOp(operand(0));
+  MoeRoutingResult result = BuildMoeRouting(gates, k_, capacity_);
+  return ReturnOps({result.expert_indices, result.positions}, loctx);
+}
+
+std::string MoeRouting::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", k=" << k_ << ", capacity=" << capacity_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
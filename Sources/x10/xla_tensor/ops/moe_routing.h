@@ -0,0 +1,49 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// Routes the tokens of the [tokens, experts] gates to their top k experts.
+// Outputs the [tokens, k] experts of the tokens, and their positions within
+// the expert buffers, which are the capacity for the dropped tokens.
+class MoeRouting : public Node {
+ public:
+  MoeRouting(const Value& gates, int64_t k, int64_t capacity);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  int64_t k() const { return k_; }
+
+  int64_t capacity() const { return capacity_; }
+
+ private:
+  int64_t k_;
+  int64_t capacity_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
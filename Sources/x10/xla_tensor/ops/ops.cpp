@@ -25,6 +25,7 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/infer_output_shape.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/constant.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/xla_lower_util.h"
 #include "tensorflow/compiler/tf2xla/lib/random.h"
@@ -176,7 +177,45 @@ NodePtr BroadcastTensors(absl::Span<const Value> tensors) {
       std::move(lower_fn), /*num_outputs=*/tensors.size());
 }
 
+NodePtr BucketMask(const Value& length, int64_t bucket) {
+  auto lower_fn = [bucket](const Node& node,
+                           LoweringContext* loctx) -> XlaOpVector {
+    xla::XlaOp xla_length = loctx->GetOutputOp(node.operand(0));
+    xla::XlaOp iota =
+        xla::Iota(xla_length.builder(), xla::PrimitiveType::S64, bucket);
+    return node.ReturnOp(xla::Lt(iota, xla_length), loctx);
+  };
+  return GenericOp(
+      OpKind(xla_bucket_mask), {length},
+      xla::ShapeUtil::MakeShape(xla::PrimitiveType::PRED, {bucket}),
+      std::move(lower_fn), /*num_outputs=*/1, xla::util::MHash(bucket));
+}
+
+NodePtr PackFlat(absl::Span<const Value> tensors) {
+  auto lower_fn = [](const Node& node, LoweringContext* loctx) -> XlaOpVector {
+    std::vector<xla::XlaOp> xla_operands;
+    for (const Output& operand : node.operands()) {
+      xla_operands.push_back(xla::Reshape(
+          loctx->GetOutputOp(operand),
+          {xla::ShapeUtil::ElementsIn(operand.shape())}));
+    }
+    return node.ReturnOp(
+        xla::ConcatInDim(xla_operands.front().builder(), xla_operands, 0),
+        loctx);
+  };
+  XLA_CHECK(!tensors.empty());
+  int64_t num_elements = 0;
+  for (const Value& tensor : tensors) {
+    XLA_CHECK_EQ(tensor.shape().element_type(),
+                 tensors.front().shape().element_type());
+    num_elements += xla::ShapeUtil::ElementsIn(tensor.shape());
+  }
+  return GenericOp(OpKind(xla_pack_flat), tensors,
+                   xla::ShapeUtil::MakeShape(
+                       tensors.front().shape().element_type(), {num_elements}),
+                   std::move(lower_fn));
+}
+
 }  // namespace ops
 }  // namespace ir
 }  // namespace swift_xla
-
@@ -73,6 +73,14 @@ NodePtr LinSpace(at::Scalar start, at::Scalar stop, int64_t num,
 
 NodePtr BroadcastTensors(absl::Span<const Value> tensors);
 
+// Creates a PRED tensor of shape [bucket], whose first length elements are
+// true. The length is an S64 scalar.
+NodePtr BucketMask(const Value& length, int64_t bucket);
+
+// Flattens the tensors, which must share the element type, and concatenates
+// them into a single rank 1 tensor.
+NodePtr PackFlat(absl::Span<const Value> tensors);
+
 }  // namespace ops
 }  // namespace ir
 }  // namespace swift_xla
@@ -0,0 +1,121 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/optimizer_step.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(absl::Span<const Value> weights,
+                           absl::Span<const Value> states) {
+  std::vector<xla::Shape> tuple_shapes;
+  tuple_shapes.reserve(weights.size() + states.size());
+  for (auto& weight : weights) {
+    tuple_shapes.push_back(weight.shape());
+  }
+  for (auto& state : states) {
+    tuple_shapes.push_back(state.shape());
+  }
+  return xla::ShapeUtil::MakeTupleShape(tuple_shapes);
+}
+
+std::vector<Value> GetOperandList(absl::Span<const Value> weights,
+                                  absl::Span<const Value> grads,
+                                  absl::Span<const Value> states,
+                                  absl::Span<const Value> hyperparameters) {
+  std::vector<Value> operand_list(weights.begin(), weights.end());
+  operand_list.insert(operand_list.end(), grads.begin(), grads.end());
+  operand_list.insert(operand_list.end(), states.begin(), states.end());
+  operand_list.insert(operand_list.end(), hyperparameters.begin(),
+                      hyperparameters.end());
+  return operand_list;
+}
+
+}  // namespace
+
+OptimizerStep::OptimizerStep(OptimizerStepKind kind,
+                             absl::Span<const Value> weights,
+                             absl::Span<const Value> grads,
+                             absl::Span<const Value> states,
+                             absl::Span<const Value> hyperparameters,
+                             bool nesterov, bool apply_weight_decay,
+                             float epsilon)
+    : Node(xla_optimizer_step,
+           GetOperandList(weights, grads, states, hyperparameters),
+           [&]() { return NodeOutputShape(weights, states); },
+           /*num_outputs=*/weights.size() + states.size(),
+           xla::util::MHash(xla::util::GetEnumValue(kind), nesterov,
+                            apply_weight_decay, epsilon)),
+      kind_(kind),
+      num_weights_(weights.size()),
+      nesterov_(nesterov),
+      apply_weight_decay_(apply_weight_decay),
+      epsilon_(epsilon) {
+  XLA_CHECK_EQ(grads.size(), num_weights_);
+  XLA_CHECK_EQ(states.size(), num_weights_ * GetOptimizerStepStateCount(kind));
+  XLA_CHECK_EQ(hyperparameters.size(),
+               GetOptimizerStepHyperparameterCount(kind));
+}
+
+NodePtr OptimizerStep::Clone(OpList operands) const {
+  size_t num_states = num_weights_ * GetOptimizerStepStateCount(kind_);
+  std::vector<Value> operand_list(operands.begin(), operands.end());
+  absl::Span<const Value> values(operand_list);
+  return MakeNode<OptimizerStep>(
+      kind_, values.subspan(0, num_weights_),
+      values.subspan(num_weights_, num_weights_),
+      values.subspan(2 * num_weights_, num_states),
+      values.subspan(2 * num_weights_ + num_states), nesterov_,
+      apply_weight_decay_, epsilon_);
+}
+
+XlaOpVector OptimizerStep::Lower(LoweringContext* loctx) const {
+  std::vector<xla::XlaOp> inputs;
+  inputs.reserve(operands().size());
+  for (const Output& operand : operands()) {
+    inputs.push_back(loctx->GetOutputOp(operand));
+  }
+  size_t num_states = num_weights_ * GetOptimizerStepStateCount(kind_);
+  absl::Span<const xla::XlaOp> values(inputs);
+  OptimizerStepResult result = BuildOptimizerStep(
+      kind_, values.subspan(0, num_weights_),
+      values.subspan(num_weights_, num_weights_),
+      values.subspan(2 * num_weights_, num_states),
+      values.subspan(2 * num_weights_ + num_states), nesterov_,
+      apply_weight_decay_, epsilon_);
+  std::vector<xla::XlaOp> outputs = std::move(result.steps);
+  outputs.insert(outputs.end(), result.states.begin(), result.states.end());
+  return ReturnOps(outputs, loctx);
+}
+
+std::string OptimizerStep::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", kind=" << xla::util::GetEnumValue(kind_)
+     << ", num_weights=" << num_weights_ << ", nesterov=" << nesterov_
+     << ", apply_weight_decay=" << apply_weight_decay_
+     << ", epsilon=" << epsilon_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/optimizer_step.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// Takes the weights, the gradients, the state major states and the scalar
+// hyperparameters, in this order, and returns the steps followed by the
+// updated states.
+class OptimizerStep : public Node {
+ public:
+  OptimizerStep(OptimizerStepKind kind, absl::Span<const Value> weights,
+                absl::Span<const Value> grads, absl::Span<const Value> states,
+                absl::Span<const Value> hyperparameters, bool nesterov,
+                bool apply_weight_decay, float epsilon);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  OptimizerStepKind kind() const { return kind_; }
+
+  size_t num_weights() const { return num_weights_; }
+
+  bool nesterov() const { return nesterov_; }
+
+  bool apply_weight_decay() const { return apply_weight_decay_; }
+
+  float epsilon() const { return epsilon_; }
+
+ private:
+  OptimizerStepKind kind_;
+  size_t num_weights_;
+  bool nesterov_;
+  bool apply_weight_decay_;
+  float epsilon_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,103 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/random_init.h"
+
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/tf2xla/lib/random.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/lib/prng.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+RandomInit::RandomInit(xla::Shape shape, RandomInitDistribution distribution,
+                       double scale, int64_t seed0, int64_t seed1,
+                       BitGeneratorType generator)
+    : Node(xla_random_init, std::move(shape), /*num_outputs=*/1,
+           xla::util::MHash(static_cast<int>(distribution), scale, seed0,
+                            seed1, static_cast<int>(generator))),
+      distribution_(distribution),
+      scale_(scale),
+      seed0_(seed0),
+      seed1_(seed1),
+      generator_(generator) {}
+
+NodePtr RandomInit::Clone(OpList operands) const {
+  return MakeNode<RandomInit>(shape(), distribution_, scale_, seed0_, seed1_,
+                              generator_);
+}
+
+XlaOpVector RandomInit::Lower(LoweringContext* loctx) const {
+  xla::XlaBuilder* builder = loctx->builder();
+  // Same key as the one the stateless random ops build out of their [2] seed.
+  xla::XlaOp key = xla::ConstantR0<xla::uint64>(
+      builder, static_cast<xla::uint64>(seed0_) |
+                   (static_cast<xla::uint64>(seed1_) << 32));
+  xla::XlaOp initial_state = xla::ConstantR0<xla::uint64>(builder, 0);
+  xla::PrimitiveType type = shape().element_type();
+  xla::PrimitiveType sample_type = type == xla::F64 ? xla::F64 : xla::F32;
+  xla::Shape sample_shape =
+      xla::ShapeUtil::MakeShape(sample_type, shape().dimensions());
+  xla::BitGeneratorTy bit_generator = GetBitGenerator(generator_);
+  xla::XlaOp sample;
+  switch (distribution_) {
+    case RandomInitDistribution::kUniform:
+      sample = xla::UniformFloatingPointDistribution(
+                   key, initial_state, bit_generator,
+                   XlaHelpers::ScalarValue(-scale_, sample_type, builder),
+                   XlaHelpers::ScalarValue(scale_, sample_type, builder),
+                   sample_shape)
+                   .value;
+      break;
+    case RandomInitDistribution::kNormal:
+      sample = xla::NormalFloatingPointDistribution(key, initial_state,
+                                                    bit_generator, sample_shape)
+                   .value *
+               XlaHelpers::ScalarValue(scale_, sample_type, builder);
+      break;
+    case RandomInitDistribution::kTruncatedNormal: {
+      xla::XlaOp uniform =
+          xla::UniformFloatingPointDistribution(
+              key, initial_state, bit_generator,
+              xla::MinPositiveNormalValue(builder, sample_type),
+              xla::One(builder, sample_type), sample_shape)
+              .value;
+      sample = tensorflow::TruncatedNormal(uniform) *
+               XlaHelpers::ScalarValue(scale_, sample_type, builder);
+      break;
+    }
+  }
+  if (sample_type != type) {
+    sample = xla::ConvertElementType(sample, type);
+  }
+  return ReturnOp(sample, loctx);
+}
+
+std::string RandomInit::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString()
+     << ", distribution=" << static_cast<int>(distribution_)
+     << ", scale=" << scale_ << ", seeds=(" << seed0_ << ", " << seed1_ << ")";
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
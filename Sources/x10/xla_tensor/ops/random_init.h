@@ -0,0 +1,65 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/tf_bit_generator.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+enum class RandomInitDistribution {
+  // Uniform between -scale and scale.
+  kUniform,
+  // Normal with scale as standard deviation.
+  kNormal,
+  // Normal with scale as standard deviation, truncated at two standard
+  // deviations.
+  kTruncatedNormal,
+};
+
+// Samples the initial values of a parameter from a seed baked into the graph,
+// so that creating the parameter uploads nothing to the device. The samples
+// are drawn at F32 precision at least, then converted to the node type.
+class RandomInit : public Node {
+ public:
+  RandomInit(xla::Shape shape, RandomInitDistribution distribution,
+             double scale, int64_t seed0, int64_t seed1,
+             BitGeneratorType generator);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  RandomInitDistribution distribution() const { return distribution_; }
+
+  double scale() const { return scale_; }
+
+ private:
+  RandomInitDistribution distribution_;
+  double scale_;
+  int64_t seed0_;
+  int64_t seed1_;
+  BitGeneratorType generator_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
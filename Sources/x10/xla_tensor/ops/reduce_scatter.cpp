@@ -0,0 +1,90 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/reduce_scatter.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& input, const Value& token,
+                           int64_t scatter_dim, int64_t shard_count) {
+  xla::Shape result_shape = input.shape();
+  XLA_CHECK_EQ(result_shape.dimensions(scatter_dim) % shard_count, 0)
+      << "Dimension " << scatter_dim << " of " << result_shape
+      << " does not split into " << shard_count << " shards";
+  result_shape.set_dimensions(scatter_dim,
+                              result_shape.dimensions(scatter_dim) /
+                                  shard_count);
+  return xla::ShapeUtil::MakeTupleShape({result_shape, token.shape()});
+}
+
+}  // namespace
+
+ReduceScatter::ReduceScatter(AllReduceType reduce_type, const Value& input,
+                             const Value& token, double scale,
+                             int64_t scatter_dim, int64_t shard_count,
+                             std::vector<std::vector<int64_t>> groups)
+    : Node(xla_reduce_scatter, {input, token},
+           [&]() {
+             return NodeOutputShape(input, token, scatter_dim, shard_count);
+           },
+           /*num_outputs=*/2,
+           xla::util::MHash(xla::util::GetEnumValue(reduce_type), scale,
+                            scatter_dim, shard_count, groups)),
+      reduce_type_(reduce_type),
+      scale_(scale),
+      scatter_dim_(scatter_dim),
+      shard_count_(shard_count),
+      groups_(std::move(groups)) {}
+
+NodePtr ReduceScatter::Clone(OpList operands) const {
+  return MakeNode<ReduceScatter>(reduce_type_, operands.at(0), operands.at(1),
+                                 scale_, scatter_dim_, shard_count_, groups_);
+}
+
+XlaOpVector ReduceScatter::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  xla::XlaOp token = loctx->GetOutputOp(operand(1));
+  ReduceScatterResult result =
+      BuildReduceScatter(reduce_type_, input, token, scale_, scatter_dim_,
+                         shard_count_, groups_);
+  return ReturnOps({result.result, result.token}, loctx);
+}
+
+std::string ReduceScatter::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString()
+     << ", reduce_type=" << xla::util::GetEnumValue(reduce_type_)
+     << ", scale=" << scale_ << ", scatter_dim=" << scatter_dim_
+     << ", shard_count=" << shard_count_ << ", groups=(";
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    ss << (i == 0 ? "(" : ",(");
+    ss << absl::StrJoin(groups_[i], ", ") << ")";
+  }
+  ss << ")";
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
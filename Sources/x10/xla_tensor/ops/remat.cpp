@@ -0,0 +1,153 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/remat.h"
+
+#include <sstream>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/memory_analysis.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/device_data.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::XlaComputation MakeBranchComputation(const xla::Shape& shape,
+                                          bool identity) {
+  xla::XlaBuilder builder(identity ? "RematIdentity" : "RematZeros");
+  xla::Parameter(&builder, 0, shape, "input");
+  if (!identity) {
+    xla::Broadcast(xla::Zero(&builder, shape.element_type()),
+                   shape.dimensions());
+  }
+  return ConsumeValue(builder.Build());
+}
+
+xla::XlaOp BuildRematBarrier(xla::XlaOp input) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::XlaBuilder* builder = input.builder();
+  // A predicate which is always true, but which XLA cannot evaluate at compile
+  // time. With a false branch different from the true one, the conditional can
+  // neither be folded away nor turned into a select of identical values.
+  xla::XlaOp sample = xla::RngUniform(
+      xla::ConstantR0<float>(builder, 0), xla::ConstantR0<float>(builder, 1),
+      xla::ShapeUtil::MakeShape(xla::PrimitiveType::F32, {}));
+  xla::XlaOp pred = xla::Lt(sample, xla::ConstantR0<float>(builder, 2));
+  return xla::Conditional(pred, input, MakeBranchComputation(shape, true),
+                          input, MakeBranchComputation(shape, false));
+}
+
+}  // namespace
+
+Remat::Remat(const Value& input, std::string scope)
+    : Node(xla_remat, {input}, input.shape(),
+           /*num_outputs=*/1, xla::util::MHash(scope)),
+      scope_(std::move(scope)) {}
+
+NodePtr Remat::Clone(OpList operands) const {
+  return MakeNode<Remat>(operands.at(0), scope_);
+}
+
+XlaOpVector Remat::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  return ReturnOp(BuildRematBarrier(input), loctx);
+}
+
+std::string Remat::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", scope=" << scope_;
+  return ss.str();
+}
+
+Remat* Remat::Cast(const Node* node) {
+  return NodeCast<Remat>(node, xla_remat);
+}
+
+std::map<std::string, int64_t> Remat::ComputeSavedBytes(
+    absl::Span<const Node* const> post_order) {
+  std::map<std::string, int64_t> saved_bytes;
+  // Hashes the nodes as if the remat nodes were not there, which makes a
+  // recomputed value hash like its forward copy. The nodes depending on a remat
+  // node are tracked with the scope of the first one reached.
+  absl::flat_hash_map<const Node*, xla::hash_t> hashes;
+  absl::flat_hash_map<const Node*, const std::string*> scopes;
+  auto output_hash = [&](const Output& output) {
+    return xla::util::HashCombine(hashes.at(output.node),
+                                  xla::util::Hash(output.index));
+  };
+  for (auto node : post_order) {
+    const Remat* remat = Cast(node);
+    if (remat != nullptr) {
+      hashes.emplace(node, output_hash(node->operand(0)));
+      scopes.emplace(node, &remat->scope());
+      continue;
+    }
+    xla::hash_t hash = node->node_hash();
+    if (node->operands().empty()) {
+      const DeviceData* device_data = DeviceData::Cast(node);
+      if (device_data != nullptr) {
+        hash = xla::util::HashCombine(hash,
+                                      device_data->data()->GetOpaqueHandle());
+      }
+    }
+    const std::string* scope = nullptr;
+    for (auto& output : node->operands()) {
+      hash = xla::util::HashCombine(hash, output_hash(output));
+      auto it = scopes.find(output.node);
+      if (scope == nullptr && it != scopes.end()) {
+        scope = it->second;
+      }
+    }
+    hashes.emplace(node, hash);
+    if (scope != nullptr) {
+      scopes.emplace(node, scope);
+    }
+  }
+  if (scopes.empty()) {
+    return saved_bytes;
+  }
+
+  absl::flat_hash_set<xla::hash_t> forward_hashes;
+  for (auto node : post_order) {
+    if (scopes.count(node) == 0) {
+      forward_hashes.insert(hashes.at(node));
+    }
+  }
+  absl::flat_hash_set<xla::hash_t> counted_hashes;
+  for (auto node : post_order) {
+    auto it = scopes.find(node);
+    if (it == scopes.end() || node->operands().empty() ||
+        Cast(node) != nullptr) {
+      continue;
+    }
+    xla::hash_t hash = hashes.at(node);
+    if (forward_hashes.count(hash) > 0 && counted_hashes.insert(hash).second) {
+      saved_bytes[*it->second] += ArraysByteSize(node->shape());
+    }
+  }
+  return saved_bytes;
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
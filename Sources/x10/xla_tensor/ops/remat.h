@@ -0,0 +1,58 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// IR node marking a rematerialization boundary. It forwards its input, but
+// lowers to an opaque identity, so that a subgraph recomputed on top of it
+// (typically inside a pullback) is neither merged with nor replaced by the
+// forward copy of the same subgraph, whose outputs can then be freed early.
+class Remat : public Node {
+ public:
+  Remat(const Value& input, std::string scope);
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  std::string ToString() const override;
+
+  const std::string& scope() const { return scope_; }
+
+  static Remat* Cast(const Node* node);
+
+  // Returns, for every remat scope within the post-order, the bytes of the
+  // forward values which the graph recomputes on top of the scope remat
+  // nodes, and hence no longer needs to keep alive.
+  static std::map<std::string, int64_t> ComputeSavedBytes(
+      absl::Span<const Node* const> post_order);
+
+ private:
+  std::string scope_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,67 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/rng_seed.h"
+
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+RngSeed::RngSeed(const Value& step_seed, int64_t op_index)
+    : Node(xla_rng_seed, {step_seed}, xla::ShapeUtil::MakeShape(xla::S32, {2}),
+           /*num_outputs=*/1, xla::util::MHash(op_index)),
+      op_index_(op_index) {}
+
+NodePtr RngSeed::Clone(OpList operands) const {
+  return MakeNode<RngSeed>(operands.at(0), op_index_);
+}
+
+XlaOpVector RngSeed::Lower(LoweringContext* loctx) const {
+  xla::XlaOp step_seed = loctx->GetOutputOp(operand(0));
+  xla::XlaBuilder* builder = loctx->builder();
+  auto u64 = [&](xla::uint64 value) {
+    return xla::ConstantR0<xla::uint64>(builder, value);
+  };
+  // SplitMix64 over the step seed advanced by op_index golden ratio
+  // increments, so that neighbouring ops get unrelated keys.
+  xla::XlaOp key =
+      xla::ConvertElementType(step_seed, xla::U64) +
+      u64(static_cast<xla::uint64>(op_index_ + 1) * 0x9E3779B97F4A7C15ULL);
+  key = xla::Xor(key, xla::ShiftRightLogical(key, u64(30))) *
+        u64(0xBF58476D1CE4E5B9ULL);
+  key = xla::Xor(key, xla::ShiftRightLogical(key, u64(27))) *
+        u64(0x94D049BB133111EBULL);
+  key = xla::Xor(key, xla::ShiftRightLogical(key, u64(31)));
+  xla::XlaOp low = xla::ConvertElementType(key, xla::U32);
+  xla::XlaOp high =
+      xla::ConvertElementType(xla::ShiftRightLogical(key, u64(32)), xla::U32);
+  xla::XlaOp seed = xla::ConcatInDim(
+      builder, {xla::Reshape(low, {1}), xla::Reshape(high, {1})}, 0);
+  return ReturnOp(xla::BitcastConvertType(seed, xla::S32), loctx);
+}
+
+std::string RngSeed::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", op_index=" << op_index_;
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
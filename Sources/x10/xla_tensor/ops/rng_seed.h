@@ -0,0 +1,47 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// Derives the [2] S32 seed of a stateless random op out of the S64 step seed
+// and of the index of the op within the step. The index is the only thing
+// baked into the graph, so the graph stays the same across steps, and the
+// random ops do not depend on each other.
+class RngSeed : public Node {
+ public:
+  RngSeed(const Value& step_seed, int64_t op_index);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  int64_t op_index() const { return op_index_; }
+
+ private:
+  int64_t op_index_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/xla/xla_data.pb.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// IR node attaching a sharding to its input, which it forwards. It lowers to
+// the XLA "Sharding" custom call, whose sharding tells the SPMD partitioner how
+// to split the value across the partitions of the computation.
+class Sharding : public Node {
+ public:
+  Sharding(const Value& input, xla::OpSharding sharding);
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  std::string ToString() const override;
+
+  const xla::OpSharding& sharding() const { return sharding_; }
+
+ private:
+  xla::OpSharding sharding_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
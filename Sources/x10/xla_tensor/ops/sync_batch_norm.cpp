@@ -0,0 +1,90 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/sync_batch_norm.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/batch_norm.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& input, const Value& weight,
+                           const Value& token, int64_t feature_index) {
+  const xla::Shape& input_shape = input.shape();
+  XLA_CHECK_EQ(weight.shape().rank(), 1) << weight.shape();
+  XLA_CHECK_EQ(weight.shape().dimensions(0),
+               input_shape.dimensions(feature_index))
+      << weight.shape() << " does not match the features of " << input_shape;
+  xla::Shape stats_shape = xla::ShapeUtil::MakeShape(
+      input_shape.element_type(), {input_shape.dimensions(feature_index)});
+  return xla::ShapeUtil::MakeTupleShape(
+      {input_shape, stats_shape, stats_shape, token.shape()});
+}
+
+}  // namespace
+
+SyncBatchNorm::SyncBatchNorm(const Value& input, const Value& weight,
+                             const Value& bias, const Value& token,
+                             int64_t feature_index, float eps,
+                             std::vector<std::vector<int64_t>> groups)
+    : Node(xla_sync_batch_norm, {input, weight, bias, token},
+           [&]() {
+             return NodeOutputShape(input, weight, token, feature_index);
+           },
+           /*num_outputs=*/4, xla::util::MHash(feature_index, eps, groups)),
+      feature_index_(feature_index),
+      eps_(eps),
+      groups_(std::move(groups)) {}
+
+NodePtr SyncBatchNorm::Clone(OpList operands) const {
+  return MakeNode<SyncBatchNorm>(operands.at(0), operands.at(1),
+                                 operands.at(2), operands.at(3),
+                                 feature_index_, eps_, groups_);
+}
+
+XlaOpVector SyncBatchNorm::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  xla::XlaOp weight = loctx->GetOutputOp(operand(1));
+  xla::XlaOp bias = loctx->GetOutputOp(operand(2));
+  xla::XlaOp token = loctx->GetOutputOp(operand(3));
+  SyncBatchNormOutput result = BuildSyncBatchNormTraining(
+      input, weight, bias, token, feature_index_, eps_, groups_);
+  return ReturnOps({result.output, result.batch_mean, result.batch_variance,
+                    result.token},
+                   loctx);
+}
+
+std::string SyncBatchNorm::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", feature_index=" << feature_index_
+     << ", eps=" << eps_ << ", groups=(";
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    ss << (i == 0 ? "(" : ",(");
+    ss << absl::StrJoin(groups_[i], ", ") << ")";
+  }
+  ss << ")";
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,79 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/sync_batch_norm_backward.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/batch_norm.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+SyncBatchNormBackward::SyncBatchNormBackward(
+    const Value& grad, const Value& input, const Value& weight,
+    const Value& mean, const Value& variance, const Value& token,
+    int64_t feature_index, float eps, std::vector<std::vector<int64_t>> groups)
+    : Node(xla_sync_batch_norm_backward,
+           {grad, input, weight, mean, variance, token},
+           [&]() {
+             return xla::ShapeUtil::MakeTupleShape(
+                 {input.shape(), weight.shape(), weight.shape(),
+                  token.shape()});
+           },
+           /*num_outputs=*/4, xla::util::MHash(feature_index, eps, groups)),
+      feature_index_(feature_index),
+      eps_(eps),
+      groups_(std::move(groups)) {}
+
+NodePtr SyncBatchNormBackward::Clone(OpList operands) const {
+  return MakeNode<SyncBatchNormBackward>(
+      operands.at(0), operands.at(1), operands.at(2), operands.at(3),
+      operands.at(4), operands.at(5), feature_index_, eps_, groups_);
+}
+
+XlaOpVector SyncBatchNormBackward::Lower(LoweringContext* loctx) const {
+  xla::XlaOp grad = loctx->GetOutputOp(operand(0));
+  xla::XlaOp input = loctx->GetOutputOp(operand(1));
+  xla::XlaOp weight = loctx->GetOutputOp(operand(2));
+  xla::XlaOp mean = loctx->GetOutputOp(operand(3));
+  xla::XlaOp variance = loctx->GetOutputOp(operand(4));
+  xla::XlaOp token = loctx->GetOutputOp(operand(5));
+  SyncBatchNormGrads grads =
+      BuildSyncBatchNormBackward(grad, input, weight, mean, variance, token,
+                                 feature_index_, eps_, groups_);
+  return ReturnOps(
+      {grads.grad_input, grads.grad_weight, grads.grad_bias, grads.token},
+      loctx);
+}
+
+std::string SyncBatchNormBackward::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", feature_index=" << feature_index_
+     << ", eps=" << eps_ << ", groups=(";
+  for (size_t i = 0; i < groups_.size(); ++i) {
+    ss << (i == 0 ? "(" : ",(");
+    ss << absl::StrJoin(groups_[i], ", ") << ")";
+  }
+  ss << ")";
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
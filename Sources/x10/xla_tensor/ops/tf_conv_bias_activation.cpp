@@ -0,0 +1,101 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/tf_conv_bias_activation.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/infer_output_shape.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/tf_create_conv_attrs.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& input, const Value& filter,
+                           const Value& bias, ConvActivation activation,
+                           const tensorflow::ConvOpAttrs& attrs) {
+  auto lower_for_shape_fn =
+      [&](absl::Span<const xla::XlaOp> operands) -> xla::XlaOp {
+    return BuildTfConvBiasActivation(operands[0], operands[1], operands[2],
+                                     activation, attrs);
+  };
+  return InferOutputShape({input.shape(), filter.shape(), bias.shape()},
+                          lower_for_shape_fn);
+}
+
+}  // namespace
+
+TfConvBiasActivation::TfConvBiasActivation(
+    const Value& input, const Value& filter, const Value& bias,
+    ConvActivation activation, bool depthwise, std::vector<int64_t> strides,
+    tensorflow::Padding padding, std::vector<int64_t> explicit_paddings,
+    tensorflow::TensorFormat data_format, std::vector<int64_t> dilations)
+    : Node(xla_tf_conv_bias_activation, {input, filter, bias},
+           [&]() {
+             return NodeOutputShape(
+                 input, filter, bias, activation,
+                 CreateConvOpAttrs(input.shape().rank() - 2, depthwise,
+                                   strides, padding, explicit_paddings,
+                                   data_format, dilations));
+           },
+           /*num_outputs=*/1,
+           xla::util::MHash(xla::util::GetEnumValue(activation), depthwise,
+                            strides, static_cast<int>(padding),
+                            explicit_paddings, static_cast<int>(data_format),
+                            dilations)),
+      activation_(activation),
+      depthwise_(depthwise),
+      strides_(std::move(strides)),
+      padding_(padding),
+      explicit_paddings_(std::move(explicit_paddings)),
+      data_format_(data_format),
+      dilations_(std::move(dilations)) {}
+
+NodePtr TfConvBiasActivation::Clone(OpList operands) const {
+  return MakeNode<TfConvBiasActivation>(
+      operands.at(0), operands.at(1), operands.at(2), activation_, depthwise_,
+      strides_, padding_, explicit_paddings_, data_format_, dilations_);
+}
+
+XlaOpVector TfConvBiasActivation::Lower(LoweringContext* loctx) const {
+  xla::XlaOp input = loctx->GetOutputOp(operand(0));
+  xla::XlaOp filter = loctx->GetOutputOp(operand(1));
+  xla::XlaOp bias = loctx->GetOutputOp(operand(2));
+  tensorflow::ConvOpAttrs attrs = CreateConvOpAttrs(
+      operand(0).shape().rank() - 2, depthwise_, strides_, padding_,
+      explicit_paddings_, data_format_, dilations_);
+  return ReturnOp(
+      BuildTfConvBiasActivation(input, filter, bias, activation_, attrs),
+      loctx);
+}
+
+std::string TfConvBiasActivation::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", activation="
+     << (activation_ == ConvActivation::kRelu ? "relu" : "identity")
+     << ", depthwise=" << depthwise_ << ", strides=("
+     << absl::StrJoin(strides_, ", ") << "), padding=" << padding_
+     << ", explicit_paddings=(" << absl::StrJoin(explicit_paddings_, ", ")
+     << "), data_format=" << data_format_ << ", dilations=("
+     << absl::StrJoin(dilations_, ", ") << ")";
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
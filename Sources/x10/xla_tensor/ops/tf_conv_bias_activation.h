@@ -0,0 +1,74 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/convolution.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// The TF convolution of the input and filter, plus the bias along the output
+// features and the activation, lowered as a single convolution epilogue.
+class TfConvBiasActivation : public Node {
+ public:
+  TfConvBiasActivation(const Value& input, const Value& filter,
+                       const Value& bias, ConvActivation activation,
+                       bool depthwise, std::vector<int64_t> strides,
+                       tensorflow::Padding padding,
+                       std::vector<int64_t> explicit_paddings,
+                       tensorflow::TensorFormat data_format,
+                       std::vector<int64_t> dilations);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+  ConvActivation activation() const { return activation_; }
+
+  bool depthwise() const { return depthwise_; }
+
+  const std::vector<int64_t>& strides() const { return strides_; }
+
+  tensorflow::Padding padding() const { return padding_; }
+
+  const std::vector<int64_t>& explicit_paddings() const {
+    return explicit_paddings_;
+  }
+
+  tensorflow::TensorFormat data_format() const { return data_format_; }
+
+  const std::vector<int64_t>& dilations() const { return dilations_; }
+
+ private:
+  ConvActivation activation_;
+  bool depthwise_;
+  std::vector<int64_t> strides_;
+  tensorflow::Padding padding_;
+  std::vector<int64_t> explicit_paddings_;
+  tensorflow::TensorFormat data_format_;
+  std::vector<int64_t> dilations_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,104 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/tf_conv_bias_activation_backward.h"
+
+#include "absl/strings/str_join.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/tf_create_conv_attrs.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+namespace {
+
+xla::Shape NodeOutputShape(const Value& input, const Value& filter,
+                           const Value& output,
+                           tensorflow::TensorFormat data_format) {
+  const xla::Shape& output_shape = output.shape();
+  int64_t feature_dim = data_format == tensorflow::FORMAT_NHWC
+                            ? output_shape.rank() - 1
+                            : 1;
+  xla::Shape bias_shape =
+      xla::ShapeUtil::MakeShape(output_shape.element_type(),
+                                {output_shape.dimensions(feature_dim)});
+  return xla::ShapeUtil::MakeTupleShape(
+      {input.shape(), filter.shape(), bias_shape});
+}
+
+}  // namespace
+
+TfConvBiasActivationBackward::TfConvBiasActivationBackward(
+    const Value& grad_output, const Value& input, const Value& filter,
+    const Value& output, ConvActivation activation, bool depthwise,
+    std::vector<int64_t> strides, tensorflow::Padding padding,
+    std::vector<int64_t> explicit_paddings,
+    tensorflow::TensorFormat data_format, std::vector<int64_t> dilations)
+    : Node(xla_tf_conv_bias_activation_backward,
+           {grad_output, input, filter, output},
+           [&]() {
+             return NodeOutputShape(input, filter, output, data_format);
+           },
+           /*num_outputs=*/3,
+           xla::util::MHash(xla::util::GetEnumValue(activation), depthwise,
+                            strides, static_cast<int>(padding),
+                            explicit_paddings, static_cast<int>(data_format),
+                            dilations)),
+      activation_(activation),
+      depthwise_(depthwise),
+      strides_(std::move(strides)),
+      padding_(padding),
+      explicit_paddings_(std::move(explicit_paddings)),
+      data_format_(data_format),
+      dilations_(std::move(dilations)) {}
+
+NodePtr TfConvBiasActivationBackward::Clone(OpList operands) const {
+  return MakeNode<TfConvBiasActivationBackward>(
+      operands.at(0), operands.at(1), operands.at(2), operands.at(3),
+      activation_, depthwise_, strides_, padding_, explicit_paddings_,
+      data_format_, dilations_);
+}
+
+XlaOpVector TfConvBiasActivationBackward::Lower(LoweringContext* loctx) const {
+  xla::XlaOp grad_output = loctx->GetOutputOp(operand(0));
+  xla::XlaOp input = loctx->GetOutputOp(operand(1));
+  xla::XlaOp filter = loctx->GetOutputOp(operand(2));
+  xla::XlaOp output = loctx->GetOutputOp(operand(3));
+  tensorflow::ConvOpAttrs attrs = CreateConvOpAttrs(
+      operand(1).shape().rank() - 2, depthwise_, strides_, padding_,
+      explicit_paddings_, data_format_, dilations_);
+  ConvGrads grads = BuildTfConvBiasActivationBackward(
+      grad_output, input, filter, output, activation_, attrs);
+  return ReturnOps({grads.grad_input, grads.grad_weight, grads.grad_bias},
+                   loctx);
+}
+
+std::string TfConvBiasActivationBackward::ToString() const {
+  std::stringstream ss;
+  ss << Node::ToString() << ", activation="
+     << (activation_ == ConvActivation::kRelu ? "relu" : "identity")
+     << ", depthwise=" << depthwise_ << ", strides=("
+     << absl::StrJoin(strides_, ", ") << "), padding=" << padding_
+     << ", explicit_paddings=(" << absl::StrJoin(explicit_paddings_, ", ")
+     << "), data_format=" << data_format_ << ", dilations=("
+     << absl::StrJoin(dilations_, ", ") << ")";
+  return ss.str();
+}
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/convolution.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+namespace ir {
+namespace ops {
+
+// The input, filter and bias gradients of TfConvBiasActivation, given the
+// gradient and the result of its output.
+class TfConvBiasActivationBackward : public Node {
+ public:
+  TfConvBiasActivationBackward(const Value& grad_output, const Value& input,
+                               const Value& filter, const Value& output,
+                               ConvActivation activation, bool depthwise,
+                               std::vector<int64_t> strides,
+                               tensorflow::Padding padding,
+                               std::vector<int64_t> explicit_paddings,
+                               tensorflow::TensorFormat data_format,
+                               std::vector<int64_t> dilations);
+
+  std::string ToString() const override;
+
+  NodePtr Clone(OpList operands) const override;
+
+  XlaOpVector Lower(LoweringContext* loctx) const override;
+
+ private:
+  ConvActivation activation_;
+  bool depthwise_;
+  std::vector<int64_t> strides_;
+  tensorflow::Padding padding_;
+  std::vector<int64_t> explicit_paddings_;
+  tensorflow::TensorFormat data_format_;
+  std::vector<int64_t> dilations_;
+};
+
+}  // namespace ops
+}  // namespace ir
+}  // namespace swift_xla
@@ -20,24 +20,49 @@ namespace swift_xla {
 namespace ir {
 namespace ops {
 
+const OpKindWrapper xla_all_finite(xla_symbols::all_finite);
+const OpKindWrapper xla_all_gather(xla_symbols::all_gather);
 const OpKindWrapper xla_all_to_all(xla_symbols::all_to_all);
 const OpKindWrapper xla_as_strided_view_update(
     xla_symbols::as_strided_view_update);
+const OpKindWrapper xla_bucket_mask(xla_symbols::bucket_mask);
 const OpKindWrapper xla_cast(xla_symbols::cast);
 const OpKindWrapper xla_collective_permute(xla_symbols::collective_permute);
 const OpKindWrapper xla_cross_replica_sum(xla_symbols::cross_replica_sum);
 const OpKindWrapper xla_device_data(xla_symbols::device_data);
 const OpKindWrapper xla_diagonal_view_update(xla_symbols::diagonal_view_update);
+const OpKindWrapper xla_fused_elementwise(xla_symbols::fused_elementwise);
 const OpKindWrapper xla_generic_slice(xla_symbols::generic_slice);
 const OpKindWrapper xla_get_dimensions_size(xla_symbols::get_dimensions_size);
+const OpKindWrapper xla_gru_cell(xla_symbols::gru_cell);
+const OpKindWrapper xla_gru_cell_backward(xla_symbols::gru_cell_backward);
+const OpKindWrapper xla_lstm_cell(xla_symbols::lstm_cell);
+const OpKindWrapper xla_lstm_cell_backward(xla_symbols::lstm_cell_backward);
+const OpKindWrapper xla_moe_combine(xla_symbols::moe_combine);
+const OpKindWrapper xla_moe_dispatch(xla_symbols::moe_dispatch);
+const OpKindWrapper xla_moe_routing(xla_symbols::moe_routing);
 const OpKindWrapper xla_moving_average(xla_symbols::moving_average);
 const OpKindWrapper xla_nms(xla_symbols::nms);
 const OpKindWrapper xla_not_supported(xla_symbols::not_supported);
+const OpKindWrapper xla_optimizer_step(xla_symbols::optimizer_step);
+const OpKindWrapper xla_pack_flat(xla_symbols::pack_flat);
+const OpKindWrapper xla_random_init(xla_symbols::random_init);
+const OpKindWrapper xla_reduce_scatter(xla_symbols::reduce_scatter);
 const OpKindWrapper xla_replication_pad(xla_symbols::replication_pad);
 const OpKindWrapper xla_replication_pad_backward(
     xla_symbols::replication_pad_backward);
+const OpKindWrapper xla_remat(xla_symbols::remat);
+const OpKindWrapper xla_rng_seed(xla_symbols::rng_seed);
 const OpKindWrapper xla_select(xla_symbols::select);
+const OpKindWrapper xla_sharding(xla_symbols::sharding);
+const OpKindWrapper xla_sync_batch_norm(xla_symbols::sync_batch_norm);
+const OpKindWrapper xla_sync_batch_norm_backward(
+    xla_symbols::sync_batch_norm_backward);
 const OpKindWrapper xla_tensor_data(xla_symbols::tensor_data);
+const OpKindWrapper xla_tf_conv_bias_activation(
+    xla_symbols::tf_conv_bias_activation);
+const OpKindWrapper xla_tf_conv_bias_activation_backward(
+    xla_symbols::tf_conv_bias_activation_backward);
 const OpKindWrapper xla_token(xla_symbols::token);
 const OpKindWrapper xla_unselect(xla_symbols::unselect);
 const OpKindWrapper xla_update_slice(xla_symbols::update_slice);
@@ -37,22 +37,44 @@ class OpKindWrapper {
   OpKind op_kind_;
 };
 
+extern const OpKindWrapper xla_all_finite;
+extern const OpKindWrapper xla_all_gather;
 extern const OpKindWrapper xla_all_to_all;
 extern const OpKindWrapper xla_as_strided_view_update;
+extern const OpKindWrapper xla_bucket_mask;
 extern const OpKindWrapper xla_cast;
 extern const OpKindWrapper xla_collective_permute;
 extern const OpKindWrapper xla_cross_replica_sum;
 extern const OpKindWrapper xla_device_data;
 extern const OpKindWrapper xla_diagonal_view_update;
+extern const OpKindWrapper xla_fused_elementwise;
 extern const OpKindWrapper xla_generic_slice;
 extern const OpKindWrapper xla_get_dimensions_size;
+extern const OpKindWrapper xla_gru_cell;
+extern const OpKindWrapper xla_gru_cell_backward;
+extern const OpKindWrapper xla_lstm_cell;
+extern const OpKindWrapper xla_lstm_cell_backward;
+extern const OpKindWrapper xla_moe_combine;
+extern const OpKindWrapper xla_moe_dispatch;
+extern const OpKindWrapper xla_moe_routing;
 extern const OpKindWrapper xla_moving_average;
 extern const OpKindWrapper xla_nms;
 extern const OpKindWrapper xla_not_supported;
+extern const OpKindWrapper xla_optimizer_step;
+extern const OpKindWrapper xla_pack_flat;
+extern const OpKindWrapper xla_random_init;
+extern const OpKindWrapper xla_reduce_scatter;
 extern const OpKindWrapper xla_replication_pad;
 extern const OpKindWrapper xla_replication_pad_backward;
+extern const OpKindWrapper xla_remat;
+extern const OpKindWrapper xla_rng_seed;
 extern const OpKindWrapper xla_select;
+extern const OpKindWrapper xla_sharding;
+extern const OpKindWrapper xla_sync_batch_norm;
+extern const OpKindWrapper xla_sync_batch_norm_backward;
 extern const OpKindWrapper xla_tensor_data;
+extern const OpKindWrapper xla_tf_conv_bias_activation;
+extern const OpKindWrapper xla_tf_conv_bias_activation_backward;
 extern const OpKindWrapper xla_token;
 extern const OpKindWrapper xla_unselect;
 extern const OpKindWrapper xla_update_slice;
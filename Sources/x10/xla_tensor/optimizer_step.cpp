@@ -0,0 +1,187 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/optimizer_step.h"
+
+#include <map>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/convert_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace swift_xla {
+namespace {
+
+bool PackTensors() {
+  static const bool pack_tensors =
+      xla::sys_util::GetEnvBool("XLA_OPTIMIZER_PACK_TENSORS", false);
+  return pack_tensors;
+}
+
+// Computes the step of a weight and updates its states in place. All the
+// operands share the element type of the weight.
+xla::XlaOp BuildTensorStep(OptimizerStepKind kind, xla::XlaOp weight,
+                           xla::XlaOp grad, std::vector<xla::XlaOp>* states,
+                           absl::Span<const xla::XlaOp> hyperparameters,
+                           bool nesterov, bool apply_weight_decay,
+                           float epsilon) {
+  switch (kind) {
+    case OptimizerStepKind::kSgdMomentum: {
+      xla::XlaOp lr = hyperparameters[0];
+      xla::XlaOp momentum = hyperparameters[1];
+      xla::XlaOp weight_decay = hyperparameters[2];
+      if (apply_weight_decay) {
+        grad = grad + weight * weight_decay;
+      }
+      xla::XlaOp& velocity = (*states)[0];
+      velocity = momentum * velocity - grad * lr;
+      return nesterov ? momentum * velocity - grad * lr : velocity;
+    }
+    case OptimizerStepKind::kAdam:
+    case OptimizerStepKind::kAdamW: {
+      xla::XlaOp lr = hyperparameters[0];
+      xla::XlaOp beta1 = hyperparameters[1];
+      xla::XlaOp beta2 = hyperparameters[2];
+      xla::XlaOp weight_decay = hyperparameters[3];
+      if (kind == OptimizerStepKind::kAdam && apply_weight_decay) {
+        grad = grad + weight * weight_decay;
+      }
+      xla::XlaOp one = xla::ScalarLike(lr, 1);
+      xla::XlaOp& first_moment = (*states)[0];
+      xla::XlaOp& second_moment = (*states)[1];
+      first_moment = beta1 * first_moment + grad * (one - beta1);
+      second_moment = beta2 * second_moment + grad * grad * (one - beta2);
+      xla::XlaOp update =
+          first_moment /
+          (xla::Sqrt(second_moment) + xla::ScalarLike(lr, epsilon));
+      if (kind == OptimizerStepKind::kAdamW && apply_weight_decay) {
+        update = update + weight * weight_decay;
+      }
+      return xla::Neg(lr) * update;
+    }
+  }
+  XLA_ERROR() << "Invalid optimizer step kind: " << static_cast<int>(kind);
+}
+
+xla::XlaOp FlattenTo(xla::XlaOp input, xla::PrimitiveType type) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  return xla::Reshape(MaybeConvertTo(input, type),
+                      {xla::ShapeUtil::ElementsIn(shape)});
+}
+
+}  // namespace
+
+size_t GetOptimizerStepStateCount(OptimizerStepKind kind) {
+  return kind == OptimizerStepKind::kSgdMomentum ? 1 : 2;
+}
+
+size_t GetOptimizerStepHyperparameterCount(OptimizerStepKind kind) {
+  return kind == OptimizerStepKind::kSgdMomentum ? 3 : 4;
+}
+
+OptimizerStepResult BuildOptimizerStep(
+    OptimizerStepKind kind, absl::Span<const xla::XlaOp> weights,
+    absl::Span<const xla::XlaOp> grads, absl::Span<const xla::XlaOp> states,
+    absl::Span<const xla::XlaOp> hyperparameters, bool nesterov,
+    bool apply_weight_decay, float epsilon) {
+  size_t num_weights = weights.size();
+  size_t state_count = GetOptimizerStepStateCount(kind);
+  XLA_CHECK_EQ(grads.size(), num_weights);
+  XLA_CHECK_EQ(states.size(), state_count * num_weights);
+  XLA_CHECK_EQ(hyperparameters.size(),
+               GetOptimizerStepHyperparameterCount(kind));
+  // Each group of weights gets its update computed at once. Without packing,
+  // every weight is its own group.
+  std::vector<std::vector<size_t>> groups;
+  if (PackTensors()) {
+    std::map<xla::PrimitiveType, std::vector<size_t>> type_groups;
+    for (size_t i = 0; i < num_weights; ++i) {
+      type_groups[XlaHelpers::TypeOfXlaOp(weights[i])].push_back(i);
+    }
+    for (auto& type_indices : type_groups) {
+      groups.push_back(std::move(type_indices.second));
+    }
+  } else {
+    for (size_t i = 0; i < num_weights; ++i) {
+      groups.push_back({i});
+    }
+  }
+  OptimizerStepResult result;
+  result.steps.resize(num_weights);
+  result.states.resize(states.size());
+  for (const auto& indices : groups) {
+    xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(weights[indices[0]]);
+    std::vector<xla::XlaOp> group_hyperparameters;
+    for (xla::XlaOp hyperparameter : hyperparameters) {
+      group_hyperparameters.push_back(MaybeConvertTo(hyperparameter, type));
+    }
+    if (indices.size() == 1) {
+      size_t i = indices[0];
+      std::vector<xla::XlaOp> tensor_states;
+      for (size_t s = 0; s < state_count; ++s) {
+        tensor_states.push_back(
+            MaybeConvertTo(states[s * num_weights + i], type));
+      }
+      result.steps[i] = BuildTensorStep(
+          kind, weights[i], MaybeConvertTo(grads[i], type), &tensor_states,
+          group_hyperparameters, nesterov, apply_weight_decay, epsilon);
+      for (size_t s = 0; s < state_count; ++s) {
+        size_t index = s * num_weights + i;
+        result.states[index] = MaybeConvertTo(
+            tensor_states[s], XlaHelpers::TypeOfXlaOp(states[index]));
+      }
+      continue;
+    }
+    auto pack = [&](absl::Span<const xla::XlaOp> operands, size_t base) {
+      std::vector<xla::XlaOp> parts;
+      parts.reserve(indices.size());
+      for (size_t i : indices) {
+        parts.push_back(FlattenTo(operands[base + i], type));
+      }
+      return xla::ConcatInDim(weights[0].builder(), parts, 0);
+    };
+    std::vector<xla::XlaOp> packed_states;
+    for (size_t s = 0; s < state_count; ++s) {
+      packed_states.push_back(pack(states, s * num_weights));
+    }
+    xla::XlaOp packed_step = BuildTensorStep(
+        kind, pack(weights, 0), pack(grads, 0), &packed_states,
+        group_hyperparameters, nesterov, apply_weight_decay, epsilon);
+    auto unpack = [](xla::XlaOp packed, int64_t offset, xla::XlaOp like) {
+      const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(like);
+      xla::XlaOp part =
+          xla::SliceInDim(packed, offset,
+                          offset + xla::ShapeUtil::ElementsIn(shape), 1, 0);
+      return MaybeConvertTo(xla::Reshape(part, shape.dimensions()),
+                            shape.element_type());
+    };
+    int64_t offset = 0;
+    for (size_t i : indices) {
+      result.steps[i] = unpack(packed_step, offset, weights[i]);
+      for (size_t s = 0; s < state_count; ++s) {
+        size_t index = s * num_weights + i;
+        result.states[index] =
+            unpack(packed_states[s], offset, states[index]);
+      }
+      offset += xla::ShapeUtil::ElementsIn(
+          XlaHelpers::ShapeOfXlaOp(weights[i]));
+    }
+  }
+  return result;
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+
+namespace swift_xla {
+
+enum class OptimizerStepKind {
+  // SGD with momentum: v = momentum * v - lr * g, stepping by v, or by
+  // momentum * v - lr * g with Nesterov momentum. Takes the lr, momentum and
+  // weight_decay hyperparameters, and the velocity state.
+  kSgdMomentum,
+  // Adam, with the weight decay added to the gradient. Takes the lr, beta1,
+  // beta2 and weight_decay hyperparameters, and the first and second moment
+  // states.
+  kAdam,
+  // Adam with the weight decay decoupled from the moments, and added to the
+  // update instead. Same hyperparameters and states as kAdam.
+  kAdamW,
+};
+
+struct OptimizerStepResult {
+  // The steps to add to the weights.
+  std::vector<xla::XlaOp> steps;
+  // The updated states, state major: states[s * num_weights + i] is the state
+  // s of the weight i.
+  std::vector<xla::XlaOp> states;
+};
+
+// Number of state tensors each weight carries for the given kind.
+size_t GetOptimizerStepStateCount(OptimizerStepKind kind);
+
+// Number of scalar hyperparameters the given kind takes.
+size_t GetOptimizerStepHyperparameterCount(OptimizerStepKind kind);
+
+// Computes the optimizer step of all the weights at once, given the gradients,
+// the state major states and the scalar hyperparameters. The weight decay only
+// applies if apply_weight_decay is set, and the epsilon is added to the square
+// root of the second moment by the Adam kinds. With XLA_OPTIMIZER_PACK_TENSORS,
+// operands sharing an element type get flattened and concatenated, so that the
+// update is a single chain of elementwise ops over one buffer per role.
+OptimizerStepResult BuildOptimizerStep(
+    OptimizerStepKind kind, absl::Span<const xla::XlaOp> weights,
+    absl::Span<const xla::XlaOp> grads, absl::Span<const xla::XlaOp> states,
+    absl::Span<const xla::XlaOp> hyperparameters, bool nesterov,
+    bool apply_weight_decay, float epsilon);
+
+}  // namespace swift_xla
@@ -0,0 +1,111 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/persistent_cache.h"
+
+#include <atomic>
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/xla/service/hlo.pb.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/public/version.h"
+
+namespace swift_xla {
+
+PersistentCache* PersistentCache::Get() {
+  static PersistentCache* cache = []() -> PersistentCache* {
+    std::string path =
+        xla::sys_util::GetEnvString("XLA_PERSISTENT_CACHE_PATH", "");
+    if (path.empty()) {
+      return nullptr;
+    }
+    tensorflow::Status status =
+        tensorflow::Env::Default()->RecursivelyCreateDir(path);
+    if (!status.ok()) {
+      TF_LOG(ERROR) << "Unable to create persistent cache folder " << path
+                    << ": " << status;
+      return nullptr;
+    }
+    return new PersistentCache(std::move(path));
+  }();
+  return cache;
+}
+
+PersistentCache::PersistentCache(std::string path) : path_(std::move(path)) {}
+
+xla::hash_t PersistentCache::GetKey(const xla::hash_t& graph_hash,
+                                    const Device& device, bool aliased) const {
+  static const std::string* xla_flags =
+      new std::string(xla::sys_util::GetEnvString("XLA_FLAGS", ""));
+  return xla::util::MHash(graph_hash, xla::util::GetEnumValue(device.hw_type),
+                          std::string(TF_VERSION_STRING), *xla_flags, aliased);
+}
+
+absl::optional<xla::XlaComputation> PersistentCache::Load(
+    const xla::hash_t& key) {
+  std::string entry_path = GetEntryPath(key);
+  std::string data;
+  if (!tensorflow::Env::Default()->FileExists(entry_path).ok() ||
+      !tensorflow::ReadFileToString(tensorflow::Env::Default(), entry_path,
+                                    &data)
+           .ok()) {
+    XLA_COUNTER("PersistentCacheMiss", 1);
+    return absl::nullopt;
+  }
+  xla::HloModuleProto proto;
+  if (!proto.ParseFromString(data)) {
+    TF_LOG(WARNING) << "Corrupted persistent cache entry: " << entry_path;
+    XLA_COUNTER("PersistentCacheMiss", 1);
+    return absl::nullopt;
+  }
+  TF_VLOG(3) << "Loaded persistent cache entry " << entry_path;
+  XLA_COUNTER("PersistentCacheHit", 1);
+  XLA_COUNTER("PersistentCacheBytesLoaded", data.size());
+  return xla::XlaComputation(std::move(proto));
+}
+
+void PersistentCache::Store(const xla::hash_t& key,
+                            const xla::XlaComputation& computation) {
+  static std::atomic<size_t> tmp_count(0);
+  std::string entry_path = GetEntryPath(key);
+  // Write into a temporary file and rename it into place, so that concurrent
+  // readers (possibly other processes sharing the folder) never observe a
+  // partially written entry.
+  std::string tmp_path =
+      absl::StrCat(entry_path, ".tmp.", tensorflow::Env::Default()->NowMicros(),
+                   ".", tmp_count.fetch_add(1));
+  tensorflow::Status status = tensorflow::WriteStringToFile(
+      tensorflow::Env::Default(), tmp_path,
+      computation.proto().SerializeAsString());
+  if (status.ok()) {
+    status = tensorflow::Env::Default()->RenameFile(tmp_path, entry_path);
+  }
+  if (!status.ok()) {
+    TF_LOG(WARNING) << "Unable to store persistent cache entry " << entry_path
+                    << ": " << status;
+    tensorflow::Env::Default()->DeleteFile(tmp_path).IgnoreError();
+    return;
+  }
+  XLA_COUNTER("PersistentCacheStore", 1);
+}
+
+std::string PersistentCache::GetEntryPath(const xla::hash_t& key) const {
+  return absl::StrCat(path_, "/", xla::util::HexHash(key), ".hlo.pb");
+}
+
+}  // namespace swift_xla
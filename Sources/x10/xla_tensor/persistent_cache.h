@@ -0,0 +1,57 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/client/xla_computation.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/compiler/xla/xla_client/types.h"
+
+namespace swift_xla {
+
+// Second tier of the XLATensor computation cache, which survives process
+// restarts. Entries are the lowered HLO modules of the SyncTensorsGraph
+// computations, stored within the folder pointed to by the
+// XLA_PERSISTENT_CACHE_PATH environment variable. A cold process which finds
+// an entry skips the IR lowering, and feeds the stored HLO to the compiler.
+class PersistentCache {
+ public:
+  // Returns the process wide persistent cache, or nullptr if the
+  // XLA_PERSISTENT_CACHE_PATH environment variable is not set.
+  static PersistentCache* Get();
+
+  explicit PersistentCache(std::string path);
+
+  // Builds the on-disk key for a graph hash. Besides the graph hash, the key
+  // includes everything outside of the IR graph which can change the generated
+  // code: the device kind, the TF/XLA version and the XLA flags.
+  xla::hash_t GetKey(const xla::hash_t& graph_hash, const Device& device,
+                     bool aliased) const;
+
+  absl::optional<xla::XlaComputation> Load(const xla::hash_t& key);
+
+  void Store(const xla::hash_t& key, const xla::XlaComputation& computation);
+
+ private:
+  std::string GetEntryPath(const xla::hash_t& key) const;
+
+  std::string path_;
+};
+
+}  // namespace swift_xla
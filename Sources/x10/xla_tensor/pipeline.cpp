@@ -0,0 +1,220 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/pipeline.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/multi_wait.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+
+namespace swift_xla {
+namespace {
+
+enum class Payload { kActivations, kGradients };
+
+std::vector<XLATensor> CopyToDevice(std::vector<XLATensor> tensors,
+                                    const Device& device) {
+  for (XLATensor& tensor : tensors) {
+    if (tensor.GetDevice() != device) {
+      tensor = tensor.CopyTensorToDevice(device);
+      XLA_COUNTER("PipelineTransfers", 1);
+    }
+  }
+  return tensors;
+}
+
+std::vector<XLATensor> Concat(const std::vector<XLATensor>& first,
+                              const std::vector<XLATensor>& second) {
+  std::vector<XLATensor> result(first);
+  result.insert(result.end(), second.begin(), second.end());
+  return result;
+}
+
+}  // namespace
+
+// Holds the tensors in flight between the stages, keyed by payload, receiving
+// stage and micro-batch. A stage failing aborts the mailbox, so that the other
+// stages stop waiting for tensors which will never come.
+class Pipeline::Mailbox {
+ public:
+  using Key = std::tuple<Payload, size_t, size_t>;
+
+  void Put(const Key& key, std::vector<XLATensor> tensors) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slots_[key] = std::move(tensors);
+    cv_.notify_all();
+  }
+
+  // Waits for the tensors of the key. They stay in the mailbox unless take is
+  // set.
+  std::vector<XLATensor> Get(const Key& key, bool take) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return aborted_ || slots_.count(key) > 0; });
+    XLA_CHECK(!aborted_) << "Pipeline aborted by a failing stage";
+    auto it = slots_.find(key);
+    std::vector<XLATensor> tensors = it->second;
+    if (take) {
+      slots_.erase(it);
+    }
+    return tensors;
+  }
+
+  void Abort() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    aborted_ = true;
+    cv_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::map<Key, std::vector<XLATensor>> slots_;
+  bool aborted_ = false;
+};
+
+Pipeline::Pipeline(std::vector<Stage> stages, Schedule schedule)
+    : stages_(std::move(stages)), schedule_(schedule) {
+  XLA_CHECK(!stages_.empty()) << "A pipeline needs at least one stage";
+  training_ = stages_.front().backward != nullptr;
+  for (size_t s = 0; s < stages_.size(); ++s) {
+    const Stage& stage = stages_[s];
+    XLA_CHECK(stage.forward != nullptr)
+        << "Pipeline stage " << s << " has no forward graph";
+    XLA_CHECK_EQ(stage.backward != nullptr, training_)
+        << "Either all the pipeline stages have a backward graph, or none";
+  }
+}
+
+std::vector<Pipeline::Step> Pipeline::ComputeSteps(
+    size_t stage, size_t num_micro_batches) const {
+  std::vector<Step> steps;
+  if (!training_ || schedule_ == Schedule::kGPipe) {
+    for (size_t m = 0; m < num_micro_batches; ++m) {
+      steps.push_back({/*forward=*/true, m});
+    }
+    if (training_) {
+      for (size_t m = num_micro_batches; m > 0; --m) {
+        steps.push_back({/*forward=*/false, m - 1});
+      }
+    }
+    return steps;
+  }
+  // The stages further from the end run more forward passes ahead, to have
+  // the gradients of the next stage come back as soon as they need them.
+  size_t warmup = std::min(stages_.size() - stage - 1, num_micro_batches);
+  for (size_t m = 0; m < warmup; ++m) {
+    steps.push_back({/*forward=*/true, m});
+  }
+  for (size_t m = warmup; m < num_micro_batches; ++m) {
+    steps.push_back({/*forward=*/true, m});
+    steps.push_back({/*forward=*/false, m - warmup});
+  }
+  for (size_t m = num_micro_batches - warmup; m < num_micro_batches; ++m) {
+    steps.push_back({/*forward=*/false, m});
+  }
+  return steps;
+}
+
+void Pipeline::RunStage(size_t stage, const std::vector<XLATensor>& params,
+                        size_t num_micro_batches, Mailbox* mailbox,
+                        Result* result) const {
+  const Stage& current = stages_[stage];
+  bool last = stage + 1 == stages_.size();
+  size_t num_activations = current.forward->num_inputs() - params.size();
+  for (const Step& step : ComputeSteps(stage, num_micro_batches)) {
+    // The activations are kept for the backward pass, which consumes them.
+    std::vector<XLATensor> activations = mailbox->Get(
+        {Payload::kActivations, stage, step.micro_batch},
+        /*take=*/!training_ || !step.forward);
+    if (step.forward) {
+      std::vector<XLATensor> inputs = Concat(params, activations);
+      std::vector<XLATensor> outputs = current.forward->Run(&inputs);
+      XLA_COUNTER("PipelineForwardSteps", 1);
+      if (last) {
+        result->outputs[step.micro_batch] = std::move(outputs);
+      } else {
+        mailbox->Put({Payload::kActivations, stage + 1, step.micro_batch},
+                     CopyToDevice(std::move(outputs),
+                                  stages_[stage + 1].forward->device()));
+      }
+      continue;
+    }
+    std::vector<XLATensor> inputs = Concat(params, activations);
+    if (!last) {
+      std::vector<XLATensor> gradients = mailbox->Get(
+          {Payload::kGradients, stage, step.micro_batch}, /*take=*/true);
+      inputs.insert(inputs.end(), gradients.begin(), gradients.end());
+    }
+    std::vector<XLATensor> outputs = current.backward->Run(&inputs);
+    XLA_COUNTER("PipelineBackwardSteps", 1);
+    XLA_CHECK_GE(outputs.size(), num_activations)
+        << "The backward graph of pipeline stage " << stage
+        << " does not output the gradients of its activations";
+    if (stage > 0) {
+      std::vector<XLATensor> gradients(outputs.begin(),
+                                       outputs.begin() + num_activations);
+      mailbox->Put({Payload::kGradients, stage - 1, step.micro_batch},
+                   CopyToDevice(std::move(gradients),
+                                stages_[stage - 1].backward->device()));
+    }
+    result->stage_results[stage][step.micro_batch].assign(
+        outputs.begin() + num_activations, outputs.end());
+  }
+}
+
+Pipeline::Result Pipeline::Run(
+    const std::vector<std::vector<XLATensor>>& params,
+    const std::vector<std::vector<XLATensor>>& micro_batches) const {
+  XLA_CHECK_EQ(params.size(), stages_.size())
+      << "Wrong number of pipeline stage parameter lists";
+  size_t num_micro_batches = micro_batches.size();
+  Result result;
+  result.outputs.resize(num_micro_batches);
+  if (training_) {
+    result.stage_results.assign(
+        stages_.size(),
+        std::vector<std::vector<XLATensor>>(num_micro_batches));
+  }
+  Mailbox mailbox;
+  for (size_t m = 0; m < num_micro_batches; ++m) {
+    mailbox.Put({Payload::kActivations, 0, m},
+                CopyToDevice(micro_batches[m], stages_[0].forward->device()));
+  }
+  xla::util::MultiWait mwait(stages_.size());
+  for (size_t s = 0; s < stages_.size(); ++s) {
+    auto stage_fn = [&, s]() {
+      try {
+        RunStage(s, params[s], num_micro_batches, &mailbox, &result);
+      } catch (...) {
+        mailbox.Abort();
+        throw;
+      }
+    };
+    xla::env::ScheduleClosure(mwait.Completer(std::move(stage_fn)));
+  }
+  mwait.Wait();
+  XLA_COUNTER("PipelineRuns", 1);
+  return result;
+}
+
+}  // namespace swift_xla
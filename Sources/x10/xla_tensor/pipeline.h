@@ -0,0 +1,97 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/frozen_graph.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+
+namespace swift_xla {
+
+// Runs a model split into stages, each frozen on its own device, over the
+// micro-batches of a batch. Every stage runs on its own thread, in the order
+// the schedule gives it, so that the stages work on different micro-batches at
+// the same time. The activations flow to the next stage, and their gradients
+// back to the previous one, through device to device copies.
+//
+// The forward graph of a stage takes the stage parameters followed by its
+// activations, which are the outputs of the previous stage (the micro-batch
+// inputs for the first stage), and outputs the activations of the next stage.
+// The backward graph takes the stage parameters, the stage activations, and the
+// gradients of the stage outputs, which are the leading outputs of the backward
+// graph of the next stage (none for the last stage). It outputs the gradients
+// of the stage activations, followed by the stage results, like the gradients
+// of the stage parameters.
+class Pipeline {
+ public:
+  enum class Schedule {
+    // All the forward passes, then all the backward passes.
+    kGPipe,
+    // After a warmup, every stage alternates between the forward pass of a
+    // micro-batch and the backward pass of an earlier one, which bounds the
+    // number of micro-batches whose activations a stage holds by the number
+    // of stages.
+    k1F1B,
+  };
+
+  struct Stage {
+    std::shared_ptr<FrozenGraph> forward;
+    // Null for inference pipelines, which then must not have any.
+    std::shared_ptr<FrozenGraph> backward;
+  };
+
+  struct Result {
+    // The outputs of the forward graph of the last stage, per micro-batch.
+    std::vector<std::vector<XLATensor>> outputs;
+    // The results of the backward graph of each stage, per micro-batch.
+    std::vector<std::vector<std::vector<XLATensor>>> stage_results;
+  };
+
+  Pipeline(std::vector<Stage> stages, Schedule schedule);
+
+  // Runs the pipeline with params[s] as the parameters of stage s, over the
+  // micro-batches, which hold the inputs of the first stage.
+  Result Run(const std::vector<std::vector<XLATensor>>& params,
+             const std::vector<std::vector<XLATensor>>& micro_batches) const;
+
+  size_t num_stages() const { return stages_.size(); }
+
+  const Stage& stage(size_t index) const { return stages_[index]; }
+
+ private:
+  struct Step {
+    bool forward = true;
+    size_t micro_batch = 0;
+  };
+
+  class Mailbox;
+
+  // Returns the steps of the stage, in the order the schedule runs them.
+  std::vector<Step> ComputeSteps(size_t stage, size_t num_micro_batches) const;
+
+  void RunStage(size_t stage, const std::vector<XLATensor>& params,
+                size_t num_micro_batches, Mailbox* mailbox,
+                Result* result) const;
+
+  std::vector<Stage> stages_;
+  Schedule schedule_;
+  bool training_ = false;
+};
+
+}  // namespace swift_xla
@@ -20,6 +20,7 @@
 #include "tensorflow/compiler/xla/client/lib/pooling.h"
 #include "tensorflow/compiler/xla/client/lib/slicing.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/data_ops.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
@@ -255,15 +256,64 @@ bool IsOverlapping(const PoolingOpAttributes& pooling_op_attributes) {
   return false;
 }
 
+bool UseVariadicMaxPoolIndices() {
+  static const bool use_variadic =
+      xla::sys_util::GetEnvBool("XLA_MAX_POOL_VARIADIC_INDICES", true);
+  return use_variadic;
+}
+
+// Reduces (value, index) pairs to the pair with the greatest value, and the
+// smallest index among the equal values, so that the first maximum of a window
+// wins, like with the select-and-scatter of the backward pass.
+xla::XlaComputation CreateMaxWithIndexComputation(xla::PrimitiveType type) {
+  xla::XlaBuilder builder("MaxWithIndex");
+  xla::Shape value_shape = xla::ShapeUtil::MakeShape(type, {});
+  xla::Shape index_shape = xla::ShapeUtil::MakeShape(kIndicesType, {});
+  xla::XlaOp lhs_value = xla::Parameter(&builder, 0, value_shape, "lhs_value");
+  xla::XlaOp lhs_index = xla::Parameter(&builder, 1, index_shape, "lhs_index");
+  xla::XlaOp rhs_value = xla::Parameter(&builder, 2, value_shape, "rhs_value");
+  xla::XlaOp rhs_index = xla::Parameter(&builder, 3, index_shape, "rhs_index");
+  xla::XlaOp pick_rhs = xla::Or(
+      xla::Gt(rhs_value, lhs_value),
+      xla::And(xla::Eq(rhs_value, lhs_value), xla::Lt(rhs_index, lhs_index)));
+  xla::Tuple(&builder, {xla::Select(pick_rhs, rhs_value, lhs_value),
+                        xla::Select(pick_rhs, rhs_index, lhs_index)});
+  return ConsumeValue(builder.Build());
+}
+
+// Computes the indices of the maxima with a single variadic reduce-window over
+// the input values and their indices, whether the windows overlap or not. The
+// padding gets the largest index, so it never wins a tie with an input value.
+xla::XlaOp ComputeVariadicMaxPoolIndices(
+    const xla::Shape& input_shape, xla::XlaOp padded_input,
+    const xla::PaddingConfig& padding_config,
+    const PoolingOpAttributes& pooling_op_attributes) {
+  xla::XlaBuilder* builder = padded_input.builder();
+  xla::XlaOp invalid_index = xla::MaxValue(builder, kIndicesType);
+  xla::XlaOp padded_iota = xla::Pad(CreatePoolIndicesIota(input_shape, builder),
+                                    invalid_index, padding_config);
+  xla::XlaOp pool = xla::ReduceWindow(
+      {padded_input, padded_iota},
+      {xla::MinValue(builder, input_shape.element_type()), invalid_index},
+      CreateMaxWithIndexComputation(input_shape.element_type()),
+      pooling_op_attributes.kernel_size, pooling_op_attributes.stride,
+      xla::Padding::kValid);
+  return xla::GetTupleElement(pool, 1);
+}
+
 xla::XlaOp ComputeMaxPoolIndices(
     const xla::Shape& input_shape, xla::XlaOp padded_input,
     xla::XlaOp pool_result, const xla::PaddingConfig& padding_config,
     const PoolingOpAttributes& pooling_op_attributes) {
+  if (UseVariadicMaxPoolIndices()) {
+    return ComputeVariadicMaxPoolIndices(input_shape, padded_input,
+                                         padding_config, pooling_op_attributes);
+  }
   if (!IsOverlapping(pooling_op_attributes)) {
     // The algorithm in ComputeNoOverlapMaxPoolIndices() only works if reduce
     // windows do not overlap. If they do, the reduce-window done on the indices
     // will find multiple indices within the window, and won't know what to
-    // select. If XLA had a vardic reduce-window we could do that.
+    // select. ComputeVariadicMaxPoolIndices() handles those.
     return ComputeNoOverlapMaxPoolIndices(input_shape, padded_input,
                                           pool_result, padding_config,
                                           pooling_op_attributes);
@@ -0,0 +1,93 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/quantization.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/xla_lower_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+
+namespace swift_xla {
+namespace {
+
+// Brings a scalar or per-channel quantization parameter to the given shape.
+xla::XlaOp BroadcastQuantizationParam(xla::XlaOp param,
+                                      const xla::Shape& shape, int64_t axis) {
+  const xla::Shape& param_shape = XlaHelpers::ShapeOfXlaOp(param);
+  if (param_shape.rank() == 0) {
+    return xla::Broadcast(param, shape.dimensions());
+  }
+  XLA_CHECK_EQ(param_shape.rank(), 1)
+      << "The quantization parameters must be scalars or rank 1 tensors: "
+      << param_shape;
+  int64_t dim = XlaHelpers::GetCanonicalDimensionIndex(axis, shape.rank());
+  XLA_CHECK_EQ(param_shape.dimensions(0), shape.dimensions(dim))
+      << "The quantization parameters do not match the size of dimension "
+      << dim << " of " << shape;
+  return xla::BroadcastInDim(param, shape.dimensions(), {dim});
+}
+
+// Rounds the F32 values, shifts them by the zero point, and saturates them
+// into S8.
+xla::XlaOp RoundToInt8(xla::XlaOp values, xla::XlaOp zero_point,
+                       const xla::Shape& shape, int64_t axis) {
+  xla::XlaBuilder* builder = values.builder();
+  xla::XlaOp shifted =
+      xla::Round(values) +
+      xla::ConvertElementType(
+          BroadcastQuantizationParam(zero_point, shape, axis),
+          xla::PrimitiveType::F32);
+  xla::XlaOp clamped =
+      xla::Clamp(xla::ConstantR0<float>(builder, -128.0f), shifted,
+                 xla::ConstantR0<float>(builder, 127.0f));
+  return xla::ConvertElementType(clamped, xla::PrimitiveType::S8);
+}
+
+}  // namespace
+
+xla::XlaOp BuildQuantize(xla::XlaOp input, xla::XlaOp scale,
+                         xla::XlaOp zero_point, int64_t axis) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::XlaOp values = xla::ConvertElementType(input, xla::PrimitiveType::F32) /
+                      BroadcastQuantizationParam(scale, shape, axis);
+  return RoundToInt8(values, zero_point, shape, axis);
+}
+
+xla::XlaOp BuildDequantize(xla::XlaOp input, xla::XlaOp scale,
+                           xla::XlaOp zero_point, int64_t axis) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::XlaOp shifted =
+      xla::ConvertElementType(input, xla::PrimitiveType::F32) -
+      xla::ConvertElementType(
+          BroadcastQuantizationParam(zero_point, shape, axis),
+          xla::PrimitiveType::F32);
+  return shifted * BroadcastQuantizationParam(scale, shape, axis);
+}
+
+xla::XlaOp BuildRequantize(xla::XlaOp input, xla::XlaOp scale,
+                           xla::XlaOp zero_point, int64_t axis) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  xla::XlaOp values = xla::ConvertElementType(input, xla::PrimitiveType::F32) *
+                      BroadcastQuantizationParam(scale, shape, axis);
+  return RoundToInt8(values, zero_point, shape, axis);
+}
+
+xla::XlaOp BuildQuantizedMatMul(xla::XlaOp lhs, xla::XlaOp rhs) {
+  // The S8 operands get widened, which the backends fold into an integer dot
+  // accumulating at S32.
+  return CreateMatMul(xla::ConvertElementType(lhs, xla::PrimitiveType::S32),
+                      xla::ConvertElementType(rhs, xla::PrimitiveType::S32));
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+
+namespace swift_xla {
+
+// The quantization parameters are either scalars, applying to the whole
+// tensor, or rank 1 tensors holding one value per index of the axis dimension.
+// The scales are F32 and the zero points S32.
+
+// Quantizes the floating point input into S8, as round(input / scale) plus the
+// zero point, saturated to the S8 range.
+xla::XlaOp BuildQuantize(xla::XlaOp input, xla::XlaOp scale,
+                         xla::XlaOp zero_point, int64_t axis);
+
+// Maps the integer input back to F32, as (input - zero point) * scale. Takes
+// the S8 quantized values, as well as the S32 accumulators of the quantized
+// matrix multiplications and convolutions, whose scale is the product of the
+// scales of their operands.
+xla::XlaOp BuildDequantize(xla::XlaOp input, xla::XlaOp scale,
+                           xla::XlaOp zero_point, int64_t axis);
+
+// Rescales the S32 accumulators of a quantized matrix multiplication or
+// convolution into the S8 input of the next quantized op, as
+// round(input * scale) plus the zero point, saturated to the S8 range. The
+// scale is the product of the scales of the operands over the output scale.
+xla::XlaOp BuildRequantize(xla::XlaOp input, xla::XlaOp scale,
+                           xla::XlaOp zero_point, int64_t axis);
+
+// Multiplies the S8 matrices with S32 accumulation. The operands are taken as
+// symmetrically quantized, with zero points of zero.
+xla::XlaOp BuildQuantizedMatMul(xla::XlaOp lhs, xla::XlaOp rhs);
+
+}  // namespace swift_xla
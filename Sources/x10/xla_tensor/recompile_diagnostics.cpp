@@ -0,0 +1,191 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/recompile_diagnostics.h"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/swift_backtrace.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace {
+
+// The graphs can have hundreds of thousands of nodes, so only what tells the
+// kind of divergence is kept, and the node text is rendered for the divergent
+// node of the missed graph only.
+struct NodeEntry {
+  // The hash of the node alone, without its operands, so that the nodes
+  // following a divergence still compare equal.
+  xla::hash_t node_hash;
+  ir::OpKind op;
+  ir::InternedShapePtr shape;
+};
+
+struct GraphEntry {
+  xla::hash_t hash;
+  std::vector<NodeEntry> nodes;
+};
+
+struct DiagnosticsState {
+  std::mutex lock;
+  std::deque<GraphEntry> graphs;
+  std::deque<std::string> reports;
+};
+
+DiagnosticsState* GetState() {
+  static DiagnosticsState* state = new DiagnosticsState();
+  return state;
+}
+
+size_t GetHistorySize() {
+  static const size_t history_size =
+      xla::sys_util::GetEnvInt("XLA_RECOMPILE_DIAGNOSTICS_HISTORY", 16);
+  return history_size;
+}
+
+GraphEntry MakeGraphEntry(const xla::hash_t& hash,
+                          absl::Span<const ir::Node* const> post_order) {
+  GraphEntry entry;
+  entry.hash = hash;
+  entry.nodes.reserve(post_order.size());
+  for (const ir::Node* node : post_order) {
+    entry.nodes.push_back(
+        {node->node_hash(), node->op(), node->interned_shape()});
+  }
+  return entry;
+}
+
+size_t CommonPrefix(const GraphEntry& graph1, const GraphEntry& graph2) {
+  size_t size = std::min(graph1.nodes.size(), graph2.nodes.size());
+  size_t i = 0;
+  for (; i < size && graph1.nodes[i].node_hash == graph2.nodes[i].node_hash;
+       ++i) {
+  }
+  return i;
+}
+
+std::string CreateReport(const GraphEntry& graph, const GraphEntry& nearest,
+                         size_t prefix, const ir::Node* divergent_node,
+                         bool with_frames) {
+  std::stringstream ss;
+  ss << "Uncached graph " << xla::util::HexHash(graph.hash) << " ("
+     << graph.nodes.size() << " nodes) diverges from graph "
+     << xla::util::HexHash(nearest.hash) << " (" << nearest.nodes.size()
+     << " nodes) at post-order node " << prefix << ": ";
+  if (prefix == graph.nodes.size() && prefix == nearest.nodes.size()) {
+    // Same nodes, so the parameters got a different order or aliasing.
+    ss << "same nodes, different parameters\n";
+    XLA_COUNTER("RecompileDivergenceParameters", 1);
+  } else if (prefix == graph.nodes.size() || prefix == nearest.nodes.size()) {
+    ss << "the graph has "
+       << (prefix == graph.nodes.size() ? "fewer" : "more") << " nodes\n";
+    XLA_COUNTER("RecompileDivergenceSize", 1);
+  } else {
+    const NodeEntry& node = graph.nodes[prefix];
+    const NodeEntry& old_node = nearest.nodes[prefix];
+    if (node.op != old_node.op) {
+      ss << "different operation\n";
+      XLA_COUNTER("RecompileDivergenceOp", 1);
+    } else if (!xla::ShapeUtil::Equal(node.shape->shape,
+                                      old_node.shape->shape)) {
+      ss << "different shape\n";
+      XLA_COUNTER("RecompileDivergenceShape", 1);
+    } else {
+      // Same operation and shape, so the difference is in a scalar value or an
+      // operation attribute.
+      ss << "different value or attribute\n";
+      XLA_COUNTER("RecompileDivergenceValue", 1);
+    }
+    ss << "  Now:    " << *divergent_node << "\n";
+    ss << "  Before: " << old_node.shape->shape << " " << old_node.op << "\n";
+  }
+  // The frames of the node creation are only captured with
+  // XLA_LOG_GRAPH_CHANGES, otherwise the sync frames are the closest ones,
+  // which are only captured for the logged reports, as it is costly.
+  if (divergent_node != nullptr &&
+      !divergent_node->metadata().frame_info.empty()) {
+    ss << "Node created at:\n" << divergent_node->metadata().frame_info;
+  } else if (with_frames) {
+    ss << "Synced at:\n" << GetSwiftFrames();
+  }
+  return ss.str();
+}
+
+}  // namespace
+
+std::string RecompileDiagnostics::Analyze(
+    const xla::hash_t& hash, absl::Span<const ir::Node* const> post_order) {
+  static const bool log_reports =
+      xla::sys_util::GetEnvBool("XLA_RECOMPILE_DIAGNOSTICS", false);
+  size_t history_size = GetHistorySize();
+  if (history_size == 0) {
+    return std::string();
+  }
+  GraphEntry graph = MakeGraphEntry(hash, post_order);
+  DiagnosticsState* state = GetState();
+  std::lock_guard<std::mutex> lock(state->lock);
+  const GraphEntry* nearest = nullptr;
+  size_t nearest_prefix = 0;
+  // Most recent first, so that ties go to the latest graph.
+  for (auto it = state->graphs.rbegin(); it != state->graphs.rend(); ++it) {
+    size_t prefix = CommonPrefix(graph, *it);
+    if (nearest == nullptr || prefix > nearest_prefix) {
+      nearest = &*it;
+      nearest_prefix = prefix;
+    }
+  }
+  std::string report;
+  if (nearest != nullptr) {
+    report = CreateReport(graph, *nearest, nearest_prefix,
+                          nearest_prefix < post_order.size()
+                              ? post_order[nearest_prefix]
+                              : nullptr,
+                          /*with_frames=*/log_reports);
+    if (log_reports) {
+      TF_LOG(INFO) << report;
+    } else {
+      TF_VLOG(1) << report;
+    }
+    state->reports.push_back(report);
+    if (state->reports.size() > history_size) {
+      state->reports.pop_front();
+    }
+  }
+  state->graphs.push_back(std::move(graph));
+  if (state->graphs.size() > history_size) {
+    state->graphs.pop_front();
+  }
+  return report;
+}
+
+std::string RecompileDiagnostics::GetReport() {
+  DiagnosticsState* state = GetState();
+  std::lock_guard<std::mutex> lock(state->lock);
+  std::stringstream ss;
+  for (auto& report : state->reports) {
+    ss << report << "\n";
+  }
+  return ss.str();
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/xla/xla_client/types.h"
+
+namespace swift_xla {
+
+// Explains the compilation cache misses of the tensors graph syncs, by pointing
+// at the first node where the missed graph diverges from the nearest among the
+// recently compiled graphs, the one sharing the longest post-order prefix.
+class RecompileDiagnostics {
+ public:
+  // Records the post-order of a graph about to be compiled, and returns the
+  // report of its divergence from the nearest recently compiled graph, or an
+  // empty string if there was none. The report is also logged, at INFO level if
+  // XLA_RECOMPILE_DIAGNOSTICS is set, and at VLOG(1) otherwise.
+  static std::string Analyze(const xla::hash_t& hash,
+                             absl::Span<const ir::Node* const> post_order);
+
+  // Returns the most recent reports, oldest first.
+  static std::string GetReport();
+};
+
+}  // namespace swift_xla
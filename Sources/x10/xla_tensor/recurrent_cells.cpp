@@ -0,0 +1,168 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/recurrent_cells.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/xla_lower_util.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+
+namespace swift_xla {
+namespace {
+
+// The index-th of the gates concatenated along the minor dimension.
+xla::XlaOp Gate(xla::XlaOp gates, int64_t index, int64_t hidden_size) {
+  return xla::SliceInDim(gates, index * hidden_size, (index + 1) * hidden_size,
+                         /*stride=*/1, /*dimno=*/1);
+}
+
+// The matmul contracting lhs_dim of lhs with rhs_dim of rhs, which spares the
+// explicit transposes of the backward passes.
+xla::XlaOp ContractDot(xla::XlaOp lhs, int64_t lhs_dim, xla::XlaOp rhs,
+                       int64_t rhs_dim) {
+  xla::DotDimensionNumbers dimension_numbers;
+  dimension_numbers.add_lhs_contracting_dimensions(lhs_dim);
+  dimension_numbers.add_rhs_contracting_dimensions(rhs_dim);
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(XlaHelpers::mat_mul_precision());
+  return xla::DotGeneral(lhs, rhs, dimension_numbers, &precision_config);
+}
+
+xla::XlaOp SumRows(xla::XlaOp input) {
+  xla::PrimitiveType type = XlaHelpers::TypeOfXlaOp(input);
+  return xla::Reduce(input, xla::Zero(input.builder(), type),
+                     XlaHelpers::CreateAddComputation(type), {0});
+}
+
+// The derivatives of the activations, given their outputs.
+xla::XlaOp SigmoidDerivative(xla::XlaOp output, xla::XlaOp one) {
+  return output * (one - output);
+}
+
+xla::XlaOp TanhDerivative(xla::XlaOp output, xla::XlaOp one) {
+  return one - output * output;
+}
+
+xla::XlaOp OneLike(xla::XlaOp input) {
+  return xla::One(input.builder(), XlaHelpers::TypeOfXlaOp(input));
+}
+
+}  // namespace
+
+LstmCellOutput BuildLstmCell(xla::XlaOp input, xla::XlaOp hidden,
+                             xla::XlaOp cell, xla::XlaOp weight,
+                             xla::XlaOp bias) {
+  int64_t hidden_size = XlaHelpers::ShapeOfXlaOp(hidden).dimensions(1);
+  xla::XlaOp gate_input = xla::ConcatInDim(input.builder(), {input, hidden}, 1);
+  xla::XlaOp fused = xla::Add(BuildDot(gate_input, weight), bias, {1});
+  xla::XlaOp input_gate = xla::Logistic(Gate(fused, 0, hidden_size));
+  xla::XlaOp update_gate = xla::Tanh(Gate(fused, 1, hidden_size));
+  xla::XlaOp forget_gate = xla::Logistic(Gate(fused, 2, hidden_size));
+  xla::XlaOp output_gate = xla::Logistic(Gate(fused, 3, hidden_size));
+  xla::XlaOp new_cell = cell * forget_gate + input_gate * update_gate;
+  xla::XlaOp new_hidden = xla::Tanh(new_cell) * output_gate;
+  xla::XlaOp gates = xla::ConcatInDim(
+      input.builder(), {input_gate, update_gate, forget_gate, output_gate}, 1);
+  return {new_cell, new_hidden, gates};
+}
+
+LstmCellGrads BuildLstmCellBackward(xla::XlaOp grad_cell,
+                                    xla::XlaOp grad_hidden, xla::XlaOp input,
+                                    xla::XlaOp hidden, xla::XlaOp cell,
+                                    xla::XlaOp weight, xla::XlaOp gates,
+                                    xla::XlaOp new_cell) {
+  int64_t input_size = XlaHelpers::ShapeOfXlaOp(input).dimensions(1);
+  int64_t hidden_size = XlaHelpers::ShapeOfXlaOp(hidden).dimensions(1);
+  xla::XlaOp one = OneLike(input);
+  xla::XlaOp input_gate = Gate(gates, 0, hidden_size);
+  xla::XlaOp update_gate = Gate(gates, 1, hidden_size);
+  xla::XlaOp forget_gate = Gate(gates, 2, hidden_size);
+  xla::XlaOp output_gate = Gate(gates, 3, hidden_size);
+  xla::XlaOp new_cell_tanh = xla::Tanh(new_cell);
+  // The new cell state feeds both the next cell state and the new hidden one.
+  xla::XlaOp grad_new_cell =
+      grad_cell +
+      grad_hidden * output_gate * TanhDerivative(new_cell_tanh, one);
+  xla::XlaOp grad_fused = xla::ConcatInDim(
+      input.builder(),
+      {grad_new_cell * update_gate * SigmoidDerivative(input_gate, one),
+       grad_new_cell * input_gate * TanhDerivative(update_gate, one),
+       grad_new_cell * cell * SigmoidDerivative(forget_gate, one),
+       grad_hidden * new_cell_tanh * SigmoidDerivative(output_gate, one)},
+      1);
+  xla::XlaOp gate_input = xla::ConcatInDim(input.builder(), {input, hidden}, 1);
+  xla::XlaOp grad_gate_input = ContractDot(grad_fused, 1, weight, 1);
+  return {xla::SliceInDim(grad_gate_input, 0, input_size, 1, 1),
+          xla::SliceInDim(grad_gate_input, input_size, input_size + hidden_size,
+                          1, 1),
+          grad_new_cell * forget_gate,
+          ContractDot(gate_input, 0, grad_fused, 0),
+          SumRows(grad_fused)};
+}
+
+GruCellOutput BuildGruCell(xla::XlaOp input, xla::XlaOp hidden,
+                           xla::XlaOp kernel, xla::XlaOp recurrent_kernel,
+                           xla::XlaOp bias, xla::XlaOp recurrent_bias) {
+  int64_t hidden_size = XlaHelpers::ShapeOfXlaOp(hidden).dimensions(1);
+  xla::XlaOp projection = xla::Add(BuildDot(input, kernel), bias, {1});
+  xla::XlaOp recurrent_projection =
+      xla::Add(BuildDot(hidden, recurrent_kernel), recurrent_bias, {1});
+  xla::XlaOp update_gate =
+      xla::Logistic(Gate(projection, 0, hidden_size) +
+                    Gate(recurrent_projection, 0, hidden_size));
+  xla::XlaOp reset_gate =
+      xla::Logistic(Gate(projection, 1, hidden_size) +
+                    Gate(recurrent_projection, 1, hidden_size));
+  xla::XlaOp recurrent_output = Gate(recurrent_projection, 2, hidden_size);
+  xla::XlaOp output_gate = xla::Tanh(Gate(projection, 2, hidden_size) +
+                                     reset_gate * recurrent_output);
+  xla::XlaOp new_hidden =
+      update_gate * hidden + (OneLike(input) - update_gate) * output_gate;
+  xla::XlaOp gates = xla::ConcatInDim(
+      input.builder(), {update_gate, reset_gate, output_gate}, 1);
+  return {new_hidden, gates, recurrent_output};
+}
+
+GruCellGrads BuildGruCellBackward(xla::XlaOp grad_hidden, xla::XlaOp input,
+                                  xla::XlaOp hidden, xla::XlaOp kernel,
+                                  xla::XlaOp recurrent_kernel,
+                                  xla::XlaOp gates,
+                                  xla::XlaOp recurrent_output) {
+  int64_t hidden_size = XlaHelpers::ShapeOfXlaOp(hidden).dimensions(1);
+  xla::XlaOp one = OneLike(input);
+  xla::XlaOp update_gate = Gate(gates, 0, hidden_size);
+  xla::XlaOp reset_gate = Gate(gates, 1, hidden_size);
+  xla::XlaOp output_gate = Gate(gates, 2, hidden_size);
+  xla::XlaOp grad_update = grad_hidden * (hidden - output_gate) *
+                           SigmoidDerivative(update_gate, one);
+  xla::XlaOp grad_output = grad_hidden * (one - update_gate) *
+                           TanhDerivative(output_gate, one);
+  xla::XlaOp grad_reset =
+      grad_output * recurrent_output * SigmoidDerivative(reset_gate, one);
+  // Both projections share the update and reset gradients, while the reset
+  // gate scales the recurrent side of the output one.
+  xla::XlaOp grad_projection = xla::ConcatInDim(
+      input.builder(), {grad_update, grad_reset, grad_output}, 1);
+  xla::XlaOp grad_recurrent_projection = xla::ConcatInDim(
+      input.builder(), {grad_update, grad_reset, grad_output * reset_gate}, 1);
+  return {ContractDot(grad_projection, 1, kernel, 1),
+          grad_hidden * update_gate +
+              ContractDot(grad_recurrent_projection, 1, recurrent_kernel, 1),
+          ContractDot(input, 0, grad_projection, 0),
+          ContractDot(hidden, 0, grad_recurrent_projection, 0),
+          SumRows(grad_projection),
+          SumRows(grad_recurrent_projection)};
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "tensorflow/compiler/xla/client/xla_builder.h"
+
+namespace swift_xla {
+
+// The LSTM and GRU cells of Layers/Recurrent.swift, with the gate weights of
+// each side concatenated so that the gate projections are a single matmul.
+// The inputs are [batch, input_size] and the states [batch, hidden_size]. The
+// activated gates are saved for the backward pass.
+
+struct LstmCellOutput {
+  xla::XlaOp cell;
+  xla::XlaOp hidden;
+  // The input, update, forget and output gates, [batch, 4 * hidden_size].
+  xla::XlaOp gates;
+};
+
+struct LstmCellGrads {
+  xla::XlaOp grad_input;
+  xla::XlaOp grad_hidden;
+  xla::XlaOp grad_cell;
+  xla::XlaOp grad_weight;
+  xla::XlaOp grad_bias;
+};
+
+struct GruCellOutput {
+  xla::XlaOp hidden;
+  // The update, reset and output gates, [batch, 3 * hidden_size].
+  xla::XlaOp gates;
+  // The recurrent projection of the output gate, before the reset gate
+  // applies, [batch, hidden_size].
+  xla::XlaOp recurrent_output;
+};
+
+struct GruCellGrads {
+  xla::XlaOp grad_input;
+  xla::XlaOp grad_hidden;
+  xla::XlaOp grad_kernel;
+  xla::XlaOp grad_recurrent_kernel;
+  xla::XlaOp grad_bias;
+  xla::XlaOp grad_recurrent_bias;
+};
+
+// The weight is [input_size + hidden_size, 4 * hidden_size], and projects the
+// concatenation of the input and the hidden state.
+LstmCellOutput BuildLstmCell(xla::XlaOp input, xla::XlaOp hidden,
+                             xla::XlaOp cell, xla::XlaOp weight,
+                             xla::XlaOp bias);
+
+LstmCellGrads BuildLstmCellBackward(xla::XlaOp grad_cell,
+                                    xla::XlaOp grad_hidden, xla::XlaOp input,
+                                    xla::XlaOp hidden, xla::XlaOp cell,
+                                    xla::XlaOp weight, xla::XlaOp gates,
+                                    xla::XlaOp new_cell);
+
+// The kernel is [input_size, 3 * hidden_size] and the recurrent kernel
+// [hidden_size, 3 * hidden_size], since the reset gate only applies to the
+// recurrent side of the output gate.
+GruCellOutput BuildGruCell(xla::XlaOp input, xla::XlaOp hidden,
+                           xla::XlaOp kernel, xla::XlaOp recurrent_kernel,
+                           xla::XlaOp bias, xla::XlaOp recurrent_bias);
+
+GruCellGrads BuildGruCellBackward(xla::XlaOp grad_hidden, xla::XlaOp input,
+                                  xla::XlaOp hidden, xla::XlaOp kernel,
+                                  xla::XlaOp recurrent_kernel,
+                                  xla::XlaOp gates,
+                                  xla::XlaOp recurrent_output);
+
+}  // namespace swift_xla
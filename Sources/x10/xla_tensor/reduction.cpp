@@ -15,8 +15,10 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/reduction.h"
 
 #include <cmath>
+#include <limits>
 
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
 #include "tensorflow/compiler/xla/client/lib/arithmetic.h"
@@ -136,6 +138,94 @@ xla::XlaOp CreateProduct(xla::XlaOp input,
   return result;
 }
 
+// Axis length from which the cumulative computations lower to a tree scan
+// rather than to a whole-axis reduce window.
+int64_t GetTreeScanMinLength() {
+  static const int64_t min_length =
+      xla::sys_util::GetEnvInt("XLA_TREE_SCAN_MIN_LENGTH", 128);
+  return min_length;
+}
+
+// Applies "reducer" element-wise to the same shaped "lhs" and "rhs", by
+// reducing them stacked along a new minor dimension.
+xla::XlaOp CombineElementWise(xla::XlaOp lhs, xla::XlaOp rhs,
+                              const xla::XlaComputation& reducer,
+                              xla::XlaOp init) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(lhs);
+  std::vector<int64_t> stacked_dims(shape.dimensions().begin(),
+                                    shape.dimensions().end());
+  stacked_dims.push_back(1);
+  xla::XlaOp stacked = xla::ConcatInDim(
+      lhs.builder(),
+      {xla::Reshape(lhs, stacked_dims), xla::Reshape(rhs, stacked_dims)},
+      shape.rank());
+  return xla::Reduce(stacked, init, reducer, {shape.rank()});
+}
+
+// Interleaves "evens" and "odds", which have the same shape, along "dim".
+xla::XlaOp Interleave(xla::XlaOp evens, xla::XlaOp odds, int64_t dim) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(evens);
+  std::vector<int64_t> split_dims(shape.dimensions().begin(),
+                                  shape.dimensions().end());
+  split_dims.insert(split_dims.begin() + dim + 1, 1);
+  xla::XlaOp pairs = xla::ConcatInDim(
+      evens.builder(),
+      {xla::Reshape(evens, split_dims), xla::Reshape(odds, split_dims)},
+      dim + 1);
+  std::vector<int64_t> result_dims(shape.dimensions().begin(),
+                                   shape.dimensions().end());
+  result_dims[dim] *= 2;
+  return xla::Reshape(pairs, result_dims);
+}
+
+// Builds the inclusive scan of "input" along "dim" by recursive pairing: the
+// pairs of adjacent elements get reduced into an axis of half the length,
+// whose scan yields the odd positions, from which the even positions follow
+// with one more combine. This takes O(n) work and O(log(n)) steps, against
+// the O(n^2) work of a whole-axis reduce window.
+xla::XlaOp BuildTreeScan(xla::XlaOp input, int64_t dim,
+                         const xla::XlaComputation& reducer, xla::XlaOp init) {
+  const xla::Shape& shape = XlaHelpers::ShapeOfXlaOp(input);
+  int64_t length = shape.dimensions(dim);
+  if (length < 2) {
+    return input;
+  }
+  std::vector<int64_t> window_dims(shape.rank(), 1);
+  window_dims[dim] = 2;
+  std::vector<int64_t> window_strides(shape.rank(), 1);
+  window_strides[dim] = 2;
+  xla::XlaOp pairs =
+      xla::ReduceWindow(input, init, reducer, window_dims, window_strides,
+                        xla::Padding::kValid);
+  xla::XlaOp odds = BuildTreeScan(pairs, dim, reducer, init);
+  // The even position 2i > 0 is the scan at 2i - 1 combined with input[2i].
+  int64_t num_evens = (length + 1) / 2;
+  int64_t num_odds = length / 2;
+  xla::XlaOp evens = xla::SliceInDim(input, 0, 1, 1, dim);
+  if (num_evens > 1) {
+    xla::XlaOp tail = CombineElementWise(
+        xla::SliceInDim(odds, 0, num_evens - 1, 1, dim),
+        xla::SliceInDim(input, 2, length, 2, dim), reducer, init);
+    evens = xla::ConcatInDim(input.builder(), {evens, tail}, dim);
+  }
+  xla::XlaOp result =
+      Interleave(xla::SliceInDim(evens, 0, num_odds, 1, dim), odds, dim);
+  if (num_evens > num_odds) {
+    result = xla::ConcatInDim(
+        input.builder(),
+        {result, xla::SliceInDim(evens, num_odds, num_evens, 1, dim)}, dim);
+  }
+  return result;
+}
+
+// The argmax and argmin indices are computed in int32 when the reduced
+// dimension allows it, as int64 is emulated on TPU, like the topk indices.
+xla::PrimitiveType ArgIndexType(const xla::Shape& shape, int64_t dim) {
+  return shape.dimensions(dim) <= std::numeric_limits<int32_t>::max()
+             ? xla::PrimitiveType::S32
+             : xla::PrimitiveType::S64;
+}
+
 }  // namespace
 
 xla::XlaOp BuildBinaryCrossEntropy(xla::XlaOp input, xla::XlaOp target,
@@ -270,19 +360,34 @@ xla::XlaOp BuildCumulativeComputation(xla::XlaOp input, int64_t dim,
                                       xla::XlaOp init, bool exclusive,
                                       bool reverse) {
   const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  int64_t length = input_shape.dimensions(dim);
+  if (length >= GetTreeScanMinLength()) {
+    xla::XlaOp scan_input = reverse ? xla::Rev(input, {dim}) : input;
+    xla::XlaOp result = BuildTreeScan(scan_input, dim, reducer, init);
+    if (exclusive) {
+      std::vector<int64_t> init_dims(input_shape.dimensions().begin(),
+                                     input_shape.dimensions().end());
+      init_dims[dim] = 1;
+      result = xla::ConcatInDim(
+          input.builder(),
+          {xla::BroadcastInDim(init, init_dims, {}),
+           xla::SliceInDim(result, 0, length - 1, 1, dim)},
+          dim);
+    }
+    return reverse ? xla::Rev(result, {dim}) : result;
+  }
   std::vector<int64_t> window_strides(input_shape.rank(), 1);
   std::vector<int64_t> window_dims(input_shape.rank(), 1);
-  window_dims[dim] = input_shape.dimensions(dim);
+  window_dims[dim] = length;
   std::vector<std::pair<int64_t, int64_t>> padding(input_shape.rank());
-  padding[dim].first = input_shape.dimensions(dim) - (exclusive ? 0 : 1);
+  padding[dim].first = length - (exclusive ? 0 : 1);
   if (reverse) std::swap(padding[dim].first, padding[dim].second);
   xla::XlaOp result = xla::ReduceWindowWithGeneralPadding(
       input, init, reducer, window_dims, window_strides,
       /*base_dilations=*/{}, /*window_dilations=*/{}, padding);
   if (exclusive) {
     int64_t offset = reverse ? 1 : 0;
-    result = xla::SliceInDim(result, offset,
-                             input_shape.dimensions(dim) + offset, 1, dim);
+    result = xla::SliceInDim(result, offset, length + offset, 1, dim);
   }
   return result;
 }
@@ -392,9 +497,10 @@ xla::XlaOp BuildArgMax(xla::XlaOp input, int64_t dim, bool keepdim) {
                                          {xla::ShapeUtil::ElementsIn(*shape)});
     shape = &XlaHelpers::ShapeOfXlaOp(operand);
   }
-  xla::XlaOp result = xla::ArgMax(
-      operand,
-      GetDevicePrimitiveType(xla::PrimitiveType::S64, /*device=*/nullptr), dim);
+  xla::XlaOp result = xla::ArgMax(operand, ArgIndexType(*shape, dim), dim);
+  result = xla::ConvertElementType(
+      result,
+      GetDevicePrimitiveType(xla::PrimitiveType::S64, /*device=*/nullptr));
   if (keepdim) {
     auto dimensions = xla::util::ToVector<int64_t>(shape->dimensions());
     dimensions[dim] = 1;
@@ -412,9 +518,10 @@ xla::XlaOp BuildArgMin(xla::XlaOp input, int64_t dim, bool keepdim) {
                                          {xla::ShapeUtil::ElementsIn(*shape)});
     shape = &XlaHelpers::ShapeOfXlaOp(operand);
   }
-  xla::XlaOp result = xla::ArgMin(
-      operand,
-      GetDevicePrimitiveType(xla::PrimitiveType::S64, /*device=*/nullptr), dim);
+  xla::XlaOp result = xla::ArgMin(operand, ArgIndexType(*shape, dim), dim);
+  result = xla::ConvertElementType(
+      result,
+      GetDevicePrimitiveType(xla::PrimitiveType::S64, /*device=*/nullptr));
   if (keepdim) {
     auto dimensions = xla::util::ToVector<int64_t>(shape->dimensions());
     dimensions[dim] = 1;
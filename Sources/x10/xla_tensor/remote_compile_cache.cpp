@@ -0,0 +1,74 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/persistent_cache.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/remote_compile_cache.h"
+
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/xla/service/hlo.pb.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/core/public/version.h"
+
+namespace swift_xla {
+
+RemoteCompileCache* RemoteCompileCache::Get() {
+  static RemoteCompileCache* cache = []() -> RemoteCompileCache* {
+    xla::service::CompileCacheClient* client =
+        xla::service::CompileCacheClient::Get();
+    return client != nullptr ? new RemoteCompileCache(client) : nullptr;
+  }();
+  return cache;
+}
+
+RemoteCompileCache::RemoteCompileCache(
+    xla::service::CompileCacheClient* client)
+    : client_(client) {}
+
+std::string RemoteCompileCache::GetKey(const xla::hash_t& ir_hash,
+                                       const Device& device, bool aliased) {
+  static const std::string* xla_flags =
+      new std::string(xla::sys_util::GetEnvString("XLA_FLAGS", ""));
+  return absl::StrCat(
+      "hlo:", TF_VERSION_STRING, ":",
+      xla::util::HexHash(xla::util::MHash(
+          ir_hash, xla::util::GetEnumValue(device.hw_type), *xla_flags,
+          aliased)));
+}
+
+absl::optional<xla::XlaComputation> RemoteCompileCache::Load(
+    const std::string& key) {
+  absl::optional<std::string> data = client_->Lookup(key);
+  if (!data) {
+    return absl::nullopt;
+  }
+  xla::HloModuleProto proto;
+  if (!proto.ParseFromString(*data)) {
+    TF_LOG(WARNING) << "Corrupted compile cache service entry: " << key;
+    return absl::nullopt;
+  }
+  TF_VLOG(3) << "Loaded compile cache service entry " << key;
+  XLA_COUNTER("CompileCacheServiceBytesLoaded", data->size());
+  return xla::XlaComputation(std::move(proto));
+}
+
+void RemoteCompileCache::Store(const std::string& key,
+                               const xla::XlaComputation& computation) {
+  client_->Store(key, computation.proto().SerializeAsString());
+}
+
+}  // namespace swift_xla
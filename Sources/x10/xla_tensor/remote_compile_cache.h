@@ -0,0 +1,56 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "absl/types/optional.h"
+#include "tensorflow/compiler/xla/client/xla_computation.h"
+#include "tensorflow/compiler/xla/xla_client/compile_cache_service.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+#include "tensorflow/compiler/xla/xla_client/types.h"
+
+namespace swift_xla {
+
+// Third tier of the XLATensor computation cache, after the in-memory and the
+// persistent ones: the compile cache service at XLA_COMPILE_CACHE_SERVICE,
+// shared by all the processes pointing at it. Entries are the lowered HLO
+// modules of the SyncTensorsGraph computations. The lookups time out and
+// fall back to the local lowering, so an unreachable service only costs the
+// lookup timeout.
+class RemoteCompileCache {
+ public:
+  // Returns the process wide remote cache, or nullptr if the
+  // XLA_COMPILE_CACHE_SERVICE environment variable is not set.
+  static RemoteCompileCache* Get();
+
+  explicit RemoteCompileCache(xla::service::CompileCacheClient* client);
+
+  // Builds the key of a graph from its host independent IR hash, the device
+  // kind, the TF/XLA version and the XLA flags.
+  static std::string GetKey(const xla::hash_t& ir_hash, const Device& device,
+                            bool aliased);
+
+  absl::optional<xla::XlaComputation> Load(const std::string& key);
+
+  void Store(const std::string& key, const xla::XlaComputation& computation);
+
+ private:
+  xla::service::CompileCacheClient* client_;
+};
+
+}  // namespace swift_xla
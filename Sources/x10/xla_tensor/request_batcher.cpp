@@ -0,0 +1,224 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/request_batcher.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+
+namespace swift_xla {
+namespace {
+
+// The 16 bits floating point types share their host representation with
+// Short, so the host tensors built here would lose their logical type.
+void CheckBatchableType(at::ScalarType type) {
+  XLA_CHECK(type != at::ScalarType::BFloat16 && type != at::ScalarType::Half)
+      << "Request batching does not support 16 bits floating point tensors";
+}
+
+at::Tensor MakeZeroTensor(at::ScalarType type, std::vector<int64_t> shape,
+                          char** data) {
+  size_t len = at::GetLenFromShape(shape);
+  switch (type) {
+#define DEFINE_ZERO_CASE(name, aten_name, DType)            \
+  case at::ScalarType::aten_name: {                         \
+    std::unique_ptr<DType[]> buffer(new DType[len]());      \
+    *data = reinterpret_cast<char*>(buffer.get());          \
+    return at::Tensor(std::move(buffer), std::move(shape)); \
+  }
+    LIST_SCALAR_TYPES(DEFINE_ZERO_CASE)
+#undef DEFINE_ZERO_CASE
+  }
+  XLA_ERROR() << "Unsupported scalar type: " << static_cast<int>(type);
+}
+
+size_t RowBytes(const at::Tensor& tensor) {
+  XLA_CHECK_GT(tensor.rank(), 0) << "Batched tensors need a batch dimension";
+  int64_t rows = tensor.shape().front();
+  return rows > 0 ? tensor.buffer().raw_size() / rows : 0;
+}
+
+// Stacks the parts along their leading dimension, zero padded to rows.
+at::Tensor ConcatRows(const std::vector<at::Tensor>& parts, int64_t rows) {
+  const at::Tensor& first = parts.front();
+  CheckBatchableType(first.scalar_type());
+  XLA_CHECK_GT(first.rank(), 0) << "Batched tensors need a batch dimension";
+  std::vector<int64_t> shape = first.shape();
+  shape.front() = rows;
+  char* data = nullptr;
+  at::Tensor result = MakeZeroTensor(first.scalar_type(), shape, &data);
+  for (const at::Tensor& part : parts) {
+    XLA_CHECK(part.scalar_type() == first.scalar_type())
+        << "Batched requests have inputs of different types";
+    XLA_CHECK(part.rank() == first.rank() &&
+              std::equal(part.shape().begin() + 1, part.shape().end(),
+                         first.shape().begin() + 1))
+        << "Batched requests have inputs of different shapes";
+    size_t size = part.buffer().raw_size();
+    std::memcpy(data, part.buffer().raw_data(), size);
+    data += size;
+  }
+  return result;
+}
+
+at::Tensor SliceRows(const at::Tensor& tensor, int64_t start, int64_t rows) {
+  size_t row_bytes = RowBytes(tensor);
+  std::vector<int64_t> shape = tensor.shape();
+  shape.front() = rows;
+  char* data = nullptr;
+  at::Tensor result = MakeZeroTensor(tensor.scalar_type(), shape, &data);
+  std::memcpy(data,
+              static_cast<const char*>(tensor.buffer().raw_data()) +
+                  start * row_bytes,
+              rows * row_bytes);
+  return result;
+}
+
+}  // namespace
+
+RequestBatcher::RequestBatcher(
+    std::map<int64_t, std::shared_ptr<FrozenGraph>> graphs,
+    std::chrono::microseconds max_latency)
+    : graphs_(std::move(graphs)), max_latency_(max_latency) {
+  XLA_CHECK(!graphs_.empty()) << "A request batcher needs one batch size";
+  XLA_CHECK_GT(graphs_.begin()->first, 0);
+  max_batch_size_ = graphs_.rbegin()->first;
+  const Device& device = graphs_.begin()->second->device();
+  for (auto& size_graph : graphs_) {
+    XLA_CHECK_EQ(size_graph.second->device(), device)
+        << "The batched graphs live on different devices";
+  }
+}
+
+std::vector<XLATensor> RequestBatcher::Run(
+    const std::vector<XLATensor>& inputs) {
+  XLA_CHECK(!inputs.empty()) << "Batched requests need at least one input";
+  for (const XLATensor& input : inputs) {
+    c10::optional<at::ScalarType> dtype = input.dtype();
+    if (dtype) {
+      CheckBatchableType(*dtype);
+    }
+  }
+  auto request = std::make_shared<Request>();
+  // The inputs created from host data are handed back without a transfer.
+  std::vector<XLATensor> tensors(inputs);
+  request->inputs = XLATensor::GetTensors(&tensors);
+  XLA_CHECK_GT(request->inputs.front().rank(), 0)
+      << "Batched tensors need a batch dimension";
+  request->rows = request->inputs.front().shape().front();
+  for (const at::Tensor& input : request->inputs) {
+    XLA_CHECK(input.rank() > 0 && input.shape().front() == request->rows)
+        << "The inputs of a batched request have different batch sizes";
+  }
+  XLA_CHECK_LE(request->rows, max_batch_size_)
+      << "The request is larger than the largest batch size";
+  request->arrival = std::chrono::steady_clock::now();
+
+  std::unique_lock<std::mutex> lock(lock_);
+  queue_.push_back(request);
+  queued_rows_ += request->rows;
+  cv_.notify_all();
+  while (!request->done) {
+    if (leader_waiting_ || queue_.empty()) {
+      cv_.wait(lock);
+      continue;
+    }
+    // Only the leader takes requests from the queue, so its front stays put
+    // while waiting.
+    leader_waiting_ = true;
+    cv_.wait_until(lock, queue_.front()->arrival + max_latency_,
+                   [this]() { return queued_rows_ >= max_batch_size_; });
+    std::vector<RequestPtr> batch = TakeBatch();
+    leader_waiting_ = false;
+    cv_.notify_all();
+    lock.unlock();
+    RunBatch(batch);
+    lock.lock();
+    for (const RequestPtr& batched : batch) {
+      batched->done = true;
+    }
+    cv_.notify_all();
+  }
+  return std::move(request->outputs);
+}
+
+std::vector<RequestBatcher::RequestPtr> RequestBatcher::TakeBatch() {
+  std::vector<RequestPtr> batch;
+  int64_t rows = 0;
+  while (!queue_.empty() && rows + queue_.front()->rows <= max_batch_size_) {
+    rows += queue_.front()->rows;
+    batch.push_back(std::move(queue_.front()));
+    queue_.pop_front();
+  }
+  queued_rows_ -= rows;
+  return batch;
+}
+
+void RequestBatcher::RunBatch(const std::vector<RequestPtr>& batch) {
+  int64_t rows = 0;
+  for (const RequestPtr& request : batch) {
+    rows += request->rows;
+  }
+  // The smallest bucket which fits the batch.
+  auto bucket = graphs_.lower_bound(rows);
+  XLA_CHECK(bucket != graphs_.end()) << "No batch size fits " << rows;
+  int64_t bucket_size = bucket->first;
+  const std::shared_ptr<FrozenGraph>& graph = bucket->second;
+  const Device& device = graph->device();
+  size_t num_inputs = batch.front()->inputs.size();
+  XLA_CHECK_EQ(num_inputs, graph->num_inputs())
+      << "Wrong number of batched request inputs";
+  std::vector<XLATensor> inputs;
+  inputs.reserve(num_inputs);
+  for (size_t i = 0; i < num_inputs; ++i) {
+    std::vector<at::Tensor> parts;
+    parts.reserve(batch.size());
+    for (const RequestPtr& request : batch) {
+      XLA_CHECK_EQ(request->inputs.size(), num_inputs)
+          << "Batched requests have different numbers of inputs";
+      parts.push_back(request->inputs[i]);
+    }
+    inputs.push_back(XLATensor::Create(ConcatRows(parts, bucket_size), device));
+  }
+  XLA_COUNTER("BatchedRequests", batch.size());
+  XLA_VALUE_METRIC("RequestBatchRows", rows);
+  XLA_VALUE_METRIC("RequestBatchPaddingRows", bucket_size - rows);
+
+  std::vector<XLATensor> outputs = graph->Run(&inputs);
+  for (const XLATensor& output : outputs) {
+    c10::optional<at::ScalarType> dtype = output.dtype();
+    if (dtype) {
+      CheckBatchableType(*dtype);
+    }
+  }
+  std::vector<at::Tensor> host_outputs = XLATensor::GetTensors(&outputs);
+  for (const at::Tensor& output : host_outputs) {
+    XLA_CHECK(output.rank() > 0 && output.shape().front() == bucket_size)
+        << "Batched graph outputs must have the batch as leading dimension";
+  }
+  int64_t start = 0;
+  for (const RequestPtr& request : batch) {
+    request->outputs.reserve(host_outputs.size());
+    for (const at::Tensor& output : host_outputs) {
+      request->outputs.push_back(XLATensor::Create(
+          SliceRows(output, start, request->rows), device));
+    }
+    start += request->rows;
+  }
+}
+
+}  // namespace swift_xla
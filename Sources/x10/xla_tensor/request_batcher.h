@@ -0,0 +1,78 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/frozen_graph.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+
+namespace swift_xla {
+
+// Collects the requests concurrently made to a served model into batches, to
+// run them with one execution instead of one per request. The model is frozen
+// once per bucketed batch size; the inputs of a request have a leading batch
+// dimension, and get concatenated with the ones of the other requests in the
+// batch, then zero padded up to the smallest bucket which fits them all. The
+// outputs of the execution get split back along their leading dimension.
+//
+// The first request to come in waits for the others up to the max latency, or
+// until the largest bucket is full, and then runs the batch on behalf of all
+// of them.
+class RequestBatcher {
+ public:
+  RequestBatcher(std::map<int64_t, std::shared_ptr<FrozenGraph>> graphs,
+                 std::chrono::microseconds max_latency);
+
+  // Runs one request, possibly batched with others, and returns its outputs.
+  std::vector<XLATensor> Run(const std::vector<XLATensor>& inputs);
+
+ private:
+  struct Request {
+    std::vector<at::Tensor> inputs;
+    int64_t rows = 0;
+    std::chrono::steady_clock::time_point arrival;
+    std::vector<XLATensor> outputs;
+    bool done = false;
+  };
+
+  using RequestPtr = std::shared_ptr<Request>;
+
+  // Takes from the front of the queue the requests which fit in the largest
+  // bucket. Called with the lock held.
+  std::vector<RequestPtr> TakeBatch();
+
+  void RunBatch(const std::vector<RequestPtr>& batch);
+
+  std::map<int64_t, std::shared_ptr<FrozenGraph>> graphs_;
+  int64_t max_batch_size_ = 0;
+  std::chrono::microseconds max_latency_;
+  std::mutex lock_;
+  std::condition_variable cv_;
+  std::deque<RequestPtr> queue_;
+  int64_t queued_rows_ = 0;
+  bool leader_waiting_ = false;
+};
+
+}  // namespace swift_xla
@@ -19,6 +19,7 @@
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/lowering_autotuner.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/shape_builder.h"
 #include "tensorflow/compiler/xla/client/lib/constants.h"
 #include "tensorflow/compiler/xla/shape_util.h"
@@ -38,6 +39,31 @@ double ResizeFactor(const xla::Shape& input_shape,
          static_cast<double>(output_shape.dimensions(dim));
 }
 
+xla::XlaOp LowerBackward2dCustomCalls(const std::string& target,
+                                      xla::XlaOp input,
+                                      const xla::Shape& output_shape,
+                                      const std::string& backend_config,
+                                      bool split) {
+  const xla::Shape& input_shape = XlaHelpers::ShapeOfXlaOp(input);
+  // XLA wants NHWC while S4TF comes in as NCHW, so we need to transpose, call
+  // the kernel, and transpose back.
+  std::vector<int64_t> transpose_permute({0, 3, 2, 1});
+  auto inv_transpose_permute = xla::InversePermutation(transpose_permute);
+  xla::Shape resized_shape =
+      xla::ShapeUtil::PermuteDimensions(inv_transpose_permute, output_shape);
+  xla::XlaOp tinput = xla::Transpose(input, transpose_permute);
+  if (split) {
+    xla::Shape partial_shape = resized_shape;
+    // Partial shape is in NHWC, while input shape is in NCHW.
+    partial_shape.mutable_dimensions()[1] = input_shape.dimensions(2);
+    tinput = xla::CustomCall(input.builder(), target, {tinput}, partial_shape,
+                             backend_config);
+  }
+  xla::XlaOp resised = xla::CustomCall(input.builder(), target, {tinput},
+                                       resized_shape, backend_config);
+  return xla::Transpose(resised, inv_transpose_permute);
+}
+
 }  // namespace
 
 xla::Shape GetForwardOutputShape2d(const xla::Shape& input_shape,
@@ -90,27 +116,30 @@ xla::XlaOp LowerBackward2d(const std::string& target, xla::XlaOp input,
       input_shape.dimensions(3) == output_shape.dimensions(3)) {
     return input;
   }
-  // XLA wants NHWC while S4TF comes in as NCHW, so we need to transpose, call
-  // the kernel, and transpose back.
-  std::vector<int64_t> transpose_permute({0, 3, 2, 1});
-  auto inv_transpose_permute = xla::InversePermutation(transpose_permute);
-  xla::Shape resized_shape =
-      xla::ShapeUtil::PermuteDimensions(inv_transpose_permute, output_shape);
-  xla::XlaOp tinput = xla::Transpose(input, transpose_permute);
   std::string backend_config =
       GetBackendConfig(align_corners, half_pixel_centers);
-  if (ResizeFactor(input_shape, output_shape, 2) > resiple_split_factor &&
-      ResizeFactor(input_shape, output_shape, 3) > resiple_split_factor) {
-    // If the resize is too large, do one dimension at a time.
-    xla::Shape partial_shape = resized_shape;
-    // Partial shape is in NHWC, while input shape is in NCHW.
-    partial_shape.mutable_dimensions()[1] = input_shape.dimensions(2);
-    tinput = xla::CustomCall(input.builder(), target, {tinput}, partial_shape,
-                             backend_config);
+  if (IsLoweringAutotuneEnabled()) {
+    auto make_resize = [&](bool split) -> LoweringFn {
+      return [&, split](absl::Span<const xla::XlaOp> operands) {
+        return LowerBackward2dCustomCalls(target, operands[0], output_shape,
+                                          backend_config, split);
+      };
+    };
+    bool split =
+        ChooseFastestLowering(
+            absl::StrCat(target, backend_config,
+                         xla::ShapeUtil::HumanString(output_shape)),
+            {input_shape},
+            {make_resize(/*split=*/false), make_resize(/*split=*/true)}) == 1;
+    return LowerBackward2dCustomCalls(target, input, output_shape,
+                                      backend_config, split);
   }
-  xla::XlaOp resised = xla::CustomCall(input.builder(), target, {tinput},
-                                       resized_shape, backend_config);
-  return xla::Transpose(resised, inv_transpose_permute);
+  // If the resize is too large, do one dimension at a time.
+  bool split =
+      ResizeFactor(input_shape, output_shape, 2) > resiple_split_factor &&
+      ResizeFactor(input_shape, output_shape, 3) > resiple_split_factor;
+  return LowerBackward2dCustomCalls(target, input, output_shape,
+                                    backend_config, split);
 }
 
 }  // namespace resize
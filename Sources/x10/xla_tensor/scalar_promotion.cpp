@@ -0,0 +1,164 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/scalar_promotion.h"
+
+#include <mutex>
+#include <unordered_map>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/constant.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/scalar.h"
+#include "tensorflow/compiler/xla/primitive_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/cache.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace {
+
+struct StructureEntry {
+  // The value hashes of the promotable nodes, in post-order.
+  std::vector<xla::hash_t> value_hashes;
+  // Whether the value of the promotable node ever changed. Once promoted, a
+  // node stays promoted, so that the graphs keep hitting the same computation.
+  std::vector<bool> changed;
+};
+
+using StructureCache =
+    xla::util::Cache<xla::hash_t, StructureEntry, xla::util::HashReducer>;
+
+struct PromotionState {
+  std::mutex lock;
+  StructureCache structures{GetCacheSize()};
+
+  static size_t GetCacheSize() {
+    static const size_t cache_size =
+        xla::sys_util::GetEnvInt("XLA_PROMOTE_CHANGING_SCALARS_CACHE", 256);
+    return cache_size;
+  }
+};
+
+PromotionState* GetState() {
+  static PromotionState* state = new PromotionState();
+  return state;
+}
+
+bool IsPromotableType(xla::PrimitiveType type) {
+  return xla::primitive_util::IsIntegralType(type) ||
+         xla::primitive_util::IsFloatingPointType(type);
+}
+
+// Hashes the graph with the values of the promotable nodes left out. The
+// operands are hashed by post-order position, which the post-order of graphs
+// of the same structure shares.
+xla::hash_t ComputeStructureHash(absl::Span<const ir::Node* const> post_order,
+                                 std::vector<xla::hash_t>* value_hashes) {
+  std::unordered_map<const ir::Node*, size_t> positions;
+  positions.reserve(post_order.size());
+  xla::hash_t hash = xla::util::MHash(post_order.size());
+  for (size_t i = 0; i < post_order.size(); ++i) {
+    const ir::Node* node = post_order[i];
+    positions.emplace(node, i);
+    xla::hash_t node_hash = node->node_hash();
+    if (ScalarPromotion::IsPromotable(node)) {
+      value_hashes->push_back(node_hash);
+      node_hash = xla::util::MHash(
+          node->op().hash(), node->shape().ToString(),
+          dynamic_cast<const ir::ops::Scalar*>(node) != nullptr);
+    }
+    hash = xla::util::HashCombine(hash, node_hash);
+    for (auto& output : node->operands()) {
+      auto it = positions.find(output.node);
+      XLA_CHECK(it != positions.end()) << "Bad post-order: " << *node;
+      hash = xla::util::HashCombine(
+          hash, xla::util::MHash(it->second, output.index));
+    }
+  }
+  return hash;
+}
+
+}  // namespace
+
+bool ScalarPromotion::IsPromotable(const ir::Node* node) {
+  if (node->op() != ir::OpKind(at::prim::Constant) ||
+      !IsPromotableType(node->shape().element_type())) {
+    return false;
+  }
+  if (dynamic_cast<const ir::ops::Scalar*>(node) != nullptr) {
+    return true;
+  }
+  const ir::ops::Constant* constant =
+      dynamic_cast<const ir::ops::Constant*>(node);
+  return constant != nullptr && node->shape().rank() == 0;
+}
+
+std::vector<size_t> ScalarPromotion::Analyze(
+    absl::Span<const ir::Node* const> post_order) {
+  static const bool promote_scalars =
+      xla::sys_util::GetEnvBool("XLA_PROMOTE_CHANGING_SCALARS", true);
+  if (!promote_scalars) {
+    return {};
+  }
+  std::vector<xla::hash_t> value_hashes;
+  xla::hash_t hash = ComputeStructureHash(post_order, &value_hashes);
+  if (value_hashes.empty()) {
+    return {};
+  }
+  PromotionState* state = GetState();
+  std::lock_guard<std::mutex> lock(state->lock);
+  StructureCache::TypePtr entry = state->structures.Get(hash);
+  if (entry != nullptr && entry->value_hashes.size() != value_hashes.size()) {
+    // A different graph colliding on the structure hash, which replaces the
+    // entry.
+    XLA_COUNTER("ScalarPromotionCollisions", 1);
+    state->structures.Erase(hash);
+    entry = nullptr;
+  }
+  if (entry == nullptr) {
+    entry = std::make_shared<StructureEntry>();
+    entry->value_hashes = std::move(value_hashes);
+    entry->changed.resize(entry->value_hashes.size(), false);
+    state->structures.Add(hash, entry);
+    return {};
+  }
+  for (size_t i = 0; i < value_hashes.size(); ++i) {
+    if (entry->value_hashes[i] != value_hashes[i]) {
+      entry->changed[i] = true;
+      entry->value_hashes[i] = value_hashes[i];
+    }
+  }
+  std::vector<size_t> promoted;
+  size_t scalar_index = 0;
+  for (size_t i = 0; i < post_order.size(); ++i) {
+    if (IsPromotable(post_order[i])) {
+      if (entry->changed[scalar_index]) {
+        promoted.push_back(i);
+      }
+      ++scalar_index;
+    }
+  }
+  if (!promoted.empty()) {
+    TF_VLOG(3) << "Promoting " << promoted.size()
+               << " changing scalars of graph structure "
+               << xla::util::HexHash(hash);
+  }
+  return promoted;
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+
+namespace swift_xla {
+
+// Stops the recompilations of graphs which only differ in the values of their
+// scalar constants, like a learning rate following a schedule. The graphs are
+// grouped by their structure, which is their hash with the values of the
+// scalar constants left out, and a scalar constant whose value changed within
+// its group is promoted to a device data parameter, so that the following
+// graphs of the group share the same computation whatever its value.
+class ScalarPromotion {
+ public:
+  // Records the values of the scalar constants of the graph, and returns the
+  // post-order positions of the ones to be promoted, which are those whose
+  // value changed across the graphs of the same structure. Returns none if
+  // XLA_PROMOTE_CHANGING_SCALARS is disabled.
+  static std::vector<size_t> Analyze(
+      absl::Span<const ir::Node* const> post_order);
+
+  // Whether the node is a scalar constant which can be promoted to a device
+  // data parameter.
+  static bool IsPromotable(const ir::Node* node);
+};
+
+}  // namespace swift_xla
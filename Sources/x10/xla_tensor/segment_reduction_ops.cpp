@@ -14,20 +14,47 @@
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/segment_reduction_ops.h"
 
+#include <limits>
+#include <numeric>
+
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/lib/scatter.h"
+#include "tensorflow/compiler/xla/client/lib/arithmetic.h"
+#include "tensorflow/compiler/xla/client/lib/constants.h"
+#include "tensorflow/compiler/xla/client/lib/slicing.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
 
 namespace swift_xla {
+namespace {
+
+using CombineFn = std::function<xla::XlaOp(xla::XlaOp, xla::XlaOp)>;
 
-xla::XlaOp UnsortedSegmentReduce(
-    xla::XlaOp data, xla::XlaOp indices, xla::XlaOp init_value,
-    int64_t num_segments,
-    const std::function<xla::XlaOp(xla::XlaOp, xla::XlaOp)>& combine) {
+// Segments count up to which the floating point sums are lowered as a matmul
+// with the one-hot encoding of the segment ids.
+int64_t GetOneHotMaxSegments() {
+  static const int64_t max_segments =
+      xla::sys_util::GetEnvInt("XLA_SEGMENT_ONE_HOT_MAX_SEGMENTS", 64);
+  return max_segments;
+}
+
+// Number of segment ids from which a runtime check for sorted ids picks the
+// scan based lowering over the scatter.
+int64_t GetSortedMinIds() {
+  static const int64_t min_ids =
+      xla::sys_util::GetEnvInt("XLA_SEGMENT_SORTED_MIN_IDS", 1024);
+  return min_ids;
+}
+
+xla::XlaOp ScatterSegmentReduce(xla::XlaOp data, xla::XlaOp indices,
+                                xla::XlaOp init_value, int64_t num_segments,
+                                const CombineFn& combine) {
   const xla::Shape& data_shape = XlaHelpers::ShapeOfXlaOp(data);
   const xla::Shape& indices_shape = XlaHelpers::ShapeOfXlaOp(indices);
   const auto data_size = data_shape.dimensions();
   std::vector<int64_t> buffer_size(data_size.begin() + indices_shape.rank(),
-                                      data_size.end());
+                                   data_size.end());
   buffer_size.insert(buffer_size.begin(), num_segments);
   xla::XlaOp buffer = xla::Broadcast(init_value, buffer_size);
   auto combiner = [&combine](xla::XlaOp a, xla::XlaOp b,
@@ -39,4 +66,210 @@ xla::XlaOp UnsortedSegmentReduce(
                                              combiner, data.builder()));
 }
 
+// Sums the rows of the [N, ...] data into [num_segments, ...] by multiplying
+// them with the [num_segments, N] one-hot encoding of the ids. Out of range
+// ids match no segment, and get dropped like with the scatter.
+xla::XlaOp OneHotSegmentSum(xla::XlaOp data, xla::XlaOp ids,
+                            int64_t num_segments) {
+  const xla::Shape& data_shape = XlaHelpers::ShapeOfXlaOp(data);
+  const xla::Shape& ids_shape = XlaHelpers::ShapeOfXlaOp(ids);
+  int64_t num_ids = ids_shape.dimensions(0);
+  std::vector<int64_t> output_sizes(data_shape.dimensions().begin(),
+                                    data_shape.dimensions().end());
+  output_sizes[0] = num_segments;
+  int64_t row_size = xla::ShapeUtil::ElementsIn(data_shape) / num_ids;
+  xla::XlaOp segments = xla::Iota(
+      ids.builder(),
+      xla::ShapeUtil::MakeShape(ids_shape.element_type(),
+                                {num_segments, num_ids}),
+      0);
+  xla::XlaOp one_hot = xla::ConvertElementType(
+      xla::Eq(segments, ids, /*broadcast_dimensions=*/{1}),
+      data_shape.element_type());
+  xla::PrecisionConfig precision_config =
+      XlaHelpers::BuildPrecisionConfig(xla::PrecisionConfig::HIGHEST);
+  xla::XlaOp sums = xla::Dot(one_hot, xla::Reshape(data, {num_ids, row_size}),
+                             &precision_config);
+  return xla::Reshape(sums, output_sizes);
+}
+
+// Reduces the rows of the [N, ...] data whose [N] ids are sorted. An inclusive
+// scan segmented by the ids leaves the reduction of each segment in its last
+// row, which gets gathered at the segment end found by a binary search.
+xla::XlaOp SortedSegmentReduceRows(xla::XlaOp data, xla::XlaOp ids,
+                                   xla::XlaOp init_value, int64_t num_segments,
+                                   const CombineFn& combine) {
+  xla::XlaBuilder* builder = data.builder();
+  const xla::Shape& data_shape = XlaHelpers::ShapeOfXlaOp(data);
+  const xla::Shape& ids_shape = XlaHelpers::ShapeOfXlaOp(ids);
+  int64_t num_ids = ids_shape.dimensions(0);
+  XLA_CHECK_LE(num_ids, std::numeric_limits<int32_t>::max());
+  auto broadcast_rows = [&](xla::XlaOp op, const xla::Shape& shape) {
+    return xla::BroadcastInDim(op, shape.dimensions(), {0});
+  };
+
+  xla::XlaOp positions = xla::Iota(
+      builder, xla::ShapeUtil::MakeShape(xla::S32, {num_ids}), 0);
+  xla::XlaOp scan = data;
+  for (int64_t step = 1; step < num_ids; step *= 2) {
+    std::vector<int64_t> pad_sizes(data_shape.dimensions().begin(),
+                                   data_shape.dimensions().end());
+    pad_sizes[0] = step;
+    xla::XlaOp shifted_scan = xla::ConcatInDim(
+        builder,
+        {xla::Broadcast(init_value, pad_sizes),
+         xla::SliceInDim(scan, 0, num_ids - step, 1, 0)},
+        0);
+    xla::XlaOp shifted_ids = xla::ConcatInDim(
+        builder,
+        {xla::Broadcast(xla::Zero(builder, ids_shape.element_type()), {step}),
+         xla::SliceInDim(ids, 0, num_ids - step, 1, 0)},
+        0);
+    // With sorted ids, equal ids step rows apart means that all the rows in
+    // between belong to the same segment.
+    xla::XlaOp same_segment =
+        xla::And(xla::Eq(ids, shifted_ids),
+                 xla::Ge(positions, xla::ConstantR0<int32_t>(
+                                        builder, static_cast<int32_t>(step))));
+    scan = combine(
+        scan, xla::Select(broadcast_rows(same_segment, data_shape),
+                          shifted_scan, xla::Broadcast(init_value, pad_sizes)));
+  }
+
+  // ends[s + 1] is the number of ids not greater than s, for s in
+  // [-1, num_segments), so that the segment s spans [ends[s], ends[s + 1]).
+  xla::XlaOp segments = xla::Iota(
+      builder,
+      xla::ShapeUtil::MakeShape(ids_shape.element_type(), {num_segments + 1}),
+      0);
+  segments = xla::Sub(segments, xla::One(builder, ids_shape.element_type()));
+  xla::XlaOp num_ids_value =
+      xla::ConstantR0<int32_t>(builder, static_cast<int32_t>(num_ids));
+  xla::XlaOp ends = xla::Broadcast(xla::Zero(builder, xla::S32),
+                                   {num_segments + 1});
+  int64_t step = 1;
+  while (step * 2 <= num_ids) {
+    step *= 2;
+  }
+  for (; step > 0; step /= 2) {
+    xla::XlaOp candidates =
+        xla::Add(ends, xla::ConstantR0<int32_t>(builder,
+                                                static_cast<int32_t>(step)));
+    xla::XlaOp probe_indices = xla::Sub(
+        xla::Min(candidates, num_ids_value), xla::One(builder, xla::S32));
+    xla::XlaOp probes = xla::TorchIndexSelect(ids, probe_indices, 0);
+    xla::XlaOp take = xla::And(xla::Le(candidates, num_ids_value),
+                               xla::Le(probes, segments));
+    ends = xla::Select(take, candidates, ends);
+  }
+  xla::XlaOp starts = xla::SliceInDim(ends, 0, num_segments, 1, 0);
+  ends = xla::SliceInDim(ends, 1, num_segments + 1, 1, 0);
+
+  xla::XlaOp last_rows = xla::TorchIndexSelect(
+      scan, xla::Max(xla::Sub(ends, xla::One(builder, xla::S32)),
+                     xla::Zero(builder, xla::S32)),
+      0);
+  const xla::Shape& output_shape = XlaHelpers::ShapeOfXlaOp(last_rows);
+  return xla::Select(broadcast_rows(xla::Gt(ends, starts), output_shape),
+                     last_rows,
+                     xla::Broadcast(init_value, output_shape.dimensions()));
+}
+
+// Runs the scan based lowering when the ids turn out to be sorted at runtime,
+// and the scatter otherwise.
+xla::XlaOp MaybeSortedSegmentReduce(xla::XlaOp data, xla::XlaOp ids,
+                                    xla::XlaOp init_value,
+                                    int64_t num_segments,
+                                    const CombineFn& combine) {
+  xla::XlaBuilder* builder = data.builder();
+  int64_t num_ids = XlaHelpers::ShapeOfXlaOp(ids).dimensions(0);
+  xla::XlaOp sorted = xla::ReduceAll(
+      xla::Le(xla::SliceInDim(ids, 0, num_ids - 1, 1, 0),
+              xla::SliceInDim(ids, 1, num_ids, 1, 0)),
+      xla::ConstantR0<bool>(builder, true),
+      xla::CreateScalarAndComputation(xla::PRED, builder));
+  XLA_COUNTER("SortedSegmentReduceCandidates", 1);
+
+  xla::XlaOp operands = xla::Tuple(builder, {data, ids, init_value});
+  const xla::Shape& operands_shape = XlaHelpers::ShapeOfXlaOp(operands);
+  auto build_branch = [&](const std::string& name, bool sorted_branch) {
+    std::unique_ptr<xla::XlaBuilder> branch_builder =
+        builder->CreateSubBuilder(name);
+    xla::XlaOp branch_operands =
+        xla::Parameter(branch_builder.get(), 0, operands_shape, "operands");
+    xla::XlaOp branch_data = xla::GetTupleElement(branch_operands, 0);
+    xla::XlaOp branch_ids = xla::GetTupleElement(branch_operands, 1);
+    xla::XlaOp branch_init = xla::GetTupleElement(branch_operands, 2);
+    xla::XlaOp result =
+        sorted_branch
+            ? SortedSegmentReduceRows(branch_data, branch_ids, branch_init,
+                                      num_segments, combine)
+            : ScatterSegmentReduce(branch_data, branch_ids, branch_init,
+                                   num_segments, combine);
+    return ConsumeValue(branch_builder->Build(result));
+  };
+  xla::XlaComputation sorted_computation =
+      build_branch("SortedSegmentReduce", /*sorted_branch=*/true);
+  xla::XlaComputation unsorted_computation =
+      build_branch("UnsortedSegmentReduce", /*sorted_branch=*/false);
+  return xla::Conditional(sorted, operands, sorted_computation, operands,
+                          unsorted_computation);
+}
+
+}  // namespace
+
+xla::XlaOp UnsortedSegmentReduce(xla::XlaOp data, xla::XlaOp indices,
+                                 xla::XlaOp init_value, int64_t num_segments,
+                                 const CombineFn& combine) {
+  const xla::Shape& data_shape = XlaHelpers::ShapeOfXlaOp(data);
+  const xla::Shape& indices_shape = XlaHelpers::ShapeOfXlaOp(indices);
+  int64_t num_ids = xla::ShapeUtil::ElementsIn(indices_shape);
+  if (indices_shape.rank() == 0 || num_ids == 0 ||
+      num_ids < GetSortedMinIds()) {
+    return ScatterSegmentReduce(data, indices, init_value, num_segments,
+                                combine);
+  }
+  // Both the lowerings below work on the rows of the flattened ids.
+  std::vector<int64_t> rows_sizes(
+      data_shape.dimensions().begin() + indices_shape.rank() - 1,
+      data_shape.dimensions().end());
+  rows_sizes[0] = num_ids;
+  xla::XlaOp rows = xla::Reshape(data, rows_sizes);
+  xla::XlaOp ids = xla::Reshape(indices, {num_ids});
+  return MaybeSortedSegmentReduce(rows, ids, init_value, num_segments,
+                                  combine);
+}
+
+xla::XlaOp UnsortedSegmentSum(xla::XlaOp data, xla::XlaOp indices,
+                              int64_t num_segments) {
+  const xla::Shape& data_shape = XlaHelpers::ShapeOfXlaOp(data);
+  const xla::Shape& indices_shape = XlaHelpers::ShapeOfXlaOp(indices);
+  xla::XlaOp init_value = xla::Zero(data.builder(), data_shape.element_type());
+  auto combine = [](xla::XlaOp a, xla::XlaOp b) { return a + b; };
+  int64_t num_ids = xla::ShapeUtil::ElementsIn(indices_shape);
+  if (indices_shape.rank() > 0 && num_ids > 0 &&
+      num_segments <= GetOneHotMaxSegments() &&
+      xla::primitive_util::IsFloatingPointType(data_shape.element_type())) {
+    XLA_COUNTER("OneHotSegmentSum", 1);
+    std::vector<int64_t> rows_sizes(
+        data_shape.dimensions().begin() + indices_shape.rank() - 1,
+        data_shape.dimensions().end());
+    rows_sizes[0] = num_ids;
+    return OneHotSegmentSum(xla::Reshape(data, rows_sizes),
+                            xla::Reshape(indices, {num_ids}), num_segments);
+  }
+  return UnsortedSegmentReduce(data, indices, init_value, num_segments,
+                               combine);
+}
+
+xla::XlaOp SegmentSumInto(xla::XlaOp buffer, xla::XlaOp data,
+                          xla::XlaOp indices) {
+  auto combiner = [](xla::XlaOp a, xla::XlaOp b, xla::XlaBuilder* builder) {
+    return a + b;
+  };
+  return ConsumeValue(tensorflow::XlaScatter(buffer, /*updates=*/data, indices,
+                                             /*indices_are_vectors=*/false,
+                                             combiner, data.builder()));
+}
+
 }  // namespace swift_xla
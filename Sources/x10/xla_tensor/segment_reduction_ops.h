@@ -21,11 +21,26 @@
 
 namespace swift_xla {
 
+// Reduces the data slices with the same ids, with init_value being the
+// identity of combine. Large enough id sets get checked for being sorted at
+// runtime, in which case the reduction runs as a segmented scan plus gather
+// instead of a scatter, which is slow on TPU and serializes on hot segments.
 xla::XlaOp UnsortedSegmentReduce(
     xla::XlaOp data, xla::XlaOp indices, xla::XlaOp init_value,
     int64_t num_segments,
     const std::function<xla::XlaOp(xla::XlaOp, xla::XlaOp)>& combine);
 
+// Sums the data slices with the same ids. Floating point sums over a few
+// segments are lowered as a matmul with the one-hot encoding of the ids.
+xla::XlaOp UnsortedSegmentSum(xla::XlaOp data, xla::XlaOp indices,
+                              int64_t num_segments);
+
+// Adds the data slices into the rows of buffer selected by the ids, in place of
+// materializing the dense sum of the slices and adding it to the buffer.
+// Out of range ids get dropped.
+xla::XlaOp SegmentSumInto(xla::XlaOp buffer, xla::XlaOp data,
+                          xla::XlaOp indices);
+
 }  // namespace swift_xla
 
 #endif  // X10_XLA_TENSOR_SEGMENT_REDUCTION_OPS_H_
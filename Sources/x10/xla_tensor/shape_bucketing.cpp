@@ -0,0 +1,89 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/shape_bucketing.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+
+namespace swift_xla {
+namespace {
+
+std::vector<int64_t> ParseBuckets() {
+  std::vector<int64_t> buckets;
+  std::string buckets_env =
+      xla::sys_util::GetEnvString("XLA_SHAPE_BUCKETS", "");
+  if (!buckets_env.empty()) {
+    std::vector<std::string> parts = absl::StrSplit(buckets_env, ',');
+    for (const auto& bucket_str : parts) {
+      int64_t bucket = std::stol(bucket_str);
+      XLA_CHECK_GT(bucket, 0) << buckets_env;
+      buckets.push_back(bucket);
+    }
+    std::sort(buckets.begin(), buckets.end());
+  }
+  return buckets;
+}
+
+const std::vector<int64_t>& GetBuckets() {
+  static const std::vector<int64_t>* buckets =
+      new std::vector<int64_t>(ParseBuckets());
+  return *buckets;
+}
+
+void AccountBucketHit(int64_t bucket) {
+  static std::mutex* lock = new std::mutex();
+  static auto* counters = new std::map<int64_t, xla::metrics::Counter*>();
+  xla::metrics::Counter* counter = nullptr;
+  {
+    std::lock_guard<std::mutex> guard(*lock);
+    auto it = counters->find(bucket);
+    if (it == counters->end()) {
+      it = counters
+               ->emplace(bucket, new xla::metrics::Counter(
+                                     absl::StrCat("ShapeBucket_", bucket)))
+               .first;
+    }
+    counter = it->second;
+  }
+  counter->AddValue(1);
+}
+
+}  // namespace
+
+int64_t GetShapeBucket(int64_t size) {
+  const std::vector<int64_t>& buckets = GetBuckets();
+  auto it = std::lower_bound(buckets.begin(), buckets.end(), size);
+  int64_t bucket = 1;
+  if (it != buckets.end()) {
+    bucket = *it;
+  } else {
+    while (bucket < size) {
+      bucket <<= 1;
+    }
+  }
+  AccountBucketHit(bucket);
+  return bucket;
+}
+
+}  // namespace swift_xla
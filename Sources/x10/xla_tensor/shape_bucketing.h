@@ -0,0 +1,32 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace swift_xla {
+
+// Returns the bucket size a dimension of the given size should be padded to,
+// so that inputs of different sizes within a bucket lower to the same graph
+// (and hence share the same compiled computation). The buckets are read from
+// the XLA_SHAPE_BUCKETS environment variable, as a comma separated list of
+// sizes. If the variable is not set, or the size is bigger than the largest
+// configured bucket, sizes are rounded up to the next power of two.
+// Every call accounts a hit for the returned bucket in the metrics.
+int64_t GetShapeBucket(int64_t size);
+
+}  // namespace swift_xla
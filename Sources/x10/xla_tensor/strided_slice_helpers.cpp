@@ -19,6 +19,9 @@
 #include "tensorflow/compiler/tf2xla/shape_util.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/compiler/xla/xla_client/cache.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
 #include "tensorflow/core/util/strided_slice_op.h"
 
 namespace swift_xla {
@@ -38,9 +41,21 @@ tensorflow::Tensor MakeRank1Tensor(absl::Span<const int64_t> values) {
   return t;
 }
 
-}  // namespace
+// Indexing heavy models slice the same shapes the same way every step, so the
+// specs are cached by the hash of the input sizes and slice arguments.
+using StridedSliceSpecCache =
+    xla::util::Cache<xla::hash_t, const StridedSliceSpec,
+                     xla::util::HashReducer>;
 
-StridedSliceSpec ComputeIndexingBoundsAndStrides(
+StridedSliceSpecCache* GetStridedSliceSpecCache() {
+  static const size_t kMaxCacheSize =
+      xla::sys_util::GetEnvInt("XLA_STRIDED_SLICE_CACHE_SIZE", 4096);
+  static StridedSliceSpecCache* cache =
+      new StridedSliceSpecCache(kMaxCacheSize, "StridedSliceSpecCache");
+  return cache;
+}
+
+StridedSliceSpec ValidateStridedSlice(
     absl::Span<const int64_t> input_sizes,
     absl::Span<const int64_t> begin, absl::Span<const int64_t> end,
     absl::Span<const int64_t> strides, int32_t begin_mask,
@@ -71,4 +86,29 @@ StridedSliceSpec ComputeIndexingBoundsAndStrides(
           final_shape.dim_sizes()};
 }
 
+}  // namespace
+
+StridedSliceSpec ComputeIndexingBoundsAndStrides(
+    absl::Span<const int64_t> input_sizes,
+    absl::Span<const int64_t> begin, absl::Span<const int64_t> end,
+    absl::Span<const int64_t> strides, int32_t begin_mask,
+    int32_t end_mask, int32_t ellipsis_mask, int32_t new_axis_mask,
+    int32_t shrink_axis_mask) {
+  // The sizes of the spans are hashed too, so that arguments of different
+  // ranks can't run into each other.
+  xla::hash_t key = xla::util::MHash(
+      input_sizes.size(), input_sizes, begin.size(), begin, end.size(), end,
+      strides.size(), strides, begin_mask, end_mask, ellipsis_mask,
+      new_axis_mask, shrink_axis_mask);
+  StridedSliceSpecCache* cache = GetStridedSliceSpecCache();
+  std::shared_ptr<const StridedSliceSpec> spec = cache->Get(key);
+  if (spec == nullptr) {
+    spec = cache->Add(
+        key, std::make_shared<const StridedSliceSpec>(ValidateStridedSlice(
+                 input_sizes, begin, end, strides, begin_mask, end_mask,
+                 ellipsis_mask, new_axis_mask, shrink_axis_mask)));
+  }
+  return *spec;
+}
+
 }  // namespace swift_xla
@@ -18,6 +18,8 @@
 #include <unistd.h>
 
 #include <climits>
+#include <mutex>
+#include <unordered_map>
 
 #include "absl/base/call_once.h"
 #include "absl/debugging/stacktrace.h"
@@ -39,28 +41,68 @@ void InitializeSymbolizer() {
   absl::InitializeSymbolizer(self);
 }
 
+// The same return addresses show up in most of the captured stacks, so their
+// names are only looked up once.
+class SymbolCache {
+ public:
+  std::string Get(void* address) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = names_.find(address);
+    if (it != names_.end()) {
+      return it->second;
+    }
+    absl::call_once(g_symbolizer_init_once, InitializeSymbolizer);
+    char func_name[1024];
+    std::string name =
+        absl::Symbolize(address, func_name, sizeof(func_name))
+            ? std::string(func_name)
+            : std::string("(unknown)");
+    names_.emplace(address, name);
+    return name;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::unordered_map<void*, std::string> names_;
+};
+
+SymbolCache* GetSymbolCache() {
+  static SymbolCache* cache = new SymbolCache();
+  return cache;
+}
+
 }  // namespace
 
-std::vector<SourceLocation> GetSwiftFrames() {
-  absl::call_once(g_symbolizer_init_once, InitializeSymbolizer);
+SwiftFrames SwiftFrames::Capture() {
+  const int max_depth = 256;
+  void* addresses[max_depth];
+  int depth = absl::GetStackTrace(addresses, max_depth, 1);
+  SwiftFrames frames;
+  frames.addresses_.assign(addresses, addresses + depth);
+  return frames;
+}
+
+std::vector<SourceLocation> SwiftFrames::Symbolize() const {
+  SymbolCache* cache = GetSymbolCache();
   std::vector<SourceLocation> frames;
-  int max_depth = 256;
-  std::vector<void*> func_addr(max_depth);
-  char func_name[1024];
-  int depth = absl::GetStackTrace(func_addr.data(), max_depth, 0);
-  for (int i = 0; i < depth; ++i) {
-    bool success = absl::Symbolize(func_addr[i], func_name, sizeof(func_name));
+  for (void* address : addresses_) {
     SourceLocation location;
-    if (success) {
-      location.function = func_name;
-    } else {
-      location.function = "(unknown)";
-    }
+    location.function = cache->Get(address);
     frames.push_back(location);
   }
   return frames;
 }
+
+std::vector<SourceLocation> GetSwiftFrames() {
+  return SwiftFrames::Capture().Symbolize();
+}
 #else
+SwiftFrames SwiftFrames::Capture() { return SwiftFrames(); }
+
+std::vector<SourceLocation> SwiftFrames::Symbolize() const {
+  return GetSwiftFrames();
+}
+
 std::vector<SourceLocation> GetSwiftFrames() {
   std::vector<SourceLocation> frames;
   SourceLocation location;
@@ -79,4 +121,8 @@ std::ostream& operator<<(std::ostream& stream,
   return stream;
 }
 
+std::ostream& operator<<(std::ostream& stream, const SwiftFrames& frames) {
+  return stream << frames.Symbolize();
+}
+
 }  // namespace swift_xla
@@ -26,9 +26,26 @@ struct SourceLocation {
   std::string function;
 };
 
+// The return addresses of a captured stack. Capturing them is cheap, they only
+// get symbolized when the frames get printed.
+class SwiftFrames {
+ public:
+  // Captures the stack of the calling thread.
+  static SwiftFrames Capture();
+
+  bool empty() const { return addresses_.empty(); }
+
+  std::vector<SourceLocation> Symbolize() const;
+
+ private:
+  std::vector<void*> addresses_;
+};
+
 std::vector<SourceLocation> GetSwiftFrames();
 
 std::ostream& operator<<(std::ostream& stream,
                          const std::vector<SourceLocation>& frames);
 
+std::ostream& operator<<(std::ostream& stream, const SwiftFrames& frames);
+
 }  // namespace swift_xla
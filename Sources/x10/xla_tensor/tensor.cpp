@@ -18,35 +18,57 @@
 #include <atomic>
 #include <cmath>
 #include <condition_variable>
+#include <cstring>
 #include <exception>
 #include <functional>
+#include <future>
+#include <limits>
+#include <map>
 #include <mutex>
 #include <set>
 #include <stdexcept>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/container/node_hash_map.h"
 #include "absl/container/node_hash_set.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
 #include "tensorflow/compiler/xla/xla_client/cache.h"
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/device_activity.h"
 #include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+#include "tensorflow/compiler/xla/xla_client/trace_recorder.h"
 #include "tensorflow/compiler/xla/xla_client/unique.h"
 #include "tensorflow/compiler/xla/xla_client/xla_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/compile_manifest.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/debug_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/graph_profiler.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_dump_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/layout_manager.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/memory_analysis.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/mesh_hlo_share.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/op_by_op_executor.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/cast.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/constant.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/device_data.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/expand.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/remat.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/scalar.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/persistent_cache.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/recompile_diagnostics.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/remote_compile_cache.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/scalar_promotion.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tracelets.h"
 #include "tensorflow/compiler/xla/literal_util.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -70,33 +92,95 @@ struct HashDevice {
   size_t operator()(const Device& device) const { return device.hash(); }
 };
 
+size_t GetCacheShards() {
+  static const size_t num_shards =
+      xla::sys_util::GetEnvInt("XLA_CACHE_SHARDS", 8);
+  return num_shards;
+}
+
 struct TlsData {
   void Reset() { trim_counter = 0; }
 
   size_t trim_counter = 0;
+  // Set while SplitPendingGraph() syncs the chunks, whose own tensors must not
+  // trigger another split.
+  bool splitting_graph = false;
+  xla::ComputationClient::ExecutePriority execute_priority =
+      xla::ComputationClient::ExecutePriority::kNormal;
 };
 
 thread_local TlsData g_tls_data;
 
-struct TraceletState {
-  absl::node_hash_map<xla::hash_t, std::vector<xla::hash_t>> tracelet_by_prefix;
-  absl::node_hash_set<xla::hash_t> cutpoints;
-  int64_t prev_uncached_compile = 0;
-};
+std::atomic<int64_t> g_next_trace_thread_id(1);
+
+// Small integer identifying the calling thread, recorded by the tensors whose
+// pending IR it traces. Zero is never handed out, and stands for no thread.
+int64_t GetTraceThreadId() {
+  thread_local int64_t id = g_next_trace_thread_id.fetch_add(1);
+  return id;
+}
+
+bool IsPerThreadSyncEnabled() {
+  static const bool per_thread_sync =
+      xla::sys_util::GetEnvBool("XLA_PER_THREAD_SYNC", false);
+  return per_thread_sync;
+}
+
+size_t GetOutlineScopeDepth() {
+  static const size_t scope_depth =
+      xla::sys_util::GetEnvInt("XLA_OUTLINE_SCOPE_DEPTH", 0);
+  return scope_depth;
+}
+
+bool IsSkipUnreadLiveTensorsEnabled() {
+  static const bool skip_unread =
+      xla::sys_util::GetEnvBool("XLA_SKIP_UNREAD_LIVE_TENSORS", false);
+  return skip_unread;
+}
+
+// The keys of the tensors which a live tensors sync has seen, and which got
+// destroyed without being read afterwards (see SyncLiveTensorsGraph()).
+class UnreadTensorTable {
+ public:
+  bool Contains(uint64_t key) {
+    std::lock_guard<std::mutex> lock(lock_);
+    return keys_.contains(key);
+  }
 
-thread_local TraceletState g_tracelet_state;
+  void Insert(uint64_t key) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (keys_.size() < kMaxKeys) {
+      keys_.insert(key);
+    }
+  }
 
-c10::optional<size_t> FindTraceDivergence(
-    absl::Span<const xla::hash_t> trace1,
-    absl::Span<const xla::hash_t> trace2) {
-  if (trace2.size() > trace1.size()) {
-    std::swap(trace1, trace2);
+  void Erase(uint64_t key) {
+    std::lock_guard<std::mutex> lock(lock_);
+    keys_.erase(key);
   }
-  auto result = std::mismatch(trace1.begin(), trace1.end(), trace2.begin());
-  if (result.first != trace1.end()) {
-    return result.first - trace1.begin();
+
+ private:
+  static constexpr size_t kMaxKeys = 16384;
+
+  std::mutex lock_;
+  absl::flat_hash_set<uint64_t> keys_;
+};
+
+UnreadTensorTable* GetUnreadTensorTable() {
+  static UnreadTensorTable* table = new UnreadTensorTable();
+  return table;
+}
+
+void ReportRematSavedBytes(absl::Span<const ir::Node* const> post_order) {
+  for (auto& scope_bytes : ir::ops::Remat::ComputeSavedBytes(post_order)) {
+    TF_VLOG(3) << "Remat scope " << scope_bytes.first << " saves "
+               << scope_bytes.second << " bytes";
+    // Metrics with the same name share the same data.
+    xla::metrics::Metric metric(
+        absl::StrCat("RematSavedBytes.", scope_bytes.first),
+        xla::metrics::MetricFnBytes);
+    metric.AddSample(scope_bytes.second);
   }
-  return absl::nullopt;
 }
 
 // Locking:
@@ -118,32 +202,49 @@ c10::optional<size_t> FindTraceDivergence(
 
 class DeviceLocker {
  public:
-  explicit DeviceLocker(Device device) : device_(std::move(device)) {}
+  explicit DeviceLocker(Device device, size_t depth)
+      : device_(std::move(device)), depth_(depth) {}
 
   const Device& device() const { return device_; }
 
-  void Lock() {
+  // Waits until fewer than depth asynchronous operations are in flight on the
+  // device, and returns the ticket of the new one.
+  size_t Lock() {
     std::unique_lock<std::mutex> lock(mutex_);
-    cv_.wait(lock, [this] { return !locked_; });
+    cv_.wait(lock, [this] { return InFlight() < depth_; });
     CheckResetException();
-    locked_ = true;
+    return next_ticket_++;
   }
 
-  void Unlock(std::exception_ptr exptr) {
+  void Unlock(size_t ticket, std::exception_ptr exptr) {
     std::lock_guard<std::mutex> lock(mutex_);
-    locked_ = false;
+    done_tickets_.insert(ticket);
+    while (done_tickets_.erase(done_prefix_) > 0) {
+      ++done_prefix_;
+    }
     exptr_ = std::move(exptr);
     cv_.notify_all();
   }
 
+  // Waits until all the operations which locked the device before the one
+  // owning ticket are complete.
+  void WaitTurn(size_t ticket) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this, ticket] { return done_prefix_ >= ticket; });
+  }
+
   void Barrier() {
     std::unique_lock<std::mutex> lock(mutex_);
-    cv_.wait(lock, [this] { return !locked_; });
+    cv_.wait(lock, [this] { return InFlight() == 0; });
     cv_.notify_all();
     CheckResetException();
   }
 
  private:
+  size_t InFlight() const {
+    return next_ticket_ - done_prefix_ - done_tickets_.size();
+  }
+
   void CheckResetException() {
     std::exception_ptr exptr = std::move(exptr_);
     exptr_ = nullptr;
@@ -153,9 +254,15 @@ class DeviceLocker {
   }
 
   Device device_;
+  size_t depth_ = 1;
   std::mutex mutex_;
   std::condition_variable cv_;
-  bool locked_ = false;
+  // Tickets are handed out in locking order. All the tickets below
+  // done_prefix_ are complete, and done_tickets_ holds the ones above it which
+  // completed out of order.
+  size_t next_ticket_ = 0;
+  size_t done_prefix_ = 0;
+  std::set<size_t> done_tickets_;
   std::exception_ptr exptr_;
 };
 
@@ -167,10 +274,17 @@ class DeviceLockerArena {
   }
 
   std::shared_ptr<DeviceLocker> GetLocker(const Device& device) {
+    // With a depth greater than one, the tracing of the next step proceeds
+    // while the previous steps are still executing. Executions on a device
+    // still happen in order, since each one waits for its turn.
+    static const size_t kPipelineDepth =
+        std::max<int64_t>(xla::sys_util::GetEnvInt("XLA_PIPELINE_DEPTH", 1), 1);
     std::lock_guard<std::mutex> lock(mutex_);
     auto it = lockers_.find(device);
     if (it == lockers_.end()) {
-      it = lockers_.emplace(device, std::make_shared<DeviceLocker>(device))
+      it = lockers_
+               .emplace(device,
+                        std::make_shared<DeviceLocker>(device, kPipelineDepth))
                .first;
     }
     return it->second;
@@ -181,13 +295,15 @@ class DeviceLockerArena {
   std::map<Device, std::shared_ptr<DeviceLocker>> lockers_;
 };
 
-xla::util::ExceptionCleanup LockDevice(const Device& device) {
+xla::util::ExceptionCleanup LockDevice(const Device& device,
+                                       std::function<void()>* wait_turn) {
   auto locker = DeviceLockerArena::Get()->GetLocker(device);
-  locker->Lock();
+  size_t ticket = locker->Lock();
+  *wait_turn = [locker, ticket]() { locker->WaitTurn(ticket); };
   return xla::util::ExceptionCleanup(
-      [locker =
-           std::move(locker)](xla::util::ExceptionCleanup::StatusType status) {
-        locker->Unlock(std::move(status));
+      [locker = std::move(locker),
+       ticket](xla::util::ExceptionCleanup::StatusType status) {
+        locker->Unlock(ticket, std::move(status));
       });
 }
 
@@ -197,14 +313,22 @@ void DeviceBarrier(const Device& device) {
 }
 
 // Use a set to impose an order on the device locking sequence (ABBA
-// prevention).
+// prevention). The wait_turn function blocks until the asynchronous operations
+// which locked the devices earlier are complete.
 std::vector<xla::util::ExceptionCleanup> LockDevices(
-    const std::set<Device>& devices) {
+    const std::set<Device>& devices, std::function<void()>* wait_turn) {
   std::vector<xla::util::ExceptionCleanup> unlocker;
+  std::vector<std::function<void()>> waiters(devices.size());
   unlocker.reserve(devices.size());
+  size_t index = 0;
   for (auto& device : devices) {
-    unlocker.emplace_back(LockDevice(device));
+    unlocker.emplace_back(LockDevice(device, &waiters[index++]));
   }
+  *wait_turn = [waiters = std::move(waiters)]() {
+    for (auto& waiter : waiters) {
+      waiter();
+    }
+  };
   return unlocker;
 }
 
@@ -224,15 +348,20 @@ class XlaDataCacheArena {
   };
 
   using XlaDataCache =
-      xla::util::Cache<at::Tensor, xla::ComputationClient::Data, TensorHasher,
-                       TensorComparer>;
+      xla::util::ShardedCache<at::Tensor, xla::ComputationClient::Data,
+                              TensorHasher, TensorComparer>;
 
-  explicit XlaDataCacheArena(size_t max_cache_size)
+  XlaDataCacheArena(size_t max_cache_size, size_t max_cache_bytes)
       : max_cache_size_(max_cache_size) {
+    auto size_fn = [](const xla::ComputationClient::Data& data) -> size_t {
+      return xla::ShapeUtil::ByteSizeOf(data.shape());
+    };
     for (const std::string& device_string :
          xla::ComputationClient::AllDevices()) {
       swift_xla::Device device(device_string);
-      std::unique_ptr<XlaDataCache> cache(new XlaDataCache(max_cache_size_));
+      std::unique_ptr<XlaDataCache> cache(
+          new XlaDataCache(max_cache_size_, GetCacheShards(), "DeviceDataCache",
+                           max_cache_bytes, size_fn));
       device_caches_.emplace(device, std::move(cache));
     }
   }
@@ -253,7 +382,10 @@ class XlaDataCacheArena {
 XlaDataCacheArena::XlaDataCache* GetXlaDataCache(const Device& device) {
   static const size_t kMaxCacheSize =
       xla::sys_util::GetEnvInt("XLA_DEVDATA_CACHE_SIZE", 128);
-  static XlaDataCacheArena* arena = new XlaDataCacheArena(kMaxCacheSize);
+  static const size_t kMaxCacheBytes =
+      xla::sys_util::GetEnvInt("XLA_DEVDATA_CACHE_BYTES", 0);
+  static XlaDataCacheArena* arena =
+      new XlaDataCacheArena(kMaxCacheSize, kMaxCacheBytes);
   return arena->Get(device);
 }
 
@@ -296,6 +428,16 @@ xla::ComputationClient::DataPtr GetDeviceData(at::Scalar value,
   return GetDeviceData(ToTensor(value, scalar_type), device);
 }
 
+// Whether the upload of the tensor goes through the device data cache, which
+// makes the tensors of identical content share a single device buffer. Scalars
+// always do, while the other tensors need to fit XLA_DEVDATA_CACHE_MAX_TENSOR,
+// since their content gets hashed and copied into the cache.
+bool IsCachedDeviceData(const at::Tensor& tensor) {
+  static const size_t max_tensor_bytes =
+      xla::sys_util::GetEnvInt("XLA_DEVDATA_CACHE_MAX_TENSOR", 0);
+  return tensor.rank() == 0 || tensor.buffer().raw_size() <= max_tensor_bytes;
+}
+
 // Routing values to device data maximizes the changes for compilation cache
 // hits, but it can prevent the compiler to perform optimizations. So tensor
 // values which are within a given set, are routed to constant scalars if this
@@ -314,6 +456,385 @@ bool ShouldSyncIrValue(const ir::Value& ir_value) {
   return ir_value->op() != ir::ops::xla_not_supported;
 }
 
+bool CanPackTensors(at::ScalarType type) {
+  // The host buffers of these types are stored as int16_t, and could not be
+  // told apart from the Short ones once sliced out of the packed tensor.
+  return type != at::ScalarType::BFloat16 && type != at::ScalarType::Half;
+}
+
+// Copies the elements of the rank 1 tensor starting at offset, into a new
+// tensor of the given shape.
+at::Tensor SliceFlatTensor(const at::Tensor& tensor, int64_t offset,
+                           std::vector<int64_t> shape) {
+  size_t size = at::GetLenFromShape(shape);
+  switch (tensor.scalar_type()) {
+#define SLICE_CASE(name, aten_name, DType)                      \
+  case at::ScalarType::aten_name: {                             \
+    std::unique_ptr<DType[]> data(new DType[size]);             \
+    const DType* source = tensor.data<DType>().data() + offset; \
+    std::copy_n(source, size, data.get());                      \
+    return at::Tensor(std::move(data), std::move(shape));       \
+  }
+    LIST_SCALAR_TYPES(SLICE_CASE)
+#undef SLICE_CASE
+  }
+}
+
+// Free list of the memory blocks of kBlockSize bytes of the deleted heap
+// XLATensor objects, or of the deleted tensor Data objects along with their
+// shared pointer control blocks. The blocks move between threads when a tensor
+// gets deleted on another thread than the one which created it, and each free
+// list is capped so that they do not grow without bound.
+template <size_t kBlockSize>
+class BlockCache {
+ public:
+  void* Allocate() {
+    if (blocks_.empty()) {
+      return ::operator new(kBlockSize);
+    }
+    void* block = blocks_.back();
+    blocks_.pop_back();
+    return block;
+  }
+
+  bool Release(void* block) {
+    if (blocks_.size() >= kMaxBlocks) {
+      return false;
+    }
+    blocks_.push_back(block);
+    return true;
+  }
+
+ private:
+  static constexpr size_t kMaxBlocks = 4096;
+
+  std::vector<void*> blocks_;
+};
+
+template <size_t kBlockSize>
+BlockCache<kBlockSize>* GetBlockCache() {
+  // Never destroyed, since tensors can still get deleted while the thread
+  // local objects of the thread are being torn down.
+  static thread_local BlockCache<kBlockSize>* cache =
+      new BlockCache<kBlockSize>();
+  return cache;
+}
+
+// Allocator recycling the single object allocations through the thread block
+// caches, which std::allocate_shared() uses for the object and the control
+// block together.
+template <typename T>
+struct BlockCacheAllocator {
+  using value_type = T;
+
+  BlockCacheAllocator() = default;
+  template <typename U>
+  BlockCacheAllocator(const BlockCacheAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    if (n != 1) {
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    return static_cast<T*>(GetBlockCache<sizeof(T)>()->Allocate());
+  }
+
+  void deallocate(T* ptr, size_t n) {
+    if (n != 1 || !GetBlockCache<sizeof(T)>()->Release(ptr)) {
+      ::operator delete(ptr);
+    }
+  }
+
+  template <typename U>
+  bool operator==(const BlockCacheAllocator<U>&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const BlockCacheAllocator<U>&) const {
+    return false;
+  }
+};
+
+// Host value downloaded from a device data. Device data never changes once it
+// holds a value, so the entry stays good for as long as the data is alive. The
+// weak reference catches a new device data reusing the address of a dead one.
+struct HostValue {
+  std::weak_ptr<xla::ComputationClient::Data> data;
+  at::ScalarType type;
+  at::Tensor tensor;
+};
+
+using HostValueCache =
+    xla::util::Cache<const xla::ComputationClient::Data*, HostValue>;
+
+size_t GetHostValueBytes(const HostValue& value) {
+  return value.tensor.buffer().size() *
+         at::internal::GetSizeof(value.tensor.scalar_type());
+}
+
+// Returns the cache of the host values downloaded from device data, which is
+// shared by all the tensors holding the same device data, or nullptr if
+// XLA_HOST_VALUE_CACHE_BYTES disabled it.
+HostValueCache* GetHostValueCache() {
+  static const size_t max_bytes = xla::sys_util::GetEnvInt(
+      "XLA_HOST_VALUE_CACHE_BYTES", 128 * 1024 * 1024);
+  static HostValueCache* cache =
+      max_bytes > 0
+          ? new HostValueCache(std::numeric_limits<size_t>::max(),
+                               "HostValueCache", max_bytes, GetHostValueBytes)
+          : nullptr;
+  return cache;
+}
+
+c10::optional<at::Tensor> GetCachedHostValue(
+    const xla::ComputationClient::DataPtr& data, at::ScalarType type) {
+  HostValueCache* cache = GetHostValueCache();
+  if (cache == nullptr) {
+    return absl::nullopt;
+  }
+  HostValueCache::TypePtr value = cache->Get(data.get());
+  if (value == nullptr || value->type != type ||
+      value->data.lock() != data) {
+    return absl::nullopt;
+  }
+  return value->tensor;
+}
+
+void CacheHostValue(const xla::ComputationClient::DataPtr& data,
+                    at::ScalarType type, const at::Tensor& tensor) {
+  HostValueCache* cache = GetHostValueCache();
+  if (cache != nullptr) {
+    // Replace any entry left behind by a dead data, or read with another type.
+    cache->Erase(data.get());
+    cache->Add(data.get(),
+               std::make_shared<HostValue>(HostValue{data, type, tensor}));
+  }
+}
+
+// Called when a tensor drops its device data. If it held the last reference,
+// the host value can never be read again, and its memory is returned at once.
+void ReleaseHostValue(const xla::ComputationClient::DataPtr& data) {
+  HostValueCache* cache = GetHostValueCache();
+  if (cache != nullptr && data != nullptr && data.use_count() == 1) {
+    cache->Erase(data.get());
+  }
+}
+
+// The spill epochs are the steps, so the tensors not read for the last few
+// steps are the cold ones.
+std::atomic<int64_t> g_spill_epoch(0);
+
+// Looks up the host values of the device data in the host value cache, and
+// returns the data whose values still need to be transferred.
+std::vector<xla::ComputationClient::DataPtr> LookupHostValues(
+    absl::Span<const xla::ComputationClient::DataPtr> tensors_data,
+    absl::Span<const at::ScalarType> dtypes,
+    std::vector<c10::optional<at::Tensor>>* values) {
+  XLA_CHECK_EQ(tensors_data.size(), dtypes.size());
+  std::vector<xla::ComputationClient::DataPtr> missing_data;
+  values->reserve(tensors_data.size());
+  for (size_t i = 0; i < tensors_data.size(); ++i) {
+    values->push_back(GetCachedHostValue(tensors_data[i], dtypes[i]));
+    if (!values->back()) {
+      missing_data.push_back(tensors_data[i]);
+    }
+  }
+  return missing_data;
+}
+
+// Fills the values LookupHostValues() missed from the literals transferred for
+// them, in order, and adds them to the host value cache.
+std::vector<at::Tensor> CompleteHostValues(
+    absl::Span<const xla::ComputationClient::DataPtr> tensors_data,
+    absl::Span<const at::ScalarType> dtypes,
+    std::vector<c10::optional<at::Tensor>> values,
+    absl::Span<const xla::Literal> literals) {
+  std::vector<at::Tensor> tensors;
+  size_t literals_index = 0;
+  tensors.reserve(values.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (values[i]) {
+      tensors.push_back(std::move(*values[i]));
+    } else {
+      XLA_CHECK_LT(literals_index, literals.size());
+      tensors.push_back(
+          MakeTensorFromXlaLiteral(literals[literals_index], dtypes[i]));
+      CacheHostValue(tensors_data[i], dtypes[i], tensors.back());
+      ++literals_index;
+    }
+  }
+  return tensors;
+}
+
+std::vector<at::Tensor> DataToTensorsCached(
+    absl::Span<const xla::ComputationClient::DataPtr> tensors_data,
+    absl::Span<const at::ScalarType> dtypes) {
+  std::vector<c10::optional<at::Tensor>> values;
+  std::vector<xla::ComputationClient::DataPtr> missing_data =
+      LookupHostValues(tensors_data, dtypes, &values);
+  std::vector<xla::Literal> literals;
+  if (!missing_data.empty()) {
+    literals = xla::ComputationClient::TransferFromServer(missing_data);
+  }
+  return CompleteHostValues(tensors_data, dtypes, std::move(values), literals);
+}
+
+// Batches the concurrent small reads of the device data behind one transfer
+// manager. The reader which finds no transfer in flight fetches all the queued
+// reads with a single transfer, while the readers arriving meanwhile queue up
+// for the next one, so a lone reader never waits for company.
+class SmallReadBatcher {
+ public:
+  void Read(xla::ComputationClient::DataPtr data, xla::Shape dest_shape,
+            void* dest) {
+    Request request{std::move(data), std::move(dest_shape), dest};
+    std::unique_lock<std::mutex> lock(mutex_);
+    queue_.push_back(&request);
+    while (!request.done) {
+      if (busy_) {
+        cv_.wait(lock);
+        continue;
+      }
+      busy_ = true;
+      std::vector<Request*> batch;
+      batch.swap(queue_);
+      lock.unlock();
+      std::exception_ptr error = Transfer(batch);
+      lock.lock();
+      for (Request* batch_request : batch) {
+        batch_request->error = error;
+        batch_request->done = true;
+      }
+      busy_ = false;
+      cv_.notify_all();
+    }
+    if (request.error) {
+      std::rethrow_exception(request.error);
+    }
+  }
+
+ private:
+  struct Request {
+    xla::ComputationClient::DataPtr data;
+    xla::Shape dest_shape;
+    void* dest = nullptr;
+    bool done = false;
+    std::exception_ptr error;
+  };
+
+  static std::exception_ptr Transfer(absl::Span<Request* const> batch) {
+    std::vector<xla::ComputationClient::DataPtr> tensors_data;
+    std::vector<xla::MutableBorrowingLiteral> literals;
+    tensors_data.reserve(batch.size());
+    literals.reserve(batch.size());
+    for (Request* request : batch) {
+      tensors_data.push_back(request->data);
+      literals.emplace_back(static_cast<const char*>(request->dest),
+                            request->dest_shape);
+    }
+    XLA_VALUE_METRIC("SmallReadBatchSize", batch.size());
+    try {
+      xla::ComputationClient::TransferFromServer(tensors_data, literals);
+    } catch (...) {
+      return std::current_exception();
+    }
+    return nullptr;
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<Request*> queue_;
+  bool busy_ = false;
+};
+
+SmallReadBatcher* GetSmallReadBatcher(
+    const xla::ComputationClient::DataPtr& data) {
+  static std::mutex* mutex = new std::mutex();
+  static auto* batchers = new std::map<xla::ComputationClient::TransferManager*,
+                                       std::unique_ptr<SmallReadBatcher>>();
+  std::lock_guard<std::mutex> lock(*mutex);
+  std::unique_ptr<SmallReadBatcher>& batcher =
+      (*batchers)[data->device()->GetTransferManager()];
+  if (batcher == nullptr) {
+    batcher = absl::make_unique<SmallReadBatcher>();
+  }
+  return batcher.get();
+}
+
+// Whether the cached computations drop the host copy of their HLO once
+// compiled, which otherwise takes a lot of host memory for large models.
+bool ShouldReleaseCompiledHlo() {
+  static const bool release_hlo =
+      xla::sys_util::GetEnvBool("XLA_RELEASE_COMPILED_HLO", false);
+  return release_hlo;
+}
+
+bool UseDeferredUploads() {
+  static const bool deferred_uploads =
+      xla::sys_util::GetEnvBool("XLA_DEFERRED_UPLOADS", false);
+  return deferred_uploads;
+}
+
+// The host tensors whose uploads got deferred to the next execution on their
+// device. The IR graphs reference the placeholders, which get filled by a
+// single batched transfer right before they are needed.
+class DeferredUploads {
+ public:
+  void Add(const Device& device, at::Tensor tensor,
+           const xla::ComputationClient::DataPtr& placeholder) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uploads_[device].push_back({std::move(tensor), placeholder});
+  }
+
+  void Flush(const Device& device) {
+    std::vector<Upload> uploads;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = uploads_.find(device);
+      if (it == uploads_.end()) {
+        return;
+      }
+      uploads = std::move(it->second);
+      uploads_.erase(it);
+    }
+    std::vector<at::Tensor> tensors;
+    std::vector<xla::Shape> shapes;
+    std::vector<xla::ComputationClient::DataPtr> placeholders;
+    for (auto& upload : uploads) {
+      // The placeholders no IR graph references anymore need no upload.
+      xla::ComputationClient::DataPtr placeholder = upload.placeholder.lock();
+      if (placeholder != nullptr) {
+        tensors.push_back(std::move(upload.tensor));
+        shapes.push_back(placeholder->shape());
+        placeholders.push_back(std::move(placeholder));
+      }
+    }
+    if (placeholders.empty()) {
+      return;
+    }
+    XLA_COUNTER("DeferredUploadFlushes", 1);
+    XLA_COUNTER("DeferredUploads", placeholders.size());
+    std::vector<xla::ComputationClient::DataPtr> handles =
+        CreateTensorsData(tensors, shapes, device.ToString());
+    for (size_t i = 0; i < handles.size(); ++i) {
+      placeholders[i]->Assign(*handles[i]);
+    }
+  }
+
+ private:
+  struct Upload {
+    at::Tensor tensor;
+    std::weak_ptr<xla::ComputationClient::Data> placeholder;
+  };
+
+  std::mutex mutex_;
+  std::map<Device, std::vector<Upload>> uploads_;
+};
+
+DeferredUploads* GetDeferredUploads() {
+  static DeferredUploads* uploads = new DeferredUploads();
+  return uploads;
+}
+
 }  // namespace
 
 // The DeviceContextArena holds per device live information and statistics,
@@ -322,21 +843,60 @@ bool ShouldSyncIrValue(const ir::Value& ir_value) {
 // operations and ensure the same XLA computations are created during the
 // training loops.
 class XLATensor::DeviceContextArena {
-  struct DeviceContext {
+  // The live tensors are striped over shards by unique ID, so that threads
+  // creating and destroying tensors on the same device rarely contend on the
+  // same lock. Shards are cache line aligned to avoid false sharing.
+  static constexpr size_t kNumTensorShards = 32;
+
+  struct alignas(64) TensorShard {
     std::mutex lock;
     absl::flat_hash_map<int64_t, std::weak_ptr<Data>> tensors_data;
+  };
+
+  struct DeviceContext {
+    TensorShard& GetShard(int64_t unique_id) {
+      return tensor_shards[static_cast<uint64_t>(unique_id) %
+                           kNumTensorShards];
+    }
+
+    TensorShard tensor_shards[kNumTensorShards];
+    std::mutex lock;
+    // The seed the thread RNG states of the device start from.
     uint64_t seed = 101;
-    uint64_t running_seed = 101;
+    // Bumped whenever seed changes, which makes every thread restart its RNG
+    // state from it.
+    std::atomic<uint64_t> seed_epoch{1};
+  };
+
+  // The random ops state of a thread on a device. Each thread steps its own
+  // seeds, so it only takes the device lock when the device seed changes.
+  struct RngState {
+    void Reset(uint64_t new_seed) {
+      seed = new_seed;
+      running_seed = seed;
+      seed_ir_value = ir::Value();
+      rng_op_index = 0;
+    }
+
+    uint64_t seed = 0;
+    uint64_t running_seed = 0;
     ir::Value seed_ir_value;
+    int64_t rng_op_index = 0;
+    // The seed epoch of the device the state started from.
+    uint64_t epoch = 0;
   };
 
+  using RngStates = absl::flat_hash_map<Device, RngState, HashDevice>;
+
  public:
   DeviceContextArena() {
     for (const std::string& device_string :
          xla::ComputationClient::AllDevices()) {
-      swift_xla::Device device(device_string);
-      device_contexts_.emplace(device, new DeviceContext);
+      device_indices_.emplace(Device(device_string), devices_.size());
+      devices_.emplace_back(device_string);
     }
+    device_contexts_.reset(
+        new std::atomic<DeviceContext*>[devices_.size()]());
   }
 
   static DeviceContextArena* Get() {
@@ -346,30 +906,45 @@ class XLATensor::DeviceContextArena {
 
   void RegisterTensor(std::shared_ptr<Data> data) {
     DeviceContext* devctx = GetDeviceContext(data->device);
-    std::lock_guard<std::mutex> lock(devctx->lock);
-    devctx->tensors_data.emplace(data->unique_id, data);
+    TensorShard& shard = devctx->GetShard(data->unique_id);
+    data->last_use.store(g_spill_epoch.load(std::memory_order_relaxed),
+                         std::memory_order_relaxed);
+    data->NoteUseThread();
+    std::lock_guard<std::mutex> lock(shard.lock);
+    shard.tensors_data.emplace(data->unique_id, data);
     XLA_COUNTER("CreateXlaTensor", 1);
   }
 
   void UnregisterTensor(Data* data) {
     DeviceContext* devctx = GetDeviceContext(data->device);
-    std::lock_guard<std::mutex> lock(devctx->lock);
-    devctx->tensors_data.erase(data->unique_id);
+    TensorShard& shard = devctx->GetShard(data->unique_id);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    shard.tensors_data.erase(data->unique_id);
     XLA_COUNTER("DestroyXlaTensor", 1);
   }
 
   std::vector<XLATensor> GetLiveTensors(const Device* device) {
-    std::vector<XLATensor> tensors;
+    // The shard locks are only held to copy the weak pointers, which get
+    // locked afterwards, so that tensors whose last reference goes away during
+    // the snapshot do not wait on it.
+    std::vector<std::weak_ptr<Data>> tensors_data;
     auto fn = [&](DeviceContext* devctx) {
-      std::lock_guard<std::mutex> lock(devctx->lock);
-      for (auto& uid_wptr : devctx->tensors_data) {
-        std::shared_ptr<Data> data = uid_wptr.second.lock();
-        if (data != nullptr) {
-          tensors.push_back(XLATensor(std::move(data)));
+      for (auto& shard : devctx->tensor_shards) {
+        std::lock_guard<std::mutex> lock(shard.lock);
+        for (auto& uid_wptr : shard.tensors_data) {
+          tensors_data.push_back(uid_wptr.second);
         }
       }
     };
     ForAllDeviceContexts(fn, device);
+    std::vector<XLATensor> tensors;
+    tensors.reserve(tensors_data.size());
+    for (auto& wptr : tensors_data) {
+      std::shared_ptr<Data> data = wptr.lock();
+      if (data != nullptr) {
+        tensors.push_back(XLATensor(std::move(data)));
+      }
+    }
     std::sort(tensors.begin(), tensors.end(), [](const XLATensor& a,
                                                  const XLATensor& b) {
       return a.GetUniqueId() < b.GetUniqueId();
@@ -378,37 +953,85 @@ class XLATensor::DeviceContextArena {
   }
 
   uint64_t GetRunningSeed(const Device& device) {
-    DeviceContext* devctx = GetDeviceContext(device);
-    std::lock_guard<std::mutex> lock(devctx->lock);
-    return devctx->running_seed;
+    return GetRngState(device)->running_seed;
+  }
+
+  ir::Value GetRngSeed(
+      const Device& device,
+      const std::function<ir::Value(uint64_t)>& seed_ir_value_fn) {
+    RngState* rng_state = GetRngState(device);
+    if (!rng_state->seed_ir_value) {
+      rng_state->seed_ir_value = seed_ir_value_fn(rng_state->running_seed);
+    }
+    return rng_state->seed_ir_value;
+  }
+
+  int64_t GetNextRngOpIndex(const Device& device) {
+    return GetRngState(device)->rng_op_index++;
   }
 
   void SetRngSeed(const Device* device, uint64_t seed) {
-    auto fn = [&](DeviceContext* devctx) {
+    auto fn = [&](const Device& device, DeviceContext* devctx) {
       std::lock_guard<std::mutex> lock(devctx->lock);
       devctx->seed = seed;
-      devctx->running_seed = devctx->seed;
-      devctx->seed_ir_value = ir::Value();
+      devctx->seed_epoch.fetch_add(1);
     };
-    ForAllDeviceContexts(fn, device);
+    ForAllDevices(fn, device);
   }
 
+  // Steps the seeds at the end of a step. With per thread syncs, a barrier
+  // only ends the step of the calling thread, whose seeds alone get stepped.
+  // Otherwise it ends the step of all the threads, which all restart from the
+  // stepped device seed.
   void StepRngSeed(const Device* device) {
-    auto fn = [&](DeviceContext* devctx) {
-      std::lock_guard<std::mutex> lock(devctx->lock);
-      devctx->seed = 1012031 + devctx->seed * 7012063;
-      devctx->running_seed = devctx->seed;
-      devctx->seed_ir_value = ir::Value();
+    auto fn = [&](const Device& device, DeviceContext* devctx) {
+      if (IsPerThreadSyncEnabled()) {
+        RngState* rng_state = GetRngState(device);
+        rng_state->Reset(NextSeed(rng_state->seed));
+      } else {
+        std::lock_guard<std::mutex> lock(devctx->lock);
+        devctx->seed = NextSeed(devctx->seed);
+        devctx->seed_epoch.fetch_add(1);
+      }
     };
-    ForAllDeviceContexts(fn, device);
+    ForAllDevices(fn, device);
   }
 
  private:
+  static uint64_t NextSeed(uint64_t seed) { return 1012031 + seed * 7012063; }
+
+  RngState* GetRngState(const Device& device) {
+    static thread_local RngStates rng_states;
+    RngState& rng_state = rng_states[device];
+    DeviceContext* devctx = GetDeviceContext(device);
+    if (rng_state.epoch != devctx->seed_epoch.load()) {
+      std::lock_guard<std::mutex> lock(devctx->lock);
+      rng_state.Reset(devctx->seed);
+      rng_state.epoch = devctx->seed_epoch.load();
+    }
+    return &rng_state;
+  }
+
+  void ForAllDevices(
+      const std::function<void(const Device&, DeviceContext*)>& fn,
+      const Device* device) {
+    if (device == nullptr) {
+      for (const Device& known_device : devices_) {
+        fn(known_device, GetDeviceContext(known_device));
+      }
+    } else {
+      fn(*device, GetDeviceContext(*device));
+    }
+  }
+
   std::vector<DeviceContext*> GetAllDeviceContexts() {
     std::vector<DeviceContext*> all_device_contexts;
-    all_device_contexts.reserve(device_contexts_.size());
-    for (auto& device_contexts : device_contexts_) {
-      all_device_contexts.push_back(device_contexts.second);
+    all_device_contexts.reserve(devices_.size());
+    for (size_t i = 0; i < devices_.size(); ++i) {
+      DeviceContext* devctx = device_contexts_[i].load();
+      if (devctx != nullptr) {
+        all_device_contexts.push_back(devctx);
+      }
     }
     return all_device_contexts;
   }
@@ -424,25 +1047,130 @@ class XLATensor::DeviceContextArena {
     }
   }
 
+  // The contexts get created at the first use of their device, which spares
+  // the hosts of a pod the ones of the many devices they never touch.
   DeviceContext* GetDeviceContext(const Device& device) {
-    auto it = device_contexts_.find(device);
-    XLA_CHECK(it != device_contexts_.end())
+    auto it = device_indices_.find(device);
+    XLA_CHECK(it != device_indices_.end())
         << "No such device: " << device.ToString();
-    return it->second;
+    std::atomic<DeviceContext*>& slot = device_contexts_[it->second];
+    DeviceContext* devctx = slot.load(std::memory_order_acquire);
+    if (devctx == nullptr) {
+      auto new_devctx = absl::make_unique<DeviceContext>();
+      if (slot.compare_exchange_strong(devctx, new_devctx.get(),
+                                       std::memory_order_acq_rel)) {
+        devctx = new_devctx.release();
+      }
+    }
+    return devctx;
   }
 
-  absl::flat_hash_map<Device, DeviceContext*, HashDevice> device_contexts_;
+  std::vector<Device> devices_;
+  absl::flat_hash_map<Device, size_t, HashDevice> device_indices_;
+  std::unique_ptr<std::atomic<DeviceContext*>[]> device_contexts_;
 };
 
 struct DeviceDataInfo : public xla::ComputationClient::Data::Info {
-  DeviceDataInfo(int64_t tensor_id, bool read_only)
-      : tensor_id(tensor_id), read_only(read_only) {}
+  DeviceDataInfo(int64_t tensor_id, bool read_only, bool frozen = false)
+      : tensor_id(tensor_id), read_only(read_only || frozen), frozen(frozen) {}
 
   int64_t tensor_id = 0;
   bool read_only = false;
+  // Set by XLATensor::FreezeDeviceData(), and kept by the later infos.
+  bool frozen = false;
 };
 
-XLATensor::Data::~Data() { DeviceContextArena::Get()->UnregisterTensor(this); }
+bool IsFrozenDeviceData(const xla::ComputationClient::Data& data) {
+  DeviceDataInfo* data_info = dynamic_cast<DeviceDataInfo*>(data.info());
+  return data_info != nullptr && data_info->frozen;
+}
+
+bool IsParamAliasingEnabled() {
+  static const bool enable_aliasing =
+      xla::sys_util::GetEnvBool("XLA_ENABLE_PARAM_ALIASING", false);
+  return enable_aliasing;
+}
+
+// Graphs whose parameters should never be donated, listed by graph hash in
+// XLA_PARAM_ALIASING_EXCLUDE (comma separated, as logged by the sync code).
+bool IsParamAliasingExcluded(const xla::hash_t& graph_hash) {
+  static const std::set<std::string>* excluded_graphs =
+      new std::set<std::string>(absl::StrSplit(
+          xla::sys_util::GetEnvString("XLA_PARAM_ALIASING_EXCLUDE", ""), ',',
+          absl::SkipEmpty()));
+  return !excluded_graphs->empty() &&
+         excluded_graphs->count(xla::util::HexHash(graph_hash)) > 0;
+}
+
+// Whether the computation carries shardings, as set by XLATensor::shard(), for
+// the SPMD partitioner.
+bool HasShardings(const xla::XlaComputation& computation) {
+  for (const xla::HloComputationProto& hlo_computation :
+       computation.proto().computations()) {
+    for (const xla::HloInstructionProto& instruction :
+         hlo_computation.instructions()) {
+      if (instruction.has_sharding()) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Hash of the element type and dimensions of a shape, ignoring its layout.
+xla::hash_t GetShapeDimensionsHash(const xla::Shape& shape) {
+  xla::hash_t hash =
+      xla::util::Hash(static_cast<int>(shape.element_type()));
+  for (auto dim : shape.dimensions()) {
+    hash = xla::util::HashCombine(hash, dim);
+  }
+  return hash;
+}
+
+xla::hash_t HashParameterAliases(
+    xla::hash_t hash,
+    absl::Span<const XLATensor::ParameterAlias> parameter_aliases) {
+  for (const XLATensor::ParameterAlias& alias : parameter_aliases) {
+    hash = xla::util::HashCombine(
+        hash, xla::util::MHash(alias.parameter_index, alias.output_index));
+  }
+  return hash;
+}
+
+XLATensor::Data::~Data() {
+  ColdData* cold_data = cold.load();
+  if (cold_data != nullptr) {
+    if (cold_data->barrier_tracked.load() && !cold_data->barrier_read.load()) {
+      GetUnreadTensorTable()->Insert(cold_data->barrier_key.load());
+    }
+    delete cold_data;
+  }
+  if (registered.load()) {
+    DeviceContextArena::Get()->UnregisterTensor(this);
+  }
+}
+
+XLATensor::ColdData* XLATensor::Data::GetColdData() {
+  ColdData* cold_data = cold.load(std::memory_order_acquire);
+  if (cold_data == nullptr) {
+    // The live tensors syncs of the other threads can race to create it.
+    std::unique_ptr<ColdData> new_cold_data(new ColdData());
+    if (cold.compare_exchange_strong(cold_data, new_cold_data.get(),
+                                     std::memory_order_acq_rel)) {
+      cold_data = new_cold_data.release();
+    }
+  }
+  return cold_data;
+}
+
+void XLATensor::Data::NoteUseThread() {
+  int64_t thread = GetTraceThreadId();
+  int64_t current = 0;
+  if (!use_thread.compare_exchange_strong(current, thread) &&
+      current != thread && current != -1) {
+    use_thread.store(-1);
+  }
+}
 
 XLATensor::Async::Async(
     SyncTensorCollection* coll,
@@ -452,6 +1180,7 @@ XLATensor::Async::Async(
     : mwait(1),
       indices(std::move(coll->indices)),
       unlocker(std::move(coll->unlocker)),
+      wait_turn(std::move(coll->wait_turn)),
       parameters_data(std::move(parameters_data)),
       device(coll->device.ToString()),
       cached_computation(std::move(cached_computation)),
@@ -479,10 +1208,31 @@ void XLATensor::Async::Wait() {
   }
 }
 
+void* XLATensor::operator new(size_t size) {
+  if (size != sizeof(XLATensor)) {
+    return ::operator new(size);
+  }
+  return GetBlockCache<sizeof(XLATensor)>()->Allocate();
+}
+
+void XLATensor::operator delete(void* ptr, size_t size) {
+  if (size != sizeof(XLATensor) ||
+      !GetBlockCache<sizeof(XLATensor)>()->Release(ptr)) {
+    ::operator delete(ptr);
+  }
+}
+
 XLATensor XLATensor::Create(const at::Tensor& tensor, const Device& device) {
   // LOG(FATAL) << "TODO check device";
+  // The live tensors syncs upload the host only tensors together, so the
+  // arrays are registered right away. The scalars, created and dropped at a
+  // high rate, are only registered once their host data gets uploaded or
+  // traced, so they miss those batched uploads, and get uploaded on their own
+  // when first used (or folded into the graph, for the special scalars).
   XLATensor xtensor(tensor, device);
-  DeviceContextArena::Get()->RegisterTensor(xtensor.data_ptr());
+  if (tensor.rank() > 0) {
+    xtensor.Register();
+  }
   return xtensor;
 }
 
@@ -495,7 +1245,7 @@ XLATensor XLATensor::Create(
     xla::ComputationClient::DataPtr xla_data,
     c10::optional<at::ScalarType> logical_element_type) {
   XLATensor xtensor(std::move(xla_data), logical_element_type);
-  DeviceContextArena::Get()->RegisterTensor(xtensor.data_ptr());
+  xtensor.Register();
   return xtensor;
 }
 
@@ -503,23 +1253,27 @@ XLATensor XLATensor::Create(
     ir::Value ir_value, const Device& device,
     c10::optional<at::ScalarType> logical_element_type) {
   XLATensor xtensor(std::move(ir_value), device, logical_element_type);
-  DeviceContextArena::Get()->RegisterTensor(xtensor.data_ptr());
+  xtensor.Register();
   return xtensor;
 }
 
 XLATensor::XLATensor(const at::Tensor& tensor, const Device& device)
-    : data_(std::make_shared<Data>(tensor, device)) {}
+    : data_(std::allocate_shared<Data>(BlockCacheAllocator<Data>(), tensor,
+                                       device)) {}
 
 XLATensor::XLATensor(xla::ComputationClient::DataPtr xla_data,
                      c10::optional<at::ScalarType> logical_element_type)
-    : data_(std::make_shared<Data>(xla_data,
-                                   Device(xla_data->device()->device_id()),
-                                   logical_element_type)) {}
+    : data_(std::allocate_shared<Data>(
+          BlockCacheAllocator<Data>(), xla_data,
+          Device(xla_data->device()->device_id()), logical_element_type)) {}
 
 XLATensor::XLATensor(ir::Value ir_value, const Device& device,
                      c10::optional<at::ScalarType> logical_element_type)
-    : data_(std::make_shared<Data>(std::move(ir_value), device,
-                                   logical_element_type)) {
+    : data_(std::allocate_shared<Data>(
+          BlockCacheAllocator<Data>(),
+          ir::Util::FoldConstant(std::move(ir_value)), device,
+          logical_element_type)) {
+  data_->trace_thread.store(GetTraceThreadId(), std::memory_order_relaxed);
   TryLimitGraphSize();
 }
 
@@ -571,7 +1325,15 @@ const Device& XLATensor::GetDevice() const { return data()->device; }
 
 int64_t XLATensor::GetUniqueId() const { return data()->unique_id; }
 
+std::shared_ptr<const ir::MetaData> XLATensor::GetOrigin() const {
+  if (data()->ir_value) {
+    return std::make_shared<ir::MetaData>(data()->ir_value.node->metadata());
+  }
+  return data()->origin;
+}
+
 xla::ComputationClient::DataPtr XLATensor::GetXlaData() {
+  NoteRead();
   bool up_to_date = true;
   ir::Value ir_value;
   if (up_to_date) {
@@ -590,7 +1352,10 @@ xla::ComputationClient::DataPtr XLATensor::GetXlaData() {
     ApplyPendingGraph();
   } else {
     XLA_CHECK(data()->tensor_data);
+    NoteSpillReload();
     data()->xla_data = TensorToXlaData(*data()->tensor_data, GetDevice());
+    Register();
+    ReleaseBorrowedTensorData();
   }
   return data()->xla_data;
 }
@@ -618,7 +1383,15 @@ void XLATensor::SetXlaData(xla::ComputationClient::DataPtr xla_data) {
 
 void XLATensor::SetXlaData(xla::ComputationClient::DataPtr xla_data,
                            bool sync) {
+  ReleaseHostValue(data()->xla_data);
   data()->xla_data = std::move(xla_data);
+  if (data()->xla_data != nullptr) {
+    Register();
+  }
+  data()->origin =
+      data()->ir_value
+          ? std::make_shared<ir::MetaData>(data()->ir_value.node->metadata())
+          : nullptr;
   // Assigning a device data should always clear the IR node, to allow graph
   // trimming.
   AssignIrValue(ir::Value());
@@ -628,9 +1401,10 @@ void XLATensor::SetXlaData(xla::ComputationClient::DataPtr xla_data,
 }
 
 void XLATensor::SetIrValue(ir::Value ir_value) {
+  ReleaseHostValue(data()->xla_data);
   data()->xla_data = nullptr;
   data()->tensor_data = absl::nullopt;
-  AssignIrValue(std::move(ir_value));
+  AssignIrValue(ir::Util::FoldConstant(std::move(ir_value)));
   TryLimitGraphSize();
 }
 
@@ -644,8 +1418,13 @@ void XLATensor::SetInPlaceIrValue(ir::Value ir_value) {
 }
 
 void XLATensor::AssignIrValue(ir::Value ir_value) const {
+  data()->trace_thread.store(ir_value ? GetTraceThreadId() : 0,
+                             std::memory_order_relaxed);
   data()->ir_value = std::move(ir_value);
   data()->generation += 1;
+  if (data()->ir_value) {
+    Register();
+  }
 }
 
 void XLATensor::TryLimitGraphSize() {
@@ -656,16 +1435,75 @@ void XLATensor::TryLimitGraphSize() {
       xla::sys_util::GetEnvInt("XLA_TRIM_GRAPH_CHECK_FREQUENCY", 5000);
   static const size_t kMaxPendingGraphSize =
       xla::sys_util::GetEnvInt("XLA_TRIM_GRAPH_SIZE", 100000);
-  if (data()->ir_value && ++g_tls_data.trim_counter % kCheckFrequency == 0) {
-    size_t graph_size = ir::Util::GetGraphSize({data()->ir_value.node.get()});
-    if (graph_size > kMaxPendingGraphSize) {
+  static const size_t kSplitGraphSize =
+      xla::sys_util::GetEnvInt("XLA_SPLIT_GRAPH_SIZE", 0);
+  static const int64_t kSplitGraphBytes =
+      xla::sys_util::GetEnvInt("XLA_SPLIT_GRAPH_BYTES", 0);
+  if (data()->ir_value && !g_tls_data.splitting_graph &&
+      ++g_tls_data.trim_counter % kCheckFrequency == 0) {
+    std::vector<const ir::Node*> post_order =
+        ir::Util::ComputePostOrder({data()->ir_value.node.get()});
+    size_t num_chunks = 1;
+    if (kSplitGraphSize > 0) {
+      num_chunks = (post_order.size() + kSplitGraphSize - 1) / kSplitGraphSize;
+    }
+    if (kSplitGraphBytes > 0) {
+      int64_t graph_bytes = ir::Util::GetPostOrderBytes(post_order);
+      num_chunks = std::max<size_t>(
+          num_chunks, (graph_bytes + kSplitGraphBytes - 1) / kSplitGraphBytes);
+    }
+    if (num_chunks > 1) {
+      XLA_COUNTER("SplitIrGraph", 1);
+      SplitPendingGraph(post_order, num_chunks);
+    } else if (post_order.size() > kMaxPendingGraphSize) {
       XLA_COUNTER("TrimIrGraph", 1);
       ApplyPendingGraph();
     }
   }
 }
 
+void XLATensor::SplitPendingGraph(
+    absl::Span<const ir::Node* const> post_order, size_t num_chunks) {
+  std::vector<std::vector<ir::Value>> cuts =
+      ir::Util::ComputeGraphCuts(post_order, num_chunks);
+  TF_VLOG(3) << "Splitting pending graph of " << post_order.size()
+             << " nodes at " << cuts.size() << " cuts";
+  g_tls_data.splitting_graph = true;
+  xla::util::ExceptionCleanup guard(
+      [](xla::util::ExceptionCleanup::StatusType /*status*/) {
+        g_tls_data.splitting_graph = false;
+      });
+  // Every chunk computes the values live across its cut, on top of what the
+  // previous chunks left on device, and the following chunks refer to them as
+  // device data instead of their defining graph.
+  ir::OutputMap<ir::Value> replacements;
+  for (auto& cut_values : cuts) {
+    std::vector<ir::Value> values =
+        ir::Util::CloneWithReplacements(cut_values, replacements);
+    std::vector<XLATensor> chunk_tensors;
+    for (auto& value : values) {
+      chunk_tensors.push_back(Create(std::move(value), GetDevice()));
+    }
+    SyncTensorsGraph(&chunk_tensors, {}, /*wait=*/true,
+                     /*sync_xla_data=*/false);
+    for (size_t i = 0; i < cut_values.size(); ++i) {
+      xla::ComputationClient::DataPtr xla_data =
+          chunk_tensors[i].CurrentXlaData();
+      XLA_CHECK(xla_data != nullptr);
+      replacements.emplace(
+          ir::Output(cut_values[i].node.get(), cut_values[i].index),
+          chunk_tensors[i].CreateTensorNode(std::move(xla_data),
+                                            /*read_only=*/false));
+    }
+    XLA_COUNTER("SplitIrGraphChunks", 1);
+  }
+  AssignIrValue(
+      ir::Util::CloneWithReplacements({CurrentIrValue()}, replacements)
+          .front());
+}
+
 ir::Value XLATensor::GetIrValue() const {
+  NoteRead();
   ir::Value ir_value = CurrentIrValue();
   if (ir_value) {
     return ir_value;
@@ -683,18 +1521,48 @@ ir::Value XLATensor::GetIrValue() const {
   }
   c10::optional<at::Tensor> tensor_data = CurrentTensorData();
   XLA_CHECK(tensor_data);
+  NoteSpillReload();
   AssignIrValue(GetIrValueForTensor(*tensor_data, GetDevice()));
+  ReleaseBorrowedTensorData();
   return data()->ir_value;
 }
 
-ir::Value XLATensor::CurrentIrValue() const {
-  return data()->ir_value;
+void XLATensor::ReleaseBorrowedTensorData() const {
+  // The borrowed scalars go back to their owner once uploaded, rather than
+  // when the tensor is destroyed. The reads go through the device from then.
+  if (data()->tensor_data && data()->tensor_data->buffer().is_borrowed()) {
+    data()->tensor_data = absl::nullopt;
+  }
+}
+
+void XLATensor::NoteRead() const {
+  Data* tensor_data = data();
+  tensor_data->last_use.store(g_spill_epoch.load(std::memory_order_relaxed),
+                              std::memory_order_relaxed);
+  tensor_data->NoteUseThread();
+  ColdData* cold_data = tensor_data->cold.load(std::memory_order_acquire);
+  if (cold_data != nullptr && cold_data->barrier_tracked.load() &&
+      !cold_data->barrier_read.exchange(true)) {
+    GetUnreadTensorTable()->Erase(cold_data->barrier_key.load());
+  }
+}
+
+ir::Value XLATensor::CurrentIrValue() const {
+  return data()->ir_value;
 }
 
 void XLATensor::SetTensorData(at::Tensor tensor_data) {
   data()->tensor_data = std::move(tensor_data);
 }
 
+void XLATensor::Register() const {
+  Data* tensor_data = data();
+  if (!tensor_data->registered.load(std::memory_order_relaxed) &&
+      !tensor_data->registered.exchange(true)) {
+    DeviceContextArena::Get()->RegisterTensor(data_);
+  }
+}
+
 c10::optional<at::Tensor> XLATensor::CurrentTensorData() const {
   return data()->tensor_data;
 }
@@ -703,15 +1571,19 @@ ir::Value XLATensor::GetIrValueForTensor(const at::Tensor& tensor,
                                          const Device& device) const {
   xla::ComputationClient::DataPtr data;
   bool read_only = false;
-  if (tensor.rank() == 0) {
-    at::Scalar value = tensor.item();
-    if (IsSpecialScalar(value)) {
-      return ir::ops::ScalarOp(
-          std::move(value),
-          MakeXlaPrimitiveType(tensor.scalar_type(), &device));
-    }
+  if (tensor.rank() == 0 && IsSpecialScalar(tensor.item())) {
+    return ir::ops::ScalarOp(
+        tensor.item(), MakeXlaPrimitiveType(tensor.scalar_type(), &device));
+  }
+  if (IsCachedDeviceData(tensor)) {
+    // The device buffer is shared, so it must never get donated or updated in
+    // place.
     data = GetDeviceData(tensor, device);
     read_only = true;
+  } else if (UseDeferredUploads()) {
+    data = xla::GetX10Device(device)->CreateDataPlaceholder(
+        CreateComputationShapeFromTensor(tensor, &device));
+    GetDeferredUploads()->Add(device, tensor, data);
   } else {
     XLA_TIMED("IrValueTensorToXlaData");
     data = TensorToXlaData(tensor, device);
@@ -719,12 +1591,22 @@ ir::Value XLATensor::GetIrValueForTensor(const at::Tensor& tensor,
   return CreateTensorNode(std::move(data), read_only);
 }
 
+void XLATensor::FlushDeferredUploads(const Device& device) {
+  GetDeferredUploads()->Flush(device);
+}
+
 ir::Value XLATensor::GetIrValueForScalar(at::Scalar value,
                                          xla::PrimitiveType type,
                                          const Device& device) {
   if (IsSpecialScalar(value)) {
     return ir::ops::ScalarOp(std::move(value), type);
   }
+  return GetDeviceDataForScalar(std::move(value), type, device);
+}
+
+ir::Value XLATensor::GetDeviceDataForScalar(at::Scalar value,
+                                            xla::PrimitiveType type,
+                                            const Device& device) {
   xla::ComputationClient::DataPtr data =
       GetDeviceData(value, TensorTypeFromXlaType(type), device);
   data->SetInfo(
@@ -767,13 +1649,15 @@ ir::Value XLATensor::GetIrValueForScalar(
 }
 
 at::Tensor XLATensor::ToTensor(bool detached) {
+  NoteRead();
   at::Tensor tensor(std::unique_ptr<at::AnyScalarBuffer>(nullptr), {});
   c10::optional<at::Tensor> tensor_data = CurrentTensorData();
   if (!tensor_data) {
     DeviceBarrier(GetDevice());
     // The GetXlaData() call will trigger an ApplyPendingGraph() if an IR Node
     // is available on the tensor.
-    std::vector<at::Tensor> tensors = XlaDataToTensors({GetXlaData()}, dtype());
+    std::vector<at::Tensor> tensors =
+        DataToTensorsCached({GetXlaData()}, {dtype()});
     tensor = std::move(tensors.front());
     if (!detached) {
       SetTensorData(tensor);
@@ -795,6 +1679,53 @@ at::Tensor XLATensor::ToTensor(bool detached) {
   return tensor;
 }
 
+void XLATensor::ToBuffer(void* dest, size_t dest_size) {
+  NoteRead();
+  c10::optional<at::Tensor> tensor_data = CurrentTensorData();
+  if (tensor_data) {
+    size_t size = tensor_data->buffer().size() *
+                  at::internal::GetSizeof(tensor_data->scalar_type());
+    XLA_CHECK_EQ(size, dest_size);
+    std::memcpy(dest, tensor_data->buffer().raw_data(), size);
+    return;
+  }
+  DeviceBarrier(GetDevice());
+  xla::ComputationClient::DataPtr xla_data = GetXlaData();
+  c10::optional<at::Tensor> host_value = GetCachedHostValue(xla_data, dtype());
+  if (host_value) {
+    size_t size = host_value->buffer().size() *
+                  at::internal::GetSizeof(host_value->scalar_type());
+    XLA_CHECK_EQ(size, dest_size);
+    std::memcpy(dest, host_value->buffer().raw_data(), size);
+    return;
+  }
+  XlaDataToBuffer(xla_data, dtype(), dest, dest_size);
+}
+
+void XLATensor::ToSmallBuffer(void* dest, size_t dest_size) {
+  XLA_CHECK_LE(dest_size, kMaxSmallReadBytes);
+  if (CurrentTensorData()) {
+    ToBuffer(dest, dest_size);
+    return;
+  }
+  NoteRead();
+  DeviceBarrier(GetDevice());
+  xla::ComputationClient::DataPtr xla_data = GetXlaData();
+  const xla::Shape& shape = xla_data->shape();
+  xla::PrimitiveType dest_type = TensorTypeToRawXlaType(dtype());
+  if (shape.element_type() != dest_type || !shape.is_static() ||
+      GetCachedHostValue(xla_data, dtype())) {
+    // Conversions, and values already on the host, take the regular path.
+    ToBuffer(dest, dest_size);
+    return;
+  }
+  xla::Shape dest_shape = MakeSwiftTensorLayout(
+      shape.dimensions(), /*dynamic_dimensions=*/{}, dest_type);
+  XLA_CHECK_EQ(xla::ShapeUtil::ByteSizeOf(dest_shape), dest_size);
+  GetSmallReadBatcher(xla_data)->Read(std::move(xla_data),
+                                      std::move(dest_shape), dest);
+}
+
 void XLATensor::ShallowCopyTo(XLATensor* dest) const {
   dest->SetIrValue(GetIrValue());
 }
@@ -829,6 +1760,17 @@ std::vector<xla::ComputationClient::DataPtr> XLATensor::GatherTensorsXlaData(
   return result_tensors_data;
 }
 
+std::vector<at::ScalarType> XLATensor::GetFetchedTypes(
+    const std::vector<XLATensor>& tensors) {
+  std::vector<at::ScalarType> dtypes;
+  for (auto& tensor : tensors) {
+    if (!tensor.CurrentTensorData()) {
+      dtypes.push_back(tensor.dtype());
+    }
+  }
+  return dtypes;
+}
+
 std::vector<at::Tensor> XLATensor::GetTensorsOpByOp(
     std::vector<XLATensor>* tensors) {
   SyncTensorsConfig config;
@@ -846,20 +1788,19 @@ std::vector<at::Tensor> XLATensor::GetTensorsOpByOp(
 
   std::vector<xla::ComputationClient::DataPtr> tensors_data =
       GatherTensorsXlaData(*tensors, coll.indices, async_tensors_data);
-  std::vector<xla::Literal> literals =
-      xla::ComputationClient::TransferFromServer(tensors_data);
+  std::vector<at::Tensor> fetched =
+      DataToTensorsCached(tensors_data, GetFetchedTypes(*tensors));
   std::vector<at::Tensor> results;
-  size_t literals_index = 0;
+  size_t fetched_index = 0;
   results.reserve(tensors->size());
   for (size_t i = 0; i < tensors->size(); ++i) {
     c10::optional<at::Tensor> tensor_data = (*tensors)[i].CurrentTensorData();
     if (tensor_data) {
       results.push_back(*tensor_data);
     } else {
-      XLA_CHECK_LT(literals_index, literals.size());
-      results.push_back(MakeTensorFromXlaLiteral(literals[literals_index],
-                                                 (*tensors)[i].dtype()));
-      ++literals_index;
+      XLA_CHECK_LT(fetched_index, fetched.size());
+      results.push_back(std::move(fetched[fetched_index]));
+      ++fetched_index;
     }
   }
   return results;
@@ -886,25 +1827,152 @@ std::vector<at::Tensor> XLATensor::GetTensorsFused(
           async != nullptr
               ? async->tensors_data
               : absl::Span<const xla::ComputationClient::DataPtr>());
-  std::vector<xla::Literal> literals =
-      xla::ComputationClient::TransferFromServer(tensors_data);
+  std::vector<at::Tensor> fetched =
+      DataToTensorsCached(tensors_data, GetFetchedTypes(*tensors));
   std::vector<at::Tensor> results;
-  size_t literals_index = 0;
+  size_t fetched_index = 0;
   results.reserve(tensors->size());
   for (size_t i = 0; i < tensors->size(); ++i) {
     c10::optional<at::Tensor> tensor_data = (*tensors)[i].CurrentTensorData();
     if (tensor_data) {
       results.push_back(*tensor_data);
     } else {
-      XLA_CHECK_LT(literals_index, literals.size());
-      results.push_back(MakeTensorFromXlaLiteral(literals[literals_index],
-                                                 (*tensors)[i].dtype()));
-      ++literals_index;
+      XLA_CHECK_LT(fetched_index, fetched.size());
+      results.push_back(std::move(fetched[fetched_index]));
+      ++fetched_index;
     }
   }
   return results;
 }
 
+std::future<std::vector<at::Tensor>> XLATensor::GetTensorsAsync(
+    std::vector<XLATensor>* tensors, std::function<void()> on_ready) {
+  SyncTensorsConfig config;
+  config.force_xla_data = false;
+  auto async = SyncTensorsGraphInternal(tensors, {}, config);
+  // The device data of the synced tensors are placeholders, which get their
+  // values once the computation completes.
+  std::vector<xla::ComputationClient::DataPtr> tensors_data =
+      GatherTensorsXlaData(
+          *tensors,
+          async != nullptr ? async->indices : absl::Span<const size_t>(),
+          async != nullptr
+              ? async->tensors_data
+              : absl::Span<const xla::ComputationClient::DataPtr>());
+  std::vector<at::ScalarType> fetched_types = GetFetchedTypes(*tensors);
+  std::vector<c10::optional<at::Tensor>> tensors_host_data;
+  tensors_host_data.reserve(tensors->size());
+  for (auto& tensor : *tensors) {
+    tensors_host_data.push_back(tensor.CurrentTensorData());
+  }
+  auto promise = std::make_shared<std::promise<std::vector<at::Tensor>>>();
+  std::future<std::vector<at::Tensor>> results_future = promise->get_future();
+  auto make_results = [async = std::move(async),
+                       tensors_host_data = std::move(tensors_host_data),
+                       tensors_data = std::move(tensors_data),
+                       fetched_types = std::move(fetched_types)]() mutable {
+    if (async != nullptr) {
+      async->mwait.Wait();
+    }
+    std::vector<c10::optional<at::Tensor>> fetched_values;
+    std::vector<xla::ComputationClient::DataPtr> missing_data =
+        LookupHostValues(tensors_data, fetched_types, &fetched_values);
+    std::vector<xla::Literal> literals;
+    if (!missing_data.empty()) {
+      literals = xla::ComputationClient::TransferFromServer(missing_data);
+    }
+    std::vector<at::Tensor> fetched = CompleteHostValues(
+        tensors_data, fetched_types, std::move(fetched_values), literals);
+    std::vector<at::Tensor> results;
+    size_t fetched_index = 0;
+    results.reserve(tensors_host_data.size());
+    for (size_t i = 0; i < tensors_host_data.size(); ++i) {
+      if (tensors_host_data[i]) {
+        results.push_back(std::move(*tensors_host_data[i]));
+      } else {
+        XLA_CHECK_LT(fetched_index, fetched.size());
+        results.push_back(std::move(fetched[fetched_index]));
+        ++fetched_index;
+      }
+    }
+    return results;
+  };
+  auto fetch = [promise, make_results = std::move(make_results),
+                on_ready = std::move(on_ready)]() mutable {
+    try {
+      promise->set_value(make_results());
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+    if (on_ready != nullptr) {
+      on_ready();
+    }
+  };
+  xla::env::ScheduleIoClosure(std::move(fetch));
+  return results_future;
+}
+
+std::vector<at::Tensor> XLATensor::GetTensorsPacked(
+    std::vector<XLATensor>* tensors) {
+  std::map<at::ScalarType, std::vector<size_t>> type_indices;
+  for (size_t i = 0; i < tensors->size(); ++i) {
+    if (!(*tensors)[i].CurrentTensorData()) {
+      type_indices[(*tensors)[i].dtype()].push_back(i);
+    }
+  }
+  std::vector<XLATensor> fetch_tensors;
+  std::vector<bool> packed_types;
+  for (auto& type_and_indices : type_indices) {
+    const std::vector<size_t>& indices = type_and_indices.second;
+    bool packed = indices.size() > 1 && CanPackTensors(type_and_indices.first);
+    if (packed) {
+      std::vector<ir::Value> values;
+      for (size_t index : indices) {
+        values.push_back((*tensors)[index].GetIrValue());
+      }
+      fetch_tensors.push_back((*tensors)[indices.front()].CreateFrom(
+          ir::Value(ir::ops::PackFlat(values), 0)));
+      XLA_COUNTER("PackedFetchTensors", indices.size());
+    } else {
+      for (size_t index : indices) {
+        fetch_tensors.push_back((*tensors)[index]);
+      }
+    }
+    packed_types.push_back(packed);
+  }
+  std::vector<at::Tensor> fetched = GetTensors(&fetch_tensors);
+
+  std::vector<c10::optional<at::Tensor>> unpacked(tensors->size());
+  size_t fetched_index = 0;
+  size_t type_index = 0;
+  for (auto& type_and_indices : type_indices) {
+    if (packed_types[type_index++]) {
+      int64_t offset = 0;
+      for (size_t index : type_and_indices.second) {
+        xla::util::MaybeRef<xla::Shape> shape = (*tensors)[index].shape();
+        unpacked[index] = SliceFlatTensor(
+            fetched[fetched_index], offset,
+            xla::util::ToVector<int64_t>(shape.get().dimensions()));
+        offset += xla::ShapeUtil::ElementsIn(shape.get());
+      }
+      ++fetched_index;
+    } else {
+      for (size_t index : type_and_indices.second) {
+        unpacked[index] = fetched[fetched_index++];
+      }
+    }
+  }
+  std::vector<at::Tensor> results;
+  results.reserve(tensors->size());
+  for (size_t i = 0; i < tensors->size(); ++i) {
+    c10::optional<at::Tensor> tensor_data =
+        unpacked[i] ? unpacked[i] : (*tensors)[i].CurrentTensorData();
+    XLA_CHECK(tensor_data);
+    results.push_back(std::move(*tensor_data));
+  }
+  return results;
+}
+
 std::vector<XLATensor> XLATensor::CreateTensors(
     const std::vector<at::Tensor>& tensors,
     const std::vector<std::string>& devices) {
@@ -926,7 +1994,8 @@ std::vector<XLATensor> XLATensor::CreateTensors(
 
 ir::Value XLATensor::CreateTensorNode(xla::ComputationClient::DataPtr data,
                                       bool read_only) const {
-  data->SetInfo(std::make_shared<DeviceDataInfo>(GetUniqueId(), read_only));
+  data->SetInfo(std::make_shared<DeviceDataInfo>(GetUniqueId(), read_only,
+                                                 IsFrozenDeviceData(*data)));
   return ir::MakeNode<ir::ops::DeviceData>(std::move(data));
 }
 
@@ -940,7 +2009,20 @@ std::vector<XLATensor> XLATensor::MakeOutputTensors(ir::NodePtr node) const {
 }
 
 XLATensor XLATensor::CopyTensorToDevice(const Device& device) {
-  // TODO: This can be optimized via proper XRT/XLA computation.
+  // A tensor already on the host only needs the upload, otherwise try a
+  // direct copy before going through the host. Data still being computed
+  // asynchronously goes through the host too, whose download waits for it.
+  xla::ComputationClient::DataPtr current_data = CurrentXlaData();
+  if (!CurrentTensorData() && device != GetDevice() &&
+      (current_data == nullptr || current_data->HasValue())) {
+    xla::ComputationClient::DataPtr xla_data =
+        xla::GetX10Device(GetDevice())
+            ->CopyToDevice(GetXlaData(), xla::GetX10Device(device));
+    if (xla_data != nullptr) {
+      XLA_COUNTER("DeviceToDeviceCopies", 1);
+      return Create(std::move(xla_data), dtype());
+    }
+  }
   return Create(ToTensor(/*detached=*/true), device);
 }
 
@@ -1006,7 +2088,7 @@ XLATensor::SyncTensorCollection XLATensor::CollectSyncTensors(
              << " ...";
   {
     XLA_TIMED("DeviceLockWait");
-    coll.unlocker = LockDevices(unique_device.AsSet());
+    coll.unlocker = LockDevices(unique_device.AsSet(), &coll.wait_turn);
   }
   TF_VLOG(4) << "Waiting on device barrier for device " << coll.device
              << " done!";
@@ -1041,8 +2123,11 @@ XLATensor::SyncTensorCollection XLATensor::CollectSyncTensors(
       // If we are here, it means that the IR Value for the tensor is not
       // present. Also, we uploaded the at::Tensor data to the device, but such
       // data is still valid so we leave it live on the XLA tensor (so that a
-      // following ToTensor() does not need to fetch it from device).
+      // following ToTensor() does not need to fetch it from device), unless
+      // it borrows its scalars.
       tensors[at_tensor_index[i]].data()->xla_data = std::move(handles[i]);
+      tensors[at_tensor_index[i]].Register();
+      tensors[at_tensor_index[i]].ReleaseBorrowedTensorData();
     }
   }
   TF_VLOG(4) << "Tensors graph hash " << xla::util::HexHash(coll.hash)
@@ -1056,15 +2141,15 @@ XLATensor::ComputationCache::TypePtr XLATensor::LookupCachedCompile(
       GetComputationCache()->Get(hash);
   if (cached_computation == nullptr) {
     XLA_COUNTER("UncachedCompile", 1);
+    Tracelets::RecordCompileLookup(/*cached=*/false);
     return nullptr;
   }
   TF_VLOG(5) << "Graph hash " << xla::util::HexHash(hash)
              << " is computation hash "
-             << xla::util::HexHash(xla::util::Hash(
-                    cached_computation->computation->computation()
-                        .proto()
-                        .SerializeAsString()));
+             << xla::util::HexHash(
+                    cached_computation->computation->fingerprint());
   XLA_COUNTER("CachedCompile", 1);
+  Tracelets::RecordCompileLookup(/*cached=*/true);
   return cached_computation;
 }
 
@@ -1085,40 +2170,229 @@ std::shared_ptr<XLATensor::Async> XLATensor::TryRunCachedSync(
 }
 
 XLATensor::ComputationCache* XLATensor::GetComputationCache() {
-  static const size_t kMaxCacheSize =
-      xla::sys_util::GetEnvInt("XLA_COMPILATION_CACHE_SIZE", 1024);
-  static ComputationCache* cache = new ComputationCache(kMaxCacheSize);
+  static ComputationCache* cache = CreateComputationCache("CompilationCache");
+  return cache;
+}
+
+XLATensor::ComputationCache* XLATensor::GetGraphHashCache() {
+  static ComputationCache* cache = CreateComputationCache("GraphHashCache");
   return cache;
 }
 
+XLATensor::ComputationCache* XLATensor::CreateComputationCache(
+    const std::string& name) {
+  static const size_t max_cache_size =
+      xla::sys_util::GetEnvInt("XLA_COMPILATION_CACHE_SIZE", 1024);
+  static const size_t max_cache_bytes =
+      xla::sys_util::GetEnvInt("XLA_COMPILATION_CACHE_BYTES", 0);
+  static const std::string policy =
+      xla::sys_util::GetEnvString("XLA_COMPILATION_CACHE_POLICY", "lru");
+  XLA_CHECK(policy == "lru" || policy == "gdsf")
+      << "Invalid XLA_COMPILATION_CACHE_POLICY: " << policy;
+  // The size of a computation is the one of its HLO, which is what the caches
+  // know about, and tracks the size of the compiled executable.
+  ComputationCache::SizeFn size_fn =
+      [](const CachedComputation& cached_computation) -> size_t {
+    return cached_computation.computation->computation_bytes();
+  };
+  ComputationCache::CostFn cost_fn;
+  if (policy == "gdsf") {
+    cost_fn = [](const CachedComputation& cached_computation) -> double {
+      return std::max<int64_t>(cached_computation.compile_time_ns, 1);
+    };
+  }
+  return new ComputationCache(max_cache_size, GetCacheShards(), name,
+                              max_cache_bytes, std::move(size_fn),
+                              std::move(cost_fn));
+}
+
+std::shared_ptr<XLATensor::Async> XLATensor::TryRunCachedSyncFast(
+    std::vector<XLATensor>* tensors, SyncTensorCollection* coll) {
+  static const bool fast_lookup =
+      xla::sys_util::GetEnvBool("XLA_FAST_CACHE_LOOKUP", false);
+  // Tracelets need the full post-order to look for cutpoints.
+  if (!fast_lookup || Tracelets::IsEnabled()) {
+    return nullptr;
+  }
+  ComputationCache::TypePtr cached_computation =
+      GetGraphHashCache()->Get(coll->hash);
+  if (cached_computation == nullptr ||
+      cached_computation->parameter_paths == nullptr) {
+    return nullptr;
+  }
+  std::vector<const ir::Node*> roots;
+  roots.reserve(coll->indices.size());
+  for (auto index : coll->indices) {
+    roots.push_back((*tensors)[index].CurrentIrValue().node.get());
+  }
+  std::vector<const ir::Node*> nodes = ir::Util::ResolveNodePaths(
+      roots, *cached_computation->parameter_paths);
+  if (nodes.size() != cached_computation->parameter_paths->num_targets) {
+    XLA_COUNTER("FastCacheLookupMismatch", 1);
+    return nullptr;
+  }
+  // The graph hash does not tell apart the graphs which only differ in how
+  // they share their subexpressions (like a * a and (x + y) * (z + w), with
+  // a = x + y), as the device data nodes hash by shape. The paths of one of
+  // them would then resolve to a subset of the device data of the other, so
+  // the sharing, and the resolved device data being all of them, get checked.
+  std::vector<const ir::Node*> post_order = ir::Util::ComputePostOrder(roots);
+  if (post_order.size() != cached_computation->graph_size ||
+      ir::Util::ComputeSharingHash(post_order) !=
+          cached_computation->sharing_hash) {
+    XLA_COUNTER("FastCacheLookupMismatch", 1);
+    return nullptr;
+  }
+  size_t device_data_count = 0;
+  for (auto node : post_order) {
+    if (ir::ops::DeviceData::Cast(node) != nullptr) {
+      if (device_data_count >= nodes.size() ||
+          nodes[device_data_count] != node) {
+        XLA_COUNTER("FastCacheLookupMismatch", 1);
+        return nullptr;
+      }
+      ++device_data_count;
+    }
+  }
+  if (device_data_count != nodes.size()) {
+    XLA_COUNTER("FastCacheLookupMismatch", 1);
+    return nullptr;
+  }
+  PostOrderData po_data;
+  CollectParametersData(nodes, &po_data);
+  if (po_data.parameter_sequence != cached_computation->parameter_sequence) {
+    // Same graph, but with a different parameters aliasing.
+    XLA_COUNTER("FastCacheLookupMismatch", 1);
+    return nullptr;
+  }
+  std::vector<ParameterAlias> parameter_aliases = ComputeParameterAliases(
+      *tensors, *coll, coll->hash, po_data.parameters_data);
+  if (parameter_aliases != cached_computation->parameter_aliases) {
+    // Same graph, but with different buffers being donated.
+    XLA_COUNTER("FastCacheLookupMismatch", 1);
+    return nullptr;
+  }
+  coll->parameter_aliases = std::move(parameter_aliases);
+  coll->hash = xla::util::HashCombine(
+      coll->hash, xla::util::Hash(po_data.parameter_sequence));
+  coll->hash = HashParameterAliases(coll->hash, coll->parameter_aliases);
+  XLA_COUNTER("CachedCompile", 1);
+  XLA_COUNTER("FastCachedCompile", 1);
+  XLA_VALUE_METRIC("TensorsGraphSize", cached_computation->graph_size);
+  TF_VLOG(5) << "TensorsGraphSize=" << cached_computation->graph_size;
+
+  return ScheduleSyncTensorsGraph(
+      tensors, coll, std::move(po_data.parameters_data),
+      coll->device.ToString(), std::move(cached_computation));
+}
+
+void XLATensor::RegisterCachedGraph(const std::vector<XLATensor>& tensors,
+                                    const SyncTensorCollection& coll,
+                                    const xla::hash_t& graph_hash,
+                                    const PostOrderData& po_data,
+                                    CachedComputation* cached_computation) {
+  std::vector<const ir::Node*> roots;
+  roots.reserve(coll.indices.size());
+  for (auto index : coll.indices) {
+    roots.push_back(tensors[index].CurrentIrValue().node.get());
+  }
+  std::vector<const ir::Node*> device_data_nodes;
+  for (auto node : po_data.post_order) {
+    if (ir::ops::DeviceData::Cast(node) != nullptr) {
+      device_data_nodes.push_back(node);
+    }
+  }
+  cached_computation->parameter_paths = std::make_shared<ir::NodePaths>(
+      ir::Util::ComputeNodePaths(roots, device_data_nodes));
+  cached_computation->parameter_sequence = po_data.parameter_sequence;
+  cached_computation->parameter_aliases = coll.parameter_aliases;
+  cached_computation->graph_size = po_data.post_order.size();
+  cached_computation->sharing_hash =
+      ir::Util::ComputeSharingHash(po_data.post_order);
+}
+
 XLATensor::PostOrderData XLATensor::RunPostOrder(
     const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices) {
+  return RunPostOrder(CollectRoots(tensors, indices));
+}
+
+XLATensor::PostOrderData XLATensor::RunPostOrder(
+    absl::Span<const ir::Value> ir_values) {
+  xla::trace::ScopedEvent trace_event("RunPostOrder");
   std::vector<const ir::Node*> roots;
-  roots.reserve(indices.size());
-  for (auto index : indices) {
-    ir::Value ir_value = tensors.at(index).CurrentIrValue();
+  roots.reserve(ir_values.size());
+  for (auto& ir_value : ir_values) {
     roots.push_back(ir_value.node.get());
   }
   PostOrderData po_data;
-  po_data.post_order = ir::Util::ComputePostOrder(roots, &po_data.emission_map);
+  po_data.post_order = ir::Util::ComputePostOrder(roots);
+  CollectParametersData(po_data.post_order, &po_data);
+  return po_data;
+}
+
+void XLATensor::PromoteScalars(std::vector<XLATensor>* tensors,
+                               SyncTensorCollection* coll,
+                               const PostOrderData& po_data,
+                               absl::Span<const size_t> positions) {
+  ir::OutputMap<ir::Value> replacements;
+  for (size_t position : positions) {
+    const ir::Node* node = po_data.post_order[position];
+    xla::PrimitiveType type = node->shape().element_type();
+    at::ScalarType scalar_type = TensorTypeFromXlaType(type);
+    const ir::ops::Scalar* scalar =
+        dynamic_cast<const ir::ops::Scalar*>(node);
+    const ir::ops::Constant* constant =
+        dynamic_cast<const ir::ops::Constant*>(node);
+    XLA_CHECK(scalar != nullptr || constant != nullptr)
+        << "Not a scalar constant: " << *node;
+    at::Scalar value =
+        scalar != nullptr
+            ? scalar->value()
+            : MakeTensorFromXlaLiteral(constant->value(), scalar_type).item();
+    xla::ComputationClient::DataPtr data =
+        GetDeviceData(value, scalar_type, coll->device);
+    data->SetInfo(std::make_shared<DeviceDataInfo>(/*tensor_id=*/-1,
+                                                   /*read_only=*/true));
+    ir::Value ir_value = ir::MakeNode<ir::ops::DeviceData>(std::move(data));
+    if (node->shape().rank() > 0) {
+      ir_value = ir::MakeNode<ir::ops::Expand>(
+          ir_value, xla::util::ToVector<int64_t>(node->shape().dimensions()));
+    }
+    replacements.emplace(ir::Output(node), std::move(ir_value));
+  }
+  std::vector<ir::Value> roots =
+      ir::Util::CloneWithReplacements(CollectRoots(*tensors, coll->indices),
+                                      replacements);
+  // Same as CollectSyncTensors(), over the new IR values.
+  coll->hash = xla::util::MHash(coll->config.force_xla_data);
+  for (size_t i = 0; i < roots.size(); ++i) {
+    coll->hash = xla::util::HashCombine(coll->hash, roots[i].hash());
+    (*tensors)[coll->indices[i]].AssignIrValue(std::move(roots[i]));
+  }
+  coll->hash = xla::util::MHash(
+      coll->hash, xla::GetX10Device(coll->device)->ResourceDomain());
+  XLA_COUNTER("PromotedScalars", positions.size());
+}
+
+void XLATensor::CollectParametersData(absl::Span<const ir::Node* const> nodes,
+                                      PostOrderData* po_data) {
   absl::node_hash_map<xla::ComputationClient::Data::OpaqueHandle, size_t>
       data_handles;
-  for (auto node : po_data.post_order) {
+  for (auto node : nodes) {
     const ir::ops::DeviceData* device_data = ir::ops::DeviceData::Cast(node);
     if (device_data != nullptr) {
       xla::ComputationClient::Data::OpaqueHandle handle =
           device_data->data()->GetOpaqueHandle();
       auto it = data_handles.find(handle);
       if (it != data_handles.end()) {
-        po_data.parameter_sequence.push_back(it->second);
+        po_data->parameter_sequence.push_back(it->second);
       } else {
-        po_data.parameter_sequence.push_back(po_data.parameters_data.size());
-        data_handles[handle] = po_data.parameters_data.size();
-        po_data.parameters_data.push_back(device_data->data());
+        po_data->parameter_sequence.push_back(po_data->parameters_data.size());
+        data_handles[handle] = po_data->parameters_data.size();
+        po_data->parameters_data.push_back(device_data->data());
       }
     }
   }
-  return po_data;
 }
 
 std::vector<ir::Value> XLATensor::CollectRoots(
@@ -1170,15 +2444,27 @@ std::shared_ptr<XLATensor::Async> XLATensor::ScheduleSyncTensorsGraph(
       coll, std::move(parameters_data), std::move(tensors_data),
       std::move(cached_computation));
 
-  auto syncfn = [async, hash = coll->hash]() {
+  auto syncfn = [async, hash = coll->hash,
+                 priority = g_tls_data.execute_priority]() {
     xla::ComputationClient::ExecuteComputationOptions options;
+    options.priority = priority;
     try {
+      {
+        xla::trace::ScopedEvent trace_event("WaitExecutionTurn");
+        async->wait_turn();
+      }
+      xla::trace::ScopedEvent trace_event("ExecuteGraph");
       TF_VLOG(3) << "Executing IR graph hash " << xla::util::HexHash(hash)
                  << " on device " << async->device << " ...";
+      int64_t start_ns = xla::sys_util::NowNs();
       auto results =
           xla::GetX10Device(async->device)
               ->ExecuteComputation(*async->cached_computation->computation,
                                    async->parameters_data, options);
+      GraphProfiler::RecordExecution(
+          hash, async->device, async->cached_computation->computation,
+          async->cached_computation->compile_time_ns, async->parameters_data,
+          results, start_ns, xla::sys_util::NowNs());
       TF_VLOG(3) << "Executing IR graph hash " << xla::util::HexHash(hash)
                  << " on device " << async->device << " done!";
 
@@ -1215,6 +2501,8 @@ std::shared_ptr<XLATensor::Async> XLATensor::ScheduleSyncTensorsGraph(
     std::vector<XLATensor>* tensors, SyncTensorCollection* coll,
     std::vector<xla::ComputationClient::DataPtr> parameters_data,
     std::string device, ComputationCache::TypePtr cached_computation) {
+  xla::trace::ScopedEvent trace_event("ScheduleSyncTensorsGraph");
+  MaybeRecompileOptimized(coll->hash, coll->device, cached_computation);
   auto tensors_data = FetchTensorData(tensors, coll->config, coll->indices);
   return ScheduleSyncTensorsGraph(coll, std::move(parameters_data),
                                   std::move(tensors_data),
@@ -1236,6 +2524,7 @@ void XLATensor::SyncTensorsGraph(std::vector<XLATensor>* tensors,
   } else {
     auto async = SyncTensorsGraphInternal(tensors, devices, config);
     if (wait && async != nullptr) {
+      xla::trace::ScopedEvent trace_event("WaitSyncTensorsGraph");
       async->mwait.Wait();
     }
   }
@@ -1245,6 +2534,52 @@ void XLATensor::SyncLiveTensorsGraph(const Device* device,
                                      absl::Span<const std::string> devices,
                                      bool wait) {
   auto tensors = GetLiveTensors(device);
+  if (IsPerThreadSyncEnabled()) {
+    // Leave alone the tensors whose pending IR is being traced by the other
+    // threads, as reading their state would race with the tracing.
+    int64_t thread = GetTraceThreadId();
+    tensors.erase(std::remove_if(tensors.begin(), tensors.end(),
+                                 [&](const XLATensor& tensor) {
+                                   int64_t trace_thread =
+                                       tensor.data()->trace_thread.load(
+                                           std::memory_order_relaxed);
+                                   return trace_thread != 0 &&
+                                          trace_thread != thread;
+                                 }),
+                  tensors.end());
+  }
+  if (IsSkipUnreadLiveTensorsEnabled()) {
+    // The pending tensors which, at the previous steps, went unread after the
+    // sync until they got destroyed (like debug copies) are left pending. They
+    // are still computed if read, which in turn puts them back in the syncs.
+    // The IR hash alone does not identify a tensor across the steps, as the
+    // device data nodes hash by shape (all the same shaped per-layer updates
+    // share it), so it is paired with the creation rank of the tensor among
+    // the live ones with that hash.
+    size_t skipped = 0;
+    absl::flat_hash_map<xla::hash_t, size_t> hash_ranks;
+    tensors.erase(
+        std::remove_if(tensors.begin(), tensors.end(),
+                       [&](const XLATensor& tensor) {
+                         ir::Value ir_value = tensor.CurrentIrValue();
+                         if (!ir_value) {
+                           return false;
+                         }
+                         uint64_t key = absl::Uint128Low64(xla::util::MHash(
+                             ir_value.hash(), hash_ranks[ir_value.hash()]++));
+                         ColdData* cold_data = tensor.data()->GetColdData();
+                         cold_data->barrier_key = key;
+                         cold_data->barrier_read = false;
+                         cold_data->barrier_tracked = true;
+                         if (!GetUnreadTensorTable()->Contains(key)) {
+                           return false;
+                         }
+                         ++skipped;
+                         return true;
+                       }),
+        tensors.end());
+    XLA_COUNTER("SkippedUnreadLiveTensors", skipped);
+  }
   if (tensors.empty()) {
     return;
   }
@@ -1255,9 +2590,117 @@ void XLATensor::SyncLiveTensorsGraph(const Device* device,
 
 void XLATensor::MarkStep(const Device* device) {
   XLA_COUNTER("MarkStep", 1);
+  SpillColdTensors(device);
+  xla::device_activity::RecordStep();
+  xla::metrics::RecordStepMetrics();
+  DebugUtil::SaveGraphProfileReport();
   DeviceContextArena::Get()->StepRngSeed(device);
+  Tracelets::MarkStep();
   ir::ScopePusher::ResetScopes();
   g_tls_data.Reset();
+  ir::NodePool::Trim();
+}
+
+void XLATensor::SpillColdTensors(const Device* device) {
+  static const double spill_fraction =
+      xla::sys_util::GetEnvDouble("XLA_SPILL_MEMORY_FRACTION", 0.0);
+  static const int64_t min_idle_steps =
+      xla::sys_util::GetEnvInt("XLA_SPILL_MIN_IDLE_STEPS", 2);
+  if (spill_fraction <= 0) {
+    return;
+  }
+  int64_t epoch = g_spill_epoch.fetch_add(1) + 1;
+  std::vector<XLATensor> live_tensors =
+      DeviceContextArena::Get()->GetLiveTensors(device);
+  std::map<Device, std::vector<XLATensor>> device_candidates;
+  int64_t thread = GetTraceThreadId();
+  for (auto& tensor : live_tensors) {
+    Data* data = tensor.data();
+    // The tensors traced, read or created by the other threads are left
+    // alone, as those can be reading the device data concurrently.
+    int64_t trace_thread = data->trace_thread.load(std::memory_order_relaxed);
+    if ((trace_thread != 0 && trace_thread != thread) ||
+        data->use_thread.load() != thread) {
+      continue;
+    }
+    // Only the tensors which alone hold their device data free memory when
+    // dropping it, and the ones with a pending IR value or a host copy are
+    // left alone.
+    if (data->xla_data == nullptr || data->xla_data.use_count() != 1 ||
+        !data->xla_data->HasValue() || data->ir_value || data->tensor_data ||
+        epoch - data->last_use.load() < min_idle_steps) {
+      continue;
+    }
+    device_candidates[tensor.GetDevice()].push_back(tensor);
+  }
+  for (auto& device_and_candidates : device_candidates) {
+    const Device& spill_device = device_and_candidates.first;
+    std::vector<XLATensor>& candidates = device_and_candidates.second;
+    xla::ComputationClient::MemoryInfo memory_info =
+        xla::GetX10Device(spill_device.ToString())->GetMemoryInfo();
+    if (memory_info.bytes_in_use < 0 || memory_info.bytes_limit <= 0) {
+      continue;
+    }
+    int64_t excess_bytes =
+        memory_info.bytes_in_use -
+        static_cast<int64_t>(spill_fraction * memory_info.bytes_limit);
+    if (excess_bytes <= 0) {
+      continue;
+    }
+    // The least recently read first, and the oldest among them.
+    std::sort(candidates.begin(), candidates.end(),
+              [](const XLATensor& a, const XLATensor& b) {
+                int64_t a_use = a.data()->last_use.load();
+                int64_t b_use = b.data()->last_use.load();
+                return a_use != b_use ? a_use < b_use
+                                      : a.GetUniqueId() < b.GetUniqueId();
+              });
+    static xla::metrics::Metric* spill_metric =
+        new xla::metrics::Metric("SpillTime", xla::metrics::MetricFnTime);
+    xla::metrics::TimedSection timed(spill_metric);
+    std::vector<xla::ComputationClient::DataPtr> spill_data;
+    std::vector<at::ScalarType> spill_types;
+    int64_t spill_bytes = 0;
+    size_t count = 0;
+    for (; count < candidates.size() && spill_bytes < excess_bytes; ++count) {
+      spill_data.push_back(candidates[count].data()->xla_data);
+      spill_types.push_back(candidates[count].dtype());
+      spill_bytes += xla::ShapeUtil::ByteSizeOf(spill_data.back()->shape());
+    }
+    TF_VLOG(3) << "Spilling " << count << " tensors (" << spill_bytes
+               << " bytes) of device " << spill_device;
+    std::vector<at::Tensor> values =
+        DataToTensorsCached(spill_data, spill_types);
+    spill_data.clear();
+    size_t spilled = 0;
+    spill_bytes = 0;
+    for (size_t i = 0; i < count; ++i) {
+      Data* data = candidates[i].data();
+      // Another thread may have picked the tensor up during the download.
+      if (data->use_thread.load() != thread) {
+        continue;
+      }
+      spill_bytes += xla::ShapeUtil::ByteSizeOf(data->xla_data->shape());
+      data->tensor_data = std::move(values[i]);
+      ReleaseHostValue(data->xla_data);
+      data->xla_data = nullptr;
+      data->GetColdData()->spilled = true;
+      ++spilled;
+    }
+    XLA_COUNTER("SpilledTensors", spilled);
+    XLA_COUNTER("SpilledBytes", spill_bytes);
+  }
+}
+
+void XLATensor::NoteSpillReload() const {
+  ColdData* cold_data = data()->cold.load(std::memory_order_acquire);
+  if (cold_data != nullptr && cold_data->spilled) {
+    cold_data->spilled = false;
+    XLA_COUNTER("SpillReloads", 1);
+    XLA_COUNTER("SpillReloadBytes",
+                at::internal::GetSizeof(data()->tensor_data->scalar_type()) *
+                    data()->tensor_data->buffer().size());
+  }
 }
 
 XLATensor::OpByOpAsync XLATensor::SyncTensorsGraphOpByOp(
@@ -1291,6 +2734,7 @@ XLATensor::OpByOpAsync XLATensor::SyncTensorsGraphOpByOp(
   auto syncfn = [async]() -> xla::Status {
     xla::Status status;
     try {
+      async->coll.wait_turn();
       TF_VLOG(3) << "Executing (OpByOp) IR graph hash "
                  << xla::util::HexHash(async->coll.hash) << " on device "
                  << async->coll.device << " ...";
@@ -1318,245 +2762,701 @@ XLATensor::OpByOpAsync XLATensor::SyncTensorsGraphOpByOp(
   return async_op.Schedule();
 }
 
-void XLATensor::BuildInputOutputAliases(const std::vector<XLATensor>& tensors,
-                                        absl::Span<const size_t> indices,
-                                        ir::LoweringContext* lowering_ctx) {
-  absl::node_hash_map<int64_t, size_t> output_tensor_id_map;
-  for (size_t i = 0; i < indices.size(); ++i) {
-    size_t tensor_index = indices[i];
-    int64_t tensor_id = tensors[tensor_index].GetUniqueId();
-    output_tensor_id_map[tensor_id] = i;
+std::vector<XLATensor::ParameterAlias> XLATensor::ComputeParameterAliases(
+    const std::vector<XLATensor>& tensors, const SyncTensorCollection& coll,
+    const xla::hash_t& graph_hash,
+    absl::Span<const xla::ComputationClient::DataPtr> parameters_data) {
+  std::vector<ParameterAlias> parameter_aliases;
+  // We can only alias at the step barrier, when force_xla_data is true.
+  // Consider the case:
+  //   1. Tensor A(DEVICE_DATA)
+  //   2. Tensor B = A + 0.9
+  //   3. A += 0.4
+  // If we activate aliasing for A's graph, and we do:
+  //   print(A)
+  //   print(A)
+  // The first print will update DEVICE_DATA' with DEVICE_DATA+0.4, and
+  // the second print will again update DEVICE_DATA" with
+  // DEVICE_DATA'+0.4, which will lead to incorrect results.
+  // When we issue a step barrier (force_xla_data == true) the synced tensors
+  // get turned into DEVICE_DATA, so their graphs are not run again. The
+  // tensors of the device which are not part of the sync (like B above, unless
+  // we sync all live tensors) can still reference the parameters, either as
+  // their device data or within their pending graphs, and their buffers must
+  // be left alone. Tensors do not have view sources whose updates need to be
+  // reflected (like in PyTorch), so once the above are excluded, the non
+  // read-only parameters are dead after the computation.
+  if (!IsParamAliasingEnabled() || !coll.config.sync_xla_data ||
+      IsParamAliasingExcluded(graph_hash)) {
+    return parameter_aliases;
+  }
+  std::vector<XLATensor> live_tensors = GetLiveTensors(&coll.device);
+  // While other threads have pending IR on the device, the parameters could be
+  // picked up by a graph they are tracing, which the pinning below cannot see
+  // without racing with them.
+  if (IsPerThreadSyncEnabled()) {
+    int64_t thread = GetTraceThreadId();
+    for (auto& tensor : live_tensors) {
+      int64_t trace_thread =
+          tensor.data()->trace_thread.load(std::memory_order_relaxed);
+      if (trace_thread != 0 && trace_thread != thread) {
+        XLA_COUNTER("ParamAliasingMultiThreadSkip", 1);
+        return parameter_aliases;
+      }
+    }
   }
-  const std::vector<xla::ComputationClient::DataPtr>& parameters_data =
-      lowering_ctx->GetParametersData();
-  std::vector<ssize_t> alias_map(indices.size(), -1);
+  absl::flat_hash_set<int64_t> synced_ids;
+  for (auto index : coll.indices) {
+    synced_ids.insert(tensors[index].GetUniqueId());
+  }
+  absl::flat_hash_set<const xla::ComputationClient::Data*> pinned_data;
+  absl::flat_hash_set<xla::ComputationClient::Data::OpaqueHandle>
+      pinned_handles;
+  auto pin_data = [&](const xla::ComputationClient::DataPtr& data) {
+    pinned_data.insert(data.get());
+    if (data->HasValue()) {
+      pinned_handles.insert(data->GetOpaqueHandle());
+    }
+  };
+  for (auto& tensor : live_tensors) {
+    if (synced_ids.contains(tensor.GetUniqueId())) {
+      continue;
+    }
+    xla::ComputationClient::DataPtr xla_data = tensor.CurrentXlaData();
+    if (xla_data != nullptr) {
+      pin_data(xla_data);
+    }
+    ir::Value ir_value = tensor.CurrentIrValue();
+    if (ir_value) {
+      for (auto node : ir::Util::ComputePostOrder({ir_value.node.get()})) {
+        const ir::ops::DeviceData* device_data =
+            ir::ops::DeviceData::Cast(node);
+        if (device_data != nullptr) {
+          pin_data(device_data->data());
+        }
+      }
+    }
+  }
+
+  // Outputs available for donation, bucketed by shape. In-place updates,
+  // where the output tensor is the one owning the parameter, are matched
+  // first.
+  absl::flat_hash_map<int64_t, size_t> output_ids;
+  std::map<xla::hash_t, std::vector<size_t>> output_buckets;
+  std::vector<xla::Shape> output_shapes;
+  output_shapes.reserve(coll.indices.size());
+  for (size_t i = 0; i < coll.indices.size(); ++i) {
+    const XLATensor& tensor = tensors[coll.indices[i]];
+    output_ids[tensor.GetUniqueId()] = i;
+    output_shapes.push_back(tensor.shape());
+  }
+  // Reversed, so that the lowest output indices sit at the buckets back.
+  for (size_t i = coll.indices.size(); i > 0; --i) {
+    output_buckets[GetShapeDimensionsHash(output_shapes[i - 1])].push_back(
+        i - 1);
+  }
+  std::vector<bool> donated_outputs(coll.indices.size(), false);
+  int64_t donated_bytes = 0;
   for (size_t i = 0; i < parameters_data.size(); ++i) {
-    DeviceDataInfo* data_info =
-        dynamic_cast<DeviceDataInfo*>(parameters_data[i]->info());
-    if (data_info != nullptr && !data_info->read_only) {
-      auto it = output_tensor_id_map.find(data_info->tensor_id);
-      if (it != output_tensor_id_map.end()) {
-        size_t output_index = it->second;
-        xla::XlaOp root = lowering_ctx->GetResult(output_index);
-        const xla::Shape& root_shape = XlaHelpers::ShapeOfXlaOp(root);
-        if (parameters_data[i]->shape() == root_shape &&
-            alias_map[output_index] < 0) {
-          lowering_ctx->builder()->SetUpAlias(
-              {static_cast<int64_t>(output_index)}, i, {});
-          alias_map[output_index] = i;
-
-          TF_VLOG(6) << "Aliased paramter " << i << " with output "
-                     << output_index << ": " << parameters_data[i]->shape();
+    const xla::ComputationClient::DataPtr& data = parameters_data[i];
+    DeviceDataInfo* data_info = dynamic_cast<DeviceDataInfo*>(data->info());
+    if (data_info == nullptr || data_info->read_only ||
+        pinned_data.contains(data.get()) ||
+        (data->HasValue() &&
+         pinned_handles.contains(data->GetOpaqueHandle()))) {
+      continue;
+    }
+    absl::optional<size_t> output_index;
+    auto id_it = output_ids.find(data_info->tensor_id);
+    if (id_it != output_ids.end() && !donated_outputs[id_it->second] &&
+        xla::ShapeUtil::Compatible(data->shape(),
+                                   output_shapes[id_it->second])) {
+      output_index = id_it->second;
+    } else {
+      auto bucket_it =
+          output_buckets.find(GetShapeDimensionsHash(data->shape()));
+      if (bucket_it != output_buckets.end()) {
+        std::vector<size_t>& bucket = bucket_it->second;
+        while (!bucket.empty() && donated_outputs[bucket.back()]) {
+          bucket.pop_back();
+        }
+        if (!bucket.empty() &&
+            xla::ShapeUtil::Compatible(data->shape(),
+                                       output_shapes[bucket.back()])) {
+          output_index = bucket.back();
+          bucket.pop_back();
         }
       }
     }
+    if (output_index) {
+      donated_outputs[*output_index] = true;
+      parameter_aliases.push_back({i, *output_index});
+      donated_bytes += xla::ShapeUtil::ByteSizeOf(data->shape());
+    }
   }
-  XLA_VALUE_METRIC("InputOutputAliasCount", alias_map.size());
+  XLA_VALUE_METRIC("DonatedParameterBytes", donated_bytes);
+  TF_VLOG(4) << "Donating " << parameter_aliases.size() << " parameters ("
+             << donated_bytes << " bytes) for graph hash "
+             << xla::util::HexHash(graph_hash);
+  return parameter_aliases;
+}
+
+void XLATensor::BuildInputOutputAliases(
+    absl::Span<const ParameterAlias> parameter_aliases,
+    ir::LoweringContext* lowering_ctx) {
+  const std::vector<xla::ComputationClient::DataPtr>& parameters_data =
+      lowering_ctx->GetParametersData();
+  size_t alias_count = 0;
+  for (const ParameterAlias& alias : parameter_aliases) {
+    const xla::Shape& parameter_shape =
+        parameters_data[alias.parameter_index]->shape();
+    xla::XlaOp root = lowering_ctx->GetResult(alias.output_index);
+    const xla::Shape& root_shape = XlaHelpers::ShapeOfXlaOp(root);
+    if (parameter_shape == root_shape) {
+      lowering_ctx->builder()->SetUpAlias(
+          {static_cast<int64_t>(alias.output_index)}, alias.parameter_index,
+          {});
+      ++alias_count;
+
+      TF_VLOG(6) << "Aliased paramter " << alias.parameter_index
+                 << " with output " << alias.output_index << ": "
+                 << parameter_shape;
+    }
+  }
+  XLA_VALUE_METRIC("InputOutputAliasCount", alias_count);
 }
 
 XLATensor::CompilationResult XLATensor::Compile(
     const std::vector<XLATensor>& tensors,
     absl::Span<const std::string> devices, const SyncTensorCollection& coll,
-    PostOrderData* po_data) {
-  static const bool enable_aliasing =
-      xla::sys_util::GetEnvBool("XLA_ENABLE_PARAM_ALIASING", false);
-  xla::util::Unique<Device> unique_device;
-  ir::RootLoweringContext lowering_ctx("SyncTensorsGraph", coll.device,
-                                       po_data->post_order,
-                                       std::move(po_data->emission_map));
-  for (auto index : coll.indices) {
-    ir::Value ir_value = tensors[index].CurrentIrValue();
-    xla::XlaOp root = lowering_ctx.GetOutputOp(ir_value);
-    lowering_ctx.AddResult(root);
-    unique_device.set(tensors[index].GetDevice());
-  }
-  if (enable_aliasing && coll.config.sync_xla_data) {
-    // We can only alias at the step barrier, when force_xla_data is true.
-    // Consider the case:
-    //   1. Tensor A(DEVICE_DATA)
-    //   2. Tensor B = A + 0.9
-    //   3. A += 0.4
-    // If we activate aliasing for A's graph, and we do:
-    //   print(A)
-    //   print(A)
-    // The first print will update DEVICE_DATA' with DEVICE_DATA+0.4, and the
-    // second print will again update DEVICE_DATA" with DEVICE_DATA'+0.4, which
-    // will lead to incorrect results.
-    // We cannot normally turn A's state into DEVICE_DATA, as if any of the
-    // sources is a view, this will not lead to correct results (as A's value
-    // taken at different times need to reflect view source changes):
-    //   1. Tensor A = some_graph_with_view_source(V)
-    //   2. print(A)
-    //   3. V += 1
-    //   4. print(A)
-    // The second print should reflect the new value due to V's changes.
-    // Also in the first example, unless we are doing a step barrier and hence
-    // include all live tensors, if the B value is not part of the graph, it
-    // will later fetch the new value of A, which is incorrect.
-    // But, when we issue a step barrier (force_xla_data == true) we have to
-    // turn everything into DEVICE_DATA, so we can activate aliasing.
-    BuildInputOutputAliases(tensors, coll.indices, &lowering_ctx);
-  }
-
-  xla::XlaComputation computation = ConsumeValue(lowering_ctx.Build());
+    PostOrderData* po_data, bool fast_compile) {
+  return Compile(CollectRoots(tensors, coll.indices), coll.parameter_aliases,
+                 devices, coll.device, coll.hash, po_data, fast_compile);
+}
+
+XLATensor::CompilationResult XLATensor::Compile(
+    absl::Span<const ir::Value> roots,
+    absl::Span<const ParameterAlias> parameter_aliases,
+    absl::Span<const std::string> devices, const Device& device,
+    const xla::hash_t& hash, PostOrderData* po_data, bool fast_compile) {
+  bool aliased = !parameter_aliases.empty();
+  PersistentCache* persistent_cache = PersistentCache::Get();
+  xla::hash_t persistent_key;
+  absl::optional<xla::XlaComputation> cached_hlo;
+  if (persistent_cache != nullptr) {
+    persistent_key = persistent_cache->GetKey(hash, device, aliased);
+    cached_hlo = persistent_cache->Load(persistent_key);
+  }
+  MeshHloShare* mesh_share = MeshHloShare::Get();
+  RemoteCompileCache* remote_cache = RemoteCompileCache::Get();
+  // The graph hash mixes in the resource domain of the host, so the keys
+  // shared with other hosts hash the IR graph again.
+  xla::hash_t ir_hash = 0;
+  if (mesh_share != nullptr || remote_cache != nullptr) {
+    ir_hash = xla::util::Hash(po_data->parameter_sequence);
+    for (auto& ir_value : roots) {
+      ir_hash = xla::util::HashCombine(ir_hash, ir_value.hash());
+    }
+    ir_hash = HashParameterAliases(ir_hash, parameter_aliases);
+  }
+  xla::hash_t mesh_key;
+  if (mesh_share != nullptr) {
+    mesh_key = MeshHloShare::GetKey(ir_hash, device, aliased);
+    if (!cached_hlo && !mesh_share->publisher()) {
+      cached_hlo = mesh_share->Fetch(mesh_key);
+    }
+  }
+  std::string remote_key;
+  bool remote_hit = false;
+  if (remote_cache != nullptr) {
+    remote_key = RemoteCompileCache::GetKey(ir_hash, device, aliased);
+    if (!cached_hlo) {
+      cached_hlo = remote_cache->Load(remote_key);
+      remote_hit = cached_hlo.has_value();
+    }
+  }
+
+  size_t emitted_nodes = po_data->post_order.size();
+  xla::XlaComputation computation;
+  if (cached_hlo) {
+    computation = std::move(*cached_hlo);
+  } else {
+    xla::trace::ScopedEvent trace_event("LowerGraph");
+    static const bool enable_cse =
+        xla::sys_util::GetEnvBool("XLA_ENABLE_CSE", false);
+    ir::Util::NodeAliases node_aliases;
+    if (enable_cse) {
+      node_aliases = ir::Util::ComputeCommonSubexpressions(po_data->post_order);
+      XLA_COUNTER("CseEliminatedNodes", node_aliases.size());
+    }
+    // Outlining lowers the nodes region by region, which the aliases of the
+    // nodes into other regions would not allow.
+    ir::OutlinedRegions outlined_regions;
+    if (node_aliases.empty()) {
+      outlined_regions = ir::Util::ComputeOutlinedRegions(
+          po_data->post_order, roots, GetOutlineScopeDepth());
+    }
+    if (!outlined_regions.regions.empty()) {
+      XLA_COUNTER("OutlinedRegions", outlined_regions.regions.size());
+      XLA_COUNTER("OutlinedComputations", outlined_regions.num_computations);
+    }
+    ReportRematSavedBytes(po_data->post_order);
+    ReplicationDevicesScope replication_devices_scope(devices);
+    ir::RootLoweringContext lowering_ctx(
+        "SyncTensorsGraph", device, po_data->post_order,
+        ir::Util::EmissionMap(), std::move(node_aliases),
+        outlined_regions);
+    for (auto& ir_value : roots) {
+      xla::XlaOp root = lowering_ctx.GetOutputOp(ir_value);
+      lowering_ctx.AddResult(root);
+    }
+    if (aliased) {
+      BuildInputOutputAliases(parameter_aliases, &lowering_ctx);
+    }
+    computation = ConsumeValue(lowering_ctx.Build());
+    if (persistent_cache != nullptr) {
+      persistent_cache->Store(persistent_key, computation);
+    }
+  }
+  if (mesh_share != nullptr && mesh_share->publisher()) {
+    mesh_share->Publish(mesh_key, computation);
+  }
+  if (remote_cache != nullptr && !remote_hit) {
+    remote_cache->Store(remote_key, computation);
+  }
+  MemoryAnalysis memory_analysis;
+  if (IsMemoryAnalysisEnabled()) {
+    memory_analysis = AnalyzeComputationMemory(computation);
+    TF_VLOG(4) << "Memory analysis of IR graph hash "
+               << xla::util::HexHash(hash) << ":\n"
+               << memory_analysis.ToString();
+    CheckMemoryBudget(memory_analysis);
+  }
   xla::ProgramShape program_shape = ConsumeValue(computation.GetProgramShape());
   xla::Shape shape =
-      MakeShapeWithDeviceLayout(program_shape.result(), coll.device.hw_type);
+      MakeShapeWithDeviceLayout(program_shape.result(), device.hw_type);
+  CompileManifest::MaybeRecord(hash, device.ToString(), devices, computation);
 
   std::vector<xla::ComputationClient::CompileInstance> instances;
-  instances.push_back({std::move(computation), &shape});
-
-  TF_VLOG(3) << "Compiling IR graph hash " << xla::util::HexHash(coll.hash)
-             << " on device " << coll.device << " ...";
+  // The graph hash identifies the lowered HLO, together with the aliasing.
+  bool spmd_partitioned = HasShardings(computation);
+  instances.push_back(
+      {std::move(computation), &shape, xla::util::MHash(hash, aliased)});
+  instances.back().spmd_partitioned = spmd_partitioned;
+  instances.back().fast_compile = fast_compile;
+  if (spmd_partitioned) {
+    XLA_COUNTER("SpmdPartitionedCompile", 1);
+  }
+  if (fast_compile) {
+    XLA_COUNTER("TieredFastCompile", 1);
+  }
+
+  TF_VLOG(3) << "Compiling IR graph hash " << xla::util::HexHash(hash)
+             << " on device " << device << " ...";
+  int64_t compile_start_ns = xla::sys_util::NowNs();
+  xla::trace::ScopedEvent trace_event("CompileGraph");
   std::vector<std::shared_ptr<xla::ComputationClient::Computation>>
       computations =
-          xla::GetX10Device(coll.device.ToString())
+          xla::GetX10Device(device.ToString())
               ->Compile(xla::ComputationClient::GetCompilationDevices(
-                            coll.device.ToString(), devices),
+                            device.ToString(), devices),
                         std::move(instances));
-  TF_VLOG(3) << "Compiling IR graph hash " << xla::util::HexHash(coll.hash)
-             << " on device " << coll.device << " done!";
+  int64_t compile_time_ns = xla::sys_util::NowNs() - compile_start_ns;
+  TF_VLOG(3) << "Compiling IR graph hash " << xla::util::HexHash(hash)
+             << " on device " << device << " done!";
   TF_VLOG(5)
-      << "Graph hash " << xla::util::HexHash(coll.hash)
-      << " is computation hash "
-      << xla::util::HexHash(xla::util::Hash(
-             computations.front()->computation().proto().SerializeAsString()));
+      << "Graph hash " << xla::util::HexHash(hash) << " is computation hash "
+      << xla::util::HexHash(computations.front()->fingerprint());
   XLA_CHECK_EQ(program_shape.parameters_size(),
                po_data->parameters_data.size());
+  // The tiered recompile of the fast computations needs their HLO, which then
+  // has to be reloadable.
+  if (ShouldReleaseCompiledHlo() &&
+      (!fast_compile || persistent_cache != nullptr)) {
+    std::function<xla::XlaComputation()> loader_fn;
+    if (persistent_cache != nullptr) {
+      loader_fn = [persistent_cache, persistent_key]() {
+        absl::optional<xla::XlaComputation> hlo =
+            persistent_cache->Load(persistent_key);
+        return hlo ? std::move(*hlo) : xla::XlaComputation();
+      };
+    }
+    computations.front()->ReleaseComputation(std::move(loader_fn));
+  }
 
-  return {/*device=*/coll.device,
-          /*emitted_nodes=*/lowering_ctx.GetEmittedNodeCount(),
+  return {/*device=*/device,
+          /*emitted_nodes=*/emitted_nodes,
           /*computation=*/std::move(computations.front()),
-          /*parameters_data=*/std::move(po_data->parameters_data)};
+          /*parameters_data=*/std::move(po_data->parameters_data),
+          /*compile_time_ns=*/compile_time_ns};
+}
+
+void XLATensor::MaybeRecompileOptimized(
+    const xla::hash_t& hash, const Device& device,
+    const ComputationCache::TypePtr& cached_computation) {
+  static const size_t threshold =
+      xla::sys_util::GetEnvInt("XLA_TIERED_COMPILATION_THRESHOLD", 8);
+  if (!cached_computation->fast_compiled ||
+      cached_computation->executions.fetch_add(1) + 1 != threshold) {
+    return;
+  }
+  XLA_COUNTER("TieredRecompileScheduled", 1);
+
+  // The lowered HLO of the fast computation is recompiled as is, so that the
+  // graph does not need to be kept around.
+  auto compilefn = [hash, device, fast_computation = cached_computation]() {
+    const xla::ComputationClient::Computation& computation =
+        *fast_computation->computation;
+    xla::Shape shape = MakeShapeWithDeviceLayout(
+        computation.program_shape().result(), device.hw_type);
+    bool aliased = !fast_computation->parameter_aliases.empty();
+    std::vector<xla::ComputationClient::CompileInstance> instances;
+    instances.push_back({computation.computation(), &shape,
+                         xla::util::MHash(hash, aliased)});
+    instances.back().spmd_partitioned =
+        HasShardings(instances.back().computation);
+    int64_t compile_start_ns = xla::sys_util::NowNs();
+    std::vector<std::shared_ptr<xla::ComputationClient::Computation>>
+        computations = xla::GetX10Device(device.ToString())
+                           ->Compile(computation.devices(),
+                                     std::move(instances));
+    auto optimized = std::make_shared<CachedComputation>(
+        std::move(computations.front()),
+        fast_computation->compile_time_ns + xla::sys_util::NowNs() -
+            compile_start_ns);
+    optimized->parameter_paths = fast_computation->parameter_paths;
+    optimized->parameter_sequence = fast_computation->parameter_sequence;
+    optimized->parameter_aliases = fast_computation->parameter_aliases;
+    optimized->graph_size = fast_computation->graph_size;
+    // Swaps the optimized computation in, under the keys of the fast one,
+    // unless the caches evicted it in the meantime.
+    for (ComputationCache* cache :
+         {GetComputationCache(), GetGraphHashCache()}) {
+      std::vector<xla::hash_t> keys;
+      cache->EraseIf(
+          [&](const xla::hash_t& key, const CachedComputation& entry) {
+            if (&entry != fast_computation.get()) {
+              return false;
+            }
+            keys.push_back(key);
+            return true;
+          });
+      for (auto& key : keys) {
+        cache->Add(key, optimized);
+      }
+    }
+    XLA_COUNTER("TieredRecompileDone", 1);
+  };
+  xla::env::ScheduleClosure(std::move(compilefn));
+}
+
+bool XLATensor::TryScheduleBackgroundCompile(
+    const std::vector<XLATensor>& tensors,
+    absl::Span<const std::string> devices, const SyncTensorCollection& coll) {
+  static const bool async_compile =
+      xla::sys_util::GetEnvBool("XLA_ASYNC_COMPILE", false);
+  // Aliased computations are tied to the liveness of the tensors being synced,
+  // so they are always compiled in the foreground. The same goes when checking
+  // the memory budget, whose failures need to surface in the sync.
+  if (!async_compile || !coll.parameter_aliases.empty() ||
+      IsMemoryAnalysisEnabled()) {
+    return false;
+  }
+  static std::mutex* lock = new std::mutex();
+  static auto* in_flight =
+      new absl::node_hash_set<xla::hash_t>();
+  {
+    std::lock_guard<std::mutex> guard(*lock);
+    if (!in_flight->insert(coll.hash).second) {
+      XLA_COUNTER("AsyncCompileDeduped", 1);
+      return true;
+    }
+  }
+  XLA_COUNTER("AsyncCompileScheduled", 1);
+
+  // The background task only captures the IR roots, as the tensors themselves
+  // will have their IR values replaced by the op-by-op execution of the graph.
+  auto compilefn = [roots = CollectRoots(tensors, coll.indices),
+                    devices = std::vector<std::string>(devices.begin(),
+                                                       devices.end()),
+                    device = coll.device, hash = coll.hash]() {
+    // A failed compilation must not leave the graph deduped forever.
+    xla::util::ExceptionCleanup in_flight_cleanup(
+        [hash](xla::util::ExceptionCleanup::StatusType status) {
+          std::lock_guard<std::mutex> guard(*lock);
+          in_flight->erase(hash);
+        });
+    PostOrderData po_data = RunPostOrder(roots);
+    CompilationResult compile_result =
+        Compile(roots, {}, devices, device, hash, &po_data,
+                /*fast_compile=*/false);
+    GetComputationCache()->Add(
+        hash, std::make_shared<CachedComputation>(
+                  std::move(compile_result.computation),
+                  compile_result.compile_time_ns));
+    XLA_COUNTER("AsyncCompileDone", 1);
+  };
+  xla::env::ScheduleClosure(std::move(compilefn));
+  return true;
+}
+
+std::shared_ptr<XLATensor::Async> XLATensor::ScheduleSyncTensorsGraphOpByOp(
+    std::vector<XLATensor>* tensors, SyncTensorCollection* coll,
+    absl::Span<const std::string> devices) {
+  std::vector<ir::Value> roots = CollectRoots(*tensors, coll->indices);
+  auto tensors_data = FetchTensorData(tensors, coll->config, coll->indices);
+  std::shared_ptr<Async> async =
+      std::make_shared<Async>(coll, /*parameters_data=*/
+                              std::vector<xla::ComputationClient::DataPtr>(),
+                              std::move(tensors_data), nullptr);
+
+  auto syncfn = [async, roots = std::move(roots),
+                 devices = std::vector<std::string>(devices.begin(),
+                                                    devices.end()),
+                 hash = coll->hash]() {
+    try {
+      async->wait_turn();
+      TF_VLOG(3) << "Executing (OpByOp) IR graph hash "
+                 << xla::util::HexHash(hash) << " on device " << async->device
+                 << " ...";
+      std::vector<xla::ComputationClient::DataPtr> results =
+          OpByOpExecutor::Get()->Execute(roots, async->device, devices);
+      TF_VLOG(3) << "Executing (OpByOp) IR graph hash "
+                 << xla::util::HexHash(hash) << " on device " << async->device
+                 << " done!";
+
+      for (size_t i = 0; i < results.size(); ++i) {
+        if (async->tensors_data[i] != nullptr) {
+          async->tensors_data[i]->Assign(*results[i]);
+        } else {
+          async->tensors_data[i] = std::move(results[i]);
+        }
+      }
+    } catch (...) {
+      std::exception_ptr exptr = std::current_exception();
+      for (auto& unlocker : async->unlocker) {
+        unlocker.SetStatus(exptr);
+      }
+      TF_LOG(FATAL) << "Exceptions disabled, shouldn't happen";
+    }
+  };
+
+  xla::env::ScheduleIoClosure(async->mwait.Completer(std::move(syncfn)));
+  return async;
 }
 
 std::shared_ptr<XLATensor::Async> XLATensor::SyncTensorsGraphInternal(
     std::vector<XLATensor>* tensors, absl::Span<const std::string> devices,
     const SyncTensorsConfig& config) {
+  xla::trace::ScopedEvent trace_event("SyncTensorsGraph");
+  xla::device_activity::ScopedHostPhase phase(
+      xla::device_activity::HostPhase::kTrace);
   SyncTensorCollection coll = CollectSyncTensors(*tensors, config);
   if (coll.indices.empty()) {
     return nullptr;
   }
+  FlushDeferredUploads(coll.device);
   DebugUtil::SaveTensorsGraphInfo("ScheduleSyncTensorsGraph", *tensors,
                                   &coll.indices);
+  DebugUtil::SaveTensorsGraphBinary("ScheduleSyncTensorsGraph", *tensors,
+                                    &coll.indices);
 
+  std::shared_ptr<Async> async = TryRunCachedSyncFast(tensors, &coll);
+  if (async != nullptr) {
+    return async;
+  }
+  xla::hash_t graph_hash = coll.hash;
   PostOrderData po_data = RunPostOrder(*tensors, coll.indices);
   InsertTraceletCutpoint(po_data);
+  coll.parameter_aliases = ComputeParameterAliases(*tensors, coll, graph_hash,
+                                                   po_data.parameters_data);
   coll.hash = xla::util::HashCombine(
       coll.hash, xla::util::Hash(po_data.parameter_sequence));
+  coll.hash = HashParameterAliases(coll.hash, coll.parameter_aliases);
   TF_VLOG(4) << "Parameter sequence graph hash "
              << xla::util::HexHash(coll.hash);
-  std::shared_ptr<Async> async = TryRunCachedSync(tensors, &coll, &po_data);
+  async = TryRunCachedSync(tensors, &coll, &po_data);
   if (async != nullptr) {
     return async;
   }
+  std::vector<size_t> promoted_scalars =
+      ScalarPromotion::Analyze(po_data.post_order);
+  if (!promoted_scalars.empty()) {
+    // The scalars whose value keeps changing become parameters, so that the
+    // graph matches the computation compiled with them promoted, if any.
+    PromoteScalars(tensors, &coll, po_data, promoted_scalars);
+    graph_hash = coll.hash;
+    po_data = RunPostOrder(*tensors, coll.indices);
+    coll.parameter_aliases = ComputeParameterAliases(
+        *tensors, coll, graph_hash, po_data.parameters_data);
+    coll.hash = xla::util::HashCombine(
+        coll.hash, xla::util::Hash(po_data.parameter_sequence));
+    coll.hash = HashParameterAliases(coll.hash, coll.parameter_aliases);
+    async = TryRunCachedSync(tensors, &coll, &po_data);
+    if (async != nullptr) {
+      return async;
+    }
+  }
+  DebugUtil::SaveTensorsGraphBinary("UncachedCompile", *tensors, &coll.indices,
+                                    /*uncached_compile=*/true);
+  RecompileDiagnostics::Analyze(coll.hash, po_data.post_order);
+  if (TryScheduleBackgroundCompile(*tensors, devices, coll)) {
+    // While the fused computation compiles, this step runs using the op-by-op
+    // executor, whose per-op compilations are small and cached.
+    XLA_VALUE_METRIC("TensorsGraphSize", po_data.post_order.size());
+    return ScheduleSyncTensorsGraphOpByOp(tensors, &coll, devices);
+  }
 
-  CompilationResult compile_result = Compile(*tensors, devices, coll, &po_data);
+  static const bool tiered_compile =
+      xla::sys_util::GetEnvBool("XLA_TIERED_COMPILATION", false);
+  CompilationResult compile_result =
+      Compile(*tensors, devices, coll, &po_data, tiered_compile);
 
   XLA_VALUE_METRIC("TensorsGraphSize", compile_result.emitted_nodes);
   TF_VLOG(5) << "TensorsGraphSize=" << compile_result.emitted_nodes;
 
   auto cached_computation = std::make_shared<CachedComputation>(
-      std::move(compile_result.computation));
+      std::move(compile_result.computation), compile_result.compile_time_ns);
+  cached_computation->fast_compiled = tiered_compile;
+  RegisterCachedGraph(*tensors, coll, graph_hash, po_data,
+                      cached_computation.get());
   GetComputationCache()->Add(coll.hash, cached_computation);
+  GetGraphHashCache()->Add(graph_hash, cached_computation);
 
   return ScheduleSyncTensorsGraph(
       tensors, &coll, std::move(compile_result.parameters_data),
       compile_result.device.ToString(), std::move(cached_computation));
 }
 
+void XLATensor::WarmupCompilationCache(const std::string& manifest_path) {
+  std::vector<CompileManifest::Entry> entries =
+      CompileManifest::Load(manifest_path);
+  TF_VLOG(2) << "Warming up compilation cache with " << entries.size()
+             << " computations from " << manifest_path;
+  xla::util::MultiWait mwait(entries.size());
+  for (auto& entry : entries) {
+    auto compilefn = [&entry]() {
+      if (GetComputationCache()->Get(entry.hash) != nullptr) {
+        return;
+      }
+      Device device(entry.device);
+      xla::ProgramShape program_shape =
+          ConsumeValue(entry.computation.GetProgramShape());
+      xla::Shape shape =
+          MakeShapeWithDeviceLayout(program_shape.result(), device.hw_type);
+      std::vector<xla::ComputationClient::CompileInstance> instances;
+      instances.push_back({std::move(entry.computation), &shape});
+      int64_t compile_start_ns = xla::sys_util::NowNs();
+      std::vector<std::shared_ptr<xla::ComputationClient::Computation>>
+          computations = xla::GetX10Device(entry.device)
+                             ->Compile(xla::ComputationClient::
+                                           GetCompilationDevices(
+                                               entry.device, entry.devices),
+                                       std::move(instances));
+      GetComputationCache()->Add(
+          entry.hash, std::make_shared<CachedComputation>(
+                          std::move(computations.front()),
+                          xla::sys_util::NowNs() - compile_start_ns));
+      XLA_COUNTER("WarmupCompile", 1);
+    };
+    xla::env::ScheduleClosure(mwait.Completer(std::move(compilefn)));
+  }
+  mwait.Wait();
+}
+
+size_t XLATensor::InvalidateReplicatedComputations(
+    absl::Span<const std::string> devices) {
+  std::set<std::string> device_set(devices.begin(), devices.end());
+  auto is_stale = [&](const xla::hash_t& hash,
+                      const CachedComputation& cached_computation) {
+    const std::vector<std::string>& compiled_devices =
+        cached_computation.computation->devices();
+    return compiled_devices.size() > 1 &&
+           std::set<std::string>(compiled_devices.begin(),
+                                 compiled_devices.end()) != device_set;
+  };
+  size_t invalidated = GetComputationCache()->EraseIf(is_stale);
+  GetGraphHashCache()->EraseIf(is_stale);
+  XLA_COUNTER("ReplicatedComputationsInvalidated", invalidated);
+  TF_VLOG(2) << "Replication devices set to (" << absl::StrJoin(devices, ", ")
+             << "), dropped " << invalidated << " replicated computations";
+  return invalidated;
+}
+
 int64_t XLATensor::GetNextTensorId() {
   static std::atomic<int64_t>* id_generator = new std::atomic<int64_t>(1);
   return id_generator->fetch_add(1);
 }
 
+void XLATensor::WaitDeviceOps(absl::Span<const std::string> devices) {
+  std::vector<std::string> wait_devices =
+      devices.empty() ? xla::ComputationClient::AllDevices()
+                      : std::vector<std::string>(devices.begin(), devices.end());
+  for (const std::string& device_str : wait_devices) {
+    DeviceBarrier(Device(device_str));
+  }
+}
+
+void XLATensor::FreezeDeviceData(const xla::ComputationClient::DataPtr& data) {
+  DeviceDataInfo* data_info = dynamic_cast<DeviceDataInfo*>(data->info());
+  data->SetInfo(std::make_shared<DeviceDataInfo>(
+      data_info != nullptr ? data_info->tensor_id : -1, /*read_only=*/true,
+      /*frozen=*/true));
+}
+
 void XLATensor::SetRngSeed(const Device* device, uint64_t seed) {
   DeviceContextArena::Get()->SetRngSeed(device, seed);
 }
 
+void XLATensor::SetExecutePriority(
+    xla::ComputationClient::ExecutePriority priority) {
+  g_tls_data.execute_priority = priority;
+}
+
+xla::ComputationClient::ExecutePriority XLATensor::GetExecutePriority() {
+  return g_tls_data.execute_priority;
+}
+
 uint64_t XLATensor::GetRunningSeed(const Device& device) {
   return DeviceContextArena::Get()->GetRunningSeed(device);
 }
 
+ir::Value XLATensor::GetRngSeed(const Device& device) {
+  auto seed_ir_value_fn = [&](uint64_t seed) {
+    // Always device data, even for the special scalars, so that the graphs do
+    // not depend on the seed value.
+    xla::ComputationClient::DataPtr data = GetDeviceData(
+        static_cast<int64_t>(seed), at::ScalarType::Long, device);
+    data->SetInfo(std::make_shared<DeviceDataInfo>(/*tensor_id=*/-1,
+                                                   /*read_only=*/true));
+    return ir::Value(ir::MakeNode<ir::ops::DeviceData>(std::move(data)));
+  };
+  return DeviceContextArena::Get()->GetRngSeed(device, seed_ir_value_fn);
+}
+
+int64_t XLATensor::GetNextRngOpIndex(const Device& device) {
+  return DeviceContextArena::Get()->GetNextRngOpIndex(device);
+}
+
+bool XLATensor::UseStepRngSeeds() {
+  static const bool step_rng = xla::sys_util::GetEnvBool("XLA_STEP_RNG", false);
+  return step_rng;
+}
+
 bool XLATensor::ApplyTraceletCutpoint() {
-  static const bool tracelets =
-      xla::sys_util::GetEnvBool("XLA_TRACELETS", false);
-  if (!tracelets) {
+  if (!Tracelets::IsEnabled() || !data()->ir_value ||
+      !Tracelets::IsCutpoint(data()->ir_value.node->hash())) {
     return false;
   }
-  if (!data()->ir_value) {
-    return false;
-  }
-  xla::hash_t hash = data()->ir_value.node->hash();
-  if (g_tracelet_state.cutpoints.find(hash) !=
-      g_tracelet_state.cutpoints.end()) {
-    ApplyPendingGraph();
-    return true;
-  }
-  return false;
+  Tracelets::CutScope cut;
+  ApplyPendingGraph();
+  return true;
 }
 
 void XLATensor::InsertTraceletCutpoint(const PostOrderData& po_data) {
-  // Wait for steady state: don't trigger any tracelet detection for the first
-  // two steps.
-  static const int64_t kSteadyStateStep = 3;
-  static const bool tracelets =
-      xla::sys_util::GetEnvBool("XLA_TRACELETS", false);
-  if (!tracelets) {
-    return;
-  }
-  xla::metrics::CounterData* mark_step = xla::metrics::GetCounter("MarkStep");
-  int64_t steps = mark_step ? mark_step->Value() : 0;
-  if (steps < kSteadyStateStep) {
-    return;
-  }
-  // For the first steady state step, just record number of compilations seen so
-  // far and return.
-  if (steps == kSteadyStateStep) {
-    xla::metrics::CounterData* uncached_compile =
-        xla::metrics::GetCounter("UncachedCompile");
-    if (uncached_compile) {
-      g_tracelet_state.prev_uncached_compile = uncached_compile->Value();
-    }
-    return;
-  }
-  xla::metrics::CounterData* uncached_compile =
-      xla::metrics::GetCounter("UncachedCompile");
-  XLA_CHECK_GE(uncached_compile->Value(),
-               g_tracelet_state.prev_uncached_compile);
-  if (!uncached_compile ||
-      uncached_compile->Value() == g_tracelet_state.prev_uncached_compile) {
-    // No new compilations, nothing to do.
-    return;
-  }
-  XLA_CHECK(!po_data.post_order.empty());
-  // Construct the new tracelet out of post-order nodes.
-  // TODO(asuhan): Consider all nodes as possible tracelet start?
-  std::vector<xla::hash_t> po_trace;
-  for (const ir::Node* node : po_data.post_order) {
-    po_trace.push_back(node->hash());
-  }
-  xla::hash_t trace_key = po_data.post_order.front()->hash();
-  const auto tracelet_it = g_tracelet_state.tracelet_by_prefix.find(trace_key);
-  if (tracelet_it != g_tracelet_state.tracelet_by_prefix.end()) {
-    // Old tracelet found starting with the same prefix as current trace. We
-    // might need to check if the two diverge and shorten it further, up to the
-    // point of divergence.
-    const auto divergent_node =
-        FindTraceDivergence(tracelet_it->second, po_trace);
-    if (divergent_node &&
-        po_data.post_order[*divergent_node]->op() != ir::ops::xla_device_data) {
-      const auto cutpoint_it = po_trace.begin() + *divergent_node;
-      g_tracelet_state.tracelet_by_prefix[trace_key] =
-          std::vector<xla::hash_t>(po_trace.begin(), cutpoint_it);
-      g_tracelet_state.cutpoints.insert(*(cutpoint_it - 1));
-    }
-  } else {
-    const auto tracelet_it_ok =
-        g_tracelet_state.tracelet_by_prefix.emplace(trace_key, po_trace);
-    XLA_CHECK(tracelet_it_ok.second);
+  if (Tracelets::IsEnabled()) {
+    Tracelets::Learn(po_data.post_order);
   }
-  g_tracelet_state.prev_uncached_compile = uncached_compile->Value();
 }
 
 }  // namespace swift_xla
@@ -16,9 +16,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 
 #include "tensorflow/compiler/tf2xla/xla_tensor/computation.h"
@@ -26,6 +30,8 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/random_init.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/optimizer_step.h"
 #include "tensorflow/compiler/xla/client/lib/pooling.h"
 #include "tensorflow/compiler/xla/client/xla_builder.h"
 #include "tensorflow/compiler/xla/status.h"
@@ -47,6 +53,14 @@ class XLATensor {
   struct Data;
 
  public:
+  // The tensors handed out through the C API get heap allocated one at a time,
+  // so their memory is recycled through per thread free lists instead of going
+  // back to the system allocator on every deletion.
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr, size_t size);
+
+  // Only the tensors of rank above zero join the live tensors right away, the
+  // scalars do when they get device data or an IR value.
   static XLATensor Create(const at::Tensor& tensor, const Device& device);
   static XLATensor Create(
       xla::ComputationClient::DataPtr xla_data,
@@ -70,6 +84,18 @@ class XLATensor {
 
   at::Tensor ToTensor(bool detached);
 
+  // Writes the tensor values into the dest buffer, like ToTensor() followed
+  // by a copy would, but without the intermediate host tensor when the values
+  // live on the device. The fetched values are not cached on the tensor.
+  void ToBuffer(void* dest, size_t dest_size);
+
+  // Same as ToBuffer(), for values of at most kMaxSmallReadBytes, like loss
+  // scalars. The concurrent small reads from the same device are batched into
+  // one transfer.
+  void ToSmallBuffer(void* dest, size_t dest_size);
+
+  static constexpr size_t kMaxSmallReadBytes = 64;
+
   void ShallowCopyTo(XLATensor* dest) const;
 
   at::ScalarType dtype() const;
@@ -99,6 +125,11 @@ class XLATensor {
   // available.
   ir::Value CurrentIrValue() const;
 
+  // Returns the metadata (scope and Swift frames) of the IR node which
+  // computes, or computed, the current value of the tensor, or nullptr if the
+  // value did not come from an IR graph.
+  std::shared_ptr<const ir::MetaData> GetOrigin() const;
+
   // Retrieves the IR Node representing this XLATensor. One will be created if
   // missing. Note that although this is a const API, it actually changes the
   // internal state ofthe object.
@@ -124,12 +155,40 @@ class XLATensor {
       at::Scalar value, const xla::Shape& shape,
       c10::optional<at::ScalarType> logical_element_type, const Device& device);
 
+  // Same as GetIrValueForScalar(), but the special scalars too become device
+  // data, for the values whose changes must not change the graph hash.
+  static ir::Value GetDeviceDataForScalar(at::Scalar value,
+                                          xla::PrimitiveType type,
+                                          const Device& device);
+
+  // Returns the device data holding the seed of the current step on the
+  // device, which gets shared by all the random ops of the step. The seeds are
+  // stepped per tracing thread, so that the threads tracing concurrently do not
+  // perturb each other's random ops.
   static ir::Value GetRngSeed(const Device& device);
 
+  // Sets the seed of the calling thread, and the one the threads which have
+  // not traced random ops yet start from.
   static void SetRngSeed(const Device* device, uint64_t seed);
 
   static uint64_t GetRunningSeed(const Device& device);
 
+  // Sets the priority of the computations executed on behalf of the calling
+  // thread, like the high one for the latency critical inference threads
+  // sharing their devices with training.
+  static void SetExecutePriority(
+      xla::ComputationClient::ExecutePriority priority);
+
+  static xla::ComputationClient::ExecutePriority GetExecutePriority();
+
+  // Returns the index of the next random op within the step of the calling
+  // thread on the device.
+  static int64_t GetNextRngOpIndex(const Device& device);
+
+  // Whether the X10 random ops take their seeds from xla_rng_seed() instead of
+  // the host, as set by XLA_STEP_RNG.
+  static bool UseStepRngSeeds();
+
   // Dispatches a comparison operator, setting the logical type of the result
   // appropriately.
   static XLATensor DispatchComparisonOp(c10::Symbol kind,
@@ -162,7 +221,10 @@ class XLATensor {
   // Makes sure that any outstanding IR operation accumulated over live tensors,
   // gets turned into device data. If wait is true, the sync operation will be
   // run synchronously. The devices argument, if not empty, tells the devices
-  // which should be participating into the replicated computation.
+  // which should be participating into the replicated computation. When
+  // XLA_PER_THREAD_SYNC is set, only the tensors whose pending IR has been
+  // traced by the calling thread get synced, so that the threads tracing
+  // different models in the same process do not sync each other's graphs.
   static void SyncLiveTensorsGraph(const Device* device,
                                    absl::Span<const std::string> devices,
                                    bool wait);
@@ -171,14 +233,61 @@ class XLATensor {
   // the computation boundaries.
   static void MarkStep(const Device* device);
 
+  // With XLA_SPILL_MEMORY_FRACTION set, moves to the host the values of the
+  // least recently read live tensors of the device (all devices if nullptr)
+  // whose device data they alone hold, until the memory in use drops under
+  // that fraction of the device memory. The tensors traced by other threads
+  // are not spilled. The spilled values get uploaded back when next used.
+  // Called by MarkStep().
+  static void SpillColdTensors(const Device* device);
+
+  // Compiles in parallel all the computations recorded within the manifest
+  // folder (see XLA_RECORD_COMPILE_MANIFEST), and adds them to the computation
+  // cache, so that the first execution of the recorded graphs does not pay the
+  // compilation cost.
+  static void WarmupCompilationCache(const std::string& manifest_path);
+
+  // Drops the cached computations compiled for a set of replication devices
+  // other than the given one. The graph hashes do not account for the
+  // replication devices, so after they change (say, when a host leaves the
+  // pool) those computations would otherwise be reused with the wrong replica
+  // groups. The single device computations are kept. Returns the number of
+  // computations dropped.
+  static size_t InvalidateReplicatedComputations(
+      absl::Span<const std::string> devices);
+
+  // Uploads, in a single batched transfer, the host tensors of the device whose
+  // uploads got deferred by XLA_DEFERRED_UPLOADS. Called before any execution
+  // on the device.
+  static void FlushDeferredUploads(const Device& device);
+
   // Waits for all the outstanding operations on all the supplied devices.
   // If devices is empty, the wait will happen for all local devices.
   static void WaitDeviceOps(absl::Span<const std::string> devices);
 
+  // Marks the device data as frozen, for the buffer to stay untouched as long
+  // as the data is alive: the computations reading it never donate it, even
+  // when its tensor gets assigned a new value.
+  static void FreezeDeviceData(const xla::ComputationClient::DataPtr& data);
+
   // Retrieves the CPU tensors behind the XLA tensors IR operations. All the
   // tensors must be on the same device.
   static std::vector<at::Tensor> GetTensors(std::vector<XLATensor>* tensors);
 
+  // Like GetTensors(), but the tensors of each type get flattened and packed
+  // into a single tensor on the device before the transfer, so that fetching
+  // many small tensors moves one buffer per type instead of one per tensor.
+  static std::vector<at::Tensor> GetTensorsPacked(
+      std::vector<XLATensor>* tensors);
+
+  // Like GetTensors(), but returns once the pending graphs are launched,
+  // without waiting for the computations or the device to host transfers. The
+  // future becomes ready once the CPU tensors are built in the background, at
+  // which point on_ready, if given, gets called from the background thread.
+  static std::future<std::vector<at::Tensor>> GetTensorsAsync(
+      std::vector<XLATensor>* tensors,
+      std::function<void()> on_ready = nullptr);
+
   // Operation which creates XLA tensors out of CPU tensors by batching the
   // requests to the computation servers.
   static std::vector<XLATensor> CreateTensors(
@@ -188,6 +297,16 @@ class XLATensor {
   //////////////////////////////////////////////////////////////////////////////
   // XLA dedicated operators follows here, listed in alphabetical order.
   //////////////////////////////////////////////////////////////////////////////
+  // Returns a boolean scalar which is true when none of the elements of the
+  // tensors is a NaN or an infinity, reduced on the device with a single node.
+  static XLATensor all_finite(absl::Span<const XLATensor> tensors);
+
+  // Concatenates the input of the replicas of each group along the dim
+  // dimension, which grows by shard_count times.
+  static std::pair<XLATensor, ir::Value> all_gather(
+      const XLATensor& input, const ir::Value& token, int64_t dim,
+      int64_t shard_count, std::vector<std::vector<int64_t>> groups);
+
   static std::pair<XLATensor, ir::Value> all_reduce(
       const XLATensor& input, const ir::Value& token, AllReduceType reduce_type,
       double scale, std::vector<std::vector<int64_t>> groups);
@@ -195,7 +314,8 @@ class XLATensor {
   static std::pair<std::vector<XLATensor>, ir::Value> all_reduce(
       const std::vector<XLATensor>& inputs, const ir::Value& token,
       AllReduceType reduce_type, double scale,
-      std::vector<std::vector<int64_t>> groups);
+      std::vector<std::vector<int64_t>> groups,
+      AllReducePrecision precision = AllReducePrecision::kFull);
 
   static ir::Value all_reduce_(XLATensor& input, const ir::Value& token,
                                AllReduceType reduce_type, double scale,
@@ -211,6 +331,64 @@ class XLATensor {
       int64_t split_dimension, int64_t concat_dimension,
       int64_t split_count, std::vector<std::vector<int64_t>> groups);
 
+  // The GRU cell of the [input_size, 3 * hidden_size] kernel and the
+  // [hidden_size, 3 * hidden_size] recurrent kernel, with the update, reset
+  // and output gates concatenated. Returns the new hidden state, along with
+  // the activated gates and the recurrent output projection which the
+  // backward pass takes.
+  static std::tuple<XLATensor, XLATensor, XLATensor> gru_cell(
+      const XLATensor& input, const XLATensor& hidden, const XLATensor& kernel,
+      const XLATensor& recurrent_kernel, const XLATensor& bias,
+      const XLATensor& recurrent_bias);
+
+  // Returns the input, hidden, kernel, recurrent kernel, bias and recurrent
+  // bias gradients of gru_cell().
+  static std::vector<XLATensor> gru_cell_backward(
+      const XLATensor& grad_hidden, const XLATensor& input,
+      const XLATensor& hidden, const XLATensor& kernel,
+      const XLATensor& recurrent_kernel, const XLATensor& gates,
+      const XLATensor& recurrent_output);
+
+  // The LSTM cell of the [input_size + hidden_size, 4 * hidden_size] weight,
+  // with the input, update, forget and output gates concatenated. Returns the
+  // new cell and hidden states, along with the activated gates which the
+  // backward pass takes.
+  static std::tuple<XLATensor, XLATensor, XLATensor> lstm_cell(
+      const XLATensor& input, const XLATensor& hidden, const XLATensor& cell,
+      const XLATensor& weight, const XLATensor& bias);
+
+  // Returns the input, hidden, cell, weight and bias gradients of lstm_cell().
+  static std::vector<XLATensor> lstm_cell_backward(
+      const XLATensor& grad_cell, const XLATensor& grad_hidden,
+      const XLATensor& input, const XLATensor& hidden, const XLATensor& cell,
+      const XLATensor& weight, const XLATensor& gates,
+      const XLATensor& new_cell);
+
+  // Routes the tokens of the [tokens, experts] gates to their top k experts.
+  // Returns the [tokens, k] experts of the tokens, and their positions within
+  // the expert buffers, which are capacity for the tokens which do not fit.
+  static std::pair<XLATensor, XLATensor> moe_routing(const XLATensor& gates,
+                                                     int64_t k,
+                                                     int64_t capacity);
+
+  // Scatters the [tokens, dim] (or [tokens, k, dim]) input into
+  // [num_experts, capacity, dim] expert buffers, following the routing, and
+  // exchanges them between the split_count replicas, each of which holds
+  // num_experts / split_count of the experts. The result rows are ordered by
+  // source replica, then by local expert.
+  static std::pair<XLATensor, ir::Value> moe_dispatch(
+      const XLATensor& input, const XLATensor& expert_indices,
+      const XLATensor& positions, const ir::Value& token, int64_t num_experts,
+      int64_t capacity, int64_t split_count,
+      std::vector<std::vector<int64_t>> groups);
+
+  // The inverse of moe_dispatch(): returns the expert outputs to the replicas
+  // of their tokens, as [tokens, k, dim] rows, zero for the dropped tokens.
+  static std::pair<XLATensor, ir::Value> moe_combine(
+      const XLATensor& expert_outputs, const XLATensor& expert_indices,
+      const XLATensor& positions, const ir::Value& token, int64_t split_count,
+      std::vector<std::vector<int64_t>> groups);
+
   static std::pair<XLATensor, ir::Value> collective_permute(
       const XLATensor& input, const ir::Value& token,
       std::vector<std::pair<int64_t, int64_t>> source_target_pairs);
@@ -218,6 +396,51 @@ class XLATensor {
   static XLATensor get_dimensions_size(const XLATensor& input,
                                        std::vector<int64_t> dimensions);
 
+  // Computes the optimizer steps of all the weights with a single node, and
+  // returns them along with the updated states, which are state major (see
+  // BuildOptimizerStep()).
+  static std::pair<std::vector<XLATensor>, std::vector<XLATensor>>
+  optimizer_step(OptimizerStepKind kind, absl::Span<const XLATensor> weights,
+                 absl::Span<const XLATensor> grads,
+                 absl::Span<const XLATensor> states,
+                 absl::Span<const XLATensor> hyperparameters, bool nesterov,
+                 bool apply_weight_decay, float epsilon);
+
+  // Pads the dim dimension of the input to the size returned by
+  // GetShapeBucket(), so that inputs whose size falls within the same bucket
+  // share the same compiled computation. Returns the padded tensor, together
+  // with a boolean mask of the bucket size, which is true for the positions
+  // holding input data. Only the inputs still held on the host get padded
+  // before entering the graph; the others bring their own size into it.
+  static std::pair<XLATensor, XLATensor> pad_to_bucket(
+      const XLATensor& input, int64_t dim, at::Scalar padding_value);
+
+  // Reduces the input across the replicas of each group, and returns the
+  // replica its shard of the scaled result, the scatter_dim dimension of which
+  // is shard_count times smaller than the input one.
+  static std::pair<XLATensor, ir::Value> reduce_scatter(
+      const XLATensor& input, const ir::Value& token, AllReduceType reduce_type,
+      double scale, int64_t scatter_dim, int64_t shard_count,
+      std::vector<std::vector<int64_t>> groups);
+
+  // Normalizes the input along the feature_index dimension with the batch
+  // statistics of all the replicas of each group. Returns the normalized input
+  // and the batch mean and biased variance, which the backward pass takes.
+  static std::tuple<XLATensor, XLATensor, XLATensor, ir::Value>
+  sync_batch_norm(const XLATensor& input, const XLATensor& weight,
+                  const XLATensor& bias, const ir::Value& token,
+                  int64_t feature_index, double eps,
+                  std::vector<std::vector<int64_t>> groups);
+
+  // Returns the input, weight and bias gradients of sync_batch_norm(). The
+  // weight and bias gradients are the ones of the local replica.
+  static std::tuple<XLATensor, XLATensor, XLATensor, ir::Value>
+  sync_batch_norm_backward(const XLATensor& grad, const XLATensor& input,
+                           const XLATensor& weight, const XLATensor& mean,
+                           const XLATensor& variance, const ir::Value& token,
+                           int64_t feature_index, double eps,
+                           std::vector<std::vector<int64_t>> groups);
+
   static std::vector<XLATensor> user_computation(
       const std::string& opname, absl::Span<const XLATensor> inputs,
       ComputationPtr computation);
@@ -245,6 +468,18 @@ class XLATensor {
   static void linspace_out(XLATensor& out, at::Scalar start, at::Scalar stop,
                            int64_t num, at::ScalarType scalar_type);
 
+  // Forwards the input through a rematerialization boundary, so that what gets
+  // computed on top of the result is recomputed rather than shared with the
+  // same computation on top of the input.
+  static XLATensor remat(const XLATensor& input, std::string scope);
+
+  // Annotates the input to be split across the partitions of an SPMD
+  // computation, tile_dimensions[i] ways along dimension i. The graphs holding
+  // such annotations get compiled through the XLA SPMD partitioner, with the
+  // replication devices as the partitions.
+  static XLATensor shard(const XLATensor& input,
+                         absl::Span<const int64_t> tile_dimensions);
+
   // XLA client operations exposed as tensor methods.
 
   static XLATensor xla_avg_pool(
@@ -283,8 +518,20 @@ class XLATensor {
 
   static XLATensor xla_truncated_normal(const XLATensor& input);
 
+  // Samples a tensor of the given size and type on the device, from seeds baked
+  // into the graph, for the initialization of the parameters.
+  static XLATensor xla_random_init(absl::Span<const int64_t> size,
+                                   ir::ops::RandomInitDistribution distribution,
+                                   double scale, int64_t seed0, int64_t seed1,
+                                   const Device& device,
+                                   at::ScalarType scalar_type);
+
   static XLATensor xla_replica_id(const Device& device);
 
+  // Returns the seed of the next stateless random op of the step on the
+  // device, derived on the device from the step seed (see GetRngSeed()).
+  static XLATensor xla_rng_seed(const Device& device);
+
  private:
   struct SyncTensorsConfig {
     // Whether we want to force XLA data on the target tensors (hence trimming
@@ -295,6 +542,18 @@ class XLATensor {
     bool sync_xla_data = true;
   };
 
+  // Tells that the buffer of a computation parameter can be donated to a
+  // computation output.
+  struct ParameterAlias {
+    size_t parameter_index = 0;
+    size_t output_index = 0;
+
+    bool operator==(const ParameterAlias& other) const {
+      return parameter_index == other.parameter_index &&
+             output_index == other.output_index;
+    }
+  };
+
   struct SyncTensorCollection {
     SyncTensorCollection() : hash(0) {}
 
@@ -302,12 +561,17 @@ class XLATensor {
     std::vector<size_t> indices;
     xla::hash_t hash;
     std::vector<xla::util::ExceptionCleanup> unlocker;
+    // Blocks until the asynchronous operations which locked the devices before
+    // this collection are complete. Must be called before executing on the
+    // devices.
+    std::function<void()> wait_turn = []() {};
     Device device;
+    // The parameters donated to the outputs (see ComputeParameterAliases()).
+    std::vector<ParameterAlias> parameter_aliases;
   };
 
   struct PostOrderData {
     std::vector<const ir::Node*> post_order;
-    ir::Util::EmissionMap emission_map;
     std::vector<xla::ComputationClient::DataPtr> parameters_data;
     std::vector<size_t> parameter_sequence;
   };
@@ -317,18 +581,41 @@ class XLATensor {
     size_t emitted_nodes = 0;
     std::shared_ptr<xla::ComputationClient::Computation> computation;
     std::vector<xla::ComputationClient::DataPtr> parameters_data;
+    int64_t compile_time_ns = 0;
   };
 
   struct CachedComputation {
     CachedComputation(
-        std::shared_ptr<xla::ComputationClient::Computation> computation)
-        : computation(std::move(computation)) {}
+        std::shared_ptr<xla::ComputationClient::Computation> computation,
+        int64_t compile_time_ns = 0)
+        : computation(std::move(computation)),
+          compile_time_ns(compile_time_ns) {}
 
     std::shared_ptr<xla::ComputationClient::Computation> computation;
+    // Time it took to compile the computation, which is what the cost aware
+    // eviction policy of the computation caches saves by keeping it.
+    int64_t compile_time_ns = 0;
+    // Paths from the graph roots to the DeviceData nodes feeding the
+    // computation parameters (in post-order), together with the parameter
+    // sequence they generated. Used by TryRunCachedSyncFast() to gather the
+    // parameters without running a post-order over the whole graph.
+    std::shared_ptr<const ir::NodePaths> parameter_paths;
+    std::vector<size_t> parameter_sequence;
+    std::vector<ParameterAlias> parameter_aliases;
+    size_t graph_size = 0;
+    // The ir::Util::ComputeSharingHash() of the post-order, which the fast
+    // lookup checks, as the graph hash does not capture the node sharing.
+    xla::hash_t sharing_hash;
+    // Whether the computation comes from the fast first tier of the tiered
+    // compilation, and how many times it ran since (see
+    // MaybeRecompileOptimized()).
+    bool fast_compiled = false;
+    std::atomic<size_t> executions{0};
   };
 
   using ComputationCache =
-      xla::util::Cache<xla::hash_t, CachedComputation, xla::util::HashReducer>;
+      xla::util::ShardedCache<xla::hash_t, CachedComputation,
+                              xla::util::HashReducer>;
 
   struct Async {
     Async(SyncTensorCollection* coll,
@@ -341,15 +628,32 @@ class XLATensor {
     xla::util::MultiWait mwait;
     std::vector<size_t> indices;
     std::vector<xla::util::ExceptionCleanup> unlocker;
+    std::function<void()> wait_turn;
     std::vector<xla::ComputationClient::DataPtr> parameters_data;
     std::string device;
     ComputationCache::TypePtr cached_computation;
     std::vector<xla::ComputationClient::DataPtr> tensors_data;
   };
 
+  // The state of the features few tensors use, kept out of line so that it
+  // does not weigh on every tensor. Allocated on first use by
+  // Data::GetColdData().
+  struct ColdData {
+    // The key the tensor had at the last live tensors sync which looked at it,
+    // and whether it has been read since (see SyncLiveTensorsGraph()). Read by
+    // the threads reading or destroying the tensor, hence atomic (and 64 bits
+    // wide, to stay lock free).
+    std::atomic<uint64_t> barrier_key{0};
+    std::atomic<bool> barrier_tracked{false};
+    std::atomic<bool> barrier_read{false};
+    // Whether the device data got spilled to tensor_data (see
+    // SpillColdTensors()).
+    bool spilled = false;
+  };
+
   // This is the core XLA tensor data structure where all the tensor data is
   // held. The XLA tensor is nothing more than a shared pointer to a Data
-  // object.
+  // object, allocated through per thread block caches.
   struct Data {
     Data(xla::ComputationClient::DataPtr xla_data, const Device& device,
          c10::optional<at::ScalarType> logical_element_type)
@@ -371,6 +675,12 @@ class XLATensor {
 
     ~Data();
 
+    // Returns the out of line state of the tensor, creating it if needed.
+    ColdData* GetColdData();
+
+    // Records a registration or a read of the tensor by the calling thread.
+    void NoteUseThread();
+
     xla::ComputationClient::DataPtr xla_data;
     ir::Value ir_value;
     c10::optional<at::ScalarType> logical_element_type;
@@ -378,6 +688,21 @@ class XLATensor {
     const Device device;
     const int64_t unique_id = 0;
     size_t generation = 1;
+    // The thread which traced the pending IR value, if any (see
+    // SyncLiveTensorsGraph()). Read by the other threads, hence atomic.
+    std::atomic<int64_t> trace_thread{0};
+    // The metadata of the IR node the device data was computed from.
+    std::shared_ptr<const ir::MetaData> origin;
+    // The spill epoch of the last read of the tensor (see SpillColdTensors()).
+    std::atomic<int64_t> last_use{0};
+    // The thread which registered or read the tensor, or -1 once more than one
+    // thread did. Only the tensors of the spilling thread get spilled.
+    std::atomic<int64_t> use_thread{0};
+    // Whether the tensor is in the live tensors of its device. The tensors
+    // holding only host data join them once they get device data or an IR
+    // value, see Register().
+    std::atomic<bool> registered{false};
+    std::atomic<ColdData*> cold{nullptr};
   };
 
   XLATensor(const at::Tensor& tensor, const Device& device);
@@ -398,8 +723,22 @@ class XLATensor {
 
   void AssignIrValue(ir::Value ir_value) const;
 
+  // Records that the value of the tensor got read, by an operation or by a
+  // fetch.
+  void NoteRead() const;
+
+  // Counts the upload of the host value of a spilled tensor.
+  void NoteSpillReload() const;
+
+  // Drops the host value once uploaded if it borrows its scalars, so that
+  // their owner gets them back.
+  void ReleaseBorrowedTensorData() const;
+
   void SetTensorData(at::Tensor tensor_data);
 
+  // Adds the tensor to the live tensors of its device, if not there already.
+  void Register() const;
+
   ir::Value CreateTensorNode(xla::ComputationClient::DataPtr data,
                              bool read_only) const;
 
@@ -426,6 +765,12 @@ class XLATensor {
   //     a = a + b
   void TryLimitGraphSize();
 
+  // Runs the given post-order of the pending graph of this tensor in
+  // num_chunks separate computations, cut where the fewest bytes are live, and
+  // leaves the tensor with the IR graph of the last chunk.
+  void SplitPendingGraph(absl::Span<const ir::Node* const> post_order,
+                         size_t num_chunks);
+
   std::vector<XLATensor> MakeOutputTensors(ir::NodePtr node) const;
 
   ir::Value GetIrValueForTensor(const at::Tensor& tensor,
@@ -455,6 +800,11 @@ class XLATensor {
       const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices,
       absl::Span<const xla::ComputationClient::DataPtr> tensors_data);
 
+  // Returns the element types of the tensors GatherTensorsXlaData() gathers
+  // device data for, in the same order.
+  static std::vector<at::ScalarType> GetFetchedTypes(
+      const std::vector<XLATensor>& tensors);
+
   static std::vector<ir::Value> CollectRoots(
       const std::vector<XLATensor>& tensors, absl::Span<const size_t> indices);
 
@@ -479,6 +829,16 @@ class XLATensor {
   static PostOrderData RunPostOrder(const std::vector<XLATensor>& tensors,
                                     absl::Span<const size_t> indices);
 
+  static PostOrderData RunPostOrder(absl::Span<const ir::Value> ir_values);
+
+  // Replaces the scalar constants at the given post-order positions with
+  // device data parameters, within the IR values of the tensors to sync, and
+  // recomputes the collection hash over the new IR values.
+  static void PromoteScalars(std::vector<XLATensor>* tensors,
+                             SyncTensorCollection* coll,
+                             const PostOrderData& po_data,
+                             absl::Span<const size_t> positions);
+
   static ComputationCache::TypePtr LookupCachedCompile(
       const std::vector<XLATensor>& tensors, const xla::hash_t& hash);
 
@@ -486,14 +846,83 @@ class XLATensor {
       std::vector<XLATensor>* tensors, SyncTensorCollection* coll,
       PostOrderData* po_data);
 
-  static void BuildInputOutputAliases(const std::vector<XLATensor>& tensors,
-                                      absl::Span<const size_t> indices,
-                                      ir::LoweringContext* lowering_ctx);
+  // The computations of the computation cache, indexed by the graph hash
+  // before the parameter sequence gets mixed into it.
+  static ComputationCache* GetGraphHashCache();
+
+  // Creates a computation cache configured by the XLA_COMPILATION_CACHE_*
+  // environment variables.
+  static ComputationCache* CreateComputationCache(const std::string& name);
+
+  // Collects the parameters data and sequence for the nodes, which are the
+  // post-order (or the post-order DeviceData nodes) of a graph.
+  static void CollectParametersData(absl::Span<const ir::Node* const> nodes,
+                                    PostOrderData* po_data);
+
+  // Looks up the computation cache using the graph hash computed by
+  // CollectSyncTensors(), and if found, gathers the parameters by following
+  // the cached parameter paths. Returns nullptr if the lookup fails, in which
+  // case the normal post-order based path needs to be taken.
+  static std::shared_ptr<Async> TryRunCachedSyncFast(
+      std::vector<XLATensor>* tensors, SyncTensorCollection* coll);
+
+  // Fills the parameter_paths and parameter_sequence fields of the cached
+  // computation, and registers it within the graph hash cache.
+  static void RegisterCachedGraph(const std::vector<XLATensor>& tensors,
+                                  const SyncTensorCollection& coll,
+                                  const xla::hash_t& graph_hash,
+                                  const PostOrderData& po_data,
+                                  CachedComputation* cached_computation);
+
+  // Picks the parameters whose buffers are dead once the sync computation has
+  // run, and pairs each of them with a computation output of the same shape,
+  // which will reuse the parameter buffer.
+  static std::vector<ParameterAlias> ComputeParameterAliases(
+      const std::vector<XLATensor>& tensors, const SyncTensorCollection& coll,
+      const xla::hash_t& graph_hash,
+      absl::Span<const xla::ComputationClient::DataPtr> parameters_data);
+
+  static void BuildInputOutputAliases(
+      absl::Span<const ParameterAlias> parameter_aliases,
+      ir::LoweringContext* lowering_ctx);
 
   static CompilationResult Compile(const std::vector<XLATensor>& tensors,
                                    absl::Span<const std::string> devices,
                                    const SyncTensorCollection& coll,
-                                   PostOrderData* po_data);
+                                   PostOrderData* po_data, bool fast_compile);
+
+  // Compiles the graph rooted at roots, with the outputs reusing the buffers
+  // of the parameters listed in parameter_aliases. The fast_compile flag
+  // selects the reduced optimization of the first compilation tier.
+  static CompilationResult Compile(
+      absl::Span<const ir::Value> roots,
+      absl::Span<const ParameterAlias> parameter_aliases,
+      absl::Span<const std::string> devices, const Device& device,
+      const xla::hash_t& hash, PostOrderData* po_data, bool fast_compile);
+
+  // With XLA_TIERED_COMPILATION, the graphs first compile with reduced
+  // optimization. Counts the executions of such a computation, and once it
+  // ran XLA_TIERED_COMPILATION_THRESHOLD times, recompiles its HLO with full
+  // optimization in background, and swaps the result into the computation
+  // caches in its place.
+  static void MaybeRecompileOptimized(
+      const xla::hash_t& hash, const Device& device,
+      const ComputationCache::TypePtr& cached_computation);
+
+  // If XLA_ASYNC_COMPILE is enabled, schedules the compilation of the graph
+  // in background and returns true, in which case the caller is expected to
+  // run the current step with the op-by-op executor. Once the compilation
+  // completes, the computation is added to the computation cache. Requests
+  // for a graph hash which is already being compiled are deduplicated.
+  static bool TryScheduleBackgroundCompile(
+      const std::vector<XLATensor>& tensors,
+      absl::Span<const std::string> devices, const SyncTensorCollection& coll);
+
+  // Like ScheduleSyncTensorsGraph(), but runs the graph using the op-by-op
+  // executor.
+  static std::shared_ptr<Async> ScheduleSyncTensorsGraphOpByOp(
+      std::vector<XLATensor>* tensors, SyncTensorCollection* coll,
+      absl::Span<const std::string> devices);
 
   static std::shared_ptr<Async> SyncTensorsGraphInternal(
       std::vector<XLATensor>* tensors, absl::Span<const std::string> devices,
@@ -506,11 +935,8 @@ class XLATensor {
   bool ApplyTraceletCutpoint();
 
   // Detect when new compilations are triggered after first few steps and
-  // attempt to find common portions, after which the trace is cut. This is
-  // meant to address variable upper bound loops, which lead to different
-  // unrolled sequences of code despite the body being identical. The hope is to
-  // reach a steady state in which no new tracelets are created after a
-  // relatively small number of cuts.
+  // attempt to find common portions, after which the trace is cut. See
+  // Tracelets.
   static void InsertTraceletCutpoint(const PostOrderData& po_data);
 
   std::shared_ptr<Data> data_;
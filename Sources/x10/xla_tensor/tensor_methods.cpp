@@ -22,11 +22,29 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/ir_util.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/layout_manager.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/lowering_context.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/all_finite.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/all_gather.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/all_reduce.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/all_to_all.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/annotate.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/expand.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/gru_cell.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/gru_cell_backward.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/lstm_cell.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/lstm_cell_backward.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/moe_combine.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/moe_dispatch.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/moe_routing.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/ops.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/optimizer_step.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/random_init.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/reduce_scatter.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/remat.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/replica_id.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/rng_seed.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/sharding.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/sync_batch_norm.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/sync_batch_norm_backward.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/tf_stateless_random_normal.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_avg_pool.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_avg_pool_grad.h"
@@ -34,6 +52,7 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_max_pool_grad.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_pad.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_slice.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/shape_bucketing.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/shape_builder.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
@@ -46,6 +65,39 @@
 namespace swift_xla {
 namespace {
 
+// Pads the dim dimension of the host tensor with padding_value, up to bucket.
+at::Tensor PadHostTensor(const at::Tensor& tensor, int64_t dim, int64_t bucket,
+                         at::Scalar padding_value) {
+  std::vector<int64_t> shape = tensor.shape();
+  int64_t outer = 1;
+  for (int64_t i = 0; i < dim; ++i) {
+    outer *= shape[i];
+  }
+  int64_t inner = 1;
+  for (size_t i = dim + 1; i < shape.size(); ++i) {
+    inner *= shape[i];
+  }
+  int64_t size = shape[dim];
+  shape[dim] = bucket;
+  switch (tensor.scalar_type()) {
+#define PAD_CASE(name, aten_name, DType)                              \
+  case at::ScalarType::aten_name: {                                   \
+    std::unique_ptr<DType[]> data(new DType[outer * bucket * inner]); \
+    const DType* source = tensor.data<DType>().data();                \
+    DType* dest = data.get();                                         \
+    for (int64_t o = 0; o < outer; ++o) {                             \
+      dest = std::copy_n(source, size * inner, dest);                 \
+      source += size * inner;                                         \
+      dest = std::fill_n(dest, (bucket - size) * inner,               \
+                         padding_value.to<DType>());                  \
+    }                                                                 \
+    return at::Tensor(std::move(data), std::move(shape));             \
+  }
+    LIST_SCALAR_TYPES(PAD_CASE)
+#undef PAD_CASE
+  }
+}
+
 struct MinMaxValues {
   ir::Value min;
   ir::Value max;
@@ -181,17 +233,45 @@ void CheckIsIntegralOrPred(const xla::Shape& shape,
 //////////////////////////////////////////////////////////////////////////////
 // XLA dedicated operators follows here, listed in alphabetical order.
 //////////////////////////////////////////////////////////////////////////////
+XLATensor XLATensor::all_finite(absl::Span<const XLATensor> tensors) {
+  XLA_CHECK(!tensors.empty()) << "all_finite needs at least one tensor";
+  std::vector<ir::Value> values;
+  values.reserve(tensors.size());
+  for (const XLATensor& tensor : tensors) {
+    values.push_back(tensor.GetIrValue());
+  }
+  ir::NodePtr node = ir::MakeNode<ir::ops::AllFinite>(values);
+  return tensors.front().CreateFrom(ir::Value(node), at::ScalarType::Bool);
+}
+
+std::pair<XLATensor, ir::Value> XLATensor::all_gather(
+    const XLATensor& input, const ir::Value& token, int64_t dim,
+    int64_t shard_count, std::vector<std::vector<int64_t>> groups) {
+  int64_t canonical_dim = XlaHelpers::GetCanonicalDimensionIndex(
+      dim, input.shape().get().rank());
+  ir::NodePtr node = ir::MakeNode<ir::ops::AllGather>(
+      input.GetIrValue(), token, canonical_dim, shard_count,
+      std::move(groups));
+  return {input.CreateFrom(ir::Value(node, 0)), ir::Value(node, 1)};
+}
+
 std::pair<std::vector<XLATensor>, ir::Value> XLATensor::all_reduce(
     const std::vector<XLATensor>& inputs, const ir::Value& token,
     AllReduceType reduce_type, double scale,
-    std::vector<std::vector<int64_t>> groups) {
+    std::vector<std::vector<int64_t>> groups, AllReducePrecision precision) {
   std::vector<ir::Value> input_values;
   input_values.reserve(inputs.size());
+  int64_t wire_bytes = 0;
   for (const XLATensor& input : inputs) {
     input_values.push_back(input.GetIrValue());
+    const xla::Shape& shape = input_values.back().shape();
+    wire_bytes += xla::ShapeUtil::ElementsIn(shape) *
+                  xla::ShapeUtil::ByteSizeOfPrimitiveType(GetAllReduceWireType(
+                      shape.element_type(), precision));
   }
+  XLA_COUNTER("AllReduceWireBytes", wire_bytes);
   ir::NodePtr node = ir::MakeNode<ir::ops::AllReduce>(
-      reduce_type, input_values, token, scale, std::move(groups));
+      reduce_type, input_values, token, scale, std::move(groups), precision);
   std::vector<XLATensor> results;
   std::vector<ir::Value> tokens;
   for (size_t i = 0; i < inputs.size(); ++i) {
@@ -200,6 +280,235 @@ std::pair<std::vector<XLATensor>, ir::Value> XLATensor::all_reduce(
   return {results, ir::Value(node, inputs.size())};
 }
 
+std::pair<XLATensor, ir::Value> XLATensor::reduce_scatter(
+    const XLATensor& input, const ir::Value& token, AllReduceType reduce_type,
+    double scale, int64_t scatter_dim, int64_t shard_count,
+    std::vector<std::vector<int64_t>> groups) {
+  int64_t canonical_dim = XlaHelpers::GetCanonicalDimensionIndex(
+      scatter_dim, input.shape().get().rank());
+  ir::NodePtr node = ir::MakeNode<ir::ops::ReduceScatter>(
+      reduce_type, input.GetIrValue(), token, scale, canonical_dim,
+      shard_count, std::move(groups));
+  return {input.CreateFrom(ir::Value(node, 0)), ir::Value(node, 1)};
+}
+
+std::tuple<XLATensor, XLATensor, XLATensor, ir::Value>
+XLATensor::sync_batch_norm(const XLATensor& input, const XLATensor& weight,
+                           const XLATensor& bias, const ir::Value& token,
+                           int64_t feature_index, double eps,
+                           std::vector<std::vector<int64_t>> groups) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::SyncBatchNorm>(
+      input.GetIrValue(), weight.GetIrValue(), bias.GetIrValue(), token,
+      XlaHelpers::GetCanonicalDimensionIndex(feature_index,
+                                             input.shape().get().rank()),
+      eps, std::move(groups));
+  return std::make_tuple(input.CreateFrom(ir::Value(node, 0)),
+                         input.CreateFrom(ir::Value(node, 1)),
+                         input.CreateFrom(ir::Value(node, 2)),
+                         ir::Value(node, 3));
+}
+
+std::tuple<XLATensor, XLATensor, XLATensor, ir::Value>
+XLATensor::sync_batch_norm_backward(const XLATensor& grad,
+                                    const XLATensor& input,
+                                    const XLATensor& weight,
+                                    const XLATensor& mean,
+                                    const XLATensor& variance,
+                                    const ir::Value& token,
+                                    int64_t feature_index, double eps,
+                                    std::vector<std::vector<int64_t>> groups) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::SyncBatchNormBackward>(
+      grad.GetIrValue(), input.GetIrValue(), weight.GetIrValue(),
+      mean.GetIrValue(), variance.GetIrValue(), token,
+      XlaHelpers::GetCanonicalDimensionIndex(feature_index,
+                                             input.shape().get().rank()),
+      eps, std::move(groups));
+  return std::make_tuple(input.CreateFrom(ir::Value(node, 0)),
+                         weight.CreateFrom(ir::Value(node, 1)),
+                         weight.CreateFrom(ir::Value(node, 2)),
+                         ir::Value(node, 3));
+}
+
+std::pair<XLATensor, ir::Value> XLATensor::all_to_all(
+    const XLATensor& input, const ir::Value& token, int64_t split_dimension,
+    int64_t concat_dimension, int64_t split_count,
+    std::vector<std::vector<int64_t>> groups) {
+  int64_t rank = input.shape().get().rank();
+  ir::NodePtr node = ir::MakeNode<ir::ops::AllToAll>(
+      input.GetIrValue(), token,
+      XlaHelpers::GetCanonicalDimensionIndex(split_dimension, rank),
+      XlaHelpers::GetCanonicalDimensionIndex(concat_dimension, rank),
+      split_count, std::move(groups));
+  return {input.CreateFrom(ir::Value(node, 0)), ir::Value(node, 1)};
+}
+
+std::tuple<XLATensor, XLATensor, XLATensor> XLATensor::gru_cell(
+    const XLATensor& input, const XLATensor& hidden, const XLATensor& kernel,
+    const XLATensor& recurrent_kernel, const XLATensor& bias,
+    const XLATensor& recurrent_bias) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::GruCell>(
+      input.GetIrValue(), hidden.GetIrValue(), kernel.GetIrValue(),
+      recurrent_kernel.GetIrValue(), bias.GetIrValue(),
+      recurrent_bias.GetIrValue());
+  return std::make_tuple(hidden.CreateFrom(ir::Value(node, 0)),
+                         hidden.CreateFrom(ir::Value(node, 1)),
+                         hidden.CreateFrom(ir::Value(node, 2)));
+}
+
+std::vector<XLATensor> XLATensor::gru_cell_backward(
+    const XLATensor& grad_hidden, const XLATensor& input,
+    const XLATensor& hidden, const XLATensor& kernel,
+    const XLATensor& recurrent_kernel, const XLATensor& gates,
+    const XLATensor& recurrent_output) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::GruCellBackward>(
+      grad_hidden.GetIrValue(), input.GetIrValue(), hidden.GetIrValue(),
+      kernel.GetIrValue(), recurrent_kernel.GetIrValue(), gates.GetIrValue(),
+      recurrent_output.GetIrValue());
+  return {input.CreateFrom(ir::Value(node, 0)),
+          hidden.CreateFrom(ir::Value(node, 1)),
+          kernel.CreateFrom(ir::Value(node, 2)),
+          recurrent_kernel.CreateFrom(ir::Value(node, 3)),
+          kernel.CreateFrom(ir::Value(node, 4)),
+          recurrent_kernel.CreateFrom(ir::Value(node, 5))};
+}
+
+std::tuple<XLATensor, XLATensor, XLATensor> XLATensor::lstm_cell(
+    const XLATensor& input, const XLATensor& hidden, const XLATensor& cell,
+    const XLATensor& weight, const XLATensor& bias) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::LstmCell>(
+      input.GetIrValue(), hidden.GetIrValue(), cell.GetIrValue(),
+      weight.GetIrValue(), bias.GetIrValue());
+  return std::make_tuple(cell.CreateFrom(ir::Value(node, 0)),
+                         hidden.CreateFrom(ir::Value(node, 1)),
+                         hidden.CreateFrom(ir::Value(node, 2)));
+}
+
+std::vector<XLATensor> XLATensor::lstm_cell_backward(
+    const XLATensor& grad_cell, const XLATensor& grad_hidden,
+    const XLATensor& input, const XLATensor& hidden, const XLATensor& cell,
+    const XLATensor& weight, const XLATensor& gates,
+    const XLATensor& new_cell) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::LstmCellBackward>(
+      grad_cell.GetIrValue(), grad_hidden.GetIrValue(), input.GetIrValue(),
+      hidden.GetIrValue(), cell.GetIrValue(), weight.GetIrValue(),
+      gates.GetIrValue(), new_cell.GetIrValue());
+  return {input.CreateFrom(ir::Value(node, 0)),
+          hidden.CreateFrom(ir::Value(node, 1)),
+          cell.CreateFrom(ir::Value(node, 2)),
+          weight.CreateFrom(ir::Value(node, 3)),
+          weight.CreateFrom(ir::Value(node, 4))};
+}
+
+std::pair<XLATensor, XLATensor> XLATensor::moe_routing(const XLATensor& gates,
+                                                       int64_t k,
+                                                       int64_t capacity) {
+  ir::NodePtr node =
+      ir::MakeNode<ir::ops::MoeRouting>(gates.GetIrValue(), k, capacity);
+  return {gates.CreateFrom(ir::Value(node, 0), at::ScalarType::Int),
+          gates.CreateFrom(ir::Value(node, 1), at::ScalarType::Int)};
+}
+
+std::pair<XLATensor, ir::Value> XLATensor::moe_dispatch(
+    const XLATensor& input, const XLATensor& expert_indices,
+    const XLATensor& positions, const ir::Value& token, int64_t num_experts,
+    int64_t capacity, int64_t split_count,
+    std::vector<std::vector<int64_t>> groups) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::MoeDispatch>(
+      input.GetIrValue(), expert_indices.GetIrValue(), positions.GetIrValue(),
+      token, num_experts, capacity, split_count, std::move(groups));
+  return {input.CreateFrom(ir::Value(node, 0)), ir::Value(node, 1)};
+}
+
+std::pair<XLATensor, ir::Value> XLATensor::moe_combine(
+    const XLATensor& expert_outputs, const XLATensor& expert_indices,
+    const XLATensor& positions, const ir::Value& token, int64_t split_count,
+    std::vector<std::vector<int64_t>> groups) {
+  ir::NodePtr node = ir::MakeNode<ir::ops::MoeCombine>(
+      expert_outputs.GetIrValue(), expert_indices.GetIrValue(),
+      positions.GetIrValue(), token, split_count, std::move(groups));
+  return {expert_outputs.CreateFrom(ir::Value(node, 0)), ir::Value(node, 1)};
+}
+
+std::pair<std::vector<XLATensor>, std::vector<XLATensor>>
+XLATensor::optimizer_step(OptimizerStepKind kind,
+                          absl::Span<const XLATensor> weights,
+                          absl::Span<const XLATensor> grads,
+                          absl::Span<const XLATensor> states,
+                          absl::Span<const XLATensor> hyperparameters,
+                          bool nesterov, bool apply_weight_decay,
+                          float epsilon) {
+  XLA_CHECK(!weights.empty()) << "optimizer_step needs at least one weight";
+  auto get_ir_values = [](absl::Span<const XLATensor> tensors) {
+    std::vector<ir::Value> values;
+    values.reserve(tensors.size());
+    for (const XLATensor& tensor : tensors) {
+      values.push_back(tensor.GetIrValue());
+    }
+    return values;
+  };
+  ir::NodePtr node = ir::MakeNode<ir::ops::OptimizerStep>(
+      kind, get_ir_values(weights), get_ir_values(grads),
+      get_ir_values(states), get_ir_values(hyperparameters), nesterov,
+      apply_weight_decay, epsilon);
+  std::vector<XLATensor> steps;
+  steps.reserve(weights.size());
+  for (size_t i = 0; i < weights.size(); ++i) {
+    steps.push_back(weights[i].CreateFrom(ir::Value(node, i)));
+  }
+  std::vector<XLATensor> new_states;
+  new_states.reserve(states.size());
+  for (size_t i = 0; i < states.size(); ++i) {
+    new_states.push_back(
+        states[i].CreateFrom(ir::Value(node, weights.size() + i)));
+  }
+  return {std::move(steps), std::move(new_states)};
+}
+
+std::pair<XLATensor, XLATensor> XLATensor::pad_to_bucket(
+    const XLATensor& input, int64_t dim, at::Scalar padding_value) {
+  auto input_shape = input.shape();
+  int64_t rank = input_shape.get().rank();
+  int64_t canonical_dim = XlaHelpers::GetCanonicalDimensionIndex(dim, rank);
+  int64_t size = input_shape.get().dimensions(canonical_dim);
+  int64_t bucket = GetShapeBucket(size);
+  xla::PaddingConfig padding_config;
+  for (int64_t i = 0; i < rank; ++i) {
+    xla::PaddingConfig::PaddingConfigDimension* dims =
+        padding_config.add_dimensions();
+    dims->set_edge_padding_low(0);
+    dims->set_edge_padding_high(i == canonical_dim ? bucket - size : 0);
+    dims->set_interior_padding(0);
+  }
+  const Device& device = input.GetDevice();
+  // The length enters the graph as device data, the special scalars 0 and 1
+  // included, so all the sizes within a bucket share the graph hash.
+  ir::Value mask = ir::ops::BucketMask(
+      GetDeviceDataForScalar(size, xla::PrimitiveType::S64, device), bucket);
+  c10::optional<at::Tensor> tensor_data = input.CurrentTensorData();
+  // The inputs still on the host get padded there, so that the graph only
+  // sees the bucket size. The 16 bits floating point types are held as raw
+  // int16_t bits, which the padding value cannot be converted to.
+  if (!input.CurrentIrValue() && tensor_data &&
+      tensor_data->scalar_type() != at::ScalarType::BFloat16 &&
+      tensor_data->scalar_type() != at::ScalarType::Half) {
+    XLA_COUNTER("PadToBucketOnHost", 1);
+    XLATensor padded = Create(
+        PadHostTensor(*tensor_data, canonical_dim, bucket, padding_value),
+        device);
+    padded.SetScalarType(input.dtype());
+    return {padded, input.CreateFrom(mask, at::ScalarType::Bool)};
+  }
+  // The device resident inputs carry their own size into the graph, which
+  // then compiles once per size anyway.
+  ir::Value padded = ir::MakeNode<ir::ops::XlaPad>(
+      input.GetIrValue(),
+      GetIrValueForScalar(padding_value, input_shape.get().element_type(),
+                          device),
+      std::move(padding_config));
+  return {input.CreateFrom(padded),
+          input.CreateFrom(mask, at::ScalarType::Bool)};
+}
+
 XLATensor XLATensor::annotate(const XLATensor& input, std::string annotation) {
   return input.CreateFrom(
       ir::MakeNode<ir::ops::Annotate>(input.GetIrValue(), annotation));
@@ -265,6 +574,36 @@ void XLATensor::linspace_out(XLATensor& out, at::Scalar start, at::Scalar stop,
   out.SetScalarType(scalar_type);
 }
 
+XLATensor XLATensor::remat(const XLATensor& input, std::string scope) {
+  return input.CreateFrom(
+      ir::MakeNode<ir::ops::Remat>(input.GetIrValue(), std::move(scope)));
+}
+
+XLATensor XLATensor::shard(const XLATensor& input,
+                           absl::Span<const int64_t> tile_dimensions) {
+  XLA_CHECK_EQ(tile_dimensions.size(), input.shape().get().rank())
+      << "Sharding needs one tile dimension per tensor dimension";
+  int64_t num_tiles = 1;
+  for (int64_t dim : tile_dimensions) {
+    XLA_CHECK_GT(dim, 0);
+    num_tiles *= dim;
+  }
+  xla::OpSharding sharding;
+  if (num_tiles == 1) {
+    sharding.set_type(xla::OpSharding::REPLICATED);
+  } else {
+    sharding.set_type(xla::OpSharding::OTHER);
+    for (int64_t dim : tile_dimensions) {
+      sharding.add_tile_assignment_dimensions(dim);
+    }
+    for (int64_t i = 0; i < num_tiles; ++i) {
+      sharding.add_tile_assignment_devices(i);
+    }
+  }
+  return input.CreateFrom(ir::MakeNode<ir::ops::Sharding>(input.GetIrValue(),
+                                                          std::move(sharding)));
+}
+
 XLATensor XLATensor::xla_avg_pool(
     const XLATensor& input, absl::Span<const int64_t> kernel_size,
     absl::Span<const int64_t> stride,
@@ -312,8 +651,29 @@ XLATensor XLATensor::xla_max_pool_grad(const XLATensor& input,
       XlaHelpers::I64List(kernel_size), XlaHelpers::I64List(stride), padding));
 }
 
+XLATensor XLATensor::xla_random_init(
+    absl::Span<const int64_t> size,
+    ir::ops::RandomInitDistribution distribution, double scale, int64_t seed0,
+    int64_t seed1, const Device& device, at::ScalarType scalar_type) {
+  xla::Shape shape = MakeArrayShapeFromDimensions(
+      size, /*dynamic_dimensions=*/{},
+      MakeXlaPrimitiveType(scalar_type, &device), device.hw_type);
+  return Create(ir::MakeNode<ir::ops::RandomInit>(
+                    shape, distribution, scale, seed0, seed1,
+                    device.hw_type == swift_xla::DeviceType::TPU
+                        ? ir::ops::BitGeneratorType::THREE_FRY
+                        : ir::ops::BitGeneratorType::PHILOX),
+                device, scalar_type);
+}
+
 XLATensor XLATensor::xla_replica_id(const Device& device) {
   return XLATensor::Create(ir::MakeNode<ir::ops::ReplicaId>(), device);
 }
 
+XLATensor XLATensor::xla_rng_seed(const Device& device) {
+  return XLATensor::Create(ir::MakeNode<ir::ops::RngSeed>(
+                               GetRngSeed(device), GetNextRngOpIndex(device)),
+                           device);
+}
+
 }  // namespace swift_xla
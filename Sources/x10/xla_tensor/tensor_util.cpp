@@ -15,22 +15,26 @@
 #include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
 
 #include <algorithm>
+#include <cstring>
 #include <functional>
 #include <list>
 #include <numeric>
 #include <thread>
 
 #include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
 #include "tensorflow/compiler/xla/xla_client/multi_wait.h"
 #include "tensorflow/compiler/xla/xla_client/sys_util.h"
 #include "tensorflow/compiler/xla/xla_client/tf_logging.h"
 #include "tensorflow/compiler/xla/xla_client/thread_pool.h"
 #include "tensorflow/compiler/xla/xla_client/util.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/conversion_kernels.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/helpers.h"
 #include "tensorflow/compiler/tf2xla/xla_tensor/layout_manager.h"
 #include "tensorflow/compiler/xla/literal_util.h"
 #include "tensorflow/compiler/xla/shape_util.h"
 #include "tensorflow/core/lib/bfloat16/bfloat16.h"
+#include "tensorflow/core/platform/env.h"
 
 namespace swift_xla {
 namespace {
@@ -230,6 +234,84 @@ void CopyData<tensorflow::bfloat16, at::BFloat16>(tensorflow::bfloat16* dest,
   CheckedMemcpy<tensorflow::bfloat16, at::BFloat16>(dest, source, n);
 }
 
+// The most common conversions go through the vectorized kernels, which return
+// the number of elements they handled. The tail (or everything, if the CPU
+// lacks the required features) is handled by the scalar path.
+template <>
+void CopyData<tensorflow::bfloat16, float>(tensorflow::bfloat16* dest,
+                                           const float* source, int64_t n,
+                                           const CopyCasted&) {
+  int64_t converted =
+      ConvertFloatToBFloat16(source, reinterpret_cast<uint16_t*>(dest), n);
+  StridedCopy(dest + converted, 1, source + converted, 1, n - converted);
+}
+template <>
+void CopyData<float, tensorflow::bfloat16>(float* dest,
+                                           const tensorflow::bfloat16* source,
+                                           int64_t n, const CopyCasted&) {
+  int64_t converted = ConvertBFloat16ToFloat(
+      reinterpret_cast<const uint16_t*>(source), dest, n);
+  StridedCopy(dest + converted, 1, source + converted, 1, n - converted);
+}
+template <>
+void CopyData<xla::half, float>(xla::half* dest, const float* source,
+                                int64_t n, const CopyCasted&) {
+  int64_t converted =
+      ConvertFloatToHalf(source, reinterpret_cast<uint16_t*>(dest), n);
+  StridedCopy(dest + converted, 1, source + converted, 1, n - converted);
+}
+template <>
+void CopyData<float, xla::half>(float* dest, const xla::half* source,
+                                int64_t n, const CopyCasted&) {
+  int64_t converted =
+      ConvertHalfToFloat(reinterpret_cast<const uint16_t*>(source), dest, n);
+  StridedCopy(dest + converted, 1, source + converted, 1, n - converted);
+}
+template <>
+void CopyData<int32_t, int64_t>(int32_t* dest, const int64_t* source,
+                                int64_t n, const CopyDirect&) {
+  int64_t converted = ConvertInt64ToInt32(source, dest, n);
+  std::copy(source + converted, source + n, dest + converted);
+}
+
+int64_t GetMaxCopyThreads() {
+  // Use at most 50% of the available cores.
+  return std::max<int64_t>(std::thread::hardware_concurrency() / 2, 1);
+}
+
+// Contiguous copies of tensors above XLA_PARALLEL_COPY_MIN_ELEMENTS are split
+// in chunks copied by the thread pool, while smaller ones (where the scheduling
+// cost dominates) run on the caller thread.
+template <typename D, typename S, typename C>
+void ParallelCopyData(D* dest, const S* source, int64_t n, const C& copy_type) {
+  static const int64_t kMinParallelElements =
+      xla::sys_util::GetEnvInt("XLA_PARALLEL_COPY_MIN_ELEMENTS", 1 << 20);
+  // Keep chunk boundaries aligned, so that the vectorized conversions run over
+  // the whole chunks.
+  static const int64_t kChunkAlignment = 64;
+  int64_t num_parts = std::min<int64_t>(
+      GetMaxCopyThreads(), n / std::max<int64_t>(kMinParallelElements, 1));
+  if (num_parts <= 1) {
+    CopyData<D, S>(dest, source, n, copy_type);
+    return;
+  }
+  int64_t chunk_size = (n + num_parts - 1) / num_parts;
+  chunk_size = (chunk_size + kChunkAlignment - 1) / kChunkAlignment *
+               kChunkAlignment;
+  num_parts = (n + chunk_size - 1) / chunk_size;
+  xla::util::MultiWait mwait(num_parts - 1);
+  for (int64_t i = 1; i < num_parts; ++i) {
+    auto copy_fn = [&, i]() {
+      int64_t start = i * chunk_size;
+      CopyData<D, S>(dest + start, source + start,
+                     std::min<int64_t>(chunk_size, n - start), copy_type);
+    };
+    xla::env::ScheduleClosure(mwait.Completer(std::move(copy_fn)));
+  }
+  CopyData<D, S>(dest, source, chunk_size, copy_type);
+  mwait.Wait();
+}
+
 std::vector<int64_t> GetIterationDimensions(const xla::Shape& shape) {
   // We want to favor the most minor dimension as core iteration dimension, as
   // this walks one of the two tensors buffers in a cache friendly fashion.
@@ -267,9 +349,7 @@ std::vector<CopyPartition> CreateCopyPartitions(
     int64_t strided_copy_dimension) {
   // The minimum number of elements copy that can be assigned to a thread.
   static const int64_t kMinThreadElements = 100000;
-  // Use at most 50% of the available cores.
-  int64_t max_parts =
-      std::max<int64_t>(std::thread::hardware_concurrency() / 2, 1);
+  int64_t max_parts = GetMaxCopyThreads();
   // Find the maximum dimension which is not the strided copy dimension.
   int64_t max_dim = -1;
   for (int64_t i = 0; i < dimensions.size(); ++i) {
@@ -338,9 +418,10 @@ void CopyTensors(const void* src_buffer, const xla::Shape& src_shape,
   DType* dest_data = reinterpret_cast<DType*>(dest_buffer);
   if (src_shape.layout().minor_to_major() ==
       dest_shape.layout().minor_to_major()) {
-    CopyData<DType, SType>(dest_data, src_data, total_elements,
-                           typename CopyType < NeedCast<SType>::value ||
-                               NeedCast<DType>::value > ::type());
+    ParallelCopyData<DType, SType>(
+        dest_data, src_data, total_elements,
+        typename CopyType < NeedCast<SType>::value ||
+            NeedCast<DType>::value > ::type());
   } else if (total_elements > 0) {
     // We issue a multi-threaded copy by slicing the bigger dimension and
     // assigning its copy to different threads. This code is only valid for
@@ -350,14 +431,18 @@ void CopyTensors(const void* src_buffer, const xla::Shape& src_shape,
     std::vector<int64_t> iter_dims = GetIterationDimensions(dest_shape);
     std::vector<CopyPartition> parts =
         CreateCopyPartitions(dest_shape.dimensions(), iter_dims.front());
-    xla::util::MultiWait mwait(parts.size());
-    for (size_t i = 0; i < parts.size(); ++i) {
+    xla::util::MultiWait mwait(parts.size() - 1);
+    for (size_t i = 1; i < parts.size(); ++i) {
       auto copy_fn = [&, i]() {
         SlicedCopy<SType, DType>(dest_shape.dimensions(), src_data, src_strides,
                                  dest_data, dest_strides, iter_dims, parts[i]);
       };
       xla::env::ScheduleClosure(mwait.Completer(std::move(copy_fn)));
     }
+    // The first partition is copied by the caller thread, which also avoids
+    // going through the thread pool for the small tensors.
+    SlicedCopy<SType, DType>(dest_shape.dimensions(), src_data, src_strides,
+                             dest_data, dest_strides, iter_dims, parts[0]);
     mwait.Wait();
   }
 }
@@ -531,6 +616,53 @@ at::Tensor XlaLiteralToTensorHelper(const xla::Literal& literal,
   }
 }
 
+// Above two chunks, tensors get hashed one fixed size chunk per closure, so
+// the hash of a tensor does not depend on the number of threads.
+constexpr size_t kHashChunkBytes = 1 << 20;
+// The sampled hashes read kHashSamples windows of kHashSampleBytes, evenly
+// spread over the tensor.
+constexpr size_t kSampledHashMinBytes = 16 << 20;
+constexpr size_t kHashSamples = 256;
+constexpr size_t kHashSampleBytes = 4096;
+
+bool UseSampledTensorHash() {
+  static const bool sampled =
+      xla::sys_util::GetEnvBool("XLA_SAMPLED_TENSOR_HASH", false);
+  return sampled;
+}
+
+xla::hash_t ChunkedDataHash(const char* data, size_t size) {
+  size_t num_chunks = (size + kHashChunkBytes - 1) / kHashChunkBytes;
+  std::vector<xla::hash_t> hashes(num_chunks);
+  xla::util::MultiWait mwait(num_chunks);
+  for (size_t i = 0; i < num_chunks; ++i) {
+    auto hash_chunk = [&, i]() {
+      size_t offset = i * kHashChunkBytes;
+      hashes[i] = xla::util::DataHash(
+          data + offset, std::min(kHashChunkBytes, size - offset));
+    };
+    xla::env::ScheduleClosure(mwait.Completer(std::move(hash_chunk)));
+  }
+  mwait.Wait();
+  XLA_COUNTER("ChunkedTensorHash", 1);
+  return xla::util::HashCombine(
+      size, xla::util::DataHash(hashes.data(),
+                                hashes.size() * sizeof(xla::hash_t)));
+}
+
+// Only valid for the users which compare the data on hash matches, like the
+// device data cache, as tensors differing out of the samples collide.
+xla::hash_t SampledDataHash(const char* data, size_t size) {
+  size_t stride = (size - kHashSampleBytes) / (kHashSamples - 1);
+  xla::hash_t hash = size;
+  for (size_t i = 0; i < kHashSamples; ++i) {
+    hash = xla::util::HashCombine(
+        hash, xla::util::DataHash(data + i * stride, kHashSampleBytes));
+  }
+  XLA_COUNTER("SampledTensorHash", 1);
+  return hash;
+}
+
 }  // namespace
 
 std::vector<int64_t> ComputeShapeStrides(const xla::Shape& shape) {
@@ -611,19 +743,88 @@ xla::ComputationClient::DataPtr TensorToXlaData(const at::Tensor& tensor,
       tensor, CreateComputationShapeFromTensor(tensor, &device), device);
 }
 
+xla::ComputationClient::DataPtr BufferToXlaData(const void* data,
+                                                at::ScalarType type,
+                                                absl::Span<const int64_t> dims,
+                                                const xla::Shape& shape,
+                                                const Device& device) {
+  auto* device_ptr = xla::GetX10Device(device);
+  xla::PrimitiveType host_type = TensorTypeToRawXlaType(type);
+  if (device_ptr->IsLocal() && host_type == shape.element_type()) {
+    xla::Shape host_shape =
+        MakeSwiftTensorLayout(dims, /*dynamic_dimensions=*/{}, host_type);
+    xla::BorrowingLiteral literal(static_cast<const char*>(data), host_shape);
+    XLA_COUNTER("BorrowedBufferTransfers", 1);
+    return device_ptr->TransferToServer(std::move(literal), shape);
+  }
+  // The 16 bits floating point types share their host buffer type with Short,
+  // so the converting path would read them as integers.
+  XLA_CHECK(type != at::ScalarType::BFloat16 && type != at::ScalarType::Half)
+      << "Cannot convert " << type << " host data to " << shape;
+  std::vector<int64_t> tensor_dims(dims.begin(), dims.end());
+  size_t len = at::GetLenFromShape(tensor_dims);
+  switch (type) {
+#define DEFINE_VIEW_CASE(name, aten_name, DType)                         \
+  case at::ScalarType::aten_name: {                                      \
+    at::Tensor view(std::make_unique<at::NonOwnedAnyScalarBuffer<DType>>( \
+                        static_cast<const DType*>(data), len),           \
+                    std::move(tensor_dims));                             \
+    return TensorToXlaData(view, shape, device);                         \
+  }
+    LIST_SCALAR_TYPES(DEFINE_VIEW_CASE)
+#undef DEFINE_VIEW_CASE
+  }
+  XLA_ERROR() << "Unsupported scalar type: " << type;
+}
+
+xla::ComputationClient::DataPtr MappedFileToXlaData(
+    const std::string& path, size_t offset, at::ScalarType type,
+    absl::Span<const int64_t> dims, const Device& device,
+    bool to_reduced_precision) {
+  std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region;
+  XLA_CHECK_OK(tensorflow::Env::Default()->NewReadOnlyMemoryRegionFromFile(
+      path, &region));
+  size_t size = xla::util::Multiply<size_t>(dims) *
+                xla::ShapeUtil::ByteSizeOfPrimitiveType(
+                    TensorTypeToRawXlaType(type));
+  XLA_CHECK_LE(offset + size, region->length())
+      << "The tensor at offset " << offset << " runs past the end of " << path;
+  xla::PrimitiveType device_type =
+      to_reduced_precision && type == at::ScalarType::Float
+          ? xla::PrimitiveType::BF16
+          : MakeXlaPrimitiveType(type, &device);
+  xla::Shape shape = MakeArrayShapeFromDimensions(
+      dims, /*dynamic_dimensions=*/{}, device_type, device.hw_type);
+  XLA_COUNTER("MappedFileLoadBytes", size);
+  return BufferToXlaData(static_cast<const char*>(region->data()) + offset,
+                         type, dims, shape, device);
+}
+
 std::vector<xla::ComputationClient::DataPtr> CreateTensorsData(
     const std::vector<at::Tensor>& tensors, const std::string& device) {
+  Device device_id(device);
+  std::vector<xla::Shape> shapes;
+  shapes.reserve(tensors.size());
+  for (const at::Tensor& tensor : tensors) {
+    shapes.push_back(CreateComputationShapeFromTensor(tensor, &device_id));
+  }
+  return CreateTensorsData(tensors, shapes, device);
+}
+
+std::vector<xla::ComputationClient::DataPtr> CreateTensorsData(
+    const std::vector<at::Tensor>& tensors,
+    const std::vector<xla::Shape>& shapes, const std::string& device) {
+  XLA_CHECK_EQ(tensors.size(), shapes.size());
   std::vector<xla::ComputationClient::TensorSource> source_tensors;
   Device device_id(device);
   for (size_t i = 0; i < tensors.size(); ++i) {
-    xla::Shape shape = CreateComputationShapeFromTensor(tensors[i], &device_id);
     auto populate_fn =
         [&, i](const xla::ComputationClient::TensorSource& source_tensor,
                void* dest_buffer, size_t dest_buffer_size) {
           PopulateTensorBuffer(tensors[i], source_tensor.shape, dest_buffer,
                                dest_buffer_size, device_id);
         };
-    source_tensors.emplace_back(std::move(shape), std::move(populate_fn));
+    source_tensors.emplace_back(shapes[i], std::move(populate_fn));
   }
   return xla::GetX10Device(device)->TransferToServer(source_tensors);
 }
@@ -658,33 +859,39 @@ std::vector<at::Tensor> XlaDataToTensors(
   return tensors;
 }
 
+void XlaDataToBuffer(const xla::ComputationClient::DataPtr& xla_data,
+                     at::ScalarType dest_element_type, void* dest,
+                     size_t dest_size) {
+  const xla::Shape& shape = xla_data->shape();
+  xla::PrimitiveType dest_type = TensorTypeToRawXlaType(dest_element_type);
+  if (shape.element_type() == dest_type && shape.is_static()) {
+    xla::Shape dest_shape = MakeSwiftTensorLayout(
+        shape.dimensions(), /*dynamic_dimensions=*/{}, dest_type);
+    XLA_CHECK_EQ(xla::ShapeUtil::ByteSizeOf(dest_shape), dest_size);
+    xla::MutableBorrowingLiteral literal(static_cast<const char*>(dest),
+                                         dest_shape);
+    xla::ComputationClient::TransferFromServer({xla_data}, {literal});
+    XLA_COUNTER("DirectTransferFromServer", 1);
+    return;
+  }
+  at::Tensor tensor =
+      std::move(XlaDataToTensors({xla_data}, dest_element_type).front());
+  size_t size = tensor.buffer().size() *
+                at::internal::GetSizeof(tensor.scalar_type());
+  XLA_CHECK_EQ(size, dest_size);
+  std::memcpy(dest, tensor.buffer().raw_data(), size);
+}
+
 xla::hash_t TensorHash(const at::Tensor& tensor) {
-  int64_t size =
-      tensor.buffer().size() * at::internal::GetSizeof(tensor.scalar_type());
-  switch (tensor.scalar_type()) {
-    case at::ScalarType::Bool:
-      return xla::util::DataHash(tensor.data<bool>().data(), size);
-    case at::ScalarType::Byte:
-      return xla::util::DataHash(tensor.data<uint8_t>().data(), size);
-    case at::ScalarType::Char:
-      return xla::util::DataHash(tensor.data<int8_t>().data(), size);
-    case at::ScalarType::Short:
-      return xla::util::DataHash(tensor.data<int16_t>().data(), size);
-    case at::ScalarType::Int:
-      return xla::util::DataHash(tensor.data<int32_t>().data(), size);
-    case at::ScalarType::Long:
-      return xla::util::DataHash(tensor.data<int64_t>().data(), size);
-    case at::ScalarType::Float:
-      return xla::util::DataHash(tensor.data<float>().data(), size);
-    case at::ScalarType::Double:
-      return xla::util::DataHash(tensor.data<double>().data(), size);
-    case at::ScalarType::BFloat16:
-      return xla::util::DataHash(tensor.data<at::BFloat16>().data(), size);
-    case at::ScalarType::Half:
-      return xla::util::DataHash(tensor.data<at::Half>().data(), size);
-    default:
-      XLA_ERROR() << "Unsupported scalar type: " << tensor.scalar_type();
+  const char* data = static_cast<const char*>(tensor.buffer().raw_data());
+  size_t size = tensor.buffer().raw_size();
+  if (size >= kSampledHashMinBytes && UseSampledTensorHash()) {
+    return SampledDataHash(data, size);
+  }
+  if (size >= 2 * kHashChunkBytes) {
+    return ChunkedDataHash(data, size);
   }
+  return xla::util::DataHash(data, size);
 }
 
 std::vector<xla::Shape> GetComponentShapes(const xla::Shape& shape) {
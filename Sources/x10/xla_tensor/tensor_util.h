@@ -41,6 +41,14 @@ std::vector<at::Tensor> XlaDataToTensors(
     absl::Span<const xla::ComputationClient::DataPtr> xla_data,
     at::ScalarType dest_element_type);
 
+// Downloads the device data into the dest buffer, laid out in row major order
+// with the given element type. When the device data already has the element
+// type and the row major layout, the transfer writes straight into the buffer,
+// which can be any caller owned memory (like a mmap-ed file).
+void XlaDataToBuffer(const xla::ComputationClient::DataPtr& xla_data,
+                     at::ScalarType dest_element_type, void* dest,
+                     size_t dest_size);
+
 // Uploads an ATEN tensor data to the device and fetches the corresponding
 // device data handle.
 xla::ComputationClient::DataPtr TensorToXlaData(const at::Tensor& tensor,
@@ -50,10 +58,33 @@ xla::ComputationClient::DataPtr TensorToXlaData(const at::Tensor& tensor,
 xla::ComputationClient::DataPtr TensorToXlaData(const at::Tensor& tensor,
                                                 const Device& device);
 
+// Uploads row major host data of the given type and dimensions to the device,
+// as the given device shape. The data only needs to stay valid during the call,
+// and can be any caller owned memory, like a file mapping. When the device is
+// local and the element types match, the data gets transferred straight from
+// there, otherwise it is converted on its way to the transfer buffer.
+xla::ComputationClient::DataPtr BufferToXlaData(const void* data,
+                                                at::ScalarType type,
+                                                absl::Span<const int64_t> dims,
+                                                const xla::Shape& shape,
+                                                const Device& device);
+
+// Maps the file in memory and uploads the row major tensor of the given type
+// and dimensions found at the offset. Only the pages of the tensor get read, so
+// loading a model one tensor at a time holds at most the largest tensor in
+// host memory. Floats get stored as bfloat16 if to_reduced_precision is set.
+xla::ComputationClient::DataPtr MappedFileToXlaData(
+    const std::string& path, size_t offset, at::ScalarType type,
+    absl::Span<const int64_t> dims, const Device& device,
+    bool to_reduced_precision);
+
 // Wraps a concrete tensor into a computation client TensorSource.
 xla::ComputationClient::TensorSource TensorToTensorSource(
     const at::Tensor& tensor, const Device& device);
 
+// Hashes the tensor data, in parallel chunks for the large tensors. With
+// XLA_SAMPLED_TENSOR_HASH set, the tensors of 16MB and more only get sampled,
+// so equal hashes must be confirmed by comparing the data.
 xla::hash_t TensorHash(const at::Tensor& tensor);
 
 // Retrieves the device data handles by parallel uploading data onto the
@@ -61,6 +92,12 @@ xla::hash_t TensorHash(const at::Tensor& tensor);
 std::vector<xla::ComputationClient::DataPtr> CreateTensorsData(
     const std::vector<at::Tensor>& tensors, const std::string& device);
 
+// Same as above, with the tensors uploaded as the given device shapes, which
+// can differ from the tensors in element type and layout.
+std::vector<xla::ComputationClient::DataPtr> CreateTensorsData(
+    const std::vector<at::Tensor>& tensors,
+    const std::vector<xla::Shape>& shapes, const std::string& device);
+
 // Creates an XLA literal out of an ATEN tensor. If shape is specified, that
 // shape+layout will be used, otherwise one will be generated out of the ATEN
 // tensor shape. The device argument (can be nullptr for the default device)
@@ -0,0 +1,215 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/tracelets.h"
+
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#include "absl/container/node_hash_map.h"
+#include "absl/container/node_hash_set.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ops/xla_ops.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/sys_util.h"
+#include "tensorflow/compiler/xla/xla_client/tf_logging.h"
+#include "tensorflow/compiler/xla/xla_client/util.h"
+
+namespace swift_xla {
+namespace {
+
+// Kept per thread, along with the step and compilation counts it is driven by,
+// so that the threads tracing different models do not cut each other's graphs.
+struct TraceletState {
+  // The earlier traces, by the hash of their first node.
+  absl::node_hash_map<xla::hash_t, std::vector<std::vector<xla::hash_t>>>
+      tails_by_prefix;
+  absl::node_hash_set<xla::hash_t> cutpoints;
+  int64_t steps = 0;
+  int64_t uncached_compiles = 0;
+  int64_t prev_uncached_compile = 0;
+  bool in_cut = false;
+};
+
+thread_local TraceletState g_tracelet_state;
+
+// The cutpoints learned by the earlier runs, kept in the tracelet_cutpoints
+// file of the persistent cache folder, one hash per line as its high and low
+// 64 bits, to which the new ones get appended.
+class PersistedCutpoints {
+ public:
+  static PersistedCutpoints* Get() {
+    static PersistedCutpoints* cutpoints = new PersistedCutpoints();
+    return cutpoints;
+  }
+
+  // Never changes once loaded, so that it is read without locking.
+  const absl::node_hash_set<xla::hash_t>& loaded() const { return loaded_; }
+
+  void Record(const xla::hash_t& cutpoint) {
+    if (path_.empty()) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(lock_);
+    std::ofstream cutpoints_file(path_, std::ios_base::app);
+    cutpoints_file << absl::Uint128High64(cutpoint) << " "
+                   << absl::Uint128Low64(cutpoint) << "\n";
+  }
+
+ private:
+  PersistedCutpoints() {
+    std::string cache_path =
+        xla::sys_util::GetEnvString("XLA_PERSISTENT_CACHE_PATH", "");
+    if (cache_path.empty()) {
+      return;
+    }
+    path_ = absl::StrCat(cache_path, "/tracelet_cutpoints");
+    std::ifstream cutpoints_file(path_);
+    uint64_t high;
+    uint64_t low;
+    while (cutpoints_file >> high >> low) {
+      loaded_.insert(absl::MakeUint128(high, low));
+    }
+    XLA_COUNTER("TraceletPersistedCutpoints", loaded_.size());
+  }
+
+  std::string path_;
+  std::mutex lock_;
+  absl::node_hash_set<xla::hash_t> loaded_;
+};
+
+// The number of steps after which the compilations start being looked at.
+int64_t SteadyStateStep() {
+  static const int64_t steady_state_step =
+      xla::sys_util::GetEnvInt("XLA_TRACELETS_STEADY_STEP", 3);
+  return steady_state_step;
+}
+
+size_t MaxTailsPerPrefix() {
+  static const size_t max_tails =
+      xla::sys_util::GetEnvInt("XLA_TRACELETS_MAX_TAILS", 8);
+  return max_tails;
+}
+
+size_t CommonPrefixLength(absl::Span<const xla::hash_t> trace1,
+                          absl::Span<const xla::hash_t> trace2) {
+  if (trace2.size() > trace1.size()) {
+    std::swap(trace1, trace2);
+  }
+  return std::mismatch(trace2.begin(), trace2.end(), trace1.begin()).first -
+         trace2.begin();
+}
+
+void AddCutpoint(const xla::hash_t& cutpoint) {
+  if (g_tracelet_state.cutpoints.insert(cutpoint).second &&
+      PersistedCutpoints::Get()->loaded().count(cutpoint) == 0) {
+    XLA_COUNTER("TraceletCutpoints", 1);
+    TF_VLOG(3) << "New tracelet cutpoint " << xla::util::HexHash(cutpoint);
+    PersistedCutpoints::Get()->Record(cutpoint);
+  }
+}
+
+}  // namespace
+
+bool Tracelets::IsEnabled() {
+  static const bool tracelets =
+      xla::sys_util::GetEnvBool("XLA_TRACELETS", false);
+  return tracelets;
+}
+
+bool Tracelets::IsCutpoint(const xla::hash_t& node_hash) {
+  return g_tracelet_state.cutpoints.count(node_hash) > 0 ||
+         PersistedCutpoints::Get()->loaded().count(node_hash) > 0;
+}
+
+void Tracelets::Learn(absl::Span<const ir::Node* const> post_order) {
+  int64_t steps = g_tracelet_state.steps;
+  if (steps < SteadyStateStep()) {
+    return;
+  }
+  // For the first steady state step, just record number of compilations seen so
+  // far and return.
+  if (steps == SteadyStateStep()) {
+    g_tracelet_state.prev_uncached_compile = g_tracelet_state.uncached_compiles;
+    return;
+  }
+  XLA_CHECK_GE(g_tracelet_state.uncached_compiles,
+               g_tracelet_state.prev_uncached_compile);
+  if (g_tracelet_state.uncached_compiles ==
+      g_tracelet_state.prev_uncached_compile) {
+    // No new compilations, nothing to do.
+    return;
+  }
+  g_tracelet_state.prev_uncached_compile = g_tracelet_state.uncached_compiles;
+  XLA_CHECK(!post_order.empty());
+  std::vector<xla::hash_t> po_trace;
+  po_trace.reserve(post_order.size());
+  for (const ir::Node* node : post_order) {
+    po_trace.push_back(node->hash());
+  }
+  std::vector<std::vector<xla::hash_t>>& tails =
+      g_tracelet_state.tails_by_prefix[po_trace.front()];
+  // The earlier trace sharing the longest prefix with this one gets cut where
+  // they diverge.
+  auto longest_it = tails.end();
+  size_t longest = 0;
+  for (auto it = tails.begin(); it != tails.end(); ++it) {
+    size_t length = CommonPrefixLength(*it, po_trace);
+    if (longest_it == tails.end() || length > longest) {
+      longest_it = it;
+      longest = length;
+    }
+  }
+  if (longest_it != tails.end() &&
+      longest == std::min(longest_it->size(), po_trace.size())) {
+    // One trace extends the other, there is nothing to cut.
+    return;
+  }
+  // The device data differ on every step by nature, cutting before them would
+  // not make the pieces any more alike.
+  if (longest_it != tails.end() && longest > 0 &&
+      post_order[longest]->op() != ir::ops::xla_device_data) {
+    longest_it->resize(longest);
+    AddCutpoint(po_trace[longest - 1]);
+  } else if (tails.size() < MaxTailsPerPrefix()) {
+    tails.push_back(std::move(po_trace));
+  }
+}
+
+void Tracelets::MarkStep() { ++g_tracelet_state.steps; }
+
+void Tracelets::RecordCompileLookup(bool cached) {
+  if (!cached) {
+    ++g_tracelet_state.uncached_compiles;
+  }
+  if (g_tracelet_state.in_cut) {
+    if (cached) {
+      XLA_COUNTER("TraceletSavedCompiles", 1);
+    } else {
+      XLA_COUNTER("TraceletCutCompiles", 1);
+    }
+  }
+}
+
+Tracelets::CutScope::CutScope() {
+  XLA_COUNTER("TraceletCuts", 1);
+  g_tracelet_state.in_cut = true;
+}
+
+Tracelets::CutScope::~CutScope() { g_tracelet_state.in_cut = false; }
+
+}  // namespace swift_xla
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "absl/types/span.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/ir.h"
+#include "tensorflow/compiler/xla/xla_client/types.h"
+
+namespace swift_xla {
+
+// Cuts the traces of programs whose graphs keep changing from step to step,
+// like loops with a data dependent trip count, which unroll into a different
+// graph every time even though their body is the same. When a graph needs a
+// compilation past the first steps, its post-order is compared with the
+// earlier ones starting with the same node, and the node after which they
+// diverge becomes a cutpoint: from then on the pending graph is synced as soon
+// as a tensor gets produced by that node, so that the traces split into pieces
+// which hit the computation cache.
+//
+// A prefix keeps up to XLA_TRACELETS_MAX_TAILS earlier traces, since several
+// tails can follow the same prefix. With XLA_PERSISTENT_CACHE_PATH set, the
+// cutpoints are recorded in its tracelet_cutpoints file, and the later runs
+// cut their traces from the first step.
+class Tracelets {
+ public:
+  // Whether XLA_TRACELETS is set.
+  static bool IsEnabled();
+
+  // Whether the traces get cut after the node of the given hash.
+  static bool IsCutpoint(const xla::hash_t& node_hash);
+
+  // Learns the cutpoints of the graph of the given post-order, if the previous
+  // graph needed a compilation.
+  static void Learn(absl::Span<const ir::Node* const> post_order);
+
+  // Counts the steps, which tracelets wait a few of before learning.
+  static void MarkStep();
+
+  // Records the outcome of a computation cache lookup. The graphs synced
+  // within a CutScope are counted as the compilations tracelets saved when
+  // they hit the cache.
+  static void RecordCompileLookup(bool cached);
+
+  // Marks the sync of a graph cut at a cutpoint, for the duration of the scope.
+  class CutScope {
+   public:
+    CutScope();
+    ~CutScope();
+  };
+};
+
+}  // namespace swift_xla
@@ -0,0 +1,243 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks of the host to device and device to host transfers, on the first
+// device of each kind, across:
+//   the element type conversions, like float to bfloat16 or 64 to 32 bits
+//     integers, which happen on the host;
+//   the layouts, where a device layout other than the row major one of the
+//     host tensors needs a transform;
+//   the sizes, from the small tensors whose transfers are latency bound to the
+//     large ones which are bandwidth bound;
+//   the batching, a transfer of many tensors in a single call against a call
+//     per tensor. The downloads also get measured straight into a caller
+//     buffer, the zero-copy path of XlaDataToBuffer().
+// The bytes are the host ones, and the items the tensors, whose inverse rate
+// gives the latency of a transfer. XRT splits the uploads in chunks of at most
+// XRT_MAX_TENSORS_PARTITION bytes, which can be set to measure its effect.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/shape_util.h"
+#include "tensorflow/compiler/xla/xla_client/computation_client.h"
+#include "tensorflow/compiler/xla/xla_client/device.h"
+
+namespace swift_xla {
+namespace {
+
+// The tensors moved by every iteration.
+constexpr int64_t kNumTensors = 8;
+
+// The minor dimension of the rank 2 layouts.
+constexpr int64_t kMinorSize = 128;
+
+struct TypeCase {
+  const char* name;
+  at::ScalarType host_type;
+  xla::PrimitiveType device_type;
+};
+
+const TypeCase kTypeCases[] = {
+    {"f32", at::ScalarType::Float, xla::F32},
+    {"f32_bf16", at::ScalarType::Float, xla::BF16},
+    {"s64", at::ScalarType::Long, xla::S64},
+    {"s64_s32", at::ScalarType::Long, xla::S32},
+};
+
+enum class Layout { kFlat, kDevice, kTransposed };
+
+const char* LayoutName(Layout layout) {
+  switch (layout) {
+    case Layout::kFlat:
+      return "flat";
+    case Layout::kDevice:
+      return "device";
+    case Layout::kTransposed:
+      return "transposed";
+  }
+}
+
+enum class Mode { kSingle, kBatched, kDirect };
+
+const char* ModeName(Mode mode) {
+  switch (mode) {
+    case Mode::kSingle:
+      return "single";
+    case Mode::kBatched:
+      return "batched";
+    case Mode::kDirect:
+      return "direct";
+  }
+}
+
+struct TransferCase {
+  TypeCase type;
+  Layout layout;
+  Mode mode;
+  int64_t num_bytes;
+};
+
+int64_t HostElementSize(at::ScalarType type) {
+  return xla::ShapeUtil::ByteSizeOfPrimitiveType(TensorTypeToRawXlaType(type));
+}
+
+std::vector<int64_t> GetDimensions(const TransferCase& transfer) {
+  int64_t num_elements =
+      transfer.num_bytes / HostElementSize(transfer.type.host_type);
+  if (transfer.layout == Layout::kFlat) {
+    return {num_elements};
+  }
+  return {num_elements / kMinorSize, kMinorSize};
+}
+
+xla::Shape GetDeviceShape(const TransferCase& transfer, const Device& device) {
+  std::vector<int64_t> dims = GetDimensions(transfer);
+  if (transfer.layout == Layout::kTransposed) {
+    return xla::ShapeUtil::MakeShapeWithLayout(transfer.type.device_type, dims,
+                                               {0, 1});
+  }
+  return MakeShapeWithDeviceLayout(
+      xla::ShapeUtil::MakeShape(transfer.type.device_type, dims),
+      device.hw_type);
+}
+
+at::Tensor MakeHostTensor(const TransferCase& transfer) {
+  std::vector<int64_t> dims = GetDimensions(transfer);
+  size_t len = at::GetLenFromShape(dims);
+  if (transfer.type.host_type == at::ScalarType::Long) {
+    std::unique_ptr<int64_t[]> data(new int64_t[len]());
+    return at::Tensor(std::move(data), std::move(dims));
+  }
+  std::unique_ptr<float[]> data(new float[len]());
+  return at::Tensor(std::move(data), std::move(dims));
+}
+
+void BM_Upload(benchmark::State& state, std::string device,
+               TransferCase transfer) {
+  Device device_id(device);
+  std::vector<at::Tensor> tensors(kNumTensors, MakeHostTensor(transfer));
+  std::vector<xla::Shape> shapes(kNumTensors,
+                                 GetDeviceShape(transfer, device_id));
+  for (auto _ : state) {
+    if (transfer.mode == Mode::kBatched) {
+      benchmark::DoNotOptimize(CreateTensorsData(tensors, shapes, device));
+    } else {
+      for (int64_t i = 0; i < kNumTensors; ++i) {
+        benchmark::DoNotOptimize(
+            TensorToXlaData(tensors[i], shapes[i], device_id));
+      }
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * kNumTensors *
+                          transfer.num_bytes);
+  state.SetItemsProcessed(state.iterations() * kNumTensors);
+}
+
+void BM_Download(benchmark::State& state, std::string device,
+                 TransferCase transfer) {
+  Device device_id(device);
+  std::vector<at::Tensor> tensors(kNumTensors, MakeHostTensor(transfer));
+  std::vector<xla::Shape> shapes(kNumTensors,
+                                 GetDeviceShape(transfer, device_id));
+  std::vector<xla::ComputationClient::DataPtr> data =
+      CreateTensorsData(tensors, shapes, device);
+  at::ScalarType host_type = transfer.type.host_type;
+  std::unique_ptr<char[]> buffer(new char[transfer.num_bytes]);
+  for (auto _ : state) {
+    switch (transfer.mode) {
+      case Mode::kSingle:
+        for (const auto& tensor_data : data) {
+          benchmark::DoNotOptimize(XlaDataToTensors({tensor_data}, host_type));
+        }
+        break;
+      case Mode::kBatched:
+        benchmark::DoNotOptimize(XlaDataToTensors(data, host_type));
+        break;
+      case Mode::kDirect:
+        for (const auto& tensor_data : data) {
+          XlaDataToBuffer(tensor_data, host_type, buffer.get(),
+                          transfer.num_bytes);
+        }
+        break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * kNumTensors *
+                          transfer.num_bytes);
+  state.SetItemsProcessed(state.iterations() * kNumTensors);
+}
+
+std::vector<std::string> GetBenchmarkDevices() {
+  std::vector<std::string> devices;
+  for (const std::string& device : xla::ComputationClient::AllDevices()) {
+    Device device_id(device);
+    bool seen = false;
+    for (const std::string& other : devices) {
+      seen = seen || Device(other).hw_type == device_id.hw_type;
+    }
+    if (!seen) {
+      devices.push_back(device);
+    }
+  }
+  return devices;
+}
+
+void RegisterTransferBenchmarks() {
+  for (const std::string& device : GetBenchmarkDevices()) {
+    for (const TypeCase& type : kTypeCases) {
+      for (Layout layout :
+           {Layout::kFlat, Layout::kDevice, Layout::kTransposed}) {
+        for (Mode mode : {Mode::kSingle, Mode::kBatched, Mode::kDirect}) {
+          for (int64_t num_bytes = 1 << 10; num_bytes <= (1 << 26);
+               num_bytes *= 16) {
+            TransferCase transfer{type, layout, mode, num_bytes};
+            std::string name =
+                absl::StrCat(device, "/", type.name, "/", LayoutName(layout),
+                             "/", ModeName(mode), "/", num_bytes);
+            // The uploads have no direct mode, and the direct downloads only
+            // apply when the device holds the host element type.
+            if (mode != Mode::kDirect) {
+              benchmark::RegisterBenchmark(
+                  absl::StrCat("BM_Upload/", name).c_str(), BM_Upload, device,
+                  transfer)
+                  ->Unit(benchmark::kMicrosecond);
+            }
+            if (mode != Mode::kDirect ||
+                TensorTypeToRawXlaType(type.host_type) == type.device_type) {
+              benchmark::RegisterBenchmark(
+                  absl::StrCat("BM_Download/", name).c_str(), BM_Download,
+                  device, transfer)
+                  ->Unit(benchmark::kMicrosecond);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace swift_xla
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  swift_xla::RegisterTransferBenchmarks();
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
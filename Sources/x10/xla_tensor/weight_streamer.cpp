@@ -0,0 +1,93 @@
+// Copyright 2020 TensorFlow Authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/weight_streamer.h"
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor_util.h"
+#include "tensorflow/compiler/xla/xla_client/debug_macros.h"
+#include "tensorflow/compiler/xla/xla_client/metrics.h"
+#include "tensorflow/compiler/xla/xla_client/thread_pool.h"
+
+namespace swift_xla {
+
+WeightStreamer::WeightStreamer(std::vector<Layer> layers)
+    : layers_(std::move(layers)) {
+  XLA_CHECK(!layers_.empty()) << "A weight streamer needs at least one layer";
+  const Device& device = layers_.front().graph->device();
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    const Layer& layer = layers_[i];
+    XLA_CHECK_EQ(layer.graph->device(), device)
+        << "Layer " << i << " is frozen on another device";
+    XLA_CHECK_LE(layer.weights.size(), layer.graph->num_inputs())
+        << "Layer " << i << " has more weights than inputs";
+  }
+}
+
+std::future<std::vector<XLATensor>> WeightStreamer::UploadWeights(
+    size_t index) const {
+  auto promise = std::make_shared<std::promise<std::vector<XLATensor>>>();
+  std::future<std::vector<XLATensor>> weights = promise->get_future();
+  // The layer gets captured by value, as the handles of its graph and weights
+  // are shared, so that the upload never outlives them.
+  auto upload_fn = [layer = layers_[index], promise]() {
+    try {
+      // The weights upload as the parameter shapes of the graph, which hold
+      // the device layouts and element types.
+      std::vector<xla::Shape> shapes;
+      shapes.reserve(layer.weights.size());
+      for (size_t i = 0; i < layer.weights.size(); ++i) {
+        shapes.push_back(layer.graph->input_shape(i));
+      }
+      std::vector<xla::ComputationClient::DataPtr> data = CreateTensorsData(
+          layer.weights, shapes, layer.graph->device().ToString());
+      std::vector<XLATensor> tensors;
+      tensors.reserve(data.size());
+      for (size_t i = 0; i < data.size(); ++i) {
+        tensors.push_back(XLATensor::Create(std::move(data[i]),
+                                            layer.weights[i].scalar_type()));
+      }
+      promise->set_value(std::move(tensors));
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+    }
+  };
+  xla::env::ScheduleIoClosure(std::move(upload_fn));
+  return weights;
+}
+
+std::vector<XLATensor> WeightStreamer::Run(std::vector<XLATensor> inputs) const {
+  static xla::metrics::Metric* wait_metric = new xla::metrics::Metric(
+      "WeightStreamerWaitTime", xla::metrics::MetricFnTime);
+  std::vector<XLATensor> activations = std::move(inputs);
+  std::future<std::vector<XLATensor>> next_weights = UploadWeights(0);
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    std::vector<XLATensor> layer_inputs;
+    {
+      // Time the layer runs waiting for its weights, which the upload of the
+      // next layer should hide once the pipeline is primed.
+      xla::metrics::TimedSection timed(wait_metric);
+      layer_inputs = next_weights.get();
+    }
+    if (i + 1 < layers_.size()) {
+      next_weights = UploadWeights(i + 1);
+    }
+    layer_inputs.insert(layer_inputs.end(), activations.begin(),
+                        activations.end());
+    activations = layers_[i].graph->Run(&layer_inputs);
+    XLA_COUNTER("WeightStreamerLayers", 1);
+  }
+  return activations;
+}
+
+}  // namespace swift_xla
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2020 TensorFlow Authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/compiler/tf2xla/xla_tensor/aten_compat.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/frozen_graph.h"
+#include "tensorflow/compiler/tf2xla/xla_tensor/tensor.h"
+
+namespace swift_xla {
+
+// Runs a model whose weights do not fit the memory of its device, split into
+// layers, each frozen on its own with its weights as the leading inputs and the
+// activations of the previous layer as the following ones. The weights stay in
+// host memory, and stream to the device one layer ahead: the weights of layer
+// i + 1 upload while layer i runs, and the ones of layer i get released once
+// it has, so the device holds the weights of two layers at most. Layers of the
+// same shapes then get their buffers recycled by the device allocator.
+class WeightStreamer {
+ public:
+  struct Layer {
+    std::shared_ptr<FrozenGraph> graph;
+    // The host values of the leading inputs of the graph.
+    std::vector<at::Tensor> weights;
+  };
+
+  explicit WeightStreamer(std::vector<Layer> layers);
+
+  // Runs the layers in order, the first one over the inputs, and returns the
+  // outputs of the last one.
+  std::vector<XLATensor> Run(std::vector<XLATensor> inputs) const;
+
+  size_t num_layers() const { return layers_.size(); }
+
+  const Layer& layer(size_t index) const { return layers_[index]; }
+
+ private:
+  // Starts uploading the weights of the layer in the background.
+  std::future<std::vector<XLATensor>> UploadWeights(size_t index) const;
+
+  std::vector<Layer> layers_;
+};
+
+}  // namespace swift_xla
@@ -442,6 +442,32 @@ final class TensorTests: XCTestCase {
     }
   }
 
+  func testAugmentImages() throws {
+    let images = Tensor<UInt8>(
+      shape: [2, 5, 5, 3], scalars: (0..<150).map { UInt8($0 * 7 % 256) }, on: x10)
+    let seed = Tensor<Int32>([3, 7], on: x10)
+    // The crops covering the whole images at their size leave the images as they are, but for
+    // the flips.
+    let flipped = augmentImages(
+      images, size: (5, 5), seed: seed, areaRange: 1...1, aspectRatioRange: 1...1)
+    let expected = Tensor<Float>(TF(images)) / 255
+    for i in 0..<2 {
+      let image = TF(flipped[i])
+      XCTAssert(
+        allClose(actual: image, expected: expected[i], absTolerance: 1e-5)
+          || allClose(
+            actual: image, expected: expected[i].reversed(inAxes: 1), absTolerance: 1e-5))
+    }
+    let augmented = augmentImages(
+      images, size: (4, 3), seed: seed, brightness: 0.2, contrast: 0.2, saturation: 0.2)
+    XCTAssertEqual(augmented.shape, [2, 4, 3, 3])
+    XCTAssert((augmented .>= 0).all() && (augmented .<= 1).all())
+    let repeated = augmentImages(
+      images, size: (4, 3), seed: seed, brightness: 0.2, contrast: 0.2, saturation: 0.2)
+    XCTAssertEqual(TF(repeated), TF(augmented))
+  }
+
+
   func testAvgPool() throws {
     for useReducedPrecision in [false, true] {
       for stride in 1..<3 {
@@ -916,6 +942,39 @@ final class TensorTests: XCTestCase {
     }
   }
 
+  func testConv2DBiasActivation() throws {
+    let input = Tensor<Float>.rand([2, 6, 6, 3]) - 0.5
+    let filter = Tensor<Float>.rand([3, 3, 3, 4]) - 0.5
+    let bias = Tensor<Float>.rand([4]) - 0.5
+    for relu in [false, true] {
+      let outGrad = Tensor<Float>.rand([2, 3, 3, 4])
+      let (actual, actualPullback) = valueWithPullback(at: input, filter, bias) {
+        conv2DBiasActivation(
+          $0, filter: $1, bias: $2, strides: (1, 2, 2, 1), padding: .same, relu: relu)
+      }
+      let (expected, expectedPullback) = valueWithPullback(at: TF(input), TF(filter), TF(bias)) {
+        conv2DBiasActivation(
+          $0, filter: $1, bias: $2, strides: (1, 2, 2, 1), padding: .same, relu: relu)
+      }
+      XCTAssert(allClose(actual: TF(actual), expected: expected, relTolerance: 1e-4))
+      let actualGrads = actualPullback(outGrad)
+      let expectedGrads = expectedPullback(TF(outGrad))
+      XCTAssert(
+        allClose(
+          actual: TF(actualGrads.0), expected: expectedGrads.0, relTolerance: 1e-4,
+          absTolerance: 1e-5))
+      XCTAssert(
+        allClose(
+          actual: TF(actualGrads.1), expected: expectedGrads.1, relTolerance: 1e-4,
+          absTolerance: 1e-5))
+      XCTAssert(
+        allClose(
+          actual: TF(actualGrads.2), expected: expectedGrads.2, relTolerance: 1e-4,
+          absTolerance: 1e-5))
+    }
+  }
+
+
   func testConv2DGrad() throws {
     let inChannels = 4
     let outChannels = 4
@@ -1185,6 +1244,19 @@ final class TensorTests: XCTestCase {
     }
   }
 
+  func testEmbeddingSparseUpdate() throws {
+    let table = Tensor<Float>.rand([6, 3])
+    let indices = Tensor<Int32>(shape: [4], scalars: [4, 1, 4, 0], on: x10)
+    let values = Tensor<Float>.rand([4, 3])
+    let actual = _Raw.embeddingSparseUpdate(table, indices: indices, values: values)
+    let expected = _Raw.embeddingSparseUpdate(TF(table), indices: TF(indices), values: TF(values))
+    XCTAssert(allClose(actual: TF(actual), expected: expected))
+    let rows = SparseRows(indices: indices, values: values)
+    XCTAssert(
+      allClose(actual: TF(rows.densified(rowCount: 6)), expected: expected - TF(table)))
+  }
+
+
   func testEqual() throws {
     var x = Tensor<Float>(shape: [4], scalars: [1, 22, 3, 5], on: x10)
     var y = Tensor<Float>(shape: [4], scalars: [7, 19, 3, 5], on: x10)
@@ -1263,6 +1335,74 @@ final class TensorTests: XCTestCase {
     }
   }
 
+  func testFusedOptimizerStep() throws {
+    // X10 runs the fused step of the parameter groups, TF eager their callbacks.
+    let x = Tensor<Float>.rand([4, 3])
+    let makers: [() -> ParameterGroupOptimizer] = [
+      { makeSGD(learningRate: 0.1, momentum: 0.9, weightDecay: 0.01, nesterov: true) },
+      { makeAdam(learningRate: 0.1) },
+      { makeAdam(learningRate: 0.1, decoupledWeightDecay: false) },
+    ]
+    for makeOptimizer in makers {
+      var model = Dense<Float>(
+        weight: Tensor<Float>.rand([3, 2]), bias: Tensor<Float>.rand([2]), activation: identity)
+      var tfModel = Dense<Float>(copying: model, to: tf)
+      let optimizer = GeneralOptimizer(
+        for: model, TensorVisitorPlan(model.differentiableVectorView),
+        defaultOptimizer: makeOptimizer())
+      let tfOptimizer = GeneralOptimizer(
+        for: tfModel, TensorVisitorPlan(tfModel.differentiableVectorView),
+        defaultOptimizer: makeOptimizer())
+      for _ in 0..<3 {
+        optimizer.update(&model, along: gradient(at: model) { $0(x).squared().sum() })
+        tfOptimizer.update(&tfModel, along: gradient(at: tfModel) { $0(TF(x)).squared().sum() })
+      }
+      XCTAssert(
+        allClose(
+          actual: TF(model.weight), expected: tfModel.weight, relTolerance: 1e-4,
+          absTolerance: 1e-5))
+      XCTAssert(
+        allClose(
+          actual: TF(model.bias), expected: tfModel.bias, relTolerance: 1e-4, absTolerance: 1e-5))
+    }
+  }
+
+
+  func testFusedRecurrentCells() throws {
+    let inputs = (0..<4).map { _ in Tensor<Float>.rand([2, 3]) }
+    func assertGradientsClose<G: KeyPathIterable>(_ actual: G, _ expected: G) {
+      for keyPath in expected.recursivelyAllKeyPaths(to: Tensor<Float>.self) {
+        XCTAssert(
+          allClose(
+            actual: TF(actual[keyPath: keyPath]), expected: expected[keyPath: keyPath],
+            relTolerance: 1e-4, absTolerance: 1e-5), "\(keyPath)")
+      }
+    }
+    let lstm = LSTM<Float>(LSTMCell(inputSize: 3, hiddenSize: 5))
+    let (lstmValue, lstmGrad) = valueWithGradient(at: LSTM<Float>(copying: lstm, to: x10)) {
+      $0.lastOutput(from: inputs).hidden.sum()
+    }
+    let (expectedLSTMValue, expectedLSTMGrad) = valueWithGradient(
+      at: LSTM<Float>(copying: lstm, to: tf)
+    ) {
+      $0.lastOutput(from: inputs.map { TF($0) }).hidden.sum()
+    }
+    XCTAssertEqual(lstmValue.scalarized(), expectedLSTMValue.scalarized(), accuracy: 1e-4)
+    assertGradientsClose(lstmGrad, expectedLSTMGrad)
+    let gru = GRU<Float>(GRUCell(inputSize: 3, hiddenSize: 5))
+    let (gruValue, gruGrad) = valueWithGradient(at: GRU<Float>(copying: gru, to: x10)) {
+      $0.lastOutput(from: inputs).sum()
+    }
+    let (expectedGRUValue, expectedGRUGrad) = valueWithGradient(
+      at: GRU<Float>(copying: gru, to: tf)
+    ) {
+      $0.lastOutput(from: inputs.map { TF($0) }).sum()
+    }
+    XCTAssertEqual(gruValue.scalarized(), expectedGRUValue.scalarized(), accuracy: 1e-4)
+    assertGradientsClose(gruGrad, expectedGRUGrad)
+  }
+
+
   func testGather() throws {
     let size = 4
     var params = Tensor<Float>.rand([size, size])
@@ -1951,6 +2091,59 @@ final class TensorTests: XCTestCase {
     }
   }
 
+  func testKeyValueCache() throws {
+    var cache = _XLAKeyValueCache<Float>(
+      batchShape: [2], capacity: 8, keyDimension: 4, valueDimension: 3, on: x10)
+    let keys = Tensor<Float>.rand([2, 5, 4])
+    let values = Tensor<Float>.rand([2, 5, 3])
+    let query = Tensor<Float>.rand([2, 2, 4])
+    cache.append(keys: keys[0..., 0..<3], values: values[0..., 0..<3])
+    cache.append(keys: keys[0..., 3..<5], values: values[0..., 3..<5])
+    XCTAssertEqual(cache.count, 5)
+    XCTAssertEqual(cache.capacity, 8)
+    XCTAssertEqual(TF(cache.keys[0..., 0..<5]), TF(keys))
+    let actual = TF(cache.attention(query: query))
+    // The query rows sit at positions 3 and 4, and see the keys up to their own position.
+    for row in 0..<2 {
+      let position = 3 + row
+      let scores = matmul(
+        TF(query)[0..., row..<(row + 1)], transposed: false,
+        TF(keys)[0..., 0...position], transposed: true) / Float(4).squareRoot()
+      let expected = matmul(softmax(scores), TF(values)[0..., 0...position])
+      XCTAssert(
+        allClose(actual: actual[0..., row..<(row + 1)], expected: expected, relTolerance: 1e-4))
+    }
+    cache.reset()
+    XCTAssertEqual(cache.count, 0)
+  }
+
+
+  func testLayerNorm() throws {
+    let x = Tensor<Float>.rand([3, 4, 6])
+    let offset = Tensor<Float>.rand([4])
+    let scale = Tensor<Float>.rand([4])
+    let outGrad = Tensor<Float>.rand([3, 4, 6])
+    let layer = LayerNorm(offset: offset, scale: scale, axis: 1, epsilon: 1e-3)
+    let tfLayer = LayerNorm(offset: TF(offset), scale: TF(scale), axis: 1, epsilon: 1e-3)
+    let (actual, actualPullback) = valueWithPullback(at: layer, x) { $0($1) }
+    let (expected, expectedPullback) = valueWithPullback(at: tfLayer, TF(x)) { $0($1) }
+    XCTAssert(allClose(actual: TF(actual), expected: expected, relTolerance: 1e-4))
+    let (actualLayerGrad, actualInputGrad) = actualPullback(outGrad)
+    let (expectedLayerGrad, expectedInputGrad) = expectedPullback(TF(outGrad))
+    XCTAssert(
+      allClose(
+        actual: TF(actualInputGrad), expected: expectedInputGrad, relTolerance: 1e-4,
+        absTolerance: 1e-5))
+    XCTAssert(
+      allClose(
+        actual: TF(actualLayerGrad.scale), expected: expectedLayerGrad.scale, relTolerance: 1e-4))
+    XCTAssert(
+      allClose(
+        actual: TF(actualLayerGrad.offset), expected: expectedLayerGrad.offset,
+        relTolerance: 1e-4))
+  }
+
+
   func testLeakyRelu() throws {
     var x = Tensor<Float>(shape: [4], scalars: [-0.5, -0.25, 0.5, 3.0], on: x10)
     let expected = leakyRelu(TF(x))
@@ -2044,6 +2237,45 @@ final class TensorTests: XCTestCase {
     }
   }
 
+  func testLinearAlgebraSolves() throws {
+    let a = Tensor<Float>.rand([2, 4, 4])
+    // Symmetric positive definite matrices, for the Cholesky decomposition.
+    let spd = matmul(a, transposed: false, a, transposed: true) + 4 * Tensor<Float>(eye: 4)
+    let rhs = Tensor<Float>.rand([2, 4, 3])
+    let factor = cholesky(spd)
+    XCTAssert(
+      allClose(actual: TF(factor), expected: cholesky(TF(spd)), relTolerance: 1e-4))
+    for lower in [false, true] {
+      for adjoint in [false, true] {
+        let triangular = lower ? factor : factor.transposed(permutation: 0, 2, 1)
+        let actual = triangularSolve(matrix: triangular, rhs: rhs, lower: lower, adjoint: adjoint)
+        XCTAssert(
+          allClose(
+            actual: TF(actual),
+            expected: triangularSolve(
+              matrix: TF(triangular), rhs: TF(rhs), lower: lower, adjoint: adjoint),
+            relTolerance: 1e-4, absTolerance: 1e-5))
+      }
+    }
+    XCTAssert(
+      allClose(
+        actual: TF(choleskySolve(cholesky: factor, rhs: rhs)),
+        expected: solve(matrix: TF(spd), rhs: TF(rhs)), relTolerance: 1e-3, absTolerance: 1e-5))
+    for adjoint in [false, true] {
+      XCTAssert(
+        allClose(
+          actual: TF(solve(matrix: a, rhs: rhs, adjoint: adjoint)),
+          expected: solve(matrix: TF(a), rhs: TF(rhs), adjoint: adjoint), relTolerance: 1e-3,
+          absTolerance: 1e-4))
+    }
+    let (lu, permutation) = a.luDecomposition()
+    let (expectedLU, expectedPermutation) = TF(a).luDecomposition()
+    XCTAssertEqual(TF(permutation), expectedPermutation)
+    XCTAssert(
+      allClose(actual: TF(lu), expected: expectedLU, relTolerance: 1e-4, absTolerance: 1e-5))
+  }
+
+
   func testLinSpace() throws {
     func testRanges(
       start: Float, stop: Float, num: Int32, useReducedPrecision: Bool, absTolerance: Float = 1e-5
@@ -2518,6 +2750,18 @@ final class TensorTests: XCTestCase {
     }
   }
 
+  func testMoeRouting() throws {
+    let gates = Tensor<Float>(
+      shape: [4, 3], scalars: [0.6, 0.3, 0.1, 0.5, 0.1, 0.4, 0.7, 0.2, 0.1, 0.1, 0.2, 0.7],
+      on: x10)
+    let (expertIndices, positions) = moeRouting(gates: gates, k: 2, capacity: 2)
+    XCTAssertEqual(expertIndices.shape, [4, 2])
+    XCTAssertEqual(expertIndices.scalars, [0, 1, 0, 2, 0, 1, 2, 1])
+    // The second choices come after all the first ones, and the overflow gets the capacity.
+    XCTAssertEqual(positions.scalars, [0, 0, 1, 1, 2, 1, 0, 2])
+  }
+
+
   func testMul() throws {
     var x = Tensor<Float>(shape: [2], scalars: [1, 3], on: x10)
     var y = Tensor<Float>(shape: [2], scalars: [7, 19], on: x10)
@@ -2537,6 +2781,46 @@ final class TensorTests: XCTestCase {
     }
   }
 
+  func testNonMaxSuppression() throws {
+    let boxes = Tensor<Float>(
+      shape: [6, 4],
+      scalars: [
+        0, 0, 1, 1, 0, 0.1, 1, 1.1, 0, -0.1, 1, 0.9,
+        0, 10, 1, 11, 0, 10.1, 1, 11.1, 0, 100, 1, 101,
+      ], on: x10)
+    let scores = Tensor<Float>(
+      shape: [2, 6], scalars: [0.9, 0.75, 0.6, 0.95, 0.5, 0.55, 0.1, 0.2, 0.3, 0.4, 0.5, 0.6],
+      on: x10)
+    let maxOutputSize = Tensor<Int32>(4, on: x10)
+    let iouThreshold = Tensor<Float>(0.5, on: x10)
+    let scoreThreshold = Tensor<Float>(0.15, on: x10)
+    var expected: [[Int32]] = []
+    for i in 0..<2 {
+      let result = _Raw.nonMaxSuppressionV4(
+        boxes: TF(boxes), scores: TF(scores[i]), maxOutputSize: TF(maxOutputSize),
+        iouThreshold: TF(iouThreshold), scoreThreshold: TF(scoreThreshold),
+        padToMaxOutputSize: true)
+      expected.append(Array(result.selectedIndices.scalars[0..<Int(result.validOutputs.scalar!)]))
+      let actual = _Raw.nonMaxSuppressionV4(
+        boxes: boxes, scores: scores[i], maxOutputSize: maxOutputSize,
+        iouThreshold: iouThreshold, scoreThreshold: scoreThreshold, padToMaxOutputSize: true)
+      XCTAssertEqual(actual.selectedIndices.shape, [4])
+      XCTAssertEqual(
+        Array(actual.selectedIndices.scalars[0..<Int(actual.validOutputs.scalar!)]), expected[i])
+    }
+    // The batched variant, with the top-k pre-filter keeping every candidate selected above.
+    let batched = _RawXLA.nonMaxSuppression(
+      boxes: boxes, scores: scores, scoreThreshold: scoreThreshold,
+      iouThreshold: iouThreshold, outputSize: 4, preNmsTopK: 5)
+    XCTAssertEqual(batched.selectedIndices.shape, [2, 4])
+    for i in 0..<2 {
+      let validOutputs = Int(batched.validOutputs[i].scalar!)
+      XCTAssertEqual(
+        Array(batched.selectedIndices[i].scalars[0..<validOutputs]), expected[i])
+    }
+  }
+
+
   func testNotEqual() throws {
     var x = Tensor<Float>(shape: [4], scalars: [1, 22, 3, 5], on: x10)
     var y = Tensor<Float>(shape: [4], scalars: [7, 19, 3, 5], on: x10)
@@ -2640,6 +2924,52 @@ final class TensorTests: XCTestCase {
     }
   }
 
+  func testPackedSequenceAttention() throws {
+    let batch = PackedSequenceBatch<Int32>(
+      packing: [
+        [Tensor<Int32>([1, 2, 3]), Tensor<Int32>([4, 5])],
+        [Tensor<Int32>([6, 7, 8, 9])],
+      ], capacity: 6, on: x10)
+    XCTAssertEqual(batch.tokens.scalars, [1, 2, 3, 4, 5, 0, 6, 7, 8, 9, 0, 0])
+    XCTAssertEqual(batch.segmentIds.scalars, [1, 1, 1, 2, 2, 0, 1, 1, 1, 1, 0, 0])
+    XCTAssertEqual(batch.positions.scalars, [0, 1, 2, 0, 1, 0, 0, 1, 2, 3, 0, 0])
+    XCTAssertEqual(batch.mask.scalars, [1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 0, 0])
+    let query = Tensor<Float>.rand([2, 6, 4])
+    let key = Tensor<Float>.rand([2, 6, 4])
+    let value = Tensor<Float>.rand([2, 6, 3])
+    let actual = TF(
+      scaledDotProductAttention(
+        query: query, key: key, value: value, segmentIds: batch.segmentIds))
+    // Each sequence attends to itself only, as if it were alone.
+    for (row, range) in [(0, 0..<3), (0, 3..<5), (1, 0..<4)] {
+      let expected = scaledDotProductAttention(
+        query: TF(query)[row, range], key: TF(key)[row, range], value: TF(value)[row, range])
+      XCTAssert(
+        allClose(actual: actual[row, range], expected: expected, relTolerance: 1e-4))
+    }
+    let logits = Tensor<Float>.rand([2, 6, 10])
+    let labels = batch.tokens
+    let loss = softmaxCrossEntropy(logits: logits, labels: labels, mask: batch.mask)
+    let expectedLoss = softmaxCrossEntropy(
+      logits: Tensor(concatenating: [TF(logits)[0, 0..<5], TF(logits)[1, 0..<4]]),
+      labels: Tensor<Int32>([1, 2, 3, 4, 5, 6, 7, 8, 9], on: tf))
+    XCTAssertEqual(loss.scalarized(), expectedLoss.scalarized(), accuracy: 1e-5)
+  }
+
+
+  func testPaddedToBucket() throws {
+    let x = Tensor<Float>(shape: [2, 5], scalars: (1...10).map(Float.init), on: x10)
+    // Once on the host, and once as the output of a pending graph.
+    for input in [x, x * 1] {
+      let (padded, mask) = input.paddedToBucket(alongAxis: 1, with: -1)
+      XCTAssertEqual(padded.shape, [2, 8])
+      XCTAssertEqual(
+        TF(padded), TF(x).padded(forSizes: [(0, 0), (0, 3)], mode: .constant(-1)))
+      XCTAssertEqual(
+        TF(mask).scalars, [Bool](repeating: true, count: 5) + [false, false, false])
+    }
+  }
+
   func testPow() throws {
     let dims = [3, 2]
     var x = Tensor<Float>.rand(dims)
@@ -2696,6 +3026,30 @@ final class TensorTests: XCTestCase {
     }
   }
 
+  func testQuantizedLayers() throws {
+    let input = Tensor<Float>.rand([2, 5, 5, 8]) - 0.5
+    ActivationCalibration.record(input, name: "QuantizedLayersTest")
+    let inputRange = try XCTUnwrap(ActivationCalibration.range(name: "QuantizedLayersTest"))
+    XCTAssertEqual(inputRange.min, input.min().scalarized())
+    XCTAssertEqual(inputRange.max, input.max().scalarized())
+    // The int8 rounding of the inputs and weights bounds the error to a few steps of their scales.
+    let dense = Dense<Float>(
+      weight: Tensor<Float>.rand([8, 4]) - 0.5, bias: Tensor<Float>.rand([4]), activation: relu)
+    let denseInput = input.reshaped(to: [50, 8])
+    XCTAssert(
+      allClose(
+        actual: TF(QuantizedDense(dense, inputRange: inputRange)(denseInput)),
+        expected: TF(dense(denseInput)), relTolerance: 0.02, absTolerance: 0.02))
+    let conv = Conv2D<Float>(
+      filter: Tensor<Float>.rand([3, 3, 8, 4]) - 0.5, bias: Tensor<Float>.rand([4]),
+      activation: relu, strides: (2, 2), padding: .same)
+    XCTAssert(
+      allClose(
+        actual: TF(QuantizedConv2D(conv, inputRange: inputRange)(input)),
+        expected: TF(conv(input)), relTolerance: 0.02, absTolerance: 0.05))
+  }
+
+
   func testRange() throws {
     let start = Int32(3)
     let limit = Int32(18)
@@ -2788,6 +3142,19 @@ final class TensorTests: XCTestCase {
     }
   }
 
+  func testRematerialized() throws {
+    func body(_ x: Tensor<Float>) -> Tensor<Float> {
+      return tanh(x * x + 1)
+    }
+    func rematX10(_ x: Tensor<Float>) -> Tensor<Float> {
+      return x.rematerialized("test", body)
+    }
+    let x = Tensor<Float>.rand([3, 4])
+    let outGrad = Tensor<Float>.rand([3, 4])
+    XCTAssert(allClose(actual: TF(rematX10(x)), expected: body(TF(x))))
+    assertEqualUnaryOperationGradients(rematX10, body, x, outGrad)
+  }
+
   func testReshape() throws {
     for useReducedPrecision in [false, true] {
       do {
@@ -2821,6 +3188,27 @@ final class TensorTests: XCTestCase {
     }
   }
 
+  func testRMSNorm() throws {
+    let x = Tensor<Float>.rand([3, 6])
+    let scale = Tensor<Float>.rand([6])
+    let outGrad = Tensor<Float>.rand([3, 6])
+    let layer = RMSNorm(scale: scale, axis: -1, epsilon: 1e-6)
+    let tfLayer = RMSNorm(scale: TF(scale), axis: -1, epsilon: 1e-6)
+    let (actual, actualPullback) = valueWithPullback(at: layer, x) { $0($1) }
+    let (expected, expectedPullback) = valueWithPullback(at: tfLayer, TF(x)) { $0($1) }
+    XCTAssert(allClose(actual: TF(actual), expected: expected, relTolerance: 1e-4))
+    let (actualLayerGrad, actualInputGrad) = actualPullback(outGrad)
+    let (expectedLayerGrad, expectedInputGrad) = expectedPullback(TF(outGrad))
+    XCTAssert(
+      allClose(
+        actual: TF(actualInputGrad), expected: expectedInputGrad, relTolerance: 1e-4,
+        absTolerance: 1e-5))
+    XCTAssert(
+      allClose(
+        actual: TF(actualLayerGrad.scale), expected: expectedLayerGrad.scale, relTolerance: 1e-4))
+  }
+
+
   func testRound() throws {
     var x = Tensor<Float>([-3.5, -3.4, -3.6, -0.5, 0.5, -0.45, 0.45, 2.4, 2.6], on: x10)
     let expected = round(TF(x))
@@ -2872,6 +3260,74 @@ final class TensorTests: XCTestCase {
     }
   }
 
+  func testScaledDotProductAttention() throws {
+    // More keys than the default block size, so that the running softmax spans a partial block.
+    let query = Tensor<Float>.rand([2, 5, 8])
+    let key = Tensor<Float>.rand([2, 600, 8])
+    let value = Tensor<Float>.rand([2, 600, 4])
+    let outGrad = Tensor<Float>.rand([2, 5, 4])
+    let (actual, actualPullback) = valueWithPullback(at: query, key, value) {
+      scaledDotProductAttention(query: $0, key: $1, value: $2)
+    }
+    let (expected, expectedPullback) = valueWithPullback(at: TF(query), TF(key), TF(value)) {
+      scaledDotProductAttention(query: $0, key: $1, value: $2)
+    }
+    XCTAssert(allClose(actual: TF(actual), expected: expected, relTolerance: 1e-4))
+    let actualGrads = actualPullback(outGrad)
+    let expectedGrads = expectedPullback(TF(outGrad))
+    XCTAssert(
+      allClose(
+        actual: TF(actualGrads.0), expected: expectedGrads.0, relTolerance: 1e-4,
+        absTolerance: 1e-5))
+    XCTAssert(
+      allClose(
+        actual: TF(actualGrads.1), expected: expectedGrads.1, relTolerance: 1e-4,
+        absTolerance: 1e-5))
+    XCTAssert(
+      allClose(
+        actual: TF(actualGrads.2), expected: expectedGrads.2, relTolerance: 1e-4,
+        absTolerance: 1e-5))
+  }
+
+
+  func testScan() throws {
+    let rnn = BasicRNN<Float>(BasicRNNCell(inputSize: 3, hiddenSize: 4))
+    let layer = BasicRNN<Float>(copying: rnn, to: x10)
+    let tfLayer = BasicRNN<Float>(copying: rnn, to: tf)
+    let sequence = Tensor<Float>.rand([5, 2, 3])
+    let initialState = Tensor<Float>.rand([2, 4])
+    let outGrad = Tensor<Float>.rand([5, 2, 4])
+    let (actual, actualPullback) = valueWithPullback(at: layer, sequence, initialState) {
+      $0.states(over: $1, initialState: $2)
+    }
+    let (expected, expectedPullback) = valueWithPullback(
+      at: tfLayer, TF(sequence), TF(initialState)
+    ) {
+      $0.states(over: $1, initialState: $2)
+    }
+    XCTAssertEqual(actual.shape, [5, 2, 4])
+    XCTAssert(allClose(actual: TF(actual), expected: expected, relTolerance: 1e-4))
+    let actualGrads = actualPullback(outGrad)
+    let expectedGrads = expectedPullback(TF(outGrad))
+    XCTAssert(
+      allClose(
+        actual: TF(actualGrads.0.cell.weight), expected: expectedGrads.0.cell.weight,
+        relTolerance: 1e-4, absTolerance: 1e-5))
+    XCTAssert(
+      allClose(
+        actual: TF(actualGrads.0.cell.bias), expected: expectedGrads.0.cell.bias,
+        relTolerance: 1e-4, absTolerance: 1e-5))
+    XCTAssert(
+      allClose(
+        actual: TF(actualGrads.1), expected: expectedGrads.1, relTolerance: 1e-4,
+        absTolerance: 1e-5))
+    XCTAssert(
+      allClose(
+        actual: TF(actualGrads.2), expected: expectedGrads.2, relTolerance: 1e-4,
+        absTolerance: 1e-5))
+  }
+
+
   func testSelect() throws {
     let dims = [4, 2, 3]
     for useReducedPrecision in [false, true] {
@@ -3168,6 +3624,33 @@ final class TensorTests: XCTestCase {
     }
   }
 
+  func testSparseTensor() throws {
+    // Two entries at the same position add up, and the two unused ones add nothing.
+    let indices = [[0, 1], [2, 0], [2, 3], [0, 1]]
+    let values: [Float] = [1, 2, 3, 4]
+    let sparse = SparseTensor(
+      indices: indices, values: values, denseShape: [3, 4], capacity: 6, on: x10)
+    XCTAssertEqual(sparse.capacity, 6)
+    let dense = Tensor<Float>(
+      shape: [3, 4], scalars: [0, 5, 0, 0, 0, 0, 0, 0, 2, 0, 0, 3], on: tf)
+    XCTAssertEqual(TF(sparse.densified()), dense)
+    XCTAssertEqual(TF(sparse.rowSums()), dense.sum(squeezingAxes: 1))
+    let rhs = Tensor<Float>.rand([4, 5])
+    let outGrad = Tensor<Float>.rand([3, 5])
+    let (product, pullback) = valueWithPullback(at: rhs) { matmul(sparse, $0) }
+    let (expectedProduct, expectedPullback) = valueWithPullback(at: TF(rhs)) {
+      matmul(dense, $0)
+    }
+    XCTAssert(allClose(actual: TF(product), expected: expectedProduct, relTolerance: 1e-5))
+    let expectedGrad = expectedPullback(TF(outGrad))
+    XCTAssert(allClose(actual: TF(pullback(outGrad)), expected: expectedGrad, relTolerance: 1e-5))
+    let sparseGrad = matmulWithSparsePullback(sparse, rhs).pullback(outGrad)
+    XCTAssert(
+      allClose(
+        actual: TF(sparseGrad.densified(rowCount: 4)), expected: expectedGrad, relTolerance: 1e-5))
+  }
+
+
   func testSplit() throws {
     let valueDims = [9, 9]
     let numSplit = Int64(3)
@@ -3550,6 +4033,25 @@ final class TensorTests: XCTestCase {
     }
   }
 
+  func testUnsortedSegmentSumLargeIds() throws {
+    // Enough ids and segments to skip the one-hot lowering and check the ids at runtime, once
+    // sorted and once not.
+    let idCount = 2048
+    let segmentCount: Int32 = 100
+    let data = Tensor<Float>.rand([idCount, 3])
+    let sortedIds = (0..<idCount).map { Int32($0 * Int(segmentCount) / idCount) }
+    let numSegments = Tensor<Int32>(segmentCount, on: x10)
+    for ids in [sortedIds, sortedIds.shuffled()] {
+      let segmentIds = Tensor<Int32>(shape: [idCount], scalars: ids, on: x10)
+      let actual = _Raw.unsortedSegmentSum(
+        data: data, segmentIds: segmentIds, numSegments: numSegments)
+      let expected = _Raw.unsortedSegmentSum(
+        data: TF(data), segmentIds: TF(segmentIds), numSegments: TF(numSegments))
+      XCTAssert(allClose(actual: TF(actual), expected: expected, relTolerance: 1e-4))
+    }
+  }
+
+
   func testXdivY() throws {
     var x = Tensor<Float>(shape: [2, 3], scalars: [0, 1, 0, 0, 4, 8], on: x10)
     var y = Tensor<Float>(shape: [3], scalars: [0, 1, 2], on: x10)
@@ -24,6 +24,77 @@ final class XLATensorTests: XCTestCase {
     let annotated = tensor.annotate("type=Tensor<Float>")
     XCTAssertEqual(annotated.annotations, "{\n  shape=[1, 2, 3] type=Tensor<Float>\n}")
   }
+
+  func testBenchmarkTraining() throws {
+    var weight = Tensor<Float>(ones: [4, 4], on: Device.defaultXLA)
+    let report = benchmarkTraining(
+      warmupSteps: 2, steps: 5, examplesPerStep: 4, on: Device.defaultXLA
+    ) {
+      weight = weight - 0.1 * matmul(weight, weight)
+      LazyTensorBarrier(on: Device.defaultXLA)
+    }
+    XCTAssertEqual(report.steps, 5)
+    XCTAssertEqual(report.steadyStateCompiles, 0)
+    XCTAssertGreaterThanOrEqual(report.executions, 5)
+  }
+
+  func testScalarPromotionReusesComputation() throws {
+    var weight = Tensor<Float>([1, 2, 3], on: Device.defaultXLA)
+    let gradient = Tensor<Float>([2, 2, 2], on: Device.defaultXLA)
+    var expected: [Float] = [1, 2, 3]
+    var cachedCompiles = 0
+    // The second step finds the learning rate changed, and compiles the graph with it promoted
+    // to a parameter, which the following steps reuse whatever its value.
+    for (step, learningRate) in [Float(0.1), 0.2, 0.3, 0.4, 0.5].enumerated() {
+      if step == 2 {
+        cachedCompiles = X10CounterValue("CachedCompile")
+      }
+      weight = weight - learningRate * gradient
+      LazyTensorBarrier()
+      expected = expected.map { $0 - learningRate * 2 }
+      for (actual, expected) in zip(weight.scalars, expected) {
+        XCTAssertEqual(actual, expected, accuracy: 1e-5)
+      }
+    }
+    XCTAssertEqual(X10CounterValue("CachedCompile"), cachedCompiles + 3)
+  }
+
+  #if canImport(Glibc)
+  func testSharedMemoryBatchesSlotCycle() throws {
+    let batches = try SharedMemoryBatches(
+      creating: "/x10_test_batches_\(UInt32.random(in: 0...UInt32.max))", slotCount: 1,
+      slotCapacity: 64)
+    batches.write(Float.self, shape: [2, 2]) { scalars in
+      for i in 0..<scalars.count { scalars[i] = Float(i) }
+    }
+    let first = batches.next(Float.self, on: Device.defaultXLA)
+    let doubled = first * 2
+    LazyTensorBarrier()
+    // The only slot must be free again once the batch got uploaded, while the tensor is alive.
+    batches.write(Float.self, shape: [2, 2]) { scalars in
+      for i in 0..<scalars.count { scalars[i] = Float(10 + i) }
+    }
+    let second = batches.next(Float.self, on: Device.defaultXLA)
+    XCTAssertEqual(first.scalars, [0, 1, 2, 3])
+    XCTAssertEqual(doubled.scalars, [0, 2, 4, 6])
+    XCTAssertEqual(second.scalars, [10, 11, 12, 13])
+  }
+  #endif
+
+  func testSharedSubexpressionsCacheLookup() throws {
+    let x = Tensor<Float>([1, 2], on: Device.defaultXLA)
+    let y = Tensor<Float>([3, 4], on: Device.defaultXLA)
+    let z = Tensor<Float>([5, 6], on: Device.defaultXLA)
+    let w = Tensor<Float>([7, 8], on: Device.defaultXLA)
+    let a = x + y
+    let shared = a * a
+    LazyTensorBarrier()
+    XCTAssertEqual(shared.scalars, [16, 36])
+    // Same root hash, as the device data hash by shape, but not the same graph.
+    let unshared = (x + y) * (z + w)
+    LazyTensorBarrier()
+    XCTAssertEqual(unshared.scalars, [48, 84])
+  }
 }
 
 final class MultiDeviceAPITests: XCTestCase {
@@ -91,6 +162,73 @@ final class MultiDeviceAPITests: XCTestCase {
     }
   }
 
+  func testAllGatherReduceScatter() {
+    let allDevices = Device.allDevices
+    let tpuDevices = allDevices.filter { $0.kind == .TPU }
+    let count = tpuDevices.count
+    let content = _Raw.rand([2 * count, 3], 47)
+    let tpuContents = tpuDevices.map { _Raw.toDevice(content, $0) }
+    let gathered = tpuContents.map { _Raw.allGather($0, axis: 0, shardCount: count) }
+    let scattered = tpuContents.map {
+      _Raw.reduceScatter($0, 1.0 / Double(count), axis: 0, shardCount: count)
+    }
+    Device.syncLiveTensorsForDevices(tpuDevices)
+    let scalars = content.scalars
+    for (replica, (gathered, scattered)) in zip(gathered, scattered).enumerated() {
+      XCTAssertEqual(gathered.shape, [2 * count * count, 3])
+      XCTAssertEqual(gathered.scalars, Array([[Float]](repeating: scalars, count: count).joined()))
+      XCTAssertEqual(scattered.shape, [2, 3])
+      for (actual, expected) in zip(scattered.scalars, scalars[(6 * replica)..<(6 * replica + 6)]) {
+        XCTAssertEqual(actual, expected, accuracy: 1e-5)
+      }
+    }
+  }
+
+  func testMoeDispatchCombine() {
+    let allDevices = Device.allDevices
+    let tpuDevices = allDevices.filter { $0.kind == .TPU }
+    let count = tpuDevices.count
+    let input = _Raw.rand([4, 3], 47)
+    let expertIndices = Tensor<Int32>(shape: [4, 1], scalars: [0, 1, 0, 1])
+    let positions = Tensor<Int32>(shape: [4, 1], scalars: [0, 0, 1, 2])
+    // Sending the rows to the experts and back returns them, but for the dropped token.
+    let results = tpuDevices.map { device -> Tensor<Float> in
+      let expertInputs = moeDispatch(
+        _Raw.toDevice(input, device), expertIndices: _Raw.toDevice(expertIndices, device),
+        positions: _Raw.toDevice(positions, device), expertCount: 2 * count, capacity: 2,
+        replicaCount: count)
+      return moeCombine(
+        expertInputs, expertIndices: _Raw.toDevice(expertIndices, device),
+        positions: _Raw.toDevice(positions, device), replicaCount: count)
+    }
+    Device.syncLiveTensorsForDevices(tpuDevices)
+    let scalars = input.scalars
+    for result in results {
+      XCTAssertEqual(result.shape, [4, 1, 3])
+      XCTAssertEqual(result.scalars, Array(scalars[0..<9]) + [0, 0, 0])
+    }
+  }
+
+  func testSyncBatchNorm() {
+    let allDevices = Device.allDevices
+    let tpuDevices = allDevices.filter { $0.kind == .TPU }
+    let input = _Raw.rand([4, 3], 47)
+    let scale = _Raw.rand([3], 48)
+    let offset = _Raw.rand([3], 49)
+    // Every replica holds the same batch, so the global statistics are the local ones.
+    let moments = input.moments(alongAxes: 0)
+    let expected = (input - moments.mean) * rsqrt(moments.variance + 0.001) * scale + offset
+    let results = tpuDevices.map { device in
+      syncBatchNorm(
+        _Raw.toDevice(input, device), scale: _Raw.toDevice(scale, device),
+        offset: _Raw.toDevice(offset, device))
+    }
+    Device.syncLiveTensorsForDevices(tpuDevices)
+    for (result, device) in zip(results, tpuDevices) {
+      XCTAssertTrue(result.isAlmostEqual(to: _Raw.toDevice(expected, device), tolerance: 1e-4))
+    }
+  }
+
   func testFunctionalWhile() {
     let res = (_RawXLA.functionalWhile(n: Tensor<Int32>(4, on: .defaultXLA),
                initial: [Tensor<Float>(3.0, on: .defaultXLA)]) { args, i in
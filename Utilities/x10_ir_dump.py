@@ -0,0 +1,238 @@
+"""
+Converts the IR graphs saved by X10 in the binary format of
+XLA_SAVE_TENSORS_BINARY_FILE to the text or dot (Graphviz) formats of
+XLA_SAVE_TENSORS_FILE.
+"""
+
+
+import argparse
+import re
+import sys
+
+
+MAGIC = b'X10IRv1\n'
+MAX_DOT_VALUE_SIZE = 64
+TAG_NAME = re.compile(r'([a-zA-Z0-9_]+)=')
+
+
+class Node(object):
+
+  def __init__(self, op, string, num_outputs, operands):
+    self.op = op
+    self.string = string
+    self.num_outputs = num_outputs
+    # List of (node id, output index) pairs.
+    self.operands = operands
+
+
+class Graph(object):
+
+  def __init__(self, name, timestamp_ns, uncached_compile, roots, nodes):
+    self.name = name
+    self.timestamp_ns = timestamp_ns
+    self.uncached_compile = uncached_compile
+    # List of (node id, hash) pairs.
+    self.roots = roots
+    # The nodes in post order.
+    self.nodes = nodes
+
+
+class Reader(object):
+
+  def __init__(self, data):
+    self.data = data
+    self.pos = 0
+    self.strings = []
+
+  def done(self):
+    return self.pos >= len(self.data)
+
+  def byte(self):
+    value = self.data[self.pos]
+    self.pos += 1
+    return value
+
+  def varint(self):
+    value = 0
+    shift = 0
+    while True:
+      byte = self.byte()
+      value |= (byte & 0x7f) << shift
+      if byte < 0x80:
+        return value
+      shift += 7
+
+  def string(self):
+    index = self.varint()
+    if index == len(self.strings):
+      size = self.varint()
+      self.strings.append(
+          self.data[self.pos:self.pos + size].decode('utf-8', 'replace'))
+      self.pos += size
+    return self.strings[index]
+
+  def graphs(self):
+    while not self.done():
+      if self.data.startswith(MAGIC, self.pos):
+        # A new stream, with its own string table.
+        self.pos += len(MAGIC)
+        self.strings = []
+        continue
+      tag = self.byte()
+      if tag != ord('G'):
+        raise ValueError('Invalid record tag %d at offset %d' %
+                         (tag, self.pos - 1))
+      yield self.graph()
+
+  def graph(self):
+    name = self.string()
+    timestamp_ns = self.varint()
+    flags = self.varint()
+    roots = []
+    for _ in range(self.varint()):
+      node_id = self.varint()
+      hash_hi = self.varint()
+      hash_lo = self.varint()
+      roots.append((node_id, (hash_hi << 64) | hash_lo))
+    nodes = []
+    for node_id in range(self.varint()):
+      op = self.string()
+      string = self.string()
+      num_outputs = self.varint()
+      operands = []
+      for _ in range(self.varint()):
+        delta = self.varint()
+        operands.append((node_id - delta, self.varint()))
+      nodes.append(Node(op, string, num_outputs, operands))
+    return Graph(name, timestamp_ns, bool(flags & 1), roots, nodes)
+
+
+def node_shape(node):
+  pos = node.string.find(node.op)
+  return node.string[:pos].rstrip() if pos >= 0 else ''
+
+
+def node_tags(node):
+  """Splits the attributes following the op name in the node string, the same
+  way the IR dumps of X10 do."""
+  string = node.string
+  pos = string.find(node.op)
+  if pos < 0:
+    return []
+  pos += len(node.op)
+  tags = []
+  while True:
+    if string.startswith(', ', pos):
+      pos += 2
+    match = TAG_NAME.match(string, pos)
+    if match is None:
+      return tags
+    pos = match.end()
+    vpos = pos
+    nested_open = None
+    nest_count = 1
+    while pos < len(string):
+      char = string[pos]
+      if nested_open is None:
+        if string.startswith(', ', pos):
+          break
+        if char in '([{':
+          nested_open = char
+          nested_close = {'(': ')', '[': ']', '{': '}'}[char]
+      elif char == nested_close:
+        nest_count -= 1
+        if nest_count == 0:
+          nest_count = 1
+          nested_open = None
+      elif char == nested_open:
+        nest_count += 1
+      pos += 1
+    tags.append((match.group(1), string[vpos:pos]))
+
+
+def root_ids(graph):
+  ids = {}
+  for index, (node_id, _) in enumerate(graph.roots):
+    ids[node_id] = index
+  return ids
+
+
+def to_text(graph):
+  roots = root_ids(graph)
+  lines = ['IR {']
+  for node_id, node in enumerate(graph.nodes):
+    operands = []
+    for operand_id, index in node.operands:
+      operand = '%%%d' % operand_id
+      if graph.nodes[operand_id].num_outputs > 1:
+        operand += '.%d' % index
+      operands.append(operand)
+    line = '  %%%d = %s %s(%s)' % (node_id, node_shape(node), node.op,
+                                  ', '.join(operands))
+    for name, value in node_tags(node):
+      line += ', %s=%s' % (name, value)
+    if node_id in roots:
+      line += ', ROOT=%d' % roots[node_id]
+    lines.append(line)
+  lines.append('}')
+  return '\n'.join(lines) + '\n'
+
+
+def to_dot(graph):
+  roots = root_ids(graph)
+  lines = ['digraph G {']
+  for node_id, node in enumerate(graph.nodes):
+    label = '%s\\n%s' % (node.op, node_shape(node))
+    for name, value in node_tags(node):
+      if len(value) >= MAX_DOT_VALUE_SIZE:
+        value = value[:MAX_DOT_VALUE_SIZE] + '...'
+      label += '\\n%s=%s' % (name, value)
+    if node_id in roots:
+      label += '\\nROOT=%d' % roots[node_id]
+    lines.append('  node%d [label="%s"]' % (node_id, label))
+  for node_id in reversed(range(len(graph.nodes))):
+    node = graph.nodes[node_id]
+    for i, (operand_id, index) in enumerate(node.operands):
+      edge = '  node%d -> node%d' % (operand_id, node_id)
+      multi_output = graph.nodes[operand_id].num_outputs > 1
+      if len(node.operands) > 1:
+        edge += ' [label="i=%d%s"]' % (i, ',o=%d' % index
+                                       if multi_output else '')
+      elif multi_output:
+        edge += ' [label="o=%d"]' % index
+      lines.append(edge)
+  lines.append('}')
+  return '\n'.join(lines) + '\n'
+
+
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument('input', help='file saved by XLA_SAVE_TENSORS_BINARY_FILE')
+  parser.add_argument('--format', choices=['text', 'dot'], default='text',
+                      help='output format of the graphs')
+  parser.add_argument('--uncached', action='store_true',
+                      help='only convert the graphs of uncached compiles')
+  parser.add_argument('--index', type=int,
+                      help='only convert the graph with this index')
+  args = parser.parse_args()
+
+  with open(args.input, 'rb') as f:
+    data = f.read()
+  if not data.startswith(MAGIC):
+    sys.exit('%s is not an X10 binary IR dump' % args.input)
+
+  formatter = to_dot if args.format == 'dot' else to_text
+  for index, graph in enumerate(Reader(data).graphs()):
+    if args.index is not None and index != args.index:
+      continue
+    if args.uncached and not graph.uncached_compile:
+      continue
+    hashes = ', '.join('0x%x' % h for _, h in graph.roots)
+    sys.stdout.write('[%s]\nTensorsGraphInfo:\nIndex: %d\nTimestampNs: %d\n'
+                     'Hashes: (%s)\n\n## BEGIN_GRAPH\n%s\n## END_GRAPH\n\n\n' %
+                     (graph.name, index, graph.timestamp_ns, hashes,
+                      formatter(graph)))
+
+
+if __name__ == '__main__':
+  main()